@@ -0,0 +1,48 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/parsing.h>
+#include <omnicore/tx.h>
+#include <primitives/block.h>
+#include <test/util/omnichain.h>
+
+#include <assert.h>
+#include <vector>
+
+using namespace mastercore;
+
+// Parses all transactions of a synthetic chain with every kind of generated Omni transaction
+static void OmniChainParse(benchmark::State& state)
+{
+    OmniChainSpec spec;
+    spec.nHolders = 2000;
+    spec.nOrders = 200;
+    spec.nNftRanges = 200;
+    spec.nStoRecipients = 200;
+    const std::vector<CBlock> vBlocks = GenerateOmniChain(spec);
+
+    // the parser takes the spent outputs from the coins view
+    for (unsigned int nHeight = 1; nHeight <= vBlocks.size(); ++nHeight) {
+        for (const CTransactionRef& tx : vBlocks[nHeight - 1].vtx) {
+            AddCoins(view, *tx, nHeight);
+        }
+    }
+
+    while (state.KeepRunning()) {
+        int nParsed = 0;
+        for (unsigned int nHeight = GetOmniChainFundingBlocks() + 1; nHeight <= vBlocks.size(); ++nHeight) {
+            const CBlock& block = vBlocks[nHeight - 1];
+            for (unsigned int idx = 1; idx < block.vtx.size(); ++idx) {
+                CMPTransaction mp_obj;
+                if (0 == ParseTransaction(*block.vtx[idx], nHeight, idx, mp_obj, block.nTime)) ++nParsed;
+            }
+        }
+        assert(nParsed > 0);
+    }
+}
+
+BENCHMARK(OmniChainParse, 20);
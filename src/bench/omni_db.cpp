@@ -0,0 +1,90 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <bench/bench.h>
+#include <bench/omni_setup.h>
+#include <omnicore/dbtradelist.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/omnicore.h>
+#include <random.h>
+#include <uint256.h>
+
+#include <univalue.h>
+
+#include <assert.h>
+#include <stdint.h>
+
+using namespace mastercore;
+
+//! Number of transactions per block of the synthetic databases
+static const unsigned int DB_BENCH_BLOCK_TXS = 100;
+//! Number of property pairs, over which the synthetic trades are distributed
+static const uint32_t DB_BENCH_PAIRS = 4;
+//! Number of trades retrieved per pair
+static const uint64_t DB_BENCH_TRADES = 100;
+
+//! Creates a unique transaction hash for the n-th record
+static uint256 RecordTxid(unsigned int n)
+{
+    return ArithToUint256(arith_uint256(n + 1));
+}
+
+static uint32_t PairProperty(uint32_t pair)
+{
+    return OMNI_PROPERTY_MSC + 2 + pair;
+}
+
+// Looks up random transactions of a transaction database with the given number of records
+static void TxListLookup(benchmark::State& state, unsigned int nRecords)
+{
+    OmniBenchDatabases databases;
+
+    pDbTransactionList->BeginBatch();
+    for (unsigned int n = 0; n < nRecords; ++n) {
+        pDbTransactionList->recordTX(RecordTxid(n), true, n / DB_BENCH_BLOCK_TXS, 0, 0, n % DB_BENCH_BLOCK_TXS);
+    }
+    assert(pDbTransactionList->CommitBatch().ok());
+
+    FastRandomContext rng(true);
+    while (state.KeepRunning()) {
+        const uint256 txid = RecordTxid(rng.randrange(nRecords));
+        int block;
+        assert(pDbTransactionList->exists(txid));
+        assert(pDbTransactionList->getValidMPTX(txid, &block));
+        // a transaction, which isn't in the database
+        assert(!pDbTransactionList->exists(RecordTxid(nRecords + rng.randrange(nRecords))));
+    }
+}
+
+// Retrieves the latest trades of a pair from a trade database with the given number of trades
+static void TradesForPair(benchmark::State& state, unsigned int nTrades)
+{
+    OmniBenchDatabases databases;
+
+    pDbTradeList->BeginBatch();
+    for (unsigned int n = 0; n < nTrades; ++n) {
+        const uint32_t pair = n % DB_BENCH_PAIRS;
+        pDbTradeList->recordMatchedTrade(RecordTxid(2 * n), RecordTxid(2 * n + 1), "maker", "taker",
+                PairProperty(pair), OMNI_PROPERTY_MSC, 1000, 100, n / DB_BENCH_BLOCK_TXS, 0);
+    }
+    assert(pDbTradeList->CommitBatch().ok());
+
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        UniValue response(UniValue::VARR);
+        pDbTradeList->getTradesForPair(PairProperty(n++ % DB_BENCH_PAIRS), OMNI_PROPERTY_MSC, response, DB_BENCH_TRADES);
+        assert(response.size() == DB_BENCH_TRADES);
+    }
+}
+
+static void OmniTxListLookup10k(benchmark::State& state) { TxListLookup(state, 10000); }
+static void OmniTxListLookup100k(benchmark::State& state) { TxListLookup(state, 100000); }
+static void OmniTradesForPair10k(benchmark::State& state) { TradesForPair(state, 10000); }
+static void OmniTradesForPair100k(benchmark::State& state) { TradesForPair(state, 100000); }
+
+BENCHMARK(OmniTxListLookup10k, 10000);
+BENCHMARK(OmniTxListLookup100k, 10000);
+BENCHMARK(OmniTradesForPair10k, 100);
+BENCHMARK(OmniTradesForPair100k, 100);
@@ -0,0 +1,274 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <bench/bench.h>
+#include <bench/omni_setup.h>
+#include <omnicore/consensushash.h>
+#include <omnicore/dbtradelist.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/tally.h>
+#include <random.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <uint256.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace mastercore;
+
+//! Number of orders, of which the prices are compared
+static const size_t MDEX_BENCH_ORDERS = 1000;
+
+static void CreateOrders(std::vector<CMPMetaDEx>& vOrders)
+{
+    FastRandomContext rng(true);
+    vOrders.clear();
+    vOrders.reserve(MDEX_BENCH_ORDERS);
+    for (size_t i = 0; i < MDEX_BENCH_ORDERS; ++i) {
+        int64_t amountForSale = 1 + rng.randrange(100000000000LL);
+        int64_t amountDesired = 1 + rng.randrange(100000000000LL);
+        vOrders.emplace_back("", 1, 3, amountForSale, 1, amountDesired, uint256(), i, 1);
+    }
+}
+
+// Compares the inverse price of every order with the unit price of every other order, as the matching did before
+static void OmniMetaDExPriceRational(benchmark::State& state)
+{
+    std::vector<CMPMetaDEx> vOrders;
+    CreateOrders(vOrders);
+
+    while (state.KeepRunning()) {
+        size_t nMatches = 0;
+        for (const CMPMetaDEx& buyer : vOrders) {
+            for (const CMPMetaDEx& seller : vOrders) {
+                if (!(buyer.inversePrice() < seller.unitPrice())) ++nMatches;
+            }
+        }
+        assert(nMatches > 0);
+    }
+}
+
+// Compares the same prices by cross-multiplication, as done by the matching
+static void OmniMetaDExPriceCrossMultiplied(benchmark::State& state)
+{
+    std::vector<CMPMetaDEx> vOrders;
+    CreateOrders(vOrders);
+
+    while (state.KeepRunning()) {
+        size_t nMatches = 0;
+        for (const CMPMetaDEx& buyer : vOrders) {
+            for (const CMPMetaDEx& seller : vOrders) {
+                if (!xIsLess(buyer.getAmountForSale(), buyer.getAmountDesired(), seller.getAmountDesired(), seller.getAmountForSale())) ++nMatches;
+            }
+        }
+        assert(nMatches > 0);
+    }
+}
+
+//! Number of property pairs of the synthetic order books, each pair is traded against OMNI
+static const uint32_t MDEX_BENCH_PAIRS = 4;
+//! Number of addresses, which own the orders of the synthetic order books
+static const uint32_t MDEX_BENCH_MAKERS = 100;
+//! Number of orders per price level of a property pair
+static const uint32_t MDEX_BENCH_LEVEL_ORDERS = 10;
+//! Amount of OMNI desired by every order of the book
+static const int64_t MDEX_BENCH_DESIRED = 1000000;
+//! Amount for sale of orders at the best price level, every further level offers a bit less
+static const int64_t MDEX_BENCH_FOR_SALE = 100000000;
+//! Block of all orders, which is before any fee activation
+static const int MDEX_BENCH_BLOCK = 1;
+
+//! Creates a unique transaction hash for the n-th order
+static uint256 OrderTxid(unsigned int n)
+{
+    return ArithToUint256(arith_uint256(n + 1));
+}
+
+static std::string MakerAddress(uint32_t maker)
+{
+    return strprintf("maker%d", maker);
+}
+
+static uint32_t PairProperty(uint32_t pair)
+{
+    return OMNI_PROPERTY_MSC + 2 + pair;
+}
+
+static int64_t LevelAmountForSale(uint32_t level)
+{
+    return MDEX_BENCH_FOR_SALE - level * 100;
+}
+
+/**
+ * A synthetic MetaDEx state with a number of asks across several property pairs.
+ *
+ * Each pair sells a token for OMNI, so no trading fees are involved, and the unit price rises with
+ * every price level. The orders are distributed round robin over the pairs and makers, and the
+ * temporary transaction and trade databases of the book record the trades and cancellations.
+ */
+class MetaDExBenchBook
+{
+public:
+    explicit MetaDExBenchBook(unsigned int nOrders) : m_nextIdx(0)
+    {
+        LOCK(cs_tally);
+        MetaDEx_CLEAR();
+        mp_tally_map.clear();
+        for (unsigned int n = 0; n < nOrders; ++n) {
+            const uint32_t pair = n % MDEX_BENCH_PAIRS;
+            const uint32_t level = (n / MDEX_BENCH_PAIRS) / MDEX_BENCH_LEVEL_ORDERS;
+            AddAsk(MakerAddress(n % MDEX_BENCH_MAKERS), pair, level);
+        }
+        assert(m_nextIdx == nOrders);
+    }
+
+    ~MetaDExBenchBook()
+    {
+        LOCK(cs_tally);
+        MetaDEx_CLEAR();
+        mp_tally_map.clear();
+    }
+
+    //! Adds an ask at the given price level of a pair, after funding the maker
+    void AddAsk(const std::string& address, uint32_t pair, uint32_t level)
+    {
+        const int64_t amountForSale = LevelAmountForSale(level);
+        assert(update_tally_map(address, PairProperty(pair), amountForSale, BALANCE));
+        assert(0 == MetaDEx_ADD(address, PairProperty(pair), amountForSale, MDEX_BENCH_BLOCK, OMNI_PROPERTY_MSC,
+                MDEX_BENCH_DESIRED, OrderTxid(m_nextIdx), m_nextIdx));
+        ++m_nextIdx;
+    }
+
+    //! Adds a bid for the token of a pair, after funding the taker
+    void AddBid(const std::string& address, uint32_t pair, int64_t amountForSale, int64_t amountDesired)
+    {
+        assert(update_tally_map(address, OMNI_PROPERTY_MSC, amountForSale, BALANCE));
+        assert(0 == MetaDEx_ADD(address, OMNI_PROPERTY_MSC, amountForSale, MDEX_BENCH_BLOCK, PairProperty(pair),
+                amountDesired, OrderTxid(m_nextIdx), m_nextIdx));
+        ++m_nextIdx;
+    }
+
+    //! Returns a hash for the next cancel transaction
+    uint256 NextTxid()
+    {
+        return OrderTxid(m_nextIdx++);
+    }
+
+private:
+    OmniBenchDatabases m_databases;
+    unsigned int m_nextIdx;
+};
+
+// Adds bids below the best ask, which are checked against the book and then inserted
+static void AddWithoutFill(benchmark::State& state, unsigned int nOrders)
+{
+    MetaDExBenchBook book(nOrders);
+
+    LOCK(cs_tally);
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        book.AddBid("taker", n++ % MDEX_BENCH_PAIRS, MDEX_BENCH_DESIRED, 2 * MDEX_BENCH_FOR_SALE);
+    }
+}
+
+// Adds bids, which fill the best asks of a pair, and re-adds the filled asks, so the book keeps its shape
+static void AddWithFill(benchmark::State& state, unsigned int nOrders, uint32_t nDepth)
+{
+    MetaDExBenchBook book(nOrders);
+
+    LOCK(cs_tally);
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        const uint32_t pair = n++ % MDEX_BENCH_PAIRS;
+        // the asks all desire the same amount, and the bid accepts any price
+        book.AddBid("taker", pair, nDepth * MDEX_BENCH_DESIRED, 1);
+        for (uint32_t i = 0; i < nDepth; ++i) {
+            book.AddAsk(MakerAddress(i % MDEX_BENCH_MAKERS), pair, i / MDEX_BENCH_LEVEL_ORDERS);
+        }
+    }
+}
+
+// Cancels the asks of a maker at one price level, and re-adds them afterwards
+static void CancelAtPrice(benchmark::State& state, unsigned int nOrders)
+{
+    MetaDExBenchBook book(nOrders);
+
+    LOCK(cs_tally);
+    // the first order of the book, and all orders of the same maker at this price
+    const std::string address = MakerAddress(0);
+    const uint32_t property = PairProperty(0);
+    const int64_t amountForSale = LevelAmountForSale(0);
+    while (state.KeepRunning()) {
+        assert(0 == MetaDEx_CANCEL_AT_PRICE(book.NextTxid(), MDEX_BENCH_BLOCK, address, property, amountForSale,
+                OMNI_PROPERTY_MSC, MDEX_BENCH_DESIRED));
+        book.AddAsk(address, 0, 0);
+    }
+}
+
+// Cancels all orders of a maker, and re-adds them afterwards
+static void CancelEverything(benchmark::State& state, unsigned int nOrders)
+{
+    MetaDExBenchBook book(nOrders);
+
+    LOCK(cs_tally);
+    const std::string address = MakerAddress(0);
+    while (state.KeepRunning()) {
+        assert(0 == MetaDEx_CANCEL_EVERYTHING(book.NextTxid(), MDEX_BENCH_BLOCK, address, OMNI_PROPERTY_MSC));
+        for (unsigned int n = 0; n < nOrders; n += MDEX_BENCH_MAKERS) {
+            const uint32_t pair = n % MDEX_BENCH_PAIRS;
+            const uint32_t level = (n / MDEX_BENCH_PAIRS) / MDEX_BENCH_LEVEL_ORDERS;
+            book.AddAsk(address, pair, level);
+        }
+    }
+}
+
+// Hashes the whole MetaDEx state, as done for consensus checks
+static void MetaDExHash(benchmark::State& state, unsigned int nOrders)
+{
+    MetaDExBenchBook book(nOrders);
+
+    while (state.KeepRunning()) {
+        GetMetaDExHash();
+    }
+}
+
+static void OmniMetaDExAdd1k(benchmark::State& state) { AddWithoutFill(state, 1000); }
+static void OmniMetaDExAdd100k(benchmark::State& state) { AddWithoutFill(state, 100000); }
+static void OmniMetaDExAdd1M(benchmark::State& state) { AddWithoutFill(state, 1000000); }
+static void OmniMetaDExAddFill1(benchmark::State& state) { AddWithFill(state, 100000, 1); }
+static void OmniMetaDExAddFill10(benchmark::State& state) { AddWithFill(state, 100000, 10); }
+static void OmniMetaDExAddFill100(benchmark::State& state) { AddWithFill(state, 100000, 100); }
+static void OmniMetaDExCancelAtPrice1k(benchmark::State& state) { CancelAtPrice(state, 1000); }
+static void OmniMetaDExCancelAtPrice100k(benchmark::State& state) { CancelAtPrice(state, 100000); }
+static void OmniMetaDExCancelAtPrice1M(benchmark::State& state) { CancelAtPrice(state, 1000000); }
+static void OmniMetaDExCancelEverything1k(benchmark::State& state) { CancelEverything(state, 1000); }
+static void OmniMetaDExCancelEverything100k(benchmark::State& state) { CancelEverything(state, 100000); }
+static void OmniMetaDExCancelEverything1M(benchmark::State& state) { CancelEverything(state, 1000000); }
+static void OmniMetaDExHash1k(benchmark::State& state) { MetaDExHash(state, 1000); }
+static void OmniMetaDExHash100k(benchmark::State& state) { MetaDExHash(state, 100000); }
+static void OmniMetaDExHash1M(benchmark::State& state) { MetaDExHash(state, 1000000); }
+
+BENCHMARK(OmniMetaDExPriceRational, 1);
+BENCHMARK(OmniMetaDExPriceCrossMultiplied, 1);
+BENCHMARK(OmniMetaDExAdd1k, 2000);
+BENCHMARK(OmniMetaDExAdd100k, 2000);
+BENCHMARK(OmniMetaDExAdd1M, 2000);
+BENCHMARK(OmniMetaDExAddFill1, 1000);
+BENCHMARK(OmniMetaDExAddFill10, 200);
+BENCHMARK(OmniMetaDExAddFill100, 20);
+BENCHMARK(OmniMetaDExCancelAtPrice1k, 1000);
+BENCHMARK(OmniMetaDExCancelAtPrice100k, 100);
+BENCHMARK(OmniMetaDExCancelAtPrice1M, 10);
+BENCHMARK(OmniMetaDExCancelEverything1k, 100);
+BENCHMARK(OmniMetaDExCancelEverything100k, 2);
+BENCHMARK(OmniMetaDExCancelEverything1M, 1);
+BENCHMARK(OmniMetaDExHash1k, 100);
+BENCHMARK(OmniMetaDExHash100k, 2);
+BENCHMARK(OmniMetaDExHash1M, 1);
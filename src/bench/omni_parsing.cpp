@@ -0,0 +1,85 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <key.h>
+#include <key_io.h>
+#include <omnicore/createpayload.h>
+#include <omnicore/encoding.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/parsing.h>
+#include <omnicore/tx.h>
+#include <primitives/transaction.h>
+#include <script/standard.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace mastercore;
+
+//! Block of the parsed transactions
+static const int PARSING_BENCH_BLOCK = 1;
+//! Value of the input of the parsed transactions
+static const CAmount PARSING_BENCH_INPUT = 100000000;
+
+/**
+ * Creates a simple send from a new address, whose input is added to the coins view of the
+ * parser, and the payload is embedded with the given class.
+ */
+static CTransaction CreateSimpleSend(bool fClassB)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript scriptSender = GetScriptForDestination(PKHash(key.GetPubKey()));
+    const std::string sender = EncodeDestination(PKHash(key.GetPubKey()));
+
+    CMutableTransaction prevTx;
+    prevTx.vout.emplace_back(PARSING_BENCH_INPUT, scriptSender);
+    const COutPoint prevout(CTransaction(prevTx).GetHash(), 0);
+
+    Coin coin;
+    coin.out = prevTx.vout[0];
+    view.AddCoin(prevout, std::move(coin), true);
+
+    std::vector<std::pair<CScript, int64_t> > vecOutputs;
+    const std::vector<unsigned char> vchPayload = CreatePayload_SimpleSend(OMNI_PROPERTY_MSC, 100000000);
+    if (fClassB) {
+        assert(OmniCore_Encode_ClassB(sender, key.GetPubKey(), vchPayload, vecOutputs));
+    } else {
+        assert(OmniCore_Encode_ClassC(vchPayload, vecOutputs));
+    }
+
+    CMutableTransaction mutableTx;
+    mutableTx.vin.emplace_back(prevout);
+    for (const std::pair<CScript, int64_t>& output : vecOutputs) {
+        mutableTx.vout.emplace_back(output.second, output.first);
+    }
+    // the reference output
+    CKey keyReference;
+    keyReference.MakeNewKey(true);
+    mutableTx.vout.emplace_back(10000, GetScriptForDestination(PKHash(keyReference.GetPubKey())));
+
+    return CTransaction(mutableTx);
+}
+
+// Parses a simple send, which is embedded as Class B or Class C transaction
+static void ParseSimpleSend(benchmark::State& state, bool fClassB)
+{
+    const CTransaction tx = CreateSimpleSend(fClassB);
+
+    while (state.KeepRunning()) {
+        CMPTransaction mp_obj;
+        assert(0 == ParseTransaction(tx, PARSING_BENCH_BLOCK, 1, mp_obj));
+    }
+}
+
+static void OmniParseClassB(benchmark::State& state) { ParseSimpleSend(state, true); }
+static void OmniParseClassC(benchmark::State& state) { ParseSimpleSend(state, false); }
+
+BENCHMARK(OmniParseClassB, 5000);
+BENCHMARK(OmniParseClassC, 5000);
@@ -0,0 +1,48 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_OMNI_SETUP_H
+#define BITCOIN_BENCH_OMNI_SETUP_H
+
+#include <omnicore/dbtradelist.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/sp.h>
+#include <util/system.h>
+
+/**
+ * Opens empty property, transaction and trade databases in the data directory of the
+ * benchmark's testing setup, like the fixtures of the unit tests, and installs them as
+ * the global databases, until the fixture goes out of scope.
+ */
+struct OmniBenchDatabases
+{
+    CMPSPInfo spinfo;
+    CMPTxList txlist;
+    CMPTradeList tradelist;
+    CMPSPInfo* pPrevSpInfo;
+    CMPTxList* pPrevTxList;
+    CMPTradeList* pPrevTradeList;
+
+    OmniBenchDatabases()
+      : spinfo(GetDataDir() / "MP_spinfo_bench", true),
+        txlist(GetDataDir() / "MP_txlist_bench", true),
+        tradelist(GetDataDir() / "MP_tradelist_bench", true),
+        pPrevSpInfo(mastercore::pDbSpInfo),
+        pPrevTxList(mastercore::pDbTransactionList),
+        pPrevTradeList(mastercore::pDbTradeList)
+    {
+        mastercore::pDbSpInfo = &spinfo;
+        mastercore::pDbTransactionList = &txlist;
+        mastercore::pDbTradeList = &tradelist;
+    }
+
+    ~OmniBenchDatabases()
+    {
+        mastercore::pDbSpInfo = pPrevSpInfo;
+        mastercore::pDbTransactionList = pPrevTxList;
+        mastercore::pDbTradeList = pPrevTradeList;
+    }
+};
+
+#endif // BITCOIN_BENCH_OMNI_SETUP_H
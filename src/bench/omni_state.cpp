@@ -0,0 +1,148 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <bench/bench.h>
+#include <chain.h>
+#include <omnicore/consensushash.h>
+#include <omnicore/log.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/persistence.h>
+#include <omnicore/sto.h>
+#include <omnicore/tally.h>
+#include <random.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string>
+
+using namespace mastercore;
+
+extern fs::path pathStateFiles;
+
+//! Number of properties, which are held by every address of the synthetic state
+static const uint32_t STATE_BENCH_PROPERTIES = 3;
+//! Height of the block, whose state is persisted
+static const int STATE_BENCH_HEIGHT = 100;
+
+static std::string HolderAddress(uint32_t holder)
+{
+    return strprintf("holder%d", holder);
+}
+
+static uint32_t HolderProperty(uint32_t n)
+{
+    return OMNI_PROPERTY_TMSC + 1 + n;
+}
+
+/**
+ * A synthetic tally map with a number of addresses, which each hold a random balance of a few
+ * properties. The tally map is cleared again, when the fixture goes out of scope.
+ */
+class TallyBenchState
+{
+public:
+    explicit TallyBenchState(uint32_t nAddresses)
+    {
+        FastRandomContext rng(true);
+
+        LOCK(cs_tally);
+        mp_tally_map.clear();
+        for (uint32_t n = 0; n < nAddresses; ++n) {
+            const std::string address = HolderAddress(n);
+            for (uint32_t i = 0; i < STATE_BENCH_PROPERTIES; ++i) {
+                assert(update_tally_map(address, HolderProperty(i), 1 + rng.randrange(100000000000LL), BALANCE));
+            }
+        }
+    }
+
+    ~TallyBenchState()
+    {
+        LOCK(cs_tally);
+        mp_tally_map.clear();
+    }
+};
+
+// Credits and debits random addresses of the state, as done for every transfer
+static void UpdateTally(benchmark::State& state, uint32_t nAddresses)
+{
+    TallyBenchState tally(nAddresses);
+    FastRandomContext rng(true);
+
+    LOCK(cs_tally);
+    while (state.KeepRunning()) {
+        const std::string address = HolderAddress(rng.randrange(nAddresses));
+        const uint32_t property = HolderProperty(rng.randrange(STATE_BENCH_PROPERTIES));
+        assert(update_tally_map(address, property, 1, BALANCE));
+        assert(update_tally_map(address, property, -1, BALANCE));
+    }
+}
+
+// Determines the receivers of a send to owners of a property, which every address of the state holds
+static void GetSTOReceivers(benchmark::State& state, uint32_t nAddresses)
+{
+    TallyBenchState tally(nAddresses);
+
+    // the receivers are otherwise logged one by one
+    const bool fDebugSto = msc_debug_sto;
+    msc_debug_sto = false;
+
+    const int64_t amount = 1000000000LL * nAddresses;
+    while (state.KeepRunning()) {
+        OwnerAddrType receivers = STO_GetReceivers(HolderAddress(0), HolderProperty(0), amount);
+        assert(!receivers.empty());
+    }
+
+    msc_debug_sto = fDebugSto;
+}
+
+// Hashes the whole state, as done for consensus checks
+static void ConsensusHash(benchmark::State& state, uint32_t nAddresses)
+{
+    TallyBenchState tally(nAddresses);
+
+    while (state.KeepRunning()) {
+        GetConsensusHash();
+    }
+}
+
+// Stores the state of a block, and loads the balances of it again
+static void PersistRestore(benchmark::State& state, uint32_t nAddresses)
+{
+    TallyBenchState tally(nAddresses);
+
+    const uint256 blockHash = ArithToUint256(arith_uint256(nAddresses));
+    CBlockIndex index;
+    index.phashBlock = &blockHash;
+    index.nHeight = STATE_BENCH_HEIGHT;
+    const std::string strBalances = (pathStateFiles / strprintf("balances-%s.dat", blockHash.ToString())).string();
+
+    LOCK(cs_tally);
+    while (state.KeepRunning()) {
+        assert(0 == PersistInMemoryState(&index));
+        assert(0 == RestoreInMemoryState(strBalances, 0, true));
+    }
+}
+
+static void OmniUpdateTally10k(benchmark::State& state) { UpdateTally(state, 10000); }
+static void OmniUpdateTally1M(benchmark::State& state) { UpdateTally(state, 1000000); }
+static void OmniSTOReceivers10k(benchmark::State& state) { GetSTOReceivers(state, 10000); }
+static void OmniSTOReceivers100k(benchmark::State& state) { GetSTOReceivers(state, 100000); }
+static void OmniConsensusHash10k(benchmark::State& state) { ConsensusHash(state, 10000); }
+static void OmniConsensusHash1M(benchmark::State& state) { ConsensusHash(state, 1000000); }
+static void OmniPersistRestore10k(benchmark::State& state) { PersistRestore(state, 10000); }
+static void OmniPersistRestore1M(benchmark::State& state) { PersistRestore(state, 1000000); }
+
+BENCHMARK(OmniUpdateTally10k, 100000);
+BENCHMARK(OmniUpdateTally1M, 100000);
+BENCHMARK(OmniSTOReceivers10k, 10);
+BENCHMARK(OmniSTOReceivers100k, 1);
+BENCHMARK(OmniConsensusHash10k, 10);
+BENCHMARK(OmniConsensusHash1M, 1);
+BENCHMARK(OmniPersistRestore10k, 10);
+BENCHMARK(OmniPersistRestore1M, 1);
@@ -0,0 +1,56 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <omnicore/sto.h>
+#include <omnicore/workerpool.h>
+#include <random.h>
+
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+#include <vector>
+
+//! Number of holders of the distributed property
+static const size_t STO_BENCH_HOLDERS = 1000000;
+
+static void CreateHoldings(std::vector<int64_t>& vOwned, int64_t& totalTokens)
+{
+    FastRandomContext rng(true);
+    vOwned.resize(STO_BENCH_HOLDERS);
+    totalTokens = 0;
+    for (int64_t& owned : vOwned) {
+        owned = 1 + rng.randrange(100000000000LL);
+        totalTokens += owned;
+    }
+    std::sort(vOwned.begin(), vOwned.end(), std::greater<int64_t>());
+}
+
+static void DistributeToOwners(benchmark::State& state, mastercore::CWorkerPool* pPool)
+{
+    std::vector<int64_t> vOwned;
+    std::vector<int64_t> vReceive;
+    int64_t totalTokens;
+    CreateHoldings(vOwned, totalTokens);
+
+    // large enough for almost every holder to receive a share
+    const int64_t amount = totalTokens / 2;
+    while (state.KeepRunning()) {
+        mastercore::STO_CalculateDistribution(vOwned, amount, totalTokens, vReceive, pPool);
+    }
+}
+
+static void OmniSTODistribution(benchmark::State& state)
+{
+    DistributeToOwners(state, nullptr);
+}
+
+static void OmniSTODistributionParallel(benchmark::State& state)
+{
+    mastercore::CWorkerPool pool(3, "omnibench");
+    DistributeToOwners(state, &pool);
+}
+
+BENCHMARK(OmniSTODistribution, 5);
+BENCHMARK(OmniSTODistributionParallel, 5);
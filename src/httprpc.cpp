@@ -15,6 +15,7 @@
 #include <util/translation.h>
 #include <walletinitinterface.h>
 
+#include <omnicore/rpcjsonstream.h>
 #include <omnicore/rpcmbstring.h> // SanitizeInvalidUTF8
 
 #include <algorithm>
@@ -186,6 +187,18 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         return false;
     }
 
+    // the reply of a single call is sent in parts, once it exceeds the flush size of the writer
+    bool fReplyStarted = false;
+    auto sendPart = [&](const std::string& part) {
+        if (!fReplyStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReplyStart(HTTP_OK);
+            fReplyStarted = true;
+        }
+        req->WriteReplyChunk(fSanitizeResponse ? mastercore::SanitizeInvalidUTF8(part) : part);
+    };
+    CJSONStreamWriter writer(sendPart);
+
     try {
         // Parse request
         UniValue valRequest;
@@ -210,10 +223,26 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
                 req->WriteReply(HTTP_FORBIDDEN);
                 return false;
             }
+            writer.BeginObject();
+            writer.Key("result");
+            jreq.resultWriter = &writer;
             UniValue result = tableRPC.execute(jreq);
 
             // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            if (!writer.IsResultWritten()) {
+                writer.Value(result);
+            }
+            writer.Key("error");
+            writer.Value(NullUniValue);
+            writer.Key("id");
+            writer.Value(jreq.id);
+            writer.EndObject();
+            strReply = writer.TakeBuffer() + "\n";
+            if (fReplyStarted) {
+                sendPart(strReply);
+                req->WriteReplyEnd();
+                return true;
+            }
             if (fSanitizeResponse) {
                 strReply = mastercore::SanitizeInvalidUTF8(strReply);
             }
@@ -236,7 +265,7 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
                     }
                 }
             }
-            strReply = JSONRPCExecBatch(jreq, valRequest.get_array());
+            strReply = JSONRPCExecBatch(jreq, valRequest.get_array(), EnqueueHTTPTaskIfIdle);
         }
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
@@ -244,9 +273,19 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
+        if (fReplyStarted) {
+            LogPrintf("RPC call %s failed after a part of its reply was sent: %s\n", jreq.strMethod, find_value(objError, "message").getValStr());
+            req->WriteReplyEnd();
+            return false;
+        }
         JSONErrorReply(req, objError, jreq.id);
         return false;
     } catch (const std::exception& e) {
+        if (fReplyStarted) {
+            LogPrintf("RPC call %s failed after a part of its reply was sent: %s\n", jreq.strMethod, e.what());
+            req->WriteReplyEnd();
+            return false;
+        }
         JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
@@ -45,6 +45,12 @@ void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPR
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Queue a task to be run by a worker thread, which is waiting for work.
+ * Returns false if all worker threads are busy, so other requests are never
+ * delayed by the task.
+ */
+bool EnqueueHTTPTaskIfIdle(const std::function<void()>& task);
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -58,6 +64,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
 
 public:
     explicit HTTPRequest(struct evhttp_request* req, bool replySent = false);
@@ -113,6 +120,26 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, of which the body is sent with WriteReplyChunk.
+     *
+     * @note call this instead of WriteReply, and finish the reply with WriteReplyEnd.
+     */
+    void WriteReplyStart(int nStatus);
+
+    /**
+     * Send a part of the body of a chunked HTTP reply.
+     */
+    void WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a chunked HTTP reply.
+     *
+     * @note As this will give the request back to the main thread, do not call
+     * any other HTTPRequest methods after calling this.
+     */
+    void WriteReplyEnd();
 };
 
 /** Event handler closure.
@@ -9,6 +9,32 @@
 #include <index/base.h>
 #include <txdb.h>
 
+/** The position of a transaction on disk: the position of its block, and the offset after the block header. */
+struct CDiskTxPos : public FlatFilePos
+{
+    unsigned int nTxOffset; // after header
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITEAS(FlatFilePos, *this);
+        READWRITE(VARINT(nTxOffset));
+    }
+
+    CDiskTxPos(const FlatFilePos &blockIn, unsigned int nTxOffsetIn) : FlatFilePos(blockIn.nFile, blockIn.nPos), nTxOffset(nTxOffsetIn) {
+    }
+
+    CDiskTxPos() {
+        SetNull();
+    }
+
+    void SetNull() {
+        FlatFilePos::SetNull();
+        nTxOffset = 0;
+    }
+};
+
 /**
  * TxIndex is used to look up transactions included in the blockchain by hash.
  * The index is written to a LevelDB database and records the filesystem
@@ -48,6 +74,13 @@ public:
     bool FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const;
 
     int ReadTxPos(const uint256& txid) const;
+
+    /// Look up the position of a transaction on disk, without reading it.
+    ///
+    /// @param[in]   tx_hash  The hash of the transaction.
+    /// @param[out]  pos  The position of the block, and the offset of the transaction after the block header.
+    /// @return  true if transaction is found, false otherwise
+    bool FindTxPos(const uint256& tx_hash, CDiskTxPos& pos) const;
 };
 
 /// The global transaction index, used in GetTransaction. May be null.
@@ -63,6 +63,12 @@
 #include <stdio.h>
 #include <set>
 
+#include <omnicore/dbbase.h>
+#include <omnicore/dbtransaction.h>
+#include <omnicore/indexproperties.h>
+#include <omnicore/metrics.h>
+#include <omnicore/nftdb.h>
+#include <omnicore/replay.h>
 #include <omnicore/version.h>
 
 #ifndef WIN32
@@ -194,6 +200,7 @@ void Shutdown(NodeContext& node)
 
     StopHTTPRPC();
     StopREST();
+    mastercore::StopMetrics();
     StopRPC();
     StopHTTPServer();
     for (const auto& client : node.chain_clients) {
@@ -490,19 +497,43 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubhashtx=<address>", "Enable publish hash transaction in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblock=<address>", "Enable publish raw block in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtx=<address>", "Enable publish raw transaction in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomnitrade=<address>", "Enable publish Omni Layer MetaDEx trades in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomniorder=<address>", "Enable publish Omni Layer MetaDEx order changes in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomnibalance=<address>", "Enable publish Omni Layer balance changes per block in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomnibalancefilter=<address>", "Only publish Omni Layer balance changes of the given address, may be used more than once (default: all addresses)", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomnitx=<address>", "Enable publish confirmed Omni Layer transactions with their decoded fields in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomniblock=<address>", "Enable publish Omni Layer processed and disconnected blocks in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomniqueue=<n>", strprintf("Set the maximal number of Omni Layer notifications waiting to be published, further ones are dropped (default: %u)", DEFAULT_ZMQ_OMNI_QUEUE), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashblockhwm=<n>", strprintf("Set publish hash block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtxhwm=<n>", strprintf("Set publish hash transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomnitradehwm=<n>", strprintf("Set publish Omni Layer MetaDEx trade outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomniorderhwm=<n>", strprintf("Set publish Omni Layer MetaDEx order outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomnibalancehwm=<n>", strprintf("Set publish Omni Layer balance outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomnitxhwm=<n>", strprintf("Set publish Omni Layer transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubomniblockhwm=<n>", strprintf("Set publish Omni Layer block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
 #else
     hidden_args.emplace_back("-zmqpubhashblock=<address>");
     hidden_args.emplace_back("-zmqpubhashtx=<address>");
     hidden_args.emplace_back("-zmqpubrawblock=<address>");
     hidden_args.emplace_back("-zmqpubrawtx=<address>");
+    hidden_args.emplace_back("-zmqpubomnitrade=<address>");
+    hidden_args.emplace_back("-zmqpubomniorder=<address>");
+    hidden_args.emplace_back("-zmqpubomnibalance=<address>");
+    hidden_args.emplace_back("-zmqpubomnibalancefilter=<address>");
+    hidden_args.emplace_back("-zmqpubomnitx=<address>");
+    hidden_args.emplace_back("-zmqpubomniblock=<address>");
+    hidden_args.emplace_back("-zmqpubomniqueue=<n>");
     hidden_args.emplace_back("-zmqpubhashblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubhashtxhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawtxhwm=<n>");
+    hidden_args.emplace_back("-zmqpubomnitradehwm=<n>");
+    hidden_args.emplace_back("-zmqpubomniorderhwm=<n>");
+    hidden_args.emplace_back("-zmqpubomnibalancehwm=<n>");
+    hidden_args.emplace_back("-zmqpubomnitxhwm=<n>");
+    hidden_args.emplace_back("-zmqpubomniblockhwm=<n>");
 #endif
 
     gArgs.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -583,9 +614,48 @@ void SetupServerArgs()
     // TODO: append help messages somewhere else
     // TODO: translation
     gArgs.AddArg("-startclean", "Clear all persistence files on startup; triggers reparsing of Omni transactions (default: 0)", false, OptionsCategory::OMNI);
-    gArgs.AddArg("-omnitxcache", "The maximum number of transactions in the input transaction cache (default: 500000)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnitxcache", "The maximum number of outputs in the input cache, least recently used outputs are evicted first (default: 500000)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnitxcachemb", "The maximum memory of the input cache in MiB, 0 for no memory limit (default: 100)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnirpctxcache", "The maximum number of transaction objects cached for the RPC calls, least recently used objects are evicted first (default: 2000)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omniprogressfrequency", "Time in seconds after which the initial scanning progress is reported (default: 30)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniprevoutindex", "Maintain an index of outputs spent by Omni transactions to speed up reparsing (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnimarkerindex", "Maintain an index of blocks with Omni transactions to skip other blocks when reparsing (default: 1)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniaddressfilterindex", "Maintain compact filters over the addresses touched by Omni transactions per block, see omni_getaddressfilter (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnibalancehistory", "Store the balances changed in every block to answer balance queries at past heights, see omni_getbalance and omni_getallbalancesforid (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnibalancechangeindex", "Maintain an index of every balance change of every address, see omni_getbalancehistory (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniaddressindex", "Maintain an index of the Omni transactions of every address, see omni_listaddresstransactions (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniindexproperties=<list>", "Restrict the trade and send-to-owners history, the balance history, the balance change index and the address index to transactions touching the comma separated properties; changing it reprocesses the Omni transactions (default: all properties)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniprune", "Run without transaction index and allow block pruning; Omni transactions are restored from the records kept, when blocks are connected, and the Omni state can't be rebuilt from pruned blocks (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniprunehistory=<n>", "Prune the Omni transaction, trade, send-to-owners and fee distribution history older than <n> blocks, at least 200; records still needed by the Omni state are kept, 0 keeps the whole history (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnimempoolcheck", "Reject transactions with structurally invalid Omni payloads from the mempool (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniscanundo", "Resolve transaction inputs via block undo data during initial scan (default: 1)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omniseedblockfilter", "Set skipping of blocks without Omni transactions during initial scan (default: 1)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnithreads=<n>", "Number of threads shared by the parallel tasks of Omni Core, such as decoding transactions, hashing the consensus state and loading state files (0 = one per core, default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnidecodethreads=<n>", "Maximum number of the shared threads to decode transactions during initial scan and of connected blocks (0 = auto, default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniparallelsends", "Check runs of independent simple sends in parallel with the decoding threads during initial scan (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnimmapblocks", "Read blocks for the initial scan and RPC calls via memory mappings of the block files (default: 1)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniscanprefetch=<n>", "Number of blocks to read ahead during initial scan, 0 to disable (default: 16)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnibulkload=<n>", "Minimum number of blocks of the initial scan to load the Omni databases in bulk, 0 to disable (default: 10000)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniasync", "Process connected blocks in order on a dedicated Omni thread, so block processing doesn't delay the chain; the Omni state may trail the chain (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniblockdelay=<n>", "Delay the execution of the transactions of each block by <n> milliseconds, while the Omni state is locked (default: 0)", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnirpcsnapshot", "Serve balance and order book queries from a snapshot of the state after the last block, without waiting for block processing (default: 1)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnimaxmemory=<n>", "Evict Omni caches, when the in-memory state and caches use more than <n> MiB, 0 for no limit (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnidbcache=<n>", "Size of the block cache shared by the Omni databases in MiB, 0 to disable (default: 16)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnidbbloombits=<n>", "Number of bits per key of the bloom filters of the Omni databases, 0 to disable (default: 10)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omninftcheckinterval=<n>", "Run the full sanity check of the non-fungible tokens in the background every <n> seconds, 0 to disable (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniunifieddb", "Keep the Omni state in one database, which writes the changes of each block atomically (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnidbcompression", "Compress the tables of the Omni databases with textual or repetitive values with Snappy, if LevelDB is built with it (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnistatecompression", "Compress the state files, which are written from now on (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnistatebaseinterval=<n>", "Store the full balances in the state files every <n> blocks and only the changed balances otherwise, 0 to always store the full balances (default: 100)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniloadsnapshot=<file>", "Bootstrap an empty Omni state from a snapshot created by omni_dumpsnapshot, and continue with the blocks after it", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnisnapshothash=<hash>", "The consensus hash, the state loaded by -omniloadsnapshot must match, if there is no checkpoint at the block of the snapshot", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnistatedeltaout=<dir>", "Publish the changes of the Omni state of every processed block to <dir>, so replicas can apply them", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnistatedeltain=<dir>", "Apply the changes of the Omni state published by a primary node to <dir> instead of processing blocks, and verify the resulting state commitment", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnistatedeltawait=<n>", "Number of milliseconds to wait for the changes of the newest block published by the primary, before it is processed instead (default: 5000)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniundoblocks=<n>", "Keep the changes of the last <n> blocks in memory, so that shorter reorganizations are undone without reloading the state, 0 to disable (default: 6)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnireplay=<from>:<to>", "Process the blocks <from> to <to> with copies of the Omni databases and the stored state of the block before, report the timings and the consensus hash, and shut down afterwards. No peers are connected, and the Omni data of the datadir is left untouched", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnimetrics", "Serve counters and gauges of Omni Core in the Prometheus text format at /metrics of the RPC server, which is accessible without authentication to the clients allowed by -rpcallowip (default: 0)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omnilockstats", "Record the acquisitions and waits of the Omni locks with the waiting call sites, see omni_getperfstats (default: 0)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omnilogfile", "The path of the log file (default: omnicore.log)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omnidebug=<category>", "Enable or disable log categories, can be \"all\" or \"none\"", false, OptionsCategory::OMNI);
     gArgs.AddArg("-autocommit", "Enable or disable broadcasting of transactions, when creating transactions (default: 1)", false, OptionsCategory::OMNI);
@@ -595,8 +665,9 @@ void SetupServerArgs()
     gArgs.AddArg("-omniactivationignoresender", "Ignore senders of activations", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omniactivationallowsender", "Whitelist senders of activations", false, OptionsCategory::OMNI);
     gArgs.AddArg("-disclaimer", "Explicitly show QT disclaimer on startup (default: 0)", false, OptionsCategory::OMNI);
-    gArgs.AddArg("-omniuiwalletscope", "Max. transactions to show in trade and transaction history (default: 65535)", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniuiwalletscope", "Max. transactions to show in transaction history (default: 65535)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omnishowblockconsensushash", "Calculate and log the consensus hash for the specified block", false, OptionsCategory::OMNI);
+    gArgs.AddArg("-omniconsensushashsections", "Hash the sections of the state concurrently, and log the section digests, when logging consensus hashes (default: 0)", false, OptionsCategory::OMNI);
     gArgs.AddArg("-omniuseragent", "Show Omni and Omni version in user agent string (default: 1)", false, OptionsCategory::OMNI);
 
 
@@ -807,6 +878,7 @@ static bool AppInitServers()
     if (!StartHTTPRPC())
         return false;
     if (gArgs.GetBoolArg("-rest", DEFAULT_REST_ENABLE)) StartREST();
+    if (gArgs.GetBoolArg("-omnimetrics", mastercore::DEFAULT_OMNI_METRICS)) mastercore::StartMetrics();
     StartHTTPServer();
     return true;
 }
@@ -825,6 +897,12 @@ void InitParameterInteraction()
             LogPrintf("%s: parameter interaction: -whitebind set -> setting -listen=1\n", __func__);
     }
 
+    if (gArgs.IsArgSet("-omnireplay")) {
+        // a replay only processes blocks, which are already stored, and must not extend the chain
+        if (gArgs.SoftSetBoolArg("-connect", false))
+            LogPrintf("%s: parameter interaction: -omnireplay set -> setting -connect=0\n", __func__);
+    }
+
     if (gArgs.IsArgSet("-connect")) {
         // when only connecting to trusted nodes, do not seed via DNS, or listen by default
         if (gArgs.SoftSetBoolArg("-dnsseed", false))
@@ -873,6 +951,14 @@ void InitParameterInteraction()
         if (gArgs.SoftSetBoolArg("-whitelistrelay", true))
             LogPrintf("%s: parameter interaction: -whitelistforcerelay=1 -> setting -whitelistrelay=1\n", __func__);
     }
+
+    // Omni Core restores its state from the recorded transactions, so blocks can be pruned
+    if (gArgs.GetBoolArg("-omniprune", mastercore::DEFAULT_OMNI_PRUNE)) {
+        if (gArgs.SoftSetBoolArg("-txindex", false))
+            LogPrintf("%s: parameter interaction: -omniprune=1 -> setting -txindex=0\n", __func__);
+        if (gArgs.SoftSetBoolArg("-omniprevoutindex", true))
+            LogPrintf("%s: parameter interaction: -omniprune=1 -> setting -omniprevoutindex=1\n", __func__);
+    }
 }
 
 /**
@@ -1009,6 +1095,8 @@ bool AppInitParameterInteraction()
 
     // if using block pruning, then disallow txindex
     if (gArgs.GetArg("-prune", 0)) {
+        if (!gArgs.GetBoolArg("-omniprune", mastercore::DEFAULT_OMNI_PRUNE))
+            return InitError(_("Prune mode requires -omniprune.").translated);
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex.").translated);
         if (!g_enabled_filter_types.empty()) {
@@ -1016,6 +1104,20 @@ bool AppInitParameterInteraction()
         }
     }
 
+    if (gArgs.IsArgSet("-omnireplay")) {
+        int nReplayFirst, nReplayLast;
+        if (!mastercore::ParseReplayRange(gArgs.GetArg("-omnireplay", ""), nReplayFirst, nReplayLast)) {
+            return InitError(strprintf("Invalid block range for -omnireplay: '%s'", gArgs.GetArg("-omnireplay", "")));
+        }
+    }
+
+    if (gArgs.IsArgSet("-omniindexproperties")) {
+        std::set<uint32_t> setIndexProperties;
+        if (!mastercore::ParseIndexProperties(gArgs.GetArg("-omniindexproperties", ""), setIndexProperties)) {
+            return InitError(strprintf("Invalid property identifiers for -omniindexproperties: '%s'", gArgs.GetArg("-omniindexproperties", "")));
+        }
+    }
+
     // -bind and -whitebind can't be set when not listening
     size_t nUserBind = gArgs.GetArgs("-bind").size() + gArgs.GetArgs("-whitebind").size();
     if (nUserBind != 0 && !gArgs.GetBoolArg("-listen", DEFAULT_LISTEN)) {
@@ -1771,7 +1873,7 @@ bool AppInitMain(NodeContext& node)
 
     // ********************************************************* Step 8.5: load omni core
 
-    if (!gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
+    if (!gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) && !gArgs.GetBoolArg("-omniprune", mastercore::DEFAULT_OMNI_PRUNE)) {
         // ask the user if they would like us to modify their config file for them
         std::string msg = _("Disabled transaction index detected.\n\n"
                             "Omni Core requires an enabled transaction index. To enable "
@@ -1810,6 +1912,15 @@ bool AppInitMain(NodeContext& node)
 
     mastercore_init();
 
+    // the full sanity check of the non-fungible tokens runs in the background, if enabled
+    const int64_t nNFTCheckInterval = gArgs.GetArg("-omninftcheckinterval", mastercore::DEFAULT_NFT_CHECK_INTERVAL);
+    if (nNFTCheckInterval > 0) {
+        node.scheduler->scheduleEvery(mastercore::FullNonFungibleTokenSanityCheck, std::chrono::seconds{nNFTCheckInterval});
+    }
+
+    // rolled back and pruned key ranges of the Omni databases are compacted in the background
+    node.scheduler->scheduleEvery(CDBBase::RunPendingCompactions, std::chrono::seconds{OMNI_DB_COMPACTION_INTERVAL});
+
     // ********************************************************* Step 9: load wallet
     for (const auto& client : node.chain_clients) {
         if (!client->load()) {
@@ -335,6 +335,10 @@ public:
     {
         return MakeHandler(::uiInterface.OmniStateInvalidated_connect(fn));
     }
+    std::unique_ptr<Handler> handleOmniMetaDExPairsChanged(OmniMetaDExPairsChangedFn fn) override
+    {
+        return MakeHandler(::uiInterface.OmniMetaDExPairsChanged_connect(fn));
+    }
     NodeContext* context() override { return &m_context; }
     NodeContext m_context;
 };
@@ -13,10 +13,12 @@
 
 #include <functional>
 #include <memory>
+#include <set>
 #include <stddef.h>
 #include <stdint.h>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 class BanMan;
@@ -265,11 +267,16 @@ public:
     using OmniPendingChangedFn = std::function<void(bool pending)>;
     virtual std::unique_ptr<Handler> handleOmniPendingChanged(OmniPendingChangedFn fn) = 0;
 
-    using OmniBalanceChangedFn = std::function<void()>;
+    //! Register handler for wallet balance changes, with the properties, whose wallet balances changed in a block.
+    using OmniBalanceChangedFn = std::function<void(const std::set<uint32_t>& property_ids)>;
     virtual std::unique_ptr<Handler> handleOmniBalanceChanged(OmniBalanceChangedFn fn) = 0;
 
     using OmniStateInvalidatedFn = std::function<void()>;
     virtual std::unique_ptr<Handler> handleOmniStateInvalidated(OmniStateInvalidatedFn fn) = 0;
+
+    //! Register handler for MetaDEx order changes, with the property pairs, whose orders changed in a block.
+    using OmniMetaDExPairsChangedFn = std::function<void(const std::set<std::pair<uint32_t, uint32_t> >& pairs)>;
+    virtual std::unique_ptr<Handler> handleOmniMetaDExPairsChanged(OmniMetaDExPairsChangedFn fn) = 0;
 };
 
 //! Return implementation of Node interface.
@@ -0,0 +1,124 @@
+/**
+ * @file addresscache.cpp
+ *
+ * This file contains a least recently used cache of encoded addresses.
+ */
+
+#include <omnicore/addresscache.h>
+
+#include <chainparams.h>
+#include <crypto/siphash.h>
+#include <key_io.h>
+#include <random.h>
+#include <script/standard.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <boost/variant/static_visitor.hpp>
+
+#include <string.h>
+
+#include <limits>
+#include <string>
+#include <utility>
+
+COmniAddressCache mastercore::addressCache;
+
+SaltedAddressHasher::SaltedAddressHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t SaltedAddressHasher::operator()(const AddressCacheKey& key) const
+{
+    return SipHashUint256Extra(k0, k1, key.hash, key.type);
+}
+
+namespace
+{
+/** Builds the cache key of a destination, if it can be cached. */
+class AddressCacheKeyVisitor : public boost::static_visitor<bool>
+{
+private:
+    AddressCacheKey& m_key;
+
+    bool Set(uint32_t type, const unsigned char* data, size_t size) const
+    {
+        if (size > m_key.hash.size()) return false;
+        m_key.type = type;
+        m_key.hash.SetNull();
+        memcpy(m_key.hash.begin(), data, size);
+        return true;
+    }
+
+public:
+    explicit AddressCacheKeyVisitor(AddressCacheKey& key) : m_key(key) {}
+
+    bool operator()(const CNoDestination& dest) const { return false; }
+    bool operator()(const PKHash& dest) const { return Set(1, dest.begin(), dest.size()); }
+    bool operator()(const ScriptHash& dest) const { return Set(2, dest.begin(), dest.size()); }
+    bool operator()(const WitnessV0KeyHash& dest) const { return Set(3, dest.begin(), dest.size()); }
+    bool operator()(const WitnessV0ScriptHash& dest) const { return Set(4, dest.begin(), dest.size()); }
+
+    bool operator()(const WitnessUnknown& dest) const
+    {
+        // the length is part of the type, as shorter programs are padded with zeros
+        return Set(0x10000 | (dest.version << 8) | dest.length, dest.program, dest.length);
+    }
+};
+}
+
+COmniAddressCache::COmniAddressCache(size_t nMaxSize)
+  : m_nMaxSize(nMaxSize), m_nHits(0), m_nMisses(0)
+{
+}
+
+std::string COmniAddressCache::Encode(const CTxDestination& dest)
+{
+    AddressCacheKey key;
+    if (m_nMaxSize == 0 || !boost::apply_visitor(AddressCacheKeyVisitor(key), dest)) {
+        return EncodeDestination(dest);
+    }
+    const std::string& network = Params().NetworkIDString();
+
+    {
+        LOCK(m_mutex);
+        if (m_network != network) {
+            m_index.clear();
+            m_entries.clear();
+            m_network = network;
+        }
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            ++m_nHits;
+            // move to the front, which is the most recently used position
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            return it->second->second;
+        }
+        ++m_nMisses;
+    }
+
+    // encode without holding the lock
+    std::string strAddress = EncodeDestination(dest);
+
+    LOCK(m_mutex);
+    if (m_network == network && m_index.find(key) == m_index.end()) {
+        m_entries.emplace_front(key, strAddress);
+        m_index.emplace(key, m_entries.begin());
+        if (m_index.size() > m_nMaxSize) {
+            m_index.erase(m_entries.back().first);
+            m_entries.pop_back();
+        }
+    }
+
+    return strAddress;
+}
+
+void COmniAddressCache::Clear()
+{
+    LOCK(m_mutex);
+    m_index.clear();
+    m_entries.clear();
+}
+
+std::string mastercore::EncodeDestinationCached(const CTxDestination& dest)
+{
+    return addressCache.Encode(dest);
+}
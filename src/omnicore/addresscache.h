@@ -0,0 +1,92 @@
+#ifndef BITCOIN_OMNICORE_ADDRESSCACHE_H
+#define BITCOIN_OMNICORE_ADDRESSCACHE_H
+
+#include <script/standard.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <list>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/** Default number of encoded addresses held in the address cache. */
+static const unsigned int DEFAULT_ADDRESS_CACHE_SIZE = 10000;
+
+/** The type and hash of a destination, which identifies an encoded address. */
+struct AddressCacheKey
+{
+    uint32_t type;
+    uint256 hash;
+
+    bool operator==(const AddressCacheKey& other) const { return type == other.type && hash == other.hash; }
+};
+
+/** Hasher for destinations, which is salted, as the destinations are chosen by the senders. */
+class SaltedAddressHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    SaltedAddressHasher();
+
+    size_t operator()(const AddressCacheKey& key) const;
+};
+
+/**
+ * Cache of the encoded addresses of destinations.
+ *
+ * Encoding an address involves hashing for the checksum, and the same addresses
+ * are encoded again and again, when the senders and receivers of transactions are
+ * determined. Only destinations of up to 32 bytes are cached, which covers all
+ * standard destinations.
+ *
+ * When the cache is full, the least recently used address is evicted.
+ *
+ * The cache is thread-safe.
+ */
+class COmniAddressCache
+{
+private:
+    typedef std::list<std::pair<AddressCacheKey, std::string>> EntryList;
+
+    mutable Mutex m_mutex;
+
+    //! Encoded addresses, the most recently used first
+    EntryList m_entries GUARDED_BY(m_mutex);
+    //! Position of each cached address in the list
+    std::unordered_map<AddressCacheKey, EntryList::iterator, SaltedAddressHasher> m_index GUARDED_BY(m_mutex);
+    //! Network of the cached addresses, as the encoding depends on the chain parameters
+    std::string m_network GUARDED_BY(m_mutex);
+
+    const size_t m_nMaxSize;
+    uint64_t m_nHits GUARDED_BY(m_mutex);
+    uint64_t m_nMisses GUARDED_BY(m_mutex);
+
+public:
+    explicit COmniAddressCache(size_t nMaxSize = DEFAULT_ADDRESS_CACHE_SIZE);
+
+    /** Returns the encoded address of a destination, like EncodeDestination(). */
+    std::string Encode(const CTxDestination& dest);
+
+    /** Removes all addresses, but keeps the counters. */
+    void Clear();
+
+    size_t Size() const { LOCK(m_mutex); return m_index.size(); }
+    uint64_t GetHits() const { LOCK(m_mutex); return m_nHits; }
+    uint64_t GetMisses() const { LOCK(m_mutex); return m_nMisses; }
+};
+
+namespace mastercore
+{
+//! Cache of the encoded addresses of senders and receivers
+extern COmniAddressCache addressCache;
+
+/** Returns the encoded address of a destination via the address cache. */
+std::string EncodeDestinationCached(const CTxDestination& dest);
+}
+
+#endif // BITCOIN_OMNICORE_ADDRESSCACHE_H
@@ -0,0 +1,132 @@
+/**
+ * @file amountformat.cpp
+ *
+ * This file contains the formatting of amounts into caller buffers, which
+ * avoids the format parsing and allocations of strprintf().
+ */
+
+#include <omnicore/amountformat.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <limits>
+
+namespace mastercore
+{
+//! Number of units per divisible token
+static const uint64_t DIVISIBLE_UNITS = 100000000;
+
+//! The decimal digits of the numbers from 00 to 99
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/** Writes the digits of a number backwards, ending before pEnd, and returns the first digit. */
+static char* WriteDigitsBackwards(char* pEnd, uint64_t n)
+{
+    while (n >= 100) {
+        const size_t nPair = (n % 100) * 2;
+        n /= 100;
+        *--pEnd = DIGIT_PAIRS[nPair + 1];
+        *--pEnd = DIGIT_PAIRS[nPair];
+    }
+    if (n >= 10) {
+        *--pEnd = DIGIT_PAIRS[n * 2 + 1];
+        *--pEnd = DIGIT_PAIRS[n * 2];
+    } else {
+        *--pEnd = '0' + n;
+    }
+    return pEnd;
+}
+
+/** Writes the eight decimals of a number below DIVISIBLE_UNITS backwards, ending before pEnd. */
+static char* WriteDecimalsBackwards(char* pEnd, uint64_t n)
+{
+    for (int i = 0; i < 4; ++i) {
+        const size_t nPair = (n % 100) * 2;
+        n /= 100;
+        *--pEnd = DIGIT_PAIRS[nPair + 1];
+        *--pEnd = DIGIT_PAIRS[nPair];
+    }
+    return pEnd;
+}
+
+/** Moves the characters from pBegin to the end of the scratch space to the start of the buffer. */
+static size_t MoveToFront(char* buf, const char* pBegin, const char* pEnd)
+{
+    const size_t nLength = pEnd - pBegin;
+    memmove(buf, pBegin, nLength);
+    buf[nLength] = '\0';
+    return nLength;
+}
+
+static size_t WriteErrorAmount(char* buf)
+{
+    static const char strError[] = "ErrorAmount";
+    memcpy(buf, strError, sizeof(strError));
+    return sizeof(strError) - 1;
+}
+
+size_t FormatIndivisibleAmount(char* buf, int64_t amount)
+{
+    char* pEnd = buf + AMOUNT_BUFFER_SIZE - 1;
+    // negated as unsigned number, which also covers the lowest 64 bit number
+    const uint64_t nAbs = amount < 0 ? uint64_t(0) - uint64_t(amount) : uint64_t(amount);
+    char* p = WriteDigitsBackwards(pEnd, nAbs);
+    if (amount < 0) *--p = '-';
+
+    return MoveToFront(buf, p, pEnd);
+}
+
+size_t FormatDivisibleAmount(char* buf, int64_t amount, bool fSign)
+{
+    if (amount == std::numeric_limits<int64_t>::min()) {
+        return WriteErrorAmount(buf);
+    }
+    char* pEnd = buf + AMOUNT_BUFFER_SIZE - 1;
+    const uint64_t nAbs = amount < 0 ? -amount : amount;
+    char* p = WriteDecimalsBackwards(pEnd, nAbs % DIVISIBLE_UNITS);
+    *--p = '.';
+    p = WriteDigitsBackwards(p, nAbs / DIVISIBLE_UNITS);
+    if (fSign) *--p = (amount < 0) ? '-' : '+';
+
+    return MoveToFront(buf, p, pEnd);
+}
+
+size_t FormatDivisibleShortAmount(char* buf, int64_t amount)
+{
+    if (amount == std::numeric_limits<int64_t>::min()) {
+        return WriteErrorAmount(buf);
+    }
+    char* pEnd = buf + AMOUNT_BUFFER_SIZE - 1;
+    const uint64_t nAbs = amount < 0 ? -amount : amount;
+    uint64_t nDecimals = nAbs % DIVISIBLE_UNITS;
+    char* p = pEnd;
+    if (nDecimals != 0) {
+        // trailing zeros are dropped
+        int nDigits = 8;
+        while (nDecimals % 10 == 0) {
+            nDecimals /= 10;
+            --nDigits;
+        }
+        while (nDigits-- > 0) {
+            *--p = '0' + (nDecimals % 10);
+            nDecimals /= 10;
+        }
+        *--p = '.';
+    }
+    p = WriteDigitsBackwards(p, nAbs / DIVISIBLE_UNITS);
+
+    return MoveToFront(buf, p, pEnd);
+}
+}
@@ -0,0 +1,39 @@
+#ifndef BITCOIN_OMNICORE_AMOUNTFORMAT_H
+#define BITCOIN_OMNICORE_AMOUNTFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace mastercore
+{
+//! Size of a buffer, which fits any formatted amount, including the sign and the terminator
+static const size_t AMOUNT_BUFFER_SIZE = 32;
+
+/**
+ * Writes an indivisible amount, such as "-150", into a buffer of at least AMOUNT_BUFFER_SIZE.
+ *
+ * @return The number of characters written, excluding the terminator
+ */
+size_t FormatIndivisibleAmount(char* buf, int64_t amount);
+
+/**
+ * Writes a divisible amount with eight decimals, such as "1.50000000", into a buffer of at
+ * least AMOUNT_BUFFER_SIZE.
+ *
+ * The absolute value is written, unless fSign is set, in which case it's prefixed by
+ * "+" or "-". The lowest 64 bit number can't be negated, and is written as "ErrorAmount".
+ *
+ * @return The number of characters written, excluding the terminator
+ */
+size_t FormatDivisibleAmount(char* buf, int64_t amount, bool fSign = false);
+
+/**
+ * Writes a divisible amount without trailing zeros, such as "1.5", into a buffer of at
+ * least AMOUNT_BUFFER_SIZE.
+ *
+ * @return The number of characters written, excluding the terminator
+ */
+size_t FormatDivisibleShortAmount(char* buf, int64_t amount);
+}
+
+#endif // BITCOIN_OMNICORE_AMOUNTFORMAT_H
@@ -0,0 +1,94 @@
+/**
+ * @file arena.cpp
+ *
+ * This file contains the monotonic arena, from which the temporaries of
+ * the transactions of a block are allocated.
+ */
+
+#include <omnicore/arena.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace mastercore
+{
+CArena::CArena() : m_nChunk(0), m_nOffset(0), m_nLive(0)
+{
+}
+
+void* CArena::Allocate(size_t n, size_t nAlign)
+{
+    while (m_nChunk < m_chunks.size()) {
+        const std::pair<std::unique_ptr<unsigned char[]>, size_t>& chunk = m_chunks[m_nChunk];
+        const uintptr_t nAddress = reinterpret_cast<uintptr_t>(chunk.first.get()) + m_nOffset;
+        const size_t nPadding = (nAlign - (nAddress % nAlign)) % nAlign;
+        if (m_nOffset + nPadding + n <= chunk.second) {
+            m_nOffset += nPadding + n;
+            ++m_nLive;
+            return chunk.first.get() + m_nOffset - n;
+        }
+        ++m_nChunk;
+        m_nOffset = 0;
+    }
+
+    // chunks are allocated with the alignment of new, so larger alignments need padding
+    const size_t nSize = std::max(ARENA_CHUNK_SIZE, n + nAlign);
+    std::unique_ptr<unsigned char[]> data(new unsigned char[nSize]);
+    m_chunks.emplace_back(std::move(data), nSize);
+    m_nChunk = m_chunks.size() - 1;
+    m_nOffset = 0;
+
+    return Allocate(n, nAlign);
+}
+
+void CArena::Deallocate(void* p, size_t n)
+{
+    assert(m_nLive > 0);
+    if (--m_nLive == 0) {
+        Rewind();
+    }
+}
+
+/**
+ * Starts to allocate from the first chunk again, and frees oversized and surplus chunks.
+ */
+void CArena::Rewind()
+{
+    assert(m_nLive == 0);
+    m_chunks.erase(std::remove_if(m_chunks.begin(), m_chunks.end(),
+            [](const std::pair<std::unique_ptr<unsigned char[]>, size_t>& chunk) { return chunk.second > ARENA_CHUNK_SIZE; }),
+            m_chunks.end());
+    if (m_chunks.size() > ARENA_MAX_KEPT_CHUNKS) {
+        m_chunks.resize(ARENA_MAX_KEPT_CHUNKS);
+    }
+    m_nChunk = 0;
+    m_nOffset = 0;
+}
+
+void CArena::Release()
+{
+    if (m_nLive > 0) return;
+
+    Rewind();
+    if (m_chunks.size() > 1) {
+        m_chunks.resize(1);
+    }
+}
+
+CArena& GetBlockArena()
+{
+    static thread_local CArena arena;
+    return arena;
+}
+
+void ReleaseBlockArena()
+{
+    GetBlockArena().Release();
+}
+}
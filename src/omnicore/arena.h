@@ -0,0 +1,98 @@
+#ifndef BITCOIN_OMNICORE_ARENA_H
+#define BITCOIN_OMNICORE_ARENA_H
+
+#include <memory>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+namespace mastercore
+{
+//! Size of the chunks, from which the arena allocates
+static const size_t ARENA_CHUNK_SIZE = 64 * 1024;
+//! Maximum number of chunks, which are kept, when the arena is rewound
+static const size_t ARENA_MAX_KEPT_CHUNKS = 4;
+
+/**
+ * A monotonic arena for short-lived temporaries, such as the containers, which are
+ * used while a transaction is decoded or interpreted.
+ *
+ * Allocations are carved from chunks, and deallocations only count the live
+ * allocations. Once there are none, the arena is rewound, and the chunks are
+ * reused, so the temporaries of a block hardly ever reach the global allocator.
+ *
+ * The arena isn't thread-safe, see GetBlockArena() for an arena per thread.
+ */
+class CArena
+{
+private:
+    //! Chunks and their sizes
+    std::vector<std::pair<std::unique_ptr<unsigned char[]>, size_t>> m_chunks;
+    //! Index of the chunk, from which is allocated
+    size_t m_nChunk;
+    //! Offset of the next allocation within the chunk
+    size_t m_nOffset;
+    //! Number of allocations, which were not yet deallocated
+    size_t m_nLive;
+
+    void Rewind();
+
+public:
+    CArena();
+
+    CArena(const CArena&) = delete;
+    CArena& operator=(const CArena&) = delete;
+
+    /** Allocates n bytes with the given alignment. */
+    void* Allocate(size_t n, size_t nAlign);
+
+    /** Deallocates memory, which is reclaimed, once all allocations are deallocated. */
+    void Deallocate(void* p, size_t n);
+
+    /** Frees all chunks but one, if there are no live allocations. */
+    void Release();
+
+    size_t GetLiveAllocations() const { return m_nLive; }
+    size_t GetChunks() const { return m_chunks.size(); }
+};
+
+/** Returns the arena of the calling thread for the temporaries of the current block. */
+CArena& GetBlockArena();
+
+/**
+ * Allocator for standard containers, which allocates from an arena.
+ *
+ * Containers with this allocator must be destroyed by the thread, which created them,
+ * and must not outlive the processing of a transaction.
+ */
+template <typename T>
+class ArenaAllocator
+{
+private:
+    template <typename U> friend class ArenaAllocator;
+
+    CArena* m_arena;
+
+public:
+    typedef T value_type;
+
+    ArenaAllocator() : m_arena(&GetBlockArena()) {}
+    explicit ArenaAllocator(CArena& arena) : m_arena(&arena) {}
+    template <typename U> ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.m_arena) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(m_arena->Allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* p, size_t n) { m_arena->Deallocate(p, n * sizeof(T)); }
+
+    template <typename U> bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.m_arena; }
+    template <typename U> bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != other.m_arena; }
+};
+
+//! A vector, which allocates from the arena of the calling thread
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/** Frees the chunks of the calling thread's arena, which were only needed for the last block. */
+void ReleaseBlockArena();
+}
+
+#endif // BITCOIN_OMNICORE_ARENA_H
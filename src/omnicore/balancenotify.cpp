@@ -0,0 +1,94 @@
+/**
+ * @file balancenotify.cpp
+ *
+ * This file contains the recording of balance changes, which are signaled once
+ * per block, for example to publish them via ZMQ.
+ */
+
+#include <omnicore/balancenotify.h>
+
+#include <omnicore/omnicore.h>
+
+#include <sync.h>
+#include <ui_interface.h>
+#include <uint256.h>
+
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mastercore
+{
+//! Whether balance changes are recorded, checked before acquiring the lock
+static std::atomic<bool> fRecordBalances{false};
+
+//! Guards the recorded balance changes
+static Mutex cs_balance_notify;
+//! The addresses to record, or empty to record all addresses
+static std::set<std::string> setFilter GUARDED_BY(cs_balance_notify);
+//! The transaction, which is processed
+static uint256 currentTxid GUARDED_BY(cs_balance_notify);
+//! The changed balances of the block, with the last transaction, which changed them
+static std::map<std::pair<std::string, uint32_t>, uint256> mapChanged GUARDED_BY(cs_balance_notify);
+
+void EnableBalanceNotifications(const std::set<std::string>& addresses)
+{
+    LOCK(cs_balance_notify);
+    setFilter = addresses;
+    fRecordBalances = true;
+}
+
+void DisableBalanceNotifications()
+{
+    LOCK(cs_balance_notify);
+    fRecordBalances = false;
+    setFilter.clear();
+    mapChanged.clear();
+}
+
+void SetBalanceNotificationTx(const uint256& txid)
+{
+    if (!fRecordBalances) return;
+
+    LOCK(cs_balance_notify);
+    currentTxid = txid;
+}
+
+void RecordBalanceChange(const std::string& address, uint32_t propertyId)
+{
+    if (!fRecordBalances) return;
+
+    LOCK(cs_balance_notify);
+    if (!setFilter.empty() && setFilter.count(address) == 0) return;
+    mapChanged[std::make_pair(address, propertyId)] = currentTxid;
+}
+
+void NotifyBalanceChanges(int nBlock)
+{
+    std::map<std::pair<std::string, uint32_t>, uint256> mapBlock;
+    {
+        LOCK(cs_balance_notify);
+        mapBlock.swap(mapChanged);
+        currentTxid.SetNull();
+    }
+    if (mapBlock.empty()) return;
+
+    // the amounts are obtained once per balance, after all changes of the block
+    std::vector<BalanceChange> vChanges;
+    vChanges.reserve(mapBlock.size());
+    for (const auto& entry : mapBlock) {
+        BalanceChange change;
+        change.address = entry.first.first;
+        change.propertyId = entry.first.second;
+        change.balance = GetTokenBalance(change.address, change.propertyId, BALANCE);
+        change.reserved = GetReservedTokenBalance(change.address, change.propertyId);
+        change.txid = entry.second;
+        vChanges.push_back(std::move(change));
+    }
+
+    uiInterface.OmniBalancesChanged(nBlock, vChanges);
+}
+}
@@ -0,0 +1,54 @@
+#ifndef BITCOIN_OMNICORE_BALANCENOTIFY_H
+#define BITCOIN_OMNICORE_BALANCENOTIFY_H
+
+#include <omnicore/timedmutex.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+extern CTimedRecursiveMutex cs_tally;
+
+namespace mastercore
+{
+/** A balance, which changed in a block, with the amounts at the end of the block. */
+struct BalanceChange
+{
+    std::string address;
+    uint32_t propertyId;
+    //! The confirmed balance, which is not reserved
+    int64_t balance;
+    //! The sum of the amounts reserved by offers, accepts and MetaDEx orders
+    int64_t reserved;
+    //! The last transaction, which changed the balance, or null, if it was changed by the block processing
+    uint256 txid;
+};
+
+/**
+ * Starts recording balance changes for the notifications.
+ *
+ * @param addresses[in]  The addresses to record, or an empty set to record all addresses
+ */
+void EnableBalanceNotifications(const std::set<std::string>& addresses);
+
+/** Stops recording balance changes, and discards the recorded ones. */
+void DisableBalanceNotifications();
+
+/** Sets the transaction, which is processed, or null, after it was processed. */
+void SetBalanceNotificationTx(const uint256& txid);
+
+/** Records a changed balance of an address, if balance changes are recorded. */
+void RecordBalanceChange(const std::string& address, uint32_t propertyId);
+
+/**
+ * Signals the balances, which changed in the block, once per block and with
+ * the amounts after the block, and clears the recorded changes.
+ */
+void NotifyBalanceChanges(int nBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+}
+
+#endif // BITCOIN_OMNICORE_BALANCENOTIFY_H
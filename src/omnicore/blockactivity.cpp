@@ -0,0 +1,140 @@
+/**
+ * @file blockactivity.cpp
+ *
+ * This file contains the activity of the last blocks, which allows to disconnect
+ * blocks without Omni activity, without rolling back the state.
+ */
+
+#include <omnicore/blockactivity.h>
+
+#include <omnicore/log.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <deque>
+#include <memory>
+#include <stdint.h>
+
+namespace mastercore
+{
+namespace
+{
+/** The activity of a block. */
+struct CBlockActivityEntry
+{
+    int nBlock;
+    uint256 hashBlock;
+    uint256 hashPrevBlock;
+    //! Commitment to the state before the block
+    uint256 hashState;
+    //! Amount of Dev Omni before the block
+    int64_t nExodusPrev;
+    //! Whether the block changed the state, other than Dev Omni
+    bool fTouched;
+};
+
+//! Entries of consecutive blocks, the last one refers to the current state
+std::deque<CBlockActivityEntry> g_entries GUARDED_BY(cs_tally);
+//! Entry of the block in progress, if tracked
+std::unique_ptr<CBlockActivityEntry> g_current GUARDED_BY(cs_tally);
+} // anonymous namespace
+
+/**
+ * Discards all entries, for example because the state was restored otherwise.
+ */
+void ClearBlockActivity()
+{
+    g_entries.clear();
+    g_current.reset();
+}
+
+/**
+ * Starts tracking the activity of a block, if it's one of the last blocks of the chain.
+ *
+ * If the block doesn't follow the last tracked block, or if the previous block was
+ * not completed, all entries are discarded.
+ */
+void BeginBlockActivity(int nBlock, const uint256& hashPrevBlock, int nChainHeight, const uint256& hashState, int64_t nExodusPrev)
+{
+    if (g_current || nBlock <= nChainHeight - MAX_BLOCK_ACTIVITY) {
+        ClearBlockActivity();
+        if (nBlock <= nChainHeight - MAX_BLOCK_ACTIVITY) return;
+    }
+    if (!g_entries.empty() && (g_entries.back().nBlock + 1 != nBlock || g_entries.back().hashBlock != hashPrevBlock)) {
+        g_entries.clear();
+    }
+
+    g_current.reset(new CBlockActivityEntry());
+    g_current->nBlock = nBlock;
+    g_current->hashPrevBlock = hashPrevBlock;
+    g_current->hashState = hashState;
+    g_current->nExodusPrev = nExodusPrev;
+    g_current->fTouched = false;
+}
+
+/**
+ * Marks the block in progress as touching the state.
+ */
+void MarkBlockTouched()
+{
+    if (g_current) g_current->fTouched = true;
+}
+
+/**
+ * Stops tracking the activity of a block, and stores it as entry.
+ *
+ * Changes of the balances, the DEx, MetaDEx and crowdsales are detected by comparing
+ * the commitments to the state, while other changes must be marked explicitly.
+ */
+void EndBlockActivity(int nBlock, const uint256& hashBlock, const uint256& hashState)
+{
+    if (!g_current) return;
+    if (g_current->nBlock != nBlock) {
+        ClearBlockActivity();
+        return;
+    }
+    g_current->hashBlock = hashBlock;
+    if (g_current->hashState != hashState) g_current->fTouched = true;
+
+    g_entries.push_back(std::move(*g_current));
+    g_current.reset();
+    while (g_entries.size() > static_cast<size_t>(MAX_BLOCK_ACTIVITY)) {
+        g_entries.pop_front();
+    }
+}
+
+/**
+ * Discards all blocks at and above the given height, if none of them touched the state.
+ *
+ * The state after the fork block is then the same as the current state, except for
+ * Dev Omni, which must be reverted by the caller.
+ */
+bool SkipUntouchedBlocks(int nHeight, const uint256& hashForkBlock, int64_t& nExodusPrev)
+{
+    if (g_current || g_entries.empty()) return false;
+
+    const CBlockActivityEntry& last = g_entries.back();
+    if (last.nBlock < nHeight - 1) return false;
+    if (last.nBlock == nHeight - 1) {
+        // nothing to skip, but the state must refer to the same block
+        return last.hashBlock == hashForkBlock;
+    }
+
+    const CBlockActivityEntry& first = g_entries.front();
+    if (first.nBlock > nHeight) return false;
+    const CBlockActivityEntry& fork = g_entries[nHeight - first.nBlock];
+    if (fork.nBlock != nHeight || fork.hashPrevBlock != hashForkBlock) return false;
+
+    for (size_t n = nHeight - first.nBlock; n < g_entries.size(); ++n) {
+        if (g_entries[n].fTouched) return false;
+    }
+
+    nExodusPrev = fork.nExodusPrev;
+    g_entries.erase(g_entries.begin() + (nHeight - first.nBlock), g_entries.end());
+
+    PrintToLog("%s(): the blocks above %d didn't touch the state\n", __func__, nHeight - 1);
+
+    return true;
+}
+} // namespace mastercore
@@ -0,0 +1,66 @@
+#ifndef BITCOIN_OMNICORE_BLOCKACTIVITY_H
+#define BITCOIN_OMNICORE_BLOCKACTIVITY_H
+
+#include <omnicore/timedmutex.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <stdint.h>
+
+extern CTimedRecursiveMutex cs_tally;
+
+namespace mastercore
+{
+//! Number of most recent blocks, whose Omni activity is tracked
+static const int MAX_BLOCK_ACTIVITY = 100;
+
+/**
+ * The activity of the last blocks records, whether a block touched the state, so
+ * that disconnecting blocks without Omni activity doesn't require a rollback.
+ *
+ * A block touches the state, if it contains Omni transactions, valid or not, or if
+ * time-based effects, such as the expiry of crowdsales, DEx accepts or alerts, or
+ * feature activations, change the state. The Dev Omni of the Exodus address grows
+ * with nearly every block, so it doesn't count as touching the state, but the amount
+ * before the block is recorded instead, so that it can be reverted.
+ */
+
+/** Discards all entries, for example because the state was restored otherwise. */
+void ClearBlockActivity() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Starts tracking the activity of a block, if it's one of the last blocks of the chain.
+ *
+ * @param nBlock         The height of the block
+ * @param hashPrevBlock  The hash of the previous block
+ * @param nChainHeight   The height of the active chain
+ * @param hashState      The commitment to the state before the block
+ * @param nExodusPrev    The amount of Dev Omni before the block
+ */
+void BeginBlockActivity(int nBlock, const uint256& hashPrevBlock, int nChainHeight, const uint256& hashState, int64_t nExodusPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Marks the block in progress as touching the state. */
+void MarkBlockTouched() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Stops tracking the activity of a block, and stores it as entry.
+ *
+ * @param nBlock     The height of the block
+ * @param hashBlock  The hash of the block
+ * @param hashState  The commitment to the state after the block, but before Dev Omni was updated
+ */
+void EndBlockActivity(int nBlock, const uint256& hashBlock, const uint256& hashState) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Discards all blocks at and above the given height, if none of them touched the state.
+ *
+ * @param nHeight        The height of the first disconnected block
+ * @param hashForkBlock  The hash of the block at nHeight - 1 in the active chain
+ * @param nExodusPrev    Set to the amount of Dev Omni before the first disconnected block, if there was any
+ * @return True, if the blocks were discarded, and only Dev Omni must be reverted
+ */
+bool SkipUntouchedBlocks(int nHeight, const uint256& hashForkBlock, int64_t& nExodusPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+}
+
+#endif // BITCOIN_OMNICORE_BLOCKACTIVITY_H
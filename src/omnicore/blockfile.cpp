@@ -0,0 +1,231 @@
+/**
+ * @file blockfile.cpp
+ *
+ * This file contains the memory mapped block reader, which is used to read
+ * blocks during the initial scan and for RPC calls, without reopening and
+ * reading the block files for every block.
+ */
+
+#include <omnicore/blockfile.h>
+
+#include <omnicore/log.h>
+#include <omnicore/statefile.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <crypto/common.h>
+#include <flatfile.h>
+#include <index/txindex.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <protocol.h>
+#include <serialize.h>
+#include <sync.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <exception>
+#include <list>
+#include <memory>
+#include <utility>
+
+namespace mastercore
+{
+//! Size of the header of a block in a block file: message start and block size
+static const size_t BLOCK_FILE_HEADER_SIZE = CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t);
+
+CMappedBlockFile::CMappedBlockFile(const fs::path& path) : m_data(nullptr), m_size(0)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            m_data = static_cast<const unsigned char*>(addr);
+            m_size = st.st_size;
+        }
+    }
+    close(fd);
+#endif
+}
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    if (m_data) {
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+    }
+#endif
+}
+
+void CMappedBlockFile::WillNeed(size_t nPos, size_t nSize) const
+{
+#ifndef WIN32
+    if (!m_data || nPos >= m_size) return;
+
+    // the advice must start at a page boundary
+    static const size_t nPageSize = sysconf(_SC_PAGESIZE);
+    const size_t nStart = nPos - (nPos % nPageSize);
+    const size_t nEnd = std::min(m_size, nPos + nSize + MAPPED_BLOCK_READ_AHEAD);
+    posix_madvise(const_cast<unsigned char*>(m_data) + nStart, nEnd - nStart, POSIX_MADV_WILLNEED);
+#endif
+}
+
+//! Guards vMappedFiles
+static Mutex cs_mapped_files;
+//! Block files, which are kept mapped, most recently used first
+static std::list<std::pair<int, std::shared_ptr<const CMappedBlockFile>>> vMappedFiles GUARDED_BY(cs_mapped_files);
+
+/**
+ * Returns the mapping of a block file, which covers at least the given number of bytes.
+ *
+ * Block files grow, while blocks are appended, so a mapping, which is too small, is replaced.
+ */
+static std::shared_ptr<const CMappedBlockFile> GetMappedBlockFile(const FlatFilePos& pos, size_t nMinSize)
+{
+    LOCK(cs_mapped_files);
+
+    for (auto it = vMappedFiles.begin(); it != vMappedFiles.end(); ++it) {
+        if (it->first != pos.nFile) continue;
+        std::shared_ptr<const CMappedBlockFile> mapped = it->second;
+        vMappedFiles.erase(it);
+        if (mapped->size() < nMinSize) break;
+        vMappedFiles.emplace_front(pos.nFile, mapped);
+        return mapped;
+    }
+
+    std::shared_ptr<const CMappedBlockFile> mapped = std::make_shared<const CMappedBlockFile>(GetBlockPosFilename(pos));
+    if (!mapped->IsMapped()) return nullptr;
+
+    vMappedFiles.emplace_front(pos.nFile, mapped);
+    if (vMappedFiles.size() > MAX_MAPPED_BLOCK_FILES) vMappedFiles.pop_back();
+
+    return mapped;
+}
+
+/**
+ * Returns the mapping of the block file, which covers the block at the given position.
+ *
+ * @param pos[in]          The position of the block
+ * @param nBlockSize[out]  The size of the block, as stored in the header preceding it
+ * @return The mapping, or nullptr, if the block can't be read via a mapping
+ */
+static std::shared_ptr<const CMappedBlockFile> MapBlock(const FlatFilePos& pos, uint32_t& nBlockSize)
+{
+    static const bool fEnabled = gArgs.GetBoolArg("-omnimmapblocks", DEFAULT_OMNI_MMAP_BLOCKS);
+    if (!fEnabled || pos.IsNull() || pos.nPos < BLOCK_FILE_HEADER_SIZE) return nullptr;
+
+    std::shared_ptr<const CMappedBlockFile> mapped = GetMappedBlockFile(pos, pos.nPos);
+    if (!mapped || mapped->size() < pos.nPos) return nullptr;
+
+    // the header precedes the block
+    const unsigned char* pHeader = mapped->data() + pos.nPos - BLOCK_FILE_HEADER_SIZE;
+    if (memcmp(pHeader, Params().MessageStart(), CMessageHeader::MESSAGE_START_SIZE) != 0) return nullptr;
+    nBlockSize = ReadLE32(pHeader + CMessageHeader::MESSAGE_START_SIZE);
+    if (nBlockSize > MAX_SIZE) return nullptr;
+
+    if (mapped->size() < size_t(pos.nPos) + nBlockSize) {
+        mapped = GetMappedBlockFile(pos, size_t(pos.nPos) + nBlockSize);
+        if (!mapped || mapped->size() < size_t(pos.nPos) + nBlockSize) return nullptr;
+    }
+
+    return mapped;
+}
+
+/**
+ * Reads a block via a memory mapping of its block file, see -omnimmapblocks.
+ *
+ * The block is deserialized straight from the mapped memory, and the range of the
+ * block, as well as the start of the following block, is requested ahead.
+ */
+bool ReadBlockMapped(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams)
+{
+    uint32_t nBlockSize = 0;
+    std::shared_ptr<const CMappedBlockFile> mapped = MapBlock(pos, nBlockSize);
+    if (!mapped) {
+        return ReadBlockFromDisk(block, pos, consensusParams);
+    }
+    mapped->WillNeed(pos.nPos, nBlockSize);
+
+    block.SetNull();
+    try {
+        CSpanReader reader(mapped->data() + pos.nPos, mapped->data() + pos.nPos + nBlockSize);
+        reader >> block;
+    } catch (const std::exception& e) {
+        PrintToLog("%s(): ERROR: failed to deserialize block at %s: %s\n", __func__, pos.ToString(), e.what());
+        return false;
+    }
+
+    if (!CheckProofOfWork(block.GetHash(), block.nBits, consensusParams)) {
+        PrintToLog("%s(): ERROR: errors in block header at %s\n", __func__, pos.ToString());
+        return false;
+    }
+
+    return true;
+}
+
+bool ReadBlockMapped(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    FlatFilePos blockPos;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+    }
+
+    if (!ReadBlockMapped(block, blockPos, consensusParams)) return false;
+    if (block.GetHash() != pindex->GetBlockHash()) {
+        PrintToLog("%s(): ERROR: hash doesn't match index for %s at %s\n", __func__, pindex->ToString(), blockPos.ToString());
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Reads a transaction via a memory mapping of its block file, like TxIndex::FindTx().
+ *
+ * Only the header of the block and the transaction are decoded, and the bytes
+ * following the transaction are requested ahead, so reading transactions in the
+ * order of their positions is mostly sequential.
+ */
+bool ReadTransactionMapped(const CDiskTxPos& pos, uint256& hashBlock, CTransactionRef& tx)
+{
+    uint32_t nBlockSize = 0;
+    std::shared_ptr<const CMappedBlockFile> mapped = MapBlock(pos, nBlockSize);
+    if (!mapped) return false;
+
+    CBlockHeader header;
+    try {
+        CSpanReader reader(mapped->data() + pos.nPos, mapped->data() + pos.nPos + nBlockSize);
+        reader >> header;
+        reader.ignore(pos.nTxOffset);
+        mapped->WillNeed(reader.data() - mapped->data(), 0);
+        reader >> tx;
+    } catch (const std::exception& e) {
+        PrintToLog("%s(): ERROR: failed to deserialize transaction at %s: %s\n", __func__, pos.ToString(), e.what());
+        return false;
+    }
+    hashBlock = header.GetHash();
+
+    return true;
+}
+
+void ReleaseMappedBlockFiles()
+{
+    LOCK(cs_mapped_files);
+    vMappedFiles.clear();
+}
+}
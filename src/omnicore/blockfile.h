@@ -0,0 +1,75 @@
+#ifndef BITCOIN_OMNICORE_BLOCKFILE_H
+#define BITCOIN_OMNICORE_BLOCKFILE_H
+
+class CBlock;
+class CBlockIndex;
+class uint256;
+struct CDiskTxPos;
+struct FlatFilePos;
+
+namespace Consensus {
+struct Params;
+}
+
+#include <fs.h>
+#include <primitives/transaction.h>
+
+#include <stddef.h>
+
+namespace mastercore
+{
+//! Default setting, whether blocks are read via memory mappings of the block files
+static const bool DEFAULT_OMNI_MMAP_BLOCKS = true;
+//! Number of block files, which are kept mapped
+static const size_t MAX_MAPPED_BLOCK_FILES = 4;
+//! Number of bytes after a block, which are requested ahead, as the next block usually follows
+static const size_t MAPPED_BLOCK_READ_AHEAD = 1 << 20;
+
+/**
+ * A block file, which is mapped into memory read-only, so blocks are decoded in place.
+ */
+class CMappedBlockFile
+{
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+
+public:
+    explicit CMappedBlockFile(const fs::path& path);
+    ~CMappedBlockFile();
+
+    CMappedBlockFile(const CMappedBlockFile&) = delete;
+    CMappedBlockFile& operator=(const CMappedBlockFile&) = delete;
+
+    /** Returns whether the file is mapped. */
+    bool IsMapped() const { return m_data != nullptr; }
+
+    /** Requests the given range, and the bytes following it, to be read ahead. */
+    void WillNeed(size_t nPos, size_t nSize) const;
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
+/**
+ * Reads a block via a memory mapping of its block file, see -omnimmapblocks.
+ *
+ * Falls back to ReadBlockFromDisk(), if the block file can't be mapped.
+ */
+bool ReadBlockMapped(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams);
+
+/** Reads a block via a memory mapping, and checks, whether it matches the index entry. */
+bool ReadBlockMapped(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+
+/**
+ * Reads a transaction and the hash of its block via a memory mapping of the block file.
+ *
+ * @return False, if the transaction can't be read via a mapping, in which case the caller falls back to reading from disk
+ */
+bool ReadTransactionMapped(const CDiskTxPos& pos, uint256& hashBlock, CTransactionRef& tx);
+
+/** Unmaps the block files, which are kept mapped. */
+void ReleaseMappedBlockFiles();
+}
+
+#endif // BITCOIN_OMNICORE_BLOCKFILE_H
@@ -0,0 +1,198 @@
+/**
+ * @file blockqueue.cpp
+ *
+ * This file contains the queue of connected and disconnected blocks, which are
+ * processed in order by a dedicated thread, when -omniasync is enabled, and the
+ * tracking of the last block processed by Omni Core.
+ */
+
+#include <omnicore/blockqueue.h>
+
+#include <omnicore/blockfile.h>
+#include <omnicore/log.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/scanprefetch.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <util/system.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+namespace mastercore
+{
+COmniBlockQueue omniBlockQueue;
+
+COmniBlockQueue::COmniBlockQueue() : m_nBlockData(0), m_pTip(nullptr), m_fStop(false) {}
+
+COmniBlockQueue::~COmniBlockQueue()
+{
+    Stop();
+}
+
+bool COmniBlockQueue::IsEnabled()
+{
+    static const bool fEnabled = gArgs.GetBoolArg("-omniasync", DEFAULT_OMNI_ASYNC);
+    return fEnabled;
+}
+
+void COmniBlockQueue::Start()
+{
+    if (m_thread.joinable()) return;
+    {
+        LOCK(m_mutex);
+        m_fStop = false;
+    }
+    m_thread = std::thread([this] {
+        util::ThreadRename("omniblocks");
+        ThreadProcess();
+    });
+}
+
+void COmniBlockQueue::Stop()
+{
+    {
+        LOCK(m_mutex);
+        m_fStop = true;
+    }
+    m_cvItems.notify_all();
+    m_cvProcessed.notify_all();
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void COmniBlockQueue::PushConnected(std::shared_ptr<const CBlock> pblock, const CBlockIndex* pBlockIndex, std::shared_ptr<std::map<COutPoint, Coin>> removedCoins)
+{
+    {
+        LOCK(m_mutex);
+        // far behind, the blocks are read from disk again, when they are processed, unless they may be pruned
+        if (m_nBlockData >= MAX_QUEUED_BLOCK_DATA && !fPruneMode) {
+            pblock.reset();
+            removedCoins.reset();
+        }
+        if (pblock) ++m_nBlockData;
+        m_items.push_back(Item{std::move(pblock), std::move(removedCoins), pBlockIndex, true});
+    }
+    m_cvItems.notify_one();
+}
+
+void COmniBlockQueue::PushDisconnected(const CBlockIndex* pBlockIndex)
+{
+    {
+        LOCK(m_mutex);
+        m_items.push_back(Item{nullptr, nullptr, pBlockIndex, false});
+    }
+    m_cvItems.notify_one();
+}
+
+size_t COmniBlockQueue::Size() const
+{
+    LOCK(m_mutex);
+    return m_items.size();
+}
+
+void COmniBlockQueue::SetTip(const CBlockIndex* pBlockIndex)
+{
+    {
+        LOCK(m_mutex);
+        m_pTip = pBlockIndex;
+    }
+    m_cvProcessed.notify_all();
+}
+
+int COmniBlockQueue::GetTip(uint256& hashBlock) const
+{
+    LOCK(m_mutex);
+    if (!m_pTip) return -1;
+    hashBlock = m_pTip->GetBlockHash();
+    return m_pTip->nHeight;
+}
+
+bool COmniBlockQueue::WaitForHeight(int nHeight, std::chrono::milliseconds timeout)
+{
+    WAIT_LOCK(m_mutex, lock);
+    return m_cvProcessed.wait_for(lock, timeout, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+        return m_fStop || (m_pTip && m_pTip->nHeight >= nHeight);
+    }) && m_pTip && m_pTip->nHeight >= nHeight;
+}
+
+/**
+ * Processes the queued notifications in order, until the queue is stopped.
+ */
+void COmniBlockQueue::ThreadProcess()
+{
+    while (true) {
+        Item item;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cvItems.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_fStop || !m_items.empty(); });
+            if (m_fStop) break;
+            item = std::move(m_items.front());
+            m_items.pop_front();
+            if (item.pblock) --m_nBlockData;
+        }
+
+        if (item.fConnected) {
+            // the following blocks can't be processed, once a block is missing
+            if (!ProcessConnected(item)) break;
+        } else {
+            mastercore_handler_disc_begin(item.pBlockIndex->nHeight, item.pBlockIndex->GetBlockHash());
+        }
+    }
+}
+
+/**
+ * Processes a connected block, like the handlers called by ConnectTip().
+ *
+ * @return False, if the block couldn't be read, in which case the node is shut down
+ */
+bool COmniBlockQueue::ProcessConnected(const Item& item)
+{
+    const CBlockIndex* pBlockIndex = item.pBlockIndex;
+    {
+        LOCK(cs_main);
+        // a disconnection of the block follows in the queue
+        if (!::ChainActive().Contains(pBlockIndex)) return true;
+    }
+
+    const CBlockIndex* pTip;
+    {
+        LOCK(m_mutex);
+        pTip = m_pTip;
+    }
+    if (pTip) {
+        // blocks connected during the initial scan were already processed
+        if (pTip->GetAncestor(pBlockIndex->nHeight) == pBlockIndex) return true;
+        // the state doesn't end with the parent, so it's rolled back, before the block is processed
+        if (pBlockIndex->pprev != pTip) mastercore_handler_disc_begin(pTip->nHeight, pTip->GetBlockHash());
+    }
+
+    std::shared_ptr<const CBlock> pblock = item.pblock;
+    std::shared_ptr<std::map<COutPoint, Coin>> removedCoins = item.removedCoins;
+    if (!pblock) {
+        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+        if (!ReadBlockMapped(*pblockRead, pBlockIndex, Params().GetConsensus())) {
+            // the state would miss the block, so it's processed again by the initial scan after a restart
+            const std::string& msg = strprintf(
+                    "Shutting down due to a failure to read block %d (hash %s) for the Omni processing. "
+                    "Please restart, and if the block can't be read again, restart with -reindex.\n",
+                    pBlockIndex->nHeight, pBlockIndex->GetBlockHash().GetHex());
+            PrintToLog(msg);
+            AbortNode(msg, msg);
+            return false;
+        }
+        removedCoins = std::make_shared<std::map<COutPoint, Coin>>();
+        if (pblockRead->vtx.size() > 1 && !ReadSpentCoins(*pblockRead, pBlockIndex, *removedCoins)) {
+            removedCoins.reset();
+        }
+        pblock = pblockRead;
+    }
+
+    mastercore_handler_block_begin(pBlockIndex->nHeight - 1, pBlockIndex);
+    unsigned int nNumMetaTxs = mastercore_handler_block(*pblock, pBlockIndex, removedCoins);
+    mastercore_handler_block_end(pBlockIndex->nHeight, pBlockIndex, nNumMetaTxs);
+
+    return true;
+}
+}
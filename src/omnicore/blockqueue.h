@@ -0,0 +1,107 @@
+#ifndef BITCOIN_OMNICORE_BLOCKQUEUE_H
+#define BITCOIN_OMNICORE_BLOCKQUEUE_H
+
+class CBlock;
+class CBlockIndex;
+class COutPoint;
+class Coin;
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <thread>
+
+namespace mastercore
+{
+//! Default setting, whether connected blocks are processed by a dedicated Omni thread
+static const bool DEFAULT_OMNI_ASYNC = false;
+//! Number of queued blocks, which are held in memory, while later blocks are read from disk again
+static const size_t MAX_QUEUED_BLOCK_DATA = 64;
+
+/**
+ * Queues connected and disconnected blocks, which are processed strictly in order
+ * by a dedicated thread, so connecting a block doesn't wait for the Omni processing.
+ *
+ * The thread sees the same sequence of notifications as the synchronous handlers.
+ * Blocks, which were disconnected again before they were processed, are skipped,
+ * and blocks, which were already included by the initial scan, are skipped as well.
+ *
+ * The queue also tracks the last block processed by Omni Core, in both modes, so
+ * clients can wait for the Omni state to catch up with a block.
+ */
+class COmniBlockQueue
+{
+private:
+    struct Item
+    {
+        //! The connected block, or nullptr, if the block is read from disk or was disconnected
+        std::shared_ptr<const CBlock> pblock;
+        //! The outputs spent by the block, or nullptr
+        std::shared_ptr<std::map<COutPoint, Coin>> removedCoins;
+        //! The connected or disconnected block
+        const CBlockIndex* pBlockIndex;
+        bool fConnected;
+    };
+
+    mutable Mutex m_mutex;
+    std::condition_variable m_cvItems;
+    std::condition_variable m_cvProcessed;
+    std::deque<Item> m_items GUARDED_BY(m_mutex);
+    //! Number of queued items, whose block data is held in memory
+    size_t m_nBlockData GUARDED_BY(m_mutex);
+    //! The last block processed by Omni Core, or nullptr, if there is none
+    const CBlockIndex* m_pTip GUARDED_BY(m_mutex);
+    bool m_fStop GUARDED_BY(m_mutex);
+    std::thread m_thread;
+
+    void ThreadProcess();
+    bool ProcessConnected(const Item& item);
+
+public:
+    COmniBlockQueue();
+    ~COmniBlockQueue();
+
+    /** Returns whether blocks are queued, see -omniasync. The setting is read once. */
+    static bool IsEnabled();
+
+    /** Starts the thread, which processes the queued blocks. */
+    void Start();
+
+    /** Stops and joins the thread. Blocks still queued are processed by the next scan after a restart. */
+    void Stop();
+
+    /** Queues a block, after it was connected. */
+    void PushConnected(std::shared_ptr<const CBlock> pblock, const CBlockIndex* pBlockIndex, std::shared_ptr<std::map<COutPoint, Coin>> removedCoins);
+
+    /** Queues the disconnection of a block. */
+    void PushDisconnected(const CBlockIndex* pBlockIndex);
+
+    /** Returns the number of queued notifications. */
+    size_t Size() const;
+
+    /** Records the last block processed by Omni Core, and wakes up waiting clients. */
+    void SetTip(const CBlockIndex* pBlockIndex);
+
+    /** Returns the height and hash of the last block processed by Omni Core, or -1, if there is none. */
+    int GetTip(uint256& hashBlock) const;
+
+    /**
+     * Waits, until a block of at least the given height was processed, the timeout passed,
+     * or the queue was stopped.
+     *
+     * @return True, if a block of the given height was processed
+     */
+    bool WaitForHeight(int nHeight, std::chrono::milliseconds timeout);
+};
+
+//! Blocks waiting for the Omni processing, and the last block processed
+extern COmniBlockQueue omniBlockQueue;
+}
+
+#endif // BITCOIN_OMNICORE_BLOCKQUEUE_H
@@ -0,0 +1,283 @@
+/**
+ * @file bootstrap.cpp
+ *
+ * This file contains the dumping and loading of verified snapshots of the state,
+ * which let new nodes start at a recent block instead of parsing from the
+ * Omni genesis block.
+ */
+
+#include <omnicore/bootstrap.h>
+
+#include <omnicore/blockqueue.h>
+#include <omnicore/consensushash.h>
+#include <omnicore/dbbase.h>
+#include <omnicore/log.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/persistence.h>
+#include <omnicore/rules.h>
+#include <omnicore/snapshot.h>
+#include <omnicore/statefile.h>
+
+#include <chain.h>
+#include <fs.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <leveldb/db.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace mastercore;
+
+//! Type of the snapshot files
+static const uint8_t FILETYPE_SNAPSHOT = 0x10;
+//! Number of database entries per record of a snapshot file
+static const size_t SNAPSHOT_ENTRIES_PER_RECORD = 10000;
+//! Maximum time to wait for the block in progress, before the dump fails
+static const int64_t MAX_DUMP_WAIT_MILLIS = 60 * 1000;
+
+typedef std::vector<std::pair<std::string, std::string> > SnapshotEntries;
+
+/**
+ * Writes a snapshot of the state after the last processed block to a file.
+ *
+ * Layout: a header with the block, the consensus hash and the number of state
+ * files, followed by one record per state file, and the entries of the databases
+ * in records of up to SNAPSHOT_ENTRIES_PER_RECORD entries, tagged with the name of
+ * their database.
+ */
+bool mastercore::DumpStateSnapshot(const fs::path& path, SnapshotSummary& summary, std::string& strError)
+{
+    std::vector<std::pair<uint8_t, std::vector<unsigned char> > > vParts;
+    std::vector<std::pair<const CDBBase*, std::shared_ptr<const leveldb::Snapshot> > > vDatabases;
+
+    // the state files and the database snapshots must reflect the same block, so a block in progress is awaited
+    const int64_t nTimeStart = GetTimeMillis();
+    while (true) {
+        {
+            LOCK(cs_tally);
+            if (!IsBlockInProgress()) {
+                for (const CDBBase* pdb : GetStateDatabases()) {
+                    if (pdb->IsBulkLoad()) {
+                        strError = "the initial scan is in progress";
+                        return false;
+                    }
+                    vDatabases.emplace_back(pdb, pdb->GetPublishedSnapshot());
+                }
+                summary.nBlock = omniBlockQueue.GetTip(summary.hashBlock);
+                if (summary.nBlock < 0) {
+                    strError = "no block was processed yet";
+                    return false;
+                }
+                summary.consensusHash = GetConsensusHash();
+                for (int what = 0; what < NUM_FILETYPES; ++what) {
+                    vParts.emplace_back(what, BuildStateFile(what));
+                }
+                break;
+            }
+        }
+        if (GetTimeMillis() - nTimeStart > MAX_DUMP_WAIT_MILLIS) {
+            strError = "timed out waiting for the block in progress";
+            return false;
+        }
+        UninterruptibleSleep(std::chrono::milliseconds{10});
+    }
+
+    const fs::path tmpPath = path.string() + ".incomplete";
+    CStateFileStreamWriter writer(tmpPath, FILETYPE_SNAPSHOT);
+    if (!writer.IsOpen()) {
+        strError = "unable to create " + tmpPath.string();
+        return false;
+    }
+
+    writer.WriteRecord(VARBLOCK(summary.nBlock), summary.hashBlock, summary.consensusHash, VARINT(static_cast<uint32_t>(vParts.size())));
+    for (const auto& part : vParts) {
+        writer.WriteRecord(part.first, part.second);
+    }
+
+    SnapshotEntries vEntries;
+    for (const auto& database : vDatabases) {
+        const std::string strName = database.first->GetName();
+        const bool fComplete = database.first->ForEachEntry(database.second, [&](const leveldb::Slice& key, const leveldb::Slice& value) {
+            vEntries.emplace_back(key.ToString(), value.ToString());
+            if (vEntries.size() >= SNAPSHOT_ENTRIES_PER_RECORD) {
+                writer.WriteRecord(strName, vEntries);
+                summary.nEntries += vEntries.size();
+                vEntries.clear();
+            }
+            return true;
+        });
+        if (!fComplete) {
+            strError = "failed to read " + strName;
+            fs::remove(tmpPath);
+            return false;
+        }
+        if (!vEntries.empty()) {
+            writer.WriteRecord(strName, vEntries);
+            summary.nEntries += vEntries.size();
+            vEntries.clear();
+        }
+    }
+
+    if (!writer.Finish() || !RenameOver(tmpPath, path)) {
+        strError = "failed to write " + path.string();
+        fs::remove(tmpPath);
+        return false;
+    }
+
+    PrintToLog("%s(): dumped the state of block %d with %d database entries to %s\n", __func__, summary.nBlock, summary.nEntries, path.string());
+
+    return true;
+}
+
+/** Clears the state databases, so a rejected snapshot doesn't leave parts of it behind. */
+static void ClearStateDatabases() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    for (CDBBase* pdb : GetStateDatabases()) {
+        pdb->Clear();
+    }
+}
+
+/**
+ * Replaces the empty state with a snapshot, and stores it as the persisted state of its block.
+ *
+ * The consensus hash is checked against the header first, so a snapshot of another
+ * block or chain is rejected before anything is loaded.
+ */
+bool mastercore::LoadStateSnapshot(const fs::path& path, const uint256& hashPinned, SnapshotSummary& summary, std::string& strError)
+{
+    CMappedStateFile mapped(path);
+    if (!mapped.IsOpen()) {
+        strError = "unable to open " + path.string();
+        return false;
+    }
+    CStateFileReader reader(mapped.data(), mapped.size());
+    if (!reader.IsValid() || reader.GetType() != FILETYPE_SNAPSHOT) {
+        strError = path.string() + " is not a valid snapshot";
+        return false;
+    }
+
+    uint32_t nParts = 0;
+    if (!reader.ReadRecord(VARBLOCK(summary.nBlock), summary.hashBlock, summary.consensusHash, VARINT(nParts))) {
+        strError = "failed to decode the header of the snapshot";
+        return false;
+    }
+
+    // the expected consensus hash is pinned by the operator, or the one of the checkpoint at the block
+    uint256 hashExpected = hashPinned;
+    for (const ConsensusCheckpoint& checkpoint : ConsensusParams().GetCheckpoints()) {
+        if (checkpoint.blockHeight != summary.nBlock) continue;
+        if (checkpoint.blockHash != summary.hashBlock) {
+            strError = strprintf("the block of the snapshot doesn't match the checkpoint at block %d", summary.nBlock);
+            return false;
+        }
+        if (!hashExpected.IsNull() && hashExpected != checkpoint.consensusHash) {
+            strError = strprintf("the pinned consensus hash doesn't match the checkpoint at block %d", summary.nBlock);
+            return false;
+        }
+        hashExpected = checkpoint.consensusHash;
+    }
+    if (hashExpected.IsNull()) {
+        strError = strprintf("there is no checkpoint at block %d, so the consensus hash of the snapshot must be pinned with -omnisnapshothash", summary.nBlock);
+        return false;
+    }
+    if (summary.consensusHash != hashExpected) {
+        strError = strprintf("the consensus hash %s of the snapshot doesn't match %s", summary.consensusHash.GetHex(), hashExpected.GetHex());
+        return false;
+    }
+
+    const CBlockIndex* pBlockIndex;
+    {
+        LOCK(cs_main);
+        pBlockIndex = LookupBlockIndex(summary.hashBlock);
+        if (!pBlockIndex || pBlockIndex->nHeight != summary.nBlock || !::ChainActive().Contains(pBlockIndex)) {
+            strError = strprintf("block %d of the snapshot is not in the active chain", summary.nBlock);
+            return false;
+        }
+    }
+
+    std::vector<std::pair<uint8_t, std::vector<unsigned char> > > vParts;
+    for (uint32_t n = 0; n < nParts; ++n) {
+        uint8_t what;
+        std::vector<unsigned char> vchPart;
+        if (!reader.ReadRecord(what, vchPart)) {
+            strError = "failed to decode the state files of the snapshot";
+            return false;
+        }
+        vParts.emplace_back(what, std::move(vchPart));
+    }
+
+    LOCK(cs_tally);
+
+    std::map<std::string, CDBBase*> mapDatabases;
+    for (CDBBase* pdb : GetStateDatabases()) {
+        pdb->Clear();
+        mapDatabases[pdb->GetName()] = pdb;
+    }
+
+    // entries of databases, which are disabled on this node, are skipped
+    std::string strName;
+    SnapshotEntries vEntries;
+    std::vector<CDBWrite> vWrites;
+    while (!reader.AtEnd()) {
+        if (!reader.ReadRecord(strName, vEntries)) {
+            strError = "failed to decode the database entries of the snapshot";
+            ClearStateDatabases();
+            return false;
+        }
+        auto it = mapDatabases.find(strName);
+        if (it == mapDatabases.end()) continue;
+
+        vWrites.clear();
+        for (auto& entry : vEntries) {
+            vWrites.emplace_back(std::move(entry.first), std::make_shared<const std::string>(std::move(entry.second)));
+        }
+        if (!it->second->ApplyWrites(vWrites).ok()) {
+            strError = "failed to write " + strName;
+            ClearStateDatabases();
+            return false;
+        }
+        summary.nEntries += vWrites.size();
+    }
+
+    for (const auto& part : vParts) {
+        if (RestoreInMemoryStateFromBuffer(part.second, part.first) < 0) {
+            strError = strprintf("failed to load state file %d of the snapshot", part.first);
+            ClearStateDatabases();
+            return false;
+        }
+    }
+
+    // the consensus hash reads the properties as of the last processed block
+    for (const auto& database : mapDatabases) {
+        database.second->PublishSnapshot();
+    }
+
+    const uint256 consensusHash = GetConsensusHash();
+    if (consensusHash != hashExpected) {
+        strError = strprintf("the consensus hash %s of the loaded state doesn't match %s", consensusHash.GetHex(), hashExpected.GetHex());
+        ClearStateDatabases();
+        return false;
+    }
+
+    if (PersistInMemoryState(pBlockIndex) < 0) {
+        strError = "failed to store the state of the snapshot";
+        ClearStateDatabases();
+        return false;
+    }
+
+    PrintToLog("%s(): loaded the state of block %d with %d database entries from %s\n", __func__, summary.nBlock, summary.nEntries, path.string());
+
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef BITCOIN_OMNICORE_BOOTSTRAP_H
+#define BITCOIN_OMNICORE_BOOTSTRAP_H
+
+#include <omnicore/timedmutex.h>
+
+#include <fs.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <string>
+
+extern CTimedRecursiveMutex cs_tally;
+
+namespace mastercore
+{
+/** Summary of a dumped or loaded snapshot of the state. */
+struct SnapshotSummary
+{
+    int nBlock;
+    uint256 hashBlock;
+    //! The consensus hash of the state, as verified by the checkpoints
+    uint256 consensusHash;
+    //! Number of database entries
+    uint64_t nEntries;
+
+    SnapshotSummary() : nBlock(-1), nEntries(0) {}
+};
+
+/**
+ * Writes a snapshot of the state after the last processed block to a file.
+ *
+ * The snapshot holds the state files of the in-memory state, the entries of the
+ * state databases and the consensus hash. The state files are built and the
+ * databases are pinned at a block boundary, and the entries are written without
+ * holding cs_tally, so block processing is not paused for long.
+ *
+ * @param path      The file to create
+ * @param summary   The block, consensus hash and number of entries of the snapshot
+ * @param strError  The reason, if the dump failed
+ * @return True, if the snapshot was written
+ */
+bool DumpStateSnapshot(const fs::path& path, SnapshotSummary& summary, std::string& strError) LOCKS_EXCLUDED(cs_tally);
+
+/**
+ * Replaces the empty state with a snapshot, and stores it as the persisted state of its block.
+ *
+ * The block of the snapshot must be in the active chain. The consensus hash of the
+ * loaded state must match the one pinned by the operator, or the checkpoint at the
+ * block, if there is one, and a snapshot, which can't be verified, is rejected.
+ * The state databases are cleared, if the snapshot is rejected after loading it.
+ *
+ * @param path         The snapshot file
+ * @param hashPinned   The expected consensus hash, or null to rely on the checkpoints
+ * @param summary      The block, consensus hash and number of entries of the snapshot
+ * @param strError     The reason, if the snapshot was rejected
+ * @return True, if the snapshot was loaded and verified
+ */
+bool LoadStateSnapshot(const fs::path& path, const uint256& hashPinned, SnapshotSummary& summary, std::string& strError) LOCKS_EXCLUDED(cs_tally);
+}
+
+#endif // BITCOIN_OMNICORE_BOOTSTRAP_H
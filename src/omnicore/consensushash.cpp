@@ -11,19 +11,30 @@
 #include <omnicore/log.h>
 #include <omnicore/parse_string.h>
 #include <omnicore/sp.h>
+#include <omnicore/statecommitment.h>
+#include <omnicore/statescan.h>
+#include <omnicore/workerpool.h>
 
 #include <arith_uint256.h>
+#include <crypto/sha256.h>
 #include <uint256.h>
 
+#include <assert.h>
 #include <stdint.h>
 #include <algorithm>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <streambuf>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace mastercore
 {
 bool ShouldConsensusHashBlock(int block) {
-    if (msc_debug_consensus_hash_every_block) {
+    if (OMNI_VERBOSE_LOG && msc_debug_consensus_hash_every_block) {
         return true;
     }
 
@@ -43,57 +54,303 @@ bool ShouldConsensusHashBlock(int block) {
     return false;
 }
 
-// Generates a consensus string for hashing based on a tally object
-std::string GenerateConsensusString(const CMPTally& tallyObj, const std::string& address, const uint32_t propertyId)
+/**
+ * Sorts address identifiers alphabetically by address.
+ */
+static void SortByAddress(std::vector<uint32_t>& vIds) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    std::sort(vIds.begin(), vIds.end(), [](uint32_t a, uint32_t b) {
+        return mp_tally_map.GetAddress(a) < mp_tally_map.GetAddress(b);
+    });
+}
+
+/**
+ * Returns the identifiers of all addresses with balance records, sorted alphabetically by address.
+ */
+static std::vector<uint32_t> GetAddressIdsSorted() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    std::vector<uint32_t> vIds;
+    vIds.reserve(mp_tally_map.size());
+    for (CMPTallyMap::iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
+        // addresses without any balances don't contribute, and aren't sorted
+        if ((*it).second.empty()) continue;
+        vIds.push_back(it.id());
+    }
+    SortByAddress(vIds);
+    return vIds;
+}
+
+/**
+ * Output stream buffer, which feeds the written bytes into a SHA256 context.
+ *
+ * The consensus data is formatted straight into the hasher, without creating a string per entry.
+ */
+class CSHA256StreamBuf : public std::streambuf
 {
-    int64_t balance = tallyObj.getMoney(propertyId, BALANCE);
-    int64_t sellOfferReserve = tallyObj.getMoney(propertyId, SELLOFFER_RESERVE);
-    int64_t acceptReserve = tallyObj.getMoney(propertyId, ACCEPT_RESERVE);
-    int64_t metaDExReserve = tallyObj.getMoney(propertyId, METADEX_RESERVE);
+private:
+    CSHA256& m_hasher;
+    char m_buffer[256];
+
+    void Flush()
+    {
+        m_hasher.Write(reinterpret_cast<const unsigned char*>(pbase()), pptr() - pbase());
+        setp(m_buffer, m_buffer + sizeof(m_buffer));
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        Flush();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override
+    {
+        Flush();
+        return 0;
+    }
 
-    // return a blank string if all balances are empty
-    if (!balance && !sellOfferReserve && !acceptReserve && !metaDExReserve) return "";
+public:
+    explicit CSHA256StreamBuf(CSHA256& hasher) : m_hasher(hasher) { setp(m_buffer, m_buffer + sizeof(m_buffer)); }
+    ~CSHA256StreamBuf() { Flush(); }
+};
 
-    return strprintf("%s|%d|%d|%d|%d|%d",
+// Writes the consensus data of the balances of an address, and returns false, if all balances are empty
+static bool WriteConsensusData(std::ostream& os, const std::string& address, const uint32_t propertyId, int64_t balance,
+        int64_t sellOfferReserve, int64_t acceptReserve, int64_t metaDExReserve)
+{
+    // write nothing, if all balances are empty
+    if (!balance && !sellOfferReserve && !acceptReserve && !metaDExReserve) return false;
+
+    tfm::format(os, "%s|%d|%d|%d|%d|%d",
             address, propertyId, balance, sellOfferReserve, acceptReserve, metaDExReserve);
+    return true;
 }
 
-// Generates a consensus string for hashing based on a DEx sell offer object
-std::string GenerateConsensusString(const CMPOffer& offerObj, const std::string& address)
+// Writes the consensus data of a tally object, and returns false, if all balances are empty
+static bool WriteConsensusData(std::ostream& os, const CMPTally& tallyObj, const std::string& address, const uint32_t propertyId)
 {
-    return strprintf("%s|%s|%d|%d|%d|%d|%d",
+    return WriteConsensusData(os, address, propertyId, tallyObj.getMoney(propertyId, BALANCE),
+            tallyObj.getMoney(propertyId, SELLOFFER_RESERVE), tallyObj.getMoney(propertyId, ACCEPT_RESERVE),
+            tallyObj.getMoney(propertyId, METADEX_RESERVE));
+}
+
+// Writes the consensus data of a DEx sell offer object
+static void WriteConsensusData(std::ostream& os, const CMPOffer& offerObj, const std::string& address)
+{
+    tfm::format(os, "%s|%s|%d|%d|%d|%d|%d",
             offerObj.getHash().GetHex(), address, offerObj.getProperty(), offerObj.getOfferAmountOriginal(),
             offerObj.getBTCDesiredOriginal(), offerObj.getMinFee(), offerObj.getBlockTimeLimit());
 }
 
-// Generates a consensus string for hashing based on a DEx accept object
-std::string GenerateConsensusString(const CMPAccept& acceptObj, const std::string& address)
+// Writes the consensus data of a DEx accept object
+static void WriteConsensusData(std::ostream& os, const CMPAccept& acceptObj, const std::string& address)
 {
-    return strprintf("%s|%s|%d|%d|%d",
+    tfm::format(os, "%s|%s|%d|%d|%d",
             acceptObj.getHash().GetHex(), address, acceptObj.getAcceptAmount(), acceptObj.getAcceptAmountRemaining(),
             acceptObj.getAcceptBlock());
 }
 
-// Generates a consensus string for hashing based on a MetaDEx object
-std::string GenerateConsensusString(const CMPMetaDEx& tradeObj)
+// Writes the consensus data of a MetaDEx object
+static void WriteConsensusData(std::ostream& os, const CMPMetaDEx& tradeObj)
 {
-    return strprintf("%s|%s|%d|%d|%d|%d|%d",
+    tfm::format(os, "%s|%s|%d|%d|%d|%d|%d",
             tradeObj.getHash().GetHex(), tradeObj.getAddr(), tradeObj.getProperty(), tradeObj.getAmountForSale(),
             tradeObj.getDesProperty(), tradeObj.getAmountDesired(), tradeObj.getAmountRemaining());
 }
 
-// Generates a consensus string for hashing based on a crowdsale object
-std::string GenerateConsensusString(const CMPCrowd& crowdObj)
+// Writes the consensus data of a crowdsale object
+static void WriteConsensusData(std::ostream& os, const CMPCrowd& crowdObj)
 {
-    return strprintf("%d|%d|%d|%d|%d",
+    tfm::format(os, "%d|%d|%d|%d|%d",
             crowdObj.getPropertyId(), crowdObj.getCurrDes(), crowdObj.getDeadline(), crowdObj.getUserCreated(),
             crowdObj.getIssuerCreated());
 }
 
+// Writes the consensus data of a property issuer
+static void WriteConsensusData(std::ostream& os, const uint32_t propertyId, const std::string& address)
+{
+    tfm::format(os, "%d|%s", propertyId, address);
+}
+
+// Generates a consensus string for hashing based on a tally object
+std::string GenerateConsensusString(const CMPTally& tallyObj, const std::string& address, const uint32_t propertyId)
+{
+    std::ostringstream ss;
+    WriteConsensusData(ss, tallyObj, address, propertyId);
+    return ss.str();
+}
+
+// Generates a consensus string for hashing based on a DEx sell offer object
+std::string GenerateConsensusString(const CMPOffer& offerObj, const std::string& address)
+{
+    std::ostringstream ss;
+    WriteConsensusData(ss, offerObj, address);
+    return ss.str();
+}
+
+// Generates a consensus string for hashing based on a DEx accept object
+std::string GenerateConsensusString(const CMPAccept& acceptObj, const std::string& address)
+{
+    std::ostringstream ss;
+    WriteConsensusData(ss, acceptObj, address);
+    return ss.str();
+}
+
+// Generates a consensus string for hashing based on a MetaDEx object
+std::string GenerateConsensusString(const CMPMetaDEx& tradeObj)
+{
+    std::ostringstream ss;
+    WriteConsensusData(ss, tradeObj);
+    return ss.str();
+}
+
+// Generates a consensus string for hashing based on a crowdsale object
+std::string GenerateConsensusString(const CMPCrowd& crowdObj)
+{
+    std::ostringstream ss;
+    WriteConsensusData(ss, crowdObj);
+    return ss.str();
+}
+
 // Generates a consensus string for hashing based on a property issuer
 std::string GenerateConsensusString(const uint32_t propertyId, const std::string& address)
 {
-    return strprintf("%d|%s", propertyId, address);
+    std::ostringstream ss;
+    WriteConsensusData(ss, propertyId, address);
+    return ss.str();
+}
+
+/** Returns the open MetaDEx orders of all (default) or a specific property for sale, ordered by txid. */
+static std::vector<const CMPMetaDEx*> GetMetaDExOrdersSorted(const uint32_t propertyId) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    std::vector<std::pair<arith_uint256, const CMPMetaDEx*> > vOrders;
+    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        if (propertyId != 0 && propertyId != my_it->first.first) continue;
+        const md_PricesMap& prices = my_it->second;
+        for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+            for (const CMPMetaDEx& order : it->second) {
+                vOrders.push_back(std::make_pair(UintToArith256(order.getHash()), &order));
+            }
+        }
+    }
+    std::sort(vOrders.begin(), vOrders.end());
+
+    std::vector<const CMPMetaDEx*> vSorted;
+    vSorted.reserve(vOrders.size());
+    for (const auto& order : vOrders) {
+        vSorted.push_back(order.second);
+    }
+    return vSorted;
+}
+
+/** Writes the consensus data of a section of the consensus hash. */
+static void WriteConsensusSection(std::ostream& os, ConsensusHashSection section) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    switch (section) {
+    case SECTION_BALANCES:
+        // Balances - loop through the tally map, updating the sha context with the data from each balance and tally type
+        // Placeholders:  "address|propertyid|balance|selloffer_reserve|accept_reserve|metadex_reserve"
+        // Sort alphabetically first, without copying the tallies
+        for (uint32_t addressId : GetAddressIdsSorted()) {
+            const std::string& address = mp_tally_map.GetAddress(addressId);
+            const CMPTally& tally = *mp_tally_map.Get(addressId);
+            for (uint32_t propertyId : tally) {
+                if (!WriteConsensusData(os, tally, address, propertyId)) continue; // skip empty balances
+                PrintToLogVerbose(msc_debug_consensus_hash, "Adding balance data to consensus hash: %s\n", GenerateConsensusString(tally, address, propertyId));
+            }
+        }
+        break;
+
+    case SECTION_DEX_OFFERS: {
+        // DEx sell offers - loop through the DEx and add each sell offer to the consensus hash (ordered by txid)
+        // Placeholders: "txid|address|propertyid|offeramount|btcdesired|minfee|timelimit"
+        std::vector<std::pair<arith_uint256, const OfferMap::value_type*> > vecDExOffers;
+        for (OfferMap::const_iterator it = my_offers.begin(); it != my_offers.end(); ++it) {
+            vecDExOffers.push_back(std::make_pair(UintToArith256(it->second.getHash()), &*it));
+        }
+        std::sort(vecDExOffers.begin(), vecDExOffers.end());
+        for (const auto& entry : vecDExOffers) {
+            const CMPOffer& selloffer = entry.second->second;
+            // the seller is derived from the legacy key, which keeps a part of property identifiers above 9
+            const std::string sellCombo = entry.second->first.ToString();
+            std::string seller = sellCombo.substr(0, sellCombo.size() - 2);
+            WriteConsensusData(os, selloffer, seller);
+            PrintToLogVerbose(msc_debug_consensus_hash, "Adding DEx offer data to consensus hash: %s\n", GenerateConsensusString(selloffer, seller));
+        }
+        break;
+    }
+
+    case SECTION_DEX_ACCEPTS: {
+        // DEx accepts - loop through the accepts map and add each accept to the consensus hash (ordered by matchedtxid then buyer)
+        // Placeholders: "matchedselloffertxid|buyer|acceptamount|acceptamountremaining|acceptblock"
+        std::vector<std::pair<std::string, const AcceptMap::value_type*> > vecAccepts;
+        for (AcceptMap::const_iterator it = my_accepts.begin(); it != my_accepts.end(); ++it) {
+            std::string sortKey = strprintf("%s-%s", it->second.getHash().GetHex(), it->first.buyer);
+            vecAccepts.push_back(std::make_pair(sortKey, &*it));
+        }
+        std::sort(vecAccepts.begin(), vecAccepts.end());
+        for (const auto& entry : vecAccepts) {
+            const CMPAccept& accept = entry.second->second;
+            const std::string& buyer = entry.second->first.buyer;
+            WriteConsensusData(os, accept, buyer);
+            PrintToLogVerbose(msc_debug_consensus_hash, "Adding DEx accept to consensus hash: %s\n", GenerateConsensusString(accept, buyer));
+        }
+        break;
+    }
+
+    case SECTION_METADEX_ORDERS:
+        // MetaDEx trades - loop through the MetaDEx maps and add each open trade to the consensus hash (ordered by txid)
+        // Placeholders: "txid|address|propertyidforsale|amountforsale|propertyiddesired|amountdesired|amountremaining"
+        for (const CMPMetaDEx* pOrder : GetMetaDExOrdersSorted(0)) {
+            WriteConsensusData(os, *pOrder);
+            PrintToLogVerbose(msc_debug_consensus_hash, "Adding MetaDEx trade data to consensus hash: %s\n", GenerateConsensusString(*pOrder));
+        }
+        break;
+
+    case SECTION_CROWDSALES: {
+        // Crowdsales - loop through open crowdsales and add to the consensus hash (ordered by property ID)
+        // Note: the variables of the crowdsale (amount, bonus etc) are not part of the crowdsale map and not included here to
+        // avoid additionalal loading of SP entries from the database
+        // Placeholders: "propertyid|propertyiddesired|deadline|usertokens|issuertokens"
+        std::vector<std::pair<uint32_t, const CMPCrowd*> > vecCrowds;
+        for (CrowdMap::const_iterator it = my_crowds.begin(); it != my_crowds.end(); ++it) {
+            vecCrowds.push_back(std::make_pair(it->second.getPropertyId(), &it->second));
+        }
+        std::sort(vecCrowds.begin(), vecCrowds.end());
+        for (const auto& entry : vecCrowds) {
+            WriteConsensusData(os, *entry.second);
+            PrintToLogVerbose(msc_debug_consensus_hash, "Adding Crowdsale entry to consensus hash: %s\n", GenerateConsensusString(*entry.second));
+        }
+        break;
+    }
+
+    case SECTION_PROPERTIES:
+        // Properties - loop through each property and store the issuer (to capture state changes via change issuer transactions)
+        // Note: we are loading every SP from the DB to check the issuer, if using consensus_hash_every_block debug option this
+        //       will slow things down dramatically.  Not an issue to do it once every 10,000 blocks for checkpoint verification.
+        // Placeholders: "propertyid|issueraddress"
+        for (uint8_t ecosystem = 1; ecosystem <= 2; ecosystem++) {
+            uint32_t startPropertyId = (ecosystem == 1) ? 1 : TEST_ECO_PROPERTY_1;
+            for (uint32_t propertyId = startPropertyId; propertyId < pDbSpInfo->peekNextSPID(ecosystem); propertyId++) {
+                CMPSPInfo::Entry sp;
+                if (!pDbSpInfo->getSP(propertyId, sp)) {
+                    PrintToLog("Error loading property ID %d for consensus hashing, hash should not be trusted!\n");
+                    continue;
+                }
+                WriteConsensusData(os, propertyId, sp.issuer);
+                PrintToLogVerbose(msc_debug_consensus_hash, "Adding property to consensus hash: %s\n", GenerateConsensusString(propertyId, sp.issuer));
+            }
+        }
+        break;
+
+    default:
+        assert(false);
+    }
 }
 
 /**
@@ -148,192 +405,442 @@ std::string GenerateConsensusString(const uint32_t propertyId, const std::string
 uint256 GetConsensusHash()
 {
     CSHA256 hasher;
+    CSHA256StreamBuf buf(hasher);
+    std::ostream os(&buf);
 
     LOCK(cs_tally);
 
-    if (msc_debug_consensus_hash) PrintToLog("Beginning generation of current consensus hash...\n");
+    PrintToLogVerbose(msc_debug_consensus_hash, "Beginning generation of current consensus hash...\n");
 
-    // Balances - loop through the tally map, updating the sha context with the data from each balance and tally type
-    // Placeholders:  "address|propertyid|balance|selloffer_reserve|accept_reserve|metadex_reserve"
-    // Sort alphabetically first
-    std::map<std::string, CMPTally> tallyMapSorted;
-    for (std::unordered_map<std::string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
-        tallyMapSorted.insert(std::make_pair(uoit->first,uoit->second));
-    }
-    for (std::map<std::string, CMPTally>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
-        const std::string& address = my_it->first;
-        CMPTally& tally = my_it->second;
-        tally.init();
-        uint32_t propertyId = 0;
-        while (0 != (propertyId = (tally.next()))) {
-            std::string dataStr = GenerateConsensusString(tally, address, propertyId);
-            if (dataStr.empty()) continue; // skip empty balances
-            if (msc_debug_consensus_hash) PrintToLog("Adding balance data to consensus hash: %s\n", dataStr);
-            hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
-        }
+    // the sections are hashed one after another with a single context
+    for (int section = 0; section < SECTION_COUNT; ++section) {
+        WriteConsensusSection(os, static_cast<ConsensusHashSection>(section));
     }
 
-    // DEx sell offers - loop through the DEx and add each sell offer to the consensus hash (ordered by txid)
-    // Placeholders: "txid|address|propertyid|offeramount|btcdesired|minfee|timelimit"
-    std::vector<std::pair<arith_uint256, std::string> > vecDExOffers;
-    for (OfferMap::iterator it = my_offers.begin(); it != my_offers.end(); ++it) {
-        const CMPOffer& selloffer = it->second;
-        const std::string& sellCombo = it->first;
-        std::string seller = sellCombo.substr(0, sellCombo.size() - 2);
-        std::string dataStr = GenerateConsensusString(selloffer, seller);
-        vecDExOffers.push_back(std::make_pair(arith_uint256(selloffer.getHash().ToString()), dataStr));
-    }
-    std::sort (vecDExOffers.begin(), vecDExOffers.end());
-    for (std::vector<std::pair<arith_uint256, std::string> >::iterator it = vecDExOffers.begin(); it != vecDExOffers.end(); ++it) {
-        const std::string& dataStr = it->second;
-        if (msc_debug_consensus_hash) PrintToLog("Adding DEx offer data to consensus hash: %s\n", dataStr);
-        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
-    }
+    // extract the final result and return the hash
+    os.flush();
+    uint256 consensusHash;
+    hasher.Finalize(consensusHash.begin());
+    PrintToLogVerbose(msc_debug_consensus_hash, "Finished generation of consensus hash.  Result: %s\n", consensusHash.GetHex());
 
-    // DEx accepts - loop through the accepts map and add each accept to the consensus hash (ordered by matchedtxid then buyer)
-    // Placeholders: "matchedselloffertxid|buyer|acceptamount|acceptamountremaining|acceptblock"
-    std::vector<std::pair<std::string, std::string> > vecAccepts;
-    for (AcceptMap::const_iterator it = my_accepts.begin(); it != my_accepts.end(); ++it) {
-        const CMPAccept& accept = it->second;
-        const std::string& acceptCombo = it->first;
-        std::string buyer = acceptCombo.substr((acceptCombo.find("+") + 1), (acceptCombo.size()-(acceptCombo.find("+") + 1)));
-        std::string dataStr = GenerateConsensusString(accept, buyer);
-        std::string sortKey = strprintf("%s-%s", accept.getHash().GetHex(), buyer);
-        vecAccepts.push_back(std::make_pair(sortKey, dataStr));
-    }
-    std::sort (vecAccepts.begin(), vecAccepts.end());
-    for (std::vector<std::pair<std::string, std::string> >::iterator it = vecAccepts.begin(); it != vecAccepts.end(); ++it) {
-        const std::string& dataStr = it->second;
-        if (msc_debug_consensus_hash) PrintToLog("Adding DEx accept to consensus hash: %s\n", dataStr);
-        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
-    }
+    return consensusHash;
+}
 
-    // MetaDEx trades - loop through the MetaDEx maps and add each open trade to the consensus hash (ordered by txid)
-    // Placeholders: "txid|address|propertyidforsale|amountforsale|propertyiddesired|amountdesired|amountremaining"
-    std::vector<std::pair<arith_uint256, std::string> > vecMetaDExTrades;
-    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        const md_PricesMap& prices = my_it->second;
-        for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
-            const md_Set& indexes = it->second;
-            for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                const CMPMetaDEx& obj = *it;
-                std::string dataStr = GenerateConsensusString(obj);
-                vecMetaDExTrades.push_back(std::make_pair(arith_uint256(obj.getHash().ToString()), dataStr));
+/**
+ * Obtains the same hash as GetConsensusHash(), but releases cs_tally between chunks of the
+ * balances and MetaDEx orders, so block processing waits for one chunk at most.
+ *
+ * The addresses and orders are copied in chunks, and sorted and hashed without holding the
+ * lock. The hash starts over, if the state is modified in the meantime. The crowdsales and
+ * properties are hashed by the last chunk, so issuer changes, which don't change the state
+ * generation, can't be mixed with an earlier state.
+ */
+uint256 GetConsensusHashYielding()
+{
+    enum Stage { COLLECT_ADDRESSES, SORT_ADDRESSES, WRITE_BALANCES, COLLECT_ORDERS, WRITE_ORDERS, WRITE_REMAINING };
+
+    CSHA256 hasher;
+    CSHA256StreamBuf buf(hasher);
+    std::ostream os(&buf);
+
+    Stage stage = COLLECT_ADDRESSES;
+    CTallyCursor tallyCursor;
+    CMetaDExCursor orderCursor;
+    // addresses with balance records and their identifiers, which are valid until the state is modified
+    std::vector<std::pair<std::string, uint32_t> > vAddresses;
+    std::vector<std::pair<arith_uint256, CMPMetaDEx> > vOrders;
+    size_t nNextAddress = 0;
+
+    PrintToLogVerbose(msc_debug_consensus_hash, "Beginning generation of current consensus hash in chunks...\n");
+
+    auto fnChunk = [&]() EXCLUSIVE_LOCKS_REQUIRED(cs_tally) {
+        switch (stage) {
+        case COLLECT_ADDRESSES:
+            if (!tallyCursor.Next(STATE_SCAN_CHUNK_SIZE, [&vAddresses](uint32_t id, const std::string& address, const CMPTally& tally) {
+                    // addresses without any balances don't contribute
+                    if (!tally.empty()) vAddresses.emplace_back(address, id);
+                })) {
+                stage = SORT_ADDRESSES;
             }
+            return true;
+
+        case WRITE_BALANCES: {
+            const size_t nEnd = std::min(vAddresses.size(), nNextAddress + STATE_SCAN_CHUNK_SIZE);
+            for (; nNextAddress < nEnd; ++nNextAddress) {
+                const std::string& address = vAddresses[nNextAddress].first;
+                const CMPTally& tally = *mp_tally_map.Get(vAddresses[nNextAddress].second);
+                for (uint32_t propertyId : tally) {
+                    if (!WriteConsensusData(os, tally, address, propertyId)) continue; // skip empty balances
+                    PrintToLogVerbose(msc_debug_consensus_hash, "Adding balance data to consensus hash: %s\n", GenerateConsensusString(tally, address, propertyId));
+                }
+            }
+            if (nNextAddress == vAddresses.size()) {
+                // there are few DEx offers and accepts, which are hashed at once
+                WriteConsensusSection(os, SECTION_DEX_OFFERS);
+                WriteConsensusSection(os, SECTION_DEX_ACCEPTS);
+                stage = COLLECT_ORDERS;
+            }
+            return true;
         }
-    }
-    std::sort (vecMetaDExTrades.begin(), vecMetaDExTrades.end());
-    for (std::vector<std::pair<arith_uint256, std::string> >::iterator it = vecMetaDExTrades.begin(); it != vecMetaDExTrades.end(); ++it) {
-        const std::string& dataStr = it->second;
-        if (msc_debug_consensus_hash) PrintToLog("Adding MetaDEx trade data to consensus hash: %s\n", dataStr);
-        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
-    }
 
-    // Crowdsales - loop through open crowdsales and add to the consensus hash (ordered by property ID)
-    // Note: the variables of the crowdsale (amount, bonus etc) are not part of the crowdsale map and not included here to
-    // avoid additionalal loading of SP entries from the database
-    // Placeholders: "propertyid|propertyiddesired|deadline|usertokens|issuertokens"
-    std::vector<std::pair<uint32_t, std::string> > vecCrowds;
-    for (CrowdMap::const_iterator it = my_crowds.begin(); it != my_crowds.end(); ++it) {
-        const CMPCrowd& crowd = it->second;
-        uint32_t propertyId = crowd.getPropertyId();
-        std::string dataStr = GenerateConsensusString(crowd);
-        vecCrowds.push_back(std::make_pair(propertyId, dataStr));
-    }
-    std::sort (vecCrowds.begin(), vecCrowds.end());
-    for (std::vector<std::pair<uint32_t, std::string> >::iterator it = vecCrowds.begin(); it != vecCrowds.end(); ++it) {
-        std::string dataStr = (*it).second;
-        if (msc_debug_consensus_hash) PrintToLog("Adding Crowdsale entry to consensus hash: %s\n", dataStr);
-        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
-    }
+        case COLLECT_ORDERS:
+            if (!orderCursor.Next(STATE_SCAN_CHUNK_SIZE, [&vOrders](const CMPMetaDEx& order) {
+                    vOrders.emplace_back(UintToArith256(order.getHash()), order);
+                })) {
+                stage = WRITE_ORDERS;
+            }
+            return true;
+
+        case WRITE_REMAINING:
+            WriteConsensusSection(os, SECTION_CROWDSALES);
+            WriteConsensusSection(os, SECTION_PROPERTIES);
+            return false;
 
-    // Properties - loop through each property and store the issuer (to capture state changes via change issuer transactions)
-    // Note: we are loading every SP from the DB to check the issuer, if using consensus_hash_every_block debug option this
-    //       will slow things down dramatically.  Not an issue to do it once every 10,000 blocks for checkpoint verification.
-    // Placeholders: "propertyid|issueraddress"
-    for (uint8_t ecosystem = 1; ecosystem <= 2; ecosystem++) {
-        uint32_t startPropertyId = (ecosystem == 1) ? 1 : TEST_ECO_PROPERTY_1;
-        for (uint32_t propertyId = startPropertyId; propertyId < pDbSpInfo->peekNextSPID(ecosystem); propertyId++) {
-            CMPSPInfo::Entry sp;
-            if (!pDbSpInfo->getSP(propertyId, sp)) {
-                PrintToLog("Error loading property ID %d for consensus hashing, hash should not be trusted!\n");
-                continue;
+        default:
+            // the other stages are processed without the lock
+            assert(false);
+            return false;
+        }
+    };
+
+    auto fnUnlocked = [&] {
+        if (stage == SORT_ADDRESSES) {
+            std::sort(vAddresses.begin(), vAddresses.end());
+            stage = WRITE_BALANCES;
+        } else if (stage == WRITE_ORDERS) {
+            std::sort(vOrders.begin(), vOrders.end(), [](const std::pair<arith_uint256, CMPMetaDEx>& a, const std::pair<arith_uint256, CMPMetaDEx>& b) {
+                return a.first < b.first;
+            });
+            for (const auto& entry : vOrders) {
+                WriteConsensusData(os, entry.second);
+                PrintToLogVerbose(msc_debug_consensus_hash, "Adding MetaDEx trade data to consensus hash: %s\n", GenerateConsensusString(entry.second));
             }
-            std::string dataStr = GenerateConsensusString(propertyId, sp.issuer);
-            if (msc_debug_consensus_hash) PrintToLog("Adding property to consensus hash: %s\n", dataStr);
-            hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
+            stage = WRITE_REMAINING;
         }
-    }
-
-    // extract the final result and return the hash
+    };
+
+    auto fnRestart = [&] {
+        PrintToLogVerbose(msc_debug_consensus_hash, "The state was modified, restarting generation of consensus hash...\n");
+        os.flush();
+        hasher.Reset();
+        stage = COLLECT_ADDRESSES;
+        tallyCursor.Reset();
+        orderCursor.Reset();
+        vAddresses.clear();
+        vOrders.clear();
+        nNextAddress = 0;
+    };
+
+    ScanStateInChunks(fnChunk, fnRestart, fnUnlocked);
+
+    os.flush();
     uint256 consensusHash;
     hasher.Finalize(consensusHash.begin());
-    if (msc_debug_consensus_hash) PrintToLog("Finished generation of consensus hash.  Result: %s\n", consensusHash.GetHex());
+    PrintToLogVerbose(msc_debug_consensus_hash, "Finished generation of consensus hash.  Result: %s\n", consensusHash.GetHex());
 
     return consensusHash;
 }
 
-uint256 GetMetaDExHash(const uint32_t propertyId)
+const char* GetConsensusHashSectionName(ConsensusHashSection section)
 {
-    CSHA256 hasher;
+    switch (section) {
+        case SECTION_BALANCES: return "balances";
+        case SECTION_DEX_OFFERS: return "dexoffers";
+        case SECTION_DEX_ACCEPTS: return "dexaccepts";
+        case SECTION_METADEX_ORDERS: return "metadexorders";
+        case SECTION_CROWDSALES: return "crowdsales";
+        case SECTION_PROPERTIES: return "properties";
+        default: return "unknown";
+    }
+}
+
+/**
+ * Obtains the digests of the sections of the consensus hash, and returns the hash of the digests.
+ *
+ * Each section is hashed on its own, concurrently on the worker pool, with the same data as
+ * in the consensus hash. The combined hash is the SHA256 hash of the section digests, in the
+ * order of the sections, so it differs from the consensus hash, but a mismatch of the state
+ * can be narrowed down to the sections with different digests.
+ */
+uint256 GetConsensusHashSections(std::vector<uint256>& vDigests)
+{
+    vDigests.assign(SECTION_COUNT, uint256());
 
     LOCK(cs_tally);
 
-    std::vector<std::pair<arith_uint256, std::string> > vecMetaDExTrades;
-    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        if (propertyId == 0 || propertyId == my_it->first) {
-            const md_PricesMap& prices = my_it->second;
-            for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
-                const md_Set& indexes = it->second;
-                for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                    const CMPMetaDEx& obj = *it;
-                    std::string dataStr = GenerateConsensusString(obj);
-                    vecMetaDExTrades.push_back(std::make_pair(arith_uint256(obj.getHash().ToString()), dataStr));
-                }
-            }
+    // the workers only read the state, which is protected by the lock of the caller
+    GetWorkerPool().ForEach(SECTION_COUNT, [&vDigests](size_t n) NO_THREAD_SAFETY_ANALYSIS {
+        CSHA256 hasher;
+        {
+            CSHA256StreamBuf buf(hasher);
+            std::ostream os(&buf);
+            WriteConsensusSection(os, static_cast<ConsensusHashSection>(n));
         }
+        hasher.Finalize(vDigests[n].begin());
+    });
+
+    CSHA256 hasher;
+    for (const uint256& digest : vDigests) {
+        hasher.Write(digest.begin(), digest.size());
     }
-    std::sort (vecMetaDExTrades.begin(), vecMetaDExTrades.end());
-    for (std::vector<std::pair<arith_uint256, std::string> >::iterator it = vecMetaDExTrades.begin(); it != vecMetaDExTrades.end(); ++it) {
-        const std::string& dataStr = it->second;
-        hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
+    uint256 combinedHash;
+    hasher.Finalize(combinedHash.begin());
+    PrintToLogVerbose(msc_debug_consensus_hash, "Finished generation of sectioned consensus hash.  Result: %s\n", combinedHash.GetHex());
+
+    return combinedHash;
+}
+
+void LogConsensusHash(const std::string& strLabel)
+{
+    if (!gArgs.GetBoolArg("-omniconsensushashsections", false)) {
+        uint256 consensusHash = GetConsensusHash();
+        PrintToLog("Consensus hash for %s: %s\n", strLabel, consensusHash.GetHex());
+        return;
     }
 
+    std::vector<uint256> vDigests;
+    uint256 combinedHash = GetConsensusHashSections(vDigests);
+    PrintToLog("Sectioned consensus hash for %s: %s\n", strLabel, combinedHash.GetHex());
+    for (size_t n = 0; n < vDigests.size(); ++n) {
+        PrintToLog("  %s: %s\n", GetConsensusHashSectionName(static_cast<ConsensusHashSection>(n)), vDigests[n].GetHex());
+    }
+}
+
+//! Cached MetaDEx hashes by property, and of all orderbooks with property ID 0, which are up to date
+static std::unordered_map<uint32_t, uint256> g_metadexHashes GUARDED_BY(cs_tally);
+//! Cached balances hashes by property, which are up to date
+static std::unordered_map<uint32_t, uint256> g_balancesHashes GUARDED_BY(cs_tally);
+
+/**
+ * Obtains a hash of the MetaDEx state.
+ *
+ * The hashes are cached, and discarded, when an order of the property is added, removed or
+ * modified, so unchanged orderbooks are not hashed again.
+ */
+uint256 GetMetaDExHash(const uint32_t propertyId)
+{
+    LOCK(cs_tally);
+
+    std::unordered_map<uint32_t, uint256>::const_iterator it = g_metadexHashes.find(propertyId);
+    if (it != g_metadexHashes.end()) {
+        return it->second;
+    }
+
+    CSHA256 hasher;
+    {
+        CSHA256StreamBuf buf(hasher);
+        std::ostream os(&buf);
+        for (const CMPMetaDEx* pOrder : GetMetaDExOrdersSorted(propertyId)) {
+            WriteConsensusData(os, *pOrder);
+        }
+    }
     uint256 metadexHash;
     hasher.Finalize(metadexHash.begin());
 
+    g_metadexHashes[propertyId] = metadexHash;
     return metadexHash;
 }
 
-/** Obtains a hash of the balances for a specific property. */
+/**
+ * Obtains a hash of the balances for a specific property.
+ *
+ * The hashes are cached, and discarded, when the tally map reports a change of the balances
+ * of the property, so unchanged properties are not hashed again.
+ */
 uint256 GetBalancesHash(const uint32_t hashPropertyId)
 {
-    CSHA256 hasher;
-
     LOCK(cs_tally);
 
-    std::map<std::string, CMPTally> tallyMapSorted;
-    for (std::unordered_map<std::string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
-        tallyMapSorted.insert(std::make_pair(uoit->first,uoit->second));
-    }
-    for (std::map<std::string, CMPTally>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
-        const std::string& address = my_it->first;
-        CMPTally& tally = my_it->second;
-        tally.init();
-        uint32_t propertyId = 0;
-        while (0 != (propertyId = (tally.next()))) {
-            if (propertyId != hashPropertyId) continue;
-            std::string dataStr = GenerateConsensusString(tally, address, propertyId);
-            if (dataStr.empty()) continue;
-            if (msc_debug_consensus_hash) PrintToLog("Adding data to balances hash: %s\n", dataStr);
-            hasher.Write((unsigned char*)dataStr.c_str(), dataStr.length());
+    std::vector<uint32_t> vModified;
+    if (mp_tally_map.TakeModifiedProperties(vModified)) {
+        for (uint32_t propertyId : vModified) {
+            g_balancesHashes.erase(propertyId);
         }
+    } else {
+        g_balancesHashes.clear();
     }
 
+    std::unordered_map<uint32_t, uint256>::const_iterator it = g_balancesHashes.find(hashPropertyId);
+    if (it != g_balancesHashes.end()) {
+        return it->second;
+    }
+
+    CSHA256 hasher;
+    CSHA256StreamBuf buf(hasher);
+    std::ostream os(&buf);
+
+    // only the holders of the property are relevant, whose balances are read from the columns by row
+    const CPropertyBalances& balances = mp_tally_map.GetBalances(hashPropertyId);
+    std::vector<uint32_t> vRows(balances.size());
+    for (uint32_t row = 0; row < vRows.size(); ++row) {
+        vRows[row] = row;
+    }
+    std::sort(vRows.begin(), vRows.end(), [&balances](uint32_t a, uint32_t b) {
+        return mp_tally_map.GetAddress(balances.ids[a]) < mp_tally_map.GetAddress(balances.ids[b]);
+    });
+
+    for (uint32_t row : vRows) {
+        const std::string& address = mp_tally_map.GetAddress(balances.ids[row]);
+        if (!WriteConsensusData(os, address, hashPropertyId, balances.balance[row], balances.sellOfferReserve[row],
+                balances.acceptReserve[row], balances.metaDExReserve[row])) continue;
+        PrintToLogVerbose(msc_debug_consensus_hash, "Adding data to balances hash: %s\n",
+                GenerateConsensusString(*mp_tally_map.Get(balances.ids[row]), address, hashPropertyId));
+    }
+
+    os.flush();
     uint256 balancesHash;
     hasher.Finalize(balancesHash.begin());
 
+    g_balancesHashes[hashPropertyId] = balancesHash;
     return balancesHash;
 }
 
+//! Commitment to the DEx offers and accepts, the MetaDEx orders and the crowdsales
+static CStateCommitment g_orderCommitment GUARDED_BY(cs_tally);
+//! Whether the commitment is up to date and maintained by the mutators of the state
+static bool g_fOrderCommitment GUARDED_BY(cs_tally) = false;
+
+void CommitDExOffer(const CDExOfferKey& key, const CMPOffer& offer, bool fAdd)
+{
+    BumpStateGeneration();
+    if (!g_fOrderCommitment) return;
+    if (fAdd) {
+        g_orderCommitment.Add(COMMIT_DEX_OFFER, key.ToString(), offer.getHash(), offer.getProperty(), offer.getOfferAmountOriginal(),
+                offer.getBTCDesiredOriginal(), offer.getMinFee(), offer.getBlockTimeLimit());
+    } else {
+        g_orderCommitment.Remove(COMMIT_DEX_OFFER, key.ToString(), offer.getHash(), offer.getProperty(), offer.getOfferAmountOriginal(),
+                offer.getBTCDesiredOriginal(), offer.getMinFee(), offer.getBlockTimeLimit());
+    }
+}
+
+void CommitDExAccept(const CDExAcceptKey& key, const CMPAccept& accept, bool fAdd)
+{
+    BumpStateGeneration();
+    if (!g_fOrderCommitment) return;
+    if (fAdd) {
+        g_orderCommitment.Add(COMMIT_DEX_ACCEPT, key.ToString(), accept.getHash(), accept.getAcceptAmount(),
+                accept.getAcceptAmountRemaining(), accept.getAcceptBlock());
+    } else {
+        g_orderCommitment.Remove(COMMIT_DEX_ACCEPT, key.ToString(), accept.getHash(), accept.getAcceptAmount(),
+                accept.getAcceptAmountRemaining(), accept.getAcceptBlock());
+    }
+}
+
+void CommitMetaDExOrder(const CMPMetaDEx& order, bool fAdd)
+{
+    BumpStateGeneration();
+    g_metadexHashes.erase(0);
+    g_metadexHashes.erase(order.getProperty());
+
+    if (!g_fOrderCommitment) return;
+    if (fAdd) {
+        g_orderCommitment.Add(COMMIT_METADEX_ORDER, order.getHash(), order.getAddr(), order.getProperty(),
+                order.getAmountForSale(), order.getDesProperty(), order.getAmountDesired(), order.getAmountRemaining());
+    } else {
+        g_orderCommitment.Remove(COMMIT_METADEX_ORDER, order.getHash(), order.getAddr(), order.getProperty(),
+                order.getAmountForSale(), order.getDesProperty(), order.getAmountDesired(), order.getAmountRemaining());
+    }
+}
+
+void CommitCrowdsale(const std::string& issuer, const CMPCrowd& crowd, bool fAdd)
+{
+    BumpStateGeneration();
+    if (!g_fOrderCommitment) return;
+    if (fAdd) {
+        g_orderCommitment.Add(COMMIT_CROWDSALE, issuer, crowd.getPropertyId(), crowd.getCurrDes(), crowd.getDeadline(),
+                crowd.getUserCreated(), crowd.getIssuerCreated());
+    } else {
+        g_orderCommitment.Remove(COMMIT_CROWDSALE, issuer, crowd.getPropertyId(), crowd.getCurrDes(), crowd.getDeadline(),
+                crowd.getUserCreated(), crowd.getIssuerCreated());
+    }
+}
+
+void InvalidateStateCommitment()
+{
+    BumpStateGeneration();
+    g_fOrderCommitment = false;
+    g_metadexHashes.clear();
+}
+
+/**
+ * Obtains the commitment to the current state.
+ *
+ * Unlike the consensus hash, the commitment is a set hash of the balances, the DEx offers
+ * and accepts, the MetaDEx orders and the crowdsales, which is updated with every change,
+ * so reading it doesn't depend on the size of the state. The property issuers are not
+ * covered, as they are not held in memory.
+ *
+ * The commitment is built once on first use, and again after the state was replaced as a
+ * whole, for example when it was loaded from disk or rolled back.
+ */
+CStateCommitment GetCurrentStateCommitment()
+{
+    LOCK(cs_tally);
+
+    if (!g_fOrderCommitment) {
+        g_fOrderCommitment = true;
+        g_orderCommitment.SetNull();
+        for (OfferMap::const_iterator it = my_offers.begin(); it != my_offers.end(); ++it) {
+            CommitDExOffer(it->first, it->second, true);
+        }
+        for (AcceptMap::const_iterator it = my_accepts.begin(); it != my_accepts.end(); ++it) {
+            CommitDExAccept(it->first, it->second, true);
+        }
+        for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+            for (md_PricesMap::const_iterator it = my_it->second.begin(); it != my_it->second.end(); ++it) {
+                for (const CMPMetaDEx& order : it->second) {
+                    CommitMetaDExOrder(order, true);
+                }
+            }
+        }
+        for (CrowdMap::const_iterator it = my_crowds.begin(); it != my_crowds.end(); ++it) {
+            CommitCrowdsale(it->first, it->second, true);
+        }
+    }
+
+    CStateCommitment commitment = mp_tally_map.GetCommitment();
+    commitment += g_orderCommitment;
+    return commitment;
+}
+
+uint256 GetStateCommitment()
+{
+    return GetCurrentStateCommitment().GetHash();
+}
+
+//! Digest of the changes of the transactions of a block so far, chained in their order
+static uint256 g_deltaChain GUARDED_BY(cs_tally);
+//! Block of the chained digest
+static int g_deltaChainBlock GUARDED_BY(cs_tally) = -1;
+
+/**
+ * Obtains the digest of the changes of the state since the given commitment.
+ *
+ * As the commitment is a set hash, the difference of two commitments only depends on
+ * the elements added and removed in between, and not on the rest of the state, so the
+ * digests of the same changes match, even if the state of two nodes already diverged.
+ */
+uint256 GetConsensusDelta(const CStateCommitment& before)
+{
+    CStateCommitment delta = GetCurrentStateCommitment();
+    delta -= before;
+    return delta.GetHash();
+}
+
+void LogConsensusDelta(int nBlock, const uint256& txid, const CStateCommitment& before)
+{
+    LOCK(cs_tally);
+
+    uint256 delta = GetConsensusDelta(before);
+
+    // the chain starts over with every block, so it doesn't depend on where the node started parsing
+    if (g_deltaChainBlock != nBlock) {
+        g_deltaChainBlock = nBlock;
+        g_deltaChain.SetNull();
+    }
+    CSHA256().Write(g_deltaChain.begin(), g_deltaChain.size()).Write(txid.begin(), txid.size()).Write(delta.begin(), delta.size()).Finalize(g_deltaChain.begin());
+
+    PrintToLog("Consensus delta for transaction %s in block %d: %s (chained: %s)\n", txid.GetHex(), nBlock, delta.GetHex(), g_deltaChain.GetHex());
+}
+
 } // namespace mastercore
@@ -1,22 +1,85 @@
 #ifndef BITCOIN_OMNICORE_CONSENSUSHASH_H
 #define BITCOIN_OMNICORE_CONSENSUSHASH_H
 
+#include <omnicore/statecommitment.h>
+
 #include <uint256.h>
 
+#include <string>
+#include <vector>
+
+class CMPAccept;
+class CMPCrowd;
+class CMPMetaDEx;
+class CMPOffer;
+struct CDExAcceptKey;
+struct CDExOfferKey;
+
 namespace mastercore
 {
 /** Checks if a given block should be consensus hashed. */
 bool ShouldConsensusHashBlock(int block);
 
+/** Sections of the consensus hash, in the order they are hashed. */
+enum ConsensusHashSection
+{
+    SECTION_BALANCES = 0,
+    SECTION_DEX_OFFERS,
+    SECTION_DEX_ACCEPTS,
+    SECTION_METADEX_ORDERS,
+    SECTION_CROWDSALES,
+    SECTION_PROPERTIES,
+    SECTION_COUNT
+};
+
 /** Obtains a hash of all balances to use for consensus verification and checkpointing. */
 uint256 GetConsensusHash();
 
+/** Obtains the same hash as GetConsensusHash(), but releases the state lock between chunks of the scan. */
+uint256 GetConsensusHashYielding();
+
+/** Returns the name of a section of the consensus hash. */
+const char* GetConsensusHashSectionName(ConsensusHashSection section);
+
+/** Obtains the digests of the sections of the consensus hash, which are hashed concurrently, and returns their combined hash. */
+uint256 GetConsensusHashSections(std::vector<uint256>& vDigests);
+
+/** Logs the consensus hash, or the sectioned hash and the section digests, if enabled, for the given block or transaction. */
+void LogConsensusHash(const std::string& strLabel);
+
 /** Obtains a hash of the overall MetaDEx state (default) or a specific orderbook (supply a property ID). */
 uint256 GetMetaDExHash(const uint32_t propertyId = 0);
 
 /** Obtains a hash of the balances for a specific property. */
 uint256 GetBalancesHash(const uint32_t hashPropertyId);
 
+/** Obtains the commitment to the current state, which is maintained incrementally and cheap to read. */
+uint256 GetStateCommitment();
+
+/** Obtains the set hash of the current state, which is the preimage of the state commitment. */
+CStateCommitment GetCurrentStateCommitment();
+
+/** Obtains the digest of the changes of the state since the set hash of an earlier state. */
+uint256 GetConsensusDelta(const CStateCommitment& before);
+
+/** Logs the digest of the changes of the state by a transaction, and the digest chained over the transactions of the block. */
+void LogConsensusDelta(int nBlock, const uint256& txid, const CStateCommitment& before);
+
+/** Adds or removes a DEx sell offer, identified by its key, in the state commitment. */
+void CommitDExOffer(const CDExOfferKey& key, const CMPOffer& offer, bool fAdd);
+
+/** Adds or removes a DEx accept, identified by its key, in the state commitment. */
+void CommitDExAccept(const CDExAcceptKey& key, const CMPAccept& accept, bool fAdd);
+
+/** Adds or removes a MetaDEx order in the state commitment. */
+void CommitMetaDExOrder(const CMPMetaDEx& order, bool fAdd);
+
+/** Adds or removes a crowdsale of an issuer in the state commitment. */
+void CommitCrowdsale(const std::string& issuer, const CMPCrowd& crowd, bool fAdd);
+
+/** Marks the commitment to the orderbooks and crowdsales, and the cached MetaDEx hashes, as outdated, after they were replaced at once. */
+void InvalidateStateCommitment();
+
 }
 
 #endif // BITCOIN_OMNICORE_CONSENSUSHASH_H
@@ -3,7 +3,7 @@
 #include <omnicore/createpayload.h>
 
 #include <omnicore/log.h>
-#include <omnicore/parsing.h>
+#include <omnicore/payload.h>
 
 #include <base58.h>
 
@@ -11,19 +11,10 @@
 #include <string>
 #include <vector>
 
-/**
- * Pushes bytes to the end of a vector.
- */
-#define PUSH_BACK_BYTES(vector, value)\
-    vector.insert(vector.end(), reinterpret_cast<unsigned char *>(&(value)),\
-    reinterpret_cast<unsigned char *>(&(value)) + sizeof((value)));
+using mastercore::CPayloadWriter;
 
-/**
- * Pushes bytes to the end of a vector based on a pointer.
- */
-#define PUSH_BACK_BYTES_PTR(vector, ptr, size)\
-    vector.insert(vector.end(), reinterpret_cast<unsigned char *>((ptr)),\
-    reinterpret_cast<unsigned char *>((ptr)) + (size));
+//! Maximal length of the string fields of a payload, longer strings are truncated
+static const size_t MAX_STRING_LENGTH = 255;
 
 /**
  * Returns a vector of bytes containing the version and hash160 for an address.
@@ -44,607 +35,297 @@ static std::vector<unsigned char> AddressToBytes(const std::string& address)
     return addressBytes;
 }
 
+/**
+ * Appends the strings describing a new property.
+ */
+static void WritePropertyStrings(CPayloadWriter& payload, const std::string& category, const std::string& subcategory,
+                                 const std::string& name, const std::string& url, const std::string& data)
+{
+    payload.WriteString(category, MAX_STRING_LENGTH);
+    payload.WriteString(subcategory, MAX_STRING_LENGTH);
+    payload.WriteString(name, MAX_STRING_LENGTH);
+    payload.WriteString(url, MAX_STRING_LENGTH);
+    payload.WriteString(data, MAX_STRING_LENGTH);
+}
+
 std::vector<unsigned char> CreatePayload_SimpleSend(uint32_t propertyId, uint64_t amount)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 0;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-    SwapByteOrder64(amount);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-    PUSH_BACK_BYTES(payload, amount);
-
-    return payload;
+    CPayloadWriter payload(0, 0);
+    payload.WriteU32(propertyId);
+    payload.WriteU64(amount);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_SendAll(uint8_t ecosystem)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageVer = 0;
-    uint16_t messageType = 4;
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, ecosystem);
+    CPayloadWriter payload(0, 4);
+    payload.WriteU8(ecosystem);
 
-    return payload;
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_SendNonFungible(uint32_t propertyId, uint64_t tokenStart, uint64_t tokenEnd)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 5;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-    SwapByteOrder64(tokenStart);
-    SwapByteOrder64(tokenEnd);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-    PUSH_BACK_BYTES(payload, tokenStart);
-    PUSH_BACK_BYTES(payload, tokenEnd);
-
-    return payload;
+    CPayloadWriter payload(0, 5);
+    payload.WriteU32(propertyId);
+    payload.WriteU64(tokenStart);
+    payload.WriteU64(tokenEnd);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_SetNonFungibleData(uint32_t propertyId, uint64_t tokenStart, uint64_t tokenEnd, uint8_t issuer, std::string& data)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 201;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-    SwapByteOrder64(tokenStart);
-    SwapByteOrder64(tokenEnd);
-    if (data.size() > 255) data = data.substr(0,255);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-    PUSH_BACK_BYTES(payload, tokenStart);
-    PUSH_BACK_BYTES(payload, tokenEnd);
-    PUSH_BACK_BYTES(payload, issuer);
-    payload.insert(payload.end(), data.begin(), data.end());
-    payload.push_back('\0');
-
-    return payload;
+    CPayloadWriter payload(0, 201);
+    payload.WriteU32(propertyId);
+    payload.WriteU64(tokenStart);
+    payload.WriteU64(tokenEnd);
+    payload.WriteU8(issuer);
+    payload.WriteString(data, MAX_STRING_LENGTH);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_DExSell(uint32_t propertyId, uint64_t amountForSale, uint64_t amountDesired, uint8_t timeLimit, uint64_t minFee, uint8_t subAction)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 20;
-    uint16_t messageVer = 1;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-    SwapByteOrder64(amountForSale);
-    SwapByteOrder64(amountDesired);
-    SwapByteOrder64(minFee);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-    PUSH_BACK_BYTES(payload, amountForSale);
-    PUSH_BACK_BYTES(payload, amountDesired);
-    PUSH_BACK_BYTES(payload, timeLimit);
-    PUSH_BACK_BYTES(payload, minFee);
-    PUSH_BACK_BYTES(payload, subAction);
-
-    return payload;
+    CPayloadWriter payload(1, 20);
+    payload.WriteU32(propertyId);
+    payload.WriteU64(amountForSale);
+    payload.WriteU64(amountDesired);
+    payload.WriteU8(timeLimit);
+    payload.WriteU64(minFee);
+    payload.WriteU8(subAction);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_DExAccept(uint32_t propertyId, uint64_t amount)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 22;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-    SwapByteOrder64(amount);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-    PUSH_BACK_BYTES(payload, amount);
-
-    return payload;
+    CPayloadWriter payload(0, 22);
+    payload.WriteU32(propertyId);
+    payload.WriteU64(amount);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_SendToOwners(uint32_t propertyId, uint64_t amount, uint32_t distributionProperty)
 {
     bool v0 = (propertyId == distributionProperty) ? true : false;
 
-    std::vector<unsigned char> payload;
-
-    uint16_t messageType = 3;
-    uint16_t messageVer = (v0) ? 0 : 1;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-    SwapByteOrder64(amount);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-    PUSH_BACK_BYTES(payload, amount);
+    CPayloadWriter payload((v0) ? 0 : 1, 3);
+    payload.WriteU32(propertyId);
+    payload.WriteU64(amount);
     if (!v0) {
-        SwapByteOrder32(distributionProperty);
-        PUSH_BACK_BYTES(payload, distributionProperty);
+        payload.WriteU32(distributionProperty);
     }
 
-    return payload;
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_IssuanceFixed(uint8_t ecosystem, uint16_t propertyType, uint32_t previousPropertyId, std::string category,
                                                        std::string subcategory, std::string name, std::string url, std::string data, uint64_t amount)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 50;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(propertyType);
-    SwapByteOrder32(previousPropertyId);
-    SwapByteOrder64(amount);
-    if (category.size() > 255) category = category.substr(0,255);
-    if (subcategory.size() > 255) subcategory = subcategory.substr(0,255);
-    if (name.size() > 255) name = name.substr(0,255);
-    if (url.size() > 255) url = url.substr(0,255);
-    if (data.size() > 255) data = data.substr(0,255);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, ecosystem);
-    PUSH_BACK_BYTES(payload, propertyType);
-    PUSH_BACK_BYTES(payload, previousPropertyId);
-    payload.insert(payload.end(), category.begin(), category.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), subcategory.begin(), subcategory.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), name.begin(), name.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), url.begin(), url.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), data.begin(), data.end());
-    payload.push_back('\0');
-    PUSH_BACK_BYTES(payload, amount);
-
-    return payload;
+    CPayloadWriter payload(0, 50);
+    payload.WriteU8(ecosystem);
+    payload.WriteU16(propertyType);
+    payload.WriteU32(previousPropertyId);
+    WritePropertyStrings(payload, category, subcategory, name, url, data);
+    payload.WriteU64(amount);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_IssuanceVariable(uint8_t ecosystem, uint16_t propertyType, uint32_t previousPropertyId, std::string category,
                                                           std::string subcategory, std::string name, std::string url, std::string data, uint32_t propertyIdDesired,
                                                           uint64_t amountPerUnit, uint64_t deadline, uint8_t earlyBonus, uint8_t issuerPercentage)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 51;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(propertyType);
-    SwapByteOrder32(previousPropertyId);
-    SwapByteOrder32(propertyIdDesired);
-    SwapByteOrder64(amountPerUnit);
-    SwapByteOrder64(deadline);
-    if (category.size() > 255) category = category.substr(0,255);
-    if (subcategory.size() > 255) subcategory = subcategory.substr(0,255);
-    if (name.size() > 255) name = name.substr(0,255);
-    if (url.size() > 255) url = url.substr(0,255);
-    if (data.size() > 255) data = data.substr(0,255);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, ecosystem);
-    PUSH_BACK_BYTES(payload, propertyType);
-    PUSH_BACK_BYTES(payload, previousPropertyId);
-    payload.insert(payload.end(), category.begin(), category.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), subcategory.begin(), subcategory.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), name.begin(), name.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), url.begin(), url.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), data.begin(), data.end());
-    payload.push_back('\0');
-    PUSH_BACK_BYTES(payload, propertyIdDesired);
-    PUSH_BACK_BYTES(payload, amountPerUnit);
-    PUSH_BACK_BYTES(payload, deadline);
-    PUSH_BACK_BYTES(payload, earlyBonus);
-    PUSH_BACK_BYTES(payload, issuerPercentage);
-
-    return payload;
+    CPayloadWriter payload(0, 51);
+    payload.WriteU8(ecosystem);
+    payload.WriteU16(propertyType);
+    payload.WriteU32(previousPropertyId);
+    WritePropertyStrings(payload, category, subcategory, name, url, data);
+    payload.WriteU32(propertyIdDesired);
+    payload.WriteU64(amountPerUnit);
+    payload.WriteU64(deadline);
+    payload.WriteU8(earlyBonus);
+    payload.WriteU8(issuerPercentage);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_IssuanceManaged(uint8_t ecosystem, uint16_t propertyType, uint32_t previousPropertyId, std::string category,
                                                        std::string subcategory, std::string name, std::string url, std::string data)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 54;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(propertyType);
-    SwapByteOrder32(previousPropertyId);
-    if (category.size() > 255) category = category.substr(0,255);
-    if (subcategory.size() > 255) subcategory = subcategory.substr(0,255);
-    if (name.size() > 255) name = name.substr(0,255);
-    if (url.size() > 255) url = url.substr(0,255);
-    if (data.size() > 255) data = data.substr(0,255);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, ecosystem);
-    PUSH_BACK_BYTES(payload, propertyType);
-    PUSH_BACK_BYTES(payload, previousPropertyId);
-    payload.insert(payload.end(), category.begin(), category.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), subcategory.begin(), subcategory.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), name.begin(), name.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), url.begin(), url.end());
-    payload.push_back('\0');
-    payload.insert(payload.end(), data.begin(), data.end());
-    payload.push_back('\0');
-
-    return payload;
+    CPayloadWriter payload(0, 54);
+    payload.WriteU8(ecosystem);
+    payload.WriteU16(propertyType);
+    payload.WriteU32(previousPropertyId);
+    WritePropertyStrings(payload, category, subcategory, name, url, data);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_CloseCrowdsale(uint32_t propertyId)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 53;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-
-    return payload;
+    CPayloadWriter payload(0, 53);
+    payload.WriteU32(propertyId);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_Grant(uint32_t propertyId, uint64_t amount, std::string info)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 55;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-    SwapByteOrder64(amount);
-    if (info.size() > 255) info = info.substr(0,255);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-    PUSH_BACK_BYTES(payload, amount);
-    payload.insert(payload.end(), info.begin(), info.end());
-    payload.push_back('\0');
-
-    return payload;
+    CPayloadWriter payload(0, 55);
+    payload.WriteU32(propertyId);
+    payload.WriteU64(amount);
+    payload.WriteString(info, MAX_STRING_LENGTH);
+
+    return payload.Release();
 }
 
 
 std::vector<unsigned char> CreatePayload_Revoke(uint32_t propertyId, uint64_t amount, std::string memo)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 56;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-    SwapByteOrder64(amount);
-    if (memo.size() > 255) memo = memo.substr(0,255);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-    PUSH_BACK_BYTES(payload, amount);
-    payload.insert(payload.end(), memo.begin(), memo.end());
-    payload.push_back('\0');
-
-    return payload;
+    CPayloadWriter payload(0, 56);
+    payload.WriteU32(propertyId);
+    payload.WriteU64(amount);
+    payload.WriteString(memo, MAX_STRING_LENGTH);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_ChangeIssuer(uint32_t propertyId)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 70;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-
-    return payload;
+    CPayloadWriter payload(0, 70);
+    payload.WriteU32(propertyId);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_EnableFreezing(uint32_t propertyId)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 71;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-
-    return payload;
+    CPayloadWriter payload(0, 71);
+    payload.WriteU32(propertyId);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_DisableFreezing(uint32_t propertyId)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 72;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-
-    return payload;
+    CPayloadWriter payload(0, 72);
+    payload.WriteU32(propertyId);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_FreezeTokens(uint32_t propertyId, uint64_t amount, const std::string& address)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 185;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-    SwapByteOrder64(amount);
-    std::vector<unsigned char> addressBytes = AddressToBytes(address);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-    PUSH_BACK_BYTES(payload, amount);
-    payload.insert(payload.end(), addressBytes.begin(), addressBytes.end());
-
-    return payload;
+    CPayloadWriter payload(0, 185);
+    payload.WriteU32(propertyId);
+    payload.WriteU64(amount);
+    payload.WriteBytes(AddressToBytes(address));
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_UnfreezeTokens(uint32_t propertyId, uint64_t amount, const std::string& address)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 186;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-    SwapByteOrder64(amount);
-    std::vector<unsigned char> addressBytes = AddressToBytes(address);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-    PUSH_BACK_BYTES(payload, amount);
-    payload.insert(payload.end(), addressBytes.begin(), addressBytes.end());
-
-    return payload;
+    CPayloadWriter payload(0, 186);
+    payload.WriteU32(propertyId);
+    payload.WriteU64(amount);
+    payload.WriteBytes(AddressToBytes(address));
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_AddDelegate(uint32_t propertyId)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 73;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-
-    return payload;
+    CPayloadWriter payload(0, 73);
+    payload.WriteU32(propertyId);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_RemoveDelegate(uint32_t propertyId)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 74;
-    uint16_t messageVer = 0;
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(messageVer);
-    SwapByteOrder32(propertyId);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyId);
-
-    return payload;
+    CPayloadWriter payload(0, 74);
+    payload.WriteU32(propertyId);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_MetaDExTrade(uint32_t propertyIdForSale, uint64_t amountForSale, uint32_t propertyIdDesired, uint64_t amountDesired)
 {
-    std::vector<unsigned char> payload;
-
-    uint16_t messageType = 25;
-    uint16_t messageVer = 0;
-
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-    SwapByteOrder32(propertyIdForSale);
-    SwapByteOrder64(amountForSale);
-    SwapByteOrder32(propertyIdDesired);
-    SwapByteOrder64(amountDesired);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyIdForSale);
-    PUSH_BACK_BYTES(payload, amountForSale);
-    PUSH_BACK_BYTES(payload, propertyIdDesired);
-    PUSH_BACK_BYTES(payload, amountDesired);
-
-    return payload;
+    CPayloadWriter payload(0, 25);
+    payload.WriteU32(propertyIdForSale);
+    payload.WriteU64(amountForSale);
+    payload.WriteU32(propertyIdDesired);
+    payload.WriteU64(amountDesired);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_MetaDExCancelPrice(uint32_t propertyIdForSale, uint64_t amountForSale, uint32_t propertyIdDesired, uint64_t amountDesired)
 {
-    std::vector<unsigned char> payload;
-
-    uint16_t messageType = 26;
-    uint16_t messageVer = 0;
-
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-    SwapByteOrder32(propertyIdForSale);
-    SwapByteOrder64(amountForSale);
-    SwapByteOrder32(propertyIdDesired);
-    SwapByteOrder64(amountDesired);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyIdForSale);
-    PUSH_BACK_BYTES(payload, amountForSale);
-    PUSH_BACK_BYTES(payload, propertyIdDesired);
-    PUSH_BACK_BYTES(payload, amountDesired);
-
-    return payload;
+    CPayloadWriter payload(0, 26);
+    payload.WriteU32(propertyIdForSale);
+    payload.WriteU64(amountForSale);
+    payload.WriteU32(propertyIdDesired);
+    payload.WriteU64(amountDesired);
+
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_MetaDExCancelPair(uint32_t propertyIdForSale, uint32_t propertyIdDesired)
 {
-    std::vector<unsigned char> payload;
-
-    uint16_t messageType = 27;
-    uint16_t messageVer = 0;
+    CPayloadWriter payload(0, 27);
+    payload.WriteU32(propertyIdForSale);
+    payload.WriteU32(propertyIdDesired);
 
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-    SwapByteOrder32(propertyIdForSale);
-    SwapByteOrder32(propertyIdDesired);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, propertyIdForSale);
-    PUSH_BACK_BYTES(payload, propertyIdDesired);
-
-    return payload;
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_MetaDExCancelEcosystem(uint8_t ecosystem)
 {
-    std::vector<unsigned char> payload;
-
-    uint16_t messageType = 28;
-    uint16_t messageVer = 0;
-
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, ecosystem);
+    CPayloadWriter payload(0, 28);
+    payload.WriteU8(ecosystem);
 
-    return payload;
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_AnyData(const std::vector<unsigned char>& data)
 {
-    std::vector<unsigned char> payload;
+    CPayloadWriter payload(0, 200);
+    payload.WriteBytes(data);
 
-    uint16_t messageVer = 0;
-    uint16_t messageType = 200;
-
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    payload.insert(payload.end(), data.begin(), data.end());
-
-    return payload;
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_DeactivateFeature(uint16_t featureId)
 {
-    std::vector<unsigned char> payload;
-
-    uint16_t messageVer = 65535;
-    uint16_t messageType = 65533;
-
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(featureId);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, featureId);
+    CPayloadWriter payload(65535, 65533);
+    payload.WriteU16(featureId);
 
-    return payload;
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_ActivateFeature(uint16_t featureId, uint32_t activationBlock, uint32_t minClientVersion)
 {
-    std::vector<unsigned char> payload;
+    CPayloadWriter payload(65535, 65534);
+    payload.WriteU16(featureId);
+    payload.WriteU32(activationBlock);
+    payload.WriteU32(minClientVersion);
 
-    uint16_t messageVer = 65535;
-    uint16_t messageType = 65534;
-
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(featureId);
-    SwapByteOrder32(activationBlock);
-    SwapByteOrder32(minClientVersion);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, featureId);
-    PUSH_BACK_BYTES(payload, activationBlock);
-    PUSH_BACK_BYTES(payload, minClientVersion);
-
-    return payload;
+    return payload.Release();
 }
 
 std::vector<unsigned char> CreatePayload_OmniCoreAlert(uint16_t alertType, uint32_t expiryValue, const std::string& alertMessage)
 {
-    std::vector<unsigned char> payload;
-    uint16_t messageType = 65535;
-    uint16_t messageVer = 65535;
-
-    SwapByteOrder16(messageVer);
-    SwapByteOrder16(messageType);
-    SwapByteOrder16(alertType);
-    SwapByteOrder32(expiryValue);
-
-    PUSH_BACK_BYTES(payload, messageVer);
-    PUSH_BACK_BYTES(payload, messageType);
-    PUSH_BACK_BYTES(payload, alertType);
-    PUSH_BACK_BYTES(payload, expiryValue);
-    payload.insert(payload.end(), alertMessage.begin(), alertMessage.end());
-    payload.push_back('\0');
-
-    return payload;
-}
+    CPayloadWriter payload(65535, 65535);
+    payload.WriteU16(alertType);
+    payload.WriteU32(expiryValue);
+    payload.WriteString(alertMessage, alertMessage.size());
 
-#undef PUSH_BACK_BYTES
-#undef PUSH_BACK_BYTES_PTR
+    return payload.Release();
+}
@@ -106,6 +106,12 @@ CMutableTransaction TxBuilder::build()
     return transaction;
 }
 
+/** Returns the transaction, which is being built, without copying it. */
+const CMutableTransaction& TxBuilder::getTransaction() const
+{
+    return transaction;
+}
+
 /** Creates a new Omni transaction builder. */
 OmniTxBuilder::OmniTxBuilder()
   : TxBuilder()
@@ -121,6 +121,13 @@ public:
      */
     CMutableTransaction build();
 
+    /**
+     * Returns the transaction, which is being built, without copying it.
+     *
+     * @return The transaction being built
+     */
+    const CMutableTransaction& getTransaction() const;
+
 protected:
     CMutableTransaction transaction;
 };
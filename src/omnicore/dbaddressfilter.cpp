@@ -0,0 +1,149 @@
+#include <omnicore/dbaddressfilter.h>
+
+#include <omnicore/log.h>
+
+#include <blockfilter.h>
+#include <chain.h>
+#include <clientversion.h>
+#include <crypto/common.h>
+#include <fs.h>
+#include <serialize.h>
+#include <streams.h>
+#include <uint256.h>
+
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+
+#include <assert.h>
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+COmniAddressFilterIndex::COmniAddressFilterIndex(const fs::path& path, bool fWipe)
+  : m_nFirstHeight(-1), m_nLastHeight(-1)
+{
+    leveldb::Status status = Open(path, fWipe);
+    PrintToConsole("Loading address filter database: %s\n", status.ToString());
+
+    // the range of recorded blocks is kept in memory
+    std::string strValue;
+    if (status.ok() && pdb->Get(readoptions, std::string(1, 'r'), &strValue).ok()) {
+        try {
+            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> m_nFirstHeight;
+            ssValue >> m_nLastHeight;
+            ssValue >> m_hashLast;
+        } catch (const std::exception& e) {
+            PrintToLog("%s(): ERROR: %s\n", __func__, e.what());
+            m_nFirstHeight = -1;
+            m_nLastHeight = -1;
+            m_hashLast.SetNull();
+        }
+    }
+}
+
+COmniAddressFilterIndex::~COmniAddressFilterIndex()
+{
+    PrintToLogVerbose(msc_debug_persistence, "COmniAddressFilterIndex closed\n");
+}
+
+GCSFilter::Params COmniAddressFilterIndex::GetParams(const uint256& hashBlock)
+{
+    return GCSFilter::Params(ReadLE64(hashBlock.begin()), ReadLE64(hashBlock.begin() + 8), BASIC_FILTER_P, BASIC_FILTER_M);
+}
+
+void COmniAddressFilterIndex::AddAddress(const std::string& address)
+{
+    if (address.empty()) return;
+
+    LOCK(m_mutex);
+    m_pending.emplace(address.begin(), address.end());
+}
+
+/**
+ * Stores the filter of the processed block, and extends the range of recorded blocks.
+ *
+ * Key:   'f' + block hash
+ * Value: encoded filter
+ *
+ * Key:   'r'
+ * Value: height of the first block + height and hash of the last block of the range
+ */
+void COmniAddressFilterIndex::RecordBlock(const CBlockIndex* pindex)
+{
+    assert(pdb);
+    LOCK(m_mutex);
+
+    const uint256& hashBlock = pindex->GetBlockHash();
+    leveldb::WriteBatch batch;
+
+    if (!m_pending.empty()) {
+        GCSFilter filter(GetParams(hashBlock), m_pending);
+        m_pending.clear();
+
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << std::make_pair('f', hashBlock);
+        leveldb::Slice slKey(&ssKey[0], ssKey.size());
+        const std::vector<unsigned char>& vEncoded = filter.GetEncoded();
+        batch.Put(slKey, leveldb::Slice(reinterpret_cast<const char*>(vEncoded.data()), vEncoded.size()));
+    }
+
+    // blocks, which were not recorded, can't be covered, so the range starts over
+    if (m_nFirstHeight < 0 || pindex->nHeight > m_nLastHeight + 1 || pindex->nHeight < m_nFirstHeight) {
+        m_nFirstHeight = pindex->nHeight;
+    }
+    m_nLastHeight = pindex->nHeight;
+    m_hashLast = hashBlock;
+
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << m_nFirstHeight;
+    ssValue << m_nLastHeight;
+    ssValue << m_hashLast;
+    batch.Put(std::string(1, 'r'), leveldb::Slice(&ssValue[0], ssValue.size()));
+
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    if (!status.ok()) {
+        PrintToLog("%s(): ERROR for block %s: %s\n", __func__, hashBlock.GetHex(), status.ToString());
+    }
+    ++nWritten;
+}
+
+bool COmniAddressFilterIndex::GetFilter(const uint256& hashBlock, GCSFilter& filter)
+{
+    assert(pdb);
+
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << std::make_pair('f', hashBlock);
+    leveldb::Slice slKey(&ssKey[0], ssKey.size());
+
+    std::string strValue;
+    leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+    if (!status.ok()) {
+        if (!status.IsNotFound()) {
+            PrintToLog("%s(): ERROR for block %s: %s\n", __func__, hashBlock.GetHex(), status.ToString());
+        }
+        return false;
+    }
+
+    try {
+        filter = GCSFilter(GetParams(hashBlock), std::vector<unsigned char>(strValue.begin(), strValue.end()));
+    } catch (const std::exception& e) {
+        PrintToLog("%s(): ERROR for block %s: %s\n", __func__, hashBlock.GetHex(), e.what());
+        return false;
+    }
+    ++nRead;
+
+    return true;
+}
+
+bool COmniAddressFilterIndex::GetRecordedRange(int& nFirstHeight, uint256& hashLast)
+{
+    LOCK(m_mutex);
+    if (m_nFirstHeight < 0) return false;
+
+    nFirstHeight = m_nFirstHeight;
+    hashLast = m_hashLast;
+
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef BITCOIN_OMNICORE_DBADDRESSFILTER_H
+#define BITCOIN_OMNICORE_DBADDRESSFILTER_H
+
+#include <omnicore/dbbase.h>
+
+#include <blockfilter.h>
+#include <fs.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <string>
+
+class CBlockIndex;
+
+//! Default setting, whether compact filters over the addresses touched by Omni transactions are stored
+static const bool DEFAULT_OMNI_ADDRESS_FILTER_INDEX = false;
+
+/** LevelDB based storage of compact filters over the addresses touched by Omni transactions.
+ *
+ * For each block, a Golomb-coded set as defined in BIP 158 is built over the
+ * senders and receivers of the Omni transactions of the block, and the addresses,
+ * whose balances changed, such as the recipients of send-to-owners transactions.
+ * The elements are the addresses as strings, and the parameters are the same as
+ * those of the basic block filter, with the SipHash key derived from the block hash.
+ *
+ * Filters are stored by block hash, so they remain valid across reorganizations.
+ * Blocks without Omni activity are not stored, but covered by the range of recorded
+ * blocks, so an empty filter can be returned for them.
+ *
+ * The filters depend on the Omni state, so the database is cleared, when Omni state
+ * is wiped.
+ */
+class COmniAddressFilterIndex : public CDBBase
+{
+public:
+    COmniAddressFilterIndex(const fs::path& path, bool fWipe);
+    virtual ~COmniAddressFilterIndex();
+
+    /** Returns the filter parameters of a block, which are derived from the block hash. */
+    static GCSFilter::Params GetParams(const uint256& hashBlock);
+
+    /** Adds an address touched by the block, which is processed. */
+    void AddAddress(const std::string& address);
+
+    /** Stores the filter of the processed block, and extends the range of recorded blocks. */
+    void RecordBlock(const CBlockIndex* pindex);
+
+    /**
+     * Retrieves the filter of a block.
+     *
+     * @return True, if a filter was stored for the block
+     */
+    bool GetFilter(const uint256& hashBlock, GCSFilter& filter);
+
+    /**
+     * Retrieves the range of blocks, which were recorded without gaps.
+     *
+     * @param nFirstHeight[out]  The height of the first recorded block
+     * @param hashLast[out]      The hash of the last recorded block
+     * @return True, if blocks were recorded
+     */
+    bool GetRecordedRange(int& nFirstHeight, uint256& hashLast);
+
+private:
+    Mutex m_mutex;
+
+    //! Addresses touched by the block, which is processed
+    GCSFilter::ElementSet m_pending GUARDED_BY(m_mutex);
+    //! Height of the first block of the recorded range, or -1
+    int m_nFirstHeight GUARDED_BY(m_mutex);
+    //! Height of the last recorded block, or -1
+    int m_nLastHeight GUARDED_BY(m_mutex);
+    //! Hash of the last recorded block
+    uint256 m_hashLast GUARDED_BY(m_mutex);
+};
+
+namespace mastercore
+{
+    //! LevelDB based storage of compact filters over the addresses touched by Omni transactions, optional
+    extern COmniAddressFilterIndex* pDbAddressFilter;
+}
+
+#endif // BITCOIN_OMNICORE_DBADDRESSFILTER_H
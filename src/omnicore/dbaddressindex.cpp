@@ -0,0 +1,223 @@
+/**
+ * @file dbaddressindex.cpp
+ *
+ * This file contains the index of the Omni transactions of every address, which
+ * is used to list the transactions of addresses not in the wallet.
+ */
+
+#include <omnicore/dbaddressindex.h>
+
+#include <omnicore/indexproperties.h>
+#include <omnicore/log.h>
+
+#include <crypto/common.h>
+#include <fs.h>
+#include <uint256.h>
+#include <util/strencodings.h>
+
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+//! Prefix of the keys of the transactions of the addresses
+static const char DB_ADDRESS_TX = 'a';
+//! Size of the part of the keys after the address: block, position in block and role
+static const size_t TX_POSITION_SIZE = 2 * sizeof(uint32_t) + 1;
+
+/**
+ * Returns the prefix of the keys of the transactions of an address.
+ *
+ * The address is preceded by its length, so the transactions of one address are adjacent.
+ */
+static std::string AddressPrefix(const std::string& address)
+{
+    const size_t nSize = std::min<size_t>(address.size(), 0xff);
+    std::string prefix(1, DB_ADDRESS_TX);
+    prefix.push_back(static_cast<char>(nSize));
+    prefix.append(address, 0, nSize);
+    return prefix;
+}
+
+/** Returns the position of a transaction within the transactions of an address, ordered by block, position and role. */
+static std::string TxPosition(int nBlock, int nIdx, AddressTxRole role)
+{
+    unsigned char buf[TX_POSITION_SIZE];
+    WriteBE32(buf, static_cast<uint32_t>(nBlock));
+    WriteBE32(buf + 4, static_cast<uint32_t>(nIdx));
+    buf[8] = static_cast<unsigned char>(role);
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+COmniAddressIndex::COmniAddressIndex(const fs::path& path, bool fWipe)
+  : m_nBlock(-1), m_nIdx(-1), m_fTxIndexed(false), m_nRecorded(0)
+{
+    leveldb::Status status = Open(path, fWipe);
+    PrintToConsole("Loading address index: %s\n", status.ToString());
+}
+
+COmniAddressIndex::~COmniAddressIndex()
+{
+    PrintToLogVerbose(msc_debug_persistence, "COmniAddressIndex closed\n");
+}
+
+void COmniAddressIndex::BeginBlock(int nBlock)
+{
+    LOCK(m_mutex);
+    m_nBlock = nBlock;
+    m_nIdx = -1;
+    m_txid.SetNull();
+    m_txKeys.clear();
+    m_fTxIndexed = false;
+    m_nRecorded = 0;
+    m_batch.Clear();
+}
+
+void COmniAddressIndex::SetTransaction(int nIdx, const uint256& txid)
+{
+    LOCK(m_mutex);
+    FlushTransaction();
+    m_nIdx = nIdx;
+    m_txid = txid;
+}
+
+/**
+ * Records an address of the transaction, which is processed.
+ *
+ * Key:   'a' + address length + address + block + position in block + role
+ * Value: txid
+ *
+ * An address recorded twice in the same role writes the same key. The keys are
+ * added to the batch, once the transaction was processed.
+ */
+void COmniAddressIndex::RecordAddress(const std::string& address, AddressTxRole role)
+{
+    if (address.empty()) return;
+
+    LOCK(m_mutex);
+    if (m_nBlock < 0 || m_nIdx < 0) return;
+
+    m_txKeys.push_back(AddressPrefix(address) + TxPosition(m_nBlock, m_nIdx, role));
+}
+
+void COmniAddressIndex::MarkProperty(uint32_t propertyId)
+{
+    LOCK(m_mutex);
+    if (m_nIdx < 0 || m_fTxIndexed) return;
+
+    m_fTxIndexed = mastercore::IsIndexedProperty(propertyId);
+}
+
+/**
+ * Adds the addresses of the transaction, which was processed, to the batch.
+ *
+ * Every key is added to the undo log of the block, so the block can be rolled back.
+ */
+void COmniAddressIndex::FlushTransaction()
+{
+    if (m_fTxIndexed || mastercore::IsIndexingAllProperties()) {
+        for (const std::string& key : m_txKeys) {
+            m_batch.Put(key, EncodeDBValue(m_txid));
+            LogWrittenKey(m_batch, m_nBlock, key);
+            ++m_nRecorded;
+        }
+    }
+    m_txKeys.clear();
+    m_fTxIndexed = false;
+}
+
+void COmniAddressIndex::EndBlock()
+{
+    assert(pdb);
+    LOCK(m_mutex);
+    if (m_nBlock < 0) return;
+
+    FlushTransaction();
+    if (m_nRecorded > 0) {
+        leveldb::Status status = pdb->Write(writeoptions, &m_batch);
+        if (!status.ok()) {
+            PrintToLog("%s(): ERROR for block %d: %s\n", __func__, m_nBlock, status.ToString());
+        }
+        nWritten += m_nRecorded;
+    }
+
+    m_nBlock = -1;
+    m_nIdx = -1;
+    m_txid.SetNull();
+    m_nRecorded = 0;
+    m_batch.Clear();
+}
+
+void COmniAddressIndex::DeleteAboveBlock(int nBlock)
+{
+    assert(pdb);
+
+    leveldb::WriteBatch batch;
+    const std::set<std::string> setKeys = GetKeysWrittenAbove(nBlock, batch);
+    if (setKeys.empty()) return;
+
+    for (const std::string& key : setKeys) {
+        batch.Delete(key);
+    }
+
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    PrintToLog("%s(): deleted %d address transactions in and above block %d: %s\n", __func__, setKeys.size(), nBlock, status.ToString());
+    ScheduleCompaction(batch);
+}
+
+/**
+ * Retrieves the transactions of an address, in the order of the chain.
+ *
+ * The cursor is the hex encoded position of the last transaction of the previous page.
+ */
+bool COmniAddressIndex::GetTransactions(const std::string& address, const std::string& cursor, size_t nLimit,
+        std::vector<CAddressTxEntry>& entries, std::string& nextCursor) const
+{
+    assert(pdb);
+
+    const std::string prefix = AddressPrefix(address);
+
+    std::string start = prefix;
+    if (!cursor.empty()) {
+        const std::vector<unsigned char> vch = ParseHex(cursor);
+        if (!IsHex(cursor) || vch.size() != TX_POSITION_SIZE) return false;
+        // the cursor is followed by the first key after it
+        start = prefix + std::string(vch.begin(), vch.end()) + std::string(1, '\0');
+    }
+
+    nextCursor.clear();
+    bool fMore = false;
+    leveldb::Iterator* it = NewSnapshotIterator();
+    for (it->Seek(start); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        const leveldb::Slice& key = it->key();
+        if (key.size() != prefix.size() + TX_POSITION_SIZE) continue;
+        if (entries.size() >= nLimit) {
+            fMore = true;
+            break;
+        }
+
+        CAddressTxEntry entry;
+        if (!DecodeDBValue(it->value(), entry.txid)) {
+            PrintToLog("%s(): ERROR: failed to decode a transaction of %s\n", __func__, address);
+            continue;
+        }
+        const unsigned char* pPosition = reinterpret_cast<const unsigned char*>(key.data() + prefix.size());
+        entry.nBlock = static_cast<int>(ReadBE32(pPosition));
+        entry.nIdx = static_cast<int>(ReadBE32(pPosition + 4));
+        entry.role = static_cast<AddressTxRole>(pPosition[8]);
+        entries.push_back(entry);
+        nextCursor = HexStr(pPosition, pPosition + TX_POSITION_SIZE);
+    }
+    delete it;
+
+    if (!fMore) nextCursor.clear();
+
+    return true;
+}
@@ -0,0 +1,122 @@
+#ifndef BITCOIN_OMNICORE_DBADDRESSINDEX_H
+#define BITCOIN_OMNICORE_DBADDRESSINDEX_H
+
+#include <omnicore/dbbase.h>
+
+#include <fs.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <leveldb/write_batch.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+//! Default setting, whether the Omni transactions of every address are indexed
+static const bool DEFAULT_OMNI_ADDRESS_INDEX = false;
+
+/** The role of an address in a transaction. */
+enum AddressTxRole : uint8_t
+{
+    ADDRESS_ROLE_SENDER = 0,
+    ADDRESS_ROLE_RECEIVER = 1,
+    ADDRESS_ROLE_STO_RECIPIENT = 2,
+    ADDRESS_ROLE_TRADE_COUNTERPARTY = 3,
+};
+
+/** A transaction of an address, as stored by the address index. */
+struct CAddressTxEntry
+{
+    //! The height of the block of the transaction
+    int nBlock;
+    //! The position of the transaction in the block
+    int nIdx;
+    uint256 txid;
+    AddressTxRole role;
+};
+
+/** LevelDB based index of the Omni transactions of every address.
+ *
+ * The senders and reference receivers of the transactions, the recipients of
+ * send-to-owners transactions and the counterparties of trades on the
+ * distributed exchange are recorded, while blocks are processed. They are
+ * stored by address and the position of the transaction in the chain, so the
+ * transactions of an address are read with one range scan, and pages continue
+ * after a cursor.
+ *
+ * The transactions of a block are written at once, when the block was processed,
+ * and rolled back via the undo log, when the block is disconnected. The database
+ * is cleared, when Omni state is wiped.
+ *
+ * If only some properties are indexed, see -omniindexproperties, the addresses of a
+ * transaction are only kept, if the transaction touched one of these properties.
+ */
+class COmniAddressIndex : public CDBBase
+{
+public:
+    COmniAddressIndex(const fs::path& path, bool fWipe);
+    virtual ~COmniAddressIndex();
+
+    /** Starts to record the transactions of a block. */
+    void BeginBlock(int nBlock);
+
+    /** Sets the transaction, which is processed, or -1 and null, after it was processed. */
+    void SetTransaction(int nIdx, const uint256& txid);
+
+    /** Records the address in the given role for the transaction, which is processed, if any. */
+    void RecordAddress(const std::string& address, AddressTxRole role);
+
+    /** Marks the transaction, which is processed, as touching a property, so it's indexed, if the property is. */
+    void MarkProperty(uint32_t propertyId);
+
+    /** Writes the transactions of the block, and stops recording. */
+    void EndBlock();
+
+    /** Deletes the transactions recorded in and above the given block. */
+    void DeleteAboveBlock(int nBlock);
+
+    /**
+     * Retrieves the transactions of an address, in the order of the chain.
+     *
+     * @param address     The address
+     * @param cursor      The cursor, after which the transactions start, or an empty string
+     * @param nLimit      The maximum number of transactions to retrieve
+     * @param entries     The transactions
+     * @param nextCursor  The cursor of the next page, if there are more transactions
+     * @return False, if the cursor is invalid
+     */
+    bool GetTransactions(const std::string& address, const std::string& cursor, size_t nLimit,
+            std::vector<CAddressTxEntry>& entries, std::string& nextCursor) const;
+
+private:
+    Mutex m_mutex;
+
+    /** Adds the addresses of the transaction, which was processed, to the batch, if it's indexed. */
+    void FlushTransaction() EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    //! The block, which is processed, or -1
+    int m_nBlock GUARDED_BY(m_mutex);
+    //! The position of the transaction, which is processed, or -1
+    int m_nIdx GUARDED_BY(m_mutex);
+    //! The transaction, which is processed, or null
+    uint256 m_txid GUARDED_BY(m_mutex);
+    //! Keys of the addresses of the transaction, which is processed
+    std::vector<std::string> m_txKeys GUARDED_BY(m_mutex);
+    //! Whether the transaction, which is processed, touched an indexed property
+    bool m_fTxIndexed GUARDED_BY(m_mutex);
+    //! Number of addresses recorded in the block
+    size_t m_nRecorded GUARDED_BY(m_mutex);
+    //! The transactions of the block, which are written at the end of it
+    leveldb::WriteBatch m_batch GUARDED_BY(m_mutex);
+};
+
+namespace mastercore
+{
+    //! LevelDB based index of the Omni transactions of every address, optional
+    extern COmniAddressIndex* pDbAddressIndex;
+}
+
+#endif // BITCOIN_OMNICORE_DBADDRESSINDEX_H
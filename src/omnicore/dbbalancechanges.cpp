@@ -0,0 +1,240 @@
+/**
+ * @file dbbalancechanges.cpp
+ *
+ * This file contains the index of the balance changes of every address, which
+ * is used to retrieve the balance history of an address.
+ */
+
+#include <omnicore/dbbalancechanges.h>
+
+#include <omnicore/log.h>
+#include <omnicore/tally.h>
+
+#include <crypto/common.h>
+#include <fs.h>
+#include <serialize.h>
+#include <uint256.h>
+#include <util/strencodings.h>
+
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+/** Value of a balance change, keyed by address, property, block and sequence. */
+struct BalanceChangeRecord
+{
+    int32_t nIdx;
+    uint256 txid;
+    uint8_t ttype;
+    int64_t nAmount;
+    int64_t nBalance;
+
+    BalanceChangeRecord() : nIdx(-1), ttype(0), nAmount(0), nBalance(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nIdx);
+        READWRITE(txid);
+        READWRITE(ttype);
+        READWRITE(nAmount);
+        READWRITE(nBalance);
+    }
+};
+}
+
+//! Prefix of the keys of the balance changes
+static const char DB_BALANCE_CHANGE = 'c';
+//! Size of the part of the keys after the address: property identifier, block and sequence
+static const size_t CHANGE_POSITION_SIZE = 3 * sizeof(uint32_t);
+
+/**
+ * Returns the prefix of the keys of the balance changes of an address.
+ *
+ * The address is preceded by its length, so the changes of one address are adjacent.
+ */
+static std::string AddressPrefix(const std::string& address)
+{
+    const size_t nSize = std::min<size_t>(address.size(), 0xff);
+    std::string prefix(1, DB_BALANCE_CHANGE);
+    prefix.push_back(static_cast<char>(nSize));
+    prefix.append(address, 0, nSize);
+    return prefix;
+}
+
+/** Returns the position of a change within the changes of an address, ordered by property, block and sequence. */
+static std::string ChangePosition(uint32_t propertyId, int nBlock, uint32_t nSequence)
+{
+    unsigned char buf[CHANGE_POSITION_SIZE];
+    WriteBE32(buf, propertyId);
+    WriteBE32(buf + 4, static_cast<uint32_t>(nBlock));
+    WriteBE32(buf + 8, nSequence);
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+COmniBalanceChangeIndex::COmniBalanceChangeIndex(const fs::path& path, bool fWipe)
+  : m_nBlock(-1), m_nIdx(-1), m_nSequence(0)
+{
+    leveldb::Status status = Open(path, fWipe);
+    PrintToConsole("Loading balance change index: %s\n", status.ToString());
+}
+
+COmniBalanceChangeIndex::~COmniBalanceChangeIndex()
+{
+    PrintToLogVerbose(msc_debug_persistence, "COmniBalanceChangeIndex closed\n");
+}
+
+void COmniBalanceChangeIndex::BeginBlock(int nBlock)
+{
+    LOCK(m_mutex);
+    m_nBlock = nBlock;
+    m_nIdx = -1;
+    m_txid.SetNull();
+    m_nSequence = 0;
+    m_batch.Clear();
+}
+
+void COmniBalanceChangeIndex::SetTransaction(int nIdx, const uint256& txid)
+{
+    LOCK(m_mutex);
+    m_nIdx = nIdx;
+    m_txid = txid;
+}
+
+/**
+ * Records a change of a balance, if a block is processed.
+ *
+ * Key:   'c' + address length + address + property identifier + block + sequence
+ * Value: transaction position + txid + tally type + amount + balance after the change
+ *
+ * Every key is added to the undo log of the block, so the block can be rolled back.
+ */
+void COmniBalanceChangeIndex::RecordChange(const std::string& address, uint32_t propertyId, TallyType ttype, int64_t nAmount, int64_t nBalance)
+{
+    if (ttype == PENDING) return;
+
+    LOCK(m_mutex);
+    if (m_nBlock < 0) return;
+
+    BalanceChangeRecord record;
+    record.nIdx = m_nIdx;
+    record.txid = m_txid;
+    record.ttype = static_cast<uint8_t>(ttype);
+    record.nAmount = nAmount;
+    record.nBalance = nBalance;
+
+    const std::string key = AddressPrefix(address) + ChangePosition(propertyId, m_nBlock, m_nSequence++);
+    m_batch.Put(key, EncodeDBValue(record));
+    LogWrittenKey(m_batch, m_nBlock, key);
+}
+
+void COmniBalanceChangeIndex::EndBlock()
+{
+    assert(pdb);
+    LOCK(m_mutex);
+    if (m_nBlock < 0) return;
+
+    if (m_nSequence > 0) {
+        leveldb::Status status = pdb->Write(writeoptions, &m_batch);
+        if (!status.ok()) {
+            PrintToLog("%s(): ERROR for block %d: %s\n", __func__, m_nBlock, status.ToString());
+        }
+        nWritten += m_nSequence;
+    }
+
+    m_nBlock = -1;
+    m_nIdx = -1;
+    m_txid.SetNull();
+    m_nSequence = 0;
+    m_batch.Clear();
+}
+
+void COmniBalanceChangeIndex::DeleteAboveBlock(int nBlock)
+{
+    assert(pdb);
+
+    leveldb::WriteBatch batch;
+    const std::set<std::string> setKeys = GetKeysWrittenAbove(nBlock, batch);
+    if (setKeys.empty()) return;
+
+    for (const std::string& key : setKeys) {
+        batch.Delete(key);
+    }
+
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    PrintToLog("%s(): deleted %d balance changes in and above block %d: %s\n", __func__, setKeys.size(), nBlock, status.ToString());
+    ScheduleCompaction(batch);
+}
+
+/**
+ * Retrieves the balance changes of an address, in the order they were made.
+ *
+ * The cursor is the hex encoded position of the last change of the previous page.
+ */
+bool COmniBalanceChangeIndex::GetChanges(const std::string& address, uint32_t propertyId, const std::string& cursor, size_t nLimit,
+        std::vector<CBalanceChangeEntry>& entries, std::string& nextCursor) const
+{
+    assert(pdb);
+
+    const std::string addressPrefix = AddressPrefix(address);
+    std::string prefix = addressPrefix;
+    if (propertyId != 0) {
+        prefix += ChangePosition(propertyId, 0, 0).substr(0, sizeof(uint32_t));
+    }
+
+    std::string start = prefix;
+    if (!cursor.empty()) {
+        const std::vector<unsigned char> vch = ParseHex(cursor);
+        const std::string position(vch.begin(), vch.end());
+        if (!IsHex(cursor) || position.size() != CHANGE_POSITION_SIZE) return false;
+        if ((addressPrefix + position).compare(0, prefix.size(), prefix) != 0) return false;
+        // the cursor is followed by the first key after it
+        start = addressPrefix + position + std::string(1, '\0');
+    }
+
+    nextCursor.clear();
+    bool fMore = false;
+    leveldb::Iterator* it = NewSnapshotIterator();
+    for (it->Seek(start); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        const leveldb::Slice& key = it->key();
+        if (key.size() != addressPrefix.size() + CHANGE_POSITION_SIZE) continue;
+        if (entries.size() >= nLimit) {
+            fMore = true;
+            break;
+        }
+
+        BalanceChangeRecord record;
+        if (!DecodeDBValue(it->value(), record)) {
+            PrintToLog("%s(): ERROR: failed to decode a balance change of %s\n", __func__, address);
+            continue;
+        }
+        const unsigned char* pPosition = reinterpret_cast<const unsigned char*>(key.data() + addressPrefix.size());
+
+        CBalanceChangeEntry entry;
+        entry.propertyId = ReadBE32(pPosition);
+        entry.nBlock = static_cast<int>(ReadBE32(pPosition + 4));
+        entry.nIdx = record.nIdx;
+        entry.txid = record.txid;
+        entry.ttype = static_cast<TallyType>(record.ttype);
+        entry.nAmount = record.nAmount;
+        entry.nBalance = record.nBalance;
+        entries.push_back(entry);
+        nextCursor = HexStr(pPosition, pPosition + CHANGE_POSITION_SIZE);
+    }
+    delete it;
+
+    if (!fMore) nextCursor.clear();
+
+    return true;
+}
@@ -0,0 +1,107 @@
+#ifndef BITCOIN_OMNICORE_DBBALANCECHANGES_H
+#define BITCOIN_OMNICORE_DBBALANCECHANGES_H
+
+#include <omnicore/dbbase.h>
+#include <omnicore/tally.h>
+
+#include <fs.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <leveldb/write_batch.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+//! Default setting, whether every balance change of every address is indexed
+static const bool DEFAULT_OMNI_BALANCE_CHANGE_INDEX = false;
+
+/** A change of a balance of an address, as stored by the balance change index. */
+struct CBalanceChangeEntry
+{
+    uint32_t propertyId;
+    //! The height of the block, in which the balance changed
+    int nBlock;
+    //! The position of the transaction in the block, or -1, if the change was made by the block processing
+    int nIdx;
+    //! The transaction, which changed the balance, or null
+    uint256 txid;
+    //! The changed tally type, one of BALANCE, SELLOFFER_RESERVE, ACCEPT_RESERVE and METADEX_RESERVE
+    TallyType ttype;
+    //! The amount, by which the balance changed
+    int64_t nAmount;
+    //! The balance of the tally type after the change
+    int64_t nBalance;
+};
+
+/** LevelDB based index of the balance changes of every address.
+ *
+ * The changes are taken from update_tally_map() and the crediting of fee
+ * distributions, excluding pending amounts, while blocks are processed. They
+ * are stored by address, property and the order they were made in, so the history
+ * of an address is read with one range scan, and pages continue after a cursor.
+ *
+ * The changes of a block are written at once, when the block was processed, and
+ * rolled back via the undo log, when the block is disconnected. The changes depend
+ * on the Omni state, so the database is cleared, when Omni state is wiped.
+ */
+class COmniBalanceChangeIndex : public CDBBase
+{
+public:
+    COmniBalanceChangeIndex(const fs::path& path, bool fWipe);
+    virtual ~COmniBalanceChangeIndex();
+
+    /** Starts to record the changes of a block. */
+    void BeginBlock(int nBlock);
+
+    /** Sets the transaction, which is processed, or -1 and null, after it was processed. */
+    void SetTransaction(int nIdx, const uint256& txid);
+
+    /** Records a change of a balance, if a block is processed. */
+    void RecordChange(const std::string& address, uint32_t propertyId, TallyType ttype, int64_t nAmount, int64_t nBalance);
+
+    /** Writes the changes of the block, and stops recording. */
+    void EndBlock();
+
+    /** Deletes the changes recorded in and above the given block. */
+    void DeleteAboveBlock(int nBlock);
+
+    /**
+     * Retrieves the balance changes of an address, in the order they were made.
+     *
+     * @param address     The address
+     * @param propertyId  The property identifier, or 0 for all properties
+     * @param cursor      The cursor, after which the changes start, or an empty string
+     * @param nLimit      The maximum number of changes to retrieve
+     * @param entries     The changes
+     * @param nextCursor  The cursor of the next page, if there are more changes
+     * @return False, if the cursor is invalid
+     */
+    bool GetChanges(const std::string& address, uint32_t propertyId, const std::string& cursor, size_t nLimit,
+            std::vector<CBalanceChangeEntry>& entries, std::string& nextCursor) const;
+
+private:
+    Mutex m_mutex;
+
+    //! The block, which is processed, or -1
+    int m_nBlock GUARDED_BY(m_mutex);
+    //! The position of the transaction, which is processed, or -1
+    int m_nIdx GUARDED_BY(m_mutex);
+    //! The transaction, which is processed, or null
+    uint256 m_txid GUARDED_BY(m_mutex);
+    //! Number of changes recorded in the block, which orders them
+    uint32_t m_nSequence GUARDED_BY(m_mutex);
+    //! The changes of the block, which are written at the end of it
+    leveldb::WriteBatch m_batch GUARDED_BY(m_mutex);
+};
+
+namespace mastercore
+{
+    //! LevelDB based index of the balance changes of every address, optional
+    extern COmniBalanceChangeIndex* pDbBalanceChanges;
+}
+
+#endif // BITCOIN_OMNICORE_DBBALANCECHANGES_H
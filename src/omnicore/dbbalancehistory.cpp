@@ -0,0 +1,268 @@
+/**
+ * @file dbbalancehistory.cpp
+ *
+ * This file contains the storage of the balances after each block, which is used
+ * to answer balance queries at past heights.
+ */
+
+#include <omnicore/dbbalancehistory.h>
+
+#include <omnicore/log.h>
+
+#include <crypto/common.h>
+#include <fs.h>
+
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! Prefix of the keys of the balances
+static const char DB_BALANCE = 'b';
+//! Key of the range of recorded blocks
+static const char DB_RANGE = 'r';
+//! Size of the property part of the keys of the balances
+static const size_t BALANCE_PROPERTY_PREFIX_SIZE = 1 + sizeof(uint32_t);
+
+/**
+ * Returns the prefix of the keys of the balances of an address and property.
+ *
+ * The address is preceded by its length, so the balances of one address are adjacent.
+ */
+static std::string BalancePrefix(uint32_t propertyId, const std::string& address)
+{
+    unsigned char buf[BALANCE_PROPERTY_PREFIX_SIZE + 1];
+    buf[0] = DB_BALANCE;
+    WriteBE32(buf + 1, propertyId);
+    buf[BALANCE_PROPERTY_PREFIX_SIZE] = static_cast<unsigned char>(std::min<size_t>(address.size(), 0xff));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf)) + address.substr(0, 0xff);
+}
+
+/**
+ * Returns the key of the balance of an address and property after a block.
+ *
+ * The height is inverted, so the newest balance comes first, and seeking the key of a
+ * height finds the balance of the highest block at or below it.
+ */
+static std::string BalanceKey(const std::string& prefix, int nBlock)
+{
+    unsigned char buf[sizeof(uint32_t)];
+    WriteBE32(buf, ~static_cast<uint32_t>(nBlock));
+    return prefix + std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/** Returns the key, which follows all balances of an address and property. */
+static std::string BalancePrefixEnd(const std::string& prefix)
+{
+    return prefix + std::string(sizeof(uint32_t) + 1, '\xff');
+}
+
+COmniBalanceHistory::COmniBalanceHistory(const fs::path& path, bool fWipe)
+  : m_nFirstHeight(-1), m_nLastHeight(-1)
+{
+    leveldb::Status status = Open(path, fWipe);
+    PrintToConsole("Loading balance history database: %s\n", status.ToString());
+
+    // the range of recorded blocks is kept in memory
+    std::string strValue;
+    std::pair<int32_t, int32_t> range;
+    if (status.ok() && pdb->Get(readoptions, std::string(1, DB_RANGE), &strValue).ok() && DecodeDBValue(strValue, range)) {
+        m_nFirstHeight = range.first;
+        m_nLastHeight = range.second;
+    }
+}
+
+COmniBalanceHistory::~COmniBalanceHistory()
+{
+    PrintToLogVerbose(msc_debug_persistence, "COmniBalanceHistory closed\n");
+}
+
+bool COmniBalanceHistory::IsEmpty()
+{
+    LOCK(m_mutex);
+    return m_nFirstHeight < 0;
+}
+
+/**
+ * Adds the range of recorded blocks to the batch, or its removal, if no block is recorded.
+ *
+ * Key:   'r'
+ * Value: height of the first block + height of the last block
+ */
+void COmniBalanceHistory::WriteRange(leveldb::WriteBatch& batch)
+{
+    if (m_nFirstHeight < 0) {
+        batch.Delete(std::string(1, DB_RANGE));
+    } else {
+        batch.Put(std::string(1, DB_RANGE), EncodeDBValue(std::pair<int32_t, int32_t>(m_nFirstHeight, m_nLastHeight)));
+    }
+}
+
+/**
+ * Stores the balances after a block, and extends the range of recorded blocks.
+ *
+ * Key:   'b' + property identifier + address length + address + inverted block height
+ * Value: available balance + reserved balance
+ *
+ * Every key is added to the undo log of the block, so the block can be rolled back.
+ */
+void COmniBalanceHistory::RecordBlock(int nBlock, const std::vector<CBalanceHistoryEntry>& entries)
+{
+    assert(pdb);
+    LOCK(m_mutex);
+
+    leveldb::WriteBatch batch;
+    for (const CBalanceHistoryEntry& entry : entries) {
+        const std::string key = BalanceKey(BalancePrefix(entry.propertyId, entry.address), nBlock);
+        batch.Put(key, EncodeDBValue(std::make_pair(entry.nBalance, entry.nReserved)));
+        LogWrittenKey(batch, nBlock, key);
+    }
+
+    if (m_nFirstHeight < 0) m_nFirstHeight = nBlock;
+    m_nLastHeight = std::max(m_nLastHeight, nBlock);
+    WriteRange(batch);
+
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    if (!status.ok()) {
+        PrintToLog("%s(): ERROR for block %d: %s\n", __func__, nBlock, status.ToString());
+    }
+    nWritten += entries.size();
+}
+
+/**
+ * Deletes the balances recorded in and above the given block, and shortens the range of recorded blocks.
+ *
+ * If the first recorded block is deleted, the next block is recorded as new snapshot.
+ */
+void COmniBalanceHistory::DeleteAboveBlock(int nBlock)
+{
+    assert(pdb);
+    LOCK(m_mutex);
+
+    leveldb::WriteBatch batch;
+    const std::set<std::string> setKeys = GetKeysWrittenAbove(nBlock, batch);
+    for (const std::string& key : setKeys) {
+        batch.Delete(key);
+    }
+
+    if (m_nFirstHeight >= nBlock) {
+        m_nFirstHeight = -1;
+        m_nLastHeight = -1;
+    } else {
+        m_nLastHeight = std::min(m_nLastHeight, nBlock - 1);
+    }
+    WriteRange(batch);
+
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    if (!status.ok()) {
+        PrintToLog("%s(): ERROR for block %d: %s\n", __func__, nBlock, status.ToString());
+    }
+    if (!setKeys.empty()) {
+        PrintToLog("%s(): deleted %d balances recorded in and above block %d\n", __func__, setKeys.size(), nBlock);
+        ScheduleCompaction(batch);
+    }
+}
+
+bool COmniBalanceHistory::GetRecordedRange(int& nFirstHeight, int& nLastHeight) const
+{
+    assert(pdb);
+
+    std::string strValue;
+    std::pair<int32_t, int32_t> range;
+    if (!SnapshotGet(std::string(1, DB_RANGE), &strValue).ok() || !DecodeDBValue(strValue, range)) {
+        return false;
+    }
+    nFirstHeight = range.first;
+    nLastHeight = range.second;
+
+    return true;
+}
+
+/** Decodes the balance the iterator points to, if it belongs to the given prefix. */
+static bool ReadBalance(leveldb::Iterator* it, const std::string& prefix, CBalanceHistoryEntry& entry)
+{
+    if (!it->Valid() || !it->key().starts_with(prefix)) return false;
+
+    std::pair<int64_t, int64_t> value;
+    if (!DecodeDBValue(it->value(), value)) {
+        PrintToLog("%s(): ERROR: failed to decode the balance of %s\n", __func__, entry.address);
+        return false;
+    }
+    entry.nBalance = value.first;
+    entry.nReserved = value.second;
+
+    return true;
+}
+
+bool COmniBalanceHistory::GetBalance(const std::string& address, uint32_t propertyId, int nHeight, CBalanceHistoryEntry& entry) const
+{
+    assert(pdb);
+
+    entry.address = address;
+    entry.propertyId = propertyId;
+    entry.nBalance = 0;
+    entry.nReserved = 0;
+
+    const std::string prefix = BalancePrefix(propertyId, address);
+    leveldb::Iterator* it = NewSnapshotIterator();
+    it->Seek(BalanceKey(prefix, nHeight));
+    bool fFound = ReadBalance(it, prefix, entry);
+    delete it;
+
+    return fFound;
+}
+
+/**
+ * Retrieves the non-empty balances of a property after the given block, ordered by address.
+ *
+ * For every address the balance at the height is read with one seek, and the older
+ * balances of the address are skipped with another one.
+ */
+bool COmniBalanceHistory::GetBalances(uint32_t propertyId, int nHeight, const std::string& cursor, size_t nLimit, std::vector<CBalanceHistoryEntry>& entries) const
+{
+    assert(pdb);
+
+    const std::string propertyPrefix = BalancePrefix(propertyId, "").substr(0, BALANCE_PROPERTY_PREFIX_SIZE);
+    bool fMore = false;
+
+    leveldb::Iterator* it = NewSnapshotIterator();
+    it->Seek(cursor.empty() ? propertyPrefix : BalancePrefixEnd(BalancePrefix(propertyId, cursor)));
+    while (it->Valid() && it->key().starts_with(propertyPrefix)) {
+        const leveldb::Slice& key = it->key();
+        if (key.size() < BALANCE_PROPERTY_PREFIX_SIZE + 1 + sizeof(uint32_t)) break;
+        const size_t nAddressSize = static_cast<unsigned char>(key[BALANCE_PROPERTY_PREFIX_SIZE]);
+        const std::string prefix(key.data(), BALANCE_PROPERTY_PREFIX_SIZE + 1 + nAddressSize);
+
+        CBalanceHistoryEntry entry;
+        entry.address = prefix.substr(BALANCE_PROPERTY_PREFIX_SIZE + 1);
+        entry.propertyId = propertyId;
+        it->Seek(BalanceKey(prefix, nHeight));
+        if (ReadBalance(it, prefix, entry) && (entry.nBalance != 0 || entry.nReserved != 0)) {
+            if (entries.size() >= nLimit) {
+                fMore = true;
+                break;
+            }
+            entries.push_back(entry);
+        }
+        it->Seek(BalancePrefixEnd(prefix));
+    }
+    delete it;
+
+    return fMore;
+}
+
+void COmniBalanceHistory::Clear()
+{
+    LOCK(m_mutex);
+    m_nFirstHeight = -1;
+    m_nLastHeight = -1;
+    CDBBase::Clear();
+}
@@ -0,0 +1,112 @@
+#ifndef BITCOIN_OMNICORE_DBBALANCEHISTORY_H
+#define BITCOIN_OMNICORE_DBBALANCEHISTORY_H
+
+#include <omnicore/dbbase.h>
+
+#include <fs.h>
+#include <sync.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+//! Default setting, whether the balances after every block are stored for historical balance queries
+static const bool DEFAULT_OMNI_BALANCE_HISTORY = false;
+
+/** The balance of an address and property after a block. */
+struct CBalanceHistoryEntry
+{
+    std::string address;
+    uint32_t propertyId;
+    //! Number of available tokens, excluding pending amounts
+    int64_t nBalance;
+    //! Number of tokens reserved by sell offers, accepts and MetaDEx trades
+    int64_t nReserved;
+};
+
+/** LevelDB based storage of the balances after each block, which allows to query balances at past heights.
+ *
+ * The first recorded block stores all non-empty balances as snapshot, and every
+ * following block stores the balances of the addresses and properties, which changed
+ * in the block, as taken from the balance journal of the undo module. The balance of
+ * an address at a height is the record of the highest block at or below the height,
+ * so a query is a single seek, instead of replaying the changes since the snapshot.
+ *
+ * Records are stored by height, and the blocks are rolled back via the undo log,
+ * when they are disconnected. The balances depend on the Omni state, so the database
+ * is cleared, when Omni state is wiped.
+ */
+class COmniBalanceHistory : public CDBBase
+{
+public:
+    COmniBalanceHistory(const fs::path& path, bool fWipe);
+    virtual ~COmniBalanceHistory();
+
+    /** Returns whether no block is recorded, so the next block must be recorded with all balances. */
+    bool IsEmpty();
+
+    /**
+     * Stores the balances after a block, and extends the range of recorded blocks.
+     *
+     * @param nBlock   The height of the block
+     * @param entries  The balances, which changed in the block, or all balances, if no block is recorded yet
+     */
+    void RecordBlock(int nBlock, const std::vector<CBalanceHistoryEntry>& entries);
+
+    /** Deletes the balances recorded in and above the given block, and shortens the range of recorded blocks. */
+    void DeleteAboveBlock(int nBlock);
+
+    /**
+     * Retrieves the range of recorded blocks, as of the last processed block.
+     *
+     * @param nFirstHeight[out]  The height of the first recorded block
+     * @param nLastHeight[out]   The height of the last recorded block
+     * @return True, if blocks were recorded
+     */
+    bool GetRecordedRange(int& nFirstHeight, int& nLastHeight) const;
+
+    /**
+     * Retrieves the balance of an address and property after the given block.
+     *
+     * The height must be within the range of recorded blocks.
+     *
+     * @return True, if a balance was recorded at or below the height, otherwise the balance is empty
+     */
+    bool GetBalance(const std::string& address, uint32_t propertyId, int nHeight, CBalanceHistoryEntry& entry) const;
+
+    /**
+     * Retrieves the non-empty balances of a property after the given block, ordered by address.
+     *
+     * @param propertyId  The property identifier
+     * @param nHeight     The height, which must be within the range of recorded blocks
+     * @param cursor      The address, after which the balances start, or an empty string
+     * @param nLimit      The maximum number of balances to retrieve
+     * @param entries     The balances
+     * @return True, if there are more balances after the ones retrieved
+     */
+    bool GetBalances(uint32_t propertyId, int nHeight, const std::string& cursor, size_t nLimit, std::vector<CBalanceHistoryEntry>& entries) const;
+
+    /** Deletes all entries of the database, including the range of recorded blocks. */
+    void Clear() override;
+
+private:
+    Mutex m_mutex;
+
+    //! Height of the first recorded block, or -1
+    int m_nFirstHeight GUARDED_BY(m_mutex);
+    //! Height of the last recorded block, or -1
+    int m_nLastHeight GUARDED_BY(m_mutex);
+
+    /** Adds the range of recorded blocks to the batch. */
+    void WriteRange(leveldb::WriteBatch& batch) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+};
+
+namespace mastercore
+{
+    //! LevelDB based storage of the balances after each block, optional
+    extern COmniBalanceHistory* pDbBalanceHistory;
+}
+
+#endif // BITCOIN_OMNICORE_DBBALANCEHISTORY_H
@@ -2,27 +2,722 @@
 
 #include <omnicore/log.h>
 
+#include <crypto/common.h>
 #include <fs.h>
 #include <util/system.h>
 
+#include <sync.h>
+
+#include <leveldb/cache.h>
 #include <leveldb/db.h>
+#include <leveldb/filter_policy.h>
+#include <leveldb/iterator.h>
 #include <leveldb/write_batch.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <set>
 #include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! Prefix of the keys of the undo log, which sorts after the printable keys of the records
+static const char DB_UNDO_LOG = '~';
+//! Size of the prefix and block at the start of the keys of the undo log
+static const size_t UNDO_LOG_PREFIX_SIZE = 1 + sizeof(uint32_t);
+
+//! Block cache shared by all databases, if enabled
+static std::unique_ptr<leveldb::Cache> g_block_cache;
+//! Bloom filter policy shared by all databases, if enabled
+static std::unique_ptr<const leveldb::FilterPolicy> g_filter_policy;
+//! Whether tables are compressed
+static bool g_compression = DEFAULT_OMNI_DB_COMPRESSION;
+//! Database, which holds the stores opened within its directory as key ranges, if enabled
+static std::shared_ptr<leveldb::DB> g_unified_db;
+//! Directory of the unified database
+static fs::path g_unified_path;
+
+//! Guards the pending compactions
+static Mutex g_compaction_mutex;
+//! Signals, that a background compaction finished
+static std::condition_variable g_compaction_cv;
+//! Ranges of deleted keys of the databases, which wait to be compacted
+static std::map<const CDBBase*, std::pair<std::string, std::string>> g_pending_compactions GUARDED_BY(g_compaction_mutex);
+//! Database, which is compacted in the background, if any
+static const CDBBase* g_compacting GUARDED_BY(g_compaction_mutex) = nullptr;
+
+//! Guards the flags, which mark the databases as released
+static Mutex g_release_mutex;
+//! Signals, that the last reference to a database was released
+static std::condition_variable g_release_cv;
+
+void ConfigureDBOptions(size_t nCacheSize, int nBloomBits, bool fCompression)
+{
+    g_block_cache.reset(nCacheSize > 0 ? leveldb::NewLRUCache(nCacheSize) : nullptr);
+    g_filter_policy.reset(nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(nBloomBits) : nullptr);
+    g_compression = fCompression;
+    PrintToLog("Omni databases use a block cache of %d MiB, bloom filters with %d bits per key, compression %s\n",
+            nCacheSize / (1024 * 1024), std::max(nBloomBits, 0), fCompression ? "enabled" : "disabled");
+}
+
+/** Returns the prefix of the undo log keys of a block. */
+static std::string UndoLogPrefix(int block)
+{
+    unsigned char buf[UNDO_LOG_PREFIX_SIZE];
+    buf[0] = DB_UNDO_LOG;
+    WriteBE32(buf + 1, static_cast<uint32_t>(block));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/** Returns the first key after all keys with a prefix, which must not end with 0xff. */
+static std::string PrefixEnd(const std::string& prefix)
+{
+    std::string end = prefix;
+    assert(!end.empty() && static_cast<unsigned char>(end.back()) != 0xff);
+    end.back() = end.back() + 1;
+    return end;
+}
+
+namespace
+{
+/** Buffered writes, where a value of nullptr marks a deleted entry. */
+typedef std::map<std::string, std::shared_ptr<const std::string>> BufferMap;
+
+/**
+ * Iterator, which merges buffered writes with the entries of the database.
+ *
+ * The buffered writes are captured, when the iterator is created, so later
+ * writes are not observed, similar to LevelDB's own implicit snapshot.
+ */
+class CBufferedIterator : public leveldb::Iterator
+{
+private:
+    std::unique_ptr<leveldb::Iterator> m_base;
+    const BufferMap m_buffer;
+    BufferMap::const_iterator m_it;
+    //! Whether the current entry is taken from the buffer
+    bool m_fBuffered;
+    bool m_fValid;
+
+    /** Moves to the next visible entry, starting at the current positions. */
+    void FindNextVisible()
+    {
+        while (true) {
+            bool fBase = m_base->Valid();
+            bool fBuffer = m_it != m_buffer.end();
+            if (!fBase && !fBuffer) {
+                m_fValid = false;
+                return;
+            }
+            int nCompare = (fBase && fBuffer) ? m_base->key().compare(m_it->first) : (fBase ? -1 : 1);
+            if (nCompare < 0) {
+                m_fBuffered = false;
+                m_fValid = true;
+                return;
+            }
+            if (m_it->second) {
+                m_fBuffered = true;
+                m_fValid = true;
+                return;
+            }
+            // deleted entry, which may shadow an entry of the database
+            if (nCompare == 0) m_base->Next();
+            ++m_it;
+        }
+    }
+
+    /** Positions at the last visible entry with a key less than the bound, or the last visible entry. */
+    void FindPrevVisible(const std::string* pBound)
+    {
+        std::string strBound;
+        while (true) {
+            std::string strBase, strBuffer;
+            bool fBase, fBuffer;
+
+            if (pBound) {
+                m_base->Seek(*pBound);
+                if (m_base->Valid()) {
+                    m_base->Prev();
+                } else {
+                    m_base->SeekToLast();
+                }
+            } else {
+                m_base->SeekToLast();
+            }
+            fBase = m_base->Valid();
+            if (fBase) strBase = m_base->key().ToString();
+
+            BufferMap::const_iterator it = pBound ? m_buffer.lower_bound(*pBound) : m_buffer.end();
+            fBuffer = it != m_buffer.begin();
+            if (fBuffer) strBuffer = (--it)->first;
+
+            if (!fBase && !fBuffer) {
+                m_fValid = false;
+                return;
+            }
+            if (fBuffer && (!fBase || strBuffer >= strBase)) {
+                if (!it->second) {
+                    // deleted entry, continue before it
+                    strBound = strBuffer;
+                    pBound = &strBound;
+                    continue;
+                }
+                Seek(strBuffer);
+            } else {
+                Seek(strBase);
+            }
+            return;
+        }
+    }
+
+public:
+    CBufferedIterator(leveldb::Iterator* base, const BufferMap& buffer)
+      : m_base(base), m_buffer(buffer), m_it(m_buffer.end()), m_fBuffered(false), m_fValid(false)
+    {
+    }
+
+    bool Valid() const override { return m_fValid; }
+
+    void SeekToFirst() override
+    {
+        m_base->SeekToFirst();
+        m_it = m_buffer.begin();
+        FindNextVisible();
+    }
+
+    void SeekToLast() override
+    {
+        FindPrevVisible(nullptr);
+    }
+
+    void Seek(const leveldb::Slice& target) override
+    {
+        m_base->Seek(target);
+        m_it = m_buffer.lower_bound(target.ToString());
+        FindNextVisible();
+    }
+
+    void Next() override
+    {
+        assert(m_fValid);
+        if (m_fBuffered) {
+            if (m_base->Valid() && m_base->key() == leveldb::Slice(m_it->first)) m_base->Next();
+            ++m_it;
+        } else {
+            m_base->Next();
+        }
+        FindNextVisible();
+    }
+
+    void Prev() override
+    {
+        assert(m_fValid);
+        std::string strKey = key().ToString();
+        FindPrevVisible(&strKey);
+    }
+
+    leveldb::Slice key() const override
+    {
+        assert(m_fValid);
+        return m_fBuffered ? leveldb::Slice(m_it->first) : m_base->key();
+    }
+
+    leveldb::Slice value() const override
+    {
+        assert(m_fValid);
+        return m_fBuffered ? leveldb::Slice(*m_it->second) : m_base->value();
+    }
+
+    leveldb::Status status() const override { return m_base->status(); }
+};
+}
+
+namespace
+{
+/**
+ * Iterator over the entries of a store within the unified database.
+ *
+ * Only entries with the prefix of the store are visible, and the prefix is
+ * stripped from the keys.
+ */
+class CPrefixedIterator : public leveldb::Iterator
+{
+private:
+    std::unique_ptr<leveldb::Iterator> m_base;
+    const std::string m_prefix;
+
+public:
+    CPrefixedIterator(leveldb::Iterator* base, const std::string& prefix) : m_base(base), m_prefix(prefix) {}
+
+    bool Valid() const override { return m_base->Valid() && m_base->key().starts_with(m_prefix); }
+
+    void SeekToFirst() override { m_base->Seek(m_prefix); }
+
+    void SeekToLast() override
+    {
+        m_base->Seek(PrefixEnd(m_prefix));
+        if (m_base->Valid()) {
+            m_base->Prev();
+        } else {
+            m_base->SeekToLast();
+        }
+    }
+
+    void Seek(const leveldb::Slice& target) override { m_base->Seek(m_prefix + target.ToString()); }
+    void Next() override { m_base->Next(); }
+    void Prev() override { m_base->Prev(); }
+
+    leveldb::Slice key() const override
+    {
+        leveldb::Slice key = m_base->key();
+        key.remove_prefix(m_prefix.size());
+        return key;
+    }
+
+    leveldb::Slice value() const override { return m_base->value(); }
+    leveldb::Status status() const override { return m_base->status(); }
+};
+
+/**
+ * A store within the unified database, where all keys are prefixed by the name of the store.
+ */
+class CPrefixedDB : public leveldb::DB
+{
+private:
+    std::shared_ptr<leveldb::DB> m_base;
+    const std::string m_prefix;
+
+    /** Prefixes the keys of a write batch. */
+    class CBatchHandler : public leveldb::WriteBatch::Handler
+    {
+    public:
+        leveldb::WriteBatch& batch;
+        const std::string& prefix;
+
+        CBatchHandler(leveldb::WriteBatch& batchIn, const std::string& prefixIn) : batch(batchIn), prefix(prefixIn) {}
+
+        void Put(const leveldb::Slice& key, const leveldb::Slice& value) override { batch.Put(prefix + key.ToString(), value); }
+        void Delete(const leveldb::Slice& key) override { batch.Delete(prefix + key.ToString()); }
+    };
+
+public:
+    CPrefixedDB(const std::shared_ptr<leveldb::DB>& base, const std::string& prefix) : m_base(base), m_prefix(prefix) {}
+
+    const std::string& Prefix() const { return m_prefix; }
+    leveldb::DB* Base() const { return m_base.get(); }
+
+    /** Deletes all entries of the store. */
+    leveldb::Status Wipe()
+    {
+        leveldb::WriteBatch batch;
+        std::unique_ptr<leveldb::Iterator> it(NewIterator(leveldb::ReadOptions()));
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            batch.Delete(m_prefix + it->key().ToString());
+        }
+        return m_base->Write(leveldb::WriteOptions(), &batch);
+    }
+
+    leveldb::Status Put(const leveldb::WriteOptions& options, const leveldb::Slice& key, const leveldb::Slice& value) override
+    {
+        return m_base->Put(options, m_prefix + key.ToString(), value);
+    }
+
+    leveldb::Status Delete(const leveldb::WriteOptions& options, const leveldb::Slice& key) override
+    {
+        return m_base->Delete(options, m_prefix + key.ToString());
+    }
+
+    leveldb::Status Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* updates) override
+    {
+        leveldb::WriteBatch batch;
+        CBatchHandler handler(batch, m_prefix);
+        leveldb::Status status = updates->Iterate(&handler);
+        if (!status.ok()) return status;
+        return m_base->Write(options, &batch);
+    }
+
+    leveldb::Status Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) override
+    {
+        return m_base->Get(options, m_prefix + key.ToString(), value);
+    }
+
+    leveldb::Iterator* NewIterator(const leveldb::ReadOptions& options) override
+    {
+        return new CPrefixedIterator(m_base->NewIterator(options), m_prefix);
+    }
+
+    const leveldb::Snapshot* GetSnapshot() override { return m_base->GetSnapshot(); }
+    void ReleaseSnapshot(const leveldb::Snapshot* snapshot) override { m_base->ReleaseSnapshot(snapshot); }
+    bool GetProperty(const leveldb::Slice& property, std::string* value) override { return m_base->GetProperty(property, value); }
+
+    void GetApproximateSizes(const leveldb::Range* range, int n, uint64_t* sizes) override
+    {
+        std::vector<std::string> vBounds;
+        for (int i = 0; i < n; ++i) {
+            vBounds.push_back(m_prefix + range[i].start.ToString());
+            vBounds.push_back(m_prefix + range[i].limit.ToString());
+        }
+        std::vector<leveldb::Range> vRanges;
+        for (int i = 0; i < n; ++i) {
+            vRanges.push_back(leveldb::Range(vBounds[2 * i], vBounds[2 * i + 1]));
+        }
+        m_base->GetApproximateSizes(vRanges.data(), n, sizes);
+    }
+
+    void CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end) override
+    {
+        const std::string strBegin = m_prefix + (begin ? begin->ToString() : std::string());
+        const std::string strEnd = end ? m_prefix + end->ToString() : PrefixEnd(m_prefix);
+        const leveldb::Slice sliceBegin(strBegin), sliceEnd(strEnd);
+        m_base->CompactRange(&sliceBegin, &sliceEnd);
+    }
+};
+}
+
+/**
+ * Wrapper around a LevelDB database, which can hold back writes in memory.
+ *
+ * Without an active batch, all calls are forwarded to the database. Within a
+ * batch, writes are buffered, and reads merge the buffer with the database.
+ * Reads of a snapshot bypass the buffer, because the buffered writes are newer.
+ */
+class CBufferedDB : public leveldb::DB
+{
+private:
+    //! Database, which is shared with the snapshots and iterators of readers
+    std::shared_ptr<leveldb::DB> m_base;
+    mutable Mutex m_mutex;
+    BufferMap m_buffer GUARDED_BY(m_mutex);
+    bool m_fActive GUARDED_BY(m_mutex);
+    //! Whether any of the buffered writes requested a sync write
+    bool m_fSync GUARDED_BY(m_mutex);
+    //! Cache of decoded values, which is invalidated by every write, if enabled
+    CDBReadCache* m_pCache;
+
+    /** Collects the content of a write batch. */
+    class CBatchHandler : public leveldb::WriteBatch::Handler
+    {
+    public:
+        BufferMap& buffer;
+
+        explicit CBatchHandler(BufferMap& bufferIn) : buffer(bufferIn) {}
+
+        void Put(const leveldb::Slice& key, const leveldb::Slice& value) override
+        {
+            buffer[key.ToString()] = std::make_shared<const std::string>(value.ToString());
+        }
+
+        void Delete(const leveldb::Slice& key) override
+        {
+            buffer[key.ToString()] = nullptr;
+        }
+    };
+
+    /** Invalidates the cached values of the keys of a write batch. */
+    class CInvalidateHandler : public leveldb::WriteBatch::Handler
+    {
+    public:
+        CDBReadCache& cache;
+
+        explicit CInvalidateHandler(CDBReadCache& cacheIn) : cache(cacheIn) {}
+
+        void Put(const leveldb::Slice& key, const leveldb::Slice& value) override { cache.Invalidate(key); }
+        void Delete(const leveldb::Slice& key) override { cache.Invalidate(key); }
+    };
+
+public:
+    explicit CBufferedDB(const std::shared_ptr<leveldb::DB>& base) : m_base(base), m_fActive(false), m_fSync(false), m_pCache(nullptr) {}
+
+    /** Sets the cache, which is invalidated by the writes, before the database is used. */
+    void SetReadCache(CDBReadCache* pCache) { m_pCache = pCache; }
+
+    void Begin()
+    {
+        LOCK(m_mutex);
+        m_fActive = true;
+    }
+
+    leveldb::DB* Base() const { return m_base.get(); }
+    const std::shared_ptr<leveldb::DB>& SharedBase() const { return m_base; }
+
+    /**
+     * Adds the buffered writes to a batch, with the keys prefixed, and returns their number.
+     *
+     * The writes stay visible, until the batch was written and the buffer is released.
+     */
+    size_t AppendTo(leveldb::WriteBatch& batch, const std::string& prefix, bool& fSync) const
+    {
+        LOCK(m_mutex);
+        for (const auto& entry : m_buffer) {
+            if (entry.second) {
+                batch.Put(prefix + entry.first, *entry.second);
+            } else {
+                batch.Delete(prefix + entry.first);
+            }
+        }
+        if (m_fSync) fSync = true;
+        return m_buffer.size();
+    }
+
+    /** Adds the buffered writes to a vector, ordered by key. */
+    void GetWrites(std::vector<CDBWrite>& vWrites) const
+    {
+        LOCK(m_mutex);
+        vWrites.assign(m_buffer.begin(), m_buffer.end());
+    }
+
+    /** Releases the buffered writes, and ends the batch. */
+    void Release()
+    {
+        LOCK(m_mutex);
+        m_fActive = false;
+        m_buffer.clear();
+        m_fSync = false;
+    }
+
+    bool IsActive() const
+    {
+        LOCK(m_mutex);
+        return m_fActive;
+    }
+
+    leveldb::Status Commit()
+    {
+        leveldb::WriteBatch batch;
+        leveldb::WriteOptions options;
+        leveldb::Status status;
+
+        // the buffer is released only after the write, so concurrent readers never miss an entry
+        if (AppendTo(batch, std::string(), options.sync) > 0) {
+            status = m_base->Write(options, &batch);
+        }
+        Release();
+        return status;
+    }
+
+    leveldb::Status Put(const leveldb::WriteOptions& options, const leveldb::Slice& key, const leveldb::Slice& value) override
+    {
+        leveldb::WriteBatch batch;
+        batch.Put(key, value);
+        return Write(options, &batch);
+    }
+
+    leveldb::Status Delete(const leveldb::WriteOptions& options, const leveldb::Slice& key) override
+    {
+        leveldb::WriteBatch batch;
+        batch.Delete(key);
+        return Write(options, &batch);
+    }
+
+    leveldb::Status Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* updates) override
+    {
+        leveldb::Status status;
+        {
+            LOCK(m_mutex);
+            if (!m_fActive) {
+                status = m_base->Write(options, updates);
+            } else {
+                CBatchHandler handler(m_buffer);
+                status = updates->Iterate(&handler);
+                if (options.sync) m_fSync = true;
+            }
+        }
+        // the cached values are invalidated after the write, so the old values can't be cached again
+        if (m_pCache) {
+            CInvalidateHandler handler(*m_pCache);
+            updates->Iterate(&handler);
+        }
+        return status;
+    }
+
+    leveldb::Status Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) override
+    {
+        if (!options.snapshot) {
+            LOCK(m_mutex);
+            BufferMap::const_iterator it = m_buffer.find(key.ToString());
+            if (it != m_buffer.end()) {
+                if (!it->second) return leveldb::Status::NotFound(leveldb::Slice());
+                *value = *it->second;
+                return leveldb::Status::OK();
+            }
+        }
+        return m_base->Get(options, key, value);
+    }
+
+    leveldb::Iterator* NewIterator(const leveldb::ReadOptions& options) override
+    {
+        if (options.snapshot) return m_base->NewIterator(options);
+
+        LOCK(m_mutex);
+        leveldb::Iterator* base = m_base->NewIterator(options);
+        if (m_buffer.empty()) return base;
+        return new CBufferedIterator(base, m_buffer);
+    }
+
+    const leveldb::Snapshot* GetSnapshot() override { return m_base->GetSnapshot(); }
+    void ReleaseSnapshot(const leveldb::Snapshot* snapshot) override { m_base->ReleaseSnapshot(snapshot); }
+    bool GetProperty(const leveldb::Slice& property, std::string* value) override { return m_base->GetProperty(property, value); }
+    void GetApproximateSizes(const leveldb::Range* range, int n, uint64_t* sizes) override { m_base->GetApproximateSizes(range, n, sizes); }
+    void CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end) override { m_base->CompactRange(begin, end); }
+};
+
+CDBReadCache::CDBReadCache(size_t nMaxEntries)
+  : m_nMaxEntries(nMaxEntries), m_nGeneration(0), m_nHits(0), m_nMisses(0)
+{
+}
+
+void CDBReadCache::Erase(std::map<std::string, EntryList::iterator>::iterator it)
+{
+    m_entries.erase(it->second);
+    m_index.erase(it);
+}
+
+bool CDBReadCache::Lookup(const std::string& key, std::shared_ptr<const Value>& value)
+{
+    LOCK(m_mutex);
+    std::map<std::string, EntryList::iterator>::const_iterator it = m_index.find(key);
+    if (it == m_index.end()) {
+        ++m_nMisses;
+        return false;
+    }
+    ++m_nHits;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    value = it->second->second;
+    return true;
+}
+
+uint64_t CDBReadCache::GetGeneration() const
+{
+    LOCK(m_mutex);
+    return m_nGeneration;
+}
+
+void CDBReadCache::Insert(const std::string& key, const std::shared_ptr<const Value>& value, uint64_t nGeneration)
+{
+    LOCK(m_mutex);
+    if (nGeneration != m_nGeneration || m_nMaxEntries == 0) return;
+
+    std::map<std::string, EntryList::iterator>::iterator it = m_index.find(key);
+    if (it != m_index.end()) Erase(it);
+    m_entries.emplace_front(key, value);
+    m_index.emplace(key, m_entries.begin());
+    // the least recently used value is evicted
+    if (m_entries.size() > m_nMaxEntries) {
+        Erase(m_index.find(m_entries.back().first));
+    }
+}
+
+void CDBReadCache::Invalidate(const leveldb::Slice& key)
+{
+    LOCK(m_mutex);
+    ++m_nGeneration;
+    if (m_index.empty()) return;
+
+    std::map<std::string, EntryList::iterator>::iterator it = m_index.find(key.ToString());
+    if (it != m_index.end()) Erase(it);
+
+    for (const auto& dependency : m_dependencies) {
+        if (!dependency.first(key)) continue;
+        const std::string& prefix = dependency.second;
+        it = m_index.lower_bound(prefix);
+        while (it != m_index.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+            Erase(it++);
+        }
+    }
+}
+
+void CDBReadCache::AddDependency(const std::function<bool(const leveldb::Slice&)>& fnMatch, const std::string& prefix)
+{
+    LOCK(m_mutex);
+    m_dependencies.emplace_back(fnMatch, prefix);
+}
+
+void CDBReadCache::Clear()
+{
+    LOCK(m_mutex);
+    ++m_nGeneration;
+    m_entries.clear();
+    m_index.clear();
+}
+
+size_t CDBReadCache::Size() const
+{
+    LOCK(m_mutex);
+    return m_entries.size();
+}
+
+/**
+ * Enables the cache of decoded values of point reads, which holds at most nMaxEntries values.
+ */
+void CDBBase::EnableReadCache(size_t nMaxEntries)
+{
+    assert(!m_read_cache);
+    m_read_cache.reset(new CDBReadCache(nMaxEntries));
+    if (pbuffer) pbuffer->SetReadCache(m_read_cache.get());
+}
 
 /**
  * Opens or creates a LevelDB based database.
  */
-leveldb::Status CDBBase::Open(const fs::path& path, bool fWipe)
+/**
+ * Takes ownership of a database, which is deleted and marked as released, once the last reference is gone.
+ */
+static std::shared_ptr<leveldb::DB> ShareDB(leveldb::DB* pdb, const std::shared_ptr<bool>& released)
+{
+    return std::shared_ptr<leveldb::DB>(pdb, [released](leveldb::DB* p) {
+        delete p;
+        {
+            LOCK(g_release_mutex);
+            *released = true;
+        }
+        g_release_cv.notify_all();
+    });
+}
+
+leveldb::Status CDBBase::Open(const fs::path& path, bool fWipe, bool fCompressible)
 {
+    // the database may have been replaced, while it was closed
+    if (m_read_cache) m_read_cache->Clear();
+    m_path = path;
+    m_fCompressible = fCompressible;
+    if (g_unified_db && path.parent_path() == g_unified_path) {
+        // the store is a key range of the unified database, prefixed by its name
+        CPrefixedDB* pstore = new CPrefixedDB(g_unified_db, path.filename().string() + "/");
+        leveldb::Status status = fWipe ? pstore->Wipe() : leveldb::Status::OK();
+        PrintToLogVerbose(msc_debug_persistence, "Opening %s in unified LevelDB %s\n", path.filename().string(), g_unified_path.string());
+        m_released = std::make_shared<bool>(false);
+        pbuffer = new CBufferedDB(ShareDB(pstore, m_released));
+        pbuffer->SetReadCache(m_read_cache.get());
+        pdb = pbuffer;
+        return status;
+    }
+
     if (fWipe) {
-        if (msc_debug_persistence) PrintToLog("Wiping LevelDB in %s\n", path.string());
+        PrintToLogVerbose(msc_debug_persistence, "Wiping LevelDB in %s\n", path.string());
         leveldb::DestroyDB(path.string(), options);
     }
     TryCreateDirectories(path);
-    if (msc_debug_persistence) PrintToLog("Opening LevelDB in %s\n", path.string());
+    PrintToLogVerbose(msc_debug_persistence, "Opening LevelDB in %s\n", path.string());
+
+    // point lookups are served by the shared block cache and bloom filters, if configured
+    options.block_cache = g_block_cache.get();
+    options.filter_policy = g_filter_policy.get();
+    // blocks are stored uncompressed, if LevelDB is built without Snappy
+    options.compression = g_compression && fCompressible ? leveldb::kSnappyCompression : leveldb::kNoCompression;
 
-    return leveldb::DB::Open(options, path.string(), &pdb);
+    leveldb::DB* pbase = NULL;
+    leveldb::Status status = leveldb::DB::Open(options, path.string(), &pbase);
+    if (status.ok()) {
+        m_released = std::make_shared<bool>(false);
+        pbuffer = new CBufferedDB(ShareDB(pbase, m_released));
+        pbuffer->SetReadCache(m_read_cache.get());
+        pdb = pbuffer;
+    }
+
+    return status;
 }
 
 /**
@@ -43,6 +738,7 @@ void CDBBase::Clear()
     delete it;
 
     leveldb::Status status = pdb->Write(writeoptions, &batch);
+    if (m_read_cache) m_read_cache->Clear();
     nRead = 0;
     nWritten = 0;
 
@@ -52,15 +748,501 @@ void CDBBase::Clear()
             n, status.ToString(), (n > 0 ? (0.001 * nTime / n) : 0), 0.001 * nTime);
 }
 
+/** References of an iterator to the database and the snapshot it reads. */
+struct CIteratorReferences
+{
+    std::shared_ptr<leveldb::DB> base;
+    std::shared_ptr<const leveldb::Snapshot> snapshot;
+};
+
+/** Releases the references held by an iterator, after the iterator itself was destroyed. */
+static void ReleaseIteratorReferences(void* arg1, void* /* arg2 */)
+{
+    delete static_cast<CIteratorReferences*>(arg1);
+}
+
+/**
+ * Creates and returns a new iterator over the database after the last processed block.
+ */
+leveldb::Iterator* CDBBase::NewSnapshotIterator() const
+{
+    return NewSnapshotIterator(GetPublishedSnapshot());
+}
+
+/**
+ * Creates and returns a new iterator over the given snapshot, or the committed state, if none is given.
+ */
+leveldb::Iterator* CDBBase::NewSnapshotIterator(const std::shared_ptr<const leveldb::Snapshot>& snapshot) const
+{
+    assert(pbuffer != NULL);
+    leveldb::ReadOptions options = iteroptions;
+    options.snapshot = snapshot.get();
+    leveldb::Iterator* it = pbuffer->Base()->NewIterator(options);
+    // the iterator retains the database and the snapshot, until it is deleted, even if the database is closed
+    it->RegisterCleanup(&ReleaseIteratorReferences, new CIteratorReferences{pbuffer->SharedBase(), snapshot}, nullptr);
+    return it;
+}
+
+/**
+ * Reads a value of the database after the last processed block.
+ */
+leveldb::Status CDBBase::SnapshotGet(const leveldb::Slice& key, std::string* value) const
+{
+    assert(pbuffer != NULL);
+    std::shared_ptr<const leveldb::Snapshot> snapshot = GetPublishedSnapshot();
+
+    leveldb::ReadOptions options = readoptions;
+    options.snapshot = snapshot.get();
+    return pbuffer->Base()->Get(options, key, value);
+}
+
+/**
+ * Publishes the committed state of the database to readers of the snapshot.
+ */
+void CDBBase::PublishSnapshot()
+{
+    assert(pbuffer != NULL);
+    // the snapshot keeps the database open, until it is released
+    std::shared_ptr<leveldb::DB> base = pbuffer->SharedBase();
+    std::shared_ptr<const leveldb::Snapshot> snapshot(base->GetSnapshot(),
+            [base](const leveldb::Snapshot* p) { base->ReleaseSnapshot(p); });
+
+    // the previous snapshot is released, once the last reader is done with it
+    LOCK(m_snapshot_mutex);
+    m_snapshot.swap(snapshot);
+}
+
+/**
+ * Returns the snapshot published after the last processed block, or nullptr, if none was published.
+ */
+std::shared_ptr<const leveldb::Snapshot> CDBBase::GetPublishedSnapshot() const
+{
+    LOCK(m_snapshot_mutex);
+    return m_snapshot;
+}
+
+/**
+ * Calls a function for every entry of the database in a snapshot, in the order of the keys.
+ */
+bool CDBBase::ForEachEntry(const std::shared_ptr<const leveldb::Snapshot>& snapshot,
+        const std::function<bool(const leveldb::Slice&, const leveldb::Slice&)>& fn) const
+{
+    std::unique_ptr<leveldb::Iterator> it(NewSnapshotIterator(snapshot));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (!fn(it->key(), it->value())) return false;
+    }
+    return it->status().ok();
+}
+
+/**
+ * Adds the entry of a key, which is written in a block, to the undo log of the database.
+ *
+ * Key: '~' + block + written key
+ *
+ * The block is stored in big endian byte order, so the entries are sorted by block.
+ */
+void CDBBase::LogWrittenKey(leveldb::WriteBatch& batch, int block, const std::string& key)
+{
+    batch.Put(UndoLogPrefix(block) + key, leveldb::Slice());
+}
+
+/**
+ * Returns whether a key belongs to the undo log, and not to a record of the database.
+ */
+bool CDBBase::IsUndoLogKey(const leveldb::Slice& key)
+{
+    return key.size() > UNDO_LOG_PREFIX_SIZE && key[0] == DB_UNDO_LOG;
+}
+
+/**
+ * Returns the keys written in or above a block, according to the undo log.
+ */
+std::set<std::string> CDBBase::GetKeysWrittenAbove(int block, leveldb::WriteBatch& batch) const
+{
+    std::set<std::string> setKeys;
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->Seek(UndoLogPrefix(block)); it->Valid() && IsUndoLogKey(it->key()); it->Next()) {
+        const leveldb::Slice& key = it->key();
+        setKeys.insert(std::string(key.data() + UNDO_LOG_PREFIX_SIZE, key.size() - UNDO_LOG_PREFIX_SIZE));
+        batch.Delete(key);
+    }
+
+    delete it;
+    return setKeys;
+}
+
+/**
+ * Returns the keys written below a block, according to the undo log.
+ */
+std::set<std::string> CDBBase::GetKeysWrittenBelow(int block, leveldb::WriteBatch& batch) const
+{
+    std::set<std::string> setKeys;
+    const std::string end = UndoLogPrefix(block);
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->Seek(UndoLogPrefix(0)); it->Valid() && IsUndoLogKey(it->key()) && it->key().compare(end) < 0; it->Next()) {
+        const leveldb::Slice& key = it->key();
+        setKeys.insert(std::string(key.data() + UNDO_LOG_PREFIX_SIZE, key.size() - UNDO_LOG_PREFIX_SIZE));
+        batch.Delete(key);
+    }
+
+    delete it;
+    return setKeys;
+}
+
+/**
+ * Removes entries of the undo log below a block, while the logged keys are kept.
+ */
+size_t CDBBase::PruneUndoLog(int block, size_t nMax)
+{
+    size_t nPruned = 0;
+    leveldb::WriteBatch batch;
+    const std::string end = UndoLogPrefix(block);
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->Seek(UndoLogPrefix(0)); nPruned < nMax && it->Valid() && IsUndoLogKey(it->key()) && it->key().compare(end) < 0; it->Next()) {
+        batch.Delete(it->key());
+        ++nPruned;
+    }
+    delete it;
+
+    if (nPruned > 0) {
+        leveldb::Status status = pdb->Write(writeoptions, &batch);
+        if (!status.ok()) {
+            PrintToLog("%s(): failed to prune the undo log of %s: %s\n", __func__, GetName(), status.ToString());
+            return 0;
+        }
+        ScheduleCompaction(batch);
+    }
+    return nPruned;
+}
+
+/**
+ * Starts to buffer writes in memory, until the batch is committed.
+ */
+void CDBBase::BeginBatch()
+{
+    assert(pbuffer != NULL);
+    pbuffer->Begin();
+}
+
+/**
+ * Writes all buffered writes to the database at once, and ends the batch.
+ */
+leveldb::Status CDBBase::CommitBatch()
+{
+    assert(pbuffer != NULL);
+    leveldb::Status status = pbuffer->Commit();
+    if (!status.ok()) {
+        PrintToLog("%s(): failed to write batch: %s\n", __func__, status.ToString());
+        // the cache may hold values of the discarded writes
+        if (m_read_cache) m_read_cache->Clear();
+    }
+    return status;
+}
+
+/**
+ * Writes the buffered writes of several databases, and ends their batches.
+ *
+ * The writes of stores within the unified database are written at once.
+ */
+leveldb::Status CDBBase::CommitBatches(const std::vector<CDBBase*>& vDatabases)
+{
+    leveldb::Status result;
+    leveldb::WriteBatch batch;
+    leveldb::WriteOptions options;
+    leveldb::DB* punified = nullptr;
+    size_t nWrites = 0;
+    std::vector<CDBBase*> vGrouped;
+
+    for (CDBBase* pdb : vDatabases) {
+        assert(pdb->pbuffer != NULL);
+        const CPrefixedDB* pstore = dynamic_cast<const CPrefixedDB*>(pdb->pbuffer->Base());
+        if (!pstore) {
+            leveldb::Status status = pdb->CommitBatch();
+            if (result.ok()) result = status;
+            continue;
+        }
+        assert(!punified || punified == pstore->Base());
+        punified = pstore->Base();
+        nWrites += pdb->pbuffer->AppendTo(batch, pstore->Prefix(), options.sync);
+        vGrouped.push_back(pdb);
+    }
+
+    if (nWrites > 0) {
+        leveldb::Status status = punified->Write(options, &batch);
+        if (!status.ok()) {
+            PrintToLog("%s(): failed to write batch: %s\n", __func__, status.ToString());
+            if (result.ok()) result = status;
+            for (CDBBase* pdb : vGrouped) {
+                if (pdb->m_read_cache) pdb->m_read_cache->Clear();
+            }
+        }
+    }
+    for (CDBBase* pdb : vGrouped) {
+        pdb->pbuffer->Release();
+    }
+
+    return result;
+}
+
+/**
+ * Retrieves the writes buffered by the active batch, ordered by key.
+ */
+void CDBBase::GetBatchWrites(std::vector<CDBWrite>& vWrites) const
+{
+    assert(pbuffer != NULL);
+    pbuffer->GetWrites(vWrites);
+}
+
+/**
+ * Applies writes, which were buffered by the same database of another node.
+ */
+leveldb::Status CDBBase::ApplyWrites(const std::vector<CDBWrite>& vWrites)
+{
+    assert(pdb != NULL);
+    leveldb::WriteBatch batch;
+    for (const CDBWrite& write : vWrites) {
+        if (write.second) {
+            batch.Put(write.first, *write.second);
+        } else {
+            batch.Delete(write.first);
+        }
+    }
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    if (!status.ok()) {
+        PrintToLog("%s(): failed to apply %d writes to %s: %s\n", __func__, vWrites.size(), GetName(), status.ToString());
+        return status;
+    }
+    nWritten += vWrites.size();
+    OnWritesApplied(vWrites);
+    return status;
+}
+
+/**
+ * Switches the database into or out of bulk-load mode.
+ */
+leveldb::Status CDBBase::SetBulkLoad(bool fEnable)
+{
+    assert(pdb != NULL);
+    if (fEnable == m_fBulkLoad) return leveldb::Status::OK();
+    m_fBulkLoad = fEnable;
+
+    readoptions.verify_checksums = !fEnable;
+    iteroptions.verify_checksums = !fEnable;
+    syncoptions.sync = !fEnable;
+
+    if (!fEnable) {
+        // the tables written in bulk are merged, before regular processing continues
+        int64_t nTimeStart = GetTimeMicros();
+        leveldb::Status status = CommitBatch();
+        if (!status.ok()) return status;
+        pdb->CompactRange(NULL, NULL);
+        PrintToLogVerbose(msc_debug_persistence, "Compacted LevelDB in %s in %.3f s\n", m_path.string(), 0.000001 * (GetTimeMicros() - nTimeStart));
+    }
+
+    if (dynamic_cast<const CPrefixedDB*>(pbuffer->Base())) {
+        return leveldb::Status::OK();
+    }
+
+    options.paranoid_checks = !fEnable;
+    options.write_buffer_size = fEnable ? OMNI_DB_BULK_LOAD_WRITE_BUFFER : leveldb::Options().write_buffer_size;
+
+    const fs::path path = m_path;
+    Close();
+    leveldb::Status status = Open(path, false, m_fCompressible);
+    PrintToLog("Reopening LevelDB in %s %s bulk-load mode: %s\n", path.string(), fEnable ? "in" : "without", status.ToString());
+    return status;
+}
+
+namespace {
+/** Collects the range of the keys deleted by a write batch. */
+class CDeletedRangeHandler : public leveldb::WriteBatch::Handler
+{
+public:
+    std::string begin;
+    std::string end;
+    bool fFound;
+
+    CDeletedRangeHandler() : fFound(false) {}
+
+    void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {}
+
+    void Delete(const leveldb::Slice& key) override
+    {
+        if (!fFound || key.compare(begin) < 0) begin = key.ToString();
+        if (!fFound || key.compare(end) > 0) end = key.ToString();
+        fFound = true;
+    }
+};
+}
+
+/**
+ * Schedules the compaction of the range of keys deleted by a batch.
+ */
+void CDBBase::ScheduleCompaction(const leveldb::WriteBatch& batch)
+{
+    // in bulk-load mode the whole database is compacted at the end
+    if (m_fBulkLoad) return;
+
+    CDeletedRangeHandler handler;
+    if (!batch.Iterate(&handler).ok() || !handler.fFound) return;
+
+    LOCK(g_compaction_mutex);
+    auto it = g_pending_compactions.find(this);
+    if (it == g_pending_compactions.end()) {
+        g_pending_compactions.emplace(this, std::make_pair(handler.begin, handler.end));
+        return;
+    }
+    if (handler.begin < it->second.first) it->second.first = handler.begin;
+    if (handler.end > it->second.second) it->second.second = handler.end;
+}
+
+/**
+ * Compacts the ranges of deleted keys of the databases, which are not writing a block.
+ */
+void CDBBase::RunPendingCompactions()
+{
+    std::set<const CDBBase*> setSkipped;
+    while (true) {
+        CDBBase* pcompact = nullptr;
+        std::pair<std::string, std::string> range;
+        {
+            LOCK(g_compaction_mutex);
+            for (auto it = g_pending_compactions.begin(); it != g_pending_compactions.end(); ++it) {
+                if (setSkipped.count(it->first)) continue;
+                CDBBase* pcandidate = const_cast<CDBBase*>(it->first);
+                if (pcandidate->pbuffer->IsActive()) {
+                    setSkipped.insert(it->first);
+                    continue;
+                }
+                pcompact = pcandidate;
+                range = it->second;
+                g_pending_compactions.erase(it);
+                g_compacting = pcompact;
+                break;
+            }
+        }
+        if (!pcompact) return;
+
+        // the database isn't closed, while it's compacted
+        int64_t nTimeStart = GetTimeMicros();
+        const leveldb::Slice begin(range.first), end(range.second);
+        pcompact->pbuffer->CompactRange(&begin, &end);
+        PrintToLogVerbose(msc_debug_persistence, "Compacted deleted range of %s in %.3f s\n",
+                pcompact->GetName(), 0.000001 * (GetTimeMicros() - nTimeStart));
+
+        {
+            LOCK(g_compaction_mutex);
+            g_compacting = nullptr;
+        }
+        g_compaction_cv.notify_all();
+    }
+}
+
+/**
+ * Returns whether a range of the database waits to be compacted.
+ */
+bool CDBBase::HasPendingCompaction() const
+{
+    LOCK(g_compaction_mutex);
+    return g_pending_compactions.count(this) > 0 || g_compacting == this;
+}
+
+/**
+ * Reads a property of LevelDB.
+ */
+bool CDBBase::GetProperty(const std::string& property, std::string& value) const
+{
+    if (!pdb) return false;
+    return pdb->GetProperty(property, &value);
+}
+
+/**
+ * Returns the approximate size of the entries of the database on disk.
+ *
+ * Stores within the unified database report the size of their own entries.
+ */
+uint64_t CDBBase::GetApproximateSize() const
+{
+    if (!pdb) return 0;
+    // no key of the Omni databases starts with this many 0xff bytes
+    const std::string strLimit(64, '\xff');
+    const leveldb::Range range(leveldb::Slice(), strLimit);
+    uint64_t nSize = 0;
+    pdb->GetApproximateSizes(&range, 1, &nSize);
+    return nSize;
+}
+
+/**
+ * Opens the unified database, which holds the stores opened within its directory.
+ */
+leveldb::Status OpenUnifiedDB(const fs::path& path)
+{
+    assert(!g_unified_db);
+    leveldb::Options options;
+    options.paranoid_checks = true;
+    options.create_if_missing = true;
+    options.max_open_files = 64;
+    options.block_cache = g_block_cache.get();
+    options.filter_policy = g_filter_policy.get();
+    options.compression = g_compression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+
+    TryCreateDirectories(path);
+    leveldb::DB* pbase = NULL;
+    leveldb::Status status = leveldb::DB::Open(options, path.string(), &pbase);
+    if (status.ok()) {
+        g_unified_db.reset(pbase);
+        g_unified_path = path;
+    }
+    PrintToLog("Opening unified Omni database in %s: %s\n", path.string(), status.ToString());
+    return status;
+}
+
+/**
+ * Closes the unified database, once the stores within it are closed.
+ */
+void CloseUnifiedDB()
+{
+    g_unified_db.reset();
+    g_unified_path = fs::path();
+}
+
 /**
  * Deinitializes and closes the database.
+ *
+ * Writes, which are still buffered, are written to the database before, and
+ * snapshots and iterators still held by readers are waited for.
  */
 void CDBBase::Close()
 {
+    {
+        // a running background compaction is finished first
+        WAIT_LOCK(g_compaction_mutex, lock);
+        g_pending_compactions.erase(this);
+        while (g_compacting == this) {
+            g_compaction_cv.wait(lock);
+        }
+    }
+    {
+        LOCK(m_snapshot_mutex);
+        m_snapshot.reset();
+    }
     if (pdb) {
+        // a failed write is logged, but the database is closed anyway
+        CommitBatch();
         delete pdb;
         pdb = NULL;
+        pbuffer = NULL;
+
+        // snapshots and iterators of readers keep the database open, so it can be reopened only after them
+        WAIT_LOCK(g_release_mutex, lock);
+        while (!*m_released) {
+            g_release_cv.wait(lock);
+        }
     }
+    if (m_read_cache) m_read_cache->Clear();
 }
 
 
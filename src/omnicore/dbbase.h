@@ -3,10 +3,157 @@
 
 #include <leveldb/db.h>
 
+#include <clientversion.h>
 #include <fs.h>
+#include <serialize.h>
+#include <streams.h>
+#include <sync.h>
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include <exception>
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+class CBufferedDB;
+
+/** A write to a database, where a value of nullptr marks a deleted entry. */
+typedef std::pair<std::string, std::shared_ptr<const std::string> > CDBWrite;
+
+//! Default size of the block cache shared by the Omni databases in MiB
+static const int64_t DEFAULT_OMNI_DB_CACHE = 16;
+//! Default number of bits per key of the bloom filters of the Omni databases, 0 to disable
+static const int DEFAULT_OMNI_DB_BLOOM_BITS = 10;
+//! Default compression of the Omni databases
+static const bool DEFAULT_OMNI_DB_COMPRESSION = false;
+//! Default layout of the Omni state databases, where one database holds all stores
+static const bool DEFAULT_OMNI_UNIFIED_DB = false;
+//! Default minimum number of blocks of the initial scan to load the Omni databases in bulk, 0 to disable
+static const int DEFAULT_OMNI_BULK_LOAD_BLOCKS = 10000;
+//! Size of the write buffer of the Omni databases in bulk-load mode
+static const size_t OMNI_DB_BULK_LOAD_WRITE_BUFFER = 64 << 20;
+//! Interval in seconds, in which ranges of deleted keys of the Omni databases are compacted in the background
+static const int64_t OMNI_DB_COMPACTION_INTERVAL = 10;
+
+/**
+ * Configures the block cache, bloom filters and compression of the Omni databases.
+ *
+ * The block cache and filter policy are shared by all databases, and only apply to
+ * databases opened afterwards. It must not be called, while a database is open.
+ *
+ * @param nCacheSize    The size of the shared block cache in bytes, 0 to disable
+ * @param nBloomBits    The number of bits per key of the bloom filters, 0 to disable
+ * @param fCompression  Whether to compress the tables of the databases, which are opened as compressible, with Snappy
+ */
+void ConfigureDBOptions(size_t nCacheSize, int nBloomBits, bool fCompression);
+
+/**
+ * Opens the unified database, which holds all stores opened within its directory.
+ *
+ * Databases, which are opened at a path within the directory of the unified database,
+ * become key ranges of it, prefixed by their name, and share its log, memtable and
+ * compaction. Their batches are written at once by CDBBase::CommitBatches().
+ *
+ * @param path  The path of the unified database
+ * @return A Status object, indicating success or failure
+ */
+leveldb::Status OpenUnifiedDB(const fs::path& path);
+
+/**
+ * Closes the unified database, after all stores within it were closed.
+ */
+void CloseUnifiedDB();
+
+/**
+ * Bounded cache of decoded values read from a database, which evicts the least recently used values.
+ *
+ * Every write of a key through the database invalidates its cached value, so the cache reflects
+ * the database including the active batch. Keys, which were not found, are cached as well.
+ * Results derived from several entries can be cached under keys, which don't exist in the
+ * database, and are invalidated by writes of the keys they depend on.
+ *
+ * The cache is thread-safe.
+ */
+class CDBReadCache
+{
+public:
+    /** A decoded value of any type. */
+    struct Value
+    {
+        virtual ~Value() {}
+    };
+
+    template <typename T>
+    struct TypedValue : public Value
+    {
+        T value;
+
+        explicit TypedValue(const T& valueIn) : value(valueIn) {}
+    };
+
+private:
+    typedef std::list<std::pair<std::string, std::shared_ptr<const Value> > > EntryList;
+
+    mutable Mutex m_mutex;
+    const size_t m_nMaxEntries;
+    //! Cached values, the most recently used first, where nullptr marks a key, which was not found
+    EntryList m_entries GUARDED_BY(m_mutex);
+    //! Cached values by key
+    std::map<std::string, EntryList::iterator> m_index GUARDED_BY(m_mutex);
+    //! Prefixes of the derived results, which are invalidated by writes of matching keys
+    std::vector<std::pair<std::function<bool(const leveldb::Slice&)>, std::string> > m_dependencies GUARDED_BY(m_mutex);
+    //! Changed by every invalidation, so values read before aren't cached afterwards
+    uint64_t m_nGeneration GUARDED_BY(m_mutex);
+
+    std::atomic<uint64_t> m_nHits;
+    std::atomic<uint64_t> m_nMisses;
+
+    void Erase(std::map<std::string, EntryList::iterator>::iterator it) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+public:
+    explicit CDBReadCache(size_t nMaxEntries);
+
+    /**
+     * Looks up the value of a key, and counts the hit or miss.
+     *
+     * @param key    The key
+     * @param value  The cached value, or nullptr, if the key was not found in the database
+     * @return False, if the key is not cached
+     */
+    bool Lookup(const std::string& key, std::shared_ptr<const Value>& value);
+
+    /** Returns the generation, which is passed to Insert() after reading a value. */
+    uint64_t GetGeneration() const;
+
+    /** Caches the value of a key, unless the cache was invalidated since the generation was obtained. */
+    void Insert(const std::string& key, const std::shared_ptr<const Value>& value, uint64_t nGeneration);
+
+    /** Invalidates the value of a written key, and the derived results, which depend on it. */
+    void Invalidate(const leveldb::Slice& key);
+
+    /** Declares, that the results cached under the prefix are derived from the keys matching fnMatch. */
+    void AddDependency(const std::function<bool(const leveldb::Slice&)>& fnMatch, const std::string& prefix);
+
+    /** Removes all values. */
+    void Clear();
+
+    /** Returns the number of cached values. */
+    size_t Size() const;
+
+    /** Returns the number of lookups, which were served by the cache or not. */
+    uint64_t GetHits() const { return m_nHits; }
+    uint64_t GetMisses() const { return m_nMisses; }
+};
 
 /** Base class for LevelDB based storage.
  */
@@ -16,6 +163,25 @@ private:
     //! Options used when iterating over values of the database
     leveldb::ReadOptions iteroptions;
 
+    //! Path of the database, used to reopen it with other options
+    fs::path m_path;
+
+    //! Whether the tables are compressed, if compression is enabled, kept to reopen the database
+    bool m_fCompressible;
+
+    //! Whether the database is in bulk-load mode
+    bool m_fBulkLoad;
+
+    mutable Mutex m_snapshot_mutex;
+    //! Snapshot of the database after the last processed block, retained by readers as long as they need it
+    std::shared_ptr<const leveldb::Snapshot> m_snapshot GUARDED_BY(m_snapshot_mutex);
+
+    //! Cache of decoded values of point reads, if enabled by the store
+    std::unique_ptr<CDBReadCache> m_read_cache;
+
+    //! Set, once the last reference to the opened database was released
+    std::shared_ptr<bool> m_released;
+
 protected:
     //! Database options used
     leveldb::Options options;
@@ -29,16 +195,19 @@ protected:
     //! Options used when sync writing to the database
     leveldb::WriteOptions syncoptions;
 
-    //! The database itself
+    //! The database itself, accessed through the write buffer
     leveldb::DB* pdb;
 
+    //! Write buffer, which holds back writes of a batch
+    CBufferedDB* pbuffer;
+
     //! Number of entries read
     unsigned int nRead;
 
     //! Number of entries written
     unsigned int nWritten;
 
-    CDBBase() : pdb(NULL), nRead(0), nWritten(0)
+    CDBBase() : m_fCompressible(false), m_fBulkLoad(false), pdb(NULL), pbuffer(NULL), nRead(0), nWritten(0)
     {
         options.paranoid_checks = true;
         options.create_if_missing = true;
@@ -69,29 +238,358 @@ protected:
         return pdb->NewIterator(iteroptions);
     }
 
+    /**
+     * Creates and returns a new iterator over the database after the last processed block.
+     *
+     * The iterator observes the snapshot published by PublishSnapshot(), or the committed
+     * state, if none was published. Writes of the block in progress are not visible, so
+     * readers don't need to hold cs_tally. The iterator is owned by the caller.
+     *
+     * @return A new LevelDB iterator
+     */
+    leveldb::Iterator* NewSnapshotIterator() const;
+
+    /**
+     * Creates and returns a new iterator over the given snapshot, or the committed state, if none is given.
+     */
+    leveldb::Iterator* NewSnapshotIterator(const std::shared_ptr<const leveldb::Snapshot>& snapshot) const;
+
+    /**
+     * Reads a value of the database after the last processed block.
+     *
+     * @param key    The key to look up
+     * @param value  The value, if found
+     * @return A Status object, indicating success, failure, or that the key was not found
+     */
+    leveldb::Status SnapshotGet(const leveldb::Slice& key, std::string* value) const;
+
+    /**
+     * Enables the cache of decoded values of point reads, which holds at most nMaxEntries values.
+     *
+     * Stores, whose recent entries are read repeatedly, opt in with their own size, before
+     * the database is opened.
+     */
+    void EnableReadCache(size_t nMaxEntries);
+
+    /** Returns the read cache, or nullptr, if it's not enabled. */
+    CDBReadCache* GetReadCache() const { return m_read_cache.get(); }
+
+    /**
+     * Returns the cached value of a key, or obtains it with fnRead and caches it, if the read cache is enabled.
+     *
+     * fnRead returns OK with the value, NotFound, which is cached as well, or an error, which isn't.
+     */
+    template <typename T>
+    leveldb::Status ReadThrough(const std::string& key, T& value, const std::function<leveldb::Status(T&)>& fnRead) const;
+
+    /**
+     * Reads and decodes a value, which was encoded with EncodeDBValue(), through the read cache.
+     *
+     * @return OK, NotFound, or Corruption, if the value couldn't be decoded
+     */
+    template <typename T>
+    leveldb::Status CachedGet(const std::string& key, T& value);
+
     /**
      * Opens or creates a LevelDB based database.
      *
      * If the database is wiped before opening, it's content is destroyed, including
      * all log files and meta data.
      *
-     * @param path   The path of the database to open
-     * @param fWipe  Whether to wipe the database before opening
+     * Only databases with textual or repetitive values are compressible, because tables
+     * of hashes and integers hardly get smaller, but still cost the time to compress them.
+     *
+     * @param path           The path of the database to open
+     * @param fWipe          Whether to wipe the database before opening
+     * @param fCompressible  Whether the tables are compressed, if compression is enabled
      * @return A Status object, indicating success or failure
      */
-    leveldb::Status Open(const fs::path& path, bool fWipe = false);
+    leveldb::Status Open(const fs::path& path, bool fWipe = false, bool fCompressible = false);
 
     /**
      * Deinitializes and closes the database.
+     *
+     * Waits until the snapshots and iterators of other threads are released, so
+     * the calling thread must not hold any of them.
      */
     void Close();
 
+    /**
+     * Adds the entry of a key, which is written in a block, to the undo log of the database.
+     *
+     * The undo log is kept next to the records, ordered by block, so rolling back
+     * blocks only visits the keys written in them.
+     *
+     * @param batch  The batch, which writes the key
+     * @param block  The block, in which the key is written
+     * @param key    The written key
+     */
+    static void LogWrittenKey(leveldb::WriteBatch& batch, int block, const std::string& key);
+
+    /**
+     * Returns whether a key belongs to the undo log, and not to a record of the database.
+     */
+    static bool IsUndoLogKey(const leveldb::Slice& key);
+
+    /**
+     * Returns the keys written in or above a block, according to the undo log.
+     *
+     * The removal of the undo log entries is added to the batch.
+     *
+     * @param block  The first block to roll back
+     * @param batch  The batch, which rolls back the blocks
+     * @return The written keys
+     */
+    std::set<std::string> GetKeysWrittenAbove(int block, leveldb::WriteBatch& batch) const;
+
+    /**
+     * Returns the keys written below a block, according to the undo log.
+     *
+     * The removal of the undo log entries is added to the batch, so the entries of
+     * pruned history are only visited once.
+     *
+     * @param block  The first block to keep
+     * @param batch  The batch, which prunes the blocks
+     * @return The written keys
+     */
+    std::set<std::string> GetKeysWrittenBelow(int block, leveldb::WriteBatch& batch) const;
+
+    /**
+     * Schedules the compaction of the range of keys deleted by a batch.
+     *
+     * It is called after rolling back or pruning entries, so the tombstones are merged
+     * away by RunPendingCompactions(), before they slow down reads and later compactions.
+     * Ranges scheduled before the compaction ran are merged.
+     *
+     * @param batch  The batch, which was written
+     */
+    void ScheduleCompaction(const leveldb::WriteBatch& batch);
+
+    /**
+     * Updates data held in memory, after writes of another node were applied by ApplyWrites().
+     *
+     * Databases, which cache entries or track written keys, override it.
+     *
+     * @param vWrites  The applied writes
+     */
+    virtual void OnWritesApplied(const std::vector<CDBWrite>& /* vWrites */) {}
+
 public:
     /**
      * Deletes all entries of the database, and resets the counters.
      */
-    void Clear();
+    virtual void Clear();
+
+    /**
+     * Starts to buffer writes in memory, until the batch is committed.
+     *
+     * While a batch is active, reads and iterators observe the buffered writes.
+     * Starting a batch, while one is already active, has no effect.
+     */
+    void BeginBatch();
+
+    /**
+     * Writes all buffered writes to the database at once, and ends the batch.
+     *
+     * @return A Status object, indicating success or failure
+     */
+    leveldb::Status CommitBatch();
+
+    /**
+     * Writes the buffered writes of several databases, and ends their batches.
+     *
+     * The writes of all stores within the unified database are written in one atomic
+     * batch, the other databases are committed one after another.
+     *
+     * @param vDatabases  The databases to commit
+     * @return A Status object, indicating success or the first failure
+     */
+    static leveldb::Status CommitBatches(const std::vector<CDBBase*>& vDatabases);
+
+    /**
+     * Retrieves the writes buffered by the active batch, ordered by key.
+     *
+     * @param vWrites  The buffered writes
+     */
+    void GetBatchWrites(std::vector<CDBWrite>& vWrites) const;
+
+    /**
+     * Applies writes, which were buffered by the same database of another node.
+     *
+     * The writes are buffered, if a batch is active, and cached data is updated.
+     *
+     * @param vWrites  The writes to apply
+     * @return A Status object, indicating success or failure
+     */
+    leveldb::Status ApplyWrites(const std::vector<CDBWrite>& vWrites);
+
+    /**
+     * Removes entries of the undo log below a block, while the logged keys are kept.
+     *
+     * It's called for blocks, which can no longer be rolled back, and removes at most
+     * the given number of entries, so a long log is removed over several calls.
+     *
+     * @param block  The first block to keep
+     * @param nMax   The maximal number of entries to remove
+     * @return The number of removed entries
+     */
+    size_t PruneUndoLog(int block, size_t nMax);
+
+    /**
+     * Compacts the ranges of deleted keys of the databases, which are not writing a block.
+     *
+     * It runs periodically on the scheduler thread. Databases with an active batch are
+     * skipped, and compacted during a later run.
+     */
+    static void RunPendingCompactions();
+
+    /** Returns whether a range of the database waits to be compacted. */
+    bool HasPendingCompaction() const;
+
+    /**
+     * Reads a property of LevelDB, such as "leveldb.stats".
+     *
+     * Stores within the unified database report the properties of the unified database.
+     *
+     * @param property  The name of the property
+     * @param value     The value of the property
+     * @return True, if the property is known
+     */
+    bool GetProperty(const std::string& property, std::string& value) const;
+
+    /** Returns the approximate size of the entries of the database on disk, in bytes. */
+    uint64_t GetApproximateSize() const;
+
+    /** Returns the name of the directory of the database. */
+    std::string GetName() const { return m_path.filename().string(); }
+
+    /** Returns the number of entries read and written since the database was opened or cleared. */
+    unsigned int GetReadCount() const { return nRead; }
+    unsigned int GetWriteCount() const { return nWritten; }
+
+    /** Returns the number of reads served by the read cache or not, and the number of cached values. */
+    uint64_t GetCacheHits() const { return m_read_cache ? m_read_cache->GetHits() : 0; }
+    uint64_t GetCacheMisses() const { return m_read_cache ? m_read_cache->GetMisses() : 0; }
+    size_t GetCacheSize() const { return m_read_cache ? m_read_cache->Size() : 0; }
+
+    /**
+     * Switches the database into or out of bulk-load mode.
+     *
+     * In bulk-load mode the database is reopened with a large write buffer and without
+     * paranoid checks, reads don't verify checksums and writes are not synced. Leaving
+     * the mode commits the active batch, compacts the database and reopens it with the
+     * safe settings. Stores within the unified database keep the options of it, and only
+     * switch their read and write options.
+     *
+     * @param fEnable  Whether to enable bulk-load mode
+     * @return A Status object, indicating success or failure
+     */
+    leveldb::Status SetBulkLoad(bool fEnable);
+
+    /**
+     * Publishes the committed state of the database to readers of the snapshot.
+     *
+     * It is called after the writes of a block were committed, so readers always
+     * observe the database at a block boundary.
+     */
+    void PublishSnapshot();
+
+    /**
+     * Returns the snapshot published after the last processed block, or nullptr, if none was published.
+     */
+    std::shared_ptr<const leveldb::Snapshot> GetPublishedSnapshot() const;
+
+    /**
+     * Calls a function for every entry of the database in a snapshot, in the order of the keys.
+     *
+     * @param snapshot  The snapshot to read, or nullptr for the committed state
+     * @param fn        The function, which returns false to stop
+     * @return False, if the function stopped, or if the database couldn't be read
+     */
+    bool ForEachEntry(const std::shared_ptr<const leveldb::Snapshot>& snapshot,
+            const std::function<bool(const leveldb::Slice&, const leveldb::Slice&)>& fn) const;
+
+    /** Returns whether the database is in bulk-load mode, where writes of several blocks are committed at once. */
+    bool IsBulkLoad() const { return m_fBulkLoad; }
 };
 
 
+//! Version of the binary encoding of database values, which is stored in front of every value
+static const uint8_t DB_VALUE_FORMAT_VERSION = 1;
+
+/**
+ * Encodes a database value with the serialization framework, prefixed by the format version.
+ *
+ * @param obj  The object to encode
+ * @return The encoded value
+ */
+template <typename T>
+std::string EncodeDBValue(const T& obj)
+{
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << DB_VALUE_FORMAT_VERSION << obj;
+    return ssValue.str();
+}
+
+/**
+ * Decodes a database value, which was encoded with EncodeDBValue().
+ *
+ * @param value  The encoded value
+ * @param obj    The decoded object
+ * @return True, if the value is of the current format, and fully decoded
+ */
+template <typename T>
+bool DecodeDBValue(const leveldb::Slice& value, T& obj)
+{
+    try {
+        CDataStream ssValue(value.data(), value.data() + value.size(), SER_DISK, CLIENT_VERSION);
+        uint8_t nVersion = 0;
+        ssValue >> nVersion;
+        if (nVersion != DB_VALUE_FORMAT_VERSION) return false;
+        ssValue >> obj;
+        return ssValue.empty();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+template <typename T>
+leveldb::Status CDBBase::ReadThrough(const std::string& key, T& value, const std::function<leveldb::Status(T&)>& fnRead) const
+{
+    if (!m_read_cache) return fnRead(value);
+
+    std::shared_ptr<const CDBReadCache::Value> cached;
+    if (m_read_cache->Lookup(key, cached)) {
+        if (!cached) return leveldb::Status::NotFound(key);
+        // a value of another type is read again
+        const CDBReadCache::TypedValue<T>* pTyped = dynamic_cast<const CDBReadCache::TypedValue<T>*>(cached.get());
+        if (pTyped) {
+            value = pTyped->value;
+            return leveldb::Status::OK();
+        }
+    }
+
+    const uint64_t nGeneration = m_read_cache->GetGeneration();
+    leveldb::Status status = fnRead(value);
+    if (status.ok()) {
+        m_read_cache->Insert(key, std::make_shared<const CDBReadCache::TypedValue<T> >(value), nGeneration);
+    } else if (status.IsNotFound()) {
+        m_read_cache->Insert(key, nullptr, nGeneration);
+    }
+    return status;
+}
+
+template <typename T>
+leveldb::Status CDBBase::CachedGet(const std::string& key, T& value)
+{
+    return ReadThrough<T>(key, value, [this, &key](T& decoded) {
+        std::string strValue;
+        leveldb::Status status = pdb->Get(readoptions, key, &strValue);
+        if (!status.ok()) return status;
+        ++nRead;
+        if (!DecodeDBValue(strValue, decoded)) return leveldb::Status::Corruption(key, "unexpected format");
+        return status;
+    });
+}
+
 #endif // BITCOIN_OMNICORE_DBBASE_H
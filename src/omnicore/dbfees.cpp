@@ -6,22 +6,27 @@
 
 #include <omnicore/dbfees.h>
 
+#include <omnicore/dbbalancechanges.h>
+#include <omnicore/indexproperties.h>
 #include <omnicore/log.h>
+#include <omnicore/omnicore.h>
 #include <omnicore/rules.h>
 #include <omnicore/sp.h>
 #include <omnicore/sto.h>
+#include <omnicore/tally.h>
 
+#include <crypto/common.h>
+#include <util/strencodings.h>
 #include <validation.h>
 
 #include <leveldb/db.h>
-
-#include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast.hpp>
+#include <leveldb/write_batch.h>
 
 #include <stdint.h>
 
 #include <limits>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -29,7 +34,83 @@ using namespace mastercore;
 
 std::map<uint32_t, int64_t> distributionThresholds;
 
-COmniFeeCache::COmniFeeCache(const fs::path& path, bool fWipe)
+namespace {
+/** Value of a fee distribution record, keyed by the number of the distribution. */
+struct FeeDistributionRecord
+{
+    int32_t block;
+    uint32_t propertyId;
+    int64_t total;
+
+    FeeDistributionRecord() : block(0), propertyId(0), total(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(block);
+        READWRITE(propertyId);
+        READWRITE(total);
+    }
+};
+}
+
+//! Prefix of the keys of the running total of the fee cache of a property
+static const char DB_FEE_TOTAL = 't';
+//! Prefix of the keys of the amount of the fee cache of a property at the end of a block
+static const char DB_FEE_BLOCK = 'b';
+//! Size of the keys of the running totals, and of the property part of the keys of the blocks
+static const size_t FEE_TOTAL_KEY_SIZE = 1 + sizeof(uint32_t);
+
+/** Returns the key of the running total of the fee cache of a property. */
+static std::string FeeTotalKey(uint32_t propertyId)
+{
+    unsigned char buf[FEE_TOTAL_KEY_SIZE];
+    buf[0] = DB_FEE_TOTAL;
+    WriteBE32(buf + 1, propertyId);
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/** Returns the key of the amount of the fee cache of a property at the end of a block, ordered by property and block. */
+static std::string FeeBlockKey(uint32_t propertyId, int block)
+{
+    unsigned char buf[FEE_TOTAL_KEY_SIZE + sizeof(uint32_t)];
+    buf[0] = DB_FEE_BLOCK;
+    WriteBE32(buf + 1, propertyId);
+    WriteBE32(buf + FEE_TOTAL_KEY_SIZE, static_cast<uint32_t>(block));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+//! Prefix of the keys of the fee distributions
+static const char DB_FEE_DISTRIBUTION = 'd';
+//! Prefix of the keys of the index of the fee distributions by property
+static const char DB_FEE_PROPERTY_INDEX = 'p';
+//! Prefix of the keys of the recipients of the fee distributions
+static const char DB_FEE_RECIPIENT = 'r';
+//! Size of the keys of the fee distributions, and of the prefix of their recipients
+static const size_t FEE_DISTRIBUTION_KEY_SIZE = 1 + sizeof(uint32_t);
+
+/** Returns the key of a fee distribution, or of its recipients with the given prefix. */
+static std::string FeeDistributionKey(int id, char prefix = DB_FEE_DISTRIBUTION)
+{
+    unsigned char buf[FEE_DISTRIBUTION_KEY_SIZE];
+    buf[0] = prefix;
+    WriteBE32(buf + 1, static_cast<uint32_t>(id));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/** Returns the key of a fee distribution in the index by property, ordered by property and distribution. */
+static std::string FeePropertyIndexKey(uint32_t propertyId, int id)
+{
+    unsigned char buf[1 + 2 * sizeof(uint32_t)];
+    buf[0] = DB_FEE_PROPERTY_INDEX;
+    WriteBE32(buf + 1, propertyId);
+    WriteBE32(buf + 5, static_cast<uint32_t>(id));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+COmniFeeCache::COmniFeeCache(const fs::path& path, bool fWipe) : fAllAmountsCached(false)
 {
     leveldb::Status status = Open(path, fWipe);
     PrintToConsole("Loading fee cache database: %s\n", status.ToString());
@@ -37,13 +118,15 @@ COmniFeeCache::COmniFeeCache(const fs::path& path, bool fWipe)
 
 COmniFeeCache::~COmniFeeCache()
 {
-    if (msc_debug_fees) PrintToLog("COmniFeeCache closed\n");
+    PrintToLogIf(msc_debug_fees, "COmniFeeCache closed\n");
 }
 
 // Returns the distribution threshold for a property
 int64_t COmniFeeCache::GetDistributionThreshold(const uint32_t &propertyId)
 {
-    return distributionThresholds[propertyId];
+    // the thresholds are only added by block processing, so lookups don't insert empty ones
+    std::map<uint32_t, int64_t>::const_iterator it = distributionThresholds.find(propertyId);
+    return (it != distributionThresholds.end()) ? it->second : 0;
 }
 
 // Sets the distribution thresholds to total tokens for a property / OMNI_FEE_THRESHOLD
@@ -61,55 +144,116 @@ void COmniFeeCache::UpdateDistributionThresholds(uint32_t propertyId)
 int64_t COmniFeeCache::GetCachedAmount(const uint32_t &propertyId)
 {
     assert(pdb);
-    // Get the fee history, set is sorted by block so last entry is most recent
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (!sCacheHistoryItems.empty()) {
-        std::set<feeCacheItem>::iterator endIt = sCacheHistoryItems.end();
-        --endIt;
-        feeCacheItem mostRecentItem = *endIt;
-        return mostRecentItem.second;
-    } else {
-        return 0; // property has never generated a fee
+    // the amount is kept in memory, and updated whenever the property is written
+    std::map<uint32_t, int64_t>::const_iterator cacheIt = cachedAmounts.find(propertyId);
+    if (cacheIt != cachedAmounts.end()) {
+        return cacheIt->second;
+    }
+    if (fAllAmountsCached) {
+        return 0;
     }
+
+    int64_t amount = 0; // property has never generated a fee
+    std::string strValue;
+    leveldb::Status status = pdb->Get(readoptions, FeeTotalKey(propertyId), &strValue);
+    if (!status.IsNotFound()) {
+        assert(status.ok());
+        ++nRead;
+        if (!DecodeDBValue(strValue, amount)) {
+            PrintToConsole("ERROR: fee cache total of property %d has an unexpected format (raw %s)!\n", propertyId, HexStr(strValue));
+            amount = 0;
+        }
+    }
+    cachedAmounts[propertyId] = amount;
+
+    return amount;
 }
 
-// Zeros a property in the fee cache
-void COmniFeeCache::ClearCache(const uint32_t &propertyId, int block)
+// Reads the running totals of all properties with one scan, unless they were read already
+void COmniFeeCache::LoadCachedAmounts()
 {
-    if (msc_debug_fees) PrintToLog("ClearCache starting (block %d, property ID %d)...\n", block, propertyId);
-    const std::string key = strprintf("%010d", propertyId);
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (msc_debug_fees) PrintToLog("   Iterating cache history (%d items)...\n",sCacheHistoryItems.size());
-    std::string newValue;
-    if (!sCacheHistoryItems.empty()) {
-        for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-            feeCacheItem tempItem = *it;
-            if (tempItem.first == block) continue;
-            if (!newValue.empty()) newValue += ",";
-            newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-            if (msc_debug_fees) PrintToLog("      Readding entry: block %d amount %d\n", tempItem.first, tempItem.second);
+    assert(pdb);
+    if (fAllAmountsCached) return;
+
+    const std::string prefix(1, DB_FEE_TOTAL);
+    leveldb::Iterator* it = NewIterator();
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        if (it->key().size() != FEE_TOTAL_KEY_SIZE) continue;
+        const uint32_t propertyId = ReadBE32(reinterpret_cast<const unsigned char*>(it->key().data() + 1));
+        int64_t amount = 0;
+        if (!DecodeDBValue(it->value(), amount)) {
+            PrintToConsole("ERROR: fee cache total of property %d has an unexpected format (raw %s)!\n", propertyId, HexStr(it->value().ToString()));
+            amount = 0;
         }
-        if (!newValue.empty()) newValue += ",";
+        ++nRead;
+        cachedAmounts[propertyId] = amount;
     }
-    if (msc_debug_fees) PrintToLog("   Adding zero valued entry: block %d\n", block);
-    newValue += strprintf("%d:%d", block, 0);
-    leveldb::Status status = pdb->Put(writeoptions, key, newValue);
+    delete it;
+
+    fAllAmountsCached = true;
+}
+
+// Returns the current amounts of the fee cache of all properties with fees, in ascending order of the properties
+std::map<uint32_t, int64_t> COmniFeeCache::GetCachedAmounts()
+{
+    LoadCachedAmounts();
+
+    std::map<uint32_t, int64_t> amounts;
+    for (const std::pair<const uint32_t, int64_t>& entry : cachedAmounts) {
+        if (entry.second != 0) amounts.insert(amounts.end(), entry);
+    }
+    return amounts;
+}
+
+// Deletes all entries of the fee cache
+void COmniFeeCache::Clear()
+{
+    cachedAmounts.clear();
+    fAllAmountsCached = false;
+    CDBBase::Clear();
+}
+
+// Discards the cached amounts, which are read from the database again
+void COmniFeeCache::OnWritesApplied(const std::vector<CDBWrite>& vWrites)
+{
+    cachedAmounts.clear();
+    fAllAmountsCached = false;
+}
+
+// Adds the amount of the fee cache of a property at the end of a block to the batch
+void COmniFeeCache::WriteCachedAmount(leveldb::WriteBatch& batch, const uint32_t &propertyId, int block, int64_t amount)
+{
+    const std::string totalKey = FeeTotalKey(propertyId);
+    const std::string value = EncodeDBValue(amount);
+    batch.Put(FeeBlockKey(propertyId, block), value);
+    batch.Put(totalKey, value);
+    LogWrittenKey(batch, block, totalKey);
+    cachedAmounts[propertyId] = amount;
+}
+
+// Zeros a property in the fee cache
+void COmniFeeCache::ClearCache(const uint32_t &propertyId, int block)
+{
+    PrintToLogIf(msc_debug_fees, "ClearCache starting (block %d, property ID %d)...\n", block, propertyId);
+    leveldb::WriteBatch batch;
+    WriteCachedAmount(batch, propertyId, block, 0);
+    PruneCache(propertyId, block, batch);
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
     assert(status.ok());
     ++nWritten;
+    ScheduleCompaction(batch);
 
-    PruneCache(propertyId, block);
-
-    if (msc_debug_fees) PrintToLog("Cleared cache for property %d block %d [%s]\n", propertyId, block, status.ToString());
+    PrintToLogIf(msc_debug_fees, "Cleared cache for property %d block %d [%s]\n", propertyId, block, status.ToString());
 }
 
 // Adds a fee to the cache (eg on a completed trade)
 void COmniFeeCache::AddFee(const uint32_t &propertyId, int block, const int64_t &amount)
 {
-    if (msc_debug_fees) PrintToLog("Starting AddFee for prop %d (block %d amount %d)...\n", propertyId, block, amount);
+    PrintToLogIf(msc_debug_fees, "Starting AddFee for prop %d (block %d amount %d)...\n", propertyId, block, amount);
 
     // Get current cached fee
     int64_t currentCachedAmount = GetCachedAmount(propertyId);
-    if (msc_debug_fees) PrintToLog("   Current cached amount %d\n", currentCachedAmount);
+    PrintToLogIf(msc_debug_fees, "   Current cached amount %d\n", currentCachedAmount);
 
     // Add new fee and rewrite record
     if ((currentCachedAmount > 0) && (amount > std::numeric_limits<int64_t>::max() - currentCachedAmount)) {
@@ -124,30 +268,16 @@ void COmniFeeCache::AddFee(const uint32_t &propertyId, int block, const int64_t
     }
     int64_t newCachedAmount = currentCachedAmount + amount;
 
-    if (msc_debug_fees) PrintToLog("   New cached amount %d\n", newCachedAmount);
-    const std::string key = strprintf("%010d", propertyId);
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (msc_debug_fees) PrintToLog("   Iterating cache history (%d items)...\n",sCacheHistoryItems.size());
-    std::string newValue;
-    if (!sCacheHistoryItems.empty()) {
-        for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-            feeCacheItem tempItem = *it;
-            if (tempItem.first == block) continue; // this is an older entry for the same block, discard it
-            if (!newValue.empty()) newValue += ",";
-            newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-            if (msc_debug_fees) PrintToLog("      Readding entry: block %d amount %d\n", tempItem.first, tempItem.second);
-        }
-        if (!newValue.empty()) newValue += ",";
-    }
-    if (msc_debug_fees) PrintToLog("   Adding requested entry: block %d new amount %d\n", block, newCachedAmount);
-    newValue += strprintf("%d:%d", block, newCachedAmount);
-    leveldb::Status status = pdb->Put(writeoptions, key, newValue);
+    PrintToLogIf(msc_debug_fees, "   New cached amount %d\n", newCachedAmount);
+    // the entry of the block, the running total and the pruning of matured entries are written at once
+    leveldb::WriteBatch batch;
+    WriteCachedAmount(batch, propertyId, block, newCachedAmount);
+    PruneCache(propertyId, block, batch);
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
     assert(status.ok());
     ++nWritten;
-    if (msc_debug_fees) PrintToLog("AddFee completed for property %d (new=%s [%s])\n", propertyId, newValue, status.ToString());
-
-    // Call for pruning (we only prune when we update a record)
-    PruneCache(propertyId, block);
+    ScheduleCompaction(batch);
+    PrintToLogIf(msc_debug_fees, "AddFee completed for property %d [%s]\n", propertyId, status.ToString());
 
     // Call for cache evaluation (we only need to do this each time a fee cache is increased)
     EvalCache(propertyId, block);
@@ -159,28 +289,43 @@ void COmniFeeCache::AddFee(const uint32_t &propertyId, int block, const int64_t
 void COmniFeeCache::RollBackCache(int block)
 {
     assert(pdb);
-    for (uint8_t ecosystem = 1; ecosystem <= 2; ecosystem++) {
-        uint32_t startPropertyId = (ecosystem == 1) ? 1 : TEST_ECO_PROPERTY_1;
-        for (uint32_t propertyId = startPropertyId; propertyId < mastercore::pDbSpInfo->peekNextSPID(ecosystem); propertyId++) {
-            const std::string key = strprintf("%010d", propertyId);
-            std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-            if (!sCacheHistoryItems.empty()) {
-                std::set<feeCacheItem>::iterator mostRecentIt = sCacheHistoryItems.end();
-                std::string newValue;
-                --mostRecentIt;
-                feeCacheItem mostRecentItem = *mostRecentIt;
-                if (mostRecentItem.first < block) continue; // all entries are unaffected by this rollback, nothing to do
-                for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-                    feeCacheItem tempItem = *it;
-                    if (tempItem.first >= block) continue; // discard this entry
-                    if (!newValue.empty()) newValue += ",";
-                    newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-                }
-                leveldb::Status status = pdb->Put(writeoptions, key, newValue);
-                assert(status.ok());
-                PrintToLog("Rolling back fee cache for property %d, new=%s [%s])\n", propertyId, newValue, status.ToString());
-            }
+    leveldb::WriteBatch batch;
+
+    // the undo log lists the running totals of the properties, whose cache was updated in the blocks
+    const std::set<std::string> setKeys = GetKeysWrittenAbove(block, batch);
+    leveldb::Iterator* it = NewIterator();
+    for (const std::string& key : setKeys) {
+        if (key.size() != FEE_TOTAL_KEY_SIZE || key[0] != DB_FEE_TOTAL) continue;
+        const uint32_t propertyId = ReadBE32(reinterpret_cast<const unsigned char*>(key.data() + 1));
+        const std::string prefix = FeeBlockKey(propertyId, 0).substr(0, FEE_TOTAL_KEY_SIZE);
+
+        // the entries of the rolled back blocks are removed
+        for (it->Seek(FeeBlockKey(propertyId, block)); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+            batch.Delete(it->key());
         }
+
+        // the most recent remaining entry becomes the running total again
+        it->Seek(FeeBlockKey(propertyId, block));
+        if (it->Valid()) {
+            it->Prev();
+        } else {
+            it->SeekToLast();
+        }
+        if (it->Valid() && it->key().starts_with(prefix)) {
+            batch.Put(key, it->value());
+        } else {
+            batch.Delete(key);
+        }
+        cachedAmounts.erase(propertyId);
+        fAllAmountsCached = false;
+        PrintToLog("Rolling back fee cache for property %d\n", propertyId);
+    }
+    delete it;
+
+    if (!setKeys.empty()) {
+        leveldb::Status status = pdb->Write(writeoptions, &batch);
+        assert(status.ok());
+        ScheduleCompaction(batch);
     }
 }
 
@@ -203,26 +348,32 @@ void COmniFeeCache::DistributeCache(const uint32_t &propertyId, int block)
         PrintToLog("Aborting fee distribution for property %d, the fee cache is empty!\n", propertyId);
     }
 
-    OwnerAddrType receiversSet;
-    if (isTestEcosystemProperty(propertyId)) {
-        receiversSet = STO_GetReceivers("FEEDISTRIBUTION", OMNI_PROPERTY_TMSC, cachedAmount);
-    } else {
-        receiversSet = STO_GetReceivers("FEEDISTRIBUTION", OMNI_PROPERTY_MSC, cachedAmount);
-    }
+    const uint32_t distributeTo = isTestEcosystemProperty(propertyId) ? OMNI_PROPERTY_TMSC : OMNI_PROPERTY_MSC;
+    const OwnerIdType receivers = STO_GetReceiverIds("FEEDISTRIBUTION", distributeTo, cachedAmount);
 
-    uint64_t numberOfReceivers = receiversSet.size(); // there will always be addresses holding OMNI, so no need to check size>0
+    uint64_t numberOfReceivers = receivers.size(); // there will always be addresses holding OMNI, so no need to check size>0
     PrintToLog("Starting fee distribution for property %d to %d recipients...\n", propertyId, numberOfReceivers);
 
+    // the receivers are credited at once, and recorded with one key per recipient
     int64_t sent_so_far = 0;
-    std::set<feeHistoryItem> historyItems;
-    for (OwnerAddrType::reverse_iterator it = receiversSet.rbegin(); it != receiversSet.rend(); ++it) {
-        const std::string& address = it->second;
-        int64_t will_really_receive = it->first;
+    std::vector<std::pair<uint32_t, int64_t> > credits;
+    std::vector<feeHistoryItem> historyItems;
+    credits.reserve(receivers.size());
+    historyItems.reserve(receivers.size());
+    for (const auto& receiver : receivers) {
+        const std::string& address = mp_tally_map.GetAddress(receiver.second);
+        int64_t will_really_receive = receiver.first;
         sent_so_far += will_really_receive;
-        if (msc_debug_fees) PrintToLog("  %s receives %d (running total %d of %d)\n", address, will_really_receive, sent_so_far, cachedAmount);
-        assert(update_tally_map(address, propertyId, will_really_receive, BALANCE));
-        feeHistoryItem recipient(address, will_really_receive);
-        historyItems.insert(recipient);
+        PrintToLogIf(msc_debug_fees, "  %s receives %d (running total %d of %d)\n", address, will_really_receive, sent_so_far, cachedAmount);
+        credits.emplace_back(receiver.second, will_really_receive);
+        historyItems.emplace_back(address, will_really_receive);
+    }
+    assert(mp_tally_map.CreditBalances(propertyId, credits));
+    if (pDbBalanceChanges && IsIndexedProperty(propertyId)) {
+        for (const auto& credit : credits) {
+            const int64_t balance = mp_tally_map.Get(credit.first)->getMoney(propertyId, BALANCE);
+            pDbBalanceChanges->RecordChange(mp_tally_map.GetAddress(credit.first), propertyId, BALANCE, credit.second, balance);
+        }
     }
 
     PrintToLog("Fee distribution completed, distributed %d out of %d\n", sent_so_far, cachedAmount);
@@ -235,51 +386,26 @@ void COmniFeeCache::DistributeCache(const uint32_t &propertyId, int block)
     ClearCache(propertyId, block);
 }
 
-// Prunes entries over MAX_STATE_HISTORY blocks old from the entry for a property
-void COmniFeeCache::PruneCache(const uint32_t &propertyId, int block)
+// Adds the removal of entries over MAX_STATE_HISTORY blocks old for a property to the batch
+void COmniFeeCache::PruneCache(const uint32_t &propertyId, int block, leveldb::WriteBatch& batch)
 {
-    if (msc_debug_fees) PrintToLog("Starting PruneCache for prop %d block %d...\n", propertyId, block);
+    PrintToLogIf(msc_debug_fees, "Starting PruneCache for prop %d block %d...\n", propertyId, block);
     assert(pdb);
 
+    // the batch holds the entry of the current block, so the cache never becomes empty
     int pruneBlock = block - MAX_STATE_HISTORY;
-    if (msc_debug_fees) PrintToLog("Removing entries prior to block %d...\n", pruneBlock);
-    const std::string key = strprintf("%010d", propertyId);
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (msc_debug_fees) PrintToLog("   Iterating cache history (%d items)...\n",sCacheHistoryItems.size());
-    if (!sCacheHistoryItems.empty()) {
-        std::set<feeCacheItem>::iterator startIt = sCacheHistoryItems.begin();
-        feeCacheItem firstItem = *startIt;
-        if (firstItem.first >= pruneBlock) {
-            if (msc_debug_fees) PrintToLog("Ending PruneCache - no matured entries found.\n");
-            return; // all entries are above supplied block value, nothing to do
-        }
-        std::string newValue;
-        for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-            feeCacheItem tempItem = *it;
-            if (tempItem.first < pruneBlock) {
-                if (msc_debug_fees) {
-                    PrintToLog("      Skipping matured entry: block %d amount %d\n", tempItem.first, tempItem.second);
-                    continue; // discard this entry
-                }
-            }
-            if (!newValue.empty()) newValue += ",";
-            newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-            if (msc_debug_fees) PrintToLog("      Readding immature entry: block %d amount %d\n", tempItem.first, tempItem.second);
-        }
-        // make sure the pruned cache isn't completely empty, if it is, prune down to just the most recent entry
-        if (newValue.empty()) {
-            std::set<feeCacheItem>::iterator mostRecentIt = sCacheHistoryItems.end();
-            --mostRecentIt;
-            feeCacheItem mostRecentItem = *mostRecentIt;
-            newValue = strprintf("%d:%d", mostRecentItem.first, mostRecentItem.second);
-            if (msc_debug_fees) PrintToLog("   All entries matured and pruned - readding most recent entry: block %d amount %d\n", mostRecentItem.first, mostRecentItem.second);
-        }
-        leveldb::Status status = pdb->Put(writeoptions, key, newValue);
-        assert(status.ok());
-        if (msc_debug_fees) PrintToLog("PruneCache completed for property %d (new=%s [%s])\n", propertyId, newValue, status.ToString());
-    } else {
-        return; // nothing to do
+    if (pruneBlock <= 0) return;
+    const std::string endKey = FeeBlockKey(propertyId, pruneBlock);
+
+    int nPruned = 0;
+    leveldb::Iterator* it = NewIterator();
+    for (it->Seek(FeeBlockKey(propertyId, 0)); it->Valid() && it->key().compare(endKey) < 0; it->Next()) {
+        batch.Delete(it->key());
+        ++nPruned;
     }
+    delete it;
+
+    PrintToLogIf(msc_debug_fees, "PruneCache completed for property %d (%d entries removed)\n", propertyId, nPruned);
 }
 
 // Show Fee Cache DB statistics
@@ -294,8 +420,9 @@ void COmniFeeCache::printAll()
     int count = 0;
     leveldb::Iterator* it = NewIterator();
     for(it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (IsUndoLogKey(it->key())) continue;
         ++count;
-        PrintToConsole("entry #%8d= %s:%s\n", count, it->key().ToString(), it->value().ToString());
+        PrintToConsole("entry #%8d= %s:%s\n", count, HexStr(it->key().ToString()), HexStr(it->value().ToString()));
     }
     delete it;
 }
@@ -305,29 +432,21 @@ std::set<feeCacheItem> COmniFeeCache::GetCacheHistory(const uint32_t &propertyId
 {
     assert(pdb);
 
-    const std::string key = strprintf("%010d", propertyId);
+    const std::string prefix = FeeBlockKey(propertyId, 0).substr(0, FEE_TOTAL_KEY_SIZE);
 
     std::set<feeCacheItem> sCacheHistoryItems;
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, key, &strValue);
-    if (status.IsNotFound()) {
-        return sCacheHistoryItems; // no cache, return empty set
-    }
-    assert(status.ok());
-    std::vector<std::string> vCacheHistoryItems;
-    boost::split(vCacheHistoryItems, strValue, boost::is_any_of(","), boost::token_compress_on);
-    for (std::vector<std::string>::iterator it = vCacheHistoryItems.begin(); it != vCacheHistoryItems.end(); ++it) {
-        std::vector<std::string> vCacheHistoryItem;
-        boost::split(vCacheHistoryItem, *it, boost::is_any_of(":"), boost::token_compress_on);
-        if (2 != vCacheHistoryItem.size()) {
-            PrintToConsole("ERROR: vCacheHistoryItem has unexpected number of elements: %d (raw %s)!\n", vCacheHistoryItem.size(), *it);
-            printAll();
+    leveldb::Iterator* it = NewIterator();
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        const int block = static_cast<int>(ReadBE32(reinterpret_cast<const unsigned char*>(it->key().data() + FEE_TOTAL_KEY_SIZE)));
+        int64_t amount = 0;
+        if (!DecodeDBValue(it->value(), amount)) {
+            PrintToConsole("ERROR: fee cache entry of property %d block %d has an unexpected format (raw %s)!\n", propertyId, block, HexStr(it->value().ToString()));
             continue;
         }
-        int64_t cacheItemBlock = boost::lexical_cast<int64_t>(vCacheHistoryItem[0]);
-        int64_t cacheItemAmount = boost::lexical_cast<int64_t>(vCacheHistoryItem[1]);
-        sCacheHistoryItems.insert(std::make_pair(cacheItemBlock, cacheItemAmount));
+        sCacheHistoryItems.insert(std::make_pair(block, amount));
+        ++nRead;
     }
+    delete it;
 
     return sCacheHistoryItems;
 }
@@ -340,7 +459,7 @@ COmniFeeHistory::COmniFeeHistory(const fs::path& path, bool fWipe)
 
 COmniFeeHistory::~COmniFeeHistory()
 {
-    if (msc_debug_fees) PrintToLog("COmniFeeHistory closed\n");
+    PrintToLogIf(msc_debug_fees, "COmniFeeHistory closed\n");
 }
 
 // Show Fee History DB statistics
@@ -355,9 +474,10 @@ void COmniFeeHistory::printAll()
     int count = 0;
     leveldb::Iterator* it = NewIterator();
     for(it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (IsUndoLogKey(it->key())) continue;
         ++count;
-        PrintToConsole("entry #%8d= %s-%s\n", count, it->key().ToString(), it->value().ToString());
-        PrintToLog("entry #%8d= %s-%s\n", count, it->key().ToString(), it->value().ToString());
+        PrintToConsole("entry #%8d= %s-%s\n", count, HexStr(it->key().ToString()), HexStr(it->value().ToString()));
+        PrintToLog("entry #%8d= %s-%s\n", count, HexStr(it->key().ToString()), HexStr(it->value().ToString()));
     }
     delete it;
 }
@@ -365,39 +485,93 @@ void COmniFeeHistory::printAll()
 // Count Fee History DB records
 int COmniFeeHistory::CountRecords()
 {
-    // No faster way to count than to iterate - "There is no way to implement Count more efficiently inside leveldb than outside."
+    // distributions are numbered from 1, and the last one is never pruned, so it holds the count
     int count = 0;
     leveldb::Iterator* it = NewIterator();
-    for(it->SeekToFirst(); it->Valid(); it->Next()) {
-        ++count;
+    it->Seek(FeeDistributionKey(std::numeric_limits<int32_t>::max()));
+    if (it->Valid()) {
+        it->Prev();
+    } else {
+        it->SeekToLast();
+    }
+    while (it->Valid() && IsUndoLogKey(it->key())) {
+        it->Prev();
+    }
+    if (it->Valid() && it->key().size() == FEE_DISTRIBUTION_KEY_SIZE && it->key()[0] == DB_FEE_DISTRIBUTION) {
+        count = static_cast<int>(ReadBE32(reinterpret_cast<const unsigned char*>(it->key().data() + 1)));
     }
     delete it;
     return count;
 }
 
+// Adds the removal of a fee distribution, its recipients and its entry in the property index to the batch
+void COmniFeeHistory::DeleteDistribution(leveldb::Iterator* it, const std::string& key, int id, leveldb::WriteBatch& batch)
+{
+    std::string strValue;
+    FeeDistributionRecord record;
+    if (pdb->Get(readoptions, key, &strValue).ok() && DecodeDBValue(strValue, record)) {
+        batch.Delete(FeePropertyIndexKey(record.propertyId, id));
+    }
+    const std::string prefix = FeeDistributionKey(id, DB_FEE_RECIPIENT);
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        batch.Delete(it->key());
+    }
+    batch.Delete(key);
+}
+
 // Roll back history in event of reorg, block is inclusive
 void COmniFeeHistory::RollBackHistory(int block)
 {
     assert(pdb);
 
-    std::set<int> sDistributions;
+    leveldb::WriteBatch batch;
+
+    // the undo log lists the fee distributions recorded in the blocks
+    const std::set<std::string> setKeys = GetKeysWrittenAbove(block, batch);
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string strValue = it->value().ToString();
-        std::string strKey = it->key().ToString();
-        std::vector<std::string> vFeeHistoryDetail;
-        boost::split(vFeeHistoryDetail, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vFeeHistoryDetail.size()) {
-            PrintToLog("ERROR: vFeeHistoryDetail has unexpected number of elements: %d !\n", vFeeHistoryDetail.size());
-            continue; // bad data
-        }
-        int feeBlock = boost::lexical_cast<int>(vFeeHistoryDetail[0]);
-        if (feeBlock >= block) {
-            PrintToLog("%s() deleting from fee history DB: %s %s\n", __FUNCTION__, strKey, strValue);
-            pdb->Delete(writeoptions, strKey);
-        }
+    for (const std::string& key : setKeys) {
+        if (key.size() != FEE_DISTRIBUTION_KEY_SIZE || key[0] != DB_FEE_DISTRIBUTION) continue;
+        const int id = static_cast<int>(ReadBE32(reinterpret_cast<const unsigned char*>(key.data() + 1)));
+        PrintToLog("%s() deleting fee distribution %d from fee history DB\n", __FUNCTION__, id);
+        DeleteDistribution(it, key, id, batch);
     }
     delete it;
+
+    if (!setKeys.empty()) {
+        leveldb::Status status = pdb->Write(writeoptions, &batch);
+        assert(status.ok());
+        ScheduleCompaction(batch);
+    }
+}
+
+// Prune history below a block, the last distribution is kept, because it holds the number of distributions
+int COmniFeeHistory::PruneHistory(int block)
+{
+    assert(pdb);
+
+    int nPruned = 0;
+    const int nLast = CountRecords();
+    leveldb::WriteBatch batch;
+
+    const std::set<std::string> setKeys = GetKeysWrittenBelow(block, batch);
+    leveldb::Iterator* it = NewIterator();
+    for (const std::string& key : setKeys) {
+        if (key.size() != FEE_DISTRIBUTION_KEY_SIZE || key[0] != DB_FEE_DISTRIBUTION) continue;
+        const int id = static_cast<int>(ReadBE32(reinterpret_cast<const unsigned char*>(key.data() + 1)));
+        if (id == nLast) continue;
+        DeleteDistribution(it, key, id, batch);
+        ++nPruned;
+    }
+    delete it;
+
+    if (!setKeys.empty()) {
+        leveldb::Status status = pdb->Write(writeoptions, &batch);
+        assert(status.ok());
+        ScheduleCompaction(batch);
+    }
+    PrintToLogIf(msc_debug_fees, "%s(%d): deleted %d fee distributions\n", __func__, block, nPruned);
+
+    return nPruned;
 }
 
 // Retrieve fee distributions for a property
@@ -405,23 +579,13 @@ std::set<int> COmniFeeHistory::GetDistributionsForProperty(const uint32_t &prope
 {
     assert(pdb);
 
+    const std::string prefix = FeePropertyIndexKey(propertyId, 0).substr(0, 1 + sizeof(uint32_t));
+
     std::set<int> sDistributions;
-    leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string strValue = it->value().ToString();
-        std::vector<std::string> vFeeHistoryDetail;
-        boost::split(vFeeHistoryDetail, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vFeeHistoryDetail.size()) {
-            PrintToConsole("ERROR: vFeeHistoryDetail has unexpected number of elements: %d !\n", vFeeHistoryDetail.size());
-            printAll();
-            continue; // bad data
-        }
-        uint32_t prop = boost::lexical_cast<uint32_t>(vFeeHistoryDetail[1]);
-        if (prop == propertyId) {
-            std::string key = it->key().ToString();
-            int id = boost::lexical_cast<int>(key);
-            sDistributions.insert(id);
-        }
+    leveldb::Iterator* it = NewSnapshotIterator();
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        const int id = static_cast<int>(ReadBE32(reinterpret_cast<const unsigned char*>(it->key().data() + prefix.size())));
+        sDistributions.insert(id);
     }
     delete it;
     return sDistributions;
@@ -432,23 +596,20 @@ bool COmniFeeHistory::GetDistributionData(int id, uint32_t *propertyId, int *blo
 {
     assert(pdb);
 
-    const std::string key = strprintf("%d", id);
     std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, key, &strValue);
+    leveldb::Status status = SnapshotGet(FeeDistributionKey(id), &strValue);
     if (status.IsNotFound()) {
         return false; // fee distribution not found
     }
     assert(status.ok());
-    std::vector<std::string> vFeeHistoryDetail;
-    boost::split(vFeeHistoryDetail, strValue, boost::is_any_of(":"), boost::token_compress_on);
-    if (4 != vFeeHistoryDetail.size()) {
-        PrintToConsole("ERROR: vFeeHistoryDetail has unexpected number of elements: %d !\n", vFeeHistoryDetail.size());
-        printAll();
+    FeeDistributionRecord record;
+    if (!DecodeDBValue(strValue, record)) {
+        PrintToConsole("ERROR: fee distribution %d has an unexpected format!\n", id);
         return false; // bad data
     }
-    *block = boost::lexical_cast<int>(vFeeHistoryDetail[0]);
-    *propertyId = boost::lexical_cast<uint32_t>(vFeeHistoryDetail[1]);
-    *total = boost::lexical_cast<int64_t>(vFeeHistoryDetail[2]);
+    *block = record.block;
+    *propertyId = record.propertyId;
+    *total = record.total;
     return true;
 }
 
@@ -457,58 +618,45 @@ std::set<feeHistoryItem> COmniFeeHistory::GetFeeDistribution(int id)
 {
     assert(pdb);
 
-    const std::string key = strprintf("%d", id);
+    const std::string prefix = FeeDistributionKey(id, DB_FEE_RECIPIENT);
+
     std::set<feeHistoryItem> sFeeHistoryItems;
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, key, &strValue);
-    if (status.IsNotFound()) {
-        return sFeeHistoryItems; // fee distribution not found, return empty set
-    }
-    assert(status.ok());
-    std::vector<std::string> vFeeHistoryDetail;
-    boost::split(vFeeHistoryDetail, strValue, boost::is_any_of(":"), boost::token_compress_on);
-    if (4 != vFeeHistoryDetail.size()) {
-        PrintToConsole("ERROR: vFeeHistoryDetail has unexpected number of elements: %d !\n", vFeeHistoryDetail.size());
-        printAll();
-        return sFeeHistoryItems; // bad data, return empty set
-    }
-    std::vector<std::string> vFeeHistoryItems;
-    boost::split(vFeeHistoryItems, vFeeHistoryDetail[3], boost::is_any_of(","), boost::token_compress_on);
-    for (std::vector<std::string>::iterator it = vFeeHistoryItems.begin(); it != vFeeHistoryItems.end(); ++it) {
-        std::vector<std::string> vFeeHistoryItem;
-        boost::split(vFeeHistoryItem, *it, boost::is_any_of("="), boost::token_compress_on);
-        if (2 != vFeeHistoryItem.size()) {
-            PrintToConsole("ERROR: vFeeHistoryItem has unexpected number of elements: %d (raw %s)!\n", vFeeHistoryItem.size(), *it);
-            printAll();
-            continue;
+    leveldb::Iterator* it = NewSnapshotIterator();
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        std::string address(it->key().data() + prefix.size(), it->key().size() - prefix.size());
+        int64_t amount = 0;
+        if (!DecodeDBValue(it->value(), amount)) {
+            PrintToConsole("ERROR: recipient %s of fee distribution %d has an unexpected format!\n", address, id);
+            continue; // bad data
         }
-        int64_t feeHistoryItemAmount = boost::lexical_cast<int64_t>(vFeeHistoryItem[1]);
-        sFeeHistoryItems.insert(std::make_pair(vFeeHistoryItem[0], feeHistoryItemAmount));
+        sFeeHistoryItems.insert(std::make_pair(address, amount));
     }
+    delete it;
 
     return sFeeHistoryItems;
 }
 
 // Record a fee distribution
-void COmniFeeHistory::RecordFeeDistribution(const uint32_t &propertyId, int block, int64_t total, std::set<feeHistoryItem> feeRecipients)
+void COmniFeeHistory::RecordFeeDistribution(const uint32_t &propertyId, int block, int64_t total, const std::vector<feeHistoryItem>& feeRecipients)
 {
     assert(pdb);
 
     int count = CountRecords() + 1;
-    std::string key = strprintf("%d", count);
-    std::string feeRecipientsStr;
-
-    if (!feeRecipients.empty()) {
-        for (std::set<feeHistoryItem>::iterator it = feeRecipients.begin(); it != feeRecipients.end(); it++) {
-            feeHistoryItem tempRecipient = *it;
-            feeRecipientsStr += strprintf("%s=%d,", tempRecipient.first, tempRecipient.second);
-        }
-        if (feeRecipientsStr.size() > 0) {
-            feeRecipientsStr.resize(feeRecipientsStr.size() - 1);
-        }
+    const std::string key = FeeDistributionKey(count);
+
+    FeeDistributionRecord record;
+    record.block = block;
+    record.propertyId = propertyId;
+    record.total = total;
+    leveldb::WriteBatch batch;
+    batch.Put(key, EncodeDBValue(record));
+    batch.Put(FeePropertyIndexKey(propertyId, count), leveldb::Slice());
+    const std::string recipientPrefix = FeeDistributionKey(count, DB_FEE_RECIPIENT);
+    for (const feeHistoryItem& recipient : feeRecipients) {
+        batch.Put(recipientPrefix + recipient.first, EncodeDBValue(recipient.second));
     }
-
-    std::string value = strprintf("%d:%d:%d:%s", block, propertyId, total, feeRecipientsStr);
-    leveldb::Status status = pdb->Put(writeoptions, key, value);
-    if (msc_debug_fees) PrintToLog("Added fee distribution to feeCacheHistory - key=%s value=%s [%s]\n", key, value, status.ToString());
+    LogWrittenKey(batch, block, key);
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    ++nWritten;
+    PrintToLogIf(msc_debug_fees, "Added fee distribution to feeCacheHistory - id=%d property=%d total=%d recipients=%d [%s]\n", count, propertyId, total, feeRecipients.size(), status.ToString());
 }
@@ -6,21 +6,46 @@
 
 #include <fs.h>
 #include <stdint.h>
+#include <map>
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 typedef std::pair<int, int64_t> feeCacheItem;
 typedef std::pair<std::string, int64_t> feeHistoryItem;
 
 /** LevelDB based storage for the MetaDEx fee cache.
+ *
+ * The amount of the cache of a property is stored per block, next to a running
+ * total, so adding a fee is a single batched write, and reading the current
+ * amount a single point read.
  */
 class COmniFeeCache : public CDBBase
 {
+private:
+    //! Current amounts of the fee cache by property, as read from or written to the database
+    std::map<uint32_t, int64_t> cachedAmounts;
+    //! Whether cachedAmounts holds the amounts of all properties, so missing properties have no fees
+    bool fAllAmountsCached;
+
+    /** Reads the running totals of all properties into cachedAmounts, unless they were read already */
+    void LoadCachedAmounts();
+
+    /** Adds the amount of the fee cache of a property at the end of a block, and its running total, to the batch */
+    void WriteCachedAmount(leveldb::WriteBatch& batch, const uint32_t &propertyId, int block, int64_t amount);
+    /** Adds the removal of entries over MAX_STATE_HISTORY blocks old for a property to the batch */
+    void PruneCache(const uint32_t &propertyId, int block, leveldb::WriteBatch& batch);
+    /** Discards the cached amounts, which may be outdated after applied writes */
+    void OnWritesApplied(const std::vector<CDBWrite>& vWrites) override;
+
 public:
     COmniFeeCache(const fs::path& path, bool fWipe);
     virtual ~COmniFeeCache();
 
+    /** Deletes all entries of the fee cache */
+    void Clear() override;
+
     /** Show Fee Cache DB statistics */
     void printStats();
     /** Show Fee Cache DB records */
@@ -34,8 +59,8 @@ public:
     std::set<feeCacheItem> GetCacheHistory(const uint32_t &propertyId);
     /** Gets the current amount of the fee cache for a property */
     int64_t GetCachedAmount(const uint32_t &propertyId);
-    /** Prunes entries over 50 blocks old from the entry for a property */
-    void PruneCache(const uint32_t &propertyId, int block);
+    /** Returns the current amounts of the fee cache of all properties with fees */
+    std::map<uint32_t, int64_t> GetCachedAmounts();
     /** Rolls back the cache to an earlier state (eg in event of a reorg) - block is *inclusive* (ie entries=block will get deleted) */
     void RollBackCache(int block);
     /** Zeros a property in the fee cache */
@@ -52,6 +77,10 @@ public:
  */
 class COmniFeeHistory : public CDBBase
 {
+private:
+    /** Adds the removal of a fee distribution, its recipients and its entry in the property index to the batch */
+    void DeleteDistribution(leveldb::Iterator* it, const std::string& key, int id, leveldb::WriteBatch& batch);
+
 public:
     COmniFeeHistory(const fs::path& path, bool fWipe);
     virtual ~COmniFeeHistory();
@@ -63,15 +92,17 @@ public:
 
     /** Roll back history in event of reorg */
     void RollBackHistory(int block);
+    /** Deletes the distributions below a block, except the last one, and returns the number of distributions deleted */
+    int PruneHistory(int block);
     /** Count Fee History DB records */
     int CountRecords();
     /** Record a fee distribution */
-    void RecordFeeDistribution(const uint32_t &propertyId, int block, int64_t total, std::set<feeHistoryItem> feeRecipients);
-    /** Retrieve the recipients for a fee distribution */
+    void RecordFeeDistribution(const uint32_t &propertyId, int block, int64_t total, const std::vector<feeHistoryItem>& feeRecipients);
+    /** Retrieve the recipients for a fee distribution, as of the last processed block */
     std::set<feeHistoryItem> GetFeeDistribution(int id);
-    /** Retrieve fee distributions for a property */
+    /** Retrieve fee distributions for a property, as of the last processed block */
     std::set<int> GetDistributionsForProperty(const uint32_t &propertyId);
-    /** Populate data about a fee distribution */
+    /** Populate data about a fee distribution, as of the last processed block */
     bool GetDistributionData(int id, uint32_t *propertyId, int *block, int64_t *total);
 };
 
@@ -0,0 +1,147 @@
+#include <omnicore/dbmarkers.h>
+
+#include <omnicore/log.h>
+
+#include <chain.h>
+#include <clientversion.h>
+#include <fs.h>
+#include <serialize.h>
+#include <streams.h>
+#include <uint256.h>
+
+#include <leveldb/db.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+COmniMarkerIndex::COmniMarkerIndex(const fs::path& path, bool fWipe)
+  : m_nPendingChunk(-1), m_nNextHeight(-1), m_nCachedChunk(-1)
+{
+    leveldb::Status status = Open(path, fWipe);
+    PrintToConsole("Loading marker index database: %s\n", status.ToString());
+}
+
+COmniMarkerIndex::~COmniMarkerIndex()
+{
+    PrintToLogVerbose(msc_debug_persistence, "COmniMarkerIndex closed\n");
+}
+
+int COmniMarkerIndex::GetChunkEnd(int nHeight)
+{
+    return (nHeight / BLOCKS_PER_CHUNK + 1) * BLOCKS_PER_CHUNK - 1;
+}
+
+/**
+ * Records, whether a block has transactions with Omni markers.
+ *
+ * Key:   'c' + chunk number (big endian)
+ * Value: hash of the last block of the chunk + bitmap
+ */
+void COmniMarkerIndex::RecordBlock(const CBlockIndex* pindex, bool fHasMarker)
+{
+    assert(pdb);
+    LOCK(m_mutex);
+
+    const int nHeight = pindex->nHeight;
+    const int nChunk = nHeight / BLOCKS_PER_CHUNK;
+    const int nOffset = nHeight % BLOCKS_PER_CHUNK;
+
+    // gaps can't be filled, so start over with the next chunk
+    if (nChunk != m_nPendingChunk || nHeight > m_nNextHeight) {
+        m_nPendingChunk = -1;
+        if (nOffset != 0) return;
+        m_nPendingChunk = nChunk;
+        m_vPendingBits.assign(BLOCKS_PER_CHUNK / 8, 0);
+        m_nNextHeight = nHeight;
+    }
+
+    // after a reorganization, forget about blocks, which are no longer part of the chain
+    for (int n = nOffset; n < m_nNextHeight - nChunk * BLOCKS_PER_CHUNK; ++n) {
+        m_vPendingBits[n / 8] &= ~(1 << (n % 8));
+    }
+    if (fHasMarker) {
+        m_vPendingBits[nOffset / 8] |= (1 << (nOffset % 8));
+    }
+    m_nNextHeight = nHeight + 1;
+
+    if (nOffset != BLOCKS_PER_CHUNK - 1) return;
+
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << 'c';
+    ssKey << static_cast<uint32_t>(nChunk);
+    // store the chunk number in big endian byte order, so chunks are sorted
+    std::reverse(ssKey.begin() + 1, ssKey.end());
+    leveldb::Slice slKey(&ssKey[0], ssKey.size());
+
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << pindex->GetBlockHash();
+    ssValue << m_vPendingBits;
+    leveldb::Slice slValue(&ssValue[0], ssValue.size());
+
+    leveldb::Status status = pdb->Put(writeoptions, slKey, slValue);
+    if (!status.ok()) {
+        PrintToLog("%s(): ERROR for chunk %d: %s\n", __func__, nChunk, status.ToString());
+    }
+    ++nWritten;
+
+    if (m_nCachedChunk == nChunk) m_nCachedChunk = -1;
+    m_nPendingChunk = -1;
+}
+
+/**
+ * Checks, whether a block is known to have no transactions with Omni markers.
+ */
+bool COmniMarkerIndex::IsMarkerFree(const CBlockIndex* pindex, const CBlockIndex* pChunkEnd)
+{
+    assert(pdb);
+    LOCK(m_mutex);
+
+    const int nHeight = pindex->nHeight;
+    const int nChunk = nHeight / BLOCKS_PER_CHUNK;
+    const int nOffset = nHeight % BLOCKS_PER_CHUNK;
+
+    if (pChunkEnd == nullptr || pChunkEnd->nHeight != GetChunkEnd(nHeight)) {
+        return false;
+    }
+
+    if (m_nCachedChunk != nChunk) {
+        m_nCachedChunk = nChunk;
+        m_hashCachedChunkEnd.SetNull();
+        m_vCachedBits.clear();
+
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << 'c';
+        ssKey << static_cast<uint32_t>(nChunk);
+        std::reverse(ssKey.begin() + 1, ssKey.end());
+        leveldb::Slice slKey(&ssKey[0], ssKey.size());
+
+        std::string strValue;
+        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        if (status.ok()) {
+            try {
+                CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+                ssValue >> m_hashCachedChunkEnd;
+                ssValue >> m_vCachedBits;
+                ++nRead;
+            } catch (const std::exception& e) {
+                PrintToLog("%s(): ERROR for chunk %d: %s\n", __func__, nChunk, e.what());
+                m_vCachedBits.clear();
+            }
+        } else if (!status.IsNotFound()) {
+            PrintToLog("%s(): ERROR for chunk %d: %s\n", __func__, nChunk, status.ToString());
+        }
+        if (m_vCachedBits.size() != BLOCKS_PER_CHUNK / 8) {
+            m_vCachedBits.clear();
+        }
+    }
+
+    if (m_vCachedBits.empty() || m_hashCachedChunkEnd != pChunkEnd->GetBlockHash()) {
+        return false;
+    }
+
+    return (m_vCachedBits[nOffset / 8] & (1 << (nOffset % 8))) == 0;
+}
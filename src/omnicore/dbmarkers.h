@@ -0,0 +1,80 @@
+#ifndef BITCOIN_OMNICORE_DBMARKERS_H
+#define BITCOIN_OMNICORE_DBMARKERS_H
+
+#include <omnicore/dbbase.h>
+
+#include <fs.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <vector>
+
+class CBlockIndex;
+
+/** LevelDB based storage of blocks with transactions, which carry Omni markers.
+ *
+ * For each chunk of BLOCKS_PER_CHUNK consecutive blocks, a bitmap is stored,
+ * where a set bit indicates that the block at the corresponding height has at
+ * least one transaction with a potential Omni marker.
+ *
+ * Each chunk is tagged with the hash of its last block. A chunk is only used,
+ * if this block is still part of the active chain, which implies that all other
+ * blocks of the chunk are as well.
+ *
+ * The markers don't depend on the Omni state, so the database is not cleared,
+ * when Omni state is wiped.
+ */
+class COmniMarkerIndex : public CDBBase
+{
+public:
+    //! Number of blocks covered by one bitmap
+    static const int BLOCKS_PER_CHUNK = 1024;
+
+    COmniMarkerIndex(const fs::path& path, bool fWipe);
+    virtual ~COmniMarkerIndex();
+
+    /** Returns the height of the last block of the chunk, which contains the given height. */
+    static int GetChunkEnd(int nHeight);
+
+    /**
+     * Records, whether a block has transactions with Omni markers.
+     *
+     * Blocks are expected to be recorded in order, and a chunk is only stored,
+     * once all its blocks were recorded.
+     */
+    void RecordBlock(const CBlockIndex* pindex, bool fHasMarker);
+
+    /**
+     * Checks, whether a block is known to have no transactions with Omni markers.
+     *
+     * @param pindex[in]     The block to check
+     * @param pChunkEnd[in]  The block of the active chain at GetChunkEnd(), or nullptr, if there is none yet
+     * @return True, if the block can be skipped
+     */
+    bool IsMarkerFree(const CBlockIndex* pindex, const CBlockIndex* pChunkEnd);
+
+private:
+    Mutex m_mutex;
+
+    //! Chunk number of the chunk being recorded, or -1
+    int m_nPendingChunk GUARDED_BY(m_mutex);
+    //! Height of the next block expected to be recorded
+    int m_nNextHeight GUARDED_BY(m_mutex);
+    //! Bitmap of the chunk being recorded
+    std::vector<unsigned char> m_vPendingBits GUARDED_BY(m_mutex);
+
+    //! Chunk number of the last loaded chunk, or -1
+    int m_nCachedChunk GUARDED_BY(m_mutex);
+    //! Hash of the last block of the last loaded chunk
+    uint256 m_hashCachedChunkEnd GUARDED_BY(m_mutex);
+    //! Bitmap of the last loaded chunk, empty, if not available
+    std::vector<unsigned char> m_vCachedBits GUARDED_BY(m_mutex);
+};
+
+namespace mastercore
+{
+    //! LevelDB based storage of blocks with transactions, which carry Omni markers
+    extern COmniMarkerIndex* pDbMarkers;
+}
+
+#endif // BITCOIN_OMNICORE_DBMARKERS_H
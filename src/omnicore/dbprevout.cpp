@@ -0,0 +1,86 @@
+#include <omnicore/dbprevout.h>
+
+#include <omnicore/log.h>
+
+#include <clientversion.h>
+#include <coins.h>
+#include <fs.h>
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <streams.h>
+
+#include <leveldb/db.h>
+
+#include <exception>
+#include <string>
+#include <utility>
+
+COmniPrevoutDB::COmniPrevoutDB(const fs::path& path, bool fWipe)
+{
+    leveldb::Status status = Open(path, fWipe);
+    PrintToConsole("Loading prevout database: %s\n", status.ToString());
+}
+
+COmniPrevoutDB::~COmniPrevoutDB()
+{
+    PrintToLogVerbose(msc_debug_persistence, "COmniPrevoutDB closed\n");
+}
+
+/**
+ * Stores an output, which is spent by an Omni transaction.
+ *
+ * Key:   'p' + outpoint
+ * Value: the serialized coin, including the height of the output
+ */
+void COmniPrevoutDB::AddCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    assert(pdb);
+    assert(!coin.IsSpent());
+
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << std::make_pair('p', outpoint);
+    leveldb::Slice slKey(&ssKey[0], ssKey.size());
+
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << coin;
+    leveldb::Slice slValue(&ssValue[0], ssValue.size());
+
+    leveldb::Status status = pdb->Put(writeoptions, slKey, slValue);
+    if (!status.ok()) {
+        PrintToLog("%s(): ERROR for %s: %s\n", __func__, outpoint.ToString(), status.ToString());
+        return;
+    }
+    ++nWritten;
+}
+
+/**
+ * Retrieves an output, returns false, if it's unknown.
+ */
+bool COmniPrevoutDB::GetCoin(const COutPoint& outpoint, Coin& coin)
+{
+    assert(pdb);
+
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << std::make_pair('p', outpoint);
+    leveldb::Slice slKey(&ssKey[0], ssKey.size());
+
+    std::string strValue;
+    leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+    if (!status.ok()) {
+        if (!status.IsNotFound()) {
+            PrintToLog("%s(): ERROR for %s: %s\n", __func__, outpoint.ToString(), status.ToString());
+        }
+        return false;
+    }
+
+    try {
+        CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue >> coin;
+    } catch (const std::exception& e) {
+        PrintToLog("%s(): ERROR for %s: %s\n", __func__, outpoint.ToString(), e.what());
+        return false;
+    }
+    ++nRead;
+
+    return true;
+}
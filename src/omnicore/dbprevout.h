@@ -0,0 +1,38 @@
+#ifndef BITCOIN_OMNICORE_DBPREVOUT_H
+#define BITCOIN_OMNICORE_DBPREVOUT_H
+
+#include <omnicore/dbbase.h>
+
+#include <fs.h>
+
+class COutPoint;
+class Coin;
+
+/** LevelDB based storage for outputs spent by Omni transactions.
+ *
+ * Outputs are immutable, so the entries remain valid across reorganizations
+ * and reparses, and the database is not cleared, when Omni state is wiped.
+ */
+class COmniPrevoutDB : public CDBBase
+{
+public:
+    COmniPrevoutDB(const fs::path& path, bool fWipe);
+    virtual ~COmniPrevoutDB();
+
+    /** Stores an output, which is spent by an Omni transaction. */
+    void AddCoin(const COutPoint& outpoint, const Coin& coin);
+
+    /** Retrieves an output, returns false, if it's unknown. */
+    bool GetCoin(const COutPoint& outpoint, Coin& coin);
+
+    /** Returns the number of successful lookups. */
+    unsigned int GetHits() const { return nRead; }
+};
+
+namespace mastercore
+{
+    //! LevelDB based storage for outputs spent by Omni transactions, optional
+    extern COmniPrevoutDB* pDbPrevout;
+}
+
+#endif // BITCOIN_OMNICORE_DBPREVOUT_H
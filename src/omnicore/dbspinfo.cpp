@@ -28,7 +28,8 @@ CMPSPInfo::Entry::Entry()
     close_early(false), max_tokens(false), missedTokens(0), timeclosed(0),
     fixed(false), manual(false), unique(false), delegate("") {}
 
-bool CMPSPInfo::Entry::isDivisible() const
+/** Returns whether the tokens of a property type are divisible. */
+static bool IsDivisibleType(uint16_t prop_type)
 {
     switch (prop_type) {
         case MSC_PROPERTY_TYPE_DIVISIBLE:
@@ -39,6 +40,57 @@ bool CMPSPInfo::Entry::isDivisible() const
     return false;
 }
 
+/** Adds a single entry of historical data, stored separately, to a batch. */
+static void WriteHistoricalEntry(leveldb::WriteBatch& batch, uint32_t propertyId, const uint256& block_hash,
+        const uint256& txid, const std::vector<int64_t>& data)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << 'h' << propertyId << txid;
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << data;
+    batch.Put(leveldb::Slice(&ssKey[0], ssKey.size()), leveldb::Slice(&ssValue[0], ssValue.size()));
+
+    // the data is removed, when the block is popped
+    CDataStream ssIndexKey(SER_DISK, CLIENT_VERSION);
+    ssIndexKey << 'H' << block_hash << propertyId << txid;
+    batch.Put(leveldb::Slice(&ssIndexKey[0], ssIndexKey.size()), leveldb::Slice());
+}
+
+/** Adds the historical data of an entry, stored separately, to a batch. */
+static void WriteHistoricalData(leveldb::WriteBatch& batch, uint32_t propertyId, const CMPSPInfo::Entry& info)
+{
+    for (const auto& entry : info.historicalData) {
+        WriteHistoricalEntry(batch, propertyId, info.update_block, entry.first, entry.second);
+    }
+}
+
+bool CMPSPInfo::Entry::isDivisible() const
+{
+    return IsDivisibleType(prop_type);
+}
+
+CMPSPInfo::Summary::Summary() : prop_type(0), unique(false) {}
+
+CMPSPInfo::Summary::Summary(const Entry& info)
+  : prop_type(info.prop_type), unique(info.unique), issuer(info.issuer), delegate(info.delegate), name(info.name) {}
+
+bool CMPSPInfo::Summary::isDivisible() const
+{
+    return IsDivisibleType(prop_type);
+}
+
+CMPSPInfo::Listing::Listing() : prop_type(0), fixed(false), manual(false), unique(false) {}
+
+CMPSPInfo::Listing::Listing(const Entry& info)
+  : prop_type(info.prop_type), name(info.name), category(info.category), subcategory(info.subcategory),
+    url(info.url), data(info.data), issuer(info.issuer), delegate(info.delegate), txid(info.txid),
+    fixed(info.fixed), manual(info.manual), unique(info.unique) {}
+
+bool CMPSPInfo::Listing::isDivisible() const
+{
+    return IsDivisibleType(prop_type);
+}
+
 void CMPSPInfo::Entry::print() const
 {
     PrintToConsole("%s:%s(Fixed=%s,Divisible=%s):%d:%s/%s, %s %s\n",
@@ -139,7 +191,7 @@ std::string CMPSPInfo::Entry::getDelegate(int block) const
 
 CMPSPInfo::CMPSPInfo(const fs::path& path, bool fWipe)
 {
-    leveldb::Status status = Open(path, fWipe);
+    leveldb::Status status = Open(path, fWipe, true);
     PrintToConsole("Loading smart property database: %s\n", status.ToString());
 
     // special cases for constant SPs OMN and TOMN
@@ -168,21 +220,39 @@ CMPSPInfo::CMPSPInfo(const fs::path& path, bool fWipe)
 
 CMPSPInfo::~CMPSPInfo()
 {
-    if (msc_debug_persistence) PrintToLog("CMPSPInfo closed\n");
+    PrintToLogVerbose(msc_debug_persistence, "CMPSPInfo closed\n");
 }
 
 void CMPSPInfo::Clear()
 {
     // wipe database via parent class
     CDBBase::Clear();
+    {
+        LOCK(cs_summaries);
+        mapSummaries.clear();
+    }
     // reset "next property identifiers"
     init();
 }
 
+void CMPSPInfo::OnWritesApplied(const std::vector<CDBWrite>& vWrites)
+{
+    {
+        LOCK(cs_summaries);
+        mapSummaries.clear();
+    }
+    LOCK(cs_listings);
+    pListings.reset();
+}
+
 void CMPSPInfo::init(uint32_t nextSPID, uint32_t nextTestSPID)
 {
     next_spid = nextSPID;
     next_test_spid = nextTestSPID;
+
+    // the listings are reloaded with the new identifiers
+    LOCK(cs_listings);
+    pListings.reset();
 }
 
 uint32_t CMPSPInfo::peekNextSPID(uint8_t ecosystem) const
@@ -236,6 +306,7 @@ bool CMPSPInfo::updateSP(uint32_t propertyId, const Entry& info)
         batch.Put(slSpPrevKey, strSpPrevValue);
     }
     batch.Put(slSpKey, slSpValue);
+    WriteHistoricalData(batch, propertyId, info);
 
     // Update delegate info if set
     if (!info.historicalDelegates.empty()) {
@@ -248,6 +319,11 @@ bool CMPSPInfo::updateSP(uint32_t propertyId, const Entry& info)
     }
 
     leveldb::Status status = pdb->Write(syncoptions, &batch);
+    {
+        LOCK(cs_summaries);
+        mapSummaries.erase(propertyId);
+    }
+    updateListing(propertyId, info);
 
     if (!status.ok()) {
         PrintToLog("%s(): ERROR for SP %d: %s\n", __func__, propertyId, status.ToString());
@@ -258,6 +334,24 @@ bool CMPSPInfo::updateSP(uint32_t propertyId, const Entry& info)
     return true;
 }
 
+bool CMPSPInfo::addHistoricalEntry(uint32_t propertyId, const uint256& block_hash, const uint256& txid, const std::vector<int64_t>& data)
+{
+    // cannot update implied SP
+    if (OMNI_PROPERTY_MSC == propertyId || OMNI_PROPERTY_TMSC == propertyId) {
+        return false;
+    }
+
+    leveldb::WriteBatch batch;
+    WriteHistoricalEntry(batch, propertyId, block_hash, txid, data);
+
+    leveldb::Status status = pdb->Write(syncoptions, &batch);
+    if (!status.ok()) {
+        PrintToLog("%s(): ERROR for SP %d: %s\n", __func__, propertyId, status.ToString());
+        return false;
+    }
+
+    return true;
+}
 
 uint32_t CMPSPInfo::putSP(uint8_t ecosystem, const Entry& info)
 {
@@ -319,12 +413,18 @@ uint32_t CMPSPInfo::putSP(uint8_t ecosystem, const Entry& info)
     leveldb::WriteBatch batch;
     batch.Put(slSpKey, slSpValue);
     batch.Put(slTxIndexKey, slTxValue);
+    WriteHistoricalData(batch, propertyId, info);
 
     if (info.unique) {
         batch.Put(uniqueKey, strprintf("%d", info.unique));
     }
 
     leveldb::Status status = pdb->Write(syncoptions, &batch);
+    {
+        LOCK(cs_summaries);
+        mapSummaries.erase(propertyId);
+    }
+    updateListing(propertyId, info);
 
     if (!status.ok()) {
         PrintToLog("%s(): ERROR for SP %d: %s\n", __func__, propertyId, status.ToString());
@@ -367,6 +467,9 @@ bool CMPSPInfo::getSP(uint32_t propertyId, Entry& info) const
         return false;
     }
 
+    // the historical data is not part of the entry, see getHistoricalData()
+    info.historicalData.clear();
+
     // Check for unique entry
     std::string uniqueKey = strprintf("UE-%d", propertyId);
     std::string uniqueValue;
@@ -398,6 +501,114 @@ bool CMPSPInfo::getSP(uint32_t propertyId, Entry& info) const
     return true;
 }
 
+bool CMPSPInfo::getSummary(uint32_t propertyId, Summary& summary) const
+{
+    {
+        LOCK(cs_summaries);
+        std::map<uint32_t, Summary>::const_iterator it = mapSummaries.find(propertyId);
+        if (it != mapSummaries.end()) {
+            summary = it->second;
+            return true;
+        }
+    }
+
+    Entry info;
+    if (!getSP(propertyId, info)) {
+        return false;
+    }
+    summary = Summary(info);
+
+    LOCK(cs_summaries);
+    mapSummaries[propertyId] = summary;
+    return true;
+}
+
+std::shared_ptr<const CMPSPInfo::ListingTable> CMPSPInfo::getListings() const
+{
+    LOCK(cs_listings);
+    if (pListings) {
+        return pListings;
+    }
+
+    std::shared_ptr<ListingTable> listings = std::make_shared<ListingTable>();
+    auto loadRange = [&](uint32_t firstId, uint32_t nextId) {
+        for (uint32_t propertyId = firstId; propertyId < nextId; ++propertyId) {
+            Entry info;
+            if (getSP(propertyId, info)) {
+                listings->emplace(propertyId, std::make_shared<const Listing>(info));
+            }
+        }
+    };
+    loadRange(OMNI_PROPERTY_MSC, next_spid);
+    loadRange(TEST_ECO_PROPERTY_1, next_test_spid);
+
+    pListings = listings;
+    return pListings;
+}
+
+void CMPSPInfo::updateListing(uint32_t propertyId, const Entry& info)
+{
+    LOCK(cs_listings);
+    if (!pListings) return;
+
+    // the listings may still be in use, so only the pointers are copied
+    std::shared_ptr<ListingTable> listings = std::make_shared<ListingTable>(*pListings);
+    (*listings)[propertyId] = std::make_shared<const Listing>(info);
+    pListings = listings;
+}
+
+bool CMPSPInfo::getHistoricalData(uint32_t propertyId, std::map<uint256, std::vector<int64_t> >& historicalData) const
+{
+    historicalData.clear();
+    leveldb::Iterator* iter = NewIterator();
+
+    CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+    ssPrefix << 'h' << propertyId;
+    leveldb::Slice slPrefix(&ssPrefix[0], ssPrefix.size());
+
+    bool fSuccess = true;
+    for (iter->Seek(slPrefix); iter->Valid() && iter->key().starts_with(slPrefix); iter->Next()) {
+        leveldb::Slice slKey = iter->key();
+        leveldb::Slice slValue = iter->value();
+        try {
+            uint256 txid;
+            CDataStream ssKey(slKey.data() + slPrefix.size(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            ssKey >> txid;
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> historicalData[txid];
+        } catch (const std::exception& e) {
+            PrintToLog("%s(): ERROR for SP %d: %s\n", __func__, propertyId, e.what());
+            fSuccess = false;
+            break;
+        }
+    }
+
+    delete iter;
+    return fSuccess;
+}
+
+bool CMPSPInfo::getHistoricalEntry(uint32_t propertyId, const uint256& txid, std::vector<int64_t>& data) const
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << 'h' << propertyId << txid;
+    leveldb::Slice slKey(&ssKey[0], ssKey.size());
+
+    std::string strValue;
+    if (!pdb->Get(readoptions, slKey, &strValue).ok()) {
+        return false;
+    }
+
+    try {
+        CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue >> data;
+    } catch (const std::exception& e) {
+        PrintToLog("%s(): ERROR for SP %d: %s\n", __func__, propertyId, e.what());
+        return false;
+    }
+
+    return true;
+}
+
 bool CMPSPInfo::hasSP(uint32_t propertyId) const
 {
     // Special cases for constant SPs MSC and TMSC
@@ -451,6 +662,19 @@ int64_t CMPSPInfo::popBlock(const uint256& block_hash)
     leveldb::WriteBatch commitBatch;
     leveldb::Iterator* iter = NewIterator();
 
+    // remove the historical data written in the block
+    CDataStream ssHistoryIndexPrefix(SER_DISK, CLIENT_VERSION);
+    ssHistoryIndexPrefix << 'H' << block_hash;
+    leveldb::Slice slHistoryIndexPrefix(&ssHistoryIndexPrefix[0], ssHistoryIndexPrefix.size());
+
+    for (iter->Seek(slHistoryIndexPrefix); iter->Valid() && iter->key().starts_with(slHistoryIndexPrefix); iter->Next()) {
+        leveldb::Slice slIndexKey = iter->key();
+        std::string strHistoryKey(1, 'h');
+        strHistoryKey.append(slIndexKey.data() + slHistoryIndexPrefix.size(), slIndexKey.size() - slHistoryIndexPrefix.size());
+        commitBatch.Delete(strHistoryKey);
+        commitBatch.Delete(slIndexKey);
+    }
+
     CDataStream ssSpKeyPrefix(SER_DISK, CLIENT_VERSION);
     ssSpKeyPrefix << 's';
     leveldb::Slice slSpKeyPrefix(&ssSpKeyPrefix[0], ssSpKeyPrefix.size());
@@ -515,6 +739,15 @@ int64_t CMPSPInfo::popBlock(const uint256& block_hash)
     delete iter;
 
     leveldb::Status status = pdb->Write(syncoptions, &commitBatch);
+    {
+        // the properties rolled back are not known in advance
+        LOCK(cs_summaries);
+        mapSummaries.clear();
+    }
+    {
+        LOCK(cs_listings);
+        pListings.reset();
+    }
 
     if (!status.ok()) {
         PrintToLog("%s(): ERROR: %s\n", __func__, status.ToString());
@@ -7,12 +7,15 @@
 
 #include <fs.h>
 #include <serialize.h>
+#include <sync.h>
 #include <uint256.h>
 
 #include <stdint.h>
 
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 /** LevelDB based storage for currencies, smart properties and tokens.
  *
@@ -41,6 +44,21 @@
  *      uint32_t propertyId
  *  Value:
  *      CMPSPInfo::Entry info
+ *
+ *  Key:
+ *      char 'h'
+ *      uint32_t propertyId
+ *      uint256 hashTxid
+ *  Value:
+ *      std::vector<int64_t> historicalData
+ *
+ *  Key:
+ *      char 'H'
+ *      uint256 hashBlock
+ *      uint32_t propertyId
+ *      uint256 hashTxid
+ *  Value:
+ *      empty, marks historical data written in the block
  */
 class CMPSPInfo : public CDBBase
 {
@@ -83,6 +101,9 @@ public:
         //   txid -> amount invested, crowdsale deadline, user issued tokens, issuer issued tokens
         // For managed properties:
         //   txid -> granted amount, revoked amount
+        //
+        // The historical data is stored separately, and not loaded with the entry. When the
+        // entry is stored, the historical data added to it is stored in addition.
         std::map<uint256, std::vector<int64_t> > historicalData;
 
         // Historical issuers:
@@ -122,7 +143,6 @@ public:
             READWRITE(update_block);
             READWRITE(fixed);
             READWRITE(manual);
-            READWRITE(historicalData);
             READWRITE(historicalIssuers);
         }
 
@@ -145,14 +165,66 @@ public:
         std::string getDelegate(int block) const;
     };
 
+    /** Compact metadata of a property, which is kept in memory for frequent lookups. */
+    struct Summary {
+        uint16_t prop_type;
+        bool unique;
+        std::string issuer;
+        std::string delegate;
+        std::string name;
+
+        Summary();
+        explicit Summary(const Entry& info);
+
+        bool isDivisible() const;
+    };
+
+    /** Metadata of a property without its history, which is listed from memory. */
+    struct Listing {
+        uint16_t prop_type;
+        std::string name;
+        std::string category;
+        std::string subcategory;
+        std::string url;
+        std::string data;
+        std::string issuer;
+        std::string delegate;
+        uint256 txid;
+        bool fixed;
+        bool manual;
+        bool unique;
+
+        Listing();
+        explicit Listing(const Entry& info);
+
+        bool isDivisible() const;
+    };
+
+    //! All properties, ordered by identifier, with the ones of the main ecosystem first
+    typedef std::map<uint32_t, std::shared_ptr<const Listing>> ListingTable;
+
 private:
     // implied version of OMN and TOMN so they don't hit the leveldb
     Entry implied_omni;
     Entry implied_tomni;
 
+    //! Summaries of the properties looked up, the full entries are loaded only when needed
+    mutable Mutex cs_summaries;
+    mutable std::map<uint32_t, Summary> mapSummaries GUARDED_BY(cs_summaries);
+
+    //! Listings of all properties, loaded at the first use and updated with every change
+    mutable Mutex cs_listings;
+    mutable std::shared_ptr<const ListingTable> pListings GUARDED_BY(cs_listings);
+
     uint32_t next_spid;
     uint32_t next_test_spid;
 
+    /** Replaces the listing of a property, if the listings are loaded. */
+    void updateListing(uint32_t propertyId, const Entry& info);
+
+    /** Discards the summaries and listings, which may be outdated after applied writes. */
+    void OnWritesApplied(const std::vector<CDBWrite>& vWrites) override;
+
 public:
     CMPSPInfo(const fs::path& path, bool fWipe);
     virtual ~CMPSPInfo();
@@ -164,8 +236,18 @@ public:
 
     uint32_t peekNextSPID(uint8_t ecosystem) const;
     bool updateSP(uint32_t propertyId, const Entry& info);
+    /**
+     * Appends a single entry to the historical data of a property, without rewriting the property,
+     * as done for grants and revokes. The entry is removed, when the block is popped.
+     */
+    bool addHistoricalEntry(uint32_t propertyId, const uint256& block_hash, const uint256& txid, const std::vector<int64_t>& data);
     uint32_t putSP(uint8_t ecosystem, const Entry& info);
     bool getSP(uint32_t propertyId, Entry& info) const;
+    bool getSummary(uint32_t propertyId, Summary& summary) const;
+    /** Returns the listings of all properties, which are only read from the DB once. */
+    std::shared_ptr<const ListingTable> getListings() const;
+    bool getHistoricalData(uint32_t propertyId, std::map<uint256, std::vector<int64_t> >& historicalData) const;
+    bool getHistoricalEntry(uint32_t propertyId, const uint256& txid, std::vector<int64_t>& data) const;
     bool hasSP(uint32_t propertyId) const;
     uint32_t findSPByTX(const uint256& txid) const;
 
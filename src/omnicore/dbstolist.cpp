@@ -2,8 +2,10 @@
 
 #include <omnicore/log.h>
 #include <omnicore/sp.h>
+#include <omnicore/sto.h>
 #include <omnicore/walletutils.h>
 
+#include <crypto/common.h>
 #include <fs.h>
 #include <interfaces/wallet.h>
 #include <uint256.h>
@@ -15,175 +17,341 @@
 #include <leveldb/iterator.h>
 #include <leveldb/slice.h>
 #include <leveldb/status.h>
-
-#include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast.hpp>
+#include <leveldb/write_batch.h>
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
+#include <limits>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 using mastercore::IsMyAddress;
 using mastercore::isPropertyDivisible;
+using mastercore::OwnerAddrType;
+
+//! Prefix of the keys of the receipts by address
+static const char DB_STO_RECEIPT = 'r';
+//! Prefix of the keys of the receipts by transaction
+static const char DB_STO_TX = 't';
+//! Prefix of the keys of the number of recipients by transaction
+static const char DB_STO_COUNT = 'n';
+//! Size of the block and txid at the end of the keys of the receipts by address
+static const size_t RECEIPT_KEY_SUFFIX_SIZE = sizeof(uint32_t) + 32;
+//! Size of the prefix and txid at the start of the keys of the receipts by transaction
+static const size_t TX_KEY_PREFIX_SIZE = 1 + 32;
+//! Size of the values of both key spaces: block, property id and amount
+static const size_t RECEIPT_VALUE_SIZE = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+/** Returns the prefix of the receipt keys of an address, which is terminated, as addresses vary in length. */
+static std::string ReceiptPrefix(const std::string& address)
+{
+    std::string prefix(1, DB_STO_RECEIPT);
+    prefix += address;
+    prefix.push_back('\0');
+    return prefix;
+}
+
+/**
+ * Creates the key of a receipt by address.
+ *
+ * Key: 'r' + address + '\0' + block + txid
+ *
+ * The block is stored in big endian byte order, so the receipts of an address are sorted by block.
+ */
+static std::string ReceiptKey(const std::string& address, int block, const uint256& txid)
+{
+    std::string key = ReceiptPrefix(address);
+    unsigned char buf[sizeof(uint32_t)];
+    WriteBE32(buf, static_cast<uint32_t>(block));
+    key.append(reinterpret_cast<const char*>(buf), sizeof(buf));
+    key.append(txid.begin(), txid.end());
+    return key;
+}
+
+/** Returns the prefix of the receipt keys of a transaction. */
+static std::string TxPrefix(const uint256& txid)
+{
+    std::string prefix(1, DB_STO_TX);
+    prefix.append(txid.begin(), txid.end());
+    return prefix;
+}
+
+/** Returns the key of the number of recipients of a transaction. */
+static std::string CountKey(const uint256& txid)
+{
+    std::string key(1, DB_STO_COUNT);
+    key.append(txid.begin(), txid.end());
+    return key;
+}
+
+/** Returns whether a recipient passes the filter: all for "*", the wallet by default, or a single address. */
+static bool MatchesFilter(const std::string& filterAddress, const std::string& recipientAddress, interfaces::Wallet* iWallet)
+{
+    if (filterAddress == "*") return true;
+    if (filterAddress.empty()) return IsMyAddress(recipientAddress, iWallet);
+    return filterAddress == recipientAddress;
+}
+
+/** Appends a recipient and its amount to the array. */
+static void PushRecipient(UniValue& recipientArray, const std::string& recipientAddress, uint32_t propertyId, int64_t amount)
+{
+    UniValue recipient(UniValue::VOBJ);
+    recipient.pushKV("address", recipientAddress);
+    if (isPropertyDivisible(propertyId)) {
+        recipient.pushKV("amount", FormatDivisibleMP(amount));
+    } else {
+        recipient.pushKV("amount", FormatIndivisibleMP(amount));
+    }
+    recipientArray.push_back(recipient);
+}
+
+/**
+ * Encodes the value of a receipt.
+ *
+ * Value: block + property id + amount, in big endian byte order
+ */
+static std::string EncodeReceipt(int block, uint32_t propertyId, int64_t amount)
+{
+    unsigned char buf[RECEIPT_VALUE_SIZE];
+    WriteBE32(buf, static_cast<uint32_t>(block));
+    WriteBE32(buf + 4, propertyId);
+    WriteBE64(buf + 8, static_cast<uint64_t>(amount));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/** Decodes the value of a receipt, and returns false, if it is malformed. */
+static bool DecodeReceipt(const leveldb::Slice& value, int& block, uint32_t& propertyId, int64_t& amount)
+{
+    if (value.size() != RECEIPT_VALUE_SIZE) return false;
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(value.data());
+    block = static_cast<int>(ReadBE32(data));
+    propertyId = ReadBE32(data + 4);
+    amount = static_cast<int64_t>(ReadBE64(data + 8));
+    return true;
+}
 
 CMPSTOList::CMPSTOList(const fs::path& path, bool fWipe)
 {
-    leveldb::Status status = Open(path, fWipe);
+    leveldb::Status status = Open(path, fWipe, true);
     PrintToConsole("Loading send-to-owners database: %s\n", status.ToString());
 }
 
 CMPSTOList::~CMPSTOList()
 {
-    if (msc_debug_persistence) PrintToLog("CMPSTOList closed\n");
+    PrintToLogVerbose(msc_debug_persistence, "CMPSTOList closed\n");
 }
 
 void CMPSTOList::getRecipients(const uint256 txid, std::string filterAddress, UniValue* recipientArray, uint64_t* total, uint64_t* numRecipients, interfaces::Wallet* iWallet)
 {
     if (!pdb) return;
 
-    bool filter = true; //default
-    bool filterByWallet = true; //default
-    bool filterByAddress = false; //default
+    // the fee is variable based on version of STO - provide number of recipients and allow calling function to work out fee
+    *numRecipients = getRecipientCount(txid);
 
-    if (filterAddress == "*") filter = false;
-    if ((filterAddress != "") && (filterAddress != "*")) {
-        filterByWallet = false;
-        filterByAddress = true;
-    }
+    std::string nextCursor;
+    getRecipientsPage(txid, filterAddress, "", std::numeric_limits<size_t>::max(), *recipientArray, *total, nextCursor, iWallet);
+}
 
-    // iterate through SDB, dropping all records where key is not filterAddress (if filtering)
-    int count = 0;
+/**
+ * Returns the number of recipients of a send to owners transaction.
+ *
+ * The number is stored along with the receipts, and counted from the receipts
+ * for databases, which were written without it.
+ */
+uint64_t CMPSTOList::getRecipientCount(const uint256& txid)
+{
+    if (!pdb) return 0;
 
-    // the fee is variable based on version of STO - provide number of recipients and allow calling function to work out fee
-    *numRecipients = 0;
+    std::string strValue;
+    leveldb::Status status = pdb->Get(readoptions, CountKey(txid), &strValue);
+    ++nRead;
+    if (status.ok() && strValue.size() == sizeof(uint64_t)) {
+        return ReadBE64(reinterpret_cast<const unsigned char*>(strValue.data()));
+    }
 
-    leveldb::Slice skey, svalue;
+    uint64_t count = 0;
+    const std::string prefix = TxPrefix(txid);
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        std::string recipientAddress = skey.ToString();
-        svalue = it->value();
-        std::string strValue = svalue.ToString();
-        // see if txid is in the data
-        size_t txidMatch = strValue.find(txid.ToString());
-        if (txidMatch != std::string::npos) {
-            ++*numRecipients;
-            // the txid exists inside the data, this address was a recipient of this STO, check filter and add the details
-            if (filter) {
-                if (((filterByAddress) && (filterAddress == recipientAddress)) || ((filterByWallet) && (IsMyAddress(recipientAddress, iWallet)))) {
-                } else {
-                    continue;
-                } // move on if no filter match (but counter still increased for fee)
-            }
-            std::vector<std::string> vstr;
-            boost::split(vstr, strValue, boost::is_any_of(","), boost::token_compress_on);
-            for (uint32_t i = 0; i < vstr.size(); i++) {
-                std::vector<std::string> svstr;
-                boost::split(svstr, vstr[i], boost::is_any_of(":"), boost::token_compress_on);
-                if (4 == svstr.size()) {
-                    if (svstr[0] == txid.ToString()) {
-                        //add data to array
-                        uint64_t amount = 0;
-                        uint64_t propertyId = 0;
-                        try {
-                            amount = boost::lexical_cast<uint64_t>(svstr[3]);
-                            propertyId = boost::lexical_cast<uint64_t>(svstr[2]);
-                        } catch (const boost::bad_lexical_cast &e) {
-                            PrintToLog("DEBUG STO - error in converting values from leveldb\n");
-                            delete it;
-                            return; //(something went wrong)
-                        }
-                        UniValue recipient(UniValue::VOBJ);
-                        recipient.pushKV("address", recipientAddress);
-                        if (isPropertyDivisible(propertyId)) {
-                            recipient.pushKV("amount", FormatDivisibleMP(amount));
-                        } else {
-                            recipient.pushKV("amount", FormatIndivisibleMP(amount));
-                        }
-                        *total += amount;
-                        recipientArray->push_back(recipient);
-                        ++count;
-                    }
-                }
-            }
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        if (it->key().size() > prefix.size()) ++count;
+    }
+    delete it;
+    return count;
+}
+
+/**
+ * Adds a page of the recipients of a send to owners transaction, ordered by address.
+ *
+ * The page starts after the address of the cursor, and the recipients are read by the
+ * prefix of the transaction, so only the receipts of the page are visited.
+ *
+ * Returns whether there are more recipients, which pass the filter.
+ */
+bool CMPSTOList::getRecipientsPage(const uint256& txid, const std::string& filterAddress, const std::string& cursor, size_t limit, UniValue& recipientArray, uint64_t& total, std::string& nextCursor, interfaces::Wallet* iWallet)
+{
+    if (!pdb) return false;
+
+    const std::string prefix = TxPrefix(txid);
+    int block = 0;
+    uint32_t propertyId = 0;
+    int64_t amount = 0;
+
+    // a single address is looked up directly
+    if (!filterAddress.empty() && filterAddress != "*") {
+        std::string strValue;
+        if (filterAddress <= cursor || !pdb->Get(readoptions, prefix + filterAddress, &strValue).ok()) return false;
+        ++nRead;
+        if (!DecodeReceipt(strValue, block, propertyId, amount)) return false;
+        if (limit == 0) return true;
+        PushRecipient(recipientArray, filterAddress, propertyId, amount);
+        total += amount;
+        nextCursor = filterAddress;
+        return false;
+    }
+
+    bool fMore = false;
+    size_t count = 0;
+    leveldb::Iterator* it = NewSnapshotIterator();
+    it->Seek(prefix + cursor);
+    if (!cursor.empty() && it->Valid() && it->key() == leveldb::Slice(prefix + cursor)) it->Next();
+    for (; it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        const leveldb::Slice& key = it->key();
+        if (key.size() == prefix.size() || !DecodeReceipt(it->value(), block, propertyId, amount)) {
+            PrintToLog("DEBUG STO - error in converting values from leveldb\n");
+            continue;
+        }
+        const std::string recipientAddress(key.data() + prefix.size(), key.size() - prefix.size());
+        if (!MatchesFilter(filterAddress, recipientAddress, iWallet)) continue;
+        if (count >= limit) {
+            fMore = true;
+            break;
         }
+        PushRecipient(recipientArray, recipientAddress, propertyId, amount);
+        total += amount;
+        nextCursor = recipientAddress;
+        ++count;
     }
+    delete it;
+
+    return fMore;
+}
+
+bool CMPSTOList::HasReceiptInWallet(const uint256& txid, interfaces::Wallet& iWallet)
+{
+    if (!pdb) return false;
 
+    bool fFound = false;
+    const std::string prefix = TxPrefix(txid);
+    leveldb::Iterator* it = NewIterator();
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix) && !fFound; it->Next()) {
+        const std::string recipientAddress(it->key().data() + prefix.size(), it->key().size() - prefix.size());
+        fFound = IsMyAddress(recipientAddress, &iWallet);
+    }
     delete it;
-    return;
+    return fFound;
 }
 
-std::string CMPSTOList::getMySTOReceipts(std::string filterAddress, interfaces::Wallet &iWallet)
+/**
+ * Returns the transactions and blocks of the receipts of an address, ordered by block.
+ *
+ * The receipts are a prefix read of the address, so only the receipts of the address are visited.
+ */
+std::vector<std::pair<uint256, int> > CMPSTOList::GetAddressReceipts(const std::string& address)
 {
-    if (!pdb) return "";
-    std::string mySTOReceipts = "";
-    leveldb::Slice skey, svalue;
+    std::vector<std::pair<uint256, int> > receipts;
+    if (!pdb) return receipts;
+
+    const std::string prefix = ReceiptPrefix(address);
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        std::string recipientAddress = skey.ToString();
-        if (!IsMyAddress(recipientAddress, &iWallet)) continue; // not ours, not interested
-        if ((!filterAddress.empty()) && (filterAddress != recipientAddress)) continue; // not the filtered address
-        // ours, get info
-        svalue = it->value();
-        std::string strValue = svalue.ToString();
-        // break into individual receipts
-        std::vector<std::string> vstr;
-        boost::split(vstr, strValue, boost::is_any_of(","), boost::token_compress_on);
-        for (uint32_t i = 0; i < vstr.size(); i++) {
-            // add to array
-            std::vector<std::string> svstr;
-            boost::split(svstr, vstr[i], boost::is_any_of(":"), boost::token_compress_on);
-            if (4 == svstr.size()) {
-                size_t txidMatch = mySTOReceipts.find(svstr[0]);
-                if (txidMatch == std::string::npos) mySTOReceipts += svstr[0] + ":" + svstr[1] + ":" + recipientAddress + ":" + svstr[2] + ",";
-            }
-        }
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        if (it->key().size() != prefix.size() + RECEIPT_KEY_SUFFIX_SIZE) continue;
+        const unsigned char* suffix = reinterpret_cast<const unsigned char*>(it->key().data()) + prefix.size();
+        uint256 txid;
+        memcpy(txid.begin(), suffix + sizeof(uint32_t), 32);
+        receipts.emplace_back(txid, static_cast<int>(ReadBE32(suffix)));
     }
     delete it;
-    // above code will leave a trailing comma - strip it
-    if (mySTOReceipts.size() > 0) mySTOReceipts.resize(mySTOReceipts.size() - 1);
-    return mySTOReceipts;
+    return receipts;
 }
 
 /**
- * This function deletes records of STO receivers above/equal to a specific block from the STO database.
+ * Adds the removal of the receipts of the STOs with the given undo log entries to a batch.
+ *
+ * The receipts are removed from both key spaces, along with the number of recipients.
  *
- * Returns the number of records changed.
+ * Returns the number of receipts deleted.
  */
-int CMPSTOList::deleteAboveBlock(int blockNum)
+unsigned int CMPSTOList::DeleteReceipts(const std::set<std::string>& setPrefixes, leveldb::WriteBatch& batch)
 {
     unsigned int n_found = 0;
-    std::vector<std::string> vecSTORecords;
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string newValue;
-        std::string oldValue = it->value().ToString();
-        bool needsUpdate = false;
-        boost::split(vecSTORecords, oldValue, boost::is_any_of(","), boost::token_compress_on);
-        for (uint32_t i = 0; i < vecSTORecords.size(); i++) {
-            std::vector<std::string> vecSTORecordFields;
-            boost::split(vecSTORecordFields, vecSTORecords[i], boost::is_any_of(":"), boost::token_compress_on);
-            if (4 != vecSTORecordFields.size()) continue;
-            if (atoi(vecSTORecordFields[1]) < blockNum) {
-                newValue += vecSTORecords[i].append(","); // STO before the reorg, add data back to new value string
-            } else {
-                needsUpdate = true;
+    for (const std::string& prefix : setPrefixes) {
+        if (prefix.size() != TX_KEY_PREFIX_SIZE || prefix[0] != DB_STO_TX) continue;
+        uint256 txid;
+        memcpy(txid.begin(), prefix.data() + 1, 32);
+        for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+            int block = 0;
+            uint32_t propertyId = 0;
+            int64_t amount = 0;
+            const std::string address(it->key().data() + prefix.size(), it->key().size() - prefix.size());
+            if (DecodeReceipt(it->value(), block, propertyId, amount)) {
+                batch.Delete(ReceiptKey(address, block, txid));
             }
-        }
-        if (needsUpdate) { // rewrite record with existing key and new value
+            batch.Delete(it->key());
             ++n_found;
-            leveldb::Status status = pdb->Put(writeoptions, it->key().ToString(), newValue);
-            PrintToLog("DEBUG STO - rewriting STO data after reorg\n");
-            PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
         }
+        batch.Delete(CountKey(txid));
     }
+    delete it;
+    return n_found;
+}
 
-    PrintToLog("%s(%d); stodb updated records= %d\n", __FUNCTION__, blockNum, n_found);
+/**
+ * This function deletes records of STO receivers above/equal to a specific block from the STO database.
+ *
+ * Returns the number of receipts deleted.
+ */
+int CMPSTOList::deleteAboveBlock(int blockNum)
+{
+    leveldb::WriteBatch batch;
 
-    delete it;
+    // the undo log lists the STOs of the blocks, whose receipts are removed from both key spaces
+    const std::set<std::string> setPrefixes = GetKeysWrittenAbove(blockNum, batch);
+    unsigned int n_found = DeleteReceipts(setPrefixes, batch);
+
+    if (!setPrefixes.empty()) {
+        leveldb::Status status = pdb->Write(writeoptions, &batch);
+        PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
+        ScheduleCompaction(batch);
+    }
+
+    PrintToLog("%s(%d); stodb deleted receipts= %d\n", __FUNCTION__, blockNum, n_found);
+
+    return (n_found);
+}
+
+/**
+ * This function deletes records of STO receivers below a specific block from the STO database, to prune the history.
+ *
+ * Returns the number of receipts deleted.
+ */
+int CMPSTOList::deleteBelowBlock(int blockNum)
+{
+    leveldb::WriteBatch batch;
+
+    // the undo log lists the STOs of the blocks, so the whole database isn't scanned
+    const std::set<std::string> setPrefixes = GetKeysWrittenBelow(blockNum, batch);
+    unsigned int n_found = DeleteReceipts(setPrefixes, batch);
+
+    if (!setPrefixes.empty()) {
+        leveldb::Status status = pdb->Write(writeoptions, &batch);
+        PrintToLogVerbose(msc_debug_sto, "%s(%d); stodb deleted receipts= %d, status: %s\n", __func__, blockNum, n_found, status.ToString());
+        ScheduleCompaction(batch);
+    }
 
     return (n_found);
 }
@@ -200,6 +368,7 @@ void CMPSTOList::printAll()
     leveldb::Iterator* it = NewIterator();
 
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (IsUndoLogKey(it->key())) continue;
         skey = it->key();
         svalue = it->value();
         ++count;
@@ -213,49 +382,38 @@ bool CMPSTOList::exists(std::string address)
 {
     if (!pdb) return false;
 
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, address, &strValue);
-
-    if (!status.ok()) {
-        if (status.IsNotFound()) return false;
-    }
+    const std::string prefix = ReceiptPrefix(address);
+    leveldb::Iterator* it = NewIterator();
+    it->Seek(prefix);
+    bool fFound = it->Valid() && it->key().starts_with(prefix);
+    delete it;
 
-    return true;
+    return fFound;
 }
 
-void CMPSTOList::recordSTOReceive(std::string address, const uint256 &txid, int nBlock, unsigned int propertyId, uint64_t amount)
+/**
+ * Records the receipts of all receivers of a send to owners transaction with a single write.
+ *
+ * Each receipt is stored by address and by transaction, along with the number of recipients,
+ * and the transaction is added to the undo log.
+ */
+void CMPSTOList::recordSTOReceives(const uint256& txid, int nBlock, uint32_t propertyId, const OwnerAddrType& receivers)
 {
-    if (!pdb) return;
-
-    bool addressExists = exists(address);
-    if (addressExists) {
-        // retrieve existing record
-        std::vector<std::string> vstr;
-        std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, address, &strValue);
-        if (status.ok()) {
-            // add details to record
-            // see if we are overwriting (check)
-            size_t txidMatch = strValue.find(txid.ToString());
-            if (txidMatch != std::string::npos) PrintToLog("STODEBUG : Duplicating entry for %s : %s\n", address, txid.ToString());
-
-            const std::string key = address;
-            const std::string newValue = strprintf("%s:%d:%u:%lu,", txid.ToString(), nBlock, propertyId, amount);
-            strValue += newValue;
-            // write updated record
-            leveldb::Status status;
-            if (pdb) {
-                status = pdb->Put(writeoptions, key, strValue);
-                PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
-            }
-        }
-    } else {
-        const std::string key = address;
-        const std::string value = strprintf("%s:%d:%u:%lu,", txid.ToString(), nBlock, propertyId, amount);
-        leveldb::Status status;
-        if (pdb) {
-            status = pdb->Put(writeoptions, key, value);
-            PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
-        }
+    if (!pdb || receivers.empty()) return;
+
+    const std::string prefix = TxPrefix(txid);
+    leveldb::WriteBatch batch;
+    for (OwnerAddrType::const_iterator it = receivers.begin(); it != receivers.end(); ++it) {
+        const std::string value = EncodeReceipt(nBlock, propertyId, it->first);
+        batch.Put(ReceiptKey(it->second, nBlock, txid), value);
+        batch.Put(prefix + it->second, value);
     }
+    unsigned char count[sizeof(uint64_t)];
+    WriteBE64(count, receivers.size());
+    batch.Put(CountKey(txid), leveldb::Slice(reinterpret_cast<const char*>(count), sizeof(count)));
+    LogWrittenKey(batch, nBlock, prefix);
+
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    nWritten += receivers.size();
+    PrintToLog("STODBDEBUG : %s(): %d receipts of %s: %s, line %d, file: %s\n", __FUNCTION__, receivers.size(), txid.ToString(), status.ToString(), __LINE__, __FILE__);
 }
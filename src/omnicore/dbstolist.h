@@ -2,41 +2,65 @@
 #define BITCOIN_OMNICORE_DBSTOLIST_H
 
 #include <omnicore/dbbase.h>
+#include <omnicore/sto.h>
 
 #include <fs.h>
 #include <uint256.h>
 
 #include <univalue.h>
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace interfaces {
 class Wallet;
 } // namespace interfaces
 
-/** LevelDB based storage for STO recipients.
+/** LevelDB based storage for STO recipients, with one record per receipt, keyed by address and by transaction.
  */
 class CMPSTOList : public CDBBase
 {
+private:
+    /** Adds the removal of the receipts of the STOs with the given undo log entries to a batch. */
+    unsigned int DeleteReceipts(const std::set<std::string>& setPrefixes, leveldb::WriteBatch& batch);
+
 public:
     CMPSTOList(const fs::path& path, bool fWipe);
     virtual ~CMPSTOList();
 
     void getRecipients(const uint256 txid, std::string filterAddress, UniValue* recipientArray, uint64_t* total, uint64_t* numRecipients, interfaces::Wallet* iWallet = nullptr);
-    std::string getMySTOReceipts(std::string filterAddress, interfaces::Wallet& iWallet);
+    /** Returns the number of recipients of a send to owners transaction. */
+    uint64_t getRecipientCount(const uint256& txid);
+    /** Adds a page of the recipients, which pass the filter, after the address of the cursor, and returns whether there are more. */
+    bool getRecipientsPage(const uint256& txid, const std::string& filterAddress, const std::string& cursor, size_t limit, UniValue& recipientArray, uint64_t& total, std::string& nextCursor, interfaces::Wallet* iWallet = nullptr);
+    /** Returns the transactions and blocks of the receipts of an address, ordered by block. */
+    std::vector<std::pair<uint256, int> > GetAddressReceipts(const std::string& address);
+    /** Returns whether an address of the wallet received tokens from a send to owners transaction. */
+    bool HasReceiptInWallet(const uint256& txid, interfaces::Wallet& iWallet);
     
     /**
      * This function deletes records of STO receivers above/equal to a specific block from the STO database.
      *
-     * Returns the number of records changed.
+     * Returns the number of receipts deleted.
      */
     int deleteAboveBlock(int blockNum);
+
+    /**
+     * This function deletes records of STO receivers below a specific block from the STO database.
+     *
+     * Returns the number of receipts deleted.
+     */
+    int deleteBelowBlock(int blockNum);
     void printStats();
     void printAll();
     bool exists(std::string address);
-    void recordSTOReceive(std::string, const uint256&, int, unsigned int, uint64_t);
+    /** Records the receipts of all receivers of a send to owners transaction with a single write. */
+    void recordSTOReceives(const uint256& txid, int nBlock, uint32_t propertyId, const mastercore::OwnerAddrType& receivers);
 };
 
 namespace mastercore
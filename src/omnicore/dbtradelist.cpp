@@ -5,6 +5,7 @@
 #include <omnicore/sp.h>
 
 #include <amount.h>
+#include <crypto/common.h>
 #include <fs.h>
 #include <uint256.h>
 #include <util/strencodings.h>
@@ -15,48 +16,215 @@
 #include <leveldb/iterator.h>
 #include <leveldb/slice.h>
 #include <leveldb/status.h>
-
-#include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast.hpp>
+#include <leveldb/write_batch.h>
 
 #include <stddef.h>
 
 #include <algorithm>
-#include <map>
+#include <functional>
+#include <limits>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
 using mastercore::isPropertyDivisible;
 
+//! Prefix of the keys of the index of matched trades by property pair
+static const char DB_TRADE_PAIR_INDEX = 'p';
+//! Size of the keys of the pair index
+static const size_t PAIR_INDEX_KEY_SIZE = 1 + 3 * sizeof(uint32_t) + 2 * 32;
+
+/** Returns the prefix of the pair index keys of a property pair, independent of the direction of the trades. */
+static std::string PairIndexPrefix(uint32_t propertyIdA, uint32_t propertyIdB)
+{
+    unsigned char buf[1 + 2 * sizeof(uint32_t)];
+    buf[0] = DB_TRADE_PAIR_INDEX;
+    WriteBE32(buf + 1, std::min(propertyIdA, propertyIdB));
+    WriteBE32(buf + 5, std::max(propertyIdA, propertyIdB));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/**
+ * Creates the key of a matched trade in the pair index.
+ *
+ * Key: 'p' + smaller property id + larger property id + inverted block + txid1 + txid2
+ *
+ * The numbers are stored in big endian byte order, and the block is inverted, so the
+ * newest trades of a pair come first.
+ */
+static std::string PairIndexKey(uint32_t propertyIdA, uint32_t propertyIdB, int blockNum, const uint256& txid1, const uint256& txid2)
+{
+    std::string key = PairIndexPrefix(propertyIdA, propertyIdB);
+    unsigned char buf[sizeof(uint32_t)];
+    WriteBE32(buf, std::numeric_limits<uint32_t>::max() - static_cast<uint32_t>(blockNum));
+    key.append(reinterpret_cast<const char*>(buf), sizeof(buf));
+    key.append(txid1.begin(), txid1.end());
+    key.append(txid2.begin(), txid2.end());
+    return key;
+}
+
+/** Returns whether a key belongs to the pair index, and not to a trade record. */
+static bool IsPairIndexKey(const leveldb::Slice& key)
+{
+    return key.size() == PAIR_INDEX_KEY_SIZE && key[0] == DB_TRADE_PAIR_INDEX;
+}
+
+//! Prefix of the keys of the index of new trades by address, upper case unlike the hex keys of trade records
+static const char DB_TRADE_ADDRESS_INDEX = 'A';
+//! Size of the block, position and txid at the end of the keys of the address index
+static const size_t ADDRESS_INDEX_SUFFIX_SIZE = 2 * sizeof(uint32_t) + 32;
+
+/** Returns the prefix of the address index keys of an address, which is terminated, as addresses vary in length. */
+static std::string AddressIndexPrefix(const std::string& address)
+{
+    std::string prefix(1, DB_TRADE_ADDRESS_INDEX);
+    prefix += address;
+    prefix.push_back('\0');
+    return prefix;
+}
+
+/**
+ * Creates the key of a new trade in the address index.
+ *
+ * Key:   'A' + address + '\0' + block + position in block + txid
+ * Value: property id for sale + property id desired
+ *
+ * The numbers are stored in big endian byte order, so the trades of an address are sorted by block and position.
+ */
+static std::string AddressIndexKey(const std::string& address, int blockNum, int blockIndex, const uint256& txid)
+{
+    std::string key = AddressIndexPrefix(address);
+    unsigned char buf[2 * sizeof(uint32_t)];
+    WriteBE32(buf, static_cast<uint32_t>(blockNum));
+    WriteBE32(buf + 4, static_cast<uint32_t>(blockIndex));
+    key.append(reinterpret_cast<const char*>(buf), sizeof(buf));
+    key.append(txid.begin(), txid.end());
+    return key;
+}
+
+/** Returns whether a key belongs to the address index, and not to a trade record. */
+static bool IsAddressIndexKey(const leveldb::Slice& key)
+{
+    return key.size() > ADDRESS_INDEX_SUFFIX_SIZE && key[0] == DB_TRADE_ADDRESS_INDEX;
+}
+
+namespace {
+/** Value of a matched trade record, keyed by the txids of both sides. */
+struct MatchedTradeRecord
+{
+    std::string address1;
+    std::string address2;
+    uint32_t prop1;
+    uint32_t prop2;
+    int64_t amount1;
+    int64_t amount2;
+    int32_t block;
+    int64_t fee;
+
+    MatchedTradeRecord() : prop1(0), prop2(0), amount1(0), amount2(0), block(0), fee(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(address1);
+        READWRITE(address2);
+        READWRITE(prop1);
+        READWRITE(prop2);
+        READWRITE(amount1);
+        READWRITE(amount2);
+        READWRITE(block);
+        READWRITE(fee);
+    }
+};
+
+/** Value of a new trade record, keyed by the txid of the trade. */
+struct NewTradeRecord
+{
+    std::string address;
+    uint32_t propertyIdForSale;
+    uint32_t propertyIdDesired;
+    int32_t block;
+    int32_t blockIndex;
+
+    NewTradeRecord() : propertyIdForSale(0), propertyIdDesired(0), block(0), blockIndex(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(address);
+        READWRITE(propertyIdForSale);
+        READWRITE(propertyIdDesired);
+        READWRITE(block);
+        READWRITE(blockIndex);
+    }
+};
+}
+
 CMPTradeList::CMPTradeList(const fs::path& path, bool fWipe)
 {
-    leveldb::Status status = Open(path, fWipe);
+    leveldb::Status status = Open(path, fWipe, true);
     PrintToConsole("Loading trades database: %s\n", status.ToString());
 }
 
 CMPTradeList::~CMPTradeList()
 {
-    if (msc_debug_persistence) PrintToLog("CMPTradeList closed\n");
+    PrintToLogVerbose(msc_debug_persistence, "CMPTradeList closed\n");
 }
 
 void CMPTradeList::recordMatchedTrade(const uint256& txid1, const uint256& txid2, const std::string& address1, const std::string& address2, uint32_t prop1, uint32_t prop2, int64_t amount1, int64_t amount2, int blockNum, int64_t fee)
 {
     if (!pdb) return;
     const std::string key = txid1.ToString() + "+" + txid2.ToString();
-    const std::string value = strprintf("%s:%s:%u:%u:%lu:%lu:%d:%d", address1, address2, prop1, prop2, amount1, amount2, blockNum, fee);
-    leveldb::Status status = pdb->Put(writeoptions, key, value);
+    MatchedTradeRecord record;
+    record.address1 = address1;
+    record.address2 = address2;
+    record.prop1 = prop1;
+    record.prop2 = prop2;
+    record.amount1 = amount1;
+    record.amount2 = amount2;
+    record.block = blockNum;
+    record.fee = fee;
+    const std::string value = EncodeDBValue(record);
+    // the trade and its entry in the pair index are written together
+    leveldb::WriteBatch batch;
+    batch.Put(key, value);
+    const std::string indexKey = PairIndexKey(prop1, prop2, blockNum, txid1, txid2);
+    batch.Put(indexKey, leveldb::Slice());
+    LogWrittenKey(batch, blockNum, key);
+    LogWrittenKey(batch, blockNum, indexKey);
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
     ++nWritten;
-    if (msc_debug_tradedb) PrintToLog("%s: %s\n", __func__, status.ToString());
+    PrintToLogIf(msc_debug_tradedb, "%s: %s\n", __func__, status.ToString());
 }
 
 void CMPTradeList::recordNewTrade(const uint256& txid, const std::string& address, uint32_t propertyIdForSale, uint32_t propertyIdDesired, int blockNum, int blockIndex)
 {
     if (!pdb) return;
-    std::string strValue = strprintf("%s:%d:%d:%d:%d", address, propertyIdForSale, propertyIdDesired, blockNum, blockIndex);
-    leveldb::Status status = pdb->Put(writeoptions, txid.ToString(), strValue);
+    NewTradeRecord record;
+    record.address = address;
+    record.propertyIdForSale = propertyIdForSale;
+    record.propertyIdDesired = propertyIdDesired;
+    record.block = blockNum;
+    record.blockIndex = blockIndex;
+    const std::string strValue = EncodeDBValue(record);
+    unsigned char properties[2 * sizeof(uint32_t)];
+    WriteBE32(properties, propertyIdForSale);
+    WriteBE32(properties + 4, propertyIdDesired);
+    // the trade and its entry in the address index are written together
+    leveldb::WriteBatch batch;
+    batch.Put(txid.ToString(), strValue);
+    const std::string indexKey = AddressIndexKey(address, blockNum, blockIndex, txid);
+    batch.Put(indexKey, leveldb::Slice(reinterpret_cast<const char*>(properties), sizeof(properties)));
+    LogWrittenKey(batch, blockNum, txid.ToString());
+    LogWrittenKey(batch, blockNum, indexKey);
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
     ++nWritten;
-    if (msc_debug_tradedb) PrintToLog("%s: %s\n", __func__, status.ToString());
+    PrintToLogIf(msc_debug_tradedb, "%s: %s\n", __func__, status.ToString());
 }
 
 /**
@@ -66,34 +234,58 @@ void CMPTradeList::recordNewTrade(const uint256& txid, const std::string& addres
  */
 int CMPTradeList::deleteAboveBlock(int blockNum)
 {
-    leveldb::Slice skey, svalue;
-    unsigned int count = 0;
-    std::vector<std::string> vstr;
-    int block = 0;
     unsigned int n_found = 0;
-    leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
-        ++count;
-        std::string strvalue = it->value().ToString();
-        boost::split(vstr, strvalue, boost::is_any_of(":"), boost::token_compress_on);
-        if (7 == vstr.size()) block = atoi(vstr[6]); // trade matches have 7 tokens, key is txid+txid, only care about block
-        if (5 == vstr.size()) block = atoi(vstr[3]); // trades have 5 tokens, key is txid, only care about block
-        if (block >= blockNum) {
+    leveldb::WriteBatch batch;
+
+    // the undo log lists the trades and index entries written in the blocks
+    const std::set<std::string> setKeys = GetKeysWrittenAbove(blockNum, batch);
+    for (const std::string& key : setKeys) {
+        if (!IsPairIndexKey(key) && !IsAddressIndexKey(key)) {
             ++n_found;
-            PrintToLog("%s() DELETING FROM TRADEDB: %s=%s\n", __func__, skey.ToString(), svalue.ToString());
-            pdb->Delete(writeoptions, skey);
+            PrintToLog("%s() DELETING FROM TRADEDB: %s\n", __func__, key);
         }
+        batch.Delete(key);
+    }
+
+    if (!setKeys.empty()) {
+        leveldb::Status status = pdb->Write(writeoptions, &batch);
+        PrintToLogIf(msc_debug_tradedb, "%s: %s\n", __func__, status.ToString());
+        ScheduleCompaction(batch);
     }
-    
-    delete it;
 
     PrintToLog("%s(%d); tradedb n_found= %d\n", __func__, blockNum, n_found);
 
     return n_found;
 }
 
+/**
+ * This function deletes records of trades below a specific block from the trade database, to prune the history.
+ *
+ * Returns the number of records deleted.
+ */
+int CMPTradeList::deleteBelowBlock(int blockNum)
+{
+    unsigned int n_found = 0;
+    leveldb::WriteBatch batch;
+
+    // the undo log lists the trades and index entries written in the blocks
+    const std::set<std::string> setKeys = GetKeysWrittenBelow(blockNum, batch);
+    for (const std::string& key : setKeys) {
+        if (!IsPairIndexKey(key) && !IsAddressIndexKey(key)) ++n_found;
+        batch.Delete(key);
+    }
+
+    if (!setKeys.empty()) {
+        leveldb::Status status = pdb->Write(writeoptions, &batch);
+        PrintToLogIf(msc_debug_tradedb, "%s: %s\n", __func__, status.ToString());
+        ScheduleCompaction(batch);
+    }
+
+    PrintToLogIf(msc_debug_tradedb, "%s(%d); tradedb n_found= %d\n", __func__, blockNum, n_found);
+
+    return n_found;
+}
+
 void CMPTradeList::printStats()
 {
     PrintToLog("CMPTradeList stats: tWritten= %d , tRead= %d\n", nWritten, nRead);
@@ -106,10 +298,11 @@ void CMPTradeList::printAll()
     leveldb::Iterator* it = NewIterator();
 
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (IsUndoLogKey(it->key())) continue;
         skey = it->key();
         svalue = it->value();
         ++count;
-        PrintToConsole("entry #%8d= %s:%s\n", count, skey.ToString(), svalue.ToString());
+        PrintToConsole("entry #%8d= %s:%s\n", count, skey.ToString(), HexStr(svalue.ToString()));
     }
 
     delete it;
@@ -123,13 +316,11 @@ bool CMPTradeList::getMatchingTrades(const uint256& txid, uint32_t propertyId, U
     totalReceived = 0;
     totalSold = 0;
 
-    std::vector<std::string> vstr;
     std::string txidStr = txid.ToString();
     leveldb::Iterator* it = NewIterator();
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
         // search key to see if this is a matching trade
         std::string strKey = it->key().ToString();
-        std::string strValue = it->value().ToString();
         std::string matchTxid;
         size_t txidMatch = strKey.find(txidStr);
         if (txidMatch == std::string::npos) continue; // no match
@@ -144,22 +335,20 @@ bool CMPTradeList::getMatchingTrades(const uint256& txid, uint32_t propertyId, U
             matchTxid = strKey.substr(0, 64);
         }
 
-        // ensure correct amount of tokens in value string
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (vstr.size() != 8) {
-            PrintToLog("TRADEDB error - unexpected number of tokens in value (%s)\n", strValue);
+        // decode the details from the value
+        MatchedTradeRecord record;
+        if (!DecodeDBValue(it->value(), record)) {
+            PrintToLog("TRADEDB error - unexpected value of %s\n", strKey);
             continue;
         }
-
-        // decode the details from the value string
-        std::string address1 = vstr[0];
-        std::string address2 = vstr[1];
-        uint32_t prop1 = boost::lexical_cast<uint32_t>(vstr[2]);
-        uint32_t prop2 = boost::lexical_cast<uint32_t>(vstr[3]);
-        int64_t amount1 = boost::lexical_cast<int64_t>(vstr[4]);
-        int64_t amount2 = boost::lexical_cast<int64_t>(vstr[5]);
-        int blockNum = atoi(vstr[6]);
-        int64_t tradingFee = boost::lexical_cast<int64_t>(vstr[7]);
+        const std::string& address1 = record.address1;
+        const std::string& address2 = record.address2;
+        uint32_t prop1 = record.prop1;
+        uint32_t prop2 = record.prop2;
+        int64_t amount1 = record.amount1;
+        int64_t amount2 = record.amount2;
+        int blockNum = record.block;
+        int64_t tradingFee = record.fee;
 
         std::string strAmount1 = FormatMP(prop1, amount1);
         std::string strAmount2 = FormatMP(prop2, amount2);
@@ -201,87 +390,129 @@ bool CMPTradeList::getMatchingTrades(const uint256& txid, uint32_t propertyId, U
 
 // obtains a vector of txids where the supplied address participated in a trade (needed for gettradehistory_MP)
 // optional property ID parameter will filter on propertyId transacted if supplied
-// sorted by block then index
+// sorted by block then index, as read from the address index
 void CMPTradeList::getTradesForAddress(const std::string& address, std::vector<uint256>& vecTransactions, uint32_t propertyIdFilter)
+{
+    std::vector<CMPAddressTrade> vecTrades;
+    getTradesForAddress(address, vecTrades);
+    for (const CMPAddressTrade& trade : vecTrades) {
+        if (propertyIdFilter != 0 && propertyIdFilter != trade.propertyIdForSale && propertyIdFilter != trade.propertyIdDesired) continue;
+        vecTransactions.push_back(trade.txid);
+    }
+}
+
+/**
+ * Appends the new trades of an address with their position and properties, sorted by block and position.
+ *
+ * Only the address index is read, so the trades of an address can be listed without
+ * loading the trade records or the transactions.
+ */
+void CMPTradeList::getTradesForAddress(const std::string& address, std::vector<CMPAddressTrade>& vecTrades)
 {
     if (!pdb) return;
 
-    std::map<std::string, uint256> mapTrades;
-    leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string strKey = it->key().ToString();
-        std::string strValue = it->value().ToString();
-        std::vector<std::string> vecValues;
-        if (strKey.size() != 64) continue; // only interested in trades
-        uint256 txid = uint256S(strKey);
-        size_t addressMatch = strValue.find(address);
-        if (addressMatch == std::string::npos) continue;
-        boost::split(vecValues, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (vecValues.size() != 5) {
-            PrintToLog("TRADEDB error - unexpected number of tokens in value (%s)\n", strValue);
+    const std::string prefix = AddressIndexPrefix(address);
+    leveldb::Iterator* it = NewSnapshotIterator();
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        const leveldb::Slice key = it->key();
+        const leveldb::Slice value = it->value();
+        if (key.size() != prefix.size() + ADDRESS_INDEX_SUFFIX_SIZE || value.size() != 2 * sizeof(uint32_t)) {
+            PrintToLog("TRADEDB error - unexpected address index entry of %s\n", address);
             continue;
         }
-        uint32_t propertyIdForSale = boost::lexical_cast<uint32_t>(vecValues[1]);
-        uint32_t propertyIdDesired = boost::lexical_cast<uint32_t>(vecValues[2]);
-        int64_t blockNum = boost::lexical_cast<uint32_t>(vecValues[3]);
-        int64_t txIndex = boost::lexical_cast<uint32_t>(vecValues[4]);
-        if (propertyIdFilter != 0 && propertyIdFilter != propertyIdForSale && propertyIdFilter != propertyIdDesired) continue;
-        std::string sortKey = strprintf("%06d%010d", blockNum, txIndex);
-        mapTrades.insert(std::make_pair(sortKey, txid));
+        const unsigned char* pSuffix = reinterpret_cast<const unsigned char*>(key.data()) + prefix.size();
+        const unsigned char* pValue = reinterpret_cast<const unsigned char*>(value.data());
+
+        CMPAddressTrade trade;
+        trade.block = static_cast<int>(ReadBE32(pSuffix));
+        trade.blockIndex = static_cast<int>(ReadBE32(pSuffix + 4));
+        trade.txid = uint256(std::vector<unsigned char>(pSuffix + 8, pSuffix + 8 + 32));
+        trade.propertyIdForSale = ReadBE32(pValue);
+        trade.propertyIdDesired = ReadBE32(pValue + 4);
+        vecTrades.push_back(trade);
+        ++nRead;
     }
     delete it;
-
-    for (std::map<std::string, uint256>::iterator it = mapTrades.begin(); it != mapTrades.end(); it++) {
-        vecTransactions.push_back(it->second);
-    }
 }
 
-static bool CompareTradePair(const std::pair<int64_t, UniValue>& firstJSONObj, const std::pair<int64_t, UniValue>& secondJSONObj)
+/**
+ * Obtains an array of matching trades with pricing and volume details for a pair.
+ *
+ * The newest trades are read from the pair index, and returned sorted by block, oldest first.
+ */
+void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyIdSideB, UniValue& responseArray, uint64_t count)
 {
-    return firstJSONObj.first > secondJSONObj.first;
+    getTradesForPair(propertyIdSideA, propertyIdSideB, [&responseArray](const UniValue& trade) { responseArray.push_back(trade); }, count);
 }
 
-// obtains an array of matching trades with pricing and volume details for a pair sorted by blocknumber
-void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyIdSideB, UniValue& responseArray, uint64_t count)
+/**
+ * Passes the matching trades of a pair on one by one, sorted by block, oldest first.
+ *
+ * Only the records are held, while they are read from the index, and every trade
+ * is converted, when it's passed on.
+ */
+void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyIdSideB, const std::function<void(const UniValue& trade)>& push, uint64_t count)
 {
     if (!pdb) return;
-    leveldb::Iterator* it = NewIterator();
-    std::vector<std::pair<int64_t, UniValue> > vecResponse;
+    std::vector<std::pair<std::pair<uint256, uint256>, MatchedTradeRecord>> vecTrades;
+    const std::string prefix = PairIndexPrefix(propertyIdSideA, propertyIdSideB);
+    leveldb::Iterator* it = NewSnapshotIterator();
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix) && vecTrades.size() < count; it->Next()) {
+        if (!IsPairIndexKey(it->key())) continue;
+
+        // the txids of the trade follow the prefix and the block
+        const unsigned char* pTxids = reinterpret_cast<const unsigned char*>(it->key().data()) + prefix.size() + sizeof(uint32_t);
+        const uint256 txid1(std::vector<unsigned char>(pTxids, pTxids + 32));
+        const uint256 txid2(std::vector<unsigned char>(pTxids + 32, pTxids + 64));
+        const std::string strKey = txid1.ToString() + "+" + txid2.ToString();
+        std::string strValue;
+        leveldb::Status status = pdb->Get(readoptions, strKey, &strValue);
+        ++nRead;
+        if (!status.ok()) {
+            PrintToLog("TRADEDB error - indexed trade not found (%s): %s\n", strKey, status.ToString());
+            continue;
+        }
+
+        MatchedTradeRecord record;
+        if (!DecodeDBValue(strValue, record)) {
+            PrintToLog("TRADEDB error - unexpected value of %s\n", strKey);
+            continue;
+        }
+        if (!(record.prop1 == propertyIdSideA && record.prop2 == propertyIdSideB) &&
+                !(record.prop2 == propertyIdSideA && record.prop1 == propertyIdSideB)) {
+            continue;
+        }
+        vecTrades.emplace_back(std::make_pair(txid1, txid2), std::move(record));
+    }
+
+    delete it;
+
     bool propertyIdSideAIsDivisible = isPropertyDivisible(propertyIdSideA);
     bool propertyIdSideBIsDivisible = isPropertyDivisible(propertyIdSideB);
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string strKey = it->key().ToString();
-        std::string strValue = it->value().ToString();
-        std::vector<std::string> vecKeys;
-        std::vector<std::string> vecValues;
+
+    // the index lists the most recent first
+    for (auto rit = vecTrades.rbegin(); rit != vecTrades.rend(); ++rit) {
+        const uint256& txid1 = rit->first.first;
+        const uint256& txid2 = rit->first.second;
+        const MatchedTradeRecord& record = rit->second;
+
         uint256 sellerTxid, matchingTxid;
         std::string sellerAddress, matchingAddress;
         int64_t amountReceived = 0, amountSold = 0;
-        if (strKey.size() != 129) continue; // only interested in matches
-        boost::split(vecKeys, strKey, boost::is_any_of("+"), boost::token_compress_on);
-        boost::split(vecValues, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (vecKeys.size() != 2 || vecValues.size() != 8) {
-            PrintToLog("TRADEDB error - unexpected number of tokens (%s:%s)\n", strKey, strValue);
-            continue;
-        }
-        uint32_t tradePropertyIdSideA = boost::lexical_cast<uint32_t>(vecValues[2]);
-        uint32_t tradePropertyIdSideB = boost::lexical_cast<uint32_t>(vecValues[3]);
-        if (tradePropertyIdSideA == propertyIdSideA && tradePropertyIdSideB == propertyIdSideB) {
-            sellerTxid.SetHex(vecKeys[1]);
-            sellerAddress = vecValues[1];
-            amountSold = boost::lexical_cast<int64_t>(vecValues[4]);
-            matchingTxid.SetHex(vecKeys[0]);
-            matchingAddress = vecValues[0];
-            amountReceived = boost::lexical_cast<int64_t>(vecValues[5]);
-        } else if (tradePropertyIdSideB == propertyIdSideA && tradePropertyIdSideA == propertyIdSideB) {
-            sellerTxid.SetHex(vecKeys[0]);
-            sellerAddress = vecValues[0];
-            amountSold = boost::lexical_cast<int64_t>(vecValues[5]);
-            matchingTxid.SetHex(vecKeys[1]);
-            matchingAddress = vecValues[1];
-            amountReceived = boost::lexical_cast<int64_t>(vecValues[4]);
+        if (record.prop1 == propertyIdSideA && record.prop2 == propertyIdSideB) {
+            sellerTxid = txid2;
+            sellerAddress = record.address2;
+            amountSold = record.amount1;
+            matchingTxid = txid1;
+            matchingAddress = record.address1;
+            amountReceived = record.amount2;
         } else {
-            continue;
+            sellerTxid = txid1;
+            sellerAddress = record.address1;
+            amountSold = record.amount2;
+            matchingTxid = txid2;
+            matchingAddress = record.address2;
+            amountReceived = record.amount1;
         }
 
         rational_t unitPrice(amountReceived, amountSold);
@@ -291,7 +522,7 @@ void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyI
         std::string unitPriceStr = xToString(unitPrice); // TODO: not here!
         std::string inversePriceStr = xToString(inversePrice);
 
-        int64_t blockNum = boost::lexical_cast<int64_t>(vecValues[6]);
+        int64_t blockNum = record.block;
 
         UniValue trade(UniValue::VOBJ);
         trade.pushKV("block", blockNum);
@@ -311,26 +542,8 @@ void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyI
         }
         trade.pushKV("matchingtxid", matchingTxid.GetHex());
         trade.pushKV("matchingaddress", matchingAddress);
-        vecResponse.push_back(std::make_pair(blockNum, trade));
+        push(trade);
     }
-
-    // sort the response most recent first before adding to the array
-    std::sort(vecResponse.begin(), vecResponse.end(), CompareTradePair);
-    uint64_t processed = 0;
-    for (std::vector<std::pair<int64_t, UniValue> >::iterator it = vecResponse.begin(); it != vecResponse.end(); ++it) {
-        responseArray.push_back(it->second);
-        processed++;
-        if (processed >= count) break;
-    }
-
-    std::vector<UniValue> responseArrayValues = responseArray.getValues();
-    std::reverse(responseArrayValues.begin(), responseArrayValues.end());
-    responseArray.clear();
-    for (std::vector<UniValue>::iterator it = responseArrayValues.begin(); it != responseArrayValues.end(); ++it) {
-        responseArray.push_back(*it);
-    }
-
-    delete it;
 }
 
 int CMPTradeList::getMPTradeCountTotal()
@@ -338,6 +551,7 @@ int CMPTradeList::getMPTradeCountTotal()
     int count = 0;
     leveldb::Iterator* it = NewIterator();
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (IsPairIndexKey(it->key()) || IsAddressIndexKey(it->key()) || IsUndoLogKey(it->key())) continue;
         ++count;
     }
     delete it;
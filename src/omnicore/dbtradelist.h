@@ -10,9 +10,20 @@
 
 #include <stdint.h>
 
+#include <functional>
 #include <string>
 #include <vector>
 
+/** A new trade of an address, as listed by the address index. */
+struct CMPAddressTrade
+{
+    uint256 txid;
+    int block;
+    int blockIndex;
+    uint32_t propertyIdForSale;
+    uint32_t propertyIdDesired;
+};
+
 /** LevelDB based storage for the MetaDEx trade history. Trades are listed with key "txid1+txid2".
  */
 class CMPTradeList : public CDBBase
@@ -24,12 +35,16 @@ public:
     void recordMatchedTrade(const uint256& txid1, const uint256& txid2, const std::string& address1, const std::string& address2, uint32_t prop1, uint32_t prop2, int64_t amount1, int64_t amount2, int blockNum, int64_t fee);
     void recordNewTrade(const uint256& txid, const std::string& address, uint32_t propertyIdForSale, uint32_t propertyIdDesired, int blockNum, int blockIndex);
     int deleteAboveBlock(int blockNum);
+    /** Deletes the trades and index entries written below a block, and returns the number of trades deleted. */
+    int deleteBelowBlock(int blockNum);
     bool exists(const uint256 &txid);
     void printStats();
     void printAll();
     bool getMatchingTrades(const uint256& txid, uint32_t propertyId, UniValue& tradeArray, int64_t& totalSold, int64_t& totalBought);
     void getTradesForAddress(const std::string& address, std::vector<uint256>& vecTransactions, uint32_t propertyIdFilter = 0);
+    void getTradesForAddress(const std::string& address, std::vector<CMPAddressTrade>& vecTrades);
     void getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyIdSideB, UniValue& response, uint64_t count);
+    void getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyIdSideB, const std::function<void(const UniValue& trade)>& push, uint64_t count);
     int getMPTradeCountTotal();
 };
 
@@ -2,70 +2,81 @@
 
 #include <omnicore/errors.h>
 #include <omnicore/log.h>
+#include <omnicore/tx.h>
 
 #include <fs.h>
 #include <uint256.h>
 #include <tinyformat.h>
 
 #include <leveldb/status.h>
-
-#include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast.hpp>
+#include <leveldb/write_batch.h>
 
 #include <stddef.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
 COmniTransactionDB::COmniTransactionDB(const fs::path& path, bool fWipe)
 {
-    leveldb::Status status = Open(path, fWipe);
+    EnableReadCache(OMNITXDB_READ_CACHE_SIZE);
+    leveldb::Status status = Open(path, fWipe, true);
     PrintToConsole("Loading master transactions database: %s\n", status.ToString());
 }
 
 COmniTransactionDB::~COmniTransactionDB()
 {
-    if (msc_debug_persistence) PrintToLog("COmniTransactionDB closed\n");
+    PrintToLogVerbose(msc_debug_persistence, "COmniTransactionDB closed\n");
+}
+
+/**
+ * Sets the recorded fields of the transaction object, which is ready to be interpreted.
+ */
+void COmniTransactionDB::Record::Restore(CMPTransaction& mp_obj, const uint256& txid, int64_t blockTime) const
+{
+    std::vector<unsigned char> packet(payload);
+    packet.resize(std::max(packet.size(), size_t(1)));
+    mp_obj.Set(sender, receiver, 0, txid, block, position, packet.data(), payload.size(), encodingClass, fee);
+    mp_obj.Set(txid, block, position, blockTime);
 }
 
 /**
- * Retrieves the serialized transaction details from the DB. 
+ * Retrieves the record of a transaction.
  */
-std::vector<std::string> COmniTransactionDB::FetchTransactionDetails(const uint256& txid)
+bool COmniTransactionDB::FetchTransactionRecord(const uint256& txid, Record& record)
 {
     assert(pdb);
-    std::string strValue;
-    std::vector<std::string> vTransactionDetails;
-
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString(), &strValue);
-    if (status.ok()) {
-        std::vector<std::string> vStr;
-        boost::split(vStr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (vStr.size() == 2) {
-            vTransactionDetails.push_back(vStr[0]);
-            vTransactionDetails.push_back(vStr[1]);
-        } else {
-            PrintToLog("ERROR: Entry (%s) found in OmniTXDB with unexpected number of attributes!\n", txid.GetHex());
-        }
-    } else {
-        PrintToLog("ERROR: Entry (%s) could not be loaded from OmniTXDB!\n", txid.GetHex());
+
+    leveldb::Status status = CachedGet(txid.ToString(), record);
+    if (status.IsCorruption()) {
+        PrintToLog("ERROR: Entry (%s) found in OmniTXDB has an unexpected format!\n", txid.GetHex());
+    } else if (!status.ok() && !status.IsNotFound()) {
+        PrintToLog("ERROR: Entry (%s) could not be loaded from OmniTXDB: %s\n", txid.GetHex(), status.ToString());
     }
 
-    return vTransactionDetails;
+    return status.ok();
 }
 
 /**
- * Stores position in block and validation result for a transaction.
+ * Stores the decoded fields, position in block and validation result for a transaction.
  */
-void COmniTransactionDB::RecordTransaction(const uint256& txid, uint32_t posInBlock, int processingResult)
+void COmniTransactionDB::RecordTransaction(const CMPTransaction& mp_obj, const uint256& blockHash, int processingResult)
 {
     assert(pdb);
 
-    const std::string key = txid.ToString();
-    const std::string value = strprintf("%d:%d", posInBlock, processingResult);
-
-    leveldb::Status status = pdb->Put(writeoptions, key, value);
+    Record record;
+    record.blockHash = blockHash;
+    record.block = mp_obj.getBlock();
+    record.position = mp_obj.getIndexInBlock();
+    record.processingResult = processingResult;
+    record.encodingClass = mp_obj.getEncodingClass();
+    record.fee = mp_obj.getFeePaid();
+    record.sender = mp_obj.getSender();
+    record.receiver = mp_obj.getReceiver();
+    record.payload = mp_obj.getRawPayload();
+
+    leveldb::Status status = pdb->Put(writeoptions, mp_obj.getHash().ToString(), EncodeDBValue(record));
     ++nWritten;
 }
 
@@ -76,9 +87,9 @@ uint32_t COmniTransactionDB::FetchTransactionPosition(const uint256& txid)
 {
     uint32_t posInBlock = 999999; // setting an initial arbitrarily high value will ensure transaction is always "last" in event of bug/exploit
 
-    std::vector<std::string> vTransactionDetails = FetchTransactionDetails(txid);
-    if (vTransactionDetails.size() == 2) {
-        posInBlock = boost::lexical_cast<uint32_t>(vTransactionDetails[0]);
+    Record record;
+    if (FetchTransactionRecord(txid, record)) {
+        posInBlock = record.position;
     }
 
     return posInBlock;
@@ -91,10 +102,25 @@ std::string COmniTransactionDB::FetchInvalidReason(const uint256& txid)
 {
     int processingResult = -999999;
 
-    std::vector<std::string> vTransactionDetails = FetchTransactionDetails(txid);
-    if (vTransactionDetails.size() == 2) {
-        processingResult = boost::lexical_cast<int>(vTransactionDetails[1]);
+    Record record;
+    if (FetchTransactionRecord(txid, record)) {
+        processingResult = record.processingResult;
     }
 
     return error_str(processingResult);
 }
+
+void COmniTransactionDB::DeleteTransactions(const std::vector<uint256>& vTxids)
+{
+    assert(pdb);
+    if (vTxids.empty()) return;
+
+    leveldb::WriteBatch batch;
+    for (const uint256& txid : vTxids) {
+        batch.Delete(txid.ToString());
+    }
+
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    PrintToLogVerbose(msc_debug_persistence, "%s(): deleted %d records, status: %s\n", __func__, vTxids.size(), status.ToString());
+    ScheduleCompaction(batch);
+}
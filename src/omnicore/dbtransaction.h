@@ -4,6 +4,7 @@
 #include <omnicore/dbbase.h>
 
 #include <fs.h>
+#include <serialize.h>
 #include <uint256.h>
 
 #include <stdint.h>
@@ -11,16 +12,63 @@
 #include <string>
 #include <vector>
 
+class CMPTransaction;
+
+//! Number of decoded transaction records, which are cached for repeated reads
+static const size_t OMNITXDB_READ_CACHE_SIZE = 10000;
+
 /** LevelDB based storage for storing Omni transaction validation and position in block data.
  */
 class COmniTransactionDB : public CDBBase
 {
 public:
+    /**
+     * Decoded fields of a transaction, as recorded when the transaction was processed.
+     *
+     * The record holds everything needed to rebuild the transaction object, so
+     * RPC results can be rendered without reading and parsing the transaction again.
+     */
+    struct Record {
+        uint256 blockHash;
+        int32_t block;
+        uint32_t position;
+        int32_t processingResult;
+        int32_t encodingClass;
+        uint64_t fee;
+        std::string sender;
+        std::string receiver;
+        std::vector<unsigned char> payload;
+
+        Record() : block(0), position(0), processingResult(0), encodingClass(0), fee(0) {}
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action)
+        {
+            READWRITE(blockHash);
+            READWRITE(block);
+            READWRITE(position);
+            READWRITE(processingResult);
+            READWRITE(encodingClass);
+            READWRITE(fee);
+            READWRITE(sender);
+            READWRITE(receiver);
+            READWRITE(payload);
+        }
+
+        /** Sets the recorded fields of the transaction object, which is ready to be interpreted. */
+        void Restore(CMPTransaction& mp_obj, const uint256& txid, int64_t blockTime) const;
+    };
+
     COmniTransactionDB(const fs::path& path, bool fWipe);
     virtual ~COmniTransactionDB();
 
-    /** Stores position in block and validation result for a transaction. */
-    void RecordTransaction(const uint256& txid, uint32_t posInBlock, int processingResult);
+    /** Stores the decoded fields, position in block and validation result for a transaction. */
+    void RecordTransaction(const CMPTransaction& mp_obj, const uint256& blockHash, int processingResult);
+
+    /** Retrieves the record of a transaction. */
+    bool FetchTransactionRecord(const uint256& txid, Record& record);
 
     /** Returns the position of a transaction in a block. */
     uint32_t FetchTransactionPosition(const uint256& txid);
@@ -28,13 +76,15 @@ public:
     /** Returns the reason why a transaction is invalid. */
     std::string FetchInvalidReason(const uint256& txid);
 
-private:
-    /** Retrieves the serialized transaction details from the DB. */
-    std::vector<std::string> FetchTransactionDetails(const uint256& txid);
+    /** Deletes the records of the given transactions, which were pruned from the transaction list. */
+    void DeleteTransactions(const std::vector<uint256>& vTxids);
 };
 
 namespace mastercore
 {
+    //! Default setting, whether Omni Core runs without transaction index, so blocks can be pruned
+    static const bool DEFAULT_OMNI_PRUNE = false;
+
     //! LevelDB based storage for storing Omni transaction validation and position in block data
     extern COmniTransactionDB* pDbTransaction;
 }
@@ -4,6 +4,7 @@
 #include <omnicore/dbtransaction.h>
 #include <omnicore/dex.h>
 #include <omnicore/log.h>
+#include <omnicore/mdex.h>
 #include <omnicore/notifications.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/tx.h>
@@ -11,6 +12,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <crypto/common.h>
 #include <fs.h>
 #include <validation.h>
 #include <sync.h>
@@ -22,12 +24,13 @@
 #include <leveldb/iterator.h>
 #include <leveldb/slice.h>
 #include <leveldb/status.h>
+#include <leveldb/write_batch.h>
 
-#include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <algorithm>
 #include <string>
@@ -43,34 +46,336 @@ using mastercore::GetBlockIndex;
 using mastercore::isNonMainNet;
 using mastercore::pDbTransaction;
 
+//! Prefix of the keys of the index of transactions by block, which is not a hex digit unlike the txids of the records
+static const char DB_TX_HEIGHT_INDEX = 'h';
+//! Size of the prefix and block at the start of the keys of the height index
+static const size_t HEIGHT_INDEX_PREFIX_SIZE = 1 + sizeof(uint32_t);
+
+/** Returns the prefix of the height index keys of a block. */
+static std::string HeightIndexPrefix(int block)
+{
+    unsigned char buf[HEIGHT_INDEX_PREFIX_SIZE];
+    buf[0] = DB_TX_HEIGHT_INDEX;
+    WriteBE32(buf + 1, static_cast<uint32_t>(block));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/**
+ * Creates the key of a record in the height index.
+ *
+ * Key:   'h' + block + key of the record
+ * Value: transaction type
+ *
+ * The numbers are stored in big endian byte order, so the records are sorted by block.
+ */
+static std::string HeightIndexKey(int block, const std::string& recordKey)
+{
+    return HeightIndexPrefix(block) + recordKey;
+}
+
+/** Returns whether a key belongs to the height index, and not to a transaction record. */
+static bool IsHeightIndexKey(const leveldb::Slice& key)
+{
+    return key.size() > HEIGHT_INDEX_PREFIX_SIZE && key[0] == DB_TX_HEIGHT_INDEX;
+}
+
+/** Returns the block of a height index key. */
+static int HeightIndexBlock(const leveldb::Slice& key)
+{
+    return static_cast<int>(ReadBE32(reinterpret_cast<const unsigned char*>(key.data()) + 1));
+}
+
+/** Returns the key of the record referenced by a height index key. */
+static std::string HeightIndexRecordKey(const leveldb::Slice& key)
+{
+    return std::string(key.data() + HEIGHT_INDEX_PREFIX_SIZE, key.size() - HEIGHT_INDEX_PREFIX_SIZE);
+}
+
+//! Prefix of the keys of the index of transactions by type, which only covers the types loaded at startup
+static const char DB_TX_TYPE_INDEX = 't';
+//! Size of the prefix and type at the start of the keys of the type index
+static const size_t TYPE_INDEX_PREFIX_SIZE = 1 + sizeof(uint32_t);
+
+/** Returns whether transactions of a type are indexed, because they are loaded at startup or after reorganizations. */
+static bool IsTypeIndexed(uint32_t type)
+{
+    return type == OMNICORE_MESSAGE_TYPE_ALERT || type == OMNICORE_MESSAGE_TYPE_ACTIVATION ||
+            type == MSC_TYPE_FREEZE_PROPERTY_TOKENS || type == MSC_TYPE_UNFREEZE_PROPERTY_TOKENS ||
+            type == MSC_TYPE_ENABLE_FREEZING || type == MSC_TYPE_DISABLE_FREEZING;
+}
+
+/** Returns the prefix of the type index keys of a transaction type. */
+static std::string TypeIndexPrefix(uint32_t type)
+{
+    unsigned char buf[TYPE_INDEX_PREFIX_SIZE];
+    buf[0] = DB_TX_TYPE_INDEX;
+    WriteBE32(buf + 1, type);
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/** Returns the prefix of the type index keys of a transaction type in and above a block. */
+static std::string TypeIndexPrefix(uint32_t type, int block)
+{
+    unsigned char buf[sizeof(uint32_t)];
+    WriteBE32(buf, block);
+    return TypeIndexPrefix(type) + std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/**
+ * Creates the key of a record in the type index.
+ *
+ * Key:   't' + type + block + key of the record
+ * Value: position of the transaction in the block
+ *
+ * The keys are ordered by block, so the transactions of a type can be loaded without reading unrelated records.
+ */
+static std::string TypeIndexKey(uint32_t type, int block, const std::string& recordKey)
+{
+    return TypeIndexPrefix(type, block) + recordKey;
+}
+
+/** Returns whether a key belongs to the type index. */
+static bool IsTypeIndexKey(const leveldb::Slice& key)
+{
+    return key.size() > TYPE_INDEX_PREFIX_SIZE + sizeof(uint32_t) && key[0] == DB_TX_TYPE_INDEX;
+}
+
+//! Prefix of the keys of the commitments to the state at the end of each block
+static const char DB_TX_STATE_HASH = 's';
+
+/**
+ * Creates the key of the commitment to the state at the end of a block.
+ *
+ * Key:   's' + block
+ * Value: block hash + commitment
+ *
+ * A block is replaced, when it's processed again after a reorganization, and only
+ * returned, if the stored block hash matches.
+ */
+static std::string StateHashKey(int block)
+{
+    unsigned char buf[1 + sizeof(uint32_t)];
+    buf[0] = DB_TX_STATE_HASH;
+    WriteBE32(buf + 1, static_cast<uint32_t>(block));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/** Returns whether a key belongs to the commitments to the state. */
+static bool IsStateHashKey(const leveldb::Slice& key)
+{
+    return key.size() == 1 + sizeof(uint32_t) && key[0] == DB_TX_STATE_HASH;
+}
+
+namespace {
+/** Value of a transaction record: validity, block, type, and the amended amount or number of sub records. */
+struct TxRecord
+{
+    bool fValid;
+    int32_t block;
+    uint32_t type;
+    uint64_t value;
+
+    TxRecord() : fValid(false), block(0), type(0), value(0) {}
+    TxRecord(bool fValidIn, int blockIn, uint32_t typeIn, uint64_t valueIn)
+      : fValid(fValidIn), block(blockIn), type(typeIn), value(valueIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(fValid);
+        READWRITE(block);
+        READWRITE(type);
+        READWRITE(value);
+    }
+};
+
+/** Value of the sub record of a DEx payment. */
+struct PaymentRecord
+{
+    uint32_t vout;
+    std::string buyer;
+    std::string seller;
+    uint32_t propertyId;
+    uint64_t amount;
+
+    PaymentRecord() : vout(0), propertyId(0), amount(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(vout);
+        READWRITE(buyer);
+        READWRITE(seller);
+        READWRITE(propertyId);
+        READWRITE(amount);
+    }
+};
+
+/** Value of the sub record of a MetaDEx cancel: the cancelled order and the amount unreserved. */
+struct CancelRecord
+{
+    uint256 txid;
+    uint32_t propertyId;
+    int64_t amountUnreserved;
+
+    CancelRecord() : propertyId(0), amountUnreserved(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txid);
+        READWRITE(propertyId);
+        READWRITE(amountUnreserved);
+    }
+};
+
+//! Prefix of the cached results of findMetaDExCancel(), which is not used by stored keys
+const std::string CANCEL_LOOKUP_PREFIX = "#cancel-";
+
+/** Returns whether a key belongs to the sub record of a MetaDEx cancel, stored as "<txid>-C<number>". */
+bool IsCancelSubRecordKey(const leveldb::Slice& key)
+{
+    return key.size() > 66 && key[64] == '-' && key[65] == 'C';
+}
+}
+
+/**
+ * Adds the height and type index entries of a record to a batch.
+ *
+ * If the record overwrites one of another block or type, the stale entries of the previous record are removed.
+ */
+static void IndexRecord(leveldb::WriteBatch& batch, const std::string& recordKey, const std::string& prevValue, int block, unsigned int type, unsigned int idx = 0)
+{
+    TxRecord prev;
+    if (!prevValue.empty() && DecodeDBValue(prevValue, prev)) {
+        if (prev.block != block) batch.Delete(HeightIndexKey(prev.block, recordKey));
+        if ((prev.type != type || prev.block != block) && IsTypeIndexed(prev.type)) {
+            batch.Delete(TypeIndexKey(prev.type, prev.block, recordKey));
+        }
+    }
+
+    unsigned char buf[sizeof(uint32_t)];
+    WriteBE32(buf, type);
+    batch.Put(HeightIndexKey(block, recordKey), leveldb::Slice(reinterpret_cast<const char*>(buf), sizeof(buf)));
+    if (IsTypeIndexed(type)) {
+        WriteBE32(buf, idx);
+        batch.Put(TypeIndexKey(type, block, recordKey), leveldb::Slice(reinterpret_cast<const char*>(buf), sizeof(buf)));
+    }
+}
+
+/** Returns whether a key belongs to the record of a transaction, and not to a sub record or index. */
+static bool IsTxRecordKey(const leveldb::Slice& key)
+{
+    return key.size() == 64;
+}
+
 CMPTxList::CMPTxList(const fs::path& path, bool fWipe)
 {
-    leveldb::Status status = Open(path, fWipe);
+    // the found cancels are cached, until a sub record of a cancel is written
+    EnableReadCache(TXLIST_READ_CACHE_SIZE);
+    GetReadCache()->AddDependency(IsCancelSubRecordKey, CANCEL_LOOKUP_PREFIX);
+
+    leveldb::Status status = Open(path, fWipe, true);
     PrintToConsole("Loading tx meta-info database: %s\n", status.ToString());
+    if (status.ok()) LoadTxidFilter();
 }
 
 CMPTxList::~CMPTxList()
 {
-    if (msc_debug_persistence) PrintToLog("CMPTxList closed\n");
+    PrintToLogVerbose(msc_debug_persistence, "CMPTxList closed\n");
+}
+
+/**
+ * Rebuilds the txid filter from the transaction records.
+ *
+ * The filter is sized for twice the number of records, so it's rebuilt rarely.
+ */
+void CMPTxList::LoadTxidFilter()
+{
+    int64_t nTimeStart = GetTimeMicros();
+    std::vector<uint256> vTxids;
+
+    leveldb::Iterator* it = NewIterator();
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (IsTxRecordKey(it->key())) {
+            vTxids.push_back(uint256S(it->key().ToString()));
+        }
+    }
+    delete it;
+
+    LOCK(m_filter_mutex);
+    m_filter.Reset(std::max(2 * vTxids.size(), MIN_TXID_FILTER_CAPACITY));
+    for (const uint256& txid : vTxids) {
+        m_filter.Insert(txid);
+    }
+    PrintToLog("Loaded txid filter with %d transactions, capacity %d, in %.3f s\n",
+            vTxids.size(), m_filter.GetCapacity(), 0.000001 * (GetTimeMicros() - nTimeStart));
+}
+
+/**
+ * Adds a recorded transaction to the txid filter.
+ */
+void CMPTxList::AddToTxidFilter(const uint256& txid)
+{
+    {
+        LOCK(m_filter_mutex);
+        m_filter.Insert(txid);
+        if (!m_filter.IsFull()) return;
+    }
+    LoadTxidFilter();
+}
+
+/**
+ * Adds the applied transaction records to the txid filter.
+ *
+ * Deleted records stay in the filter, which only answers negative lookups.
+ */
+void CMPTxList::OnWritesApplied(const std::vector<CDBWrite>& vWrites)
+{
+    for (const CDBWrite& write : vWrites) {
+        if (write.second && IsTxRecordKey(write.first)) {
+            AddToTxidFilter(uint256S(write.first));
+        }
+    }
+}
+
+/**
+ * Deletes all entries of the database, and resets the txid filter.
+ */
+void CMPTxList::Clear()
+{
+    CDBBase::Clear();
+    LoadTxidFilter();
 }
 
-void CMPTxList::recordTX(const uint256 &txid, bool fValid, int nBlock, unsigned int type, uint64_t nValue)
+void CMPTxList::recordTX(const uint256 &txid, bool fValid, int nBlock, unsigned int type, uint64_t nValue, unsigned int nIdx)
 {
     if (!pdb) return;
 
+    const std::string key = txid.ToString();
+    const std::string value = EncodeDBValue(TxRecord(fValid, nBlock, type, nValue));
+
     // overwrite detection, we should never be overwriting a tx, as that means we have redone something a second time
     // reorgs delete all txs from levelDB above reorg_chain_height
-    if (exists(txid)) PrintToLog("LEVELDB TX OVERWRITE DETECTION - %s\n", txid.ToString());
-
-    const std::string key = txid.ToString();
-    const std::string value = strprintf("%u:%d:%u:%lu", fValid ? 1 : 0, nBlock, type, nValue);
-    leveldb::Status status;
+    std::string prevValue;
+    if (pdb->Get(readoptions, key, &prevValue).ok()) PrintToLog("LEVELDB TX OVERWRITE DETECTION - %s\n", txid.ToString());
 
     PrintToLog("%s(%s, valid=%s, block= %d, type= %d, value= %lu)\n",
             __func__, txid.ToString(), fValid ? "YES" : "NO", nBlock, type, nValue);
 
-    status = pdb->Put(writeoptions, key, value);
+    // the record and its entries in the height and type index are written together
+    leveldb::WriteBatch batch;
+    batch.Put(key, value);
+    IndexRecord(batch, key, prevValue, nBlock, type, nIdx);
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
     ++nWritten;
+    AddToTxidFilter(txid);
 }
 
 void CMPTxList::recordPaymentTX(const uint256& txid, bool fValid, int nBlock, unsigned int vout, unsigned int propertyId, uint64_t nValue, std::string buyer, std::string seller)
@@ -84,84 +389,93 @@ void CMPTxList::recordPaymentTX(const uint256& txid, bool fValid, int nBlock, un
     uint64_t existingNumberOfPayments = 0;
 
     // Step 1 - Check TXList to see if this payment TXID exists
-    bool paymentEntryExists = exists(txid);
+    const std::string key = txid.ToString();
+    std::string strValue;
+    bool paymentEntryExists = pdb->Get(readoptions, key, &strValue).ok();
 
     // Step 2a - If doesn't exist leave number of payments & paymentNumber set to 1
     // Step 2b - If does exist add +1 to existing number of payments and set this paymentNumber as new numberOfPayments
     if (paymentEntryExists) {
         //retrieve old numberOfPayments
-        std::vector<std::string> vstr;
-        std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, txid.ToString(), &strValue);
-        if (status.ok()) {
-            // parse the string returned
-            boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-
-            // obtain the existing number of payments
-            if (4 <= vstr.size()) {
-                existingNumberOfPayments = atoi(vstr[3]);
-                paymentNumber = existingNumberOfPayments + 1;
-                numberOfPayments = existingNumberOfPayments + 1;
-            }
+        TxRecord record;
+        if (DecodeDBValue(strValue, record)) {
+            existingNumberOfPayments = record.value;
+            paymentNumber = existingNumberOfPayments + 1;
+            numberOfPayments = existingNumberOfPayments + 1;
         }
     }
 
+    leveldb::WriteBatch batch;
+
     // Step 3 - Create new/update master record for payment tx in TXList
-    const std::string key = txid.ToString();
-    const std::string value = strprintf("%u:%d:%u:%lu", fValid ? 1 : 0, nBlock, type, numberOfPayments);
-    leveldb::Status status;
+    const std::string value = EncodeDBValue(TxRecord(fValid, nBlock, type, numberOfPayments));
     PrintToLog("DEXPAYDEBUG : Writing master record %s(%s, valid=%s, block= %d, type= %d, number of payments= %lu)\n", __func__, txid.ToString(), fValid ? "YES" : "NO", nBlock, type, numberOfPayments);
-    status = pdb->Put(writeoptions, key, value);
+    batch.Put(key, value);
+    IndexRecord(batch, key, strValue, nBlock, type);
 
     // Step 4 - Write sub-record with payment details
-    const std::string txidStr = txid.ToString();
-    const std::string subKey = STR_PAYMENT_SUBKEY_TXID_PAYMENT_COMBO(txidStr, paymentNumber);
-    const std::string subValue = strprintf("%d:%s:%s:%d:%lu", vout, buyer, seller, propertyId, nValue);
-    leveldb::Status subStatus;
-    PrintToLog("DEXPAYDEBUG : Writing sub-record %s with value %s\n", subKey, subValue);
-    subStatus = pdb->Put(writeoptions, subKey, subValue);
+    const std::string subKey = STR_PAYMENT_SUBKEY_TXID_PAYMENT_COMBO(key, paymentNumber);
+    PaymentRecord payment;
+    payment.vout = vout;
+    payment.buyer = buyer;
+    payment.seller = seller;
+    payment.propertyId = propertyId;
+    payment.amount = nValue;
+    PrintToLog("DEXPAYDEBUG : Writing sub-record %s with value %d:%s:%s:%d:%lu\n", subKey, vout, buyer, seller, propertyId, nValue);
+    batch.Put(subKey, EncodeDBValue(payment));
+
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    ++nWritten;
+    if (!paymentEntryExists) AddToTxidFilter(txid);
 }
 
-void CMPTxList::recordMetaDExCancelTX(const uint256& txidMaster, const uint256& txidSub, bool fValid, int nBlock, unsigned int propertyId, uint64_t nValue)
+/**
+ * Records a MetaDEx cancel transaction and the orders it cancelled.
+ *
+ * The master record and one sub-record per cancelled order are written with a single batch.
+ */
+void CMPTxList::recordMetaDExCancelTX(const uint256& txidMaster, bool fValid, int nBlock, const std::vector<CMPMetaDEx>& vCancelled)
 {
-    if (!pdb) return;
+    if (!pdb || vCancelled.empty()) return;
 
     // Prep - setup vars
     unsigned int type = 99992104;
-    unsigned int refNumber = 1;
-    uint64_t existingAffectedTXCount = 0;
+    unsigned int refNumber = 0;
     std::string txidMasterStr = txidMaster.ToString() + "-C";
 
     // Step 1 - Check TXList to see if this cancel TXID exists
-    // Step 2a - If doesn't exist leave number of affected txs & ref set to 1
-    // Step 2b - If does exist add +1 to existing ref and set this ref as new number of affected
-    std::vector<std::string> vstr;
+    // Step 2a - If doesn't exist the sub-records are numbered from 1
+    // Step 2b - If does exist the sub-records are numbered after the existing ones
     std::string strValue;
     leveldb::Status status = pdb->Get(readoptions, txidMasterStr, &strValue);
-    if (status.ok()) {
-        // parse the string returned
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-
+    TxRecord record;
+    if (status.ok() && DecodeDBValue(strValue, record)) {
         // obtain the existing affected tx count
-        if (4 <= vstr.size()) {
-            existingAffectedTXCount = atoi(vstr[3]);
-            refNumber = existingAffectedTXCount + 1;
-        }
+        refNumber = record.value;
+    }
+
+    leveldb::WriteBatch batch;
+
+    // Step 3 - Write sub-records with cancel details
+    for (const CMPMetaDEx& order : vCancelled) {
+        ++refNumber;
+        const std::string subKey = STR_REF_SUBKEY_TXID_REF_COMBO(txidMasterStr, refNumber);
+        CancelRecord cancel;
+        cancel.txid = order.getHash();
+        cancel.propertyId = order.getProperty();
+        cancel.amountUnreserved = order.getAmountRemaining();
+        PrintToLog("METADEXCANCELDEBUG : Writing sub-record %s with value %s:%d:%lu\n", subKey, cancel.txid.ToString(), cancel.propertyId, cancel.amountUnreserved);
+        batch.Put(subKey, EncodeDBValue(cancel));
     }
 
-    // Step 3 - Create new/update master record for cancel tx in TXList
-    const std::string key = txidMasterStr;
-    const std::string value = strprintf("%u:%d:%u:%lu", fValid ? 1 : 0, nBlock, type, refNumber);
+    // Step 4 - Create new/update master record for cancel tx in TXList
+    const std::string value = EncodeDBValue(TxRecord(fValid, nBlock, type, refNumber));
     PrintToLog("METADEXCANCELDEBUG : Writing master record %s(%s, valid=%s, block= %d, type= %d, number of affected transactions= %d)\n", __func__, txidMaster.ToString(), fValid ? "YES" : "NO", nBlock, type, refNumber);
-    status = pdb->Put(writeoptions, key, value);
+    batch.Put(txidMasterStr, value);
+    IndexRecord(batch, txidMasterStr, strValue, nBlock, type);
 
-    // Step 4 - Write sub-record with cancel details
-    const std::string txidStr = txidMaster.ToString() + "-C";
-    const std::string subKey = STR_REF_SUBKEY_TXID_REF_COMBO(txidStr, refNumber);
-    const std::string subValue = strprintf("%s:%d:%lu", txidSub.ToString(), propertyId, nValue);
-    PrintToLog("METADEXCANCELDEBUG : Writing sub-record %s with value %s\n", subKey, subValue);
-    status = pdb->Put(writeoptions, subKey, subValue);
-    if (msc_debug_txdb) PrintToLog("%s(): store: %s=%s, status: %s\n", __func__, subKey, subValue, status.ToString());
+    status = pdb->Write(writeoptions, &batch);
+    PrintToLogVerbose(msc_debug_txdb, "%s(): store: %d sub-records of %s, status: %s\n", __func__, vCancelled.size(), txidMasterStr, status.ToString());
 }
 
 
@@ -171,50 +485,49 @@ void CMPTxList::recordMetaDExCancelTX(const uint256& txidMaster, const uint256&
 void CMPTxList::recordSendAllSubRecord(const uint256& txid, int subRecordNumber, uint32_t propertyId, int64_t nValue)
 {
     std::string strKey = strprintf("%s-%d", txid.ToString(), subRecordNumber);
-    std::string strValue = strprintf("%d:%d", propertyId, nValue);
 
-    leveldb::Status status = pdb->Put(writeoptions, strKey, strValue);
+    leveldb::Status status = pdb->Put(writeoptions, strKey, EncodeDBValue(std::make_pair(propertyId, nValue)));
     ++nWritten;
-    if (msc_debug_txdb) PrintToLog("%s(): store: %s=%s, status: %s\n", __func__, strKey, strValue, status.ToString());
+    PrintToLogVerbose(msc_debug_txdb, "%s(): store: %s=%d:%d, status: %s\n", __func__, strKey, propertyId, nValue, status.ToString());
 }
 
 
-std::string CMPTxList::getKeyValue(std::string key)
-{
-    if (!pdb) return "";
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, key, &strValue);
-    if (status.ok()) {
-        return strValue;
-    } else {
-        return "";
-    }
-}
-
 uint256 CMPTxList::findMetaDExCancel(const uint256 txid)
 {
-    std::vector<std::string> vstr;
-    std::string txidStr = txid.ToString();
-    leveldb::Slice skey, svalue;
+    // the whole list is scanned, so the result is cached under a key, which isn't stored
     uint256 cancelTxid;
-    leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
-        std::string svalueStr = svalue.ToString();
-        boost::split(vstr, svalueStr, boost::is_any_of(":"), boost::token_compress_on);
-        // obtain the existing affected tx count
-        if (3 <= vstr.size()) {
-            if (vstr[0] == txidStr) {
-                delete it;
-                cancelTxid.SetHex(skey.ToString());
-                return cancelTxid;
+    ReadThrough<uint256>(CANCEL_LOOKUP_PREFIX + txid.ToString(), cancelTxid, [this, &txid](uint256& result) {
+        result.SetNull();
+        leveldb::Iterator* it = NewIterator();
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            const leveldb::Slice& skey = it->key();
+            if (!IsCancelSubRecordKey(skey)) continue;
+            CancelRecord cancel;
+            if (DecodeDBValue(it->value(), cancel) && cancel.txid == txid) {
+                result = uint256S(std::string(skey.data(), 64));
+                break;
             }
         }
-    }
+        delete it;
+        return leveldb::Status::OK();
+    });
+    return cancelTxid;
+}
 
-    delete it;
-    return uint256();
+/**
+ * Retrieves details about an order cancelled by a MetaDEx cancel.
+ */
+bool CMPTxList::getMetaDExCancelDetails(const uint256& txid, int refNumber, uint256& orderTxid, uint32_t& propertyId, int64_t& amountUnreserved)
+{
+    if (!pdb) return false;
+    std::string strValue;
+    leveldb::Status status = pdb->Get(readoptions, STR_REF_SUBKEY_TXID_REF_COMBO(txid.ToString() + "-C", refNumber), &strValue);
+    CancelRecord cancel;
+    if (!status.ok() || !DecodeDBValue(strValue, cancel)) return false;
+    orderTxid = cancel.txid;
+    propertyId = cancel.propertyId;
+    amountUnreserved = cancel.amountUnreserved;
+    return true;
 }
 
 /**
@@ -222,57 +535,41 @@ uint256 CMPTxList::findMetaDExCancel(const uint256 txid)
  */
 int CMPTxList::getNumberOfSubRecords(const uint256& txid)
 {
-    int numberOfSubRecords = 0;
-
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString(), &strValue);
-    if (status.ok()) {
-        std::vector<std::string> vstr;
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 <= vstr.size()) {
-            numberOfSubRecords = boost::lexical_cast<int>(vstr[3]);
-        }
+    TxRecord record;
+    if (CachedGet(txid.ToString(), record).ok()) {
+        return record.value;
     }
 
-    return numberOfSubRecords;
+    return 0;
 }
 
 int CMPTxList::getNumberOfMetaDExCancels(const uint256 txid)
 {
     if (!pdb) return 0;
-    int numberOfCancels = 0;
-    std::vector<std::string> vstr;
     std::string strValue;
     leveldb::Status status = pdb->Get(readoptions, txid.ToString() + "-C", &strValue);
-    if (status.ok()) {
-        // parse the string returned
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
+    TxRecord record;
+    if (status.ok() && DecodeDBValue(strValue, record)) {
         // obtain the number of cancels
-        if (4 <= vstr.size()) {
-            numberOfCancels = atoi(vstr[3]);
-        }
+        return record.value;
     }
-    return numberOfCancels;
+    return 0;
 }
 
 bool CMPTxList::getPurchaseDetails(const uint256 txid, int purchaseNumber, std::string* buyer, std::string* seller, uint64_t* vout, uint64_t* propertyId, uint64_t* nValue)
 {
     if (!pdb) return 0;
-    std::vector<std::string> vstr;
     std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString() + "-" + std::to_string(purchaseNumber), &strValue);
-    if (status.ok()) {
-        // parse the string returned
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
+    leveldb::Status status = pdb->Get(readoptions, STR_PAYMENT_SUBKEY_TXID_PAYMENT_COMBO(txid.ToString(), purchaseNumber), &strValue);
+    PaymentRecord payment;
+    if (status.ok() && DecodeDBValue(strValue, payment)) {
         // obtain the requisite details
-        if (5 == vstr.size()) {
-            *vout = atoi(vstr[0]);
-            *buyer = vstr[1];
-            *seller = vstr[2];
-            *propertyId = atoi64(vstr[3]);
-            *nValue = boost::lexical_cast<boost::uint64_t>(vstr[4]);
-            return true;
-        }
+        *vout = payment.vout;
+        *buyer = payment.buyer;
+        *seller = payment.seller;
+        *propertyId = payment.propertyId;
+        *nValue = payment.amount;
+        return true;
     }
     return false;
 }
@@ -285,14 +582,11 @@ bool CMPTxList::getSendAllDetails(const uint256& txid, int subSend, uint32_t& pr
     std::string strKey = strprintf("%s-%d", txid.ToString(), subSend);
     std::string strValue;
     leveldb::Status status = pdb->Get(readoptions, strKey, &strValue);
-    if (status.ok()) {
-        std::vector<std::string> vstr;
-        boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (2 == vstr.size()) {
-            propertyId = boost::lexical_cast<uint32_t>(vstr[0]);
-            amount = boost::lexical_cast<int64_t>(vstr[1]);
-            return true;
-        }
+    std::pair<uint32_t, int64_t> subRecord;
+    if (status.ok() && DecodeDBValue(strValue, subRecord)) {
+        propertyId = subRecord.first;
+        amount = subRecord.second;
+        return true;
     }
     return false;
 }
@@ -300,11 +594,9 @@ bool CMPTxList::getSendAllDetails(const uint256& txid, int subSend, uint32_t& pr
 int CMPTxList::getMPTransactionCountTotal()
 {
     int count = 0;
-    leveldb::Slice skey, svalue;
     leveldb::Iterator* it = NewIterator();
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        if (skey.ToString().length() == 64) {
+        if (IsTxRecordKey(it->key())) {
             ++count;
         } //extra entries for cancels and purchases are more than 64 chars long
     }
@@ -315,21 +607,12 @@ int CMPTxList::getMPTransactionCountTotal()
 int CMPTxList::getMPTransactionCountBlock(int block)
 {
     int count = 0;
-    leveldb::Slice skey, svalue;
+    const std::string prefix = HeightIndexPrefix(block);
     leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
-        if (skey.ToString().length() == 64) {
-            std::string strValue = svalue.ToString();
-            std::vector<std::string> vstr;
-            boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-            if (4 == vstr.size()) {
-                if (atoi(vstr[1]) == block) {
-                    ++count;
-                }
-            }
-        }
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        if (it->key().size() == HEIGHT_INDEX_PREFIX_SIZE + 64) {
+            ++count;
+        } //extra entries for cancels are more than 64 chars long
     }
     delete it;
     return count;
@@ -340,22 +623,12 @@ int CMPTxList::GetOmniTxsInBlockRange(int blockFirst, int blockLast, std::set<ui
 {
     int count = 0;
     leveldb::Iterator* it = NewIterator();
-    
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        const leveldb::Slice& sKey = it->key();
-        const leveldb::Slice& sValue = it->value();
-
-        if (sKey.ToString().length() == 64) {
-            const std::string& strValue = sValue.ToString();
-            std::vector<std::string> vStr;
-            boost::split(vStr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-            if (4 == vStr.size()) {
-                int blockCurrent = atoi(vStr[1]);
-                if (blockCurrent >= blockFirst && blockCurrent <= blockLast) {
-                    retTxs.insert(uint256S(sKey.ToString()));                    
-                    ++count;
-                }
-            }
+
+    for (it->Seek(HeightIndexPrefix(blockFirst)); it->Valid() && IsHeightIndexKey(it->key()); it->Next()) {
+        if (HeightIndexBlock(it->key()) > blockLast) break;
+        if (it->key().size() == HEIGHT_INDEX_PREFIX_SIZE + 64) {
+            retTxs.insert(uint256S(HeightIndexRecordKey(it->key())));
+            ++count;
         }
     }
 
@@ -363,6 +636,23 @@ int CMPTxList::GetOmniTxsInBlockRange(int blockFirst, int blockLast, std::set<ui
     return count;
 }
 
+std::vector<CMPTxList::BlockTx> CMPTxList::GetTxsInBlockRange(int blockFirst, int blockLast)
+{
+    std::vector<BlockTx> vTxs;
+    leveldb::Iterator* it = NewIterator();
+
+    for (it->Seek(HeightIndexPrefix(blockFirst)); it->Valid() && IsHeightIndexKey(it->key()); it->Next()) {
+        int block = HeightIndexBlock(it->key());
+        if (block > blockLast) break;
+        if (it->key().size() != HEIGHT_INDEX_PREFIX_SIZE + 64 || it->value().size() != sizeof(uint32_t)) continue;
+        uint32_t type = ReadBE32(reinterpret_cast<const unsigned char*>(it->value().data()));
+        vTxs.push_back(BlockTx{block, type, uint256S(HeightIndexRecordKey(it->key()))});
+    }
+
+    delete it;
+    return vTxs;
+}
+
 /*
  * Gets the DB version from txlistdb
  *
@@ -378,7 +668,7 @@ int CMPTxList::getDBVersion()
         verDB = boost::lexical_cast<uint64_t>(strValue);
     }
 
-    if (msc_debug_txdb) PrintToLog("%s(): dbversion %s status %s, line %d, file: %s\n", __func__, strValue, status.ToString(), __LINE__, __FILE__);
+    PrintToLogVerbose(msc_debug_txdb, "%s(): dbversion %s status %s, line %d, file: %s\n", __func__, strValue, status.ToString(), __LINE__, __FILE__);
 
     return verDB;
 }
@@ -393,22 +683,42 @@ int CMPTxList::setDBVersion()
     std::string verStr = boost::lexical_cast<std::string>(DB_VERSION);
     leveldb::Status status = pdb->Put(writeoptions, "dbversion", verStr);
 
-    if (msc_debug_txdb) PrintToLog("%s(): dbversion %s status %s, line %d, file: %s\n", __func__, verStr, status.ToString(), __LINE__, __FILE__);
+    PrintToLogVerbose(msc_debug_txdb, "%s(): dbversion %s status %s, line %d, file: %s\n", __func__, verStr, status.ToString(), __LINE__, __FILE__);
 
     return getDBVersion();
 }
 
+/*
+ * Gets the properties, whose history was indexed, when the databases were built
+ *
+ * Returns an empty string, if all properties were indexed
+ */
+std::string CMPTxList::getIndexProperties()
+{
+    std::string strValue;
+    leveldb::Status status = pdb->Get(readoptions, "indexproperties", &strValue);
+
+    PrintToLogVerbose(msc_debug_txdb, "%s(): indexproperties %s status %s\n", __func__, strValue, status.ToString());
+
+    return strValue;
+}
+
+/*
+ * Sets the properties, whose history is indexed, or an empty string for all properties
+ */
+void CMPTxList::setIndexProperties(const std::string& strProperties)
+{
+    leveldb::Status status = strProperties.empty() ? pdb->Delete(writeoptions, "indexproperties") : pdb->Put(writeoptions, "indexproperties", strProperties);
+
+    PrintToLogVerbose(msc_debug_txdb, "%s(): indexproperties %s status %s\n", __func__, strProperties, status.ToString());
+}
+
 std::pair<int64_t,int64_t> CMPTxList::GetNonFungibleGrant(const uint256& txid)
 {
     std::string strKey = strprintf("%s-UG", txid.ToString());
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, strKey, &strValue);
-    if (status.ok()) {
-        std::vector<std::string> vstr;
-        boost::split(vstr, strValue, boost::is_any_of("-"), boost::token_compress_on);
-        if (2 == vstr.size()) {
-            return std::make_pair(boost::lexical_cast<int64_t>(vstr[0]), boost::lexical_cast<int64_t>(vstr[1]));
-        }
+    std::pair<int64_t,int64_t> grantedRange;
+    if (CachedGet(strKey, grantedRange).ok()) {
+        return grantedRange;
     }
     return std::make_pair(0,0);
 }
@@ -418,7 +728,7 @@ void CMPTxList::RecordNonFungibleGrant(const uint256& txid, int64_t start, int64
     assert(pdb);
 
     const std::string key = txid.ToString() + "-UG";
-    const std::string value = strprintf("%d-%d", start, end);
+    const std::string value = EncodeDBValue(std::make_pair(start, end));
 
     leveldb::Status status = pdb->Put(writeoptions, key, value);
     PrintToLog("%s(): Writing Non-Fungible Grant range %s:%d-%d (%s), line %d, file: %s\n", __FUNCTION__, key, start, end, status.ToString(), __LINE__, __FILE__);
@@ -427,9 +737,13 @@ void CMPTxList::RecordNonFungibleGrant(const uint256& txid, int64_t start, int64
 bool CMPTxList::exists(const uint256 &txid)
 {
     if (!pdb) return false;
+    {
+        LOCK(m_filter_mutex);
+        if (!m_filter.MayContain(txid)) return false;
+    }
 
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString(), &strValue);
+    TxRecord record;
+    leveldb::Status status = CachedGet(txid.ToString(), record);
 
     if (!status.ok()) {
         if (status.IsNotFound()) return false;
@@ -438,18 +752,6 @@ bool CMPTxList::exists(const uint256 &txid)
     return true;
 }
 
-bool CMPTxList::getTX(const uint256 &txid, std::string& value)
-{
-    leveldb::Status status = pdb->Get(readoptions, txid.ToString(), &value);
-    ++nRead;
-
-    if (status.ok()) {
-        return true;
-    }
-
-    return false;
-}
-
 // call it like so (variable # of parameters):
 // int block = 0;
 // ...
@@ -459,43 +761,29 @@ bool CMPTxList::getTX(const uint256 &txid, std::string& value)
 //
 bool CMPTxList::getValidMPTX(const uint256& txid, int* block, unsigned int* type, uint64_t* nAmended)
 {
-    std::string result;
-    int validity = 0;
-
-    if (msc_debug_txdb) PrintToLog("%s()\n", __func__);
+    PrintToLogVerbose(msc_debug_txdb, "%s()\n", __func__);
 
     if (!pdb) return false;
-
-    if (!getTX(txid, result)) return false;
-
-    // parse the string returned, find the validity flag/bit & other parameters
-    std::vector<std::string> vstr;
-    boost::split(vstr, result, boost::is_any_of(":"), boost::token_compress_on);
-
-    if (msc_debug_txdb) PrintToLog("%s() size=%lu : %s\n", __func__, vstr.size(), result);
-
-    if (1 <= vstr.size()) validity = atoi(vstr[0]);
-
-    if (block) {
-        if (2 <= vstr.size()) *block = atoi(vstr[1]);
-        else *block = 0;
+    {
+        LOCK(m_filter_mutex);
+        if (!m_filter.MayContain(txid)) return false;
     }
 
-    if (type) {
-        if (3 <= vstr.size()) *type = atoi(vstr[2]);
-        else *type = 0;
+    // decode the record, find the validity flag/bit & other parameters
+    TxRecord record;
+    leveldb::Status status = CachedGet(txid.ToString(), record);
+    if (status.IsCorruption()) {
+        PrintToLog("%s(): failed to decode record of %s\n", __func__, txid.ToString());
     }
+    if (!status.ok()) return false;
 
-    if (nAmended) {
-        if (4 <= vstr.size()) *nAmended = boost::lexical_cast<boost::uint64_t>(vstr[3]);
-        else nAmended = 0;
-    }
+    if (block) *block = record.block;
+    if (type) *type = record.type;
+    if (nAmended) *nAmended = record.value;
 
     if (msc_debug_txdb) printStats();
 
-    if ((int) 0 == validity) return false;
-
-    return true;
+    return record.fValid;
 }
 
 std::set<int> CMPTxList::GetSeedBlocks(int startHeight, int endHeight)
@@ -506,15 +794,12 @@ std::set<int> CMPTxList::GetSeedBlocks(int startHeight, int endHeight)
 
     leveldb::Iterator* it = NewIterator();
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue; // unexpected number of tokens
-        int block = atoi(vstr[1]);
-        if (block >= startHeight && block <= endHeight) {
-            setSeedBlocks.insert(block);
-        }
+    // one seek per block with transactions, skipping the other records of the block
+    for (it->Seek(HeightIndexPrefix(startHeight)); it->Valid() && IsHeightIndexKey(it->key()); ) {
+        int block = HeightIndexBlock(it->key());
+        if (block > endHeight) break;
+        setSeedBlocks.insert(block);
+        it->Seek(HeightIndexPrefix(block + 1));
     }
 
     delete it;
@@ -522,32 +807,85 @@ std::set<int> CMPTxList::GetSeedBlocks(int startHeight, int endHeight)
     return setSeedBlocks;
 }
 
-void CMPTxList::LoadAlerts(int blockHeight)
+/**
+ * Returns the valid transactions of the given types in chain order, via the type index.
+ */
+std::vector<CMPTxList::PositionedTx> CMPTxList::GetValidTxsOfTypes(const std::vector<uint32_t>& vTypes)
 {
-    if (!pdb) return;
-    leveldb::Slice skey, svalue;
+    const size_t nKeyOffset = TYPE_INDEX_PREFIX_SIZE + sizeof(uint32_t);
+    std::vector<PositionedTx> vTxs;
     leveldb::Iterator* it = NewIterator();
 
-    std::vector<std::pair<int64_t, uint256> > loadOrder;
+    for (uint32_t type : vTypes) {
+        assert(IsTypeIndexed(type));
+        const std::string prefix = TypeIndexPrefix(type);
+        for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+            if (it->key().size() <= nKeyOffset || it->value().size() != sizeof(uint32_t)) continue;
+            const std::string recordKey(it->key().data() + nKeyOffset, it->key().size() - nKeyOffset);
+            std::string strValue;
+            TxRecord record;
+            if (!pdb->Get(readoptions, recordKey, &strValue).ok() || !DecodeDBValue(strValue, record)) continue;
+            ++nRead;
+            if (record.type != type || !record.fValid) continue;
+            PositionedTx tx;
+            tx.block = record.block;
+            tx.idx = ReadBE32(reinterpret_cast<const unsigned char*>(it->value().data()));
+            tx.txid = uint256S(recordKey);
+            vTxs.push_back(tx);
+        }
+    }
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue; // unexpected number of tokens
-        if (atoi(vstr[2]) != OMNICORE_MESSAGE_TYPE_ALERT || atoi(vstr[0]) != 1) continue; // not a valid alert
-        uint256 txid = uint256S(it->key().ToString());
-        loadOrder.push_back(std::make_pair(atoi(vstr[1]), txid));
+    delete it;
+
+    std::sort(vTxs.begin(), vTxs.end());
+    return vTxs;
+}
+
+/**
+ * Retrieves a transaction, which is loaded to restore the state, and the hash of its block.
+ *
+ * The fields recorded, when the transaction was processed, are used, if available, so neither
+ * the transaction index nor the block is needed, see -omniprune. Transactions without record
+ * are retrieved from the blockchain.
+ */
+static bool FetchLoadedTransaction(const uint256& txid, COmniTransactionDB::Record& record, CTransactionRef& tx, uint256& blockHash)
+{
+    if (pDbTransaction && pDbTransaction->FetchTransactionRecord(txid, record)) {
+        blockHash = record.blockHash;
+        return true;
     }
 
-    std::sort(loadOrder.begin(), loadOrder.end());
+    return GetTransaction(txid, tx, Params().GetConsensus(), blockHash);
+}
 
-    for (std::vector<std::pair<int64_t, uint256> >::iterator it = loadOrder.begin(); it != loadOrder.end(); ++it) {
-        uint256 txid = (*it).second;
+/**
+ * Decodes a transaction, which is loaded to restore the state, from its record, or by parsing it.
+ *
+ * @return 0, if the transaction was decoded
+ */
+static int DecodeLoadedTransaction(const uint256& txid, const COmniTransactionDB::Record& record, const CTransactionRef& tx, const CBlockIndex* pBlockIndex, int nParseBlock, CMPTransaction& mp_obj)
+{
+    if (!tx) {
+        record.Restore(mp_obj, txid, pBlockIndex->GetBlockTime());
+        return 0;
+    }
+
+    return ParseTransaction(*tx, nParseBlock, 0, mp_obj);
+}
+
+void CMPTxList::LoadAlerts(int blockHeight)
+{
+    if (!pdb) return;
+
+    const std::vector<PositionedTx> loadOrder = GetValidTxsOfTypes({OMNICORE_MESSAGE_TYPE_ALERT});
+
+    for (std::vector<PositionedTx>::const_iterator it = loadOrder.begin(); it != loadOrder.end(); ++it) {
+        uint256 txid = it->txid;
         uint256 blockHash;
         CTransactionRef wtx;
+        COmniTransactionDB::Record record;
         CMPTransaction mp_obj;
-        if (!GetTransaction(txid, wtx, Params().GetConsensus(), blockHash)) {
+        if (!FetchLoadedTransaction(txid, record, wtx, blockHash)) {
             PrintToLog("ERROR: While loading alert %s: tx in levelDB but does not exist.\n", txid.GetHex());
             continue;
         }
@@ -557,7 +895,7 @@ void CMPTxList::LoadAlerts(int blockHeight)
             // skipping, because it's in the future
             continue;
         }
-        if (0 != ParseTransaction(*wtx, blockHeight, 0, mp_obj)) {
+        if (0 != DecodeLoadedTransaction(txid, record, wtx, pBlockIndex, blockHeight, mp_obj)) {
             PrintToLog("ERROR: While loading alert %s: failed ParseTransaction.\n", txid.GetHex());
             continue;
         }
@@ -581,7 +919,6 @@ void CMPTxList::LoadAlerts(int blockHeight)
         }
     }
 
-    delete it;
     int64_t blockTime = 0;
     {
         LOCK(cs_main);
@@ -599,32 +936,19 @@ void CMPTxList::LoadActivations(int blockHeight)
 {
     if (!pdb) return;
 
-    leveldb::Slice skey, svalue;
-    leveldb::Iterator* it = NewIterator();
-
     PrintToLog("Loading feature activations from levelDB\n");
 
-    std::vector<std::pair<int64_t, uint256> > loadOrder;
-
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue; // unexpected number of tokens
-        if (atoi(vstr[2]) != OMNICORE_MESSAGE_TYPE_ACTIVATION || atoi(vstr[0]) != 1) continue; // we only care about valid activations
-        uint256 txid = uint256S(it->key().ToString());
-        loadOrder.push_back(std::make_pair(atoi(vstr[1]), txid));
-    }
-
-    std::sort(loadOrder.begin(), loadOrder.end());
+    // we only care about valid activations
+    const std::vector<PositionedTx> loadOrder = GetValidTxsOfTypes({OMNICORE_MESSAGE_TYPE_ACTIVATION});
 
-    for (std::vector<std::pair<int64_t, uint256> >::iterator it = loadOrder.begin(); it != loadOrder.end(); ++it) {
-        uint256 hash = (*it).second;
+    for (std::vector<PositionedTx>::const_iterator it = loadOrder.begin(); it != loadOrder.end(); ++it) {
+        uint256 hash = it->txid;
         uint256 blockHash;
         CTransactionRef wtx;
+        COmniTransactionDB::Record record;
         CMPTransaction mp_obj;
 
-        if (!GetTransaction(hash, wtx, Params().GetConsensus(), blockHash)) {
+        if (!FetchLoadedTransaction(hash, record, wtx, blockHash)) {
             PrintToLog("ERROR: While loading activation transaction %s: tx in levelDB but does not exist.\n", hash.GetHex());
             continue;
         }
@@ -642,7 +966,7 @@ void CMPTxList::LoadActivations(int blockHeight)
             // skipping, because it's in the future
             continue;
         }
-        if (0 != ParseTransaction(*wtx, currentBlockHeight, 0, mp_obj)) {
+        if (0 != DecodeLoadedTransaction(hash, record, wtx, pBlockIndex, currentBlockHeight, mp_obj)) {
             PrintToLog("ERROR: While loading activation transaction %s: failed ParseTransaction.\n", hash.GetHex());
             continue;
         }
@@ -660,7 +984,6 @@ void CMPTxList::LoadActivations(int blockHeight)
             continue;
         }
     }
-    delete it;
     CheckLiveActivations(blockHeight);
 
     // This alert never expires as long as custom activations are used
@@ -674,36 +997,20 @@ bool CMPTxList::LoadFreezeState(int blockHeight)
 {
     assert(pdb);
 
-    std::vector<std::pair<std::string, uint256> > loadOrder;
     int txnsLoaded = 0;
-    leveldb::Iterator* it = NewIterator();
     PrintToLog("Loading freeze state from levelDB\n");
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue;
-        uint16_t txtype = atoi(vstr[2]);
-        if (txtype != MSC_TYPE_FREEZE_PROPERTY_TOKENS && txtype != MSC_TYPE_UNFREEZE_PROPERTY_TOKENS &&
-                txtype != MSC_TYPE_ENABLE_FREEZING && txtype != MSC_TYPE_DISABLE_FREEZING) continue;
-        if (atoi(vstr[0]) != 1) continue; // invalid, ignore
-        uint256 txid = uint256S(it->key().ToString());
-        int txPosition = pDbTransaction->FetchTransactionPosition(txid);
-        std::string sortKey = strprintf("%06d%010d", atoi(vstr[1]), txPosition);
-        loadOrder.push_back(std::make_pair(sortKey, txid));
-    }
-
-    delete it;
-
-    std::sort(loadOrder.begin(), loadOrder.end());
+    // the type index provides the position in the block, so the transactions are applied in chain order
+    const std::vector<PositionedTx> loadOrder = GetValidTxsOfTypes({MSC_TYPE_FREEZE_PROPERTY_TOKENS,
+            MSC_TYPE_UNFREEZE_PROPERTY_TOKENS, MSC_TYPE_ENABLE_FREEZING, MSC_TYPE_DISABLE_FREEZING});
 
-    for (std::vector<std::pair<std::string, uint256> >::iterator it = loadOrder.begin(); it != loadOrder.end(); ++it) {
-        uint256 hash = (*it).second;
+    for (std::vector<PositionedTx>::const_iterator it = loadOrder.begin(); it != loadOrder.end(); ++it) {
+        uint256 hash = it->txid;
         uint256 blockHash;
         CTransactionRef wtx;
+        COmniTransactionDB::Record record;
         CMPTransaction mp_obj;
-        if (!GetTransaction(hash, wtx, Params().GetConsensus(), blockHash)) {
+        if (!FetchLoadedTransaction(hash, record, wtx, blockHash)) {
             PrintToLog("ERROR: While loading freeze transaction %s: tx in levelDB but does not exist.\n", hash.GetHex());
             return false;
         }
@@ -721,7 +1028,7 @@ bool CMPTxList::LoadFreezeState(int blockHeight)
             // skipping, because it's in the future
             continue;
         }
-        if (0 != ParseTransaction(*wtx, currentBlockHeight, 0, mp_obj)) {
+        if (0 != DecodeLoadedTransaction(hash, record, wtx, pBlockIndex, currentBlockHeight, mp_obj)) {
             PrintToLog("ERROR: While loading freeze transaction %s: failed ParseTransaction.\n", hash.GetHex());
             return false;
         }
@@ -754,24 +1061,19 @@ bool CMPTxList::CheckForFreezeTxs(int blockHeight)
     assert(pdb);
 
     leveldb::Iterator* it = NewIterator();
-
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue;
-        int block = atoi(vstr[1]);
-        if (block < blockHeight) continue;
-        uint16_t txtype = atoi(vstr[2]);
-        if (txtype == MSC_TYPE_FREEZE_PROPERTY_TOKENS || txtype == MSC_TYPE_UNFREEZE_PROPERTY_TOKENS ||
-                txtype == MSC_TYPE_ENABLE_FREEZING || txtype == MSC_TYPE_DISABLE_FREEZING) {
-            delete it;
-            return true;
+    bool fFound = false;
+
+    // one seek per type into the type index, which is ordered by block
+    for (uint32_t type : {MSC_TYPE_FREEZE_PROPERTY_TOKENS, MSC_TYPE_UNFREEZE_PROPERTY_TOKENS, MSC_TYPE_ENABLE_FREEZING, MSC_TYPE_DISABLE_FREEZING}) {
+        it->Seek(TypeIndexPrefix(type, blockHeight));
+        if (it->Valid() && it->key().starts_with(TypeIndexPrefix(type))) {
+            fFound = true;
+            break;
         }
     }
 
     delete it;
-    return false;
+    return fFound;
 }
 
 void CMPTxList::printStats()
@@ -789,51 +1091,154 @@ void CMPTxList::printAll()
         skey = it->key();
         svalue = it->value();
         ++count;
-        PrintToConsole("entry #%8d= %s:%s\n", count, skey.ToString(), svalue.ToString());
+        const bool fIndexKey = IsHeightIndexKey(skey) || IsTypeIndexKey(skey) || IsStateHashKey(skey);
+        PrintToConsole("entry #%8d= %s:%s\n", count, fIndexKey ? HexStr(skey.ToString()) : skey.ToString(), HexStr(svalue.ToString()));
     }
 
     delete it;
 }
 
+void CMPTxList::RecordStateHash(int nBlock, const uint256& blockHash, const uint256& stateHash)
+{
+    if (!pdb) return;
+
+    std::string value(blockHash.begin(), blockHash.end());
+    value.append(stateHash.begin(), stateHash.end());
+    leveldb::Status status = pdb->Put(writeoptions, StateHashKey(nBlock), value);
+    ++nWritten;
+    if (!status.ok()) PrintToLog("%s(): ERROR for block %d: %s\n", __func__, nBlock, status.ToString());
+}
+
+bool CMPTxList::GetStateHash(int nBlock, const uint256& blockHash, uint256& stateHash)
+{
+    if (!pdb) return false;
+
+    std::string value;
+    if (!pdb->Get(readoptions, StateHashKey(nBlock), &value).ok()) return false;
+    if (value.size() != 2 * sizeof(uint256) || memcmp(value.data(), blockHash.begin(), sizeof(uint256)) != 0) return false;
+
+    memcpy(stateHash.begin(), value.data() + sizeof(uint256), sizeof(uint256));
+    ++nRead;
+    return true;
+}
+
+void CMPTxList::DeleteStateHashes(int nBlock)
+{
+    if (!pdb) return;
+
+    leveldb::WriteBatch batch;
+    leveldb::Iterator* it = NewIterator();
+    for (it->Seek(StateHashKey(nBlock)); it->Valid() && IsStateHashKey(it->key()); it->Next()) {
+        batch.Delete(it->key());
+    }
+    delete it;
+
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    PrintToLogVerbose(msc_debug_txdb, "%s(%d): %s\n", __func__, nBlock, status.ToString());
+}
+
 // figure out if there was at least 1 Master Protocol transaction within the block range, or a block if starting equals ending
 // block numbers are inclusive
 // pass in bDeleteFound = true to erase each entry found within the block range
+// the txids of erased entries remain in the txid filter as false positives, until it's rebuilt
 bool CMPTxList::isMPinBlockRange(int starting_block, int ending_block, bool bDeleteFound)
 {
-    leveldb::Slice skey, svalue;
-    unsigned int count = 0;
-    std::vector<std::string> vstr;
-    int block;
     unsigned int n_found = 0;
+    leveldb::WriteBatch batch;
 
     leveldb::Iterator* it = NewIterator();
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        skey = it->key();
-        svalue = it->value();
-
-        ++count;
-
-        std::string strvalue = it->value().ToString();
-
-        // parse the string returned, find the validity flag/bit & other parameters
-        boost::split(vstr, strvalue, boost::is_any_of(":"), boost::token_compress_on);
+    for (it->Seek(HeightIndexPrefix(starting_block)); it->Valid() && IsHeightIndexKey(it->key()); it->Next()) {
+        if (HeightIndexBlock(it->key()) > ending_block) break;
 
-        // only care about the block number/height here
-        if (2 <= vstr.size()) {
-            block = atoi(vstr[1]);
+        ++n_found;
 
-            if ((starting_block <= block) && (block <= ending_block)) {
-                ++n_found;
-                PrintToLog("%s() DELETING: %s=%s\n", __func__, skey.ToString(), svalue.ToString());
-                if (bDeleteFound) pdb->Delete(writeoptions, skey);
+        const std::string recordKey = HeightIndexRecordKey(it->key());
+        PrintToLog("%s() DELETING: %s\n", __func__, recordKey);
+        if (bDeleteFound) {
+            batch.Delete(recordKey);
+            batch.Delete(it->key());
+            if (it->value().size() == sizeof(uint32_t)) {
+                uint32_t type = ReadBE32(reinterpret_cast<const unsigned char*>(it->value().data()));
+                if (IsTypeIndexed(type)) batch.Delete(TypeIndexKey(type, HeightIndexBlock(it->key()), recordKey));
             }
         }
     }
 
+    delete it;
+
+    if (bDeleteFound && n_found > 0) {
+        leveldb::Status status = pdb->Write(writeoptions, &batch);
+        PrintToLogVerbose(msc_debug_txdb, "%s(): erased %d records, status: %s\n", __func__, n_found, status.ToString());
+        ScheduleCompaction(batch);
+    }
+
     PrintToLog("%s(%d, %d); n_found= %d\n", __func__, starting_block, ending_block, n_found);
 
+    return (n_found);
+}
+
+/**
+ * Deletes the records below a block, along with their entries in the indexes and their sub-records.
+ *
+ * Records of governance and freeze transactions, which are loaded at startup, the records of the
+ * transactions in the given set, and the ranges awarded by grants of non-fungible tokens are kept.
+ * The block is stored with the deletions, and the txids of the pruned transactions are returned,
+ * so their entries in other databases can be deleted as well.
+ *
+ * The txids of deleted records remain in the txid filter as false positives, until it's rebuilt.
+ */
+int CMPTxList::PruneBelowBlock(int nBlock, const std::set<uint256>& setKeep, std::vector<uint256>& vPruned)
+{
+    assert(pdb);
+
+    int nPruned = 0;
+    leveldb::WriteBatch batch;
+    leveldb::Iterator* it = NewIterator();
+    leveldb::Iterator* itSub = NewIterator();
+
+    for (it->Seek(HeightIndexPrefix(0)); it->Valid() && IsHeightIndexKey(it->key()); it->Next()) {
+        const int block = HeightIndexBlock(it->key());
+        if (block >= nBlock) break;
+        if (it->value().size() != sizeof(uint32_t)) continue;
+
+        const uint32_t type = ReadBE32(reinterpret_cast<const unsigned char*>(it->value().data()));
+        const std::string recordKey = HeightIndexRecordKey(it->key());
+        const uint256 txid = uint256S(recordKey.substr(0, 64));
+        if (IsTypeIndexed(type) || setKeep.count(txid)) continue;
+
+        batch.Delete(recordKey);
+        batch.Delete(it->key());
+
+        // sub-records of payments, "send all" and MetaDEx cancels, but not the ranges of grants
+        const std::string prefix = txid.ToString() + "-";
+        for (itSub->Seek(prefix); itSub->Valid() && itSub->key().starts_with(prefix); itSub->Next()) {
+            if (itSub->key().ToString().compare(prefix.size(), std::string::npos, "UG") == 0) continue;
+            batch.Delete(itSub->key());
+        }
+
+        if (recordKey.size() == 64) vPruned.push_back(txid);
+        ++nPruned;
+    }
+
+    delete itSub;
     delete it;
 
-    return (n_found);
+    batch.Put("prunedheight", boost::lexical_cast<std::string>(nBlock));
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+    PrintToLogVerbose(msc_debug_txdb, "%s(%d): pruned %d records, status: %s\n", __func__, nBlock, nPruned, status.ToString());
+    if (nPruned > 0) ScheduleCompaction(batch);
+
+    return nPruned;
+}
+
+int CMPTxList::GetPrunedHeight()
+{
+    if (!pdb) return 0;
+
+    std::string strValue;
+    if (!pdb->Get(readoptions, "prunedheight", &strValue).ok()) return 0;
+
+    return boost::lexical_cast<int>(strValue);
 }
+
@@ -3,33 +3,80 @@
 
 #include <omnicore/dbbase.h>
 #include <omnicore/nftdb.h>
+#include <omnicore/txidfilter.h>
 
 #include <fs.h>
+#include <sync.h>
 #include <uint256.h>
 
 #include <stdint.h>
 
 #include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
-/** LevelDB based storage for transactions, with txid as key and validity bit, and other data as value.
+class CMPMetaDEx;
+
+//! Number of decoded transaction records and derived results, which are cached for repeated reads
+static const size_t TXLIST_READ_CACHE_SIZE = 10000;
+
+/** LevelDB based storage for transactions, with txid as key and validity bit, and other data as binary encoded value.
+ *
+ * The records are also indexed by block, so queries for block ranges and reorgs only visit the affected blocks.
+ * Lookups of transactions, which are not in the database, are answered by an in-memory filter of the txids.
  */
 class CMPTxList : public CDBBase
 {
+private:
+    mutable Mutex m_filter_mutex;
+    //! Filter of the txids of the transaction records, so negative lookups don't read the database
+    COmniTxidFilter m_filter GUARDED_BY(m_filter_mutex);
+
+    /** Rebuilds the txid filter from the transaction records, sized for growth. */
+    void LoadTxidFilter();
+    /** Adds a recorded transaction to the txid filter, and rebuilds it larger, when full. */
+    void AddToTxidFilter(const uint256& txid);
+    /** Adds the applied transaction records to the txid filter. */
+    void OnWritesApplied(const std::vector<CDBWrite>& vWrites) override;
+
 public:
+    /** A transaction with its position in the chain, ordered by block and position in the block. */
+    struct PositionedTx
+    {
+        int block;
+        uint32_t idx;
+        uint256 txid;
+
+        bool operator<(const PositionedTx& other) const
+        {
+            return block != other.block ? block < other.block : idx < other.idx;
+        }
+    };
+
+    /** A transaction of the height index, with its block and type. */
+    struct BlockTx
+    {
+        int block;
+        uint32_t type;
+        uint256 txid;
+    };
+
     CMPTxList(const fs::path& path, bool fWipe);
     virtual ~CMPTxList();
 
-    void recordTX(const uint256& txid, bool fValid, int nBlock, unsigned int type, uint64_t nValue);
+    void recordTX(const uint256& txid, bool fValid, int nBlock, unsigned int type, uint64_t nValue, unsigned int nIdx = 0);
     void recordPaymentTX(const uint256& txid, bool fValid, int nBlock, unsigned int vout, unsigned int propertyId, uint64_t nValue, std::string buyer, std::string seller);
-    void recordMetaDExCancelTX(const uint256 &txidMaster, const uint256& txidSub, bool fValid, int nBlock, unsigned int propertyId, uint64_t nValue);
+    /** Records a MetaDEx cancel transaction and the orders it cancelled with a single write. */
+    void recordMetaDExCancelTX(const uint256& txidMaster, bool fValid, int nBlock, const std::vector<CMPMetaDEx>& vCancelled);
     /** Records a "send all" sub record. */
     void recordSendAllSubRecord(const uint256& txid, int subRecordNumber, uint32_t propertyId, int64_t nvalue);
     /** Records the range awarded in a grant applied to a non-fungible property. */
     void RecordNonFungibleGrant(const uint256 &txid, int64_t start, int64_t end);
 
-    std::string getKeyValue(std::string key);
     uint256 findMetaDExCancel(const uint256 txid);
+    /** Retrieves details about an order cancelled by a MetaDEx cancel. */
+    bool getMetaDExCancelDetails(const uint256& txid, int refNumber, uint256& orderTxid, uint32_t& propertyId, int64_t& amountUnreserved);
     /** Returns the number of sub records. */
     int getNumberOfSubRecords(const uint256& txid);
     int getNumberOfMetaDExCancels(const uint256 txid);
@@ -40,27 +87,52 @@ public:
     std::pair<int64_t,int64_t> GetNonFungibleGrant(const uint256& txid);
 
     int getMPTransactionCountTotal();
+    /** Returns the number of Omni transactions in the given block. */
     int getMPTransactionCountBlock(int block);
     /** Returns a list of all Omni transactions in the given block range. */
     int GetOmniTxsInBlockRange(int blockFirst, int blockLast, std::set<uint256>& retTxs);
+    /** Returns the Omni transactions in the given block range with their types, ordered by block. */
+    std::vector<BlockTx> GetTxsInBlockRange(int blockFirst, int blockLast);
 
     int getDBVersion();
     int setDBVersion();
+    /** Returns the properties, whose history was indexed, when the databases were built, or an empty string for all. */
+    std::string getIndexProperties();
+    /** Stores the properties, whose history is indexed. */
+    void setIndexProperties(const std::string& strProperties);
+
+    /** Deletes all entries of the database, and resets the txid filter. */
+    void Clear() override;
 
     bool exists(const uint256& txid);
-    bool getTX(const uint256& txid, std::string& value);
     bool getValidMPTX(const uint256& txid, int* block = nullptr, unsigned int* type = nullptr, uint64_t* nAmended = nullptr);
 
+    /** Returns the blocks with Omni transactions in the given block range. */
     std::set<int> GetSeedBlocks(int startHeight, int endHeight);
+    /** Returns the valid alerts, activations or freeze transactions of the given types in chain order. */
+    std::vector<PositionedTx> GetValidTxsOfTypes(const std::vector<uint32_t>& vTypes);
     void LoadAlerts(int blockHeight);
     void LoadActivations(int blockHeight);
     bool LoadFreezeState(int blockHeight);
+    /** Returns whether there are freeze related transactions in or above the given block. */
     bool CheckForFreezeTxs(int blockHeight);
 
+    /** Records the commitment to the state at the end of a block. */
+    void RecordStateHash(int nBlock, const uint256& blockHash, const uint256& stateHash);
+    /** Retrieves the commitment to the state at the end of a block, and returns false, if none was recorded for this block. */
+    bool GetStateHash(int nBlock, const uint256& blockHash, uint256& stateHash);
+    /** Deletes the recorded commitments of the given block and above. */
+    void DeleteStateHashes(int nBlock);
+
     void printStats();
     void printAll();
 
     bool isMPinBlockRange(int, int, bool);
+
+    /** Deletes the records below a block, except the ones still needed, and returns the number of records deleted. */
+    int PruneBelowBlock(int nBlock, const std::set<uint256>& setKeep, std::vector<uint256>& vPruned);
+    /** Returns the block, below which the records were pruned, or 0, if none were pruned. */
+    int GetPrunedHeight();
 };
 
 namespace mastercore
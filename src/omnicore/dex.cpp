@@ -6,39 +6,127 @@
 
 #include <omnicore/dex.h>
 
+#include <omnicore/consensushash.h>
 #include <omnicore/convert.h>
 #include <omnicore/dbtxlist.h>
 #include <omnicore/log.h>
+#include <omnicore/memusage.h>
 #include <omnicore/rules.h>
 #include <omnicore/uint256_extensions.h>
 
-#include <arith_uint256.h>
+#include <memusage.h>
+#include <random.h>
 #include <validation.h>
 #include <tinyformat.h>
 #include <uint256.h>
 
-#include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast.hpp>
-
 #include <stdint.h>
 
-#include <fstream>
+#include <algorithm>
+#include <limits>
 #include <map>
 #include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
+CDExKeyHasher::CDExKeyHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
 namespace mastercore
 {
+/** Returns the block at which the payment window of an accept is over. */
+static int GetExpiryBlock(const CMPAccept& accept)
+{
+    return accept.getAcceptBlock() + static_cast<int>(accept.getBlockTimeLimit());
+}
+
+std::pair<CDExAcceptMap::iterator, bool> CDExAcceptMap::insert(const value_type& value)
+{
+    std::pair<iterator, bool> result = m_accepts.insert(value);
+    if (result.second) {
+        // the accepts are restored in ascending order of their keys
+        m_keys.insert(m_keys.end(), value.first);
+        m_buyers.insert(std::make_pair(value.first.buyer, value.first.seller));
+        m_expiries.push(std::make_pair(GetExpiryBlock(value.second), value.first));
+    }
+    return result;
+}
+
+void CDExAcceptMap::erase(iterator it)
+{
+    m_keys.erase(it->first);
+    m_buyers.erase(m_buyers.find(std::make_pair(it->first.buyer, it->first.seller)));
+    m_accepts.erase(it);
+}
+
+void CDExAcceptMap::clear()
+{
+    m_accepts.clear();
+    m_keys.clear();
+    m_buyers.clear();
+    m_expiries = decltype(m_expiries)();
+}
+
+std::vector<CDExAcceptKey> CDExAcceptMap::GetSellerAccepts(const std::string& seller) const
+{
+    std::vector<CDExAcceptKey> vKeys;
+    for (auto it = m_keys.lower_bound(CDExAcceptKey(seller, 0, "")); it != m_keys.end() && it->seller == seller; ++it) {
+        vKeys.push_back(*it);
+    }
+    return vKeys;
+}
+
+std::vector<std::string> CDExAcceptMap::GetBuyerSellers(const std::string& buyer) const
+{
+    std::vector<std::string> vSellers;
+    for (auto it = m_buyers.lower_bound(std::make_pair(buyer, std::string())); it != m_buyers.end() && it->first == buyer; ++it) {
+        if (vSellers.empty() || vSellers.back() != it->second) vSellers.push_back(it->second);
+    }
+    return vSellers;
+}
+
+std::vector<CDExAcceptKey> CDExAcceptMap::TakeExpired(int block)
+{
+    std::vector<std::pair<std::string, CDExAcceptKey> > vExpired;
+    while (!m_expiries.empty() && m_expiries.top().first <= block) {
+        const CDExAcceptKey& key = m_expiries.top().second;
+        const_iterator it = m_accepts.find(key);
+        // skip entries of erased accepts, and of accepts, which were replaced by a later one
+        if (it != m_accepts.end() && GetExpiryBlock(it->second) <= block) {
+            vExpired.push_back(std::make_pair(key.ToString(), key));
+        }
+        m_expiries.pop();
+    }
+
+    // the accepts were expired in the order of their legacy keys, and an accept may have several entries
+    std::sort(vExpired.begin(), vExpired.end(),
+            [](const std::pair<std::string, CDExAcceptKey>& a, const std::pair<std::string, CDExAcceptKey>& b) { return a.first < b.first; });
+    std::vector<CDExAcceptKey> vKeys;
+    for (size_t i = 0; i < vExpired.size(); ++i) {
+        if (i > 0 && vExpired[i].first == vExpired[i - 1].first) continue;
+        vKeys.push_back(vExpired[i].second);
+    }
+    return vKeys;
+}
+
+size_t CDExAcceptMap::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(m_accepts) + memusage::DynamicUsage(m_keys) +
+            memusage::MallocUsage(sizeof(memusage::stl_tree_node<std::pair<std::string, std::string> >)) * m_buyers.size() +
+            memusage::MallocUsage(sizeof(Expiry) * m_expiries.size());
+    // the keys are held by the map, the indexes and the expiry entries
+    for (const auto& entry : m_accepts) {
+        nUsage += 4 * (StringUsage(entry.first.seller) + StringUsage(entry.first.buyer));
+    }
+    return nUsage;
+}
+
 /**
  * Checks, if such a sell offer exists.
  */
 bool DEx_offerExists(const std::string& addressSeller, uint32_t propertyId)
 {
-    std::string key = STR_SELLOFFER_ADDR_PROP_COMBO(addressSeller, propertyId);
-
-    return !(my_offers.find(key) == my_offers.end());
+    return my_offers.count(CDExOfferKey(addressSeller, propertyId)) > 0;
 }
 
 /**
@@ -46,13 +134,9 @@ bool DEx_offerExists(const std::string& addressSeller, uint32_t propertyId)
  */
 bool DEx_hasOffer(const std::string& addressSeller)
 {
-    for (auto const& offer : my_offers) {
-        if (offer.first.find(addressSeller) == 0) {
-            return true;
-        }
-    }
+    OfferMap::const_iterator it = my_offers.lower_bound(CDExOfferKey(addressSeller, 0));
 
-    return false;
+    return it != my_offers.end() && it->first.seller == addressSeller;
 }
 
 /**
@@ -67,29 +151,12 @@ bool DEx_hasOffer(const std::string& addressSeller)
  */
 bool DEx_getTokenForSale(const std::string& addressSeller, uint32_t& retTokenId)
 {
-    for (auto const& offer : my_offers) {
-        if (offer.first.find(addressSeller) == 0) {
-
-            // Format is: "address-tokenid"
-            std::vector<std::string> vstr;
-            boost::split(vstr, offer.first, boost::is_any_of("-"), boost::token_compress_on);
-
-            if (vstr.size() != 2) {
-                PrintToLog("ERROR: failed to parse token for sale: %s\n", offer.first);
-                return false;
-            }
-
-            try {
-                retTokenId = boost::lexical_cast<uint32_t>(vstr[1]);
-                return true;
-            }
-            catch (boost::bad_lexical_cast const& e) {
-                PrintToLog("ERROR: failed to parse token for sale: %s (%s)\n", offer.first, e.what());
-            }
-        }
-    }
+    OfferMap::const_iterator it = my_offers.lower_bound(CDExOfferKey(addressSeller, 0));
+
+    if (it == my_offers.end() || it->first.seller != addressSeller) return false;
 
-    return false;
+    retTokenId = it->first.propertyId;
+    return true;
 }
 
 /**
@@ -99,10 +166,9 @@ bool DEx_getTokenForSale(const std::string& addressSeller, uint32_t& retTokenId)
  */
 CMPOffer* DEx_getOffer(const std::string& addressSeller, uint32_t propertyId)
 {
-    if (msc_debug_dex) PrintToLog("%s(%s, %d)\n", __func__, addressSeller, propertyId);
+    PrintToLogIf(msc_debug_dex, "%s(%s, %d)\n", __func__, addressSeller, propertyId);
 
-    std::string key = STR_SELLOFFER_ADDR_PROP_COMBO(addressSeller, propertyId);
-    OfferMap::iterator it = my_offers.find(key);
+    OfferMap::iterator it = my_offers.find(CDExOfferKey(addressSeller, propertyId));
 
     if (it != my_offers.end()) return &(it->second);
 
@@ -114,9 +180,7 @@ CMPOffer* DEx_getOffer(const std::string& addressSeller, uint32_t propertyId)
  */
 bool DEx_acceptExists(const std::string& addressSeller, uint32_t propertyId, const std::string& addressBuyer)
 {
-    std::string key = STR_ACCEPT_ADDR_PROP_ADDR_COMBO(addressSeller, addressBuyer, propertyId);
-
-    return !(my_accepts.find(key) == my_accepts.end());
+    return !(my_accepts.find(CDExAcceptKey(addressSeller, propertyId, addressBuyer)) == my_accepts.end());
 }
 
 /**
@@ -126,10 +190,9 @@ bool DEx_acceptExists(const std::string& addressSeller, uint32_t propertyId, con
  */
 CMPAccept* DEx_getAccept(const std::string& addressSeller, uint32_t propertyId, const std::string& addressBuyer)
 {
-    if (msc_debug_dex) PrintToLog("%s(%s, %d, %s)\n", __func__, addressSeller, propertyId, addressBuyer);
+    PrintToLogIf(msc_debug_dex, "%s(%s, %d, %s)\n", __func__, addressSeller, propertyId, addressBuyer);
 
-    std::string key = STR_ACCEPT_ADDR_PROP_ADDR_COMBO(addressSeller, addressBuyer, propertyId);
-    AcceptMap::iterator it = my_accepts.find(key);
+    AcceptMap::iterator it = my_accepts.find(CDExAcceptKey(addressSeller, propertyId, addressBuyer));
 
     if (it != my_accepts.end()) return &(it->second);
 
@@ -172,13 +235,7 @@ int64_t calculateDesiredBTC(const int64_t amountOffered, const int64_t amountDes
         return 0; // divide by null protection
     }
 
-    arith_uint256 amountOffered256 = ConvertTo256(amountOffered);
-    arith_uint256 amountDesired256 = ConvertTo256(amountDesired);
-    arith_uint256 amountAvailable256 = ConvertTo256(amountAvailable);
-
-    amountDesired256 = DivideAndRoundUp((amountDesired256 * amountAvailable256), amountOffered256);
-
-    return ConvertTo64(amountDesired256);
+    return MultiplyAndDivideRoundUp(amountDesired, amountAvailable, amountOffered);
 }
 
 /**
@@ -210,8 +267,8 @@ int DEx_offerCreate(const std::string& addressSeller, uint32_t propertyId, int64
         }
     }
 
-    const std::string key = STR_SELLOFFER_ADDR_PROP_COMBO(addressSeller, propertyId);
-    if (msc_debug_dex) PrintToLog("%s(%s|%s), nValue=%d)\n", __func__, addressSeller, key, amountOffered);
+    const CDExOfferKey key(addressSeller, propertyId);
+    PrintToLogIf(msc_debug_dex, "%s(%s|%s), nValue=%d)\n", __func__, addressSeller, key.ToString(), amountOffered);
 
     const int64_t balanceReallyAvailable = GetTokenBalance(addressSeller, propertyId, BALANCE);
 
@@ -252,6 +309,7 @@ int DEx_offerCreate(const std::string& addressSeller, uint32_t propertyId, int64
 
         CMPOffer sellOffer(block, amountOffered, propertyId, amountDesired, minAcceptFee, paymentWindow, txid);
         my_offers.insert(std::make_pair(key, sellOffer));
+        CommitDExOffer(key, sellOffer, true);
 
         rc = 0;
     }
@@ -281,11 +339,11 @@ int DEx_offerDestroy(const std::string& addressSeller, uint32_t propertyId)
     }
 
     // delete the offer
-    const std::string key = STR_SELLOFFER_ADDR_PROP_COMBO(addressSeller, propertyId);
-    OfferMap::iterator it = my_offers.find(key);
+    OfferMap::iterator it = my_offers.find(CDExOfferKey(addressSeller, propertyId));
+    CommitDExOffer(it->first, it->second, false);
     my_offers.erase(it);
 
-    if (msc_debug_dex) PrintToLog("%s(%s|%s)\n", __func__, addressSeller, key);
+    PrintToLogIf(msc_debug_dex, "%s(%s|%s)\n", __func__, addressSeller, STR_SELLOFFER_ADDR_PROP_COMBO(addressSeller, propertyId));
 
     return 0;
 }
@@ -299,7 +357,7 @@ int DEx_offerDestroy(const std::string& addressSeller, uint32_t propertyId)
  */
 int DEx_offerUpdate(const std::string& addressSeller, uint32_t propertyId, int64_t amountOffered, int block, int64_t amountDesired, int64_t minAcceptFee, uint8_t paymentWindow, const uint256& txid, uint64_t* nAmended)
 {
-    if (msc_debug_dex) PrintToLog("%s(%s, %d)\n", __func__, addressSeller, propertyId);
+    PrintToLogIf(msc_debug_dex, "%s(%s, %d)\n", __func__, addressSeller, propertyId);
 
     if (!DEx_offerExists(addressSeller, propertyId)) {
         return (DEX_ERROR_SELLOFFER -12); // offer does not exist
@@ -324,8 +382,8 @@ int DEx_offerUpdate(const std::string& addressSeller, uint32_t propertyId, int64
 int DEx_acceptCreate(const std::string& addressBuyer, const std::string& addressSeller, uint32_t propertyId, int64_t amountAccepted, int block, int64_t feePaid, uint64_t* nAmended)
 {
     int rc = DEX_ERROR_ACCEPT -10;
-    const std::string keySellOffer = STR_SELLOFFER_ADDR_PROP_COMBO(addressSeller, propertyId);
-    const std::string keyAcceptOrder = STR_ACCEPT_ADDR_PROP_ADDR_COMBO(addressSeller, addressBuyer, propertyId);
+    const CDExOfferKey keySellOffer(addressSeller, propertyId);
+    const CDExAcceptKey keyAcceptOrder(addressSeller, propertyId, addressBuyer);
 
     OfferMap::const_iterator my_it = my_offers.find(keySellOffer);
 
@@ -368,6 +426,7 @@ int DEx_acceptCreate(const std::string& addressBuyer, const std::string& address
 
         CMPAccept acceptOffer(amountReserved, block, offer.getBlockTimeLimit(), offer.getProperty(), offer.getOfferAmountOriginal(), offer.getBTCDesiredOriginal(), offer.getHash());
         my_accepts.insert(std::make_pair(keyAcceptOrder, acceptOffer));
+        CommitDExAccept(keyAcceptOrder, acceptOffer, true);
 
         rc = 0;
     }
@@ -427,10 +486,10 @@ int DEx_acceptDestroy(const std::string& addressBuyer, const std::string& addres
 
     // can only erase when is NOT called from an iterator loop
     if (fForceErase) {
-        std::string key = STR_ACCEPT_ADDR_PROP_ADDR_COMBO(addressSeller, addressBuyer, propertyid);
-        AcceptMap::iterator it = my_accepts.find(key);
+        AcceptMap::iterator it = my_accepts.find(CDExAcceptKey(addressSeller, propertyid, addressBuyer));
 
         if (my_accepts.end() != it) {
+            CommitDExAccept(it->first, it->second, false);
             my_accepts.erase(it);
         }
     }
@@ -478,16 +537,8 @@ static int64_t calculateDExPurchase(const int64_t amountOffered, const int64_t a
  */
 int64_t calculateDExPurchase(const int64_t amountOffered, const int64_t amountDesired, const int64_t amountPaid)
 {
-    // conversion
-    arith_uint256 amountOffered256 = ConvertTo256(amountOffered);
-    arith_uint256 amountDesired256 = ConvertTo256(amountDesired);
-    arith_uint256 amountPaid256 = ConvertTo256(amountPaid);
-
     // actual calculation; round up
-    arith_uint256 amountPurchased256 = DivideAndRoundUp((amountPaid256 * amountOffered256), amountDesired256);
-
-    // convert back to int64_t
-    return ConvertTo64(amountPurchased256);
+    return MultiplyAndDivideRoundUp(amountPaid, amountOffered, amountDesired);
 }
 
 /**
@@ -496,7 +547,7 @@ int64_t calculateDExPurchase(const int64_t amountOffered, const int64_t amountDe
  */
 int DEx_payment(const uint256& txid, unsigned int vout, const std::string& addressSeller, const std::string& addressBuyer, int64_t amountPaid, int block, uint64_t* nAmended)
 {
-    if (msc_debug_dex) PrintToLog("%s(%s, %s)\n", __func__, addressSeller, addressBuyer);
+    PrintToLogIf(msc_debug_dex, "%s(%s, %s)\n", __func__, addressSeller, addressBuyer);
 
     int rc = DEX_ERROR_PAYMENT;
 
@@ -538,7 +589,7 @@ int DEx_payment(const uint256& txid, unsigned int vout, const std::string& addre
 
     // divide by 0 protection
     if (0 == amountDesired) {
-        if (msc_debug_dex) PrintToLog("%s: ERROR: desired amount of accept order is zero", __func__);
+        PrintToLogIf(msc_debug_dex, "%s: ERROR: desired amount of accept order is zero", __func__);
 
         return (DEX_ERROR_PAYMENT -2);
     }
@@ -566,7 +617,7 @@ int DEx_payment(const uint256& txid, unsigned int vout, const std::string& addre
 
     const int64_t amountRemaining = p_accept->getAcceptAmountRemaining(); // actual amount desired, in the Accept
 
-    if (msc_debug_dex) PrintToLog(
+    PrintToLogIf(msc_debug_dex,
             "%s: BTC desired: %s, offered amount: %s, amount to purchase: %s, amount remaining: %s\n", __func__,
             FormatDivisibleMP(amountDesired), FormatDivisibleMP(amountOffered),
             FormatDivisibleMP(amountPurchased), FormatDivisibleMP(amountRemaining));
@@ -595,7 +646,11 @@ int DEx_payment(const uint256& txid, unsigned int vout, const std::string& addre
     }
 
     // reduce the amount of units still desired by the buyer and if 0 destroy the Accept order
-    if (p_accept->reduceAcceptAmountRemaining_andIsZero(amountPurchased)) {
+    const CDExAcceptKey keyAccept(addressSeller, propertyId, addressBuyer);
+    CommitDExAccept(keyAccept, *p_accept, false);
+    bool fAcceptFilled = p_accept->reduceAcceptAmountRemaining_andIsZero(amountPurchased);
+    CommitDExAccept(keyAccept, *p_accept, true);
+    if (fAcceptFilled) {
         const int64_t reserveSell = GetTokenBalance(addressSeller, propertyId, SELLOFFER_RESERVE);
         const int64_t reserveAccept = GetTokenBalance(addressSeller, propertyId, ACCEPT_RESERVE);
 
@@ -613,32 +668,21 @@ int DEx_payment(const uint256& txid, unsigned int vout, const std::string& addre
 unsigned int eraseExpiredAccepts(int blockNow)
 {
     unsigned int how_many_erased = 0;
-    AcceptMap::iterator it = my_accepts.begin();
 
-    while (my_accepts.end() != it) {
+    for (const CDExAcceptKey& key : my_accepts.TakeExpired(blockNow)) {
+        AcceptMap::iterator it = my_accepts.find(key);
         const CMPAccept& acceptOrder = it->second;
 
-        int blocksSinceAccept = blockNow - acceptOrder.getAcceptBlock();
-        int blocksPaymentWindow = static_cast<int>(acceptOrder.getBlockTimeLimit());
-
-        if (blocksSinceAccept >= blocksPaymentWindow) {
-            PrintToLog("%s: sell offer: %s\n", __func__, acceptOrder.getHash().GetHex());
-            PrintToLog("%s: erasing at block: %d, order confirmed at block: %d, payment window: %d\n",
-                    __func__, blockNow, acceptOrder.getAcceptBlock(), acceptOrder.getBlockTimeLimit());
-
-            // extract the seller, buyer and property from the key
-            std::vector<std::string> vstr;
-            boost::split(vstr, it->first, boost::is_any_of("-+"), boost::token_compress_on);
-            std::string addressSeller = vstr[0];
-            uint32_t propertyId = atoi(vstr[1]);
-            std::string addressBuyer = vstr[2];
+        PrintToLog("%s: sell offer: %s\n", __func__, acceptOrder.getHash().GetHex());
+        PrintToLog("%s: erasing at block: %d, order confirmed at block: %d, payment window: %d\n",
+                __func__, blockNow, acceptOrder.getAcceptBlock(), acceptOrder.getBlockTimeLimit());
 
-            DEx_acceptDestroy(addressBuyer, addressSeller, propertyId);
+        DEx_acceptDestroy(key.buyer, key.seller, key.propertyId);
 
-            my_accepts.erase(it++);
+        CommitDExAccept(it->first, it->second, false);
+        my_accepts.erase(it);
 
-            ++how_many_erased;
-        } else it++;
+        ++how_many_erased;
     }
 
     return how_many_erased;
@@ -3,17 +3,24 @@
 
 #include <omnicore/log.h>
 #include <omnicore/omnicore.h>
+#include <omnicore/statefile.h>
 #include <omnicore/tx.h>
 
 #include <amount.h>
-#include <hash.h>
+#include <crypto/siphash.h>
 #include <tinyformat.h>
 #include <uint256.h>
 
+#include <stddef.h>
 #include <stdint.h>
-#include <fstream>
+#include <functional>
 #include <map>
+#include <queue>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 /** Lookup key to find DEx offers. */
 inline std::string STR_SELLOFFER_ADDR_PROP_COMBO(const std::string& address, uint32_t propertyId)
@@ -36,6 +43,74 @@ inline std::string STR_REF_SUBKEY_TXID_REF_COMBO(const std::string& txidStr, uns
     return strprintf("%s%d", txidStr, refNumber);
 }
 
+/** Lookup key of DEx offers, there is at most one offer per seller and property. */
+struct CDExOfferKey
+{
+    std::string seller;
+    uint32_t propertyId;
+
+    CDExOfferKey(const std::string& sellerIn, uint32_t propertyIdIn) : seller(sellerIn), propertyId(propertyIdIn) {}
+
+    bool operator==(const CDExOfferKey& other) const
+    {
+        return propertyId == other.propertyId && seller == other.seller;
+    }
+
+    bool operator<(const CDExOfferKey& other) const
+    {
+        int cmp = seller.compare(other.seller);
+        return cmp < 0 || (cmp == 0 && propertyId < other.propertyId);
+    }
+
+    /** Returns the key in the legacy form "seller-property", as used by the state commitment. */
+    std::string ToString() const { return STR_SELLOFFER_ADDR_PROP_COMBO(seller, propertyId); }
+};
+
+/** Lookup key of DEx accepts, there is at most one accept per buyer and offer. */
+struct CDExAcceptKey
+{
+    std::string seller;
+    uint32_t propertyId;
+    std::string buyer;
+
+    CDExAcceptKey(const std::string& sellerIn, uint32_t propertyIdIn, const std::string& buyerIn)
+      : seller(sellerIn), propertyId(propertyIdIn), buyer(buyerIn) {}
+
+    bool operator==(const CDExAcceptKey& other) const
+    {
+        return propertyId == other.propertyId && seller == other.seller && buyer == other.buyer;
+    }
+
+    /** Orders by seller first, so the accepts of a seller are adjacent. */
+    bool operator<(const CDExAcceptKey& other) const
+    {
+        int cmp = seller.compare(other.seller);
+        if (cmp != 0) return cmp < 0;
+        if (propertyId != other.propertyId) return propertyId < other.propertyId;
+        return buyer < other.buyer;
+    }
+
+    /** Returns the key in the legacy form "seller-property+buyer", as used by the state commitment. */
+    std::string ToString() const { return STR_ACCEPT_ADDR_PROP_ADDR_COMBO(seller, buyer, propertyId); }
+};
+
+/** Salted hasher for DEx accept keys, as the addresses are chosen by the senders of transactions. */
+class CDExKeyHasher
+{
+private:
+    /** Salt */
+    uint64_t k0, k1;
+
+public:
+    CDExKeyHasher();
+
+    size_t operator()(const CDExAcceptKey& key) const
+    {
+        return CSipHasher(k0, k1).Write((const unsigned char*) key.seller.data(), key.seller.size())
+                .Write(key.propertyId).Write((const unsigned char*) key.buyer.data(), key.buyer.size()).Finalize();
+    }
+};
+
 /** A single outstanding offer, from one seller of one property.
  *
  * There many be more than one accepted offers.
@@ -76,7 +151,7 @@ public:
         BTC_desired_original(amountDesired), min_fee(minAcceptFee), blocktimelimit(paymentWindow),
         txid(tx), subaction(0)
     {
-        if (msc_debug_dex) PrintToLog("%s(%d): %s\n", __func__, amountOffered, txid.GetHex());
+        PrintToLogIf(msc_debug_dex, "%s(%d): %s\n", __func__, amountOffered, txid.GetHex());
     }
 
     CMPOffer(const CMPTransaction& tx)
@@ -86,25 +161,18 @@ public:
     {
     }
 
-    void saveOffer(std::ofstream& file, const std::string& address, CHash256& hasher) const
+    void saveOffer(CStateFileWriter& writer, const std::string& address) const
     {
-        std::string lineOut = strprintf("%s,%d,%d,%d,%d,%d,%d,%d,%s",
-                address,
-                offerBlock,
-                offer_amount_original,
-                property,
-                BTC_desired_original,
-                (OMNI_PROPERTY_BTC),
-                min_fee,
-                blocktimelimit,
-                txid.ToString()
-        );
-
-        // add the line to the hash
-        hasher.Write((unsigned char*)lineOut.c_str(), lineOut.length());
+        writer.WriteRecord(address, VARBLOCK(offerBlock), VARAMOUNT(offer_amount_original), VARINT(property),
+                VARAMOUNT(BTC_desired_original), VARAMOUNT(min_fee), blocktimelimit, txid);
+    }
 
-        // write the line
-        file << lineOut << std::endl;
+    bool operator==(const CMPOffer& other) const
+    {
+        return offerBlock == other.offerBlock && offer_amount_original == other.offer_amount_original &&
+                property == other.property && BTC_desired_original == other.BTC_desired_original &&
+                min_fee == other.min_fee && blocktimelimit == other.blocktimelimit && txid == other.txid &&
+                subaction == other.subaction;
     }
 };
 
@@ -163,6 +231,15 @@ public:
         PrintToLog("%s(%d[%d]): %s\n", __func__, acceptAmountRemaining, acceptAmountOriginal, txid.GetHex());
     }
 
+    bool operator==(const CMPAccept& other) const
+    {
+        return accept_amount_original == other.accept_amount_original &&
+                accept_amount_remaining == other.accept_amount_remaining && blocktimelimit == other.blocktimelimit &&
+                property == other.property && offer_amount_original == other.offer_amount_original &&
+                BTC_desired_original == other.BTC_desired_original && offer_txid == other.offer_txid &&
+                block == other.block;
+    }
+
     void print()
     {
         // TODO: no floating numbers
@@ -194,32 +271,83 @@ public:
         return bRet;
     }
 
-    void saveAccept(std::ofstream& file, const std::string& address, const std::string& buyer, CHash256& hasher) const
+    void saveAccept(CStateFileWriter& writer, const std::string& address, const std::string& buyer) const
     {
-        std::string lineOut = strprintf("%s,%d,%s,%d,%d,%d,%d,%d,%d,%s",
-                address,
-                property,
-                buyer,
-                block,
-                accept_amount_remaining,
-                accept_amount_original,
-                blocktimelimit,
-                offer_amount_original,
-                BTC_desired_original,
-                offer_txid.ToString());
-
-        // add the line to the hash
-        hasher.Write((unsigned char*)lineOut.c_str(), lineOut.length());
-
-        // write the line
-        file << lineOut << std::endl;
+        writer.WriteRecord(address, VARINT(property), buyer, VARBLOCK(block), VARAMOUNT(accept_amount_remaining),
+                VARAMOUNT(accept_amount_original), blocktimelimit, VARAMOUNT(offer_amount_original),
+                VARAMOUNT(BTC_desired_original), offer_txid);
     }
 };
 
 namespace mastercore
 {
-typedef std::map<std::string, CMPOffer> OfferMap;
-typedef std::map<std::string, CMPAccept> AcceptMap;
+/** DEx offers, ordered by seller and property, so the offers of a seller are adjacent. */
+typedef std::map<CDExOfferKey, CMPOffer> OfferMap;
+
+/**
+ * DEx accepts, indexed by seller, and by the block at which their payment window ends,
+ * so expiring accepts at the end of a block only visits the expired ones.
+ *
+ * The expiry entries of accepts, which are erased before the end of their payment
+ * window, are dropped lazily, once that block is reached.
+ */
+class CDExAcceptMap
+{
+public:
+    typedef std::unordered_map<CDExAcceptKey, CMPAccept, CDExKeyHasher> Map;
+    typedef Map::value_type value_type;
+    typedef Map::iterator iterator;
+    typedef Map::const_iterator const_iterator;
+
+private:
+    //! Block at which the payment window ends, and the accept
+    typedef std::pair<int, CDExAcceptKey> Expiry;
+
+    Map m_accepts;
+    //! Keys of the accepts, ordered by seller
+    std::set<CDExAcceptKey> m_keys;
+    //! Buyers and sellers of the accepts, one entry per accept
+    std::multiset<std::pair<std::string, std::string> > m_buyers;
+    //! Earliest end of a payment window on top
+    std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry> > m_expiries;
+
+public:
+    iterator begin() { return m_accepts.begin(); }
+    iterator end() { return m_accepts.end(); }
+    const_iterator begin() const { return m_accepts.begin(); }
+    const_iterator end() const { return m_accepts.end(); }
+    iterator find(const CDExAcceptKey& key) { return m_accepts.find(key); }
+    const_iterator find(const CDExAcceptKey& key) const { return m_accepts.find(key); }
+    size_t size() const { return m_accepts.size(); }
+    bool empty() const { return m_accepts.empty(); }
+
+    std::pair<iterator, bool> insert(const value_type& value);
+    void erase(iterator it);
+    void clear();
+    void reserve(size_t n) { m_accepts.reserve(n); }
+
+    /** Compares the accepts, the indexes are derived from them. */
+    bool operator==(const CDExAcceptMap& other) const { return m_accepts == other.m_accepts; }
+
+    /** Returns the keys of all accepts in ascending order, which is the order they are persisted in. */
+    const std::set<CDExAcceptKey>& GetKeys() const { return m_keys; }
+
+    /** Returns the keys of the accepts of a seller, ordered by property and buyer. */
+    std::vector<CDExAcceptKey> GetSellerAccepts(const std::string& seller) const;
+
+    /** Returns the sellers, whose offers were accepted by a buyer, without duplicates. */
+    std::vector<std::string> GetBuyerSellers(const std::string& buyer) const;
+
+    /**
+     * Drops the expiry entries up to the block, and returns the keys of the accepts, whose
+     * payment window is over, in the order of their legacy keys.
+     */
+    std::vector<CDExAcceptKey> TakeExpired(int block);
+
+    size_t DynamicMemoryUsage() const;
+};
+
+typedef CDExAcceptMap AcceptMap;
 
 //! In-memory collection of DEx offers
 extern OfferMap my_offers;
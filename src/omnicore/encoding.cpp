@@ -28,8 +28,9 @@ bool OmniCore_Encode_ClassB(const std::string& senderAddress, const CPubKey& red
     unsigned int nRemainingBytes = vchPayload.size();
     unsigned int nNextByte = 0;
     unsigned char chSeqNum = 1;
-    std::string strObfuscatedHashes[1+MAX_SHA256_OBFUSCATION_TIMES];
-    PrepareObfuscatedHashes(senderAddress, MAX_SHA256_OBFUSCATION_TIMES, strObfuscatedHashes);
+    unsigned char vchObfuscatedHashes[1+MAX_SHA256_OBFUSCATION_TIMES][32];
+    // Only as many hashes as there are packets
+    PrepareObfuscatedHashes(senderAddress, (nRemainingBytes + PACKET_SIZE - 2) / (PACKET_SIZE - 1), vchObfuscatedHashes);
     while (nRemainingBytes > 0) {
         int nKeys = 1; // Assume one key of data, because we have data remaining
         if (nRemainingBytes > (PACKET_SIZE - 1)) { nKeys += 1; } // ... or enough data to embed in 2 keys
@@ -45,7 +46,7 @@ bool OmniCore_Encode_ClassB(const std::string& senderAddress, const CPubKey& red
             vchFakeKey.resize(PACKET_SIZE); // Pad to 31 total bytes with zeros
             nNextByte += nCurrentBytes;
             nRemainingBytes -= nCurrentBytes;
-            std::vector<unsigned char> vchHash = ParseHex(strObfuscatedHashes[chSeqNum]);
+            const unsigned char* vchHash = vchObfuscatedHashes[chSeqNum];
             for (size_t j = 0; j < PACKET_SIZE; j++) { // Xor in the obfuscation
                 vchFakeKey[j] = vchFakeKey[j] ^ vchHash[j];
             }
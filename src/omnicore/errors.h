@@ -34,6 +34,7 @@ enum MPRPCErrorCode
     MP_TX_IS_NOT_OMNI_PROTOCOL    = -3336,  // No Omni Layer Protocol transaction.
     MP_TXINDEX_STILL_SYNCING      = -3337,  // No such mempool transaction. Blockchain transactions are still in the process of being indexed.
     MP_RPC_DECODE_INPUTS_MISSING  = -3338,  // Transaction inputs missing
+    MP_TX_HISTORY_PRUNED          = -3339,  // Transaction below the pruned history
 };
 
 inline std::string error_str(int ec) {
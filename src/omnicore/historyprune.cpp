@@ -0,0 +1,150 @@
+/**
+ * @file historyprune.cpp
+ *
+ * This file contains the pruning of the Omni history below a configurable horizon.
+ */
+
+#include <omnicore/historyprune.h>
+
+#include <omnicore/dbaddressindex.h>
+#include <omnicore/dbbalancechanges.h>
+#include <omnicore/dbbalancehistory.h>
+#include <omnicore/dbbase.h>
+#include <omnicore/dbfees.h>
+#include <omnicore/dbstolist.h>
+#include <omnicore/dbtradelist.h>
+#include <omnicore/dbtransaction.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/dex.h>
+#include <omnicore/log.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/rules.h>
+
+#include <sync.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <vector>
+
+namespace mastercore
+{
+namespace
+{
+//! Block, below which the history was pruned, read by RPC calls without holding cs_tally
+std::atomic<int> g_nPrunedHeight{0};
+//! Number of blocks of history to keep, 0 to keep the whole history
+int g_nPruneDepth GUARDED_BY(cs_tally) = DEFAULT_OMNI_PRUNE_HISTORY;
+
+//! Block, below which the undo logs were pruned since the start
+int g_nUndoLogPrunedHeight GUARDED_BY(cs_tally) = 0;
+
+/**
+ * Removes the undo log entries of the blocks, which can no longer be rolled back.
+ *
+ * With pruned history, the entries of the trade and STO lists and the fee history are
+ * needed to find the records below the horizon, and are removed along with them.
+ */
+void PruneUndoLogs(int nBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    const int nHorizon = nBlock - MAX_STATE_HISTORY;
+    if (nHorizon - g_nUndoLogPrunedHeight < OMNI_PRUNE_HISTORY_INTERVAL) return;
+
+    std::vector<CDBBase*> vDatabases{pDbFeeCache, pDbBalanceHistory, pDbBalanceChanges, pDbAddressIndex};
+    if (g_nPruneDepth <= 0) {
+        vDatabases.insert(vDatabases.end(), {pDbTradeList, pDbStoList, pDbFeeHistory});
+    }
+
+    size_t nPruned = 0;
+    bool fComplete = true;
+    for (CDBBase* pdb : vDatabases) {
+        if (!pdb) continue;
+        const size_t n = pdb->PruneUndoLog(nHorizon, OMNI_PRUNE_UNDO_LOG_STEP);
+        // the remaining entries are removed with the next block
+        if (n == OMNI_PRUNE_UNDO_LOG_STEP) fComplete = false;
+        nPruned += n;
+    }
+
+    if (nPruned > 0) {
+        PrintToLog("Pruned %d undo log entries below block %d\n", nPruned, nHorizon);
+    }
+    if (fComplete) g_nUndoLogPrunedHeight = nHorizon;
+}
+
+/** Returns the transactions, whose records are needed, even if they are below the horizon. */
+std::set<uint256> GetRetainedTransactions() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    std::set<uint256> setKeep;
+    for (const TransactionCheckpoint& checkpoint : ConsensusParams().GetTransactions()) {
+        setKeep.insert(checkpoint.txHash);
+    }
+    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        for (md_PricesMap::const_iterator it = my_it->second.begin(); it != my_it->second.end(); ++it) {
+            for (const CMPMetaDEx& order : it->second) {
+                setKeep.insert(order.getHash());
+            }
+        }
+    }
+    for (OfferMap::const_iterator it = my_offers.begin(); it != my_offers.end(); ++it) {
+        setKeep.insert(it->second.getHash());
+    }
+    for (AcceptMap::const_iterator it = my_accepts.begin(); it != my_accepts.end(); ++it) {
+        setKeep.insert(it->second.getHash());
+    }
+    return setKeep;
+}
+} // anonymous namespace
+
+void LoadHistoryPrunedHeight()
+{
+    AssertLockHeld(cs_tally);
+
+    g_nPruneDepth = static_cast<int>(gArgs.GetArg("-omniprunehistory", DEFAULT_OMNI_PRUNE_HISTORY));
+    // blocks, which can be rolled back, are never pruned
+    if (g_nPruneDepth > 0) g_nPruneDepth = std::max(g_nPruneDepth, MAX_STATE_HISTORY);
+
+    g_nPrunedHeight = pDbTransactionList->GetPrunedHeight();
+    // the undo logs are checked from the start
+    g_nUndoLogPrunedHeight = 0;
+    if (g_nPrunedHeight > 0) {
+        PrintToLog("Omni history is pruned below block %d\n", g_nPrunedHeight.load());
+    }
+}
+
+int GetHistoryPrunedHeight()
+{
+    return g_nPrunedHeight;
+}
+
+void PruneHistory(int nBlock, bool fReplicaBlock)
+{
+    AssertLockHeld(cs_tally);
+
+    // the deletions of the primary were applied with the state delta
+    if (fReplicaBlock) {
+        g_nPrunedHeight = pDbTransactionList->GetPrunedHeight();
+        return;
+    }
+    PruneUndoLogs(nBlock);
+    if (g_nPruneDepth <= 0) return;
+
+    const int nPrunedHeight = std::max(g_nPrunedHeight.load(), ConsensusParams().GENESIS_BLOCK);
+    int nHorizon = nBlock - g_nPruneDepth + 1;
+    if (nHorizon - nPrunedHeight < OMNI_PRUNE_HISTORY_INTERVAL) return;
+    nHorizon = std::min(nHorizon, nPrunedHeight + OMNI_PRUNE_HISTORY_STEP);
+
+    std::vector<uint256> vPruned;
+    const int nRecords = pDbTransactionList->PruneBelowBlock(nHorizon, GetRetainedTransactions(), vPruned);
+    pDbTransaction->DeleteTransactions(vPruned);
+    const int nTrades = pDbTradeList->deleteBelowBlock(nHorizon);
+    const int nReceipts = pDbStoList->deleteBelowBlock(nHorizon);
+    const int nDistributions = pDbFeeHistory->PruneHistory(nHorizon);
+
+    PrintToLog("Pruned Omni history below block %d: %d transactions, %d trades, %d STO receipts, %d fee distributions\n",
+            nHorizon, nRecords, nTrades, nReceipts, nDistributions);
+    g_nPrunedHeight = nHorizon;
+}
+} // namespace mastercore
@@ -0,0 +1,54 @@
+#ifndef BITCOIN_OMNICORE_HISTORYPRUNE_H
+#define BITCOIN_OMNICORE_HISTORYPRUNE_H
+
+#include <omnicore/timedmutex.h>
+
+#include <sync.h>
+
+#include <stddef.h>
+
+extern CTimedRecursiveMutex cs_tally;
+
+namespace mastercore
+{
+//! Default number of blocks of Omni history to keep, 0 to keep the whole history
+static const int DEFAULT_OMNI_PRUNE_HISTORY = 0;
+//! Number of blocks, after which the history is pruned again
+static const int OMNI_PRUNE_HISTORY_INTERVAL = 100;
+//! Maximal number of blocks pruned at once, so the history of an existing node is pruned over several blocks
+static const int OMNI_PRUNE_HISTORY_STEP = 1000;
+//! Maximal number of undo log entries removed from a database at once
+static const size_t OMNI_PRUNE_UNDO_LOG_STEP = 100000;
+
+/**
+ * With -omniprunehistory=<blocks> the transaction list, the transaction records, the
+ * trade and STO lists and the fee distributions below the horizon are deleted, so the
+ * databases don't grow with the whole history of the chain.
+ *
+ * Consensus code still needs some of the records: governance and freeze transactions,
+ * which are loaded at startup, the ranges awarded by grants of non-fungible tokens, the
+ * transactions of the checkpoints, the open MetaDEx orders and DEx offers, and the last
+ * fee distribution are kept. The horizon is never within the blocks, which can be
+ * rolled back, and queries of pruned blocks or transactions fail.
+ *
+ * Independent of the history, the entries of the undo logs of the databases are removed,
+ * once their blocks can no longer be rolled back.
+ */
+
+/** Loads the block, below which the history was pruned, and the configured horizon. */
+void LoadHistoryPrunedHeight() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Returns the block, below which the history was pruned, or 0, if the history is complete. */
+int GetHistoryPrunedHeight();
+
+/**
+ * Prunes the history below the horizon, and the undo logs of the blocks, which can no longer
+ * be rolled back, once they advanced by some blocks since the last time.
+ *
+ * @param nBlock         The height of the connected block
+ * @param fReplicaBlock  Whether the state after the block was taken from a delta, which holds the deletions
+ */
+void PruneHistory(int nBlock, bool fReplicaBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+}
+
+#endif // BITCOIN_OMNICORE_HISTORYPRUNE_H
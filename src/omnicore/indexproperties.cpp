@@ -0,0 +1,81 @@
+/**
+ * @file indexproperties.cpp
+ *
+ * This file contains the properties, whose history is indexed.
+ */
+
+#include <omnicore/indexproperties.h>
+
+#include <sync.h>
+#include <util/strencodings.h>
+
+#include <boost/algorithm/string.hpp>
+
+#include <atomic>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace mastercore
+{
+//! Whether the history of all properties is indexed, checked before acquiring the lock
+static std::atomic<bool> fIndexAll{true};
+
+//! Guards the indexed properties
+static Mutex cs_index_properties;
+//! The properties, whose history is indexed, or empty to index all properties
+static std::set<uint32_t> setIndexed GUARDED_BY(cs_index_properties);
+
+bool ParseIndexProperties(const std::string& strList, std::set<uint32_t>& setProperties)
+{
+    setProperties.clear();
+    if (strList.empty()) return true;
+
+    std::vector<std::string> vstr;
+    boost::split(vstr, strList, boost::is_any_of(","));
+    for (std::string& str : vstr) {
+        boost::trim(str);
+        uint32_t propertyId;
+        if (!ParseUInt32(str, &propertyId) || propertyId == 0) return false;
+        setProperties.insert(propertyId);
+    }
+
+    return true;
+}
+
+std::string FormatIndexProperties(const std::set<uint32_t>& setProperties)
+{
+    std::string str;
+    for (uint32_t propertyId : setProperties) {
+        if (!str.empty()) str += ",";
+        str += std::to_string(propertyId);
+    }
+    return str;
+}
+
+void SetIndexProperties(const std::set<uint32_t>& setProperties)
+{
+    LOCK(cs_index_properties);
+    setIndexed = setProperties;
+    fIndexAll = setProperties.empty();
+}
+
+std::set<uint32_t> GetIndexProperties()
+{
+    LOCK(cs_index_properties);
+    return setIndexed;
+}
+
+bool IsIndexedProperty(uint32_t propertyId)
+{
+    if (fIndexAll) return true;
+
+    LOCK(cs_index_properties);
+    return setIndexed.count(propertyId) > 0;
+}
+
+bool IsIndexingAllProperties()
+{
+    return fIndexAll;
+}
+} // namespace mastercore
@@ -0,0 +1,36 @@
+#ifndef BITCOIN_OMNICORE_INDEXPROPERTIES_H
+#define BITCOIN_OMNICORE_INDEXPROPERTIES_H
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+
+namespace mastercore
+{
+/**
+ * With -omniindexproperties=<list> the history of the trades, the send-to-owners receipts,
+ * the balance history, the balance changes and the address index only cover transactions,
+ * which touch one of the listed properties. The consensus state of all properties is kept.
+ */
+
+/** Parses a comma separated list of property identifiers, and returns false, if it's invalid. */
+bool ParseIndexProperties(const std::string& strList, std::set<uint32_t>& setProperties);
+
+/** Returns the properties as sorted, comma separated list, or an empty string for all properties. */
+std::string FormatIndexProperties(const std::set<uint32_t>& setProperties);
+
+/** Sets the properties, whose history is indexed, or all properties, if the set is empty. */
+void SetIndexProperties(const std::set<uint32_t>& setProperties);
+
+/** Returns the properties, whose history is indexed, or an empty set for all properties. */
+std::set<uint32_t> GetIndexProperties();
+
+/** Returns whether the history of a property is indexed. */
+bool IsIndexedProperty(uint32_t propertyId);
+
+/** Returns whether the history of all properties is indexed. */
+bool IsIndexingAllProperties();
+}
+
+#endif // BITCOIN_OMNICORE_INDEXPROPERTIES_H
@@ -0,0 +1,100 @@
+/**
+ * @file inputcache.cpp
+ *
+ * This file contains a least recently used cache of outputs, which are spent
+ * by Omni transactions.
+ */
+
+#include <omnicore/inputcache.h>
+
+#include <coins.h>
+#include <memusage.h>
+#include <primitives/transaction.h>
+
+#include <utility>
+
+COmniInputCache::COmniInputCache(size_t nMaxSize, size_t nMaxMemory)
+  : m_nMaxSize(nMaxSize), m_nMaxMemory(nMaxMemory), m_nEntryUsage(0), m_nHits(0), m_nMisses(0), m_nEvictions(0)
+{
+}
+
+/**
+ * Returns the heap memory used by a list entry, which holds the entry and two pointers.
+ */
+size_t COmniInputCache::EntryUsage(const Coin& coin)
+{
+    return memusage::MallocUsage(sizeof(EntryList::value_type) + 2 * sizeof(void*)) + coin.DynamicMemoryUsage();
+}
+
+bool COmniInputCache::Get(const COutPoint& outpoint, Coin& coin)
+{
+    auto it = m_index.find(outpoint);
+    if (it == m_index.end()) {
+        ++m_nMisses;
+        return false;
+    }
+    ++m_nHits;
+
+    // move to the front, which is the most recently used position
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    coin = it->second->second;
+
+    return true;
+}
+
+void COmniInputCache::Add(const COutPoint& outpoint, const Coin& coin)
+{
+    if (m_nMaxSize == 0) return;
+
+    auto it = m_index.find(outpoint);
+    if (it != m_index.end()) {
+        m_nEntryUsage -= EntryUsage(it->second->second);
+        it->second->second = coin;
+        m_nEntryUsage += EntryUsage(coin);
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        Trim();
+        return;
+    }
+
+    m_entries.emplace_front(outpoint, coin);
+    m_index.emplace(outpoint, m_entries.begin());
+    m_nEntryUsage += EntryUsage(coin);
+    Trim();
+}
+
+void COmniInputCache::SetMaxSize(size_t nMaxSize)
+{
+    m_nMaxSize = nMaxSize;
+    Trim();
+}
+
+void COmniInputCache::SetMaxMemory(size_t nMaxMemory)
+{
+    m_nMaxMemory = nMaxMemory;
+    Trim();
+}
+
+size_t COmniInputCache::DynamicMemoryUsage() const
+{
+    return m_nEntryUsage + memusage::DynamicUsage(m_index);
+}
+
+void COmniInputCache::Clear()
+{
+    m_index.clear();
+    m_entries.clear();
+    m_nEntryUsage = 0;
+}
+
+/**
+ * Evicts the least recently used outputs, until the cache is within its limits.
+ */
+void COmniInputCache::Trim()
+{
+    while (!m_entries.empty() && (m_index.size() > m_nMaxSize || (m_nMaxMemory > 0 && DynamicMemoryUsage() > m_nMaxMemory))) {
+        m_nEntryUsage -= EntryUsage(m_entries.back().second);
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+        ++m_nEvictions;
+    }
+}
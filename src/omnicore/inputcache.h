@@ -0,0 +1,79 @@
+#ifndef BITCOIN_OMNICORE_INPUTCACHE_H
+#define BITCOIN_OMNICORE_INPUTCACHE_H
+
+#include <coins.h>
+#include <primitives/transaction.h>
+
+#include <list>
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+
+/** Default number of outputs held in the input cache. */
+static const unsigned int DEFAULT_INPUT_CACHE_SIZE = 500000;
+/** Default memory budget of the input cache in MiB. */
+static const unsigned int DEFAULT_INPUT_CACHE_MEMORY = 100;
+
+/**
+ * Cache of outputs spent by Omni transactions.
+ *
+ * When the cache is full, the least recently used output is evicted, so the
+ * outputs created by recent transactions, which are likely spent soon, stay
+ * cached. The cache is bounded by the number of outputs and by the memory they
+ * use, whichever limit is reached first.
+ *
+ * The cache is not thread-safe. Note: cs_tx_cache should be locked!
+ */
+class COmniInputCache
+{
+private:
+    typedef std::list<std::pair<COutPoint, Coin>> EntryList;
+
+    //! Cached outputs, the most recently used first
+    EntryList m_entries;
+    //! Position of each cached output in the list
+    std::unordered_map<COutPoint, EntryList::iterator, SaltedOutpointHasher> m_index;
+
+    size_t m_nMaxSize;
+    //! Maximum memory used by the cache in bytes, or 0 for no limit
+    size_t m_nMaxMemory;
+    //! Memory used by the list entries, which is tracked while adding and evicting
+    size_t m_nEntryUsage;
+    uint64_t m_nHits;
+    uint64_t m_nMisses;
+    uint64_t m_nEvictions;
+
+    static size_t EntryUsage(const Coin& coin);
+    void Trim();
+
+public:
+    explicit COmniInputCache(size_t nMaxSize = DEFAULT_INPUT_CACHE_SIZE, size_t nMaxMemory = DEFAULT_INPUT_CACHE_MEMORY * 1024 * 1024);
+
+    /** Retrieves an output and marks it as recently used. */
+    bool Get(const COutPoint& outpoint, Coin& coin);
+
+    /** Adds an output, and evicts the least recently used one, if the cache is full. */
+    void Add(const COutPoint& outpoint, const Coin& coin);
+
+    /** Sets the maximum number of cached outputs. */
+    void SetMaxSize(size_t nMaxSize);
+
+    /** Sets the maximum memory used by the cache in bytes, or 0 for no limit. */
+    void SetMaxMemory(size_t nMaxMemory);
+
+    /** Removes all outputs, but keeps the counters. */
+    void Clear();
+
+    /** Returns the approximate heap memory used by the cache. */
+    size_t DynamicMemoryUsage() const;
+
+    size_t Size() const { return m_index.size(); }
+    size_t GetMaxSize() const { return m_nMaxSize; }
+    size_t GetMaxMemory() const { return m_nMaxMemory; }
+    uint64_t GetHits() const { return m_nHits; }
+    uint64_t GetMisses() const { return m_nMisses; }
+    uint64_t GetEvictions() const { return m_nEvictions; }
+};
+
+#endif // BITCOIN_OMNICORE_INPUTCACHE_H
@@ -4,13 +4,16 @@
 #include <fs.h>
 #include <logging.h>
 #include <util/system.h>
+#include <util/threadnames.h>
 #include <util/time.h>
 
 #include <assert.h>
 #include <stdio.h>
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 // Default log files
@@ -19,6 +22,7 @@ const std::string LOG_FILENAME    = "omnicore.log";
 // Options
 static const long LOG_BUFFERSIZE  =  8000000; //  8 MB
 static const long LOG_SHRINKSIZE  = 50000000; // 50 MB
+static const size_t LOG_QUEUESIZE = 16000000; // 16 MB of queued messages, before messages are dropped
 
 // Debug flags
 bool msc_debug_parser_data        = 0;
@@ -38,6 +42,8 @@ bool msc_debug_tokens             = 0;
 bool msc_debug_spec               = 0;
 bool msc_debug_exo                = 0;
 bool msc_debug_tally              = 1;
+//! Compare the running totals of properties with the tally map
+bool msc_debug_tally_totals       = 0;
 bool msc_debug_sp                 = 1;
 bool msc_debug_sto                = 1;
 bool msc_debug_txdb               = 0;
@@ -62,6 +68,8 @@ bool msc_debug_consensus_hash_every_block = 0;
 bool msc_debug_alerts             = 1;
 //! Print consensus hashes for each transaction when parsing
 bool msc_debug_consensus_hash_every_transaction = 0;
+//! Print digests of the state changes of each transaction when parsing
+bool msc_debug_consensus_delta = 0;
 //! Debug fees
 bool msc_debug_fees               = 1;
 //! Debug the non-fungible tokens database
@@ -84,6 +92,19 @@ static std::once_flag debugLogInitFlag;
  */
 static FILE* fileout = nullptr;
 static std::mutex* mutexDebugLog = nullptr;
+/** Signals the writer thread, when messages are queued or when it should stop. */
+static std::condition_variable* condDebugLog = nullptr;
+/** Messages, which are not yet written by the writer thread. */
+static std::vector<std::string>* vDebugLogQueue = nullptr;
+/** Size of the queued messages in bytes. */
+static size_t nDebugLogQueued = 0;
+/** Number of messages, which were dropped, because the queue was full. */
+static uint64_t nDebugLogDropped = 0;
+/** Whether messages are written by the writer thread, or directly. */
+static bool fDebugLogAsync = false;
+static bool fDebugLogStop = false;
+/** The writer thread, which is never destroyed, like the mutex. */
+static std::thread* threadDebugLog = nullptr;
 /** Flag to indicate, whether the Omni Core log file should be reopened. */
 extern std::atomic<bool> fReopenOmniCoreLog;
 /**
@@ -108,7 +129,71 @@ static fs::path GetLogPath()
 }
 
 /**
- * Opens debug log file.
+ * @return The current timestamp in the format: 2009-01-03 18:15:05
+ */
+static std::string GetTimestamp()
+{
+    return FormatISO8601DateTime(GetTime());
+}
+
+/**
+ * Reopens the log file, if requested, for example after it was rotated.
+ */
+static void ReopenDebugLog()
+{
+    if (fReopenOmniCoreLog) {
+        fReopenOmniCoreLog = false;
+        fs::path pathDebug = GetLogPath();
+        if (freopen(pathDebug.string().c_str(), "a", fileout) == nullptr) {
+            fileout = nullptr;
+        }
+    }
+}
+
+/**
+ * Writes the queued messages in batches, until the writer is stopped and all messages are written.
+ *
+ * Only this thread touches the log file, while it is running.
+ */
+static void ThreadDebugLog()
+{
+    std::vector<std::string> vBatch;
+    std::unique_lock<std::mutex> lock(*mutexDebugLog);
+    while (true) {
+        while (!fDebugLogStop && vDebugLogQueue->empty()) {
+            condDebugLog->wait(lock);
+        }
+        if (vDebugLogQueue->empty()) break;
+
+        vBatch.swap(*vDebugLogQueue);
+        uint64_t nDropped = nDebugLogDropped;
+        nDebugLogQueued = 0;
+        nDebugLogDropped = 0;
+        lock.unlock();
+
+        ReopenDebugLog();
+        if (fileout != nullptr) {
+            for (const std::string& str : vBatch) {
+                fwrite(str.data(), 1, str.size(), fileout);
+            }
+            if (nDropped > 0) {
+                std::string strDropped = strprintf("%s [%d log messages were dropped, because the log couldn't be written fast enough]\n",
+                        GetTimestamp(), nDropped);
+                fwrite(strDropped.data(), 1, strDropped.size(), fileout);
+            }
+            fflush(fileout);
+        }
+        vBatch.clear();
+
+        lock.lock();
+    }
+
+    // later messages are written directly
+    fDebugLogAsync = false;
+}
+
+/**
+ * Opens debug log file, and starts the writer thread.
  */
 static void DebugLogInit()
 {
@@ -118,21 +203,21 @@ static void DebugLogInit()
     fs::path pathDebug = GetLogPath();
     fileout = fopen(pathDebug.string().c_str(), "a");
 
-    if (fileout) {
-        setbuf(fileout, nullptr); // Unbuffered
-    } else {
+    if (!fileout) {
         PrintToConsole("Failed to open debug log file: %s\n", pathDebug.string());
     }
 
     mutexDebugLog = new std::mutex();
-}
+    condDebugLog = new std::condition_variable();
+    vDebugLogQueue = new std::vector<std::string>();
 
-/**
- * @return The current timestamp in the format: 2009-01-03 18:15:05
- */
-static std::string GetTimestamp()
-{
-    return FormatISO8601DateTime(GetTime());
+    if (fileout) {
+        fDebugLogAsync = true;
+        threadDebugLog = new std::thread([] {
+            util::ThreadRename("omnilog");
+            ThreadDebugLog();
+        });
+    }
 }
 
 /**
@@ -141,6 +226,10 @@ static std::string GetTimestamp()
  * The configuration options "-logtimestamps" can be used to indicate, whether
  * the message to log should be prepended with a timestamp.
  *
+ * The message is only queued, and written by a background thread, so the caller
+ * doesn't wait for the disk. If the queue is full, the message is dropped, and
+ * the number of dropped messages is logged instead.
+ *
  * If "-printtoconsole" is enabled, then the message is written to the standard
  * output, usually the console, instead of a log file.
  *
@@ -158,35 +247,72 @@ int LogFilePrint(const std::string& str)
         static bool fStartedNewLine = true;
         std::call_once(debugLogInitFlag, &DebugLogInit);
 
-        if (fileout == nullptr) {
-            return ret;
-        }
-        std::lock_guard<std::mutex> lock(*mutexDebugLog);
-
-        // Reopen the log file, if requested
-        if (fReopenOmniCoreLog) {
-            fReopenOmniCoreLog = false;
-            fs::path pathDebug = GetLogPath();
-            if (freopen(pathDebug.string().c_str(), "a", fileout) != nullptr) {
-                setbuf(fileout, nullptr); // Unbuffered
-            }
-        }
+        // the log file may only be touched by the writer thread, so it's checked once the message is written
+        std::unique_lock<std::mutex> lock(*mutexDebugLog);
 
         // Printing log timestamps can be useful for profiling
+        std::string strLine;
         if (LogInstance().m_log_timestamps && fStartedNewLine) {
-            ret += fprintf(fileout, "%s ", GetTimestamp().c_str());
+            strLine = GetTimestamp() + " " + str;
+        } else {
+            strLine = str;
         }
         if (!str.empty() && str[str.size()-1] == '\n') {
             fStartedNewLine = true;
         } else {
             fStartedNewLine = false;
         }
-        ret += fwrite(str.data(), 1, str.size(), fileout);
+
+        if (!fDebugLogAsync) {
+            ReopenDebugLog();
+            if (fileout == nullptr) {
+                return ret;
+            }
+            ret = fwrite(strLine.data(), 1, strLine.size(), fileout);
+            fflush(fileout);
+            return ret;
+        }
+
+        if (nDebugLogQueued + strLine.size() > LOG_QUEUESIZE) {
+            ++nDebugLogDropped;
+            return ret;
+        }
+        ret = strLine.size();
+        bool fNotify = vDebugLogQueue->empty();
+        nDebugLogQueued += strLine.size();
+        vDebugLogQueue->push_back(std::move(strLine));
+        lock.unlock();
+
+        // the writer only waits, when the queue is empty
+        if (fNotify) condDebugLog->notify_one();
     }
 
     return ret;
 }
 
+/**
+ * Writes the queued messages, and stops the writer thread.
+ *
+ * Messages, which are logged afterwards, are written directly.
+ */
+void StopDebugLog()
+{
+    std::thread* thread = nullptr;
+    if (mutexDebugLog == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(*mutexDebugLog);
+        if (!fDebugLogAsync || fDebugLogStop) {
+            return;
+        }
+        fDebugLogStop = true;
+        thread = threadDebugLog;
+    }
+    condDebugLog->notify_all();
+    thread->join();
+}
+
 /**
  * Prints to the standard output, usually the console.
  *
@@ -200,6 +326,9 @@ int ConsolePrint(const std::string& str)
 {
     int ret = 0; // Number of characters written
     static bool fStartedNewLine = true;
+    // messages may be printed by several threads, such as when the databases are opened
+    static std::mutex mutexConsole;
+    std::lock_guard<std::mutex> lock(mutexConsole);
 
     if (LogInstance().m_log_timestamps && fStartedNewLine) {
         ret = fprintf(stdout, "%s %s", GetTimestamp().c_str(), str.c_str());
@@ -248,6 +377,7 @@ void InitDebugLogLevels()
         if (*it == "spec") msc_debug_spec = true;
         if (*it == "exo") msc_debug_exo = true;
         if (*it == "tally") msc_debug_tally = true;
+        if (*it == "tally_totals") msc_debug_tally_totals = true;
         if (*it == "sp") msc_debug_sp = true;
         if (*it == "sto") msc_debug_sto = true;
         if (*it == "txdb") msc_debug_txdb = true;
@@ -265,6 +395,7 @@ void InitDebugLogLevels()
         if (*it == "consensus_hash_every_block") msc_debug_consensus_hash_every_block = true;
         if (*it == "alerts") msc_debug_alerts = true;
         if (*it == "consensus_hash_every_transaction") msc_debug_consensus_hash_every_transaction = true;
+        if (*it == "consensus_delta") msc_debug_consensus_delta = true;
         if (*it == "fees") msc_debug_fees = true;
         if (*it == "nftdb") msc_debug_nftdb = true;
         if (*it == "none" || *it == "all") {
@@ -285,6 +416,7 @@ void InitDebugLogLevels()
             msc_debug_spec = allDebugState;
             msc_debug_exo = allDebugState;
             msc_debug_tally = allDebugState;
+            msc_debug_tally_totals = allDebugState;
             msc_debug_sp = allDebugState;
             msc_debug_sto = allDebugState;
             msc_debug_txdb = allDebugState;
@@ -302,6 +434,7 @@ void InitDebugLogLevels()
             msc_debug_consensus_hash_every_block = allDebugState;
             msc_debug_alerts = allDebugState;
             msc_debug_consensus_hash_every_transaction = allDebugState;
+            msc_debug_consensus_delta = allDebugState;
             msc_debug_fees = allDebugState;
             msc_debug_nftdb = allDebugState;
         }
@@ -1,14 +1,28 @@
 #ifndef BITCOIN_OMNICORE_LOG_H
 #define BITCOIN_OMNICORE_LOG_H
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
 #include <util/system.h>
 #include <tinyformat.h>
 
 #include <string>
 
+/** Whether the verbose debug categories are built in, see configure option --disable-omni-verbose-log. */
+#ifdef DISABLE_OMNI_VERBOSE_LOG
+static const bool OMNI_VERBOSE_LOG = false;
+#else
+static const bool OMNI_VERBOSE_LOG = true;
+#endif
+
 /** Prints to the log file. */
 int LogFilePrint(const std::string& str);
 
+/** Writes the queued log messages, and stops the log writer thread. */
+void StopDebugLog();
+
 /** Prints to the console. */
 int ConsolePrint(const std::string& str);
 
@@ -34,6 +48,7 @@ extern bool msc_debug_tokens;
 extern bool msc_debug_spec;
 extern bool msc_debug_exo;
 extern bool msc_debug_tally;
+extern bool msc_debug_tally_totals;
 extern bool msc_debug_sp;
 extern bool msc_debug_sto;
 extern bool msc_debug_txdb;
@@ -51,6 +66,7 @@ extern bool msc_debug_consensus_hash;
 extern bool msc_debug_consensus_hash_every_block;
 extern bool msc_debug_alerts;
 extern bool msc_debug_consensus_hash_every_transaction;
+extern bool msc_debug_consensus_delta;
 extern bool msc_debug_fees;
 extern bool msc_debug_nftdb;
 
@@ -83,5 +99,20 @@ TINYFORMAT_FOREACH_ARGNUM(MAKE_OMNI_CORE_ERROR_AND_LOG_FUNC)
 
 #undef MAKE_OMNI_CORE_ERROR_AND_LOG_FUNC
 
+/**
+ * Prints to the log file, if the debug category is enabled.
+ *
+ * The arguments are only evaluated, when the message is logged.
+ */
+#define PrintToLogIf(category, ...) do { if (category) PrintToLog(__VA_ARGS__); } while (0)
+
+/**
+ * Prints to the log file, if the verbose debug category is enabled.
+ *
+ * Verbose categories are off by default, and the call is removed by the compiler,
+ * if the verbose categories are not built in.
+ */
+#define PrintToLogVerbose(category, ...) do { if (OMNI_VERBOSE_LOG && (category)) PrintToLog(__VA_ARGS__); } while (0)
+
 
 #endif // BITCOIN_OMNICORE_LOG_H
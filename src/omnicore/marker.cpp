@@ -0,0 +1,168 @@
+/**
+ * @file marker.cpp
+ *
+ * This file contains the detection of Omni markers in transaction outputs.
+ */
+
+#include <omnicore/marker.h>
+
+#include <omnicore/omnicore.h>
+#include <omnicore/parsing.h>
+#include <omnicore/rules.h>
+#include <omnicore/script.h>
+#include <omnicore/utilsbitcoin.h>
+
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <script/standard.h>
+
+#include <stddef.h>
+#include <string.h>
+
+namespace mastercore
+{
+//! The class C marker "omni"
+static const unsigned char pchMarker[] = {0x6f, 0x6d, 0x6e, 0x69};
+//! The first block, where the marker bytes are searched on mainnet
+static const int FIRST_MARKER_SEARCH_BLOCK = 395000;
+
+/** Checks, if the marker bytes appear anywhere within the given data. */
+static bool ContainsMarker(const unsigned char* pch, size_t nSize)
+{
+    const unsigned char* pend = pch + nSize;
+    while (static_cast<size_t>(pend - pch) >= sizeof(pchMarker)) {
+        pch = static_cast<const unsigned char*>(memchr(pch, pchMarker[0], (pend - pch) - sizeof(pchMarker) + 1));
+        if (pch == nullptr) return false;
+        if (memcmp(pch, pchMarker, sizeof(pchMarker)) == 0) return true;
+        ++pch;
+    }
+    return false;
+}
+
+/** Returns the hash160 of a pay-to-pubkey-hash script, or nullptr, if it's not one. */
+static const unsigned char* GetPubKeyHash(const CScript& script)
+{
+    if (script.size() == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 &&
+            script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG) {
+        return script.data() + 3;
+    }
+    return nullptr;
+}
+
+/**
+ * Checks, if a script is a null data output, where the first pushed element
+ * equals, or starts with the marker.
+ *
+ * Equivalent to a TX_NULL_DATA output type, where the first element returned by
+ * GetScriptPushes() starts with the marker.
+ */
+static bool IsMarkedNullData(const CScript& script)
+{
+    if (script.size() < 2 || script[0] != OP_RETURN) return false;
+
+    bool fFirstPush = true;
+    bool fMarked = false;
+    CScript::const_iterator pc = script.begin() + 1;
+    while (pc < script.end()) {
+        CScript::const_iterator pcOp = pc;
+        opcodetype opcode;
+        if (!GetScriptOp(pc, script.end(), opcode, nullptr)) return false;
+        if (opcode > OP_16) return false;
+        if (opcode <= OP_PUSHDATA4 && fFirstPush) {
+            fFirstPush = false;
+            size_t nHeader = 1;
+            if (opcode == OP_PUSHDATA1) nHeader = 2;
+            if (opcode == OP_PUSHDATA2) nHeader = 3;
+            if (opcode == OP_PUSHDATA4) nHeader = 5;
+            CScript::const_iterator pcData = pcOp + nHeader;
+            fMarked = (static_cast<size_t>(pc - pcData) >= sizeof(pchMarker)) && memcmp(&*pcData, pchMarker, sizeof(pchMarker)) == 0;
+        }
+    }
+
+    return fMarked;
+}
+
+/**
+ * Scans the outputs of a transaction for Omni markers, and determines the encoding class.
+ *
+ * Encoding classes:
+ *   0 None
+ *   1 Class A (p2pkh)
+ *   2 Class B (multisig)
+ *   3 Class C (op-return)
+ */
+void ScanMarkers(const CTransaction& tx, int nBlock, CMarkerScan& scan)
+{
+    scan.nEncodingClass = NO_MARKER;
+    scan.nExodusOut = -1;
+    scan.nCrowdsaleOut = -1;
+    scan.nMultisigOut = -1;
+    scan.nDataOut = -1;
+    scan.nRawMarkerOut = -1;
+
+    const CTxDestination exodus = ExodusAddress();
+    const CTxDestination crowdsale = ExodusCrowdsaleAddress(nBlock);
+    const PKHash* pExodusHash = boost::get<PKHash>(&exodus);
+    const PKHash* pCrowdsaleHash = boost::get<PKHash>(&crowdsale);
+
+    const bool fAllowPubKeyHash = IsAllowedOutputType(TX_PUBKEYHASH, nBlock);
+    const bool fAllowMultisig = IsAllowedOutputType(TX_MULTISIG, nBlock);
+    const bool fAllowNullData = IsAllowedOutputType(TX_NULL_DATA, nBlock);
+
+    for (unsigned int n = 0; n < tx.vout.size(); ++n) {
+        const CScript& script = tx.vout[n].scriptPubKey;
+
+        const unsigned char* pchHash = GetPubKeyHash(script);
+        if (pchHash) {
+            if (scan.nExodusOut < 0 && pExodusHash && memcmp(pchHash, pExodusHash->begin(), 20) == 0) {
+                scan.nExodusOut = n;
+            }
+            if (scan.nCrowdsaleOut < 0 && pCrowdsaleHash && memcmp(pchHash, pCrowdsaleHash->begin(), 20) == 0) {
+                scan.nCrowdsaleOut = n;
+            }
+            continue;
+        }
+
+        if (!ContainsMarker(script.data(), script.size())) {
+            // bare multisig outputs are rare, so the full check is only done for candidates
+            if (scan.nMultisigOut < 0 && fAllowMultisig && !script.empty() && script.back() == OP_CHECKMULTISIG) {
+                txnouttype outType;
+                if (GetOutputType(script, outType) && outType == TX_MULTISIG) {
+                    scan.nMultisigOut = n;
+                }
+            }
+            continue;
+        }
+
+        if (scan.nRawMarkerOut < 0) {
+            scan.nRawMarkerOut = n;
+        }
+        if (scan.nDataOut < 0 && fAllowNullData && IsMarkedNullData(script)) {
+            scan.nDataOut = n;
+        }
+        if (scan.nMultisigOut < 0 && fAllowMultisig && script.back() == OP_CHECKMULTISIG) {
+            txnouttype outType;
+            if (GetOutputType(script, outType) && outType == TX_MULTISIG) {
+                scan.nMultisigOut = n;
+            }
+        }
+    }
+
+    // on mainnet, transactions are only examined closely, if there is an output to the
+    // Exodus address, or if class C is enabled and there are marker bytes anywhere
+    if (!isNonMainNet() && scan.nExodusOut < 0 && (nBlock < FIRST_MARKER_SEARCH_BLOCK || scan.nRawMarkerOut < 0)) {
+        return;
+    }
+
+    bool hasExodus = fAllowPubKeyHash && scan.nExodusOut >= 0;
+    bool hasMoney = fAllowPubKeyHash && scan.nCrowdsaleOut >= 0;
+
+    if (scan.nDataOut >= 0) {
+        scan.nEncodingClass = OMNI_CLASS_C;
+    } else if (hasExodus && scan.nMultisigOut >= 0) {
+        scan.nEncodingClass = OMNI_CLASS_B;
+    } else if (hasExodus || hasMoney) {
+        scan.nEncodingClass = OMNI_CLASS_A;
+    }
+}
+}
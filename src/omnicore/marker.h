@@ -0,0 +1,43 @@
+#ifndef BITCOIN_OMNICORE_MARKER_H
+#define BITCOIN_OMNICORE_MARKER_H
+
+class CTransaction;
+
+namespace mastercore
+{
+/** Omni markers found in the outputs of a transaction. */
+struct CMarkerScan
+{
+    //! The encoding class, as returned by GetEncodingClass()
+    int nEncodingClass;
+    //! Index of the first output to the Exodus address, or -1
+    int nExodusOut;
+    //! Index of the first output to the Exodus crowdsale address, or -1
+    int nCrowdsaleOut;
+    //! Index of the first bare multisig output, or -1
+    int nMultisigOut;
+    //! Index of the first null data output, where the first push starts with the marker, or -1
+    int nDataOut;
+    //! Index of the first output, which has the marker bytes anywhere in the script, or -1
+    int nRawMarkerOut;
+
+    /**
+     * Checks, if the transaction has any marker.
+     *
+     * Note: this may include invalid or malformed Omni Layer transactions!
+     *
+     * MUST NOT BE USED FOR CONSENSUS CRITICAL STUFF!
+     */
+    bool HasMarker() const { return nRawMarkerOut >= 0 || nExodusOut >= 0 || nCrowdsaleOut >= 0; }
+};
+
+/**
+ * Scans the outputs of a transaction for Omni markers, and determines the encoding class.
+ *
+ * The raw script bytes are examined in a single pass, without allocating memory,
+ * except for bare multisig outputs, which are rare.
+ */
+void ScanMarkers(const CTransaction& tx, int nBlock, CMarkerScan& scan);
+}
+
+#endif // BITCOIN_OMNICORE_MARKER_H
@@ -1,18 +1,26 @@
 #include <omnicore/mdex.h>
 
+#include <omnicore/consensushash.h>
+#include <omnicore/dbaddressindex.h>
 #include <omnicore/dbfees.h>
 #include <omnicore/dbtradelist.h>
 #include <omnicore/dbtxlist.h>
+#include <omnicore/indexproperties.h>
 #include <omnicore/log.h>
+#include <omnicore/memusage.h>
 #include <omnicore/rules.h>
 #include <omnicore/sp.h>
+#include <omnicore/statefile.h>
+#include <omnicore/trace.h>
 #include <omnicore/uint256_extensions.h>
 
-#include <arith_uint256.h>
 #include <chain.h>
 #include <hash.h>
+#include <memusage.h>
+#include <sync.h>
 #include <validation.h>
 #include <tinyformat.h>
+#include <ui_interface.h>
 #include <uint256.h>
 
 #include <univalue.h>
@@ -23,11 +31,16 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include <algorithm>
+#include <deque>
 #include <fstream>
 #include <limits>
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 typedef boost::multiprecision::cpp_dec_float_100 dec_float;
 typedef boost::multiprecision::checked_int128_t int128_t;
@@ -40,9 +53,297 @@ using namespace mastercore;
 //! Global map for price and order data
 md_PropertiesMap mastercore::metadex;
 
-md_PricesMap* mastercore::get_Prices(uint32_t prop)
+namespace {
+/**
+ * Pool of the addresses of MetaDEx orders.
+ *
+ * Addresses are only removed, when the whole state is cleared, so ids and references stay
+ * valid for copies of the orders in the undo journal and snapshots. Ids are never reused,
+ * and orders copied before the pool was cleared have the empty address, which has id 0.
+ */
+class CMPAddressPool
+{
+private:
+    mutable Mutex m_mutex;
+    //! Addresses by id, starting with the first id, a deque keeps references stable when appending
+    std::deque<std::string> m_addresses GUARDED_BY(m_mutex);
+    std::unordered_map<std::string, uint32_t> m_ids GUARDED_BY(m_mutex);
+    //! Id of the first address in the pool, addresses with lower ids were removed
+    uint32_t m_nFirstId GUARDED_BY(m_mutex);
+
+    static const std::string& Empty()
+    {
+        static const std::string strEmpty;
+        return strEmpty;
+    }
+
+public:
+    CMPAddressPool() : m_nFirstId(1) {}
+
+    uint32_t Intern(const std::string& address)
+    {
+        if (address.empty()) return 0;
+
+        LOCK(m_mutex);
+        std::unordered_map<std::string, uint32_t>::const_iterator it = m_ids.find(address);
+        if (it != m_ids.end()) return it->second;
+
+        assert(m_nFirstId + m_addresses.size() < std::numeric_limits<uint32_t>::max());
+        const uint32_t id = m_nFirstId + m_addresses.size();
+        m_addresses.push_back(address);
+        m_ids.emplace(address, id);
+        return id;
+    }
+
+    const std::string& Get(uint32_t id) const
+    {
+        LOCK(m_mutex);
+        if (id < m_nFirstId) return Empty();
+        assert(id - m_nFirstId < m_addresses.size());
+        return m_addresses[id - m_nFirstId];
+    }
+
+    /** Removes all addresses, while the ids of later addresses continue after the removed ones. */
+    void Clear()
+    {
+        LOCK(m_mutex);
+        m_nFirstId += m_addresses.size();
+        std::deque<std::string>().swap(m_addresses);
+        std::unordered_map<std::string, uint32_t>().swap(m_ids);
+    }
+
+    size_t DynamicMemoryUsage() const
+    {
+        LOCK(m_mutex);
+        size_t nUsage = memusage::DynamicUsage(m_ids) + m_addresses.size() * sizeof(std::string);
+        for (const std::string& address : m_addresses) {
+            nUsage += 2 * StringUsage(address);
+        }
+        return nUsage;
+    }
+};
+
+CMPAddressPool& AddressPool()
+{
+    // constructed on first use, as orders may be created during static initialization
+    static CMPAddressPool pool;
+    return pool;
+}
+
+/** Location of an open order in the MetaDEx maps. */
+struct md_OrderLocation
+{
+    md_PropertyPair pair;
+    rational_t price;
+    int block;
+    unsigned int idx;
+};
+
+/** Hasher for txids, which are already uniformly distributed. */
+struct md_TxidHasher
+{
+    size_t operator()(const uint256& txid) const { return txid.GetUint64(0); }
+};
+
+typedef std::unordered_map<uint256, md_OrderLocation, md_TxidHasher> md_TxidIndex;
+//! An open order as txid and location
+typedef std::pair<uint256, md_OrderLocation> md_OrderRef;
+
+//! Index of the open orders by txid
+md_TxidIndex md_txidIndex;
+//! Index of the txids of the open orders by address
+std::unordered_map<std::string, std::set<uint256> > md_addressIndex;
+//! Aggregated open orders by property pair and price
+std::map<md_PropertyPair, md_DepthMap> md_depth;
+//! Property pairs with modified orders, since the last call of MetaDEx_TakeModifiedPairs() by each consumer
+std::set<md_PropertyPair> md_modifiedPairs[MD_MODIFIED_CONSUMER_COUNT];
+//! Whether all orders were replaced, since the last call of MetaDEx_TakeModifiedPairs() by each consumer
+bool md_fModifiedAll[MD_MODIFIED_CONSUMER_COUNT] = {true, true};
+
+/** Marks all orders as replaced for every consumer of the modified pairs. */
+void MarkAllPairsModified()
+{
+    for (int consumer = 0; consumer < MD_MODIFIED_CONSUMER_COUNT; ++consumer) {
+        md_modifiedPairs[consumer].clear();
+        md_fModifiedAll[consumer] = true;
+    }
+}
+
+/** Adds an amount and a number of orders to the price level of an order, which is removed once it has no orders. */
+void UpdateDepth(const CMPMetaDEx& order, int64_t amount, int orders)
+{
+    // every change of an order passes through here, so it's also where the modified pairs are tracked
+    const md_PropertyPair pair(order.getProperty(), order.getDesProperty());
+    for (int consumer = 0; consumer < MD_MODIFIED_CONSUMER_COUNT; ++consumer) {
+        md_modifiedPairs[consumer].insert(pair);
+    }
+
+    std::map<md_PropertyPair, md_DepthMap>::iterator pairIt = md_depth.insert(std::make_pair(pair, md_DepthMap())).first;
+    md_DepthMap::iterator levelIt = pairIt->second.insert(std::make_pair(order.unitPrice(), md_DepthLevel())).first;
+
+    md_DepthLevel& level = levelIt->second;
+    level.amountRemaining += amount;
+    level.orders += orders;
+    assert(0 <= level.amountRemaining && 0 <= level.orders);
+
+    if (level.orders == 0) {
+        pairIt->second.erase(levelIt);
+        if (pairIt->second.empty()) md_depth.erase(pairIt);
+    }
+}
+
+void IndexOrder(const CMPMetaDEx& order)
+{
+    md_OrderLocation& location = md_txidIndex[order.getHash()];
+    location.pair = md_PropertyPair(order.getProperty(), order.getDesProperty());
+    location.price = order.unitPrice();
+    location.block = order.getBlock();
+    location.idx = order.getIdx();
+
+    md_addressIndex[order.getAddr()].insert(order.getHash());
+    UpdateDepth(order, order.getAmountRemaining(), 1);
+    CommitMetaDExOrder(order, true);
+}
+
+void UnindexOrder(const CMPMetaDEx& order)
+{
+    md_txidIndex.erase(order.getHash());
+    UpdateDepth(order, -order.getAmountRemaining(), -1);
+    CommitMetaDExOrder(order, false);
+
+    std::unordered_map<std::string, std::set<uint256> >::iterator it = md_addressIndex.find(order.getAddr());
+    if (it == md_addressIndex.end()) return;
+    it->second.erase(order.getHash());
+    if (it->second.empty()) md_addressIndex.erase(it);
+}
+
+/** Locates an open order in the MetaDEx maps, and returns false, if it's not there. */
+bool LocateOrder(const uint256& txid, const md_OrderLocation& location,
+        md_PropertiesMap::iterator& pairIt, md_PricesMap::iterator& priceIt, md_Set::iterator& orderIt)
+{
+    pairIt = metadex.find(location.pair);
+    if (pairIt == metadex.end()) return false;
+    priceIt = pairIt->second.find(location.price);
+    if (priceIt == pairIt->second.end()) return false;
+
+    // orders are sorted by block and position only, so a key object is sufficient for the lookup
+    const CMPMetaDEx key("", location.block, 0, 0, 0, 0, txid, location.idx, 0);
+    orderIt = priceIt->second.find(key);
+
+    return (orderIt != priceIt->second.end() && orderIt->getHash() == txid);
+}
+
+/** Locates an open order via the txid index, or returns nullptr. */
+const CMPMetaDEx* FindOrder(const uint256& txid)
+{
+    md_TxidIndex::const_iterator it = md_txidIndex.find(txid);
+    if (it == md_txidIndex.end()) return nullptr;
+
+    md_PropertiesMap::iterator pairIt;
+    md_PricesMap::iterator priceIt;
+    md_Set::iterator orderIt;
+    if (!LocateOrder(it->first, it->second, pairIt, priceIt, orderIt)) return nullptr;
+
+    return &(*orderIt);
+}
+
+/**
+ * Returns the open orders of an address via the address index.
+ *
+ * The orders are sorted by property for sale, price, block and position, which is
+ * the order in which cancellations are processed.
+ */
+std::vector<md_OrderRef> GetOrdersOfAddress(const std::string& address)
+{
+    std::vector<md_OrderRef> vOrders;
+    std::unordered_map<std::string, std::set<uint256> >::const_iterator it = md_addressIndex.find(address);
+    if (it == md_addressIndex.end()) return vOrders;
+
+    vOrders.reserve(it->second.size());
+    for (const uint256& txid : it->second) {
+        md_TxidIndex::const_iterator indexIt = md_txidIndex.find(txid);
+        assert(indexIt != md_txidIndex.end());
+        vOrders.push_back(*indexIt);
+    }
+    std::sort(vOrders.begin(), vOrders.end(), [](const md_OrderRef& lhs, const md_OrderRef& rhs) {
+        const md_OrderLocation& l = lhs.second;
+        const md_OrderLocation& r = rhs.second;
+        if (l.pair.first != r.pair.first) return l.pair.first < r.pair.first;
+        if (l.price != r.price) return l.price < r.price;
+        if (l.block != r.block) return l.block < r.block;
+        return l.idx < r.idx;
+    });
+
+    return vOrders;
+}
+
+//! Amounts to move from reserve to balance, aggregated by address and property
+typedef std::map<std::pair<std::string, uint32_t>, int64_t> md_ReserveMap;
+
+/** Moves the aggregated amounts from reserve to balance, with one tally update each. */
+void ReleaseReserves(const md_ReserveMap& reserves)
+{
+    for (const auto& entry : reserves) {
+        assert(update_tally_map(entry.first.first, entry.first.second, -entry.second, METADEX_RESERVE));
+        assert(update_tally_map(entry.first.first, entry.first.second, entry.second, BALANCE));
+    }
+}
+
+/**
+ * Cancels open orders in the given order.
+ *
+ * The orders are removed first, while their remaining amounts are aggregated by address
+ * and property. Then the reserves are released, the cancellations are recorded with a
+ * single database write, and the price levels and pairs left empty are removed.
+ */
+void CancelOrders(const uint256& txid, unsigned int block, const std::vector<md_OrderRef>& vOrders)
 {
-    md_PropertiesMap::iterator it = metadex.find(prop);
+    if (vOrders.empty()) return;
+
+    std::vector<CMPMetaDEx> vCancelled;
+    vCancelled.reserve(vOrders.size());
+    md_ReserveMap reserves;
+    std::vector<std::pair<md_PropertiesMap::iterator, md_PricesMap::iterator> > vEmptied;
+
+    for (const md_OrderRef& order : vOrders) {
+        md_PropertiesMap::iterator pairIt;
+        md_PricesMap::iterator priceIt;
+        md_Set::iterator orderIt;
+        assert(LocateOrder(order.first, order.second, pairIt, priceIt, orderIt));
+
+        PrintToLog("%s(): REMOVING %s\n", __func__, orderIt->ToString());
+
+        reserves[std::make_pair(orderIt->getAddr(), orderIt->getProperty())] += orderIt->getAmountRemaining();
+        vCancelled.push_back(*orderIt);
+
+        UnindexOrder(*orderIt);
+        priceIt->second.erase(orderIt);
+        // a level is emptied only once, and stays in place until all orders are removed
+        if (priceIt->second.empty()) vEmptied.push_back(std::make_pair(pairIt, priceIt));
+    }
+
+    // move from reserve to balance
+    ReleaseReserves(reserves);
+
+    // record the cancellations
+    bool bValid = true;
+    pDbTransactionList->recordMetaDExCancelTX(txid, bValid, block, vCancelled);
+
+    for (const CMPMetaDEx& order : vCancelled) {
+        uiInterface.OmniMetaDExOrderChanged(order, CT_DELETED);
+    }
+
+    for (const auto& emptied : vEmptied) {
+        md_PropertiesMap::iterator pairIt = emptied.first;
+        pairIt->second.erase(emptied.second);
+        if (pairIt->second.empty()) metadex.erase(pairIt);
+    }
+}
+} // anonymous namespace
+
+md_PricesMap* mastercore::get_Prices(uint32_t propertyForSale, uint32_t propertyDesired)
+{
+    md_PropertiesMap::iterator it = metadex.find(md_PropertyPair(propertyForSale, propertyDesired));
 
     if (it != metadex.end()) return &(it->second);
 
@@ -137,10 +438,12 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
     MatchReturnType NewReturn = NOTHING;
     bool bBuyerSatisfied = false;
 
-    if (msc_debug_metadex1) PrintToLog("%s(%s: prop=%d, desprop=%d, desprice= %s);newo: %s\n",
+    PrintToLogVerbose(msc_debug_metadex1, "%s(%s: prop=%d, desprop=%d, desprice= %s);newo: %s\n",
         __FUNCTION__, pnew->getAddr(), propertyForSale, propertyDesired, xToString(pnew->inversePrice()), pnew->ToString());
 
-    md_PricesMap* const ppriceMap = get_Prices(propertyDesired);
+    // the offers selling the desired property for the property of this order
+    const md_PropertyPair marketPair(propertyDesired, propertyForSale);
+    md_PricesMap* const ppriceMap = get_Prices(marketPair.first, marketPair.second);
 
     // nothing for the desired property exists in the market, sorry!
     if (!ppriceMap) {
@@ -148,45 +451,48 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
         return NewReturn;
     }
 
-    // within the desired property map (given one property) iterate over the items looking at prices
-    for (md_PricesMap::iterator priceIt = ppriceMap->begin(); priceIt != ppriceMap->end(); ++priceIt) { // check all prices
-        const rational_t sellersPrice = priceIt->first;
+    // within the map of the property pair iterate over the items looking at prices
+    md_PricesMap::iterator priceIt = ppriceMap->begin();
+    while (priceIt != ppriceMap->end()) { // check all prices
+        const rational_t& sellersPrice = priceIt->first;
+        md_Set* const pofferSet = &(priceIt->second);
+
+        // price levels are erased, once their last offer is gone, but an empty one is skipped anyway
+        if (pofferSet->empty()) {
+            ++priceIt;
+            continue;
+        }
 
-        if (msc_debug_metadex2) PrintToLog("comparing prices: desprice %s needs to be GREATER THAN OR EQUAL TO %s\n",
+        PrintToLogVerbose(msc_debug_metadex2, "comparing prices: desprice %s needs to be GREATER THAN OR EQUAL TO %s\n",
             xToString(pnew->inversePrice()), xToString(sellersPrice));
 
         // Is the desired price check satisfied? The buyer's inverse price must be larger than that of the seller.
-        if (pnew->inversePrice() < sellersPrice) {
-            continue;
+        // The prices are in ascending order, so none of the following price levels can match either.
+        // All offers of a price level have the same unit price, so the amounts of the first one are compared.
+        const CMPMetaDEx& first = *pofferSet->begin();
+        if (xIsLess(pnew->getAmountForSale(), pnew->getAmountDesired(), first.getAmountDesired(), first.getAmountForSale())) {
+            break;
         }
 
-        md_Set* const pofferSet = &(priceIt->second);
-
         // at good (single) price level and property iterate over offers looking at all parameters to find the match
         md_Set::iterator offerIt = pofferSet->begin();
         while (offerIt != pofferSet->end()) { // specific price, check all properties
             const CMPMetaDEx* const pold = &(*offerIt);
             assert(pold->unitPrice() == sellersPrice);
 
-            if (msc_debug_metadex1) PrintToLog("Looking at existing: %s (its prop= %d, its des prop= %d) = %s\n",
+            PrintToLogVerbose(msc_debug_metadex1, "Looking at existing: %s (its prop= %d, its des prop= %d) = %s\n",
                 xToString(sellersPrice), pold->getProperty(), pold->getDesProperty(), pold->ToString());
 
-            // does the desired property match?
-            if (pold->getDesProperty() != propertyForSale) {
-                ++offerIt;
-                continue;
-            }
-
-            if (msc_debug_metadex1) PrintToLog("MATCH FOUND, Trade: %s = %s\n", xToString(sellersPrice), pold->ToString());
+            PrintToLogVerbose(msc_debug_metadex1, "MATCH FOUND, Trade: %s = %s\n", xToString(sellersPrice), pold->ToString());
 
             // match found, execute trade now!
             const int64_t seller_amountForSale = pold->getAmountRemaining();
             const int64_t buyer_amountOffered = pnew->getAmountRemaining();
 
-            if (msc_debug_metadex1) PrintToLog("$$ trading using price: %s; seller: forsale=%d, desired=%d, remaining=%d, buyer amount offered=%d\n",
+            PrintToLogVerbose(msc_debug_metadex1, "$$ trading using price: %s; seller: forsale=%d, desired=%d, remaining=%d, buyer amount offered=%d\n",
                 xToString(sellersPrice), pold->getAmountForSale(), pold->getAmountDesired(), pold->getAmountRemaining(), pnew->getAmountRemaining());
-            if (msc_debug_metadex1) PrintToLog("$$ old: %s\n", pold->ToString());
-            if (msc_debug_metadex1) PrintToLog("$$ new: %s\n", pnew->ToString());
+            PrintToLogVerbose(msc_debug_metadex1, "$$ old: %s\n", pold->ToString());
+            PrintToLogVerbose(msc_debug_metadex1, "$$ new: %s\n", pnew->ToString());
 
             ///////////////////////////
 
@@ -196,8 +502,8 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             assert(pnew->getProperty() != pnew->getDesProperty());
             assert(pnew->getProperty() == pold->getDesProperty());
             assert(pold->getProperty() == pnew->getDesProperty());
-            assert(pold->unitPrice() <= pnew->inversePrice());
-            assert(pnew->unitPrice() <= pold->inversePrice());
+            // the unit price of the old order must not exceed the inverse price of the new one, and vice versa
+            assert(!xIsLess(pnew->getAmountForSale(), pnew->getAmountDesired(), pold->getAmountDesired(), pold->getAmountForSale()));
 
             ///////////////////////////
 
@@ -205,17 +511,14 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             // purchase from Bob, using Bob's unit price
             // This implies rounding down, since rounding up is impossible, and would
             // require more tokens than Alice has
-            arith_uint256 iCouldBuy = (ConvertTo256(pnew->getAmountRemaining()) * ConvertTo256(pold->getAmountForSale())) / ConvertTo256(pold->getAmountDesired());
-
             int64_t nCouldBuy = 0;
-            if (iCouldBuy < ConvertTo256(pold->getAmountRemaining())) {
-                nCouldBuy = ConvertTo64(iCouldBuy);
-            } else {
+            if (!CheckedMultiplyAndDivide(pnew->getAmountRemaining(), pold->getAmountForSale(), pold->getAmountDesired(), false, nCouldBuy) ||
+                    nCouldBuy > pold->getAmountRemaining()) {
                 nCouldBuy = pold->getAmountRemaining();
             }
 
             if (nCouldBuy == 0) {
-                if (msc_debug_metadex1) PrintToLog(
+                PrintToLogVerbose(msc_debug_metadex1,
                         "-- buyer has not enough tokens for sale to purchase one unit!\n");
                 ++offerIt;
                 continue;
@@ -225,16 +528,13 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             // is fractional, always round UP the amount Alice has to pay
             // This will always be better for Bob. Rounding in the other direction
             // will always be impossible, because it would violate Bob's accepted price
-            arith_uint256 iWouldPay = DivideAndRoundUp((ConvertTo256(nCouldBuy) * ConvertTo256(pold->getAmountDesired())), ConvertTo256(pold->getAmountForSale()));
-            int64_t nWouldPay = ConvertTo64(iWouldPay);
+            int64_t nWouldPay = MultiplyAndDivideRoundUp(nCouldBuy, pold->getAmountDesired(), pold->getAmountForSale());
 
             // If the resulting adjusted unit price is higher than Alice' price, the
             // orders shall not execute, and no representable fill is made
-            const rational_t xEffectivePrice(nWouldPay, nCouldBuy);
-
-            if (xEffectivePrice > pnew->inversePrice()) {
-                if (msc_debug_metadex1) PrintToLog(
-                        "-- effective price is too expensive: %s\n", xToString(xEffectivePrice));
+            if (xIsLess(pnew->getAmountForSale(), pnew->getAmountDesired(), nWouldPay, nCouldBuy)) {
+                PrintToLogVerbose(msc_debug_metadex1,
+                        "-- effective price is too expensive: %s\n", xToString(rational_t(nWouldPay, nCouldBuy)));
                 ++offerIt;
                 continue;
             }
@@ -244,14 +544,14 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             const int64_t buyer_amountLeft = pnew->getAmountRemaining() - seller_amountGot;
             const int64_t seller_amountLeft = pold->getAmountRemaining() - buyer_amountGot;
 
-            if (msc_debug_metadex1) PrintToLog("$$ buyer_got= %d, seller_got= %d, seller_left_for_sale= %d, buyer_still_for_sale= %d\n",
+            PrintToLogVerbose(msc_debug_metadex1, "$$ buyer_got= %d, seller_got= %d, seller_left_for_sale= %d, buyer_still_for_sale= %d\n",
                 buyer_amountGot, seller_amountGot, seller_amountLeft, buyer_amountLeft);
 
             ///////////////////////////
 
             // postconditions
-            assert(xEffectivePrice >= pold->unitPrice());
-            assert(xEffectivePrice <= pnew->inversePrice());
+            assert(!xIsLess(nWouldPay, nCouldBuy, pold->getAmountDesired(), pold->getAmountForSale()));
+            assert(!xIsLess(pnew->getAmountForSale(), pnew->getAmountDesired(), nWouldPay, nCouldBuy));
             assert(0 <= seller_amountLeft);
             assert(0 <= buyer_amountLeft);
             assert(seller_amountForSale == seller_amountLeft + buyer_amountGot);
@@ -274,7 +574,7 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
                     // add the fee to the fee cache
                     pDbFeeCache->AddFee(pnew->getDesProperty(), pnew->getBlock(), tradingFee);
                 } else {
-                    if (msc_debug_fees) PrintToLog("Skipping fee reduction for trade match %s:%s as one of the properties is Omni\n", pold->getHash().GetHex(), pnew->getHash().GetHex());
+                    PrintToLogIf(msc_debug_fees, "Skipping fee reduction for trade match %s:%s as one of the properties is Omni\n", pold->getHash().GetHex(), pnew->getHash().GetHex());
                 }
             }
 
@@ -288,9 +588,6 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
 
             NewReturn = TRADED;
 
-            CMPMetaDEx seller_replacement = *pold; // < can be moved into last if block
-            seller_replacement.setAmountRemaining(seller_amountLeft, "seller_replacement");
-
             pnew->setAmountRemaining(buyer_amountLeft, "buyer");
 
             if (0 < buyer_amountLeft) {
@@ -305,20 +602,35 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
                 NewReturn = TRADED_MOREINSELLER;
             }
 
-            if (msc_debug_metadex1) PrintToLog("==== TRADED !!! %u=%s\n", NewReturn, getTradeReturnType(NewReturn));
+            PrintToLogVerbose(msc_debug_metadex1, "==== TRADED !!! %u=%s\n", NewReturn, getTradeReturnType(NewReturn));
+            OMNI_TRACE6(metadex_match, pnew->getHash().begin(), pold->getHash().begin(), pold->getProperty(), pold->getDesProperty(), buyer_amountGot, seller_amountGot);
 
             // record the trade in MPTradeList
-            pDbTradeList->recordMatchedTrade(pold->getHash(), pnew->getHash(), // < might just pass pold, pnew
-                pold->getAddr(), pnew->getAddr(), pold->getDesProperty(), pnew->getDesProperty(), seller_amountGot, buyer_amountGotAfterFee, pnew->getBlock(), tradingFee);
+            if (IsIndexedProperty(pold->getDesProperty()) || IsIndexedProperty(pnew->getDesProperty())) {
+                pDbTradeList->recordMatchedTrade(pold->getHash(), pnew->getHash(), // < might just pass pold, pnew
+                    pold->getAddr(), pnew->getAddr(), pold->getDesProperty(), pnew->getDesProperty(), seller_amountGot, buyer_amountGotAfterFee, pnew->getBlock(), tradingFee);
+            }
+            // the maker takes part in the transaction of the taker
+            if (pDbAddressIndex) pDbAddressIndex->RecordAddress(pold->getAddr(), ADDRESS_ROLE_TRADE_COUNTERPARTY);
+            uiInterface.OmniMetaDExTrade(*pold, *pnew, buyer_amountGot, seller_amountGot, tradingFee);
+
+            // the sold amount is no longer up for sale at this price
+            UpdateDepth(*pold, -buyer_amountGot, 0);
 
-            if (msc_debug_metadex1) PrintToLog("++ erased old: %s\n", offerIt->ToString());
-            // erase the old seller element
-            pofferSet->erase(offerIt++);
+            // the remaining amount is not part of the ordering, so the seller's order is updated in place
+            CMPMetaDEx& seller = const_cast<CMPMetaDEx&>(*offerIt);
+            CommitMetaDExOrder(seller, false);
+            seller.setAmountRemaining(seller_amountLeft, "seller");
+            CommitMetaDExOrder(seller, true);
 
-            // insert the updated one in place of the old
-            if (0 < seller_replacement.getAmountRemaining()) {
-                PrintToLog("++ inserting seller_replacement: %s\n", seller_replacement.ToString());
-                pofferSet->insert(seller_replacement);
+            if (0 < seller_amountLeft) {
+                uiInterface.OmniMetaDExOrderChanged(seller, CT_UPDATED);
+                ++offerIt;
+            } else {
+                uiInterface.OmniMetaDExOrderChanged(seller, CT_DELETED);
+                UnindexOrder(seller);
+                PrintToLogVerbose(msc_debug_metadex1, "++ erased old: %s\n", offerIt->ToString());
+                offerIt = pofferSet->erase(offerIt);
             }
 
             if (bBuyerSatisfied) {
@@ -327,9 +639,18 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             }
         } // specific price, check all properties
 
+        // remove the price level, once all offers were filled
+        if (pofferSet->empty()) {
+            priceIt = ppriceMap->erase(priceIt);
+        } else {
+            ++priceIt;
+        }
+
         if (bBuyerSatisfied) break;
     } // check all prices
 
+    if (ppriceMap->empty()) metadex.erase(marketPair);
+
     PrintToLog("%s()=%d:%s\n", __FUNCTION__, NewReturn, getTradeReturnType(NewReturn));
 
     return NewReturn;
@@ -369,27 +690,45 @@ std::string CMPMetaDEx::displayUnitPrice() const
  */
 std::string CMPMetaDEx::displayFullUnitPrice() const
 {
-    rational_t tempUnitPrice = unitPrice();
+    return xToFullUnitPriceString(unitPrice(), getProperty(), getDesProperty());
+}
+
+/**
+ * Used for display of unit prices of a property pair with 50 decimal places at RPC layer.
+ */
+std::string xToFullUnitPriceString(const rational_t& unitPrice, uint32_t propertyForSale, uint32_t propertyDesired)
+{
+    rational_t tempUnitPrice = unitPrice;
 
     /* Matching types require no action (divisible/divisible or indivisible/indivisible)
        Non-matching types require adjustment for display purposes
            divisible/indivisible   : *COIN
            indivisible/divisible   : /COIN
     */
-    if ( isPropertyDivisible(getProperty()) && !isPropertyDivisible(getDesProperty()) ) tempUnitPrice = tempUnitPrice*COIN;
-    if ( !isPropertyDivisible(getProperty()) && isPropertyDivisible(getDesProperty()) ) tempUnitPrice = tempUnitPrice/COIN;
+    if ( isPropertyDivisible(propertyForSale) && !isPropertyDivisible(propertyDesired) ) tempUnitPrice = tempUnitPrice*COIN;
+    if ( !isPropertyDivisible(propertyForSale) && isPropertyDivisible(propertyDesired) ) tempUnitPrice = tempUnitPrice/COIN;
 
     std::string unitPriceStr = xToString(tempUnitPrice);
     return unitPriceStr;
 }
 
-rational_t CMPMetaDEx::unitPrice() const
+rational_t CMPMetaDEx::calculateUnitPrice(int64_t amountForSale, int64_t amountDesired)
 {
     rational_t effectivePrice;
-    if (amount_forsale) effectivePrice = rational_t(amount_desired, amount_forsale);
+    if (amountForSale) effectivePrice = rational_t(amountDesired, amountForSale);
     return effectivePrice;
 }
 
+uint32_t CMPMetaDEx::internAddress(const std::string& address)
+{
+    return AddressPool().Intern(address);
+}
+
+const std::string& CMPMetaDEx::getAddr() const
+{
+    return AddressPool().Get(addr_id);
+}
+
 rational_t CMPMetaDEx::inversePrice() const
 {
     rational_t inversePrice;
@@ -400,9 +739,7 @@ rational_t CMPMetaDEx::inversePrice() const
 int64_t CMPMetaDEx::getAmountToFill() const
 {
     // round up to ensure that the amount we present will actually result in buying all available tokens
-    arith_uint256 iAmountNeededToFill = DivideAndRoundUp((ConvertTo256(amount_remaining) * ConvertTo256(amount_desired)), ConvertTo256(amount_forsale));
-    int64_t nAmountNeededToFill = ConvertTo64(iAmountNeededToFill);
-    return nAmountNeededToFill;
+    return MultiplyAndDivideRoundUp(amount_remaining, amount_desired, amount_forsale);
 }
 
 int64_t CMPMetaDEx::getBlockTime() const
@@ -414,36 +751,20 @@ int64_t CMPMetaDEx::getBlockTime() const
 void CMPMetaDEx::setAmountRemaining(int64_t amount, const std::string& label)
 {
     amount_remaining = amount;
-    PrintToLog("update remaining amount still up for sale (%ld %s):%s\n", amount, label, ToString());
+    PrintToLogVerbose(msc_debug_metadex1, "update remaining amount still up for sale (%ld %s):%s\n", amount, label, ToString());
 }
 
 std::string CMPMetaDEx::ToString() const
 {
     return strprintf("%s:%34s in %d/%03u, txid: %s , trade #%u %s for #%u %s",
-        xToString(unitPrice()), addr, block, idx, txid.ToString().substr(0, 10),
+        xToString(unitPrice()), getAddr(), block, idx, txid.ToString().substr(0, 10),
         property, FormatMP(property, amount_forsale), desired_property, FormatMP(desired_property, amount_desired));
 }
 
-void CMPMetaDEx::saveOffer(std::ofstream& file, CHash256 &hasher) const
+void CMPMetaDEx::saveOffer(CStateFileWriter& writer) const
 {
-    std::string lineOut = strprintf("%s,%d,%d,%d,%d,%d,%d,%d,%s,%d",
-        addr,
-        block,
-        amount_forsale,
-        property,
-        amount_desired,
-        desired_property,
-        subaction,
-        idx,
-        txid.ToString(),
-        amount_remaining
-    );
-
-    // add the line to the hash
-    hasher.Write((unsigned char*)lineOut.c_str(), lineOut.length());
-
-    // write the line
-    file << lineOut << std::endl;
+    writer.WriteRecord(getAddr(), VARBLOCK(block), VARAMOUNT(amount_forsale), VARINT(property), VARAMOUNT(amount_desired),
+            VARINT(desired_property), subaction, VARINT(idx), txid, VARAMOUNT(amount_remaining));
 }
 
 bool MetaDEx_compare::operator()(const CMPMetaDEx &lhs, const CMPMetaDEx &rhs) const
@@ -454,37 +775,74 @@ bool MetaDEx_compare::operator()(const CMPMetaDEx &lhs, const CMPMetaDEx &rhs) c
 
 bool mastercore::MetaDEx_INSERT(const CMPMetaDEx& objMetaDEx)
 {
-    // Create an empty price map (to use in case price map for this property does not already exist)
-    md_PricesMap temp_prices;
-    // Attempt to obtain the price map for the property
-    md_PricesMap *p_prices = get_Prices(objMetaDEx.getProperty());
+    // Obtain the price map for the property pair, and the set of metadex objects at this price, which are created, if they don't exist
+    md_PricesMap& prices = metadex[md_PropertyPair(objMetaDEx.getProperty(), objMetaDEx.getDesProperty())];
+    md_Set& indexes = prices[objMetaDEx.unitPrice()];
 
-    // Create an empty set of metadex objects (to use in case no set currently exists at this price)
-    md_Set temp_indexes;
-    md_Set *p_indexes = nullptr;
+    // Attempt to insert the metadex object into the set, which fails only if it already exists, so nothing empty is left behind
+    std::pair<md_Set::iterator, bool> ret = indexes.insert(objMetaDEx);
+    if (ret.second) IndexOrder(objMetaDEx);
 
-    // Prepare for return code
-    std::pair <md_Set::iterator, bool> ret;
+    return ret.second;
+}
 
-    // Attempt to obtain a set of metadex objects for this price from the price map
-    if (p_prices) p_indexes = get_Indexes(p_prices, objMetaDEx.unitPrice());
-    // See if the set was populated, if not no set exists at this price level, use the empty set that we created earlier
-    if (!p_indexes) p_indexes = &temp_indexes;
+void mastercore::CMetaDExLoader::Reserve(size_t nOrders)
+{
+    md_txidIndex.reserve(nOrders);
+}
 
-    // Attempt to insert the metadex object into the set
-    ret = p_indexes->insert(objMetaDEx);
-    if (false == ret.second) return false;
+bool mastercore::CMetaDExLoader::Insert(const CMPMetaDEx& objMetaDEx)
+{
+    // the pair and the price of the previous order are reused, and new ones are appended
+    const md_PropertyPair pair(objMetaDEx.getProperty(), objMetaDEx.getDesProperty());
+    if (!m_fPair || m_itPair->first != pair) {
+        m_itPair = metadex.emplace_hint(metadex.end(), pair, md_PricesMap());
+        m_fPair = true;
+        m_fPrice = false;
+    }
+    md_PricesMap& prices = m_itPair->second;
+    const rational_t price = objMetaDEx.unitPrice();
+    if (!m_fPrice || m_itPrice->first != price) {
+        m_itPrice = prices.emplace_hint(prices.end(), price, md_Set());
+        m_fPrice = true;
+    }
+    md_Set& indexes = m_itPrice->second;
 
-    // If a prices map did not exist for this property, set p_prices to the temp empty price map
-    if (!p_prices) p_prices = &temp_prices;
+    const size_t nSize = indexes.size();
+    md_Set::iterator it = indexes.insert(indexes.end(), objMetaDEx);
+    if (indexes.size() == nSize) return false;
+    IndexOrder(*it);
 
-    // Update the prices map with the new set at this price
-    (*p_prices)[objMetaDEx.unitPrice()] = *p_indexes;
+    return true;
+}
 
-    // Set the metadex map for the property to the updated (or new if it didn't exist) price map
-    metadex[objMetaDEx.getProperty()] = *p_prices;
+void mastercore::MetaDEx_CLEAR()
+{
+    metadex.clear();
+    md_txidIndex.clear();
+    md_addressIndex.clear();
+    md_depth.clear();
+    MarkAllPairsModified();
+    InvalidateStateCommitment();
+}
 
-    return true;
+void mastercore::MetaDEx_RebuildIndex()
+{
+    md_txidIndex.clear();
+    md_addressIndex.clear();
+    md_depth.clear();
+    // the orders were replaced as a whole, so the commitment is rebuilt when needed
+    MarkAllPairsModified();
+    InvalidateStateCommitment();
+    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        const md_PricesMap& prices = my_it->second;
+        for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+            const md_Set& indexes = it->second;
+            for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                IndexOrder(*it);
+            }
+        }
+    }
 }
 
 // pretty much directly linked to the ADD TX21 command off the wire
@@ -494,7 +852,7 @@ int mastercore::MetaDEx_ADD(const std::string& sender_addr, uint32_t prop, int64
 
     // Create a MetaDEx object from parameters
     CMPMetaDEx new_mdex(sender_addr, block, prop, amount, property_desired, amount_desired, txid, idx, CMPTransaction::ADD);
-    if (msc_debug_metadex1) PrintToLog("%s(); buyer obj: %s\n", __FUNCTION__, new_mdex.ToString());
+    PrintToLogVerbose(msc_debug_metadex1, "%s(); buyer obj: %s\n", __FUNCTION__, new_mdex.ToString());
 
     // Ensure this is not a badly priced trade (for example due to zero amounts)
     if (0 >= new_mdex.unitPrice()) return METADEX_ERROR -66;
@@ -504,6 +862,11 @@ int mastercore::MetaDEx_ADD(const std::string& sender_addr, uint32_t prop, int64
     x_Trade(&new_mdex);
     if (msc_debug_metadex3) MetaDEx_debug_print();
 
+    // an order matched completely on arrival is never added to the order book, but still filled
+    if (0 == new_mdex.getAmountRemaining()) {
+        uiInterface.OmniMetaDExOrderChanged(new_mdex, CT_DELETED);
+    }
+
     // Insert the remaining order into the MetaDEx maps
     if (0 < new_mdex.getAmountRemaining()) { //switch to getAmountRemaining() when ready
         if (!MetaDEx_INSERT(new_mdex)) {
@@ -513,8 +876,9 @@ int mastercore::MetaDEx_ADD(const std::string& sender_addr, uint32_t prop, int64
             // move tokens into reserve
             assert(update_tally_map(sender_addr, prop, -new_mdex.getAmountRemaining(), BALANCE));
             assert(update_tally_map(sender_addr, prop, new_mdex.getAmountRemaining(), METADEX_RESERVE));
+            uiInterface.OmniMetaDExOrderChanged(new_mdex, CT_NEW);
 
-            if (msc_debug_metadex1) PrintToLog("==== INSERTED: %s= %s\n", xToString(new_mdex.unitPrice()), new_mdex.ToString());
+            PrintToLogVerbose(msc_debug_metadex1, "==== INSERTED: %s= %s\n", xToString(new_mdex.unitPrice()), new_mdex.ToString());
             if (msc_debug_metadex3) MetaDEx_debug_print();
         }
     }
@@ -527,10 +891,9 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
 {
     int rc = METADEX_ERROR -20;
     CMPMetaDEx mdex(sender_addr, 0, prop, amount, property_desired, amount_desired, uint256(), 0, CMPTransaction::CANCEL_AT_PRICE);
-    md_PricesMap* prices = get_Prices(prop);
-    const CMPMetaDEx* p_mdex = nullptr;
+    md_PricesMap* prices = get_Prices(prop, property_desired);
 
-    if (msc_debug_metadex1) PrintToLog("%s():%s\n", __FUNCTION__, mdex.ToString());
+    PrintToLogVerbose(msc_debug_metadex1, "%s():%s\n", __FUNCTION__, mdex.ToString());
 
     if (msc_debug_metadex2) MetaDEx_debug_print();
 
@@ -539,38 +902,17 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
         return rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
-    for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
-        rational_t sellers_price = my_it->first;
-
-        if (mdex.unitPrice() != sellers_price) continue;
-
-        md_Set* indexes = &(my_it->second);
-
-        for (md_Set::iterator iitt = indexes->begin(); iitt != indexes->end();) {
-            p_mdex = &(*iitt);
-
-            if (msc_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
-
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
-                ++iitt;
-                continue;
-            }
-
-            rc = 0;
-            PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
-
-            // move from reserve to main
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
+    // only the orders of the sender at the given price of the property pair are cancelled
+    const md_PropertyPair pair(prop, property_desired);
+    const rational_t price = mdex.unitPrice();
+    std::vector<md_OrderRef> vCancel;
+    for (const md_OrderRef& order : GetOrdersOfAddress(sender_addr)) {
+        if (order.second.pair != pair || order.second.price != price) continue;
 
-            // record the cancellation
-            bool bValid = true;
-            pDbTransactionList->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
-
-            indexes->erase(iitt++);
-        }
+        rc = 0;
+        vCancel.push_back(order);
     }
+    CancelOrders(txid, block, vCancel);
 
     if (msc_debug_metadex2) MetaDEx_debug_print();
 
@@ -580,8 +922,7 @@ int mastercore::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block,
 int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int block, const std::string& sender_addr, uint32_t prop, uint32_t property_desired)
 {
     int rc = METADEX_ERROR -30;
-    md_PricesMap* prices = get_Prices(prop);
-    const CMPMetaDEx* p_mdex = nullptr;
+    md_PricesMap* prices = get_Prices(prop, property_desired);
 
     PrintToLog("%s(%d,%d)\n", __FUNCTION__, prop, property_desired);
 
@@ -592,34 +933,16 @@ int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int bl
         return rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
-    for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
-        md_Set* indexes = &(my_it->second);
-
-        for (md_Set::iterator iitt = indexes->begin(); iitt != indexes->end();) {
-            p_mdex = &(*iitt);
+    // the orders of the sender are cancelled by price, and then by block and position
+    const md_PropertyPair pair(prop, property_desired);
+    std::vector<md_OrderRef> vCancel;
+    for (const md_OrderRef& order : GetOrdersOfAddress(sender_addr)) {
+        if (order.second.pair != pair) continue;
 
-            if (msc_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
-
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
-                ++iitt;
-                continue;
-            }
-
-            rc = 0;
-            PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
-
-            // move from reserve to main
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
-
-            // record the cancellation
-            bool bValid = true;
-            pDbTransactionList->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
-
-            indexes->erase(iitt++);
-        }
+        rc = 0;
+        vCancel.push_back(order);
     }
+    CancelOrders(txid, block, vCancel);
 
     if (msc_debug_metadex3) MetaDEx_debug_print();
 
@@ -627,7 +950,10 @@ int mastercore::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int bl
 }
 
 /**
- * Scans the orderbook and remove everything for an address.
+ * Removes everything for an address.
+ *
+ * For every property for sale, the orders of all pairs are cancelled by price,
+ * and then by block and position, as if the pairs shared a single book.
  */
 int mastercore::MetaDEx_CANCEL_EVERYTHING(const uint256& txid, unsigned int block, const std::string& sender_addr, unsigned char ecosystem)
 {
@@ -639,45 +965,20 @@ int mastercore::MetaDEx_CANCEL_EVERYTHING(const uint256& txid, unsigned int bloc
 
     PrintToLog("<<<<<<\n");
 
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        unsigned int prop = my_it->first;
+    std::vector<md_OrderRef> vCancel;
+    for (const md_OrderRef& order : GetOrdersOfAddress(sender_addr)) {
+        const uint32_t prop = order.second.pair.first;
 
         // skip property, if it is not in the expected ecosystem
-        if (isMainEcosystemProperty(ecosystem) && !isMainEcosystemProperty(prop)) continue;
-        if (isTestEcosystemProperty(ecosystem) && !isTestEcosystemProperty(prop)) continue;
-
-        PrintToLog(" ## property: %u\n", prop);
-        md_PricesMap& prices = my_it->second;
-
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            rational_t price = it->first;
-            md_Set& indexes = it->second;
-
-            PrintToLog("  # Price Level: %s\n", xToString(price));
-
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                PrintToLog("%s= %s\n", xToString(price), it->ToString());
-
-                if (it->getAddr() != sender_addr) {
-                    ++it;
-                    continue;
-                }
-
-                rc = 0;
-                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
-
-                // move from reserve to balance
-                assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-
-                // record the cancellation
-                bool bValid = true;
-                pDbTransactionList->recordMetaDExCancelTX(txid, it->getHash(), bValid, block, it->getProperty(), it->getAmountRemaining());
-
-                indexes.erase(it++);
-            }
+        if ((isMainEcosystemProperty(ecosystem) && !isMainEcosystemProperty(prop)) ||
+                (isTestEcosystemProperty(ecosystem) && !isTestEcosystemProperty(prop))) {
+            continue;
         }
+
+        rc = 0;
+        vCancel.push_back(order);
     }
+    CancelOrders(txid, block, vCancel);
     PrintToLog(">>>>>>\n");
 
     if (msc_debug_metadex2) MetaDEx_debug_print();
@@ -692,21 +993,26 @@ int mastercore::MetaDEx_SHUTDOWN_ALLPAIR()
 {
     int rc = 0;
     PrintToLog("%s()\n", __FUNCTION__);
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+    md_ReserveMap reserves;
+    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end();) {
+        if (my_it->first.first <= OMNI_PROPERTY_TMSC || my_it->first.second <= OMNI_PROPERTY_TMSC) { // OMN/TOMN side to the trade
+            ++my_it;
+            continue;
+        }
         md_PricesMap& prices = my_it->second;
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
             md_Set& indexes = it->second;
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                if (it->getDesProperty() > OMNI_PROPERTY_TMSC && it->getProperty() > OMNI_PROPERTY_TMSC) { // no OMN/TOMN side to the trade
-                    PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
-                    // move from reserve to balance
-                    assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                    assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-                    indexes.erase(it++);
-                }
+            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
+                reserves[std::make_pair(it->getAddr(), it->getProperty())] += it->getAmountRemaining();
+                uiInterface.OmniMetaDExOrderChanged(*it, CT_DELETED);
+                UnindexOrder(*it);
             }
         }
+        my_it = metadex.erase(my_it);
     }
+    // move from reserve to balance
+    ReleaseReserves(reserves);
     return rc;
 }
 
@@ -717,38 +1023,81 @@ int mastercore::MetaDEx_SHUTDOWN()
 {
     int rc = 0;
     PrintToLog("%s()\n", __FUNCTION__);
+    md_ReserveMap reserves;
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
         md_PricesMap& prices = my_it->second;
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
             md_Set& indexes = it->second;
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
+            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
                 PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
-                // move from reserve to balance
-                assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-                indexes.erase(it++);
+                reserves[std::make_pair(it->getAddr(), it->getProperty())] += it->getAmountRemaining();
+                uiInterface.OmniMetaDExOrderChanged(*it, CT_DELETED);
             }
         }
     }
+    MetaDEx_CLEAR();
+    // move from reserve to balance
+    ReleaseReserves(reserves);
     return rc;
 }
 
+bool mastercore::MetaDEx_TakeModifiedPairs(std::set<md_PropertyPair>& pairs, md_ModifiedConsumer consumer)
+{
+    bool fComplete = !md_fModifiedAll[consumer];
+    pairs.clear();
+    pairs.swap(md_modifiedPairs[consumer]);
+    md_fModifiedAll[consumer] = false;
+    return fComplete;
+}
+
+void mastercore::MetaDEx_ClearAddresses()
+{
+    assert(metadex.empty());
+    AddressPool().Clear();
+}
+
+size_t mastercore::MetaDEx_AddressPoolUsage()
+{
+    return AddressPool().DynamicMemoryUsage();
+}
+
+/**
+ * Returns the open orders of an address, sorted by property for sale, price, block and position.
+ */
+std::vector<CMPMetaDEx> mastercore::MetaDEx_getOpenOrders(const std::string& address)
+{
+    std::vector<CMPMetaDEx> vOrders;
+    for (const md_OrderRef& order : GetOrdersOfAddress(address)) {
+        const CMPMetaDEx* pOrder = FindOrder(order.first);
+        assert(pOrder != nullptr);
+        vOrders.push_back(*pOrder);
+    }
+    return vOrders;
+}
+
+/**
+ * Returns up to nLevels price levels of a property pair with the aggregated open orders, starting with the lowest unit price.
+ */
+std::vector<std::pair<rational_t, md_DepthLevel> > mastercore::MetaDEx_getDepth(uint32_t propertyForSale, uint32_t propertyDesired, size_t nLevels)
+{
+    std::vector<std::pair<rational_t, md_DepthLevel> > vLevels;
+    std::map<md_PropertyPair, md_DepthMap>::const_iterator pairIt = md_depth.find(md_PropertyPair(propertyForSale, propertyDesired));
+    if (pairIt == md_depth.end()) return vLevels;
+
+    for (md_DepthMap::const_iterator it = pairIt->second.begin(); it != pairIt->second.end() && vLevels.size() < nLevels; ++it) {
+        vLevels.push_back(*it);
+    }
+    return vLevels;
+}
+
 // searches the metadex maps to see if a trade is still open
-// allows search to be optimized if propertyIdForSale is specified
+// if propertyIdForSale is specified, the trade must also sell this property
 bool mastercore::MetaDEx_isOpen(const uint256& txid, uint32_t propertyIdForSale)
 {
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        if (propertyIdForSale != 0 && propertyIdForSale != my_it->first) continue;
-        md_PricesMap & prices = my_it->second;
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            md_Set & indexes = (it->second);
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                CMPMetaDEx obj = *it;
-                if( obj.getHash().GetHex() == txid.GetHex() ) return true;
-            }
-        }
-    }
-    return false;
+    const CMPMetaDEx* pOrder = FindOrder(txid);
+    if (!pOrder) return false;
+
+    return (propertyIdForSale == 0 || pOrder->getProperty() == propertyIdForSale);
 }
 
 /**
@@ -807,9 +1156,9 @@ void mastercore::MetaDEx_debug_print(bool bShowPriceLevel, bool bDisplay)
 {
     PrintToLog("<<<\n");
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        uint32_t prop = my_it->first;
+        const md_PropertyPair& pair = my_it->first;
 
-        PrintToLog(" ## property: %u\n", prop);
+        PrintToLog(" ## property: %u, desired: %u\n", pair.first, pair.second);
         md_PricesMap& prices = my_it->second;
 
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
@@ -830,19 +1179,10 @@ void mastercore::MetaDEx_debug_print(bool bShowPriceLevel, bool bDisplay)
 }
 
 /**
- * Locates a trade in the MetaDEx maps via txid and returns the trade object
+ * Locates a trade in the MetaDEx maps via the txid index and returns the trade object
  *
  */
 const CMPMetaDEx* mastercore::MetaDEx_RetrieveTrade(const uint256& txid)
 {
-    for (md_PropertiesMap::iterator propIter = metadex.begin(); propIter != metadex.end(); ++propIter) {
-        md_PricesMap & prices = propIter->second;
-        for (md_PricesMap::iterator pricesIter = prices.begin(); pricesIter != prices.end(); ++pricesIter) {
-            md_Set & indexes = pricesIter->second;
-            for (md_Set::iterator tradesIter = indexes.begin(); tradesIter != indexes.end(); ++tradesIter) {
-                if (txid == (*tradesIter).getHash()) return &(*tradesIter);
-            }
-        }
-    }
-    return static_cast<CMPMetaDEx*>(nullptr);
+    return FindOrder(txid);
 }
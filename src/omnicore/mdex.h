@@ -16,8 +16,10 @@
 #include <map>
 #include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
-class CHash256;
+class CStateFileWriter;
 
 typedef boost::rational<boost::multiprecision::checked_int128_t> rational_t;
 
@@ -32,21 +34,46 @@ typedef boost::rational<boost::multiprecision::checked_int128_t> rational_t;
 /** Converts price to string. */
 std::string xToString(const rational_t& value);
 
+/** Used for display of unit prices of a property pair with 50 decimal places at RPC layer. */
+std::string xToFullUnitPriceString(const rational_t& unitPrice, uint32_t propertyForSale, uint32_t propertyDesired);
+
+/**
+ * Returns whether num1 / den1 is less than num2 / den2, for positive denominators.
+ *
+ * The prices are compared exactly by cross-multiplication, without normalizing them.
+ */
+inline bool xIsLess(int64_t num1, int64_t den1, int64_t num2, int64_t den2)
+{
+#ifdef __SIZEOF_INT128__
+    // the products of two 64 bit factors fit into 128 bits
+    return static_cast<__int128>(num1) * den2 < static_cast<__int128>(num2) * den1;
+#else
+    return boost::multiprecision::checked_int128_t(num1) * den2 < boost::multiprecision::checked_int128_t(num2) * den1;
+#endif
+}
+
 /** A trade on the distributed exchange.
+ *
+ * The members are ordered by size, and the address is stored as id of an append-only
+ * address pool, so an order doesn't allocate memory for its address.
  */
 class CMPMetaDEx
 {
 private:
-    int block;
     uint256 txid;
-    unsigned int idx; // index within block
-    uint32_t property;
+    rational_t unit_price; // cached, the amounts for sale and desired never change
     int64_t amount_forsale;
-    uint32_t desired_property;
     int64_t amount_desired;
     int64_t amount_remaining;
+    int block;
+    unsigned int idx; // index within block
+    uint32_t property;
+    uint32_t desired_property;
+    uint32_t addr_id;
     uint8_t subaction;
-    std::string addr;
+
+    static rational_t calculateUnitPrice(int64_t amountForSale, int64_t amountDesired);
+    static uint32_t internAddress(const std::string& address);
 
 public:
     uint256 getHash() const { return txid; }
@@ -63,7 +90,7 @@ public:
 
     uint8_t getAction() const { return subaction; }
 
-    const std::string& getAddr() const { return addr; }
+    const std::string& getAddr() const;
 
     int getBlock() const { return block; }
     unsigned int getIdx() const { return idx; }
@@ -71,27 +98,30 @@ public:
     int64_t getBlockTime() const;
 
     CMPMetaDEx()
-      : block(0), idx(0), property(0), amount_forsale(0), desired_property(0), amount_desired(0),
-        amount_remaining(0), subaction(0) {}
+      : amount_forsale(0), amount_desired(0), amount_remaining(0), block(0), idx(0), property(0),
+        desired_property(0), addr_id(0), subaction(0) {}
 
     CMPMetaDEx(const std::string& addr, int b, uint32_t c, int64_t nValue, uint32_t cd, int64_t ad,
                const uint256& tx, uint32_t i, uint8_t suba)
-      : block(b), txid(tx), idx(i), property(c), amount_forsale(nValue), desired_property(cd), amount_desired(ad),
-        amount_remaining(nValue), subaction(suba), addr(addr) {}
+      : txid(tx), unit_price(calculateUnitPrice(nValue, ad)), amount_forsale(nValue), amount_desired(ad),
+        amount_remaining(nValue), block(b), idx(i), property(c), desired_property(cd), addr_id(internAddress(addr)),
+        subaction(suba) {}
 
     CMPMetaDEx(const std::string& addr, int b, uint32_t c, int64_t nValue, uint32_t cd, int64_t ad,
                const uint256& tx, uint32_t i, uint8_t suba, int64_t ar)
-      : block(b), txid(tx), idx(i), property(c), amount_forsale(nValue), desired_property(cd), amount_desired(ad),
-        amount_remaining(ar), subaction(suba), addr(addr) {}
+      : txid(tx), unit_price(calculateUnitPrice(nValue, ad)), amount_forsale(nValue), amount_desired(ad),
+        amount_remaining(ar), block(b), idx(i), property(c), desired_property(cd), addr_id(internAddress(addr)),
+        subaction(suba) {}
 
     CMPMetaDEx(const CMPTransaction& tx)
-      : block(tx.block), txid(tx.txid), idx(tx.tx_idx), property(tx.property), amount_forsale(tx.nValue),
-        desired_property(tx.desired_property), amount_desired(tx.desired_value), amount_remaining(tx.nValue),
-        subaction(tx.subaction), addr(tx.sender) {}
+      : txid(tx.txid), unit_price(calculateUnitPrice(tx.nValue, tx.desired_value)), amount_forsale(tx.nValue),
+        amount_desired(tx.desired_value), amount_remaining(tx.nValue), block(tx.block), idx(tx.tx_idx),
+        property(tx.property), desired_property(tx.desired_property), addr_id(internAddress(tx.sender)),
+        subaction(tx.subaction) {}
 
     std::string ToString() const;
 
-    rational_t unitPrice() const;
+    const rational_t& unitPrice() const { return unit_price; }
     rational_t inversePrice() const;
 
     /** Used for display of unit prices to 8 decimal places at UI layer. */
@@ -99,7 +129,16 @@ public:
     /** Used for display of unit prices with 50 decimal places at RPC layer. */
     std::string displayFullUnitPrice() const;
 
-    void saveOffer(std::ofstream& file, CHash256 &hasher) const;
+    void saveOffer(CStateFileWriter& writer) const;
+
+    bool operator==(const CMPMetaDEx& other) const
+    {
+        // the unit price is derived from the amounts
+        return txid == other.txid && amount_forsale == other.amount_forsale && amount_desired == other.amount_desired &&
+                amount_remaining == other.amount_remaining && block == other.block && idx == other.idx &&
+                property == other.property && desired_property == other.desired_property &&
+                addr_id == other.addr_id && subaction == other.subaction;
+    }
 };
 
 namespace mastercore
@@ -114,14 +153,36 @@ struct MetaDEx_compare
 typedef std::set<CMPMetaDEx, MetaDEx_compare> md_Set; 
 //! Map of prices; there is a set of sorted objects for each price
 typedef std::map<rational_t, md_Set> md_PricesMap;
-//! Map of properties; there is a map of prices for each property
-typedef std::map<uint32_t, md_PricesMap> md_PropertiesMap;
+//! Pair of the property for sale and the property desired
+typedef std::pair<uint32_t, uint32_t> md_PropertyPair;
+//! Map of property pairs; there is a map of prices for each pair, ordered by the property for sale
+typedef std::map<md_PropertyPair, md_PricesMap> md_PropertiesMap;
 
 //! Global map for price and order data
 extern md_PropertiesMap metadex;
 
-// TODO: explore a property-pair, instead of a single property as map's key........
-md_PricesMap* get_Prices(uint32_t prop);
+/** Aggregated open orders at a price of a property pair. */
+struct md_DepthLevel
+{
+    //! Total amount still up for sale
+    int64_t amountRemaining;
+    //! Number of orders
+    int orders;
+
+    md_DepthLevel() : amountRemaining(0), orders(0) {}
+};
+//! Map of prices; there are aggregated open orders for each price
+typedef std::map<rational_t, md_DepthLevel> md_DepthMap;
+
+/** Consumers of the property pairs with modified orders, which are tracked independently. */
+enum md_ModifiedConsumer
+{
+    MD_MODIFIED_SNAPSHOT = 0,
+    MD_MODIFIED_UI,
+    MD_MODIFIED_CONSUMER_COUNT
+};
+
+md_PricesMap* get_Prices(uint32_t propertyForSale, uint32_t propertyDesired);
 md_Set* get_Indexes(md_PricesMap* p, rational_t price);
 // ---------------
 
@@ -132,8 +193,44 @@ int MetaDEx_CANCEL_EVERYTHING(const uint256& txid, uint32_t block, const std::st
 int MetaDEx_SHUTDOWN();
 int MetaDEx_SHUTDOWN_ALLPAIR();
 bool MetaDEx_INSERT(const CMPMetaDEx& objMetaDEx);
+
+/**
+ * Inserts orders into the MetaDEx maps in the order of the maps, such as when the state is restored.
+ *
+ * Every insertion is hinted by the previous one, so orders in sorted order are inserted in
+ * constant time. Orders out of order are still inserted correctly, just not faster.
+ */
+class CMetaDExLoader
+{
+private:
+    md_PropertiesMap::iterator m_itPair;
+    md_PricesMap::iterator m_itPrice;
+    bool m_fPair;
+    bool m_fPrice;
+
+public:
+    CMetaDExLoader() : m_fPair(false), m_fPrice(false) {}
+
+    /** Reserves space in the indexes for the given number of orders in total. */
+    void Reserve(size_t nOrders);
+
+    /** Inserts an order as MetaDEx_INSERT(), and returns false, if it exists already. */
+    bool Insert(const CMPMetaDEx& objMetaDEx);
+};
+//! Removes all orders from the MetaDEx maps and the indexes
+void MetaDEx_CLEAR();
+//! Rebuilds the txid and address indexes of open orders, after the MetaDEx maps were replaced as a whole
+void MetaDEx_RebuildIndex();
+//! Retrieves the property pairs with modified orders since the last call by the consumer, and returns false, if all orders were replaced
+bool MetaDEx_TakeModifiedPairs(std::set<md_PropertyPair>& pairs, md_ModifiedConsumer consumer);
+//! Removes the addresses of all orders from the pool, once the MetaDEx maps and the undo journal are cleared
+void MetaDEx_ClearAddresses();
+//! Returns the memory used by the pool of the addresses of orders
+size_t MetaDEx_AddressPoolUsage();
 void MetaDEx_debug_print(bool bShowPriceLevel = false, bool bDisplay = false);
 bool MetaDEx_isOpen(const uint256& txid, uint32_t propertyIdForSale = 0);
+std::vector<CMPMetaDEx> MetaDEx_getOpenOrders(const std::string& address);
+std::vector<std::pair<rational_t, md_DepthLevel> > MetaDEx_getDepth(uint32_t propertyForSale, uint32_t propertyDesired, size_t nLevels);
 int MetaDEx_getStatus(const uint256& txid, uint32_t propertyIdForSale, int64_t amountForSale, int64_t totalSold = -1);
 std::string MetaDEx_getStatusText(int tradeStatus);
 
@@ -0,0 +1,149 @@
+/**
+ * @file memusage.cpp
+ *
+ * This file contains the accounting of the memory used by the in-memory state
+ * and caches, and a soft limit, which evicts caches, when exceeded.
+ */
+
+#include <omnicore/memusage.h>
+
+#include <omnicore/dex.h>
+#include <omnicore/inputcache.h>
+#include <omnicore/log.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/pending.h>
+#include <omnicore/snapshot.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+
+#include <coins.h>
+#include <memusage.h>
+#include <sync.h>
+
+#include <memory>
+#include <stddef.h>
+#include <string>
+
+namespace mastercore
+{
+//! Soft limit of the memory used, 0 for no limit
+static size_t nMaxMemoryUsage GUARDED_BY(cs_tally) = 0;
+//! Whether the limit was exceeded after evicting the caches, which is logged only once
+static bool fMemoryLimitExceeded GUARDED_BY(cs_tally) = false;
+
+COmniMemoryUsage::COmniMemoryUsage()
+  : nTally(0), nSnapshot(0), nMetaDEx(0), nOffers(0), nAccepts(0), nCrowds(0),
+    nPending(0), nMarkerCache(0), nCoinsView(0), nInputCache(0)
+{
+}
+
+size_t COmniMemoryUsage::GetTotal() const
+{
+    return nTally + nSnapshot + nMetaDEx + nOffers + nAccepts + nCrowds + nPending + nMarkerCache + nCoinsView + nInputCache;
+}
+
+/** Returns the memory used by the MetaDEx orderbook. */
+static size_t MetaDExUsage() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    size_t nUsage = memusage::DynamicUsage(metadex) + MetaDEx_AddressPoolUsage();
+    for (const auto& prices : metadex) {
+        nUsage += memusage::DynamicUsage(prices.second);
+        for (const auto& orders : prices.second) {
+            nUsage += memusage::DynamicUsage(orders.second);
+        }
+    }
+    return nUsage;
+}
+
+/**
+ * Determines the memory used by the in-memory state and caches.
+ *
+ * The locks are acquired one after another, so the numbers may not refer to
+ * exactly the same state.
+ */
+COmniMemoryUsage GetMemoryUsage()
+{
+    COmniMemoryUsage usage;
+    {
+        LOCK(cs_tally);
+        usage.nTally = mp_tally_map.DynamicMemoryUsage();
+        usage.nMetaDEx = MetaDExUsage();
+        usage.nOffers = memusage::DynamicUsage(my_offers);
+        for (const auto& entry : my_offers) {
+            usage.nOffers += StringUsage(entry.first.seller);
+        }
+        usage.nAccepts = my_accepts.DynamicMemoryUsage();
+        usage.nCrowds = my_crowds.DynamicMemoryUsage();
+        for (const auto& entry : my_crowds) {
+            usage.nCrowds += entry.second.DynamicMemoryUsage();
+        }
+    }
+    {
+        LOCK(cs_pending);
+        usage.nPending = memusage::DynamicUsage(my_pending);
+        for (const auto& entry : my_pending) {
+            usage.nPending += StringUsage(entry.second.src);
+        }
+    }
+    {
+        LOCK(cs_tx_cache);
+        usage.nCoinsView = view.DynamicMemoryUsage();
+        usage.nInputCache = inputCache.DynamicMemoryUsage();
+    }
+    std::shared_ptr<const CStateSnapshot> snapshot = GetStateSnapshot();
+    if (snapshot) {
+        usage.nSnapshot = snapshot->DynamicMemoryUsage();
+    }
+    usage.nMarkerCache = GetMarkerCacheUsage();
+
+    return usage;
+}
+
+/**
+ * Sets the soft limit of the memory used, 0 for no limit.
+ */
+void SetMaxMemoryUsage(size_t nMaxUsage)
+{
+    LOCK(cs_tally);
+    nMaxMemoryUsage = nMaxUsage;
+    fMemoryLimitExceeded = false;
+}
+
+/**
+ * Evicts caches, if the memory used exceeds the soft limit.
+ *
+ * Only the coins view and the input cache hold data, which can be restored, so
+ * the limit can still be exceeded by the state itself, in which case a warning
+ * is logged.
+ */
+void CheckMemoryUsage()
+{
+    LOCK(cs_tally);
+    if (nMaxMemoryUsage == 0) return;
+
+    COmniMemoryUsage usage = GetMemoryUsage();
+    if (usage.GetTotal() <= nMaxMemoryUsage) {
+        fMemoryLimitExceeded = false;
+        return;
+    }
+
+    {
+        LOCK(cs_tx_cache);
+        view.Flush();
+        inputCache.Clear();
+    }
+
+    // as long as the state itself exceeds the limit, this is logged only once
+    size_t nTotal = usage.GetTotal() - usage.nCoinsView - usage.nInputCache;
+    if (!fMemoryLimitExceeded) {
+        PrintToLog("%s(): memory usage of %d bytes exceeds the limit of %d bytes, evicted %d bytes of caches\n",
+                __func__, usage.GetTotal(), nMaxMemoryUsage, usage.nCoinsView + usage.nInputCache);
+        if (nTotal > nMaxMemoryUsage) {
+            PrintToLog("WARNING: the in-memory state uses %d bytes, which exceeds the limit of %d bytes [tally=%d, snapshot=%d, metadex=%d]\n",
+                    nTotal, nMaxMemoryUsage, usage.nTally, usage.nSnapshot, usage.nMetaDEx);
+        }
+    }
+    fMemoryLimitExceeded = (nTotal > nMaxMemoryUsage);
+}
+} // namespace mastercore
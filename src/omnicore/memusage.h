@@ -0,0 +1,52 @@
+#ifndef BITCOIN_OMNICORE_MEMUSAGE_H
+#define BITCOIN_OMNICORE_MEMUSAGE_H
+
+#include <memusage.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace mastercore
+{
+//! Default soft limit of the memory used by the in-memory state in MiB, 0 for no limit
+static const int64_t DEFAULT_OMNI_MAX_MEMORY = 0;
+
+/** Returns the heap memory used by a string, which is zero for strings stored inline. */
+static inline size_t StringUsage(const std::string& s)
+{
+    static const size_t nInlineCapacity = std::string().capacity();
+    return (s.capacity() > nInlineCapacity) ? memusage::MallocUsage(s.capacity() + 1) : 0;
+}
+
+/** Approximate memory used by the in-memory state and caches, in bytes. */
+struct COmniMemoryUsage
+{
+    size_t nTally;
+    size_t nSnapshot;
+    size_t nMetaDEx;
+    size_t nOffers;
+    size_t nAccepts;
+    size_t nCrowds;
+    size_t nPending;
+    size_t nMarkerCache;
+    size_t nCoinsView;
+    size_t nInputCache;
+
+    COmniMemoryUsage();
+
+    /** Returns the memory used by all objects. */
+    size_t GetTotal() const;
+};
+
+/** Determines the memory used by the in-memory state and caches. */
+COmniMemoryUsage GetMemoryUsage();
+
+/** Sets the soft limit of the memory used, 0 for no limit. */
+void SetMaxMemoryUsage(size_t nMaxUsage);
+
+/** Evicts caches, if the memory used exceeds the soft limit. */
+void CheckMemoryUsage();
+}
+
+#endif // BITCOIN_OMNICORE_MEMUSAGE_H
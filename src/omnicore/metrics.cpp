@@ -0,0 +1,313 @@
+/**
+ * @file metrics.cpp
+ *
+ * This file contains the counters and gauges of Omni Core in the Prometheus text
+ * format, which are served at /metrics of the HTTP server.
+ */
+
+#include <omnicore/metrics.h>
+
+#include <omnicore/blockqueue.h>
+#include <omnicore/dbaddressfilter.h>
+#include <omnicore/dbbase.h>
+#include <omnicore/dbmarkers.h>
+#include <omnicore/dbprevout.h>
+#include <omnicore/dex.h>
+#include <omnicore/inputcache.h>
+#include <omnicore/mdex.h>
+#include <omnicore/memusage.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/pending.h>
+#include <omnicore/perfstats.h>
+#include <omnicore/rpcstats.h>
+#include <omnicore/timedmutex.h>
+
+#include <httpserver.h>
+#include <rpc/protocol.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <uint256.h>
+
+#include <univalue.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mastercore
+{
+//! Whether blocks and transactions are counted
+static std::atomic<bool> fMetricsEnabled{false};
+//! Number of processed blocks
+static std::atomic<uint64_t> nMetricsBlocks{0};
+
+static Mutex cs_metrics;
+//! Number of interpreted transactions by type, and whether they were valid
+static std::map<std::pair<uint16_t, bool>, uint64_t> mapMetricsTransactions GUARDED_BY(cs_metrics);
+
+void CountMetricsBlock()
+{
+    if (!fMetricsEnabled.load(std::memory_order_relaxed)) return;
+    nMetricsBlocks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CountMetricsTransaction(uint16_t type, bool fValid)
+{
+    if (!fMetricsEnabled.load(std::memory_order_relaxed)) return;
+    LOCK(cs_metrics);
+    ++mapMetricsTransactions[std::make_pair(type, fValid)];
+}
+
+/** Escapes a label value of the text format. */
+static std::string EscapeLabel(const std::string& value)
+{
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') escaped += '\\';
+        if (c == '\n') {
+            escaped += "\\n";
+            continue;
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+/** Builds the metrics, one family after the other. */
+class CMetricsWriter
+{
+private:
+    std::string m_out;
+
+public:
+    void Family(const std::string& name, const char* type, const char* help)
+    {
+        m_out += strprintf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    }
+
+    void Sample(const std::string& name, const std::string& labels, uint64_t value)
+    {
+        m_out += strprintf("%s%s %d\n", name, labels.empty() ? "" : "{" + labels + "}", value);
+    }
+
+    void Sample(const std::string& name, const std::string& labels, double value)
+    {
+        m_out += strprintf("%s%s %.6f\n", name, labels.empty() ? "" : "{" + labels + "}", value);
+    }
+
+    static std::string Label(const std::string& name, const std::string& value)
+    {
+        return name + "=\"" + EscapeLabel(value) + "\"";
+    }
+
+    const std::string& Get() const { return m_out; }
+};
+
+/** Adds the block and transaction counters, and the per-phase timings. */
+static void AddBlockMetrics(CMetricsWriter& writer)
+{
+    uint256 hashTip;
+    const int nTip = omniBlockQueue.GetTip(hashTip);
+
+    writer.Family("omni_blocks_processed_total", "counter", "Number of blocks processed by Omni Core");
+    writer.Sample("omni_blocks_processed_total", "", nMetricsBlocks.load(std::memory_order_relaxed));
+    writer.Family("omni_block_height", "gauge", "Height of the last block processed by Omni Core");
+    writer.Sample("omni_block_height", "", (uint64_t) std::max(nTip, 0));
+
+    std::map<std::pair<uint16_t, bool>, uint64_t> mapTransactions;
+    {
+        LOCK(cs_metrics);
+        mapTransactions = mapMetricsTransactions;
+    }
+    writer.Family("omni_transactions_total", "counter", "Number of interpreted Omni transactions by type");
+    for (const auto& entry : mapTransactions) {
+        const std::string labels = CMetricsWriter::Label("type", strTransactionType(entry.first.first)) + ","
+                + CMetricsWriter::Label("valid", entry.first.second ? "true" : "false");
+        writer.Sample("omni_transactions_total", labels, entry.second);
+    }
+
+    const UniValue perf = GetPerfStats(0, false);
+    writer.Family("omni_block_phase_seconds_total", "counter", "Time spent in the phases of the block processing");
+    for (const UniValue& phase : perf["phases"].getValues()) {
+        writer.Sample("omni_block_phase_seconds_total", CMetricsWriter::Label("phase", phase["phase"].get_str()), phase["totaltime"].get_real());
+    }
+    writer.Family("omni_interpret_seconds_total", "counter", "Time spent interpreting transactions by type");
+    for (const UniValue& type : perf["types"].getValues()) {
+        writer.Sample("omni_interpret_seconds_total", CMetricsWriter::Label("type", type["type"].get_str()), type["totaltime"].get_real());
+    }
+
+    writer.Family("omni_lock_acquisitions_total", "counter", "Number of acquisitions of the Omni locks, recorded with -omnilockstats");
+    const UniValue locks = GetLockStats(0, false);
+    for (const UniValue& lock : locks.getValues()) {
+        writer.Sample("omni_lock_acquisitions_total", CMetricsWriter::Label("lock", lock["name"].get_str()), (uint64_t) lock["acquisitions"].get_int64());
+    }
+    writer.Family("omni_lock_wait_seconds_total", "counter", "Time spent waiting for the Omni locks, recorded with -omnilockstats");
+    for (const UniValue& lock : locks.getValues()) {
+        writer.Sample("omni_lock_wait_seconds_total", CMetricsWriter::Label("lock", lock["name"].get_str()), lock["totalwait"].get_real());
+    }
+}
+
+/** Adds the sizes of the order books, pending transactions and the memory used by the state. */
+static void AddStateMetrics(CMetricsWriter& writer)
+{
+    uint64_t nOrders = 0;
+    uint64_t nPairs = 0;
+    uint64_t nOffers = 0;
+    uint64_t nAccepts = 0;
+    {
+        LOCK(cs_tally);
+        for (const auto& pair : metadex) {
+            if (pair.second.empty()) continue;
+            ++nPairs;
+            for (const auto& price : pair.second) {
+                nOrders += price.second.size();
+            }
+        }
+        nOffers = my_offers.size();
+        nAccepts = my_accepts.size();
+    }
+    uint64_t nPending = 0;
+    {
+        LOCK(cs_pending);
+        nPending = my_pending.size();
+    }
+
+    writer.Family("omni_metadex_orders", "gauge", "Number of open orders of the distributed exchange");
+    writer.Sample("omni_metadex_orders", "", nOrders);
+    writer.Family("omni_metadex_pairs", "gauge", "Number of property pairs with open orders");
+    writer.Sample("omni_metadex_pairs", "", nPairs);
+    writer.Family("omni_dex_offers", "gauge", "Number of sell offers of the traditional distributed exchange");
+    writer.Sample("omni_dex_offers", "", nOffers);
+    writer.Family("omni_dex_accepts", "gauge", "Number of accepted offers of the traditional distributed exchange");
+    writer.Sample("omni_dex_accepts", "", nAccepts);
+    writer.Family("omni_pending_transactions", "gauge", "Number of pending Omni transactions of the wallet");
+    writer.Sample("omni_pending_transactions", "", nPending);
+
+    const COmniMemoryUsage usage = GetMemoryUsage();
+    const std::pair<const char*, size_t> vUsage[] = {
+        {"tally", usage.nTally}, {"snapshot", usage.nSnapshot}, {"metadex", usage.nMetaDEx},
+        {"offers", usage.nOffers}, {"accepts", usage.nAccepts}, {"crowdsales", usage.nCrowds},
+        {"pending", usage.nPending}, {"markercache", usage.nMarkerCache}, {"coinsview", usage.nCoinsView},
+        {"inputcache", usage.nInputCache}};
+    writer.Family("omni_memory_bytes", "gauge", "Approximate memory used by the in-memory state and caches");
+    for (const auto& entry : vUsage) {
+        writer.Sample("omni_memory_bytes", CMetricsWriter::Label("component", entry.first), (uint64_t) entry.second);
+    }
+}
+
+/** Adds the statistics of the input cache and the databases. */
+static void AddCacheMetrics(CMetricsWriter& writer)
+{
+    uint64_t nHits, nMisses, nEvictions, nEntries;
+    {
+        LOCK(cs_tx_cache);
+        nHits = inputCache.GetHits();
+        nMisses = inputCache.GetMisses();
+        nEvictions = inputCache.GetEvictions();
+        nEntries = inputCache.Size();
+    }
+    writer.Family("omni_inputcache_hits_total", "counter", "Number of outputs found in the input cache");
+    writer.Sample("omni_inputcache_hits_total", "", nHits);
+    writer.Family("omni_inputcache_misses_total", "counter", "Number of outputs not found in the input cache");
+    writer.Sample("omni_inputcache_misses_total", "", nMisses);
+    writer.Family("omni_inputcache_evictions_total", "counter", "Number of outputs evicted from the input cache");
+    writer.Sample("omni_inputcache_evictions_total", "", nEvictions);
+    writer.Family("omni_inputcache_entries", "gauge", "Number of outputs in the input cache");
+    writer.Sample("omni_inputcache_entries", "", nEntries);
+
+    std::vector<CDBBase*> vDatabases;
+    {
+        LOCK(cs_tally);
+        vDatabases = GetStateDatabases();
+    }
+    for (CDBBase* pdb : std::vector<CDBBase*>{pDbPrevout, pDbMarkers, pDbAddressFilter}) {
+        if (pdb) vDatabases.push_back(pdb);
+    }
+
+    writer.Family("omni_db_reads_total", "counter", "Number of entries read from the Omni databases");
+    for (const CDBBase* pdb : vDatabases) {
+        writer.Sample("omni_db_reads_total", CMetricsWriter::Label("db", pdb->GetName()), (uint64_t) pdb->GetReadCount());
+    }
+    writer.Family("omni_db_writes_total", "counter", "Number of entries written to the Omni databases");
+    for (const CDBBase* pdb : vDatabases) {
+        writer.Sample("omni_db_writes_total", CMetricsWriter::Label("db", pdb->GetName()), (uint64_t) pdb->GetWriteCount());
+    }
+    writer.Family("omni_db_cache_hits_total", "counter", "Number of reads served by the read caches of the Omni databases");
+    for (const CDBBase* pdb : vDatabases) {
+        writer.Sample("omni_db_cache_hits_total", CMetricsWriter::Label("db", pdb->GetName()), pdb->GetCacheHits());
+    }
+    writer.Family("omni_db_cache_misses_total", "counter", "Number of reads, which missed the read caches of the Omni databases");
+    for (const CDBBase* pdb : vDatabases) {
+        writer.Sample("omni_db_cache_misses_total", CMetricsWriter::Label("db", pdb->GetName()), pdb->GetCacheMisses());
+    }
+    writer.Family("omni_db_size_bytes", "gauge", "Approximate size of the Omni databases on disk");
+    for (const CDBBase* pdb : vDatabases) {
+        writer.Sample("omni_db_size_bytes", CMetricsWriter::Label("db", pdb->GetName()), pdb->GetApproximateSize());
+    }
+}
+
+/** Adds the latencies of the Omni RPC methods as histograms. */
+static void AddRPCMetrics(CMetricsWriter& writer)
+{
+    const UniValue stats = GetRPCStats(false);
+    const std::vector<UniValue>& vLimits = stats["latencylimits"].getValues();
+
+    writer.Family("omni_rpc_duration_seconds", "histogram", "Latency of the Omni RPC methods");
+    for (const UniValue& method : stats["methods"].getValues()) {
+        const std::string label = CMetricsWriter::Label("method", method["method"].get_str());
+        const std::vector<UniValue>& vLatency = method["latency"].getValues();
+        uint64_t nCumulative = 0;
+        for (size_t n = 0; n < vLatency.size(); ++n) {
+            nCumulative += vLatency[n].get_int64();
+            const std::string le = n < vLimits.size() ? strprintf("%g", vLimits[n].get_real()) : "+Inf";
+            writer.Sample("omni_rpc_duration_seconds_bucket", label + "," + CMetricsWriter::Label("le", le), nCumulative);
+        }
+        writer.Sample("omni_rpc_duration_seconds_sum", label, method["totaltime"].get_real());
+        writer.Sample("omni_rpc_duration_seconds_count", label, (uint64_t) method["calls"].get_int64());
+    }
+    writer.Family("omni_rpc_errors_total", "counter", "Number of Omni RPC calls, which failed");
+    for (const UniValue& method : stats["methods"].getValues()) {
+        writer.Sample("omni_rpc_errors_total", CMetricsWriter::Label("method", method["method"].get_str()), (uint64_t) method["errors"].get_int64());
+    }
+}
+
+std::string GetMetrics()
+{
+    CMetricsWriter writer;
+    AddBlockMetrics(writer);
+    AddStateMetrics(writer);
+    AddCacheMetrics(writer);
+    AddRPCMetrics(writer);
+    return writer.Get();
+}
+
+static bool HTTPReq_Metrics(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (req->GetRequestMethod() != HTTPRequest::GET) {
+        req->WriteReply(HTTP_BAD_METHOD, "Only GET requests are supported\r\n");
+        return false;
+    }
+
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, GetMetrics());
+    return true;
+}
+
+void StartMetrics()
+{
+    fMetricsEnabled.store(true, std::memory_order_relaxed);
+    RegisterHTTPHandler("/metrics", true, HTTPReq_Metrics);
+}
+
+void StopMetrics()
+{
+    UnregisterHTTPHandler("/metrics", true);
+    fMetricsEnabled.store(false, std::memory_order_relaxed);
+}
+} // namespace mastercore
@@ -0,0 +1,35 @@
+#ifndef BITCOIN_OMNICORE_METRICS_H
+#define BITCOIN_OMNICORE_METRICS_H
+
+#include <stdint.h>
+
+#include <string>
+
+namespace mastercore
+{
+//! Default for serving the metrics of Omni Core via the HTTP server
+static const bool DEFAULT_OMNI_METRICS = false;
+
+/** Counts a processed block, while the metrics are served. */
+void CountMetricsBlock();
+
+/** Counts an interpreted transaction of a type, while the metrics are served. */
+void CountMetricsTransaction(uint16_t type, bool fValid);
+
+/**
+ * Returns the counters and gauges of Omni Core in the Prometheus text format.
+ *
+ * The block and transaction counters cover the time since the metrics are served,
+ * the timings are the ones of omni_getperfstats and omni_getrpcstats, and start
+ * again, when those are reset.
+ */
+std::string GetMetrics();
+
+/** Serves the metrics at /metrics of the HTTP server, and starts counting blocks and transactions. */
+void StartMetrics();
+
+/** Stops serving the metrics. */
+void StopMetrics();
+}
+
+#endif // BITCOIN_OMNICORE_METRICS_H
@@ -10,72 +10,172 @@
 #include <omnicore/errors.h>
 #include <omnicore/log.h>
 
+#include <crypto/common.h>
+#include <util/strencodings.h>
 #include <validation.h>
 
 #include <stdint.h>
 
-#include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <limits>
 
 typedef std::underlying_type<NonFungibleStorage>::type StorageType;
 
+//! Size of the keys: type, property identifier, range start and range end
+static const size_t RANGE_KEY_SIZE = 1 + sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+/** Maps a token identifier to an unsigned value, which sorts in the same order, when stored in big endian byte order. */
+static uint64_t EncodeTokenId(int64_t tokenId)
+{
+    return static_cast<uint64_t>(tokenId) ^ (uint64_t{1} << 63);
+}
+
+static int64_t DecodeTokenId(uint64_t value)
+{
+    return static_cast<int64_t>(value ^ (uint64_t{1} << 63));
+}
+
+/**
+ * Returns the key of a range.
+ *
+ * Key: type + property identifier + range start + range end
+ *
+ * All numbers are stored in big endian byte order, so the ranges of a property and
+ * type are adjacent, and sorted by their start.
+ */
+static std::string RangeKey(NonFungibleStorage type, uint32_t propertyId, int64_t tokenIdStart, int64_t tokenIdEnd)
+{
+    unsigned char buf[RANGE_KEY_SIZE];
+    buf[0] = static_cast<StorageType>(type);
+    WriteBE32(buf + 1, propertyId);
+    WriteBE64(buf + 5, EncodeTokenId(tokenIdStart));
+    WriteBE64(buf + 13, EncodeTokenId(tokenIdEnd));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+/** Returns the prefix of the keys of the ranges of a property and type. */
+static std::string RangeKeyPrefix(NonFungibleStorage type, uint32_t propertyId)
+{
+    return RangeKey(type, propertyId, 0, 0).substr(0, 1 + sizeof(uint32_t));
+}
+
+/**
+ * Returns the prefix of the owner index entries of an address, or of an address and property.
+ *
+ * Key: type + owner + 0 + property identifier + range start
+ *
+ * Addresses never contain a zero byte, so the entries of one address are adjacent.
+ */
+static std::string OwnerIndexPrefix(const std::string& owner, uint32_t propertyId = 0)
+{
+    std::string prefix(1, static_cast<StorageType>(NonFungibleStorage::OwnerIndex));
+    prefix += owner;
+    prefix += '\0';
+    if (propertyId != 0) {
+        unsigned char buf[sizeof(uint32_t)];
+        WriteBE32(buf, propertyId);
+        prefix.append(reinterpret_cast<const char*>(buf), sizeof(buf));
+    }
+    return prefix;
+}
+
+/** Returns the key of the owner index entry of a range, whose value is the range end. */
+static std::string OwnerIndexKey(const std::string& owner, uint32_t propertyId, int64_t tokenIdStart)
+{
+    unsigned char buf[sizeof(uint32_t) + sizeof(uint64_t)];
+    WriteBE32(buf, propertyId);
+    WriteBE64(buf + 4, EncodeTokenId(tokenIdStart));
+    return OwnerIndexPrefix(owner) + std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+static std::string EncodeRangeEnd(int64_t tokenIdEnd)
+{
+    unsigned char buf[sizeof(uint64_t)];
+    WriteBE64(buf, EncodeTokenId(tokenIdEnd));
+    return std::string(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
 /* Extracts the property ID from a DB key
  */
 uint32_t CMPNonFungibleTokensDB::GetPropertyIdFromKey(const std::string& key)
 {
-    std::vector<std::string> vPropertyId;
-    boost::split(vPropertyId, key, boost::is_any_of("_"), boost::token_compress_on);
-    assert(vPropertyId.size() == 3); // if size !=3 then we cannot trust the data in the DB and we must halt
-    return boost::lexical_cast<uint32_t>(vPropertyId[0]);
+    assert(key.size() == RANGE_KEY_SIZE); // if the size differs then we cannot trust the data in the DB and we must halt
+    return ReadBE32(reinterpret_cast<const unsigned char*>(key.data()) + 1);
 }
 
 /* Extracts the storage type from a DB key
  */
 NonFungibleStorage CMPNonFungibleTokensDB::GetTypeFromKey(const std::string& key)
 {
-    std::vector<std::string> vPropertyId;
-    boost::split(vPropertyId, key, boost::is_any_of("_"), boost::token_compress_on);
-    assert(vPropertyId.size() == 3); // if size !=3 then we cannot trust the data in the DB and we must halt
-    auto ch = boost::lexical_cast<uint32_t>(vPropertyId[1]);
-    return static_cast<NonFungibleStorage>(ch);
+    assert(key.size() == RANGE_KEY_SIZE); // if the size differs then we cannot trust the data in the DB and we must halt
+    return static_cast<NonFungibleStorage>(key[0]);
 }
 
 /* Extracts the range from a DB key
  */
 void CMPNonFungibleTokensDB::GetRangeFromKey(const std::string& key, int64_t *start, int64_t *end)
 {
-   std::vector<std::string> vPropertyId;
-   boost::split(vPropertyId, key, boost::is_any_of("_"), boost::token_compress_on);
-   assert(vPropertyId.size() == 3); // if size !=2 then we cannot trust the data in the DB and we must halt
+    assert(key.size() == RANGE_KEY_SIZE); // if the size differs then we cannot trust the data in the DB and we must halt
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(key.data());
+    *start = DecodeTokenId(ReadBE64(data + 5));
+    *end = DecodeTokenId(ReadBE64(data + 13));
+}
 
-   std::vector<std::string> vRanges;
-   boost::split(vRanges, vPropertyId[2], boost::is_any_of("-"), boost::token_compress_on);
-   assert(vRanges.size() == 2); // if size !=2 then we cannot trust the data in the DB and we must halt
+/* Returns the cached ranges of a property and type
+ *
+ * The ranges are loaded from the database, when the property and type are looked up for the
+ * first time, and AddRange() and DeleteRange() keep them in sync with the database afterwards.
+ */
+CMPNonFungibleTokensDB::RangeCache& CMPNonFungibleTokensDB::GetCachedRanges(uint32_t propertyId, NonFungibleStorage type)
+{
+    AssertLockHeld(m_cache_mutex);
+    auto inserted = m_rangeCache.emplace(std::make_pair(propertyId, type), RangeCache());
+    RangeCache& ranges = inserted.first->second;
+    if (!inserted.second) return ranges;
 
-   *start = boost::lexical_cast<int64_t>(vRanges[0]);
-   *end = boost::lexical_cast<int64_t>(vRanges[1]);
+    const std::string prefix = RangeKeyPrefix(type, propertyId);
+    leveldb::Iterator* it = NewIterator();
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        int64_t start, end;
+        GetRangeFromKey(it->key().ToString(), &start, &end);
+        ranges.emplace_hint(ranges.end(), start, std::make_pair(end, it->value().ToString()));
+        ++nRead;
+    }
+    delete it;
+    return ranges;
 }
 
-/* Gets the range a non-fungible token is in
+/* Finds the range of a property and type, which contains a token
+ *
+ * The range with the highest start not above the token is the only candidate, so it's
+ * found with a single lookup in the cached ranges.
  */
-std::pair<int64_t,int64_t> CMPNonFungibleTokensDB::GetRange(const uint32_t &propertyId, const int64_t &tokenId, const NonFungibleStorage type)
+bool CMPNonFungibleTokensDB::FindRange(const uint32_t &propertyId, const int64_t &tokenId, const NonFungibleStorage type, int64_t *start, int64_t *end, std::string *value)
 {
     assert(pdb);
-    leveldb::Iterator* it = NewIterator();
+    LOCK(m_cache_mutex);
+    const RangeCache& ranges = GetCachedRanges(propertyId, type);
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        if (propertyId != GetPropertyIdFromKey(it->key().ToString()) ||
-                GetTypeFromKey(it->key().ToString()) != type) continue;
+    auto it = ranges.upper_bound(tokenId);
+    if (it == ranges.begin()) return false;
+    --it;
+    if (tokenId > it->second.first) return false;
 
-        int64_t start, end;
-        GetRangeFromKey(it->key().ToString(), &start, &end);
-        if (tokenId >= start && tokenId <= end) {
-            delete it;
-            return std::make_pair(start, end);
-        }
+    *start = it->first;
+    *end = it->second.first;
+    if (value) *value = it->second.second;
+    return true;
+}
+
+/* Gets the range a non-fungible token is in
+ */
+std::pair<int64_t,int64_t> CMPNonFungibleTokensDB::GetRange(const uint32_t &propertyId, const int64_t &tokenId, const NonFungibleStorage type)
+{
+    int64_t start, end;
+    if (FindRange(propertyId, tokenId, type, &start, &end, nullptr)) {
+        return std::make_pair(start, end);
     }
 
-    delete it;
     return std::make_pair(0,0); // token not found, return zero'd range
 }
 
@@ -83,36 +183,20 @@ std::pair<int64_t,int64_t> CMPNonFungibleTokensDB::GetRange(const uint32_t &prop
  */
 bool CMPNonFungibleTokensDB::IsRangeContiguous(const uint32_t &propertyId, const int64_t &rangeStart, const int64_t &rangeEnd)
 {
-
-    assert(pdb);
-    leveldb::Iterator* it = NewIterator();
-
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        if (propertyId != GetPropertyIdFromKey(it->key().ToString()) ||
-                GetTypeFromKey(it->key().ToString()) != NonFungibleStorage::RangeIndex) continue;
-
-        int64_t start, end;
-        GetRangeFromKey(it->key().ToString(), &start, &end);
-
-        if (rangeStart >= start && rangeStart <= end) {
-            delete it;
-            if (rangeEnd >= rangeStart && rangeEnd <= end) {
-                return true;
-            } else {
-                return false; // the start ID falls within this range but the end ID does not - not owned by a single address
-            }
-        }
+    int64_t start, end;
+    if (!FindRange(propertyId, rangeStart, NonFungibleStorage::RangeIndex, &start, &end, nullptr)) {
+        return false; // range doesn't exist
     }
 
-    delete it;
-    return false; // range doesn't exist
+    // the start ID falls within this range, but the end ID may not - then it's not owned by a single address
+    return rangeEnd >= rangeStart && rangeEnd <= end;
 }
 
 /* Moves a range of tokens (returns false if not able to move)
  */
 bool CMPNonFungibleTokensDB::MoveNonFungibleTokens(const uint32_t &propertyId, const int64_t &tokenIdStart, const int64_t &tokenIdEnd, const std::string &from, const std::string &to)
 {
-    if (msc_debug_nftdb) PrintToLog("%s(): %d:%d:%d:%s:%s, line %d, file: %s\n", __FUNCTION__, propertyId, tokenIdStart, tokenIdEnd, from, to, __LINE__, __FILE__);
+    PrintToLogVerbose(msc_debug_nftdb, "%s(): %d:%d:%d:%s:%s, line %d, file: %s\n", __FUNCTION__, propertyId, tokenIdStart, tokenIdEnd, from, to, __LINE__, __FILE__);
 
     assert(pdb);
 
@@ -179,7 +263,7 @@ bool CMPNonFungibleTokensDB::MoveNonFungibleTokens(const uint32_t &propertyId, c
  */
 bool CMPNonFungibleTokensDB::ChangeNonFungibleTokenData(const uint32_t &propertyId, const int64_t &tokenIdStart, const int64_t &tokenIdEnd, const std::string &data, const NonFungibleStorage type)
 {
-    if (msc_debug_nftdb) PrintToLog("%s(): %d:%d:%d:%s:%s, line %d, file: %s\n", __FUNCTION__, propertyId, tokenIdStart, tokenIdEnd, data, type == NonFungibleStorage::IssuerData ? "IssuerData" : "HolderData", __LINE__, __FILE__);
+    PrintToLogVerbose(msc_debug_nftdb, "%s(): %d:%d:%d:%s:%s, line %d, file: %s\n", __FUNCTION__, propertyId, tokenIdStart, tokenIdEnd, data, type == NonFungibleStorage::IssuerData ? "IssuerData" : "HolderData", __LINE__, __FILE__);
 
     assert(pdb);
 
@@ -229,21 +313,11 @@ int64_t CMPNonFungibleTokensDB::GetHighestRangeEnd(const uint32_t &propertyId)
 {
     assert(pdb);
 
-    int64_t tokenCount = 0;
-    leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        if (propertyId != GetPropertyIdFromKey(it->key().ToString()) ||
-                GetTypeFromKey(it->key().ToString()) != NonFungibleStorage::RangeIndex) continue;
-
-        int64_t start, end;
-        GetRangeFromKey(it->key().ToString(), &start, &end);
-
-        if (end > tokenCount) {
-            tokenCount = end;
-        }
-    }
-    delete it;
-    return tokenCount;
+    // the ranges don't overlap, so the last range of the property has the highest end
+    LOCK(m_cache_mutex);
+    const RangeCache& ranges = GetCachedRanges(propertyId, NonFungibleStorage::RangeIndex);
+    if (ranges.empty()) return 0;
+    return std::max<int64_t>(ranges.rbegin()->second.first, 0);
 }
 
 /* Deletes a range of non-fungible tokens
@@ -251,10 +325,23 @@ int64_t CMPNonFungibleTokensDB::GetHighestRangeEnd(const uint32_t &propertyId)
 void CMPNonFungibleTokensDB::DeleteRange(const uint32_t &propertyId, const int64_t &tokenIdStart, const int64_t &tokenIdEnd, const NonFungibleStorage type)
 {
     assert(pdb);
-    const std::string key = strprintf("%010d_%u_%020d-%020d", propertyId, static_cast<StorageType>(type), tokenIdStart, tokenIdEnd);
+    const std::string key = RangeKey(type, propertyId, tokenIdStart, tokenIdEnd);
     pdb->Delete(leveldb::WriteOptions(), key);
+    setModifiedProperties.insert(propertyId);
+    {
+        LOCK(m_cache_mutex);
+        RangeCache& ranges = GetCachedRanges(propertyId, type);
+        auto it = ranges.find(tokenIdStart);
+        if (it != ranges.end() && it->second.first == tokenIdEnd) {
+            // the owner of the range is only known before it's removed
+            if (type == NonFungibleStorage::RangeIndex) {
+                pdb->Delete(leveldb::WriteOptions(), OwnerIndexKey(it->second.second, propertyId, tokenIdStart));
+            }
+            ranges.erase(it);
+        }
+    }
 
-    if (msc_debug_nftdb) PrintToLog("%s():%s, line %d, file: %s\n", __FUNCTION__, key, __LINE__, __FILE__);
+    PrintToLogVerbose(msc_debug_nftdb, "%s():%d:%c:%d-%d, line %d, file: %s\n", __FUNCTION__, propertyId, static_cast<StorageType>(type), tokenIdStart, tokenIdEnd, __LINE__, __FILE__);
 }
 
 /* Adds a range of non-fungible tokens and/or sets data on that range
@@ -263,18 +350,27 @@ void CMPNonFungibleTokensDB::AddRange(const uint32_t &propertyId, const int64_t
 {
     assert(pdb);
 
-    const std::string key = strprintf("%010d_%u_%020d-%020d", propertyId, static_cast<StorageType>(type), tokenIdStart, tokenIdEnd);
+    const std::string key = RangeKey(type, propertyId, tokenIdStart, tokenIdEnd);
     leveldb::Status status = pdb->Put(writeoptions, key, info);
     ++nWritten;
+    setModifiedProperties.insert(propertyId);
+    {
+        LOCK(m_cache_mutex);
+        GetCachedRanges(propertyId, type)[tokenIdStart] = std::make_pair(tokenIdEnd, info);
+    }
+    if (type == NonFungibleStorage::RangeIndex) {
+        pdb->Put(writeoptions, OwnerIndexKey(info, propertyId, tokenIdStart), EncodeRangeEnd(tokenIdEnd));
+        ++nWritten;
+    }
 
-    if (msc_debug_nftdb) PrintToLog("%s():%s=%s:%s, line %d, file: %s\n", __FUNCTION__, key, info, status.ToString(), __LINE__, __FILE__);
+    PrintToLogVerbose(msc_debug_nftdb, "%s():%d:%c:%d-%d=%s:%s, line %d, file: %s\n", __FUNCTION__, propertyId, static_cast<StorageType>(type), tokenIdStart, tokenIdEnd, info, status.ToString(), __LINE__, __FILE__);
 }
 
 /* Creates a range of non-fungible tokens
  */
 std::pair<int64_t,int64_t> CMPNonFungibleTokensDB::CreateNonFungibleTokens(const uint32_t &propertyId, const int64_t &amount, const std::string &owner, const std::string &info)
 {
-    if (msc_debug_nftdb) PrintToLog("%s(): %d:%d:%s, line %d, file: %s\n", __FUNCTION__, propertyId, amount, owner, __LINE__, __FILE__);
+    PrintToLogVerbose(msc_debug_nftdb, "%s(): %d:%d:%s, line %d, file: %s\n", __FUNCTION__, propertyId, amount, owner, __LINE__, __FILE__);
 
     int64_t highestId = GetHighestRangeEnd(propertyId);
     int64_t newTokenStartId = highestId + 1;
@@ -307,89 +403,78 @@ std::pair<int64_t,int64_t> CMPNonFungibleTokensDB::CreateNonFungibleTokens(const
  */
 std::string CMPNonFungibleTokensDB::GetNonFungibleTokenOwner(const uint32_t &propertyId, const int64_t &tokenId)
 {
-    assert(pdb);
-    leveldb::Iterator* it = NewIterator();
-
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        if (propertyId != GetPropertyIdFromKey(it->key().ToString()) ||
-                GetTypeFromKey(it->key().ToString()) != NonFungibleStorage::RangeIndex) continue;
-
-        int64_t start, end;
-        GetRangeFromKey(it->key().ToString(), &start, &end);
-
-        if (tokenId >= start && tokenId <= end) {
-            std::string retval = it->value().ToString();
-            delete it;
-            return retval;
-        }
-    }
-
-    delete it;
-    return ""; // not found
+    return GetNonFungibleTokenData(propertyId, tokenId, NonFungibleStorage::RangeIndex);
 }
 
 /* Gets the info set in a non-fungible token
  */
 std::string CMPNonFungibleTokensDB::GetNonFungibleTokenData(const uint32_t &propertyId, const int64_t &tokenId, const NonFungibleStorage type)
 {
-    assert(pdb);
-    leveldb::Iterator* it = NewIterator();
-
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        if (propertyId != GetPropertyIdFromKey(it->key().ToString()) ||
-                GetTypeFromKey(it->key().ToString()) != type) continue;
-
-        int64_t start, end;
-        GetRangeFromKey(it->key().ToString(), &start, &end);
-
-        if (tokenId >= start && tokenId <= end) {
-            std::string retval = it->value().ToString();
-            delete it;
-            return retval;
-        }
+    int64_t start, end;
+    std::string value;
+    if (FindRange(propertyId, tokenId, type, &start, &end, &value)) {
+        return value;
     }
 
-    delete it;
     return ""; // not found
 }
 
 /* Gets the ranges of non-fungible tokens owned by an address
+ *
+ * The owner index holds the ranges of an address ordered by property and range start, so
+ * only the entries of the address, or of the address and property, are visited.
  */
 std::map<uint32_t, std::vector<std::pair<int64_t, int64_t>>> CMPNonFungibleTokensDB::GetAddressNonFungibleTokens(const uint32_t &propertyId, const std::string &address)
 {
     std::map<uint32_t, std::vector<std::pair<int64_t, int64_t>>> uniqueMap;
     assert(pdb);
-    leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string value = it->value().ToString();
-        if (value != address) continue;
-
-        const auto id = GetPropertyIdFromKey(it->key().ToString());
-        if ((propertyId != 0 && propertyId != id) ||
-            GetTypeFromKey(it->key().ToString()) != NonFungibleStorage::RangeIndex) continue;
+    // the ranges of one property, or of all properties, if none is given
+    const std::string prefix = OwnerIndexPrefix(address, propertyId);
+    const size_t nOffset = OwnerIndexPrefix(address).size();
+    leveldb::Iterator* it = NewSnapshotIterator();
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        const leveldb::Slice key = it->key();
+        const leveldb::Slice value = it->value();
+        assert(key.size() == nOffset + sizeof(uint32_t) + sizeof(uint64_t) && value.size() == sizeof(uint64_t));
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(key.data()) + nOffset;
+        const int64_t start = DecodeTokenId(ReadBE64(data + 4));
+        const int64_t end = DecodeTokenId(ReadBE64(reinterpret_cast<const unsigned char*>(value.data())));
+
+        uniqueMap[ReadBE32(data)].emplace_back(start, end);
+    }
+    delete it;
+    return uniqueMap;
+}
 
+/* Calls the function with the property ID, range and owner of every range of non-fungible tokens in the snapshot
+ */
+void CMPNonFungibleTokensDB::ForEachRange(const std::shared_ptr<const leveldb::Snapshot>& snapshot, const std::function<void(uint32_t, int64_t, int64_t, const std::string&)>& fn)
+{
+    assert(pdb);
+    const std::string prefix(1, static_cast<StorageType>(NonFungibleStorage::RangeIndex));
+    leveldb::Iterator* it = NewSnapshotIterator(snapshot);
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        const std::string key = it->key().ToString();
         int64_t start, end;
-        GetRangeFromKey(it->key().ToString(), &start, &end);
-
-        uniqueMap[id].emplace_back(start, end);
+        GetRangeFromKey(key, &start, &end);
+        fn(GetPropertyIdFromKey(key), start, end, it->value().ToString());
     }
     delete it;
-    return uniqueMap;
 }
 
 /* Gets the ranges of non-fungible tokens for a property
  */
-std::vector<std::pair<std::string,std::pair<int64_t,int64_t> > > CMPNonFungibleTokensDB::GetNonFungibleTokenRanges(const uint32_t &propertyId)
+std::vector<std::pair<std::string,std::pair<int64_t,int64_t> > > CMPNonFungibleTokensDB::GetNonFungibleTokenRanges(const uint32_t &propertyId, int64_t tokenIdAfter, size_t nMax)
 {
     std::vector<std::pair<std::string,std::pair<int64_t,int64_t> > > rangeMap;
 
     assert(pdb);
+    if (tokenIdAfter == std::numeric_limits<int64_t>::max()) return rangeMap;
 
-    leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        if (propertyId != GetPropertyIdFromKey(it->key().ToString()) ||
-                GetTypeFromKey(it->key().ToString()) != NonFungibleStorage::RangeIndex) continue;
-
+    // the ranges are ordered by their first token, so the iteration starts at the first one after the given token
+    const std::string prefix = RangeKeyPrefix(NonFungibleStorage::RangeIndex, propertyId);
+    leveldb::Iterator* it = NewSnapshotIterator();
+    for (it->Seek(RangeKey(NonFungibleStorage::RangeIndex, propertyId, tokenIdAfter + 1, 0)); it->Valid() && it->key().starts_with(prefix) && rangeMap.size() < nMax; it->Next()) {
         std::string address = it->value().ToString();
         int64_t start, end;
         GetRangeFromKey(it->key().ToString(), &start, &end);
@@ -401,7 +486,7 @@ std::vector<std::pair<std::string,std::pair<int64_t,int64_t> > > CMPNonFungibleT
     return rangeMap;
 }
 
-void CMPNonFungibleTokensDB::SanityCheck()
+void CMPNonFungibleTokensDB::SanityCheck(bool fFull)
 {
     assert(pdb);
 
@@ -409,17 +494,25 @@ void CMPNonFungibleTokensDB::SanityCheck()
 
     std::map<uint32_t,int64_t> totals;
 
-    leveldb::Iterator* it = NewIterator();
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        if (GetTypeFromKey(it->key().ToString()) != NonFungibleStorage::RangeIndex) continue;
-        uint32_t propertyId = GetPropertyIdFromKey(it->key().ToString());
-        int64_t start, end;
-        GetRangeFromKey(it->key().ToString(), &start, &end);
-        if (end > totals[propertyId]) {
-            totals[propertyId] = end;
+    if (fFull) {
+        const std::string prefix(1, static_cast<StorageType>(NonFungibleStorage::RangeIndex));
+        leveldb::Iterator* it = NewIterator();
+        for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+            uint32_t propertyId = GetPropertyIdFromKey(it->key().ToString());
+            int64_t start, end;
+            GetRangeFromKey(it->key().ToString(), &start, &end);
+            if (end > totals[propertyId]) {
+                totals[propertyId] = end;
+            }
+        }
+        delete it;
+    } else {
+        // only the properties modified since the last check can have changed
+        for (uint32_t propertyId : setModifiedProperties) {
+            totals[propertyId] = GetHighestRangeEnd(propertyId);
         }
     }
-    delete it;
+    setModifiedProperties.clear();
 
     for (std::map<uint32_t,int64_t>::iterator it = totals.begin(); it != totals.end(); ++it) {
         if (mastercore::getTotalTokens(it->first) != it->second) {
@@ -430,7 +523,26 @@ void CMPNonFungibleTokensDB::SanityCheck()
         }
     }
 
-    if (msc_debug_nftdb) PrintToLog("UTDB sanity check OK (%s)\n", result);
+    PrintToLogVerbose(msc_debug_nftdb, "UTDB sanity check OK (%s)\n", result);
+}
+
+/* Discards the cached ranges, which are loaded from the database again
+ */
+void CMPNonFungibleTokensDB::OnWritesApplied(const std::vector<CDBWrite>& vWrites)
+{
+    LOCK(m_cache_mutex);
+    m_rangeCache.clear();
+}
+
+/* Deletes all entries of the database and the cached ranges
+ */
+void CMPNonFungibleTokensDB::Clear()
+{
+    {
+        LOCK(m_cache_mutex);
+        m_rangeCache.clear();
+    }
+    CDBBase::Clear();
 }
 
 void CMPNonFungibleTokensDB::printStats()
@@ -448,10 +560,14 @@ void CMPNonFungibleTokensDB::printAll()
         skey = it->key();
         svalue = it->value();
         ++count;
-        PrintToConsole("entry #%8d= %s:%s\n", count, skey.ToString(), svalue.ToString());
-//      PrintToLog("entry #%8d= %s:%s\n", count, skey.ToString(), svalue.ToString());
+        PrintToConsole("entry #%8d= %s:%s\n", count, HexStr(skey.ToString()), svalue.ToString());
     }
 
     delete it;
 }
 
+void mastercore::FullNonFungibleTokenSanityCheck()
+{
+    LOCK(cs_tally);
+    if (pDbNFT) pDbNFT->SanityCheck(true);
+}
@@ -9,6 +9,16 @@
 #include <stdint.h>
 #include <boost/filesystem.hpp>
 
+#include <sync.h>
+
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+
 enum class NonFungibleStorage : unsigned char
 {
     None       = 0,
@@ -16,12 +26,31 @@ enum class NonFungibleStorage : unsigned char
     GrantData  = 'G',
     IssuerData = 'I',
     HolderData = 'H',
+    OwnerIndex = 'O',
 };
 
 /** LevelDB based storage for non-fungible tokens, with uid range (propertyid_tokenidstart-tokenidend) as key and token owner (address) as value.
+ *
+ * The owned ranges are also indexed by owner, property and range start, to list the tokens of an address.
  */
 class CMPNonFungibleTokensDB : public CDBBase
 {
+private:
+    //! Properties, whose ranges were modified since the last sanity check
+    std::set<uint32_t> setModifiedProperties;
+
+    //! Ranges of a property and type, by their first token, with their last token and value
+    typedef std::map<int64_t, std::pair<int64_t, std::string>> RangeCache;
+
+    mutable Mutex m_cache_mutex;
+    //! Ranges of the properties and types looked up so far, which are written through to the database
+    std::map<std::pair<uint32_t, NonFungibleStorage>, RangeCache> m_rangeCache GUARDED_BY(m_cache_mutex);
+
+    // Returns the cached ranges of a property and type, which are loaded from the database on first use
+    RangeCache& GetCachedRanges(uint32_t propertyId, NonFungibleStorage type) EXCLUSIVE_LOCKS_REQUIRED(m_cache_mutex);
+
+    // Discards the cached ranges, which may be outdated after applied writes
+    void OnWritesApplied(const std::vector<CDBWrite>& vWrites) override;
 
 public:
     CMPNonFungibleTokensDB(const boost::filesystem::path& path, bool fWipe)
@@ -32,12 +61,15 @@ public:
 
     virtual ~CMPNonFungibleTokensDB()
     {
-        if (msc_debug_persistence) PrintToLog("CMPNonFungibleTokensDB closed\n");
+        PrintToLogVerbose(msc_debug_persistence, "CMPNonFungibleTokensDB closed\n");
     }
 
     void printStats();
     void printAll();
 
+    // Deletes all entries of the database and the cached ranges
+    void Clear() override;
+
     // Helper to extract the property ID from a DB key
     uint32_t GetPropertyIdFromKey(const std::string& key);
     // Extracts the storage type from a DB key
@@ -45,6 +77,9 @@ public:
     // Helper to extracts the range from a DB key
     void GetRangeFromKey(const std::string& key, int64_t *start, int64_t *end);
 
+    // Finds the range of a property and type, which contains a token, and its value
+    bool FindRange(const uint32_t &propertyId, const int64_t &tokenId, const NonFungibleStorage type, int64_t *start, int64_t *end, std::string *value);
+
     // Gets the owner of a range of non-fungible tokens
     std::string GetNonFungibleTokenOwner(const uint32_t &propertyId, const int64_t &tokenId);
     // Gets the data set in a non-fungible token
@@ -65,17 +100,25 @@ public:
     bool ChangeNonFungibleTokenData(const uint32_t &propertyId, const int64_t &tokenIdStart, const int64_t &tokenIdEnd, const std::string &data, const NonFungibleStorage type);
     // Adds a range of non-fungible tokens
     void AddRange(const uint32_t &propertyId, const int64_t &tokenIdStart, const int64_t &tokenIdEnd, const std::string &owner, const NonFungibleStorage type);
-    // Gets the non-fungible token ranges for a property ID and address
+    // Gets the non-fungible token ranges for a property ID and address, after the last processed block
     std::map<uint32_t, std::vector<std::pair<int64_t, int64_t>>> GetAddressNonFungibleTokens(const uint32_t &propertyId, const std::string &address);
-    // Gets the non-fungible token ranges for a property ID
-    std::vector<std::pair<std::string,std::pair<int64_t,int64_t> > > GetNonFungibleTokenRanges(const uint32_t &propertyId);
-    // Sanity checks the token counts
-    void SanityCheck();
+    // Calls the function with the property ID, range and owner of every range of non-fungible tokens in the snapshot
+    void ForEachRange(const std::shared_ptr<const leveldb::Snapshot>& snapshot, const std::function<void(uint32_t, int64_t, int64_t, const std::string&)>& fn);
+    // Gets the non-fungible token ranges for a property ID, which start after a token, after the last processed block, at most nMax ranges
+    std::vector<std::pair<std::string,std::pair<int64_t,int64_t> > > GetNonFungibleTokenRanges(const uint32_t &propertyId, int64_t tokenIdAfter = 0, size_t nMax = std::numeric_limits<size_t>::max());
+    // Sanity checks the token counts of the properties modified since the last check, or of all properties
+    void SanityCheck(bool fFull = false);
 };
 
 namespace mastercore
 {
+    //! Default interval of the full sanity check of the non-fungible tokens in seconds, 0 to disable
+    static const int64_t DEFAULT_NFT_CHECK_INTERVAL = 0;
+
     extern CMPNonFungibleTokensDB *pDbNFT;
+
+    /** Runs the full sanity check of the non-fungible tokens, if the database is open. */
+    void FullNonFungibleTokenSanityCheck();
 }
 
 #endif // BITCOIN_OMNICORE_NFTDB_H
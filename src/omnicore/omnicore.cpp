@@ -7,54 +7,92 @@
 #include <omnicore/omnicore.h>
 
 #include <omnicore/activation.h>
+#include <omnicore/addresscache.h>
+#include <omnicore/amountformat.h>
+#include <omnicore/arena.h>
+#include <omnicore/balancenotify.h>
+#include <omnicore/blockactivity.h>
+#include <omnicore/blockfile.h>
+#include <omnicore/blockqueue.h>
+#include <omnicore/bootstrap.h>
 #include <omnicore/consensushash.h>
 #include <omnicore/convert.h>
+#include <omnicore/dbaddressfilter.h>
+#include <omnicore/dbaddressindex.h>
+#include <omnicore/dbbalancechanges.h>
+#include <omnicore/dbbalancehistory.h>
 #include <omnicore/dbbase.h>
 #include <omnicore/dbfees.h>
+#include <omnicore/dbmarkers.h>
+#include <omnicore/dbprevout.h>
 #include <omnicore/dbspinfo.h>
 #include <omnicore/dbstolist.h>
 #include <omnicore/dbtradelist.h>
 #include <omnicore/dbtransaction.h>
 #include <omnicore/dbtxlist.h>
 #include <omnicore/dex.h>
+#include <omnicore/historyprune.h>
+#include <omnicore/indexproperties.h>
+#include <omnicore/inputcache.h>
 #include <omnicore/log.h>
+#include <omnicore/marker.h>
 #include <omnicore/mdex.h>
+#include <omnicore/memusage.h>
+#include <omnicore/metrics.h>
 #include <omnicore/notifications.h>
 #include <omnicore/parsing.h>
 #include <omnicore/pending.h>
+#include <omnicore/perfstats.h>
 #include <omnicore/persistence.h>
+#include <omnicore/replay.h>
 #include <omnicore/rules.h>
+#include <omnicore/scanprefetch.h>
+#include <omnicore/scanstatus.h>
 #include <omnicore/script.h>
 #include <omnicore/seedblocks.h>
+#include <omnicore/snapshot.h>
 #include <omnicore/sp.h>
+#include <omnicore/statedelta.h>
 #include <omnicore/tally.h>
+#include <omnicore/timedmutex.h>
+#include <omnicore/trace.h>
 #include <omnicore/tx.h>
+#include <omnicore/txnotify.h>
+#include <omnicore/txobjectcache.h>
+#include <omnicore/undo.h>
 #include <omnicore/utilsbitcoin.h>
 #include <omnicore/utilsui.h>
 #include <omnicore/version.h>
 #include <omnicore/walletcache.h>
 #include <omnicore/walletutils.h>
+#include <omnicore/workerpool.h>
 
 #include <base58.h>
 #include <chainparams.h>
 #include <coins.h>
 #include <core_io.h>
+#include <cuckoocache.h>
 #include <fs.h>
+#include <index/txindex.h>
 #include <key_io.h>
 #include <init.h>
 #include <validation.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <script/script.h>
+#include <script/sigcache.h>
 #include <script/standard.h>
 #include <shutdown.h>
+#include <span.h>
 #include <sync.h>
 #include <tinyformat.h>
 #include <uint256.h>
 #include <ui_interface.h>
 #include <util/system.h>
+#include <util/memory.h>
 #include <util/strencodings.h>
 #include <util/time.h>
+#include <validationinterface.h>
 #ifdef ENABLE_WALLET
 #include <wallet/ismine.h>
 #include <wallet/wallet.h>
@@ -62,20 +100,28 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 using namespace mastercore;
 
 //! Global lock for state objects
-RecursiveMutex cs_tally;
+CTimedRecursiveMutex cs_tally("cs_tally");
 
 //! Exodus address (changes based on network)
 static std::string exodus_address = "1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P";
@@ -89,6 +135,16 @@ static const std::string getmoney_testnet = "moneyqMan7uh8FqdCA2BV5yZ8qVrc9ikLP"
 
 static int nWaterlineBlock = 0;
 
+//! Number of transactions with Omni markers in the block being processed, guarded by cs_tally
+static unsigned int nBlockMarkers = 0;
+
+//! Whether the databases are loaded in bulk during the initial scan, guarded by cs_tally
+static bool fBulkLoadMode = false;
+//! Number of blocks, after which the database writes are committed in bulk-load mode
+static const int BULK_LOAD_COMMIT_INTERVAL = 1000;
+//! Minimal number of addresses without balances, before they are removed from the tally map
+static const size_t MIN_EMPTY_ADDRESSES_REMOVED = 100000;
+
 /**
  * Used to indicate, whether to automatically commit created transactions.
  *
@@ -126,6 +182,18 @@ COmniFeeCache* mastercore::pDbFeeCache;
 COmniFeeHistory* mastercore::pDbFeeHistory;
 //! LevelDB based storage for UITs
 CMPNonFungibleTokensDB *mastercore::pDbNFT;
+//! LevelDB based storage for outputs spent by Omni transactions, optional
+COmniPrevoutDB* mastercore::pDbPrevout = nullptr;
+//! LevelDB based storage of blocks with transactions, which carry Omni markers
+COmniMarkerIndex* mastercore::pDbMarkers = nullptr;
+//! LevelDB based storage of compact filters over the addresses touched by Omni transactions, optional
+COmniAddressFilterIndex* mastercore::pDbAddressFilter = nullptr;
+//! LevelDB based storage of the balances after each block, optional
+COmniBalanceHistory* mastercore::pDbBalanceHistory = nullptr;
+//! LevelDB based index of the balance changes of every address, optional
+COmniBalanceChangeIndex* mastercore::pDbBalanceChanges = nullptr;
+//! LevelDB based index of the Omni transactions of every address, optional
+COmniAddressIndex* mastercore::pDbAddressIndex = nullptr;
 
 //! In-memory collection of DEx offers
 OfferMap mastercore::my_offers;
@@ -138,9 +206,11 @@ CrowdMap mastercore::my_crowds;
 std::set<std::pair<uint32_t,int> > setFreezingEnabledProperties;
 //! Set containing addresses that have been frozen
 std::set<std::pair<std::string,uint32_t> > setFrozenAddresses;
+//! Frozen addresses by property, derived from setFrozenAddresses, to check freezes with one hash lookup
+static std::unordered_map<uint32_t, std::unordered_set<std::string> > mapFrozenByProperty;
 
 //! In-memory collection of all amounts for all addresses for all properties
-std::unordered_map<std::string, CMPTally> mastercore::mp_tally_map;
+CMPTallyMap mastercore::mp_tally_map;
 
 // Only needed for GUI:
 
@@ -176,46 +246,22 @@ std::string mastercore::strMPProperty(uint32_t propertyId)
 
 std::string FormatDivisibleShortMP(int64_t n)
 {
-    if (n == std::numeric_limits<int64_t>::min()) // Avoids overflow when getting absolute value
-        return "ErrorAmount";
-    int64_t n_abs = (n > 0 ? n : -n);
-    int64_t quotient = n_abs / COIN;
-    int64_t remainder = n_abs % COIN;
-    std::string str = strprintf("%d.%08d", quotient, remainder);
-    // clean up trailing zeros - good for RPC not so much for UI
-    str.erase(str.find_last_not_of('0') + 1, std::string::npos);
-    if (str.length() > 0) {
-        std::string::iterator it = str.end() - 1;
-        if (*it == '.') {
-            str.erase(it);
-        }
-    } //get rid of trailing dot if non decimal
-    return str;
+    char buf[AMOUNT_BUFFER_SIZE];
+    return std::string(buf, FormatDivisibleShortAmount(buf, n));
 }
 
 std::string FormatDivisibleMP(int64_t n, bool fSign)
 {
     // Note: not using straight sprintf here because we do NOT want
     // localized number formatting.
-    if (n == std::numeric_limits<int64_t>::min()) // Avoids overflow when getting absolute value
-        return "ErrorAmount";
-    int64_t n_abs = (n > 0 ? n : -n);
-    int64_t quotient = n_abs / COIN;
-    int64_t remainder = n_abs % COIN;
-    std::string str = strprintf("%d.%08d", quotient, remainder);
-
-    if (!fSign) return str;
-
-    if (n < 0)
-        str.insert((unsigned int) 0, 1, '-');
-    else
-        str.insert((unsigned int) 0, 1, '+');
-    return str;
+    char buf[AMOUNT_BUFFER_SIZE];
+    return std::string(buf, FormatDivisibleAmount(buf, n, fSign));
 }
 
 std::string FormatIndivisibleMP(int64_t n)
 {
-    return strprintf("%d", n);
+    char buf[AMOUNT_BUFFER_SIZE];
+    return std::string(buf, FormatIndivisibleAmount(buf, n));
 }
 
 std::string FormatShortMP(uint32_t property, int64_t n)
@@ -247,11 +293,12 @@ std::string FormatByType(int64_t amount, uint16_t propertyType)
 
 CMPTally* mastercore::getTally(const std::string& address)
 {
-    std::unordered_map<std::string, CMPTally>::iterator it = mp_tally_map.find(address);
-
-    if (it != mp_tally_map.end()) return &(it->second);
+    return mp_tally_map.Get(address);
+}
 
-    return static_cast<CMPTally*>(nullptr);
+CMPTally* mastercore::getTally(uint32_t addressId)
+{
+    return mp_tally_map.Get(addressId);
 }
 
 // look at balance for an address
@@ -263,9 +310,9 @@ int64_t GetTokenBalance(const std::string& address, uint32_t propertyId, TallyTy
     }
 
     LOCK(cs_tally);
-    const std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.find(address);
-    if (my_it != mp_tally_map.end()) {
-        balance = (my_it->second).getMoney(propertyId, ttype);
+    const CMPTally* tally = mp_tally_map.Get(address);
+    if (tally) {
+        balance = tally->getMoney(propertyId, ttype);
     }
 
     return balance;
@@ -323,6 +370,17 @@ void mastercore::ClearFreezeState()
     // Should only ever be called in the event of a reorg
     setFreezingEnabledProperties.clear();
     setFrozenAddresses.clear();
+    mapFrozenByProperty.clear();
+}
+
+void mastercore::RestoreFreezeState(const std::set<std::pair<uint32_t,int> >& enabledProperties, const std::set<std::pair<std::string,uint32_t> >& frozenAddresses)
+{
+    setFreezingEnabledProperties = enabledProperties;
+    setFrozenAddresses = frozenAddresses;
+    mapFrozenByProperty.clear();
+    for (const std::pair<std::string,uint32_t>& frozen : setFrozenAddresses) {
+        mapFrozenByProperty[frozen.second].insert(frozen.first);
+    }
 }
 
 void mastercore::PrintFreezeState()
@@ -346,25 +404,26 @@ void mastercore::enableFreezing(uint32_t propertyId, int liveBlock)
 
 void mastercore::disableFreezing(uint32_t propertyId)
 {
-    int liveBlock = 0;
-    for (std::set<std::pair<uint32_t,int> >::iterator it = setFreezingEnabledProperties.begin(); it != setFreezingEnabledProperties.end(); it++) {
-        if (propertyId == (*it).first) {
-            liveBlock = (*it).second;
-        }
-    }
+    // the entries of a property are adjacent and ordered by block, the last one is removed
+    std::set<std::pair<uint32_t,int> >::iterator it = setFreezingEnabledProperties.upper_bound(std::make_pair(propertyId, std::numeric_limits<int>::max()));
+    assert(it != setFreezingEnabledProperties.begin());
+    --it;
+    int liveBlock = (*it).first == propertyId ? (*it).second : 0;
     assert(liveBlock > 0);
 
-    setFreezingEnabledProperties.erase(std::make_pair(propertyId, liveBlock));
+    setFreezingEnabledProperties.erase(it);
     PrintToLog("Freezing for property %d has been disabled.\n", propertyId);
 
     // When disabling freezing for a property, all frozen addresses for that property will be unfrozen!
-    for (std::set<std::pair<std::string,uint32_t> >::iterator it = setFrozenAddresses.begin(); it != setFrozenAddresses.end(); ) {
-        if ((*it).second == propertyId) {
-            PrintToLog("Address %s has been unfrozen for property %d.\n", (*it).first, propertyId);
-            it = setFrozenAddresses.erase(it);
-            assert(!isAddressFrozen((*it).first, (*it).second));
-        } else {
-            it++;
+    std::unordered_map<uint32_t, std::unordered_set<std::string> >::iterator itFrozen = mapFrozenByProperty.find(propertyId);
+    if (itFrozen != mapFrozenByProperty.end()) {
+        std::vector<std::string> vUnfrozen(itFrozen->second.begin(), itFrozen->second.end());
+        std::sort(vUnfrozen.begin(), vUnfrozen.end());
+        mapFrozenByProperty.erase(itFrozen);
+        for (const std::string& address : vUnfrozen) {
+            setFrozenAddresses.erase(std::make_pair(address, propertyId));
+            PrintToLog("Address %s has been unfrozen for property %d.\n", address, propertyId);
+            assert(!isAddressFrozen(address, propertyId));
         }
     }
 
@@ -373,19 +432,15 @@ void mastercore::disableFreezing(uint32_t propertyId)
 
 bool mastercore::isFreezingEnabled(uint32_t propertyId, int block)
 {
-    for (std::set<std::pair<uint32_t,int> >::iterator it = setFreezingEnabledProperties.begin(); it != setFreezingEnabledProperties.end(); it++) {
-        uint32_t itemPropertyId = (*it).first;
-        int itemBlock = (*it).second;
-        if (propertyId == itemPropertyId && block >= itemBlock) {
-            return true;
-        }
-    }
-    return false;
+    // the first entry of a property has the lowest block
+    std::set<std::pair<uint32_t,int> >::const_iterator it = setFreezingEnabledProperties.lower_bound(std::make_pair(propertyId, std::numeric_limits<int>::min()));
+    return it != setFreezingEnabledProperties.end() && (*it).first == propertyId && block >= (*it).second;
 }
 
 void mastercore::freezeAddress(const std::string& address, uint32_t propertyId)
 {
     setFrozenAddresses.insert(std::make_pair(address, propertyId));
+    mapFrozenByProperty[propertyId].insert(address);
     assert(isAddressFrozen(address, propertyId));
     PrintToLog("Address %s has been frozen for property %d.\n", address, propertyId);
 }
@@ -393,16 +448,30 @@ void mastercore::freezeAddress(const std::string& address, uint32_t propertyId)
 void mastercore::unfreezeAddress(const std::string& address, uint32_t propertyId)
 {
     setFrozenAddresses.erase(std::make_pair(address, propertyId));
+    std::unordered_map<uint32_t, std::unordered_set<std::string> >::iterator it = mapFrozenByProperty.find(propertyId);
+    if (it != mapFrozenByProperty.end()) {
+        it->second.erase(address);
+        if (it->second.empty()) mapFrozenByProperty.erase(it);
+    }
     assert(!isAddressFrozen(address, propertyId));
     PrintToLog("Address %s has been unfrozen for property %d.\n", address, propertyId);
 }
 
 bool mastercore::isAddressFrozen(const std::string& address, uint32_t propertyId)
 {
-    if (setFrozenAddresses.find(std::make_pair(address, propertyId)) != setFrozenAddresses.end()) {
-        return true;
-    }
-    return false;
+    // most properties have no frozen addresses, so the address is only hashed for the others
+    std::unordered_map<uint32_t, std::unordered_set<std::string> >::const_iterator it = mapFrozenByProperty.find(propertyId);
+    return it != mapFrozenByProperty.end() && it->second.count(address) != 0;
+}
+
+const std::set<std::pair<std::string, uint32_t> >& mastercore::GetFrozenAddresses()
+{
+    return setFrozenAddresses;
+}
+
+const std::set<std::pair<uint32_t, int> >& mastercore::GetFreezingEnabledProperties()
+{
+    return setFreezingEnabledProperties;
 }
 
 std::string mastercore::getTokenLabel(uint32_t propertyId)
@@ -424,7 +493,6 @@ std::string mastercore::getTokenLabel(uint32_t propertyId)
 // optionally counts the number of addresses who own that property: n_owners_total
 int64_t mastercore::getTotalTokens(uint32_t propertyId, int64_t* n_owners_total)
 {
-    int64_t prev = 0;
     int64_t owners = 0;
     int64_t totalTokens = 0;
 
@@ -436,19 +504,21 @@ int64_t mastercore::getTotalTokens(uint32_t propertyId, int64_t* n_owners_total)
     }
 
     if (!property.fixed || n_owners_total) {
-        for (std::unordered_map<std::string, CMPTally>::const_iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-            const CMPTally& tally = it->second;
-
-            totalTokens += tally.getMoney(propertyId, BALANCE);
-            totalTokens += tally.getMoney(propertyId, SELLOFFER_RESERVE);
-            totalTokens += tally.getMoney(propertyId, ACCEPT_RESERVE);
-            totalTokens += tally.getMoney(propertyId, METADEX_RESERVE);
-
-            if (prev != totalTokens) {
-                prev = totalTokens;
-                owners++;
+        // the totals are updated with every balance change
+        totalTokens = mp_tally_map.GetTotalTokens(propertyId);
+        owners = mp_tally_map.GetOwnerCount(propertyId);
+
+        if (OMNI_VERBOSE_LOG && msc_debug_tally_totals) {
+            // the balance columns of the holders are summed, rather than every tally
+            const CPropertyBalances& balances = mp_tally_map.GetBalances(propertyId);
+            int64_t scannedTokens = balances.GetTotalTokens();
+            int64_t scannedOwners = balances.GetOwnerCount();
+            if (scannedTokens != totalTokens || scannedOwners != owners) {
+                PrintToLog("%s(%d): ERROR: running totals (tokens=%d, owners=%d) don't match the tally map (tokens=%d, owners=%d)\n",
+                        __func__, propertyId, totalTokens, owners, scannedTokens, scannedOwners);
             }
         }
+
         int64_t cachedFee = pDbFeeCache->GetCachedAmount(propertyId);
         totalTokens += cachedFee;
     }
@@ -462,6 +532,14 @@ int64_t mastercore::getTotalTokens(uint32_t propertyId, int64_t* n_owners_total)
     return totalTokens;
 }
 
+// the running totals and the fee cache are both kept in memory
+int64_t mastercore::getVariableTotalTokens(uint32_t propertyId)
+{
+    LOCK(cs_tally);
+
+    return mp_tally_map.GetTotalTokens(propertyId) + pDbFeeCache->GetCachedAmount(propertyId);
+}
+
 // return true if everything is ok
 bool mastercore::update_tally_map(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype)
 {
@@ -474,35 +552,55 @@ bool mastercore::update_tally_map(const std::string& who, uint32_t propertyId, i
         return false;
     }
 
+    LOCK(cs_tally);
+
+    // an empty tally is added for unknown addresses
+    return update_tally_map(mp_tally_map.AddAddress(who), propertyId, amount, ttype);
+}
+
+// the amount must not be zero, and the tally type must be valid
+bool mastercore::update_tally_map(uint32_t addressId, uint32_t propertyId, int64_t amount, TallyType ttype)
+{
+    if (0 == amount || ttype >= TALLY_TYPE_COUNT) {
+        return false;
+    }
+
     bool bRet = false;
     int64_t before = 0;
     int64_t after = 0;
 
     LOCK(cs_tally);
 
+    CMPTally* pTally = mp_tally_map.Get(addressId);
+    if (!pTally) {
+        PrintToLog("%s(%u, %u=0x%X, %+d, ttype=%d) ERROR: unknown address identifier\n", __func__, addressId, propertyId, propertyId, amount, ttype);
+        return false;
+    }
+    CMPTally& tally = *pTally;
+    const std::string& who = mp_tally_map.GetAddress(addressId);
+
     if (ttype == BALANCE && amount < 0) {
         assert(!isAddressFrozen(who, propertyId)); // for safety, this should never fail if everything else is working properly.
     }
 
-    before = GetTokenBalance(who, propertyId, ttype);
+    before = tally.getMoney(propertyId, ttype);
 
-    std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.find(who);
-    if (my_it == mp_tally_map.end()) {
-        // insert an empty element
-        my_it = (mp_tally_map.insert(std::make_pair(who, CMPTally()))).first;
-    }
-
-    CMPTally& tally = my_it->second;
-    bRet = tally.updateMoney(propertyId, amount, ttype);
+    bRet = mp_tally_map.UpdateMoney(addressId, propertyId, amount, ttype);
 
-    after = GetTokenBalance(who, propertyId, ttype);
+    after = tally.getMoney(propertyId, ttype);
     if (!bRet) {
         assert(before == after);
         PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: insufficient balance (=%d)\n", __func__, who, propertyId, propertyId, amount, ttype, before);
+    } else if (ttype != PENDING) {
+        RecordBalanceChange(who, propertyId);
+        if (pDbAddressFilter) pDbAddressFilter->AddAddress(who);
+        if (pDbBalanceChanges && IsIndexedProperty(propertyId)) pDbBalanceChanges->RecordChange(who, propertyId, ttype, amount, after);
+        if (pDbAddressIndex) pDbAddressIndex->MarkProperty(propertyId);
     }
     if (msc_debug_tally && (exodus_address != who || msc_debug_exo)) {
         PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d): before=%d, after=%d\n", __func__, who, propertyId, propertyId, amount, ttype, before, after);
     }
+    OMNI_TRACE5(tally_update, who.c_str(), propertyId, amount, (int) ttype, bRet);
 
     return bRet;
 }
@@ -554,7 +652,7 @@ static int64_t calculate_and_update_devmsc(unsigned int nTime, int block)
     devmsc = rounduint64(available_reward);
     exodus_delta = devmsc - exodus_prev;
 
-    if (msc_debug_exo) PrintToLog("devmsc=%d, exodus_prev=%d, exodus_delta=%d\n", devmsc, exodus_prev, exodus_delta);
+    PrintToLogVerbose(msc_debug_exo, "devmsc=%d, exodus_prev=%d, exodus_delta=%d\n", devmsc, exodus_prev, exodus_delta);
 
     // skip if a block's timestamp is older than that of a previous one!
     if (0 > exodus_delta) return 0;
@@ -598,6 +696,18 @@ void NotifyTotalTokensChanged(uint32_t propertyId, int block)
 
 void CheckWalletUpdate(bool forceUpdate)
 {
+    // the pairs are taken in any case, so they don't accumulate without UI
+    std::set<md_PropertyPair> setPairs;
+    {
+        LOCK(cs_tally);
+        if (!MetaDEx_TakeModifiedPairs(setPairs, MD_MODIFIED_UI)) {
+            // all orders were replaced, so every pair with open orders is refreshed
+            for (const auto& entry : metadex) {
+                setPairs.insert(entry.first);
+            }
+        }
+    }
+
 #ifdef ENABLE_WALLET
     if (!HasWallets()) {
         return;
@@ -610,43 +720,24 @@ void CheckWalletUpdate(bool forceUpdate)
         return;
     }
 
-    if (!WalletCacheUpdate()) {
+    // the order books are refreshed before the balances, so both are consistent in the UI
+    if (!setPairs.empty()) {
+        uiInterface.OmniMetaDExPairsChanged(setPairs);
+    }
+
+    // the cache and the wallet totals are updated for the modified addresses only
+    std::set<uint32_t> setPropertyIds;
+    if (!WalletCacheUpdate(&setPropertyIds)) {
         // no balance changes were detected that affect wallet addresses, signal a generic change to overall Omni state
         if (!forceUpdate) {
             uiInterface.OmniStateChanged();
             return;
         }
     }
-#ifdef ENABLE_WALLET
-    LOCK(cs_tally);
 
-    // balance changes were found in the wallet, update the global totals and signal a Omni balance change
-    global_balance_money.clear();
-    global_balance_reserved.clear();
-
-    // populate global balance totals and wallet property list - note global balances do not include additional balances from watch-only addresses
-    for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-        // check if the address is a wallet address (including watched addresses)
-        std::string address = my_it->first;
-        int addressIsMine = IsMyAddressAllWallets(address, false, ISMINE_SPENDABLE);
-        if (!addressIsMine) continue;
-        // iterate only those properties in the TokenMap for this address
-        my_it->second.init();
-        uint32_t propertyId;
-        while (0 != (propertyId = (my_it->second).next())) {
-            // add to the global wallet property list
-            global_wallet_property_list.insert(propertyId);
-            // check if the address is spendable (only spendable balances are included in totals)
-            if (addressIsMine != ISMINE_SPENDABLE) continue;
-            // work out the balances and add to globals
-            global_balance_money[propertyId] += GetAvailableTokenBalance(address, propertyId);
-            global_balance_reserved[propertyId] += GetTokenBalance(address, propertyId, SELLOFFER_RESERVE);
-            global_balance_reserved[propertyId] += GetTokenBalance(address, propertyId, METADEX_RESERVE);
-            global_balance_reserved[propertyId] += GetTokenBalance(address, propertyId, ACCEPT_RESERVE);
-        }
-    }
-    // signal an Omni balance change
-    uiInterface.OmniBalanceChanged();
+#ifdef ENABLE_WALLET
+    // signal an Omni balance change with the properties, whose wallet balances changed
+    uiInterface.OmniBalanceChanged(setPropertyIds);
 #endif
 }
 
@@ -679,72 +770,127 @@ static bool TXExodusFundraiser(const CTransaction& tx, const std::string& sender
     return false;
 }
 
-//! Cache for potential Omni Layer transactions
-static std::set<uint256> setMarkerCache;
-
-//! Guards marker cache
-static RecursiveMutex cs_marker_cache;
+//! Maximal memory used by the marker cache
+static const size_t MAX_MARKER_CACHE_BYTES = 4 << 20;
 
 /**
- * Checks, if transaction has any Omni marker.
- *
- * Note: this may include invalid or malformed Omni Layer transactions!
+ * Bounded cache for potential Omni Layer transactions in the mempool.
  *
- * MUST NOT BE USED FOR CONSENSUS CRITICAL STUFF!
+ * Lookups and removals only take a shared lock, and the oldest entries are
+ * discarded, when the cache is full. Removed entries are only discarded lazily
+ * and may still be found, so the cache is only consulted for transactions,
+ * which are in the mempool.
  */
-static bool HasMarkerUnsafe(const CTransactionRef& tx)
+class CMarkerCache
 {
-    const std::string strClassC("6f6d6e69");
-    const std::string strClassAB("76a914946cb2e08075bcbaf157e47bcb67eb2b2339d24288ac");
-    const std::string strClassABTest("76a914643ce12b1590633077b8620316f43a9362ef18e588ac");
-    const std::string strClassMoney("76a9145ab93563a289b74c355a9b9258b86f12bb84affb88ac");
+private:
+    CuckooCache::cache<uint256, SignatureCacheHasher> setTxids;
+    boost::shared_mutex cs_marker_cache;
+    CLockStats lockStats;
+    uint32_t nElements;
 
-    for (unsigned int n = 0; n < tx->vout.size(); ++n) {
-        const CTxOut& out = tx->vout[n];
-        std::string str = HexStr(out.scriptPubKey.begin(), out.scriptPubKey.end());
+public:
+    CMarkerCache() : lockStats("cs_marker_cache")
+    {
+        nElements = setTxids.setup_bytes(MAX_MARKER_CACHE_BYTES);
+    }
 
-        if (str.find(strClassC) != std::string::npos) {
-            return true;
-        }
+    void Add(const uint256& txHash)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_marker_cache, boost::defer_lock);
+        LockWithStats(lock, lockStats, __FILE__, __LINE__);
+        setTxids.insert(txHash);
+    }
 
-        if (MainNet()) {
-            if (str == strClassAB) {
-                return true;
-            }
-        } else {
-            if (str == strClassABTest) {
-                return true;
-            }
-            if (str == strClassMoney) {
-                return true;
-            }
-        }
+    void Remove(const uint256& txHash)
+    {
+        // the entry is only marked as discardable, which is allowed with a shared lock
+        boost::shared_lock<boost::shared_mutex> lock(cs_marker_cache, boost::defer_lock);
+        LockWithStats(lock, lockStats, __FILE__, __LINE__);
+        setTxids.contains(txHash, true);
     }
 
-    return false;
-}
+    bool Contains(const uint256& txHash)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_marker_cache, boost::defer_lock);
+        LockWithStats(lock, lockStats, __FILE__, __LINE__);
+        return setTxids.contains(txHash, false);
+    }
+
+    size_t DynamicMemoryUsage() const
+    {
+        // the table and the flags are allocated once
+        return nElements * sizeof(uint256) + (nElements + 7) / 8;
+    }
+};
+
+//! Cache for potential Omni Layer transactions
+static CMarkerCache markerCache;
 
 /** Scans for marker and if one is found, add transaction to marker cache. */
 void TryToAddToMarkerCache(const CTransactionRef &tx)
 {
-    if (HasMarkerUnsafe(tx)) {
-        LOCK(cs_marker_cache);
-        setMarkerCache.insert(tx->GetHash());
+    // the transaction is expected to be confirmed in a future block
+    CMarkerScan scan;
+    ScanMarkers(*tx, std::numeric_limits<int>::max(), scan);
+
+    if (scan.HasMarker()) {
+        markerCache.Add(tx->GetHash());
     }
 }
 
+static void RemoveMempoolDecoded(const uint256& txid);
+
 /** Removes transaction from marker cache. */
 void RemoveFromMarkerCache(const uint256& txHash)
 {
-    LOCK(cs_marker_cache);
-    setMarkerCache.erase(txHash);
+    markerCache.Remove(txHash);
+    RemoveMempoolDecoded(txHash);
 }
 
 /** Checks, if transaction is in marker cache. */
 bool IsInMarkerCache(const uint256& txHash)
 {
-    LOCK(cs_marker_cache);
-    return (setMarkerCache.find(txHash) != setMarkerCache.end());
+    return markerCache.Contains(txHash);
+}
+
+/**
+ * Checks, if a transaction of the mempool has a marker.
+ *
+ * The marker cache is bounded, so transactions, which aren't found, are scanned
+ * again, in case they were evicted.
+ */
+bool HasMempoolMarker(const uint256& txHash)
+{
+    if (markerCache.Contains(txHash)) return true;
+
+    CTransactionRef tx = mempool.get(txHash);
+    if (!tx) return false;
+
+    CMarkerScan scan;
+    ScanMarkers(*tx, std::numeric_limits<int>::max(), scan);
+    return scan.HasMarker();
+}
+
+/**
+ * Checks, if the outputs spent by a transaction of a connected block are captured for the block handlers.
+ *
+ * Only transactions with markers are processed, other transactions, which are examined after
+ * a rule change within the same block, resolve their inputs via the transaction index.
+ */
+bool HasMarkerForInputs(const CTransaction& tx, int nBlock)
+{
+    if (tx.IsCoinBase()) return false;
+
+    CMarkerScan scan;
+    ScanMarkers(tx, nBlock, scan);
+    return scan.HasMarker() || scan.nEncodingClass != NO_MARKER;
+}
+
+/** Returns the heap memory used by the marker cache. */
+size_t mastercore::GetMarkerCacheUsage()
+{
+    return markerCache.DynamicMemoryUsage();
 }
 
 /**
@@ -757,214 +903,222 @@ bool IsInMarkerCache(const uint256& txHash)
  */
 int mastercore::GetEncodingClass(const CTransaction& tx, int nBlock)
 {
-    bool hasExodus = false;
-    bool hasMultisig = false;
-    bool hasOpReturn = false;
-    bool hasMoney = false;
-
-    /* Fast Search
-     * Perform a string comparison on hex for each scriptPubKey & look directly for Exodus hash160 bytes or omni marker bytes
-     * This allows to drop non-Omni transactions with less work
-     */
-    std::string strClassC = "6f6d6e69";
-    std::string strClassAB = "76a914946cb2e08075bcbaf157e47bcb67eb2b2339d24288ac";
-    bool examineClosely = false;
-    for (unsigned int n = 0; n < tx.vout.size(); ++n) {
-        const CTxOut& output = tx.vout[n];
-        std::string strSPB = HexStr(output.scriptPubKey.begin(), output.scriptPubKey.end());
-        if (strSPB != strClassAB) { // not an exodus marker
-            if (nBlock < 395000) { // class C not enabled yet, no need to search for marker bytes
-                continue;
-            } else {
-                if (strSPB.find(strClassC) != std::string::npos) {
-                    examineClosely = true;
-                    break;
-                }
-            }
-        } else {
-            examineClosely = true;
-            break;
-        }
-    }
+    CMarkerScan scan;
+    ScanMarkers(tx, nBlock, scan);
 
-    // Examine everything when not on mainnet
-    if (isNonMainNet()) {
-        examineClosely = true;
-    }
+    return scan.nEncodingClass;
+}
 
-    if (!examineClosely) return NO_MARKER;
+// TODO: move
+CCoinsView mastercore::viewDummy;
+CCoinsViewCache mastercore::view(&viewDummy);
 
-    for (unsigned int n = 0; n < tx.vout.size(); ++n) {
-        const CTxOut& output = tx.vout[n];
+//! Cache of outputs spent by Omni transactions
+COmniInputCache mastercore::inputCache;
 
-        txnouttype outType;
-        if (!GetOutputType(output.scriptPubKey, outType)) {
-            continue;
-        }
-        if (!IsAllowedOutputType(outType, nBlock)) {
-            continue;
-        }
+//! Progress of the initial scan
+CScanStatus mastercore::scanStatus;
 
-        if (outType == TX_PUBKEYHASH) {
-            CTxDestination dest;
-            if (ExtractDestination(output.scriptPubKey, dest)) {
-                if (dest == ExodusAddress()) {
-                    hasExodus = true;
-                }
-                if (dest == ExodusCrowdsaleAddress(nBlock)) {
-                    hasMoney = true;
-                }
-            }
-        }
-        if (outType == TX_MULTISIG) {
-            hasMultisig = true;
-        }
-        if (outType == TX_NULL_DATA) {
-            // Ensure there is a payload, and the first pushed element equals,
-            // or starts with the "omni" marker
-            std::vector<std::string> scriptPushes;
-            if (!GetScriptPushes(output.scriptPubKey, scriptPushes)) {
-                continue;
-            }
-            if (!scriptPushes.empty()) {
-                std::vector<unsigned char> vchMarker = GetOmMarker();
-                std::vector<unsigned char> vchPushed = ParseHex(scriptPushes[0]);
-                if (vchPushed.size() < vchMarker.size()) {
-                    continue;
-                }
-                if (std::equal(vchMarker.begin(), vchMarker.end(), vchPushed.begin())) {
-                    hasOpReturn = true;
-                }
-            }
-        }
-    }
+//! Guards coins view cache and input cache
+CInstrumentedRecursiveMutex mastercore::cs_tx_cache("cs_tx_cache");
 
-    if (hasOpReturn) {
-        return OMNI_CLASS_C;
+/**
+ * Looks up an output in the layers, which don't require cs_main: the coins spent
+ * by the block, the input cache, and the coins view, which holds explicitly
+ * provided inputs.
+ *
+ * Note: cs_tx_cache should be locked!
+ */
+static bool GetCachedInput(const COutPoint& prevout, const std::shared_ptr<std::map<COutPoint, Coin>>& removedCoins, Coin& coin, bool& fFromBlock)
+{
+    fFromBlock = false;
+    if (removedCoins) {
+        std::map<COutPoint, Coin>::const_iterator it = removedCoins->find(prevout);
+        if (it != removedCoins->end()) {
+            coin = it->second;
+            fFromBlock = true;
+            return true;
+        }
     }
-    if (hasExodus && hasMultisig) {
-        return OMNI_CLASS_B;
+    if (inputCache.Get(prevout, coin)) {
+        return true;
     }
-    if (hasExodus || hasMoney) {
-        return OMNI_CLASS_A;
+    const Coin& viewCoin = view.AccessCoin(prevout);
+    if (!viewCoin.IsSpent()) {
+        coin = viewCoin;
+        return true;
     }
-
-    return NO_MARKER;
+    return false;
 }
 
-// TODO: move
-CCoinsView mastercore::viewDummy;
-CCoinsViewCache mastercore::view(&viewDummy);
-
-//! Guards coins view cache
-RecursiveMutex mastercore::cs_tx_cache;
-
-static unsigned int nCacheHits = 0;
-static unsigned int nCacheMiss = 0;
-
 /**
- * Fetches transaction inputs and adds them to the coins view cache.
+ * Fetches the outputs spent by a transaction from the layers, which don't require cs_main.
+ *
+ * Inputs provided by the caller come first, followed by the coins spent by the block,
+ * the input cache and the coins view of explicitly provided inputs.
  *
  * Note: cs_tx_cache should be locked, when adding and accessing inputs!
  *
- * @param tx[in]  The transaction to fetch inputs for
- * @return True, if all inputs were successfully added to the cache
+ * @param tx[in]            The transaction to fetch inputs for
+ * @param removedCoins[in]  Coins spent by the block, which may be used to resolve the inputs
+ * @param pInputs[in]       Inputs provided by the caller, which are not remembered, if any
+ * @param vPrevouts[out]    The spent outputs, in the order of the inputs
+ * @param vMissing[out]     The positions of the inputs, which were not found
+ * @return True, if all inputs were successfully fetched
  */
-static bool FillTxInputCache(const CTransaction& tx, const std::shared_ptr<std::map<COutPoint, Coin>> removedCoins)
+static bool FillTxInputCache(const CTransaction& tx, const std::shared_ptr<std::map<COutPoint, Coin>> removedCoins, const CCoinsViewCache* pInputs, std::vector<CTxOut>& vPrevouts, std::vector<size_t>& vMissing)
 {
-    static unsigned int nCacheSize = gArgs.GetArg("-omnitxcache", 500000);
+    vPrevouts.assign(tx.vin.size(), CTxOut());
+    vMissing.clear();
+
+    for (size_t n = 0; n < tx.vin.size(); ++n) {
+        const COutPoint& prevout = tx.vin[n].prevout;
+        if (pInputs) {
+            const Coin& coin = pInputs->AccessCoin(prevout);
+            if (!coin.IsSpent()) {
+                vPrevouts[n] = coin.out;
+                continue;
+            }
+        }
 
-    if (view.GetCacheSize() > nCacheSize) {
-        PrintToLog("%s(): clearing cache before insertion [size=%d, hit=%d, miss=%d]\n",
-                __func__, view.GetCacheSize(), nCacheHits, nCacheMiss);
-        view.Flush();
+        Coin newcoin;
+        bool fFromBlock = false;
+        if (!GetCachedInput(prevout, removedCoins, newcoin, fFromBlock)) {
+            vMissing.push_back(n);
+            continue;
+        }
+        vPrevouts[n] = newcoin.out;
+        if (!fFromBlock) continue;
+        // remember outputs spent by the block, so they don't need to be looked up again during reparses
+        if (pDbPrevout) pDbPrevout->AddCoin(prevout, newcoin);
+        inputCache.Add(prevout, newcoin);
     }
 
-    for (std::vector<CTxIn>::const_iterator it = tx.vin.begin(); it != tx.vin.end(); ++it) {
-        const CTxIn& txIn = *it;
-        unsigned int nOut = txIn.prevout.n;
-        const Coin& coin = view.AccessCoin(txIn.prevout);
+    return vMissing.empty();
+}
 
-        if (!coin.IsSpent()) {
-            ++nCacheHits;
-            continue;
-        } else {
-            ++nCacheMiss;
+/**
+ * Fetches an output, which isn't cached, from the unspent outputs of the chainstate, the
+ * prevout database, and finally the mempool or the transaction index.
+ *
+ * Each lock is only held for the lookup, which needs it: cs_main for the chainstate and the
+ * block index, and cs_tx_cache for the prevout database and the input cache, while
+ * CTxMemPool::get() holds ::mempool.cs itself. The transaction index is read without any
+ * of them, so slow disk reads don't stall the validation or the mempool acceptance.
+ *
+ * Outputs found in the chainstate are not added to the input cache, because they
+ * are already held in memory by the chainstate's own cache.
+ *
+ * Note: cs_tx_cache must not be locked, unless cs_main is locked before!
+ *
+ * @param prevout[in]   The output to fetch
+ * @param txOut[out]    The output
+ * @return True, if the output was found
+ */
+static bool FetchUncachedInput(const COutPoint& prevout, CTxOut& txOut)
+{
+    Coin coin;
+    {
+        LOCK(cs_main);
+        if (::ChainstateActive().CoinsTip().GetCoin(prevout, coin)) {
+            txOut = coin.out;
+            return true;
         }
-
-        CTransactionRef txPrev;
-        uint256 hashBlock;
-        Coin newcoin;
-        if (removedCoins && removedCoins->find(txIn.prevout) != removedCoins->end()) {
-            newcoin = removedCoins->find(txIn.prevout)->second;
-        } else if (GetTransaction(txIn.prevout.hash, txPrev, Params().GetConsensus(), hashBlock)) {
-            newcoin.out.scriptPubKey = txPrev->vout[nOut].scriptPubKey;
-            newcoin.out.nValue = txPrev->vout[nOut].nValue;
-            BlockMap::iterator bit = ::BlockIndex().find(hashBlock);
-            newcoin.nHeight = bit != ::BlockIndex().end() ? bit->second->nHeight : 1;
-        } else {
-            return false;
+    }
+    {
+        LOCK(cs_tx_cache);
+        if (pDbPrevout && pDbPrevout->GetCoin(prevout, coin)) {
+            inputCache.Add(prevout, coin);
+            txOut = coin.out;
+            return true;
         }
-
-        view.AddCoin(txIn.prevout, std::move(newcoin), true);
     }
 
+    CTransactionRef txPrev;
+    uint256 hashBlock;
+    if (!FetchTransaction(prevout.hash, txPrev, hashBlock)) return false;
+    if (prevout.n >= txPrev->vout.size()) return false;
+
+    const CBlockIndex* pBlockIndex = hashBlock.IsNull() ? nullptr : GetBlockIndex(hashBlock);
+    coin = Coin(txPrev->vout[prevout.n], pBlockIndex ? pBlockIndex->nHeight : 1, false);
+
+    LOCK(cs_tx_cache);
+    // remember confirmed outputs, so they don't need to be looked up again during reparses
+    if (pDbPrevout && pBlockIndex) pDbPrevout->AddCoin(prevout, coin);
+    inputCache.Add(prevout, coin);
+    txOut = coin.out;
     return true;
 }
 
-// idx is position within the block, 0-based
-// int msc_tx_push(const CTransaction &wtx, int nBlock, unsigned int idx)
-// INPUT: bRPConly -- set to true to avoid moving funds; to be called from various RPC calls like this
-// RETURNS: 0 if parsed a MP TX
-// RETURNS: < 0 if a non-MP-TX or invalid
-// RETURNS: >0 if 1 or more payments have been made
-static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock, unsigned int idx, CMPTransaction& mp_tx, unsigned int nTime, const std::shared_ptr<std::map<COutPoint, Coin>> removedCoins = nullptr)
+/**
+ * Prints the header of a parsed transaction to the log, ahead of the transaction fields.
+ */
+static void PrintParseHeader(const CTransaction& wtx, int nBlock, unsigned int idx, unsigned int nTime)
 {
-    assert(bRPConly == mp_tx.isRpcOnly());
-    mp_tx.Set(wtx.GetHash(), nBlock, idx, nTime);
+    if (!msc_debug_packets) return;
 
-    // ### CLASS IDENTIFICATION AND MARKER CHECK ###
-    int omniClass = GetEncodingClass(wtx, nBlock);
+    PrintToLog("____________________________________________________________________________________________________________________________________\n");
+    PrintToLog("%s(block=%d, %s idx= %d); txid: %s\n", "parseTransaction", nBlock, FormatISO8601DateTime(nTime), idx, wtx.GetHash().GetHex());
+}
 
-    if (omniClass == NO_MARKER) {
-        return -1; // No Exodus/Omni marker, thus not a valid Omni transaction
+/**
+ * Fetches the outputs spent by a transaction.
+ *
+ * Most inputs are spent by the block or cached, and the others are fetched one by one,
+ * without holding cs_main or ::mempool.cs across disk reads.
+ *
+ * @param wtx[in]           The transaction to fetch the inputs for
+ * @param vPrevouts[out]    The spent outputs, in the order of the inputs
+ * @param removedCoins[in]  Coins spent by the block, which may be used to resolve the inputs
+ * @param pInputs[in]       Inputs provided by the caller, which are not remembered, if any
+ * @return True, if all inputs could be fetched
+ */
+static bool FetchTransactionInputs(const CTransaction& wtx, std::vector<CTxOut>& vPrevouts, const std::shared_ptr<std::map<COutPoint, Coin>> removedCoins, const CCoinsViewCache* pInputs = nullptr)
+{
+    std::vector<size_t> vMissing;
+    {
+        LOCK(cs_tx_cache);
+        if (FillTxInputCache(wtx, removedCoins, pInputs, vPrevouts, vMissing)) return true;
     }
 
-    if (!bRPConly || msc_debug_parser_readonly) {
-        PrintToLog("____________________________________________________________________________________________________________________________________\n");
-        PrintToLog("%s(block=%d, %s idx= %d); txid: %s\n", __FUNCTION__, nBlock, FormatISO8601DateTime(nTime), idx, wtx.GetHash().GetHex());
+    for (size_t n : vMissing) {
+        if (!FetchUncachedInput(wtx.vin[n].prevout, vPrevouts[n])) {
+            PrintToLog("%s() ERROR: failed to get inputs for %s\n", __func__, wtx.GetHash().GetHex());
+            return false;
+        }
     }
 
+    return true;
+}
+
+/**
+ * Decodes a transaction with a marker, based on the outputs it spends.
+ *
+ * The decoding only depends on the transaction, the spent outputs and the block
+ * height, but not on the state, so it's safe to decode several transactions of
+ * a block in parallel.
+ *
+ * @return 0 if it's an Omni transaction, 1 if it's a potential DEx payment, or < 0 if invalid
+ */
+static int decodeTransaction(bool bRPConly, const CTransaction& wtx, int nBlock, unsigned int idx, CMPTransaction& mp_tx, int omniClass, const std::vector<CTxOut>& vPrevouts)
+{
+    assert(vPrevouts.size() == wtx.vin.size());
+
     // ### SENDER IDENTIFICATION ###
     std::string strSender;
     int64_t inAll = 0;
 
-    { // needed to ensure the cache isn't cleared in the meantime when doing parallel queries
-    // To avoid potential dead lock warning
-    // cs_main for FillTxInputCache() > GetTransaction()
-    // mempool.cs for FillTxInputCache() > GetTransaction() > mempool.get()
-    LOCK2(cs_main, ::mempool.cs);
-    LOCK(cs_tx_cache);
-
-    // Add previous transaction inputs to the cache
-    if (!FillTxInputCache(wtx, removedCoins)) {
-        PrintToLog("%s() ERROR: failed to get inputs for %s\n", __func__, wtx.GetHash().GetHex());
-        return -101;
-    }
-
-    assert(view.HaveInputs(wtx));
-
     if (omniClass != OMNI_CLASS_C)
     {
         // OLD LOGIC - collect input amounts and identify sender via "largest input by sum"
-        std::map<std::string, int64_t> inputs_sum_of_values;
+        // the amounts are collected per destination, so only candidates need to be encoded
+        typedef std::map<CTxDestination, int64_t, std::less<CTxDestination>, ArenaAllocator<std::pair<const CTxDestination, int64_t>>> InputSums;
+        InputSums inputs_sum_of_values;
 
         for (unsigned int i = 0; i < wtx.vin.size(); ++i) {
-            if (msc_debug_vin) PrintToLog("vin=%d:%s\n", i, ScriptToAsmStr(wtx.vin[i].scriptSig));
+            PrintToLogVerbose(msc_debug_vin, "vin=%d:%s\n", i, ScriptToAsmStr(wtx.vin[i].scriptSig));
 
-            const CTxIn& txIn = wtx.vin[i];
-            const Coin& coin = view.AccessCoin(txIn.prevout);
-            const CTxOut& txOut = coin.out;
+            const CTxOut& txOut = vPrevouts[i];
 
             assert(!txOut.IsNull());
 
@@ -977,18 +1131,22 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
                 return -105;
             }
             if (ExtractDestination(txOut.scriptPubKey, source)) { // extract the destination of the previous transaction's vout[n] and check it's allowed type
-                inputs_sum_of_values[EncodeDestination(source)] += txOut.nValue;
+                inputs_sum_of_values[source] += txOut.nValue;
             }
             else return -106;
         }
 
         int64_t nMax = 0;
-        for (std::map<std::string, int64_t>::iterator it = inputs_sum_of_values.begin(); it != inputs_sum_of_values.end(); ++it) { // find largest by sum
-            int64_t nTemp = it->second;
-            if (nTemp > nMax) {
-                strSender = it->first;
-                if (msc_debug_exo) PrintToLog("looking for The Sender: %s , nMax=%lu, nTemp=%d\n", strSender, nMax, nTemp);
-                nMax = nTemp;
+        for (InputSums::const_iterator it = inputs_sum_of_values.begin(); it != inputs_sum_of_values.end(); ++it) { // find largest by sum
+            nMax = std::max(nMax, it->second);
+        }
+        // among equal sums, the address which comes first in alphabetical order is the sender
+        for (InputSums::const_iterator it = inputs_sum_of_values.begin(); nMax > 0 && it != inputs_sum_of_values.end(); ++it) {
+            if (it->second != nMax) continue;
+            std::string strCandidate = EncodeDestinationCached(it->first);
+            if (strSender.empty() || strCandidate < strSender) {
+                strSender = strCandidate;
+                PrintToLogVerbose(msc_debug_exo, "looking for The Sender: %s , nMax=%lu\n", strSender, nMax);
             }
         }
     }
@@ -999,11 +1157,9 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
         // determine the sender, but invalidate transaction, if the input is not accepted
         {
             unsigned int vin_n = 0; // the first input
-            if (msc_debug_vin) PrintToLog("vin=%d:%s\n", vin_n, ScriptToAsmStr(wtx.vin[vin_n].scriptSig));
+            PrintToLogVerbose(msc_debug_vin, "vin=%d:%s\n", vin_n, ScriptToAsmStr(wtx.vin[vin_n].scriptSig));
 
-            const CTxIn& txIn = wtx.vin[vin_n];
-            const Coin& coin = view.AccessCoin(txIn.prevout);
-            const CTxOut& txOut = coin.out;
+            const CTxOut& txOut = vPrevouts[vin_n];
 
             assert(!txOut.IsNull());
 
@@ -1016,21 +1172,21 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
             }
             CTxDestination source;
             if (ExtractDestination(txOut.scriptPubKey, source)) {
-                strSender = EncodeDestination(source);
+                strSender = EncodeDestinationCached(source);
             }
             else return -110;
         }
     }
 
-    inAll = view.GetValueIn(wtx);
-
-    } // end of LOCK(cs_tx_cache)
+    for (const CTxOut& txOut : vPrevouts) {
+        inAll += txOut.nValue;
+    }
 
     int64_t outAll = wtx.GetValueOut();
     int64_t txFee = inAll - outAll; // miner fee
 
     if (!strSender.empty()) {
-        if (msc_debug_verbose) PrintToLog("The Sender: %s : fee= %s\n", strSender, FormatDivisibleMP(txFee));
+        PrintToLogVerbose(msc_debug_verbose, "The Sender: %s : fee= %s\n", strSender, FormatDivisibleMP(txFee));
     } else {
         PrintToLog("The sender is still EMPTY !!! txid: %s\n", wtx.GetHash().GetHex());
         return -5;
@@ -1041,8 +1197,8 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
     unsigned char single_pkt[MAX_PACKETS * PACKET_SIZE];
     unsigned int packet_size = 0;
     std::vector<std::string> script_data;
-    std::vector<std::string> address_data;
-    std::vector<int64_t> value_data;
+    ArenaVector<std::string> address_data;
+    ArenaVector<int64_t> value_data;
 
     for (unsigned int n = 0; n < wtx.vout.size(); ++n) {
         txnouttype whichType;
@@ -1057,13 +1213,13 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
             if (!(dest == ExodusAddress())) {
                 // saving for Class A processing or reference
                 GetScriptPushes(wtx.vout[n].scriptPubKey, script_data);
-                address_data.push_back(EncodeDestination(dest));
+                address_data.push_back(EncodeDestinationCached(dest));
                 value_data.push_back(wtx.vout[n].nValue);
-                if (msc_debug_parser_data) PrintToLog("saving address_data #%d: %s:%s\n", n, EncodeDestination(dest), ScriptToAsmStr(wtx.vout[n].scriptPubKey));
+                PrintToLogVerbose(msc_debug_parser_data, "saving address_data #%d: %s:%s\n", n, address_data.back(), ScriptToAsmStr(wtx.vout[n].scriptPubKey));
             }
         }
     }
-    if (msc_debug_parser_data) PrintToLog(" address_data.size=%lu\n script_data.size=%lu\n value_data.size=%lu\n", address_data.size(), script_data.size(), value_data.size());
+    PrintToLogVerbose(msc_debug_parser_data, " address_data.size=%lu\n script_data.size=%lu\n value_data.size=%lu\n", address_data.size(), script_data.size(), value_data.size());
 
     // ### CLASS A PARSING ###
     if (omniClass == OMNI_CLASS_A) {
@@ -1082,10 +1238,10 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
                     strDataAddress = address_data[k]; // record data address
                     dataAddressSeq = seq; // record data address seq num for reference matching
                     dataAddressValue = value_data[k]; // record data address amount for reference matching
-                    if (msc_debug_parser_data) PrintToLog("Data Address located - data[%d]:%s: %s (%s)\n", k, script_data[k], address_data[k], FormatDivisibleMP(value_data[k]));
+                    PrintToLogVerbose(msc_debug_parser_data, "Data Address located - data[%d]:%s: %s (%s)\n", k, script_data[k], address_data[k], FormatDivisibleMP(value_data[k]));
                 } else { // invalidate - Class A cannot be more than one data packet - possible collision, treat as default (BTC payment)
                     strDataAddress.clear(); //empty strScriptData to block further parsing
-                    if (msc_debug_parser_data) PrintToLog("Multiple Data Addresses found (collision?) Class A invalidated, defaulting to BTC payment\n");
+                    PrintToLogVerbose(msc_debug_parser_data, "Multiple Data Addresses found (collision?) Class A invalidated, defaulting to BTC payment\n");
                     break;
                 }
             }
@@ -1097,15 +1253,15 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
                 if ((address_data[k] != strDataAddress) && (address_data[k] != exodus_address) && (expectedRefAddressSeq == seq)) { // found reference address with matching sequence number
                     if (strRefAddress.empty()) { // confirm we have not already located a reference address
                         strRefAddress = address_data[k]; // set ref address
-                        if (msc_debug_parser_data) PrintToLog("Reference Address located via seqnum - data[%d]:%s: %s (%s)\n", k, script_data[k], address_data[k], FormatDivisibleMP(value_data[k]));
+                        PrintToLogVerbose(msc_debug_parser_data, "Reference Address located via seqnum - data[%d]:%s: %s (%s)\n", k, script_data[k], address_data[k], FormatDivisibleMP(value_data[k]));
                     } else { // can't trust sequence numbers to provide reference address, there is a collision with >1 address with expected seqnum
                         strRefAddress.clear(); // blank ref address
-                        if (msc_debug_parser_data) PrintToLog("Reference Address sequence number collision, will fall back to evaluating matching output amounts\n");
+                        PrintToLogVerbose(msc_debug_parser_data, "Reference Address sequence number collision, will fall back to evaluating matching output amounts\n");
                         break;
                     }
                 }
             }
-            std::vector<int64_t> ExodusValues;
+            ArenaVector<int64_t> ExodusValues;
             for (unsigned int n = 0; n < wtx.vout.size(); ++n) {
                 CTxDestination dest;
                 if (ExtractDestination(wtx.vout[n].scriptPubKey, dest)) {
@@ -1121,10 +1277,10 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
                             if (value_data[k] == ExodusValues[exodus_idx]) { //this output matches data address value and exodus address value, choose as ref
                                 if (strRefAddress.empty()) {
                                     strRefAddress = address_data[k];
-                                    if (msc_debug_parser_data) PrintToLog("Reference Address located via matching amounts - data[%d]:%s: %s (%s)\n", k, script_data[k], address_data[k], FormatDivisibleMP(value_data[k]));
+                                    PrintToLogVerbose(msc_debug_parser_data, "Reference Address located via matching amounts - data[%d]:%s: %s (%s)\n", k, script_data[k], address_data[k], FormatDivisibleMP(value_data[k]));
                                 } else {
                                     strRefAddress.clear();
-                                    if (msc_debug_parser_data) PrintToLog("Reference Address collision, multiple potential candidates. Class A invalidated, defaulting to BTC payment\n");
+                                    PrintToLogVerbose(msc_debug_parser_data, "Reference Address collision, multiple potential candidates. Class A invalidated, defaulting to BTC payment\n");
                                     break;
                                 }
                             }
@@ -1140,7 +1296,7 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
             strDataAddress.clear(); // last validation step, if strRefAddress is empty, blank strDataAddress so we default to BTC payment
         }
         if (!strDataAddress.empty()) { // valid Class A packet almost ready
-            if (msc_debug_parser_data) PrintToLog("valid Class A:from=%s:to=%s:data=%s\n", strSender, strReference, strScriptData);
+            PrintToLogVerbose(msc_debug_parser_data, "valid Class A:from=%s:to=%s:data=%s\n", strSender, strReference, strScriptData);
             packet_size = PACKET_SIZE_CLASS_A;
             memcpy(single_pkt, &ParseHex(strScriptData)[0], packet_size);
         } else {
@@ -1152,58 +1308,59 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
     }
     // ### CLASS B / CLASS C PARSING ###
     if ((omniClass == OMNI_CLASS_B) || (omniClass == OMNI_CLASS_C)) {
-        if (msc_debug_parser_data) PrintToLog("Beginning reference identification\n");
+        PrintToLogVerbose(msc_debug_parser_data, "Beginning reference identification\n");
         bool referenceFound = false; // bool to hold whether we've found the reference yet
         bool changeRemoved = false; // bool to hold whether we've ignored the first output to sender as change
         unsigned int potentialReferenceOutputs = 0; // int to hold number of potential reference outputs
         for (unsigned k = 0; k < address_data.size(); ++k) { // how many potential reference outputs do we have, if just one select it right here
             const std::string& addr = address_data[k];
-            if (msc_debug_parser_data) PrintToLog("ref? data[%d]:%s: %s (%s)\n", k, script_data[k], addr, FormatIndivisibleMP(value_data[k]));
+            PrintToLogVerbose(msc_debug_parser_data, "ref? data[%d]:%s: %s (%s)\n", k, script_data[k], addr, FormatIndivisibleMP(value_data[k]));
             if (addr != exodus_address) {
                 ++potentialReferenceOutputs;
                 if (1 == potentialReferenceOutputs) {
                     strReference = addr;
                     referenceFound = true;
-                    if (msc_debug_parser_data) PrintToLog("Single reference potentially id'd as follows: %s \n", strReference);
+                    PrintToLogVerbose(msc_debug_parser_data, "Single reference potentially id'd as follows: %s \n", strReference);
                 } else { //as soon as potentialReferenceOutputs > 1 we need to go fishing
                     strReference.clear(); // avoid leaving strReference populated for sanity
                     referenceFound = false;
-                    if (msc_debug_parser_data) PrintToLog("More than one potential reference candidate, blanking strReference, need to go fishing\n");
+                    PrintToLogVerbose(msc_debug_parser_data, "More than one potential reference candidate, blanking strReference, need to go fishing\n");
                 }
             }
         }
         if (!referenceFound) { // do we have a reference now? or do we need to dig deeper
-            if (msc_debug_parser_data) PrintToLog("Reference has not been found yet, going fishing\n");
+            PrintToLogVerbose(msc_debug_parser_data, "Reference has not been found yet, going fishing\n");
             for (unsigned k = 0; k < address_data.size(); ++k) {
                 const std::string& addr = address_data[k];
                 if (addr != exodus_address) { // removed strSender restriction, not to spec
                     if (addr == strSender && !changeRemoved) {
                         changeRemoved = true; // per spec ignore first output to sender as change if multiple possible ref addresses
-                        if (msc_debug_parser_data) PrintToLog("Removed change\n");
+                        PrintToLogVerbose(msc_debug_parser_data, "Removed change\n");
                     } else {
                         strReference = addr; // this may be set several times, but last time will be highest vout
-                        if (msc_debug_parser_data) PrintToLog("Resetting strReference as follows: %s \n ", strReference);
+                        PrintToLogVerbose(msc_debug_parser_data, "Resetting strReference as follows: %s \n ", strReference);
                     }
                 }
             }
         }
-        if (msc_debug_parser_data) PrintToLog("Ending reference identification\nFinal decision on reference identification is: %s\n", strReference);
+        PrintToLogVerbose(msc_debug_parser_data, "Ending reference identification\nFinal decision on reference identification is: %s\n", strReference);
 
         // ### CLASS B SPECIFIC PARSING ###
         if (omniClass == OMNI_CLASS_B) {
-            std::vector<std::string> multisig_script_data;
+            Span<const unsigned char> multisig_script_data[MAX_PACKETS];
+            size_t nExtracted = 0;
 
             // ### POPULATE MULTISIG SCRIPT DATA ###
             for (unsigned int i = 0; i < wtx.vout.size(); ++i) {
                 txnouttype whichType;
                 std::vector<CTxDestination> vDest;
                 int nRequired;
-                if (msc_debug_script) PrintToLog("scriptPubKey: %s\n", HexStr(wtx.vout[i].scriptPubKey));
+                PrintToLogVerbose(msc_debug_script, "scriptPubKey: %s\n", HexStr(wtx.vout[i].scriptPubKey));
                 if (!ExtractDestinations(wtx.vout[i].scriptPubKey, whichType, vDest, nRequired)) {
                     continue;
                 }
                 if (whichType == TX_MULTISIG) {
-                    if (msc_debug_script) {
+                    if (OMNI_VERBOSE_LOG && msc_debug_script) {
                         PrintToLog(" >> multisig: ");
                         for(const CTxDestination& dest : vDest) {
                             PrintToLog("%s ; ", EncodeDestination(dest));
@@ -1212,7 +1369,7 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
                     }
                     // ignore first public key, as it should belong to the sender
                     // and it be used to avoid the creation of unspendable dust
-                    GetScriptPushes(wtx.vout[i].scriptPubKey, multisig_script_data, true);
+                    GetScriptPushes(wtx.vout[i].scriptPubKey, multisig_script_data, MAX_PACKETS, nExtracted, true);
                 }
             }
 
@@ -1223,15 +1380,15 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
             // Transactions with more than MAX_PACKET packets
             // are not invalidated, but trimmed.
 
-            unsigned int nPackets = multisig_script_data.size();
+            unsigned int nPackets = nExtracted;
             if (nPackets > MAX_PACKETS) {
                 nPackets = MAX_PACKETS;
-                PrintToLog("limiting number of packets to %d [extracted=%d]\n", nPackets, multisig_script_data.size());
+                PrintToLog("limiting number of packets to %d [extracted=%d]\n", nPackets, nExtracted);
             }
 
             // ### PREPARE A FEW VARS ###
-            std::string strObfuscatedHashes[1+MAX_SHA256_OBFUSCATION_TIMES];
-            PrepareObfuscatedHashes(strSender, 1+nPackets, strObfuscatedHashes);
+            unsigned char vchObfuscatedHashes[1+MAX_SHA256_OBFUSCATION_TIMES][32];
+            PrepareObfuscatedHashes(strSender, nPackets, vchObfuscatedHashes);
             unsigned char packets[MAX_PACKETS][32];
             unsigned int mdata_count = 0;  // multisig data count
 
@@ -1240,22 +1397,25 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
                 assert(mdata_count < MAX_PACKETS);
                 assert(mdata_count < MAX_SHA256_OBFUSCATION_TIMES);
 
-                std::vector<unsigned char> hash = ParseHex(strObfuscatedHashes[mdata_count+1]);
-                std::vector<unsigned char> packet = ParseHex(multisig_script_data[k].substr(2*1,2*PACKET_SIZE));
-                for (unsigned int i = 0; i < packet.size(); i++) { // this is a data packet, must deobfuscate now
-                    packet[i] ^= hash[i];
+                const unsigned char* hash = vchObfuscatedHashes[mdata_count+1];
+                const Span<const unsigned char>& data = multisig_script_data[k];
+                // the packet follows the first byte of the public key
+                const size_t nPacketBytes = std::min<size_t>(PACKET_SIZE, data.size() > 1 ? data.size() - 1 : 0);
+                unsigned char* packet = packets[mdata_count];
+                memset(packet, 0, sizeof(packets[mdata_count]));
+                for (unsigned int i = 0; i < nPacketBytes; i++) { // this is a data packet, must deobfuscate now
+                    packet[i] = data[1 + i] ^ hash[i];
                 }
-                memcpy(&packets[mdata_count], &packet[0], PACKET_SIZE);
                 ++mdata_count;
 
-                if (msc_debug_parser_data) {
-                    CPubKey key(ParseHex(multisig_script_data[k]));
+                if (OMNI_VERBOSE_LOG && msc_debug_parser_data) {
+                    CPubKey key(data.begin(), data.end());
                     std::string strAddress = EncodeDestination(PKHash(key));
-                    PrintToLog("multisig_data[%d]:%s: %s\n", k, multisig_script_data[k], strAddress);
+                    PrintToLog("multisig_data[%d]:%s: %s\n", k, HexStr(data.begin(), data.end()), strAddress);
                 }
-                if (msc_debug_parser) {
-                    if (!packet.empty()) {
-                        std::string strPacket = HexStr(packet.begin(), packet.end());
+                if (OMNI_VERBOSE_LOG && msc_debug_parser) {
+                    if (nPacketBytes > 0) {
+                        std::string strPacket = HexStr(packet, packet + nPacketBytes);
                         PrintToLog("packet #%d: %s\n", mdata_count, strPacket);
                     }
                 }
@@ -1265,11 +1425,11 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
 
             // ### FINALIZE CLASS B ###
             for (unsigned int m = 0; m < mdata_count; ++m) { // now decode mastercoin packets
-                if (msc_debug_parser) PrintToLog("m=%d: %s\n", m, HexStr(packets[m], PACKET_SIZE + packets[m]));
+                PrintToLogVerbose(msc_debug_parser, "m=%d: %s\n", m, HexStr(packets[m], PACKET_SIZE + packets[m]));
 
                 // check to ensure the sequence numbers are sequential and begin with 01 !
                 if (1 + m != packets[m][0]) {
-                    if (msc_debug_spec) PrintToLog("Error: non-sequential seqnum ! expected=%d, got=%d\n", 1+m, packets[m][0]);
+                    PrintToLogVerbose(msc_debug_spec, "Error: non-sequential seqnum ! expected=%d, got=%d\n", 1+m, packets[m][0]);
                 }
 
                 memcpy(m*(PACKET_SIZE-1)+single_pkt, 1+packets[m], PACKET_SIZE-1); // now ignoring sequence numbers for Class B packets
@@ -1309,7 +1469,7 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
                             // add the data to the rest
                             op_return_script_data.insert(op_return_script_data.end(), vstrPushes.begin(), vstrPushes.end());
 
-                            if (msc_debug_parser_data) {
+                            if (OMNI_VERBOSE_LOG && msc_debug_parser_data) {
                                 PrintToLog("Class C transaction detected: %s parsed to %s at vout %d\n", wtx.GetHash().GetHex(), vstrPushes[0], n);
                             }
                         }
@@ -1339,7 +1499,7 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
     }
 
     // ### SET MP TX INFO ###
-    if (msc_debug_verbose) PrintToLog("single_pkt: %s\n", HexStr(single_pkt, packet_size + single_pkt));
+    PrintToLogVerbose(msc_debug_verbose, "single_pkt: %s\n", HexStr(single_pkt, packet_size + single_pkt));
     mp_tx.Set(strSender, strReference, 0, wtx.GetHash(), nBlock, idx, (unsigned char *)&single_pkt, packet_size, omniClass, (inAll-outAll));
 
     // TODO: the following is a bit awful
@@ -1352,36 +1512,439 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
 }
 
 /**
- * Provides access to parseTransaction in read-only mode.
+ * A transaction of the mempool with a marker, which was decoded ahead of its confirmation.
  */
-int ParseTransaction(const CTransaction& tx, int nBlock, unsigned int idx, CMPTransaction& mptx, unsigned int nTime)
+struct CMempoolDecoded
+{
+    //! The outputs spent by the transaction
+    std::vector<CTxOut> vPrevouts;
+    //! The height of the block, the transaction was decoded for
+    int nBlock;
+    //! The encoding class at that height
+    int nClass;
+    //! The result of the decoding, see decodeTransaction()
+    int nResult;
+    //! The decoded transaction in read-only mode
+    CMPTransaction mp_tx;
+};
+
+//! Maximal number of decoded mempool transactions
+static const size_t MAX_MEMPOOL_DECODED = 20000;
+
+//! Guards mapMempoolDecoded
+static Mutex cs_mempool_decoded;
+//! Decoded transactions of the mempool, by txid
+static std::map<uint256, std::shared_ptr<const CMempoolDecoded> > mapMempoolDecoded GUARDED_BY(cs_mempool_decoded);
+
+/** Returns a decoded transaction of the mempool, or nullptr, if it wasn't decoded. */
+static std::shared_ptr<const CMempoolDecoded> GetMempoolDecoded(const uint256& txid)
+{
+    LOCK(cs_mempool_decoded);
+    std::map<uint256, std::shared_ptr<const CMempoolDecoded> >::const_iterator it = mapMempoolDecoded.find(txid);
+    if (it == mapMempoolDecoded.end()) return nullptr;
+    return it->second;
+}
+
+/** Discards a decoded transaction of the mempool. */
+static void RemoveMempoolDecoded(const uint256& txid)
 {
-    return parseTransaction(true, tx, nBlock, idx, mptx, nTime);
+    LOCK(cs_mempool_decoded);
+    mapMempoolDecoded.erase(txid);
 }
 
 /**
- * Handles potential DEx payments.
- *
- * Note: must *not* be called outside of the transaction handler, and it does not
- * check, if a transaction marker exists.
+ * Decodes a transaction with a marker, which entered the mempool, for the next block.
  *
- * @return True, if valid
+ * The decoding is stateless, so it can be reused by the RPC calls and, if the
+ * transaction is confirmed in the next block, by the block processing.
  */
-static bool HandleDExPayments(const CTransaction& tx, int nBlock, const std::string& strSender)
+static void DecodeMempoolTransaction(const CTransaction& tx)
 {
-    int count = 0;
+    std::shared_ptr<CMempoolDecoded> decoded = std::make_shared<CMempoolDecoded>();
+    {
+        LOCK(cs_main);
+        decoded->nBlock = ::ChainActive().Height() + 1;
+    }
 
-    for (unsigned int n = 0; n < tx.vout.size(); ++n) {
+    // already decoded by the checks at the mempool acceptance
+    std::shared_ptr<const CMempoolDecoded> cached = GetMempoolDecoded(tx.GetHash());
+    if (cached && cached->nBlock == decoded->nBlock) return;
+
+    CMarkerScan scan;
+    ScanMarkers(tx, decoded->nBlock, scan);
+    decoded->nClass = scan.nEncodingClass;
+    if (decoded->nClass == NO_MARKER) return;
+
+    if (!FetchTransactionInputs(tx, decoded->vPrevouts, nullptr)) return;
+
+    decoded->mp_tx.Set(tx.GetHash(), decoded->nBlock, 0, 0);
+    decoded->nResult = decodeTransaction(true, tx, decoded->nBlock, 0, decoded->mp_tx, decoded->nClass, decoded->vPrevouts);
+
+    // transactions leave the mempool while cs_main is held, so a transaction, which is no
+    // longer in the mempool, is not added, and any other is discarded, when it leaves
+    LOCK(cs_main);
+    if (!mempool.exists(tx.GetHash())) return;
+    LOCK(cs_mempool_decoded);
+    if (mapMempoolDecoded.size() >= MAX_MEMPOOL_DECODED) return;
+    mapMempoolDecoded[tx.GetHash()] = std::move(decoded);
+}
+
+//! Default setting, whether Omni payloads are checked at the mempool acceptance
+static const bool DEFAULT_OMNI_MEMPOOL_CHECK = false;
+
+/**
+ * Checks the structure of an Omni payload, when a transaction is accepted to the mempool.
+ *
+ * Only class B and C transactions are checked, plain payments to the Exodus address are
+ * never rejected. A payload is rejected, if it can't be decoded, if its type and version
+ * are unknown, or if the fields can't be interpreted. No state is consulted, so a payload,
+ * which passes, may still be invalid, when it's confirmed.
+ *
+ * The outputs spent by the transaction are taken from the view of the mempool acceptance,
+ * and the decoded transaction is cached for the block processing, if requested.
+ *
+ * @return False, if the payload is structurally invalid
+ */
+bool CheckOmniMempoolPayload(const CTransaction& tx, const CCoinsViewCache& view, bool fCache, std::string& strReason)
+{
+    static const bool fEnabled = gArgs.GetBoolArg("-omnimempoolcheck", DEFAULT_OMNI_MEMPOOL_CHECK);
+    if (!fEnabled) return true;
+
+    AssertLockHeld(cs_main);
+
+    std::shared_ptr<CMempoolDecoded> decoded = std::make_shared<CMempoolDecoded>();
+    decoded->nBlock = ::ChainActive().Height() + 1;
+
+    CMarkerScan scan;
+    ScanMarkers(tx, decoded->nBlock, scan);
+    decoded->nClass = scan.nEncodingClass;
+    if (decoded->nClass != OMNI_CLASS_B && decoded->nClass != OMNI_CLASS_C) return true;
+
+    for (const CTxIn& txIn : tx.vin) {
+        const Coin& coin = view.AccessCoin(txIn.prevout);
+        if (coin.IsSpent()) return true;
+        decoded->vPrevouts.push_back(coin.out);
+    }
+
+    decoded->mp_tx.Set(tx.GetHash(), decoded->nBlock, 0, 0);
+    decoded->nResult = decodeTransaction(true, tx, decoded->nBlock, 0, decoded->mp_tx, decoded->nClass, decoded->vPrevouts);
+    if (decoded->nResult != 0) {
+        strReason = strprintf("payload can't be decoded (%d)", decoded->nResult);
+        return false;
+    }
+
+    // the fields are interpreted on a copy, the block processing starts with the decoded transaction
+    CMPTransaction mp_check = decoded->mp_tx;
+    if (!mp_check.interpret_Transaction()) {
+        strReason = "payload can't be interpreted";
+        return false;
+    }
+    if (!IsTransactionTypeKnown(mp_check.getType(), mp_check.getVersion())) {
+        strReason = strprintf("unknown transaction type %d and version %d", mp_check.getType(), mp_check.getVersion());
+        return false;
+    }
+
+    if (fCache) {
+        LOCK(cs_mempool_decoded);
+        if (mapMempoolDecoded.size() < MAX_MEMPOOL_DECODED) {
+            mapMempoolDecoded[tx.GetHash()] = std::move(decoded);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Decodes the transactions with markers, when they enter the mempool, on the
+ * background thread of the validation notifications.
+ */
+class CMempoolDecoder : public CValidationInterface
+{
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& tx) override
+    {
+        DecodeMempoolTransaction(*tx);
+    }
+
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason) override
+    {
+        RemoveMempoolDecoded(tx->GetHash());
+    }
+};
+
+//! Subscription to the mempool notifications
+static std::shared_ptr<CMempoolDecoder> g_mempool_decoder;
+
+// idx is position within the block, 0-based
+// int msc_tx_push(const CTransaction &wtx, int nBlock, unsigned int idx)
+// INPUT: bRPConly -- set to true to avoid moving funds; to be called from various RPC calls like this
+// RETURNS: 0 if parsed a MP TX
+// RETURNS: < 0 if a non-MP-TX or invalid
+// RETURNS: >0 if 1 or more payments have been made
+static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock, unsigned int idx, CMPTransaction& mp_tx, unsigned int nTime, const std::shared_ptr<std::map<COutPoint, Coin>> removedCoins = nullptr, const CCoinsViewCache* pInputs = nullptr)
+{
+    assert(bRPConly == mp_tx.isRpcOnly());
+    mp_tx.Set(wtx.GetHash(), nBlock, idx, nTime);
+
+    // ### CLASS IDENTIFICATION AND MARKER CHECK ###
+    int omniClass = GetEncodingClass(wtx, nBlock);
+
+    if (omniClass == NO_MARKER) {
+        return -1; // No Exodus/Omni marker, thus not a valid Omni transaction
+    }
+
+    if (!bRPConly || msc_debug_parser_readonly) {
+        PrintParseHeader(wtx, nBlock, idx, nTime);
+    }
+
+    // the outputs spent by transactions of the mempool were already fetched
+    std::shared_ptr<const CMempoolDecoded> cached = GetMempoolDecoded(wtx.GetHash());
+    if (cached) {
+        return decodeTransaction(bRPConly, wtx, nBlock, idx, mp_tx, omniClass, cached->vPrevouts);
+    }
+
+    std::vector<CTxOut> vPrevouts;
+    const int64_t nTimeInputs = GetPerfTimeMicros();
+    const bool fInputs = FetchTransactionInputs(wtx, vPrevouts, removedCoins, pInputs);
+    if (!bRPConly) AddPerfTime(PERF_INPUTS, GetPerfTimeMicros() - nTimeInputs);
+    if (!fInputs) {
+        return -101;
+    }
+
+    return decodeTransaction(bRPConly, wtx, nBlock, idx, mp_tx, omniClass, vPrevouts);
+}
+
+/**
+ * A transaction of a block, which was decoded ahead of its interpretation.
+ */
+struct CDecodedTransaction
+{
+    //! The markers found in the transaction
+    CMarkerScan scan;
+    //! The encoding class, or NO_MARKER
+    int nClass;
+    //! The result of the decoding, see parseTransaction()
+    int nResult;
+    //! The outputs spent by the transaction, kept to decode it again, if the rules change within the block
+    std::vector<CTxOut> vPrevouts;
+    //! The decoded transaction, if there is a marker
+    std::unique_ptr<CMPTransaction> mp_tx;
+
+    CDecodedTransaction() : nClass(NO_MARKER), nResult(-1) {}
+};
+
+//! Maximum number of threads used to decode transactions by default
+static const int MAX_SCAN_DECODE_THREADS = 8;
+
+/** Returns the maximal number of threads of the shared pool, which decode the transactions of a block. */
+static int GetDecodeThreads()
+{
+    static const int nDecodeThreads = [] {
+        int nThreads = gArgs.GetArg("-omnidecodethreads", 0);
+        if (nThreads <= 0) nThreads = std::min(GetNumCores(), MAX_SCAN_DECODE_THREADS);
+        return nThreads;
+    }();
+    return nDecodeThreads;
+}
+
+/**
+ * Fetches the outputs spent by transactions of a block, which aren't cached yet, in one pass.
+ *
+ * The missing outputs are collected first. The positions of the transactions, which created
+ * them, are looked up in the transaction index, and the transactions are read in the order
+ * of their positions on disk across the worker pool, so the reads are mostly sequential.
+ * The outputs are added to the input cache, where they are found, when the inputs of the
+ * transactions are fetched as usual.
+ *
+ * @param block[in]         The block
+ * @param vMarked[in]       The positions of the transactions with markers
+ * @param spentCoins[in]    The outputs spent by the block, if available
+ * @param pool[in]          The workers to use
+ */
+static void PrefetchBlockInputs(const CBlock& block, const std::vector<size_t>& vMarked, const std::shared_ptr<std::map<COutPoint, Coin>> spentCoins, CWorkerPool& pool)
+{
+    if (!g_txindex) return;
+
+    // the missing outputs by the transactions, which created them
+    std::map<uint256, std::set<uint32_t> > mapMissing;
+    {
+        LOCK(cs_tx_cache);
+        for (size_t n : vMarked) {
+            for (const CTxIn& txIn : block.vtx[n]->vin) {
+                Coin coin;
+                bool fFromBlock = false;
+                if (GetCachedInput(txIn.prevout, spentCoins, coin, fFromBlock)) continue;
+                if (pDbPrevout && pDbPrevout->GetCoin(txIn.prevout, coin)) {
+                    inputCache.Add(txIn.prevout, coin);
+                    continue;
+                }
+                mapMissing[txIn.prevout.hash].insert(txIn.prevout.n);
+            }
+        }
+    }
+    if (mapMissing.empty()) return;
+
+    CPerfTimer timer(PERF_INPUTS);
+
+    struct PrevTx
+    {
+        uint256 txid;
+        CDiskTxPos pos;
+        CTransactionRef tx;
+        uint256 hashBlock;
+    };
+    std::vector<PrevTx> vPrevTxs;
+    vPrevTxs.reserve(mapMissing.size());
+    for (const auto& entry : mapMissing) {
+        vPrevTxs.push_back(PrevTx{entry.first, CDiskTxPos(), nullptr, uint256()});
+    }
+
+    // transactions, which aren't indexed, such as the ones of the mempool, are looked up later as usual
+    pool.ForEach(vPrevTxs.size(), [&](size_t i) {
+        if (!g_txindex->FindTxPos(vPrevTxs[i].txid, vPrevTxs[i].pos)) vPrevTxs[i].pos.SetNull();
+    }, GetDecodeThreads());
+    vPrevTxs.erase(std::remove_if(vPrevTxs.begin(), vPrevTxs.end(), [](const PrevTx& prev) { return prev.pos.IsNull(); }), vPrevTxs.end());
+    std::sort(vPrevTxs.begin(), vPrevTxs.end(), [](const PrevTx& a, const PrevTx& b) {
+        return std::make_tuple(a.pos.nFile, a.pos.nPos, a.pos.nTxOffset) < std::make_tuple(b.pos.nFile, b.pos.nPos, b.pos.nTxOffset);
+    });
+
+    pool.ForEach(vPrevTxs.size(), [&](size_t i) {
+        PrevTx& prev = vPrevTxs[i];
+        if (!ReadTransactionMapped(prev.pos, prev.hashBlock, prev.tx) && !g_txindex->FindTx(prev.txid, prev.hashBlock, prev.tx)) {
+            prev.tx.reset();
+        }
+        if (prev.tx && prev.tx->GetHash() != prev.txid) prev.tx.reset();
+    }, GetDecodeThreads());
+
+    LOCK(cs_main);
+    LOCK(cs_tx_cache);
+    for (const PrevTx& prev : vPrevTxs) {
+        if (!prev.tx) continue;
+        const CBlockIndex* pBlockIndex = LookupBlockIndex(prev.hashBlock);
+        for (uint32_t nOut : mapMissing[prev.txid]) {
+            if (nOut >= prev.tx->vout.size()) continue;
+            const COutPoint prevout(prev.txid, nOut);
+            Coin coin(prev.tx->vout[nOut], pBlockIndex ? pBlockIndex->nHeight : 1, false);
+            // remember confirmed outputs, so they don't need to be looked up again during reparses
+            if (pDbPrevout && pBlockIndex) pDbPrevout->AddCoin(prevout, coin);
+            inputCache.Add(prevout, coin);
+        }
+    }
+}
+
+/**
+ * Decodes all transactions of a block ahead of their interpretation.
+ *
+ * The previous outputs are fetched on the calling thread, after the outputs, which
+ * aren't cached, were read in one pass, while classifying the transactions and the
+ * stateless decoding of senders and payloads is distributed across the worker pool.
+ *
+ * @param block[in]         The block to decode
+ * @param nBlock[in]        The height of the block
+ * @param nTime[in]         The timestamp of the block
+ * @param spentCoins[in]    The outputs spent by the block, if available
+ * @param pool[in]          The workers to use
+ * @param vDecoded[out]     The decoded transactions, in the order of the block
+ */
+static void DecodeBlockTransactions(const CBlock& block, int nBlock, unsigned int nTime, const std::shared_ptr<std::map<COutPoint, Coin>> spentCoins, CWorkerPool& pool, std::vector<CDecodedTransaction>& vDecoded)
+{
+    vDecoded.clear();
+    vDecoded.resize(block.vtx.size());
+
+    pool.ForEach(block.vtx.size(), [&](size_t n) {
+        ScanMarkers(*block.vtx[n], nBlock, vDecoded[n].scan);
+        vDecoded[n].nClass = vDecoded[n].scan.nEncodingClass;
+    }, GetDecodeThreads());
+
+    // the outputs, which aren't spent by the block or cached, are fetched together
+    std::vector<size_t> vPrefetch;
+    for (size_t n = 0; n < block.vtx.size(); ++n) {
+        if (vDecoded[n].nClass != NO_MARKER && !GetMempoolDecoded(block.vtx[n]->GetHash())) vPrefetch.push_back(n);
+    }
+    PrefetchBlockInputs(block, vPrefetch, spentCoins, pool);
+
+    // the remaining outputs are fetched with the locks held only for each lookup
+    std::vector<size_t> vMarked;
+    for (size_t n = 0; n < block.vtx.size(); ++n) {
+        CDecodedTransaction& decoded = vDecoded[n];
+        if (decoded.nClass == NO_MARKER) continue;
+
+        // transactions, which were decoded in the mempool for this block, are reused
+        std::shared_ptr<const CMempoolDecoded> cached = GetMempoolDecoded(block.vtx[n]->GetHash());
+        if (cached && cached->nBlock == nBlock && cached->nClass == decoded.nClass) {
+            decoded.mp_tx = MakeUnique<CMPTransaction>(cached->mp_tx);
+            decoded.mp_tx->unlockLogic();
+            decoded.mp_tx->Set(block.vtx[n]->GetHash(), nBlock, n, nTime);
+            decoded.nResult = cached->nResult;
+            decoded.vPrevouts = cached->vPrevouts;
+            continue;
+        }
+
+        decoded.mp_tx = MakeUnique<CMPTransaction>();
+        decoded.mp_tx->unlockLogic();
+        decoded.mp_tx->Set(block.vtx[n]->GetHash(), nBlock, n, nTime);
+
+        if (cached) {
+            decoded.vPrevouts = cached->vPrevouts;
+            vMarked.push_back(n);
+        } else if (FetchTransactionInputs(*block.vtx[n], decoded.vPrevouts, spentCoins)) {
+            vMarked.push_back(n);
+        } else {
+            decoded.nResult = -101;
+        }
+    }
+
+    pool.ForEach(vMarked.size(), [&](size_t i) {
+        const size_t n = vMarked[i];
+        CDecodedTransaction& decoded = vDecoded[n];
+        OMNI_TRACE3(tx_parse_start, block.vtx[n]->GetHash().begin(), nBlock, n);
+        decoded.nResult = decodeTransaction(false, *block.vtx[n], nBlock, n, *decoded.mp_tx, decoded.nClass, decoded.vPrevouts);
+        OMNI_TRACE4(tx_parse_end, block.vtx[n]->GetHash().begin(), nBlock, n, decoded.nResult);
+    }, GetDecodeThreads());
+}
+
+/**
+ * Provides access to parseTransaction in read-only mode.
+ */
+int ParseTransaction(const CTransaction& tx, int nBlock, unsigned int idx, CMPTransaction& mptx, unsigned int nTime, const CCoinsViewCache* pInputs)
+{
+    return parseTransaction(true, tx, nBlock, idx, mptx, nTime, nullptr, pInputs);
+}
+
+/**
+ * Handles potential DEx payments.
+ *
+ * Note: must *not* be called outside of the transaction handler, and it does not
+ * check, if a transaction marker exists.
+ *
+ * @return True, if valid
+ */
+static bool HandleDExPayments(const CTransaction& tx, int nBlock, const std::string& strSender)
+{
+    // only outputs to sellers, whose offers were accepted by the sender, can be payments
+    std::vector<std::pair<CTxDestination, std::string> > vSellers;
+    for (const std::string& seller : my_accepts.GetBuyerSellers(strSender)) {
+        vSellers.push_back(std::make_pair(DecodeDestination(seller), seller));
+    }
+    if (vSellers.empty()) return false;
+
+    const CTxDestination exodus = ExodusAddress();
+    int count = 0;
+
+    for (unsigned int n = 0; n < tx.vout.size(); ++n) {
         CTxDestination dest;
         if (ExtractDestination(tx.vout[n].scriptPubKey, dest)) {
-            if (dest == ExodusAddress()) {
+            if (dest == exodus) {
                 continue;
             }
-            std::string strAddress = EncodeDestination(dest);
-            if (msc_debug_parser_dex) PrintToLog("payment #%d %s %s\n", count, strAddress, FormatIndivisibleMP(tx.vout[n].nValue));
+            for (const auto& seller : vSellers) {
+                if (!(dest == seller.first)) continue;
+                PrintToLogIf(msc_debug_parser_dex, "payment #%d %s %s\n", count, seller.second, FormatIndivisibleMP(tx.vout[n].nValue));
 
-            // check everything and pay BTC for the property we are buying here...
-            if (0 == DEx_payment(tx.GetHash(), n, strAddress, strSender, tx.vout[n].nValue, nBlock)) ++count;
+                // check everything and pay BTC for the property we are buying here...
+                if (0 == DEx_payment(tx.GetHash(), n, seller.second, strSender, tx.vout[n].nValue, nBlock)) ++count;
+                break;
+            }
         }
     }
 
@@ -1398,12 +1961,13 @@ static bool HandleDExPayments(const CTransaction& tx, int nBlock, const std::str
  */
 static bool HandleExodusPurchase(const CTransaction& tx, int nBlock, const std::string& strSender, unsigned int nTime)
 {
+    const CTxDestination crowdsaleAddress = ExodusCrowdsaleAddress(nBlock);
     int64_t amountInvested = 0;
 
     for (unsigned int n = 0; n < tx.vout.size(); ++n) {
         CTxDestination dest;
         if (ExtractDestination(tx.vout[n].scriptPubKey, dest)) {
-            if (dest == ExodusCrowdsaleAddress(nBlock)) {
+            if (dest == crowdsaleAddress) {
                 amountInvested = tx.vout[n].nValue;
                 break; // TODO: maybe sum all values
             }
@@ -1492,14 +2056,45 @@ public:
     }
 };
 
+static unsigned int HandleBlockTransactions(const CBlock& block, const CBlockIndex* pBlockIndex, const std::shared_ptr<std::map<COutPoint, Coin> > removedCoins, std::vector<CDecodedTransaction>* pvDecoded, CWorkerPool* pPool);
+
+static void SetBulkLoadMode(bool fEnable);
+
+//! Default for checking independent simple sends in parallel during the initial scan
+static const bool DEFAULT_OMNI_PARALLEL_SENDS = false;
+//! Minimum number of independent simple sends to check them in parallel
+static const size_t MIN_PARALLEL_SEND_CHECKS = 16;
+
+/**
+ * Determines, whether a block has no Omni transactions and can be skipped during the scan.
+ *
+ * Besides the static list of seed blocks, blocks are skipped, which were already
+ * processed once and are known to be free of Omni markers.
+ */
+static bool CanSkipBlock(const CBlockIndex* pblockindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (SkipBlock(pblockindex->nHeight)) {
+        return true;
+    }
+    if (pDbMarkers) {
+        const CBlockIndex* pChunkEnd = ::ChainActive()[COmniMarkerIndex::GetChunkEnd(pblockindex->nHeight)];
+        return pDbMarkers->IsMarkerFree(pblockindex, pChunkEnd);
+    }
+    return false;
+}
+
 /**
  * Scans the blockchain for meta transactions.
  *
  * It scans the blockchain, starting at the given block index, to the current
- * tip, much like as if new block were arriving and being processed on the fly.
+ * tip or the given last block, much like as if new block were arriving and
+ * being processed on the fly.
  *
  * Every 30 seconds the progress of the scan is reported.
  *
+ * The transactions of a block are decoded in parallel, before they are
+ * interpreted one after another, in the order of the block.
+ *
  * In case the current block being processed is not part of the active chain, or
  * if a block could not be retrieved from the disk, then the scan stops early.
  * Likewise, global shutdown requests are honored, and stop the scan progress.
@@ -1509,16 +2104,17 @@ public:
  * @see mastercore_handler_block_end()
  *
  * @param nFirstBlock[in]  The index of the first block to scan
+ * @param nLastBlock[in]   The index of the last block to scan, or -1 to scan to the tip
  * @return An exit code, indicating success or failure
  */
-static int msc_initial_scan(int nFirstBlock)
+static int msc_initial_scan(int nFirstBlock, int nLastBlock = -1)
 {
     int nTimeBetweenProgressReports = gArgs.GetArg("-omniprogressfrequency", 30);  // seconds
     int64_t nNow = GetTime();
     unsigned int nTxsTotal = 0;
     unsigned int nTxsFoundTotal = 0;
     int nBlock = 999999;
-    const int nLastBlock = GetHeight();
+    if (nLastBlock < 0 || nLastBlock > GetHeight()) nLastBlock = GetHeight();
 
     // this function is useless if there are not enough blocks in the blockchain yet!
     if (nFirstBlock < 0 || nLastBlock < nFirstBlock) return -1;
@@ -1533,11 +2129,44 @@ static int msc_initial_scan(int nFirstBlock)
         pLastBlock = ::ChainActive()[nLastBlock];
     }
 
+    // far from the tip, the databases are written in bulk, and switched back to the safe settings afterwards
+    const int nBulkLoadBlocks = gArgs.GetArg("-omnibulkload", DEFAULT_OMNI_BULK_LOAD_BLOCKS);
+    const bool fBulkLoad = nBulkLoadBlocks > 0 && nLastBlock - nFirstBlock >= nBulkLoadBlocks;
+    if (fBulkLoad) SetBulkLoadMode(true);
+
     ProgressReporter progressReporter(pFirstBlock, pLastBlock);
+    scanStatus.Start(nFirstBlock, nLastBlock, pFirstBlock->nChainTx, pLastBlock->nChainTx);
 
     // check if using seed block filter should be disabled
     bool seedBlockFilterEnabled = gArgs.GetBoolArg("-omniseedblockfilter", true);
 
+    // resolve transaction inputs via the undo data of the blocks, instead of looking up each input
+    bool fUseUndo = gArgs.GetBoolArg("-omniscanundo", true);
+
+    // read and deserialize upcoming blocks in the background, while the current block is processed
+    std::unique_ptr<CBlockPrefetcher> prefetcher;
+    int nPrefetch = gArgs.GetArg("-omniscanprefetch", DEFAULT_SCAN_PREFETCH);
+    if (nPrefetch > 0) {
+        prefetcher = MakeUnique<CBlockPrefetcher>(nPrefetch, fUseUndo);
+        {
+            LOCK(cs_main);
+            for (int n = nFirstBlock; n <= nLastBlock; ++n) {
+                const CBlockIndex* pblockindex = ::ChainActive()[n];
+                if (nullptr == pblockindex) break;
+                if (seedBlockFilterEnabled && CanSkipBlock(pblockindex)) continue;
+                prefetcher->Add(pblockindex);
+            }
+        }
+        prefetcher->Start(std::max(1, std::min(GetNumCores() - 1, MAX_SCAN_PREFETCH_THREADS)));
+    }
+
+    // decode transactions of a block in parallel, the scanning thread is one of the decoders
+    CWorkerPool& decodePool = GetWorkerPool();
+    std::vector<CDecodedTransaction> vDecoded;
+
+    // the decoders also check runs of independent simple sends, before they are executed
+    const bool fParallelSends = gArgs.GetBoolArg("-omniparallelsends", DEFAULT_OMNI_PARALLEL_SENDS);
+
     for (nBlock = nFirstBlock; nBlock <= nLastBlock; ++nBlock)
     {
         if (ShutdownRequested()) {
@@ -1546,15 +2175,17 @@ static int msc_initial_scan(int nFirstBlock)
         }
 
         CBlockIndex* pblockindex;
+        bool fSkipBlock = false;
         {
             LOCK(cs_main);
             pblockindex = ::ChainActive()[nBlock];
+            if (pblockindex && seedBlockFilterEnabled) fSkipBlock = CanSkipBlock(pblockindex);
         }
 
         if (nullptr == pblockindex) break;
         std::string strBlockHash = pblockindex->GetBlockHash().GetHex();
 
-        if (msc_debug_exo) PrintToLog("%s(%d; max=%d):%s, line %d, file: %s\n",
+        PrintToLogVerbose(msc_debug_exo, "%s(%d; max=%d):%s, line %d, file: %s\n",
             __FUNCTION__, nBlock, nLastBlock, strBlockHash, __LINE__, __FILE__);
 
         if (GetTime() >= nNow + nTimeBetweenProgressReports) {
@@ -1566,21 +2197,51 @@ static int msc_initial_scan(int nFirstBlock)
         unsigned int nTxsFoundInBlock = 0;
         mastercore_handler_block_begin(nBlock, pblockindex);
 
-        if (!seedBlockFilterEnabled || !SkipBlock(nBlock)) {
+        // blocks applied from a delta of the primary are neither read nor interpreted
+        {
+            LOCK(cs_tally);
+            if (IsApplyingStateDelta()) fSkipBlock = true;
+        }
+
+        if (!fSkipBlock) {
+            int64_t nTimeStart = GetTimeMicros();
             CBlock block;
-            if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) break;
+            std::shared_ptr<std::map<COutPoint, Coin>> spentCoins;
+            if (!prefetcher || !prefetcher->Next(pblockindex, block, spentCoins)) {
+                if (!ReadBlockMapped(block, pblockindex, Params().GetConsensus())) {
+                    if (fHavePruned) PrintToConsole("Block %d was pruned, the Omni state can't be rebuilt from pruned blocks\n", nBlock);
+                    break;
+                }
+                if (fUseUndo && block.vtx.size() > 1) {
+                    spentCoins = std::make_shared<std::map<COutPoint, Coin>>();
+                    if (!ReadSpentCoins(block, pblockindex, *spentCoins)) spentCoins.reset();
+                }
+            }
 
-            for(const auto tx : block.vtx) {
-                if (mastercore_handler_tx(*tx, nBlock, nTxNum, pblockindex, nullptr)) ++nTxsFoundInBlock;
-                ++nTxNum;
+            {
+                CPerfTimer timer(PERF_PARSE);
+                DecodeBlockTransactions(block, nBlock, pblockindex->GetBlockTime(), spentCoins, decodePool, vDecoded);
             }
+            int64_t nTimeDecoded = GetTimeMicros();
+
+            nTxsFoundInBlock = HandleBlockTransactions(block, pblockindex, spentCoins, &vDecoded, fParallelSends ? &decodePool : nullptr);
+            nTxNum = block.vtx.size();
+            scanStatus.AddTime(nTimeDecoded - nTimeStart, GetTimeMicros() - nTimeDecoded, 0);
         }
 
         nTxsFoundTotal += nTxsFoundInBlock;
         nTxsTotal += nTxNum;
         mastercore_handler_block_end(nBlock, pblockindex, nTxsFoundInBlock);
+        scanStatus.BlockProcessed(nBlock, pblockindex->nChainTx, nTxNum, nTxsFoundInBlock);
     }
 
+    scanStatus.Stop();
+
+    // the block files of the scan are no longer needed, and mapped again, when blocks are read later
+    ReleaseMappedBlockFiles();
+
+    if (fBulkLoad) SetBulkLoadMode(false);
+
     if (nBlock < nLastBlock) {
         PrintToConsole("Scan stopped early at block %d of block %d\n", nBlock, nLastBlock);
     }
@@ -1598,17 +2259,23 @@ void clear_all_state()
     PrintToLog("Clearing all state..\n");
     LOCK2(cs_tally, cs_pending);
 
+    // don't move the watermark of the cleared SP database to a stale state later
+    FlushStatePersistence();
+
     // Memory based storage
     mp_tally_map.clear();
     my_offers.clear();
     my_accepts.clear();
     my_crowds.clear();
-    metadex.clear();
+    MetaDEx_CLEAR();
     my_pending.clear();
     ResetConsensusParams();
     ClearActivations();
     ClearAlerts();
     ClearFreezeState();
+    ClearUndoJournal();
+    MetaDEx_ClearAddresses();
+    ClearBlockActivity();
 
     // LevelDB based storage
     pDbSpInfo->Clear();
@@ -1619,38 +2286,76 @@ void clear_all_state()
     pDbFeeCache->Clear();
     pDbFeeHistory->Clear();
     pDbNFT->Clear();
+    if (pDbBalanceHistory) pDbBalanceHistory->Clear();
+    if (pDbBalanceChanges) pDbBalanceChanges->Clear();
+    if (pDbAddressIndex) pDbAddressIndex->Clear();
     assert(pDbTransactionList->setDBVersion() == DB_VERSION); // new set of databases, set DB version
+    pDbTransactionList->setIndexProperties(FormatIndexProperties(GetIndexProperties()));
+    LoadHistoryPrunedHeight();
     exodus_prev = 0;
 }
 
-void RewindDBsAndState(int nHeight, int nBlockPrev = 0, bool fInitialParse = false)
+/**
+ * Rebuilds the freeze state from the freeze transactions up to the given block.
+ *
+ * This is only needed, if the restored state doesn't include the freeze state.
+ */
+static bool ReloadFreezeState(int nBlock)
+{
+    // Lock cs_main here for LoadFreezeState() > GetTransaction()
+    // Lock mempool here for LoadFreezeState() > GetTransaction() > mempool.Get()
+    LOCK2(cs_main, ::mempool.cs);
+    LOCK(cs_tally);
+    ClearFreezeState();
+    return pDbTransactionList->LoadFreezeState(nBlock);
+}
+
+void RewindDBsAndState(int nHeight, int nBlockPrev = 0)
 {
     int nWaterline;
-    bool reorgContainsFreeze;
     {
         LOCK(cs_tally);
-        // Check if any freeze related transactions would be rolled back - if so wipe the state and startclean
-        reorgContainsFreeze = pDbTransactionList->CheckForFreezeTxs(nHeight);
-
         // NOTE: The blockNum parameter is inclusive, so deleteAboveBlock(1000) will delete records in block 1000 and above.
         pDbTransactionList->isMPinBlockRange(nHeight, reorgRecoveryMaxHeight, true);
+        pDbTransactionList->DeleteStateHashes(nHeight);
         pDbTradeList->deleteAboveBlock(nHeight);
         pDbStoList->deleteAboveBlock(nHeight);
         pDbFeeCache->RollBackCache(nHeight);
         pDbFeeHistory->RollBackHistory(nHeight);
+        if (pDbBalanceHistory) pDbBalanceHistory->DeleteAboveBlock(nHeight);
+        if (pDbBalanceChanges) pDbBalanceChanges->DeleteAboveBlock(nHeight);
+        if (pDbAddressIndex) pDbAddressIndex->DeleteAboveBlock(nHeight);
+        rpcTxCache.Clear();
         reorgRecoveryMaxHeight = 0;
+        ClearBlockActivity();
 
         nWaterlineBlock = ConsensusParams().GENESIS_BLOCK - 1;
     }
 
-    if (reorgContainsFreeze && !fInitialParse) {
-       PrintToConsole("Reorganization containing freeze related transactions detected, forcing a reparse...\n");
-       clear_all_state(); // unable to reorg freezes safely, clear state and reparse
+    int nUndoneBlock = -1;
+    {
+        // short reorganizations are undone in memory, if the undo journal covers the blocks
+        LOCK2(cs_main, cs_tally);
+        const CBlockIndex* pForkBlock = ::ChainActive()[nHeight - 1];
+        if (pForkBlock) nUndoneBlock = UndoBlocks(nHeight, pForkBlock->GetBlockHash());
+    }
+
+    if (nUndoneBlock >= 0) {
+        LOCK(cs_tally);
+        nWaterlineBlock = nUndoneBlock;
     } else {
-        int best_state_block = LoadMostRelevantInMemoryState();
+        {
+            LOCK(cs_tally);
+            ClearUndoJournal();
+        }
+        bool fFreezeStateRestored = false;
+        int best_state_block = LoadMostRelevantInMemoryState(fFreezeStateRestored);
         if (best_state_block < 0) {
             // unable to recover easily, remove stale stale state bits and reparse from the beginning.
             clear_all_state();
+        } else if (!fFreezeStateRestored && !ReloadFreezeState(best_state_block)) {
+            PrintToLog("Failed to load freeze state of block %d from levelDB, forcing a reparse...\n", best_state_block);
+            clear_all_state();
         } else {
             LOCK(cs_tally);
             nWaterlineBlock = best_state_block;
@@ -1659,16 +2364,90 @@ void RewindDBsAndState(int nHeight, int nBlockPrev = 0, bool fInitialParse = fal
 
     {
         LOCK(cs_tally);
-        // clear the global wallet property list, perform a forced wallet update and tell the UI that state is no longer valid, and UI views need to be reinit
-        global_wallet_property_list.clear();
+        // reset the wallet cache and totals, perform a forced wallet update and tell the UI that state is no longer valid, and UI views need to be reinit
+        WalletCacheReset();
         CheckWalletUpdate(true);
         uiInterface.OmniStateInvalidated();
         nWaterline = nWaterlineBlock;
     }
 
     if (nWaterline < nBlockPrev) {
-        // scan from the block after the best active block to catch up to the active chain
-        msc_initial_scan(nWaterline + 1);
+        // scan from the block after the best active block to catch up with the block before the one in progress
+        msc_initial_scan(nWaterline + 1, nBlockPrev);
+    }
+}
+
+/**
+ * Handles a reorganization, if none of the disconnected blocks touched the state.
+ *
+ * Only Dev Omni is reverted and the watermark is moved to the fork block, while the
+ * databases and the rest of the state are left as they are.
+ *
+ * @param pBlockIndex  The first block of the new chain
+ * @return True, if the state refers to the fork block, otherwise it must be rewound
+ */
+static bool DisconnectUntouchedBlocks(const CBlockIndex* pBlockIndex)
+{
+    const int nHeight = pBlockIndex->nHeight;
+    const uint256 hashForkBlock = pBlockIndex->pprev ? pBlockIndex->pprev->GetBlockHash() : uint256();
+
+    LOCK(cs_tally);
+    int64_t nExodusPrev = exodus_prev;
+    if (!SkipUntouchedBlocks(nHeight, hashForkBlock, nExodusPrev)) return false;
+
+    // Dev Omni is granted again, when the blocks of the new chain are processed
+    if (exodus_prev > nExodusPrev && !update_tally_map(exodus_address, OMNI_PROPERTY_MSC, nExodusPrev - exodus_prev, BALANCE)) {
+        PrintToLog("%s(): failed to revert Dev Omni above block %d, the state must be rewound\n", __func__, nHeight - 1);
+        return false;
+    }
+    exodus_prev = nExodusPrev;
+
+    DiscardBlockUndo(nHeight);
+    pDbTransactionList->DeleteStateHashes(nHeight);
+    if (pDbBalanceHistory) pDbBalanceHistory->DeleteAboveBlock(nHeight);
+    if (pDbBalanceChanges) pDbBalanceChanges->DeleteAboveBlock(nHeight);
+    if (pDbAddressIndex) pDbAddressIndex->DeleteAboveBlock(nHeight);
+    pDbSpInfo->setWatermark(hashForkBlock);
+    rpcTxCache.Clear();
+    reorgRecoveryMaxHeight = 0;
+
+    nWaterlineBlock = nHeight - 1;
+
+    return true;
+}
+
+/**
+ * Returns the databases of the global state, which are updated while processing blocks.
+ */
+std::vector<CDBBase*> mastercore::GetStateDatabases()
+{
+    std::vector<CDBBase*> vDatabases{pDbTransactionList, pDbTradeList, pDbStoList, pDbSpInfo,
+            pDbTransaction, pDbFeeCache, pDbFeeHistory, pDbNFT, pDbBalanceHistory, pDbBalanceChanges,
+            pDbAddressIndex};
+    vDatabases.erase(std::remove(vDatabases.begin(), vDatabases.end(), nullptr), vDatabases.end());
+    return vDatabases;
+}
+
+/**
+ * Switches the databases of the global state into or out of bulk-load mode.
+ *
+ * While loading in bulk, the writes of many blocks are committed at once. Leaving
+ * the mode commits the remaining writes, and compacts the databases.
+ */
+static void SetBulkLoadMode(bool fEnable)
+{
+    LOCK(cs_tally);
+    PrintToLog("%s bulk-load mode of the Omni databases\n", fEnable ? "Entering" : "Leaving");
+    fBulkLoadMode = fEnable;
+    for (CDBBase* pdb : GetStateDatabases()) {
+        leveldb::Status status = pdb->SetBulkLoad(fEnable);
+        if (!status.ok()) {
+            std::string strShutdownReason = strprintf("Failed to switch the bulk-load mode of the Omni databases: %s\n", status.ToString());
+            PrintToLog(strShutdownReason);
+            AbortNode(strShutdownReason, strShutdownReason);
+            return;
+        }
+        pdb->PublishSnapshot();
     }
 }
 
@@ -1679,7 +2458,27 @@ void RewindDBsAndState(int nHeight, int nBlockPrev = 0, bool fInitialParse = fal
  */
 int mastercore_init()
 {
-    bool wrongDBVersion, startClean = false;
+    bool wrongDBVersion, wrongIndexProperties, startClean = false;
+
+    // a replay processes a block range with copies of the Omni databases, so the datadir is left untouched
+    int nReplayFirst = -1;
+    int nReplayLast = -1;
+    const bool fReplay = ParseReplayRange(gArgs.GetArg("-omnireplay", ""), nReplayFirst, nReplayLast);
+    bool fReplayPrepared = false;
+    if (fReplay) {
+        {
+            LOCK(cs_tally);
+            if (mastercoreInitialized) return 0;
+        }
+        std::string strError;
+        fReplayPrepared = PrepareReplayDirectory(nReplayFirst, nReplayLast, strError);
+        if (!fReplayPrepared) {
+            const std::string& msg = strprintf("Failed to prepare the replay of blocks %d to %d: %s\n", nReplayFirst, nReplayLast, strError);
+            PrintToLog(msg);
+            AbortNode(msg, msg);
+        }
+    }
+    const fs::path omniDir = fReplay ? GetReplayDirectory() : GetDataDir();
 
     {
         LOCK(cs_tally);
@@ -1708,8 +2507,20 @@ int mastercore_init()
             autoCommit = false;
         }
 
+        // the contention of the Omni locks is only recorded, when enabled
+        EnableLockStats(gArgs.GetBoolArg("-omnilockstats", DEFAULT_OMNI_LOCK_STATS));
+
+        // read snapshots of the state are published for RPC, unless disabled
+        InitStateSnapshot(gArgs.GetBoolArg("-omnirpcsnapshot", DEFAULT_RPC_SNAPSHOT));
+
+        // caches are evicted, when the memory used exceeds the limit given in MiB
+        SetMaxMemoryUsage(std::max<int64_t>(0, gArgs.GetArg("-omnimaxmemory", DEFAULT_OMNI_MAX_MEMORY)) * 1024 * 1024);
+
+        // the changes of the last blocks are kept in memory, so short reorganizations can be undone
+        InitUndoJournal(gArgs.GetArg("-omniundoblocks", DEFAULT_UNDO_BLOCKS));
+
         // check for --startclean option and delete MP_ folders if present
-        if (gArgs.GetBoolArg("-startclean", false)) {
+        if (!fReplay && gArgs.GetBoolArg("-startclean", false)) {
             PrintToLog("Process was started with --startclean option, attempting to clear persistence files..\n");
             try {
                 fs::path persistPath = GetDataDir() / "MP_persist";
@@ -1721,6 +2532,7 @@ int mastercore_init()
                 fs::path feesPath = GetDataDir() / "OMNI_feecache";
                 fs::path feeHistoryPath = GetDataDir() / "OMNI_feehistory";
                 fs::path nftdbPath = GetDataDir() / "OMNI_nftdb";
+                fs::path unifiedPath = GetDataDir() / "OMNI_state";
                 if (fs::exists(persistPath)) fs::remove_all(persistPath);
                 if (fs::exists(txlistPath)) fs::remove_all(txlistPath);
                 if (fs::exists(tradePath)) fs::remove_all(tradePath);
@@ -1730,6 +2542,7 @@ int mastercore_init()
                 if (fs::exists(feesPath)) fs::remove_all(feesPath);
                 if (fs::exists(feeHistoryPath)) fs::remove_all(feeHistoryPath);
                 if (fs::exists(nftdbPath)) fs::remove_all(nftdbPath);
+                if (fs::exists(unifiedPath)) fs::remove_all(unifiedPath);
                 PrintToLog("Success clearing persistence files in datadir %s\n", GetDataDir().string());
                 startClean = true;
             } catch (const fs::filesystem_error& e) {
@@ -1738,27 +2551,120 @@ int mastercore_init()
             }
         }
 
-        pDbTradeList = new CMPTradeList(GetDataDir() / "MP_tradelist", fReindex);
-        pDbStoList = new CMPSTOList(GetDataDir() / "MP_stolist", fReindex);
-        pDbTransactionList = new CMPTxList(GetDataDir() / "MP_txlist", fReindex);
-        pDbSpInfo = new CMPSPInfo(GetDataDir() / "MP_spinfo", fReindex);
-        pDbTransaction = new COmniTransactionDB(GetDataDir() / "Omni_TXDB", fReindex);
-        pDbFeeCache = new COmniFeeCache(GetDataDir() / "OMNI_feecache", fReindex);
-        pDbFeeHistory = new COmniFeeHistory(GetDataDir() / "OMNI_feehistory", fReindex);
-        pDbNFT = new CMPNonFungibleTokensDB(GetDataDir() / "OMNI_nftdb", fReindex);
+        // the databases share a block cache, which is sized in MiB
+        ConfigureDBOptions(std::max<int64_t>(0, gArgs.GetArg("-omnidbcache", DEFAULT_OMNI_DB_CACHE)) * 1024 * 1024,
+                gArgs.GetArg("-omnidbbloombits", DEFAULT_OMNI_DB_BLOOM_BITS),
+                gArgs.GetBoolArg("-omnidbcompression", DEFAULT_OMNI_DB_COMPRESSION));
+
+        // the state databases are either separate, or key ranges of one database, which commits each block atomically
+        fs::path stateDir = omniDir;
+        if (gArgs.GetBoolArg("-omniunifieddb", DEFAULT_OMNI_UNIFIED_DB)) {
+            stateDir = omniDir / "OMNI_state";
+            leveldb::Status status = OpenUnifiedDB(stateDir);
+            if (!status.ok()) {
+                // the separate databases are opened nevertheless, so the node can shut down properly
+                const std::string& msg = strprintf("Failed to open the unified Omni database: %s\n", status.ToString());
+                PrintToLog(msg);
+                AbortNode(msg, msg);
+                stateDir = omniDir;
+            }
+        }
+
+        // the databases are independent, and opening them, which includes replaying their logs, is done in parallel
+        std::vector<std::function<void()> > vOpen{
+            [&] { pDbTradeList = new CMPTradeList(stateDir / "MP_tradelist", fReindex); },
+            [&] { pDbStoList = new CMPSTOList(stateDir / "MP_stolist", fReindex); },
+            [&] { pDbTransactionList = new CMPTxList(stateDir / "MP_txlist", fReindex); },
+            [&] { pDbSpInfo = new CMPSPInfo(stateDir / "MP_spinfo", fReindex); },
+            [&] { pDbTransaction = new COmniTransactionDB(stateDir / "Omni_TXDB", fReindex); },
+            [&] { pDbFeeCache = new COmniFeeCache(stateDir / "OMNI_feecache", fReindex); },
+            [&] { pDbFeeHistory = new COmniFeeHistory(stateDir / "OMNI_feehistory", fReindex); },
+            [&] { pDbNFT = new CMPNonFungibleTokensDB(stateDir / "OMNI_nftdb", fReindex); },
+        };
+        // not affected by -startclean, because the spent outputs don't change, when Omni state is reprocessed
+        if (gArgs.GetBoolArg("-omniprevoutindex", false)) {
+            vOpen.push_back([&] { pDbPrevout = new COmniPrevoutDB(omniDir / "OMNI_prevouts", fReindex); });
+        }
+        // not affected by -startclean either, the markers only depend on the blockchain
+        if (gArgs.GetBoolArg("-omnimarkerindex", true)) {
+            vOpen.push_back([&] { pDbMarkers = new COmniMarkerIndex(omniDir / "OMNI_markerindex", fReindex); });
+        }
+        // the filters depend on the Omni state, so they are wiped with it
+        if (gArgs.GetBoolArg("-omniaddressfilterindex", DEFAULT_OMNI_ADDRESS_FILTER_INDEX)) {
+            vOpen.push_back([&] { pDbAddressFilter = new COmniAddressFilterIndex(stateDir / "OMNI_addressfilter", fReindex); });
+        }
+        // the balances are part of the Omni state, so they are wiped with it
+        if (gArgs.GetBoolArg("-omnibalancehistory", DEFAULT_OMNI_BALANCE_HISTORY)) {
+            vOpen.push_back([&] { pDbBalanceHistory = new COmniBalanceHistory(stateDir / "OMNI_balancehistory", fReindex); });
+        }
+        if (gArgs.GetBoolArg("-omnibalancechangeindex", DEFAULT_OMNI_BALANCE_CHANGE_INDEX)) {
+            vOpen.push_back([&] { pDbBalanceChanges = new COmniBalanceChangeIndex(stateDir / "OMNI_balancechanges", fReindex); });
+        }
+        // the trade counterparties and send-to-owners recipients depend on the Omni state
+        if (gArgs.GetBoolArg("-omniaddressindex", DEFAULT_OMNI_ADDRESS_INDEX)) {
+            vOpen.push_back([&] { pDbAddressIndex = new COmniAddressIndex(stateDir / "OMNI_addressindex", fReindex); });
+        }
+        {
+            GetWorkerPool().ForEach(vOpen.size(), [&](size_t i) { vOpen[i](); });
+        }
+
+        {
+            LOCK(cs_tx_cache);
+            inputCache.SetMaxSize(gArgs.GetArg("-omnitxcache", DEFAULT_INPUT_CACHE_SIZE));
+            inputCache.SetMaxMemory(std::max<int64_t>(0, gArgs.GetArg("-omnitxcachemb", DEFAULT_INPUT_CACHE_MEMORY)) * 1024 * 1024);
+        }
+        rpcTxCache.SetMaxSize(gArgs.GetArg("-omnirpctxcache", DEFAULT_RPC_TX_CACHE_SIZE));
 
-        pathStateFiles = GetDataDir() / "MP_persist";
+        pathStateFiles = omniDir / "MP_persist";
         TryCreateDirectories(pathStateFiles);
 
         wrongDBVersion = (pDbTransactionList->getDBVersion() != DB_VERSION);
 
+        // the history indexes only cover the properties, which were configured, when they were built
+        std::set<uint32_t> setIndexProperties;
+        ParseIndexProperties(gArgs.GetArg("-omniindexproperties", ""), setIndexProperties);
+        SetIndexProperties(setIndexProperties);
+        wrongIndexProperties = (pDbTransactionList->getIndexProperties() != FormatIndexProperties(setIndexProperties));
+
         ++mastercoreInitialized;
     }
 
-    int nWaterline = LoadMostRelevantInMemoryState();
+    // a verified snapshot bootstraps an empty state, and is then loaded like any other persisted state
+    const std::string strSnapshot = gArgs.GetArg("-omniloadsnapshot", "");
+    if (!fReplay && !strSnapshot.empty()) {
+        uint256 hashWatermark;
+        bool fHaveState;
+        {
+            LOCK(cs_tally);
+            fHaveState = pDbSpInfo->getWatermark(hashWatermark);
+        }
+        if (fHaveState) {
+            PrintToLog("Ignoring -omniloadsnapshot, because there is Omni state already\n");
+        } else {
+            SnapshotSummary summary;
+            std::string strError;
+            if (!LoadStateSnapshot(fs::absolute(strSnapshot, GetDataDir()), uint256S(gArgs.GetArg("-omnisnapshothash", "")), summary, strError)) {
+                const std::string& msg = strprintf("Failed to load the Omni state snapshot %s: %s\n", strSnapshot, strError);
+                PrintToLog(msg);
+                AbortNode(msg, msg);
+                return 0;
+            }
+            PrintToConsole("Loading Omni state snapshot: OK [block %d]\n", summary.nBlock);
+
+            LOCK(cs_tally);
+            // the version is part of the snapshot
+            wrongDBVersion = (pDbTransactionList->getDBVersion() != DB_VERSION);
+            wrongIndexProperties = (pDbTransactionList->getIndexProperties() != FormatIndexProperties(GetIndexProperties()));
+        }
+    }
+
+    bool fFreezeStateRestored = false;
+    int nWaterline = LoadMostRelevantInMemoryState(fFreezeStateRestored);
 
     if (!startClean && nWaterline > 0 && nWaterline < GetHeight()) {
-        RewindDBsAndState(nWaterline + 1, 0, true);
+        RewindDBsAndState(nWaterline + 1, 0);
+        // the freeze state is restored or rebuilt along with the rest of the state
+        fFreezeStateRestored = true;
     }
 
     {
@@ -1769,7 +2675,8 @@ int mastercore_init()
 
         if (startClean) {
             assert(pDbTransactionList->setDBVersion() == DB_VERSION); // new set of databases, set DB version
-        } else if (wrongDBVersion) {
+            pDbTransactionList->setIndexProperties(FormatIndexProperties(GetIndexProperties()));
+        } else if (wrongDBVersion || wrongIndexProperties) {
             nWaterlineBlock = -1; // force a clear_all_state and parse from start
         }
 
@@ -1784,6 +2691,7 @@ int mastercore_init()
         } else {
             std::string strReason = "unknown";
             if (wrongDBVersion) strReason = "client version changed";
+            if (wrongIndexProperties) strReason = "indexed properties changed";
             if (noPreviousState) strReason = "no usable previous state found";
             if (startClean) strReason = "-startclean parameter used";
             if (inconsistentDb) strReason = "INCONSISTENT DB DETECTED!\n"
@@ -1797,6 +2705,9 @@ int mastercore_init()
         if (nWaterlineBlock < 0) {
             // persistence says we reparse!, nuke some stuff in case the partial loads left stale bits
             clear_all_state();
+            fFreezeStateRestored = false;
+        } else {
+            LoadHistoryPrunedHeight();
         }
 
         if (inconsistentDb) {
@@ -1819,7 +2730,7 @@ int mastercore_init()
 
         // collect the real Exodus balances available at the snapshot time
         // redundant? do we need to show it both pre-parse and post-parse?  if so let's label the printfs accordingly
-        if (msc_debug_exo) {
+        if (OMNI_VERBOSE_LOG && msc_debug_exo) {
             int64_t exodus_balance = GetTokenBalance(exodus_address, OMNI_PROPERTY_MSC, BALANCE);
             PrintToLog("Exodus balance at start: %s\n", FormatDivisibleMP(exodus_balance));
         }
@@ -1837,8 +2748,9 @@ int mastercore_init()
         // load all alerts from levelDB (and immediately expire old ones)
         pDbTransactionList->LoadAlerts(nWaterlineBlock);
 
-        // load the state of any freeable properties and frozen addresses from levelDB
-        if (!pDbTransactionList->LoadFreezeState(nWaterlineBlock)) {
+        // load the state of any freeable properties and frozen addresses from levelDB,
+        // unless it was restored from the persisted state
+        if (!fFreezeStateRestored && !pDbTransactionList->LoadFreezeState(nWaterlineBlock)) {
             std::string strShutdownReason = "Failed to load freeze state from levelDB.  It is unsafe to continue.\n";
             PrintToLog(strShutdownReason);
             if (!gArgs.GetBoolArg("-overrideforcedshutdown", false)) {
@@ -1849,8 +2761,42 @@ int mastercore_init()
         nWaterline = nWaterlineBlock;
     }
 
-    // initial scan
-    msc_initial_scan(nWaterline);
+    {
+        LOCK(cs_main);
+        // the state includes the blocks before the waterline, the scan records the blocks it processes
+        omniBlockQueue.SetTip(::ChainActive()[nWaterline - 1]);
+    }
+
+    // the stored states are pruned without looking up their blocks, once they are known
+    ScanStoredStates();
+
+    // write the state files off the block processing path
+    StartStatePersistence();
+
+    {
+        LOCK(cs_tally);
+        // a primary publishes the changes of the blocks it processes, replicas apply them
+        InitStateDeltas(gArgs.GetArg("-omnistatedeltaout", ""), gArgs.GetArg("-omnistatedeltain", ""),
+                gArgs.GetArg("-omnistatedeltawait", DEFAULT_STATE_DELTA_WAIT));
+    }
+
+    if (fReplay && fReplayPrepared) {
+        // the replay starts with the stored state of the block before the range, unless it starts with an empty state
+        if (nReplayFirst > ConsensusParams().GENESIS_BLOCK && nWaterline != nReplayFirst) {
+            const std::string& msg = strprintf("Failed to load the state of block %d to replay blocks %d to %d\n", nReplayFirst - 1, nReplayFirst, nReplayLast);
+            PrintToLog(msg);
+            AbortNode(msg, msg);
+        } else {
+            PrintToConsole("Replaying blocks %d to %d in %s\n", nWaterline, nReplayLast, omniDir.string());
+            GetPerfStats(0, true);
+            msc_initial_scan(nWaterline, nReplayLast);
+            ReportReplay(nWaterline, nReplayLast);
+            StartShutdown();
+        }
+    } else if (!fReplay) {
+        // initial scan
+        msc_initial_scan(nWaterline);
+    }
 
     {
         LOCK(cs_tally);
@@ -1860,6 +2806,28 @@ int mastercore_init()
         PrintToLog("Exodus balance after initialization: %s\n", FormatDivisibleMP(exodus_balance));
     }
 
+    {
+        LOCK2(cs_main, cs_tally);
+        // make the initial state available to readers, in case no block was processed
+        const CBlockIndex* pTip = ::ChainActive().Tip();
+        if (pTip) PublishStateSnapshot(pTip->nHeight, pTip->GetBlockHash());
+        for (CDBBase* pdb : GetStateDatabases()) {
+            pdb->PublishSnapshot();
+        }
+    }
+
+    // release pending transactions, when they leave the mempool
+    PendingRegisterNotifications();
+
+    // decode transactions with markers, when they enter the mempool
+    g_mempool_decoder = std::make_shared<CMempoolDecoder>();
+    RegisterSharedValidationInterface(g_mempool_decoder);
+
+    // process the blocks connected from now on, and the ones queued during the initial scan
+    if (COmniBlockQueue::IsEnabled()) {
+        omniBlockQueue.Start();
+    }
+
     PrintToConsole("Omni Core initialization completed\n");
 
     return 0;
@@ -1875,8 +2843,25 @@ int mastercore_init()
  */
 int mastercore_shutdown()
 {
+    // the blocks still queued are processed after a restart
+    omniBlockQueue.Stop();
+    ReleaseMappedBlockFiles();
+
+    PendingUnregisterNotifications();
+    if (g_mempool_decoder) {
+        UnregisterSharedValidationInterface(g_mempool_decoder);
+        g_mempool_decoder.reset();
+    }
+    {
+        LOCK(cs_mempool_decoded);
+        mapMempoolDecoded.clear();
+    }
+
     LOCK(cs_tally);
 
+    // write the remaining state files, while the SP database is still open
+    StopStatePersistence();
+
     if (pDbTransactionList) {
         delete pDbTransactionList;
         pDbTransactionList = nullptr;
@@ -1909,11 +2894,50 @@ int mastercore_shutdown()
         delete pDbNFT;
         pDbNFT = nullptr;
     }
+    if (pDbPrevout) {
+        delete pDbPrevout;
+        pDbPrevout = nullptr;
+    }
+    if (pDbMarkers) {
+        delete pDbMarkers;
+        pDbMarkers = nullptr;
+    }
+    if (pDbAddressFilter) {
+        delete pDbAddressFilter;
+        pDbAddressFilter = nullptr;
+    }
+    if (pDbBalanceHistory) {
+        delete pDbBalanceHistory;
+        pDbBalanceHistory = nullptr;
+    }
+    if (pDbBalanceChanges) {
+        delete pDbBalanceChanges;
+        pDbBalanceChanges = nullptr;
+    }
+    if (pDbAddressIndex) {
+        delete pDbAddressIndex;
+        pDbAddressIndex = nullptr;
+    }
+    CloseUnifiedDB();
+
+    {
+        LOCK(cs_tx_cache);
+        PrintToLog("Input cache statistics [size=%d, hit=%d, miss=%d, evicted=%d]\n",
+                inputCache.Size(), inputCache.GetHits(), inputCache.GetMisses(), inputCache.GetEvictions());
+        inputCache.Clear();
+    }
+
+    InitStateSnapshot(false);
+    InitUndoJournal(0);
+
+    // interruptible tasks of other threads are skipped from now on
+    StopWorkerPool();
 
     mastercoreInitialized = 0;
 
     PrintToLog("\nOmni Core shutdown completed\n");
     PrintToLog("Shutdown time: %s\n", FormatISO8601DateTime(GetTime()));
+    StopDebugLog();
 
     PrintToConsole("Omni Core shutdown completed\n");
 
@@ -1921,91 +2945,329 @@ int mastercore_shutdown()
 }
 
 /**
- * This handler is called for every new transaction that comes in (actually in block parsing loop).
+ * Processes a transaction, which may have been decoded in advance.
+ *
+ * A transaction, which was decoded in advance, is executed without acquiring cs_main,
+ * while parsing fetches the spent outputs, which may require cs_main.
  *
+ * @param mp_parsed[in,out]   The object to parse into, if the transaction wasn't decoded, which is reused within a block
+ * @param fRulesChanged[out]  Set to true, if the transaction activated or deactivated a feature
  * @return True, if the transaction was an Exodus purchase, DEx payment or a valid Omni transaction
  */
-bool mastercore_handler_tx(const CTransaction& tx, int nBlock, unsigned int idx, const CBlockIndex* pBlockIndex, const std::shared_ptr<std::map<COutPoint, Coin> > removedCoins)
+static bool HandleTransaction(const CTransaction& tx, int nBlock, unsigned int idx, const CBlockIndex* pBlockIndex, const std::shared_ptr<std::map<COutPoint, Coin> > removedCoins, CDecodedTransaction* pDecoded, CMPTransaction& mp_parsed, bool& fRulesChanged) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
 {
-    int nMastercoreInit, pop_ret;
-    {
-        LOCK(cs_tally);
-        nMastercoreInit = mastercoreInitialized;
-    }
-
-    if (!nMastercoreInit) {
-        mastercore_init();
-    }
-
-    {
-        LOCK(cs_tally);
-
-        // clear pending, if any
-        // NOTE1: Every incoming TX is checked, not just MP-ones because:
-        // if for some reason the incoming TX doesn't pass our parser validation steps successfully, I'd still want to clear pending amounts for that TX.
-        // NOTE2: Plus I wanna clear the amount before that TX is parsed by our protocol, in case we ever consider pending amounts in internal calculations.
-        PendingDelete(tx.GetHash());
-
-        // we do not care about parsing blocks prior to our waterline (empty blockchain defense)
-        if (nBlock < nWaterlineBlock) return false;
-    }
-
     int64_t nBlockTime = pBlockIndex->GetBlockTime();
-    CMPTransaction mp_obj;
-    mp_obj.unlockLogic();
+    const bool fParse = !pDecoded || !pDecoded->mp_tx;
+    if (fParse) mp_parsed.SetNull();
+    CMPTransaction& mp_obj = fParse ? mp_parsed : *pDecoded->mp_tx;
     bool fFoundTx = false;
+    int pop_ret;
 
-    {
-        LOCK2(cs_main, cs_tally);
+    // balance changes are published with the transaction, which caused them
+    SetBalanceNotificationTx(tx.GetHash());
+    if (pDbBalanceChanges) pDbBalanceChanges->SetTransaction(idx, tx.GetHash());
+    if (pDbAddressIndex) pDbAddressIndex->SetTransaction(idx, tx.GetHash());
+
+    // the changes of the transaction are obtained from the state commitment before and after
+    CStateCommitment commitmentBefore;
+    if (msc_debug_consensus_delta) commitmentBefore = GetCurrentStateCommitment();
+
+    if (pDecoded) {
+        pop_ret = pDecoded->nResult;
+        if (pDecoded->nClass != NO_MARKER) {
+            PrintParseHeader(tx, nBlock, idx, nBlockTime);
+        }
+    } else {
+        mp_obj.unlockLogic();
+        CPerfTimer timer(PERF_PARSE);
+        OMNI_TRACE3(tx_parse_start, tx.GetHash().begin(), nBlock, idx);
         pop_ret = parseTransaction(false, tx, nBlock, idx, mp_obj, nBlockTime, removedCoins);
+        OMNI_TRACE4(tx_parse_end, tx.GetHash().begin(), nBlock, idx, pop_ret);
     }
 
-    {
-        LOCK(cs_tally);
+    if (pop_ret >= 0) {
+        assert(mp_obj.getEncodingClass() != NO_MARKER);
+        assert(mp_obj.getSender().empty() == false);
 
-        if (pop_ret >= 0) {
-            assert(mp_obj.getEncodingClass() != NO_MARKER);
-            assert(mp_obj.getSender().empty() == false);
+        if (pDbAddressFilter) {
+            pDbAddressFilter->AddAddress(mp_obj.getSender());
+            pDbAddressFilter->AddAddress(mp_obj.getReceiver());
+        }
+        if (pDbAddressIndex) {
+            pDbAddressIndex->RecordAddress(mp_obj.getSender(), ADDRESS_ROLE_SENDER);
+            pDbAddressIndex->RecordAddress(mp_obj.getReceiver(), ADDRESS_ROLE_RECEIVER);
+        }
 
-            // extra iteration of the outputs for every transaction, not needed on mainnet after Exodus closed
-            const CConsensusParams& params = ConsensusParams();
-            if (isNonMainNet() || nBlock <= params.LAST_EXODUS_BLOCK) {
-                fFoundTx |= HandleExodusPurchase(tx, nBlock, mp_obj.getSender(), nBlockTime);
-            }
+        // extra iteration of the outputs for every transaction, not needed on mainnet after Exodus closed
+        const CConsensusParams& params = ConsensusParams();
+        if (isNonMainNet() || nBlock <= params.LAST_EXODUS_BLOCK) {
+            fFoundTx |= HandleExodusPurchase(tx, nBlock, mp_obj.getSender(), nBlockTime);
         }
+    }
 
-        if (pop_ret > 0) {
-            assert(mp_obj.getEncodingClass() == OMNI_CLASS_A);
-            assert(mp_obj.getPayload().empty() == true);
+    if (pop_ret > 0) {
+        assert(mp_obj.getEncodingClass() == OMNI_CLASS_A);
+        assert(mp_obj.getPayload().empty() == true);
 
-            fFoundTx |= HandleDExPayments(tx, nBlock, mp_obj.getSender());
-        }
+        fFoundTx |= HandleDExPayments(tx, nBlock, mp_obj.getSender());
     }
 
     if (0 == pop_ret) {
-        int interp_ret = mp_obj.interpretPacket();
+        const int64_t nTimeInterpret = GetPerfTimeMicros();
+        OMNI_TRACE4(tx_interpret_start, tx.GetHash().begin(), nBlock, mp_obj.getType(), mp_obj.getVersion());
+        int interp_ret = mp_obj.interpretPacket(pBlockIndex);
+        OMNI_TRACE4(tx_interpret_end, tx.GetHash().begin(), nBlock, mp_obj.getType(), interp_ret);
+        const int64_t nInterpretTime = GetPerfTimeMicros() - nTimeInterpret;
+        AddPerfTime(PERF_INTERPRET, nInterpretTime);
+        AddPerfTypeTime(mp_obj.getType(), nInterpretTime);
+        CountMetricsTransaction(mp_obj.getType(), interp_ret == 0);
         if (interp_ret) PrintToLog("!!! interpretPacket() returned %d !!!\n", interp_ret);
 
         // Only structurally valid transactions get recorded in levelDB
         // PKT_ERROR - 2 = interpret_Transaction failed, structurally invalid payload
         if (interp_ret != PKT_ERROR - 2) {
-            LOCK(cs_tally);
+            CPerfTimer timer(PERF_DB_WRITE);
             bool bValid = (0 <= interp_ret);
-            pDbTransactionList->recordTX(tx.GetHash(), bValid, nBlock, mp_obj.getType(), mp_obj.getNewAmount());
-            pDbTransaction->RecordTransaction(tx.GetHash(), idx, interp_ret);
+            pDbTransactionList->recordTX(tx.GetHash(), bValid, nBlock, mp_obj.getType(), mp_obj.getNewAmount(), mp_obj.getIndexInBlock());
+            pDbTransaction->RecordTransaction(mp_obj, pBlockIndex->GetBlockHash(), interp_ret);
+            NotifyTransactionRecorded(mp_obj, pBlockIndex->GetBlockHash(), interp_ret);
+        }
+        // invalid transactions of a property are indexed, too, even though they didn't change its balances
+        if (pDbAddressIndex) {
+            pDbAddressIndex->MarkProperty(mp_obj.getProperty());
+            pDbAddressIndex->MarkProperty(mp_obj.getDesiredProperty());
         }
         fFoundTx |= (interp_ret == 0);
+
+        uint16_t type = mp_obj.getType();
+        if (type == OMNICORE_MESSAGE_TYPE_ACTIVATION || type == OMNICORE_MESSAGE_TYPE_DEACTIVATION) {
+            fRulesChanged = true;
+        }
+        // replicas reload neither activations nor alerts, so they process such blocks themselves
+        if (fRulesChanged || type == OMNICORE_MESSAGE_TYPE_ALERT) {
+            MarkStateDeltaRulesChanged();
+        }
     }
 
-    LOCK(cs_tally);
+    SetBalanceNotificationTx(uint256());
+    if (pDbBalanceChanges) pDbBalanceChanges->SetTransaction(-1, uint256());
+    if (pDbAddressIndex) pDbAddressIndex->SetTransaction(-1, uint256());
+
     if (fFoundTx && msc_debug_consensus_hash_every_transaction) {
-        uint256 consensusHash = GetConsensusHash();
-        PrintToLog("Consensus hash for transaction %s: %s\n", tx.GetHash().GetHex(), consensusHash.GetHex());
+        LogConsensusHash(strprintf("transaction %s", tx.GetHash().GetHex()));
+    }
+
+    if (fFoundTx && msc_debug_consensus_delta) {
+        LogConsensusDelta(nBlock, tx.GetHash(), commitmentBefore);
     }
 
     return fFoundTx;
 }
 
+/**
+ * Checks a run of simple sends of a block in parallel, ahead of their execution.
+ *
+ * The run starts at the given position, and ends before the first other transaction,
+ * which was decoded successfully, or before the first send of a sender, which already
+ * sends the same property within the run. Earlier transactions of the run only credit
+ * the balances checked by a send, and don't change the properties, rules or freeze
+ * state, so checks, which passed against the state before the run, still pass, when
+ * the sends are executed one after another in the order of the block.
+ *
+ * @return The position after the run
+ */
+static size_t PrecheckSimpleSends(std::vector<CDecodedTransaction>& vDecoded, size_t nFirst, CWorkerPool& pool) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    std::vector<CMPTransaction*> vSends;
+    std::set<std::pair<std::string, uint32_t> > setDebited;
+
+    size_t n = nFirst;
+    for (; n < vDecoded.size(); ++n) {
+        CDecodedTransaction& decoded = vDecoded[n];
+        // transactions, which failed to decode, are not executed
+        if (decoded.nClass == NO_MARKER || decoded.nResult < 0) continue;
+
+        uint32_t property;
+        if (decoded.nResult > 0 || !decoded.mp_tx || !decoded.mp_tx->peekSimpleSend(property)) break;
+        if (!setDebited.emplace(decoded.mp_tx->getSender(), property).second) break;
+        vSends.push_back(decoded.mp_tx.get());
+    }
+
+    // short runs are checked as usual, when they are executed
+    if (vSends.size() >= MIN_PARALLEL_SEND_CHECKS) {
+        CPerfTimer timer(PERF_PRECHECK);
+        pool.ForEach(vSends.size(), [&](size_t i) { vSends[i]->precheckSimpleSend(); }, GetDecodeThreads());
+    }
+
+    return std::max(n, nFirst + 1);
+}
+
+/**
+ * Decodes a transaction again, after a feature activation changed the rules within the block.
+ *
+ * The outputs spent by the transaction were fetched, when it was decoded in advance, so
+ * no further lookups are needed.
+ */
+static void RedecodeTransaction(const CTransaction& tx, int nBlock, unsigned int idx, int64_t nTime, CDecodedTransaction& decoded)
+{
+    // transactions without marker stay skipped, and missing outputs stay missing
+    if (decoded.nClass == NO_MARKER || decoded.vPrevouts.size() != tx.vin.size()) return;
+
+    decoded.mp_tx = MakeUnique<CMPTransaction>();
+    decoded.mp_tx->unlockLogic();
+    decoded.mp_tx->Set(tx.GetHash(), nBlock, idx, nTime);
+    decoded.nResult = decodeTransaction(false, tx, nBlock, idx, *decoded.mp_tx, decoded.nClass, decoded.vPrevouts);
+}
+
+//! Delay of the execution of the transactions of each block in milliseconds, so tests can hold the processing inside a block
+static int64_t GetBlockDelay()
+{
+    static const int64_t nDelay = gArgs.GetArg("-omniblockdelay", 0);
+    return nDelay;
+}
+
+/**
+ * Clears the pending amounts of the transactions of a block, and executes the ones with
+ * a marker, in the order of the block.
+ *
+ * @return The number of Exodus purchases, DEx payments and valid Omni transactions
+ */
+static unsigned int ExecuteBlockTransactions(const CBlock& block, const CBlockIndex* pBlockIndex, const std::shared_ptr<std::map<COutPoint, Coin> > removedCoins, const std::vector<CMarkerScan>& vScan, std::vector<CDecodedTransaction>* pvDecoded, CWorkerPool* pPool, bool fReplicaBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    const int nBlock = pBlockIndex->nHeight;
+
+    if (GetBlockDelay() > 0) UninterruptibleSleep(std::chrono::milliseconds{GetBlockDelay()});
+
+    // clear pending, if any
+    // NOTE1: Every incoming TX is checked, not just MP-ones because:
+    // if for some reason the incoming TX doesn't pass our parser validation steps successfully, I'd still want to clear pending amounts for that TX.
+    // NOTE2: Plus I wanna clear the amount before that TX is parsed by our protocol, in case we ever consider pending amounts in internal calculations.
+    {
+        CPerfTimer timerPending(PERF_PENDING);
+        for (const auto& tx : block.vtx) {
+            PendingDelete(tx->GetHash());
+        }
+    }
+
+    // we do not care about parsing blocks prior to our waterline (empty blockchain defense)
+    if (nBlock < nWaterlineBlock) return 0;
+
+    // the changes of the block are applied from the delta of the primary, when it was processed
+    if (fReplicaBlock) return 0;
+
+    // feature activations may change the rules for following transactions of the
+    // same block, in which case they are no longer filtered, and decoded again
+    bool fRulesChanged = false;
+    unsigned int nFound = 0;
+    size_t nPrecheckedUntil = 0;
+    // transactions, which were not decoded in advance, are parsed into the same object
+    CMPTransaction mp_parsed;
+
+    for (size_t n = 0; n < block.vtx.size(); ++n) {
+        const CTransaction& tx = *block.vtx[n];
+
+        // remember blocks with potential Omni transactions, so others can be skipped when rescanning
+        if (vScan[n].HasMarker()) ++nBlockMarkers;
+
+        if (!fRulesChanged && vScan[n].nEncodingClass == NO_MARKER) continue;
+
+        CDecodedTransaction* pDecoded = pvDecoded ? &(*pvDecoded)[n] : nullptr;
+        if (pDecoded && fRulesChanged) {
+            RedecodeTransaction(tx, nBlock, n, pBlockIndex->GetBlockTime(), *pDecoded);
+        } else if (pDecoded && pPool && n >= nPrecheckedUntil) {
+            nPrecheckedUntil = PrecheckSimpleSends(*pvDecoded, n, *pPool);
+        }
+        if (HandleTransaction(tx, nBlock, n, pBlockIndex, removedCoins, pDecoded, mp_parsed, fRulesChanged)) ++nFound;
+    }
+
+    return nFound;
+}
+
+/**
+ * Processes the transactions of a block.
+ *
+ * Transactions without marker are filtered first, without holding any locks,
+ * and the remaining transactions are processed within a single critical section.
+ *
+ * The transactions, which were decoded in advance, are executed with cs_tally
+ * held only, so the chain can advance meanwhile, when the block is processed
+ * by the Omni thread, see -omniasync. Otherwise cs_main is held as well, because
+ * parsing may look up the spent outputs.
+ *
+ * @param pvDecoded[in]  The transactions decoded in advance, or nullptr
+ * @param pPool[in]      The workers to check independent simple sends in advance, or nullptr
+ * @return The number of Exodus purchases, DEx payments and valid Omni transactions
+ */
+static unsigned int HandleBlockTransactions(const CBlock& block, const CBlockIndex* pBlockIndex, const std::shared_ptr<std::map<COutPoint, Coin> > removedCoins, std::vector<CDecodedTransaction>* pvDecoded, CWorkerPool* pPool)
+{
+    const int nBlock = pBlockIndex->nHeight;
+    int nMastercoreInit;
+    bool fReplicaBlock;
+    {
+        LOCK(cs_tally);
+        nMastercoreInit = mastercoreInitialized;
+        fReplicaBlock = IsApplyingStateDelta();
+    }
+
+    if (!nMastercoreInit) {
+        mastercore_init();
+    }
+
+    std::vector<CMarkerScan> vScan(block.vtx.size());
+    for (size_t n = 0; !fReplicaBlock && n < block.vtx.size(); ++n) {
+        if (pvDecoded) {
+            vScan[n] = (*pvDecoded)[n].scan;
+        } else {
+            ScanMarkers(*block.vtx[n], nBlock, vScan[n]);
+        }
+    }
+
+    CPerfTimer timer(PERF_TRANSACTIONS);
+    if (pvDecoded) {
+        LOCK(cs_tally);
+        return ExecuteBlockTransactions(block, pBlockIndex, removedCoins, vScan, pvDecoded, pPool, fReplicaBlock);
+    }
+
+    LOCK2(cs_main, cs_tally);
+    return ExecuteBlockTransactions(block, pBlockIndex, removedCoins, vScan, pvDecoded, pPool, fReplicaBlock);
+}
+
+//! Minimum number of transactions of a connected block to decode them in parallel
+static const size_t MIN_PARALLEL_DECODE_TXS = 32;
+
+/**
+ * This handler is called for every new block, after it was connected.
+ *
+ * The senders and payloads of larger blocks are decoded in parallel, before the
+ * transactions are interpreted in the order of the block. On the Omni thread every
+ * block is decoded in advance, so cs_main isn't held while it's interpreted.
+ *
+ * @return The number of Exodus purchases, DEx payments and valid Omni transactions in the block
+ */
+unsigned int mastercore_handler_block(const CBlock& block, const CBlockIndex* pBlockIndex, const std::shared_ptr<std::map<COutPoint, Coin> > removedCoins)
+{
+    bool fInitialized;
+    bool fReplicaBlock;
+    {
+        LOCK(cs_tally);
+        fInitialized = mastercoreInitialized;
+        fReplicaBlock = IsApplyingStateDelta();
+    }
+
+    // blocks applied from a delta are not interpreted, so there is nothing to decode
+    if (!fInitialized || fReplicaBlock || (block.vtx.size() < MIN_PARALLEL_DECODE_TXS && !COmniBlockQueue::IsEnabled())) {
+        return HandleBlockTransactions(block, pBlockIndex, removedCoins, nullptr, nullptr);
+    }
+
+    std::vector<CDecodedTransaction> vDecoded;
+    {
+        CPerfTimer timer(PERF_PARSE);
+        DecodeBlockTransactions(block, pBlockIndex->nHeight, pBlockIndex->GetBlockTime(), removedCoins, GetWorkerPool(), vDecoded);
+    }
+
+    return HandleBlockTransactions(block, pBlockIndex, removedCoins, &vDecoded, nullptr);
+}
+
 /**
  * Determines, whether it is valid to use a Class C transaction for a given payload size.
  *
@@ -2025,27 +3287,59 @@ bool mastercore::UseEncodingClassC(size_t nDataSize)
 
 int mastercore_handler_block_begin(int nBlockPrev, CBlockIndex const * pBlockIndex)
 {
+    OMNI_TRACE2(block_begin, pBlockIndex->nHeight, pBlockIndex->GetBlockHash().begin());
+    CPerfTimer timer(PERF_BLOCK_BEGIN);
+    const int nChainHeight = GetHeight();
     bool bRecoveryMode{false};
     {
         LOCK(cs_tally);
 
+        // changes are not visible to readers, until the block was processed
+        HoldStateSnapshot();
+
         if (reorgRecoveryMode > 0) {
             reorgRecoveryMode = 0; // clear reorgRecovery here as this is likely re-entrant
             bRecoveryMode = true;
         }
     }
 
-    if (bRecoveryMode) {
+    // disconnected blocks without Omni activity don't require a rollback
+    if (bRecoveryMode && !DisconnectUntouchedBlocks(pBlockIndex)) {
         RewindDBsAndState(pBlockIndex->nHeight, nBlockPrev);
     }
 
+    // replicas apply the changes of the block published by the primary, if there are any
+    const bool fReplicaBlock = pBlockIndex->nHeight >= nWaterlineBlock && LoadStateDelta(pBlockIndex);
+
     {
         LOCK(cs_tally);
 
+        // the recovery publishes the state of the blocks rescanned, so hold again
+        HoldStateSnapshot();
+
+        nBlockMarkers = 0;
+
+        // record the changes of this block, if it's one of the last blocks of the chain
+        const uint256 hashPrevBlock = pBlockIndex->pprev ? pBlockIndex->pprev->GetBlockHash() : uint256();
+        BeginBlockUndo(pBlockIndex->nHeight, hashPrevBlock, nChainHeight);
+
+        // track, whether this block touches the state, so disconnecting it is cheap otherwise
+        BeginBlockActivity(pBlockIndex->nHeight, hashPrevBlock, nChainHeight, GetStateCommitment(), exodus_prev);
+
+        // the writes of this block are committed at once, when the block was processed
+        for (CDBBase* pdb : GetStateDatabases()) {
+            pdb->BeginBatch();
+        }
+        // the index entries of applied blocks are part of the writes of the primary
+        if (pDbBalanceChanges && !fReplicaBlock) pDbBalanceChanges->BeginBlock(pBlockIndex->nHeight);
+        if (pDbAddressIndex && !fReplicaBlock) pDbAddressIndex->BeginBlock(pBlockIndex->nHeight);
+
         // handle any features that go live with this block
+        const size_t nPendingActivations = GetPendingActivations().size();
         CheckLiveActivations(pBlockIndex->nHeight);
+        if (GetPendingActivations().size() != nPendingActivations) MarkBlockTouched();
 
-        eraseExpiredCrowdsale(pBlockIndex);
+        if (!fReplicaBlock) eraseExpiredCrowdsale(pBlockIndex);
     }
 
     return 0;
@@ -2057,6 +3351,7 @@ int mastercore_handler_block_begin(int nBlockPrev, CBlockIndex const * pBlockInd
 int mastercore_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex,
         unsigned int countMP)
 {
+    const int64_t nTimeBlockEnd = GetPerfTimeMicros();
     int nMastercoreInit;
     {
         LOCK(cs_tally);
@@ -2067,6 +3362,24 @@ int mastercore_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex,
         mastercore_init();
     }
 
+    // replicas take the state after the block from the delta of the primary
+    bool fReplicaBlock;
+    {
+        LOCK(cs_tally);
+        fReplicaBlock = IsApplyingStateDelta();
+        if (fReplicaBlock && !ApplyStateDelta(GetStateDatabases())) {
+            // diverged from the primary, can't be trusted to provide valid data - shutdown client
+            const std::string& msg = strprintf(
+                    "Shutting down due to a failed state delta for block %d (hash %s). "
+                    "Please restart without -omnistatedeltain to process the blocks instead.\n",
+                    nBlockNow, pBlockIndex->GetBlockHash().GetHex());
+            PrintToLog(msg);
+            if (!gArgs.GetBoolArg("-overrideforcedshutdown", false)) {
+                AbortNode(msg, msg);
+            }
+        }
+    }
+
     bool checkpointValid;
     {
         LOCK(cs_tally);
@@ -2077,38 +3390,70 @@ int mastercore_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex,
         //    paying BTC for the offer in several installments)
         // 2) update the amount in the Exodus address
         int64_t devmsc = 0;
-        unsigned int how_many_erased = eraseExpiredAccepts(nBlockNow);
+        unsigned int how_many_erased = fReplicaBlock ? 0 : eraseExpiredAccepts(nBlockNow);
 
         if (how_many_erased) {
             PrintToLog("%s(%d); erased %u accepts this block, line %d, file: %s\n",
                 __FUNCTION__, how_many_erased, nBlockNow, __LINE__, __FILE__);
         }
 
+        // Dev Omni changes the state of nearly every block, so it's not considered as activity
+        const uint256 hashStateBeforeDevMsc = GetStateCommitment();
+
         // calculate devmsc as of this block and update the Exodus' balance
-        devmsc = calculate_and_update_devmsc(pBlockIndex->GetBlockTime(), nBlockNow);
+        if (!fReplicaBlock) devmsc = calculate_and_update_devmsc(pBlockIndex->GetBlockTime(), nBlockNow);
 
-        if (msc_debug_exo) {
+        if (OMNI_VERBOSE_LOG && msc_debug_exo) {
             int64_t balance = GetTokenBalance(exodus_address, OMNI_PROPERTY_MSC, BALANCE);
             PrintToLog("devmsc for block %d: %d, Exodus balance: %d\n", nBlockNow, devmsc, FormatDivisibleMP(balance));
         }
 
         // check the alert status, do we need to do anything else here?
+        const size_t nAlerts = GetOmniCoreAlerts().size();
         CheckExpiredAlerts(nBlockNow, pBlockIndex->GetBlockTime());
 
-        // check that pending transactions are still in the mempool
-        PendingCheck();
+        // invalid Omni transactions are recorded as well, so they touch the state, too
+        // the activity of applied blocks is unknown, so they are rolled back like touched ones
+        if (countMP > 0 || nBlockMarkers > 0 || fReplicaBlock || GetOmniCoreAlerts().size() != nAlerts) MarkBlockTouched();
+        EndBlockActivity(nBlockNow, pBlockIndex->GetBlockHash(), hashStateBeforeDevMsc);
+
+        // blocks prior to the waterline are not examined for markers, and applied blocks are not scanned
+        if (pDbMarkers && nBlockNow >= nWaterlineBlock && !fReplicaBlock) {
+            pDbMarkers->RecordBlock(pBlockIndex, nBlockMarkers > 0);
+        }
+
+        // store the filter over the addresses touched by this block
+        if (pDbAddressFilter && !fReplicaBlock) {
+            pDbAddressFilter->RecordBlock(pBlockIndex);
+        }
 
         // transactions were found in the block, signal the UI accordingly
-        if (countMP > 0) CheckWalletUpdate(true);
+        if (countMP > 0 || fReplicaBlock) CheckWalletUpdate(true);
+
+        // signal the balances, which changed in this block, once with their final amounts
+        NotifyBalanceChanges(nBlockNow);
+        NotifyBlockConnected(nBlockNow, pBlockIndex->GetBlockHash());
 
-        // calculate and print a consensus hash if required
-        if (ShouldConsensusHashBlock(nBlockNow)) {
-            uint256 consensusHash = GetConsensusHash();
-            PrintToLog("Consensus hash for block %d: %s\n", nBlockNow, consensusHash.GetHex());
+        {
+            CPerfTimer timer(PERF_CONSENSUS_HASH);
+
+            // calculate and print a consensus hash if required
+            if (ShouldConsensusHashBlock(nBlockNow)) {
+                LogConsensusHash(strprintf("block %d", nBlockNow));
+            }
+
+            // the commitment is maintained incrementally, so it's cheap to keep one for every block
+            pDbTransactionList->RecordStateHash(nBlockNow, pBlockIndex->GetBlockHash(), GetStateCommitment());
+        }
+
+        // check the token counts of the properties, whose non-fungible tokens changed in this block
+        {
+            CPerfTimer timer(PERF_NFT_SANITY);
+            pDbNFT->SanityCheck();
         }
 
-        // request nftdb sanity check
-        pDbNFT->SanityCheck();
+        // drop the history below the horizon, the deletions are written with the other updates of this block
+        PruneHistory(nBlockNow, fReplicaBlock);
 
         // request checkpoint verification
         checkpointValid = VerifyCheckpoint(nBlockNow, pBlockIndex->GetBlockHash());
@@ -2127,23 +3472,105 @@ int mastercore_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex,
         }
     }
 
-    LOCK2(cs_main, cs_tally);
+    // the distance to the chain tip is determined, before cs_tally is locked again
+    const bool fPersistEnabled = IsPersistenceEnabled(nBlockNow);
+
+    // nothing below requires cs_main, so the chain can advance, while the block is committed by the Omni thread
+    LOCK(cs_tally);
+
+    // the balance history, changes and address index are written with the other updates of this block
+    EndBlockUndo(nBlockNow, pBlockIndex->GetBlockHash());
+    if (pDbBalanceChanges) pDbBalanceChanges->EndBlock();
+    if (pDbAddressIndex) pDbAddressIndex->EndBlock();
+
+    // the delta holds the writes of this block, so they are published before they are committed
+    if (checkpointValid && !fReplicaBlock) {
+        PublishStateDelta(pBlockIndex, GetStateDatabases());
+    }
+
+    // write the database updates of this block, before the state is persisted
+    int64_t nTimeStart = GetTimeMicros();
+    const bool fPersist = checkpointValid && fPersistEnabled && nBlockNow >= ConsensusParams().GENESIS_BLOCK;
+    // in bulk-load mode the updates of many blocks are written at once, but always before the state is persisted,
+    // and every block, while deltas are published, because a delta holds the writes of one block only
+    if (!fBulkLoadMode || fPersist || IsPublishingStateDeltas() || nBlockNow % BULK_LOAD_COMMIT_INTERVAL == 0) {
+        CPerfTimer timer(PERF_DB_WRITE);
+        const std::vector<CDBBase*> vDatabases = GetStateDatabases();
+        OMNI_TRACE2(db_commit_start, nBlockNow, vDatabases.size());
+        CDBBase::CommitBatches(vDatabases);
+        OMNI_TRACE1(db_commit_end, nBlockNow);
+
+        // history queries read the databases as of this block, without holding cs_tally
+        for (CDBBase* pdb : vDatabases) {
+            pdb->PublishSnapshot();
+        }
+    }
+
     if (checkpointValid){
         // save out the state after this block
-        if (IsPersistenceEnabled(nBlockNow) && nBlockNow >= ConsensusParams().GENESIS_BLOCK) {
+        if (fPersist) {
+            CPerfTimer timer(PERF_PERSIST);
+            OMNI_TRACE1(persist_start, nBlockNow);
             PersistInMemoryState(pBlockIndex);
+            OMNI_TRACE1(persist_end, nBlockNow);
         }
     }
+    scanStatus.AddTime(0, 0, GetTimeMicros() - nTimeStart);
+
+    // make the state after this block available to readers
+    PublishStateSnapshot(nBlockNow, pBlockIndex->GetBlockHash());
+
+    // addresses without balances are removed, once they make up half of the tally map, because the
+    // consumers of the modified addresses examine all addresses afterwards, as after a clear
+    if (mp_tally_map.GetEmptyCount() >= std::max(MIN_EMPTY_ADDRESSES_REMOVED, mp_tally_map.size() / 2)) {
+        const int64_t nTimeRemove = GetTimeMicros();
+        const size_t nRemoved = RemoveEmptyAddresses();
+        PrintToLog("Removed %d addresses without balances from the tally map in %.3f ms\n", nRemoved, 0.001 * (GetTimeMicros() - nTimeRemove));
+    }
+
+    CheckMemoryUsage();
+
+    // the temporaries of this block are gone, so surplus arena chunks can be freed
+    ReleaseBlockArena();
+
+    // clients waiting for this block are released
+    omniBlockQueue.SetTip(pBlockIndex);
+
+    AddPerfTime(PERF_BLOCK_END, GetPerfTimeMicros() - nTimeBlockEnd);
+    EndPerfBlock();
+    CountMetricsBlock();
+
+    OMNI_TRACE3(block_end, nBlockNow, pBlockIndex->GetBlockHash().begin(), countMP);
 
     return 0;
 }
 
-void mastercore_handler_disc_begin(const int nHeight)
+void mastercore_handler_disc_begin(const int nHeight, const uint256& blockHash)
 {
     LOCK(cs_tally);
 
     reorgRecoveryMode = 1;
     reorgRecoveryMaxHeight = (nHeight > reorgRecoveryMaxHeight) ? nHeight: reorgRecoveryMaxHeight;
+
+    // the cached transaction objects of the disconnected blocks are outdated
+    rpcTxCache.Clear();
+
+    NotifyBlockDisconnected(nHeight, blockHash);
+}
+
+bool mastercore_async_enabled()
+{
+    return COmniBlockQueue::IsEnabled();
+}
+
+void mastercore_queue_block_connected(std::shared_ptr<const CBlock> pblock, CBlockIndex const * pBlockIndex, std::shared_ptr<std::map<COutPoint, Coin>> removedCoins)
+{
+    omniBlockQueue.PushConnected(std::move(pblock), pBlockIndex, std::move(removedCoins));
+}
+
+void mastercore_queue_block_disconnected(CBlockIndex const * pBlockIndex)
+{
+    omniBlockQueue.PushDisconnected(pBlockIndex);
 }
 
 /**
@@ -1,14 +1,18 @@
 #ifndef BITCOIN_OMNICORE_OMNICORE_H
 #define BITCOIN_OMNICORE_OMNICORE_H
 
+class CBlock;
 class CBlockIndex;
 class CCoinsView;
 class CCoinsViewCache;
+class CDBBase;
+class COmniInputCache;
 class CTransaction;
 class Coin;
 
 #include <omnicore/log.h>
 #include <omnicore/tally.h>
+#include <omnicore/timedmutex.h>
 
 #include <script/standard.h>
 #include <sync.h>
@@ -38,7 +42,7 @@ int const DONT_STORE_MAINNET_STATE_UNTIL = 622000;
 #define TEST_ECO_PROPERTY_1 (0x80000003UL)
 
 // increment this value to force a refresh of the state (similar to --startclean)
-#define DB_VERSION 8
+#define DB_VERSION 22
 
 // could probably also use: int64_t maxInt64 = std::numeric_limits<int64_t>::max();
 // maximum numeric values from the spec:
@@ -144,8 +148,19 @@ const std::vector<unsigned char> GetOmMarker();
 //! Used to indicate, whether to automatically commit created transactions
 extern bool autoCommit;
 
-//! Global lock for state objects
-extern RecursiveMutex cs_tally;
+/**
+ * Global lock for state objects.
+ *
+ * It guards the tally map, the DEx, MetaDEx, crowdsale and freeze state, and the
+ * writes of the state databases, which change together while a block is processed.
+ * Readers of the state after the last processed block use the published snapshots
+ * instead, see GetStateSnapshot() and CDBBase::NewSnapshotIterator().
+ *
+ * Lock order: cs_main, ::mempool.cs, cs_tally, then cs_pending, cs_tx_cache and the
+ * internal locks of the databases and caches, which are never held while acquiring
+ * one of the former.
+ */
+extern CTimedRecursiveMutex cs_tally;
 
 //! Available balances of wallet properties
 extern std::map<uint32_t, int64_t> global_balance_money;
@@ -166,10 +181,15 @@ int mastercore_init();
 int mastercore_shutdown();
 
 /** Block and transaction handlers. */
-void mastercore_handler_disc_begin(const int nHeight);
+void mastercore_handler_disc_begin(const int nHeight, const uint256& blockHash);
 int mastercore_handler_block_begin(int nBlockNow, CBlockIndex const * pBlockIndex);
 int mastercore_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex, unsigned int);
-bool mastercore_handler_tx(const CTransaction& tx, int nBlock, unsigned int idx, const CBlockIndex* pBlockIndex, const std::shared_ptr<std::map<COutPoint, Coin>> removedCoins);
+unsigned int mastercore_handler_block(const CBlock& block, const CBlockIndex* pBlockIndex, const std::shared_ptr<std::map<COutPoint, Coin>> removedCoins);
+
+/** Queue of the block notifications, which are processed by the Omni thread, see -omniasync. */
+bool mastercore_async_enabled();
+void mastercore_queue_block_connected(std::shared_ptr<const CBlock> pblock, CBlockIndex const * pBlockIndex, std::shared_ptr<std::map<COutPoint, Coin>> removedCoins);
+void mastercore_queue_block_disconnected(CBlockIndex const * pBlockIndex);
 
 /** Scans for marker and if one is found, add transaction to marker cache. */
 void TryToAddToMarkerCache(const CTransactionRef& tx);
@@ -177,6 +197,12 @@ void TryToAddToMarkerCache(const CTransactionRef& tx);
 void RemoveFromMarkerCache(const uint256& txHash);
 /** Checks, if transaction is in marker cache. */
 bool IsInMarkerCache(const uint256& txHash);
+/** Checks, if a transaction of the mempool has a marker, also when it was evicted from the marker cache. */
+bool HasMempoolMarker(const uint256& txHash);
+/** Checks, if the outputs spent by a transaction of a connected block are needed by the block handlers. */
+bool HasMarkerForInputs(const CTransaction& tx, int nBlock);
+/** Checks the structure of an Omni payload, when a transaction is accepted to the mempool, see -omnimempoolcheck. */
+bool CheckOmniMempoolPayload(const CTransaction& tx, const CCoinsViewCache& view, bool fCache, std::string& strReason);
 
 /** Global handler to total wallet balances. */
 void CheckWalletUpdate(bool forceUpdate = false);
@@ -187,13 +213,18 @@ void NotifyTotalTokensChanged(uint32_t propertyId, int block);
 namespace mastercore
 {
 //! In-memory collection of all amounts for all addresses for all properties
-extern std::unordered_map<std::string, CMPTally> mp_tally_map;
+extern CMPTallyMap mp_tally_map;
 
 // TODO: move, rename
 extern CCoinsView viewDummy;
 extern CCoinsViewCache view;
-//! Guards coins view cache
-extern RecursiveMutex cs_tx_cache;
+//! Cache of outputs spent by Omni transactions
+extern COmniInputCache inputCache;
+//! Guards coins view cache and input cache
+extern CInstrumentedRecursiveMutex cs_tx_cache;
+
+/** Returns the databases of the global state, which are updated while processing blocks. */
+std::vector<CDBBase*> GetStateDatabases() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
 
 /** Returns the encoding class, used to embed a payload. */
 int GetEncodingClass(const CTransaction& tx, int nBlock);
@@ -206,8 +237,12 @@ bool isMainEcosystemProperty(uint32_t propertyId);
 uint32_t GetNextPropertyId(bool maineco); // maybe move into sp
 
 CMPTally* getTally(const std::string& address);
+CMPTally* getTally(uint32_t addressId);
 bool update_tally_map(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype);
+bool update_tally_map(uint32_t addressId, uint32_t propertyId, int64_t amount, TallyType ttype);
 int64_t getTotalTokens(uint32_t propertyId, int64_t* n_owners_total = nullptr);
+/** Returns the number of tokens of a property, which isn't of fixed supply, without loading the property. */
+int64_t getVariableTotalTokens(uint32_t propertyId);
 
 std::string strMPProperty(uint32_t propertyId);
 std::string strTransactionType(uint16_t txType);
@@ -223,14 +258,22 @@ void freezeAddress(const std::string& address, uint32_t propertyId);
 void unfreezeAddress(const std::string& address, uint32_t propertyId);
 /** Checks whether an address and property are frozen **/
 bool isAddressFrozen(const std::string& address, uint32_t propertyId);
+/** Returns the heap memory used by the cache of potential Omni transactions in the mempool **/
+size_t GetMarkerCacheUsage();
+/** Returns all frozen addresses and properties **/
+const std::set<std::pair<std::string, uint32_t> >& GetFrozenAddresses();
 /** Adds a property to the freezingEnabledMap **/
 void enableFreezing(uint32_t propertyId, int liveBlock);
 /** Removes a property from the freezingEnabledMap **/
 void disableFreezing(uint32_t propertyId);
 /** Checks whether a property has freezing enabled **/
 bool isFreezingEnabled(uint32_t propertyId, int block);
+/** Returns all properties with freezing enabled and the blocks, at which freezing becomes live **/
+const std::set<std::pair<uint32_t, int> >& GetFreezingEnabledProperties();
 /** Clears the freeze state in the event of a reorg **/
 void ClearFreezeState();
+/** Replaces the freeze state, when it's restored from the undo journal or a persisted state **/
+void RestoreFreezeState(const std::set<std::pair<uint32_t, int> >& enabledProperties, const std::set<std::pair<std::string, uint32_t> >& frozenAddresses);
 /** Prints the freeze state **/
 void PrintFreezeState();
 
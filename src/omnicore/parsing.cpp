@@ -6,10 +6,12 @@
 
 #include <omnicore/parsing.h>
 
+#include <omnicore/addresscache.h>
 #include <omnicore/log.h>
 #include <omnicore/script.h>
 
 #include <base58.h>
+#include <crypto/sha256.h>
 #include <key_io.h>
 #include <uint256.h>
 #include <util/strencodings.h>
@@ -84,10 +86,10 @@ std::string HashToAddress(unsigned char version, const uint160& hash)
 {
     if (version == Params().Base58Prefix(CChainParams::PUBKEY_ADDRESS)[0]) {
         CKeyID keyId(hash);
-        return EncodeDestination(PKHash(keyId));
+        return mastercore::EncodeDestinationCached(PKHash(keyId));
     } else if (version == Params().Base58Prefix(CChainParams::SCRIPT_ADDRESS)[0]) {
         CScriptID scriptId(hash);
-        return EncodeDestination(ScriptHash(scriptId));
+        return mastercore::EncodeDestinationCached(ScriptHash(scriptId));
     }
 
     return "";
@@ -105,28 +107,38 @@ std::string HashToAddress(unsigned char version, const uint160& hash)
  * @param hashCount[in]    How many hashes to generate (number of packets to debofuscate)
  * @param vstrHashes[out]  The generated hashes
  */
-void PrepareObfuscatedHashes(const std::string& strSeed, int hashCount, std::string(&vstrHashes)[1+MAX_SHA256_OBFUSCATION_TIMES])
+void PrepareObfuscatedHashes(const std::string& strSeed, int hashCount, unsigned char (&vchHashes)[1+MAX_SHA256_OBFUSCATION_TIMES][32])
 {
-    unsigned char sha_input[128];
-    unsigned char sha_result[128];
-    std::vector<unsigned char> vec_chars;
-
-    assert(strSeed.size() < sizeof(sha_input));
-    strcpy((char *)sha_input, strSeed.c_str());
+    static const char hexDigits[] = "0123456789ABCDEF";
+    unsigned char sha_input[64]; // upper case hex of the previous hash
 
     if (hashCount > MAX_SHA256_OBFUSCATION_TIMES) hashCount = MAX_SHA256_OBFUSCATION_TIMES;
+    if (hashCount < 1) return;
+
+    CSHA256().Write(reinterpret_cast<const unsigned char*>(strSeed.data()), strSeed.size()).Finalize(vchHashes[1]);
 
     // Do only as many re-hashes as there are data packets, 255 per specification
+    for (int j = 2; j <= hashCount; ++j)
+    {
+        for (int i = 0; i < 32; ++i) {
+            sha_input[2*i] = hexDigits[vchHashes[j-1][i] >> 4];
+            sha_input[2*i+1] = hexDigits[vchHashes[j-1][i] & 0x0f];
+        }
+        CSHA256().Write(sha_input, sizeof(sha_input)).Finalize(vchHashes[j]);
+    }
+}
+
+void PrepareObfuscatedHashes(const std::string& strSeed, int hashCount, std::string(&vstrHashes)[1+MAX_SHA256_OBFUSCATION_TIMES])
+{
+    unsigned char vchHashes[1+MAX_SHA256_OBFUSCATION_TIMES][32];
+
+    if (hashCount > MAX_SHA256_OBFUSCATION_TIMES) hashCount = MAX_SHA256_OBFUSCATION_TIMES;
+    PrepareObfuscatedHashes(strSeed, hashCount, vchHashes);
+
     for (int j = 1; j <= hashCount; ++j)
     {
-        CSHA256().Write(sha_input, strlen((const char *)sha_input)).Finalize(sha_result);
-        vec_chars.resize(32);
-        memcpy(&vec_chars[0], &sha_result[0], 32);
-        vstrHashes[j] = HexStr(vec_chars);
+        vstrHashes[j] = HexStr(vchHashes[j], vchHashes[j] + 32);
         boost::to_upper(vstrHashes[j]); // Convert to upper case characters
-
-        assert(vstrHashes[j].size() < sizeof(sha_input));
-        strcpy((char *)sha_input, vstrHashes[j].c_str());
     }
 }
 
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 
+class CCoinsViewCache;
 class CTransaction;
 class CMPTransaction;
 class uint160;
@@ -31,11 +32,14 @@ void SwapByteOrder64(uint64_t&);
 /** Determines the Bitcoin address associated with a given hash and version. */
 std::string HashToAddress(unsigned char version, const uint160& hash);
 
+/** Generates hashes used for obfuscation via SHA256(ToUpper(HexStr(x))), chained from SHA256(seed). */
+void PrepareObfuscatedHashes(const std::string& strSeed, int hashCount, unsigned char (&vchHashes)[1+MAX_SHA256_OBFUSCATION_TIMES][32]);
+
 /** Generates hashes used for obfuscation via ToUpper(HexStr(SHA256(x))). */
 void PrepareObfuscatedHashes(const std::string& strSeed, int hashCount, std::string(&vstrHashes)[1+MAX_SHA256_OBFUSCATION_TIMES]);
 
-/** Parses a transaction and populates the CMPTransaction object. */
-int ParseTransaction(const CTransaction& tx, int nBlock, unsigned int idx, CMPTransaction& mptx, unsigned int nTime=0);
+/** Parses a transaction and populates the CMPTransaction object, optionally with inputs provided by the caller. */
+int ParseTransaction(const CTransaction& tx, int nBlock, unsigned int idx, CMPTransaction& mptx, unsigned int nTime=0, const CCoinsViewCache* pInputs=nullptr);
 
 
 #endif // BITCOIN_OMNICORE_PARSING_H
@@ -0,0 +1,195 @@
+#ifndef BITCOIN_OMNICORE_PAYLOAD_H
+#define BITCOIN_OMNICORE_PAYLOAD_H
+
+#include <crypto/common.h>
+#include <span.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace mastercore
+{
+/**
+ * Reads the fields of a payload in big-endian byte order.
+ *
+ * The reader spans the payload and the zero padding following it, see PAYLOAD_PADDING,
+ * so fields and strings, which extend past the end of the payload, are read as zero.
+ * Reads beyond the padding are refused, and yield zero values instead.
+ */
+class CPayloadReader
+{
+private:
+    //! The payload, followed by zero padding
+    Span<const unsigned char> m_data;
+    //! The size of the payload without the padding
+    size_t m_size;
+    //! The position of the next field
+    size_t m_pos;
+    //! Whether a field extended past the padding
+    bool m_fFailed;
+
+    /** Returns a pointer to the next n bytes and advances, or nullptr, if they are not covered. */
+    const unsigned char* Take(size_t n)
+    {
+        if (m_fFailed || n > m_data.size() - std::min<size_t>(m_pos, m_data.size())) {
+            m_fFailed = true;
+            return nullptr;
+        }
+        const unsigned char* p = m_data.data() + m_pos;
+        m_pos += n;
+        return p;
+    }
+
+public:
+    /**
+     * @param data  The payload, followed by the padding
+     * @param size  The size of the payload without the padding
+     * @param pos   The position of the first field
+     */
+    CPayloadReader(Span<const unsigned char> data, size_t size, size_t pos = 0)
+        : m_data(data), m_size(size), m_pos(pos), m_fFailed(size > size_t(data.size())) {}
+
+    uint8_t ReadU8()
+    {
+        const unsigned char* p = Take(1);
+        return p ? p[0] : 0;
+    }
+
+    uint16_t ReadU16()
+    {
+        const unsigned char* p = Take(2);
+        return p ? (uint16_t(p[0]) << 8) | p[1] : 0;
+    }
+
+    uint32_t ReadU32()
+    {
+        const unsigned char* p = Take(4);
+        return p ? ReadBE32(p) : 0;
+    }
+
+    uint64_t ReadU64()
+    {
+        const unsigned char* p = Take(8);
+        return p ? ReadBE64(p) : 0;
+    }
+
+    /** Reads n raw bytes, or zeros, if they are not covered. */
+    void ReadBytes(unsigned char* dst, size_t n)
+    {
+        const unsigned char* p = Take(n);
+        if (p) {
+            memcpy(dst, p, n);
+        } else {
+            memset(dst, 0, n);
+        }
+    }
+
+    /**
+     * Reads a null-terminated string, and returns its first nMaxLength characters.
+     *
+     * The terminator is consumed. A string, which runs to the end of the payload, is
+     * terminated by the padding.
+     */
+    std::string ReadString(size_t nMaxLength)
+    {
+        if (m_fFailed || m_pos >= size_t(m_data.size())) {
+            m_fFailed = true;
+            return std::string();
+        }
+        const unsigned char* p = m_data.data() + m_pos;
+        const void* pEnd = memchr(p, '\0', m_data.size() - m_pos);
+        if (!pEnd) {
+            m_fFailed = true;
+            return std::string();
+        }
+        const size_t nLength = static_cast<const unsigned char*>(pEnd) - p;
+        m_pos += nLength + 1;
+        return std::string(reinterpret_cast<const char*>(p), std::min(nLength, nMaxLength));
+    }
+
+    /** Returns the position of the next field. */
+    size_t GetPosition() const { return m_pos; }
+
+    /**
+     * Returns whether the fields read extend past the end of the payload.
+     *
+     * For compatibility, the fields may extend one byte past the end.
+     */
+    bool IsOverrun() const { return m_fFailed || m_pos > m_size; }
+};
+
+/**
+ * Appends the fields of a payload in big-endian byte order.
+ */
+class CPayloadWriter
+{
+private:
+    std::vector<unsigned char> m_payload;
+
+public:
+    /** Starts a payload with the given version and type. */
+    CPayloadWriter(uint16_t version, uint16_t type)
+    {
+        WriteU16(version);
+        WriteU16(type);
+    }
+
+    CPayloadWriter& WriteU8(uint8_t value)
+    {
+        m_payload.push_back(value);
+        return *this;
+    }
+
+    CPayloadWriter& WriteU16(uint16_t value)
+    {
+        m_payload.push_back(value >> 8);
+        m_payload.push_back(value & 0xff);
+        return *this;
+    }
+
+    CPayloadWriter& WriteU32(uint32_t value)
+    {
+        unsigned char buf[4];
+        WriteBE32(buf, value);
+        m_payload.insert(m_payload.end(), buf, buf + sizeof(buf));
+        return *this;
+    }
+
+    CPayloadWriter& WriteU64(uint64_t value)
+    {
+        unsigned char buf[8];
+        WriteBE64(buf, value);
+        m_payload.insert(m_payload.end(), buf, buf + sizeof(buf));
+        return *this;
+    }
+
+    CPayloadWriter& WriteBytes(const std::vector<unsigned char>& vch)
+    {
+        m_payload.insert(m_payload.end(), vch.begin(), vch.end());
+        return *this;
+    }
+
+    /** Appends the first nMaxLength characters of a string, followed by a terminator. */
+    CPayloadWriter& WriteString(const std::string& str, size_t nMaxLength)
+    {
+        m_payload.insert(m_payload.end(), str.begin(), str.begin() + std::min(str.size(), nMaxLength));
+        m_payload.push_back('\0');
+        return *this;
+    }
+
+    /** Returns the payload, after which the writer is empty. */
+    std::vector<unsigned char> Release()
+    {
+        std::vector<unsigned char> payload;
+        payload.swap(m_payload);
+        return payload;
+    }
+};
+}
+
+#endif // BITCOIN_OMNICORE_PAYLOAD_H
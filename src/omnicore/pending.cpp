@@ -1,6 +1,7 @@
 #include <omnicore/pending.h>
 
 #include <omnicore/log.h>
+#include <omnicore/snapshot.h>
 #include <omnicore/sp.h>
 
 #include <amount.h>
@@ -9,13 +10,15 @@
 #include <txmempool.h>
 #include <uint256.h>
 #include <ui_interface.h>
+#include <validationinterface.h>
 
+#include <memory>
 #include <string>
 
 namespace mastercore
 {
 //! Guards my_pending
-RecursiveMutex cs_pending;
+CInstrumentedRecursiveMutex cs_pending("cs_pending");
 
 //! Global map of pending transaction objects
 PendingMap my_pending;
@@ -25,25 +28,39 @@ PendingMap my_pending;
  */
 void PendingAdd(const uint256& txid, const std::string& sendingAddress, uint16_t type, uint32_t propertyId, int64_t amount, bool fSubtract)
 {
-    if (msc_debug_pending) PrintToLog("%s(%s,%s,%d,%d,%d,%s)\n", __func__, txid.GetHex(), sendingAddress, type, propertyId, amount, fSubtract);
+    PrintToLogIf(msc_debug_pending, "%s(%s,%s,%d,%d,%d,%s)\n", __func__, txid.GetHex(), sendingAddress, type, propertyId, amount, fSubtract);
 
-    // bypass tally update for pending transactions, if there the amount should not be subtracted from the balance (e.g. for cancels)
-    if (fSubtract) {
-        if (!update_tally_map(sendingAddress, propertyId, -amount, PENDING)) {
-            PrintToLog("ERROR - Update tally for pending failed! %s(%s,%s,%d,%d,%d,%s)\n", __func__, txid.GetHex(), sendingAddress, type, propertyId, amount, fSubtract);
+    {
+        // removals from the mempool happen while cs_main is held, so a transaction, which is in the
+        // mempool here, is only removed after it was added, and the notification deletes it again
+        LOCK(cs_main);
+        if (!mempool.exists(txid)) {
+            PrintToLog("WARNING: Pending transaction %s is not in this nodes mempool and will be discarded\n", txid.GetHex());
             return;
         }
-    }
 
-    // add pending object
-    CMPPending pending;
-    pending.src = sendingAddress;
-    pending.amount = amount;
-    pending.prop = propertyId;
-    pending.type = type;
-    {
-        LOCK(cs_pending);
-        my_pending.insert(std::make_pair(txid, pending));
+        // bypass tally update for pending transactions, if there the amount should not be subtracted from the balance (e.g. for cancels)
+        if (fSubtract) {
+            if (!update_tally_map(sendingAddress, propertyId, -amount, PENDING)) {
+                PrintToLog("ERROR - Update tally for pending failed! %s(%s,%s,%d,%d,%d,%s)\n", __func__, txid.GetHex(), sendingAddress, type, propertyId, amount, fSubtract);
+                return;
+            }
+        }
+
+        // add pending object
+        CMPPending pending;
+        pending.src = sendingAddress;
+        pending.amount = amount;
+        pending.prop = propertyId;
+        pending.type = type;
+        {
+            LOCK(cs_pending);
+            my_pending.insert(std::make_pair(txid, pending));
+        }
+        {
+            LOCK(cs_tally);
+            RefreshStateSnapshot();
+        }
     }
     // after adding a transaction to pending the available balance may now be reduced, refresh wallet totals
     CheckWalletUpdate(true); // force an update since some outbound pending (eg MetaDEx cancel) may not change balances
@@ -63,7 +80,7 @@ void PendingDelete(const uint256& txid)
     if (it != my_pending.end()) {
         const CMPPending& pending = it->second;
         int64_t src_amount = GetTokenBalance(pending.src, pending.prop, PENDING);
-        if (msc_debug_pending) PrintToLog("%s(%s): amount=%d\n", __FUNCTION__, txid.GetHex(), src_amount);
+        PrintToLogIf(msc_debug_pending, "%s(%s): amount=%d\n", __FUNCTION__, txid.GetHex(), src_amount);
         if (src_amount) update_tally_map(pending.src, pending.prop, pending.amount, PENDING);
         my_pending.erase(it);
 
@@ -73,29 +90,49 @@ void PendingDelete(const uint256& txid)
 }
 
 /**
- * Performs a check to ensure all pending transactions are still in the mempool.
+ * Releases pending transactions, when they leave the mempool without being included in a block.
  *
- * NOTE: Transactions no longer in the mempool (eg orphaned) are deleted from
- *       the pending map and credited back to the pending tally.
+ * Transactions, which are included in a block, are deleted from the pending map, when the
+ * block is processed.
  */
-void PendingCheck()
+class CPendingNotifications : public CValidationInterface
 {
-    LOCK(cs_pending);
-
-    std::vector<uint256> vecMemPoolTxids;
-    std::vector<uint256> txidsForDeletion;
-    mempool.queryHashes(vecMemPoolTxids);
-
-    for (PendingMap::iterator it = my_pending.begin(); it != my_pending.end(); ++it) {
-        const uint256& txid = it->first;
-        if (std::find(vecMemPoolTxids.begin(), vecMemPoolTxids.end(), txid) == vecMemPoolTxids.end()) {
+protected:
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason) override
+    {
+        const uint256& txid = tx->GetHash();
+        {
+            LOCK2(cs_tally, cs_pending);
+            if (!my_pending.count(txid)) return;
             PrintToLog("WARNING: Pending transaction %s is no longer in this nodes mempool and will be discarded\n", txid.GetHex());
-            txidsForDeletion.push_back(txid);
+            PendingDelete(txid);
+            RefreshStateSnapshot();
         }
+        CheckWalletUpdate(true);
     }
+};
+
+//! Subscription to the mempool notifications
+static std::shared_ptr<CPendingNotifications> g_pending_notifications;
+
+/**
+ * Subscribes the pending map to the transactions leaving the mempool.
+ */
+void PendingRegisterNotifications()
+{
+    if (g_pending_notifications) return;
+    g_pending_notifications = std::make_shared<CPendingNotifications>();
+    RegisterSharedValidationInterface(g_pending_notifications);
+}
 
-    for (auto& txid : txidsForDeletion)
-        PendingDelete(txid);
+/**
+ * Stops the subscription to the mempool notifications.
+ */
+void PendingUnregisterNotifications()
+{
+    if (!g_pending_notifications) return;
+    UnregisterSharedValidationInterface(g_pending_notifications);
+    g_pending_notifications.reset();
 }
 
 } // namespace mastercore
@@ -4,6 +4,8 @@
 class uint256;
 struct CMPPending;
 
+#include <omnicore/timedmutex.h>
+
 #include <sync.h>
 
 #include <stdint.h>
@@ -15,7 +17,7 @@ namespace mastercore
 //! Map of pending transaction objects
 typedef std::map<uint256, CMPPending> PendingMap;
 //! Guards my_pending
-extern RecursiveMutex cs_pending;
+extern CInstrumentedRecursiveMutex cs_pending;
 //! Global map of pending transaction objects
 extern PendingMap my_pending;
 
@@ -25,8 +27,11 @@ void PendingAdd(const uint256& txid, const std::string& sendingAddress, uint16_t
 /** Deletes a transaction from the pending map and credits the amount back to the pending tally for the address. */
 void PendingDelete(const uint256& txid);
 
-/** Performs a check to ensure all pending transactions are still in the mempool. */
-void PendingCheck();
+/** Subscribes the pending map to the transactions leaving the mempool. */
+void PendingRegisterNotifications();
+
+/** Stops the subscription to the mempool notifications. */
+void PendingUnregisterNotifications();
 
 }
 
@@ -0,0 +1,190 @@
+/**
+ * @file perfstats.cpp
+ *
+ * This file contains the times spent in the phases of the block processing,
+ * per block, since startup and over the last blocks.
+ */
+
+#include <omnicore/perfstats.h>
+
+#include <omnicore/omnicore.h>
+#include <omnicore/timedmutex.h>
+
+#include <sync.h>
+
+#include <univalue.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace mastercore
+{
+//! Names of the phases, as reported by the RPC
+static const char* const PERF_PHASE_NAMES[PERF_PHASE_COUNT] = {
+    "blockbegin", "transactions", "pending", "parse", "inputs", "interpret",
+    "precheck", "dbwrite", "consensushash", "nftsanity", "persist", "blockend"
+};
+
+//! Time of the phases in the current block, which is updated without locks
+static std::atomic<int64_t> vCurrentTimes[PERF_PHASE_COUNT];
+
+static Mutex cs_perfstats;
+//! Time of the transaction types in the current block
+static std::map<uint16_t, int64_t> mapCurrentTypeTimes GUARDED_BY(cs_perfstats);
+static CPerfSeries vPhaseSeries[PERF_PHASE_COUNT] GUARDED_BY(cs_perfstats);
+static std::map<uint16_t, CPerfSeries> mapTypeSeries GUARDED_BY(cs_perfstats);
+
+int64_t GetPerfTimeMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Returns the bucket of a time, the first one holds times below one microsecond. */
+static size_t GetBucket(int64_t nMicros)
+{
+    size_t bucket = 0;
+    while (bucket < PERF_BUCKETS - 1 && nMicros >= (int64_t{1} << bucket)) ++bucket;
+    return bucket;
+}
+
+void CPerfSeries::Add(int64_t nMicros)
+{
+    if (m_nBlocks == 0 || nMicros < m_nMin) m_nMin = nMicros;
+    if (m_nBlocks == 0 || nMicros > m_nMax) m_nMax = nMicros;
+    ++m_nBlocks;
+    m_nTotal += nMicros;
+    ++m_vBuckets[GetBucket(nMicros)];
+
+    m_recent.push_back(nMicros);
+    if (m_recent.size() > PERF_RECENT_BLOCKS) m_recent.pop_front();
+}
+
+int64_t CPerfSeries::GetPercentile99() const
+{
+    if (m_nBlocks == 0) return 0;
+
+    const uint64_t nRank = (m_nBlocks * 99 + 99) / 100;
+    uint64_t nCount = 0;
+    for (size_t bucket = 0; bucket < PERF_BUCKETS; ++bucket) {
+        nCount += m_vBuckets[bucket];
+        if (nCount >= nRank) {
+            return std::min(int64_t{1} << bucket, m_nMax);
+        }
+    }
+    return m_nMax;
+}
+
+int64_t CPerfSeries::GetRecentPercentile99(size_t nBlocks) const
+{
+    nBlocks = std::min(nBlocks, m_recent.size());
+    if (nBlocks == 0) return 0;
+
+    std::vector<int64_t> vTimes(m_recent.end() - nBlocks, m_recent.end());
+    const size_t nRank = (nBlocks * 99 + 99) / 100;
+    std::nth_element(vTimes.begin(), vTimes.begin() + (nRank - 1), vTimes.end());
+    return vTimes[nRank - 1];
+}
+
+UniValue CPerfSeries::ToJSON(size_t nBlocks) const
+{
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("blocks", m_nBlocks);
+    result.pushKV("totaltime", m_nTotal / 1000000.0);
+    result.pushKV("mintime", m_nMin / 1000000.0);
+    result.pushKV("avgtime", m_nBlocks ? m_nTotal / (1000000.0 * m_nBlocks) : 0.0);
+    result.pushKV("p99time", GetPercentile99() / 1000000.0);
+    result.pushKV("maxtime", m_nMax / 1000000.0);
+
+    nBlocks = std::min(nBlocks, m_recent.size());
+    int64_t nRecentTotal = 0;
+    int64_t nRecentMin = 0;
+    int64_t nRecentMax = 0;
+    const size_t nFirst = m_recent.size() - nBlocks;
+    for (size_t n = nFirst; n < m_recent.size(); ++n) {
+        const int64_t nMicros = m_recent[n];
+        if (n == nFirst || nMicros < nRecentMin) nRecentMin = nMicros;
+        nRecentMax = std::max(nRecentMax, nMicros);
+        nRecentTotal += nMicros;
+    }
+
+    UniValue recent(UniValue::VOBJ);
+    recent.pushKV("blocks", (uint64_t) nBlocks);
+    recent.pushKV("totaltime", nRecentTotal / 1000000.0);
+    recent.pushKV("mintime", nRecentMin / 1000000.0);
+    recent.pushKV("avgtime", nBlocks ? nRecentTotal / (1000000.0 * nBlocks) : 0.0);
+    recent.pushKV("p99time", GetRecentPercentile99(nBlocks) / 1000000.0);
+    recent.pushKV("maxtime", nRecentMax / 1000000.0);
+    result.pushKV("recent", recent);
+
+    return result;
+}
+
+void AddPerfTime(PerfPhase phase, int64_t nMicros)
+{
+    vCurrentTimes[phase].fetch_add(nMicros, std::memory_order_relaxed);
+}
+
+void AddPerfTypeTime(uint16_t type, int64_t nMicros)
+{
+    LOCK(cs_perfstats);
+    mapCurrentTypeTimes[type] += nMicros;
+}
+
+void EndPerfBlock()
+{
+    LOCK(cs_perfstats);
+    for (size_t phase = 0; phase < PERF_PHASE_COUNT; ++phase) {
+        vPhaseSeries[phase].Add(vCurrentTimes[phase].exchange(0, std::memory_order_relaxed));
+    }
+
+    // types are only counted in blocks, which have transactions of the type
+    for (const std::pair<const uint16_t, int64_t>& entry : mapCurrentTypeTimes) {
+        mapTypeSeries[entry.first].Add(entry.second);
+    }
+    mapCurrentTypeTimes.clear();
+}
+
+UniValue GetPerfStats(size_t nBlocks, bool fReset)
+{
+    UniValue phases(UniValue::VARR);
+    UniValue types(UniValue::VARR);
+    UniValue locks = GetLockStats(LOCK_STATS_TOP_SITES, fReset);
+
+    LOCK(cs_perfstats);
+    for (size_t phase = 0; phase < PERF_PHASE_COUNT; ++phase) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("phase", PERF_PHASE_NAMES[phase]);
+        entry.pushKVs(vPhaseSeries[phase].ToJSON(nBlocks));
+        phases.push_back(entry);
+    }
+    for (const std::pair<const uint16_t, CPerfSeries>& series : mapTypeSeries) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("type_int", (uint64_t) series.first);
+        entry.pushKV("type", strTransactionType(series.first));
+        entry.pushKVs(series.second.ToJSON(nBlocks));
+        types.push_back(entry);
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("blocks", vPhaseSeries[PERF_BLOCK_END].GetBlocks());
+    response.pushKV("phases", phases);
+    response.pushKV("types", types);
+    response.pushKV("locks", locks);
+
+    if (fReset) {
+        for (size_t phase = 0; phase < PERF_PHASE_COUNT; ++phase) {
+            vPhaseSeries[phase] = CPerfSeries();
+        }
+        mapTypeSeries.clear();
+    }
+
+    return response;
+}
+} // namespace mastercore
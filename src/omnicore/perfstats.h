@@ -0,0 +1,97 @@
+#ifndef BITCOIN_OMNICORE_PERFSTATS_H
+#define BITCOIN_OMNICORE_PERFSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+
+class UniValue;
+
+namespace mastercore
+{
+/** Phases of the block processing, which are timed. */
+enum PerfPhase : size_t
+{
+    PERF_BLOCK_BEGIN,       //!< mastercore_handler_block_begin, with activations and crowdsale expiry
+    PERF_TRANSACTIONS,      //!< all transactions of the block, including the phases below
+    PERF_PENDING,           //!< clearing pending amounts of the transactions of the block
+    PERF_PARSE,             //!< parseTransaction, including the inputs
+    PERF_INPUTS,            //!< fetching the outputs spent by transactions into the input cache
+    PERF_INTERPRET,         //!< interpretPacket, also reported by transaction type
+    PERF_PRECHECK,          //!< checking runs of independent simple sends in parallel
+    PERF_DB_WRITE,          //!< recording transactions, and committing the database batches
+    PERF_CONSENSUS_HASH,    //!< consensus hashes and the state commitment of the block
+    PERF_NFT_SANITY,        //!< sanity check of the non-fungible tokens
+    PERF_PERSIST,           //!< PersistInMemoryState
+    PERF_BLOCK_END,         //!< mastercore_handler_block_end, including the phases above
+    PERF_PHASE_COUNT
+};
+
+//! Number of recent blocks, whose times are kept for the statistics
+static const size_t PERF_RECENT_BLOCKS = 1000;
+//! Number of buckets of the time distribution, each one covers twice the time of the previous one
+static const size_t PERF_BUCKETS = 40;
+
+/** Returns the time of a monotonic clock in microseconds. */
+int64_t GetPerfTimeMicros();
+
+/**
+ * Times of one phase per block.
+ *
+ * The times since startup are kept as totals and as a distribution with buckets of
+ * increasing size, the times of the recent blocks are kept in full.
+ */
+class CPerfSeries
+{
+private:
+    uint64_t m_nBlocks = 0;
+    int64_t m_nTotal = 0;
+    int64_t m_nMin = 0;
+    int64_t m_nMax = 0;
+    uint64_t m_vBuckets[PERF_BUCKETS] = {};
+    std::deque<int64_t> m_recent;
+
+public:
+    /** Adds the time of a block. */
+    void Add(int64_t nMicros);
+
+    /** Returns the number of blocks since startup. */
+    uint64_t GetBlocks() const { return m_nBlocks; }
+
+    /** Returns the 99th percentile since startup, which is the upper limit of its bucket. */
+    int64_t GetPercentile99() const;
+
+    /** Returns the 99th percentile of the last blocks. */
+    int64_t GetRecentPercentile99(size_t nBlocks) const;
+
+    /** Returns the statistics since startup and of the last blocks, with times in seconds. */
+    UniValue ToJSON(size_t nBlocks) const;
+};
+
+/** Adds time spent in a phase to the current block. */
+void AddPerfTime(PerfPhase phase, int64_t nMicros);
+
+/** Adds time spent interpreting a transaction of a type to the current block. */
+void AddPerfTypeTime(uint16_t type, int64_t nMicros);
+
+/** Adds the times of the current block to the statistics, and starts the next block. */
+void EndPerfBlock();
+
+/** Returns the statistics of the phases, transaction types and locks, and optionally resets them. */
+UniValue GetPerfStats(size_t nBlocks, bool fReset);
+
+/** Measures the time of a scope, and adds it to a phase. */
+class CPerfTimer
+{
+private:
+    const PerfPhase m_phase;
+    const int64_t m_nStart;
+
+public:
+    explicit CPerfTimer(PerfPhase phase) : m_phase(phase), m_nStart(GetPerfTimeMicros()) {}
+    ~CPerfTimer() { AddPerfTime(m_phase, GetPerfTimeMicros() - m_nStart); }
+};
+}
+
+#endif // BITCOIN_OMNICORE_PERFSTATS_H
@@ -6,31 +6,43 @@
 
 #include <omnicore/persistence.h>
 
+#include <omnicore/consensushash.h>
 #include <omnicore/dex.h>
 #include <omnicore/log.h>
 #include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
 #include <omnicore/rules.h>
 #include <omnicore/sp.h>
+#include <omnicore/statefile.h>
 #include <omnicore/tally.h>
 #include <omnicore/utilsbitcoin.h>
+#include <omnicore/workerpool.h>
 
 #include <chain.h>
 #include <fs.h>
 #include <hash.h>
+#include <sync.h>
 #include <validation.h>
 #include <tinyformat.h>
 #include <uint256.h>
 #include <util/system.h>
+#include <util/threadnames.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 
 #include <stdint.h>
+#include <string.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <map>
 #include <set>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -43,15 +55,12 @@ extern int64_t exodus_prev;
 //! Path for file based persistence
 extern fs::path pathStateFiles;
 
-enum FILETYPES {
-  FILETYPE_BALANCES = 0,
-  FILETYPE_OFFERS,
-  FILETYPE_ACCEPTS,
-  FILETYPE_GLOBALS,
-  FILETYPE_CROWDSALES,
-  FILETYPE_MDEXORDERS,
-  NUM_FILETYPES
-};
+//! Marks a state file, which holds the changes since the state of another block
+static const uint8_t FILETYPE_DELTA = 0x80;
+//! Type of the manifest, which lists the state files of a block, once all of them were written
+static const uint8_t FILETYPE_MANIFEST = 0x40;
+
+static char const * const manifestPrefix = "manifest";
 
 static char const * const statePrefix[NUM_FILETYPES] = {
     "balances",
@@ -60,6 +69,7 @@ static char const * const statePrefix[NUM_FILETYPES] = {
     "globals",
     "crowdsales",
     "mdexorders",
+    "freeze",
 };
 
 static bool is_state_prefix(std::string const &str)
@@ -70,112 +80,172 @@ static bool is_state_prefix(std::string const &str)
         }
     }
 
-    return false;
+    return boost::equals(str, manifestPrefix);
 }
 
-static int write_msc_balances(std::ofstream& file, CHash256& hasher)
+static fs::path get_manifest_path(const uint256& blockHash)
 {
-    std::unordered_map<std::string, CMPTally>::iterator iter;
-    for (iter = mp_tally_map.begin(); iter != mp_tally_map.end(); ++iter) {
-        bool emptyWallet = true;
+    return pathStateFiles / strprintf("%s-%s.dat", manifestPrefix, blockHash.ToString());
+}
 
-        std::string lineOut = (*iter).first;
-        lineOut.append("=");
-        CMPTally& curAddr = (*iter).second;
-        curAddr.init();
-        uint32_t propertyId = 0;
-        while (0 != (propertyId = curAddr.next())) {
-            int64_t balance = (*iter).second.getMoney(propertyId, BALANCE);
-            int64_t sellReserved = (*iter).second.getMoney(propertyId, SELLOFFER_RESERVE);
-            int64_t acceptReserved = (*iter).second.getMoney(propertyId, ACCEPT_RESERVE);
-            int64_t metadexReserved = (*iter).second.getMoney(propertyId, METADEX_RESERVE);
+/** Returns the path, under which a file is written, before it's moved to its final path. */
+static fs::path get_temp_path(const fs::path& path)
+{
+    fs::path pathTemp = path;
+    pathTemp += ".tmp";
+    return pathTemp;
+}
 
-            // we don't allow 0 balances to read in, so if we don't write them
-            // it makes things match up better between persisted state and processed state
-            if (0 == balance && 0 == sellReserved && 0 == acceptReserved && 0 == metadexReserved) {
-                continue;
-            }
+/**
+ * Checks whether the state files of a block exist with the sizes and hashes listed in its manifest.
+ *
+ * The files themselves are not hashed, so that the latest complete state can be found quickly.
+ */
+static bool check_manifest(const uint256& blockHash)
+{
+    CMappedStateFile mapped(get_manifest_path(blockHash));
+    if (!mapped.IsOpen()) return false;
 
-            emptyWallet = false;
+    CStateFileReader reader(mapped.data(), mapped.size());
+    if (!reader.IsValid() || reader.GetType() != FILETYPE_MANIFEST) return false;
 
-            lineOut.append(strprintf("%d:%d,%d,%d,%d;",
-                    propertyId,
-                    balance,
-                    sellReserved,
-                    acceptReserved,
-                    metadexReserved));
+    int nFiles = 0;
+    while (!reader.AtEnd()) {
+        uint8_t nType;
+        uint64_t nSize;
+        uint256 hash;
+        if (!reader.ReadRecord(nType, VARINT(nSize), hash) || nType >= NUM_FILETYPES) return false;
+
+        // the hash of the content is stored at the end of each state file
+        CMappedStateFile file(pathStateFiles / strprintf("%s-%s.dat", statePrefix[nType], blockHash.ToString()));
+        if (!file.IsOpen() || file.size() != nSize || nSize < hash.size()) return false;
+        if (memcmp(file.data() + nSize - hash.size(), hash.begin(), hash.size()) != 0) return false;
+        ++nFiles;
+    }
+
+    return nFiles == NUM_FILETYPES;
+}
+
+/** Balances of one property of an address, as stored in the balances state file. */
+struct CBalanceRecord
+{
+    uint32_t propertyId;
+    int64_t balance;
+    int64_t sellReserved;
+    int64_t acceptReserved;
+    int64_t metadexReserved;
+
+    SERIALIZE_METHODS(CBalanceRecord, obj)
+    {
+        READWRITE(VARINT(obj.propertyId), VARAMOUNT(obj.balance), VARAMOUNT(obj.sellReserved),
+                VARAMOUNT(obj.acceptReserved), VARAMOUNT(obj.metadexReserved));
+    }
+};
+
+static void collect_balances(const CMPTally& curAddr, std::vector<CBalanceRecord>& vBalances)
+{
+    vBalances.clear();
+    for (uint32_t propertyId : curAddr) {
+        CBalanceRecord record;
+        record.propertyId = propertyId;
+        record.balance = curAddr.getMoney(propertyId, BALANCE);
+        record.sellReserved = curAddr.getMoney(propertyId, SELLOFFER_RESERVE);
+        record.acceptReserved = curAddr.getMoney(propertyId, ACCEPT_RESERVE);
+        record.metadexReserved = curAddr.getMoney(propertyId, METADEX_RESERVE);
+
+        // we don't allow 0 balances to read in, so if we don't write them
+        // it makes things match up better between persisted state and processed state
+        if (0 == record.balance && 0 == record.sellReserved && 0 == record.acceptReserved && 0 == record.metadexReserved) {
+            continue;
         }
 
-        if (false == emptyWallet) {
-            // add the line to the hash
-            hasher.Write((unsigned char*)lineOut.c_str(), lineOut.length());
+        vBalances.push_back(record);
+    }
+}
+
+static int write_msc_balances(CStateFileWriter& writer)
+{
+    std::vector<CBalanceRecord> vBalances;
+    for (const auto& entry : mp_tally_map) {
+        collect_balances(entry.second, vBalances);
 
-            // write the line
-            file << lineOut << std::endl;
+        if (!vBalances.empty()) {
+            writer.WriteRecord(entry.first, vBalances);
         }
     }
 
     return 0;
 }
 
-static int write_mp_offers(std::ofstream& file, CHash256& hasher)
+/**
+ * Writes the balances of the addresses, which were modified since the state of the base block.
+ *
+ * The first record is the hash of the base block, followed by the complete balances of every
+ * modified address, which may be empty, if all balances of the address are zero now.
+ */
+static int write_msc_balances_delta(CStateFileWriter& writer, const uint256& hashBase, const std::vector<uint32_t>& vModified)
+{
+    writer.WriteRecord(hashBase);
+
+    std::vector<CBalanceRecord> vBalances;
+    for (uint32_t id : vModified) {
+        collect_balances(*mp_tally_map.Get(id), vBalances);
+        writer.WriteRecord(mp_tally_map.GetAddress(id), vBalances);
+    }
+
+    return 0;
+}
+
+static int write_mp_offers(CStateFileWriter& writer)
 {
     OfferMap::const_iterator iter;
     for (iter = my_offers.begin(); iter != my_offers.end(); ++iter) {
-        // decompose the key for address
-        std::vector<std::string> vstr;
-        boost::split(vstr, iter->first, boost::is_any_of("-"), boost::token_compress_on);
         const CMPOffer& offer = iter->second;
-        offer.saveOffer(file, vstr[0], hasher);
+        offer.saveOffer(writer, iter->first.seller);
     }
 
     return 0;
 }
 
-static int write_mp_accepts(std::ofstream& file, CHash256& hasher)
+static int write_mp_accepts(CStateFileWriter& writer)
 {
-    AcceptMap::const_iterator iter;
-    for (iter = my_accepts.begin(); iter != my_accepts.end(); ++iter) {
-        // decompose the key for address
-        std::vector<std::string> vstr;
-        boost::split(vstr, iter->first, boost::is_any_of("-+"), boost::token_compress_on);
-        const CMPAccept& accept = iter->second;
-        accept.saveAccept(file, vstr[0], vstr[2], hasher);
+    // the accepts are hashed, so they are written in the order of their keys, which is deterministic
+    for (const CDExAcceptKey& key : my_accepts.GetKeys()) {
+        const CMPAccept& accept = my_accepts.find(key)->second;
+        accept.saveAccept(writer, key.seller, key.buyer);
     }
 
     return 0;
 }
 
-static int write_globals_state(std::ofstream& file, CHash256& hasher)
+static int write_globals_state(CStateFileWriter& writer)
 {
     uint32_t nextSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_MSC);
     uint32_t nextTestSPID = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_TMSC);
-    std::string lineOut = strprintf("%d,%d,%d",
-            exodus_prev,
-            nextSPID,
-            nextTestSPID);
+    writer.WriteRecord(VARAMOUNT(exodus_prev), VARINT(nextSPID), VARINT(nextTestSPID));
 
-    // add the line to the hash
-    hasher.Write((unsigned char*)lineOut.c_str(), lineOut.length());
+    return 0;
+}
 
-    // write the line
-    file << lineOut << std::endl;
+static int write_freeze_state(CStateFileWriter& writer)
+{
+    writer.WriteRecord(GetFreezingEnabledProperties(), GetFrozenAddresses());
 
     return 0;
 }
 
-static int write_mp_crowdsales(std::ofstream& file, CHash256& hasher)
+static int write_mp_crowdsales(CStateFileWriter& writer)
 {
     for (CrowdMap::const_iterator it = my_crowds.begin(); it != my_crowds.end(); ++it) {
         // decompose the key for address
         const CMPCrowd& crowd = it->second;
-        crowd.saveCrowdSale(file, it->first, hasher);
+        crowd.saveCrowdSale(writer, it->first);
     }
 
     return 0;
 }
 
-static int write_mp_metadex(std::ofstream &file, CHash256& hasher)
+static int write_mp_metadex(CStateFileWriter& writer)
 {
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
         md_PricesMap& prices = my_it->second;
@@ -183,7 +253,7 @@ static int write_mp_metadex(std::ofstream &file, CHash256& hasher)
             md_Set& indexes = (it->second);
             for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
                 const CMPMetaDEx& meta = *it;
-                meta.saveOffer(file, hasher);
+                meta.saveOffer(writer);
             }
         }
     }
@@ -191,6 +261,9 @@ static int write_mp_metadex(std::ofstream &file, CHash256& hasher)
     return 0;
 }
 
+//! Inserts the restored orders, which are sorted like the MetaDEx maps, with hinted insertions
+static CMetaDExLoader metadexLoader;
+
 static int input_msc_balances_string(const std::string& s)
 {
     // "address=propertybalancedata"
@@ -198,7 +271,7 @@ static int input_msc_balances_string(const std::string& s)
     boost::split(addrData, s, boost::is_any_of("="), boost::token_compress_on);
     if (addrData.size() != 2) return -1;
 
-    std::string strAddress = addrData[0];
+    const uint32_t addressId = mp_tally_map.AddAddress(addrData[0]);
 
     // split the tuples of properties
     std::vector<std::string> vProperties;
@@ -227,10 +300,10 @@ static int input_msc_balances_string(const std::string& s)
         int64_t acceptReserved = boost::lexical_cast<int64_t>(curBalance[2]);
         int64_t metadexReserved = boost::lexical_cast<int64_t>(curBalance[3]);
 
-        if (balance) update_tally_map(strAddress, propertyId, balance, BALANCE);
-        if (sellReserved) update_tally_map(strAddress, propertyId, sellReserved, SELLOFFER_RESERVE);
-        if (acceptReserved) update_tally_map(strAddress, propertyId, acceptReserved, ACCEPT_RESERVE);
-        if (metadexReserved) update_tally_map(strAddress, propertyId, metadexReserved, METADEX_RESERVE);
+        if (balance) update_tally_map(addressId, propertyId, balance, BALANCE);
+        if (sellReserved) update_tally_map(addressId, propertyId, sellReserved, SELLOFFER_RESERVE);
+        if (acceptReserved) update_tally_map(addressId, propertyId, acceptReserved, ACCEPT_RESERVE);
+        if (metadexReserved) update_tally_map(addressId, propertyId, metadexReserved, METADEX_RESERVE);
     }
 
     return 0;
@@ -260,7 +333,7 @@ static int input_mp_offers_string(const std::string& s)
     // TODO: should this be here? There are usually no sanity checks..
     if (OMNI_PROPERTY_BTC != prop_desired) return -1;
 
-    const std::string combo = STR_SELLOFFER_ADDR_PROP_COMBO(sellerAddr, prop);
+    const CDExOfferKey combo(sellerAddr, prop);
     CMPOffer newOffer(offerBlock, amountOriginal, prop, btcDesired, minFee, blocktimelimit, txid);
 
     if (!my_offers.insert(std::make_pair(combo, newOffer)).second) return -1;
@@ -295,7 +368,7 @@ static int input_mp_accepts_string(const std::string& s)
     btcDesired = boost::lexical_cast<int64_t>(vstr[i++]);
     txidStr = vstr[i++];
 
-    const std::string combo = STR_ACCEPT_ADDR_PROP_ADDR_COMBO(sellerAddr, buyerAddr, prop);
+    const CDExAcceptKey combo(sellerAddr, prop, buyerAddr);
     CMPAccept newAccept(amountOriginal, amountRemaining, nBlock, blocktimelimit, prop, offerOriginal, btcDesired, uint256S(txidStr));
     if (my_accepts.insert(std::make_pair(combo, newAccept)).second) {
         return 0;
@@ -394,64 +467,295 @@ static int input_mp_mdexorder_string(const std::string& s)
     CMPMetaDEx mdexObj(addr, block, property, amount_forsale, desired_property,
             amount_desired, txid, idx, subaction, amount_remaining);
 
-    if (!MetaDEx_INSERT(mdexObj)) return -1;
+    if (!metadexLoader.Insert(mdexObj)) return -1;
 
     return 0;
 }
 
-static int write_state_file(const CBlockIndex* pBlockIndex, int what)
+static int input_msc_balances_record(CStateFileReader& reader)
 {
-    fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[what], pBlockIndex->GetBlockHash().ToString());
-    const std::string strFile = path.string();
+    std::string address;
+    std::vector<CBalanceRecord> vBalances;
+    if (!reader.ReadRecord(address, vBalances)) return -1;
 
-    std::ofstream file;
-    file.open(strFile.c_str());
+    const uint32_t addressId = mp_tally_map.AddAddress(address);
 
-    CHash256 hasher;
+    for (const CBalanceRecord& record : vBalances) {
+        if (record.balance) update_tally_map(addressId, record.propertyId, record.balance, BALANCE);
+        if (record.sellReserved) update_tally_map(addressId, record.propertyId, record.sellReserved, SELLOFFER_RESERVE);
+        if (record.acceptReserved) update_tally_map(addressId, record.propertyId, record.acceptReserved, ACCEPT_RESERVE);
+        if (record.metadexReserved) update_tally_map(addressId, record.propertyId, record.metadexReserved, METADEX_RESERVE);
+    }
+
+    return 0;
+}
+
+//! Maximum number of threads to decode the balances, when the state is loaded
+static const int MAX_STATE_LOAD_THREADS = 8;
+
+/** The balances of one address, as decoded from the balances file. */
+typedef std::pair<std::string, std::vector<CBalanceRecord> > CBalanceEntry;
+
+/**
+ * Loads the complete balances from a state file.
+ *
+ * The records are decoded in parallel parts, while the hash of the file is
+ * verified, and then added to the tally map in the order of the file.
+ */
+static int input_msc_balances_parallel(CStateFileReader& reader, const CMappedStateFile& mapped, int& nRecords)
+{
+    CWorkerPool& pool = GetWorkerPool();
+    const int nThreads = std::min<int>(pool.Size() + 1, MAX_STATE_LOAD_THREADS);
+    std::vector<CStateFileReader> vParts;
+    if (!reader.Split(nThreads, vParts)) return -1;
+
+    // the first task verifies the hash, the others decode one part each
+    std::vector<std::vector<CBalanceEntry> > vDecoded(vParts.size());
+    std::vector<char> vSuccess(vParts.size() + 1, false);
+    pool.ForEach(vParts.size() + 1, [&](size_t n) {
+        if (n == 0) {
+            vSuccess[0] = CStateFileReader::VerifyHash(mapped.data(), mapped.size());
+            return;
+        }
+        CStateFileReader& part = vParts[n - 1];
+        std::vector<CBalanceEntry>& vEntries = vDecoded[n - 1];
+        while (!part.AtEnd()) {
+            vEntries.emplace_back();
+            if (!part.ReadRecord(vEntries.back().first, vEntries.back().second)) return;
+        }
+        vSuccess[n] = true;
+    });
+
+    for (char fSuccess : vSuccess) {
+        if (!fSuccess) return -1;
+    }
+
+    // every record is one address, so the index of the addresses is sized once
+    size_t nAddresses = 0;
+    for (const std::vector<CBalanceEntry>& vEntries : vDecoded) {
+        nAddresses += vEntries.size();
+    }
+    mp_tally_map.Reserve(mp_tally_map.size() + nAddresses);
+
+    for (const std::vector<CBalanceEntry>& vEntries : vDecoded) {
+        for (const CBalanceEntry& entry : vEntries) {
+            const uint32_t addressId = mp_tally_map.AddAddress(entry.first);
+            for (const CBalanceRecord& record : entry.second) {
+                if (record.balance) update_tally_map(addressId, record.propertyId, record.balance, BALANCE);
+                if (record.sellReserved) update_tally_map(addressId, record.propertyId, record.sellReserved, SELLOFFER_RESERVE);
+                if (record.acceptReserved) update_tally_map(addressId, record.propertyId, record.acceptReserved, ACCEPT_RESERVE);
+                if (record.metadexReserved) update_tally_map(addressId, record.propertyId, record.metadexReserved, METADEX_RESERVE);
+            }
+            ++nRecords;
+        }
+    }
+
+    return 0;
+}
+
+static int input_msc_balances_delta_record(CStateFileReader& reader)
+{
+    std::string address;
+    std::vector<CBalanceRecord> vBalances;
+    if (!reader.ReadRecord(address, vBalances)) return -1;
+
+    const uint32_t addressId = mp_tally_map.AddAddress(address);
+
+    // the balances of the address replace the ones of the base
+    const CMPTally& tally = *mp_tally_map.Get(addressId);
+    std::vector<uint32_t> vProperties;
+    for (uint32_t propertyId : tally) {
+        vProperties.push_back(propertyId);
+    }
+    for (uint32_t propertyId : vProperties) {
+        for (int n = 0; n < TALLY_TYPE_COUNT; ++n) {
+            TallyType ttype = static_cast<TallyType>(n);
+            if (ttype == PENDING) continue;
+            int64_t amount = tally.getMoney(propertyId, ttype);
+            if (amount && !update_tally_map(addressId, propertyId, -amount, ttype)) return -1;
+        }
+    }
+
+    for (const CBalanceRecord& record : vBalances) {
+        if (record.balance) update_tally_map(addressId, record.propertyId, record.balance, BALANCE);
+        if (record.sellReserved) update_tally_map(addressId, record.propertyId, record.sellReserved, SELLOFFER_RESERVE);
+        if (record.acceptReserved) update_tally_map(addressId, record.propertyId, record.acceptReserved, ACCEPT_RESERVE);
+        if (record.metadexReserved) update_tally_map(addressId, record.propertyId, record.metadexReserved, METADEX_RESERVE);
+    }
+
+    return 0;
+}
+
+static int input_mp_offers_record(CStateFileReader& reader)
+{
+    std::string sellerAddr;
+    int offerBlock;
+    int64_t amountOriginal, btcDesired, minFee;
+    uint32_t prop;
+    uint8_t blocktimelimit;
+    uint256 txid;
+
+    if (!reader.ReadRecord(sellerAddr, VARBLOCK(offerBlock), VARAMOUNT(amountOriginal), VARINT(prop),
+            VARAMOUNT(btcDesired), VARAMOUNT(minFee), blocktimelimit, txid)) return -1;
+
+    const CDExOfferKey combo(sellerAddr, prop);
+    CMPOffer newOffer(offerBlock, amountOriginal, prop, btcDesired, minFee, blocktimelimit, txid);
+
+    // the offers are persisted in the order of the map, so each one is appended
+    const size_t nOffers = my_offers.size();
+    my_offers.emplace_hint(my_offers.end(), combo, newOffer);
+    if (my_offers.size() == nOffers) return -1;
+
+    return 0;
+}
+
+static int input_mp_accepts_record(CStateFileReader& reader)
+{
+    std::string sellerAddr, buyerAddr;
+    uint32_t prop;
+    int nBlock;
+    int64_t amountRemaining, amountOriginal, offerOriginal, btcDesired;
+    uint8_t blocktimelimit;
+    uint256 txid;
+
+    if (!reader.ReadRecord(sellerAddr, VARINT(prop), buyerAddr, VARBLOCK(nBlock), VARAMOUNT(amountRemaining),
+            VARAMOUNT(amountOriginal), blocktimelimit, VARAMOUNT(offerOriginal), VARAMOUNT(btcDesired), txid)) return -1;
+
+    const CDExAcceptKey combo(sellerAddr, prop, buyerAddr);
+    CMPAccept newAccept(amountOriginal, amountRemaining, nBlock, blocktimelimit, prop, offerOriginal, btcDesired, txid);
+
+    if (!my_accepts.insert(std::make_pair(combo, newAccept)).second) return -1;
+
+    return 0;
+}
+
+static int input_globals_state_record(CStateFileReader& reader)
+{
+    int64_t exodusPrev;
+    uint32_t nextSPID, nextTestSPID;
+
+    if (!reader.ReadRecord(VARAMOUNT(exodusPrev), VARINT(nextSPID), VARINT(nextTestSPID))) return -1;
 
-    int result = 0;
+    exodus_prev = exodusPrev;
+    pDbSpInfo->init(nextSPID, nextTestSPID);
+    return 0;
+}
+
+static int input_freeze_state_record(CStateFileReader& reader)
+{
+    std::set<std::pair<uint32_t, int> > enabledProperties;
+    std::set<std::pair<std::string, uint32_t> > frozenAddresses;
+
+    if (!reader.ReadRecord(enabledProperties, frozenAddresses)) return -1;
+
+    RestoreFreezeState(enabledProperties, frozenAddresses);
+    return 0;
+}
+
+static int input_mp_crowdsale_record(CStateFileReader& reader)
+{
+    std::string sellerAddr;
+    uint32_t propertyId, property_desired;
+    int64_t nValue, deadline, u_created, i_created;
+    uint8_t early_bird, percentage;
+    std::map<uint256, std::vector<int64_t> > txFundraiserData;
+
+    if (!reader.ReadRecord(sellerAddr, VARINT(propertyId), VARAMOUNT(nValue), VARINT(property_desired), VARAMOUNT(deadline),
+            early_bird, percentage, VARAMOUNT(u_created), VARAMOUNT(i_created), txFundraiserData)) return -1;
+
+    CMPCrowd newCrowdsale(propertyId, nValue, property_desired, deadline, early_bird, percentage, u_created, i_created);
+    for (const auto& entry : txFundraiserData) {
+        newCrowdsale.insertDatabase(entry.first, entry.second);
+    }
+
+    if (!my_crowds.insert(std::make_pair(sellerAddr, newCrowdsale)).second) return -1;
+
+    return 0;
+}
+
+static int input_mp_mdexorder_record(CStateFileReader& reader)
+{
+    std::string addr;
+    int block;
+    int64_t amount_forsale, amount_desired, amount_remaining;
+    uint32_t property, desired_property;
+    uint8_t subaction;
+    unsigned int idx;
+    uint256 txid;
+
+    if (!reader.ReadRecord(addr, VARBLOCK(block), VARAMOUNT(amount_forsale), VARINT(property), VARAMOUNT(amount_desired),
+            VARINT(desired_property), subaction, VARINT(idx), txid, VARAMOUNT(amount_remaining))) return -1;
+
+    CMPMetaDEx mdexObj(addr, block, property, amount_forsale, desired_property,
+            amount_desired, txid, idx, subaction, amount_remaining);
+
+    if (!metadexLoader.Insert(mdexObj)) return -1;
+
+    return 0;
+}
+
+static std::vector<unsigned char> build_state_file(int what)
+{
+    CStateFileWriter writer(what);
 
     switch (what) {
         case FILETYPE_BALANCES:
-            result = write_msc_balances(file, hasher);
+            write_msc_balances(writer);
             break;
 
         case FILETYPE_OFFERS:
-            result = write_mp_offers(file, hasher);
+            write_mp_offers(writer);
             break;
 
         case FILETYPE_ACCEPTS:
-            result = write_mp_accepts(file, hasher);
+            write_mp_accepts(writer);
             break;
 
         case FILETYPE_GLOBALS:
-            result = write_globals_state(file, hasher);
+            write_globals_state(writer);
             break;
 
         case FILETYPE_CROWDSALES:
-            result = write_mp_crowdsales(file, hasher);
+            write_mp_crowdsales(writer);
             break;
 
         case FILETYPE_MDEXORDERS:
-            result = write_mp_metadex(file, hasher);
+            write_mp_metadex(writer);
             break;
-    }
 
-    // generate and write the double hash of all the contents written
-    uint256 hash;
-    hasher.Finalize(hash.begin());
-    file << "!" << hash.ToString() << std::endl;
+        case FILETYPE_FREEZE:
+            write_freeze_state(writer);
+            break;
+    }
 
-    file.flush();
-    file.close();
-    return result;
+    // the records and the double hash of all the contents
+    return writer.GetContent();
 }
 
-static void prune_state_files(const CBlockIndex* topIndex)
+/**
+ * @return The number of blocks, after which the state files hold the full balances again.
+ */
+static int GetStateBaseInterval()
 {
-    // build a set of blockHashes for which we have any state files
-    std::set<uint256> statefulBlockHashes;
+    int nInterval = gArgs.GetArg("-omnistatebaseinterval", DEFAULT_STATE_BASE_INTERVAL);
+    return std::max(0, std::min(nInterval, MAX_STATE_HISTORY));
+}
+
+//! The stored states since the last one with the full balances, by height, which the next delta refers to
+static std::vector<std::pair<int, uint256> > vDeltaChain;
 
+//! Heights of the stored states by block hash, as far as known to this process, or -1, if the block isn't known
+static std::map<uint256, int> mapPersistedBlocks;
+
+/**
+ * Scans the persistence directory for the stored states, and looks up the heights of their blocks.
+ *
+ * The heights are looked up before cs_tally is locked, so the stored states can be
+ * pruned without acquiring cs_main, while the state is persisted.
+ */
+void ScanStoredStates()
+{
+    std::set<uint256> setBlocks;
     fs::directory_iterator dIter(pathStateFiles);
     fs::directory_iterator endIter;
     for (; dIter != endIter; ++dIter) {
@@ -469,39 +773,271 @@ static void prune_state_files(const CBlockIndex* topIndex)
                 boost::equals(vstr[2], "dat")) {
             uint256 blockHash;
             blockHash.SetHex(vstr[1]);
-            statefulBlockHashes.insert(blockHash);
+            setBlocks.insert(blockHash);
         } else {
             PrintToLog("None state file found in persistence directory : %s\n", fName);
         }
     }
 
-    // for each blockHash in the set, determine the distance from the given block
-    std::set<uint256>::const_iterator iter;
-    for (iter = statefulBlockHashes.begin(); iter != statefulBlockHashes.end(); ++iter) {
-        // look up the CBlockIndex for height info
-        CBlockIndex const *curIndex = GetBlockIndex(*iter);
+    std::map<uint256, int> mapBlocks;
+    for (const uint256& blockHash : setBlocks) {
+        const CBlockIndex* pBlockIndex = GetBlockIndex(blockHash);
+        mapBlocks.emplace(blockHash, pBlockIndex ? pBlockIndex->nHeight : -1);
+    }
+
+    LOCK(cs_tally);
+    // states stored in the meantime are already tracked
+    mapPersistedBlocks.insert(mapBlocks.begin(), mapBlocks.end());
+}
+
+/**
+ * Determines the stored states, which are no longer needed, once the state of the given block is stored.
+ */
+static std::vector<uint256> select_prunable_states(const CBlockIndex* topIndex)
+{
+    std::vector<uint256> vPrunable;
+
+    // the states older than the history may still be the base of newer deltas
+    const int nMaxHistory = MAX_STATE_HISTORY + GetStateBaseInterval();
+
+    std::set<uint256> setDeltaChain;
+    for (const auto& entry : vDeltaChain) {
+        setDeltaChain.insert(entry.second);
+    }
+
+    // for each blockHash in the map, determine the distance from the given block
+    std::map<uint256, int>::iterator iter = mapPersistedBlocks.begin();
+    while (iter != mapPersistedBlocks.end()) {
+        if (iter->first == topIndex->GetBlockHash() || setDeltaChain.count(iter->first)) {
+            ++iter;
+            continue;
+        }
+
+        // the height was recorded, when the state was stored, or when the directory was scanned
+        const int nHeight = iter->second;
 
         // if we have nothing int the index, or this block is too old..
-        if (nullptr == curIndex || (((topIndex->nHeight - curIndex->nHeight) > MAX_STATE_HISTORY)
-                && (curIndex->nHeight % STORE_EVERY_N_BLOCK != 0))) {
-            if (msc_debug_persistence) {
-                if (curIndex) {
-                    PrintToLog("State from Block:%s is no longer need, removing files (age-from-tip: %d)\n", (*iter).ToString(), topIndex->nHeight - curIndex->nHeight);
+        if (nHeight < 0 || (((topIndex->nHeight - nHeight) > nMaxHistory)
+                && (nHeight % STORE_EVERY_N_BLOCK != 0))) {
+            if (OMNI_VERBOSE_LOG && msc_debug_persistence) {
+                if (nHeight >= 0) {
+                    PrintToLog("State from Block:%s is no longer need, removing files (age-from-tip: %d)\n", iter->first.ToString(), topIndex->nHeight - nHeight);
                 } else {
-                    PrintToLog("State from Block:%s is no longer need, removing files (not in index)\n", (*iter).ToString());
+                    PrintToLog("State from Block:%s is no longer need, removing files (not in index)\n", iter->first.ToString());
                 }
             }
 
-            // destroy the associated files!
-            std::string strBlockHash = iter->ToString();
-            for (int i = 0; i < NUM_FILETYPES; ++i) {
-                fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[i], strBlockHash);
-                fs::remove(path);
-            }
+            vPrunable.push_back(iter->first);
+            iter = mapPersistedBlocks.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    mapPersistedBlocks[topIndex->GetBlockHash()] = topIndex->nHeight;
+
+    return vPrunable;
+}
+
+/** The serialized state of one block, which is written to disk. */
+struct CPersistJob
+{
+    uint256 blockHash;
+    //! The state files and their content
+    std::vector<std::pair<fs::path, std::vector<unsigned char> > > vFiles;
+    //! Blocks, whose state files are removed, after the new ones were written
+    std::vector<uint256> vPruned;
+    //! Whether the state files are compressed, before they are written
+    bool fCompress = false;
+};
+
+/**
+ * Builds the manifest of a state, which holds the type, size and hash of each of its files.
+ */
+static std::vector<unsigned char> build_manifest(const CPersistJob& job)
+{
+    CStateFileWriter writer(FILETYPE_MANIFEST);
+    for (size_t i = 0; i < job.vFiles.size(); ++i) {
+        const std::vector<unsigned char>& vch = job.vFiles[i].second;
+        uint8_t nType = i;
+        uint64_t nSize = vch.size();
+        uint256 hash;
+        memcpy(hash.begin(), vch.data() + vch.size() - hash.size(), hash.size());
+        writer.WriteRecord(nType, VARINT(nSize), hash);
+    }
+
+    return writer.GetContent();
+}
+
+/**
+ * Writes the state files of a block, so that a crash never leaves a partial state behind.
+ *
+ * The files are written under temporary names, and moved to their final paths, once
+ * all of them are on disk. The manifest is written last, and marks the state as complete.
+ */
+static bool write_persist_job(CPersistJob& job)
+{
+    const fs::path pathManifest = get_manifest_path(job.blockHash);
+    // the state of the block may be written again after a reorganization
+    fs::remove(pathManifest);
+
+    // the files are compressed by the writer, so block processing doesn't wait for it
+    if (job.fCompress) {
+        for (auto& file : job.vFiles) {
+            file.second = CompressStateFile(file.second);
+        }
+    }
+
+    for (const auto& file : job.vFiles) {
+        if (!CStateFileWriter::WriteToFile(get_temp_path(file.first), file.second)) {
+            PrintToLog("%s(): failed to write %s\n", __func__, file.first.string());
+            return false;
+        }
+    }
+    for (const auto& file : job.vFiles) {
+        if (!RenameOver(get_temp_path(file.first), file.first)) {
+            PrintToLog("%s(): failed to rename %s\n", __func__, file.first.string());
+            return false;
+        }
+    }
+    if (!SyncStateDirectory(pathStateFiles)) {
+        PrintToLog("%s(): failed to flush %s\n", __func__, pathStateFiles.string());
+        return false;
+    }
+
+    if (!CStateFileWriter::WriteToFile(get_temp_path(pathManifest), build_manifest(job)) ||
+            !RenameOver(get_temp_path(pathManifest), pathManifest) || !SyncStateDirectory(pathStateFiles)) {
+        PrintToLog("%s(): failed to write %s\n", __func__, pathManifest.string());
+        return false;
+    }
+
+    // destroy the associated files, the manifest first, so that the state is no longer considered complete
+    for (const uint256& blockHash : job.vPruned) {
+        fs::remove(get_manifest_path(blockHash));
+        std::string strBlockHash = blockHash.ToString();
+        for (int i = 0; i < NUM_FILETYPES; ++i) {
+            fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[i], strBlockHash);
+            fs::remove(path);
+        }
+    }
+
+    return true;
+}
+
+//! Maximum number of states waiting to be written, before block processing waits for the writer
+static const size_t MAX_PENDING_PERSIST_JOBS = 2;
+
+static Mutex cs_persist;
+static std::condition_variable cvPersist;
+//! States waiting to be written by the background thread
+static std::deque<CPersistJob> queuePersist GUARDED_BY(cs_persist);
+//! Whether the background thread is writing a state
+static bool fPersistBusy GUARDED_BY(cs_persist) = false;
+//! Whether a state couldn't be written, so that later deltas can't refer to it
+static bool fPersistFailed GUARDED_BY(cs_persist) = false;
+static bool fPersistStop GUARDED_BY(cs_persist) = false;
+//! Whether the state is written by the background thread
+static bool fPersistAsync GUARDED_BY(cs_persist) = false;
+//! Latest block, whose state was written completely, but which isn't the watermark yet
+static uint256 hashDurable GUARDED_BY(cs_persist);
+static std::thread threadPersist;
+
+/**
+ * Writes the queued states, until the persistence is stopped and all states are written.
+ */
+static void ThreadPersistState()
+{
+    WAIT_LOCK(cs_persist, lock);
+    while (true) {
+        while (!fPersistStop && queuePersist.empty()) {
+            cvPersist.wait(lock);
+        }
+        if (queuePersist.empty()) break;
+
+        CPersistJob job = std::move(queuePersist.front());
+        queuePersist.pop_front();
+        fPersistBusy = true;
+        bool fSuccess;
+        {
+            REVERSE_LOCK(lock);
+            fSuccess = write_persist_job(job);
         }
+        fPersistBusy = false;
+        if (fSuccess) hashDurable = job.blockHash;
+        if (!fSuccess) fPersistFailed = true;
+        cvPersist.notify_all();
     }
 }
 
+/**
+ * Moves the watermark of the SP database to the latest state, which was written completely.
+ *
+ * The SP database isn't touched by the background thread, so this happens during block processing.
+ */
+static void apply_durable_watermark()
+{
+    AssertLockHeld(cs_tally);
+
+    uint256 hash;
+    {
+        LOCK(cs_persist);
+        hash = hashDurable;
+        hashDurable.SetNull();
+    }
+
+    if (!hash.IsNull()) {
+        pDbSpInfo->setWatermark(hash);
+    }
+}
+
+/**
+ * Starts writing the state files in a background thread.
+ */
+void StartStatePersistence()
+{
+    LOCK(cs_persist);
+    if (fPersistAsync) return;
+
+    fPersistStop = false;
+    fPersistAsync = true;
+    threadPersist = std::thread([] {
+        util::ThreadRename("omnipersist");
+        ThreadPersistState();
+    });
+}
+
+/**
+ * Waits until all queued states are written, and moves the watermark accordingly.
+ */
+void FlushStatePersistence()
+{
+    {
+        WAIT_LOCK(cs_persist, lock);
+        while (fPersistBusy || !queuePersist.empty()) {
+            cvPersist.wait(lock);
+        }
+    }
+
+    LOCK(cs_tally);
+    apply_durable_watermark();
+}
+
+/**
+ * Writes the queued states, and stops the background thread.
+ */
+void StopStatePersistence()
+{
+    FlushStatePersistence();
+    {
+        LOCK(cs_persist);
+        if (!fPersistAsync) return;
+        fPersistStop = true;
+        fPersistAsync = false;
+    }
+    cvPersist.notify_all();
+    threadPersist.join();
+}
+
 /**
  * @return The block height at which the state is persisted every block.
  */
@@ -538,19 +1074,84 @@ bool IsPersistenceEnabled(int blockHeight)
 
 /**
  * Stores the in-memory state in files.
+ *
+ * The state is serialized into memory, and written by the background thread, if
+ * it's running. The watermark of the SP database is only moved to a block, after
+ * all state files of the block were written and flushed to disk.
+ *
+ * The balances, which are by far the largest part of the state, are only stored
+ * completely every few blocks. In between only the balances of the addresses,
+ * which were modified since the previously stored state, are stored.
  */
 int PersistInMemoryState(const CBlockIndex* pBlockIndex)
 {
-    // write the new state as of the given block
-    write_state_file(pBlockIndex, FILETYPE_BALANCES);
-    write_state_file(pBlockIndex, FILETYPE_OFFERS);
-    write_state_file(pBlockIndex, FILETYPE_ACCEPTS);
-    write_state_file(pBlockIndex, FILETYPE_GLOBALS);
-    write_state_file(pBlockIndex, FILETYPE_CROWDSALES);
-    write_state_file(pBlockIndex, FILETYPE_MDEXORDERS);
+    AssertLockHeld(cs_tally);
 
-    // clean-up the directory
-    prune_state_files(pBlockIndex);
+    {
+        LOCK(cs_persist);
+        if (fPersistFailed) {
+            vDeltaChain.clear();
+            fPersistFailed = false;
+        }
+    }
+
+    // a delta requires a stored state of an ancestor, which isn't too far away
+    std::vector<uint32_t> vModified;
+    bool fDelta = mp_tally_map.TakeModified(vModified, CMPTallyMap::MODIFIED_PERSISTENCE);
+    const int nInterval = GetStateBaseInterval();
+    if (fDelta) {
+        fDelta = nInterval > 0 && !vDeltaChain.empty()
+                && pBlockIndex->nHeight % STORE_EVERY_N_BLOCK != 0
+                && pBlockIndex->nHeight - vDeltaChain.front().first < nInterval
+                && pBlockIndex->nHeight > vDeltaChain.back().first;
+    }
+    if (fDelta) {
+        const CBlockIndex* pBaseIndex = pBlockIndex->GetAncestor(vDeltaChain.back().first);
+        fDelta = pBaseIndex && pBaseIndex->GetBlockHash() == vDeltaChain.back().second;
+    }
+    if (!fDelta) {
+        vDeltaChain.clear();
+    }
+
+    // serialize the new state as of the given block
+    CPersistJob job;
+    job.blockHash = pBlockIndex->GetBlockHash();
+    job.fCompress = gArgs.GetBoolArg("-omnistatecompression", DEFAULT_STATE_COMPRESSION);
+    for (int i = 0; i < NUM_FILETYPES; ++i) {
+        fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[i], job.blockHash.ToString());
+        if (i == FILETYPE_BALANCES && fDelta) {
+            CStateFileWriter writer(FILETYPE_BALANCES | FILETYPE_DELTA);
+            write_msc_balances_delta(writer, vDeltaChain.back().second, vModified);
+            job.vFiles.emplace_back(path, writer.GetContent());
+        } else {
+            job.vFiles.emplace_back(path, build_state_file(i));
+        }
+    }
+    vDeltaChain.emplace_back(pBlockIndex->nHeight, job.blockHash);
+
+    // clean-up the directory, after the new state is written
+    job.vPruned = select_prunable_states(pBlockIndex);
+
+    // states of previous blocks, which were written in the meantime
+    apply_durable_watermark();
+
+    {
+        WAIT_LOCK(cs_persist, lock);
+        if (fPersistAsync) {
+            // don't let the states pile up, if the disk can't keep up
+            while (queuePersist.size() >= MAX_PENDING_PERSIST_JOBS) {
+                cvPersist.wait(lock);
+            }
+            queuePersist.push_back(std::move(job));
+            cvPersist.notify_all();
+            return 0;
+        }
+    }
+
+    if (!write_persist_job(job)) {
+        vDeltaChain.clear();
+        return -1;
+    }
 
     pDbSpInfo->setWatermark(pBlockIndex->GetBlockHash());
 
@@ -560,36 +1161,47 @@ int PersistInMemoryState(const CBlockIndex* pBlockIndex)
 /**
  * Loads and retrieves state from a file.
  */
-int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash)
-{
-    int lines = 0;
-    int (*inputLineFunc)(const std::string&) = nullptr;
-
-    CHash256 hasher;
+typedef int (*StateLineFunc)(const std::string&);
+typedef int (*StateRecordFunc)(CStateFileReader&);
 
+/**
+ * Clears the in-memory state of a file type, and selects the functions to input its records and legacy lines.
+ *
+ * @return False, if the file type is unknown
+ */
+static bool PrepareStateInput(int what, StateLineFunc& inputLineFunc, StateRecordFunc& inputRecordFunc)
+{
     switch (what) {
         case FILETYPE_BALANCES:
             mp_tally_map.clear();
             inputLineFunc = input_msc_balances_string;
+            inputRecordFunc = input_msc_balances_record;
             break;
 
         case FILETYPE_OFFERS:
             my_offers.clear();
+            InvalidateStateCommitment();
             inputLineFunc = input_mp_offers_string;
+            inputRecordFunc = input_mp_offers_record;
             break;
 
         case FILETYPE_ACCEPTS:
             my_accepts.clear();
+            InvalidateStateCommitment();
             inputLineFunc = input_mp_accepts_string;
+            inputRecordFunc = input_mp_accepts_record;
             break;
 
         case FILETYPE_GLOBALS:
             inputLineFunc = input_globals_state_string;
+            inputRecordFunc = input_globals_state_record;
             break;
 
         case FILETYPE_CROWDSALES:
             my_crowds.clear();
+            InvalidateStateCommitment();
             inputLineFunc = input_mp_crowdsale_string;
+            inputRecordFunc = input_mp_crowdsale_record;
             break;
 
         case FILETYPE_MDEXORDERS:
@@ -597,19 +1209,125 @@ int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash)
             // memory leak ... gotta unallocate inner layers first....
             // TODO
             // ...
-            metadex.clear();
+            MetaDEx_CLEAR();
+            metadexLoader = CMetaDExLoader();
             inputLineFunc = input_mp_mdexorder_string;
+            inputRecordFunc = input_mp_mdexorder_record;
+            break;
+
+        case FILETYPE_FREEZE:
+            ClearFreezeState();
+            inputRecordFunc = input_freeze_state_record;
             break;
 
         default:
-            return -1;
+            return false;
     }
 
-    if (msc_debug_persistence) {
+    return true;
+}
+
+/**
+ * Presizes the hashed containers of a file type for the number of records of a state file.
+ *
+ * The complete balances are sized, once they are decoded, and the sorted containers are
+ * built with hinted insertions instead.
+ */
+static void PresizeStateInput(int what, uint64_t nRecords)
+{
+    if (nRecords == 0) return;
+
+    switch (what) {
+        case FILETYPE_ACCEPTS:
+            my_accepts.reserve(nRecords);
+            break;
+
+        case FILETYPE_MDEXORDERS:
+            metadexLoader.Reserve(nRecords);
+            break;
+    }
+}
+
+int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash)
+{
+    int lines = 0;
+    StateLineFunc inputLineFunc = nullptr;
+    StateRecordFunc inputRecordFunc = nullptr;
+
+    CHash256 hasher;
+
+    if (!PrepareStateInput(what, inputLineFunc, inputRecordFunc)) return -1;
+
+    if (OMNI_VERBOSE_LOG && msc_debug_persistence) {
         LogPrintf("Loading %s ... \n", filename);
         PrintToLog("%s(%s), line %d, file: %s\n", __FUNCTION__, filename, __LINE__, __FILE__);
     }
 
+    // map the file into memory, and decode the records in place
+    CMappedStateFile mapped(filename);
+    if (!mapped.IsOpen()) {
+        if (msc_debug_persistence) LogPrintf("%s(%s): file not found, line %d, file: %s\n", __FUNCTION__, filename, __LINE__, __FILE__);
+        return -1;
+    }
+    if (!mapped.Decompress()) {
+        PrintToLog("File %s loaded, but failed to decompress!\n", filename);
+        return -1;
+    }
+
+    int res = 0;
+
+    if (CStateFileReader::IsStateFile(mapped.data(), mapped.size())) {
+        // the hash is always verified, because the header and records can't be trusted otherwise
+        CStateFileReader reader(mapped.data(), mapped.size(), false);
+        const bool fDelta = reader.GetType() == (what | FILETYPE_DELTA) && what == FILETYPE_BALANCES;
+        if (!reader.IsValid() || (reader.GetType() != what && !fDelta)) {
+            PrintToLog("File %s loaded, but failed header validation!\n", filename);
+            res = -1;
+        }
+        if (res == 0 && !fDelta) PresizeStateInput(what, reader.GetRecordCount());
+
+        // the complete balances are by far the largest file, and verified while they are decoded
+        if (res == 0 && what == FILETYPE_BALANCES && !fDelta) {
+            res = input_msc_balances_parallel(reader, mapped, lines);
+            if (res < 0) PrintToLog("File %s loaded, but failed hash validation or decoding!\n", filename);
+        } else if (res == 0 && !CStateFileReader::VerifyHash(mapped.data(), mapped.size())) {
+            PrintToLog("File %s loaded, but failed hash validation!\n", filename);
+            res = -1;
+        }
+
+        // a delta is applied on top of the state of its base, which is loaded first
+        if (res == 0 && fDelta) {
+            uint256 hashBase;
+            if (!reader.ReadRecord(hashBase)) {
+                res = -1;
+            } else {
+                fs::path pathBase = fs::path(filename).parent_path() / strprintf("%s-%s.dat", statePrefix[what], hashBase.ToString());
+                res = RestoreInMemoryState(pathBase.string(), what, verifyHash);
+            }
+            inputRecordFunc = input_msc_balances_delta_record;
+        }
+
+        while (res == 0 && !reader.AtEnd()) {
+            if (inputRecordFunc(reader) < 0) {
+                res = -1;
+                break;
+            }
+
+            ++lines;
+        }
+
+        PrintToLog("%s(%s), loaded records= %d, res= %d\n", __FUNCTION__, filename, lines, res);
+        LogPrintf("%s(): file: %s , loaded records= %d, res= %d\n", __FUNCTION__, filename, lines, res);
+
+        return res;
+    }
+
+    // otherwise parse the legacy text format line by line, which newer file types don't have
+    if (!inputLineFunc) {
+        PrintToLog("File %s loaded, but is not a binary state file!\n", filename);
+        return -1;
+    }
+
     std::ifstream file;
     file.open(filename.c_str());
     if (!file.is_open()) {
@@ -617,8 +1335,6 @@ int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash)
         return -1;
     }
 
-    int res = 0;
-
     std::string fileHash;
     while (file.good()) {
         std::string line;
@@ -668,15 +1384,70 @@ int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash)
     return res;
 }
 
+/**
+ * Returns the content of a state file of the current in-memory state.
+ */
+std::vector<unsigned char> BuildStateFile(int what)
+{
+    return build_state_file(what);
+}
+
+/**
+ * Returns the content of a balances state file, which only holds the balances of the given addresses.
+ */
+std::vector<unsigned char> BuildBalancesDeltaFile(const uint256& hashBase, const std::vector<uint32_t>& vModified)
+{
+    CStateFileWriter writer(FILETYPE_BALANCES | FILETYPE_DELTA);
+    write_msc_balances_delta(writer, hashBase, vModified);
+    return writer.GetContent();
+}
+
+/**
+ * Loads the in-memory state of a file type from the content of a state file.
+ *
+ * Unlike a delta file on disk, a balances delta is applied on top of the current
+ * balances, and the base recorded in it is not loaded.
+ */
+int RestoreInMemoryStateFromBuffer(const std::vector<unsigned char>& vch, int what)
+{
+    CStateFileReader reader(vch);
+    const bool fDelta = reader.GetType() == (what | FILETYPE_DELTA) && what == FILETYPE_BALANCES;
+    if (!reader.IsValid() || (reader.GetType() != what && !fDelta)) return -1;
+
+    StateLineFunc inputLineFunc = nullptr;
+    StateRecordFunc inputRecordFunc = nullptr;
+    if (fDelta) {
+        uint256 hashBase;
+        if (!reader.ReadRecord(hashBase)) return -1;
+        inputRecordFunc = input_msc_balances_delta_record;
+    } else if (!PrepareStateInput(what, inputLineFunc, inputRecordFunc)) {
+        return -1;
+    }
+
+    while (!reader.AtEnd()) {
+        if (inputRecordFunc(reader) < 0) return -1;
+    }
+
+    return 0;
+}
+
 /**
  * Loads and restores the latest state. Returns -1 if reparse is required.
+ *
+ * States persisted by earlier versions don't include the freeze state, which
+ * is then left untouched, and must be loaded from the transactions instead.
+ *
+ * The undo journal must be empty, because the addresses of orders are removed.
  */
-int LoadMostRelevantInMemoryState()
+int LoadMostRelevantInMemoryState(bool& fFreezeStateRestored)
 {
     int res = -1;
+    fFreezeStateRestored = false;
     uint256 spWatermark;
     {
         LOCK(cs_tally);
+        // states, which are still being written, are needed as well
+        FlushStatePersistence();
         PrintToLog("Trying to load most relevant state into memory..\n");
         // check the SP database and roll it back to its latest valid state
         // according to the active chain
@@ -736,6 +1507,7 @@ int LoadMostRelevantInMemoryState()
     }
 
     std::set<uint256> persistedBlocks;
+    std::set<uint256> completeBlocks;
     {
         LOCK2(cs_main, cs_tally);
 
@@ -757,6 +1529,7 @@ int LoadMostRelevantInMemoryState()
 
         // prepare a set of available files by block hash pruning any that are
         // not in the active chain
+        std::vector<fs::path> vTempFiles;
         fs::directory_iterator dIter(pathStateFiles);
         fs::directory_iterator endIter;
         for (; dIter != endIter; ++dIter) {
@@ -765,6 +1538,12 @@ int LoadMostRelevantInMemoryState()
                 continue;
             }
 
+            if (dIter->path().extension() == ".tmp") {
+                // left over from an interrupted write
+                vTempFiles.push_back(dIter->path());
+                continue;
+            }
+
             std::string fName = (*--dIter->path().end()).string();
             std::vector<std::string> vstr;
             boost::split(vstr, fName, boost::is_any_of("-."), boost::token_compress_on);
@@ -779,8 +1558,20 @@ int LoadMostRelevantInMemoryState()
 
                 // this is a valid block in the active chain, store it
                 persistedBlocks.insert(blockHash);
+                if (boost::equals(vstr[0], manifestPrefix)) {
+                    completeBlocks.insert(blockHash);
+                }
             }
         }
+
+        for (const fs::path& path : vTempFiles) {
+            fs::remove(path);
+        }
+
+        // states of earlier versions have no manifest, and are only tried, if there are no others
+        if (!completeBlocks.empty()) {
+            persistedBlocks = completeBlocks;
+        }
     }
 
     {
@@ -796,9 +1587,24 @@ int LoadMostRelevantInMemoryState()
         while (nullptr != curTip && persistedBlocks.size() > 0 && curTip->nHeight > abortRollBackBlock ) {
             if (persistedBlocks.find(curTip->GetBlockHash()) != persistedBlocks.end()) {
                 int success = -1;
-                for (int i = 0; i < NUM_FILETYPES; ++i) {
+                bool fFreezeStateFound = true;
+                // states, whose files don't match the manifest, are skipped without decoding them
+                const bool fComplete = completeBlocks.empty() || check_manifest(curTip->GetBlockHash());
+                if (!fComplete) {
+                    PrintToLog("State files of block %d don't match their manifest\n", curTip->nHeight);
+                }
+                if (fComplete) {
+                    // the undo journal was cleared, so the addresses are interned again by the restored orders
+                    MetaDEx_CLEAR();
+                    MetaDEx_ClearAddresses();
+                }
+                for (int i = 0; fComplete && i < NUM_FILETYPES; ++i) {
                     fs::path path = pathStateFiles / strprintf("%s-%s.dat", statePrefix[i], curTip->GetBlockHash().ToString());
                     const std::string strFile = path.string();
+                    if (i == FILETYPE_FREEZE && !fs::exists(path)) {
+                        fFreezeStateFound = false;
+                        continue;
+                    }
                     success = RestoreInMemoryState(strFile, i, true);
                     if (success < 0) {
                         PrintToConsole("Found a state inconsistency at block height %d. "
@@ -810,6 +1616,7 @@ int LoadMostRelevantInMemoryState()
 
                 if (success >= 0) {
                     res = curTip->nHeight;
+                    fFreezeStateRestored = fFreezeStateFound;
                     break;
                 }
 
@@ -840,3 +1647,133 @@ int LoadMostRelevantInMemoryState()
     // return the height of the block we settled at
     return res;
 }
+
+//! Maximum number of threads to verify the stored states
+static const int MAX_STATE_VERIFY_THREADS = 16;
+
+/**
+ * Verifies a stored state completely, and returns the reason, if it's invalid.
+ *
+ * Other than check_manifest(), the content of every file is hashed, the balances
+ * are decoded, and the base of a balances delta must be a stored state of an
+ * earlier block in the active chain.
+ */
+static std::string verify_stored_state(const uint256& blockHash, int nHeight, const std::map<uint256, int>& mapStored)
+{
+    CMappedStateFile manifest(get_manifest_path(blockHash));
+    if (!manifest.IsOpen()) return "the manifest is missing";
+
+    CStateFileReader reader(manifest.data(), manifest.size());
+    if (!reader.IsValid() || reader.GetType() != FILETYPE_MANIFEST) return "the manifest is invalid";
+
+    std::set<uint8_t> setTypes;
+    while (!reader.AtEnd()) {
+        uint8_t nType;
+        uint64_t nSize;
+        uint256 hash;
+        if (!reader.ReadRecord(nType, VARINT(nSize), hash) || nType >= NUM_FILETYPES) return "the manifest is invalid";
+        setTypes.insert(nType);
+
+        CMappedStateFile file(pathStateFiles / strprintf("%s-%s.dat", statePrefix[nType], blockHash.ToString()));
+        if (!file.IsOpen()) return strprintf("the %s file is missing", statePrefix[nType]);
+        if (file.size() != nSize || nSize < hash.size() || memcmp(file.data() + nSize - hash.size(), hash.begin(), hash.size()) != 0) {
+            return strprintf("the %s file doesn't match the manifest", statePrefix[nType]);
+        }
+        if (!file.Decompress()) return strprintf("the %s file can't be decompressed", statePrefix[nType]);
+
+        CStateFileReader content(file.data(), file.size());
+        if (!content.IsValid() || (content.GetType() & ~FILETYPE_DELTA) != nType) {
+            return strprintf("the content of the %s file is corrupted", statePrefix[nType]);
+        }
+        if (nType != FILETYPE_BALANCES) continue;
+
+        if (content.GetType() & FILETYPE_DELTA) {
+            uint256 hashBase;
+            if (!content.ReadRecord(hashBase)) return "the balances file is malformed";
+            auto it = mapStored.find(hashBase);
+            if (it == mapStored.end() || it->second >= nHeight) {
+                return strprintf("the base %s of the balances is not stored", hashBase.ToString());
+            }
+        }
+        while (!content.AtEnd()) {
+            std::string address;
+            std::vector<CBalanceRecord> vBalances;
+            if (!content.ReadRecord(address, vBalances)) return "the balances file is malformed";
+        }
+    }
+
+    if (setTypes.size() != NUM_FILETYPES) return "the manifest is incomplete";
+
+    return std::string();
+}
+
+/**
+ * Verifies the stored states of the blocks in the active chain.
+ *
+ * Each state is verified independently of the others, so the states are spread
+ * over a pool of threads. States, which are pruned during the verification, are
+ * left out of the results.
+ */
+int VerifyStoredStates(int nThreads, std::vector<CStoredStateCheck>& vChecks)
+{
+    std::map<uint256, int> mapStored;
+    {
+        LOCK(cs_main);
+        fs::directory_iterator dIter(pathStateFiles);
+        fs::directory_iterator endIter;
+        for (; dIter != endIter; ++dIter) {
+            if (false == fs::is_regular_file(dIter->status()) || dIter->path().empty()) {
+                continue;
+            }
+
+            std::string fName = (*--dIter->path().end()).string();
+            std::vector<std::string> vstr;
+            boost::split(vstr, fName, boost::is_any_of("-."), boost::token_compress_on);
+            if (vstr.size() == 3 && boost::equals(vstr[0], manifestPrefix) && boost::equals(vstr[2], "dat")) {
+                uint256 blockHash;
+                blockHash.SetHex(vstr[1]);
+                const CBlockIndex* pBlockIndex = LookupBlockIndex(blockHash);
+                if (pBlockIndex != nullptr && ::ChainActive().Contains(pBlockIndex)) {
+                    mapStored.emplace(blockHash, pBlockIndex->nHeight);
+                }
+            }
+        }
+    }
+
+    vChecks.clear();
+    for (const auto& entry : mapStored) {
+        vChecks.emplace_back();
+        vChecks.back().hashBlock = entry.first;
+        vChecks.back().nBlock = entry.second;
+    }
+    std::sort(vChecks.begin(), vChecks.end(), [](const CStoredStateCheck& a, const CStoredStateCheck& b) {
+        return a.nBlock < b.nBlock;
+    });
+
+    // states, which were not verified before a shutdown, are reported as such
+    std::vector<char> vVerified(vChecks.size(), false);
+    nThreads = std::max(1, std::min(nThreads, MAX_STATE_VERIFY_THREADS));
+    GetWorkerPool().ForEachInterruptible(vChecks.size(), [&](size_t n) {
+        vChecks[n].strError = verify_stored_state(vChecks[n].hashBlock, vChecks[n].nBlock, mapStored);
+        vVerified[n] = true;
+    }, nThreads);
+    for (size_t n = 0; n < vChecks.size(); ++n) {
+        if (!vVerified[n]) vChecks[n].strError = "the verification was interrupted";
+    }
+
+    int nInvalid = 0;
+    std::vector<CStoredStateCheck>::iterator it = vChecks.begin();
+    while (it != vChecks.end()) {
+        if (!it->strError.empty() && !fs::exists(get_manifest_path(it->hashBlock))) {
+            it = vChecks.erase(it);
+            continue;
+        }
+        if (!it->strError.empty()) {
+            PrintToLog("%s(): state of block %d is invalid: %s\n", __func__, it->nBlock, it->strError);
+            ++nInvalid;
+        }
+        ++it;
+    }
+
+    return nInvalid;
+}
@@ -1,21 +1,78 @@
 #ifndef BITCOIN_OMNICORE_PERSISTENCE_H
 #define BITCOIN_OMNICORE_PERSISTENCE_H
 
+#include <uint256.h>
+
 #include <boost/filesystem.hpp>
 
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 class CBlockIndex;
 
+/** Types of the state files, which hold the in-memory state together. */
+enum FILETYPES {
+  FILETYPE_BALANCES = 0,
+  FILETYPE_OFFERS,
+  FILETYPE_ACCEPTS,
+  FILETYPE_GLOBALS,
+  FILETYPE_CROWDSALES,
+  FILETYPE_MDEXORDERS,
+  FILETYPE_FREEZE,
+  NUM_FILETYPES
+};
+
+//! Default number of blocks, after which the state files hold the full balances again, instead of the changes
+static const int DEFAULT_STATE_BASE_INTERVAL = 100;
+//! Default compression of the state files
+static const bool DEFAULT_STATE_COMPRESSION = false;
+
 /** Indicates whether persistence is enabled and the state is stored. */
 bool IsPersistenceEnabled(int blockHeight);
 
 /** Stores the in-memory state in files. */
 int PersistInMemoryState(const CBlockIndex* pBlockIndex);
 
+/** Scans the persistence directory for the stored states, which are pruned, once they are no longer needed. */
+void ScanStoredStates();
+
+/** Starts writing the state files in a background thread. */
+void StartStatePersistence();
+
+/** Waits until all queued states are written, and moves the watermark accordingly. */
+void FlushStatePersistence();
+
+/** Writes the queued states, and stops the background thread. */
+void StopStatePersistence();
+
 /** Loads and retrieves state from a file. */
 int RestoreInMemoryState(const std::string& filename, int what, bool verifyHash = false);
 
+/** Returns the content of a state file of the current in-memory state. */
+std::vector<unsigned char> BuildStateFile(int what);
+
+/** Returns the content of a balances state file, which only holds the balances of the given addresses. */
+std::vector<unsigned char> BuildBalancesDeltaFile(const uint256& hashBase, const std::vector<uint32_t>& vModified);
+
+/** Loads the in-memory state of a file type from the content of a state file, a balances delta updates the current balances. */
+int RestoreInMemoryStateFromBuffer(const std::vector<unsigned char>& vch, int what);
+
 /** Loads and restores the latest state. Returns -1 if reparse is required. */
-int LoadMostRelevantInMemoryState();
+int LoadMostRelevantInMemoryState(bool& fFreezeStateRestored);
+
+/** Result of the verification of a stored state. */
+struct CStoredStateCheck
+{
+    int nBlock;
+    uint256 hashBlock;
+    //! The reason, if the state is invalid, or empty
+    std::string strError;
+
+    CStoredStateCheck() : nBlock(-1) {}
+};
 
+/** Verifies the stored states of the active chain in parallel. Returns the number of invalid states. */
+int VerifyStoredStates(int nThreads, std::vector<CStoredStateCheck>& vChecks);
 
 #endif // BITCOIN_OMNICORE_PERSISTENCE_H
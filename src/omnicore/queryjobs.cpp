@@ -0,0 +1,123 @@
+/**
+ * @file queryjobs.cpp
+ *
+ * This file contains the jobs, which execute long running queries in the
+ * background, and keep their results, until they are read.
+ */
+
+#include <omnicore/queryjobs.h>
+
+#include <omnicore/workerpool.h>
+
+#include <random.h>
+#include <rpc/protocol.h>
+#include <rpc/request.h>
+#include <sync.h>
+#include <uint256.h>
+#include <util/time.h>
+
+#include <univalue.h>
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+CQueryJobStore mastercore::queryJobs;
+
+CQueryJob::CQueryJob(const std::string& strMethodIn, int64_t nTime)
+  : strMethod(strMethodIn), status(QUEUED), nSubmitted(nTime), nStarted(0), nFinished(0), nLastUsed(nTime)
+{
+}
+
+const char* CQueryJob::GetStatusName() const
+{
+    switch (status) {
+        case QUEUED: return "queued";
+        case RUNNING: return "running";
+        case DONE: return "done";
+        case FAILED: return "failed";
+    }
+    return "unknown";
+}
+
+CQueryJobStore::CQueryJobStore(size_t nMaxJobs, int64_t nTimeout, mastercore::CWorkerPool* pPool)
+  : m_nMaxJobs(nMaxJobs), m_nTimeout(nTimeout), m_pPool(pPool)
+{
+}
+
+void CQueryJobStore::Expire(int64_t nTime)
+{
+    for (auto it = m_jobs.begin(); it != m_jobs.end(); ) {
+        const CQueryJob& job = it->second;
+        if ((job.status == CQueryJob::DONE || job.status == CQueryJob::FAILED) && job.nLastUsed + m_nTimeout < nTime) {
+            it = m_jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CQueryJobStore::Run(const uint256& id, const std::function<UniValue()>& fn)
+{
+    {
+        LOCK(m_mutex);
+        auto it = m_jobs.find(id);
+        if (it == m_jobs.end()) return;
+        it->second.status = CQueryJob::RUNNING;
+        it->second.nStarted = GetTime();
+    }
+
+    CQueryJob::Status status = CQueryJob::DONE;
+    std::shared_ptr<const UniValue> result;
+    try {
+        result = std::make_shared<const UniValue>(fn());
+    } catch (const UniValue& objError) {
+        status = CQueryJob::FAILED;
+        result = std::make_shared<const UniValue>(objError);
+    } catch (const std::exception& e) {
+        status = CQueryJob::FAILED;
+        result = std::make_shared<const UniValue>(JSONRPCError(RPC_MISC_ERROR, e.what()));
+    }
+
+    LOCK(m_mutex);
+    auto it = m_jobs.find(id);
+    if (it == m_jobs.end()) return;
+    it->second.status = status;
+    it->second.result = result;
+    it->second.nFinished = GetTime();
+    // the timeout starts, once the result is available
+    it->second.nLastUsed = std::max(it->second.nLastUsed, it->second.nFinished);
+}
+
+uint256 CQueryJobStore::Submit(const std::string& strMethod, const std::function<UniValue()>& fn, int64_t nTime)
+{
+    uint256 id;
+    {
+        LOCK(m_mutex);
+        Expire(nTime);
+        if (m_jobs.size() >= m_nMaxJobs) return uint256();
+
+        id = GetRandHash();
+        m_jobs.emplace(id, CQueryJob(strMethod, nTime));
+    }
+
+    mastercore::CWorkerPool& pool = m_pPool ? *m_pPool : mastercore::GetWorkerPool();
+    pool.Post([this, id, fn] { Run(id, fn); });
+
+    return id;
+}
+
+bool CQueryJobStore::Get(const uint256& id, int64_t nTime, CQueryJob& job)
+{
+    LOCK(m_mutex);
+    Expire(nTime);
+    auto it = m_jobs.find(id);
+    if (it == m_jobs.end()) return false;
+
+    it->second.nLastUsed = nTime;
+    job = it->second;
+    return true;
+}
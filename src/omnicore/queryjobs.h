@@ -0,0 +1,102 @@
+#ifndef BITCOIN_OMNICORE_QUERYJOBS_H
+#define BITCOIN_OMNICORE_QUERYJOBS_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <univalue.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/** Default number of query jobs, which are kept at the same time. */
+static const unsigned int DEFAULT_QUERY_JOBS = 16;
+/** Default number of seconds, after which the result of a finished query job is dropped, if it isn't read. */
+static const int64_t DEFAULT_QUERY_JOB_TIMEOUT = 10 * 60;
+
+namespace mastercore
+{
+class CWorkerPool;
+}
+
+/**
+ * A call, which is executed in the background, and its result.
+ */
+struct CQueryJob
+{
+    enum Status { QUEUED, RUNNING, DONE, FAILED };
+
+    //! Name of the called method
+    std::string strMethod;
+    Status status;
+    //! Times of the submission, the start and the end of the call
+    int64_t nSubmitted;
+    int64_t nStarted;
+    int64_t nFinished;
+    //! Time of the last use, to drop unread results
+    int64_t nLastUsed;
+    //! Result of a finished call, or the error object of a failed call
+    std::shared_ptr<const UniValue> result;
+
+    CQueryJob(const std::string& strMethodIn, int64_t nTime);
+
+    /** Returns the status as string. */
+    const char* GetStatusName() const;
+};
+
+/**
+ * Store of the query jobs, which are identified by random ids.
+ *
+ * The calls are executed on the worker pool, so long queries neither occupy
+ * the threads of the RPC server, nor run into timeouts of the clients.
+ *
+ * Finished jobs, which were not used within the timeout, are dropped, and no
+ * new jobs are accepted, if the maximal number of jobs is reached.
+ *
+ * The store is thread-safe.
+ */
+class CQueryJobStore
+{
+private:
+    mutable Mutex m_mutex;
+
+    std::map<uint256, CQueryJob> m_jobs GUARDED_BY(m_mutex);
+
+    size_t m_nMaxJobs;
+    int64_t m_nTimeout;
+    //! Pool to run the calls, or nullptr for the shared pool
+    mastercore::CWorkerPool* m_pPool;
+
+    /** Drops the finished jobs, which were not used within the timeout. */
+    void Expire(int64_t nTime) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    /** Executes the call of a job, and stores its result. */
+    void Run(const uint256& id, const std::function<UniValue()>& fn);
+
+public:
+    explicit CQueryJobStore(size_t nMaxJobs = DEFAULT_QUERY_JOBS, int64_t nTimeout = DEFAULT_QUERY_JOB_TIMEOUT, mastercore::CWorkerPool* pPool = nullptr);
+
+    /**
+     * Queues a call, and returns the id of its job, or a null id, if too many jobs are kept.
+     *
+     * The call may throw an error object or an exception, which marks the job as failed.
+     */
+    uint256 Submit(const std::string& strMethod, const std::function<UniValue()>& fn, int64_t nTime);
+
+    /** Returns a copy of the job with the given id, or false, if there is no such job. */
+    bool Get(const uint256& id, int64_t nTime, CQueryJob& job);
+
+    size_t Size() const { LOCK(m_mutex); return m_jobs.size(); }
+};
+
+namespace mastercore
+{
+//! Jobs of the queries submitted via RPC
+extern CQueryJobStore queryJobs;
+}
+
+#endif // BITCOIN_OMNICORE_QUERYJOBS_H
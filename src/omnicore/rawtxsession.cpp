@@ -0,0 +1,79 @@
+/**
+ * @file rawtxsession.cpp
+ *
+ * This file contains the sessions, which keep a raw transaction and the previous
+ * outputs of its inputs between the calls, which build it.
+ */
+
+#include <omnicore/rawtxsession.h>
+
+#include <omnicore/createtx.h>
+
+#include <coins.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+
+CRawTxSessionStore mastercore::rawTxSessions;
+
+CRawTxSession::CRawTxSession(const CMutableTransaction& tx, int64_t nTime)
+  : builder(tx), view(&viewDummy), nLastUsed(nTime)
+{
+}
+
+CRawTxSessionStore::CRawTxSessionStore(size_t nMaxSessions, int64_t nTimeout)
+  : m_nMaxSessions(nMaxSessions), m_nTimeout(nTimeout)
+{
+}
+
+void CRawTxSessionStore::Expire(int64_t nTime)
+{
+    for (auto it = m_sessions.begin(); it != m_sessions.end(); ) {
+        if (it->second->nLastUsed + m_nTimeout < nTime) {
+            it = m_sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+uint256 CRawTxSessionStore::Create(const CMutableTransaction& tx, int64_t nTime)
+{
+    LOCK(m_mutex);
+    Expire(nTime);
+    if (m_sessions.size() >= m_nMaxSessions) return uint256();
+
+    uint256 id = GetRandHash();
+    m_sessions.emplace(id, std::unique_ptr<CRawTxSession>(new CRawTxSession(tx, nTime)));
+    return id;
+}
+
+bool CRawTxSessionStore::Modify(const uint256& id, int64_t nTime, const std::function<void(CRawTxSession&)>& fn)
+{
+    LOCK(m_mutex);
+    Expire(nTime);
+    auto it = m_sessions.find(id);
+    if (it == m_sessions.end()) return false;
+
+    it->second->nLastUsed = nTime;
+    fn(*it->second);
+    return true;
+}
+
+bool CRawTxSessionStore::Finalize(const uint256& id, int64_t nTime, CMutableTransaction& tx)
+{
+    LOCK(m_mutex);
+    Expire(nTime);
+    auto it = m_sessions.find(id);
+    if (it == m_sessions.end()) return false;
+
+    tx = it->second->builder.build();
+    m_sessions.erase(it);
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef BITCOIN_OMNICORE_RAWTXSESSION_H
+#define BITCOIN_OMNICORE_RAWTXSESSION_H
+
+#include <omnicore/createtx.h>
+
+#include <coins.h>
+#include <primitives/transaction.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Default number of open raw transaction sessions. */
+static const unsigned int DEFAULT_RAWTX_SESSIONS = 100;
+/** Default number of seconds, after which an unused raw transaction session is closed. */
+static const int64_t DEFAULT_RAWTX_SESSION_TIMEOUT = 30 * 60;
+
+/**
+ * A transaction, which is built by several calls, along with the previous outputs of its inputs.
+ */
+struct CRawTxSession
+{
+    //! Builder of the transaction
+    OmniTxBuilder builder;
+    //! Empty base of the view
+    CCoinsView viewDummy;
+    //! Previous outputs of the inputs, which were provided so far
+    CCoinsViewCache view;
+    //! Time of the last use, to close unused sessions
+    int64_t nLastUsed;
+
+    CRawTxSession(const CMutableTransaction& tx, int64_t nTime);
+};
+
+/**
+ * Store of the raw transaction sessions, which are identified by random ids.
+ *
+ * The transaction and the previous outputs are kept between the calls, so a transaction
+ * is only encoded once, when it's finished, instead of being decoded and encoded again
+ * for each added input or output.
+ *
+ * Sessions, which were not used within the timeout, are closed, and no new sessions
+ * are opened, if the maximal number of sessions is reached.
+ *
+ * The store is thread-safe.
+ */
+class CRawTxSessionStore
+{
+private:
+    mutable Mutex m_mutex;
+
+    std::map<uint256, std::unique_ptr<CRawTxSession> > m_sessions GUARDED_BY(m_mutex);
+
+    size_t m_nMaxSessions;
+    int64_t m_nTimeout;
+
+    /** Closes the sessions, which were not used within the timeout. */
+    void Expire(int64_t nTime) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+public:
+    explicit CRawTxSessionStore(size_t nMaxSessions = DEFAULT_RAWTX_SESSIONS, int64_t nTimeout = DEFAULT_RAWTX_SESSION_TIMEOUT);
+
+    /** Opens a session to extend a transaction, and returns its id, or a null id, if too many sessions are open. */
+    uint256 Create(const CMutableTransaction& tx, int64_t nTime);
+
+    /** Modifies the session with the given id, and returns false, if there is no such session. */
+    bool Modify(const uint256& id, int64_t nTime, const std::function<void(CRawTxSession&)>& fn);
+
+    /** Closes the session with the given id, and returns its transaction, or false, if there is no such session. */
+    bool Finalize(const uint256& id, int64_t nTime, CMutableTransaction& tx);
+
+    size_t Size() const { LOCK(m_mutex); return m_sessions.size(); }
+};
+
+namespace mastercore
+{
+//! Sessions of the raw transaction calls
+extern CRawTxSessionStore rawTxSessions;
+}
+
+#endif // BITCOIN_OMNICORE_RAWTXSESSION_H
@@ -0,0 +1,178 @@
+/**
+ * @file replay.cpp
+ *
+ * This file contains the preparation and reporting of a replay of a block range,
+ * which processes historical blocks of the datadir, starting with a stored state,
+ * to measure the performance and to compare the consensus hash.
+ */
+
+#include <omnicore/replay.h>
+
+#include <omnicore/consensushash.h>
+#include <omnicore/log.h>
+#include <omnicore/perfstats.h>
+#include <omnicore/rules.h>
+#include <omnicore/scanstatus.h>
+#include <omnicore/utilsbitcoin.h>
+
+#include <chain.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <univalue.h>
+
+#include <boost/algorithm/string.hpp>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace mastercore
+{
+//! Databases of the Omni state, which are only copied, if the replay doesn't start with an empty state
+static const char* const REPLAY_STATE_DATABASES[] = {
+    "MP_tradelist", "MP_stolist", "MP_txlist", "MP_spinfo", "Omni_TXDB",
+    "OMNI_feecache", "OMNI_feehistory", "OMNI_nftdb", "OMNI_state"
+};
+
+//! Indexes, which only depend on the blockchain
+static const char* const REPLAY_CHAIN_DATABASES[] = {
+    "OMNI_prevouts", "OMNI_markerindex"
+};
+
+bool ParseReplayRange(const std::string& strRange, int& nFirstBlock, int& nLastBlock)
+{
+    std::vector<std::string> vstr;
+    boost::split(vstr, strRange, boost::is_any_of(":"));
+    if (vstr.size() != 2) return false;
+    if (!ParseInt32(vstr[0], &nFirstBlock) || !ParseInt32(vstr[1], &nLastBlock)) return false;
+
+    return nFirstBlock >= 0 && nFirstBlock <= nLastBlock;
+}
+
+fs::path GetReplayDirectory()
+{
+    return GetDataDir() / "omnireplay";
+}
+
+/**
+ * Links or copies a file into the replay directory.
+ *
+ * Files, which are never modified in place, are hard linked, if possible.
+ */
+static void CopyReplayFile(const fs::path& from, const fs::path& to, bool fImmutable)
+{
+    if (fImmutable) {
+        boost::system::error_code ec;
+        fs::create_hard_link(from, to, ec);
+        if (!ec) return;
+    }
+    fs::copy_file(from, to);
+}
+
+/**
+ * Copies a LevelDB database, whose table files are immutable, while the log and manifest are appended.
+ */
+static void CopyReplayDatabase(const fs::path& from, const fs::path& to)
+{
+    if (!fs::is_directory(from)) return;
+
+    fs::create_directories(to);
+    for (fs::directory_iterator it(from); it != fs::directory_iterator(); ++it) {
+        if (!fs::is_regular_file(it->status())) continue;
+        const fs::path& path = it->path();
+        if (path.filename() == "LOCK") continue;
+        const bool fTable = path.extension() == ".ldb" || path.extension() == ".sst";
+        CopyReplayFile(path, to / path.filename(), fTable);
+    }
+}
+
+bool PrepareReplayDirectory(int nFirstBlock, int nLastBlock, std::string& strError)
+{
+    const fs::path pathReplay = GetReplayDirectory();
+    const fs::path pathStates = GetDataDir() / "MP_persist";
+    // before the first Omni block, the replay starts with an empty state
+    const bool fEmptyState = nFirstBlock <= ConsensusParams().GENESIS_BLOCK;
+
+    uint256 hashStart;
+    {
+        LOCK(cs_main);
+        if (nLastBlock > ::ChainActive().Height()) {
+            strError = strprintf("block %d is above the tip at block %d", nLastBlock, ::ChainActive().Height());
+            return false;
+        }
+        if (!fEmptyState) hashStart = ::ChainActive()[nFirstBlock - 1]->GetBlockHash();
+    }
+
+    if (!fEmptyState && !fs::exists(pathStates / strprintf("balances-%s.dat", hashStart.ToString()))) {
+        strError = strprintf("no state of block %d is stored", nFirstBlock - 1);
+        return false;
+    }
+
+    try {
+        fs::remove_all(pathReplay);
+        fs::create_directories(pathReplay / "MP_persist");
+
+        for (const char* name : REPLAY_CHAIN_DATABASES) {
+            CopyReplayDatabase(GetDataDir() / name, pathReplay / name);
+        }
+        if (fEmptyState) return true;
+
+        for (const char* name : REPLAY_STATE_DATABASES) {
+            CopyReplayDatabase(GetDataDir() / name, pathReplay / name);
+        }
+
+        // the states up to the start of the range, which includes the bases of deltas
+        LOCK(cs_main);
+        for (fs::directory_iterator it(pathStates); it != fs::directory_iterator(); ++it) {
+            if (!fs::is_regular_file(it->status()) || it->path().extension() != ".dat") continue;
+
+            std::vector<std::string> vstr;
+            const std::string fName = it->path().filename().string();
+            boost::split(vstr, fName, boost::is_any_of("-."), boost::token_compress_on);
+            if (vstr.size() != 3) continue;
+
+            const CBlockIndex* pBlockIndex = GetBlockIndex(uint256S(vstr[1]));
+            if (pBlockIndex == nullptr || !::ChainActive().Contains(pBlockIndex) || pBlockIndex->nHeight >= nFirstBlock) continue;
+
+            // state files are written under a temporary name, and never modified afterwards
+            CopyReplayFile(it->path(), pathReplay / "MP_persist" / it->path().filename(), true);
+        }
+    } catch (const fs::filesystem_error& e) {
+        strError = e.what();
+        return false;
+    }
+
+    return true;
+}
+
+void ReportReplay(int nFirstBlock, int nLastBlock)
+{
+    const ScanStatusInfo info = scanStatus.Get();
+    const double dSeconds = std::max<int64_t>(1, info.nElapsed) / 1000000.0;
+
+    if (info.nCurrentBlock < nLastBlock) {
+        PrintToConsole("Replay stopped early at block %d of block %d\n", info.nCurrentBlock, nLastBlock);
+    }
+    PrintToConsole("Replayed blocks %d to %d in %.3f seconds\n", nFirstBlock, info.nCurrentBlock, dSeconds);
+    PrintToConsole("Throughput: %.2f blocks/s, %.2f transactions/s, %.2f Omni transactions/s\n",
+            info.nBlocks / dSeconds, info.nTransactions / dSeconds, info.nOmniTransactions / dSeconds);
+
+    const UniValue stats = GetPerfStats(PERF_RECENT_BLOCKS, false);
+    for (const UniValue& phase : stats["phases"].getValues()) {
+        PrintToConsole("  %-14s total %10.3f s, avg %.6f s, p99 %.6f s, max %.6f s\n", phase["phase"].get_str(),
+                phase["totaltime"].get_real(), phase["avgtime"].get_real(), phase["p99time"].get_real(), phase["maxtime"].get_real());
+    }
+    PrintToLog("Replay statistics: %s\n", stats.write());
+
+    const std::string strHash = GetConsensusHash().GetHex();
+    PrintToConsole("Consensus hash after block %d: %s\n", info.nCurrentBlock, strHash);
+    PrintToLog("Replay of blocks %d to %d finished, consensus hash after block %d: %s\n", nFirstBlock, nLastBlock, info.nCurrentBlock, strHash);
+}
+}
@@ -0,0 +1,26 @@
+#ifndef BITCOIN_OMNICORE_REPLAY_H
+#define BITCOIN_OMNICORE_REPLAY_H
+
+#include <fs.h>
+
+#include <string>
+
+namespace mastercore
+{
+/** Parses a block range of the form "<from>:<to>", as given by -omnireplay. */
+bool ParseReplayRange(const std::string& strRange, int& nFirstBlock, int& nLastBlock);
+
+/** Returns the directory, which holds the Omni databases and state files of a replay. */
+fs::path GetReplayDirectory();
+
+/**
+ * Prepares the directory of a replay with copies of the Omni databases and the state files
+ * up to the block before the range, so that the replay leaves the datadir untouched.
+ */
+bool PrepareReplayDirectory(int nFirstBlock, int nLastBlock, std::string& strError);
+
+/** Logs and prints the throughput, the timings of the phases and the consensus hash after a replay. */
+void ReportReplay(int nFirstBlock, int nLastBlock);
+}
+
+#endif // BITCOIN_OMNICORE_REPLAY_H
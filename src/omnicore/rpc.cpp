@@ -7,28 +7,54 @@
 #include <omnicore/rpc.h>
 
 #include <omnicore/activation.h>
+#include <omnicore/blockfile.h>
+#include <omnicore/blockqueue.h>
+#include <omnicore/bootstrap.h>
 #include <omnicore/consensushash.h>
 #include <omnicore/convert.h>
+#include <omnicore/dbaddressfilter.h>
+#include <omnicore/dbaddressindex.h>
+#include <omnicore/dbbalancechanges.h>
+#include <omnicore/dbbalancehistory.h>
 #include <omnicore/dbfees.h>
+#include <omnicore/dbmarkers.h>
+#include <omnicore/dbprevout.h>
 #include <omnicore/dbspinfo.h>
 #include <omnicore/dbstolist.h>
 #include <omnicore/dbtradelist.h>
+#include <omnicore/dbtransaction.h>
 #include <omnicore/dbtxlist.h>
 #include <omnicore/dex.h>
 #include <omnicore/errors.h>
+#include <omnicore/indexproperties.h>
+#include <omnicore/inputcache.h>
 #include <omnicore/log.h>
 #include <omnicore/mdex.h>
+#include <omnicore/memusage.h>
 #include <omnicore/notifications.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/parsing.h>
+#include <omnicore/perfstats.h>
+#include <omnicore/persistence.h>
+#include <omnicore/queryjobs.h>
+#include <omnicore/rpcjsonstream.h>
 #include <omnicore/rpcrequirements.h>
+#include <omnicore/rpcstats.h>
 #include <omnicore/rpctxobject.h>
 #include <omnicore/rpcvalues.h>
 #include <omnicore/rules.h>
+#include <omnicore/scanstatus.h>
+#include <omnicore/seedblocks.h>
+#include <omnicore/snapshot.h>
 #include <omnicore/sp.h>
+#include <omnicore/statecommitment.h>
+#include <omnicore/stateexport.h>
+#include <omnicore/statescan.h>
 #include <omnicore/sto.h>
 #include <omnicore/tally.h>
+#include <omnicore/timedmutex.h>
 #include <omnicore/tx.h>
+#include <omnicore/txobjectcache.h>
 #include <omnicore/nftdb.h>
 #include <omnicore/utilsbitcoin.h>
 #include <omnicore/version.h>
@@ -59,7 +85,12 @@
 #include <univalue.h>
 
 #include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
 #include <map>
+#include <memory>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <tuple>
@@ -92,12 +123,14 @@ void PopulateFailure(int error)
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No such mempool transaction. Blockchain transactions are still in the process of being indexed.");
         case MP_RPC_DECODE_INPUTS_MISSING:
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction inputs were not found. Please provide inputs explicitly (see help description) or fully synchronize node.");
+        case MP_TX_HISTORY_PRUNED:
+            throw JSONRPCError(RPC_MISC_ERROR, "Transaction history was pruned (see -omniprunehistory)");
 
     }
     throw JSONRPCError(RPC_INTERNAL_ERROR, "Generic transaction population failure");
 }
 
-void PropertyToJSON(const CMPSPInfo::Entry& sProperty, UniValue& property_obj)
+void PropertyToJSON(const CMPSPInfo::Listing& sProperty, UniValue& property_obj)
 {
     property_obj.pushKV("name", sProperty.name);
     property_obj.pushKV("category", sProperty.category);
@@ -113,6 +146,11 @@ void PropertyToJSON(const CMPSPInfo::Entry& sProperty, UniValue& property_obj)
     property_obj.pushKV("non-fungibletoken", sProperty.unique);
 }
 
+void PropertyToJSON(const CMPSPInfo::Entry& sProperty, UniValue& property_obj)
+{
+    PropertyToJSON(CMPSPInfo::Listing(sProperty), property_obj);
+}
+
 void MetaDexObjectToJSON(const CMPMetaDEx& obj, UniValue& metadex_obj)
 {
     bool propertyIdForSaleIsDivisible = isPropertyDivisible(obj.getProperty());
@@ -149,13 +187,8 @@ void MetaDexObjectsToJSON(std::vector<CMPMetaDEx>& vMetaDexObjs, UniValue& respo
     }
 }
 
-bool BalanceToJSON(const std::string& address, uint32_t property, UniValue& balance_obj, bool divisible)
+static bool BalanceToJSON(int64_t nAvailable, int64_t nReserved, int64_t nFrozen, UniValue& balance_obj, bool divisible)
 {
-    // confirmed balance minus unconfirmed, spent amounts
-    int64_t nAvailable = GetAvailableTokenBalance(address, property);
-    int64_t nReserved = GetReservedTokenBalance(address, property);
-    int64_t nFrozen = GetFrozenTokenBalance(address, property);
-
     if (divisible) {
         balance_obj.pushKV("balance", FormatDivisibleMP(nAvailable));
         balance_obj.pushKV("reserved", FormatDivisibleMP(nReserved));
@@ -169,6 +202,77 @@ bool BalanceToJSON(const std::string& address, uint32_t property, UniValue& bala
     return (nAvailable || nReserved || nFrozen);
 }
 
+bool BalanceToJSON(const std::string& address, uint32_t property, UniValue& balance_obj, bool divisible)
+{
+    // confirmed balance minus unconfirmed, spent amounts
+    int64_t nAvailable = GetAvailableTokenBalance(address, property);
+    int64_t nReserved = GetReservedTokenBalance(address, property);
+    int64_t nFrozen = GetFrozenTokenBalance(address, property);
+
+    return BalanceToJSON(nAvailable, nReserved, nFrozen, balance_obj, divisible);
+}
+
+// obtains the balance from a snapshot of the state, which doesn't require cs_tally
+bool BalanceToJSON(const CStateSnapshot& snapshot, const std::string& address, uint32_t property, UniValue& balance_obj, bool divisible)
+{
+    int64_t nAvailable = snapshot.GetAvailableTokenBalance(address, property);
+    int64_t nReserved = snapshot.GetReservedTokenBalance(address, property);
+    int64_t nFrozen = snapshot.GetFrozenTokenBalance(address, property);
+
+    return BalanceToJSON(nAvailable, nReserved, nFrozen, balance_obj, divisible);
+}
+
+// obtains the balance after a past block from the balance history, which doesn't record the freeze state
+static bool BalanceToJSON(const CBalanceHistoryEntry& entry, UniValue& balance_obj, bool divisible)
+{
+    if (divisible) {
+        balance_obj.pushKV("balance", FormatDivisibleMP(entry.nBalance));
+        balance_obj.pushKV("reserved", FormatDivisibleMP(entry.nReserved));
+    } else {
+        balance_obj.pushKV("balance", FormatIndivisibleMP(entry.nBalance));
+        balance_obj.pushKV("reserved", FormatIndivisibleMP(entry.nReserved));
+    }
+
+    return (entry.nBalance || entry.nReserved);
+}
+
+/** Parses the height of a balance query, which must be covered by the balance history. */
+static int ParseHistoryHeight(const UniValue& value)
+{
+    if (!pDbBalanceHistory) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The balance history is disabled, use -omnibalancehistory to enable it");
+    }
+    const int nHeight = value.get_int();
+    int nFirstHeight = 0;
+    int nLastHeight = 0;
+    if (!pDbBalanceHistory->GetRecordedRange(nFirstHeight, nLastHeight)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The balance history doesn't cover any blocks yet");
+    }
+    if (nHeight < nFirstHeight || nHeight > nLastHeight) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block height is out of range, the balance history covers the blocks %d to %d", nFirstHeight, nLastHeight));
+    }
+    return nHeight;
+}
+
+/** Wraps a page of a list, and adds the cursor of the next page, if there are more entries. */
+static UniValue PageToJSON(const UniValue& entries, bool fMore, const std::string& cursor)
+{
+    UniValue page(UniValue::VOBJ);
+    page.pushKV("entries", entries);
+    if (fMore) page.pushKV("cursor", cursor);
+    return page;
+}
+
+/** Parses a cursor, which consists of a number. */
+static int64_t ParseNumericCursor(const std::string& cursor)
+{
+    int64_t value = 0;
+    if (!ParseInt64(cursor, &value) || value < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    return value;
+}
+
 // display the non-fungible tokens owned by an address for a property
 UniValue omni_getnonfungibletokens(const JSONRPCRequest& request)
 {
@@ -333,33 +437,51 @@ UniValue omni_getnonfungibletokenranges(const JSONRPCRequest& request)
        "\nReturns the ranges and their addresses for a non-fungible token property.\n",
        {
            {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::NO, "the property identifier"},
+           {"limit", RPCArg::Type::NUM, /* default */ "no limit", "the maximum number of ranges to return, which returns a page"},
+           {"cursor", RPCArg::Type::STR, /* default */ "the first page", "the cursor of the page to return"},
        },
-       RPCResult{
-           RPCResult::Type::ARR, "", "",
-           {
-               {RPCResult::Type::OBJ, "", "",
+       {
+           RPCResult{"if no limit or cursor is given",
+               RPCResult::Type::ARR, "", "",
                {
-                   {RPCResult::Type::STR, "address", "the address"},
-                   {RPCResult::Type::NUM, "tokenstart", "the first token in this range"},
-                   {RPCResult::Type::NUM, "tokenend", "the last token in this range"},
-                   {RPCResult::Type::NUM, "amount", "the amount of tokens in the range"},
-               }},
-           }
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR, "address", "the address"},
+                       {RPCResult::Type::NUM, "tokenstart", "the first token in this range"},
+                       {RPCResult::Type::NUM, "tokenend", "the last token in this range"},
+                       {RPCResult::Type::NUM, "amount", "the amount of tokens in the range"},
+                   }},
+               }
+           },
+           RPCResult{"otherwise",
+               RPCResult::Type::OBJ, "", "",
+               {
+                   {RPCResult::Type::ARR, "entries", "the ranges of the page, as above", {{RPCResult::Type::ELISION, "", ""}}},
+                   {RPCResult::Type::STR, "cursor", /* optional */ true, "the cursor of the next page, if there are more ranges"},
+               }
+           },
        },
        RPCExamples{
            HelpExampleCli("omni_getnonfungibletokenranges", "1")
+           + HelpExampleCli("omni_getnonfungibletokenranges", "1 1000")
            + HelpExampleRpc("omni_getnonfungibletokenranges", "1")
        }
     }.Check(request);
 
     uint32_t propertyId = ParsePropertyId(request.params[0]);
+    const bool fPaged = !request.params[1].isNull() || !request.params[2].isNull();
+    const size_t limit = request.params[1].isNull() ? std::numeric_limits<size_t>::max() - 1 : ParsePageLimit(request.params[1]);
+    const int64_t tokenIdAfter = request.params[2].isNull() ? 0 : ParseNumericCursor(request.params[2].get_str());
 
     RequireExistingProperty(propertyId);
     RequireNonFungibleProperty(propertyId);
 
     UniValue response(UniValue::VARR);
 
-    std::vector<std::pair<std::string,std::pair<int64_t,int64_t> > > rangeMap = pDbNFT->GetNonFungibleTokenRanges(propertyId);
+    // one more range is retrieved to find out, whether there is another page
+    std::vector<std::pair<std::string,std::pair<int64_t,int64_t> > > rangeMap = pDbNFT->GetNonFungibleTokenRanges(propertyId, tokenIdAfter, limit + 1);
+    const bool fMore = rangeMap.size() > limit;
+    if (fMore) rangeMap.pop_back();
 
     for (std::vector<std::pair<std::string,std::pair<int64_t,int64_t> > >::iterator it = rangeMap.begin(); it!= rangeMap.end(); ++it) {
         std::pair<std::string,std::pair<int64_t,int64_t> > entry = *it;
@@ -376,6 +498,10 @@ UniValue omni_getnonfungibletokenranges(const JSONRPCRequest& request)
         response.push_back(uniqueRangeObj);
     }
 
+    if (fPaged) {
+        return PageToJSON(response, fMore, rangeMap.empty() ? "" : std::to_string(rangeMap.back().second.first));
+    }
+
     return response;
 }
 
@@ -563,9 +689,13 @@ static UniValue omni_getfeetrigger(const JSONRPCRequest& request)
 
     UniValue response(UniValue::VARR);
 
+    // the thresholds are kept in memory, and updated by block processing, whenever the supply changes
+    LOCK(cs_tally);
+
     for (uint8_t ecosystem = 1; ecosystem <= 2; ecosystem++) {
         uint32_t startPropertyId = (ecosystem == 1) ? 1 : TEST_ECO_PROPERTY_1;
-        for (uint32_t itPropertyId = startPropertyId; itPropertyId < pDbSpInfo->peekNextSPID(ecosystem); itPropertyId++) {
+        const uint32_t nextPropertyId = pDbSpInfo->peekNextSPID(ecosystem);
+        for (uint32_t itPropertyId = startPropertyId; itPropertyId < nextPropertyId; itPropertyId++) {
             if (propertyId == 0 || propertyId == itPropertyId) {
                 int64_t feeTrigger = pDbFeeCache->GetDistributionThreshold(itPropertyId);
                 std::string strFeeTrigger = FormatMP(itPropertyId, feeTrigger);
@@ -625,14 +755,11 @@ static UniValue omni_getfeeshare(const JSONRPCRequest& request)
     UniValue response(UniValue::VARR);
     bool addObj = false;
 
-    OwnerAddrType receiversSet;
-    if (ecosystem == 1) {
-        receiversSet = STO_GetReceivers("FEEDISTRIBUTION", OMNI_PROPERTY_MSC, COIN);
-    } else {
-        receiversSet = STO_GetReceivers("FEEDISTRIBUTION", OMNI_PROPERTY_TMSC, COIN);
-    }
+    // the shares are determined once per modification of the balances, and shared by all calls
+    std::shared_ptr<const OwnerAddrType> pReceivers = GetFeeShares((ecosystem == 1) ? OMNI_PROPERTY_MSC : OMNI_PROPERTY_TMSC);
+    const OwnerAddrType& receiversSet = *pReceivers;
 
-    for (OwnerAddrType::reverse_iterator it = receiversSet.rbegin(); it != receiversSet.rend(); ++it) {
+    for (OwnerAddrType::const_reverse_iterator it = receiversSet.rbegin(); it != receiversSet.rend(); ++it) {
         addObj = false;
         if (address.empty()) {
             if (IsMyAddress(it->second, pWallet.get())) {
@@ -693,24 +820,26 @@ static UniValue omni_getfeecache(const JSONRPCRequest& request)
 
     UniValue response(UniValue::VARR);
 
-    for (uint8_t ecosystem = 1; ecosystem <= 2; ecosystem++) {
-        uint32_t startPropertyId = (ecosystem == 1) ? 1 : TEST_ECO_PROPERTY_1;
-        for (uint32_t itPropertyId = startPropertyId; itPropertyId < pDbSpInfo->peekNextSPID(ecosystem); itPropertyId++) {
-            if (propertyId == 0 || propertyId == itPropertyId) {
-                int64_t cachedFee = pDbFeeCache->GetCachedAmount(itPropertyId);
-                if (cachedFee == 0) {
-                    // filter empty results unless the call specifically requested this property
-                    if (propertyId != itPropertyId) continue;
-                }
-                std::string strFee = FormatMP(itPropertyId, cachedFee);
-                UniValue cacheObj(UniValue::VOBJ);
-                cacheObj.pushKV("propertyid", (uint64_t)itPropertyId);
-                cacheObj.pushKV("cachedfees", strFee);
-                response.push_back(cacheObj);
-            }
+    // empty results are filtered, unless the call specifically requested the property
+    std::map<uint32_t, int64_t> cachedFees;
+    {
+        LOCK(cs_tally);
+        if (propertyId > 0) {
+            cachedFees[propertyId] = pDbFeeCache->GetCachedAmount(propertyId);
+        } else {
+            // the amounts of all properties are read with one scan per block, rather than one read per property
+            cachedFees = pDbFeeCache->GetCachedAmounts();
         }
     }
 
+    for (const std::pair<const uint32_t, int64_t>& cachedFee : cachedFees) {
+        std::string strFee = FormatMP(cachedFee.first, cachedFee.second);
+        UniValue cacheObj(UniValue::VOBJ);
+        cacheObj.pushKV("propertyid", (uint64_t)cachedFee.first);
+        cacheObj.pushKV("cachedfees", strFee);
+        response.push_back(cacheObj);
+    }
+
     return response;
 }
 
@@ -743,7 +872,18 @@ static UniValue omni_getseedblocks(const JSONRPCRequest& request)
 
     UniValue response(UniValue::VARR);
 
-    {
+    // blocks covered by the static seed block list are served from the list
+    std::vector<int> vSeedBlocks;
+    int nCoveredHeight = 0;
+    if (GetStaticSeedBlocks(startHeight, endHeight, vSeedBlocks, nCoveredHeight)) {
+        for (int block : vSeedBlocks) {
+            response.push_back(block);
+        }
+        startHeight = nCoveredHeight + 1;
+    }
+
+    if (startHeight <= endHeight) {
+        RequireUnprunedHistory(startHeight);
         LOCK(cs_tally);
         std::set<int> setSeedBlocks = pDbTransactionList->GetSeedBlocks(startHeight, endHeight);
         for (std::set<int>::const_iterator it = setSeedBlocks.begin(); it != setSeedBlocks.end(); ++it) {
@@ -777,6 +917,18 @@ static UniValue omni_getpayload(const JSONRPCRequest& request)
 
     uint256 txid = ParseHashV(request.params[0], "txid");
 
+    // processed transactions are served from their records, so no transaction index is needed
+    COmniTransactionDB::Record record;
+    if (pDbTransaction->FetchTransactionRecord(txid, record)) {
+        CMPTransaction mp_obj;
+        record.Restore(mp_obj, txid, 0);
+
+        UniValue payloadObj(UniValue::VOBJ);
+        payloadObj.pushKV("payload", mp_obj.getPayload());
+        payloadObj.pushKV("payloadsize", mp_obj.getPayloadSize());
+        return payloadObj;
+    }
+
     bool f_txindex_ready = false;
     if (g_txindex) {
         f_txindex_ready = g_txindex->BlockUntilSyncedToCurrentChain();
@@ -784,8 +936,8 @@ static UniValue omni_getpayload(const JSONRPCRequest& request)
 
     CTransactionRef tx;
     uint256 blockHash;
-    if (!GetTransaction(txid, tx, Params().GetConsensus(), blockHash)) {
-        if (!f_txindex_ready) {
+    if (!FetchTransaction(txid, tx, blockHash)) {
+        if (g_txindex && !f_txindex_ready) {
             PopulateFailure(MP_TXINDEX_STILL_SYNCING);
         } else {
             PopulateFailure(MP_TX_NOT_FOUND);
@@ -876,9 +1028,9 @@ static UniValue mscrpc(const JSONRPCRequest& request)
             LOCK(cs_tally);
             int64_t total = 0;
             // display all balances
-            for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-                PrintToConsole("%34s => ", my_it->first);
-                total += (my_it->second).print(extra2, bDivisible);
+            for (const auto& entry : mp_tally_map) {
+                PrintToConsole("%34s => ", entry.first);
+                total += entry.second.print(extra2, bDivisible);
             }
             PrintToConsole("total for property %d  = %X is %s\n", extra2, extra2, FormatDivisibleMP(total));
             break;
@@ -901,13 +1053,11 @@ static UniValue mscrpc(const JSONRPCRequest& request)
         case 3:
         {
             LOCK(cs_tally);
-            uint32_t id = 0;
             // for each address display all currencies it holds
-            for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-                PrintToConsole("%34s => ", my_it->first);
-                (my_it->second).print(extra2);
-                (my_it->second).init();
-                while (0 != (id = (my_it->second).next())) {
+            for (const auto& entry : mp_tally_map) {
+                PrintToConsole("%34s => ", entry.first);
+                entry.second.print(extra2);
+                for (uint32_t id : entry.second) {
                     PrintToConsole("Id: %u=0x%X ", id, id);
                 }
                 PrintToConsole("\n");
@@ -1022,10 +1172,12 @@ static UniValue mscrpc(const JSONRPCRequest& request)
 static UniValue omni_getbalance(const JSONRPCRequest& request)
 {
     RPCHelpMan{"omni_getbalance",
-       "\nReturns the token balance for a given address and property.\n",
+       "\nReturns the token balance for a given address and property.\n"
+       "\nBalances after past blocks are retrieved from the balance history, which requires -omnibalancehistory, and don't include the frozen amount.\n",
        {
            {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "the address"},
            {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::NO, ""},
+           {"height", RPCArg::Type::NUM, /* default */ "the current state", "the block height, after which the balance is retrieved"},
        },
        RPCResult{
            RPCResult::Type::OBJ, "", "",
@@ -1037,6 +1189,7 @@ static UniValue omni_getbalance(const JSONRPCRequest& request)
        },
        RPCExamples{
            HelpExampleCli("omni_getbalance", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\" 1")
+           + HelpExampleCli("omni_getbalance", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\" 1 650000")
            + HelpExampleRpc("omni_getbalance", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\", 1")
        }
     }.Check(request);
@@ -1044,20 +1197,51 @@ static UniValue omni_getbalance(const JSONRPCRequest& request)
     std::string address = ParseAddress(request.params[0]);
     uint32_t propertyId = ParsePropertyId(request.params[1]);
 
+    UniValue balanceObj(UniValue::VOBJ);
+
+    if (!request.params[2].isNull()) {
+        const int nHeight = ParseHistoryHeight(request.params[2]);
+        RequireExistingProperty(propertyId);
+        RequireIndexedProperty(propertyId);
+        CBalanceHistoryEntry entry;
+        pDbBalanceHistory->GetBalance(address, propertyId, nHeight, entry);
+        BalanceToJSON(entry, balanceObj, isPropertyDivisible(propertyId));
+        return balanceObj;
+    }
+
+    std::shared_ptr<const CStateSnapshot> snapshot = GetStateSnapshot();
+    if (snapshot) {
+        const CStateSnapshot::PropertyInfo* pProperty = snapshot->GetProperty(propertyId);
+        if (pProperty == nullptr) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Property identifier does not exist");
+        }
+        BalanceToJSON(*snapshot, address, propertyId, balanceObj, pProperty->fDivisible);
+        return balanceObj;
+    }
+
     RequireExistingProperty(propertyId);
 
-    UniValue balanceObj(UniValue::VOBJ);
     BalanceToJSON(address, propertyId, balanceObj, isPropertyDivisible(propertyId));
 
     return balanceObj;
 }
 
-static UniValue omni_getallbalancesforid(const JSONRPCRequest& request)
+static UniValue omni_getbalances(const JSONRPCRequest& request)
 {
-    RPCHelpMan{"omni_getallbalancesforid",
-       "\nReturns a list of token balances for a given currency or property identifier.\n",
+    RPCHelpMan{"omni_getbalances",
+       "\nReturns the token balances for a list of addresses and properties.\n"
+       "\nAll balances are retrieved from the same state.\n",
        {
-           {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::NO, "the property identifier"},
+           {"balances", RPCArg::Type::ARR, RPCArg::Optional::NO, "a JSON array of addresses and properties",
+                {
+                    {"", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED, "",
+                        {
+                            {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "the address"},
+                            {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::NO, "the property identifier"},
+                        }
+                    }
+                }
+           },
        },
        RPCResult{
            RPCResult::Type::ARR, "", "",
@@ -1065,6 +1249,7 @@ static UniValue omni_getallbalancesforid(const JSONRPCRequest& request)
                {RPCResult::Type::OBJ, "", "",
                {
                    {RPCResult::Type::STR, "address", "the address"},
+                   {RPCResult::Type::NUM, "propertyid", "the property identifier"},
                    {RPCResult::Type::STR_AMOUNT, "balance", "the available balance of the address"},
                    {RPCResult::Type::STR_AMOUNT, "reserved", "the amount reserved by sell offers and accepts"},
                    {RPCResult::Type::STR_AMOUNT, "frozen", "the amount frozen by the issuer (applies to managed properties only)"},
@@ -1072,136 +1257,653 @@ static UniValue omni_getallbalancesforid(const JSONRPCRequest& request)
            }
        },
        RPCExamples{
-           HelpExampleCli("omni_getallbalancesforid", "1")
-           + HelpExampleRpc("omni_getallbalancesforid", "1")
+           HelpExampleCli("omni_getbalances", "\"[{\\\"address\\\":\\\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\\\",\\\"propertyid\\\":1}]\"")
+           + HelpExampleRpc("omni_getbalances", "[{\"address\":\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\",\"propertyid\":1}]")
        }
     }.Check(request);
 
-    uint32_t propertyId = ParsePropertyId(request.params[0]);
-
-    RequireExistingProperty(propertyId);
+    const UniValue& queries = request.params[0].get_array();
+    std::vector<std::pair<std::string, uint32_t> > vQueries;
+    vQueries.reserve(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const UniValue& query = queries[i];
+        if (!query.isObject()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected object with {\"address\",\"propertyid\"}");
+        }
+        vQueries.emplace_back(ParseAddress(find_value(query, "address")), ParsePropertyId(find_value(query, "propertyid")));
+    }
 
     UniValue response(UniValue::VARR);
-    bool isDivisible = isPropertyDivisible(propertyId); // we want to check this BEFORE the loop
+
+    std::shared_ptr<const CStateSnapshot> snapshot = GetStateSnapshot();
+    if (snapshot) {
+        for (const std::pair<std::string, uint32_t>& query : vQueries) {
+            const CStateSnapshot::PropertyInfo* pProperty = snapshot->GetProperty(query.second);
+            if (pProperty == nullptr) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Property identifier %d does not exist", query.second));
+            }
+
+            UniValue balanceObj(UniValue::VOBJ);
+            balanceObj.pushKV("address", query.first);
+            balanceObj.pushKV("propertyid", (uint64_t) query.second);
+            BalanceToJSON(*snapshot, query.first, query.second, balanceObj, pProperty->fDivisible);
+            response.push_back(balanceObj);
+        }
+
+        return response;
+    }
+
+    // the properties are only looked up once, and all balances are retrieved under one lock
+    std::map<uint32_t, bool> mapDivisible;
 
     LOCK(cs_tally);
 
-    for (std::unordered_map<std::string, CMPTally>::iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-        uint32_t id = 0;
-        bool includeAddress = false;
-        std::string address = it->first;
-        (it->second).init();
-        while (0 != (id = (it->second).next())) {
-            if (id == propertyId) {
-                includeAddress = true;
-                break;
+    for (const std::pair<std::string, uint32_t>& query : vQueries) {
+        std::map<uint32_t, bool>::const_iterator it = mapDivisible.find(query.second);
+        if (it == mapDivisible.end()) {
+            CMPSPInfo::Entry property;
+            if (!pDbSpInfo->getSP(query.second, property)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Property identifier %d does not exist", query.second));
             }
+            it = mapDivisible.emplace(query.second, property.isDivisible()).first;
         }
-        if (!includeAddress) {
-            continue; // ignore this address, has never transacted in this propertyId
-        }
-        UniValue balanceObj(UniValue::VOBJ);
-        balanceObj.pushKV("address", address);
-        bool nonEmptyBalance = BalanceToJSON(address, propertyId, balanceObj, isDivisible);
 
-        if (nonEmptyBalance) {
-            response.push_back(balanceObj);
-        }
+        UniValue balanceObj(UniValue::VOBJ);
+        balanceObj.pushKV("address", query.first);
+        balanceObj.pushKV("propertyid", (uint64_t) query.second);
+        BalanceToJSON(query.first, query.second, balanceObj, it->second);
+        response.push_back(balanceObj);
     }
 
     return response;
 }
 
-static UniValue omni_getallbalancesforaddress(const JSONRPCRequest& request)
+static UniValue omni_getbalancesforaddresses(const JSONRPCRequest& request)
 {
-    RPCHelpMan{"omni_getallbalancesforaddress",
-       "\nReturns a list of all token balances for a given address.\n",
+    RPCHelpMan{"omni_getbalancesforaddresses",
+       "\nReturns the token balances for a list of addresses.\n"
+       "\nAll balances are retrieved from the same state. If no property identifier is given, the non-empty balances of all properties are returned.\n",
        {
-           {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "the address"},
+           {"addresses", RPCArg::Type::ARR, RPCArg::Optional::NO, "a JSON array of addresses",
+                {
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "the address"},
+                }
+           },
+           {"propertyid", RPCArg::Type::NUM, /* default */ "all properties", "the property identifier"},
        },
-       RPCResult{
-           RPCResult::Type::ARR, "", "",
-           {
-               {RPCResult::Type::OBJ, "", "",
+       {
+           RPCResult{"if a property identifier is given",
+               RPCResult::Type::ARR, "", "",
                {
-                   {RPCResult::Type::NUM, "propertyid", "the property identifier"},
-                   {RPCResult::Type::STR, "name", "the name of the property"},
-                   {RPCResult::Type::STR_AMOUNT, "balance", "the available balance of the address"},
-                   {RPCResult::Type::STR_AMOUNT, "reserved", "the amount reserved by sell offers and accepts"},
-                   {RPCResult::Type::STR_AMOUNT, "frozen", "the amount frozen by the issuer (applies to managed properties only)"},
-               }},
-           }
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR, "address", "the address"},
+                       {RPCResult::Type::STR_AMOUNT, "balance", "the available balance of the address"},
+                       {RPCResult::Type::STR_AMOUNT, "reserved", "the amount reserved by sell offers and accepts"},
+                       {RPCResult::Type::STR_AMOUNT, "frozen", "the amount frozen by the issuer (applies to managed properties only)"},
+                   }},
+               }
+           },
+           RPCResult{"otherwise",
+               RPCResult::Type::ARR, "", "",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR, "address", "the address"},
+                       {RPCResult::Type::ARR, "balances", "the non-empty balances of the address",
+                       {
+                           {RPCResult::Type::OBJ, "", "",
+                           {
+                               {RPCResult::Type::NUM, "propertyid", "the property identifier"},
+                               {RPCResult::Type::STR, "name", "the name of the property"},
+                               {RPCResult::Type::STR_AMOUNT, "balance", "the available balance of the address"},
+                               {RPCResult::Type::STR_AMOUNT, "reserved", "the amount reserved by sell offers and accepts"},
+                               {RPCResult::Type::STR_AMOUNT, "frozen", "the amount frozen by the issuer (applies to managed properties only)"},
+                           }},
+                       }},
+                   }},
+               }
+           },
        },
        RPCExamples{
-           HelpExampleCli("omni_getallbalancesforaddress", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\"")
-           + HelpExampleRpc("omni_getallbalancesforaddress", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\"")
+           HelpExampleCli("omni_getbalancesforaddresses", "\"[\\\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\\\"]\" 1")
+           + HelpExampleRpc("omni_getbalancesforaddresses", "[\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\"], 1")
        }
     }.Check(request);
 
-    std::string address = ParseAddress(request.params[0]);
+    const UniValue& addresses = request.params[0].get_array();
+    std::vector<std::string> vAddresses;
+    vAddresses.reserve(addresses.size());
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        vAddresses.push_back(ParseAddress(addresses[i]));
+    }
+    const bool fAllProperties = request.params[1].isNull();
+    const uint32_t propertyId = fAllProperties ? 0 : ParsePropertyId(request.params[1]);
 
     UniValue response(UniValue::VARR);
 
+    std::shared_ptr<const CStateSnapshot> snapshot = GetStateSnapshot();
+    if (snapshot) {
+        const CStateSnapshot::PropertyInfo* pRequested = nullptr;
+        if (!fAllProperties) {
+            pRequested = snapshot->GetProperty(propertyId);
+            if (pRequested == nullptr) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Property identifier does not exist");
+            }
+        }
+
+        for (const std::string& address : vAddresses) {
+            UniValue addressObj(UniValue::VOBJ);
+            addressObj.pushKV("address", address);
+
+            if (!fAllProperties) {
+                BalanceToJSON(*snapshot, address, propertyId, addressObj, pRequested->fDivisible);
+                response.push_back(addressObj);
+                continue;
+            }
+
+            UniValue balances(UniValue::VARR);
+            const CMPTally* addressTally = snapshot->GetTally(address);
+            if (addressTally != nullptr) {
+                for (uint32_t id : *addressTally) {
+                    const CStateSnapshot::PropertyInfo* pProperty = snapshot->GetProperty(id);
+                    if (pProperty == nullptr) {
+                        continue;
+                    }
+
+                    UniValue balanceObj(UniValue::VOBJ);
+                    balanceObj.pushKV("propertyid", (uint64_t) id);
+                    balanceObj.pushKV("name", pProperty->name);
+                    if (BalanceToJSON(*snapshot, address, id, balanceObj, pProperty->fDivisible)) {
+                        balances.push_back(balanceObj);
+                    }
+                }
+            }
+            addressObj.pushKV("balances", balances);
+            response.push_back(addressObj);
+        }
+
+        return response;
+    }
+
+    // the properties are only looked up once, and all balances are retrieved under one lock
+    std::map<uint32_t, std::pair<std::string, bool> > mapProperties;
+
     LOCK(cs_tally);
 
-    CMPTally* addressTally = getTally(address);
+    auto lookupProperty = [&mapProperties](uint32_t id) -> const std::pair<std::string, bool>* {
+        std::map<uint32_t, std::pair<std::string, bool> >::const_iterator it = mapProperties.find(id);
+        if (it == mapProperties.end()) {
+            CMPSPInfo::Entry property;
+            if (!pDbSpInfo->getSP(id, property)) {
+                return nullptr;
+            }
+            it = mapProperties.emplace(id, std::make_pair(property.name, property.isDivisible())).first;
+        }
+        return &it->second;
+    };
 
-    if (nullptr == addressTally) { // addressTally object does not exist
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "Address not found");
+    const std::pair<std::string, bool>* pRequested = nullptr;
+    if (!fAllProperties) {
+        pRequested = lookupProperty(propertyId);
+        if (pRequested == nullptr) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Property identifier does not exist");
+        }
     }
 
-    addressTally->init();
+    for (const std::string& address : vAddresses) {
+        UniValue addressObj(UniValue::VOBJ);
+        addressObj.pushKV("address", address);
 
-    uint32_t propertyId = 0;
-    while (0 != (propertyId = addressTally->next())) {
-        CMPSPInfo::Entry property;
-        if (!pDbSpInfo->getSP(propertyId, property)) {
+        if (!fAllProperties) {
+            BalanceToJSON(address, propertyId, addressObj, pRequested->second);
+            response.push_back(addressObj);
             continue;
         }
 
-        UniValue balanceObj(UniValue::VOBJ);
-        balanceObj.pushKV("propertyid", (uint64_t) propertyId);
-        balanceObj.pushKV("name", property.name);
-
-        bool nonEmptyBalance = BalanceToJSON(address, propertyId, balanceObj, property.isDivisible());
+        UniValue balances(UniValue::VARR);
+        CMPTally* addressTally = getTally(address);
+        if (addressTally != nullptr) {
+            for (uint32_t id : *addressTally) {
+                const std::pair<std::string, bool>* pProperty = lookupProperty(id);
+                if (pProperty == nullptr) {
+                    continue;
+                }
 
-        if (nonEmptyBalance) {
-            response.push_back(balanceObj);
+                UniValue balanceObj(UniValue::VOBJ);
+                balanceObj.pushKV("propertyid", (uint64_t) id);
+                balanceObj.pushKV("name", pProperty->first);
+                if (BalanceToJSON(address, id, balanceObj, pProperty->second)) {
+                    balances.push_back(balanceObj);
+                }
+            }
         }
+        addressObj.pushKV("balances", balances);
+        response.push_back(addressObj);
     }
 
     return response;
 }
 
-/** Returns all addresses that may be mine. */
-static std::set<std::string> getWalletAddresses(const JSONRPCRequest& request, bool fIncludeWatchOnly)
+static UniValue omni_getallbalancesforid(const JSONRPCRequest& request)
 {
-#ifdef ENABLE_WALLET
-    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
-    CWallet* const pwallet = wallet.get();
-#endif
+    RPCHelpMan{"omni_getallbalancesforid",
+       "\nReturns a list of token balances for a given currency or property identifier.\n"
+       "\nBalances after past blocks are retrieved from the balance history, which requires -omnibalancehistory, ordered by address, and don't include the frozen amount.\n",
+       {
+           {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::NO, "the property identifier"},
+           {"limit", RPCArg::Type::NUM, /* default */ "no limit", "the maximum number of balances to return, which returns a page"},
+           {"cursor", RPCArg::Type::STR, /* default */ "the first page", "the cursor of the page to return"},
+           {"height", RPCArg::Type::NUM, /* default */ "the current state", "the block height, after which the balances are retrieved"},
+       },
+       {
+           RPCResult{"if no limit or cursor is given",
+               RPCResult::Type::ARR, "", "",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR, "address", "the address"},
+                       {RPCResult::Type::STR_AMOUNT, "balance", "the available balance of the address"},
+                       {RPCResult::Type::STR_AMOUNT, "reserved", "the amount reserved by sell offers and accepts"},
+                       {RPCResult::Type::STR_AMOUNT, "frozen", "the amount frozen by the issuer (applies to managed properties only)"},
+                   }},
+               }
+           },
+           RPCResult{"otherwise",
+               RPCResult::Type::OBJ, "", "",
+               {
+                   {RPCResult::Type::ARR, "entries", "the balances of the page, as above", {{RPCResult::Type::ELISION, "", ""}}},
+                   {RPCResult::Type::STR, "cursor", /* optional */ true, "the cursor of the next page, if there are more balances"},
+               }
+           },
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getallbalancesforid", "1")
+           + HelpExampleCli("omni_getallbalancesforid", "1 1000")
+           + HelpExampleCli("omni_getallbalancesforid", "1 null null 650000")
+           + HelpExampleRpc("omni_getallbalancesforid", "1")
+       }
+    }.Check(request);
 
-    std::set<std::string> result;
+    uint32_t propertyId = ParsePropertyId(request.params[0]);
+    const bool fPaged = !request.params[1].isNull() || !request.params[2].isNull();
+    const size_t limit = request.params[1].isNull() ? std::numeric_limits<size_t>::max() : ParsePageLimit(request.params[1]);
+    const std::string cursor = request.params[2].isNull() ? "" : request.params[2].get_str();
 
-#ifdef ENABLE_WALLET
-    LOCK(pwallet->cs_wallet);
+    RequireExistingProperty(propertyId);
 
-    for(const auto& item : pwallet->m_address_book) {
-        const CTxDestination& address = item.first;
-        isminetype iIsMine = pwallet->IsMine(address);
+    bool isDivisible = isPropertyDivisible(propertyId); // we want to check this BEFORE the loop
 
-        if (iIsMine == ISMINE_SPENDABLE || (fIncludeWatchOnly && iIsMine != ISMINE_NO)) {
-            result.insert(EncodeDestination(address));
+    if (!request.params[3].isNull()) {
+        // the history is read from the database, without holding cs_tally
+        const int nHeight = ParseHistoryHeight(request.params[3]);
+        RequireIndexedProperty(propertyId);
+        std::vector<CBalanceHistoryEntry> entries;
+        const bool fMore = pDbBalanceHistory->GetBalances(propertyId, nHeight, cursor, limit, entries);
+
+        CRPCArrayWriter response(fPaged ? nullptr : request.resultWriter);
+        for (const CBalanceHistoryEntry& entry : entries) {
+            UniValue balanceObj(UniValue::VOBJ);
+            balanceObj.pushKV("address", entry.address);
+            BalanceToJSON(entry, balanceObj, isDivisible);
+            response.push_back(balanceObj);
+        }
+
+        if (fPaged) {
+            return PageToJSON(response.Finish(), fMore, entries.empty() ? "" : entries.back().address);
         }
+        return response.Finish();
     }
-#endif
 
-    return result;
-}
+    LOCK(cs_tally);
 
-#ifdef ENABLE_WALLET
-static UniValue omni_getwalletbalances(const JSONRPCRequest& request)
-{
+    // only addresses with a balance of the property are considered, ordered by their identifiers,
+    // and a page starts after the address of the cursor
+    const std::set<uint32_t>& holders = mp_tally_map.GetHolders(propertyId);
+    std::set<uint32_t>::const_iterator it = holders.begin();
+    if (!cursor.empty()) {
+        uint32_t cursorId = mp_tally_map.GetId(cursor);
+        if (cursorId == CMPTallyMap::INVALID_ID) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        it = holders.upper_bound(cursorId);
+    }
+
+    // all balances are written into the reply right away, while a page is returned as a whole
+    CRPCArrayWriter response(fPaged ? nullptr : request.resultWriter);
+    bool fMore = false;
+    std::string lastAddress;
+    for (; it != holders.end(); ++it) {
+        const std::string& address = mp_tally_map.GetAddress(*it);
+        UniValue balanceObj(UniValue::VOBJ);
+        balanceObj.pushKV("address", address);
+        bool nonEmptyBalance = BalanceToJSON(address, propertyId, balanceObj, isDivisible);
+
+        if (nonEmptyBalance) {
+            if (response.size() >= limit) {
+                fMore = true;
+                break;
+            }
+            response.push_back(balanceObj);
+            lastAddress = address;
+        }
+    }
+
+    if (fPaged) {
+        return PageToJSON(response.Finish(), fMore, lastAddress);
+    }
+
+    return response.Finish();
+}
+
+static UniValue omni_getpropertystats(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getpropertystats",
+       "\nReturns statistics about the holders of a property, such as the largest holders and the distribution of the holdings.\n"
+       "\nHoldings include reserved tokens. The holders of a property are ranked on the first request, and the ranking is then maintained by every balance update of the property.\n",
+       {
+           {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::NO, "the property identifier"},
+           {"top", RPCArg::Type::NUM, /* default */ "10", "the number of largest holders to return"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "propertyid", "the identifier of the property"},
+               {RPCResult::Type::NUM, "holders", "the number of addresses, which hold tokens"},
+               {RPCResult::Type::STR_AMOUNT, "totaltokens", "the number of tokens held by all addresses"},
+               {RPCResult::Type::STR_AMOUNT, "reserved", "the number of tokens reserved by offers and accepts"},
+               {RPCResult::Type::ARR, "top", "the largest holders, in descending order",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR, "address", "the address"},
+                       {RPCResult::Type::STR_AMOUNT, "tokens", "the number of tokens held by the address"},
+                   }},
+               }},
+               {RPCResult::Type::STR, "topshare", "the percentage of the tokens held by the largest holders"},
+               {RPCResult::Type::OBJ, "percentiles", "the holdings at the percentiles of the holders, in ascending order",
+               {
+                   {RPCResult::Type::STR_AMOUNT, "p25", "the holding, which 25% of the holders don't exceed"},
+                   {RPCResult::Type::STR_AMOUNT, "p50", "the median holding"},
+                   {RPCResult::Type::STR_AMOUNT, "p75", "the holding, which 75% of the holders don't exceed"},
+                   {RPCResult::Type::STR_AMOUNT, "p90", "the holding, which 90% of the holders don't exceed"},
+                   {RPCResult::Type::STR_AMOUNT, "p99", "the holding, which 99% of the holders don't exceed"},
+               }},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getpropertystats", "31")
+           + HelpExampleCli("omni_getpropertystats", "31 100")
+           + HelpExampleRpc("omni_getpropertystats", "31, 100")
+       }
+    }.Check(request);
+
+    uint32_t propertyId = ParsePropertyId(request.params[0]);
+    size_t nTop = 10;
+    if (!request.params[1].isNull()) {
+        nTop = ParsePageLimit(request.params[1]);
+    }
+
+    RequireExistingProperty(propertyId);
+
+    const bool isDivisible = isPropertyDivisible(propertyId);
+    auto formatTokens = [isDivisible](int64_t amount) {
+        return isDivisible ? FormatDivisibleMP(amount) : FormatIndivisibleMP(amount);
+    };
+
+    LOCK(cs_tally);
+
+    const std::set<std::pair<int64_t, uint32_t> >& ranked = mp_tally_map.GetRankedHolders(propertyId);
+    const int64_t nTotalTokens = mp_tally_map.GetTotalTokens(propertyId);
+
+    UniValue top(UniValue::VARR);
+    int64_t nTopTokens = 0;
+    for (auto it = ranked.rbegin(); it != ranked.rend() && top.size() < nTop; ++it) {
+        UniValue holder(UniValue::VOBJ);
+        holder.pushKV("address", mp_tally_map.GetAddress(it->second));
+        holder.pushKV("tokens", formatTokens(it->first));
+        top.push_back(holder);
+        nTopTokens += it->first;
+    }
+
+    // nearest-rank percentiles, collected in a single walk over the ascending holdings
+    static const int PERCENTILES[] = {25, 50, 75, 90, 99};
+    UniValue percentiles(UniValue::VOBJ);
+    auto it = ranked.begin();
+    size_t nIndex = 0;
+    for (int percentile : PERCENTILES) {
+        int64_t nTokens = 0;
+        if (!ranked.empty()) {
+            const size_t nRank = std::max<size_t>(1, (ranked.size() * percentile + 99) / 100);
+            for (; nIndex + 1 < nRank; ++nIndex) ++it;
+            nTokens = it->first;
+        }
+        percentiles.pushKV(strprintf("p%d", percentile), formatTokens(nTokens));
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("propertyid", (uint64_t) propertyId);
+    response.pushKV("holders", (uint64_t) ranked.size());
+    response.pushKV("totaltokens", formatTokens(nTotalTokens));
+    response.pushKV("reserved", formatTokens(mp_tally_map.GetReservedTokens(propertyId)));
+    response.pushKV("top", top);
+    // a display value only, so floating point precision is sufficient
+    response.pushKV("topshare", strprintf("%.4f%%", nTotalTokens > 0 ? double(nTopTokens) / double(nTotalTokens) * 100.0 : 0.0));
+    response.pushKV("percentiles", percentiles);
+
+    return response;
+}
+
+/** Returns the name of a tally type, which is changed by the balance changes. */
+static std::string TallyTypeToString(TallyType ttype)
+{
+    switch (ttype) {
+        case BALANCE: return "balance";
+        case SELLOFFER_RESERVE: return "sellofferreserve";
+        case ACCEPT_RESERVE: return "acceptreserve";
+        case METADEX_RESERVE: return "metadexreserve";
+        default: return "unknown";
+    }
+}
+
+static UniValue omni_getbalancehistory(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getbalancehistory",
+       "\nReturns the balance changes of an address, ordered by property and in the order they were made.\n"
+       "\nThe changes include transactions, trades, send-to-owners receipts, fee distributions and the changes made by the block processing. Requires -omnibalancechangeindex.\n",
+       {
+           {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "the address"},
+           {"propertyid", RPCArg::Type::NUM, /* default */ "all properties", "the property identifier"},
+           {"cursor", RPCArg::Type::STR, /* default */ "the first page", "the cursor of the page to return"},
+           {"limit", RPCArg::Type::NUM, /* default */ "no limit", "the maximum number of changes to return, which returns a page"},
+       },
+       {
+           RPCResult{"if no limit or cursor is given",
+               RPCResult::Type::ARR, "", "",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::NUM, "propertyid", "the property identifier"},
+                       {RPCResult::Type::NUM, "block", "the height of the block, in which the balance changed"},
+                       {RPCResult::Type::NUM, "positioninblock", /* optional */ true, "the position of the transaction in the block, if it changed the balance"},
+                       {RPCResult::Type::STR_HEX, "txid", /* optional */ true, "the hash of the transaction, if it changed the balance"},
+                       {RPCResult::Type::STR, "type", "the changed balance: balance, sellofferreserve, acceptreserve or metadexreserve"},
+                       {RPCResult::Type::STR_AMOUNT, "amount", "the signed amount of the change"},
+                       {RPCResult::Type::STR_AMOUNT, "balance", "the changed balance after the change"},
+                   }},
+               }
+           },
+           RPCResult{"otherwise",
+               RPCResult::Type::OBJ, "", "",
+               {
+                   {RPCResult::Type::ARR, "entries", "the changes of the page, as above", {{RPCResult::Type::ELISION, "", ""}}},
+                   {RPCResult::Type::STR, "cursor", /* optional */ true, "the cursor of the next page, if there are more changes"},
+               }
+           },
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getbalancehistory", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\" 1")
+           + HelpExampleCli("omni_getbalancehistory", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\" 1 \"\" 1000")
+           + HelpExampleRpc("omni_getbalancehistory", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\", 1")
+       }
+    }.Check(request);
+
+    if (!pDbBalanceChanges) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The balance change index is disabled, use -omnibalancechangeindex to enable it");
+    }
+
+    const std::string address = ParseAddress(request.params[0]);
+    const uint32_t propertyId = request.params[1].isNull() ? 0 : ParsePropertyId(request.params[1]);
+    const std::string cursor = request.params[2].isNull() ? "" : request.params[2].get_str();
+    const bool fPaged = !request.params[2].isNull() || !request.params[3].isNull();
+    const size_t limit = request.params[3].isNull() ? std::numeric_limits<size_t>::max() : ParsePageLimit(request.params[3]);
+
+    if (propertyId != 0) RequireIndexedProperty(propertyId);
+
+    // the changes are read from the database, without holding cs_tally
+    std::vector<CBalanceChangeEntry> entries;
+    std::string nextCursor;
+    if (!pDbBalanceChanges->GetChanges(address, propertyId, cursor, limit, entries, nextCursor)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+
+    CRPCArrayWriter response(fPaged ? nullptr : request.resultWriter);
+    for (const CBalanceChangeEntry& entry : entries) {
+        UniValue changeObj(UniValue::VOBJ);
+        changeObj.pushKV("propertyid", (uint64_t) entry.propertyId);
+        changeObj.pushKV("block", entry.nBlock);
+        if (!entry.txid.IsNull()) {
+            changeObj.pushKV("positioninblock", entry.nIdx);
+            changeObj.pushKV("txid", entry.txid.GetHex());
+        }
+        changeObj.pushKV("type", TallyTypeToString(entry.ttype));
+        changeObj.pushKV("amount", FormatMP(entry.propertyId, entry.nAmount, true));
+        changeObj.pushKV("balance", FormatMP(entry.propertyId, entry.nBalance));
+        response.push_back(changeObj);
+    }
+
+    if (fPaged) {
+        return PageToJSON(response.Finish(), !nextCursor.empty(), nextCursor);
+    }
+
+    return response.Finish();
+}
+
+static UniValue omni_getallbalancesforaddress(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getallbalancesforaddress",
+       "\nReturns a list of all token balances for a given address.\n",
+       {
+           {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "the address"},
+       },
+       RPCResult{
+           RPCResult::Type::ARR, "", "",
+           {
+               {RPCResult::Type::OBJ, "", "",
+               {
+                   {RPCResult::Type::NUM, "propertyid", "the property identifier"},
+                   {RPCResult::Type::STR, "name", "the name of the property"},
+                   {RPCResult::Type::STR_AMOUNT, "balance", "the available balance of the address"},
+                   {RPCResult::Type::STR_AMOUNT, "reserved", "the amount reserved by sell offers and accepts"},
+                   {RPCResult::Type::STR_AMOUNT, "frozen", "the amount frozen by the issuer (applies to managed properties only)"},
+               }},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getallbalancesforaddress", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\"")
+           + HelpExampleRpc("omni_getallbalancesforaddress", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\"")
+       }
+    }.Check(request);
+
+    std::string address = ParseAddress(request.params[0]);
+
+    UniValue response(UniValue::VARR);
+
+    std::shared_ptr<const CStateSnapshot> snapshot = GetStateSnapshot();
+    if (snapshot) {
+        const CMPTally* addressTally = snapshot->GetTally(address);
+
+        if (nullptr == addressTally) { // addressTally object does not exist
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Address not found");
+        }
+
+        for (uint32_t propertyId : *addressTally) {
+            const CStateSnapshot::PropertyInfo* pProperty = snapshot->GetProperty(propertyId);
+            if (pProperty == nullptr) {
+                continue;
+            }
+
+            UniValue balanceObj(UniValue::VOBJ);
+            balanceObj.pushKV("propertyid", (uint64_t) propertyId);
+            balanceObj.pushKV("name", pProperty->name);
+
+            bool nonEmptyBalance = BalanceToJSON(*snapshot, address, propertyId, balanceObj, pProperty->fDivisible);
+
+            if (nonEmptyBalance) {
+                response.push_back(balanceObj);
+            }
+        }
+
+        return response;
+    }
+
+    LOCK(cs_tally);
+
+    CMPTally* addressTally = getTally(address);
+
+    if (nullptr == addressTally) { // addressTally object does not exist
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Address not found");
+    }
+
+    for (uint32_t propertyId : *addressTally) {
+        CMPSPInfo::Entry property;
+        if (!pDbSpInfo->getSP(propertyId, property)) {
+            continue;
+        }
+
+        UniValue balanceObj(UniValue::VOBJ);
+        balanceObj.pushKV("propertyid", (uint64_t) propertyId);
+        balanceObj.pushKV("name", property.name);
+
+        bool nonEmptyBalance = BalanceToJSON(address, propertyId, balanceObj, property.isDivisible());
+
+        if (nonEmptyBalance) {
+            response.push_back(balanceObj);
+        }
+    }
+
+    return response;
+}
+
+/** Returns all addresses that may be mine. */
+static std::set<std::string> getWalletAddresses(const JSONRPCRequest& request, bool fIncludeWatchOnly)
+{
+#ifdef ENABLE_WALLET
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    CWallet* const pwallet = wallet.get();
+#endif
+
+    std::set<std::string> result;
+
+#ifdef ENABLE_WALLET
+    LOCK(pwallet->cs_wallet);
+
+    for(const auto& item : pwallet->m_address_book) {
+        const CTxDestination& address = item.first;
+        isminetype iIsMine = pwallet->IsMine(address);
+
+        if (iIsMine == ISMINE_SPENDABLE || (fIncludeWatchOnly && iIsMine != ISMINE_NO)) {
+            result.insert(EncodeDestination(address));
+        }
+    }
+#endif
+
+    return result;
+}
+
+#ifdef ENABLE_WALLET
+static UniValue omni_getwalletbalances(const JSONRPCRequest& request)
+{
     std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
     CWallet* const pwallet = wallet.get();
 
@@ -1250,10 +1952,7 @@ static UniValue omni_getwalletbalances(const JSONRPCRequest& request)
             continue; // address doesn't have tokens
         }
 
-        uint32_t propertyId = 0;
-        addressTally->init();
-
-        while (0 != (propertyId = addressTally->next())) {
+        for (uint32_t propertyId : *addressTally) {
             int64_t nAvailable = GetAvailableTokenBalance(address, propertyId);
             int64_t nReserved = GetReservedTokenBalance(address, propertyId);
             int64_t nFrozen = GetFrozenTokenBalance(address, propertyId);
@@ -1368,10 +2067,7 @@ static UniValue omni_getwalletaddressbalances(const JSONRPCRequest& request)
         }
 
         UniValue arrBalances(UniValue::VARR);
-        uint32_t propertyId = 0;
-        addressTally->init();
-
-        while (0 != (propertyId = addressTally->next())) {
+        for (uint32_t propertyId : *addressTally) {
             CMPSPInfo::Entry property;
             if (!pDbSpInfo->getSP(propertyId, property)) {
                 continue; // token wasn't found in the DB
@@ -1465,61 +2161,95 @@ static UniValue omni_listproperties(const JSONRPCRequest& request)
 {
     RPCHelpMan{"omni_listproperties",
        "\nLists all tokens or smart properties. To get the total number of tokens, please use omni_getproperty.\n",
-       {},
-       RPCResult{
-           RPCResult::Type::ARR, "", "",
-           {
-               {RPCResult::Type::OBJ, "", "",
+       {
+           {"limit", RPCArg::Type::NUM, /* default */ "no limit", "the maximum number of properties to return, which returns a page"},
+           {"cursor", RPCArg::Type::STR, /* default */ "the first page", "the cursor of the page to return"},
+           {"ecosystem", RPCArg::Type::NUM, /* default */ "any ecosystem", "only list properties of the ecosystem (1 for main, 2 for test)"},
+           {"type", RPCArg::Type::NUM, /* default */ "any type", "only list properties of the type (1 for indivisible, 2 for divisible)"},
+           {"issuer", RPCArg::Type::STR, /* default */ "any issuer", "only list properties of the issuer"},
+       },
+       {
+           RPCResult{"if no limit or cursor is given",
+               RPCResult::Type::ARR, "", "",
                {
-                    {RPCResult::Type::NUM, "propertyid", "the identifier of the tokens"},
-                    {RPCResult::Type::STR, "name", "the name of the tokens"},
-                    {RPCResult::Type::STR, "category", "the category used for the tokens"},
-                    {RPCResult::Type::STR, "subcategory", "the subcategory used for the tokens"},
-                    {RPCResult::Type::STR, "data", "additional information or a description"},
-                    {RPCResult::Type::STR, "url", "a URI, for example pointing to a website"},
-                    {RPCResult::Type::BOOL, "divisible", "whether the tokens are divisible"},
-                    {RPCResult::Type::STR, "issuer", "the Bitcoin address of the issuer on record"},
-                    {RPCResult::Type::STR_HEX, "creationtxid", "the hex-encoded creation transaction hash"},
-                    {RPCResult::Type::BOOL, "fixedissuance", "whether the token supply is fixed"},
-                    {RPCResult::Type::BOOL, "managedissuance", "whether the token supply is managed"},
-               }},
-           }
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                        {RPCResult::Type::NUM, "propertyid", "the identifier of the tokens"},
+                        {RPCResult::Type::STR, "name", "the name of the tokens"},
+                        {RPCResult::Type::STR, "category", "the category used for the tokens"},
+                        {RPCResult::Type::STR, "subcategory", "the subcategory used for the tokens"},
+                        {RPCResult::Type::STR, "data", "additional information or a description"},
+                        {RPCResult::Type::STR, "url", "a URI, for example pointing to a website"},
+                        {RPCResult::Type::BOOL, "divisible", "whether the tokens are divisible"},
+                        {RPCResult::Type::STR, "issuer", "the Bitcoin address of the issuer on record"},
+                        {RPCResult::Type::STR_HEX, "creationtxid", "the hex-encoded creation transaction hash"},
+                        {RPCResult::Type::BOOL, "fixedissuance", "whether the token supply is fixed"},
+                        {RPCResult::Type::BOOL, "managedissuance", "whether the token supply is managed"},
+                   }},
+               }
+           },
+           RPCResult{"otherwise",
+               RPCResult::Type::OBJ, "", "",
+               {
+                   {RPCResult::Type::ARR, "entries", "the properties of the page, as above", {{RPCResult::Type::ELISION, "", ""}}},
+                   {RPCResult::Type::STR, "cursor", /* optional */ true, "the cursor of the next page, if there are more properties"},
+               }
+           },
        },
        RPCExamples{
            HelpExampleCli("omni_listproperties", "")
+           + HelpExampleCli("omni_listproperties", "100")
+           + HelpExampleCli("omni_listproperties", "null null 1 2")
            + HelpExampleRpc("omni_listproperties", "")
        }
     }.Check(request);
 
-    UniValue response(UniValue::VARR);
+    const bool fPaged = !request.params[0].isNull() || !request.params[1].isNull();
+    const size_t limit = request.params[0].isNull() ? std::numeric_limits<size_t>::max() : ParsePageLimit(request.params[0]);
+    // a page starts after the property of the cursor
+    const int64_t propertyIdAfter = request.params[1].isNull() ? 0 : ParseNumericCursor(request.params[1].get_str());
 
-    LOCK(cs_tally);
+    const uint8_t ecosystem = request.params[2].isNull() ? 0 : ParseEcosystem(request.params[2]);
+    const uint16_t propertyType = request.params[3].isNull() ? 0 : ParsePropertyType(request.params[3]);
+    const std::string issuer = request.params[4].isNull() ? "" : ParseAddress(request.params[4]);
 
-    uint32_t nextSPID = pDbSpInfo->peekNextSPID(1);
-    for (uint32_t propertyId = 1; propertyId < nextSPID; propertyId++) {
-        CMPSPInfo::Entry sp;
-        if (pDbSpInfo->getSP(propertyId, sp)) {
-            UniValue propertyObj(UniValue::VOBJ);
-            propertyObj.pushKV("propertyid", (uint64_t) propertyId);
-            PropertyToJSON(sp, propertyObj); // name, category, subcategory, ...
+    // the listings are kept in memory, and a snapshot of them is used without locks
+    std::shared_ptr<const CMPSPInfo::ListingTable> listings;
+    {
+        LOCK(cs_tally);
+        listings = pDbSpInfo->getListings();
+    }
 
-            response.push_back(propertyObj);
+    // all properties are written into the reply right away, while a page is returned as a whole
+    CRPCArrayWriter response(fPaged ? nullptr : request.resultWriter);
+    bool fMore = false;
+    uint32_t lastPropertyId = 0;
+
+    auto it = listings->upper_bound(static_cast<uint32_t>(std::min<int64_t>(propertyIdAfter, std::numeric_limits<uint32_t>::max())));
+    for (; it != listings->end(); ++it) {
+        const uint32_t propertyId = it->first;
+        const CMPSPInfo::Listing& sp = *it->second;
+        if (ecosystem && (isTestEcosystemProperty(propertyId) ? OMNI_PROPERTY_TMSC : OMNI_PROPERTY_MSC) != ecosystem) continue;
+        if (propertyType && sp.isDivisible() != (propertyType == MSC_PROPERTY_TYPE_DIVISIBLE)) continue;
+        if (!issuer.empty() && sp.issuer != issuer) continue;
+
+        if (response.size() >= limit) {
+            fMore = true;
+            break;
         }
-    }
+        UniValue propertyObj(UniValue::VOBJ);
+        propertyObj.pushKV("propertyid", (uint64_t) propertyId);
+        PropertyToJSON(sp, propertyObj); // name, category, subcategory, ...
 
-    uint32_t nextTestSPID = pDbSpInfo->peekNextSPID(2);
-    for (uint32_t propertyId = TEST_ECO_PROPERTY_1; propertyId < nextTestSPID; propertyId++) {
-        CMPSPInfo::Entry sp;
-        if (pDbSpInfo->getSP(propertyId, sp)) {
-            UniValue propertyObj(UniValue::VOBJ);
-            propertyObj.pushKV("propertyid", (uint64_t) propertyId);
-            PropertyToJSON(sp, propertyObj); // name, category, subcategory, ...
+        response.push_back(propertyObj);
+        lastPropertyId = propertyId;
+    }
 
-            response.push_back(propertyObj);
-        }
+    if (fPaged) {
+        return PageToJSON(response.Finish(), fMore, std::to_string(lastPropertyId));
     }
 
-    return response;
+    return response.Finish();
 }
 
 static UniValue omni_getcrowdsale(const JSONRPCRequest& request)
@@ -1583,22 +2313,8 @@ static UniValue omni_getcrowdsale(const JSONRPCRequest& request)
         }
     }
 
-    const uint256& creationHash = sp.txid;
-
-    bool f_txindex_ready = false;
-    if (g_txindex) {
-        f_txindex_ready = g_txindex->BlockUntilSyncedToCurrentChain();
-    }
-
-    CTransactionRef tx;
-    uint256 hashBlock;
-    if (!GetTransaction(creationHash, tx, Params().GetConsensus(), hashBlock)) {
-        if (!f_txindex_ready) {
-            PopulateFailure(MP_TXINDEX_STILL_SYNCING);
-        } else {
-            PopulateFailure(MP_TX_NOT_FOUND);
-        }
-    }
+    // the block of the creation is recorded, so the transaction isn't retrieved
+    const uint256& hashBlock = sp.creation_block;
 
     UniValue response(UniValue::VOBJ);
     bool active = isCrowdsaleActive(propertyId);
@@ -1620,7 +2336,8 @@ static UniValue omni_getcrowdsale(const JSONRPCRequest& request)
             throw JSONRPCError(RPC_INTERNAL_ERROR, "Crowdsale is flagged active but cannot be retrieved");
         }
     } else {
-        database = sp.historicalData;
+        LOCK(cs_tally);
+        pDbSpInfo->getHistoricalData(propertyId, database);
     }
 
     int64_t tokensIssued = getTotalTokens(propertyId);
@@ -1723,22 +2440,8 @@ static UniValue omni_getactivecrowdsales(const JSONRPCRequest& request)
             continue;
         }
 
-        const uint256& creationHash = sp.txid;
-
-        bool f_txindex_ready = false;
-        if (g_txindex) {
-            f_txindex_ready = g_txindex->BlockUntilSyncedToCurrentChain();
-        }
-
-        CTransactionRef tx;
-        uint256 hashBlock;
-        if (!GetTransaction(creationHash, tx, Params().GetConsensus(), hashBlock)) {
-            if (!f_txindex_ready) {
-                PopulateFailure(MP_TXINDEX_STILL_SYNCING);
-            } else {
-                PopulateFailure(MP_TX_NOT_FOUND);
-            }
-        }
+        // the block of the creation is recorded, so the transaction isn't retrieved
+        const uint256& hashBlock = sp.creation_block;
 
         int64_t startTime = -1;
         if (!hashBlock.IsNull() && GetBlockIndex(hashBlock)) {
@@ -1808,6 +2511,7 @@ static UniValue omni_getgrants(const JSONRPCRequest& request)
         if (false == pDbSpInfo->getSP(propertyId, sp)) {
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Property identifier does not exist");
         }
+        pDbSpInfo->getHistoricalData(propertyId, sp.historicalData);
     }
     UniValue response(UniValue::VOBJ);
     const uint256& creationHash = sp.txid;
@@ -1847,16 +2551,213 @@ static UniValue omni_getgrants(const JSONRPCRequest& request)
     return response;
 }
 
-static UniValue omni_getorderbook(const JSONRPCRequest& request)
+/** Position of an order in the orderbook of a property for sale, after which a page starts. */
+struct OrderbookCursor
 {
-    RPCHelpMan{"omni_getorderbook",
-       "\nList active offers on the distributed token exchange.\n",
-       {
-           {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::NO, "filter orders by property identifier for sale"},
-           {"propertyiddesired", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "filter orders by property identifier desired"},
-       },
-       RPCResult{
-           RPCResult::Type::ARR, "", "",
+    uint32_t propertyIdDesired = 0;
+    rational_t price;
+    int block = 0;
+    unsigned int idx = 0;
+};
+
+/** Returns the cursor of an order: the property desired, the unit price, the block and the position in the block. */
+static std::string OrderbookCursorToString(const CMPMetaDEx& order)
+{
+    const rational_t price = order.unitPrice();
+    return strprintf("%d:%s:%s:%d:%d", order.getDesProperty(), price.numerator().str(), price.denominator().str(), order.getBlock(), order.getIdx());
+}
+
+static OrderbookCursor ParseOrderbookCursor(const std::string& str)
+{
+    std::vector<std::string> vstr;
+    boost::split(vstr, str, boost::is_any_of(":"));
+
+    OrderbookCursor cursor;
+    int64_t propertyIdDesired = 0;
+    int64_t block = 0;
+    int64_t idx = 0;
+    if (vstr.size() != 5 || !ParseInt64(vstr[0], &propertyIdDesired) || !ParseInt64(vstr[3], &block) || !ParseInt64(vstr[4], &idx) ||
+            propertyIdDesired < 0 || propertyIdDesired > std::numeric_limits<uint32_t>::max() ||
+            block < 0 || block > std::numeric_limits<int>::max() || idx < 0 || idx > std::numeric_limits<unsigned int>::max()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    try {
+        boost::multiprecision::checked_int128_t numerator(vstr[1]);
+        boost::multiprecision::checked_int128_t denominator(vstr[2]);
+        cursor.price = rational_t(numerator, denominator);
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    cursor.propertyIdDesired = propertyIdDesired;
+    cursor.block = block;
+    cursor.idx = idx;
+
+    return cursor;
+}
+
+/** Adds the orders of a property pair after the cursor to a page, and returns false, once the page is full. */
+static bool AddOrdersToPage(const md_PricesMap& prices, bool fCursorPair, const OrderbookCursor& cursor, size_t limit, std::vector<CMPMetaDEx>& vOrders)
+{
+    md_PricesMap::const_iterator it = fCursorPair ? prices.lower_bound(cursor.price) : prices.begin();
+    for (; it != prices.end(); ++it) {
+        const md_Set& indexes = it->second;
+        const bool fCursorPrice = fCursorPair && it->first == cursor.price;
+        for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
+            if (fCursorPrice && std::make_pair(it->getBlock(), it->getIdx()) <= std::make_pair(cursor.block, cursor.idx)) {
+                continue;
+            }
+            if (vOrders.size() >= limit) {
+                return false;
+            }
+            vOrders.push_back(*it);
+        }
+    }
+    return true;
+}
+
+/** Returns the aggregated orders of the lowest price levels of a property pair in a snapshot. */
+static std::vector<std::pair<rational_t, md_DepthLevel> > GetDepth(const CStateSnapshot& snapshot, uint32_t propertyForSale, uint32_t propertyDesired, size_t nLevels)
+{
+    std::vector<std::pair<rational_t, md_DepthLevel> > vLevels;
+    const md_PricesMap* pPrices = snapshot.GetOrders(propertyForSale, propertyDesired);
+    if (pPrices == nullptr) return vLevels;
+
+    for (md_PricesMap::const_iterator it = pPrices->begin(); it != pPrices->end() && vLevels.size() < nLevels; ++it) {
+        md_DepthLevel level;
+        for (const CMPMetaDEx& order : it->second) {
+            level.amountRemaining += order.getAmountRemaining();
+            ++level.orders;
+        }
+        vLevels.push_back(std::make_pair(it->first, level));
+    }
+    return vLevels;
+}
+
+/** Throws, if a property doesn't exist in the snapshot, or in the current state, if there is no snapshot. */
+static void RequireExistingProperty(const CStateSnapshot* pSnapshot, uint32_t propertyId)
+{
+    if (pSnapshot == nullptr) {
+        RequireExistingProperty(propertyId);
+    } else if (pSnapshot->GetProperty(propertyId) == nullptr) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Property identifier does not exist");
+    }
+}
+
+static UniValue omni_getorderbook(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getorderbook",
+       "\nList active offers on the distributed token exchange.\n",
+       {
+           {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::NO, "filter orders by property identifier for sale"},
+           {"propertyiddesired", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "filter orders by property identifier desired"},
+           {"limit", RPCArg::Type::NUM, /* default */ "no limit", "the maximum number of orders to return, which returns a page"},
+           {"cursor", RPCArg::Type::STR, /* default */ "the first page", "the cursor of the page to return"},
+       },
+       {
+           RPCResult{"if no limit or cursor is given",
+               RPCResult::Type::ARR, "", "",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                        {RPCResult::Type::STR, "address", "the Bitcoin address of the trader"},
+                        {RPCResult::Type::STR_HEX, "txid", "the hex-encoded hash of the transaction of the order"},
+                        {RPCResult::Type::STR, "ecosystem", "the ecosytem in which the order was made (if \"cancel-ecosystem\")"},
+                        {RPCResult::Type::NUM, "propertyidforsale", "the identifier of the tokens put up for sale"},
+                        {RPCResult::Type::BOOL, "propertyidforsaleisdivisible", "whether the tokens for sale are divisible"},
+                        {RPCResult::Type::STR_AMOUNT, "amountforsale", "the amount of tokens initially offered"},
+                        {RPCResult::Type::STR_AMOUNT, "amountremaining", "the amount of tokens still up for sale"},
+                        {RPCResult::Type::NUM, "propertyiddesired", "the identifier of the tokens desired in exchange"},
+                        {RPCResult::Type::BOOL, "propertyiddesiredisdivisible", "whether the desired tokens are divisible"},
+                        {RPCResult::Type::STR_AMOUNT, "amountdesired", "the amount of tokens initially desired"},
+                        {RPCResult::Type::STR_AMOUNT, "amounttofill", "the amount of tokens still needed to fill the offer completely"},
+                        {RPCResult::Type::NUM, "action", "the action of the transaction: (1) \"trade\", (2) \"cancel-price\", (3) \"cancel-pair\", (4) \"cancel-ecosystem\""},
+                        {RPCResult::Type::NUM, "block", "the index of the block that contains the transaction"},
+                        {RPCResult::Type::NUM, "blocktime", "the timestamp of the block that contains the transaction"},
+                   }},
+               }
+           },
+           RPCResult{"otherwise",
+               RPCResult::Type::OBJ, "", "",
+               {
+                   {RPCResult::Type::ARR, "entries", "the orders of the page, as above", {{RPCResult::Type::ELISION, "", ""}}},
+                   {RPCResult::Type::STR, "cursor", /* optional */ true, "the cursor of the next page, if there are more orders"},
+               }
+           },
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getorderbook", "2")
+           + HelpExampleCli("omni_getorderbook", "2 null 500")
+           + HelpExampleRpc("omni_getorderbook", "2")
+       }
+    }.Check(request);
+
+    bool filterDesired = !request.params[1].isNull();
+    uint32_t propertyIdForSale = ParsePropertyId(request.params[0]);
+    uint32_t propertyIdDesired = 0;
+    const bool fPaged = !request.params[2].isNull() || !request.params[3].isNull();
+    const size_t limit = request.params[2].isNull() ? std::numeric_limits<size_t>::max() : ParsePageLimit(request.params[2]);
+    const bool fCursor = !request.params[3].isNull();
+    OrderbookCursor cursor;
+    if (fCursor) cursor = ParseOrderbookCursor(request.params[3].get_str());
+
+    // the orders are read from the snapshot, so concurrent calls don't wait for each other or the block processing
+    std::shared_ptr<const CStateSnapshot> snapshot = GetStateSnapshot();
+
+    RequireExistingProperty(snapshot.get(), propertyIdForSale);
+
+    if (filterDesired) {
+        propertyIdDesired = ParsePropertyId(request.params[1]);
+
+        RequireExistingProperty(snapshot.get(), propertyIdDesired);
+        RequireSameEcosystem(propertyIdForSale, propertyIdDesired);
+        RequireDifferentIds(propertyIdForSale, propertyIdDesired);
+    }
+
+    // the pairs are ordered by the property for sale, so only the relevant pairs are visited,
+    // and a page starts after the order of the cursor
+    const md_PropertyPair firstPair(propertyIdForSale, std::max(filterDesired ? propertyIdDesired : 0, fCursor ? cursor.propertyIdDesired : 0));
+    const md_PropertyPair lastPair(propertyIdForSale, filterDesired ? propertyIdDesired : std::numeric_limits<uint32_t>::max());
+
+    std::vector<CMPMetaDEx> vecMetaDexObjects;
+    bool fMore = false;
+
+    if (snapshot) {
+        const CStateSnapshot::OrderBook& orderBook = *snapshot->pOrderBook;
+        CStateSnapshot::OrderBook::const_iterator my_it = orderBook.lower_bound(firstPair);
+        CStateSnapshot::OrderBook::const_iterator pairsEnd = orderBook.upper_bound(lastPair);
+        for (; my_it != pairsEnd && !fMore; ++my_it) {
+            const bool fCursorPair = fCursor && my_it->first.second == cursor.propertyIdDesired;
+            fMore = !AddOrdersToPage(*my_it->second, fCursorPair, cursor, limit, vecMetaDexObjects);
+        }
+    } else {
+        LOCK(cs_tally);
+        md_PropertiesMap::const_iterator my_it = metadex.lower_bound(firstPair);
+        md_PropertiesMap::const_iterator pairsEnd = metadex.upper_bound(lastPair);
+        for (; my_it != pairsEnd && !fMore; ++my_it) {
+            const bool fCursorPair = fCursor && my_it->first.second == cursor.propertyIdDesired;
+            fMore = !AddOrdersToPage(my_it->second, fCursorPair, cursor, limit, vecMetaDexObjects);
+        }
+    }
+
+    UniValue response(UniValue::VARR);
+    MetaDexObjectsToJSON(vecMetaDexObjects, response);
+
+    if (fPaged) {
+        return PageToJSON(response, fMore, vecMetaDexObjects.empty() ? "" : OrderbookCursorToString(vecMetaDexObjects.back()));
+    }
+
+    return response;
+}
+
+static UniValue omni_getopenorders(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getopenorders",
+       "\nList the active offers of an address on the distributed token exchange.\n",
+       {
+           {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "the address of the trader"},
+       },
+       RPCResult{
+           RPCResult::Type::ARR, "", "",
            {
                {RPCResult::Type::OBJ, "", "",
                {
@@ -1878,39 +2779,17 @@ static UniValue omni_getorderbook(const JSONRPCRequest& request)
            }
        },
        RPCExamples{
-           HelpExampleCli("omni_getorderbook", "2")
-           + HelpExampleRpc("omni_getorderbook", "2")
+           HelpExampleCli("omni_getopenorders", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\"")
+           + HelpExampleRpc("omni_getopenorders", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\"")
        }
     }.Check(request);
 
-    bool filterDesired = (request.params.size() > 1);
-    uint32_t propertyIdForSale = ParsePropertyId(request.params[0]);
-    uint32_t propertyIdDesired = 0;
-
-    RequireExistingProperty(propertyIdForSale);
-
-    if (filterDesired) {
-        propertyIdDesired = ParsePropertyId(request.params[1]);
-
-        RequireExistingProperty(propertyIdDesired);
-        RequireSameEcosystem(propertyIdForSale, propertyIdDesired);
-        RequireDifferentIds(propertyIdForSale, propertyIdDesired);
-    }
+    std::string address = ParseAddress(request.params[0]);
 
     std::vector<CMPMetaDEx> vecMetaDexObjects;
     {
         LOCK(cs_tally);
-        for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-            const md_PricesMap& prices = my_it->second;
-            for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
-                const md_Set& indexes = it->second;
-                for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                    const CMPMetaDEx& obj = *it;
-                    if (obj.getProperty() != propertyIdForSale) continue;
-                    if (!filterDesired || obj.getDesProperty() == propertyIdDesired) vecMetaDexObjects.push_back(obj);
-                }
-            }
-        }
+        vecMetaDexObjects = MetaDEx_getOpenOrders(address);
     }
 
     UniValue response(UniValue::VARR);
@@ -1918,6 +2797,95 @@ static UniValue omni_getorderbook(const JSONRPCRequest& request)
     return response;
 }
 
+static UniValue omni_getorderbookdepth(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getorderbookdepth",
+       "\nReturns the aggregated active offers of a market on the distributed token exchange by price.\n"
+       "\nAll prices are unit prices of the first property, expressed in units of the second property.\n",
+       {
+           {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::NO, "the first side of the traded pair"},
+           {"propertyidsecond", RPCArg::Type::NUM, RPCArg::Optional::NO, "the second side of the traded pair"},
+           {"levels", RPCArg::Type::NUM, /* default */ "10", "the maximal number of price levels per side"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::ARR, "asks", "the offers selling the first property, lowest price first",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR, "unitprice", "the unit price of the offers"},
+                       {RPCResult::Type::STR_AMOUNT, "amountforsale", "the total amount of the first property still up for sale"},
+                       {RPCResult::Type::NUM, "orders", "the number of offers"},
+                   }},
+               }},
+               {RPCResult::Type::ARR, "bids", "the offers selling the second property, highest price first",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR, "unitprice", "the unit price of the offers"},
+                       {RPCResult::Type::STR_AMOUNT, "amountforsale", "the total amount of the second property still up for sale"},
+                       {RPCResult::Type::NUM, "orders", "the number of offers"},
+                   }},
+               }},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getorderbookdepth", "3 1 20")
+           + HelpExampleRpc("omni_getorderbookdepth", "3, 1, 20")
+       }
+    }.Check(request);
+
+    uint32_t propertyIdSideA = ParsePropertyId(request.params[0]);
+    uint32_t propertyIdSideB = ParsePropertyId(request.params[1]);
+    int64_t levels = (request.params.size() > 2) ? request.params[2].get_int64() : 10;
+
+    std::shared_ptr<const CStateSnapshot> snapshot = GetStateSnapshot();
+
+    RequireExistingProperty(snapshot.get(), propertyIdSideA);
+    RequireExistingProperty(snapshot.get(), propertyIdSideB);
+    RequireSameEcosystem(propertyIdSideA, propertyIdSideB);
+    RequireDifferentIds(propertyIdSideA, propertyIdSideB);
+    if (levels < 1) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Number of levels must be positive");
+    }
+
+    std::vector<std::pair<rational_t, md_DepthLevel> > vAsks;
+    std::vector<std::pair<rational_t, md_DepthLevel> > vBids;
+    if (snapshot) {
+        vAsks = GetDepth(*snapshot, propertyIdSideA, propertyIdSideB, levels);
+        vBids = GetDepth(*snapshot, propertyIdSideB, propertyIdSideA, levels);
+    } else {
+        LOCK(cs_tally);
+        vAsks = MetaDEx_getDepth(propertyIdSideA, propertyIdSideB, levels);
+        vBids = MetaDEx_getDepth(propertyIdSideB, propertyIdSideA, levels);
+    }
+
+    UniValue asks(UniValue::VARR);
+    for (const std::pair<rational_t, md_DepthLevel>& level : vAsks) {
+        UniValue levelObj(UniValue::VOBJ);
+        levelObj.pushKV("unitprice", xToFullUnitPriceString(level.first, propertyIdSideA, propertyIdSideB));
+        levelObj.pushKV("amountforsale", FormatMP(propertyIdSideA, level.second.amountRemaining));
+        levelObj.pushKV("orders", level.second.orders);
+        asks.push_back(levelObj);
+    }
+
+    // the unit prices of the offers selling the second property are inverted, so the best offers come first
+    UniValue bids(UniValue::VARR);
+    for (const std::pair<rational_t, md_DepthLevel>& level : vBids) {
+        UniValue levelObj(UniValue::VOBJ);
+        levelObj.pushKV("unitprice", xToFullUnitPriceString(rational_t(1) / level.first, propertyIdSideA, propertyIdSideB));
+        levelObj.pushKV("amountforsale", FormatMP(propertyIdSideB, level.second.amountRemaining));
+        levelObj.pushKV("orders", level.second.orders);
+        bids.push_back(levelObj);
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("asks", asks);
+    response.pushKV("bids", bids);
+    return response;
+}
+
 static UniValue omni_gettradehistoryforaddress(const JSONRPCRequest& request)
 {
 #ifdef ENABLE_WALLET
@@ -1987,14 +2955,13 @@ static UniValue omni_gettradehistoryforaddress(const JSONRPCRequest& request)
     if (request.params.size() > 2) {
         propertyId = ParsePropertyId(request.params[2]);
         RequireExistingProperty(propertyId);
+        RequireIndexedProperty(propertyId);
     }
 
     // Obtain a sorted vector of txids for the address trade history
+    // the trade history is read from the snapshot of the last block, without blocking block processing
     std::vector<uint256> vecTransactions;
-    {
-        LOCK(cs_tally);
-        pDbTradeList->getTradesForAddress(address, vecTransactions, propertyId);
-    }
+    pDbTradeList->getTradesForAddress(address, vecTransactions, propertyId);
 
     // Populate the address trade history into JSON objects until we have processed count transactions
     UniValue response(UniValue::VARR);
@@ -2053,12 +3020,13 @@ static UniValue omni_gettradehistoryforpair(const JSONRPCRequest& request)
     RequireExistingProperty(propertyIdSideB);
     RequireSameEcosystem(propertyIdSideA, propertyIdSideB);
     RequireDifferentIds(propertyIdSideA, propertyIdSideB);
+    // trades are indexed, if one of the properties is
+    if (!IsIndexedProperty(propertyIdSideB)) RequireIndexedProperty(propertyIdSideA);
 
-    // request pair trade history from trade db
-    UniValue response(UniValue::VARR);
-    LOCK(cs_tally);
-    pDbTradeList->getTradesForPair(propertyIdSideA, propertyIdSideB, response, count);
-    return response;
+    // request pair trade history from trade db, and write the trades into the reply right away
+    CRPCArrayWriter response(request.resultWriter);
+    pDbTradeList->getTradesForPair(propertyIdSideA, propertyIdSideB, [&response](const UniValue& trade) { response.push_back(trade); }, count);
+    return response.Finish();
 }
 
 static UniValue omni_getactivedexsells(const JSONRPCRequest& request)
@@ -2116,9 +3084,7 @@ static UniValue omni_getactivedexsells(const JSONRPCRequest& request)
 
     for (OfferMap::iterator it = my_offers.begin(); it != my_offers.end(); ++it) {
         const CMPOffer& selloffer = it->second;
-        std::vector<std::string> vstr;
-        boost::split(vstr, it->first, boost::is_any_of("-"), boost::token_compress_on);
-        std::string seller = vstr[0];
+        const std::string& seller = it->first.seller;
 
         // filtering
         if (!addressFilter.empty() && seller != addressFilter) continue;
@@ -2160,15 +3126,13 @@ static UniValue omni_getactivedexsells(const JSONRPCRequest& request)
         // display info about accepts related to sell
         responseObj.pushKV("amountaccepted", FormatMP(propertyId, amountAccepted));
         UniValue acceptsMatched(UniValue::VARR);
-        for (AcceptMap::const_iterator ait = my_accepts.begin(); ait != my_accepts.end(); ++ait) {
+        for (const CDExAcceptKey& acceptKey : my_accepts.GetSellerAccepts(seller)) {
             UniValue matchedAccept(UniValue::VOBJ);
-            const CMPAccept& accept = ait->second;
-            const std::string& acceptCombo = ait->first;
+            const CMPAccept& accept = my_accepts.find(acceptKey)->second;
 
             // does this accept match the sell?
             if (accept.getHash() == selloffer.getHash()) {
-                // split acceptCombo out to get the buyer address
-                std::string buyer = acceptCombo.substr((acceptCombo.find("+") + 1), (acceptCombo.size()-(acceptCombo.find("+") + 1)));
+                const std::string& buyer = acceptKey.buyer;
                 int blockOfAccept = accept.getAcceptBlock();
                 int blocksLeftToPay = (blockOfAccept + selloffer.getBlockTimeLimit()) - curBlock;
                 int64_t amountAccepted = accept.getAcceptAmountRemaining();
@@ -2213,6 +3177,7 @@ static UniValue omni_listblocktransactions(const JSONRPCRequest& request)
     int blockHeight = request.params[0].get_int();
 
     RequireHeightInChain(blockHeight);
+    RequireUnprunedHistory(blockHeight);
 
     // next let's obtain the block for this height
     CBlock block;
@@ -2220,7 +3185,7 @@ static UniValue omni_listblocktransactions(const JSONRPCRequest& request)
         LOCK(cs_main);
         CBlockIndex* pBlockIndex = ::ChainActive()[blockHeight];
 
-        if (!ReadBlockFromDisk(block, pBlockIndex, Params().GetConsensus())) {
+        if (!ReadBlockMapped(block, pBlockIndex, Params().GetConsensus())) {
             throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to read block from disk");
         }
     }
@@ -2266,6 +3231,8 @@ static UniValue omni_listblockstransactions(const JSONRPCRequest& request)
     int blockFirst = request.params[0].get_int();
     int blockLast = request.params[1].get_int();
 
+    RequireUnprunedHistory(blockFirst);
+
     std::set<uint256> txs;
     UniValue response(UniValue::VARR);
 
@@ -2281,6 +3248,209 @@ static UniValue omni_listblockstransactions(const JSONRPCRequest& request)
     return response;
 }
 
+/** Returns the name of the role of an address in a transaction. */
+static std::string AddressTxRoleToString(AddressTxRole role)
+{
+    switch (role) {
+        case ADDRESS_ROLE_SENDER: return "sender";
+        case ADDRESS_ROLE_RECEIVER: return "receiver";
+        case ADDRESS_ROLE_STO_RECIPIENT: return "storecipient";
+        case ADDRESS_ROLE_TRADE_COUNTERPARTY: return "tradecounterparty";
+        default: return "unknown";
+    }
+}
+
+static UniValue omni_listaddresstransactions(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_listaddresstransactions",
+       "\nLists the Omni transactions of any address, in the order of the chain.\n"
+       "\nThe address is listed as sender or reference receiver of a transaction, as recipient of a send-to-owners transaction, or as counterparty of a trade executed by a transaction. Requires -omniaddressindex.\n",
+       {
+           {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "the address"},
+           {"cursor", RPCArg::Type::STR, /* default */ "the first page", "the cursor of the page to return"},
+           {"limit", RPCArg::Type::NUM, /* default */ "no limit", "the maximum number of transactions to return, which returns a page"},
+       },
+       {
+           RPCResult{"if no limit or cursor is given",
+               RPCResult::Type::ARR, "", "",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR_HEX, "txid", "the hash of the transaction"},
+                       {RPCResult::Type::NUM, "block", "the height of the block of the transaction"},
+                       {RPCResult::Type::NUM, "positioninblock", "the position of the transaction in the block"},
+                       {RPCResult::Type::STR, "role", "the role of the address: sender, receiver, storecipient or tradecounterparty"},
+                   }},
+               }
+           },
+           RPCResult{"otherwise",
+               RPCResult::Type::OBJ, "", "",
+               {
+                   {RPCResult::Type::ARR, "entries", "the transactions of the page, as above", {{RPCResult::Type::ELISION, "", ""}}},
+                   {RPCResult::Type::STR, "cursor", /* optional */ true, "the cursor of the next page, if there are more transactions"},
+               }
+           },
+       },
+       RPCExamples{
+           HelpExampleCli("omni_listaddresstransactions", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\"")
+           + HelpExampleCli("omni_listaddresstransactions", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\" \"\" 1000")
+           + HelpExampleRpc("omni_listaddresstransactions", "\"1EXoDusjGwvnjZUyKkxZ4UHEf77z6A5S4P\"")
+       }
+    }.Check(request);
+
+    if (!pDbAddressIndex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The address index is disabled, use -omniaddressindex to enable it");
+    }
+
+    const std::string address = ParseAddress(request.params[0]);
+    const std::string cursor = request.params[1].isNull() ? "" : request.params[1].get_str();
+    const bool fPaged = !request.params[1].isNull() || !request.params[2].isNull();
+    const size_t limit = request.params[2].isNull() ? std::numeric_limits<size_t>::max() : ParsePageLimit(request.params[2]);
+
+    // the transactions are read from the database, without holding cs_tally
+    std::vector<CAddressTxEntry> entries;
+    std::string nextCursor;
+    if (!pDbAddressIndex->GetTransactions(address, cursor, limit, entries, nextCursor)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+
+    CRPCArrayWriter response(fPaged ? nullptr : request.resultWriter);
+    for (const CAddressTxEntry& entry : entries) {
+        UniValue txObj(UniValue::VOBJ);
+        txObj.pushKV("txid", entry.txid.GetHex());
+        txObj.pushKV("block", entry.nBlock);
+        txObj.pushKV("positioninblock", entry.nIdx);
+        txObj.pushKV("role", AddressTxRoleToString(entry.role));
+        response.push_back(txObj);
+    }
+
+    if (fPaged) {
+        return PageToJSON(response.Finish(), !nextCursor.empty(), nextCursor);
+    }
+
+    return response.Finish();
+}
+
+static UniValue omni_getblock(const JSONRPCRequest& request)
+{
+#ifdef ENABLE_WALLET
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    std::unique_ptr<interfaces::Wallet> pWallet = interfaces::MakeWallet(wallet);
+#else
+    std::unique_ptr<interfaces::Wallet> pWallet;
+#endif
+
+    RPCHelpMan{"omni_getblock",
+       "\nReturns a block and its Omni transactions.\n"
+       "\nWith verbosity 1 the hashes of the Omni transactions are returned, with verbosity 2 the decoded transactions, "
+       "including the extended details, as returned by omni_gettransaction, omni_getsto and omni_gettrade.\n",
+       {
+           {"hash_or_height", RPCArg::Type::NUM, RPCArg::Optional::NO, "the hash or height of the block", "", {"", "string or numeric"}},
+           {"verbosity", RPCArg::Type::NUM, /* default */ "1", "1 for the transaction hashes, 2 for the decoded transactions"},
+       },
+       {
+           RPCResult{"for verbosity = 1",
+               RPCResult::Type::OBJ, "", "",
+               {
+                   {RPCResult::Type::STR_HEX, "hash", "the hash of the block"},
+                   {RPCResult::Type::NUM, "height", "the height of the block"},
+                   {RPCResult::Type::NUM, "confirmations", "the number of confirmations of the block"},
+                   {RPCResult::Type::NUM_TIME, "time", "the timestamp of the block"},
+                   {RPCResult::Type::ARR, "tx", "the Omni transactions, in the order of the block",
+                   {
+                       {RPCResult::Type::STR_HEX, "", "the hash of the transaction"},
+                   }},
+               }
+           },
+           RPCResult{"for verbosity = 2",
+               RPCResult::Type::OBJ, "", "",
+               {
+                   {RPCResult::Type::ELISION, "", "same output as verbosity = 1"},
+                   {RPCResult::Type::ARR, "tx", "the Omni transactions, in the order of the block",
+                   {
+                       {RPCResult::Type::OBJ, "", "",
+                       {
+                           {RPCResult::Type::ELISION, "", "the transaction, as returned by omni_gettransaction, with the extended details"},
+                       }},
+                   }},
+               }
+           },
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getblock", "279007 2")
+           + HelpExampleRpc("omni_getblock", "279007, 2")
+       }
+    }.Check(request);
+
+    int verbosity = request.params[1].isNull() ? 1 : request.params[1].get_int();
+    if (verbosity < 1 || verbosity > 2) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbosity must be 1 or 2");
+    }
+
+    // the block is read once, and the transactions are rendered from their records
+    CBlock block;
+    uint256 blockHash;
+    int blockHeight;
+    int confirmations;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pBlockIndex = nullptr;
+        if (request.params[0].isNum()) {
+            blockHeight = request.params[0].get_int();
+            RequireHeightInChain(blockHeight);
+            pBlockIndex = ::ChainActive()[blockHeight];
+        } else {
+            pBlockIndex = LookupBlockIndex(ParseHashV(request.params[0], "hash_or_height"));
+            if (!pBlockIndex) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+            }
+            if (!::ChainActive().Contains(pBlockIndex)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Block is not in the active chain");
+            }
+        }
+
+        if (!ReadBlockMapped(block, pBlockIndex, Params().GetConsensus())) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to read block from disk");
+        }
+        blockHash = pBlockIndex->GetBlockHash();
+        blockHeight = pBlockIndex->nHeight;
+        confirmations = ::ChainActive().Height() - blockHeight + 1;
+    }
+
+    RequireUnprunedHistory(blockHeight);
+
+    std::vector<CTransactionRef> omniTxs;
+    {
+        LOCK(cs_tally);
+        for (const CTransactionRef& tx : block.vtx) {
+            if (pDbTransactionList->exists(tx->GetHash())) {
+                omniTxs.push_back(tx);
+            }
+        }
+    }
+
+    UniValue txs(UniValue::VARR);
+    for (const CTransactionRef& tx : omniTxs) {
+        if (verbosity == 1) {
+            txs.push_back(tx->GetHash().GetHex());
+            continue;
+        }
+        UniValue txobj(UniValue::VOBJ);
+        int populateResult = populateRPCBlockTransactionObject(*tx, blockHash, txobj, true, pWallet.get());
+        if (populateResult != 0) PopulateFailure(populateResult);
+        txs.push_back(txobj);
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("hash", blockHash.GetHex());
+    response.pushKV("height", blockHeight);
+    response.pushKV("confirmations", confirmations);
+    response.pushKV("time", block.GetBlockTime());
+    response.pushKV("tx", txs);
+
+    return response;
+}
+
 static UniValue omni_gettransaction(const JSONRPCRequest& request)
 {
 #ifdef ENABLE_WALLET
@@ -2406,13 +3576,151 @@ static UniValue omni_listtransactions(const JSONRPCRequest& request)
 
     return response;
 }
-#endif
 
-static UniValue omni_listpendingtransactions(const JSONRPCRequest& request)
+static UniValue omni_rescanaddresses(const JSONRPCRequest& request)
 {
-#ifdef ENABLE_WALLET
     std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
-    std::unique_ptr<interfaces::Wallet> pWallet = interfaces::MakeWallet(wallet);
+    CWallet* const pwallet = wallet.get();
+
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    RPCHelpMan{"omni_rescanaddresses",
+       "\nRescans only the blocks with Omni transactions of the given addresses for wallet transactions, and rebuilds the Omni transaction index of the wallet.\n"
+       "\nThe addresses must already be part of the wallet, for example imported with \"importaddress\" without rescan. "
+       "Bitcoin transactions of the addresses, which are not Omni transactions, are not found by this call.\n",
+       {
+           {"addresses", RPCArg::Type::ARR, RPCArg::Optional::NO, "the addresses to rescan for",
+               {
+                   {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "an address of the wallet"},
+               },
+           },
+           {"startheight", RPCArg::Type::NUM, /* default */ "0", "the block height where the rescan should start"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "start_height", "the block height where the rescan started"},
+               {RPCResult::Type::NUM, "stop_height", "the height of the last processed block"},
+               {RPCResult::Type::NUM, "transactions", "the number of Omni transactions of the addresses"},
+               {RPCResult::Type::NUM, "blocks", "the number of rescanned blocks"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_rescanaddresses", "\"[\\\"3M9qvHKtgARhqcMtM5cRT9VaiDJ5PSfQGY\\\"]\" 500000")
+           + HelpExampleRpc("omni_rescanaddresses", "[\"3M9qvHKtgARhqcMtM5cRT9VaiDJ5PSfQGY\"], 500000")
+       }
+    }.Check(request);
+
+    std::set<std::string> setAddresses;
+    const UniValue& addresses = request.params[0].get_array();
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        setAddresses.insert(ParseAddress(addresses[i]));
+    }
+    if (setAddresses.empty()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "No addresses provided");
+    }
+
+    int startHeight = 0;
+    if (!request.params[1].isNull()) {
+        startHeight = request.params[1].get_int();
+        if (startHeight < 0) throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative start height");
+    }
+
+    WalletRescanReserver reserver(pwallet);
+    if (!reserver.reserve()) {
+        throw JSONRPCError(RPC_WALLET_ERROR, "Wallet is currently rescanning. Abort existing rescan or wait.");
+    }
+
+    {
+        auto locked_chain = pwallet->chain().lock();
+        LOCK(pwallet->cs_wallet);
+        for (const std::string& address : setAddresses) {
+            if (pwallet->IsMine(DecodeDestination(address)) == ISMINE_NO) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strprintf("Address is not part of the wallet: %s", address));
+            }
+        }
+    }
+
+    // the height index of the transaction list lists the processed Omni transactions by
+    // block, and their records provide sender and reference address, so only the blocks
+    // with transactions of the addresses have to be read from disk
+    int stopHeight = -1;
+    int nTransactions = 0;
+    std::set<int> setHeights;
+    {
+        LOCK2(cs_main, cs_tally);
+        stopHeight = GetHeight();
+        if (startHeight > stopHeight) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Start height is beyond the chain tip");
+        }
+
+        for (const CMPTxList::BlockTx& blockTx : pDbTransactionList->GetTxsInBlockRange(startHeight, stopHeight)) {
+            bool fRelevant = false;
+            COmniTransactionDB::Record record;
+            if (pDbTransaction->FetchTransactionRecord(blockTx.txid, record)) {
+                fRelevant = setAddresses.count(record.sender) || setAddresses.count(record.receiver);
+            } else {
+                // DEx payments have no record, but the purchases list buyer and seller
+                std::string buyer, seller;
+                uint64_t vout, propertyId, nValue;
+                if (pDbTransactionList->getPurchaseDetails(blockTx.txid, 1, &buyer, &seller, &vout, &propertyId, &nValue)) {
+                    fRelevant = setAddresses.count(buyer) || setAddresses.count(seller);
+                }
+            }
+            if (fRelevant) {
+                setHeights.insert(blockTx.block);
+                ++nTransactions;
+            }
+        }
+    }
+
+    // consecutive blocks are rescanned as one range
+    std::vector<std::pair<uint256, uint256> > vRanges;
+    {
+        auto locked_chain = pwallet->chain().lock();
+        for (std::set<int>::const_iterator it = setHeights.begin(); it != setHeights.end(); ) {
+            int first = *it;
+            int last = first;
+            while (++it != setHeights.end() && *it == last + 1) last = *it;
+            if (locked_chain->findPruned(first, last)) {
+                throw JSONRPCError(RPC_MISC_ERROR, "Can't rescan beyond pruned data. Use RPC call getblockchaininfo to determine your pruned height.");
+            }
+            vRanges.emplace_back(locked_chain->getBlockHash(first), locked_chain->getBlockHash(last));
+        }
+    }
+
+    for (const std::pair<uint256, uint256>& range : vRanges) {
+        CWallet::ScanResult result = pwallet->ScanForWalletTransactions(range.first, range.second, reserver, true /* fUpdate */);
+        switch (result.status) {
+        case CWallet::ScanResult::SUCCESS:
+            break;
+        case CWallet::ScanResult::FAILURE:
+            throw JSONRPCError(RPC_MISC_ERROR, "Rescan failed. Potentially corrupted data files.");
+        case CWallet::ScanResult::USER_ABORT:
+            throw JSONRPCError(RPC_MISC_ERROR, "Rescan aborted.");
+        }
+    }
+
+    // the index is rebuilt, so the STO receipts of the addresses are found, too
+    std::unique_ptr<interfaces::Wallet> pWallet = interfaces::MakeWallet(wallet);
+    ReloadWalletOmniTransactions(*pWallet);
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("start_height", startHeight);
+    response.pushKV("stop_height", stopHeight);
+    response.pushKV("transactions", nTransactions);
+    response.pushKV("blocks", static_cast<int>(setHeights.size()));
+    return response;
+}
+#endif
+
+static UniValue omni_listpendingtransactions(const JSONRPCRequest& request)
+{
+#ifdef ENABLE_WALLET
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    std::unique_ptr<interfaces::Wallet> pWallet = interfaces::MakeWallet(wallet);
 #else
     std::unique_ptr<interfaces::Wallet> pWallet;
 #endif
@@ -2459,7 +3767,7 @@ static UniValue omni_listpendingtransactions(const JSONRPCRequest& request)
 
     UniValue result(UniValue::VARR);
     for(const uint256& hash : vTxid) {
-        if (!IsInMarkerCache(hash)) {
+        if (!HasMempoolMarker(hash)) {
             continue;
         }
 
@@ -2486,6 +3794,8 @@ static UniValue omni_getinfo(const JSONRPCRequest& request)
                {RPCResult::Type::STR, "bitcoincoreversion", "Bitcoin Core version"},
                {RPCResult::Type::NUM, "block", "index of the last processed block"},
                {RPCResult::Type::NUM, "blocktime", "timestamp of the last processed block"},
+               {RPCResult::Type::NUM, "omniblock", "index of the last block processed by Omni Core, which may trail the chain with -omniasync"},
+               {RPCResult::Type::NUM, "queuedblocks", "block notifications waiting for the Omni thread with -omniasync"},
                {RPCResult::Type::NUM, "blocktransactions", "Omni transactions found in the last processed block"},
                {RPCResult::Type::NUM, "totaltransactions", "Omni transactions processed in total"},
                {RPCResult::Type::ARR, "alerts", "active protocol alert (if any)",
@@ -2517,6 +3827,9 @@ static UniValue omni_getinfo(const JSONRPCRequest& request)
     // provide the current block details
     int block = GetHeight();
     int64_t blockTime = GetLatestBlockTime();
+    uint256 hashOmniBlock;
+    int omniBlock = omniBlockQueue.GetTip(hashOmniBlock);
+    size_t queuedBlocks = omniBlockQueue.Size();
 
     LOCK(cs_tally);
 
@@ -2525,6 +3838,8 @@ static UniValue omni_getinfo(const JSONRPCRequest& request)
     int totalMPTrades = pDbTradeList->getMPTradeCountTotal();
     infoResponse.pushKV("block", block);
     infoResponse.pushKV("blocktime", blockTime);
+    infoResponse.pushKV("omniblock", omniBlock);
+    infoResponse.pushKV("queuedblocks", (uint64_t) queuedBlocks);
     infoResponse.pushKV("blocktransactions", blockMPTransactions);
 
     // provide the number of trades completed
@@ -2559,6 +3874,51 @@ static UniValue omni_getinfo(const JSONRPCRequest& request)
     return infoResponse;
 }
 
+static UniValue omni_getmemoryinfo(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getmemoryinfo",
+       "\nReturns the approximate memory used by the in-memory state and caches of Omni Core, in bytes.\n",
+       {},
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "tally", "the balances of all addresses"},
+               {RPCResult::Type::NUM, "snapshot", "the snapshot of the balances used by RPC"},
+               {RPCResult::Type::NUM, "metadex", "the orders of the distributed exchange"},
+               {RPCResult::Type::NUM, "offers", "the sell offers of the traditional distributed exchange"},
+               {RPCResult::Type::NUM, "accepts", "the accepted offers of the traditional distributed exchange"},
+               {RPCResult::Type::NUM, "crowdsales", "the active crowdsales"},
+               {RPCResult::Type::NUM, "pending", "the pending transactions"},
+               {RPCResult::Type::NUM, "markercache", "the cache of potential Omni transactions in the mempool"},
+               {RPCResult::Type::NUM, "coinsview", "the coins view used to create and decode transactions"},
+               {RPCResult::Type::NUM, "inputcache", "the cache of outputs spent by Omni transactions"},
+               {RPCResult::Type::NUM, "total", "the total memory used"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getmemoryinfo", "")
+           + HelpExampleRpc("omni_getmemoryinfo", "")
+       }
+    }.Check(request);
+
+    COmniMemoryUsage usage = GetMemoryUsage();
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("tally", (uint64_t) usage.nTally);
+    response.pushKV("snapshot", (uint64_t) usage.nSnapshot);
+    response.pushKV("metadex", (uint64_t) usage.nMetaDEx);
+    response.pushKV("offers", (uint64_t) usage.nOffers);
+    response.pushKV("accepts", (uint64_t) usage.nAccepts);
+    response.pushKV("crowdsales", (uint64_t) usage.nCrowds);
+    response.pushKV("pending", (uint64_t) usage.nPending);
+    response.pushKV("markercache", (uint64_t) usage.nMarkerCache);
+    response.pushKV("coinsview", (uint64_t) usage.nCoinsView);
+    response.pushKV("inputcache", (uint64_t) usage.nInputCache);
+    response.pushKV("total", (uint64_t) usage.GetTotal());
+
+    return response;
+}
+
 static UniValue omni_getactivations(const JSONRPCRequest& request)
 {
     RPCHelpMan{"omni_getactivations",
@@ -2641,6 +4001,8 @@ static UniValue omni_getsto(const JSONRPCRequest& request)
        {
            {"txid", RPCArg::Type::STR, RPCArg::Optional::NO, "the hash of the transaction to lookup"},
            {"recipientfilter", RPCArg::Type::STR, /* default */ "\"*\" for all", "a filter for recipients"},
+           {"limit", RPCArg::Type::NUM, /* default */ "all", "the maximal number of recipients to return"},
+           {"cursor", RPCArg::Type::STR, /* default */ "", "the cursor of the page of recipients to return, as returned by the previous page"},
        },
        RPCResult{
            RPCResult::Type::OBJ, "", "",
@@ -2667,22 +4029,33 @@ static UniValue omni_getsto(const JSONRPCRequest& request)
                        {RPCResult::Type::STR_AMOUNT, "amount", "the number of tokens sent to this recipient"},
                    }},
                }},
+               {RPCResult::Type::STR, "cursor", /* optional */ true, "the cursor of the next page, if a limit is given and there are more recipients"},
            }
        },
        RPCExamples{
            HelpExampleCli("omni_getsto", "\"1075db55d416d3ca199f55b6084e2115b9345e16c5cf302fc80e9d5fbf5d48d\" \"*\"")
+           + HelpExampleCli("omni_getsto", "\"1075db55d416d3ca199f55b6084e2115b9345e16c5cf302fc80e9d5fbf5d48d\" \"*\" 1000")
            + HelpExampleRpc("omni_getsto", "\"1075db55d416d3ca199f55b6084e2115b9345e16c5cf302fc80e9d5fbf5d48d\", \"*\"")
        }
     }.Check(request);
 
     uint256 hash = ParseHashV(request.params[0], "txid");
     std::string filterAddress;
-    if (request.params.size() > 1) filterAddress = ParseAddressOrWildcard(request.params[1]);
+    if (request.params.size() > 1 && !request.params[1].isNull()) filterAddress = ParseAddressOrWildcard(request.params[1]);
+    const bool fPaged = !request.params[2].isNull() || !request.params[3].isNull();
 
     UniValue txobj(UniValue::VOBJ);
-    int populateResult = populateRPCTransactionObject(hash, txobj, "", true, filterAddress, pWallet.get());
+    int populateResult = populateRPCTransactionObject(hash, txobj, "", !fPaged, filterAddress, pWallet.get());
     if (populateResult != 0) PopulateFailure(populateResult);
 
+    // a page of the recipients is read by the prefix of the transaction, after the address of the cursor
+    if (fPaged && find_value(txobj, "type_int").get_int() == MSC_TYPE_SEND_TO_OWNERS && find_value(txobj, "confirmations").get_int() > 0) {
+        const size_t limit = request.params[2].isNull() ? std::numeric_limits<size_t>::max() : ParsePageLimit(request.params[2]);
+        const std::string cursor = request.params[3].isNull() ? "" : request.params[3].get_str();
+        const uint16_t version = find_value(txobj, "version").get_int();
+        populateRPCExtendedTypeSendToOwners(hash, filterAddress, cursor, limit, txobj, version, pWallet.get());
+    }
+
     return txobj;
 }
 
@@ -2756,34 +4129,904 @@ static UniValue omni_getcurrentconsensushash(const JSONRPCRequest& request)
 {
     RPCHelpMan{"omni_getcurrentconsensushash",
        "\nReturns the consensus hash for all balances for the current block.\n",
-       {},
+       {
+           {"sections", RPCArg::Type::BOOL, /* default */ "false", "hash the sections of the state concurrently, and return their digests and the hash of the digests"},
+       },
        RPCResult{
            RPCResult::Type::OBJ, "", "",
            {
                {RPCResult::Type::NUM, "block", "the index of the block this consensus hash applies to"},
                {RPCResult::Type::STR_HEX, "blockhash", "the hash of the corresponding block"},
-               {RPCResult::Type::STR_HEX, "consensushash", "the consensus hash for the block"},
+               {RPCResult::Type::STR_HEX, "consensushash", "the consensus hash for the block, or the hash of the section digests"},
+               {RPCResult::Type::OBJ, "sections", "the digests of the sections (if sections is true)",
+               {
+                   {RPCResult::Type::STR_HEX, "balances", "the digest of the balances"},
+                   {RPCResult::Type::STR_HEX, "dexoffers", "the digest of the DEx offers"},
+                   {RPCResult::Type::STR_HEX, "dexaccepts", "the digest of the DEx accepts"},
+                   {RPCResult::Type::STR_HEX, "metadexorders", "the digest of the MetaDEx orders"},
+                   {RPCResult::Type::STR_HEX, "crowdsales", "the digest of the crowdsales"},
+                   {RPCResult::Type::STR_HEX, "properties", "the digest of the property issuers"},
+               }},
            }
        },
        RPCExamples{
            HelpExampleCli("omni_getcurrentconsensushash", "")
-           + HelpExampleRpc("omni_getcurrentconsensushash", "")
+           + HelpExampleCli("omni_getcurrentconsensushash", "true")
+           + HelpExampleRpc("omni_getcurrentconsensushash", "true")
+       }
+    }.Check(request);
+
+    bool fSections = (request.params.size() > 0) ? request.params[0].get_bool() : false;
+
+    int block = 0;
+    uint256 blockHash;
+    uint256 consensusHash;
+    std::vector<uint256> vSections;
+
+    auto getTip = [&block, &blockHash]() EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+        block = GetHeight();
+        blockHash = ::ChainActive()[block]->GetBlockHash();
+    };
+
+    if (!fSections) {
+        // the state is hashed in chunks without holding cs_main, so blocks can be processed in the
+        // meantime, and the hash is only used, if the tip is still the same afterwards
+        for (int nAttempt = 0; nAttempt < MAX_STATE_SCAN_RESTARTS && consensusHash.IsNull(); ++nAttempt) {
+            WITH_LOCK(cs_main, getTip());
+            consensusHash = GetConsensusHashYielding();
+            LOCK(cs_main);
+            if (::ChainActive().Height() != block || ::ChainActive().Tip()->GetBlockHash() != blockHash) {
+                consensusHash.SetNull();
+            }
+        }
+    }
+    if (consensusHash.IsNull()) {
+        LOCK(cs_main);
+        getTip();
+        consensusHash = fSections ? GetConsensusHashSections(vSections) : GetConsensusHash();
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("block", block);
+    response.pushKV("blockhash", blockHash.GetHex());
+    response.pushKV("consensushash", consensusHash.GetHex());
+
+    if (fSections) {
+        UniValue sections(UniValue::VOBJ);
+        for (size_t n = 0; n < vSections.size(); ++n) {
+            sections.pushKV(GetConsensusHashSectionName(static_cast<ConsensusHashSection>(n)), vSections[n].GetHex());
+        }
+        response.pushKV("sections", sections);
+    }
+
+    return response;
+}
+
+static UniValue omni_getstatecommitment(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getstatecommitment",
+       "\nReturns the commitment to the state of the current block, which is maintained incrementally.\n"
+       "\nUnlike the consensus hash, it doesn't cover the property issuers, and is independent of it.\n",
+       {},
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "block", "the index of the block this commitment applies to"},
+               {RPCResult::Type::STR_HEX, "blockhash", "the hash of the corresponding block"},
+               {RPCResult::Type::NUM, "version", "the version of the commitment"},
+               {RPCResult::Type::STR_HEX, "commitment", "the commitment to the state of the block"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getstatecommitment", "")
+           + HelpExampleRpc("omni_getstatecommitment", "")
        }
     }.Check(request);
 
-    LOCK(cs_main); // TODO - will this ensure we don't take in a new block in the couple of ms it takes to calculate the consensus hash?
+    LOCK(cs_main);
 
     int block = GetHeight();
 
     CBlockIndex* pblockindex = ::ChainActive()[block];
     uint256 blockHash = pblockindex->GetBlockHash();
 
-    uint256 consensusHash = GetConsensusHash();
+    uint256 commitment = GetStateCommitment();
 
     UniValue response(UniValue::VOBJ);
     response.pushKV("block", block);
     response.pushKV("blockhash", blockHash.GetHex());
-    response.pushKV("consensushash", consensusHash.GetHex());
+    response.pushKV("version", STATE_COMMITMENT_VERSION);
+    response.pushKV("commitment", commitment.GetHex());
+
+    return response;
+}
+
+static UniValue omni_getconsensushash(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getconsensushash",
+       "\nReturns the commitment to the state at the end of a block, which is recorded for every processed block.\n"
+       "\nThe commitment equals the one returned by omni_getstatecommitment at that block.\n",
+       {
+           {"block", RPCArg::Type::NUM, RPCArg::Optional::NO, "the height of the block"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "block", "the index of the block this commitment applies to"},
+               {RPCResult::Type::STR_HEX, "blockhash", "the hash of the corresponding block"},
+               {RPCResult::Type::NUM, "version", "the version of the commitment"},
+               {RPCResult::Type::STR_HEX, "commitment", "the commitment to the state at the end of the block"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getconsensushash", "610000")
+           + HelpExampleRpc("omni_getconsensushash", "610000")
+       }
+    }.Check(request);
+
+    int block = request.params[0].get_int();
+
+    RequireHeightInChain(block);
+
+    uint256 blockHash;
+    {
+        LOCK(cs_main);
+        blockHash = ::ChainActive()[block]->GetBlockHash();
+    }
+
+    uint256 commitment;
+    if (!pDbTransactionList->GetStateHash(block, blockHash, commitment)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "No commitment to the state was recorded for this block");
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("block", block);
+    response.pushKV("blockhash", blockHash.GetHex());
+    response.pushKV("version", STATE_COMMITMENT_VERSION);
+    response.pushKV("commitment", commitment.GetHex());
+
+    return response;
+}
+
+static UniValue omni_getaddressfilter(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getaddressfilter",
+       "\nReturns a compact filter over the addresses touched by the Omni transactions of a block.\n"
+       "\nThe filter is a Golomb-coded set as defined in BIP 158, with the parameters of the basic block filter, "
+       "and the addresses as elements. It covers the senders and receivers of the Omni transactions, "
+       "and all addresses, whose balances changed in the block. Requires -omniaddressfilterindex.\n",
+       {
+           {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "the hash of the block"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "block", "the height of the block"},
+               {RPCResult::Type::STR_HEX, "blockhash", "the hash of the block"},
+               {RPCResult::Type::NUM, "elements", "the number of addresses in the filter"},
+               {RPCResult::Type::STR_HEX, "filter", "the hex-encoded filter data"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getaddressfilter", "\"00000000000000000001e6bd2e1e9e2c1ab3a5b1c2d1b3c3c8e5b8ec1b0e9e1a\"")
+           + HelpExampleRpc("omni_getaddressfilter", "\"00000000000000000001e6bd2e1e9e2c1ab3a5b1c2d1b3c3c8e5b8ec1b0e9e1a\"")
+       }
+    }.Check(request);
+
+    if (!pDbAddressFilter) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The address filter index is disabled, use -omniaddressfilterindex to enable it");
+    }
+
+    uint256 blockHash = ParseHashV(request.params[0], "blockhash");
+    const CBlockIndex* pBlockIndex;
+    {
+        LOCK(cs_main);
+        pBlockIndex = LookupBlockIndex(blockHash);
+    }
+    if (!pBlockIndex) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    }
+
+    GCSFilter filter;
+    if (!pDbAddressFilter->GetFilter(blockHash, filter)) {
+        // blocks without Omni activity are not stored, but covered by the recorded range
+        int nFirstHeight;
+        uint256 hashLast;
+        const CBlockIndex* pLast = nullptr;
+        if (pDbAddressFilter->GetRecordedRange(nFirstHeight, hashLast) && pBlockIndex->nHeight >= nFirstHeight) {
+            LOCK(cs_main);
+            pLast = LookupBlockIndex(hashLast);
+        }
+        if (!pLast || pLast->GetAncestor(pBlockIndex->nHeight) != pBlockIndex) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "No address filter was recorded for this block");
+        }
+        filter = GCSFilter(COmniAddressFilterIndex::GetParams(blockHash));
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("block", pBlockIndex->nHeight);
+    response.pushKV("blockhash", blockHash.GetHex());
+    response.pushKV("elements", (uint64_t) filter.GetN());
+    response.pushKV("filter", HexStr(filter.GetEncoded()));
+
+    return response;
+}
+
+static UniValue omni_getinputcacheinfo(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getinputcacheinfo",
+       "\nReturns statistics of the cache of outputs spent by Omni transactions.\n",
+       {},
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "size", "the number of cached outputs"},
+               {RPCResult::Type::NUM, "maxsize", "the maximum number of cached outputs"},
+               {RPCResult::Type::NUM, "usage", "the memory used by the cache in bytes"},
+               {RPCResult::Type::NUM, "maxusage", "the maximum memory used by the cache in bytes, or 0 for no limit"},
+               {RPCResult::Type::NUM, "hits", "the number of lookups served by the cache"},
+               {RPCResult::Type::NUM, "misses", "the number of lookups not served by the cache"},
+               {RPCResult::Type::NUM, "evictions", "the number of outputs evicted from the cache"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getinputcacheinfo", "")
+           + HelpExampleRpc("omni_getinputcacheinfo", "")
+       }
+    }.Check(request);
+
+    LOCK(cs_tx_cache);
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("size", (uint64_t) inputCache.Size());
+    response.pushKV("maxsize", (uint64_t) inputCache.GetMaxSize());
+    response.pushKV("usage", (uint64_t) inputCache.DynamicMemoryUsage());
+    response.pushKV("maxusage", (uint64_t) inputCache.GetMaxMemory());
+    response.pushKV("hits", inputCache.GetHits());
+    response.pushKV("misses", inputCache.GetMisses());
+    response.pushKV("evictions", inputCache.GetEvictions());
+
+    return response;
+}
+
+static UniValue omni_gettransactioncacheinfo(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_gettransactioncacheinfo",
+       "\nReturns statistics of the cache of transaction objects returned by the RPC calls.\n",
+       {},
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "size", "the number of cached transaction objects"},
+               {RPCResult::Type::NUM, "maxsize", "the maximum number of cached transaction objects"},
+               {RPCResult::Type::NUM, "hits", "the number of lookups served by the cache"},
+               {RPCResult::Type::NUM, "misses", "the number of lookups not served by the cache"},
+               {RPCResult::Type::NUM, "evictions", "the number of transaction objects evicted from the cache"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_gettransactioncacheinfo", "")
+           + HelpExampleRpc("omni_gettransactioncacheinfo", "")
+       }
+    }.Check(request);
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("size", (uint64_t) rpcTxCache.Size());
+    response.pushKV("maxsize", (uint64_t) rpcTxCache.GetMaxSize());
+    response.pushKV("hits", rpcTxCache.GetHits());
+    response.pushKV("misses", rpcTxCache.GetMisses());
+    response.pushKV("evictions", rpcTxCache.GetEvictions());
+
+    return response;
+}
+
+static UniValue omni_getscanstatus(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getscanstatus",
+       "\nReturns the progress and throughput of the current, or last scan for Omni transactions.\n",
+       {},
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::BOOL, "scanning", "whether a scan is in progress"},
+               {RPCResult::Type::NUM, "startblock", "the first block of the scan"},
+               {RPCResult::Type::NUM, "endblock", "the last block of the scan"},
+               {RPCResult::Type::NUM, "block", "the last processed block"},
+               {RPCResult::Type::NUM, "progress", "the progress in percent, based on the number of Bitcoin transactions"},
+               {RPCResult::Type::NUM, "blocks", "the number of processed blocks"},
+               {RPCResult::Type::NUM, "transactions", "the number of examined transactions"},
+               {RPCResult::Type::NUM, "omnitransactions", "the number of Omni transactions found"},
+               {RPCResult::Type::NUM, "blockspersecond", "the number of processed blocks per second"},
+               {RPCResult::Type::NUM, "omnitransactionspersecond", "the number of Omni transactions found per second"},
+               {RPCResult::Type::NUM, "inputcachehitrate", "the ratio of transaction inputs served by the input cache"},
+               {RPCResult::Type::NUM, "elapsedtime", "the time since the start of the scan in seconds"},
+               {RPCResult::Type::NUM, "decodetime", "the time spent reading and decoding transactions in seconds"},
+               {RPCResult::Type::NUM, "interprettime", "the time spent interpreting transactions in seconds"},
+               {RPCResult::Type::NUM, "persistencetime", "the time spent persisting the state in seconds"},
+               {RPCResult::Type::NUM, "remainingtime", "the estimated time to complete the scan in seconds, or -1 if unknown"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getscanstatus", "")
+           + HelpExampleRpc("omni_getscanstatus", "")
+       }
+    }.Check(request);
+
+    ScanStatusInfo info = scanStatus.Get();
+
+    double dHitRate = 0.0;
+    {
+        LOCK(cs_tx_cache);
+        uint64_t nLookups = inputCache.GetHits() + inputCache.GetMisses();
+        if (nLookups > 0) dHitRate = static_cast<double>(inputCache.GetHits()) / nLookups;
+    }
+
+    double dElapsed = info.nElapsed / 1000000.0;
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("scanning", info.fScanning);
+    response.pushKV("startblock", info.nFirstBlock);
+    response.pushKV("endblock", info.nLastBlock);
+    response.pushKV("block", info.nCurrentBlock);
+    response.pushKV("progress", info.dProgress);
+    response.pushKV("blocks", info.nBlocks);
+    response.pushKV("transactions", info.nTransactions);
+    response.pushKV("omnitransactions", info.nOmniTransactions);
+    response.pushKV("blockspersecond", dElapsed > 0.0 ? info.nBlocks / dElapsed : 0.0);
+    response.pushKV("omnitransactionspersecond", dElapsed > 0.0 ? info.nOmniTransactions / dElapsed : 0.0);
+    response.pushKV("inputcachehitrate", dHitRate);
+    response.pushKV("elapsedtime", dElapsed);
+    response.pushKV("decodetime", info.nTimeDecode / 1000000.0);
+    response.pushKV("interprettime", info.nTimeInterpret / 1000000.0);
+    response.pushKV("persistencetime", info.nTimePersist / 1000000.0);
+    response.pushKV("remainingtime", info.nRemaining < 0 ? -1.0 : info.nRemaining / 1000000.0);
+
+    return response;
+}
+
+static UniValue omni_getdbstats(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getdbstats",
+       "\nReturns LevelDB statistics of the Omni databases, to diagnose write stalls and compaction backlogs.\n"
+       "\nStores within the unified database report the statistics of the unified database.\n",
+       {},
+       RPCResult{
+           RPCResult::Type::ARR, "", "",
+           {
+               {RPCResult::Type::OBJ, "", "",
+               {
+                   {RPCResult::Type::STR, "name", "the name of the database"},
+                   {RPCResult::Type::NUM, "read", "the number of entries read since the database was opened or cleared"},
+                   {RPCResult::Type::NUM, "written", "the number of entries written since the database was opened or cleared"},
+                   {RPCResult::Type::NUM, "cachehits", "the number of reads served by the read cache of decoded values"},
+                   {RPCResult::Type::NUM, "cachemisses", "the number of reads, which missed the read cache"},
+                   {RPCResult::Type::NUM, "cacheentries", "the number of values in the read cache"},
+                   {RPCResult::Type::NUM, "memoryusage", "the approximate number of bytes of memory in use by LevelDB"},
+                   {RPCResult::Type::BOOL, "pendingcompaction", "whether a range of deleted keys waits to be compacted in the background"},
+                   {RPCResult::Type::STR, "stats", "the files and compaction statistics per level"},
+                   {RPCResult::Type::STR, "sstables", "the tables per level"},
+               }},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getdbstats", "")
+           + HelpExampleRpc("omni_getdbstats", "")
+       }
+    }.Check(request);
+
+    const std::vector<CDBBase*> vDatabases{pDbTransactionList, pDbTradeList, pDbStoList, pDbSpInfo,
+            pDbTransaction, pDbFeeCache, pDbFeeHistory, pDbNFT, pDbPrevout, pDbMarkers, pDbAddressFilter, pDbBalanceHistory, pDbBalanceChanges,
+            pDbAddressIndex};
+
+    UniValue response(UniValue::VARR);
+    for (const CDBBase* pdb : vDatabases) {
+        if (!pdb) continue;
+        std::string strUsage, strStats, strTables;
+        pdb->GetProperty("leveldb.approximate-memory-usage", strUsage);
+        pdb->GetProperty("leveldb.stats", strStats);
+        pdb->GetProperty("leveldb.sstables", strTables);
+
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("name", pdb->GetName());
+        entry.pushKV("read", (uint64_t) pdb->GetReadCount());
+        entry.pushKV("written", (uint64_t) pdb->GetWriteCount());
+        entry.pushKV("cachehits", pdb->GetCacheHits());
+        entry.pushKV("cachemisses", pdb->GetCacheMisses());
+        entry.pushKV("cacheentries", (uint64_t) pdb->GetCacheSize());
+        entry.pushKV("memoryusage", strUsage.empty() ? 0 : atoi64(strUsage));
+        entry.pushKV("pendingcompaction", pdb->HasPendingCompaction());
+        entry.pushKV("stats", strStats);
+        entry.pushKV("sstables", strTables);
+        response.push_back(entry);
+    }
+
+    return response;
+}
+
+static UniValue omni_getrpcstats(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getrpcstats",
+       "\nReturns the number of calls, the latencies, the time spent waiting for the state lock and the response sizes of the Omni RPC methods.\n"
+       "\nOnly methods called since the start or the last reset are listed. Times are in seconds.\n",
+       {
+           {"reset", RPCArg::Type::BOOL, /* default */ "false", "reset the statistics after returning them"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::ARR, "latencylimits", "the upper limits of the latency buckets",
+               {
+                   {RPCResult::Type::NUM, "", "the upper limit in seconds"},
+               }},
+               {RPCResult::Type::ARR, "methods", "",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR, "method", "the name of the method"},
+                       {RPCResult::Type::NUM, "calls", "the number of calls"},
+                       {RPCResult::Type::NUM, "errors", "the number of calls, which failed"},
+                       {RPCResult::Type::NUM, "totaltime", "the time spent in the method"},
+                       {RPCResult::Type::NUM, "maxtime", "the time of the slowest call"},
+                       {RPCResult::Type::ARR, "latency", "the number of calls per latency bucket, the last one counts calls above all limits",
+                       {
+                           {RPCResult::Type::NUM, "", "the number of calls"},
+                       }},
+                       {RPCResult::Type::NUM, "lockwaittime", "the time spent waiting for the state lock"},
+                       {RPCResult::Type::NUM, "maxlockwaittime", "the longest wait of a call for the state lock"},
+                       {RPCResult::Type::NUM, "responsebytes", "the approximate number of bytes of all results"},
+                       {RPCResult::Type::NUM, "maxresponsebytes", "the approximate number of bytes of the largest result"},
+                   }},
+               }},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getrpcstats", "")
+           + HelpExampleCli("omni_getrpcstats", "true")
+           + HelpExampleRpc("omni_getrpcstats", "")
+       }
+    }.Check(request);
+
+    const bool fReset = request.params[0].isNull() ? false : request.params[0].get_bool();
+
+    return GetRPCStats(fReset);
+}
+
+static UniValue omni_getperfstats(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getperfstats",
+       "\nReturns the time spent per block in the phases of the Omni block processing, and interpreting each transaction type.\n"
+       "\nThe statistics cover the blocks since the start or the last reset, and the last blocks. Times are in seconds, "
+       "and the 99th percentile since the start is rounded up to the next power of two microseconds. "
+       "Transaction types only count blocks with transactions of the type.\n",
+       {
+           {"blocks", RPCArg::Type::NUM, /* default */ strprintf("%d", PERF_RECENT_BLOCKS), strprintf("the number of last blocks to report separately (at most %d)", PERF_RECENT_BLOCKS)},
+           {"reset", RPCArg::Type::BOOL, /* default */ "false", "reset the statistics after returning them"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "blocks", "the number of processed blocks"},
+               {RPCResult::Type::ARR, "phases", "",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR, "phase", "the name of the phase"},
+                       {RPCResult::Type::NUM, "blocks", "the number of blocks"},
+                       {RPCResult::Type::NUM, "totaltime", "the time spent in all blocks"},
+                       {RPCResult::Type::NUM, "mintime", "the minimal time per block"},
+                       {RPCResult::Type::NUM, "avgtime", "the average time per block"},
+                       {RPCResult::Type::NUM, "p99time", "the 99th percentile of the time per block"},
+                       {RPCResult::Type::NUM, "maxtime", "the maximal time per block"},
+                       {RPCResult::Type::OBJ, "recent", "the same values for the last blocks",
+                       {
+                           {RPCResult::Type::ELISION, "", ""},
+                       }},
+                   }},
+               }},
+               {RPCResult::Type::ARR, "types", "",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::NUM, "type_int", "the transaction type as number"},
+                       {RPCResult::Type::STR, "type", "the transaction type as string"},
+                       {RPCResult::Type::ELISION, "", "the same values as for the phases"},
+                   }},
+               }},
+               {RPCResult::Type::ARR, "locks", "the contention of the Omni locks, recorded with -omnilockstats",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::STR, "name", "the name of the lock"},
+                       {RPCResult::Type::NUM, "acquisitions", "the number of acquisitions, including recursive ones"},
+                       {RPCResult::Type::NUM, "contended", "the number of acquisitions, which waited for the lock"},
+                       {RPCResult::Type::NUM, "totalwait", "the time spent waiting for the lock"},
+                       {RPCResult::Type::NUM, "maxwait", "the longest wait for the lock"},
+                       {RPCResult::Type::ARR, "sites", strprintf("the call sites, which waited the longest in total (at most %d)", LOCK_STATS_TOP_SITES),
+                       {
+                           {RPCResult::Type::OBJ, "", "",
+                           {
+                               {RPCResult::Type::STR, "site", "the source file and line of the lock"},
+                               {RPCResult::Type::NUM, "waits", "the number of waits at the call site"},
+                               {RPCResult::Type::NUM, "totalwait", "the time spent waiting at the call site"},
+                               {RPCResult::Type::NUM, "maxwait", "the longest wait at the call site"},
+                           }},
+                       }},
+                   }},
+               }},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getperfstats", "")
+           + HelpExampleCli("omni_getperfstats", "100 true")
+           + HelpExampleRpc("omni_getperfstats", "100, false")
+       }
+    }.Check(request);
+
+    int64_t nBlocks = PERF_RECENT_BLOCKS;
+    if (!request.params[0].isNull()) {
+        nBlocks = request.params[0].get_int64();
+        if (nBlocks < 0) throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative number of blocks");
+    }
+    const bool fReset = request.params[1].isNull() ? false : request.params[1].get_bool();
+
+    return GetPerfStats(static_cast<size_t>(nBlocks), fReset);
+}
+
+static UniValue omni_waitforblock(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_waitforblock",
+       "\nWaits, until Omni Core processed a block of at least the given height, and returns the last processed block.\n"
+       "\nWith -omniasync the Omni state may trail the chain. Returns the last processed block on timeout or exit.\n",
+       {
+           {"height", RPCArg::Type::NUM, RPCArg::Optional::NO, "the block height to wait for"},
+           {"timeout", RPCArg::Type::NUM, /* default */ "0", "the time in milliseconds to wait, 0 to wait without timeout"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::STR_HEX, "hash", "the hash of the last processed block"},
+               {RPCResult::Type::NUM, "height", "the height of the last processed block, or -1, if there is none"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_waitforblock", "100 1000")
+           + HelpExampleRpc("omni_waitforblock", "100, 1000")
+       }
+    }.Check(request);
+
+    const int nHeight = request.params[0].get_int();
+    const int64_t nTimeout = request.params[1].isNull() ? 0 : request.params[1].get_int64();
+    if (nTimeout < 0) throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative timeout");
+
+    // wake up regularly, so a shutdown isn't delayed by waiting clients
+    const int64_t nDeadline = GetTimeMillis() + nTimeout;
+    while (IsRPCRunning()) {
+        int64_t nWait = 1000;
+        if (nTimeout > 0) {
+            nWait = std::min(nWait, nDeadline - GetTimeMillis());
+            if (nWait <= 0) break;
+        }
+        if (omniBlockQueue.WaitForHeight(nHeight, std::chrono::milliseconds(nWait))) break;
+    }
+
+    uint256 hashBlock;
+    const int nBlock = omniBlockQueue.GetTip(hashBlock);
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("hash", hashBlock.GetHex());
+    response.pushKV("height", nBlock);
+    return response;
+}
+
+static UniValue omni_exportstate(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_exportstate",
+       "\nWrites the properties, balances, open orders, DEx offers and non-fungible token ranges after the last processed block to a file.\n"
+       "\nThe state is read from snapshots, without pausing block processing. Amounts are written in their smallest unit.\n",
+       {
+           {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "the file to create, relative paths are resolved against the data directory"},
+           {"format", RPCArg::Type::STR, /* default */ "csv", "the format of the records, either \"csv\" or \"json\" (one object per line)"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::STR, "path", "the path of the created file"},
+               {RPCResult::Type::NUM, "block", "the index of the block the state applies to"},
+               {RPCResult::Type::STR_HEX, "blockhash", "the hash of the corresponding block"},
+               {RPCResult::Type::NUM, "properties", "the number of exported properties"},
+               {RPCResult::Type::NUM, "balances", "the number of exported balances"},
+               {RPCResult::Type::NUM, "orders", "the number of exported open orders"},
+               {RPCResult::Type::NUM, "offers", "the number of exported DEx offers"},
+               {RPCResult::Type::NUM, "nftranges", "the number of exported non-fungible token ranges"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_exportstate", "\"state.csv\"")
+           + HelpExampleRpc("omni_exportstate", "\"state.json\", \"json\"")
+       }
+    }.Check(request);
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    }
+
+    ExportFormat format = ExportFormat::CSV;
+    if (!request.params[1].isNull() && !ParseExportFormat(request.params[1].get_str(), format)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown format, expected \"csv\" or \"json\"");
+    }
+
+    ExportSummary summary;
+    std::string strError;
+    if (!ExportState(path, format, summary, strError)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to export the state: " + strError);
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("path", path.string());
+    response.pushKV("block", summary.nBlock);
+    response.pushKV("blockhash", summary.hashBlock.GetHex());
+    response.pushKV("properties", summary.nProperties);
+    response.pushKV("balances", summary.nBalances);
+    response.pushKV("orders", summary.nOrders);
+    response.pushKV("offers", summary.nOffers);
+    response.pushKV("nftranges", summary.nRanges);
+
+    return response;
+}
+
+static UniValue omni_dumpsnapshot(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_dumpsnapshot",
+       "\nWrites a snapshot of the Omni state after the last processed block to a file, which bootstraps other nodes via -omniloadsnapshot.\n"
+       "\nThe snapshot holds the in-memory state and the content of the Omni databases. Nodes loading it verify the consensus hash against a checkpoint, or the one pinned with -omnisnapshothash.\n",
+       {
+           {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "the file to create, relative paths are resolved against the data directory"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::STR, "path", "the path of the created file"},
+               {RPCResult::Type::NUM, "block", "the index of the block the state applies to"},
+               {RPCResult::Type::STR_HEX, "blockhash", "the hash of the corresponding block"},
+               {RPCResult::Type::STR_HEX, "consensushash", "the consensus hash of the state, to be pinned by nodes loading the snapshot"},
+               {RPCResult::Type::NUM, "entries", "the number of database entries"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_dumpsnapshot", "\"omni-snapshot.dat\"")
+           + HelpExampleRpc("omni_dumpsnapshot", "\"omni-snapshot.dat\"")
+       }
+    }.Check(request);
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    }
+
+    SnapshotSummary summary;
+    std::string strError;
+    if (!DumpStateSnapshot(path, summary, strError)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to dump the snapshot: " + strError);
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("path", path.string());
+    response.pushKV("block", summary.nBlock);
+    response.pushKV("blockhash", summary.hashBlock.GetHex());
+    response.pushKV("consensushash", summary.consensusHash.GetHex());
+    response.pushKV("entries", summary.nEntries);
+
+    return response;
+}
+
+static UniValue omni_verifyhistory(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_verifyhistory",
+       "\nVerifies the stored Omni states of the blocks in the active chain, spread over several threads.\n"
+       "\nThe content of every state file is hashed and the balances are decoded, and the base state of each balances delta must be stored as well.\n",
+       {
+           {"threads", RPCArg::Type::NUM, /* default */ "the number of cores", "the number of threads to verify the states"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "states", "the number of verified states"},
+               {RPCResult::Type::NUM, "first", "the index of the block of the oldest state"},
+               {RPCResult::Type::NUM, "last", "the index of the block of the newest state"},
+               {RPCResult::Type::ARR, "invalid", "the states, which are invalid",
+               {
+                   {RPCResult::Type::OBJ, "", "",
+                   {
+                       {RPCResult::Type::NUM, "block", "the index of the block"},
+                       {RPCResult::Type::STR_HEX, "blockhash", "the hash of the block"},
+                       {RPCResult::Type::STR, "error", "the reason, why the state is invalid"},
+                   }},
+               }},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_verifyhistory", "")
+           + HelpExampleRpc("omni_verifyhistory", "4")
+       }
+    }.Check(request);
+
+    int nThreads = GetNumCores();
+    if (!request.params[0].isNull()) {
+        nThreads = request.params[0].get_int();
+        if (nThreads < 1) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Number of threads must be positive");
+        }
+    }
+
+    std::vector<CStoredStateCheck> vChecks;
+    VerifyStoredStates(nThreads, vChecks);
+
+    UniValue invalid(UniValue::VARR);
+    for (const CStoredStateCheck& check : vChecks) {
+        if (check.strError.empty()) continue;
+        UniValue state(UniValue::VOBJ);
+        state.pushKV("block", check.nBlock);
+        state.pushKV("blockhash", check.hashBlock.GetHex());
+        state.pushKV("error", check.strError);
+        invalid.push_back(state);
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("states", (uint64_t) vChecks.size());
+    response.pushKV("first", vChecks.empty() ? -1 : vChecks.front().nBlock);
+    response.pushKV("last", vChecks.empty() ? -1 : vChecks.back().nBlock);
+    response.pushKV("invalid", invalid);
+
+    return response;
+}
+
+//! Read-only calls, which may run long, so they can be submitted as query jobs
+static const char* const queryCommands[] =
+{
+    "omni_getallbalancesforid",
+    "omni_getallbalancesforaddress",
+    "omni_getbalancehistory",
+    "omni_listproperties",
+    "omni_getactivecrowdsales",
+    "omni_getactivedexsells",
+    "omni_getgrants",
+    "omni_getorderbook",
+    "omni_getsto",
+    "omni_gettradehistoryforpair",
+    "omni_gettradehistoryforaddress",
+    "omni_listblockstransactions",
+    "omni_listaddresstransactions",
+    "omni_getnonfungibletokens",
+    "omni_getnonfungibletokenranges",
+    "omni_getfeedistributions",
+    "omni_getseedblocks",
+    "omni_getcurrentconsensushash",
+    "omni_getbalanceshash",
+    "omni_getmetadexhash",
+};
+
+//! Number of elements of an array result returned per call of omni_getqueryresult
+static const size_t QUERY_RESULT_CHUNK_SIZE = 1000;
+
+static UniValue omni_submitquery(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_submitquery",
+       "\nExecutes a long running query in the background, and returns the id of its job.\n"
+       "\nThe result is retrieved with omni_getqueryresult, and dropped, if it wasn't read for " + std::to_string(DEFAULT_QUERY_JOB_TIMEOUT / 60) + " minutes.\n"
+       "\nSupported methods: " + [] {
+           std::string strMethods;
+           for (const char* pszMethod : queryCommands) strMethods += (strMethods.empty() ? "" : ", ") + std::string(pszMethod);
+           return strMethods;
+       }() + "\n",
+       {
+           {"method", RPCArg::Type::STR, RPCArg::Optional::NO, "the name of the method to call"},
+           {"params", RPCArg::Type::ARR, /* default */ "[]", "the parameters of the call, as array or object",
+               {
+                   {"param", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "a parameter of any type"},
+               },
+           },
+       },
+       RPCResult{
+           RPCResult::Type::STR_HEX, "id", "the id of the job"
+       },
+       RPCExamples{
+           HelpExampleCli("omni_submitquery", "\"omni_getallbalancesforid\" \"[31]\"")
+           + HelpExampleRpc("omni_submitquery", "\"omni_getallbalancesforid\", [31]")
+       }
+    }.Check(request);
+
+    const std::string strMethod = request.params[0].get_str();
+    if (std::find_if(std::begin(queryCommands), std::end(queryCommands), [&strMethod](const char* pszMethod) { return strMethod == pszMethod; }) == std::end(queryCommands)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Method can't be submitted as query: " + strMethod);
+    }
+
+    JSONRPCRequest query;
+    query.strMethod = strMethod;
+    query.params = request.params[1].isNull() ? UniValue(UniValue::VARR) : request.params[1];
+    if (!query.params.isArray() && !query.params.isObject()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Parameters must be an array or object");
+    }
+    query.URI = request.URI;
+    query.authUser = request.authUser;
+    query.peerAddr = request.peerAddr;
+
+    const uint256 id = queryJobs.Submit(strMethod, [query] { return tableRPC.execute(query); }, GetTime());
+    if (id.IsNull()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Too many query jobs");
+    }
+
+    return id.GetHex();
+}
+
+static UniValue omni_getqueryresult(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_getqueryresult",
+       "\nReturns the status of a query job, and its result, once it's finished.\n"
+       "\nResults, which are arrays, are returned in chunks of " + std::to_string(QUERY_RESULT_CHUNK_SIZE) + " elements, starting at the cursor.\n",
+       {
+           {"id", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "the id of the job"},
+           {"cursor", RPCArg::Type::NUM, /* default */ "0", "the position of the first element of an array result"},
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::STR, "method", "the called method"},
+               {RPCResult::Type::STR, "status", "the status of the job: \"queued\", \"running\", \"done\" or \"failed\""},
+               {RPCResult::Type::NUM, "elapsed", "the seconds since the job was submitted, or the seconds it took, once it's finished"},
+               {RPCResult::Type::ELISION, "", "the result of the call, if the job is done"},
+               {RPCResult::Type::NUM, "total", /* optional */ true, "the number of elements of an array result"},
+               {RPCResult::Type::NUM, "nextcursor", /* optional */ true, "the cursor of the next chunk, if there are more elements"},
+               {RPCResult::Type::OBJ, "error", /* optional */ true, "the error of the call, if the job failed", {{RPCResult::Type::ELISION, "", ""}}},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_getqueryresult", "\"1075db55d416d3ca199f55b6084e2115b9345e16c5cf302fc80e9d5fbf5d48d\"")
+           + HelpExampleRpc("omni_getqueryresult", "\"1075db55d416d3ca199f55b6084e2115b9345e16c5cf302fc80e9d5fbf5d48d\", 1000")
+       }
+    }.Check(request);
+
+    const uint256 id = ParseHashV(request.params[0], "id");
+    const int64_t nCursor = request.params[1].isNull() ? 0 : request.params[1].get_int64();
+    if (nCursor < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor must not be negative");
+    }
+
+    CQueryJob job("", 0);
+    const int64_t nTime = GetTime();
+    if (!queryJobs.Get(id, nTime, job)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Query job not found or expired");
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("method", job.strMethod);
+    response.pushKV("status", job.GetStatusName());
+    response.pushKV("elapsed", (job.nFinished ? job.nFinished : nTime) - job.nSubmitted);
+
+    if (job.status == CQueryJob::FAILED) {
+        response.pushKV("error", *job.result);
+    }
+    if (job.status != CQueryJob::DONE) {
+        return response;
+    }
+
+    const UniValue& result = *job.result;
+    if (!result.isArray()) {
+        response.pushKV("result", result);
+        return response;
+    }
+
+    const size_t nBegin = std::min<uint64_t>(nCursor, result.size());
+    const size_t nEnd = std::min(result.size(), nBegin + QUERY_RESULT_CHUNK_SIZE);
+    UniValue chunk(UniValue::VARR);
+    for (size_t n = nBegin; n < nEnd; ++n) {
+        chunk.push_back(result[n]);
+    }
+    response.pushKV("result", chunk);
+    response.pushKV("total", (uint64_t) result.size());
+    if (nEnd < result.size()) {
+        response.pushKV("nextcursor", (uint64_t) nEnd);
+    }
 
     return response;
 }
@@ -2880,25 +5123,44 @@ static const CRPCCommand commands[] =
   //  ------------------------------------ ------------------------------- ------------------------------ ----------
     { "omni layer (data retrieval)", "omni_getinfo",                   &omni_getinfo,                    {} },
     { "omni layer (data retrieval)", "omni_getactivations",            &omni_getactivations,             {} },
-    { "omni layer (data retrieval)", "omni_getallbalancesforid",       &omni_getallbalancesforid,        {"propertyid"} },
-    { "omni layer (data retrieval)", "omni_getbalance",                &omni_getbalance,                 {"address", "propertyid"} },
+    { "omni layer (data retrieval)", "omni_getallbalancesforid",       &omni_getallbalancesforid,        {"propertyid", "limit", "cursor", "height"} },
+    { "omni layer (data retrieval)", "omni_getpropertystats",          &omni_getpropertystats,           {"propertyid", "top"} },
+    { "omni layer (data retrieval)", "omni_getbalance",                &omni_getbalance,                 {"address", "propertyid", "height"} },
+    { "omni layer (data retrieval)", "omni_getbalancehistory",         &omni_getbalancehistory,          {"address", "propertyid", "cursor", "limit"} },
+    { "omni layer (data retrieval)", "omni_getbalances",               &omni_getbalances,                {"balances"} },
+    { "omni layer (data retrieval)", "omni_getbalancesforaddresses",   &omni_getbalancesforaddresses,    {"addresses", "propertyid"} },
     { "omni layer (data retrieval)", "omni_gettransaction",            &omni_gettransaction,             {"txid"} },
     { "omni layer (data retrieval)", "omni_getproperty",               &omni_getproperty,                {"propertyid"} },
-    { "omni layer (data retrieval)", "omni_listproperties",            &omni_listproperties,             {} },
+    { "omni layer (data retrieval)", "omni_listproperties",            &omni_listproperties,             {"limit", "cursor", "ecosystem", "type", "issuer"} },
     { "omni layer (data retrieval)", "omni_getcrowdsale",              &omni_getcrowdsale,               {"propertyid", "verbose"} },
     { "omni layer (data retrieval)", "omni_getgrants",                 &omni_getgrants,                  {"propertyid"} },
     { "omni layer (data retrieval)", "omni_getactivedexsells",         &omni_getactivedexsells,          {"address"} },
     { "omni layer (data retrieval)", "omni_getactivecrowdsales",       &omni_getactivecrowdsales,        {} },
-    { "omni layer (data retrieval)", "omni_getorderbook",              &omni_getorderbook,               {"propertyid", "propertyid"} },
+    { "omni layer (data retrieval)", "omni_getorderbook",              &omni_getorderbook,               {"propertyid", "propertyiddesired", "limit", "cursor"} },
+    { "omni layer (data retrieval)", "omni_getopenorders",             &omni_getopenorders,              {"address"} },
+    { "omni layer (data retrieval)", "omni_getorderbookdepth",         &omni_getorderbookdepth,          {"propertyid", "propertyidsecond", "levels"} },
     { "omni layer (data retrieval)", "omni_gettrade",                  &omni_gettrade,                   {"txid"} },
-    { "omni layer (data retrieval)", "omni_getsto",                    &omni_getsto,                     {"txid", "recipientfilter"} },
+    { "omni layer (data retrieval)", "omni_getsto",                    &omni_getsto,                     {"txid", "recipientfilter", "limit", "cursor"} },
     { "omni layer (data retrieval)", "omni_listblocktransactions",     &omni_listblocktransactions,      {"index"} },
     { "omni layer (data retrieval)", "omni_listblockstransactions",    &omni_listblockstransactions,     {"firstblock", "lastblock"} },
+    { "omni layer (data retrieval)", "omni_listaddresstransactions",   &omni_listaddresstransactions,    {"address", "cursor", "limit"} },
+    { "omni layer (data retrieval)", "omni_getblock",                  &omni_getblock,                   {"hash_or_height", "verbosity"} },
     { "omni layer (data retrieval)", "omni_listpendingtransactions",   &omni_listpendingtransactions,    {"address"} },
     { "omni layer (data retrieval)", "omni_getallbalancesforaddress",  &omni_getallbalancesforaddress,   {"address"} },
     { "omni layer (data retrieval)", "omni_gettradehistoryforaddress", &omni_gettradehistoryforaddress,  {"address", "count", "propertyid"} },
     { "omni layer (data retrieval)", "omni_gettradehistoryforpair",    &omni_gettradehistoryforpair,     {"propertyid", "propertyidsecond", "count"} },
-    { "omni layer (data retrieval)", "omni_getcurrentconsensushash",   &omni_getcurrentconsensushash,    {} },
+    { "omni layer (data retrieval)", "omni_getcurrentconsensushash",   &omni_getcurrentconsensushash,    {"sections"} },
+    { "omni layer (data retrieval)", "omni_getstatecommitment",        &omni_getstatecommitment,         {} },
+    { "omni layer (data retrieval)", "omni_getconsensushash",          &omni_getconsensushash,           {"block"} },
+    { "omni layer (data retrieval)", "omni_getaddressfilter",          &omni_getaddressfilter,           {"blockhash"} },
+    { "omni layer (data retrieval)", "omni_getinputcacheinfo",         &omni_getinputcacheinfo,          {} },
+    { "omni layer (data retrieval)", "omni_gettransactioncacheinfo",   &omni_gettransactioncacheinfo,    {} },
+    { "omni layer (data retrieval)", "omni_getscanstatus",             &omni_getscanstatus,              {} },
+    { "omni layer (data retrieval)", "omni_getdbstats",                &omni_getdbstats,                 {} },
+    { "omni layer (data retrieval)", "omni_getrpcstats",               &omni_getrpcstats,                {"reset"} },
+    { "omni layer (data retrieval)", "omni_getperfstats",              &omni_getperfstats,               {"blocks", "reset"} },
+    { "omni layer (data retrieval)", "omni_waitforblock",              &omni_waitforblock,               {"height", "timeout"} },
+    { "omni layer (data retrieval)", "omni_getmemoryinfo",             &omni_getmemoryinfo,              {} },
     { "omni layer (data retrieval)", "omni_getpayload",                &omni_getpayload,                 {"txid"} },
     { "omni layer (data retrieval)", "omni_getseedblocks",             &omni_getseedblocks,              {"startblock", "endblock"} },
     { "omni layer (data retrieval)", "omni_getmetadexhash",            &omni_getmetadexhash,             {"propertyid"} },
@@ -2909,9 +5171,15 @@ static const CRPCCommand commands[] =
     { "omni layer (data retrieval)", "omni_getbalanceshash",           &omni_getbalanceshash,            {"propertyid"} },
     { "omni layer (data retrieval)", "omni_getnonfungibletokens",      &omni_getnonfungibletokens,       {"address", "propertyid"} },
     { "omni layer (data retrieval)", "omni_getnonfungibletokendata",   &omni_getnonfungibletokendata,    {"propertyid", "tokenidstart", "tokenidend"} },
-    { "omni layer (data retrieval)", "omni_getnonfungibletokenranges", &omni_getnonfungibletokenranges,  {"propertyid"} },
+    { "omni layer (data retrieval)", "omni_getnonfungibletokenranges", &omni_getnonfungibletokenranges,  {"propertyid", "limit", "cursor"} },
+    { "omni layer (data retrieval)", "omni_exportstate",               &omni_exportstate,                {"path", "format"} },
+    { "omni layer (data retrieval)", "omni_dumpsnapshot",              &omni_dumpsnapshot,               {"path"} },
+    { "omni layer (data retrieval)", "omni_verifyhistory",             &omni_verifyhistory,              {"threads"} },
+    { "omni layer (data retrieval)", "omni_submitquery",               &omni_submitquery,                {"method", "params"} },
+    { "omni layer (data retrieval)", "omni_getqueryresult",            &omni_getqueryresult,             {"id", "cursor"} },
 #ifdef ENABLE_WALLET
     { "omni layer (data retrieval)", "omni_listtransactions",          &omni_listtransactions,           {"address", "count", "skip", "startblock", "endblock"} },
+    { "omni layer (data retrieval)", "omni_rescanaddresses",           &omni_rescanaddresses,            {"addresses", "startheight"} },
     { "omni layer (data retrieval)", "omni_getfeeshare",               &omni_getfeeshare,                {"address", "ecosystem"} },
     { "omni layer (configuration)",  "omni_setautocommit",             &omni_setautocommit,              {"flag"}  },
     { "omni layer (data retrieval)", "omni_getwalletbalances",         &omni_getwalletbalances,          {"includewatchonly"} },
@@ -2930,7 +5198,7 @@ static const CRPCCommand commands[] =
     { "hidden",                      "getgrants_MP",                   &omni_getgrants,                  {"propertyid"} },
     { "hidden",                      "getactivedexsells_MP",           &omni_getactivedexsells,          {"address"} },
     { "hidden",                      "getactivecrowdsales_MP",         &omni_getactivecrowdsales,        {} },
-    { "hidden",                      "getsto_MP",                      &omni_getsto,                     {"txid", "recipientfilter"} },
+    { "hidden",                      "getsto_MP",                      &omni_getsto,                     {"txid", "recipientfilter", "limit", "cursor"} },
     { "hidden",                      "getorderbook_MP",                &omni_getorderbook,               {"propertyid", "propertyiddesired"} },
     { "hidden",                      "gettrade_MP",                    &omni_gettrade,                   {"txid"} },
     { "hidden",                      "gettransaction_MP",              &omni_gettransaction,             {"txid"} },
@@ -2940,8 +5208,33 @@ static const CRPCCommand commands[] =
 #endif
 };
 
+//! Read-only calls, which are thread-safe, so they can be executed in parallel within a batch
+static const char* const parallelCommands[] =
+{
+    "omni_getbalance",
+    "omni_getbalancehistory",
+    "omni_getbalances",
+    "omni_getbalancesforaddresses",
+    "omni_getallbalancesforaddress",
+    "omni_gettransaction",
+    "omni_getproperty",
+    "omni_getcrowdsale",
+    "omni_getorderbook",
+    "omni_getorderbookdepth",
+    "omni_gettrade",
+    "omni_getsto",
+    "omni_getblock",
+    "omni_listblocktransactions",
+    "omni_listaddresstransactions",
+    "omni_getpayload",
+    "omni_getnonfungibletokens",
+    "omni_getnonfungibletokendata",
+};
+
 void RegisterOmniDataRetrievalRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
-        tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+        tableRPC.appendCommand(commands[vcidx].name, WithRPCStats(commands[vcidx]));
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(parallelCommands); vcidx++)
+        tableRPC.markParallel(parallelCommands[vcidx]);
 }
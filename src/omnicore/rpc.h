@@ -14,7 +14,29 @@
 #ifndef BITCOIN_OMNICORE_RPC_H
 #define BITCOIN_OMNICORE_RPC_H
 
+#include <omnicore/dbspinfo.h>
+
+#include <stdint.h>
+#include <string>
+
+class CMPMetaDEx;
+class UniValue;
+
+namespace mastercore
+{
+class CStateSnapshot;
+}
+
 /** Throws a JSONRPCError, depending on error code. */
 void PopulateFailure(int error);
 
+/** Adds the metadata of a property to a JSON object. */
+void PropertyToJSON(const CMPSPInfo::Listing& sProperty, UniValue& property_obj);
+
+/** Adds the details of a MetaDEx order to a JSON object. */
+void MetaDexObjectToJSON(const CMPMetaDEx& obj, UniValue& metadex_obj);
+
+/** Adds the balances of an address in a snapshot to a JSON object, and returns whether any is not zero. */
+bool BalanceToJSON(const mastercore::CStateSnapshot& snapshot, const std::string& address, uint32_t property, UniValue& balance_obj, bool divisible);
+
 #endif /* BITCOIN_OMNICORE_RPC_H */
@@ -0,0 +1,144 @@
+/**
+ * @file rpcjsonstream.cpp
+ *
+ * This file contains the incremental JSON serialization of large RPC results,
+ * which are written into the HTTP reply in parts.
+ */
+
+#include <omnicore/rpcjsonstream.h>
+
+#include <univalue.h>
+
+#include <assert.h>
+
+#include <string>
+#include <vector>
+
+CJSONStreamWriter::CJSONStreamWriter(const FlushFunction& flush, size_t nFlushSize)
+  : m_flush(flush), m_nFlushSize(nFlushSize), m_fAfterKey(false), m_fFlushed(false), m_nPassedOn(0), m_fResultWritten(false)
+{
+}
+
+void CJSONStreamWriter::Separate()
+{
+    if (m_fAfterKey) {
+        m_fAfterKey = false;
+        return;
+    }
+    if (!m_vFirst.empty()) {
+        if (!m_vFirst.back()) m_buffer += ',';
+        m_vFirst.back() = false;
+    }
+}
+
+void CJSONStreamWriter::MaybeFlush()
+{
+    if (m_buffer.size() >= m_nFlushSize) {
+        Flush();
+    }
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    Separate();
+    m_buffer += '[';
+    m_vFirst.push_back(true);
+}
+
+void CJSONStreamWriter::EndArray()
+{
+    assert(!m_vFirst.empty());
+    m_vFirst.pop_back();
+    m_buffer += ']';
+    MaybeFlush();
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    Separate();
+    m_buffer += '{';
+    m_vFirst.push_back(true);
+}
+
+void CJSONStreamWriter::EndObject()
+{
+    assert(!m_vFirst.empty());
+    m_vFirst.pop_back();
+    m_buffer += '}';
+    MaybeFlush();
+}
+
+void CJSONStreamWriter::Key(const std::string& key)
+{
+    Separate();
+    m_buffer += UniValue(key).write();
+    m_buffer += ':';
+    m_fAfterKey = true;
+}
+
+void CJSONStreamWriter::Value(const UniValue& value)
+{
+    if (value.isArray()) {
+        BeginArray();
+        for (const UniValue& element : value.getValues()) {
+            Value(element);
+        }
+        EndArray();
+    } else if (value.isObject()) {
+        BeginObject();
+        const std::vector<std::string>& keys = value.getKeys();
+        const std::vector<UniValue>& values = value.getValues();
+        for (size_t n = 0; n < keys.size(); ++n) {
+            Key(keys[n]);
+            Value(values[n]);
+        }
+        EndObject();
+    } else {
+        Separate();
+        m_buffer += value.write();
+        MaybeFlush();
+    }
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (m_buffer.empty()) return;
+    m_flush(m_buffer);
+    m_nPassedOn += m_buffer.size();
+    m_buffer.clear();
+    m_fFlushed = true;
+}
+
+std::string CJSONStreamWriter::TakeBuffer()
+{
+    std::string buffer;
+    buffer.swap(m_buffer);
+    m_nPassedOn += buffer.size();
+    return buffer;
+}
+
+CRPCArrayWriter::CRPCArrayWriter(CJSONStreamWriter* writer)
+  : m_writer(writer), m_array(UniValue::VARR), m_nSize(0)
+{
+    if (m_writer) m_writer->BeginArray();
+}
+
+void CRPCArrayWriter::push_back(const UniValue& element)
+{
+    ++m_nSize;
+    if (m_writer) {
+        m_writer->Value(element);
+    } else {
+        m_array.push_back(element);
+    }
+}
+
+UniValue CRPCArrayWriter::Finish()
+{
+    if (m_writer) {
+        m_writer->EndArray();
+        m_writer->SetResultWritten();
+        return NullUniValue;
+    }
+    return m_array;
+}
@@ -0,0 +1,103 @@
+#ifndef BITCOIN_OMNICORE_RPCJSONSTREAM_H
+#define BITCOIN_OMNICORE_RPCJSONSTREAM_H
+
+#include <univalue.h>
+
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+//! Size of the serialized JSON, after which it's passed on
+static const size_t JSON_STREAM_FLUSH_SIZE = 64 * 1024;
+
+/**
+ * Serializes JSON incrementally, and passes it on in parts.
+ *
+ * The serialized JSON is passed on, once it exceeds the flush size, so large
+ * values are never held in memory as a whole string. Parts are only cut
+ * between complete values, so a string is never split.
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string& part)> FlushFunction;
+
+private:
+    FlushFunction m_flush;
+    size_t m_nFlushSize;
+    std::string m_buffer;
+    //! Whether the next element is the first one, for every open array or object
+    std::vector<bool> m_vFirst;
+    //! Whether a key was written, which is followed by its value
+    bool m_fAfterKey;
+    //! Whether anything was passed on
+    bool m_fFlushed;
+    //! Number of bytes passed on or taken
+    size_t m_nPassedOn;
+    //! Whether the result of an RPC call was written by its handler
+    bool m_fResultWritten;
+
+    /** Writes the separator before the next element, if needed. */
+    void Separate();
+
+    /** Passes the buffer on, once it exceeds the flush size. */
+    void MaybeFlush();
+
+public:
+    explicit CJSONStreamWriter(const FlushFunction& flush, size_t nFlushSize = JSON_STREAM_FLUSH_SIZE);
+
+    void BeginArray();
+    void EndArray();
+    void BeginObject();
+    void EndObject();
+
+    /** Writes the key of the next value of an object. */
+    void Key(const std::string& key);
+
+    /** Writes a value, and the elements of arrays and objects one by one. */
+    void Value(const UniValue& value);
+
+    /** Passes the buffer on. */
+    void Flush();
+
+    /** Returns and clears the buffer, which wasn't passed on yet. */
+    std::string TakeBuffer();
+
+    /** Returns whether anything was passed on. */
+    bool HasFlushed() const { return m_fFlushed; }
+
+    /** Returns the number of bytes serialized so far. */
+    size_t GetSize() const { return m_nPassedOn + m_buffer.size(); }
+
+    /** Records that the handler of an RPC call wrote its result, instead of returning it. */
+    void SetResultWritten() { m_fResultWritten = true; }
+    bool IsResultWritten() const { return m_fResultWritten; }
+};
+
+/**
+ * Collects the elements of an array, which is the result of an RPC call.
+ *
+ * If a result writer is given, the elements are written right away, so the
+ * array is never held in memory as a whole.
+ */
+class CRPCArrayWriter
+{
+private:
+    CJSONStreamWriter* m_writer;
+    UniValue m_array;
+    size_t m_nSize;
+
+public:
+    explicit CRPCArrayWriter(CJSONStreamWriter* writer);
+
+    void push_back(const UniValue& element);
+
+    /** Returns the number of elements. */
+    size_t size() const { return m_nSize; }
+
+    /** Returns the result of the handler, which is null, if the array was written. */
+    UniValue Finish();
+};
+
+#endif // BITCOIN_OMNICORE_RPCJSONSTREAM_H
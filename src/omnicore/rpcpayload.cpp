@@ -2,6 +2,7 @@
 #include <omnicore/nftdb.h>
 #include <omnicore/rpcvalues.h>
 #include <omnicore/rpcrequirements.h>
+#include <omnicore/rpcstats.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/sp.h>
 #include <omnicore/tx.h>
@@ -775,5 +776,5 @@ static const CRPCCommand commands[] =
 void RegisterOmniPayloadCreationRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
-        tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+        tableRPC.appendCommand(commands[vcidx].name, WithRPCStats(commands[vcidx]));
 }
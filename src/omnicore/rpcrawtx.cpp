@@ -1,7 +1,9 @@
 #include <omnicore/createtx.h>
 #include <omnicore/omnicore.h>
+#include <omnicore/rawtxsession.h>
 #include <omnicore/rpc.h>
 #include <omnicore/rpctxobject.h>
+#include <omnicore/rpcstats.h>
 #include <omnicore/rpcvalues.h>
 
 #include <coins.h>
@@ -14,18 +16,18 @@
 #include <sync.h>
 #include <uint256.h>
 #include <util/strencodings.h>
+#include <util/time.h>
 #include <wallet/rpcwallet.h>
 
 #include <univalue.h>
 
 #include <stdint.h>
+#include <functional>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
-extern RecursiveMutex cs_main;
-
-using mastercore::cs_tx_cache;
-using mastercore::view;
+using mastercore::rawTxSessions;
 
 
 static UniValue omni_decodetransaction(const JSONRPCRequest& request)
@@ -94,17 +96,9 @@ static UniValue omni_decodetransaction(const JSONRPCRequest& request)
         blockHeight = request.params[2].get_int();
     }
 
+    // the provided inputs are looked up first, and no lock is held across the lookups of the others
     UniValue txObj(UniValue::VOBJ);
-    int populateResult = -3331;
-    {
-        LOCK2(cs_main, cs_tx_cache);
-        // temporarily switch global coins view cache for transaction inputs
-        std::swap(view, viewTemp);
-        // then get the results
-        populateResult = populateRPCTransactionObject(tx, uint256(), txObj, "", false, "", blockHeight, pWallet.get());
-        // and restore the original, unpolluted coins view cache
-        std::swap(viewTemp, view);
-    }
+    int populateResult = populateRPCTransactionObject(tx, uint256(), txObj, "", false, "", blockHeight, pWallet.get(), &viewTemp);
 
     if (populateResult != 0) PopulateFailure(populateResult);
 
@@ -304,6 +298,191 @@ static UniValue omni_createrawtx_change(const JSONRPCRequest& request)
     return EncodeHexTx(CTransaction(tx));
 }
 
+/** Parses the id of a raw transaction session. */
+static uint256 ParseSessionId(const UniValue& value)
+{
+    return ParseHashV(value, "session");
+}
+
+/**
+ * Parses a step of a raw transaction session, which is applied to the session, once all
+ * steps were parsed, so the session is not modified, if one of them is invalid.
+ */
+static std::function<void(CRawTxSession&)> ParseSessionStep(const UniValue& value, interfaces::Wallet* iWallet)
+{
+    if (!value.isObject()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid step, expected object with \"type\"");
+    }
+    const std::string type = find_value(value, "type").isStr() ? find_value(value, "type").get_str() : "";
+
+    if (type == "input") {
+        // the previous output is optional, and only needed to determine the change
+        if (find_value(value, "scriptPubKey").isNull()) {
+            const uint256 txid = ParseHashO(value, "txid");
+            const uint32_t nOut = ParseOutputIndex(find_value(value, "vout"));
+            return [txid, nOut](CRawTxSession& session) { session.builder.addInput(txid, nOut); };
+        }
+        UniValue prevTxs(UniValue::VARR);
+        prevTxs.push_back(value);
+        const std::vector<PrevTxsEntry> prevTxsParsed = ParsePrevTxs(prevTxs);
+        return [prevTxsParsed](CRawTxSession& session) {
+            session.builder.addInputs(prevTxsParsed);
+            InputsToView(prevTxsParsed, session.view);
+        };
+    }
+    if (type == "opreturn") {
+        const std::vector<unsigned char> payload = ParseHexO(value, "payload");
+        return [payload](CRawTxSession& session) { session.builder.addOpReturn(payload); };
+    }
+    if (type == "multisig") {
+        const std::vector<unsigned char> payload = ParseHexO(value, "payload");
+        const std::string obfuscationSeed = ParseAddressOrEmpty(find_value(value, "seed"));
+        const CPubKey redeemKey = ParsePubKeyOrAddress(iWallet, find_value(value, "redeemkey"));
+        return [payload, obfuscationSeed, redeemKey](CRawTxSession& session) { session.builder.addMultisig(payload, obfuscationSeed, redeemKey); };
+    }
+    if (type == "reference") {
+        const std::string destination = ParseAddress(find_value(value, "destination"));
+        const int64_t amount = find_value(value, "amount").isNull() ? 0 : ParseAmount(find_value(value, "amount"), true);
+        return [destination, amount](CRawTxSession& session) { session.builder.addReference(destination, amount); };
+    }
+    if (type == "change") {
+        const std::string destination = ParseAddress(find_value(value, "destination"));
+        const int64_t txFee = AmountFromValue(find_value(value, "fee"));
+        const uint32_t nOut = find_value(value, "position").isNull() ? 0 : find_value(value, "position").get_int64();
+        return [destination, txFee, nOut](CRawTxSession& session) { session.builder.addChange(destination, session.view, txFee, nOut); };
+    }
+
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid step type, expected \"input\", \"opreturn\", \"multisig\", \"reference\" or \"change\"");
+}
+
+static UniValue omni_rawtxsession_create(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_rawtxsession_create",
+       "\nOpens a session to build a raw transaction with several calls.\n"
+       "\nThe transaction and the previous outputs of its inputs are kept by the server, until the "
+       "session is finalized, or wasn't used for " + std::to_string(DEFAULT_RAWTX_SESSION_TIMEOUT / 60) + " minutes.\n",
+       {
+           {"rawtx", RPCArg::Type::STR, /* default */ "a new transaction", "the raw transaction to extend\n"},
+       },
+       RPCResult{
+           RPCResult::Type::STR_HEX, "session", "the id of the session"
+       },
+       RPCExamples{
+           HelpExampleCli("omni_rawtxsession_create", "")
+           + HelpExampleRpc("omni_rawtxsession_create", "\"01000000000000000000\"")
+       }
+    }.Check(request);
+
+    CMutableTransaction tx;
+    if (!request.params[0].isNull()) tx = ParseMutableTransaction(request.params[0]);
+
+    const uint256 id = rawTxSessions.Create(tx, GetTime());
+    if (id.IsNull()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Too many open raw transaction sessions");
+    }
+
+    return id.GetHex();
+}
+
+static UniValue omni_rawtxsession_add(const JSONRPCRequest& request)
+{
+#ifdef ENABLE_WALLET
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    std::unique_ptr<interfaces::Wallet> pWallet = interfaces::MakeWallet(wallet);
+#else
+    std::unique_ptr<interfaces::Wallet> pWallet;
+#endif
+
+    RPCHelpMan{"omni_rawtxsession_add",
+       "\nAdds inputs, payloads, reference and change outputs to the transaction of a session.\n"
+       "\nThe steps are applied in order, and the transaction is not modified, if one of them is invalid. "
+       "The change is determined by the inputs, whose previous outputs were provided.\n",
+       {
+           {"session", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "the id of the session\n"},
+           {"steps", RPCArg::Type::ARR, RPCArg::Optional::NO, "a JSON array of steps\n",
+                {
+                    {"", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED, "",
+                        {
+                            {"type", RPCArg::Type::STR, RPCArg::Optional::NO, "\"input\", \"opreturn\", \"multisig\", \"reference\" or \"change\"\n"},
+                            {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "input: the hash of the input transaction\n"},
+                            {"vout", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "input: the index of the transaction output used as input\n"},
+                            {"scriptPubKey", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "input: the output script, to determine the change\n"},
+                            {"value", RPCArg::Type::AMOUNT, RPCArg::Optional::OMITTED, "input: the output value, to determine the change\n"},
+                            {"payload", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "opreturn, multisig: the hex-encoded payload to add\n"},
+                            {"seed", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "multisig: the seed for obfuscation\n"},
+                            {"redeemkey", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "multisig: a public key or address for dust redemption\n"},
+                            {"destination", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "reference, change: the address\n"},
+                            {"amount", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "reference: the optional reference amount (minimal by default)\n"},
+                            {"fee", RPCArg::Type::AMOUNT, RPCArg::Optional::OMITTED, "change: the desired transaction fees\n"},
+                            {"position", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "change: the position of the change output (first by default)\n"},
+                        }
+                    }
+                }
+           },
+       },
+       RPCResult{
+           RPCResult::Type::OBJ, "", "",
+           {
+               {RPCResult::Type::NUM, "inputs", "the number of inputs of the transaction"},
+               {RPCResult::Type::NUM, "outputs", "the number of outputs of the transaction"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_rawtxsession_add", "\"9f1cd6cd1c4b4c7a3c1e6e3e0c6b8a1f4b0b0f3f6e8f1d5c7a2b9e4d3c2b1a09\" \"[{\\\"type\\\":\\\"input\\\",\\\"txid\\\":\\\"6779a710fcd5f6fb0883ea3306360c3ad8c0a3c5de902768ec57ef3104e65eb1\\\",\\\"vout\\\":4,\\\"scriptPubKey\\\":\\\"76a9147b25205fd98d462880a3e5b0541235831ae959e588ac\\\",\\\"value\\\":0.00068257},{\\\"type\\\":\\\"opreturn\\\",\\\"payload\\\":\\\"00000000000000020000000006dac2c0\\\"}]\"")
+           + HelpExampleRpc("omni_rawtxsession_add", "\"9f1cd6cd1c4b4c7a3c1e6e3e0c6b8a1f4b0b0f3f6e8f1d5c7a2b9e4d3c2b1a09\", [{\"type\":\"reference\",\"destination\":\"1CE8bBr1dYZRMnpmyYsFEoexa1YoPz2mfB\"},{\"type\":\"change\",\"destination\":\"1CE8bBr1dYZRMnpmyYsFEoexa1YoPz2mfB\",\"fee\":0.000035}]")
+       }
+    }.Check(request);
+
+    const uint256 id = ParseSessionId(request.params[0]);
+    const UniValue& steps = request.params[1].get_array();
+
+    std::vector<std::function<void(CRawTxSession&)> > vSteps;
+    vSteps.reserve(steps.size());
+    for (size_t i = 0; i < steps.size(); ++i) {
+        vSteps.push_back(ParseSessionStep(steps[i], pWallet.get()));
+    }
+
+    UniValue response(UniValue::VOBJ);
+    bool fFound = rawTxSessions.Modify(id, GetTime(), [&vSteps, &response](CRawTxSession& session) {
+        for (const std::function<void(CRawTxSession&)>& step : vSteps) {
+            step(session);
+        }
+        response.pushKV("inputs", (uint64_t) session.builder.getTransaction().vin.size());
+        response.pushKV("outputs", (uint64_t) session.builder.getTransaction().vout.size());
+    });
+    if (!fFound) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown or expired raw transaction session");
+    }
+
+    return response;
+}
+
+static UniValue omni_rawtxsession_finalize(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"omni_rawtxsession_finalize",
+       "\nCloses a session and returns its transaction.\n",
+       {
+           {"session", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "the id of the session\n"},
+       },
+       RPCResult{
+           RPCResult::Type::STR_HEX, "rawtx", "the hex-encoded raw transaction"
+       },
+       RPCExamples{
+           HelpExampleCli("omni_rawtxsession_finalize", "\"9f1cd6cd1c4b4c7a3c1e6e3e0c6b8a1f4b0b0f3f6e8f1d5c7a2b9e4d3c2b1a09\"")
+           + HelpExampleRpc("omni_rawtxsession_finalize", "\"9f1cd6cd1c4b4c7a3c1e6e3e0c6b8a1f4b0b0f3f6e8f1d5c7a2b9e4d3c2b1a09\"")
+       }
+    }.Check(request);
+
+    const uint256 id = ParseSessionId(request.params[0]);
+
+    CMutableTransaction tx;
+    if (!rawTxSessions.Finalize(id, GetTime(), tx)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown or expired raw transaction session");
+    }
+
+    return EncodeHexTx(CTransaction(tx));
+}
+
 static const CRPCCommand commands[] =
 { //  category                         name                          actor (function)             okSafeMode
   //  -------------------------------- ----------------------------- ---------------------------- ----------
@@ -313,11 +492,14 @@ static const CRPCCommand commands[] =
     { "omni layer (raw transactions)", "omni_createrawtx_input",     &omni_createrawtx_input,     {"rawtx", "txid", "n"} },
     { "omni layer (raw transactions)", "omni_createrawtx_reference", &omni_createrawtx_reference, {"rawtx", "destination", "referenceamount"} },
     { "omni layer (raw transactions)", "omni_createrawtx_change",    &omni_createrawtx_change,    {"rawtx", "prevtxs", "destination", "fee", "position"} },
+    { "omni layer (raw transactions)", "omni_rawtxsession_create",   &omni_rawtxsession_create,   {"rawtx"} },
+    { "omni layer (raw transactions)", "omni_rawtxsession_add",      &omni_rawtxsession_add,      {"session", "steps"} },
+    { "omni layer (raw transactions)", "omni_rawtxsession_finalize", &omni_rawtxsession_finalize, {"session"} },
 
 };
 
 void RegisterOmniRawTransactionRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
-        tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+        tableRPC.appendCommand(commands[vcidx].name, mastercore::WithRPCStats(commands[vcidx]));
 }
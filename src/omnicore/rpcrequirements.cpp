@@ -2,6 +2,8 @@
 
 #include <omnicore/dbspinfo.h>
 #include <omnicore/dex.h>
+#include <omnicore/historyprune.h>
+#include <omnicore/indexproperties.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/sp.h>
 #include <omnicore/nftdb.h>
@@ -254,6 +256,21 @@ void RequireHeightInChain(int blockHeight)
     }
 }
 
+void RequireUnprunedHistory(int blockHeight)
+{
+    int prunedHeight = mastercore::GetHistoryPrunedHeight();
+    if (blockHeight < prunedHeight) {
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("History below block %d was pruned (see -omniprunehistory)", prunedHeight));
+    }
+}
+
+void RequireIndexedProperty(uint32_t propertyId)
+{
+    if (!mastercore::IsIndexedProperty(propertyId)) {
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("History of property %d is not indexed (see -omniindexproperties)", propertyId));
+    }
+}
+
 void RequireNonFungibleTokenOwner(const std::string& address, uint32_t propertyId, int64_t tokenStart, int64_t tokenEnd)
 {
     std::string rangeStartOwner = mastercore::pDbNFT->GetNonFungibleTokenOwner(propertyId, tokenStart);
@@ -28,6 +28,8 @@ void RequireSaneDExPaymentWindow(const std::string& address, uint32_t propertyId
 void RequireSaneDExFee(const std::string& address, uint32_t propertyId);
 void RequireSaneNonFungibleRange(int64_t tokenStart, int64_t tokenEnd);
 void RequireHeightInChain(int blockHeight);
+void RequireUnprunedHistory(int blockHeight);
+void RequireIndexedProperty(uint32_t propertyId);
 void RequireNonFungibleTokenOwner(const std::string& address, uint32_t propertyId, int64_t tokenStart, int64_t tokenEnd);
 
 // TODO:
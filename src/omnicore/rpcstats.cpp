@@ -0,0 +1,195 @@
+/**
+ * @file rpcstats.cpp
+ *
+ * This file contains the call counts, latencies, lock wait times and response
+ * sizes of the Omni RPC methods.
+ */
+
+#include <omnicore/rpcstats.h>
+
+#include <omnicore/rpcjsonstream.h>
+#include <omnicore/timedmutex.h>
+
+#include <rpc/request.h>
+#include <rpc/server.h>
+#include <sync.h>
+#include <util/time.h>
+
+#include <univalue.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mastercore
+{
+//! Guards the registry of the statistics
+static Mutex cs_rpcstats;
+//! Statistics by method name
+static std::map<std::string, std::shared_ptr<CRPCMethodStats>> mapRPCStats GUARDED_BY(cs_rpcstats);
+//! Commands, which record their calls, and remain valid until shutdown
+static std::deque<CRPCCommand> dequeStatsCommands GUARDED_BY(cs_rpcstats);
+
+template <typename T>
+static void UpdateMax(std::atomic<T>& max, T value)
+{
+    T current = max.load(std::memory_order_relaxed);
+    while (current < value && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+CRPCMethodStats::CRPCMethodStats()
+{
+    for (size_t n = 0; n < RPC_LATENCY_BUCKETS; ++n) {
+        vLatency[n] = 0;
+    }
+}
+
+void CRPCMethodStats::Add(int64_t nCallTime, int64_t nCallLockWait, uint64_t nCallResponseBytes, bool fError)
+{
+    nCalls.fetch_add(1, std::memory_order_relaxed);
+    if (fError) nErrors.fetch_add(1, std::memory_order_relaxed);
+    nTime.fetch_add(nCallTime, std::memory_order_relaxed);
+    UpdateMax(nMaxTime, nCallTime);
+    nLockWait.fetch_add(nCallLockWait, std::memory_order_relaxed);
+    UpdateMax(nMaxLockWait, nCallLockWait);
+    nResponseBytes.fetch_add(nCallResponseBytes, std::memory_order_relaxed);
+    UpdateMax(nMaxResponseBytes, nCallResponseBytes);
+
+    size_t bucket = 0;
+    while (bucket < RPC_LATENCY_BUCKETS - 1 && nCallTime > RPC_LATENCY_LIMITS[bucket]) ++bucket;
+    vLatency[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void CRPCMethodStats::Reset()
+{
+    nCalls = 0;
+    nErrors = 0;
+    nTime = 0;
+    nMaxTime = 0;
+    nLockWait = 0;
+    nMaxLockWait = 0;
+    nResponseBytes = 0;
+    nMaxResponseBytes = 0;
+    for (size_t n = 0; n < RPC_LATENCY_BUCKETS; ++n) {
+        vLatency[n] = 0;
+    }
+}
+
+const CRPCCommand* WithRPCStats(const CRPCCommand& command)
+{
+    LOCK(cs_rpcstats);
+    std::shared_ptr<CRPCMethodStats>& stats = mapRPCStats[command.name];
+    if (!stats) stats = std::make_shared<CRPCMethodStats>();
+
+    const CRPCCommand::Actor actor = command.actor;
+    const std::shared_ptr<CRPCMethodStats> pStats = stats;
+    dequeStatsCommands.emplace_back(command.category, command.name,
+            [actor, pStats](const JSONRPCRequest& request, UniValue& result, bool last_handler) {
+                // help requests are not counted
+                if (request.fHelp) return actor(request, result, last_handler);
+
+                const int64_t nStart = GetTimeMicros();
+                const int64_t nLockWaitStart = GetThreadLockWaitTime();
+                const size_t nWrittenStart = request.resultWriter ? request.resultWriter->GetSize() : 0;
+                bool fHandled = false;
+                try {
+                    fHandled = actor(request, result, last_handler);
+                } catch (...) {
+                    pStats->Add(GetTimeMicros() - nStart, GetThreadLockWaitTime() - nLockWaitStart, 0, true);
+                    throw;
+                }
+
+                // results written into the reply are counted by the writer
+                uint64_t nResponseBytes = 0;
+                if (request.resultWriter && request.resultWriter->IsResultWritten()) {
+                    nResponseBytes = request.resultWriter->GetSize() - nWrittenStart;
+                } else {
+                    nResponseBytes = GetJSONSize(result);
+                }
+                pStats->Add(GetTimeMicros() - nStart, GetThreadLockWaitTime() - nLockWaitStart, nResponseBytes, false);
+                return fHandled;
+            },
+            command.argNames, command.unique_id);
+
+    return &dequeStatsCommands.back();
+}
+
+size_t GetJSONSize(const UniValue& value)
+{
+    switch (value.getType()) {
+        case UniValue::VNULL:
+            return 4;
+        case UniValue::VBOOL:
+            return value.get_bool() ? 4 : 5;
+        case UniValue::VSTR:
+            return value.getValStr().size() + 2;
+        case UniValue::VNUM:
+            return value.getValStr().size();
+        case UniValue::VARR: {
+            const std::vector<UniValue>& values = value.getValues();
+            size_t size = 2 + (values.empty() ? 0 : values.size() - 1);
+            for (const UniValue& element : values) {
+                size += GetJSONSize(element);
+            }
+            return size;
+        }
+        case UniValue::VOBJ: {
+            const std::vector<std::string>& keys = value.getKeys();
+            const std::vector<UniValue>& values = value.getValues();
+            size_t size = 2 + (values.empty() ? 0 : values.size() - 1);
+            for (size_t n = 0; n < keys.size(); ++n) {
+                size += keys[n].size() + 3 + GetJSONSize(values[n]);
+            }
+            return size;
+        }
+    }
+    return 0;
+}
+
+UniValue GetRPCStats(bool fReset)
+{
+    UniValue limits(UniValue::VARR);
+    for (int64_t nLimit : RPC_LATENCY_LIMITS) {
+        limits.push_back(nLimit / 1000000.0);
+    }
+
+    UniValue methods(UniValue::VARR);
+    LOCK(cs_rpcstats);
+    for (const auto& entry : mapRPCStats) {
+        CRPCMethodStats& stats = *entry.second;
+        const uint64_t nCalls = stats.nCalls;
+        if (nCalls == 0) continue;
+
+        UniValue latency(UniValue::VARR);
+        for (size_t n = 0; n < RPC_LATENCY_BUCKETS; ++n) {
+            latency.push_back((uint64_t) stats.vLatency[n]);
+        }
+
+        UniValue method(UniValue::VOBJ);
+        method.pushKV("method", entry.first);
+        method.pushKV("calls", nCalls);
+        method.pushKV("errors", (uint64_t) stats.nErrors);
+        method.pushKV("totaltime", stats.nTime / 1000000.0);
+        method.pushKV("maxtime", stats.nMaxTime / 1000000.0);
+        method.pushKV("latency", latency);
+        method.pushKV("lockwaittime", stats.nLockWait / 1000000.0);
+        method.pushKV("maxlockwaittime", stats.nMaxLockWait / 1000000.0);
+        method.pushKV("responsebytes", (uint64_t) stats.nResponseBytes);
+        method.pushKV("maxresponsebytes", (uint64_t) stats.nMaxResponseBytes);
+        methods.push_back(method);
+
+        if (fReset) stats.Reset();
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.pushKV("latencylimits", limits);
+    response.pushKV("methods", methods);
+    return response;
+}
+} // namespace mastercore
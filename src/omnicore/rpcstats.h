@@ -0,0 +1,57 @@
+#ifndef BITCOIN_OMNICORE_RPCSTATS_H
+#define BITCOIN_OMNICORE_RPCSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+class CRPCCommand;
+class UniValue;
+
+namespace mastercore
+{
+//! Upper limits of the latency buckets in microseconds, the last bucket holds all slower calls
+static const int64_t RPC_LATENCY_LIMITS[] = {100, 300, 1000, 3000, 10000, 30000, 100000, 300000, 1000000, 3000000, 10000000};
+static const size_t RPC_LATENCY_BUCKETS = sizeof(RPC_LATENCY_LIMITS) / sizeof(RPC_LATENCY_LIMITS[0]) + 1;
+
+/** Counters of the calls of an RPC method, which are updated without locks. */
+struct CRPCMethodStats
+{
+    std::atomic<uint64_t> nCalls{0};
+    std::atomic<uint64_t> nErrors{0};
+    //! Total and maximal time spent in the handler, in microseconds
+    std::atomic<int64_t> nTime{0};
+    std::atomic<int64_t> nMaxTime{0};
+    //! Total and maximal time spent waiting for cs_tally, in microseconds
+    std::atomic<int64_t> nLockWait{0};
+    std::atomic<int64_t> nMaxLockWait{0};
+    //! Total and maximal size of the serialized results
+    std::atomic<uint64_t> nResponseBytes{0};
+    std::atomic<uint64_t> nMaxResponseBytes{0};
+    std::atomic<uint64_t> vLatency[RPC_LATENCY_BUCKETS];
+
+    CRPCMethodStats();
+
+    /** Records a call. */
+    void Add(int64_t nCallTime, int64_t nCallLockWait, uint64_t nCallResponseBytes, bool fError);
+
+    /** Sets all counters to zero. */
+    void Reset();
+};
+
+/**
+ * Returns a command, which calls the given command and records its calls.
+ *
+ * The returned command is valid until shutdown.
+ */
+const CRPCCommand* WithRPCStats(const CRPCCommand& command);
+
+/** Returns the number of bytes of a value, when serialized as JSON, ignoring escaped characters. */
+size_t GetJSONSize(const UniValue& value);
+
+/** Returns the statistics of all called methods, and optionally resets them. */
+UniValue GetRPCStats(bool fReset);
+}
+
+#endif // BITCOIN_OMNICORE_RPCSTATS_H
@@ -11,6 +11,7 @@
 #include <omnicore/omnicore.h>
 #include <omnicore/pending.h>
 #include <omnicore/rpcrequirements.h>
+#include <omnicore/rpcstats.h>
 #include <omnicore/rpcvalues.h>
 #include <omnicore/rules.h>
 #include <omnicore/sp.h>
@@ -33,8 +34,12 @@
 #include <univalue.h>
 
 #include <stdint.h>
+#include <limits>
+#include <map>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 using std::runtime_error;
 using namespace mastercore;
@@ -234,6 +239,121 @@ static UniValue omni_send(const JSONRPCRequest& request)
     }
 }
 
+static UniValue omni_sendbatch(const JSONRPCRequest& request)
+{
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    std::unique_ptr<interfaces::Wallet> pwallet = interfaces::MakeWallet(wallet);
+
+    RPCHelpMan{"omni_sendbatch",
+       "\nCreate and broadcast a sequence of simple send transactions from one address.\n"
+       "\nEach transaction spends the change of the previous one, so the transactions form an unconfirmed chain, which is\n"
+       "limited by the mempool ancestor limit. If a transaction can't be created, the transactions before it remain sent.\n",
+       {
+           {"fromaddress", RPCArg::Type::STR, RPCArg::Optional::NO, "the address to send from\n"},
+           {"sends", RPCArg::Type::ARR, RPCArg::Optional::NO, "a JSON array of simple sends\n",
+                {
+                    {"", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED, "",
+                        {
+                            {"toaddress", RPCArg::Type::STR, RPCArg::Optional::NO, "the address of the receiver\n"},
+                            {"propertyid", RPCArg::Type::NUM, RPCArg::Optional::NO, "the identifier of the tokens to send\n"},
+                            {"amount", RPCArg::Type::STR, RPCArg::Optional::NO, "the amount to send\n"},
+                        }
+                    }
+                }
+           },
+       },
+       RPCResult{
+           RPCResult::Type::ARR, "", "",
+           {
+               {RPCResult::Type::STR_HEX, "hash", "the hex-encoded transaction hash"},
+           }
+       },
+       RPCExamples{
+           HelpExampleCli("omni_sendbatch", "\"3M9qvHKtgARhqcMtM5cRT9VaiDJ5PSfQGY\" \"[{\\\"toaddress\\\":\\\"37FaKponF7zqoMLUjEiko25pDiuVH5YLEa\\\",\\\"propertyid\\\":1,\\\"amount\\\":\\\"100.0\\\"}]\"")
+           + HelpExampleRpc("omni_sendbatch", "\"3M9qvHKtgARhqcMtM5cRT9VaiDJ5PSfQGY\", [{\"toaddress\":\"37FaKponF7zqoMLUjEiko25pDiuVH5YLEa\",\"propertyid\":1,\"amount\":\"100.0\"}]")
+       }
+    }.Check(request);
+
+    if (!autoCommit) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Batch sends can't be created without being committed, because each transaction spends the change of the previous one");
+    }
+
+    // obtain parameters & info
+    std::string fromAddress = ParseAddress(request.params[0]);
+    const UniValue& sends = request.params[1].get_array();
+    if (sends.empty()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, no sends given");
+    }
+    if (sends.size() > DEFAULT_ANCESTOR_LIMIT) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid parameter, at most %d sends can be chained", DEFAULT_ANCESTOR_LIMIT));
+    }
+
+    struct BatchSend
+    {
+        std::string toAddress;
+        uint32_t propertyId;
+        int64_t amount;
+    };
+
+    std::vector<BatchSend> vSends;
+    std::map<uint32_t, int64_t> mapTotals;
+    for (size_t i = 0; i < sends.size(); ++i) {
+        if (!sends[i].isObject()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "expected object with {\"toaddress\",\"propertyid\",\"amount\"}");
+        }
+        const UniValue& send = sends[i].get_obj();
+        BatchSend entry;
+        entry.toAddress = ParseAddress(find_value(send, "toaddress"));
+        entry.propertyId = ParsePropertyId(find_value(send, "propertyid"));
+        RequireExistingProperty(entry.propertyId);
+        entry.amount = ParseAmount(find_value(send, "amount"), isPropertyDivisible(entry.propertyId));
+        int64_t& total = mapTotals[entry.propertyId];
+        if (total > std::numeric_limits<int64_t>::max() - entry.amount) {
+            throw JSONRPCError(RPC_TYPE_ERROR, "Invalid amount, the total of the sends is out of range");
+        }
+        total += entry.amount;
+        vSends.push_back(entry);
+    }
+
+    // perform checks
+    for (const std::pair<const uint32_t, int64_t>& total : mapTotals) {
+        RequireBalance(fromAddress, total.first, total.second);
+    }
+
+    // the transactions are created and committed under one wallet lock, so the coin selection
+    // of each transaction finds the change of the previous one, and nothing else interferes
+    std::vector<uint256> vTxids;
+    int result = 0;
+    {
+        auto locked_chain = wallet->chain().lock();
+        LOCK(wallet->cs_wallet);
+
+        for (const BatchSend& send : vSends) {
+            std::vector<unsigned char> payload = CreatePayload_SimpleSend(send.propertyId, send.amount);
+            uint256 txid;
+            std::string rawHex;
+            result = WalletTxBuilder(fromAddress, send.toAddress, "", 0, payload, txid, rawHex, true, pwallet.get());
+            if (result != 0) break;
+            vTxids.push_back(txid);
+        }
+    }
+
+    for (size_t i = 0; i < vTxids.size(); ++i) {
+        PendingAdd(vTxids[i], fromAddress, MSC_TYPE_SIMPLE_SEND, vSends[i].propertyId, vSends[i].amount);
+    }
+
+    // check error and return the txids
+    if (result != 0) {
+        throw JSONRPCError(result, strprintf("%s (%d of %d transactions were sent)", error_str(result), vTxids.size(), vSends.size()));
+    }
+
+    UniValue response(UniValue::VARR);
+    for (const uint256& txid : vTxids) {
+        response.push_back(txid.GetHex());
+    }
+    return response;
+}
+
 static UniValue omni_sendall(const JSONRPCRequest& request)
 {
     std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
@@ -2121,6 +2241,7 @@ static const CRPCCommand commands[] =
   //  ------------------------------------ ------------------------------- ------------------------------ ----------
     { "omni layer (transaction creation)", "omni_sendrawtx",               &omni_sendrawtx,               {"fromaddress", "rawtransaction", "referenceaddress", "redeemaddress", "referenceamount"} },
     { "omni layer (transaction creation)", "omni_send",                    &omni_send,                    {"fromaddress", "toaddress", "propertyid", "amount", "redeemaddress", "referenceamount"} },
+    { "omni layer (transaction creation)", "omni_sendbatch",               &omni_sendbatch,               {"fromaddress", "sends"} },
     { "omni layer (transaction creation)", "omni_senddexsell",             &omni_senddexsell,             {"fromaddress", "propertyidforsale", "amountforsale", "amountdesired", "paymentwindow", "minacceptfee", "action"} },
     { "omni layer (transaction creation)", "omni_sendnewdexorder",         &omni_sendnewdexorder,         {"fromaddress", "propertyidforsale", "amountforsale", "amountdesired", "paymentwindow", "minacceptfee"} },
     { "omni layer (transaction creation)", "omni_sendupdatedexorder",      &omni_sendupdatedexorder,      {"fromaddress", "propertyidforsale", "amountforsale", "amountdesired", "paymentwindow", "minacceptfee"} },
@@ -2165,5 +2286,5 @@ static const CRPCCommand commands[] =
 void RegisterOmniTransactionCreationRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
-        tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+        tableRPC.appendCommand(commands[vcidx].name, WithRPCStats(commands[vcidx]));
 }
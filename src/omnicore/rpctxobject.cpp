@@ -13,6 +13,7 @@
 #include <omnicore/dbtxlist.h>
 #include <omnicore/dex.h>
 #include <omnicore/errors.h>
+#include <omnicore/historyprune.h>
 #include <omnicore/mdex.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/parsing.h>
@@ -20,6 +21,7 @@
 #include <omnicore/sp.h>
 #include <omnicore/sto.h>
 #include <omnicore/tx.h>
+#include <omnicore/txobjectcache.h>
 #include <omnicore/utilsbitcoin.h>
 #include <omnicore/walletutils.h>
 
@@ -32,8 +34,6 @@
 
 #include <univalue.h>
 
-#include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast.hpp>
 
 #include <stdint.h>
 #include <string>
@@ -42,6 +42,142 @@
 // Namespaces
 using namespace mastercore;
 
+/**
+ * Populates the fields shared by all transaction objects of an interpreted Omni transaction.
+ */
+static void populateRPCTransactionFields(CMPTransaction& mp_obj, UniValue& txobj, const uint256& blockHash, int64_t blockTime, int blockHeight, int confirmations, bool valid, int positionInBlock, const std::string& invalidReason, bool extendedDetails, std::string extendedDetailsFilter, interfaces::Wallet* iWallet)
+{
+    // populate some initial info for the transaction
+    bool fMine = false;
+    if (IsMyAddress(mp_obj.getSender(), iWallet) || IsMyAddress(mp_obj.getReceiver(), iWallet)) fMine = true;
+    txobj.pushKV("txid", mp_obj.getHash().GetHex());
+    txobj.pushKV("fee", FormatDivisibleMP(mp_obj.getFeePaid()));
+    txobj.pushKV("sendingaddress", mp_obj.getSender());
+    if (showRefForTx(mp_obj.getType())) txobj.pushKV("referenceaddress", mp_obj.getReceiver());
+    txobj.pushKV("ismine", fMine);
+    txobj.pushKV("version", (uint64_t)mp_obj.getVersion());
+    txobj.pushKV("type_int", (uint64_t)mp_obj.getType());
+    if (mp_obj.getType() != MSC_TYPE_SIMPLE_SEND) { // Type 0 will add "Type" attribute during populateRPCTypeSimpleSend
+        txobj.pushKV("type", mp_obj.getTypeString());
+    }
+
+    // populate type specific info and extended details if requested
+    // extended details are not available for unconfirmed transactions
+    if (confirmations <= 0) extendedDetails = false;
+    populateRPCTypeInfo(mp_obj, txobj, mp_obj.getType(), extendedDetails, extendedDetailsFilter, confirmations, iWallet);
+
+    // state and chain related information
+    if (confirmations != 0 && !blockHash.IsNull()) {
+        txobj.pushKV("valid", valid);
+        if (!valid) {
+            txobj.pushKV("invalidreason", invalidReason);
+        }
+        txobj.pushKV("blockhash", blockHash.GetHex());
+        txobj.pushKV("blocktime", blockTime);
+        txobj.pushKV("positioninblock", positionInBlock);
+    }
+    if (confirmations != 0) {
+        txobj.pushKV("block", blockHeight);
+    }
+    txobj.pushKV("confirmations", confirmations);
+}
+
+/**
+ * Populates the basic transaction object from the cache, and updates the fields, which depend on the wallet or the chain tip.
+ *
+ * Returns MP_TX_NOT_FOUND, if the transaction is not cached, or its block is no longer in the active chain.
+ */
+static int populateRPCTransactionObjectFromCache(const uint256& txid, UniValue& txobj, const std::string& filterAddress, interfaces::Wallet* iWallet)
+{
+    COmniTxObjectCache::Entry entry;
+    if (!rpcTxCache.Get(txid, entry)) {
+        return MP_TX_NOT_FOUND;
+    }
+
+    int blockHeight = 0;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pBlockIndex = LookupBlockIndex(entry.blockHash);
+        if (nullptr == pBlockIndex || !::ChainActive().Contains(pBlockIndex)) {
+            return MP_TX_NOT_FOUND;
+        }
+        blockHeight = pBlockIndex->nHeight;
+    }
+    int confirmations = 1 + GetHeight() - blockHeight;
+
+    // check if we're filtering from listtransactions_MP, and if so whether we have a non-match we want to skip
+    if (!filterAddress.empty() && entry.sender != filterAddress && entry.receiver != filterAddress) return -1;
+
+    bool fMine = false;
+    if (IsMyAddress(entry.sender, iWallet) || IsMyAddress(entry.receiver, iWallet)) fMine = true;
+    txobj.pushKVs(entry.txobj);
+    txobj.pushKV("ismine", fMine);
+    txobj.pushKV("confirmations", confirmations);
+
+    return 0;
+}
+
+/**
+ * Populates the transaction object from the fields recorded, when the transaction was processed.
+ *
+ * Basic transaction objects are cached, as they don't change, unless the block is disconnected.
+ *
+ * Returns MP_TX_NOT_FOUND, if there is no record, or the recorded block is no longer in the active chain.
+ */
+static int populateRPCTransactionObjectFromRecord(const uint256& txid, UniValue& txobj, std::string filterAddress, bool extendedDetails, std::string extendedDetailsFilter, interfaces::Wallet* iWallet)
+{
+    if (!extendedDetails) {
+        int cacheRC = populateRPCTransactionObjectFromCache(txid, txobj, filterAddress, iWallet);
+        if (cacheRC != MP_TX_NOT_FOUND) {
+            return cacheRC;
+        }
+    }
+
+    COmniTransactionDB::Record record;
+    if (!pDbTransaction->FetchTransactionRecord(txid, record)) {
+        return MP_TX_NOT_FOUND;
+    }
+
+    int blockHeight = 0;
+    int64_t blockTime = 0;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pBlockIndex = LookupBlockIndex(record.blockHash);
+        if (nullptr == pBlockIndex || !::ChainActive().Contains(pBlockIndex)) {
+            return MP_TX_NOT_FOUND;
+        }
+        blockHeight = pBlockIndex->nHeight;
+        blockTime = pBlockIndex->GetBlockTime();
+    }
+    int confirmations = 1 + GetHeight() - blockHeight;
+
+    CMPTransaction mp_obj;
+    record.Restore(mp_obj, txid, blockTime);
+
+    // check if we're filtering from listtransactions_MP, and if so whether we have a non-match we want to skip
+    if (!filterAddress.empty() && mp_obj.getSender() != filterAddress && mp_obj.getReceiver() != filterAddress) return -1;
+
+    // parse packet and populate mp_obj
+    if (!mp_obj.interpret_Transaction()) return MP_TX_IS_NOT_OMNI_PROTOCOL;
+
+    bool valid = (0 <= record.processingResult);
+    std::string invalidReason;
+    if (!valid) invalidReason = error_str(record.processingResult);
+
+    populateRPCTransactionFields(mp_obj, txobj, record.blockHash, blockTime, blockHeight, confirmations, valid, record.position, invalidReason, extendedDetails, extendedDetailsFilter, iWallet);
+
+    if (!extendedDetails) {
+        COmniTxObjectCache::Entry entry;
+        entry.txobj = txobj;
+        entry.blockHash = record.blockHash;
+        entry.sender = mp_obj.getSender();
+        entry.receiver = mp_obj.getReceiver();
+        rpcTxCache.Add(txid, entry);
+    }
+
+    return 0;
+}
+
 /**
  * Function to standardize RPC output for transactions into a JSON object in either basic or extended mode.
  *
@@ -49,9 +185,17 @@ using namespace mastercore;
  * Use extended mode for transaction specific calls (e.g. omni_getsto, omni_gettrade etc.)
  *
  * DEx payments and the extended mode are only available for confirmed transactions.
+ *
+ * Confirmed transactions are rendered from the fields recorded when they were processed,
+ * other transactions are retrieved from the blockchain and parsed.
  */
 int populateRPCTransactionObject(const uint256& txid, UniValue& txobj, std::string filterAddress, bool extendedDetails, std::string extendedDetailsFilter, interfaces::Wallet* iWallet)
 {
+    int recordRC = populateRPCTransactionObjectFromRecord(txid, txobj, filterAddress, extendedDetails, extendedDetailsFilter, iWallet);
+    if (recordRC != MP_TX_NOT_FOUND) {
+        return recordRC;
+    }
+
     bool f_txindex_ready = false;
     if (g_txindex) {
         f_txindex_ready = g_txindex->BlockUntilSyncedToCurrentChain();
@@ -60,8 +204,8 @@ int populateRPCTransactionObject(const uint256& txid, UniValue& txobj, std::stri
     // retrieve the transaction from the blockchain and obtain it's height/confs/time
     CTransactionRef tx;
     uint256 blockHash;
-    if (!GetTransaction(txid, tx, Params().GetConsensus(), blockHash)) {
-        if (!f_txindex_ready) {
+    if (!FetchTransaction(txid, tx, blockHash)) {
+        if (g_txindex && !f_txindex_ready) {
             return MP_TXINDEX_STILL_SYNCING;
         } else {
             return MP_TX_NOT_FOUND;
@@ -71,7 +215,22 @@ int populateRPCTransactionObject(const uint256& txid, UniValue& txobj, std::stri
     return populateRPCTransactionObject(*tx, blockHash, txobj, filterAddress, extendedDetails, extendedDetailsFilter, 0, iWallet);
 }
 
-int populateRPCTransactionObject(const CTransaction& tx, const uint256& blockHash, UniValue& txobj, std::string filterAddress, bool extendedDetails, std::string extendedDetailsFilter, int blockHeight, interfaces::Wallet* iWallet)
+/**
+ * Populates the transaction object of a transaction, which was read from a block.
+ *
+ * The transaction is rendered from its record, and only parsed, if there is none, such as for DEx payments.
+ */
+int populateRPCBlockTransactionObject(const CTransaction& tx, const uint256& blockHash, UniValue& txobj, bool extendedDetails, interfaces::Wallet* iWallet)
+{
+    int recordRC = populateRPCTransactionObjectFromRecord(tx.GetHash(), txobj, "", extendedDetails, "", iWallet);
+    if (recordRC != MP_TX_NOT_FOUND) {
+        return recordRC;
+    }
+
+    return populateRPCTransactionObject(tx, blockHash, txobj, "", extendedDetails, "", 0, iWallet);
+}
+
+int populateRPCTransactionObject(const CTransaction& tx, const uint256& blockHash, UniValue& txobj, std::string filterAddress, bool extendedDetails, std::string extendedDetailsFilter, int blockHeight, interfaces::Wallet* iWallet, const CCoinsViewCache* pInputs)
 {
     int confirmations = 0;
     int64_t blockTime = 0;
@@ -92,7 +251,7 @@ int populateRPCTransactionObject(const CTransaction& tx, const uint256& blockHas
 
     // attempt to parse the transaction
     CMPTransaction mp_obj;
-    int parseRC = ParseTransaction(tx, blockHeight, 0, mp_obj, blockTime);
+    int parseRC = ParseTransaction(tx, blockHeight, 0, mp_obj, blockTime, pInputs);
     if (parseRC == -101) {
         return MP_RPC_DECODE_INPUTS_MISSING;
     }
@@ -102,6 +261,12 @@ int populateRPCTransactionObject(const CTransaction& tx, const uint256& blockHas
 
     const uint256& txid = tx.GetHash();
 
+    // the records of confirmed transactions below the horizon may have been pruned
+    if (confirmations > 0 && blockHeight < GetHistoryPrunedHeight()) {
+        LOCK(cs_tally);
+        if (!pDbTransactionList->exists(txid)) return MP_TX_HISTORY_PRUNED;
+    }
+
     // DEx BTC payment needs special handling since it's not actually an Omni message - handle and return
     if (parseRC > 0) {
         if (confirmations <= 0) {
@@ -135,45 +300,15 @@ int populateRPCTransactionObject(const CTransaction& tx, const uint256& blockHas
 
     // obtain validity - only confirmed transactions can be valid
     bool valid = false;
+    std::string invalidReason;
     if (confirmations > 0) {
         LOCK(cs_tally);
         valid = pDbTransactionList->getValidMPTX(txid);
         positionInBlock = pDbTransaction->FetchTransactionPosition(txid);
+        if (!valid) invalidReason = pDbTransaction->FetchInvalidReason(txid);
     }
 
-    // populate some initial info for the transaction
-    bool fMine = false;
-    if (IsMyAddress(mp_obj.getSender(), iWallet) || IsMyAddress(mp_obj.getReceiver(), iWallet)) fMine = true;
-    txobj.pushKV("txid", txid.GetHex());
-    txobj.pushKV("fee", FormatDivisibleMP(mp_obj.getFeePaid()));
-    txobj.pushKV("sendingaddress", mp_obj.getSender());
-    if (showRefForTx(mp_obj.getType())) txobj.pushKV("referenceaddress", mp_obj.getReceiver());
-    txobj.pushKV("ismine", fMine);
-    txobj.pushKV("version", (uint64_t)mp_obj.getVersion());
-    txobj.pushKV("type_int", (uint64_t)mp_obj.getType());
-    if (mp_obj.getType() != MSC_TYPE_SIMPLE_SEND) { // Type 0 will add "Type" attribute during populateRPCTypeSimpleSend
-        txobj.pushKV("type", mp_obj.getTypeString());
-    }
-
-    // populate type specific info and extended details if requested
-    // extended details are not available for unconfirmed transactions
-    if (confirmations <= 0) extendedDetails = false;
-    populateRPCTypeInfo(mp_obj, txobj, mp_obj.getType(), extendedDetails, extendedDetailsFilter, confirmations, iWallet);
-
-    // state and chain related information
-    if (confirmations != 0 && !blockHash.IsNull()) {
-        txobj.pushKV("valid", valid);
-        if (!valid) {
-            txobj.pushKV("invalidreason", pDbTransaction->FetchInvalidReason(txid));
-        }
-        txobj.pushKV("blockhash", blockHash.GetHex());
-        txobj.pushKV("blocktime", blockTime);
-        txobj.pushKV("positioninblock", positionInBlock);
-    }
-    if (confirmations != 0) {
-        txobj.pushKV("block", blockHeight);
-    }
-    txobj.pushKV("confirmations", confirmations);
+    populateRPCTransactionFields(mp_obj, txobj, blockHash, blockTime, blockHeight, confirmations, valid, positionInBlock, invalidReason, extendedDetails, extendedDetailsFilter, iWallet);
 
     // finished
     return 0;
@@ -641,7 +776,6 @@ void populateRPCExtendedTypeSendToOwners(const uint256 txid, std::string extende
 {
     UniValue receiveArray(UniValue::VARR);
     uint64_t tmpAmount = 0, stoFee = 0, numRecipients = 0;
-    LOCK(cs_tally);
     pDbStoList->getRecipients(txid, extendedDetailsFilter, &receiveArray, &tmpAmount, &numRecipients, iWallet);
     if (version == MP_TX_PKT_V0) {
         stoFee = numRecipients * TRANSFER_FEE_PER_OWNER;
@@ -652,6 +786,25 @@ void populateRPCExtendedTypeSendToOwners(const uint256 txid, std::string extende
     txobj.pushKV("recipients", receiveArray);
 }
 
+/* Adds a page of the recipients of a send to owners transaction, and the cursor of the next page, if there are more
+ */
+void populateRPCExtendedTypeSendToOwners(const uint256 txid, std::string extendedDetailsFilter, const std::string& cursor, size_t limit, UniValue& txobj, uint16_t version, interfaces::Wallet *iWallet)
+{
+    UniValue receiveArray(UniValue::VARR);
+    uint64_t tmpAmount = 0, stoFee = 0;
+    std::string nextCursor;
+    uint64_t numRecipients = pDbStoList->getRecipientCount(txid);
+    bool fMore = pDbStoList->getRecipientsPage(txid, extendedDetailsFilter, cursor, limit, receiveArray, tmpAmount, nextCursor, iWallet);
+    if (version == MP_TX_PKT_V0) {
+        stoFee = numRecipients * TRANSFER_FEE_PER_OWNER;
+    } else {
+        stoFee = numRecipients * TRANSFER_FEE_PER_OWNER_V1;
+    }
+    txobj.pushKV("totalstofee", FormatDivisibleMP(stoFee)); // fee always OMNI so always divisible
+    txobj.pushKV("recipients", receiveArray);
+    if (fMore) txobj.pushKV("cursor", nextCursor);
+}
+
 void populateRPCExtendedTypeGrantNonFungible(CMPTransaction& omniObj, UniValue& txobj)
 {
     LOCK(cs_tally);
@@ -690,17 +843,14 @@ void populateRPCExtendedTypeMetaDExCancel(const uint256& txid, UniValue& txobj)
     if (0<numberOfCancels) {
         for(int refNumber = 1; refNumber <= numberOfCancels; refNumber++) {
             UniValue cancelTx(UniValue::VOBJ);
-            std::string strValue = pDbTransactionList->getKeyValue(txid.ToString() + "-C" + strprintf("%d",refNumber));
-            if (strValue.empty()) continue;
-            std::vector<std::string> vstr;
-            boost::split(vstr, strValue, boost::is_any_of(":"), boost::token_compress_on);
-            if (vstr.size() != 3) {
-                PrintToLog("TXListDB Error - trade cancel number of tokens is not as expected (%s)\n", strValue);
+            uint256 orderTxid;
+            uint32_t propId = 0;
+            int64_t amountUnreserved = 0;
+            if (!pDbTransactionList->getMetaDExCancelDetails(txid, refNumber, orderTxid, propId, amountUnreserved)) {
+                PrintToLog("TXListDB Error - trade cancel %d of %s could not be read\n", refNumber, txid.GetHex());
                 continue;
             }
-            uint32_t propId = boost::lexical_cast<uint32_t>(vstr[1]);
-            int64_t amountUnreserved = boost::lexical_cast<int64_t>(vstr[2]);
-            cancelTx.pushKV("txid", vstr[0]);
+            cancelTx.pushKV("txid", orderTxid.GetHex());
             cancelTx.pushKV("propertyid", (uint64_t) propId);
             cancelTx.pushKV("amountunreserved", FormatMP(propId, amountUnreserved));
             cancelArray.push_back(cancelTx);
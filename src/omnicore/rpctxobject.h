@@ -3,9 +3,12 @@
 
 #include <univalue.h>
 
+#include <stddef.h>
+
 #include <string>
 
 class uint256;
+class CCoinsViewCache;
 class CMPTransaction;
 class CTransaction;
 
@@ -14,7 +17,8 @@ class Wallet;
 } // namespace interfaces
 
 int populateRPCTransactionObject(const uint256& txid, UniValue& txobj, std::string filterAddress = "", bool extendedDetails = false, std::string extendedDetailsFilter = "", interfaces::Wallet* iWallet = nullptr);
-int populateRPCTransactionObject(const CTransaction& tx, const uint256& blockHash, UniValue& txobj, std::string filterAddress = "", bool extendedDetails = false, std::string extendedDetailsFilter = "", int blockHeight = 0, interfaces::Wallet* iWallet = nullptr);
+int populateRPCTransactionObject(const CTransaction& tx, const uint256& blockHash, UniValue& txobj, std::string filterAddress = "", bool extendedDetails = false, std::string extendedDetailsFilter = "", int blockHeight = 0, interfaces::Wallet* iWallet = nullptr, const CCoinsViewCache* pInputs = nullptr);
+int populateRPCBlockTransactionObject(const CTransaction& tx, const uint256& blockHash, UniValue& txobj, bool extendedDetails = false, interfaces::Wallet* iWallet = nullptr);
 
 void populateRPCTypeInfo(CMPTransaction& mp_obj, UniValue& txobj, uint32_t txType, bool extendedDetails, std::string extendedDetailsFilter, int confirmations, interfaces::Wallet* iWallet = nullptr);
 
@@ -46,6 +50,7 @@ void populateRPCTypeRemoveDelegate(CMPTransaction& omniObj, UniValue& txobj);
 void populateRPCTypeAnyData(CMPTransaction& omniObj, UniValue& txobj);
 
 void populateRPCExtendedTypeSendToOwners(const uint256 txid, std::string extendedDetailsFilter, UniValue& txobj, uint16_t version, interfaces::Wallet* iWallet = nullptr);
+void populateRPCExtendedTypeSendToOwners(const uint256 txid, std::string extendedDetailsFilter, const std::string& cursor, size_t limit, UniValue& txobj, uint16_t version, interfaces::Wallet* iWallet = nullptr);
 void populateRPCExtendedTypeGrantNonFungible(CMPTransaction& omniObj, UniValue& txobj);
 void populateRPCExtendedTypeMetaDExTrade(const uint256& txid, uint32_t propertyIdForSale, int64_t amountForSale, UniValue& txobj);
 void populateRPCExtendedTypeMetaDExCancel(const uint256& txid, UniValue& txobj);
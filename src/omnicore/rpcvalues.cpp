@@ -1,5 +1,6 @@
 #include <omnicore/rpcvalues.h>
 
+#include <omnicore/addresscache.h>
 #include <omnicore/createtx.h>
 #include <omnicore/parse_string.h>
 #include <omnicore/walletutils.h>
@@ -28,7 +29,7 @@ std::string ParseAddress(const UniValue& value)
     if (!IsValidDestination(address)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
-    return EncodeDestination(address);
+    return mastercore::EncodeDestinationCached(address);
 }
 
 std::string ParseAddressOrEmpty(const UniValue& value)
@@ -56,6 +57,15 @@ uint32_t ParsePropertyId(const UniValue& value)
     return static_cast<uint32_t>(propertyId);
 }
 
+size_t ParsePageLimit(const UniValue& value)
+{
+    int64_t limit = value.get_int64();
+    if (limit < 1) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit must be positive");
+    }
+    return static_cast<size_t>(limit);
+}
+
 int64_t ParseAmount(const UniValue& value, bool isDivisible)
 {
     int64_t amount = mastercore::StrToInt64(value.get_str(), isDivisible);
@@ -24,66 +24,113 @@
 #include <stdint.h>
 #include <limits>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace mastercore
 {
+/** A transaction restriction, which refers to the activation block of the consensus parameters. */
+struct TransactionRestrictionRule
+{
+    uint16_t txType;
+    uint16_t txVersion;
+    bool allowWildcard;
+    int CConsensusParams::*activationBlock;
+};
+
+/**
+ * The supported transaction types and versions, and the blocks at which they are enabled.
+ *
+ * The activation blocks are referenced, rather than copied, so the rules don't need to be
+ * rebuilt, when features are activated or deactivated.
+ */
+static const TransactionRestrictionRule vTxRestrictionRules[] =
+{ //  transaction type                    version        allow 0  activation block
+  //  ----------------------------------  -------------  -------  ------------------------------
+    { OMNICORE_MESSAGE_TYPE_ALERT,        0xFFFF,        true,    &CConsensusParams::MSC_ALERT_BLOCK },
+    { OMNICORE_MESSAGE_TYPE_ACTIVATION,   0xFFFF,        true,    &CConsensusParams::MSC_ALERT_BLOCK },
+    { OMNICORE_MESSAGE_TYPE_DEACTIVATION, 0xFFFF,        true,    &CConsensusParams::MSC_ALERT_BLOCK },
+
+    { MSC_TYPE_SIMPLE_SEND,               MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_SEND_BLOCK },
+
+    { MSC_TYPE_TRADE_OFFER,               MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_DEX_BLOCK },
+    { MSC_TYPE_TRADE_OFFER,               MP_TX_PKT_V1,  false,   &CConsensusParams::MSC_DEX_BLOCK },
+    { MSC_TYPE_ACCEPT_OFFER_BTC,          MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_DEX_BLOCK },
+
+    { MSC_TYPE_CREATE_PROPERTY_FIXED,     MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_SP_BLOCK },
+    { MSC_TYPE_CREATE_PROPERTY_VARIABLE,  MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_SP_BLOCK },
+    { MSC_TYPE_CREATE_PROPERTY_VARIABLE,  MP_TX_PKT_V1,  false,   &CConsensusParams::MSC_SP_BLOCK },
+    { MSC_TYPE_CLOSE_CROWDSALE,           MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_SP_BLOCK },
+
+    { MSC_TYPE_CREATE_PROPERTY_MANUAL,    MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_MANUALSP_BLOCK },
+    { MSC_TYPE_GRANT_PROPERTY_TOKENS,     MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_MANUALSP_BLOCK },
+    { MSC_TYPE_REVOKE_PROPERTY_TOKENS,    MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_MANUALSP_BLOCK },
+    { MSC_TYPE_CHANGE_ISSUER_ADDRESS,     MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_MANUALSP_BLOCK },
+    { MSC_TYPE_ENABLE_FREEZING,           MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_MANUALSP_BLOCK },
+    { MSC_TYPE_DISABLE_FREEZING,          MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_MANUALSP_BLOCK },
+    { MSC_TYPE_FREEZE_PROPERTY_TOKENS,    MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_MANUALSP_BLOCK },
+    { MSC_TYPE_UNFREEZE_PROPERTY_TOKENS,  MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_MANUALSP_BLOCK },
+
+    { MSC_TYPE_ADD_DELEGATE,              MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_DELEGATED_ISSUANCE_BLOCK },
+    { MSC_TYPE_REMOVE_DELEGATE,           MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_DELEGATED_ISSUANCE_BLOCK },
+
+    { MSC_TYPE_SEND_TO_OWNERS,            MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_STO_BLOCK },
+    { MSC_TYPE_SEND_TO_OWNERS,            MP_TX_PKT_V1,  false,   &CConsensusParams::MSC_STOV1_BLOCK },
+
+    { MSC_TYPE_METADEX_TRADE,             MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_METADEX_BLOCK },
+    { MSC_TYPE_METADEX_CANCEL_PRICE,      MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_METADEX_BLOCK },
+    { MSC_TYPE_METADEX_CANCEL_PAIR,       MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_METADEX_BLOCK },
+    { MSC_TYPE_METADEX_CANCEL_ECOSYSTEM,  MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_METADEX_BLOCK },
+
+    { MSC_TYPE_SEND_ALL,                  MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_SEND_ALL_BLOCK },
+
+    { MSC_TYPE_ANYDATA,                   MP_TX_PKT_V0,  true,    &CConsensusParams::MSC_ANYDATA_BLOCK },
+
+    { MSC_TYPE_OFFER_ACCEPT_A_BET,        MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_BET_BLOCK },
+
+    { MSC_TYPE_SEND_NONFUNGIBLE,          MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_NONFUNGIBLE_BLOCK },
+    { MSC_TYPE_NONFUNGIBLE_DATA,          MP_TX_PKT_V0,  false,   &CConsensusParams::MSC_NONFUNGIBLE_BLOCK },
+};
+
+//! Number of transaction restriction rules
+static const size_t nTxRestrictionRules = sizeof(vTxRestrictionRules) / sizeof(vTxRestrictionRules[0]);
+
+/**
+ * Returns the restriction rule of a transaction type and version, or nullptr, if it's unknown.
+ *
+ * The rules are indexed by type and version once, so the lookup takes constant time.
+ */
+static const TransactionRestrictionRule* GetRestrictionRule(uint16_t txType, uint16_t version)
+{
+    static const std::unordered_map<uint32_t, const TransactionRestrictionRule*> mapRules = [] {
+        std::unordered_map<uint32_t, const TransactionRestrictionRule*> mapIndex;
+        for (const TransactionRestrictionRule& rule : vTxRestrictionRules) {
+            mapIndex.emplace((uint32_t(rule.txType) << 16) | rule.txVersion, &rule);
+        }
+        return mapIndex;
+    }();
+
+    std::unordered_map<uint32_t, const TransactionRestrictionRule*>::const_iterator it = mapRules.find((uint32_t(txType) << 16) | version);
+    if (it == mapRules.end()) {
+        return nullptr;
+    }
+
+    return it->second;
+}
+
 /**
  * Returns a mapping of transaction types, and the blocks at which they are enabled.
  */
 std::vector<TransactionRestriction> CConsensusParams::GetRestrictions() const
 {
-    const TransactionRestriction vTxRestrictions[] =
-    { //  transaction type                    version        allow 0  activation block
-      //  ----------------------------------  -------------  -------  ------------------
-        { OMNICORE_MESSAGE_TYPE_ALERT,        0xFFFF,        true,    MSC_ALERT_BLOCK    },
-        { OMNICORE_MESSAGE_TYPE_ACTIVATION,   0xFFFF,        true,    MSC_ALERT_BLOCK    },
-        { OMNICORE_MESSAGE_TYPE_DEACTIVATION, 0xFFFF,        true,    MSC_ALERT_BLOCK    },
-
-        { MSC_TYPE_SIMPLE_SEND,               MP_TX_PKT_V0,  false,   MSC_SEND_BLOCK     },
-
-        { MSC_TYPE_TRADE_OFFER,               MP_TX_PKT_V0,  false,   MSC_DEX_BLOCK      },
-        { MSC_TYPE_TRADE_OFFER,               MP_TX_PKT_V1,  false,   MSC_DEX_BLOCK      },
-        { MSC_TYPE_ACCEPT_OFFER_BTC,          MP_TX_PKT_V0,  false,   MSC_DEX_BLOCK      },
-
-        { MSC_TYPE_CREATE_PROPERTY_FIXED,     MP_TX_PKT_V0,  false,   MSC_SP_BLOCK       },
-        { MSC_TYPE_CREATE_PROPERTY_VARIABLE,  MP_TX_PKT_V0,  false,   MSC_SP_BLOCK       },
-        { MSC_TYPE_CREATE_PROPERTY_VARIABLE,  MP_TX_PKT_V1,  false,   MSC_SP_BLOCK       },
-        { MSC_TYPE_CLOSE_CROWDSALE,           MP_TX_PKT_V0,  false,   MSC_SP_BLOCK       },
-
-        { MSC_TYPE_CREATE_PROPERTY_MANUAL,    MP_TX_PKT_V0,  false,   MSC_MANUALSP_BLOCK },
-        { MSC_TYPE_GRANT_PROPERTY_TOKENS,     MP_TX_PKT_V0,  false,   MSC_MANUALSP_BLOCK },
-        { MSC_TYPE_REVOKE_PROPERTY_TOKENS,    MP_TX_PKT_V0,  false,   MSC_MANUALSP_BLOCK },
-        { MSC_TYPE_CHANGE_ISSUER_ADDRESS,     MP_TX_PKT_V0,  false,   MSC_MANUALSP_BLOCK },
-        { MSC_TYPE_ENABLE_FREEZING,           MP_TX_PKT_V0,  false,   MSC_MANUALSP_BLOCK },
-        { MSC_TYPE_DISABLE_FREEZING,          MP_TX_PKT_V0,  false,   MSC_MANUALSP_BLOCK },
-        { MSC_TYPE_FREEZE_PROPERTY_TOKENS,    MP_TX_PKT_V0,  false,   MSC_MANUALSP_BLOCK },
-        { MSC_TYPE_UNFREEZE_PROPERTY_TOKENS,  MP_TX_PKT_V0,  false,   MSC_MANUALSP_BLOCK },
-
-        { MSC_TYPE_ADD_DELEGATE,              MP_TX_PKT_V0,  false,   MSC_DELEGATED_ISSUANCE_BLOCK },
-        { MSC_TYPE_REMOVE_DELEGATE,           MP_TX_PKT_V0,  false,   MSC_DELEGATED_ISSUANCE_BLOCK },
-
-        { MSC_TYPE_SEND_TO_OWNERS,            MP_TX_PKT_V0,  false,   MSC_STO_BLOCK      },
-        { MSC_TYPE_SEND_TO_OWNERS,            MP_TX_PKT_V1,  false,   MSC_STOV1_BLOCK    },
-
-        { MSC_TYPE_METADEX_TRADE,             MP_TX_PKT_V0,  false,   MSC_METADEX_BLOCK  },
-        { MSC_TYPE_METADEX_CANCEL_PRICE,      MP_TX_PKT_V0,  false,   MSC_METADEX_BLOCK  },
-        { MSC_TYPE_METADEX_CANCEL_PAIR,       MP_TX_PKT_V0,  false,   MSC_METADEX_BLOCK  },
-        { MSC_TYPE_METADEX_CANCEL_ECOSYSTEM,  MP_TX_PKT_V0,  false,   MSC_METADEX_BLOCK  },
-
-        { MSC_TYPE_SEND_ALL,                  MP_TX_PKT_V0,  false,   MSC_SEND_ALL_BLOCK },
-        
-        { MSC_TYPE_ANYDATA,                   MP_TX_PKT_V0,  true,    MSC_ANYDATA_BLOCK },
-
-        { MSC_TYPE_OFFER_ACCEPT_A_BET,        MP_TX_PKT_V0,  false,   MSC_BET_BLOCK      },
-
-        { MSC_TYPE_SEND_NONFUNGIBLE,          MP_TX_PKT_V0,  false,   MSC_NONFUNGIBLE_BLOCK  },
-        { MSC_TYPE_NONFUNGIBLE_DATA,          MP_TX_PKT_V0,  false,   MSC_NONFUNGIBLE_BLOCK  },
-    };
+    std::vector<TransactionRestriction> vTxRestrictions;
+    vTxRestrictions.reserve(nTxRestrictionRules);
 
-    const size_t nSize = sizeof(vTxRestrictions) / sizeof(vTxRestrictions[0]);
+    for (const TransactionRestrictionRule& rule : vTxRestrictionRules) {
+        vTxRestrictions.push_back({rule.txType, rule.txVersion, rule.allowWildcard, this->*rule.activationBlock});
+    }
 
-    return std::vector<TransactionRestriction>(vTxRestrictions, vTxRestrictions + nSize);
+    return vTxRestrictions;
 }
 
 /**
@@ -715,28 +762,28 @@ bool IsFeatureActivated(uint16_t featureId, int transactionBlock)
  */
 bool IsTransactionTypeAllowed(int txBlock, uint32_t txProperty, uint16_t txType, uint16_t version)
 {
-    const std::vector<TransactionRestriction>& vTxRestrictions = ConsensusParams().GetRestrictions();
-
-    for (std::vector<TransactionRestriction>::const_iterator it = vTxRestrictions.begin(); it != vTxRestrictions.end(); ++it)
-    {
-        const TransactionRestriction& entry = *it;
-        if (entry.txType != txType || entry.txVersion != version) {
-            continue;
-        }
-        // a property identifier of 0 (= BTC) may be used as wildcard
-        if (OMNI_PROPERTY_BTC == txProperty && !entry.allowWildcard) {
-            continue;
-        }
-        // transactions are not restricted in the test ecosystem
-        if (isTestEcosystemProperty(txProperty)) {
-            return true;
-        }
-        if (txBlock >= entry.activationBlock) {
-            return true;
-        }
+    const TransactionRestrictionRule* rule = GetRestrictionRule(txType, version);
+    if (!rule) {
+        return false;
+    }
+    // a property identifier of 0 (= BTC) may be used as wildcard
+    if (OMNI_PROPERTY_BTC == txProperty && !rule->allowWildcard) {
+        return false;
+    }
+    // transactions are not restricted in the test ecosystem
+    if (isTestEcosystemProperty(txProperty)) {
+        return true;
     }
 
-    return false;
+    return (txBlock >= ConsensusParams().*rule->activationBlock);
+}
+
+/**
+ * Checks, if the transaction type and version is supported at all, independent of the property and block.
+ */
+bool IsTransactionTypeKnown(uint16_t txType, uint16_t version)
+{
+    return GetRestrictionRule(txType, version) != nullptr;
 }
 
 /**
@@ -0,0 +1,192 @@
+/**
+ * @file scanprefetch.cpp
+ *
+ * This file contains a reader, which fetches blocks ahead of the initial scan,
+ * so disk I/O and deserialization overlap with the processing of transactions.
+ */
+
+#include <omnicore/scanprefetch.h>
+
+#include <omnicore/blockfile.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <undo.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+#include <assert.h>
+
+namespace mastercore
+{
+/**
+ * Reads the undo data of a block, and collects the outputs spent by the block.
+ *
+ * The undo data holds the spent outputs of all, but the coinbase transaction,
+ * in the order of the inputs.
+ */
+bool ReadSpentCoins(const CBlock& block, const CBlockIndex* pblockindex, std::map<COutPoint, Coin>& spentCoins)
+{
+    CBlockUndo blockUndo;
+    if (!UndoReadFromDisk(blockUndo, pblockindex)) {
+        return false;
+    }
+    if (blockUndo.vtxundo.size() + 1 != block.vtx.size()) {
+        return false;
+    }
+
+    for (size_t i = 1; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        CTxUndo& txUndo = blockUndo.vtxundo[i - 1];
+        if (txUndo.vprevout.size() != tx.vin.size()) {
+            return false;
+        }
+        for (size_t j = 0; j < tx.vin.size(); ++j) {
+            spentCoins.emplace(tx.vin[j].prevout, std::move(txUndo.vprevout[j]));
+        }
+    }
+
+    return true;
+}
+
+CBlockPrefetcher::CBlockPrefetcher(size_t nDepth, bool fSpentCoins)
+  : m_nNextRead(0), m_nNextConsume(0), m_nDepth(nDepth > 0 ? nDepth : 1), m_fSpentCoins(fSpentCoins), m_fStarted(false), m_fStop(false)
+{
+}
+
+CBlockPrefetcher::~CBlockPrefetcher()
+{
+    Stop();
+}
+
+/**
+ * Queues a block for prefetching.
+ *
+ * The caller must hold cs_main, which is required to access the block position.
+ */
+void CBlockPrefetcher::Add(const CBlockIndex* pblockindex)
+{
+    assert(!m_fStarted);
+    LOCK(m_mutex);
+    Entry entry;
+    entry.pblockindex = pblockindex;
+    entry.nHeight = pblockindex->nHeight;
+    entry.pos = pblockindex->GetBlockPos();
+    entry.hash = pblockindex->GetBlockHash();
+    entry.fDone = false;
+    m_entries.push_back(std::move(entry));
+}
+
+/**
+ * Starts the worker threads.
+ */
+void CBlockPrefetcher::Start(int nThreads)
+{
+    assert(!m_fStarted);
+    m_fStarted = true;
+    for (int i = 0; i < nThreads; ++i) {
+        m_threads.emplace_back(&CBlockPrefetcher::ThreadRead, this);
+    }
+}
+
+/**
+ * Stops and joins the worker threads.
+ */
+void CBlockPrefetcher::Stop()
+{
+    {
+        LOCK(m_mutex);
+        m_fStop = true;
+    }
+    m_cvWorker.notify_all();
+    for (std::thread& thread : m_threads) {
+        if (thread.joinable()) thread.join();
+    }
+    m_threads.clear();
+}
+
+/**
+ * Reads queued blocks, while no more than m_nDepth blocks are waiting to be consumed.
+ */
+void CBlockPrefetcher::ThreadRead()
+{
+    util::ThreadRename("omniprefetch");
+
+    WAIT_LOCK(m_mutex, lock);
+    while (true) {
+        while (!m_fStop && m_nNextRead < m_entries.size() && m_nNextRead >= m_nNextConsume + m_nDepth) {
+            m_cvWorker.wait(lock);
+        }
+        if (m_fStop || m_nNextRead >= m_entries.size()) break;
+
+        Entry& entry = m_entries[m_nNextRead++];
+        const CBlockIndex* pblockindex = entry.pblockindex;
+        const FlatFilePos pos = entry.pos;
+        const uint256 hash = entry.hash;
+
+        std::unique_ptr<CBlock> block(new CBlock());
+        std::shared_ptr<std::map<COutPoint, Coin>> spentCoins;
+        bool fSuccess;
+        {
+            REVERSE_LOCK(lock);
+            fSuccess = ReadBlockMapped(*block, pos, Params().GetConsensus()) && block->GetHash() == hash;
+
+            // blocks, which only have a coinbase transaction, don't spend anything
+            if (fSuccess && m_fSpentCoins && block->vtx.size() > 1) {
+                spentCoins = std::make_shared<std::map<COutPoint, Coin>>();
+                if (!ReadSpentCoins(*block, pblockindex, *spentCoins)) {
+                    spentCoins.reset();
+                }
+            }
+        }
+        if (fSuccess) {
+            entry.block = std::move(block);
+            entry.spentCoins = std::move(spentCoins);
+        }
+        entry.fDone = true;
+        m_cvConsumer.notify_all();
+    }
+}
+
+/**
+ * Retrieves the next queued block.
+ *
+ * If the requested block is not the next queued block, or if the block could not
+ * be read, false is returned, and the caller is expected to read the block itself.
+ */
+bool CBlockPrefetcher::Next(const CBlockIndex* pblockindex, CBlock& block, std::shared_ptr<std::map<COutPoint, Coin>>& spentCoins)
+{
+    WAIT_LOCK(m_mutex, lock);
+
+    // skip entries, which were not requested
+    while (m_nNextConsume < m_entries.size() && m_entries[m_nNextConsume].nHeight < pblockindex->nHeight) {
+        m_entries[m_nNextConsume].block.reset();
+        m_entries[m_nNextConsume].spentCoins.reset();
+        ++m_nNextConsume;
+    }
+    m_cvWorker.notify_all();
+
+    if (m_nNextConsume >= m_entries.size()) return false;
+
+    Entry& entry = m_entries[m_nNextConsume];
+    if (entry.nHeight != pblockindex->nHeight) return false;
+    if (entry.hash != pblockindex->GetBlockHash()) return false;
+
+    while (!entry.fDone && !m_fStop) {
+        m_cvConsumer.wait(lock);
+    }
+
+    std::unique_ptr<CBlock> pblock = std::move(entry.block);
+    spentCoins = std::move(entry.spentCoins);
+    ++m_nNextConsume;
+    m_cvWorker.notify_all();
+
+    if (!pblock) return false;
+
+    block = std::move(*pblock);
+    return true;
+}
+}
@@ -0,0 +1,104 @@
+#ifndef BITCOIN_OMNICORE_SCANPREFETCH_H
+#define BITCOIN_OMNICORE_SCANPREFETCH_H
+
+class CBlock;
+class CBlockIndex;
+class COutPoint;
+class Coin;
+
+#include <flatfile.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <thread>
+#include <vector>
+
+namespace mastercore
+{
+/** Default number of blocks, which are read ahead during the initial scan. */
+static const int DEFAULT_SCAN_PREFETCH = 16;
+/** Maximum number of threads used to read blocks ahead during the initial scan. */
+static const int MAX_SCAN_PREFETCH_THREADS = 4;
+
+/**
+ * Reads the undo data of a block, and collects the outputs spent by the block.
+ *
+ * @param block[in]        The block
+ * @param pblockindex[in]  The index entry of the block
+ * @param spentCoins[out]  The spent outputs
+ * @return True, if the undo data was read successfully
+ */
+bool ReadSpentCoins(const CBlock& block, const CBlockIndex* pblockindex, std::map<COutPoint, Coin>& spentCoins);
+
+/**
+ * Reads and deserializes blocks ahead of the initial scan.
+ *
+ * The positions of the blocks are resolved by the caller, so the worker threads
+ * never acquire cs_main. This matters, because the scan may be triggered while
+ * cs_main is held, e.g. during a reorganization.
+ *
+ * Optionally the outputs spent by a block are loaded from the undo data as well.
+ *
+ * At most nDepth blocks are held in memory. Blocks must be retrieved strictly in
+ * the order they were added.
+ */
+class CBlockPrefetcher
+{
+private:
+    struct Entry
+    {
+        const CBlockIndex* pblockindex;
+        int nHeight;
+        FlatFilePos pos;
+        uint256 hash;
+        std::unique_ptr<CBlock> block;
+        std::shared_ptr<std::map<COutPoint, Coin>> spentCoins;
+        bool fDone;
+    };
+
+    Mutex m_mutex;
+    std::condition_variable m_cvWorker;
+    std::condition_variable m_cvConsumer;
+    std::vector<Entry> m_entries GUARDED_BY(m_mutex);
+    //! Index of the next entry to be read by a worker
+    size_t m_nNextRead GUARDED_BY(m_mutex);
+    //! Index of the next entry to be handed out
+    size_t m_nNextConsume GUARDED_BY(m_mutex);
+    const size_t m_nDepth;
+    const bool m_fSpentCoins;
+    bool m_fStarted;
+    bool m_fStop GUARDED_BY(m_mutex);
+    std::vector<std::thread> m_threads;
+
+    void ThreadRead();
+
+public:
+    CBlockPrefetcher(size_t nDepth, bool fSpentCoins);
+    ~CBlockPrefetcher();
+
+    /** Queues a block for prefetching. Must be called before Start(). */
+    void Add(const CBlockIndex* pblockindex);
+
+    /** Starts the worker threads. */
+    void Start(int nThreads);
+
+    /** Stops and joins the worker threads. */
+    void Stop();
+
+    /**
+     * Retrieves the next queued block and waits, if it's still being read.
+     *
+     * @param pblockindex[in]  The expected block, must match the next queued block
+     * @param block[out]       The deserialized block
+     * @param spentCoins[out]  The outputs spent by the block, or nullptr, if not available
+     * @return True, if the block was read successfully
+     */
+    bool Next(const CBlockIndex* pblockindex, CBlock& block, std::shared_ptr<std::map<COutPoint, Coin>>& spentCoins);
+};
+}
+
+#endif // BITCOIN_OMNICORE_SCANPREFETCH_H
@@ -0,0 +1,81 @@
+/**
+ * @file scanstatus.cpp
+ *
+ * This file contains the tracking of the progress and throughput of the
+ * initial scan, which is reported via RPC.
+ */
+
+#include <omnicore/scanstatus.h>
+
+#include <util/time.h>
+
+namespace mastercore
+{
+CScanStatus::CScanStatus() : m_info(), m_nTimeStart(0), m_nChainTxFirst(0), m_nChainTxLast(0)
+{
+    m_info.fScanning = false;
+}
+
+void CScanStatus::Start(int nFirstBlock, int nLastBlock, unsigned int nChainTxFirst, unsigned int nChainTxLast)
+{
+    LOCK(m_mutex);
+    m_info = ScanStatusInfo();
+    m_info.fScanning = true;
+    m_info.nFirstBlock = nFirstBlock;
+    m_info.nLastBlock = nLastBlock;
+    m_info.nCurrentBlock = nFirstBlock - 1;
+    m_nTimeStart = GetTimeMicros();
+    m_nChainTxFirst = nChainTxFirst;
+    m_nChainTxLast = nChainTxLast;
+}
+
+void CScanStatus::BlockProcessed(int nBlock, unsigned int nChainTx, unsigned int nTransactions, unsigned int nOmniTransactions)
+{
+    LOCK(m_mutex);
+    if (!m_info.fScanning) return;
+
+    m_info.nCurrentBlock = nBlock;
+    m_info.nBlocks += 1;
+    m_info.nTransactions += nTransactions;
+    m_info.nOmniTransactions += nOmniTransactions;
+    if (m_nChainTxLast > m_nChainTxFirst) {
+        m_info.dProgress = 100.0 * (nChainTx - m_nChainTxFirst) / (m_nChainTxLast - m_nChainTxFirst);
+    } else {
+        m_info.dProgress = 100.0;
+    }
+}
+
+void CScanStatus::AddTime(int64_t nTimeDecode, int64_t nTimeInterpret, int64_t nTimePersist)
+{
+    LOCK(m_mutex);
+    if (!m_info.fScanning) return;
+
+    m_info.nTimeDecode += nTimeDecode;
+    m_info.nTimeInterpret += nTimeInterpret;
+    m_info.nTimePersist += nTimePersist;
+}
+
+void CScanStatus::Stop()
+{
+    LOCK(m_mutex);
+    if (!m_info.fScanning) return;
+
+    m_info.fScanning = false;
+    m_info.nElapsed = GetTimeMicros() - m_nTimeStart;
+    m_info.nRemaining = 0;
+}
+
+ScanStatusInfo CScanStatus::Get() const
+{
+    LOCK(m_mutex);
+    ScanStatusInfo info = m_info;
+    if (info.fScanning) {
+        info.nElapsed = GetTimeMicros() - m_nTimeStart;
+        info.nRemaining = -1;
+        if (info.dProgress > 0.0) {
+            info.nRemaining = static_cast<int64_t>((100.0 - info.dProgress) / info.dProgress * info.nElapsed);
+        }
+    }
+    return info;
+}
+}
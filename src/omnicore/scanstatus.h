@@ -0,0 +1,71 @@
+#ifndef BITCOIN_OMNICORE_SCANSTATUS_H
+#define BITCOIN_OMNICORE_SCANSTATUS_H
+
+#include <sync.h>
+
+#include <stdint.h>
+
+namespace mastercore
+{
+/** A snapshot of the progress of the initial scan. */
+struct ScanStatusInfo
+{
+    bool fScanning;
+    int nFirstBlock;
+    int nLastBlock;
+    int nCurrentBlock;
+    //! Progress in percent, based on the number of Bitcoin transactions
+    double dProgress;
+    //! Time since the start of the scan in microseconds
+    int64_t nElapsed;
+    //! Estimated time to complete the scan in microseconds
+    int64_t nRemaining;
+    uint64_t nBlocks;
+    uint64_t nTransactions;
+    uint64_t nOmniTransactions;
+    //! Time spent reading and decoding transactions in microseconds
+    int64_t nTimeDecode;
+    //! Time spent interpreting transactions in microseconds
+    int64_t nTimeInterpret;
+    //! Time spent persisting the state in microseconds
+    int64_t nTimePersist;
+};
+
+/**
+ * Collects the progress and throughput of the initial scan.
+ *
+ * The values of the last scan remain available after it finished.
+ */
+class CScanStatus
+{
+private:
+    mutable Mutex m_mutex;
+    ScanStatusInfo m_info GUARDED_BY(m_mutex);
+    int64_t m_nTimeStart GUARDED_BY(m_mutex);
+    unsigned int m_nChainTxFirst GUARDED_BY(m_mutex);
+    unsigned int m_nChainTxLast GUARDED_BY(m_mutex);
+
+public:
+    CScanStatus();
+
+    /** Starts tracking a scan, the chain transaction counts are used to estimate the progress. */
+    void Start(int nFirstBlock, int nLastBlock, unsigned int nChainTxFirst, unsigned int nChainTxLast);
+
+    /** Records a processed block. */
+    void BlockProcessed(int nBlock, unsigned int nChainTx, unsigned int nTransactions, unsigned int nOmniTransactions);
+
+    /** Adds time spent in the different phases, ignored, when there is no scan. */
+    void AddTime(int64_t nTimeDecode, int64_t nTimeInterpret, int64_t nTimePersist);
+
+    /** Marks the scan as finished. */
+    void Stop();
+
+    /** Returns the current status. */
+    ScanStatusInfo Get() const;
+};
+
+//! Progress of the initial scan
+extern CScanStatus scanStatus;
+}
+
+#endif // BITCOIN_OMNICORE_SCANSTATUS_H
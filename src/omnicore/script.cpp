@@ -75,6 +75,45 @@ bool GetScriptPushes(const CScript& script, std::vector<std::string>& vstrRet, b
     return true;
 }
 
+/**
+ * Extracts the pushed data as spans into a script, and appends them to a fixed buffer.
+ *
+ * The data isn't copied, so the spans are only valid as long as the script is.
+ *
+ * @param script[in]      The script
+ * @param pRet[out]       The buffer, which receives the pushed data
+ * @param nMax[in]        The capacity of the buffer
+ * @param nCount[in,out]  The number of pushes found so far, including those, which didn't fit into the buffer
+ * @param fSkipFirst[in]  Whether the first push operation should be skipped (default: false)
+ * @return True if the extraction was successful (result can be empty)
+ */
+bool GetScriptPushes(const CScript& script, Span<const unsigned char>* pRet, size_t nMax, size_t& nCount, bool fSkipFirst)
+{
+    int count = 0;
+    CScript::const_iterator pc = script.begin();
+
+    while (pc < script.end()) {
+        const CScript::const_iterator pcOp = pc;
+        opcodetype opcode;
+        if (!GetScriptOp(pc, script.end(), opcode, nullptr))
+            return false;
+        if (0x00 <= opcode && opcode <= OP_PUSHDATA4 && (count++ || !fSkipFirst)) {
+            // the push opcode and the size of the data precede the data
+            size_t nHeader = 1;
+            if (opcode == OP_PUSHDATA1) nHeader = 2;
+            if (opcode == OP_PUSHDATA2) nHeader = 3;
+            if (opcode == OP_PUSHDATA4) nHeader = 5;
+            if (nCount < nMax) {
+                const size_t nPos = (pcOp - script.begin()) + nHeader;
+                pRet[nCount] = Span<const unsigned char>(script.data() + nPos, (pc - pcOp) - nHeader);
+            }
+            ++nCount;
+        }
+    }
+
+    return true;
+}
+
 /**
  * Returns public keys or hashes from scriptPubKey, for standard transaction types.
  *
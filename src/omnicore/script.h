@@ -7,6 +7,9 @@
 class CScript;
 
 #include <script/standard.h>
+#include <span.h>
+
+#include <stddef.h>
 
 /** Determines the minimum output amount to be spent by an output. */
 int64_t OmniGetDustThreshold(const CScript& scriptPubKey);
@@ -17,6 +20,9 @@ bool GetOutputType(const CScript& scriptPubKey, txnouttype& whichTypeRet);
 /** Extracts the pushed data as hex-encoded string from a script. */
 bool GetScriptPushes(const CScript& script, std::vector<std::string>& vstrRet, bool fSkipFirst = false);
 
+/** Extracts the pushed data as spans into a script, and appends them to a fixed buffer. */
+bool GetScriptPushes(const CScript& script, Span<const unsigned char>* pRet, size_t nMax, size_t& nCount, bool fSkipFirst = false);
+
 /** Returns public keys or hashes from scriptPubKey, for standard transaction types. */
 bool SafeSolver(const CScript& scriptPubKey, txnouttype& typeRet, std::vector<std::vector<unsigned char> >& vSolutionsRet);
 
@@ -1,7 +1,17 @@
 #ifndef BITCOIN_OMNICORE_SEEDBLOCKS_H
 #define BITCOIN_OMNICORE_SEEDBLOCKS_H
 
+#include <vector>
+
 bool SkipBlock(int nBlock);
 
+/**
+ * Appends the seed blocks within the given range from the static list, which covers the mainnet
+ * blocks up to MAX_SEED_BLOCK.
+ *
+ * @return False, if the range isn't covered, otherwise the last covered height is returned
+ */
+bool GetStaticSeedBlocks(int startHeight, int endHeight, std::vector<int>& vBlocksRet, int& nCoveredHeightRet);
+
 
 #endif // BITCOIN_OMNICORE_SEEDBLOCKS_H
@@ -0,0 +1,348 @@
+/**
+ * @file snapshot.cpp
+ *
+ * This file contains immutable snapshots of the state, which are published by
+ * the block processing and used by RPC readers, without holding cs_tally.
+ */
+
+#include <omnicore/snapshot.h>
+
+#include <omnicore/dbspinfo.h>
+#include <omnicore/mdex.h>
+#include <omnicore/memusage.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mastercore
+{
+const size_t CStateSnapshot::SHARD_COUNT;
+
+namespace
+{
+//! Guards the pointer to the most recent snapshot, but not the snapshot itself
+Mutex cs_snapshot;
+//! The most recent snapshot
+std::shared_ptr<const CStateSnapshot> g_snapshot GUARDED_BY(cs_snapshot);
+//! The snapshot, changes are applied to, which equals g_snapshot
+std::shared_ptr<const CStateSnapshot> g_published GUARDED_BY(cs_tally);
+//! Whether snapshots are published
+bool g_fEnabled GUARDED_BY(cs_tally) = false;
+//! Whether a block is in progress, during which changes are not published
+bool g_fHold GUARDED_BY(cs_tally) = false;
+
+/** Adds the properties of an ecosystem in the range [nFirst, nNext). */
+void AddProperties(std::map<uint32_t, CStateSnapshot::PropertyInfo>& properties, uint32_t nFirst, uint32_t nNext) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    for (uint32_t propertyId = nFirst; propertyId < nNext; ++propertyId) {
+        CMPSPInfo::Entry sp;
+        if (!pDbSpInfo->getSP(propertyId, sp)) continue;
+        CStateSnapshot::PropertyInfo& info = properties[propertyId];
+        info.name = sp.name;
+        info.fDivisible = sp.isDivisible();
+    }
+}
+
+/**
+ * Creates a snapshot of the current state based on the previous snapshot.
+ *
+ * Only the changes since the previous snapshot are copied over, unless the
+ * tally map was cleared or the orders were replaced, in which case the whole
+ * balances or orders are copied.
+ */
+std::shared_ptr<CStateSnapshot> CreateSnapshot(const std::shared_ptr<const CStateSnapshot>& pPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    std::vector<uint32_t> vModified;
+    bool fComplete = mp_tally_map.TakeModified(vModified, CMPTallyMap::MODIFIED_SNAPSHOT) && pPrev;
+
+    std::shared_ptr<CStateSnapshot> pNext = std::make_shared<CStateSnapshot>();
+
+    // balances
+    if (fComplete) {
+        pNext->vShards = pPrev->vShards;
+
+        std::map<size_t, std::vector<uint32_t> > mapShardChanges;
+        for (uint32_t id : vModified) {
+            mapShardChanges[CStateSnapshot::GetShard(mp_tally_map.GetAddress(id))].push_back(id);
+        }
+        for (const auto& change : mapShardChanges) {
+            std::shared_ptr<CStateSnapshot::BalanceShard> pShard = std::make_shared<CStateSnapshot::BalanceShard>(*pNext->vShards[change.first]);
+            for (uint32_t id : change.second) {
+                (*pShard)[mp_tally_map.GetAddress(id)] = *mp_tally_map.Get(id);
+            }
+            pNext->vShards[change.first] = std::move(pShard);
+        }
+    } else {
+        std::vector<std::shared_ptr<CStateSnapshot::BalanceShard> > vShards;
+        for (size_t n = 0; n < CStateSnapshot::SHARD_COUNT; ++n) {
+            vShards.push_back(std::make_shared<CStateSnapshot::BalanceShard>());
+        }
+        for (const auto& entry : mp_tally_map) {
+            (*vShards[CStateSnapshot::GetShard(entry.first)])[entry.first] = entry.second;
+        }
+        pNext->vShards.assign(vShards.begin(), vShards.end());
+    }
+
+    // frozen addresses
+    const std::set<std::pair<std::string, uint32_t> >& setFrozen = GetFrozenAddresses();
+    if (pPrev && *pPrev->pFrozen == setFrozen) {
+        pNext->pFrozen = pPrev->pFrozen;
+    } else {
+        pNext->pFrozen = std::make_shared<std::set<std::pair<std::string, uint32_t> > >(setFrozen);
+    }
+
+    // orders, of which only the modified pairs are copied
+    std::set<md_PropertyPair> setModifiedPairs;
+    bool fCompleteOrders = MetaDEx_TakeModifiedPairs(setModifiedPairs, MD_MODIFIED_SNAPSHOT) && pPrev;
+    if (fCompleteOrders && setModifiedPairs.empty()) {
+        pNext->pOrderBook = pPrev->pOrderBook;
+    } else if (fCompleteOrders) {
+        std::shared_ptr<CStateSnapshot::OrderBook> pOrderBook = std::make_shared<CStateSnapshot::OrderBook>(*pPrev->pOrderBook);
+        for (const md_PropertyPair& pair : setModifiedPairs) {
+            const md_PricesMap* pPrices = get_Prices(pair.first, pair.second);
+            if (pPrices) {
+                (*pOrderBook)[pair] = std::make_shared<const md_PricesMap>(*pPrices);
+            } else {
+                pOrderBook->erase(pair);
+            }
+        }
+        pNext->pOrderBook = std::move(pOrderBook);
+    } else {
+        std::shared_ptr<CStateSnapshot::OrderBook> pOrderBook = std::make_shared<CStateSnapshot::OrderBook>();
+        for (const auto& entry : metadex) {
+            pOrderBook->emplace(entry.first, std::make_shared<const md_PricesMap>(entry.second));
+        }
+        pNext->pOrderBook = std::move(pOrderBook);
+    }
+
+    // properties are never modified, once they were created, so only new ones are added
+    pNext->nNextMainId = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_MSC);
+    pNext->nNextTestId = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_TMSC);
+    if (fComplete && pNext->nNextMainId == pPrev->nNextMainId && pNext->nNextTestId == pPrev->nNextTestId) {
+        pNext->pProperties = pPrev->pProperties;
+    } else if (fComplete && pNext->nNextMainId >= pPrev->nNextMainId && pNext->nNextTestId >= pPrev->nNextTestId) {
+        std::shared_ptr<std::map<uint32_t, CStateSnapshot::PropertyInfo> > pProperties = std::make_shared<std::map<uint32_t, CStateSnapshot::PropertyInfo> >(*pPrev->pProperties);
+        AddProperties(*pProperties, pPrev->nNextMainId, pNext->nNextMainId);
+        AddProperties(*pProperties, pPrev->nNextTestId, pNext->nNextTestId);
+        pNext->pProperties = std::move(pProperties);
+    } else {
+        std::shared_ptr<std::map<uint32_t, CStateSnapshot::PropertyInfo> > pProperties = std::make_shared<std::map<uint32_t, CStateSnapshot::PropertyInfo> >();
+        AddProperties(*pProperties, OMNI_PROPERTY_MSC, pNext->nNextMainId);
+        AddProperties(*pProperties, TEST_ECO_PROPERTY_1, pNext->nNextTestId);
+        pNext->pProperties = std::move(pProperties);
+    }
+
+    return pNext;
+}
+
+/** Makes a snapshot available to readers. */
+void SetSnapshot(std::shared_ptr<const CStateSnapshot> pSnapshot) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    g_published = pSnapshot;
+    LOCK(cs_snapshot);
+    // the previous snapshot is released by its last reader
+    g_snapshot.swap(pSnapshot);
+}
+} // anonymous namespace
+
+CStateSnapshot::CStateSnapshot() : nBlock(0), nNextMainId(0), nNextTestId(0)
+{
+}
+
+/**
+ * Returns the shard of an address.
+ */
+size_t CStateSnapshot::GetShard(const std::string& address)
+{
+    return std::hash<std::string>()(address) % SHARD_COUNT;
+}
+
+/**
+ * Returns the tally of an address, or nullptr, if the address is unknown.
+ */
+const CMPTally* CStateSnapshot::GetTally(const std::string& address) const
+{
+    const BalanceShard& shard = *vShards[GetShard(address)];
+    BalanceShard::const_iterator it = shard.find(address);
+    if (it != shard.end()) {
+        return &it->second;
+    }
+    return nullptr;
+}
+
+/**
+ * Returns the number of tokens for the given tally type.
+ */
+int64_t CStateSnapshot::GetTokenBalance(const std::string& address, uint32_t propertyId, TallyType ttype) const
+{
+    const CMPTally* pTally = GetTally(address);
+    return pTally ? pTally->getMoney(propertyId, ttype) : 0;
+}
+
+/**
+ * Returns the number of available tokens, reduced by outgoing pending amounts.
+ *
+ * @see GetAvailableTokenBalance()
+ */
+int64_t CStateSnapshot::GetAvailableTokenBalance(const std::string& address, uint32_t propertyId) const
+{
+    const CMPTally* pTally = GetTally(address);
+    return pTally ? pTally->getMoneyAvailable(propertyId) : 0;
+}
+
+/**
+ * Returns the number of reserved tokens.
+ *
+ * @see GetReservedTokenBalance()
+ */
+int64_t CStateSnapshot::GetReservedTokenBalance(const std::string& address, uint32_t propertyId) const
+{
+    const CMPTally* pTally = GetTally(address);
+    return pTally ? pTally->getMoneyReserved(propertyId) : 0;
+}
+
+/**
+ * Returns the number of frozen tokens.
+ *
+ * @see GetFrozenTokenBalance()
+ */
+int64_t CStateSnapshot::GetFrozenTokenBalance(const std::string& address, uint32_t propertyId) const
+{
+    if (pFrozen->count(std::make_pair(address, propertyId))) {
+        return GetTokenBalance(address, propertyId, BALANCE);
+    }
+    return 0;
+}
+
+/**
+ * Returns the name and divisibility of a property, or nullptr, if the property doesn't exist.
+ */
+const CStateSnapshot::PropertyInfo* CStateSnapshot::GetProperty(uint32_t propertyId) const
+{
+    std::map<uint32_t, PropertyInfo>::const_iterator it = pProperties->find(propertyId);
+    if (it != pProperties->end()) {
+        return &it->second;
+    }
+    return nullptr;
+}
+
+/**
+ * Returns the open orders of a property pair, or nullptr, if there are none.
+ */
+const md_PricesMap* CStateSnapshot::GetOrders(uint32_t propertyForSale, uint32_t propertyDesired) const
+{
+    OrderBook::const_iterator it = pOrderBook->find(md_PropertyPair(propertyForSale, propertyDesired));
+    if (it != pOrderBook->end()) {
+        return it->second.get();
+    }
+    return nullptr;
+}
+
+/**
+ * Returns the approximate heap memory used by the snapshot, including shared parts.
+ */
+size_t CStateSnapshot::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(vShards);
+    for (const std::shared_ptr<const BalanceShard>& pShard : vShards) {
+        nUsage += memusage::DynamicUsage(pShard) + memusage::DynamicUsage(*pShard);
+        for (const auto& entry : *pShard) {
+            nUsage += StringUsage(entry.first) + entry.second.DynamicMemoryUsage();
+        }
+    }
+    nUsage += memusage::DynamicUsage(pFrozen) + memusage::DynamicUsage(*pFrozen);
+    for (const auto& entry : *pFrozen) {
+        nUsage += StringUsage(entry.first);
+    }
+    nUsage += memusage::DynamicUsage(pProperties) + memusage::DynamicUsage(*pProperties);
+    for (const auto& entry : *pProperties) {
+        nUsage += StringUsage(entry.second.name);
+    }
+    nUsage += memusage::DynamicUsage(pOrderBook) + memusage::DynamicUsage(*pOrderBook);
+    for (const auto& entry : *pOrderBook) {
+        nUsage += memusage::DynamicUsage(entry.second) + memusage::DynamicUsage(*entry.second);
+        for (const auto& orders : *entry.second) {
+            nUsage += memusage::DynamicUsage(orders.second);
+        }
+    }
+    return nUsage;
+}
+
+/**
+ * Enables or disables publishing snapshots, and discards the current snapshot.
+ */
+void InitStateSnapshot(bool fEnabled)
+{
+    LOCK(cs_tally);
+    g_fEnabled = fEnabled;
+    g_fHold = false;
+    SetSnapshot(nullptr);
+}
+
+/**
+ * Returns the most recent snapshot, or nullptr, if none was published.
+ */
+std::shared_ptr<const CStateSnapshot> GetStateSnapshot()
+{
+    LOCK(cs_snapshot);
+    return g_snapshot;
+}
+
+/**
+ * Prevents publishing changes, until the state after the block in progress is published.
+ */
+void HoldStateSnapshot()
+{
+    g_fHold = true;
+}
+
+/**
+ * Returns whether a block is in progress, so the state differs from the published snapshot.
+ */
+bool IsBlockInProgress()
+{
+    return g_fHold;
+}
+
+/**
+ * Publishes the state after a block.
+ */
+void PublishStateSnapshot(int nBlock, const uint256& hashBlock)
+{
+    g_fHold = false;
+    if (!g_fEnabled) return;
+
+    std::shared_ptr<CStateSnapshot> pNext = CreateSnapshot(g_published);
+    pNext->nBlock = nBlock;
+    pNext->hashBlock = hashBlock;
+    SetSnapshot(std::move(pNext));
+}
+
+/**
+ * Publishes changes, which occur outside of block processing, such as pending amounts.
+ *
+ * Nothing is published, while a block is in progress, or before the state after
+ * a block was published.
+ */
+void RefreshStateSnapshot()
+{
+    if (!g_fEnabled || g_fHold || !g_published) return;
+
+    std::shared_ptr<CStateSnapshot> pNext = CreateSnapshot(g_published);
+    pNext->nBlock = g_published->nBlock;
+    pNext->hashBlock = g_published->hashBlock;
+    SetSnapshot(std::move(pNext));
+}
+} // namespace mastercore
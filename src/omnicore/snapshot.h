@@ -0,0 +1,121 @@
+#ifndef BITCOIN_OMNICORE_SNAPSHOT_H
+#define BITCOIN_OMNICORE_SNAPSHOT_H
+
+#include <omnicore/mdex.h>
+#include <omnicore/tally.h>
+#include <omnicore/timedmutex.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+extern CTimedRecursiveMutex cs_tally;
+
+namespace mastercore
+{
+//! Default setting, whether read snapshots of the state are published for RPC
+static const bool DEFAULT_RPC_SNAPSHOT = true;
+
+/**
+ * An immutable view of the balances, frozen addresses, properties and MetaDEx orders.
+ *
+ * A snapshot is published after every block, and whenever pending amounts change
+ * outside of block processing. Readers retain the snapshot as long as they need it,
+ * without holding cs_tally.
+ *
+ * The balances are split into shards by address. When a snapshot is published,
+ * only the shards with modified addresses are copied, while all other shards are
+ * shared with the previous snapshot. Likewise, only the orders of modified property
+ * pairs are copied.
+ */
+class CStateSnapshot
+{
+public:
+    //! Number of shards the balances are split into
+    static const size_t SHARD_COUNT = 1024;
+
+    typedef std::unordered_map<std::string, CMPTally> BalanceShard;
+
+    typedef std::map<md_PropertyPair, std::shared_ptr<const md_PricesMap> > OrderBook;
+
+    struct PropertyInfo
+    {
+        std::string name;
+        bool fDivisible;
+    };
+
+    //! Height of the last block included
+    int nBlock;
+    //! Hash of the last block included
+    uint256 hashBlock;
+    //! Balances, by shard
+    std::vector<std::shared_ptr<const BalanceShard> > vShards;
+    //! Frozen (address, property) pairs
+    std::shared_ptr<const std::set<std::pair<std::string, uint32_t> > > pFrozen;
+    //! Names and divisibility of the properties
+    std::shared_ptr<const std::map<uint32_t, PropertyInfo> > pProperties;
+    //! Open MetaDEx orders, by property pair
+    std::shared_ptr<const OrderBook> pOrderBook;
+    //! Next property identifiers of the main and test ecosystem
+    uint32_t nNextMainId;
+    uint32_t nNextTestId;
+
+    CStateSnapshot();
+
+    /** Returns the shard of an address. */
+    static size_t GetShard(const std::string& address);
+
+    /** Returns the tally of an address, or nullptr, if the address is unknown. */
+    const CMPTally* GetTally(const std::string& address) const;
+
+    /** Returns the number of tokens for the given tally type. */
+    int64_t GetTokenBalance(const std::string& address, uint32_t propertyId, TallyType ttype) const;
+
+    /** Returns the number of available tokens, reduced by outgoing pending amounts. */
+    int64_t GetAvailableTokenBalance(const std::string& address, uint32_t propertyId) const;
+
+    /** Returns the number of reserved tokens. */
+    int64_t GetReservedTokenBalance(const std::string& address, uint32_t propertyId) const;
+
+    /** Returns the number of frozen tokens. */
+    int64_t GetFrozenTokenBalance(const std::string& address, uint32_t propertyId) const;
+
+    /** Returns the name and divisibility of a property, or nullptr, if the property doesn't exist. */
+    const PropertyInfo* GetProperty(uint32_t propertyId) const;
+
+    /** Returns the open orders of a property pair, or nullptr, if there are none. */
+    const md_PricesMap* GetOrders(uint32_t propertyForSale, uint32_t propertyDesired) const;
+
+    /** Returns the approximate heap memory used by the snapshot, including shared parts. */
+    size_t DynamicMemoryUsage() const;
+};
+
+/** Enables or disables publishing snapshots, and discards the current snapshot. */
+void InitStateSnapshot(bool fEnabled);
+
+/** Returns the most recent snapshot, or nullptr, if none was published. */
+std::shared_ptr<const CStateSnapshot> GetStateSnapshot();
+
+/** Prevents publishing changes, until the state after the block in progress is published. */
+void HoldStateSnapshot() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Returns whether a block is in progress, so the state differs from the published snapshot. */
+bool IsBlockInProgress() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Publishes the state after a block. */
+void PublishStateSnapshot(int nBlock, const uint256& hashBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Publishes changes, which occur outside of block processing, such as pending amounts. */
+void RefreshStateSnapshot() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+}
+
+#endif // BITCOIN_OMNICORE_SNAPSHOT_H
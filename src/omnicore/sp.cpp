@@ -2,12 +2,16 @@
 
 #include <omnicore/sp.h>
 
+#include <omnicore/consensushash.h>
 #include <omnicore/log.h>
+#include <omnicore/memusage.h>
 #include <omnicore/omnicore.h>
+#include <omnicore/statefile.h>
 #include <omnicore/uint256_extensions.h>
 
 #include <arith_uint256.h>
 #include <hash.h>
+#include <memusage.h>
 #include <validation.h>
 #include <tinyformat.h>
 #include <uint256.h>
@@ -19,7 +23,9 @@
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 #include <utility>
@@ -43,6 +49,54 @@ void CMPCrowd::insertDatabase(const uint256& txHash, const std::vector<int64_t>&
     txFundraiserData.insert(std::make_pair(txHash, txData));
 }
 
+size_t CMPCrowd::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(txFundraiserData);
+    for (const auto& entry : txFundraiserData) {
+        nUsage += memusage::DynamicUsage(entry.second);
+    }
+    return nUsage;
+}
+
+std::pair<CMPCrowdMap::iterator, bool> CMPCrowdMap::insert(const value_type& value)
+{
+    std::pair<iterator, bool> result = m_crowds.insert(value);
+    if (result.second) m_deadlines.insert(std::make_pair(value.second.getDeadline(), value.first));
+    return result;
+}
+
+void CMPCrowdMap::erase(iterator it)
+{
+    m_deadlines.erase(std::make_pair(it->second.getDeadline(), it->first));
+    m_crowds.erase(it);
+}
+
+void CMPCrowdMap::clear()
+{
+    m_crowds.clear();
+    m_deadlines.clear();
+}
+
+std::vector<std::string> CMPCrowdMap::GetExpired(int64_t blockTime) const
+{
+    std::vector<std::string> vAddresses;
+    for (auto it = m_deadlines.begin(); it != m_deadlines.end() && it->first < blockTime; ++it) {
+        vAddresses.push_back(it->second);
+    }
+    std::sort(vAddresses.begin(), vAddresses.end());
+    return vAddresses;
+}
+
+size_t CMPCrowdMap::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(m_crowds) + memusage::DynamicUsage(m_deadlines);
+    // the addresses are held by the map and the index
+    for (const auto& entry : m_crowds) {
+        nUsage += 2 * StringUsage(entry.first);
+    }
+    return nUsage;
+}
+
 std::string CMPCrowd::toString(const std::string& address) const
 {
     return strprintf("%34s : id=%u=%X; prop=%u, value= %li, deadline: %d)", address, propertyId, propertyId,
@@ -54,42 +108,12 @@ void CMPCrowd::print(const std::string& address, FILE* fp) const
     fprintf(fp, "%s\n", toString(address).c_str());
 }
 
-void CMPCrowd::saveCrowdSale(std::ofstream& file, const std::string& addr, CHash256& hasher) const
+void CMPCrowd::saveCrowdSale(CStateFileWriter& writer, const std::string& addr) const
 {
-    // compose the outputline
-    // addr,propertyId,nValue,property_desired,deadline,early_bird,percentage,created,mined
-    std::string lineOut = strprintf("%s,%d,%d,%d,%d,%d,%d,%d,%d",
-            addr,
-            propertyId,
-            nValue,
-            property_desired,
-            deadline,
-            early_bird,
-            percentage,
-            u_created,
-            i_created);
-
-    // append N pairs of address=nValue;blockTime for the database
-    std::map<uint256, std::vector<int64_t> >::const_iterator iter;
-    for (iter = txFundraiserData.begin(); iter != txFundraiserData.end(); ++iter) {
-        lineOut.append(strprintf(",%s=", (*iter).first.GetHex()));
-        std::vector<int64_t> const &vals = (*iter).second;
-
-        std::vector<int64_t>::const_iterator valIter;
-        for (valIter = vals.begin(); valIter != vals.end(); ++valIter) {
-            if (valIter != vals.begin()) {
-                lineOut.append(";");
-            }
-
-            lineOut.append(strprintf("%d", *valIter));
-        }
-    }
-
-    // add the line to the hash
-    hasher.Write((unsigned char*)lineOut.c_str(), lineOut.length());
-
-    // write the line
-    file << lineOut << std::endl;
+    // addr,propertyId,nValue,property_desired,deadline,early_bird,percentage,created,mined,
+    // followed by the txid => nValue;blockTime pairs for the database
+    writer.WriteRecord(addr, VARINT(propertyId), VARAMOUNT(nValue), VARINT(property_desired), VARAMOUNT(deadline),
+            early_bird, percentage, VARAMOUNT(u_created), VARAMOUNT(i_created), txFundraiserData);
 }
 
 CMPCrowd* mastercore::getCrowd(const std::string& address)
@@ -122,18 +146,18 @@ bool mastercore::IsPropertyIdValid(uint32_t propertyId)
 
 bool mastercore::isPropertyNonFungible(uint32_t propertyId)
 {
-    CMPSPInfo::Entry sp;
+    CMPSPInfo::Summary sp;
 
-    if (pDbSpInfo->getSP(propertyId, sp)) return sp.unique;
+    if (pDbSpInfo->getSummary(propertyId, sp)) return sp.unique;
 
     return false;
 }
 
 bool mastercore::HasDelegate(uint32_t propertyId)
 {
-    CMPSPInfo::Entry sp;
+    CMPSPInfo::Summary sp;
 
-    if (pDbSpInfo->getSP(propertyId, sp)) {
+    if (pDbSpInfo->getSummary(propertyId, sp)) {
         return !sp.delegate.empty();
     }
 
@@ -142,9 +166,9 @@ bool mastercore::HasDelegate(uint32_t propertyId)
 
 std::string mastercore::GetDelegate(uint32_t propertyId)
 {
-    CMPSPInfo::Entry sp;
+    CMPSPInfo::Summary sp;
 
-    if (pDbSpInfo->getSP(propertyId, sp)) {
+    if (pDbSpInfo->getSummary(propertyId, sp)) {
         return sp.delegate;
     }
 
@@ -154,17 +178,17 @@ std::string mastercore::GetDelegate(uint32_t propertyId)
 bool mastercore::isPropertyDivisible(uint32_t propertyId)
 {
     // TODO: is a lock here needed
-    CMPSPInfo::Entry sp;
+    CMPSPInfo::Summary sp;
 
-    if (pDbSpInfo->getSP(propertyId, sp)) return sp.isDivisible();
+    if (pDbSpInfo->getSummary(propertyId, sp)) return sp.isDivisible();
 
     return true;
 }
 
 std::string mastercore::getPropertyName(uint32_t propertyId)
 {
-    CMPSPInfo::Entry sp;
-    if (pDbSpInfo->getSP(propertyId, sp)) return sp.name;
+    CMPSPInfo::Summary sp;
+    if (pDbSpInfo->getSummary(propertyId, sp)) return sp.name;
     return "Property Name Not Found";
 }
 
@@ -343,15 +367,12 @@ bool mastercore::isCrowdsalePurchase(const uint256& txid, const std::string& add
     for (uint8_t ecosystem = 1; ecosystem <= 2; ecosystem++) {
         uint32_t startPropertyId = (ecosystem == 1) ? 1 : TEST_ECO_PROPERTY_1;
         for (uint32_t loopPropertyId = startPropertyId; loopPropertyId < pDbSpInfo->peekNextSPID(ecosystem); loopPropertyId++) {
-            CMPSPInfo::Entry sp;
-            if (!pDbSpInfo->getSP(loopPropertyId, sp)) continue;
-            for (std::map<uint256, std::vector<int64_t> >::const_iterator it = sp.historicalData.begin(); it != sp.historicalData.end(); it++) {
-                if (it->first == txid) {
-                    *propertyId = loopPropertyId;
-                    *userTokens = it->second.at(2);
-                    *issuerTokens = it->second.at(3);
-                    return true;
-                }
+            std::vector<int64_t> data;
+            if (pDbSpInfo->getHistoricalEntry(loopPropertyId, txid, data)) {
+                *propertyId = loopPropertyId;
+                *userTokens = data.at(2);
+                *issuerTokens = data.at(3);
+                return true;
             }
         }
     }
@@ -389,6 +410,7 @@ void mastercore::eraseMaxedCrowdsale(const std::string& address, int64_t blockTi
         assert(pDbSpInfo->updateSP(crowdsale.getPropertyId(), sp));
 
         // no calculate fractional calls here, no more tokens (at MAX)
+        CommitCrowdsale(it->first, it->second, false);
         my_crowds.erase(it);
     }
 }
@@ -400,46 +422,43 @@ unsigned int mastercore::eraseExpiredCrowdsale(const CBlockIndex* pBlockIndex)
     const int64_t blockTime = pBlockIndex->GetBlockTime();
     const int blockHeight = pBlockIndex->nHeight;
     unsigned int how_many_erased = 0;
-    CrowdMap::iterator my_it = my_crowds.begin();
 
-    while (my_crowds.end() != my_it) {
-        const std::string& address = my_it->first;
+    for (const std::string& address : my_crowds.GetExpired(blockTime)) {
+        CrowdMap::iterator my_it = my_crowds.find(address);
         const CMPCrowd& crowdsale = my_it->second;
 
-        if (blockTime > crowdsale.getDeadline()) {
-            PrintToLog("%s(): ERASING EXPIRED CROWDSALE from address=%s, at block %d (timestamp: %d), SP: %d (%s)\n",
-                __func__, address, blockHeight, blockTime, crowdsale.getPropertyId(), strMPProperty(crowdsale.getPropertyId()));
-
-            if (msc_debug_sp) {
-                PrintToLog("%s(): %s\n", __func__, FormatISO8601DateTime(blockTime));
-                PrintToLog("%s(): %s\n", __func__, crowdsale.toString(address));
-            }
+        PrintToLog("%s(): ERASING EXPIRED CROWDSALE from address=%s, at block %d (timestamp: %d), SP: %d (%s)\n",
+            __func__, address, blockHeight, blockTime, crowdsale.getPropertyId(), strMPProperty(crowdsale.getPropertyId()));
 
-            // get sp from data struct
-            CMPSPInfo::Entry sp;
-            assert(pDbSpInfo->getSP(crowdsale.getPropertyId(), sp));
+        if (msc_debug_sp) {
+            PrintToLog("%s(): %s\n", __func__, FormatISO8601DateTime(blockTime));
+            PrintToLog("%s(): %s\n", __func__, crowdsale.toString(address));
+        }
 
-            // find missing tokens
-            int64_t missedTokens = GetMissedIssuerBonus(sp, crowdsale);
+        // get sp from data struct
+        CMPSPInfo::Entry sp;
+        assert(pDbSpInfo->getSP(crowdsale.getPropertyId(), sp));
 
-            // get txdata
-            sp.historicalData = crowdsale.getDatabase();
-            sp.missedTokens = missedTokens;
+        // find missing tokens
+        int64_t missedTokens = GetMissedIssuerBonus(sp, crowdsale);
 
-            // update SP with this data
-            sp.update_block = pBlockIndex->GetBlockHash();
-            assert(pDbSpInfo->updateSP(crowdsale.getPropertyId(), sp));
+        // get txdata
+        sp.historicalData = crowdsale.getDatabase();
+        sp.missedTokens = missedTokens;
 
-            // update values
-            if (missedTokens > 0) {
-                assert(update_tally_map(sp.issuer, crowdsale.getPropertyId(), missedTokens, BALANCE));
-            }
+        // update SP with this data
+        sp.update_block = pBlockIndex->GetBlockHash();
+        assert(pDbSpInfo->updateSP(crowdsale.getPropertyId(), sp));
 
-            my_crowds.erase(my_it++);
+        // update values
+        if (missedTokens > 0) {
+            assert(update_tally_map(sp.issuer, crowdsale.getPropertyId(), missedTokens, BALANCE));
+        }
 
-            ++how_many_erased;
+        CommitCrowdsale(my_it->first, my_it->second, false);
+        my_crowds.erase(my_it);
 
-        } else my_it++;
+        ++how_many_erased;
     }
 
     return how_many_erased;
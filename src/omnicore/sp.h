@@ -6,7 +6,7 @@
 #include <omnicore/log.h>
 
 class CBlockIndex;
-class CHash256;
+class CStateFileWriter;
 class uint256;
 
 #include <stdint.h>
@@ -14,6 +14,7 @@ class uint256;
 
 #include <fstream>
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -61,12 +62,64 @@ public:
 
     std::string toString(const std::string& address) const;
     void print(const std::string& address, FILE* fp = stdout) const;
-    void saveCrowdSale(std::ofstream& file, const std::string& addr, CHash256 &hasher) const;
+    void saveCrowdSale(CStateFileWriter& writer, const std::string& addr) const;
+
+    bool operator==(const CMPCrowd& other) const
+    {
+        return propertyId == other.propertyId && nValue == other.nValue && property_desired == other.property_desired &&
+                deadline == other.deadline && early_bird == other.early_bird && percentage == other.percentage &&
+                u_created == other.u_created && i_created == other.i_created && txid == other.txid &&
+                txFundraiserData == other.txFundraiserData;
+    }
+
+    /** Returns the heap memory used by the crowdsale. */
+    size_t DynamicMemoryUsage() const;
 };
 
 namespace mastercore
 {
-typedef std::map<std::string, CMPCrowd> CrowdMap;
+/**
+ * Active crowdsales by issuer, indexed by deadline, so the check for expired crowdsales
+ * at the beginning of a block doesn't visit the crowdsales, which are still open.
+ */
+class CMPCrowdMap
+{
+public:
+    typedef std::map<std::string, CMPCrowd> Map;
+    typedef Map::value_type value_type;
+    typedef Map::iterator iterator;
+    typedef Map::const_iterator const_iterator;
+
+private:
+    Map m_crowds;
+    //! Deadlines and issuers, earliest deadline first
+    std::set<std::pair<int64_t, std::string> > m_deadlines;
+
+public:
+    iterator begin() { return m_crowds.begin(); }
+    iterator end() { return m_crowds.end(); }
+    const_iterator begin() const { return m_crowds.begin(); }
+    const_iterator end() const { return m_crowds.end(); }
+    iterator find(const std::string& address) { return m_crowds.find(address); }
+    const_iterator find(const std::string& address) const { return m_crowds.find(address); }
+    size_t size() const { return m_crowds.size(); }
+    bool empty() const { return m_crowds.empty(); }
+
+    std::pair<iterator, bool> insert(const value_type& value);
+    void erase(iterator it);
+    void clear();
+
+    /** Compares the crowdsales, the index is derived from them. */
+    bool operator==(const CMPCrowdMap& other) const { return m_crowds == other.m_crowds; }
+
+    /** Returns the issuers of the crowdsales, whose deadline is before the block time, ordered by address. */
+    std::vector<std::string> GetExpired(int64_t blockTime) const;
+
+    /** Returns the heap memory used by the map and the index, without the crowdsales. */
+    size_t DynamicMemoryUsage() const;
+};
+
+typedef CMPCrowdMap CrowdMap;
 
 //! LevelDB based storage for currencies, smart properties and tokens
 extern CMPSPInfo* pDbSpInfo;
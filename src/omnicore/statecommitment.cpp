@@ -0,0 +1,58 @@
+/**
+ * @file statecommitment.cpp
+ *
+ * This file contains the homomorphic set hash, which commits to the state
+ * and is maintained incrementally.
+ */
+
+#include <omnicore/statecommitment.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <uint256.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+void CStateCommitment::Update(const unsigned char* data, size_t size, bool fAdd)
+{
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, size).Finalize(key);
+
+    unsigned char expanded[LANES * sizeof(uint16_t)];
+    ChaCha20(key, sizeof(key)).Keystream(expanded, sizeof(expanded));
+
+    for (size_t n = 0; n < LANES; ++n) {
+        const uint16_t lane = ReadLE16(expanded + n * sizeof(uint16_t));
+        m_lanes[n] = fAdd ? m_lanes[n] + lane : m_lanes[n] - lane;
+    }
+}
+
+CStateCommitment& CStateCommitment::operator+=(const CStateCommitment& other)
+{
+    for (size_t n = 0; n < LANES; ++n) {
+        m_lanes[n] += other.m_lanes[n];
+    }
+    return *this;
+}
+
+CStateCommitment& CStateCommitment::operator-=(const CStateCommitment& other)
+{
+    for (size_t n = 0; n < LANES; ++n) {
+        m_lanes[n] -= other.m_lanes[n];
+    }
+    return *this;
+}
+
+uint256 CStateCommitment::GetHash() const
+{
+    unsigned char serialized[LANES * sizeof(uint16_t)];
+    for (size_t n = 0; n < LANES; ++n) {
+        WriteLE16(serialized + n * sizeof(uint16_t), m_lanes[n]);
+    }
+
+    uint256 hash;
+    CSHA256().Write(&STATE_COMMITMENT_VERSION, 1).Write(serialized, sizeof(serialized)).Finalize(hash.begin());
+    return hash;
+}
@@ -0,0 +1,82 @@
+#ifndef BITCOIN_OMNICORE_STATECOMMITMENT_H
+#define BITCOIN_OMNICORE_STATECOMMITMENT_H
+
+#include <serialize.h>
+#include <streams.h>
+#include <uint256.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//! Version of the state commitment, which is independent of the consensus hash
+static const uint8_t STATE_COMMITMENT_VERSION = 1;
+
+//! Kinds of the elements of the state commitment, which are serialized first
+static const uint8_t COMMIT_BALANCE = 1;
+static const uint8_t COMMIT_DEX_OFFER = 2;
+static const uint8_t COMMIT_DEX_ACCEPT = 3;
+static const uint8_t COMMIT_METADEX_ORDER = 4;
+static const uint8_t COMMIT_CROWDSALE = 5;
+
+/**
+ * Homomorphic hash of a set of elements, which is updated incrementally.
+ *
+ * Every element is expanded into 1024 lanes of 16 bit by ChaCha20, keyed with the SHA256
+ * hash of the serialized element, and the lanes are added to the state modulo 2^16, as
+ * in LtHash. The result doesn't depend on the order of the updates, removing an element
+ * undoes adding it, and commitments to disjoint sets can be combined by adding them.
+ *
+ * The hash of the commitment is the SHA256 hash of the version, followed by the lanes
+ * in little endian byte order.
+ */
+class CStateCommitment
+{
+public:
+    //! Number of 16 bit lanes
+    static const size_t LANES = 1024;
+
+private:
+    uint16_t m_lanes[LANES];
+
+    /** Adds or subtracts the expansion of an element. */
+    void Update(const unsigned char* data, size_t size, bool fAdd);
+
+public:
+    CStateCommitment() { SetNull(); }
+
+    /** Resets the commitment to the one of the empty set. */
+    void SetNull() { memset(m_lanes, 0, sizeof(m_lanes)); }
+
+    /** Adds an element, which consists of the serialized arguments. */
+    template <typename... Args>
+    void Add(const Args&... args)
+    {
+        CDataStream ss(SER_GETHASH, 0);
+        SerializeMany(ss, args...);
+        Update(reinterpret_cast<const unsigned char*>(ss.data()), ss.size(), true);
+    }
+
+    /** Removes an element, which consists of the serialized arguments. */
+    template <typename... Args>
+    void Remove(const Args&... args)
+    {
+        CDataStream ss(SER_GETHASH, 0);
+        SerializeMany(ss, args...);
+        Update(reinterpret_cast<const unsigned char*>(ss.data()), ss.size(), false);
+    }
+
+    /** Adds the elements of another commitment. */
+    CStateCommitment& operator+=(const CStateCommitment& other);
+
+    /** Removes the elements of another commitment, which leaves the changes between them. */
+    CStateCommitment& operator-=(const CStateCommitment& other);
+
+    bool operator==(const CStateCommitment& other) const { return memcmp(m_lanes, other.m_lanes, sizeof(m_lanes)) == 0; }
+    bool operator!=(const CStateCommitment& other) const { return !(*this == other); }
+
+    /** Returns the hash of the commitment. */
+    uint256 GetHash() const;
+};
+
+#endif // BITCOIN_OMNICORE_STATECOMMITMENT_H
@@ -0,0 +1,350 @@
+/**
+ * @file statedelta.cpp
+ *
+ * This file contains the publishing and applying of the per-block state deltas,
+ * which let replica nodes follow a primary node without processing transactions.
+ */
+
+#include <omnicore/statedelta.h>
+
+#include <omnicore/consensushash.h>
+#include <omnicore/dbbalancehistory.h>
+#include <omnicore/log.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/persistence.h>
+#include <omnicore/statefile.h>
+#include <omnicore/tally.h>
+
+#include <chain.h>
+#include <fs.h>
+#include <hash.h>
+#include <serialize.h>
+#include <shutdown.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <chrono>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace mastercore;
+
+//! Type of the state delta files
+static const uint8_t FILETYPE_STATE_DELTA = 0x20;
+
+namespace {
+/** A write to a database, as stored in a state delta file. */
+struct DeltaWriteRecord
+{
+    std::string key;
+    bool fDelete;
+    std::string value;
+
+    DeltaWriteRecord() : fDelete(false) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(key);
+        READWRITE(fDelete);
+        READWRITE(value);
+    }
+};
+}
+
+/**
+ * Returns the content of a state delta file.
+ *
+ * Layout: a header with the block, the commitment and the number of parts and
+ * databases, followed by one record per state file, and one per database.
+ */
+std::vector<unsigned char> EncodeStateDelta(const CStateDelta& delta)
+{
+    CStateFileWriter writer(FILETYPE_STATE_DELTA);
+    writer.WriteRecord(VARBLOCK(delta.nBlock), delta.hashBlock, delta.hashPrevBlock, delta.hashCommitment,
+            delta.fProcessBlock, VARINT(static_cast<uint32_t>(delta.vParts.size())), VARINT(static_cast<uint32_t>(delta.vDatabases.size())));
+
+    for (const auto& part : delta.vParts) {
+        writer.WriteRecord(part.first, part.second);
+    }
+
+    std::vector<DeltaWriteRecord> vRecords;
+    for (const auto& database : delta.vDatabases) {
+        vRecords.clear();
+        for (const CDBWrite& write : database.second) {
+            DeltaWriteRecord record;
+            record.key = write.first;
+            record.fDelete = !write.second;
+            if (write.second) record.value = *write.second;
+            vRecords.push_back(std::move(record));
+        }
+        writer.WriteRecord(database.first, vRecords);
+    }
+
+    return writer.GetContent();
+}
+
+/**
+ * Decodes a state delta file, and returns false, if it's malformed.
+ */
+bool DecodeStateDelta(const std::vector<unsigned char>& vch, CStateDelta& delta)
+{
+    CStateFileReader reader(vch);
+    if (!reader.IsValid() || reader.GetType() != FILETYPE_STATE_DELTA) return false;
+
+    uint32_t nParts = 0;
+    uint32_t nDatabases = 0;
+    if (!reader.ReadRecord(VARBLOCK(delta.nBlock), delta.hashBlock, delta.hashPrevBlock, delta.hashCommitment,
+            delta.fProcessBlock, VARINT(nParts), VARINT(nDatabases))) return false;
+
+    delta.vParts.clear();
+    for (uint32_t n = 0; n < nParts; ++n) {
+        uint8_t what;
+        std::vector<unsigned char> vchPart;
+        if (!reader.ReadRecord(what, vchPart) || what >= NUM_FILETYPES) return false;
+        delta.vParts.emplace_back(what, std::move(vchPart));
+    }
+
+    delta.vDatabases.clear();
+    for (uint32_t n = 0; n < nDatabases; ++n) {
+        std::string name;
+        std::vector<DeltaWriteRecord> vRecords;
+        if (!reader.ReadRecord(name, vRecords)) return false;
+
+        std::vector<CDBWrite> vWrites;
+        vWrites.reserve(vRecords.size());
+        for (DeltaWriteRecord& record : vRecords) {
+            std::shared_ptr<const std::string> pValue;
+            if (!record.fDelete) pValue = std::make_shared<const std::string>(std::move(record.value));
+            vWrites.emplace_back(std::move(record.key), std::move(pValue));
+        }
+        delta.vDatabases.emplace_back(std::move(name), std::move(vWrites));
+    }
+
+    return reader.AtEnd();
+}
+
+//! Directory, where the deltas of processed blocks are published, or empty
+static fs::path pathDeltaOut GUARDED_BY(cs_tally);
+//! Directory, from where the deltas of blocks are applied, or empty
+static fs::path pathDeltaIn GUARDED_BY(cs_tally);
+//! Time to wait for the delta of the newest block in milliseconds
+static int64_t nDeltaWaitMillis GUARDED_BY(cs_tally) = DEFAULT_STATE_DELTA_WAIT;
+
+//! Whether the block, which is processed, changed feature activations or alerts
+static bool fDeltaRulesChanged GUARDED_BY(cs_tally) = false;
+//! Hashes of the state files, which were last published, by file type, or null, if none was
+static uint256 hashPublishedParts[NUM_FILETYPES] GUARDED_BY(cs_tally);
+
+//! The delta of the block, which is connected, if it's applied instead of processed
+static std::unique_ptr<CStateDelta> pPendingDelta GUARDED_BY(cs_tally);
+
+/** Returns the name of the delta file of a block. */
+static std::string GetDeltaFileName(int nBlock, const uint256& hashBlock)
+{
+    return strprintf("delta-%08d-%s.dat", nBlock, hashBlock.ToString());
+}
+
+void mastercore::InitStateDeltas(const fs::path& pathOut, const fs::path& pathIn, int64_t nWaitMillis)
+{
+    pathDeltaOut = pathOut;
+    pathDeltaIn = pathIn;
+    nDeltaWaitMillis = nWaitMillis;
+    fDeltaRulesChanged = false;
+    for (uint256& hash : hashPublishedParts) {
+        hash.SetNull();
+    }
+    pPendingDelta.reset();
+
+    if (!pathDeltaOut.empty()) {
+        TryCreateDirectories(pathDeltaOut);
+        PrintToLog("Publishing state deltas to %s\n", pathDeltaOut.string());
+    }
+    if (!pathDeltaIn.empty()) {
+        PrintToLog("Applying state deltas from %s\n", pathDeltaIn.string());
+    }
+}
+
+bool mastercore::IsPublishingStateDeltas()
+{
+    return !pathDeltaOut.empty();
+}
+
+void mastercore::MarkStateDeltaRulesChanged()
+{
+    fDeltaRulesChanged = true;
+}
+
+/**
+ * Publishes the delta of a processed block.
+ *
+ * The balances are carried for the addresses modified since the last delta, all of
+ * them after the tally map was cleared. The other state files are only carried, if
+ * their content changed, except for the globals, which change with nearly every block.
+ * The balance history is left out, because replicas derive it from their balances.
+ */
+bool mastercore::PublishStateDelta(const CBlockIndex* pBlockIndex, const std::vector<CDBBase*>& vDatabases)
+{
+    if (pathDeltaOut.empty()) return true;
+
+    CStateDelta delta;
+    delta.nBlock = pBlockIndex->nHeight;
+    delta.hashBlock = pBlockIndex->GetBlockHash();
+    delta.hashPrevBlock = pBlockIndex->pprev ? pBlockIndex->pprev->GetBlockHash() : uint256();
+    delta.hashCommitment = GetStateCommitment();
+    delta.fProcessBlock = fDeltaRulesChanged;
+    fDeltaRulesChanged = false;
+
+    std::vector<uint32_t> vModified;
+    if (!mp_tally_map.TakeModified(vModified, CMPTallyMap::MODIFIED_STATE_DELTA)) {
+        delta.vParts.emplace_back(FILETYPE_BALANCES, BuildStateFile(FILETYPE_BALANCES));
+    } else if (!vModified.empty()) {
+        delta.vParts.emplace_back(FILETYPE_BALANCES, BuildBalancesDeltaFile(uint256(), vModified));
+    }
+    for (int what = FILETYPE_BALANCES + 1; what < NUM_FILETYPES; ++what) {
+        std::vector<unsigned char> vch = BuildStateFile(what);
+        const uint256 hash = Hash(vch.begin(), vch.end());
+        if (what != FILETYPE_GLOBALS && hash == hashPublishedParts[what]) continue;
+        hashPublishedParts[what] = hash;
+        delta.vParts.emplace_back(what, std::move(vch));
+    }
+
+    for (const CDBBase* pdb : vDatabases) {
+        if (pdb == pDbBalanceHistory) continue;
+        std::vector<CDBWrite> vWrites;
+        pdb->GetBatchWrites(vWrites);
+        if (!vWrites.empty()) delta.vDatabases.emplace_back(pdb->GetName(), std::move(vWrites));
+    }
+
+    // the file appears at once, so replicas never read a partial delta
+    const fs::path path = pathDeltaOut / GetDeltaFileName(delta.nBlock, delta.hashBlock);
+    fs::path pathTemp = path;
+    pathTemp += ".tmp";
+    if (!CStateFileWriter::WriteToFile(pathTemp, EncodeStateDelta(delta)) || !RenameOver(pathTemp, path)) {
+        PrintToLog("%s(): ERROR: failed to write the state delta of block %d\n", __func__, delta.nBlock);
+        return false;
+    }
+
+    // the deltas of older blocks are no longer needed by replicas, which are catching up
+    const CBlockIndex* pPruned = pBlockIndex->GetAncestor(pBlockIndex->nHeight - STATE_DELTA_KEEP_BLOCKS);
+    if (pPruned) {
+        fs::remove(pathDeltaOut / GetDeltaFileName(pPruned->nHeight, pPruned->GetBlockHash()));
+    }
+
+    PrintToLogVerbose(msc_debug_persistence, "%s(): published %d state files and the writes of %d databases of block %d\n",
+            __func__, delta.vParts.size(), delta.vDatabases.size(), delta.nBlock);
+
+    return true;
+}
+
+/**
+ * Loads the delta of a block, which is about to be connected.
+ *
+ * Only the newest block is waited for, because the primary is expected to have
+ * published the deltas of older blocks already.
+ */
+bool mastercore::LoadStateDelta(const CBlockIndex* pBlockIndex)
+{
+    fs::path pathIn;
+    int64_t nWaitMillis;
+    {
+        LOCK(cs_tally);
+        pPendingDelta.reset();
+        if (pathDeltaIn.empty()) return false;
+        pathIn = pathDeltaIn;
+        nWaitMillis = nDeltaWaitMillis;
+    }
+
+    bool fNewest;
+    {
+        LOCK(cs_main);
+        fNewest = pindexBestHeader == nullptr || pindexBestHeader->nHeight <= pBlockIndex->nHeight;
+    }
+
+    const fs::path path = pathIn / GetDeltaFileName(pBlockIndex->nHeight, pBlockIndex->GetBlockHash());
+    const int64_t nWaitUntil = GetTimeMillis() + (fNewest ? nWaitMillis : 0);
+    while (!fs::exists(path) && GetTimeMillis() < nWaitUntil && !ShutdownRequested()) {
+        UninterruptibleSleep(std::chrono::milliseconds{50});
+    }
+
+    CMappedStateFile mapped(path);
+    if (!mapped.IsOpen()) {
+        PrintToLogVerbose(msc_debug_persistence, "%s(): no state delta for block %d, processing it\n", __func__, pBlockIndex->nHeight);
+        return false;
+    }
+
+    std::unique_ptr<CStateDelta> pDelta(new CStateDelta());
+    const std::vector<unsigned char> vch(mapped.data(), mapped.data() + mapped.size());
+    const uint256 hashPrevBlock = pBlockIndex->pprev ? pBlockIndex->pprev->GetBlockHash() : uint256();
+    if (!DecodeStateDelta(vch, *pDelta) || pDelta->nBlock != pBlockIndex->nHeight ||
+            pDelta->hashBlock != pBlockIndex->GetBlockHash() || pDelta->hashPrevBlock != hashPrevBlock) {
+        PrintToLog("%s(): ERROR: invalid state delta for block %d, processing it\n", __func__, pBlockIndex->nHeight);
+        return false;
+    }
+    if (pDelta->fProcessBlock) {
+        PrintToLog("%s(): block %d changes the rules, processing it\n", __func__, pBlockIndex->nHeight);
+        return false;
+    }
+
+    LOCK(cs_tally);
+    pPendingDelta = std::move(pDelta);
+    return true;
+}
+
+bool mastercore::IsApplyingStateDelta()
+{
+    return pPendingDelta != nullptr;
+}
+
+/**
+ * Applies the loaded delta of the block, which is connected.
+ *
+ * The writes are added to the batches of the block, so they are committed and rolled
+ * back like the writes of processed blocks. Writes of databases, which are disabled on
+ * this node, are skipped.
+ */
+bool mastercore::ApplyStateDelta(const std::vector<CDBBase*>& vDatabases)
+{
+    if (!pPendingDelta) return false;
+    std::unique_ptr<CStateDelta> pDelta = std::move(pPendingDelta);
+
+    for (const auto& database : pDelta->vDatabases) {
+        for (CDBBase* pdb : vDatabases) {
+            if (pdb == pDbBalanceHistory || pdb->GetName() != database.first) continue;
+            leveldb::Status status = pdb->ApplyWrites(database.second);
+            if (!status.ok()) {
+                PrintToLog("%s(): ERROR: failed to apply the writes of %s in block %d: %s\n",
+                        __func__, database.first, pDelta->nBlock, status.ToString());
+                return false;
+            }
+        }
+    }
+
+    for (const auto& part : pDelta->vParts) {
+        if (RestoreInMemoryStateFromBuffer(part.second, part.first) < 0) {
+            PrintToLog("%s(): ERROR: failed to apply state file %d of block %d\n", __func__, part.first, pDelta->nBlock);
+            return false;
+        }
+    }
+
+    const uint256 hashCommitment = GetStateCommitment();
+    if (hashCommitment != pDelta->hashCommitment) {
+        PrintToLog("%s(): ERROR: state commitment %s of block %d doesn't match %s of the primary\n",
+                __func__, hashCommitment.GetHex(), pDelta->nBlock, pDelta->hashCommitment.GetHex());
+        return false;
+    }
+
+    PrintToLogVerbose(msc_debug_persistence, "%s(): applied %d state files and the writes of %d databases of block %d\n",
+            __func__, pDelta->vParts.size(), pDelta->vDatabases.size(), pDelta->nBlock);
+
+    return true;
+}
@@ -0,0 +1,106 @@
+#ifndef BITCOIN_OMNICORE_STATEDELTA_H
+#define BITCOIN_OMNICORE_STATEDELTA_H
+
+#include <omnicore/dbbase.h>
+#include <omnicore/timedmutex.h>
+
+#include <fs.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class CBlockIndex;
+
+extern CTimedRecursiveMutex cs_tally;
+
+//! Default number of milliseconds a replica waits for the delta of the newest block
+static const int64_t DEFAULT_STATE_DELTA_WAIT = 5000;
+//! Number of blocks, for which the primary keeps the published deltas
+static const int STATE_DELTA_KEEP_BLOCKS = 1000;
+
+/**
+ * The changes of the Omni state in one block, as published by a primary node.
+ *
+ * The in-memory state is carried as state files: the balances of the addresses,
+ * which changed, and every other file type, whose content changed, as a whole. The
+ * databases are carried as the writes buffered for the block. A replica, which had
+ * the same state before the block, has the same state after applying the delta, and
+ * the commitment to it is checked against the one of the primary.
+ */
+struct CStateDelta
+{
+    int nBlock;
+    uint256 hashBlock;
+    uint256 hashPrevBlock;
+    //! The state commitment of the primary after the block
+    uint256 hashCommitment;
+    //! Whether the block changed feature activations or alerts, so replicas process it themselves
+    bool fProcessBlock;
+    //! The state files, which changed, by file type
+    std::vector<std::pair<uint8_t, std::vector<unsigned char> > > vParts;
+    //! The writes of the block, by database name
+    std::vector<std::pair<std::string, std::vector<CDBWrite> > > vDatabases;
+
+    CStateDelta() : nBlock(-1), fProcessBlock(false) {}
+};
+
+/** Returns the content of a state delta file. */
+std::vector<unsigned char> EncodeStateDelta(const CStateDelta& delta);
+
+/** Decodes a state delta file, and returns false, if it's malformed. */
+bool DecodeStateDelta(const std::vector<unsigned char>& vch, CStateDelta& delta);
+
+namespace mastercore
+{
+/**
+ * Sets up publishing or applying state deltas.
+ *
+ * @param pathOut      The directory, where the deltas of processed blocks are published, or empty
+ * @param pathIn       The directory, from where the deltas of blocks are applied, or empty
+ * @param nWaitMillis  The time to wait for the delta of the newest block
+ */
+void InitStateDeltas(const fs::path& pathOut, const fs::path& pathIn, int64_t nWaitMillis) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Returns whether the deltas of processed blocks are published. */
+bool IsPublishingStateDeltas() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Marks the block, which is processed, as changing feature activations or alerts. */
+void MarkStateDeltaRulesChanged() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Publishes the delta of a processed block, before the writes of the databases are committed.
+ *
+ * @param pBlockIndex  The processed block
+ * @param vDatabases   The databases of the state
+ * @return False, if the file couldn't be written
+ */
+bool PublishStateDelta(const CBlockIndex* pBlockIndex, const std::vector<CDBBase*>& vDatabases) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Loads the delta of a block, which is about to be connected, if one was published for it.
+ *
+ * The delta of the newest block is waited for. If there is none, or if it doesn't
+ * belong to the block, the block is processed as usual.
+ *
+ * @return True, if the delta is applied instead of processing the block
+ */
+bool LoadStateDelta(const CBlockIndex* pBlockIndex) LOCKS_EXCLUDED(cs_tally);
+
+/** Returns whether the block, which is connected, is applied from a delta. */
+bool IsApplyingStateDelta() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Applies the loaded delta of the block, which is connected, and verifies the resulting state.
+ *
+ * @param vDatabases  The databases of the state
+ * @return False, if the delta couldn't be applied, or if the state commitment doesn't match
+ */
+bool ApplyStateDelta(const std::vector<CDBBase*>& vDatabases) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+}
+
+#endif // BITCOIN_OMNICORE_STATEDELTA_H
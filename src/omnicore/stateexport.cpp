@@ -0,0 +1,216 @@
+/**
+ * @file stateexport.cpp
+ *
+ * This file contains the export of the Omni state to a file.
+ */
+
+#include <omnicore/stateexport.h>
+
+#include <omnicore/dex.h>
+#include <omnicore/mdex.h>
+#include <omnicore/nftdb.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/snapshot.h>
+#include <omnicore/tally.h>
+
+#include <fs.h>
+#include <sync.h>
+#include <uint256.h>
+#include <util/time.h>
+
+#include <univalue.h>
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mastercore
+{
+namespace
+{
+//! Maximum time to wait for a block in progress, before the export is aborted
+const int64_t MAX_EXPORT_WAIT_MILLIS = 60 * 1000;
+
+typedef std::vector<std::pair<std::string, UniValue> > ExportFields;
+
+/** Writes the records of an export in one of the formats. */
+class ExportWriter
+{
+private:
+    std::ofstream& m_file;
+    ExportFormat m_format;
+
+    /** Quotes a string value of a CSV record, if needed. */
+    static std::string QuoteCSV(const std::string& value)
+    {
+        if (value.find_first_of(",\"\r\n") == std::string::npos) return value;
+        std::string quoted = "\"";
+        for (char c : value) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+public:
+    ExportWriter(std::ofstream& file, ExportFormat format) : m_file(file), m_format(format) {}
+
+    /** Writes a line, which describes the columns of a record type, in CSV files. */
+    void WriteColumns(const std::string& type, const std::string& columns)
+    {
+        if (m_format == ExportFormat::CSV) m_file << "# " << type << "," << columns << "\n";
+    }
+
+    /** Writes a record of a type. */
+    void Write(const std::string& type, const ExportFields& fields)
+    {
+        if (m_format == ExportFormat::JSON) {
+            UniValue record(UniValue::VOBJ);
+            record.pushKV("type", type);
+            for (const auto& field : fields) {
+                record.pushKV(field.first, field.second);
+            }
+            m_file << record.write() << "\n";
+        } else {
+            m_file << type;
+            for (const auto& field : fields) {
+                m_file << "," << (field.second.isStr() ? QuoteCSV(field.second.get_str()) : field.second.write());
+            }
+            m_file << "\n";
+        }
+    }
+};
+}
+
+/** Parses the name of an export format, returns false, if it is unknown. */
+bool ParseExportFormat(const std::string& name, ExportFormat& format)
+{
+    if (name == "csv") {
+        format = ExportFormat::CSV;
+    } else if (name == "json") {
+        format = ExportFormat::JSON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Streams properties, balances, open MetaDEx orders, DEx offers and non-fungible
+ * token ranges after the last processed block to a file.
+ */
+bool ExportState(const fs::path& path, ExportFormat format, ExportSummary& summary, std::string& strError)
+{
+    std::shared_ptr<const CStateSnapshot> state;
+    std::shared_ptr<const leveldb::Snapshot> ranges;
+    std::vector<CMPMetaDEx> vOrders;
+    std::vector<std::pair<CDExOfferKey, CMPOffer> > vOffers;
+
+    // the snapshots and the copied orders must reflect the same block, so a block in progress is awaited
+    const int64_t nTimeStart = GetTimeMillis();
+    while (true) {
+        {
+            LOCK(cs_tally);
+            if (!IsBlockInProgress()) {
+                state = GetStateSnapshot();
+                if (!state) {
+                    strError = "state snapshots are disabled (-omnirpcsnapshot=0)";
+                    return false;
+                }
+                ranges = pDbNFT->GetPublishedSnapshot();
+                for (const auto& pair : metadex) {
+                    for (const auto& price : pair.second) {
+                        vOrders.insert(vOrders.end(), price.second.begin(), price.second.end());
+                    }
+                }
+                vOffers.assign(my_offers.begin(), my_offers.end());
+                break;
+            }
+        }
+        if (GetTimeMillis() - nTimeStart > MAX_EXPORT_WAIT_MILLIS) {
+            strError = "timed out waiting for the block in progress";
+            return false;
+        }
+        UninterruptibleSleep(std::chrono::milliseconds{10});
+    }
+
+    const fs::path tmpPath = path.string() + ".incomplete";
+    std::ofstream file(tmpPath.string(), std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        strError = "unable to create " + tmpPath.string();
+        return false;
+    }
+
+    summary.nBlock = state->nBlock;
+    summary.hashBlock = state->hashBlock;
+
+    ExportWriter writer(file, format);
+    writer.WriteColumns("block", "height,hash");
+    writer.WriteColumns("property", "propertyid,name,divisible");
+    writer.WriteColumns("balance", "address,propertyid,balance,selloffer_reserve,accept_reserve,metadex_reserve");
+    writer.WriteColumns("order", "txid,address,propertyidforsale,amountforsale,propertyiddesired,amountdesired,amountremaining,block,positioninblock");
+    writer.WriteColumns("offer", "txid,address,propertyid,amountoffered,bitcoindesired,minimumfee,timelimit");
+    writer.WriteColumns("nftrange", "propertyid,tokenstart,tokenend,owner");
+
+    writer.Write("block", {{"height", state->nBlock}, {"hash", state->hashBlock.GetHex()}});
+
+    for (const auto& entry : *state->pProperties) {
+        writer.Write("property", {{"propertyid", (uint64_t) entry.first}, {"name", entry.second.name}, {"divisible", entry.second.fDivisible}});
+        ++summary.nProperties;
+    }
+
+    // amounts are written in their smallest unit, divisibility is part of the property records
+    for (const auto& shard : state->vShards) {
+        if (!shard) continue;
+        for (const auto& entry : *shard) {
+            const CMPTally& tally = entry.second;
+            for (uint32_t propertyId : tally) {
+                int64_t nBalance = tally.getMoney(propertyId, BALANCE);
+                int64_t nSellOffer = tally.getMoney(propertyId, SELLOFFER_RESERVE);
+                int64_t nAccept = tally.getMoney(propertyId, ACCEPT_RESERVE);
+                int64_t nMetaDEx = tally.getMoney(propertyId, METADEX_RESERVE);
+                if (nBalance == 0 && nSellOffer == 0 && nAccept == 0 && nMetaDEx == 0) continue;
+                writer.Write("balance", {{"address", entry.first}, {"propertyid", (uint64_t) propertyId},
+                        {"balance", nBalance}, {"selloffer_reserve", nSellOffer}, {"accept_reserve", nAccept}, {"metadex_reserve", nMetaDEx}});
+                ++summary.nBalances;
+            }
+        }
+    }
+
+    for (const CMPMetaDEx& order : vOrders) {
+        writer.Write("order", {{"txid", order.getHash().GetHex()}, {"address", order.getAddr()},
+                {"propertyidforsale", (uint64_t) order.getProperty()}, {"amountforsale", order.getAmountForSale()},
+                {"propertyiddesired", (uint64_t) order.getDesProperty()}, {"amountdesired", order.getAmountDesired()},
+                {"amountremaining", order.getAmountRemaining()}, {"block", order.getBlock()}, {"positioninblock", (uint64_t) order.getIdx()}});
+        ++summary.nOrders;
+    }
+    std::vector<CMPMetaDEx>().swap(vOrders);
+
+    for (const auto& entry : vOffers) {
+        const CMPOffer& offer = entry.second;
+        writer.Write("offer", {{"txid", offer.getHash().GetHex()}, {"address", entry.first.seller}, {"propertyid", (uint64_t) offer.getProperty()},
+                {"amountoffered", offer.getOfferAmountOriginal()}, {"bitcoindesired", offer.getBTCDesiredOriginal()},
+                {"minimumfee", offer.getMinFee()}, {"timelimit", (int) offer.getBlockTimeLimit()}});
+        ++summary.nOffers;
+    }
+
+    pDbNFT->ForEachRange(ranges, [&](uint32_t propertyId, int64_t start, int64_t end, const std::string& owner) {
+        writer.Write("nftrange", {{"propertyid", (uint64_t) propertyId}, {"tokenstart", start}, {"tokenend", end}, {"owner", owner}});
+        ++summary.nRanges;
+    });
+
+    file.close();
+    if (file.fail()) {
+        strError = "unable to write " + tmpPath.string();
+        fs::remove(tmpPath);
+        return false;
+    }
+    fs::rename(tmpPath, path);
+
+    return true;
+}
+} // namespace mastercore
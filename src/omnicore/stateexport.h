@@ -0,0 +1,54 @@
+#ifndef BITCOIN_OMNICORE_STATEEXPORT_H
+#define BITCOIN_OMNICORE_STATEEXPORT_H
+
+#include <fs.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <string>
+
+namespace mastercore
+{
+/** Formats of the state export. */
+enum class ExportFormat
+{
+    CSV,  //!< One line of comma separated values per record, with the record type first
+    JSON, //!< One JSON object per line
+};
+
+/** Parses the name of an export format, returns false, if it is unknown. */
+bool ParseExportFormat(const std::string& name, ExportFormat& format);
+
+/** Summary of a completed state export. */
+struct ExportSummary
+{
+    int nBlock;
+    uint256 hashBlock;
+    uint64_t nProperties;
+    uint64_t nBalances;
+    uint64_t nOrders;
+    uint64_t nOffers;
+    uint64_t nRanges;
+
+    ExportSummary() : nBlock(0), nProperties(0), nBalances(0), nOrders(0), nOffers(0), nRanges(0) {}
+};
+
+/**
+ * Streams properties, balances, open MetaDEx orders, DEx offers and non-fungible
+ * token ranges after the last processed block to a file.
+ *
+ * The balances, properties and token ranges are read from the published snapshots,
+ * while cs_tally is only held to copy the open orders and offers, so block
+ * processing is not paused. The file is written under a temporary name and moved
+ * into place, once it is complete.
+ *
+ * @param path      The file to create
+ * @param format    The format of the records
+ * @param summary   The block and number of exported records
+ * @param strError  The reason, if the export failed
+ * @return True, if the export was successful
+ */
+bool ExportState(const fs::path& path, ExportFormat format, ExportSummary& summary, std::string& strError);
+}
+
+#endif // BITCOIN_OMNICORE_STATEEXPORT_H
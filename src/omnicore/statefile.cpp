@@ -0,0 +1,462 @@
+/**
+ * @file statefile.cpp
+ *
+ * This file contains the binary format of the files, which persist the
+ * in-memory state, and the memory mapping used to decode them in place.
+ */
+
+#include <omnicore/statefile.h>
+
+#include <clientversion.h>
+#include <crypto/common.h>
+#include <fs.h>
+#include <hash.h>
+#include <streams.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+//! Magic bytes at the start of a state file, which can't start a line of the legacy text format
+static const unsigned char STATE_FILE_MAGIC[] = {0xfe, 'O', 'M', 'N'};
+//! Size of the header: magic, version and file type, which is followed by the number of records since version 2
+static const size_t STATE_FILE_HEADER_SIZE = sizeof(STATE_FILE_MAGIC) + 2;
+//! Magic bytes at the start of a compressed state file
+static const unsigned char COMPRESSED_STATE_FILE_MAGIC[] = {0xfe, 'O', 'M', 'Z'};
+//! Version of the compressed format, which is independent from the version of the content
+static const uint8_t COMPRESSED_STATE_FILE_VERSION = 1;
+//! Size of the header of a compressed state file: magic and version
+static const size_t COMPRESSED_STATE_FILE_HEADER_SIZE = sizeof(COMPRESSED_STATE_FILE_MAGIC) + 1;
+
+//! Minimal length of a repeated sequence, which is compressed
+static const size_t LZ_MIN_MATCH = 4;
+//! Maximal distance of a repeated sequence to its earlier occurrence
+static const size_t LZ_MAX_OFFSET = 65535;
+//! Number of bytes at the end of a frame, which are always copied as they are
+static const size_t LZ_LAST_LITERALS = 5;
+//! Number of bits of the hash of the table of earlier positions
+static const int LZ_HASH_BITS = 14;
+
+/** Appends the header of a state file, including the number of records. */
+static void WriteStateFileHeader(std::vector<unsigned char>& vch, uint8_t nType, uint64_t nRecords)
+{
+    vch.insert(vch.end(), STATE_FILE_MAGIC, STATE_FILE_MAGIC + sizeof(STATE_FILE_MAGIC));
+    vch.push_back(STATE_FILE_VERSION);
+    vch.push_back(nType);
+    CVectorWriter writer(SER_DISK, CLIENT_VERSION, vch, vch.size());
+    WriteCompactSize(writer, nRecords);
+}
+
+CStateFileWriter::CStateFileWriter(uint8_t nType) : m_nType(nType), m_nRecords(0), m_stream(SER_DISK, CLIENT_VERSION)
+{
+}
+
+std::vector<unsigned char> CStateFileWriter::GetContent() const
+{
+    // the header is added last, once the number of records is known
+    std::vector<unsigned char> vch;
+    vch.reserve(STATE_FILE_HEADER_SIZE + 9 + m_stream.size() + CHash256::OUTPUT_SIZE);
+    WriteStateFileHeader(vch, m_nType, m_nRecords);
+    vch.insert(vch.end(), m_stream.begin(), m_stream.end());
+    uint256 hash;
+    CHash256().Write(vch.data(), vch.size()).Finalize(hash.begin());
+    vch.insert(vch.end(), hash.begin(), hash.end());
+    return vch;
+}
+
+bool CStateFileWriter::WriteToFile(const fs::path& path) const
+{
+    return WriteToFile(path, GetContent());
+}
+
+bool CStateFileWriter::WriteToFile(const fs::path& path, const std::vector<unsigned char>& vch)
+{
+    FILE* file = fsbridge::fopen(path, "wb");
+    if (!file) return false;
+    bool fSuccess = fwrite(vch.data(), 1, vch.size(), file) == vch.size();
+    if (fSuccess && !FileCommit(file)) fSuccess = false;
+    if (fclose(file) != 0) fSuccess = false;
+    return fSuccess;
+}
+
+CStateFileStreamWriter::CStateFileStreamWriter(const fs::path& path, uint8_t nType, uint64_t nRecords)
+  : m_file(fsbridge::fopen(path, "wb")), m_record(SER_DISK, CLIENT_VERSION), m_fFailed(false)
+{
+    std::vector<unsigned char> vchHeader;
+    WriteStateFileHeader(vchHeader, nType, nRecords);
+    Write(vchHeader.data(), vchHeader.size());
+}
+
+CStateFileStreamWriter::~CStateFileStreamWriter()
+{
+    if (m_file) fclose(m_file);
+}
+
+void CStateFileStreamWriter::Write(const unsigned char* pdata, size_t nSize)
+{
+    if (!m_file || m_fFailed) return;
+    m_hasher.Write(pdata, nSize);
+    if (fwrite(pdata, 1, nSize, m_file) != nSize) m_fFailed = true;
+}
+
+bool CStateFileStreamWriter::Finish()
+{
+    if (!m_file) return false;
+
+    uint256 hash;
+    m_hasher.Finalize(hash.begin());
+    Write(hash.begin(), hash.size());
+    bool fSuccess = !m_fFailed && FileCommit(m_file);
+    if (fclose(m_file) != 0) fSuccess = false;
+    m_file = nullptr;
+    return fSuccess;
+}
+
+bool SyncStateDirectory(const fs::path& dir)
+{
+#ifndef WIN32
+    int fd = open(dir.string().c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool fSuccess = fsync(fd) == 0;
+    close(fd);
+    return fSuccess;
+#else
+    // renames are durable without flushing the directory
+    return true;
+#endif
+}
+
+/** Appends the part of a length, which didn't fit into the token, in steps of 255. */
+static void WriteLZLength(std::vector<unsigned char>& out, size_t nLength)
+{
+    while (nLength >= 255) {
+        out.push_back(255);
+        nLength -= 255;
+    }
+    out.push_back(nLength);
+}
+
+/** Reads the part of a length, which didn't fit into the token, and returns false, if the data ends. */
+static bool ReadLZLength(const unsigned char*& p, const unsigned char* pend, size_t& nLength)
+{
+    unsigned char n;
+    do {
+        if (p == pend) return false;
+        n = *p++;
+        nLength += n;
+    } while (n == 255);
+    return true;
+}
+
+/**
+ * Appends a sequence of literals, followed by a repetition of earlier data, or no repetition, if it's the last one.
+ *
+ * Layout: token with the lengths of the literals and the repetition in four bits each, the rest of
+ * the length of the literals, the literals, the distance of the repetition in two bytes little-endian
+ * and the rest of the length of the repetition.
+ */
+static void WriteLZSequence(std::vector<unsigned char>& out, const unsigned char* pLiterals, size_t nLiterals, size_t nOffset, size_t nMatch)
+{
+    const size_t nMatchCode = nMatch ? nMatch - LZ_MIN_MATCH : 0;
+    out.push_back((std::min<size_t>(nLiterals, 15) << 4) | std::min<size_t>(nMatchCode, 15));
+    if (nLiterals >= 15) WriteLZLength(out, nLiterals - 15);
+    out.insert(out.end(), pLiterals, pLiterals + nLiterals);
+    if (nMatch == 0) return;
+
+    out.push_back(nOffset & 0xff);
+    out.push_back(nOffset >> 8);
+    if (nMatchCode >= 15) WriteLZLength(out, nMatchCode - 15);
+}
+
+/**
+ * Compresses a frame by replacing repeated sequences with references to their earlier occurrences.
+ *
+ * Earlier positions are found by a hash of the next four bytes, and the search speeds up over
+ * data without repetitions, so incompressible frames cost little time.
+ */
+static void CompressFrame(const unsigned char* pdata, size_t nSize, std::vector<unsigned char>& out)
+{
+    std::vector<uint32_t> vTable(1 << LZ_HASH_BITS, 0);
+    size_t nAnchor = 0;
+    size_t nPos = 0;
+    const size_t nLimit = nSize > LZ_LAST_LITERALS + LZ_MIN_MATCH ? nSize - LZ_LAST_LITERALS - LZ_MIN_MATCH : 0;
+    while (nPos < nLimit) {
+        const uint32_t nSequence = ReadLE32(pdata + nPos);
+        const uint32_t nHash = (nSequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+        // the table holds the positions plus one, so that 0 marks an empty slot
+        const size_t nCandidate = vTable[nHash];
+        vTable[nHash] = nPos + 1;
+        if (nCandidate == 0 || nPos + 1 - nCandidate > LZ_MAX_OFFSET || ReadLE32(pdata + nCandidate - 1) != nSequence) {
+            nPos += 1 + ((nPos - nAnchor) >> 6);
+            continue;
+        }
+
+        const size_t nMatchPos = nCandidate - 1;
+        size_t nMatch = LZ_MIN_MATCH;
+        while (nPos + nMatch < nSize - LZ_LAST_LITERALS && pdata[nMatchPos + nMatch] == pdata[nPos + nMatch]) ++nMatch;
+
+        WriteLZSequence(out, pdata + nAnchor, nPos - nAnchor, nPos - nMatchPos, nMatch);
+        nPos += nMatch;
+        nAnchor = nPos;
+    }
+    WriteLZSequence(out, pdata + nAnchor, nSize - nAnchor, 0, 0);
+}
+
+/** Restores a frame of exactly the given size, and returns false, if the compressed data is malformed. */
+static bool DecompressFrame(const unsigned char* p, const unsigned char* pend, unsigned char* pout, size_t nSize)
+{
+    size_t nPos = 0;
+    while (true) {
+        if (p == pend) return false;
+        const unsigned char nToken = *p++;
+
+        size_t nLiterals = nToken >> 4;
+        if (nLiterals == 15 && !ReadLZLength(p, pend, nLiterals)) return false;
+        if (nLiterals > static_cast<size_t>(pend - p) || nLiterals > nSize - nPos) return false;
+        memcpy(pout + nPos, p, nLiterals);
+        p += nLiterals;
+        nPos += nLiterals;
+
+        // the last sequence has no repetition
+        if (p == pend) return nPos == nSize;
+
+        if (pend - p < 2) return false;
+        const size_t nOffset = p[0] | (static_cast<size_t>(p[1]) << 8);
+        p += 2;
+        size_t nMatch = nToken & 15;
+        if (nMatch == 15 && !ReadLZLength(p, pend, nMatch)) return false;
+        nMatch += LZ_MIN_MATCH;
+        if (nOffset == 0 || nOffset > nPos || nMatch > nSize - nPos) return false;
+
+        // the repetition may overlap with itself, so it's copied byte by byte
+        for (size_t n = 0; n < nMatch; ++n, ++nPos) {
+            pout[nPos] = pout[nPos - nOffset];
+        }
+    }
+}
+
+std::vector<unsigned char> CompressStateFile(const std::vector<unsigned char>& vch)
+{
+    // without a trailing hash it's not a state file
+    if (vch.size() < CHash256::OUTPUT_SIZE) return vch;
+
+    std::vector<unsigned char> vchOut(COMPRESSED_STATE_FILE_MAGIC, COMPRESSED_STATE_FILE_MAGIC + sizeof(COMPRESSED_STATE_FILE_MAGIC));
+    vchOut.push_back(COMPRESSED_STATE_FILE_VERSION);
+
+    const size_t nContentSize = vch.size() - CHash256::OUTPUT_SIZE;
+    std::vector<unsigned char> vchFrame;
+    for (size_t nPos = 0; nPos < nContentSize; nPos += STATE_FILE_FRAME_SIZE) {
+        const size_t nFrameSize = std::min(STATE_FILE_FRAME_SIZE, nContentSize - nPos);
+        vchFrame.clear();
+        CompressFrame(vch.data() + nPos, nFrameSize, vchFrame);
+
+        // frames, which don't get smaller, are stored as they are
+        const bool fStored = vchFrame.size() >= nFrameSize;
+        CVectorWriter writer(SER_DISK, CLIENT_VERSION, vchOut, vchOut.size());
+        WriteCompactSize(writer, nFrameSize);
+        WriteCompactSize(writer, fStored ? 0 : vchFrame.size());
+        if (fStored) {
+            vchOut.insert(vchOut.end(), vch.begin() + nPos, vch.begin() + nPos + nFrameSize);
+        } else {
+            vchOut.insert(vchOut.end(), vchFrame.begin(), vchFrame.end());
+        }
+    }
+    vchOut.insert(vchOut.end(), vch.end() - CHash256::OUTPUT_SIZE, vch.end());
+
+    return vchOut;
+}
+
+bool IsCompressedStateFile(const unsigned char* pdata, size_t nSize)
+{
+    return nSize >= sizeof(COMPRESSED_STATE_FILE_MAGIC) && memcmp(pdata, COMPRESSED_STATE_FILE_MAGIC, sizeof(COMPRESSED_STATE_FILE_MAGIC)) == 0;
+}
+
+bool DecompressStateFile(const unsigned char* pdata, size_t nSize, std::vector<unsigned char>& vch)
+{
+    vch.clear();
+    if (!IsCompressedStateFile(pdata, nSize) || nSize < COMPRESSED_STATE_FILE_HEADER_SIZE + CHash256::OUTPUT_SIZE) return false;
+    if (pdata[sizeof(COMPRESSED_STATE_FILE_MAGIC)] != COMPRESSED_STATE_FILE_VERSION) return false;
+
+    // the integrity of the content is checked by its trailing hash, once it's restored
+    CSpanReader stream(pdata + COMPRESSED_STATE_FILE_HEADER_SIZE, pdata + nSize - CHash256::OUTPUT_SIZE);
+    try {
+        while (!stream.empty()) {
+            const uint64_t nFrameSize = ReadCompactSize(stream);
+            const uint64_t nPacked = ReadCompactSize(stream);
+            const uint64_t nStored = nPacked ? nPacked : nFrameSize;
+            if (nFrameSize == 0 || nFrameSize > STATE_FILE_FRAME_SIZE || nStored > stream.size()) return false;
+
+            const size_t nPos = vch.size();
+            vch.resize(nPos + nFrameSize);
+            if (nPacked == 0) {
+                memcpy(vch.data() + nPos, stream.data(), nFrameSize);
+            } else if (!DecompressFrame(stream.data(), stream.data() + nPacked, vch.data() + nPos, nFrameSize)) {
+                return false;
+            }
+            stream.ignore(nStored);
+        }
+    } catch (const std::ios_base::failure&) {
+        return false;
+    }
+    vch.insert(vch.end(), pdata + nSize - CHash256::OUTPUT_SIZE, pdata + nSize);
+
+    return true;
+}
+
+CMappedStateFile::CMappedStateFile(const fs::path& path)
+  : m_data(nullptr), m_size(0), m_fOpen(false), m_fMapped(false)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return;
+    }
+
+    m_fOpen = true;
+    m_size = st.st_size;
+    if (m_size > 0) {
+        void* addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            m_data = static_cast<const unsigned char*>(addr);
+            m_fMapped = true;
+            // the records are decoded front to back
+            posix_madvise(addr, m_size, POSIX_MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+
+    if (m_fMapped || m_size == 0) return;
+#endif
+
+    // fall back to reading the whole file
+    m_fOpen = false;
+    m_size = 0;
+    FILE* file = fsbridge::fopen(path, "rb");
+    if (!file) return;
+
+    unsigned char buf[65536];
+    size_t nRead;
+    while ((nRead = fread(buf, 1, sizeof(buf), file)) > 0) {
+        m_buffer.insert(m_buffer.end(), buf, buf + nRead);
+    }
+    m_fOpen = !ferror(file);
+    fclose(file);
+
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+CMappedStateFile::~CMappedStateFile()
+{
+#ifndef WIN32
+    if (m_fMapped) {
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+    }
+#endif
+}
+
+bool CMappedStateFile::Decompress()
+{
+    if (!IsCompressedStateFile(m_data, m_size)) return true;
+
+    std::vector<unsigned char> vch;
+    if (!DecompressStateFile(m_data, m_size, vch)) return false;
+#ifndef WIN32
+    if (m_fMapped) {
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+        m_fMapped = false;
+    }
+#endif
+    m_buffer.swap(vch);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    return true;
+}
+
+CStateFileReader::CStateFileReader(const unsigned char* pdata, size_t nSize, bool fVerifyHash)
+  : m_stream(nullptr, nullptr), m_nType(0), m_nRecords(0), m_fValid(false)
+{
+    if (!IsStateFile(pdata, nSize) || nSize < STATE_FILE_HEADER_SIZE + CHash256::OUTPUT_SIZE) return;
+    const uint8_t nVersion = pdata[sizeof(STATE_FILE_MAGIC)];
+    if (nVersion < MIN_STATE_FILE_VERSION || nVersion > STATE_FILE_VERSION) return;
+    if (fVerifyHash && !VerifyHash(pdata, nSize)) return;
+
+    const size_t nContentSize = nSize - CHash256::OUTPUT_SIZE;
+
+    m_nType = pdata[sizeof(STATE_FILE_MAGIC) + 1];
+    m_stream = CSpanReader(pdata + STATE_FILE_HEADER_SIZE, pdata + nContentSize);
+    if (nVersion >= 2) {
+        try {
+            m_nRecords = ReadCompactSize(m_stream);
+        } catch (const std::ios_base::failure&) {
+            return;
+        }
+        // every record takes at least one byte, so the number can't exceed the size
+        if (m_nRecords > m_stream.size()) return;
+    }
+    m_fValid = true;
+}
+
+CStateFileReader::CStateFileReader(uint8_t nType, const unsigned char* pbegin, const unsigned char* pend)
+  : m_stream(pbegin, pend), m_nType(nType), m_nRecords(0), m_fValid(true)
+{
+}
+
+bool CStateFileReader::VerifyHash(const unsigned char* pdata, size_t nSize)
+{
+    if (nSize < CHash256::OUTPUT_SIZE) return false;
+
+    const size_t nContentSize = nSize - CHash256::OUTPUT_SIZE;
+    uint256 hash;
+    CHash256().Write(pdata, nContentSize).Finalize(hash.begin());
+    return memcmp(hash.begin(), pdata + nContentSize, CHash256::OUTPUT_SIZE) == 0;
+}
+
+bool CStateFileReader::Split(size_t nParts, std::vector<CStateFileReader>& vParts)
+{
+    vParts.clear();
+    if (nParts == 0) nParts = 1;
+
+    // find the start of every record, without decoding the records
+    std::vector<const unsigned char*> vStarts;
+    try {
+        while (!m_stream.empty()) {
+            vStarts.push_back(m_stream.data());
+            m_stream.ignore(ReadCompactSize(m_stream));
+        }
+    } catch (const std::ios_base::failure&) {
+        return false;
+    }
+
+    // every part gets about the same number of records, and refers to the same buffer
+    const unsigned char* pEnd = m_stream.data();
+    const size_t nRecords = vStarts.size();
+    nParts = std::min(nParts, nRecords);
+    for (size_t n = 0; n < nParts; ++n) {
+        size_t nFirst = nRecords * n / nParts;
+        size_t nLast = nRecords * (n + 1) / nParts;
+        vParts.push_back(CStateFileReader(m_nType, vStarts[nFirst], nLast < nRecords ? vStarts[nLast] : pEnd));
+    }
+
+    return true;
+}
+
+bool CStateFileReader::IsStateFile(const unsigned char* pdata, size_t nSize)
+{
+    return nSize >= sizeof(STATE_FILE_MAGIC) && memcmp(pdata, STATE_FILE_MAGIC, sizeof(STATE_FILE_MAGIC)) == 0;
+}
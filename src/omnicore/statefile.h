@@ -0,0 +1,302 @@
+#ifndef BITCOIN_OMNICORE_STATEFILE_H
+#define BITCOIN_OMNICORE_STATEFILE_H
+
+#include <clientversion.h>
+#include <fs.h>
+#include <hash.h>
+#include <serialize.h>
+#include <streams.h>
+
+#include <ios>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+//! Version of the binary format of the state files
+static const uint8_t STATE_FILE_VERSION = 2;
+//! Earliest version of the binary format, which can still be read, and which has no record count
+static const uint8_t MIN_STATE_FILE_VERSION = 1;
+//! Maximal size of the sections of a state file, which are compressed independently
+static const size_t STATE_FILE_FRAME_SIZE = 1 << 20;
+
+/** Formatter for signed amounts as variable length integers in zigzag encoding, so small negative amounts stay short. */
+struct VarAmountFormatter
+{
+    template <typename Stream>
+    void Ser(Stream& s, int64_t v)
+    {
+        WriteVarInt<Stream, VarIntMode::DEFAULT, uint64_t>(s, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+    }
+
+    template <typename Stream>
+    void Unser(Stream& s, int64_t& v)
+    {
+        uint64_t n = ReadVarInt<Stream, VarIntMode::DEFAULT, uint64_t>(s);
+        v = static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+    }
+};
+
+#define VARAMOUNT(obj) Using<VarAmountFormatter>(obj)
+#define VARBLOCK(obj) VARINT_MODE(obj, VarIntMode::NONNEGATIVE_SIGNED)
+
+/**
+ * Writes a state file in the binary format.
+ *
+ * Layout: magic + version + file type + number of records as compact size, followed by
+ * the records, each prefixed by its length as compact size, and the double SHA256 hash
+ * of everything before it.
+ *
+ * The number of records allows readers to presize the containers, which are restored
+ * from the file, where 0 stands for an unknown number.
+ *
+ * The records are collected in memory, and the file is written at once.
+ */
+class CStateFileWriter
+{
+private:
+    uint8_t m_nType;
+    uint64_t m_nRecords;
+    CDataStream m_stream;
+
+public:
+    explicit CStateFileWriter(uint8_t nType);
+
+    /** Adds a record, which consists of the serialized arguments. */
+    template <typename... Args>
+    void WriteRecord(const Args&... args)
+    {
+        WriteCompactSize(m_stream, GetSerializeSizeMany(m_stream.GetVersion(), args...));
+        SerializeMany(m_stream, args...);
+        ++m_nRecords;
+    }
+
+    /** Returns the content of the file, including the trailing hash. */
+    std::vector<unsigned char> GetContent() const;
+
+    /** Writes the file, and returns false, if it failed. */
+    bool WriteToFile(const fs::path& path) const;
+
+    /** Writes the content of a state file and flushes it to disk, and returns false, if it failed. */
+    static bool WriteToFile(const fs::path& path, const std::vector<unsigned char>& vch);
+};
+
+/**
+ * Writes a state file in the binary format record by record.
+ *
+ * The content is the same as the one of CStateFileWriter, but the records are
+ * written to the file right away, so large files are not held in memory, and the
+ * number of records in the header must be known in advance, or 0.
+ */
+class CStateFileStreamWriter
+{
+private:
+    FILE* m_file;
+    CHash256 m_hasher;
+    CDataStream m_record;
+    bool m_fFailed;
+
+    void Write(const unsigned char* pdata, size_t nSize);
+
+public:
+    CStateFileStreamWriter(const fs::path& path, uint8_t nType, uint64_t nRecords = 0);
+    ~CStateFileStreamWriter();
+
+    CStateFileStreamWriter(const CStateFileStreamWriter&) = delete;
+    CStateFileStreamWriter& operator=(const CStateFileStreamWriter&) = delete;
+
+    /** Returns whether the file could be created. */
+    bool IsOpen() const { return m_file != nullptr; }
+
+    /** Adds a record, which consists of the serialized arguments. */
+    template <typename... Args>
+    void WriteRecord(const Args&... args)
+    {
+        m_record.clear();
+        WriteCompactSize(m_record, GetSerializeSizeMany(m_record.GetVersion(), args...));
+        SerializeMany(m_record, args...);
+        Write(reinterpret_cast<const unsigned char*>(m_record.data()), m_record.size());
+    }
+
+    /** Appends the trailing hash, flushes the file to disk and closes it, and returns false, if any write failed. */
+    bool Finish();
+};
+
+/** Flushes the entries of a directory, such as renamed files, to disk, and returns false, if it failed. */
+bool SyncStateDirectory(const fs::path& dir);
+
+/**
+ * Compresses the content of a state file.
+ *
+ * Layout: magic + version, followed by frames of up to STATE_FILE_FRAME_SIZE bytes of the
+ * content, each prefixed by its size and its compressed size as compact size, where a
+ * compressed size of 0 marks a frame, which is stored as it is, and the trailing hash of
+ * the content.
+ *
+ * The compressed file ends with the same hash as the content, so it can be listed in a
+ * manifest like any other state file.
+ */
+std::vector<unsigned char> CompressStateFile(const std::vector<unsigned char>& vch);
+
+/** Returns whether the buffer starts with the magic bytes of a compressed state file. */
+bool IsCompressedStateFile(const unsigned char* pdata, size_t nSize);
+
+/** Restores the content of a compressed state file, and returns false, if it's malformed. */
+bool DecompressStateFile(const unsigned char* pdata, size_t nSize, std::vector<unsigned char>& vch);
+
+/**
+ * Stream to decode serialized data in place from a range of memory.
+ */
+class CSpanReader
+{
+private:
+    const unsigned char* m_pos;
+    const unsigned char* m_end;
+
+public:
+    CSpanReader(const unsigned char* pbegin, const unsigned char* pend) : m_pos(pbegin), m_end(pend) {}
+
+    int GetType() const { return SER_DISK; }
+    int GetVersion() const { return CLIENT_VERSION; }
+
+    void read(char* dst, size_t n)
+    {
+        if (n > size()) {
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        }
+        memcpy(dst, m_pos, n);
+        m_pos += n;
+    }
+
+    void ignore(size_t n)
+    {
+        if (n > size()) {
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        }
+        m_pos += n;
+    }
+
+    template <typename T>
+    CSpanReader& operator>>(T&& obj)
+    {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+
+    const unsigned char* data() const { return m_pos; }
+    size_t size() const { return m_end - m_pos; }
+    bool empty() const { return m_pos == m_end; }
+};
+
+/**
+ * A state file, which is mapped into memory read-only.
+ *
+ * Where memory mapping isn't available, the file is read into a buffer instead.
+ */
+class CMappedStateFile
+{
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    bool m_fOpen;
+    bool m_fMapped;
+    std::vector<unsigned char> m_buffer;
+
+public:
+    explicit CMappedStateFile(const fs::path& path);
+    ~CMappedStateFile();
+
+    CMappedStateFile(const CMappedStateFile&) = delete;
+    CMappedStateFile& operator=(const CMappedStateFile&) = delete;
+
+    /** Returns whether the file could be opened. */
+    bool IsOpen() const { return m_fOpen; }
+
+    /**
+     * Replaces the content of a compressed state file by the decompressed content.
+     *
+     * Other files are left as they are. Returns false, if the compressed file is malformed.
+     */
+    bool Decompress();
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
+/**
+ * Decodes a state file in the binary format in place from a buffer.
+ *
+ * The buffer must outlive the reader and the parts created by Split().
+ */
+class CStateFileReader
+{
+private:
+    CSpanReader m_stream;
+    uint8_t m_nType;
+    uint64_t m_nRecords;
+    bool m_fValid;
+
+    /** Creates a reader of a part of the records of another reader. */
+    CStateFileReader(uint8_t nType, const unsigned char* pbegin, const unsigned char* pend);
+
+public:
+    /**
+     * Checks the header and the trailing hash of the buffer.
+     *
+     * The hash check can be skipped, if it's done separately via VerifyHash().
+     */
+    CStateFileReader(const unsigned char* pdata, size_t nSize, bool fVerifyHash = true);
+    explicit CStateFileReader(const std::vector<unsigned char>& vch, bool fVerifyHash = true)
+      : CStateFileReader(vch.data(), vch.size(), fVerifyHash) {}
+    CStateFileReader(std::vector<unsigned char>&& vch, bool fVerifyHash = true) = delete;
+
+    /** Returns whether the buffer starts with the magic bytes of the binary format. */
+    static bool IsStateFile(const unsigned char* pdata, size_t nSize);
+    static bool IsStateFile(const std::vector<unsigned char>& vch) { return IsStateFile(vch.data(), vch.size()); }
+
+    /** Returns whether the trailing hash of the buffer matches its content. */
+    static bool VerifyHash(const unsigned char* pdata, size_t nSize);
+    static bool VerifyHash(const std::vector<unsigned char>& vch) { return VerifyHash(vch.data(), vch.size()); }
+
+    /** Returns whether the buffer is a state file of the supported version with a valid hash. */
+    bool IsValid() const { return m_fValid; }
+
+    /**
+     * Moves the remaining records into at most nParts readers, which can be decoded independently.
+     *
+     * @return False, if the length prefixes of the records don't match the size of the content
+     */
+    bool Split(size_t nParts, std::vector<CStateFileReader>& vParts);
+
+    uint8_t GetType() const { return m_nType; }
+
+    /**
+     * Returns the number of records according to the header, or 0, if it's unknown.
+     *
+     * The number is bounded by the size of the file, but only meant to presize containers.
+     */
+    uint64_t GetRecordCount() const { return m_nRecords; }
+
+    /** Returns whether all records were read. */
+    bool AtEnd() const { return m_stream.empty(); }
+
+    /** Reads the next record into the arguments, and returns false, if it can't be decoded completely. */
+    template <typename... Args>
+    bool ReadRecord(Args&&... args)
+    {
+        try {
+            uint64_t nSize = ReadCompactSize(m_stream);
+            if (nSize > m_stream.size()) return false;
+            CSpanReader record(m_stream.data(), m_stream.data() + nSize);
+            m_stream.ignore(nSize);
+            UnserializeMany(record, args...);
+            return record.empty();
+        } catch (const std::ios_base::failure&) {
+            return false;
+        }
+    }
+};
+
+#endif // BITCOIN_OMNICORE_STATEFILE_H
@@ -0,0 +1,115 @@
+/**
+ * @file statescan.cpp
+ *
+ * This file contains the scans of the state in chunks, which release cs_tally
+ * between the chunks, and the cursors over the tally map and the order book.
+ */
+
+#include <omnicore/statescan.h>
+
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/tally.h>
+
+#include <sync.h>
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+namespace mastercore
+{
+namespace
+{
+//! Modifications of the orders and crowdsales, which are added to the generation of the tally map
+uint64_t g_nStateGeneration GUARDED_BY(cs_tally) = 0;
+}
+
+uint64_t GetStateGeneration()
+{
+    return mp_tally_map.GetGeneration() + g_nStateGeneration;
+}
+
+void BumpStateGeneration()
+{
+    ++g_nStateGeneration;
+}
+
+int ScanStateInChunks(const std::function<bool()>& fnChunk, const std::function<void()>& fnRestart,
+        const std::function<void()>& fnUnlocked)
+{
+    int nRestarts = 0;
+    uint64_t nGeneration = 0;
+    bool fStarted = false;
+    bool fMore = true;
+
+    while (fMore) {
+        {
+            LOCK(cs_tally);
+            if (fStarted && fnRestart && GetStateGeneration() != nGeneration) {
+                fnRestart();
+                ++nRestarts;
+            }
+            fStarted = true;
+
+            if (fnRestart && nRestarts >= MAX_STATE_SCAN_RESTARTS) {
+                // the remaining chunks are processed without releasing the lock
+                do {
+                    fMore = fnChunk();
+                    if (fnUnlocked) fnUnlocked();
+                } while (fMore);
+                break;
+            }
+
+            fMore = fnChunk();
+            nGeneration = GetStateGeneration();
+        }
+        if (fnUnlocked) fnUnlocked();
+        // give waiting threads, such as block processing, a chance to take the lock
+        if (fMore) std::this_thread::yield();
+    }
+
+    return nRestarts;
+}
+
+bool CTallyCursor::Next(size_t nMax, const std::function<void(uint32_t, const std::string&, const CMPTally&)>& fn)
+{
+    const uint32_t nEnd = mp_tally_map.size();
+    for (size_t n = 0; n < nMax && m_nNext < nEnd; ++n, ++m_nNext) {
+        fn(m_nNext, mp_tally_map.GetAddress(m_nNext), *mp_tally_map.Get(m_nNext));
+    }
+    return m_nNext < nEnd;
+}
+
+bool CMetaDExCursor::Next(size_t nMax, const std::function<void(const CMPMetaDEx&)>& fn)
+{
+    if (!m_fStarted) {
+        m_fStarted = true;
+        m_itProperty = metadex.begin();
+        if (m_itProperty != metadex.end()) {
+            m_itPrice = m_itProperty->second.begin();
+            if (m_itPrice != m_itProperty->second.end()) m_itOrder = m_itPrice->second.begin();
+        }
+    }
+
+    size_t n = 0;
+    while (m_itProperty != metadex.end()) {
+        if (m_itPrice == m_itProperty->second.end()) {
+            if (++m_itProperty != metadex.end()) {
+                m_itPrice = m_itProperty->second.begin();
+                if (m_itPrice != m_itProperty->second.end()) m_itOrder = m_itPrice->second.begin();
+            }
+            continue;
+        }
+        if (m_itOrder == m_itPrice->second.end()) {
+            if (++m_itPrice != m_itProperty->second.end()) m_itOrder = m_itPrice->second.begin();
+            continue;
+        }
+        if (n++ == nMax) return true;
+        fn(*m_itOrder++);
+    }
+    return false;
+}
+}
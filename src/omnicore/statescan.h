@@ -0,0 +1,109 @@
+#ifndef BITCOIN_OMNICORE_STATESCAN_H
+#define BITCOIN_OMNICORE_STATESCAN_H
+
+#include <omnicore/mdex.h>
+#include <omnicore/timedmutex.h>
+
+#include <sync.h>
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+extern CTimedRecursiveMutex cs_tally;
+
+class CMPTally;
+
+namespace mastercore
+{
+//! Maximal number of addresses or orders visited by one chunk of a state scan, while cs_tally is held
+static const size_t STATE_SCAN_CHUNK_SIZE = 10000;
+//! Number of times a state scan starts over, before it keeps cs_tally until it's complete
+static const int MAX_STATE_SCAN_RESTARTS = 3;
+
+/**
+ * Long scans of the state, such as the consensus hash of all balances, are split into
+ * chunks of bounded size, and cs_tally is released between the chunks, so block
+ * processing waits for one chunk at most, instead of the whole scan.
+ *
+ * The state generation changes with every modification of the balances, the DEx offers
+ * and accepts, the MetaDEx orders and the crowdsales, so a scan can tell, whether the
+ * state was modified between two chunks, and either start over or merge the changes.
+ */
+
+/** Returns a counter, which changes with every modification of the balances, orders and crowdsales. */
+uint64_t GetStateGeneration() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Marks the orders or crowdsales as modified, which are not covered by the tally map. */
+void BumpStateGeneration() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Scans the state in chunks, and releases cs_tally between the chunks.
+ *
+ * fnChunk is called with cs_tally held, processes a bounded part of the state, and returns
+ * false, once the scan is complete. fnUnlocked is called after every chunk, once the lock
+ * was released, to process the data copied so far, such as sorting it.
+ *
+ * If the state was modified between two chunks, fnRestart discards the partial results, and
+ * the scan starts over. After MAX_STATE_SCAN_RESTARTS restarts the lock is kept until the scan
+ * is complete. Without fnRestart the scan continues, and the caller merges the modifications
+ * later on. Nothing is released, if the caller holds cs_tally already.
+ *
+ * @return The number of restarts
+ */
+int ScanStateInChunks(const std::function<bool()>& fnChunk, const std::function<void()>& fnRestart,
+        const std::function<void()>& fnUnlocked = nullptr);
+
+/**
+ * Resumable position in the tally map, which visits the addresses in the order of their identifiers.
+ *
+ * The position remains valid between chunks, as long as the map isn't cleared.
+ */
+class CTallyCursor
+{
+private:
+    uint32_t m_nNext;
+
+public:
+    CTallyCursor() : m_nNext(0) {}
+
+    void Reset() { m_nNext = 0; }
+
+    /**
+     * Calls fn(id, address, tally) for the next addresses, at most nMax of them.
+     *
+     * @return False, if all addresses were visited
+     */
+    bool Next(size_t nMax, const std::function<void(uint32_t, const std::string&, const CMPTally&)>& fn) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+};
+
+/**
+ * Resumable position in the MetaDEx order book, which visits the orders by property, price and insertion.
+ *
+ * The position refers to the maps of the order book, and is only valid between chunks, as long as the
+ * state generation is unchanged.
+ */
+class CMetaDExCursor
+{
+private:
+    md_PropertiesMap::const_iterator m_itProperty;
+    md_PricesMap::const_iterator m_itPrice;
+    md_Set::const_iterator m_itOrder;
+    bool m_fStarted;
+
+public:
+    CMetaDExCursor() : m_fStarted(false) {}
+
+    void Reset() { m_fStarted = false; }
+
+    /**
+     * Calls fn(order) for the next orders, at most nMax of them.
+     *
+     * @return False, if all orders were visited
+     */
+    bool Next(size_t nMax, const std::function<void(const CMPMetaDEx&)>& fn) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+};
+}
+
+#endif // BITCOIN_OMNICORE_STATESCAN_H
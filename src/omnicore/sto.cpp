@@ -4,16 +4,21 @@
 #include <omnicore/omnicore.h>
 #include <omnicore/tally.h>
 #include <omnicore/uint256_extensions.h>
+#include <omnicore/workerpool.h>
 
-#include <arith_uint256.h>
+#include <amount.h>
 #include <sync.h>
+#include <util/system.h>
 
+#include <algorithm>
 #include <assert.h>
-#include <stdint.h>
 #include <map>
+#include <memory>
 #include <set>
+#include <stdint.h>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace mastercore
 {
@@ -28,88 +33,191 @@ bool SendToOwners_compare::operator()(const std::pair<int64_t, std::string>& p1,
 }
 
 /**
- * Determines the receivers and amounts to distribute.
- *
- * The sender is excluded from the result set.
+ * Returns ceil(owned * amount / totalTokens).
  */
-OwnerAddrType STO_GetReceivers(const std::string& sender, uint32_t property, int64_t amount)
+static int64_t CalculateShare(int64_t owned, int64_t amount, int64_t totalTokens)
 {
-    int64_t totalTokens = 0;
-    int64_t senderTokens = 0;
-    OwnerAddrType ownerAddrSet;
-
-    {
-        LOCK(cs_tally);
-        std::unordered_map<std::string, CMPTally>::iterator it;
-
-        for (it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-            const std::string& address = it->first;
-            const CMPTally& tally = it->second;
-
-            int64_t tokens = 0;
-            tokens += tally.getMoney(property, BALANCE);
-            tokens += tally.getMoney(property, SELLOFFER_RESERVE);
-            tokens += tally.getMoney(property, ACCEPT_RESERVE);
-            tokens += tally.getMoney(property, METADEX_RESERVE);
-
-            // Do not include the sender
-            if (address == sender) {
-                senderTokens = tokens;
-                continue;
-            }
-
-            totalTokens += tokens;
+    return MultiplyAndDivideRoundUp(owned, amount, totalTokens);
+}
 
-            // Only holders with balance are relevant
-            if (0 < tokens) {
-                ownerAddrSet.insert(std::make_pair(tokens, address));
+/**
+ * Calculates the amounts to distribute to owners.
+ *
+ * Every owner receives at least one unit, so no more than amount owners can
+ * receive anything, and the shares of the other owners are never calculated.
+ *
+ * The shares are independent from each other, and are calculated in parallel
+ * for large distributions. The allocation of the remaining amount is applied
+ * sequentially afterwards.
+ */
+void STO_CalculateDistribution(const std::vector<int64_t>& vOwned, int64_t amount, int64_t totalTokens,
+        std::vector<int64_t>& vReceive, CWorkerPool* pPool)
+{
+    vReceive.clear();
+    if (amount <= 0 || totalTokens <= 0) return;
+
+    size_t nCandidates = vOwned.size();
+    if (amount < static_cast<int64_t>(nCandidates)) nCandidates = amount;
+    vReceive.resize(nCandidates);
+
+    if (pPool && pPool->Size() > 0 && nCandidates >= STO_PARALLEL_THRESHOLD) {
+        const size_t nChunks = pPool->Size() + 1;
+        const size_t nChunkSize = (nCandidates + nChunks - 1) / nChunks;
+        pPool->ForEach(nChunks, [&](size_t nChunk) {
+            size_t nEnd = std::min(nCandidates, (nChunk + 1) * nChunkSize);
+            for (size_t i = nChunk * nChunkSize; i < nEnd; ++i) {
+                vReceive[i] = CalculateShare(vOwned[i], amount, totalTokens);
             }
+        });
+    } else {
+        for (size_t i = 0; i < nCandidates; ++i) {
+            vReceive[i] = CalculateShare(vOwned[i], amount, totalTokens);
         }
     }
 
-    // Split up what was taken and distribute between all holders
+    // Ensure that no more than available is distributed, and stop, once the whole amount is allocated
     int64_t sent_so_far = 0;
-    OwnerAddrType receiversSet;
+    for (size_t i = 0; i < nCandidates; ++i) {
+        int64_t will_really_receive = std::min(vReceive[i], amount - sent_so_far);
+        if (will_really_receive <= 0) {
+            vReceive.resize(i);
+            break;
+        }
+        vReceive[i] = will_really_receive;
+        sent_so_far += will_really_receive;
+    }
+}
+
+/**
+ * Determines the receivers by address identifier and the amounts to distribute.
+ *
+ * The holders are sorted descending by the tokens they own, and ascending by
+ * address, if they own the same number of tokens. The result is in the same
+ * order.
+ *
+ * The sender is excluded from the result set.
+ */
+OwnerIdType STO_GetReceiverIds(const std::string& sender, uint32_t property, int64_t amount)
+{
+    int64_t totalTokens = 0;
+    int64_t senderTokens = 0;
+    std::vector<std::pair<int64_t, uint32_t> > vOwners;
+    std::vector<int64_t> vOwned;
+    std::vector<int64_t> vReceive;
+    OwnerIdType receivers;
 
-    for (OwnerAddrType::reverse_iterator it = ownerAddrSet.rbegin(); it != ownerAddrSet.rend(); ++it) {
-        const std::string& address = it->second;
+    LOCK(cs_tally);
 
-        arith_uint256 owns = ConvertTo256(it->first);
-        arith_uint256 temp = owns * ConvertTo256(amount);
-        arith_uint256 piece = DivideAndRoundUp(temp, ConvertTo256(totalTokens));
+    const uint32_t senderId = mp_tally_map.GetId(sender);
+    const CPropertyBalances& balances = mp_tally_map.GetBalances(property);
+    vOwners.reserve(balances.size());
 
-        int64_t will_really_receive = 0;
-        int64_t should_receive = ConvertTo64(piece);
+    for (size_t row = 0; row < balances.size(); ++row) {
+        const uint32_t addressId = balances.ids[row];
+        const int64_t tokens = balances.GetTokens(row);
 
-        // Ensure that no more than available is distributed
-        if ((amount - sent_so_far) < should_receive) {
-            will_really_receive = amount - sent_so_far;
-        } else {
-            will_really_receive = should_receive;
+        // Do not include the sender
+        if (addressId == senderId) {
+            senderTokens = tokens;
+            continue;
         }
 
-        sent_so_far += will_really_receive;
+        totalTokens += tokens;
 
-        if (msc_debug_sto) {
-            PrintToLog("%14d = %s, temp= %38s, should_get= %19d, will_really_get= %14d, sent_so_far= %14d\n",
-                it->first, address, temp.ToString(), should_receive, will_really_receive, sent_so_far);
+        // Only holders with balance are relevant
+        if (0 < tokens) {
+            vOwners.emplace_back(tokens, addressId);
         }
+    }
 
-        // Stop, once the whole amount is allocated
-        if (will_really_receive > 0) {
-            receiversSet.insert(std::make_pair(will_really_receive, address));
-        } else {
-            break;
+    std::sort(vOwners.begin(), vOwners.end(), [](const std::pair<int64_t, uint32_t>& a, const std::pair<int64_t, uint32_t>& b) {
+        if (a.first != b.first) return a.first > b.first;
+        return mp_tally_map.GetAddress(a.second) < mp_tally_map.GetAddress(b.second);
+    });
+
+    // Split up what was taken and distribute between all holders
+    vOwned.reserve(vOwners.size());
+    for (const auto& owner : vOwners) {
+        vOwned.push_back(owner.first);
+    }
+    CWorkerPool* pPool = (vOwned.size() >= STO_PARALLEL_THRESHOLD) ? &GetWorkerPool() : nullptr;
+    STO_CalculateDistribution(vOwned, amount, totalTokens, vReceive, pPool);
+
+    int64_t sent_so_far = 0;
+    receivers.reserve(vReceive.size());
+    for (size_t i = 0; i < vReceive.size(); ++i) {
+        sent_so_far += vReceive[i];
+
+        if (msc_debug_sto) {
+            PrintToLog("%14d = %s, should_get= %19d, will_really_get= %14d, sent_so_far= %14d\n",
+                vOwned[i], mp_tally_map.GetAddress(vOwners[i].second), CalculateShare(vOwned[i], amount, totalTokens), vReceive[i], sent_so_far);
         }
+
+        receivers.emplace_back(vReceive[i], vOwners[i].second);
     }
 
-    uint64_t numberOfOwners = receiversSet.size();
     PrintToLog("\t    Total Tokens: %s\n", FormatMP(property, totalTokens + senderTokens));
     PrintToLog("\tExcluding Sender: %s\n", FormatMP(property, totalTokens));
-    PrintToLog("\t          Owners: %d\n", numberOfOwners);
+    PrintToLog("\t          Owners: %d\n", receivers.size());
+
+    return receivers;
+}
+
+/**
+ * Determines the receivers and amounts to distribute.
+ *
+ * The result is sorted by the amount received in the order of SendToOwners_compare.
+ *
+ * The sender is excluded from the result set.
+ */
+OwnerAddrType STO_GetReceivers(const std::string& sender, uint32_t property, int64_t amount)
+{
+    OwnerAddrType receiversSet;
+
+    LOCK(cs_tally);
+
+    const OwnerIdType receivers = STO_GetReceiverIds(sender, property, amount);
+    receiversSet.reserve(receivers.size());
+    for (const auto& receiver : receivers) {
+        receiversSet.emplace_back(receiver.first, mp_tally_map.GetAddress(receiver.second));
+    }
+    std::sort(receiversSet.begin(), receiversSet.end(), SendToOwners_compare());
 
     return receiversSet;
 }
 
-} // namespace mastercore
+namespace
+{
+/** Receivers of a fee distribution, and the generation of the balances they were determined from. */
+struct CFeeShares
+{
+    uint64_t nGeneration;
+    std::shared_ptr<const OwnerAddrType> receivers;
+};
+
+//! Receivers of fee distributions by property, which are polled much more often than blocks arrive
+std::map<uint32_t, CFeeShares> g_feeShares GUARDED_BY(cs_tally);
+}
+
+/**
+ * Returns the receivers of a fee distribution of COIN units of a property.
+ *
+ * The receivers are determined once, and then shared by all callers, until the
+ * balances of the property are modified by a block.
+ */
+std::shared_ptr<const OwnerAddrType> GetFeeShares(uint32_t property)
+{
+    LOCK(cs_tally);
 
+    const uint64_t nGeneration = mp_tally_map.GetPropertyGeneration(property);
+    std::map<uint32_t, CFeeShares>::const_iterator it = g_feeShares.find(property);
+    if (it != g_feeShares.end() && it->second.nGeneration == nGeneration) {
+        return it->second.receivers;
+    }
+
+    std::shared_ptr<const OwnerAddrType> receivers = std::make_shared<const OwnerAddrType>(STO_GetReceivers("FEEDISTRIBUTION", property, COIN));
+    g_feeShares[property] = CFeeShares{nGeneration, receivers};
+
+    return receivers;
+}
+}
@@ -1,13 +1,17 @@
 #ifndef BITCOIN_OMNICORE_STO_H
 #define BITCOIN_OMNICORE_STO_H
 
+#include <stddef.h>
 #include <stdint.h>
-#include <set>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace mastercore
 {
+class CWorkerPool;
+
 //! Comparator for owner/receiver entries
 struct SendToOwners_compare
 {
@@ -18,11 +22,41 @@ struct SendToOwners_compare
 const int64_t TRANSFER_FEE_PER_OWNER = 1;
 const int64_t TRANSFER_FEE_PER_OWNER_V1 = 1000;
 
-//! Set of owner/receivers, sorted by amount they own or might receive
-typedef std::set<std::pair<int64_t, std::string>, SendToOwners_compare> OwnerAddrType;
+//! Minimum number of potential receivers to split the calculation of a distribution across threads
+const size_t STO_PARALLEL_THRESHOLD = 100000;
+
+//! Owner/receivers, sorted by amount they own or might receive, in the order of SendToOwners_compare
+typedef std::vector<std::pair<int64_t, std::string> > OwnerAddrType;
+
+//! Receivers by address identifier, with the amounts they receive, in descending order of the tokens they own
+typedef std::vector<std::pair<int64_t, uint32_t> > OwnerIdType;
+
+/** Determines the receivers by address identifier and the amounts to distribute, without copying the addresses. */
+OwnerIdType STO_GetReceiverIds(const std::string& sender, uint32_t property, int64_t amount);
 
 /** Determines the receivers and amounts to distribute. */
 OwnerAddrType STO_GetReceivers(const std::string& sender, uint32_t property, int64_t amount);
+
+/**
+ * Returns the receivers of a fee distribution of COIN units of a property, in the order of
+ * SendToOwners_compare, which are cached until the balances of the property change.
+ */
+std::shared_ptr<const OwnerAddrType> GetFeeShares(uint32_t property);
+
+/**
+ * Calculates the amounts to distribute to owners.
+ *
+ * Every owner receives the share of the amount proportional to the tokens it owns,
+ * rounded up, until the whole amount is allocated.
+ *
+ * @param vOwned       The tokens owned, sorted in descending order
+ * @param amount       The amount to distribute
+ * @param totalTokens  The total number of tokens owned
+ * @param vReceive     The amounts received by the first owners
+ * @param pPool        Optional worker threads for large distributions
+ */
+void STO_CalculateDistribution(const std::vector<int64_t>& vOwned, int64_t amount, int64_t totalTokens,
+        std::vector<int64_t>& vReceive, CWorkerPool* pPool = nullptr);
 }
 
 
@@ -1,32 +1,69 @@
 #include <omnicore/tally.h>
 
 #include <omnicore/log.h>
+#include <omnicore/memusage.h>
 #include <omnicore/omnicore.h>
 
+#include <algorithm>
+#include <assert.h>
+#include <limits>
 #include <stdint.h>
-#include <map>
+#include <string>
+#include <utility>
 
 /**
  * Creates an empty tally.
  */
-CMPTally::CMPTally()
+CMPTally::CMPTally() : my_propertyId(0), my_fEnd(true)
 {
-    my_it = mp_token.begin();
+}
+
+/**
+ * Returns the balance record of a token, or the end, if there is none.
+ */
+CMPTally::TokenMap::const_iterator CMPTally::find(uint32_t propertyId) const
+{
+    TokenMap::const_iterator it = std::lower_bound(mp_token.begin(), mp_token.end(), propertyId,
+            [](const BalanceRecord& record, uint32_t id) { return record.propertyId < id; });
+    if (it != mp_token.end() && it->propertyId == propertyId) {
+        return it;
+    }
+    return mp_token.end();
+}
+
+/**
+ * Returns the row of the balance record of a token, or NO_ROW, if there is none.
+ */
+uint32_t CMPTally::getRow(uint32_t propertyId) const
+{
+    TokenMap::const_iterator it = find(propertyId);
+    return (it != mp_token.end()) ? it->row : NO_ROW;
+}
+
+/**
+ * Sets the row of the balance record of a token, if there is one.
+ */
+void CMPTally::setRow(uint32_t propertyId, uint32_t row)
+{
+    TokenMap::const_iterator it = find(propertyId);
+    if (it != mp_token.end()) {
+        mp_token[it - mp_token.begin()].row = row;
+    }
 }
 
 /**
  * Resets the internal iterator.
  *
+ * The iterator refers to property identifiers, rather than positions, so it
+ * remains valid, when new balance records are inserted.
+ *
  * @return Identifier of the first tally element.
  */
 uint32_t CMPTally::init()
 {
-    uint32_t propertyId = 0;
-    my_it = mp_token.begin();
-    if (my_it != mp_token.end()) {
-        propertyId = my_it->first;
-    }
-    return propertyId;
+    my_fEnd = mp_token.empty();
+    my_propertyId = my_fEnd ? 0 : mp_token.front().propertyId;
+    return my_propertyId;
 }
 
 /**
@@ -36,10 +73,16 @@ uint32_t CMPTally::init()
  */
 uint32_t CMPTally::next()
 {
-    uint32_t ret = 0;
-    if (my_it != mp_token.end()) {
-        ret = my_it->first;
-        ++my_it;
+    if (my_fEnd) {
+        return 0;
+    }
+    uint32_t ret = my_propertyId;
+    TokenMap::const_iterator it = std::upper_bound(mp_token.begin(), mp_token.end(), ret,
+            [](uint32_t id, const BalanceRecord& record) { return id < record.propertyId; });
+    if (it != mp_token.end()) {
+        my_propertyId = it->propertyId;
+    } else {
+        my_fEnd = true;
     }
     return ret;
 }
@@ -60,7 +103,9 @@ static bool isOverflow(int64_t a, int64_t b)
 /**
  * Updates the number of tokens for the given tally type.
  *
- * Negative balances are only permitted for pending balances.
+ * Negative balances are only permitted for pending balances. A balance record,
+ * whose amounts are all zero afterwards, is removed, so tallies of addresses,
+ * which no longer hold any tokens, don't keep records around.
  *
  * @param propertyId  The identifier of the tally to update
  * @param amount      The amount to add
@@ -73,24 +118,36 @@ bool CMPTally::updateMoney(uint32_t propertyId, int64_t amount, TallyType ttype)
         return false;
     }
     bool fUpdated = false;
-    int64_t now64 = mp_token[propertyId].balance[ttype];
+    TokenMap::iterator it = std::lower_bound(mp_token.begin(), mp_token.end(), propertyId,
+            [](const BalanceRecord& record, uint32_t id) { return record.propertyId < id; });
+    if (it == mp_token.end() || it->propertyId != propertyId) {
+        BalanceRecord record = BalanceRecord();
+        record.propertyId = propertyId;
+        record.row = NO_ROW;
+        it = mp_token.insert(it, record);
+    }
+    int64_t& now64 = it->balance[ttype];
 
     if (isOverflow(now64, amount)) {
         PrintToLog("%s(): ERROR: arithmetic overflow [%d + %d]\n", __func__, now64, amount);
-        return false;
-    }
-
-    if (PENDING != ttype && (now64 + amount) < 0) {
+    } else if (PENDING != ttype && (now64 + amount) < 0) {
         // NOTE:
         // Negative balances are only permitted for pending balances
     } else {
 
         now64 += amount;
-        mp_token[propertyId].balance[ttype] = now64;
 
         fUpdated = true;
     }
 
+    bool fEmpty = true;
+    for (int n = 0; n < TALLY_TYPE_COUNT && fEmpty; ++n) {
+        fEmpty = it->balance[n] == 0;
+    }
+    if (fEmpty) {
+        mp_token.erase(it);
+    }
+
     return fUpdated;
 }
 
@@ -107,10 +164,10 @@ int64_t CMPTally::getMoney(uint32_t propertyId, TallyType ttype) const
         return 0;
     }
     int64_t money = 0;
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    TokenMap::const_iterator it = find(propertyId);
 
     if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
+        const BalanceRecord& record = *it;
         money = record.balance[ttype];
     }
 
@@ -128,10 +185,10 @@ int64_t CMPTally::getMoney(uint32_t propertyId, TallyType ttype) const
  */
 int64_t CMPTally::getMoneyAvailable(uint32_t propertyId) const
 {
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    TokenMap::const_iterator it = find(propertyId);
 
     if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
+        const BalanceRecord& record = *it;
         if (record.balance[PENDING] < 0) {
             return record.balance[BALANCE] + record.balance[PENDING];
         } else {
@@ -154,10 +211,10 @@ int64_t CMPTally::getMoneyAvailable(uint32_t propertyId) const
 int64_t CMPTally::getMoneyReserved(uint32_t propertyId) const
 {
     int64_t money = 0;
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    TokenMap::const_iterator it = find(propertyId);
 
     if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
+        const BalanceRecord& record = *it;
         money += record.balance[SELLOFFER_RESERVE];
         money += record.balance[ACCEPT_RESERVE];
         money += record.balance[METADEX_RESERVE];
@@ -166,6 +223,14 @@ int64_t CMPTally::getMoneyReserved(uint32_t propertyId) const
     return money;
 }
 
+/**
+ * Returns the heap memory used by the tally.
+ */
+size_t CMPTally::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(mp_token);
+}
+
 /**
  * Compares the tally with another tally and returns true, if they are equal.
  *
@@ -180,25 +245,20 @@ bool CMPTally::operator==(const CMPTally& rhs) const
     TokenMap::const_iterator pc1 = mp_token.begin();
     TokenMap::const_iterator pc2 = rhs.mp_token.begin();
 
-    for (unsigned int i = 0; i < mp_token.size(); ++i) {
-        if (pc1->first != pc2->first) {
+    for (; pc1 != mp_token.end(); ++pc1, ++pc2) {
+        if (pc1->propertyId != pc2->propertyId) {
             return false;
         }
-        const BalanceRecord& record1 = pc1->second;
-        const BalanceRecord& record2 = pc2->second;
+        const BalanceRecord& record1 = *pc1;
+        const BalanceRecord& record2 = *pc2;
 
         for (int ttype = 0; ttype < TALLY_TYPE_COUNT; ++ttype) {
             if (record1.balance[ttype] != record2.balance[ttype]) {
                 return false;
             }
         }
-        ++pc1;
-        ++pc2;
     }
 
-    assert(pc1 == mp_token.end());
-    assert(pc2 == rhs.mp_token.end());
-
     return true;
 }
 
@@ -228,10 +288,10 @@ int64_t CMPTally::print(uint32_t propertyId, bool bDivisible) const
     int64_t pending = 0;
     int64_t metadex_reserve = 0;
 
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    TokenMap::const_iterator it = find(propertyId);
 
     if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
+        const BalanceRecord& record = *it;
         balance = record.balance[BALANCE];
         selloffer_reserve = record.balance[SELLOFFER_RESERVE];
         accept_reserve = record.balance[ACCEPT_RESERVE];
@@ -251,3 +311,639 @@ int64_t CMPTally::print(uint32_t propertyId, bool bDivisible) const
 
     return (balance + selloffer_reserve + accept_reserve + metadex_reserve);
 }
+
+const uint32_t CMPTally::NO_ROW;
+
+/**
+ * Returns the number of tokens of all rows, including reserved tokens.
+ *
+ * Each column is summed in a separate pass over a plain array, which the compiler
+ * can vectorize.
+ */
+int64_t CPropertyBalances::GetTotalTokens() const
+{
+    int64_t nTokens = 0;
+    for (const std::vector<int64_t>* column : {&balance, &sellOfferReserve, &acceptReserve, &metaDExReserve}) {
+        const int64_t* pValues = column->data();
+        const size_t nRows = column->size();
+        for (size_t row = 0; row < nRows; ++row) {
+            nTokens += pValues[row];
+        }
+    }
+    return nTokens;
+}
+
+/**
+ * Returns the number of rows with tokens, excluding rows with only pending amounts.
+ */
+int64_t CPropertyBalances::GetOwnerCount() const
+{
+    const int64_t* pBalance = balance.data();
+    const int64_t* pSellOfferReserve = sellOfferReserve.data();
+    const int64_t* pAcceptReserve = acceptReserve.data();
+    const int64_t* pMetaDExReserve = metaDExReserve.data();
+    const size_t nRows = ids.size();
+
+    int64_t nOwners = 0;
+    for (size_t row = 0; row < nRows; ++row) {
+        nOwners += (pBalance[row] + pSellOfferReserve[row] + pAcceptReserve[row] + pMetaDExReserve[row]) != 0;
+    }
+    return nOwners;
+}
+
+/**
+ * Returns the heap memory used by the columns.
+ */
+size_t CPropertyBalances::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(ids) + memusage::DynamicUsage(balance) + memusage::DynamicUsage(sellOfferReserve) +
+            memusage::DynamicUsage(acceptReserve) + memusage::DynamicUsage(metaDExReserve);
+}
+
+const uint32_t CMPTallyMap::INVALID_ID;
+
+/**
+ * Returns the identifier of an address, or INVALID_ID, if the address is unknown.
+ */
+uint32_t CMPTallyMap::GetId(const std::string& address) const
+{
+    std::unordered_map<std::string, uint32_t>::const_iterator it = m_ids.find(address);
+    if (it != m_ids.end()) {
+        return it->second;
+    }
+    return INVALID_ID;
+}
+
+/**
+ * Returns the identifier of an address, and adds an empty tally, if the address is unknown.
+ */
+uint32_t CMPTallyMap::AddAddress(const std::string& address)
+{
+    std::pair<std::unordered_map<std::string, uint32_t>::iterator, bool> result = m_ids.emplace(address, m_tallies.size());
+    if (result.second) {
+        assert(m_tallies.size() < INVALID_ID);
+        ++m_nGeneration;
+        // keys of unordered maps are never moved, so the pointer remains valid
+        m_addresses.push_back(&result.first->first);
+        m_tallies.emplace_back();
+        ++m_nEmpty;
+        for (ModifiedTracker& tracker : m_trackers) {
+            tracker.vModified.push_back(false);
+        }
+    }
+    return result.first->second;
+}
+
+/**
+ * Reserves space for a number of addresses, so restoring the state doesn't rehash the index
+ * of the addresses over and over.
+ */
+void CMPTallyMap::Reserve(size_t nAddresses)
+{
+    m_ids.reserve(nAddresses);
+    m_addresses.reserve(nAddresses);
+    for (ModifiedTracker& tracker : m_trackers) {
+        tracker.vModified.reserve(nAddresses);
+    }
+}
+
+/**
+ * Updates the number of tokens of an address, and the index of holders.
+ *
+ * @param id          The identifier of the address
+ * @param propertyId  The identifier of the tally to update
+ * @param amount      The amount to add
+ * @param ttype       The tally type
+ * @return True, if the update was successful
+ */
+bool CMPTallyMap::UpdateMoney(uint32_t id, uint32_t propertyId, int64_t amount, TallyType ttype)
+{
+    CMPTally* pTally = Get(id);
+    if (!pTally) {
+        return false;
+    }
+    int64_t nTokensBefore = pTally->getMoney(propertyId, BALANCE) + pTally->getMoneyReserved(propertyId);
+    const uint32_t row = pTally->getRow(propertyId);
+    const bool fCommit = m_fCommitment && ttype != PENDING;
+    const bool fEmptyBefore = pTally->empty();
+    if (fCommit) UpdateCommitment(id, propertyId, false);
+    bool fUpdated = pTally->updateMoney(propertyId, amount, ttype);
+    if (fCommit) UpdateCommitment(id, propertyId, true);
+    // even a failed update may drop an empty record
+    if (fEmptyBefore && !pTally->empty()) --m_nEmpty;
+    if (!fEmptyBefore && pTally->empty()) ++m_nEmpty;
+    if (!fUpdated) {
+        return false;
+    }
+    ++m_nGeneration;
+
+    for (ModifiedTracker& tracker : m_trackers) {
+        if (!tracker.vModified[id]) {
+            tracker.vModified[id] = true;
+            tracker.vIds.push_back(id);
+        }
+    }
+
+    if (m_fJournal && ttype != PENDING) {
+        m_journal.push_back(Change{id, propertyId, ttype, amount});
+    }
+
+    if (ttype != PENDING) {
+        m_modifiedProperties.insert(propertyId);
+
+        PropertyTotals& totals = m_totals[propertyId];
+        totals.nTokens += amount;
+        if (ttype != BALANCE) totals.nReserved += amount;
+        totals.nGeneration = m_nGeneration;
+
+        int64_t nTokensAfter = nTokensBefore + amount;
+        if (nTokensBefore == 0 && nTokensAfter != 0) ++totals.nOwners;
+        if (nTokensBefore != 0 && nTokensAfter == 0) --totals.nOwners;
+        UpdateRanking(id, propertyId, nTokensBefore, nTokensAfter);
+    }
+
+    bool fHolder = false;
+    for (int n = 0; n < TALLY_TYPE_COUNT && !fHolder; ++n) {
+        fHolder = pTally->getMoney(propertyId, static_cast<TallyType>(n)) != 0;
+    }
+
+    if (fHolder) {
+        // addresses are mostly added in ascending order, such as when the state is restored
+        std::set<uint32_t>& holders = m_holders[propertyId];
+        holders.insert(holders.end(), id);
+    } else {
+        std::unordered_map<uint32_t, std::set<uint32_t> >::iterator it = m_holders.find(propertyId);
+        if (it != m_holders.end()) {
+            it->second.erase(id);
+            if (it->second.empty()) m_holders.erase(it);
+        }
+    }
+    UpdateBalanceRow(id, propertyId, row);
+
+    return true;
+}
+
+/**
+ * Updates the row of an address in the balance columns of a property, after its tally was updated.
+ *
+ * A new holder is appended, and the row of an address, which no longer holds the property,
+ * is taken by the last row, so the columns remain dense.
+ */
+void CMPTallyMap::UpdateBalanceRow(uint32_t id, uint32_t propertyId, uint32_t row)
+{
+    CMPTally& tally = m_tallies[id];
+    CMPTally::TokenMap::const_iterator it = tally.find(propertyId);
+
+    if (it == tally.mp_token.end()) {
+        if (row == CMPTally::NO_ROW) return;
+        std::unordered_map<uint32_t, CPropertyBalances>::iterator itBalances = m_balances.find(propertyId);
+        assert(itBalances != m_balances.end());
+        CPropertyBalances& balances = itBalances->second;
+
+        const uint32_t last = balances.size() - 1;
+        if (row != last) {
+            balances.ids[row] = balances.ids[last];
+            balances.balance[row] = balances.balance[last];
+            balances.sellOfferReserve[row] = balances.sellOfferReserve[last];
+            balances.acceptReserve[row] = balances.acceptReserve[last];
+            balances.metaDExReserve[row] = balances.metaDExReserve[last];
+            m_tallies[balances.ids[row]].setRow(propertyId, row);
+        }
+        balances.ids.pop_back();
+        balances.balance.pop_back();
+        balances.sellOfferReserve.pop_back();
+        balances.acceptReserve.pop_back();
+        balances.metaDExReserve.pop_back();
+        if (balances.empty()) m_balances.erase(itBalances);
+        return;
+    }
+
+    CPropertyBalances& balances = m_balances[propertyId];
+    if (row == CMPTally::NO_ROW) {
+        assert(balances.size() < CMPTally::NO_ROW);
+        tally.setRow(propertyId, balances.size());
+        balances.ids.push_back(id);
+        balances.balance.push_back(it->balance[BALANCE]);
+        balances.sellOfferReserve.push_back(it->balance[SELLOFFER_RESERVE]);
+        balances.acceptReserve.push_back(it->balance[ACCEPT_RESERVE]);
+        balances.metaDExReserve.push_back(it->balance[METADEX_RESERVE]);
+    } else {
+        balances.balance[row] = it->balance[BALANCE];
+        balances.sellOfferReserve[row] = it->balance[SELLOFFER_RESERVE];
+        balances.acceptReserve[row] = it->balance[ACCEPT_RESERVE];
+        balances.metaDExReserve[row] = it->balance[METADEX_RESERVE];
+    }
+}
+
+/**
+ * Credits the available balances of a property of several addresses at once.
+ *
+ * The result is the same as calling UpdateMoney() for every credit, but the index of
+ * holders and the running totals of the property are looked up only once.
+ *
+ * @param propertyId  The property to credit
+ * @param credits     The address identifiers and the positive amounts to credit
+ * @return False, if an address is unknown, an amount is not positive, or a balance overflows,
+ *         in which case the credits up to the failed one were applied
+ */
+bool CMPTallyMap::CreditBalances(uint32_t propertyId, const std::vector<std::pair<uint32_t, int64_t> >& credits)
+{
+    std::set<uint32_t>& holders = m_holders[propertyId];
+    PropertyTotals& totals = m_totals[propertyId];
+    bool fSuccess = true;
+    bool fModified = false;
+
+    for (const std::pair<uint32_t, int64_t>& credit : credits) {
+        const uint32_t id = credit.first;
+        const int64_t amount = credit.second;
+        CMPTally* pTally = Get(id);
+        if (!pTally || amount <= 0) {
+            fSuccess = false;
+            break;
+        }
+        int64_t nTokensBefore = pTally->getMoney(propertyId, BALANCE) + pTally->getMoneyReserved(propertyId);
+        const uint32_t row = pTally->getRow(propertyId);
+        const bool fEmptyBefore = pTally->empty();
+        if (m_fCommitment) UpdateCommitment(id, propertyId, false);
+        bool fUpdated = pTally->updateMoney(propertyId, amount, BALANCE);
+        if (m_fCommitment) UpdateCommitment(id, propertyId, true);
+        if (fEmptyBefore && !pTally->empty()) --m_nEmpty;
+        if (!fEmptyBefore && pTally->empty()) ++m_nEmpty;
+        if (!fUpdated) {
+            fSuccess = false;
+            break;
+        }
+        fModified = true;
+        ++m_nGeneration;
+
+        for (ModifiedTracker& tracker : m_trackers) {
+            if (!tracker.vModified[id]) {
+                tracker.vModified[id] = true;
+                tracker.vIds.push_back(id);
+            }
+        }
+        if (m_fJournal) {
+            m_journal.push_back(Change{id, propertyId, BALANCE, amount});
+        }
+
+        // a credited address always holds tokens afterwards
+        totals.nTokens += amount;
+        totals.nGeneration = m_nGeneration;
+        if (nTokensBefore == 0) ++totals.nOwners;
+        holders.insert(holders.end(), id);
+        UpdateBalanceRow(id, propertyId, row);
+        UpdateRanking(id, propertyId, nTokensBefore, nTokensBefore + amount);
+    }
+
+    if (fModified) m_modifiedProperties.insert(propertyId);
+    if (holders.empty()) m_holders.erase(propertyId);
+
+    return fSuccess;
+}
+
+/**
+ * Returns the identifiers of the addresses with a non-zero balance of a property.
+ */
+const std::set<uint32_t>& CMPTallyMap::GetHolders(uint32_t propertyId) const
+{
+    static const std::set<uint32_t> empty;
+    std::unordered_map<uint32_t, std::set<uint32_t> >::const_iterator it = m_holders.find(propertyId);
+    if (it != m_holders.end()) {
+        return it->second;
+    }
+    return empty;
+}
+
+/**
+ * Returns the balances of the holders of a property in columns, with one row per holder.
+ */
+const CPropertyBalances& CMPTallyMap::GetBalances(uint32_t propertyId) const
+{
+    static const CPropertyBalances empty;
+    std::unordered_map<uint32_t, CPropertyBalances>::const_iterator it = m_balances.find(propertyId);
+    if (it != m_balances.end()) {
+        return it->second;
+    }
+    return empty;
+}
+
+/**
+ * Returns the number of tokens of a property held by all addresses, including reserved tokens.
+ */
+int64_t CMPTallyMap::GetTotalTokens(uint32_t propertyId) const
+{
+    std::unordered_map<uint32_t, PropertyTotals>::const_iterator it = m_totals.find(propertyId);
+    return (it != m_totals.end()) ? it->second.nTokens : 0;
+}
+
+/**
+ * Returns the number of reserved tokens of a property held by all addresses.
+ */
+int64_t CMPTallyMap::GetReservedTokens(uint32_t propertyId) const
+{
+    std::unordered_map<uint32_t, PropertyTotals>::const_iterator it = m_totals.find(propertyId);
+    return (it != m_totals.end()) ? it->second.nReserved : 0;
+}
+
+/**
+ * Returns the number of addresses, which hold tokens of a property, including reserved tokens.
+ */
+int64_t CMPTallyMap::GetOwnerCount(uint32_t propertyId) const
+{
+    std::unordered_map<uint32_t, PropertyTotals>::const_iterator it = m_totals.find(propertyId);
+    return (it != m_totals.end()) ? it->second.nOwners : 0;
+}
+
+/**
+ * Returns a counter, which changes with every modification of the balances of a property.
+ *
+ * The counter is the generation of the map at the last modification, which is never reused,
+ * even after the map was cleared.
+ */
+uint64_t CMPTallyMap::GetPropertyGeneration(uint32_t propertyId) const
+{
+    std::unordered_map<uint32_t, PropertyTotals>::const_iterator it = m_totals.find(propertyId);
+    return (it != m_totals.end()) ? it->second.nGeneration : 0;
+}
+
+//! Maximum number of properties, whose holders are ranked at the same time
+static const size_t MAX_RANKED_PROPERTIES = 32;
+
+/**
+ * Moves an address within the ranking of a property, if the property is ranked.
+ */
+void CMPTallyMap::UpdateRanking(uint32_t id, uint32_t propertyId, int64_t nTokensBefore, int64_t nTokensAfter)
+{
+    if (m_ranked.empty()) return;
+    std::unordered_map<uint32_t, std::set<std::pair<int64_t, uint32_t> > >::iterator it = m_ranked.find(propertyId);
+    if (it == m_ranked.end() || nTokensBefore == nTokensAfter) return;
+
+    if (nTokensBefore > 0) it->second.erase(std::make_pair(nTokensBefore, id));
+    if (nTokensAfter > 0) it->second.emplace(nTokensAfter, id);
+}
+
+/**
+ * Returns the holders of a property as (tokens, identifier) pairs in ascending order.
+ */
+const std::set<std::pair<int64_t, uint32_t> >& CMPTallyMap::GetRankedHolders(uint32_t propertyId)
+{
+    // the rankings are rebuilt on demand, so they are dropped, rather than growing without bound
+    if (m_ranked.size() >= MAX_RANKED_PROPERTIES && !m_ranked.count(propertyId)) {
+        m_ranked.clear();
+    }
+    std::pair<std::unordered_map<uint32_t, std::set<std::pair<int64_t, uint32_t> > >::iterator, bool> result = m_ranked.emplace(propertyId, std::set<std::pair<int64_t, uint32_t> >());
+    if (result.second) {
+        // holders with only pending amounts don't hold tokens
+        const CPropertyBalances& balances = GetBalances(propertyId);
+        for (size_t row = 0; row < balances.size(); ++row) {
+            int64_t nTokens = balances.GetTokens(row);
+            if (nTokens > 0) result.first->second.emplace(nTokens, balances.ids[row]);
+        }
+    }
+    return result.first->second;
+}
+
+/**
+ * Retrieves the identifiers of the addresses, which were modified since the last call by the consumer.
+ */
+bool CMPTallyMap::TakeModified(std::vector<uint32_t>& ids, ModifiedConsumer consumer)
+{
+    ModifiedTracker& tracker = m_trackers[consumer];
+    bool fComplete = !tracker.fCleared;
+    ids.clear();
+    ids.swap(tracker.vIds);
+    for (uint32_t id : ids) {
+        tracker.vModified[id] = false;
+    }
+    tracker.fCleared = false;
+    return fComplete;
+}
+
+/**
+ * Retrieves the changes, which were recorded since the last call.
+ */
+bool CMPTallyMap::TakeJournal(std::vector<Change>& changes)
+{
+    bool fComplete = !m_fJournalCleared;
+    changes.clear();
+    changes.swap(m_journal);
+    m_fJournalCleared = false;
+    return fComplete;
+}
+
+/**
+ * Retrieves the properties, whose balances, excluding pending amounts, were modified since the last call.
+ */
+bool CMPTallyMap::TakeModifiedProperties(std::vector<uint32_t>& propertyIds)
+{
+    bool fComplete = !m_fPropertiesCleared;
+    propertyIds.assign(m_modifiedProperties.begin(), m_modifiedProperties.end());
+    m_modifiedProperties.clear();
+    m_fPropertiesCleared = false;
+    return fComplete;
+}
+
+/**
+ * Reverts changes, which were retrieved from the journal, without recording them.
+ *
+ * The changes are reverted in reverse order, so every intermediate state was
+ * valid before, and the balance checks can't fail, unless the map was modified
+ * otherwise in the meantime.
+ */
+bool CMPTallyMap::RevertChanges(const std::vector<Change>& changes)
+{
+    bool fJournal = m_fJournal;
+    m_fJournal = false;
+    bool fSuccess = true;
+    for (std::vector<Change>::const_reverse_iterator it = changes.rbegin(); it != changes.rend() && fSuccess; ++it) {
+        fSuccess = UpdateMoney(it->id, it->propertyId, -it->amount, it->ttype);
+    }
+    m_fJournal = fJournal;
+    return fSuccess;
+}
+
+/**
+ * Adds or removes the balances of an address and property in the commitment, unless they are empty.
+ *
+ * The element consists of the address, the property identifier, and the balance and
+ * reserves, in the order of the consensus hash.
+ */
+void CMPTallyMap::UpdateCommitment(uint32_t id, uint32_t propertyId, bool fAdd)
+{
+    const CMPTally& tally = m_tallies[id];
+    int64_t balance = tally.getMoney(propertyId, BALANCE);
+    int64_t sellOfferReserve = tally.getMoney(propertyId, SELLOFFER_RESERVE);
+    int64_t acceptReserve = tally.getMoney(propertyId, ACCEPT_RESERVE);
+    int64_t metaDExReserve = tally.getMoney(propertyId, METADEX_RESERVE);
+    if (!balance && !sellOfferReserve && !acceptReserve && !metaDExReserve) return;
+
+    if (fAdd) {
+        m_commitment.Add(COMMIT_BALANCE, GetAddress(id), propertyId, balance, sellOfferReserve, acceptReserve, metaDExReserve);
+    } else {
+        m_commitment.Remove(COMMIT_BALANCE, GetAddress(id), propertyId, balance, sellOfferReserve, acceptReserve, metaDExReserve);
+    }
+}
+
+/**
+ * Returns the commitment to the balances.
+ *
+ * The commitment is built from all tallies on first use, or after the map was cleared,
+ * so loading the state doesn't pay for it. Afterwards every update costs O(1).
+ */
+const CStateCommitment& CMPTallyMap::GetCommitment()
+{
+    if (!m_fCommitment) {
+        m_commitment.SetNull();
+        for (uint32_t id = 0; id < m_tallies.size(); ++id) {
+            for (uint32_t propertyId : m_tallies[id]) {
+                UpdateCommitment(id, propertyId, true);
+            }
+        }
+        m_fCommitment = true;
+    }
+    return m_commitment;
+}
+
+/**
+ * Removes the addresses without balance records, and assigns the identifiers of the
+ * remaining addresses again, in the same order.
+ *
+ * Addresses, whose changes were recorded in the journal since the last call of
+ * TakeJournal(), are kept as well, so the journal remains complete. The columns
+ * and the index of holders are translated, and the rankings are built again on
+ * demand, while the totals and the commitment don't refer to identifiers.
+ */
+size_t CMPTallyMap::RemoveEmpty(const std::set<uint32_t>& keep, std::vector<uint32_t>& remap)
+{
+    std::vector<bool> vKeep(m_tallies.size(), false);
+    for (uint32_t id : keep) {
+        if (id < vKeep.size()) vKeep[id] = true;
+    }
+    for (const Change& change : m_journal) {
+        vKeep[change.id] = true;
+    }
+
+    remap.assign(m_tallies.size(), INVALID_ID);
+    uint32_t nNextId = 0;
+    for (uint32_t id = 0; id < m_tallies.size(); ++id) {
+        if (!m_tallies[id].empty() || vKeep[id]) remap[id] = nNextId++;
+    }
+    const size_t nRemoved = m_tallies.size() - nNextId;
+    if (nRemoved == 0) return 0;
+
+    std::vector<const std::string*> vAddresses;
+    std::deque<CMPTally> tallies;
+    vAddresses.reserve(nNextId);
+    for (uint32_t id = 0; id < m_tallies.size(); ++id) {
+        if (remap[id] == INVALID_ID) continue;
+        vAddresses.push_back(m_addresses[id]);
+        tallies.push_back(std::move(m_tallies[id]));
+    }
+    // the keys of the remaining addresses are not moved, so the pointers remain valid
+    for (std::unordered_map<std::string, uint32_t>::iterator it = m_ids.begin(); it != m_ids.end(); ) {
+        const uint32_t id = remap[it->second];
+        if (id == INVALID_ID) {
+            it = m_ids.erase(it);
+        } else {
+            it->second = id;
+            ++it;
+        }
+    }
+    m_ids.rehash(0);
+    m_addresses.swap(vAddresses);
+    m_tallies.swap(tallies);
+
+    // holders are never empty, and the order of the identifiers is preserved
+    for (auto& entry : m_holders) {
+        std::set<uint32_t> holders;
+        for (uint32_t id : entry.second) {
+            assert(remap[id] != INVALID_ID);
+            holders.insert(holders.end(), remap[id]);
+        }
+        entry.second.swap(holders);
+    }
+    for (auto& entry : m_balances) {
+        for (uint32_t& id : entry.second.ids) {
+            id = remap[id];
+        }
+    }
+    m_ranked.clear();
+
+    for (ModifiedTracker& tracker : m_trackers) {
+        std::vector<bool>(m_tallies.size(), false).swap(tracker.vModified);
+        tracker.vIds.clear();
+        tracker.fCleared = true;
+    }
+    for (Change& change : m_journal) {
+        change.id = remap[change.id];
+    }
+    m_nEmpty -= nRemoved;
+    ++m_nGeneration;
+    ++m_nClears;
+
+    return nRemoved;
+}
+
+/**
+ * Returns the approximate heap memory used by the map.
+ *
+ * The tallies are stored in blocks, so each tally is accounted for without
+ * allocation overhead.
+ */
+size_t CMPTallyMap::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(m_ids) + memusage::DynamicUsage(m_addresses);
+    for (const auto& entry : m_ids) {
+        nUsage += mastercore::StringUsage(entry.first);
+    }
+    nUsage += m_tallies.size() * sizeof(CMPTally);
+    for (const CMPTally& tally : m_tallies) {
+        nUsage += tally.DynamicMemoryUsage();
+    }
+    nUsage += memusage::DynamicUsage(m_holders);
+    for (const auto& entry : m_holders) {
+        nUsage += memusage::DynamicUsage(entry.second);
+    }
+    nUsage += memusage::DynamicUsage(m_balances);
+    for (const auto& entry : m_balances) {
+        nUsage += entry.second.DynamicMemoryUsage();
+    }
+    nUsage += memusage::DynamicUsage(m_totals);
+    nUsage += memusage::DynamicUsage(m_ranked);
+    for (const auto& entry : m_ranked) {
+        nUsage += memusage::DynamicUsage(entry.second);
+    }
+    nUsage += memusage::DynamicUsage(m_modifiedProperties);
+    for (const ModifiedTracker& tracker : m_trackers) {
+        nUsage += memusage::MallocUsage(tracker.vModified.capacity() / 8) + memusage::DynamicUsage(tracker.vIds);
+    }
+    return nUsage;
+}
+
+/**
+ * Removes all addresses and tallies.
+ */
+void CMPTallyMap::clear()
+{
+    m_ids.clear();
+    m_addresses.clear();
+    m_tallies.clear();
+    m_holders.clear();
+    m_balances.clear();
+    m_totals.clear();
+    m_ranked.clear();
+    for (ModifiedTracker& tracker : m_trackers) {
+        tracker.vModified.clear();
+        tracker.vIds.clear();
+        tracker.fCleared = true;
+    }
+    m_journal.clear();
+    m_fJournalCleared = true;
+    m_modifiedProperties.clear();
+    m_fPropertiesCleared = true;
+    m_commitment.SetNull();
+    m_fCommitment = false;
+    m_nEmpty = 0;
+    ++m_nGeneration;
+    ++m_nClears;
+}
@@ -1,8 +1,18 @@
 #ifndef BITCOIN_OMNICORE_TALLY_H
 #define BITCOIN_OMNICORE_TALLY_H
 
+#include <omnicore/statecommitment.h>
+
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <stddef.h>
 #include <stdint.h>
-#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 //! Balance record types
 enum TallyType {
@@ -19,27 +29,76 @@ enum TallyType {
 class CMPTally
 {
 private:
-    typedef struct {
+    friend class CMPTallyMap;
+
+    //! Row, which doesn't refer to any row of the balance columns
+    static const uint32_t NO_ROW = std::numeric_limits<uint32_t>::max();
+
+    struct BalanceRecord {
+        uint32_t propertyId;
+        //! Row of the address in the balance columns of the property, maintained by CMPTallyMap
+        uint32_t row;
         int64_t balance[TALLY_TYPE_COUNT];
-    } BalanceRecord;
+    };
 
-    //! Map of balance records
-    typedef std::map<uint32_t, BalanceRecord> TokenMap;
+    //! Balance records, sorted by property identifier
+    typedef std::vector<BalanceRecord> TokenMap;
     //! Balance records for different tokens
     TokenMap mp_token;
-    //! Internal iterator pointing to a balance record
-    TokenMap::iterator my_it;
+    //! Property identifier of the balance record the internal iterator points to
+    uint32_t my_propertyId;
+    //! Whether the internal iterator points past the last balance record
+    bool my_fEnd;
+
+    /** Returns the balance record of a token, or the end, if there is none. */
+    TokenMap::const_iterator find(uint32_t propertyId) const;
+
+    /** Returns the row of the balance record of a token, or NO_ROW, if there is none. */
+    uint32_t getRow(uint32_t propertyId) const;
+
+    /** Sets the row of the balance record of a token, if there is one. */
+    void setRow(uint32_t propertyId, uint32_t row);
 
 public:
+    /** Iterator over the property identifiers of the tally, in ascending order. */
+    class const_iterator
+    {
+    private:
+        TokenMap::const_iterator m_it;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef uint32_t value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const uint32_t* pointer;
+        typedef const uint32_t& reference;
+
+        explicit const_iterator(TokenMap::const_iterator it) : m_it(it) {}
+
+        reference operator*() const { return m_it->propertyId; }
+        const_iterator& operator++() { ++m_it; return *this; }
+        bool operator==(const const_iterator& other) const { return m_it == other.m_it; }
+        bool operator!=(const const_iterator& other) const { return m_it != other.m_it; }
+    };
+
     /** Creates an empty tally. */
     CMPTally();
 
-    /** Resets the internal iterator. */
+    /** Resets the internal iterator. Prefer the const iteration via begin() and end(). */
     uint32_t init();
 
-    /** Advances the internal iterator. */
+    /** Advances the internal iterator. Prefer the const iteration via begin() and end(). */
     uint32_t next();
 
+    /** Returns an iterator to the first property identifier of the tally. */
+    const_iterator begin() const { return const_iterator(mp_token.begin()); }
+
+    /** Returns an iterator past the last property identifier of the tally. */
+    const_iterator end() const { return const_iterator(mp_token.end()); }
+
+    /** Returns whether the tally has no balance records, which is the case, once all its balances are zero. */
+    bool empty() const { return mp_token.empty(); }
+
     /** Updates the number of tokens for the given tally type. */
     bool updateMoney(uint32_t propertyId, int64_t amount, TallyType ttype);
 
@@ -60,6 +119,319 @@ public:
 
     /** Prints a balance record to the console. */
     int64_t print(uint32_t propertyId = 1, bool bDivisible = true) const;
+
+    /** Returns the heap memory used by the tally. */
+    size_t DynamicMemoryUsage() const;
+};
+
+/** Balances of the holders of a property, excluding pending amounts, stored in columns.
+ *
+ * Every holder has one row, in no particular order, and the columns are contiguous,
+ * so that sums and filters over all holders run over plain arrays, rather than
+ * looking up the balance records of every address.
+ */
+struct CPropertyBalances
+{
+    //! Identifiers of the addresses
+    std::vector<uint32_t> ids;
+    //! Available balances
+    std::vector<int64_t> balance;
+    //! Tokens reserved by sell offers
+    std::vector<int64_t> sellOfferReserve;
+    //! Tokens reserved by accepts
+    std::vector<int64_t> acceptReserve;
+    //! Tokens reserved by MetaDEx orders
+    std::vector<int64_t> metaDExReserve;
+
+    /** Returns the number of rows. */
+    size_t size() const { return ids.size(); }
+
+    /** Returns whether there are no rows. */
+    bool empty() const { return ids.empty(); }
+
+    /** Returns the number of tokens of a row, including reserved tokens. */
+    int64_t GetTokens(size_t row) const { return balance[row] + sellOfferReserve[row] + acceptReserve[row] + metaDExReserve[row]; }
+
+    /** Returns the number of tokens of all rows, including reserved tokens. */
+    int64_t GetTotalTokens() const;
+
+    /** Returns the number of rows with tokens, excluding rows with only pending amounts. */
+    int64_t GetOwnerCount() const;
+
+    /** Returns the heap memory used by the columns. */
+    size_t DynamicMemoryUsage() const;
+};
+
+/** Tallies of all addresses, where addresses are interned as numeric identifiers.
+ *
+ * Identifiers are assigned in ascending order, starting at 0, and remain valid,
+ * until the map is cleared, or the addresses without balances are removed, which
+ * assigns the identifiers again. References to tallies are not invalidated, when
+ * new addresses are added.
+ *
+ * For every property an index of the addresses with a non-zero balance of any
+ * tally type is maintained, as long as balances are updated via UpdateMoney(),
+ * together with the balances of these addresses in property-major columns.
+ * Likewise the total number of tokens and the number of owners are tracked, and
+ * the commitment to the balances is updated, once it was requested.
+ */
+class CMPTallyMap
+{
+public:
+    //! Identifier, which doesn't refer to any address
+    static const uint32_t INVALID_ID = std::numeric_limits<uint32_t>::max();
+
+    /** Consumers of the modified addresses, which are tracked independently. */
+    enum ModifiedConsumer
+    {
+        MODIFIED_SNAPSHOT = 0,
+        MODIFIED_WALLET,
+        MODIFIED_PERSISTENCE,
+        MODIFIED_STATE_DELTA,
+        MODIFIED_CONSUMER_COUNT
+    };
+
+    /** A change of a balance, as recorded by the journal. */
+    struct Change
+    {
+        uint32_t id;
+        uint32_t propertyId;
+        TallyType ttype;
+        int64_t amount;
+    };
+
+    /** Iterator over (address, tally) pairs, in the order the addresses were added. */
+    class iterator
+    {
+    private:
+        CMPTallyMap* m_map;
+        uint32_t m_id;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const std::string&, CMPTally&> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef void pointer;
+        typedef value_type reference;
+
+        iterator(CMPTallyMap* map, uint32_t id) : m_map(map), m_id(id) {}
+
+        /** Returns the identifier of the current address. */
+        uint32_t id() const { return m_id; }
+
+        value_type operator*() const { return value_type(m_map->GetAddress(m_id), m_map->m_tallies[m_id]); }
+        iterator& operator++() { ++m_id; return *this; }
+        bool operator==(const iterator& other) const { return m_id == other.m_id; }
+        bool operator!=(const iterator& other) const { return m_id != other.m_id; }
+    };
+
+private:
+    //! Identifiers of the addresses
+    std::unordered_map<std::string, uint32_t> m_ids;
+    //! Addresses by identifier, pointing to the keys of m_ids
+    std::vector<const std::string*> m_addresses;
+    //! Tallies by identifier
+    std::deque<CMPTally> m_tallies;
+    //! Identifiers of the addresses with a non-zero balance, by property
+    std::unordered_map<uint32_t, std::set<uint32_t> > m_holders;
+    //! Balances of the addresses with a non-zero balance in columns, by property
+    std::unordered_map<uint32_t, CPropertyBalances> m_balances;
+
+    /**
+     * Updates the row of an address in the balance columns of a property, after its tally was updated.
+     *
+     * @param id          The identifier of the address
+     * @param propertyId  The property, whose balances were updated
+     * @param row         The row of the address before the update, or CMPTally::NO_ROW
+     */
+    void UpdateBalanceRow(uint32_t id, uint32_t propertyId, uint32_t row);
+
+    /** Running totals of a property, excluding pending amounts. */
+    struct PropertyTotals
+    {
+        //! Number of tokens, including reserved tokens
+        int64_t nTokens;
+        //! Number of reserved tokens
+        int64_t nReserved;
+        //! Number of addresses with a non-zero number of tokens
+        int64_t nOwners;
+        //! Generation of the map, when the balances of the property were last modified
+        uint64_t nGeneration;
+    };
+
+    //! Running totals by property
+    std::unordered_map<uint32_t, PropertyTotals> m_totals;
+
+    //! Holders ordered by their number of tokens, for the properties, whose ranking was requested
+    std::unordered_map<uint32_t, std::set<std::pair<int64_t, uint32_t> > > m_ranked;
+
+    /** Moves an address within the ranking of a property, if the property is ranked. */
+    void UpdateRanking(uint32_t id, uint32_t propertyId, int64_t nTokensBefore, int64_t nTokensAfter);
+
+    /** Modifications since the last call of TakeModified() by one consumer. */
+    struct ModifiedTracker
+    {
+        //! Whether an address was modified, by identifier
+        std::vector<bool> vModified;
+        //! Identifiers of the modified addresses
+        std::vector<uint32_t> vIds;
+        //! Whether the map was cleared
+        bool fCleared = true;
+    };
+
+    //! Modifications, tracked independently for every consumer
+    ModifiedTracker m_trackers[MODIFIED_CONSUMER_COUNT];
+
+    //! Whether changes, excluding pending amounts, are recorded in the journal
+    bool m_fJournal = false;
+    //! Changes recorded since the last call of TakeJournal(), in the order they were applied
+    std::vector<Change> m_journal;
+    //! Whether the map was cleared since the last call of TakeJournal()
+    bool m_fJournalCleared = true;
+
+    //! Properties with changed balances, excluding pending amounts, since the last call of TakeModifiedProperties()
+    std::set<uint32_t> m_modifiedProperties;
+    //! Whether the map was cleared since the last call of TakeModifiedProperties()
+    bool m_fPropertiesCleared = true;
+
+    //! Commitment to the non-empty balances, excluding pending amounts
+    CStateCommitment m_commitment;
+    //! Whether the commitment is up to date and maintained by UpdateMoney()
+    bool m_fCommitment = false;
+
+    /** Adds or removes the balances of an address and property in the commitment, unless they are empty. */
+    void UpdateCommitment(uint32_t id, uint32_t propertyId, bool fAdd);
+
+    //! Counter, which changes with every modification of the map
+    uint64_t m_nGeneration = 0;
+    //! Number of times the map was cleared, or the identifiers were assigned again
+    uint64_t m_nClears = 0;
+    //! Number of addresses without balance records
+    size_t m_nEmpty = 0;
+
+public:
+    /** Returns the identifier of an address, or INVALID_ID, if the address is unknown. */
+    uint32_t GetId(const std::string& address) const;
+
+    /** Returns the identifier of an address, and adds an empty tally, if the address is unknown. */
+    uint32_t AddAddress(const std::string& address);
+
+    /** Reserves space for the given number of addresses in total. */
+    void Reserve(size_t nAddresses);
+
+    /** Returns the address of an identifier. */
+    const std::string& GetAddress(uint32_t id) const { return *m_addresses[id]; }
+
+    /** Returns the tally of an identifier, or nullptr, if the identifier is unknown. */
+    CMPTally* Get(uint32_t id) { return id < m_tallies.size() ? &m_tallies[id] : nullptr; }
+    const CMPTally* Get(uint32_t id) const { return id < m_tallies.size() ? &m_tallies[id] : nullptr; }
+
+    /** Returns the tally of an address, or nullptr, if the address is unknown. */
+    CMPTally* Get(const std::string& address) { return Get(GetId(address)); }
+
+    /** Updates the number of tokens of an address, and the index of holders. */
+    bool UpdateMoney(uint32_t id, uint32_t propertyId, int64_t amount, TallyType ttype);
+
+    /** Credits the available balances of a property of several addresses at once, as by UpdateMoney(). */
+    bool CreditBalances(uint32_t propertyId, const std::vector<std::pair<uint32_t, int64_t> >& credits);
+
+    /** Returns the identifiers of the addresses with a non-zero balance of a property, in ascending order. */
+    const std::set<uint32_t>& GetHolders(uint32_t propertyId) const;
+
+    /** Returns the balances of the holders of a property in columns, with one row per holder. */
+    const CPropertyBalances& GetBalances(uint32_t propertyId) const;
+
+    /** Returns the number of tokens of a property held by all addresses, including reserved tokens. */
+    int64_t GetTotalTokens(uint32_t propertyId) const;
+
+    /** Returns the number of reserved tokens of a property held by all addresses. */
+    int64_t GetReservedTokens(uint32_t propertyId) const;
+
+    /** Returns the number of addresses, which hold tokens of a property, including reserved tokens. */
+    int64_t GetOwnerCount(uint32_t propertyId) const;
+
+    /**
+     * Returns a counter, which changes with every modification of the balances of a property,
+     * excluding pending amounts, so results derived from the balances can be cached.
+     */
+    uint64_t GetPropertyGeneration(uint32_t propertyId) const;
+
+    /**
+     * Returns the holders of a property as (tokens, identifier) pairs in ascending order, where
+     * the tokens include reserved tokens.
+     *
+     * The ranking is built from the holders on first use, and then maintained by every update
+     * of the property, so it's meant for a few properties, which are queried frequently.
+     */
+    const std::set<std::pair<int64_t, uint32_t> >& GetRankedHolders(uint32_t propertyId);
+
+    /**
+     * Retrieves the identifiers of the addresses, which were modified since the last call by the consumer.
+     *
+     * @param ids[out]  The identifiers of the modified addresses
+     * @param consumer  The consumer, for which the modifications are tracked
+     * @return False, if the map was cleared in the meantime, in which case all addresses are to be considered as modified
+     */
+    bool TakeModified(std::vector<uint32_t>& ids, ModifiedConsumer consumer);
+
+    /** Enables or disables recording changes, excluding pending amounts, in the journal. */
+    void SetJournal(bool fEnabled) { m_fJournal = fEnabled; }
+
+    /**
+     * Retrieves the changes, which were recorded since the last call.
+     *
+     * @param changes[out]  The changes, in the order they were applied
+     * @return False, if the map was cleared in the meantime, in which case the changes can't be reverted
+     */
+    bool TakeJournal(std::vector<Change>& changes);
+
+    /** Reverts changes, which were retrieved from the journal, without recording them. */
+    bool RevertChanges(const std::vector<Change>& changes);
+
+    /**
+     * Retrieves the properties, whose balances, excluding pending amounts, were modified since the last call.
+     *
+     * @param propertyIds[out]  The identifiers of the modified properties, in ascending order
+     * @return False, if the map was cleared in the meantime, in which case all properties are to be considered as modified
+     */
+    bool TakeModifiedProperties(std::vector<uint32_t>& propertyIds);
+
+    /** Returns the commitment to the balances, which is built on first use and then maintained incrementally. */
+    const CStateCommitment& GetCommitment();
+
+    /** Returns a counter, which changes with every modification of the map, so scans can detect concurrent modifications. */
+    uint64_t GetGeneration() const { return m_nGeneration; }
+
+    /** Returns the number of times the map was cleared or compacted, after which identifiers may refer to other addresses. */
+    uint64_t GetClearCount() const { return m_nClears; }
+
+    /** Returns the number of addresses without balance records, which can be removed. */
+    size_t GetEmptyCount() const { return m_nEmpty; }
+
+    /**
+     * Removes the addresses without balance records, and assigns the identifiers of the
+     * remaining addresses again, in the same order.
+     *
+     * The changes in the journal are translated, while the consumers of the modified
+     * addresses observe the removal like a clear.
+     *
+     * @param keep[in]    Identifiers of addresses, which are kept, even if they are empty
+     * @param remap[out]  The new identifier by the old one, or INVALID_ID, if the address was removed
+     * @return The number of removed addresses
+     */
+    size_t RemoveEmpty(const std::set<uint32_t>& keep, std::vector<uint32_t>& remap);
+
+    /** Returns the number of addresses. */
+    size_t size() const { return m_tallies.size(); }
+
+    /** Removes all addresses and tallies. */
+    void clear();
+
+    /** Returns the approximate heap memory used by the map. */
+    size_t DynamicMemoryUsage() const;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_tallies.size()); }
 };
 
 
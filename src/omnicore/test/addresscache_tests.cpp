@@ -0,0 +1,58 @@
+#include <omnicore/addresscache.h>
+
+#include <chainparams.h>
+#include <key_io.h>
+#include <script/standard.h>
+#include <uint256.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_addresscache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(address_cache_encode)
+{
+    COmniAddressCache cache(2);
+
+    const CTxDestination destA = PKHash(uint160(std::vector<unsigned char>(20, 0x01)));
+    const CTxDestination destB = ScriptHash(uint160(std::vector<unsigned char>(20, 0x01)));
+    const CTxDestination destC = WitnessV0ScriptHash(uint256S("02"));
+
+    BOOST_CHECK_EQUAL(cache.Encode(destA), EncodeDestination(destA));
+    BOOST_CHECK_EQUAL(cache.Encode(destA), EncodeDestination(destA));
+    BOOST_CHECK_EQUAL(cache.GetHits(), 1U);
+    BOOST_CHECK_EQUAL(cache.GetMisses(), 1U);
+
+    // the same hash with another type is another address
+    BOOST_CHECK_EQUAL(cache.Encode(destB), EncodeDestination(destB));
+    BOOST_CHECK_EQUAL(cache.GetMisses(), 2U);
+
+    // the least recently used address is evicted
+    BOOST_CHECK_EQUAL(cache.Encode(destC), EncodeDestination(destC));
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+    BOOST_CHECK_EQUAL(cache.Encode(destA), EncodeDestination(destA));
+    BOOST_CHECK_EQUAL(cache.GetMisses(), 4U);
+
+    // destinations without address aren't cached
+    BOOST_CHECK_EQUAL(cache.Encode(CNoDestination()), "");
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(address_cache_network)
+{
+    COmniAddressCache cache;
+    const CTxDestination dest = PKHash(uint160(std::vector<unsigned char>(20, 0x01)));
+
+    const std::string strMain = cache.Encode(dest);
+    SelectParams(CBaseChainParams::REGTEST);
+    BOOST_CHECK_EQUAL(cache.Encode(dest), EncodeDestination(dest));
+    BOOST_CHECK(cache.Encode(dest) != strMain);
+    SelectParams(CBaseChainParams::MAIN);
+    BOOST_CHECK_EQUAL(cache.Encode(dest), strMain);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
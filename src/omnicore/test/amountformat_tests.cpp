@@ -0,0 +1,56 @@
+#include <omnicore/amountformat.h>
+#include <omnicore/omnicore.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <limits>
+#include <string>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_amountformat_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(format_indivisible)
+{
+    BOOST_CHECK_EQUAL(FormatIndivisibleMP(0), "0");
+    BOOST_CHECK_EQUAL(FormatIndivisibleMP(7), "7");
+    BOOST_CHECK_EQUAL(FormatIndivisibleMP(-150), "-150");
+    BOOST_CHECK_EQUAL(FormatIndivisibleMP(std::numeric_limits<int64_t>::max()), "9223372036854775807");
+    BOOST_CHECK_EQUAL(FormatIndivisibleMP(std::numeric_limits<int64_t>::min()), "-9223372036854775808");
+}
+
+BOOST_AUTO_TEST_CASE(format_divisible)
+{
+    BOOST_CHECK_EQUAL(FormatDivisibleMP(0), "0.00000000");
+    BOOST_CHECK_EQUAL(FormatDivisibleMP(1), "0.00000001");
+    BOOST_CHECK_EQUAL(FormatDivisibleMP(150000000), "1.50000000");
+    BOOST_CHECK_EQUAL(FormatDivisibleMP(-150000000), "1.50000000");
+    BOOST_CHECK_EQUAL(FormatDivisibleMP(-150000000, true), "-1.50000000");
+    BOOST_CHECK_EQUAL(FormatDivisibleMP(0, true), "+0.00000000");
+    BOOST_CHECK_EQUAL(FormatDivisibleMP(std::numeric_limits<int64_t>::max(), true), "+92233720368.54775807");
+    BOOST_CHECK_EQUAL(FormatDivisibleMP(std::numeric_limits<int64_t>::min()), "ErrorAmount");
+}
+
+BOOST_AUTO_TEST_CASE(format_divisible_short)
+{
+    BOOST_CHECK_EQUAL(FormatDivisibleShortMP(0), "0");
+    BOOST_CHECK_EQUAL(FormatDivisibleShortMP(1), "0.00000001");
+    BOOST_CHECK_EQUAL(FormatDivisibleShortMP(150000000), "1.5");
+    BOOST_CHECK_EQUAL(FormatDivisibleShortMP(10000000000), "100");
+    BOOST_CHECK_EQUAL(FormatDivisibleShortMP(-12345678900), "123.456789");
+    BOOST_CHECK_EQUAL(FormatDivisibleShortMP(std::numeric_limits<int64_t>::min()), "ErrorAmount");
+}
+
+BOOST_AUTO_TEST_CASE(format_into_buffer)
+{
+    char buf[AMOUNT_BUFFER_SIZE];
+    BOOST_CHECK_EQUAL(FormatDivisibleAmount(buf, 250000000), 10U);
+    BOOST_CHECK_EQUAL(std::string(buf), "2.50000000");
+    BOOST_CHECK_EQUAL(FormatIndivisibleAmount(buf, -42), 3U);
+    BOOST_CHECK_EQUAL(std::string(buf), "-42");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
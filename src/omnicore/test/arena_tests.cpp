@@ -0,0 +1,75 @@
+#include <omnicore/arena.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <functional>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_arena_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(arena_rewind)
+{
+    CArena arena;
+
+    void* p1 = arena.Allocate(10, 1);
+    void* p2 = arena.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(p2) % 8, 0U);
+    BOOST_CHECK_EQUAL(arena.GetLiveAllocations(), 2U);
+    BOOST_CHECK_EQUAL(arena.GetChunks(), 1U);
+
+    arena.Deallocate(p1, 10);
+    arena.Deallocate(p2, 8);
+    BOOST_CHECK_EQUAL(arena.GetLiveAllocations(), 0U);
+
+    // the arena is rewound, once there are no live allocations
+    BOOST_CHECK(arena.Allocate(10, 1) == p1);
+}
+
+BOOST_AUTO_TEST_CASE(arena_chunks)
+{
+    CArena arena;
+
+    // allocations, which exceed a chunk, get their own chunk, which isn't kept
+    void* pLarge = arena.Allocate(ARENA_CHUNK_SIZE * 2, 16);
+    void* pSmall = arena.Allocate(ARENA_CHUNK_SIZE / 2, 16);
+    void* pSecond = arena.Allocate(ARENA_CHUNK_SIZE / 2 + 1, 16);
+    BOOST_CHECK_EQUAL(arena.GetChunks(), 3U);
+
+    arena.Deallocate(pLarge, ARENA_CHUNK_SIZE * 2);
+    arena.Deallocate(pSmall, ARENA_CHUNK_SIZE / 2);
+    arena.Deallocate(pSecond, ARENA_CHUNK_SIZE / 2 + 1);
+    BOOST_CHECK_EQUAL(arena.GetChunks(), 2U);
+
+    arena.Release();
+    BOOST_CHECK_EQUAL(arena.GetChunks(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(arena_containers)
+{
+    CArena& arena = GetBlockArena();
+    {
+        ArenaVector<int64_t> vValues;
+        std::map<std::string, int64_t, std::less<std::string>, ArenaAllocator<std::pair<const std::string, int64_t>>> mapSums;
+        for (int n = 0; n < 1000; ++n) {
+            vValues.push_back(n);
+            mapSums[std::to_string(n % 10)] += n;
+        }
+        BOOST_CHECK_EQUAL(vValues.size(), 1000U);
+        BOOST_CHECK_EQUAL(mapSums.size(), 10U);
+        BOOST_CHECK_EQUAL(mapSums["9"], 50400);
+        BOOST_CHECK(arena.GetLiveAllocations() > 0);
+    }
+    BOOST_CHECK_EQUAL(arena.GetLiveAllocations(), 0U);
+
+    ReleaseBlockArena();
+    BOOST_CHECK(arena.GetChunks() <= 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
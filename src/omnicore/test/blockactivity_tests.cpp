@@ -0,0 +1,94 @@
+#include <omnicore/blockactivity.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+using namespace mastercore;
+
+namespace {
+struct BlockActivityTestingSetup : BasicTestingSetup
+{
+    BlockActivityTestingSetup()
+    {
+        LOCK(cs_tally);
+        ClearBlockActivity();
+    }
+
+    ~BlockActivityTestingSetup()
+    {
+        LOCK(cs_tally);
+        ClearBlockActivity();
+    }
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_blockactivity_tests, BlockActivityTestingSetup)
+
+BOOST_AUTO_TEST_CASE(skip_untouched_blocks)
+{
+    LOCK(cs_tally);
+    BeginBlockActivity(10, uint256S("09"), 9, uint256S("aa"), 100);
+    EndBlockActivity(10, uint256S("0a"), uint256S("bb"));
+
+    BeginBlockActivity(11, uint256S("0a"), 10, uint256S("bb"), 105);
+    EndBlockActivity(11, uint256S("0b"), uint256S("bb"));
+
+    BeginBlockActivity(12, uint256S("0b"), 11, uint256S("bb"), 110);
+    EndBlockActivity(12, uint256S("0c"), uint256S("bb"));
+
+    int64_t nExodusPrev = -1;
+    // the fork block doesn't match
+    BOOST_CHECK(!SkipUntouchedBlocks(11, uint256S("ff"), nExodusPrev));
+    // block 10 changed the state
+    BOOST_CHECK(!SkipUntouchedBlocks(10, uint256S("09"), nExodusPrev));
+    BOOST_CHECK_EQUAL(nExodusPrev, -1);
+
+    BOOST_CHECK(SkipUntouchedBlocks(12, uint256S("0b"), nExodusPrev));
+    BOOST_CHECK_EQUAL(nExodusPrev, 110);
+    BOOST_CHECK(SkipUntouchedBlocks(11, uint256S("0a"), nExodusPrev));
+    BOOST_CHECK_EQUAL(nExodusPrev, 105);
+
+    // nothing left to skip, but the state refers to the fork block
+    nExodusPrev = -1;
+    BOOST_CHECK(SkipUntouchedBlocks(11, uint256S("0a"), nExodusPrev));
+    BOOST_CHECK_EQUAL(nExodusPrev, -1);
+    BOOST_CHECK(!SkipUntouchedBlocks(11, uint256S("ff"), nExodusPrev));
+}
+
+BOOST_AUTO_TEST_CASE(marked_blocks)
+{
+    LOCK(cs_tally);
+    BeginBlockActivity(10, uint256S("09"), 9, uint256S("aa"), 0);
+    EndBlockActivity(10, uint256S("0a"), uint256S("aa"));
+
+    BeginBlockActivity(11, uint256S("0a"), 10, uint256S("aa"), 0);
+    MarkBlockTouched();
+    EndBlockActivity(11, uint256S("0b"), uint256S("aa"));
+
+    int64_t nExodusPrev = -1;
+    BOOST_CHECK(!SkipUntouchedBlocks(10, uint256S("09"), nExodusPrev));
+    BOOST_CHECK(!SkipUntouchedBlocks(11, uint256S("0a"), nExodusPrev));
+
+    // a block, which doesn't follow the last one, starts over
+    BeginBlockActivity(11, uint256S("fa"), 10, uint256S("aa"), 0);
+    EndBlockActivity(11, uint256S("fb"), uint256S("aa"));
+    BOOST_CHECK(!SkipUntouchedBlocks(10, uint256S("09"), nExodusPrev));
+    BOOST_CHECK(SkipUntouchedBlocks(11, uint256S("fa"), nExodusPrev));
+
+    // blocks far away from the tip are not tracked
+    BeginBlockActivity(12, uint256S("fb"), 12 + MAX_BLOCK_ACTIVITY, uint256S("aa"), 0);
+    EndBlockActivity(12, uint256S("fc"), uint256S("aa"));
+    BOOST_CHECK(!SkipUntouchedBlocks(12, uint256S("fb"), nExodusPrev));
+
+    // an incomplete block can't be skipped
+    BeginBlockActivity(10, uint256S("09"), 9, uint256S("aa"), 0);
+    BOOST_CHECK(!SkipUntouchedBlocks(10, uint256S("09"), nExodusPrev));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
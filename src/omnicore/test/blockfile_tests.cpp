@@ -0,0 +1,88 @@
+#include <omnicore/blockfile.h>
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <flatfile.h>
+#include <fs.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <validation.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <stdio.h>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_blockfile_tests, BasicTestingSetup)
+
+/** Appends a block with its header to a block file, and returns its position. */
+static FlatFilePos AppendBlock(const FlatFilePos& filePos, const CBlock& block)
+{
+    fs::path path = GetBlockPosFilename(filePos);
+    fs::create_directories(path.parent_path());
+    CAutoFile file(fsbridge::fopen(path, "ab"), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!file.IsNull());
+
+    file << Params().MessageStart() << (uint32_t) GetSerializeSize(block, CLIENT_VERSION);
+    const long nPos = ftell(file.Get());
+    file << block;
+
+    return FlatFilePos(filePos.nFile, nPos);
+}
+
+BOOST_AUTO_TEST_CASE(blockfile_mapped_read)
+{
+    const CBlock& genesis = Params().GenesisBlock();
+    const FlatFilePos filePos(9999, 0);
+
+    FlatFilePos pos = AppendBlock(filePos, genesis);
+    BOOST_CHECK_EQUAL(pos.nPos, 8U);
+
+    CBlock block;
+    BOOST_CHECK(ReadBlockMapped(block, pos, Params().GetConsensus()));
+    BOOST_CHECK_EQUAL(block.GetHash(), genesis.GetHash());
+    BOOST_CHECK_EQUAL(block.vtx.size(), genesis.vtx.size());
+
+    // the block file grows, after it was mapped
+    FlatFilePos posNext = AppendBlock(filePos, genesis);
+    BOOST_CHECK(posNext.nPos > pos.nPos);
+    CBlock blockNext;
+    BOOST_CHECK(ReadBlockMapped(blockNext, posNext, Params().GetConsensus()));
+    BOOST_CHECK_EQUAL(blockNext.GetHash(), genesis.GetHash());
+
+    // positions without a block can't be read
+    CBlock blockMissing;
+    BOOST_CHECK(!ReadBlockMapped(blockMissing, FlatFilePos(9999, posNext.nPos + 80), Params().GetConsensus()));
+    BOOST_CHECK(!ReadBlockMapped(blockMissing, FlatFilePos(9998, 8), Params().GetConsensus()));
+
+    ReleaseMappedBlockFiles();
+}
+
+BOOST_AUTO_TEST_CASE(blockfile_mapping)
+{
+    const fs::path path = GetDataDir() / "blockfile_mapping.dat";
+    FILE* file = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(file);
+    for (int n = 0; n < 10000; ++n) {
+        fputc(n & 0xff, file);
+    }
+    fclose(file);
+
+    CMappedBlockFile mapped(path);
+#ifndef WIN32
+    BOOST_CHECK(mapped.IsMapped());
+    BOOST_CHECK_EQUAL(mapped.size(), 10000U);
+    BOOST_CHECK_EQUAL(mapped.data()[0], 0);
+    BOOST_CHECK_EQUAL(mapped.data()[9999], 9999 & 0xff);
+    mapped.WillNeed(5000, 100);
+    mapped.WillNeed(20000, 100);
+#endif
+
+    BOOST_CHECK(!CMappedBlockFile(GetDataDir() / "blockfile_missing.dat").IsMapped());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,4 +1,5 @@
 #include <omnicore/consensushash.h>
+#include <omnicore/dbspinfo.h>
 #include <omnicore/dex.h>
 #include <omnicore/mdex.h>
 #include <omnicore/sp.h>
@@ -7,14 +8,17 @@
 #include <omnicore/tally.h>
 
 #include <arith_uint256.h>
+#include <crypto/sha256.h>
 #include <sync.h>
 #include <test/util/setup_common.h>
 #include <uint256.h>
+#include <util/system.h>
 
 #include <boost/test/unit_test.hpp>
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 namespace mastercore
 {
@@ -98,6 +102,136 @@ BOOST_AUTO_TEST_CASE(consensus_string_property_issuer)
             GenerateConsensusString(5, "3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b"));
 }
 
+BOOST_AUTO_TEST_CASE(streamed_hashes)
+{
+    LOCK(cs_tally);
+    mp_tally_map.clear();
+    MetaDEx_CLEAR();
+
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", 3, 7000, BALANCE));
+    BOOST_CHECK(update_tally_map("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 3, 500, METADEX_RESERVE));
+    BOOST_CHECK(update_tally_map("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 4, 20, BALANCE));
+
+    // the balances are streamed into the hasher, sorted by address, as the consensus strings would be
+    std::string data = GenerateConsensusString(*mp_tally_map.Get("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj"), "1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 3) +
+            GenerateConsensusString(*mp_tally_map.Get("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b"), "3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", 3);
+    uint256 expected;
+    CSHA256().Write(reinterpret_cast<const unsigned char*>(data.data()), data.size()).Finalize(expected.begin());
+    BOOST_CHECK(GetBalancesHash(3) == expected);
+
+    // the orders are streamed into the hasher, sorted by txid
+    const CMPMetaDEx orderA("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 100, 3, 300, 1, 100, uint256S("0b"), 1, 1);
+    const CMPMetaDEx orderB("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 101, 3, 200, 1, 50, uint256S("0a"), 1, 1);
+    BOOST_CHECK(MetaDEx_INSERT(orderA));
+    BOOST_CHECK(MetaDEx_INSERT(orderB));
+    data = GenerateConsensusString(orderB) + GenerateConsensusString(orderA);
+    CSHA256().Write(reinterpret_cast<const unsigned char*>(data.data()), data.size()).Finalize(expected.begin());
+    BOOST_CHECK(GetMetaDExHash() == expected);
+    BOOST_CHECK(GetMetaDExHash(3) == expected);
+    BOOST_CHECK(GetMetaDExHash(4) != expected);
+
+    mp_tally_map.clear();
+    MetaDEx_CLEAR();
+}
+
+BOOST_AUTO_TEST_CASE(cached_hashes)
+{
+    LOCK(cs_tally);
+    mp_tally_map.clear();
+    MetaDEx_CLEAR();
+
+    const std::string address = "1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj";
+    const uint256 emptyBalances = GetBalancesHash(3);
+    const uint256 emptyOrders = GetMetaDExHash(3);
+
+    // the cached hashes are discarded, when the balances or orders of the property change
+    BOOST_CHECK(update_tally_map(address, 3, 500, BALANCE));
+    std::string data = GenerateConsensusString(*mp_tally_map.Get(address), address, 3);
+    uint256 expected;
+    CSHA256().Write(reinterpret_cast<const unsigned char*>(data.data()), data.size()).Finalize(expected.begin());
+    BOOST_CHECK(GetBalancesHash(3) == expected);
+    BOOST_CHECK(GetBalancesHash(4) == emptyBalances);
+
+    BOOST_CHECK(update_tally_map(address, 3, -300, BALANCE));
+    BOOST_CHECK(update_tally_map(address, 3, 300, METADEX_RESERVE));
+    const CMPMetaDEx order(address, 100, 3, 300, 1, 100, uint256S("0a"), 1, 1);
+    BOOST_CHECK(MetaDEx_INSERT(order));
+    BOOST_CHECK(GetBalancesHash(3) != expected);
+    data = GenerateConsensusString(order);
+    CSHA256().Write(reinterpret_cast<const unsigned char*>(data.data()), data.size()).Finalize(expected.begin());
+    BOOST_CHECK(GetMetaDExHash(3) == expected);
+    BOOST_CHECK(GetMetaDExHash() == expected);
+    BOOST_CHECK(GetMetaDExHash(4) == emptyOrders);
+
+    // pending amounts are not part of the balances hash
+    const uint256 balancesHash = GetBalancesHash(3);
+    BOOST_CHECK(update_tally_map(address, 3, 50, PENDING));
+    BOOST_CHECK(GetBalancesHash(3) == balancesHash);
+
+    // ... and clearing the state discards all hashes
+    mp_tally_map.clear();
+    MetaDEx_CLEAR();
+    BOOST_CHECK(GetBalancesHash(3) == emptyBalances);
+    BOOST_CHECK(GetMetaDExHash(3) == emptyOrders);
+    BOOST_CHECK(GetMetaDExHash() == emptyOrders);
+}
+
+BOOST_AUTO_TEST_CASE(sectioned_hashes)
+{
+    LOCK(cs_tally);
+    pDbSpInfo = new CMPSPInfo(GetDataDir() / "MP_spinfo_sections", true);
+    mp_tally_map.clear();
+    MetaDEx_CLEAR();
+
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", 3, 7000, BALANCE));
+    BOOST_CHECK(update_tally_map("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 3, 500, METADEX_RESERVE));
+    const CMPMetaDEx order("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 100, 3, 500, 1, 100, uint256S("0a"), 1, 1);
+    BOOST_CHECK(MetaDEx_INSERT(order));
+
+    std::vector<std::string> vData(SECTION_COUNT);
+    vData[SECTION_BALANCES] = GenerateConsensusString(*mp_tally_map.Get("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj"), "1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 3) +
+            GenerateConsensusString(*mp_tally_map.Get("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b"), "3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", 3);
+    vData[SECTION_METADEX_ORDERS] = GenerateConsensusString(order);
+    for (uint32_t propertyId = 1; propertyId < pDbSpInfo->peekNextSPID(1); ++propertyId) {
+        CMPSPInfo::Entry sp;
+        BOOST_CHECK(pDbSpInfo->getSP(propertyId, sp));
+        vData[SECTION_PROPERTIES] += GenerateConsensusString(propertyId, sp.issuer);
+    }
+
+    // every section is hashed on its own with the same data as the consensus hash
+    std::vector<uint256> vDigests;
+    uint256 combinedHash = GetConsensusHashSections(vDigests);
+    BOOST_CHECK_EQUAL(vDigests.size(), (size_t) SECTION_COUNT);
+
+    CSHA256 combined;
+    CSHA256 legacy;
+    for (int section = 0; section < SECTION_COUNT; ++section) {
+        const std::string& data = vData[section];
+        uint256 expected;
+        CSHA256().Write(reinterpret_cast<const unsigned char*>(data.data()), data.size()).Finalize(expected.begin());
+        BOOST_CHECK_MESSAGE(vDigests[section] == expected, GetConsensusHashSectionName(static_cast<ConsensusHashSection>(section)));
+        combined.Write(expected.begin(), expected.size());
+        legacy.Write(reinterpret_cast<const unsigned char*>(data.data()), data.size());
+    }
+
+    // the digests are combined in the order of the sections
+    uint256 expected;
+    combined.Finalize(expected.begin());
+    BOOST_CHECK(combinedHash == expected);
+
+    // the consensus hash is unchanged and covers the same data at once
+    legacy.Finalize(expected.begin());
+    BOOST_CHECK(GetConsensusHash() == expected);
+
+    // ... as does the hash obtained in chunks
+    BOOST_CHECK(GetConsensusHashYielding() == expected);
+
+    mp_tally_map.clear();
+    MetaDEx_CLEAR();
+    delete pDbSpInfo;
+    pDbSpInfo = nullptr;
+}
+
 BOOST_AUTO_TEST_CASE(get_checkpoints)
 {
     // There are consensus checkpoints for mainnet:
@@ -0,0 +1,65 @@
+#include <omnicore/sp.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using mastercore::CMPCrowdMap;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_crowdsale_expiry_tests, BasicTestingSetup)
+
+/** Creates a crowdsale of a property with the given deadline. */
+static CMPCrowd MakeCrowd(uint32_t propertyId, int64_t deadline)
+{
+    return CMPCrowd(propertyId, 100, 1, deadline, 10, 5, 0, 0);
+}
+
+BOOST_AUTO_TEST_CASE(expired_by_deadline)
+{
+    CMPCrowdMap crowds;
+    crowds.insert(std::make_pair("c", MakeCrowd(3, 1000)));
+    crowds.insert(std::make_pair("a", MakeCrowd(4, 2000)));
+    crowds.insert(std::make_pair("b", MakeCrowd(5, 1000)));
+
+    // the deadline itself is still open
+    BOOST_CHECK(crowds.GetExpired(1000).empty());
+
+    std::vector<std::string> vExpired = crowds.GetExpired(1001);
+    BOOST_CHECK_EQUAL(vExpired.size(), 2U);
+    BOOST_CHECK_EQUAL(vExpired[0], "b");
+    BOOST_CHECK_EQUAL(vExpired[1], "c");
+
+    // a crowdsale, which was closed or maxed out before, is no longer reported
+    crowds.erase(crowds.find("b"));
+    BOOST_CHECK_EQUAL(crowds.GetExpired(1001).size(), 1U);
+
+    vExpired = crowds.GetExpired(2001);
+    BOOST_CHECK_EQUAL(vExpired.size(), 2U);
+    BOOST_CHECK_EQUAL(vExpired[0], "a");
+    BOOST_CHECK_EQUAL(vExpired[1], "c");
+}
+
+BOOST_AUTO_TEST_CASE(copy_and_clear)
+{
+    CMPCrowdMap crowds;
+    crowds.insert(std::make_pair("a", MakeCrowd(3, 1000)));
+
+    CMPCrowdMap copy = crowds;
+    BOOST_CHECK(copy == crowds);
+    BOOST_CHECK_EQUAL(copy.GetExpired(1001).size(), 1U);
+
+    // a second crowdsale of the same issuer isn't added
+    BOOST_CHECK(!copy.insert(std::make_pair("a", MakeCrowd(4, 500))).second);
+    BOOST_CHECK(copy.GetExpired(1000).empty());
+
+    copy.clear();
+    BOOST_CHECK(copy.empty());
+    BOOST_CHECK(copy.GetExpired(1001).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,120 @@
+#include <omnicore/dbaddressfilter.h>
+
+#include <arith_uint256.h>
+#include <blockfilter.h>
+#include <chain.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbaddressfilter_tests, BasicTestingSetup)
+
+namespace {
+/** Creates a chain of linked block index entries with unique hashes. */
+class TestChain
+{
+public:
+    std::vector<uint256> hashes;
+    std::vector<CBlockIndex> blocks;
+
+    TestChain(int nBlocks, uint32_t nSalt) : hashes(nBlocks), blocks(nBlocks)
+    {
+        for (int n = 0; n < nBlocks; ++n) {
+            hashes[n] = ArithToUint256(arith_uint256(n + 1) | (arith_uint256(nSalt) << 128));
+            blocks[n].nHeight = n;
+            blocks[n].phashBlock = &hashes[n];
+            blocks[n].pprev = (n > 0) ? &blocks[n - 1] : nullptr;
+        }
+    }
+};
+
+GCSFilter::Element ToElement(const std::string& address)
+{
+    return GCSFilter::Element(address.begin(), address.end());
+}
+}
+
+BOOST_AUTO_TEST_CASE(addressfilter_match)
+{
+    COmniAddressFilterIndex db(GetDataDir() / "OMNI_addressfilter", true);
+    TestChain chain(3, 1);
+
+    db.AddAddress("1CdighsfdfRcj4ytQSskZgQXbUEamuMUNF");
+    db.AddAddress("3MbYQMMmSkC3AgWkj9FMo5LsPTW1zBTwXL");
+    db.AddAddress("1CdighsfdfRcj4ytQSskZgQXbUEamuMUNF");
+    db.RecordBlock(&chain.blocks[0]);
+    db.RecordBlock(&chain.blocks[1]);
+
+    GCSFilter filter;
+    BOOST_CHECK(db.GetFilter(chain.hashes[0], filter));
+    BOOST_CHECK_EQUAL(filter.GetN(), 2U);
+    BOOST_CHECK(filter.Match(ToElement("1CdighsfdfRcj4ytQSskZgQXbUEamuMUNF")));
+    BOOST_CHECK(filter.Match(ToElement("3MbYQMMmSkC3AgWkj9FMo5LsPTW1zBTwXL")));
+    BOOST_CHECK(!filter.Match(ToElement("1MCHESTptvd2LnNp7wmr2sGTpRomteAkq8")));
+
+    // blocks without addresses are not stored, but covered by the range
+    BOOST_CHECK(!db.GetFilter(chain.hashes[1], filter));
+    int nFirstHeight = -1;
+    uint256 hashLast;
+    BOOST_CHECK(db.GetRecordedRange(nFirstHeight, hashLast));
+    BOOST_CHECK_EQUAL(nFirstHeight, 0);
+    BOOST_CHECK(hashLast == chain.hashes[1]);
+}
+
+BOOST_AUTO_TEST_CASE(addressfilter_range)
+{
+    COmniAddressFilterIndex db(GetDataDir() / "OMNI_addressfilter", true);
+    TestChain chain(10, 1);
+    int nFirstHeight = -1;
+    uint256 hashLast;
+
+    BOOST_CHECK(!db.GetRecordedRange(nFirstHeight, hashLast));
+
+    for (int n = 2; n < 5; ++n) {
+        db.RecordBlock(&chain.blocks[n]);
+    }
+    BOOST_CHECK(db.GetRecordedRange(nFirstHeight, hashLast));
+    BOOST_CHECK_EQUAL(nFirstHeight, 2);
+
+    // a reorganization continues the range
+    TestChain fork(10, 2);
+    db.RecordBlock(&fork.blocks[3]);
+    BOOST_CHECK(db.GetRecordedRange(nFirstHeight, hashLast));
+    BOOST_CHECK_EQUAL(nFirstHeight, 2);
+    BOOST_CHECK(hashLast == fork.hashes[3]);
+
+    // a gap starts the range over
+    db.RecordBlock(&chain.blocks[7]);
+    BOOST_CHECK(db.GetRecordedRange(nFirstHeight, hashLast));
+    BOOST_CHECK_EQUAL(nFirstHeight, 7);
+}
+
+BOOST_AUTO_TEST_CASE(addressfilter_persisted)
+{
+    TestChain chain(2, 1);
+    {
+        COmniAddressFilterIndex db(GetDataDir() / "OMNI_addressfilter", true);
+        db.AddAddress("1CdighsfdfRcj4ytQSskZgQXbUEamuMUNF");
+        db.RecordBlock(&chain.blocks[0]);
+        db.RecordBlock(&chain.blocks[1]);
+    }
+
+    COmniAddressFilterIndex db(GetDataDir() / "OMNI_addressfilter", false);
+    GCSFilter filter;
+    BOOST_CHECK(db.GetFilter(chain.hashes[0], filter));
+    BOOST_CHECK(filter.Match(ToElement("1CdighsfdfRcj4ytQSskZgQXbUEamuMUNF")));
+
+    int nFirstHeight = -1;
+    uint256 hashLast;
+    BOOST_CHECK(db.GetRecordedRange(nFirstHeight, hashLast));
+    BOOST_CHECK_EQUAL(nFirstHeight, 0);
+    BOOST_CHECK(hashLast == chain.hashes[1]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,137 @@
+#include <omnicore/dbaddressindex.h>
+#include <omnicore/indexproperties.h>
+
+#include <arith_uint256.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+#include <set>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbaddressindex_tests, BasicTestingSetup)
+
+static const size_t NO_LIMIT = std::numeric_limits<size_t>::max();
+
+BOOST_AUTO_TEST_CASE(addressindex_record)
+{
+    COmniAddressIndex db(GetDataDir() / "OMNI_addressindex", true);
+    const uint256 txid1 = ArithToUint256(arith_uint256(1));
+    const uint256 txid2 = ArithToUint256(arith_uint256(2));
+
+    // addresses outside of blocks and transactions are not recorded
+    db.RecordAddress("1A", ADDRESS_ROLE_SENDER);
+    db.BeginBlock(100);
+    db.RecordAddress("1A", ADDRESS_ROLE_SENDER);
+
+    db.SetTransaction(4, txid2);
+    db.RecordAddress("1B", ADDRESS_ROLE_SENDER);
+    db.RecordAddress("1A", ADDRESS_ROLE_TRADE_COUNTERPARTY);
+    db.RecordAddress("1A", ADDRESS_ROLE_TRADE_COUNTERPARTY);
+    db.RecordAddress("", ADDRESS_ROLE_RECEIVER);
+    db.SetTransaction(1, txid1);
+    db.RecordAddress("1A", ADDRESS_ROLE_SENDER);
+    db.RecordAddress("1A", ADDRESS_ROLE_RECEIVER);
+    db.SetTransaction(-1, uint256());
+    db.EndBlock();
+
+    // ordered by the position in the chain, and recorded once per role
+    std::vector<CAddressTxEntry> entries;
+    std::string nextCursor;
+    BOOST_CHECK(db.GetTransactions("1A", "", NO_LIMIT, entries, nextCursor));
+    BOOST_CHECK(nextCursor.empty());
+    BOOST_CHECK_EQUAL(entries.size(), 3U);
+    BOOST_CHECK_EQUAL(entries[0].nBlock, 100);
+    BOOST_CHECK_EQUAL(entries[0].nIdx, 1);
+    BOOST_CHECK(entries[0].txid == txid1);
+    BOOST_CHECK_EQUAL(entries[0].role, ADDRESS_ROLE_SENDER);
+    BOOST_CHECK_EQUAL(entries[1].role, ADDRESS_ROLE_RECEIVER);
+    BOOST_CHECK_EQUAL(entries[2].nIdx, 4);
+    BOOST_CHECK(entries[2].txid == txid2);
+    BOOST_CHECK_EQUAL(entries[2].role, ADDRESS_ROLE_TRADE_COUNTERPARTY);
+
+    entries.clear();
+    BOOST_CHECK(db.GetTransactions("1C", "", NO_LIMIT, entries, nextCursor));
+    BOOST_CHECK(entries.empty());
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_pages)
+{
+    COmniAddressIndex db(GetDataDir() / "OMNI_addressindex", true);
+    for (int nBlock = 1; nBlock <= 3; ++nBlock) {
+        db.BeginBlock(nBlock);
+        db.SetTransaction(0, ArithToUint256(arith_uint256(nBlock)));
+        db.RecordAddress("1A", ADDRESS_ROLE_STO_RECIPIENT);
+        db.EndBlock();
+    }
+
+    std::vector<CAddressTxEntry> entries;
+    std::string nextCursor;
+    BOOST_CHECK(db.GetTransactions("1A", "", 2, entries, nextCursor));
+    BOOST_CHECK_EQUAL(entries.size(), 2U);
+    BOOST_CHECK(!nextCursor.empty());
+    const std::string cursor = nextCursor;
+    entries.clear();
+    BOOST_CHECK(db.GetTransactions("1A", cursor, 2, entries, nextCursor));
+    BOOST_CHECK_EQUAL(entries.size(), 1U);
+    BOOST_CHECK_EQUAL(entries[0].nBlock, 3);
+    BOOST_CHECK(nextCursor.empty());
+
+    // a malformed cursor is rejected
+    BOOST_CHECK(!db.GetTransactions("1A", "xyz", 2, entries, nextCursor));
+    BOOST_CHECK(!db.GetTransactions("1A", "00", 2, entries, nextCursor));
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_rollback)
+{
+    COmniAddressIndex db(GetDataDir() / "OMNI_addressindex", true);
+    for (int nBlock = 1; nBlock <= 3; ++nBlock) {
+        db.BeginBlock(nBlock);
+        db.SetTransaction(0, ArithToUint256(arith_uint256(nBlock)));
+        db.RecordAddress("1A", ADDRESS_ROLE_SENDER);
+        db.EndBlock();
+    }
+
+    db.DeleteAboveBlock(2);
+
+    std::vector<CAddressTxEntry> entries;
+    std::string nextCursor;
+    BOOST_CHECK(db.GetTransactions("1A", "", NO_LIMIT, entries, nextCursor));
+    BOOST_CHECK_EQUAL(entries.size(), 1U);
+    BOOST_CHECK_EQUAL(entries[0].nBlock, 1);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_indexed_properties)
+{
+    COmniAddressIndex db(GetDataDir() / "OMNI_addressindex_properties", true);
+    mastercore::SetIndexProperties(std::set<uint32_t>{31});
+
+    // only transactions touching an indexed property are recorded
+    db.BeginBlock(100);
+    db.SetTransaction(1, ArithToUint256(arith_uint256(1)));
+    db.RecordAddress("1A", ADDRESS_ROLE_SENDER);
+    db.MarkProperty(3);
+    db.SetTransaction(2, ArithToUint256(arith_uint256(2)));
+    db.RecordAddress("1A", ADDRESS_ROLE_SENDER);
+    db.MarkProperty(3);
+    db.MarkProperty(31);
+    db.SetTransaction(3, ArithToUint256(arith_uint256(3)));
+    db.RecordAddress("1A", ADDRESS_ROLE_RECEIVER);
+    db.SetTransaction(-1, uint256());
+    db.EndBlock();
+    mastercore::SetIndexProperties(std::set<uint32_t>());
+
+    std::vector<CAddressTxEntry> entries;
+    std::string nextCursor;
+    BOOST_CHECK(db.GetTransactions("1A", "", NO_LIMIT, entries, nextCursor));
+    BOOST_REQUIRE_EQUAL(entries.size(), 1U);
+    BOOST_CHECK_EQUAL(entries[0].nIdx, 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,114 @@
+#include <omnicore/dbbalancechanges.h>
+
+#include <omnicore/tally.h>
+
+#include <arith_uint256.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbbalancechanges_tests, BasicTestingSetup)
+
+static const size_t NO_LIMIT = std::numeric_limits<size_t>::max();
+
+BOOST_AUTO_TEST_CASE(balancechanges_record)
+{
+    COmniBalanceChangeIndex db(GetDataDir() / "OMNI_balancechanges", true);
+    const uint256 txid = ArithToUint256(arith_uint256(7));
+
+    // changes outside of blocks are not recorded
+    db.RecordChange("1A", 1, BALANCE, 5, 5);
+
+    db.BeginBlock(100);
+    db.SetTransaction(3, txid);
+    db.RecordChange("1A", 1, BALANCE, -40, 60);
+    db.RecordChange("1B", 1, BALANCE, 40, 40);
+    db.RecordChange("1A", 1, PENDING, -10, -10);
+    db.SetTransaction(-1, uint256());
+    db.RecordChange("1A", 1, SELLOFFER_RESERVE, 20, 20);
+    db.EndBlock();
+
+    std::vector<CBalanceChangeEntry> entries;
+    std::string nextCursor;
+    BOOST_CHECK(db.GetChanges("1A", 1, "", NO_LIMIT, entries, nextCursor));
+    BOOST_CHECK(nextCursor.empty());
+    BOOST_CHECK_EQUAL(entries.size(), 2U);
+    BOOST_CHECK_EQUAL(entries[0].nBlock, 100);
+    BOOST_CHECK_EQUAL(entries[0].nIdx, 3);
+    BOOST_CHECK(entries[0].txid == txid);
+    BOOST_CHECK_EQUAL(entries[0].ttype, BALANCE);
+    BOOST_CHECK_EQUAL(entries[0].nAmount, -40);
+    BOOST_CHECK_EQUAL(entries[0].nBalance, 60);
+    BOOST_CHECK_EQUAL(entries[1].nIdx, -1);
+    BOOST_CHECK(entries[1].txid.IsNull());
+    BOOST_CHECK_EQUAL(entries[1].ttype, SELLOFFER_RESERVE);
+
+    entries.clear();
+    BOOST_CHECK(db.GetChanges("1C", 0, "", NO_LIMIT, entries, nextCursor));
+    BOOST_CHECK(entries.empty());
+}
+
+BOOST_AUTO_TEST_CASE(balancechanges_pages)
+{
+    COmniBalanceChangeIndex db(GetDataDir() / "OMNI_balancechanges", true);
+    for (int nBlock = 1; nBlock <= 3; ++nBlock) {
+        db.BeginBlock(nBlock);
+        db.RecordChange("1A", 2, BALANCE, nBlock, nBlock * 10);
+        db.RecordChange("1A", 1, BALANCE, nBlock, nBlock * 10);
+        db.EndBlock();
+    }
+
+    // ordered by property, then by block
+    std::vector<CBalanceChangeEntry> entries;
+    std::string nextCursor;
+    BOOST_CHECK(db.GetChanges("1A", 0, "", NO_LIMIT, entries, nextCursor));
+    BOOST_CHECK_EQUAL(entries.size(), 6U);
+    BOOST_CHECK_EQUAL(entries[0].propertyId, 1U);
+    BOOST_CHECK_EQUAL(entries[2].nBlock, 3);
+    BOOST_CHECK_EQUAL(entries[3].propertyId, 2U);
+    BOOST_CHECK_EQUAL(entries[3].nBlock, 1);
+
+    entries.clear();
+    BOOST_CHECK(db.GetChanges("1A", 2, "", 2, entries, nextCursor));
+    BOOST_CHECK_EQUAL(entries.size(), 2U);
+    BOOST_CHECK(!nextCursor.empty());
+    const std::string cursor = nextCursor;
+    entries.clear();
+    BOOST_CHECK(db.GetChanges("1A", 2, cursor, 2, entries, nextCursor));
+    BOOST_CHECK_EQUAL(entries.size(), 1U);
+    BOOST_CHECK_EQUAL(entries[0].nBlock, 3);
+    BOOST_CHECK(nextCursor.empty());
+
+    // a cursor of another property, or a malformed one, is rejected
+    BOOST_CHECK(!db.GetChanges("1A", 1, cursor, 2, entries, nextCursor));
+    BOOST_CHECK(!db.GetChanges("1A", 0, "xyz", 2, entries, nextCursor));
+}
+
+BOOST_AUTO_TEST_CASE(balancechanges_rollback)
+{
+    COmniBalanceChangeIndex db(GetDataDir() / "OMNI_balancechanges", true);
+    for (int nBlock = 1; nBlock <= 3; ++nBlock) {
+        db.BeginBlock(nBlock);
+        db.RecordChange("1A", 1, BALANCE, 1, nBlock);
+        db.EndBlock();
+    }
+
+    db.DeleteAboveBlock(2);
+
+    std::vector<CBalanceChangeEntry> entries;
+    std::string nextCursor;
+    BOOST_CHECK(db.GetChanges("1A", 1, "", NO_LIMIT, entries, nextCursor));
+    BOOST_CHECK_EQUAL(entries.size(), 1U);
+    BOOST_CHECK_EQUAL(entries[0].nBlock, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,131 @@
+#include <omnicore/dbbalancehistory.h>
+
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbbalancehistory_tests, BasicTestingSetup)
+
+static CBalanceHistoryEntry Entry(const std::string& address, uint32_t propertyId, int64_t nBalance, int64_t nReserved = 0)
+{
+    CBalanceHistoryEntry entry;
+    entry.address = address;
+    entry.propertyId = propertyId;
+    entry.nBalance = nBalance;
+    entry.nReserved = nReserved;
+    return entry;
+}
+
+static int64_t Balance(const COmniBalanceHistory& db, const std::string& address, uint32_t propertyId, int nHeight)
+{
+    CBalanceHistoryEntry entry;
+    db.GetBalance(address, propertyId, nHeight, entry);
+    return entry.nBalance;
+}
+
+BOOST_AUTO_TEST_CASE(balancehistory_at_height)
+{
+    COmniBalanceHistory db(GetDataDir() / "OMNI_balancehistory", true);
+    BOOST_CHECK(db.IsEmpty());
+
+    // the first block is the snapshot of all balances
+    db.RecordBlock(10, {Entry("1A", 1, 100), Entry("1B", 1, 50, 5), Entry("1A", 3, 7)});
+    BOOST_CHECK(!db.IsEmpty());
+    db.RecordBlock(11, {Entry("1A", 1, 60), Entry("1C", 1, 40)});
+    db.RecordBlock(12, {});
+    db.RecordBlock(13, {Entry("1A", 1, 0)});
+
+    int nFirstHeight = 0;
+    int nLastHeight = 0;
+    BOOST_CHECK(db.GetRecordedRange(nFirstHeight, nLastHeight));
+    BOOST_CHECK_EQUAL(nFirstHeight, 10);
+    BOOST_CHECK_EQUAL(nLastHeight, 13);
+
+    BOOST_CHECK_EQUAL(Balance(db, "1A", 1, 10), 100);
+    BOOST_CHECK_EQUAL(Balance(db, "1A", 1, 11), 60);
+    BOOST_CHECK_EQUAL(Balance(db, "1A", 1, 12), 60);
+    BOOST_CHECK_EQUAL(Balance(db, "1A", 1, 13), 0);
+    BOOST_CHECK_EQUAL(Balance(db, "1A", 3, 13), 7);
+    BOOST_CHECK_EQUAL(Balance(db, "1C", 1, 10), 0);
+    BOOST_CHECK_EQUAL(Balance(db, "1C", 1, 12), 40);
+
+    CBalanceHistoryEntry entry;
+    BOOST_CHECK(db.GetBalance("1B", 1, 13, entry));
+    BOOST_CHECK_EQUAL(entry.nBalance, 50);
+    BOOST_CHECK_EQUAL(entry.nReserved, 5);
+    BOOST_CHECK(!db.GetBalance("1D", 1, 13, entry));
+    BOOST_CHECK_EQUAL(entry.nBalance, 0);
+}
+
+BOOST_AUTO_TEST_CASE(balancehistory_property_pages)
+{
+    COmniBalanceHistory db(GetDataDir() / "OMNI_balancehistory", true);
+    db.RecordBlock(1, {Entry("1A", 1, 1), Entry("1B", 1, 2), Entry("1C", 2, 3)});
+    db.RecordBlock(2, {Entry("1A", 1, 0), Entry("1D", 1, 4), Entry("1B", 1, 5)});
+
+    const size_t nNoLimit = std::numeric_limits<size_t>::max();
+    std::vector<CBalanceHistoryEntry> entries;
+    BOOST_CHECK(!db.GetBalances(1, 1, "", nNoLimit, entries));
+    BOOST_CHECK_EQUAL(entries.size(), 2U);
+    BOOST_CHECK_EQUAL(entries[0].address, "1A");
+    BOOST_CHECK_EQUAL(entries[1].address, "1B");
+    BOOST_CHECK_EQUAL(entries[1].nBalance, 2);
+
+    // empty balances are skipped
+    entries.clear();
+    BOOST_CHECK(!db.GetBalances(1, 2, "", nNoLimit, entries));
+    BOOST_CHECK_EQUAL(entries.size(), 2U);
+    BOOST_CHECK_EQUAL(entries[0].address, "1B");
+    BOOST_CHECK_EQUAL(entries[0].nBalance, 5);
+    BOOST_CHECK_EQUAL(entries[1].address, "1D");
+
+    // pages start after the address of the cursor
+    entries.clear();
+    BOOST_CHECK(db.GetBalances(1, 2, "", 1, entries));
+    BOOST_CHECK_EQUAL(entries.size(), 1U);
+    BOOST_CHECK_EQUAL(entries[0].address, "1B");
+    entries.clear();
+    BOOST_CHECK(!db.GetBalances(1, 2, "1B", 1, entries));
+    BOOST_CHECK_EQUAL(entries.size(), 1U);
+    BOOST_CHECK_EQUAL(entries[0].address, "1D");
+
+    entries.clear();
+    BOOST_CHECK(!db.GetBalances(3, 2, "", nNoLimit, entries));
+    BOOST_CHECK(entries.empty());
+}
+
+BOOST_AUTO_TEST_CASE(balancehistory_rollback)
+{
+    COmniBalanceHistory db(GetDataDir() / "OMNI_balancehistory", true);
+    db.RecordBlock(5, {Entry("1A", 1, 10)});
+    db.RecordBlock(6, {Entry("1A", 1, 20)});
+    db.RecordBlock(7, {Entry("1A", 1, 30)});
+
+    db.DeleteAboveBlock(6);
+    int nFirstHeight = 0;
+    int nLastHeight = 0;
+    BOOST_CHECK(db.GetRecordedRange(nFirstHeight, nLastHeight));
+    BOOST_CHECK_EQUAL(nFirstHeight, 5);
+    BOOST_CHECK_EQUAL(nLastHeight, 5);
+    BOOST_CHECK_EQUAL(Balance(db, "1A", 1, 7), 10);
+
+    // the blocks of the new chain replace the disconnected ones
+    db.RecordBlock(6, {Entry("1A", 1, 15)});
+    BOOST_CHECK_EQUAL(Balance(db, "1A", 1, 6), 15);
+
+    // without the snapshot the history starts over
+    db.DeleteAboveBlock(5);
+    BOOST_CHECK(db.IsEmpty());
+    BOOST_CHECK(!db.GetRecordedRange(nFirstHeight, nLastHeight));
+    BOOST_CHECK_EQUAL(Balance(db, "1A", 1, 6), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
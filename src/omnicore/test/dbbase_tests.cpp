@@ -0,0 +1,491 @@
+#include <omnicore/dbbase.h>
+
+#include <tinyformat.h>
+#include <util/system.h>
+#include <util/time.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <leveldb/db.h>
+#include <leveldb/iterator.h>
+#include <leveldb/write_batch.h>
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbbase_tests, BasicTestingSetup)
+
+namespace {
+/** Exposes the underlying database for testing. */
+class TestDB : public CDBBase
+{
+public:
+    using CDBBase::NewIterator;
+    using CDBBase::ScheduleCompaction;
+    using CDBBase::NewSnapshotIterator;
+    using CDBBase::SnapshotGet;
+    using CDBBase::EnableReadCache;
+    using CDBBase::CachedGet;
+    using CDBBase::Close;
+
+    explicit TestDB(const fs::path& path)
+    {
+        leveldb::Status status = Open(path, true);
+        assert(status.ok());
+    }
+
+    void Put(const std::string& key, const std::string& value)
+    {
+        assert(pdb->Put(writeoptions, key, value).ok());
+    }
+
+    void Delete(const std::string& key)
+    {
+        assert(pdb->Delete(writeoptions, key).ok());
+    }
+
+    bool Get(const std::string& key, std::string& value)
+    {
+        return pdb->Get(readoptions, key, &value).ok();
+    }
+
+    /** Reads a value and the keys of the database, as of a snapshot taken before. */
+    std::string ReadSnapshot(const leveldb::Snapshot* snapshot, const std::string& key)
+    {
+        leveldb::ReadOptions options = readoptions;
+        options.snapshot = snapshot;
+        std::string strResult;
+        if (!pdb->Get(options, key, &strResult).ok()) strResult = "-";
+        leveldb::Iterator* it = pdb->NewIterator(options);
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            strResult += it->key().ToString();
+        }
+        delete it;
+        return strResult;
+    }
+
+    const leveldb::Snapshot* GetSnapshot() { return pdb->GetSnapshot(); }
+    void ReleaseSnapshot(const leveldb::Snapshot* snapshot) { pdb->ReleaseSnapshot(snapshot); }
+
+    std::string Forward(const std::string& start = "")
+    {
+        std::string strKeys;
+        leveldb::Iterator* it = NewIterator();
+        for (start.empty() ? it->SeekToFirst() : it->Seek(start); it->Valid(); it->Next()) {
+            strKeys += it->key().ToString() + it->value().ToString();
+        }
+        delete it;
+        return strKeys;
+    }
+
+    std::string Backward()
+    {
+        std::string strKeys;
+        leveldb::Iterator* it = NewIterator();
+        for (it->SeekToLast(); it->Valid(); it->Prev()) {
+            strKeys += it->key().ToString() + it->value().ToString();
+        }
+        delete it;
+        return strKeys;
+    }
+
+    void PutInBlock(int block, const std::string& key, const std::string& value)
+    {
+        leveldb::WriteBatch batch;
+        batch.Put(key, value);
+        LogWrittenKey(batch, block, key);
+        assert(pdb->Write(writeoptions, &batch).ok());
+    }
+
+    /** Deletes the keys written in or above the block. */
+    std::string RollBack(int block)
+    {
+        std::string strKeys;
+        leveldb::WriteBatch batch;
+        for (const std::string& key : GetKeysWrittenAbove(block, batch)) {
+            batch.Delete(key);
+            strKeys += key;
+        }
+        assert(pdb->Write(writeoptions, &batch).ok());
+        return strKeys;
+    }
+
+    void Reopen(const fs::path& path)
+    {
+        Close();
+        assert(Open(path).ok());
+    }
+};
+}
+
+BOOST_AUTO_TEST_CASE(undo_log_roll_back)
+{
+    TestDB db(GetDataDir() / "OMNI_testdb");
+    db.PutInBlock(100, "a", "1");
+    db.PutInBlock(101, "b", "2");
+    db.PutInBlock(101, "c", "3");
+    db.PutInBlock(300, "d", "4");
+    db.PutInBlock(300, "b", "5");
+
+    BOOST_CHECK_EQUAL(db.RollBack(101), "bcd");
+    std::string value;
+    BOOST_CHECK(db.Get("a", value));
+    BOOST_CHECK(!db.Get("b", value));
+    BOOST_CHECK(!db.Get("d", value));
+    BOOST_CHECK_EQUAL(db.RollBack(101), "");
+    BOOST_CHECK_EQUAL(db.RollBack(0), "a");
+    BOOST_CHECK_EQUAL(db.Forward(), "");
+}
+
+BOOST_AUTO_TEST_CASE(undo_log_prune)
+{
+    TestDB db(GetDataDir() / "OMNI_testdb");
+    db.PutInBlock(100, "a", "1");
+    db.PutInBlock(100, "b", "2");
+    db.PutInBlock(101, "c", "3");
+    db.PutInBlock(102, "d", "4");
+
+    BOOST_CHECK_EQUAL(db.PruneUndoLog(102, 1), 1U);
+    BOOST_CHECK_EQUAL(db.PruneUndoLog(102, 10), 2U);
+    BOOST_CHECK_EQUAL(db.PruneUndoLog(102, 10), 0U);
+
+    // only the keys of the remaining entries are rolled back, the others are kept
+    BOOST_CHECK_EQUAL(db.RollBack(0), "d");
+    BOOST_CHECK_EQUAL(db.Forward(), "a1b2c3");
+}
+
+BOOST_AUTO_TEST_CASE(batch_read_own_writes)
+{
+    TestDB db(GetDataDir() / "OMNI_testdb");
+    db.Put("a", "1");
+    db.Put("c", "3");
+    db.Put("e", "5");
+
+    db.BeginBatch();
+    db.Put("b", "2");
+    db.Put("c", "4");
+    db.Delete("e");
+    db.Put("f", "6");
+
+    std::string value;
+    BOOST_CHECK(db.Get("c", value));
+    BOOST_CHECK_EQUAL(value, "4");
+    BOOST_CHECK(!db.Get("e", value));
+    BOOST_CHECK_EQUAL(db.Forward(), "a1b2c4f6");
+    BOOST_CHECK_EQUAL(db.Forward("c"), "c4f6");
+    BOOST_CHECK_EQUAL(db.Forward("d"), "f6");
+    BOOST_CHECK_EQUAL(db.Backward(), "f6c4b2a1");
+
+    BOOST_CHECK(db.CommitBatch().ok());
+    BOOST_CHECK_EQUAL(db.Forward(), "a1b2c4f6");
+    BOOST_CHECK_EQUAL(db.Backward(), "f6c4b2a1");
+}
+
+BOOST_AUTO_TEST_CASE(batch_deleted_entries)
+{
+    TestDB db(GetDataDir() / "OMNI_testdb");
+    db.Put("a", "1");
+    db.Put("b", "2");
+
+    db.BeginBatch();
+    db.Delete("a");
+    db.Delete("b");
+    db.Delete("x");
+    BOOST_CHECK_EQUAL(db.Forward(), "");
+    BOOST_CHECK_EQUAL(db.Backward(), "");
+
+    db.Put("b", "3");
+    BOOST_CHECK_EQUAL(db.Forward(), "b3");
+    BOOST_CHECK_EQUAL(db.Backward(), "b3");
+
+    db.Clear();
+    BOOST_CHECK_EQUAL(db.Forward(), "");
+    BOOST_CHECK(db.CommitBatch().ok());
+    BOOST_CHECK_EQUAL(db.Forward(), "");
+}
+
+BOOST_AUTO_TEST_CASE(batch_iterator_snapshot)
+{
+    TestDB db(GetDataDir() / "OMNI_testdb");
+    db.BeginBatch();
+    db.Put("a", "1");
+    db.Put("c", "3");
+
+    leveldb::Iterator* it = db.NewIterator();
+    db.Put("b", "2");
+    std::string strKeys;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        strKeys += it->key().ToString();
+    }
+    delete it;
+    BOOST_CHECK_EQUAL(strKeys, "ac");
+    BOOST_CHECK_EQUAL(db.Forward(), "a1b2c3");
+}
+
+BOOST_AUTO_TEST_CASE(batch_not_in_snapshot)
+{
+    TestDB db(GetDataDir() / "OMNI_testdb");
+    db.Put("a", "1");
+    const leveldb::Snapshot* snapshot = db.GetSnapshot();
+
+    db.BeginBatch();
+    db.Put("a", "2");
+    db.Put("b", "3");
+    BOOST_CHECK_EQUAL(db.ReadSnapshot(snapshot, "a"), "1a");
+    BOOST_CHECK_EQUAL(db.ReadSnapshot(snapshot, "b"), "-a");
+    BOOST_CHECK_EQUAL(db.Forward(), "a2b3");
+
+    BOOST_CHECK(db.CommitBatch().ok());
+    BOOST_CHECK_EQUAL(db.ReadSnapshot(snapshot, "a"), "1a");
+    db.ReleaseSnapshot(snapshot);
+}
+
+BOOST_AUTO_TEST_CASE(published_snapshot)
+{
+    TestDB db(GetDataDir() / "OMNI_testdb");
+    db.Put("a", "1");
+    db.PublishSnapshot();
+
+    // neither buffered writes, nor writes committed after publishing are visible
+    db.BeginBatch();
+    db.Put("b", "2");
+    leveldb::Iterator* it = db.NewSnapshotIterator();
+    BOOST_CHECK(db.CommitBatch().ok());
+    db.Put("c", "3");
+    std::string strKeys;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        strKeys += it->key().ToString();
+    }
+    BOOST_CHECK_EQUAL(strKeys, "a");
+
+    // the iterator retains its snapshot, after the next one was published
+    db.PublishSnapshot();
+    strKeys.clear();
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        strKeys += it->key().ToString();
+    }
+    delete it;
+    BOOST_CHECK_EQUAL(strKeys, "a");
+
+    std::string value;
+    BOOST_CHECK(db.SnapshotGet("c", &value).ok());
+    BOOST_CHECK_EQUAL(value, "3");
+    db.Delete("c");
+    BOOST_CHECK(db.SnapshotGet("c", &value).ok());
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_outlives_close)
+{
+    const fs::path path = GetDataDir() / "OMNI_testdb";
+    TestDB db(path);
+    db.Put("a", "1");
+    db.PublishSnapshot();
+    std::shared_ptr<const leveldb::Snapshot> snapshot = db.GetPublishedSnapshot();
+    leveldb::Iterator* it = db.NewSnapshotIterator();
+
+    // the database is closed, once the reader released its snapshot and iterator
+    std::atomic<bool> fClosed{false};
+    std::thread closer([&db, &fClosed] {
+        db.Close();
+        fClosed = true;
+    });
+    UninterruptibleSleep(std::chrono::milliseconds{50});
+    BOOST_CHECK(!fClosed);
+    std::string strKeys;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        strKeys += it->key().ToString();
+    }
+    delete it;
+    BOOST_CHECK_EQUAL(strKeys, "a");
+    snapshot.reset();
+    closer.join();
+    BOOST_CHECK(fClosed);
+
+    db.Reopen(path);
+    BOOST_CHECK_EQUAL(db.Forward(), "a1");
+}
+
+BOOST_AUTO_TEST_CASE(batch_flushed_on_close)
+{
+    const fs::path path = GetDataDir() / "OMNI_testdb";
+    TestDB db(path);
+    db.BeginBatch();
+    db.Put("a", "1");
+    db.Reopen(path);
+    BOOST_CHECK_EQUAL(db.Forward(), "a1");
+}
+
+BOOST_AUTO_TEST_CASE(bulk_load_mode)
+{
+    TestDB db(GetDataDir() / "OMNI_testdb");
+    db.Put("a", "1");
+    BOOST_CHECK(db.SetBulkLoad(true).ok());
+    BOOST_CHECK_EQUAL(db.Forward(), "a1");
+
+    // the batch is committed, when leaving the mode
+    db.BeginBatch();
+    db.Put("b", "2");
+    db.Delete("a");
+    BOOST_CHECK(db.SetBulkLoad(false).ok());
+    BOOST_CHECK_EQUAL(db.Forward(), "b2");
+    std::string value;
+    BOOST_CHECK(db.SnapshotGet("b", &value).ok());
+}
+
+BOOST_AUTO_TEST_CASE(background_compaction)
+{
+    TestDB db(GetDataDir() / "OMNI_testdb");
+    db.Put("a", "1");
+    db.Put("b", "2");
+    BOOST_CHECK(!db.HasPendingCompaction());
+
+    leveldb::WriteBatch batch;
+    batch.Delete("a");
+    batch.Put("c", "3");
+    db.ScheduleCompaction(batch);
+    BOOST_CHECK(db.HasPendingCompaction());
+
+    // databases, which are writing a block, are skipped
+    db.BeginBatch();
+    CDBBase::RunPendingCompactions();
+    BOOST_CHECK(db.HasPendingCompaction());
+    BOOST_CHECK(db.CommitBatch().ok());
+    CDBBase::RunPendingCompactions();
+    BOOST_CHECK(!db.HasPendingCompaction());
+    BOOST_CHECK_EQUAL(db.Forward(), "a1b2");
+
+    std::string value;
+    BOOST_CHECK(db.GetProperty("leveldb.stats", value));
+    BOOST_CHECK(!db.GetProperty("leveldb.unknown", value));
+    BOOST_CHECK_EQUAL(db.GetName(), "OMNI_testdb");
+}
+
+BOOST_AUTO_TEST_CASE(shared_cache_and_filters)
+{
+    ConfigureDBOptions(1024 * 1024, 10, true);
+    {
+        const fs::path path = GetDataDir() / "OMNI_testdb";
+        TestDB db(path);
+        for (int i = 0; i < 1000; ++i) {
+            db.Put(strprintf("key%04d", i), std::string(100, 'x'));
+        }
+        // reopening moves the entries into tables, which are read through the cache and filters
+        db.Reopen(path);
+        std::string value;
+        BOOST_CHECK(db.Get("key0500", value));
+        BOOST_CHECK_EQUAL(value, std::string(100, 'x'));
+        BOOST_CHECK(db.Get("key0500", value));
+        BOOST_CHECK(!db.Get("key5000", value));
+    }
+    ConfigureDBOptions(0, 0, false);
+}
+
+BOOST_AUTO_TEST_CASE(unified_stores)
+{
+    const fs::path path = GetDataDir() / "OMNI_unified";
+    BOOST_CHECK(OpenUnifiedDB(path).ok());
+    {
+        TestDB a(path / "a");
+        TestDB b(path / "b");
+        a.Put("x", "1");
+        a.Put("y", "2");
+        b.Put("x", "3");
+        BOOST_CHECK_EQUAL(a.Forward(), "x1y2");
+        BOOST_CHECK_EQUAL(a.Backward(), "y2x1");
+        BOOST_CHECK_EQUAL(b.Forward(), "x3");
+        BOOST_CHECK_EQUAL(b.Backward(), "x3");
+
+        // the batches of both stores are written together
+        a.BeginBatch();
+        b.BeginBatch();
+        a.Delete("x");
+        b.Put("z", "4");
+        BOOST_CHECK(CDBBase::CommitBatches({&a, &b}).ok());
+        BOOST_CHECK_EQUAL(a.Forward(), "y2");
+        BOOST_CHECK_EQUAL(b.Forward(), "x3z4");
+
+        // wiping a store leaves the other one intact
+        a.Reopen(path / "a");
+        TestDB c(path / "b");
+        BOOST_CHECK_EQUAL(c.Forward(), "");
+        BOOST_CHECK_EQUAL(a.Forward(), "y2");
+    }
+    CloseUnifiedDB();
+}
+
+BOOST_AUTO_TEST_CASE(read_cache)
+{
+    TestDB db(GetDataDir() / "OMNI_testdb");
+    db.EnableReadCache(2);
+    db.Put("a", EncodeDBValue(int64_t(1)));
+
+    // the decoded value is read once, and then served by the cache
+    int64_t value = 0;
+    BOOST_CHECK(db.CachedGet("a", value).ok());
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_CHECK(db.CachedGet("a", value).ok());
+    BOOST_CHECK_EQUAL(db.GetReadCount(), 1U);
+    BOOST_CHECK_EQUAL(db.GetCacheHits(), 1U);
+    BOOST_CHECK_EQUAL(db.GetCacheMisses(), 1U);
+
+    // writes invalidate the cached values, also of keys, which were not found
+    db.Put("a", EncodeDBValue(int64_t(2)));
+    BOOST_CHECK(db.CachedGet("a", value).ok());
+    BOOST_CHECK_EQUAL(value, 2);
+    BOOST_CHECK(db.CachedGet("b", value).IsNotFound());
+    BOOST_CHECK(db.CachedGet("b", value).IsNotFound());
+    db.Put("b", EncodeDBValue(int64_t(3)));
+    BOOST_CHECK(db.CachedGet("b", value).ok());
+    BOOST_CHECK_EQUAL(value, 3);
+
+    // ... and the cache reflects the active batch
+    db.BeginBatch();
+    db.Delete("a");
+    BOOST_CHECK(db.CachedGet("a", value).IsNotFound());
+    BOOST_CHECK(db.CommitBatch().ok());
+    BOOST_CHECK(db.CachedGet("a", value).IsNotFound());
+
+    // values, which can't be decoded, are not cached, and the least recently used values are evicted
+    db.Put("c", "invalid");
+    BOOST_CHECK(db.CachedGet("c", value).IsCorruption());
+    BOOST_CHECK(db.CachedGet("c", value).IsCorruption());
+    BOOST_CHECK_EQUAL(db.GetCacheSize(), 2U);
+
+    db.Clear();
+    BOOST_CHECK_EQUAL(db.GetCacheSize(), 0U);
+    BOOST_CHECK(db.CachedGet("b", value).IsNotFound());
+}
+
+BOOST_AUTO_TEST_CASE(value_encoding)
+{
+    std::set<std::pair<int, int64_t> > items;
+    items.insert(std::make_pair(100, int64_t(5000)));
+    items.insert(std::make_pair(101, int64_t(-1)));
+
+    const std::string value = EncodeDBValue(items);
+    BOOST_CHECK_EQUAL(value[0], char(DB_VALUE_FORMAT_VERSION));
+
+    std::set<std::pair<int, int64_t> > decoded;
+    BOOST_CHECK(DecodeDBValue(value, decoded));
+    BOOST_CHECK(decoded == items);
+
+    // other versions, truncated and trailing data are rejected
+    std::string invalid = value;
+    invalid[0] = DB_VALUE_FORMAT_VERSION + 1;
+    BOOST_CHECK(!DecodeDBValue(invalid, decoded));
+    BOOST_CHECK(!DecodeDBValue(value.substr(0, value.size() - 1), decoded));
+    BOOST_CHECK(!DecodeDBValue(value + "x", decoded));
+    BOOST_CHECK(!DecodeDBValue(std::string("100:5000"), decoded));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
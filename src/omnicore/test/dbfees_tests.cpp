@@ -0,0 +1,109 @@
+#include <omnicore/dbfees.h>
+#include <omnicore/omnicore.h>
+
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <set>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbfees_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(cache_entries_and_rollback)
+{
+    COmniFeeCache db(GetDataDir() / "MP_feecache_test", true);
+
+    BOOST_CHECK_EQUAL(db.GetCachedAmount(3), 0);
+    BOOST_CHECK(db.GetCacheHistory(3).empty());
+
+    db.ClearCache(3, 100);
+    db.ClearCache(3, 110);
+    db.ClearCache(4, 105);
+    BOOST_CHECK_EQUAL(db.GetCacheHistory(3).size(), 2U);
+    BOOST_CHECK_EQUAL(db.GetCacheHistory(4).size(), 1U);
+    // properties without fees are omitted from the amounts of all properties
+    BOOST_CHECK(db.GetCachedAmounts().empty());
+    BOOST_CHECK_EQUAL(db.GetCachedAmount(4), 0);
+
+    // entries over MAX_STATE_HISTORY blocks old are pruned, when the property is written
+    db.ClearCache(3, 110 + MAX_STATE_HISTORY);
+    std::set<feeCacheItem> history = db.GetCacheHistory(3);
+    BOOST_CHECK_EQUAL(history.size(), 2U);
+    BOOST_CHECK_EQUAL(history.begin()->first, 110);
+
+    // rolling back restores the running total of the most recent remaining block
+    db.RollBackCache(110);
+    history = db.GetCacheHistory(3);
+    BOOST_CHECK(history.empty());
+    BOOST_CHECK_EQUAL(db.GetCachedAmount(3), 0);
+    BOOST_CHECK_EQUAL(db.GetCacheHistory(4).size(), 1U);
+
+    db.RollBackCache(105);
+    BOOST_CHECK(db.GetCacheHistory(4).empty());
+}
+
+BOOST_AUTO_TEST_CASE(distributions_by_property)
+{
+    COmniFeeHistory db(GetDataDir() / "MP_feehistory_test", true);
+
+    std::set<feeHistoryItem> recipients;
+    recipients.insert(std::make_pair("Alice", 60));
+    recipients.insert(std::make_pair("Bob", 40));
+    db.RecordFeeDistribution(3, 100, 100, std::vector<feeHistoryItem>(recipients.begin(), recipients.end()));
+    db.RecordFeeDistribution(4, 101, 40, std::vector<feeHistoryItem>{std::make_pair("Bob", 40)});
+    db.RecordFeeDistribution(3, 102, 40, std::vector<feeHistoryItem>{std::make_pair("Alice", 40)});
+    BOOST_CHECK_EQUAL(db.CountRecords(), 3);
+
+    std::set<int> distributions = db.GetDistributionsForProperty(3);
+    BOOST_CHECK_EQUAL(distributions.size(), 2U);
+    BOOST_CHECK(distributions.count(1) && distributions.count(3));
+    BOOST_CHECK_EQUAL(db.GetDistributionsForProperty(4).size(), 1U);
+    BOOST_CHECK(db.GetDistributionsForProperty(5).empty());
+
+    uint32_t propertyId = 0;
+    int block = 0;
+    int64_t total = 0;
+    BOOST_CHECK(db.GetDistributionData(1, &propertyId, &block, &total));
+    BOOST_CHECK_EQUAL(propertyId, 3U);
+    BOOST_CHECK_EQUAL(block, 100);
+    BOOST_CHECK_EQUAL(total, 100);
+    BOOST_CHECK(db.GetFeeDistribution(1) == recipients);
+    BOOST_CHECK_EQUAL(db.GetFeeDistribution(2).size(), 1U);
+
+    // rolling back removes the distribution, its recipients and its index entry
+    db.RollBackHistory(102);
+    BOOST_CHECK_EQUAL(db.CountRecords(), 2);
+    BOOST_CHECK_EQUAL(db.GetDistributionsForProperty(3).size(), 1U);
+    BOOST_CHECK(db.GetFeeDistribution(3).empty());
+    BOOST_CHECK(!db.GetDistributionData(3, &propertyId, &block, &total));
+    BOOST_CHECK(db.GetFeeDistribution(1) == recipients);
+}
+
+BOOST_AUTO_TEST_CASE(prune_distributions)
+{
+    COmniFeeHistory db(GetDataDir() / "MP_feehistory_prune_test", true);
+
+    db.RecordFeeDistribution(3, 100, 100, std::vector<feeHistoryItem>{std::make_pair("Alice", 100)});
+    db.RecordFeeDistribution(4, 101, 40, std::vector<feeHistoryItem>{std::make_pair("Bob", 40)});
+    db.RecordFeeDistribution(3, 102, 40, std::vector<feeHistoryItem>{std::make_pair("Alice", 40)});
+
+    // the distributions below the block are deleted, the ones above are kept
+    BOOST_CHECK_EQUAL(db.PruneHistory(102), 2);
+    BOOST_CHECK_EQUAL(db.CountRecords(), 3);
+    BOOST_CHECK(db.GetFeeDistribution(1).empty());
+    BOOST_CHECK(db.GetDistributionsForProperty(4).empty());
+    BOOST_CHECK_EQUAL(db.GetDistributionsForProperty(3).size(), 1U);
+    BOOST_CHECK_EQUAL(db.GetFeeDistribution(3).size(), 1U);
+
+    // the last distribution holds the count, so it's never pruned
+    BOOST_CHECK_EQUAL(db.PruneHistory(200), 0);
+    BOOST_CHECK_EQUAL(db.CountRecords(), 3);
+    db.RecordFeeDistribution(4, 201, 10, std::vector<feeHistoryItem>{std::make_pair("Bob", 10)});
+    BOOST_CHECK_EQUAL(db.CountRecords(), 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
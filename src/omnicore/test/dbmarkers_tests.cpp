@@ -0,0 +1,95 @@
+#include <omnicore/dbmarkers.h>
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbmarkers_tests, BasicTestingSetup)
+
+namespace {
+/** Creates a chain of block index entries with unique hashes. */
+class TestChain
+{
+public:
+    std::vector<uint256> hashes;
+    std::vector<CBlockIndex> blocks;
+
+    TestChain(int nBlocks, uint32_t nSalt) : hashes(nBlocks), blocks(nBlocks)
+    {
+        for (int n = 0; n < nBlocks; ++n) {
+            hashes[n] = ArithToUint256(arith_uint256(n + 1) | (arith_uint256(nSalt) << 128));
+            blocks[n].nHeight = n;
+            blocks[n].phashBlock = &hashes[n];
+        }
+    }
+};
+}
+
+BOOST_AUTO_TEST_CASE(markers_chunk)
+{
+    const int N = COmniMarkerIndex::BLOCKS_PER_CHUNK;
+    BOOST_CHECK_EQUAL(COmniMarkerIndex::GetChunkEnd(0), N - 1);
+    BOOST_CHECK_EQUAL(COmniMarkerIndex::GetChunkEnd(N - 1), N - 1);
+    BOOST_CHECK_EQUAL(COmniMarkerIndex::GetChunkEnd(N), 2 * N - 1);
+
+    COmniMarkerIndex db(GetDataDir() / "OMNI_markerindex", true);
+    TestChain chain(2 * N, 1);
+
+    for (int n = 0; n < N + 10; ++n) {
+        db.RecordBlock(&chain.blocks[n], n == 5);
+    }
+
+    BOOST_CHECK(db.IsMarkerFree(&chain.blocks[3], &chain.blocks[N - 1]));
+    BOOST_CHECK(!db.IsMarkerFree(&chain.blocks[5], &chain.blocks[N - 1]));
+    // the chunk is not complete yet
+    BOOST_CHECK(!db.IsMarkerFree(&chain.blocks[N + 3], nullptr));
+    BOOST_CHECK(!db.IsMarkerFree(&chain.blocks[N + 3], &chain.blocks[2 * N - 1]));
+
+    // the last block of the chunk is no longer part of the chain
+    TestChain fork(2 * N, 2);
+    BOOST_CHECK(!db.IsMarkerFree(&chain.blocks[3], &fork.blocks[N - 1]));
+}
+
+BOOST_AUTO_TEST_CASE(markers_reorg)
+{
+    const int N = COmniMarkerIndex::BLOCKS_PER_CHUNK;
+    COmniMarkerIndex db(GetDataDir() / "OMNI_markerindex", true);
+    TestChain chain(N, 1);
+    TestChain fork(N, 2);
+
+    for (int n = 0; n < 500; ++n) {
+        db.RecordBlock(&chain.blocks[n], n == 480);
+    }
+    for (int n = 400; n < N; ++n) {
+        db.RecordBlock(&fork.blocks[n], n == 450);
+    }
+
+    BOOST_CHECK(db.IsMarkerFree(&fork.blocks[480], &fork.blocks[N - 1]));
+    BOOST_CHECK(!db.IsMarkerFree(&fork.blocks[450], &fork.blocks[N - 1]));
+    BOOST_CHECK(!db.IsMarkerFree(&chain.blocks[300], &chain.blocks[N - 1]));
+}
+
+BOOST_AUTO_TEST_CASE(markers_gap)
+{
+    const int N = COmniMarkerIndex::BLOCKS_PER_CHUNK;
+    COmniMarkerIndex db(GetDataDir() / "OMNI_markerindex", true);
+    TestChain chain(2 * N, 1);
+
+    // blocks, which were not recorded, may have markers
+    for (int n = 10; n < 2 * N; ++n) {
+        if (n == N + 20) continue;
+        db.RecordBlock(&chain.blocks[n], false);
+    }
+
+    BOOST_CHECK(!db.IsMarkerFree(&chain.blocks[100], &chain.blocks[N - 1]));
+    BOOST_CHECK(!db.IsMarkerFree(&chain.blocks[N + 100], &chain.blocks[2 * N - 1]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,39 @@
+#include <omnicore/dbprevout.h>
+
+#include <coins.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <uint256.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbprevout_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(prevout_roundtrip)
+{
+    COmniPrevoutDB db(GetDataDir() / "OMNI_prevouts", true);
+
+    CScript scriptPubKey = CScript() << OP_DUP << OP_HASH160 << ParseHex("946cb2e08075bcbaf157e47bcb67eb2b2339d242") << OP_EQUALVERIFY << OP_CHECKSIG;
+    Coin coin(CTxOut(5460, scriptPubKey), 251023, false);
+    COutPoint outpoint(uint256S("0x1c3d8c0b6a8b02840c3e5cd9e6c7a4b1d3c7b2f1e0a9183746556473829101ab"), 2);
+
+    Coin result;
+    BOOST_CHECK(!db.GetCoin(outpoint, result));
+
+    db.AddCoin(outpoint, coin);
+    BOOST_CHECK(db.GetCoin(outpoint, result));
+    BOOST_CHECK(result.out == coin.out);
+    BOOST_CHECK_EQUAL(result.nHeight, 251023U);
+    BOOST_CHECK_EQUAL(db.GetHits(), 1U);
+
+    // other outputs of the same transaction are unknown
+    BOOST_CHECK(!db.GetCoin(COutPoint(outpoint.hash, 1), result));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
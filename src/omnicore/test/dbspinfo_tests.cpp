@@ -0,0 +1,176 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/omnicore.h>
+
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbspinfo_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(summary_follows_updates)
+{
+    CMPSPInfo db(GetDataDir() / "MP_spinfo_test", true);
+
+    CMPSPInfo::Entry info;
+    info.issuer = "Alice";
+    info.name = "Alpha";
+    info.prop_type = MSC_PROPERTY_TYPE_INDIVISIBLE;
+    info.txid = uint256S("01");
+    info.creation_block = uint256S("a1");
+    info.update_block = info.creation_block;
+    uint32_t propertyId = db.putSP(OMNI_PROPERTY_MSC, info);
+
+    CMPSPInfo::Summary summary;
+    BOOST_CHECK(db.getSummary(propertyId, summary));
+    BOOST_CHECK_EQUAL(summary.name, "Alpha");
+    BOOST_CHECK_EQUAL(summary.issuer, "Alice");
+    BOOST_CHECK(!summary.isDivisible());
+    BOOST_CHECK(!db.getSummary(propertyId + 1, summary));
+
+    // the cached summary is replaced, when the property is updated
+    info.name = "Beta";
+    info.delegate = "Bob";
+    info.addDelegate(2, 1, "Bob");
+    info.update_block = uint256S("a2");
+    BOOST_CHECK(db.updateSP(propertyId, info));
+    BOOST_CHECK(db.getSummary(propertyId, summary));
+    BOOST_CHECK_EQUAL(summary.name, "Beta");
+    BOOST_CHECK_EQUAL(summary.delegate, "Bob");
+
+    // and when the update is rolled back
+    BOOST_CHECK_EQUAL(db.popBlock(uint256S("a2")), 1);
+    BOOST_CHECK(db.getSummary(propertyId, summary));
+    BOOST_CHECK_EQUAL(summary.name, "Alpha");
+
+    // the implied properties are always known
+    BOOST_CHECK(db.getSummary(OMNI_PROPERTY_MSC, summary));
+    BOOST_CHECK(summary.isDivisible());
+}
+
+BOOST_AUTO_TEST_CASE(historical_data_stored_separately)
+{
+    CMPSPInfo db(GetDataDir() / "MP_spinfo_test", true);
+
+    CMPSPInfo::Entry info;
+    info.txid = uint256S("01");
+    info.creation_block = uint256S("a1");
+    info.update_block = info.creation_block;
+    info.manual = true;
+    uint32_t propertyId = db.putSP(OMNI_PROPERTY_MSC, info);
+
+    // only the new data is added to the entry, when it's updated
+    CMPSPInfo::Entry sp;
+    BOOST_CHECK(db.getSP(propertyId, sp));
+    sp.historicalData[uint256S("02")] = {100, 0};
+    sp.update_block = uint256S("a2");
+    BOOST_CHECK(db.updateSP(propertyId, sp));
+
+    BOOST_CHECK(db.getSP(propertyId, sp));
+    BOOST_CHECK(sp.historicalData.empty());
+    sp.historicalData[uint256S("03")] = {0, 40};
+    sp.update_block = uint256S("a3");
+    BOOST_CHECK(db.updateSP(propertyId, sp));
+
+    std::map<uint256, std::vector<int64_t> > historicalData;
+    BOOST_CHECK(db.getHistoricalData(propertyId, historicalData));
+    BOOST_CHECK_EQUAL(historicalData.size(), 2U);
+    BOOST_CHECK_EQUAL(historicalData[uint256S("02")].at(0), 100);
+    BOOST_CHECK_EQUAL(historicalData[uint256S("03")].at(1), 40);
+
+    std::vector<int64_t> data;
+    BOOST_CHECK(db.getHistoricalEntry(propertyId, uint256S("02"), data));
+    BOOST_CHECK(!db.getHistoricalEntry(propertyId + 1, uint256S("02"), data));
+
+    // the data written in a block is removed, when the block is popped
+    BOOST_CHECK_EQUAL(db.popBlock(uint256S("a3")), 1);
+    BOOST_CHECK(db.getHistoricalData(propertyId, historicalData));
+    BOOST_CHECK_EQUAL(historicalData.size(), 1U);
+    BOOST_CHECK(!db.getHistoricalEntry(propertyId, uint256S("03"), data));
+}
+
+BOOST_AUTO_TEST_CASE(historical_entry_appended)
+{
+    CMPSPInfo db(GetDataDir() / "MP_spinfo_test", true);
+
+    CMPSPInfo::Entry info;
+    info.issuer = "Alice";
+    info.manual = true;
+    info.txid = uint256S("01");
+    info.creation_block = uint256S("a1");
+    info.update_block = info.creation_block;
+    uint32_t propertyId = db.putSP(OMNI_PROPERTY_MSC, info);
+
+    // grants and revokes only append their entry, while the property remains unchanged
+    BOOST_CHECK(db.addHistoricalEntry(propertyId, uint256S("a2"), uint256S("02"), std::vector<int64_t>{100, 0}));
+    BOOST_CHECK(db.addHistoricalEntry(propertyId, uint256S("a3"), uint256S("03"), std::vector<int64_t>{0, 40}));
+    BOOST_CHECK(!db.addHistoricalEntry(OMNI_PROPERTY_MSC, uint256S("a3"), uint256S("04"), std::vector<int64_t>{1, 0}));
+
+    CMPSPInfo::Entry stored;
+    BOOST_CHECK(db.getSP(propertyId, stored));
+    BOOST_CHECK(stored.update_block == info.creation_block);
+
+    std::map<uint256, std::vector<int64_t> > historicalData;
+    BOOST_CHECK(db.getHistoricalData(propertyId, historicalData));
+    BOOST_CHECK_EQUAL(historicalData.size(), 2U);
+    BOOST_CHECK_EQUAL(historicalData[uint256S("03")].at(1), 40);
+
+    // the entry is removed, when its block is popped, and the property is kept
+    BOOST_CHECK_EQUAL(db.popBlock(uint256S("a3")), 1);
+    BOOST_CHECK(db.getHistoricalData(propertyId, historicalData));
+    BOOST_CHECK_EQUAL(historicalData.size(), 1U);
+    BOOST_CHECK(db.hasSP(propertyId));
+}
+
+BOOST_AUTO_TEST_CASE(listings_follow_updates)
+{
+    CMPSPInfo db(GetDataDir() / "MP_spinfo_test", true);
+
+    CMPSPInfo::Entry info;
+    info.issuer = "Alice";
+    info.name = "Alpha";
+    info.prop_type = MSC_PROPERTY_TYPE_INDIVISIBLE;
+    info.txid = uint256S("01");
+    info.creation_block = uint256S("a1");
+    info.update_block = info.creation_block;
+    uint32_t propertyId = db.putSP(OMNI_PROPERTY_MSC, info);
+    info.txid = uint256S("02");
+    uint32_t testPropertyId = db.putSP(OMNI_PROPERTY_TMSC, info);
+
+    // the implied properties are listed, followed by the ones of the test ecosystem
+    std::shared_ptr<const CMPSPInfo::ListingTable> listings = db.getListings();
+    BOOST_CHECK_EQUAL(listings->size(), 4U);
+    BOOST_CHECK_EQUAL(listings->begin()->first, OMNI_PROPERTY_MSC);
+    BOOST_CHECK_EQUAL(listings->rbegin()->first, testPropertyId);
+    BOOST_CHECK_EQUAL(listings->at(propertyId)->name, "Alpha");
+    BOOST_CHECK(listings->at(OMNI_PROPERTY_MSC)->isDivisible());
+
+    // updates are applied to a copy, while the old listings remain unchanged
+    info.name = "Beta";
+    info.update_block = uint256S("a2");
+    BOOST_CHECK(db.updateSP(propertyId, info));
+    info.txid = uint256S("03");
+    info.creation_block = info.update_block;
+    uint32_t newPropertyId = db.putSP(OMNI_PROPERTY_MSC, info);
+    std::shared_ptr<const CMPSPInfo::ListingTable> updated = db.getListings();
+    BOOST_CHECK_EQUAL(updated->size(), 5U);
+    BOOST_CHECK_EQUAL(updated->at(propertyId)->name, "Beta");
+    BOOST_CHECK(updated->at(newPropertyId)->txid == uint256S("03"));
+    BOOST_CHECK_EQUAL(listings->size(), 4U);
+    BOOST_CHECK_EQUAL(listings->at(propertyId)->name, "Alpha");
+
+    // the listings are reloaded, when a block is rolled back
+    BOOST_CHECK_EQUAL(db.popBlock(uint256S("a2")), 2);
+    BOOST_CHECK_EQUAL(db.getListings()->at(propertyId)->name, "Alpha");
+    BOOST_CHECK(!db.getListings()->count(newPropertyId));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
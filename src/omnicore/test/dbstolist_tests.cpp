@@ -0,0 +1,164 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dbstolist.h>
+#include <omnicore/sp.h>
+#include <omnicore/sto.h>
+
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace mastercore;
+
+namespace {
+/** Provides a STO database, and a property database to look up the divisibility of properties. */
+struct STOListTestingSetup : BasicTestingSetup
+{
+    CMPSPInfo spinfo;
+    CMPSPInfo* pPrevSpInfo;
+    CMPSTOList stolist;
+
+    STOListTestingSetup()
+      : spinfo(GetDataDir() / "MP_spinfo", true), pPrevSpInfo(pDbSpInfo), stolist(GetDataDir() / "MP_stolist", true)
+    {
+        pDbSpInfo = &spinfo;
+    }
+
+    ~STOListTestingSetup()
+    {
+        pDbSpInfo = pPrevSpInfo;
+    }
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbstolist_tests, STOListTestingSetup)
+
+BOOST_AUTO_TEST_CASE(recipients_of_sto)
+{
+    OwnerAddrType receivers;
+    receivers.push_back(std::make_pair(100, "b"));
+    receivers.push_back(std::make_pair(250, "a"));
+    stolist.recordSTOReceives(uint256S("01"), 100, 1, receivers);
+
+    receivers.clear();
+    receivers.push_back(std::make_pair(7, "a"));
+    stolist.recordSTOReceives(uint256S("02"), 101, 1, receivers);
+
+    BOOST_CHECK(stolist.exists("a"));
+    BOOST_CHECK(stolist.exists("b"));
+    BOOST_CHECK(!stolist.exists("c"));
+
+    // the receipts of an address, ordered by block
+    std::vector<std::pair<uint256, int> > receipts = stolist.GetAddressReceipts("a");
+    BOOST_REQUIRE_EQUAL(receipts.size(), 2U);
+    BOOST_CHECK(receipts[0].first == uint256S("01"));
+    BOOST_CHECK_EQUAL(receipts[0].second, 100);
+    BOOST_CHECK(receipts[1].first == uint256S("02"));
+    BOOST_CHECK_EQUAL(receipts[1].second, 101);
+    BOOST_CHECK_EQUAL(stolist.GetAddressReceipts("b").size(), 1U);
+    BOOST_CHECK(stolist.GetAddressReceipts("c").empty());
+
+    // all recipients, sorted by address
+    UniValue recipients(UniValue::VARR);
+    uint64_t total = 0;
+    uint64_t numRecipients = 0;
+    stolist.getRecipients(uint256S("01"), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 2U);
+    BOOST_CHECK_EQUAL(total, 350U);
+    BOOST_REQUIRE_EQUAL(recipients.size(), 2U);
+    BOOST_CHECK_EQUAL(recipients[0]["address"].get_str(), "a");
+    BOOST_CHECK_EQUAL(recipients[0]["amount"].get_str(), "0.00000250");
+    BOOST_CHECK_EQUAL(recipients[1]["address"].get_str(), "b");
+
+    // filtered by address, but counting all recipients
+    UniValue filtered(UniValue::VARR);
+    total = 0;
+    stolist.getRecipients(uint256S("01"), "b", &filtered, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 2U);
+    BOOST_CHECK_EQUAL(total, 100U);
+    BOOST_REQUIRE_EQUAL(filtered.size(), 1U);
+    BOOST_CHECK_EQUAL(filtered[0]["address"].get_str(), "b");
+}
+
+BOOST_AUTO_TEST_CASE(recipients_of_sto_paged)
+{
+    OwnerAddrType receivers;
+    receivers.push_back(std::make_pair(10, "d"));
+    receivers.push_back(std::make_pair(20, "c"));
+    receivers.push_back(std::make_pair(30, "b"));
+    receivers.push_back(std::make_pair(40, "a"));
+    stolist.recordSTOReceives(uint256S("01"), 100, 1, receivers);
+    receivers.clear();
+    receivers.push_back(std::make_pair(50, "e"));
+    stolist.recordSTOReceives(uint256S("02"), 100, 1, receivers);
+
+    BOOST_CHECK_EQUAL(stolist.getRecipientCount(uint256S("01")), 4U);
+    BOOST_CHECK_EQUAL(stolist.getRecipientCount(uint256S("02")), 1U);
+    BOOST_CHECK_EQUAL(stolist.getRecipientCount(uint256S("03")), 0U);
+
+    // pages of two recipients, which continue after the cursor
+    UniValue page(UniValue::VARR);
+    uint64_t total = 0;
+    std::string cursor;
+    BOOST_CHECK(stolist.getRecipientsPage(uint256S("01"), "*", "", 2, page, total, cursor));
+    BOOST_REQUIRE_EQUAL(page.size(), 2U);
+    BOOST_CHECK_EQUAL(page[0]["address"].get_str(), "a");
+    BOOST_CHECK_EQUAL(page[1]["address"].get_str(), "b");
+    BOOST_CHECK_EQUAL(cursor, "b");
+    BOOST_CHECK_EQUAL(total, 70U);
+
+    UniValue next(UniValue::VARR);
+    std::string nextCursor;
+    BOOST_CHECK(!stolist.getRecipientsPage(uint256S("01"), "*", cursor, 2, next, total, nextCursor));
+    BOOST_REQUIRE_EQUAL(next.size(), 2U);
+    BOOST_CHECK_EQUAL(next[0]["address"].get_str(), "c");
+    BOOST_CHECK_EQUAL(next[1]["address"].get_str(), "d");
+    BOOST_CHECK_EQUAL(total, 100U);
+
+    // a single address, which is looked up directly
+    UniValue single(UniValue::VARR);
+    total = 0;
+    BOOST_CHECK(!stolist.getRecipientsPage(uint256S("01"), "c", "", 2, single, total, cursor));
+    BOOST_REQUIRE_EQUAL(single.size(), 1U);
+    BOOST_CHECK_EQUAL(total, 20U);
+    UniValue none(UniValue::VARR);
+    BOOST_CHECK(!stolist.getRecipientsPage(uint256S("01"), "e", "", 2, none, total, cursor));
+    BOOST_CHECK(none.empty());
+}
+
+BOOST_AUTO_TEST_CASE(delete_above_block)
+{
+    OwnerAddrType receivers;
+    receivers.push_back(std::make_pair(100, "a"));
+    receivers.push_back(std::make_pair(200, "b"));
+    stolist.recordSTOReceives(uint256S("01"), 100, 1, receivers);
+    stolist.recordSTOReceives(uint256S("02"), 101, 1, receivers);
+
+    receivers.clear();
+    receivers.push_back(std::make_pair(300, "c"));
+    stolist.recordSTOReceives(uint256S("03"), 102, 1, receivers);
+
+    BOOST_CHECK_EQUAL(stolist.deleteAboveBlock(101), 3);
+    BOOST_CHECK(stolist.exists("a"));
+    BOOST_CHECK(!stolist.exists("c"));
+
+    UniValue recipients(UniValue::VARR);
+    uint64_t total = 0;
+    uint64_t numRecipients = 0;
+    stolist.getRecipients(uint256S("02"), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 0U);
+    stolist.getRecipients(uint256S("01"), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
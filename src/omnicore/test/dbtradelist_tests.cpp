@@ -0,0 +1,130 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dbtradelist.h>
+#include <omnicore/sp.h>
+
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+#include <vector>
+
+using namespace mastercore;
+
+namespace {
+/** Provides a trade database, and a property database to look up the divisibility of properties. */
+struct TradeListTestingSetup : BasicTestingSetup
+{
+    CMPSPInfo spinfo;
+    CMPSPInfo* pPrevSpInfo;
+    CMPTradeList tradelist;
+
+    TradeListTestingSetup()
+      : spinfo(GetDataDir() / "MP_spinfo", true), pPrevSpInfo(pDbSpInfo), tradelist(GetDataDir() / "MP_tradelist", true)
+    {
+        pDbSpInfo = &spinfo;
+    }
+
+    ~TradeListTestingSetup()
+    {
+        pDbSpInfo = pPrevSpInfo;
+    }
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbtradelist_tests, TradeListTestingSetup)
+
+BOOST_AUTO_TEST_CASE(trades_for_pair)
+{
+    tradelist.recordMatchedTrade(uint256S("01"), uint256S("02"), "a", "b", 3, 1, 100, 50, 100, 0);
+    tradelist.recordMatchedTrade(uint256S("03"), uint256S("04"), "c", "d", 1, 3, 20, 40, 101, 0);
+    tradelist.recordMatchedTrade(uint256S("05"), uint256S("06"), "e", "f", 4, 1, 10, 10, 102, 0);
+    tradelist.recordMatchedTrade(uint256S("07"), uint256S("08"), "g", "h", 3, 1, 30, 15, 103, 0);
+    BOOST_CHECK_EQUAL(tradelist.getMPTradeCountTotal(), 4);
+
+    // both directions of the pair, the newest ones, sorted oldest first
+    UniValue trades(UniValue::VARR);
+    tradelist.getTradesForPair(3, 1, trades, 2);
+    BOOST_REQUIRE_EQUAL(trades.size(), 2U);
+    BOOST_CHECK_EQUAL(trades[0]["block"].get_int(), 101);
+    BOOST_CHECK_EQUAL(trades[0]["sellertxid"].get_str(), uint256S("03").GetHex());
+    BOOST_CHECK_EQUAL(trades[0]["selleraddress"].get_str(), "c");
+    BOOST_CHECK_EQUAL(trades[0]["matchingaddress"].get_str(), "d");
+    BOOST_CHECK_EQUAL(trades[1]["block"].get_int(), 103);
+    BOOST_CHECK_EQUAL(trades[1]["sellertxid"].get_str(), uint256S("08").GetHex());
+
+    UniValue all(UniValue::VARR);
+    tradelist.getTradesForPair(1, 3, all, 10);
+    BOOST_REQUIRE_EQUAL(all.size(), 3U);
+    BOOST_CHECK_EQUAL(all[0]["block"].get_int(), 100);
+    BOOST_CHECK_EQUAL(all[0]["sellertxid"].get_str(), uint256S("01").GetHex());
+
+    // the positions and properties are read from the index as well
+    std::vector<CMPAddressTrade> vecTrades;
+    tradelist.getTradesForAddress("a", vecTrades);
+    BOOST_REQUIRE_EQUAL(vecTrades.size(), 4U);
+    BOOST_CHECK(vecTrades[1].txid == uint256S("04"));
+    BOOST_CHECK_EQUAL(vecTrades[1].block, 101);
+    BOOST_CHECK_EQUAL(vecTrades[1].blockIndex, 1);
+    BOOST_CHECK_EQUAL(vecTrades[1].propertyIdForSale, 1U);
+    BOOST_CHECK_EQUAL(vecTrades[1].propertyIdDesired, 3U);
+
+    // the index entries are rolled back together with the trades
+    tradelist.deleteAboveBlock(103);
+    UniValue remaining(UniValue::VARR);
+    tradelist.getTradesForPair(3, 1, remaining, 10);
+    BOOST_REQUIRE_EQUAL(remaining.size(), 2U);
+    BOOST_CHECK_EQUAL(remaining[1]["block"].get_int(), 101);
+    BOOST_CHECK_EQUAL(tradelist.getMPTradeCountTotal(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(trades_for_address)
+{
+    tradelist.recordNewTrade(uint256S("01"), "a", 3, 1, 101, 2);
+    tradelist.recordNewTrade(uint256S("02"), "a", 4, 1, 100, 5);
+    tradelist.recordNewTrade(uint256S("03"), "ab", 3, 1, 100, 1);
+    tradelist.recordNewTrade(uint256S("04"), "a", 1, 3, 101, 1);
+    tradelist.recordNewTrade(uint256S("05"), "a", 5, 6, 102, 1);
+    BOOST_CHECK_EQUAL(tradelist.getMPTradeCountTotal(), 5);
+
+    // sorted by block and position, without the trades of other addresses
+    std::vector<uint256> vecTransactions;
+    tradelist.getTradesForAddress("a", vecTransactions);
+    BOOST_REQUIRE_EQUAL(vecTransactions.size(), 4U);
+    BOOST_CHECK(vecTransactions[0] == uint256S("02"));
+    BOOST_CHECK(vecTransactions[1] == uint256S("04"));
+    BOOST_CHECK(vecTransactions[2] == uint256S("01"));
+    BOOST_CHECK(vecTransactions[3] == uint256S("05"));
+
+    vecTransactions.clear();
+    tradelist.getTradesForAddress("a", vecTransactions, 3);
+    BOOST_REQUIRE_EQUAL(vecTransactions.size(), 2U);
+    BOOST_CHECK(vecTransactions[0] == uint256S("04"));
+    BOOST_CHECK(vecTransactions[1] == uint256S("01"));
+
+    // the positions and properties are read from the index as well
+    std::vector<CMPAddressTrade> vecTrades;
+    tradelist.getTradesForAddress("a", vecTrades);
+    BOOST_REQUIRE_EQUAL(vecTrades.size(), 4U);
+    BOOST_CHECK(vecTrades[1].txid == uint256S("04"));
+    BOOST_CHECK_EQUAL(vecTrades[1].block, 101);
+    BOOST_CHECK_EQUAL(vecTrades[1].blockIndex, 1);
+    BOOST_CHECK_EQUAL(vecTrades[1].propertyIdForSale, 1U);
+    BOOST_CHECK_EQUAL(vecTrades[1].propertyIdDesired, 3U);
+
+    // the index entries are rolled back together with the trades
+    tradelist.deleteAboveBlock(101);
+    vecTransactions.clear();
+    tradelist.getTradesForAddress("a", vecTransactions);
+    BOOST_REQUIRE_EQUAL(vecTransactions.size(), 1U);
+    BOOST_CHECK(vecTransactions[0] == uint256S("02"));
+    BOOST_CHECK_EQUAL(tradelist.getMPTradeCountTotal(), 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,50 @@
+#include <omnicore/createpayload.h>
+#include <omnicore/dbtransaction.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/tx.h>
+
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbtransaction_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(record_restores_transaction)
+{
+    COmniTransactionDB db(GetDataDir() / "MP_txdb_test", true);
+
+    const uint256 txid = uint256S("01");
+    std::vector<unsigned char> payload = CreatePayload_SimpleSend(31, 5000);
+
+    CMPTransaction mp_obj;
+    mp_obj.Set("Alice", "Bob", 0, txid, 350000, 7, payload.data(), payload.size(), OMNI_CLASS_C, 1000);
+    db.RecordTransaction(mp_obj, uint256S("a1"), -51);
+
+    COmniTransactionDB::Record record;
+    BOOST_CHECK(!db.FetchTransactionRecord(uint256S("02"), record));
+    BOOST_CHECK(db.FetchTransactionRecord(txid, record));
+    BOOST_CHECK_EQUAL(record.blockHash, uint256S("a1"));
+    BOOST_CHECK_EQUAL(record.block, 350000);
+    BOOST_CHECK_EQUAL(db.FetchTransactionPosition(txid), 7U);
+
+    // the restored transaction is interpreted like a parsed one
+    CMPTransaction restored;
+    record.Restore(restored, txid, 1400000000);
+    BOOST_CHECK(restored.interpret_Transaction());
+    BOOST_CHECK_EQUAL(restored.getSender(), "Alice");
+    BOOST_CHECK_EQUAL(restored.getReceiver(), "Bob");
+    BOOST_CHECK_EQUAL(restored.getFeePaid(), 1000U);
+    BOOST_CHECK_EQUAL(restored.getType(), MSC_TYPE_SIMPLE_SEND);
+    BOOST_CHECK_EQUAL(restored.getProperty(), 31U);
+    BOOST_CHECK_EQUAL(restored.getAmount(), 5000U);
+    BOOST_CHECK_EQUAL(restored.getIndexInBlock(), 7U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,230 @@
+#include <omnicore/dbtxlist.h>
+#include <omnicore/omnicore.h>
+
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace mastercore;
+
+namespace {
+/** Provides a transaction database. */
+struct TxListTestingSetup : BasicTestingSetup
+{
+    CMPTxList txlist;
+
+    TxListTestingSetup() : txlist(GetDataDir() / "MP_txlist", true) {}
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dbtxlist_tests, TxListTestingSetup)
+
+BOOST_AUTO_TEST_CASE(txs_in_block_range)
+{
+    txlist.recordTX(uint256S("01"), true, 100, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.recordTX(uint256S("02"), false, 100, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.recordTX(uint256S("03"), true, 102, MSC_TYPE_SEND_ALL, 2);
+    txlist.recordTX(uint256S("04"), true, 105, MSC_TYPE_TRADE_OFFER, 0);
+    txlist.recordPaymentTX(uint256S("05"), true, 105, 1, 1, 50, "buyer", "seller");
+    txlist.recordPaymentTX(uint256S("05"), true, 105, 2, 1, 60, "buyer", "seller");
+    txlist.recordSendAllSubRecord(uint256S("03"), 1, 3, 100);
+    BOOST_CHECK_EQUAL(txlist.getMPTransactionCountTotal(), 5);
+
+    BOOST_CHECK_EQUAL(txlist.getMPTransactionCountBlock(99), 0);
+    BOOST_CHECK_EQUAL(txlist.getMPTransactionCountBlock(100), 2);
+    BOOST_CHECK_EQUAL(txlist.getMPTransactionCountBlock(105), 2);
+
+    std::set<uint256> txs;
+    BOOST_CHECK_EQUAL(txlist.GetOmniTxsInBlockRange(101, 105, txs), 3);
+    BOOST_CHECK(txs.count(uint256S("03")));
+    BOOST_CHECK(txs.count(uint256S("04")));
+    BOOST_CHECK(txs.count(uint256S("05")));
+
+    // invalid transactions are included, and the sub records are skipped
+    std::vector<CMPTxList::BlockTx> blockTxs = txlist.GetTxsInBlockRange(100, 104);
+    BOOST_CHECK_EQUAL(blockTxs.size(), 3U);
+    BOOST_CHECK_EQUAL(blockTxs[0].block, 100);
+    BOOST_CHECK_EQUAL(blockTxs[2].block, 102);
+    BOOST_CHECK_EQUAL(blockTxs[2].type, MSC_TYPE_SEND_ALL);
+    BOOST_CHECK(blockTxs[2].txid == uint256S("03"));
+    BOOST_CHECK(txlist.GetTxsInBlockRange(106, 200).empty());
+
+    std::set<int> seedBlocks = txlist.GetSeedBlocks(0, 104);
+    BOOST_CHECK_EQUAL(seedBlocks.size(), 2U);
+    BOOST_CHECK(seedBlocks.count(100));
+    BOOST_CHECK(seedBlocks.count(102));
+
+    BOOST_CHECK(txlist.isMPinBlockRange(101, 102, false));
+    BOOST_CHECK(!txlist.isMPinBlockRange(103, 104, false));
+}
+
+BOOST_AUTO_TEST_CASE(freeze_txs_above_block)
+{
+    txlist.recordTX(uint256S("01"), true, 100, MSC_TYPE_ENABLE_FREEZING, 0);
+    txlist.recordTX(uint256S("02"), true, 101, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.recordTX(uint256S("03"), false, 102, MSC_TYPE_FREEZE_PROPERTY_TOKENS, 0);
+    txlist.recordTX(uint256S("04"), true, 103, MSC_TYPE_SIMPLE_SEND, 0);
+
+    BOOST_CHECK(txlist.CheckForFreezeTxs(100));
+    BOOST_CHECK(txlist.CheckForFreezeTxs(102));
+    BOOST_CHECK(!txlist.CheckForFreezeTxs(103));
+}
+
+BOOST_AUTO_TEST_CASE(txs_of_types)
+{
+    txlist.recordTX(uint256S("01"), true, 100, OMNICORE_MESSAGE_TYPE_ALERT, 0);
+    txlist.recordTX(uint256S("02"), false, 101, OMNICORE_MESSAGE_TYPE_ALERT, 0);
+    txlist.recordTX(uint256S("03"), true, 101, MSC_TYPE_ENABLE_FREEZING, 0);
+    txlist.recordTX(uint256S("04"), true, 102, MSC_TYPE_FREEZE_PROPERTY_TOKENS, 0);
+    txlist.recordTX(uint256S("05"), true, 102, MSC_TYPE_SIMPLE_SEND, 0);
+
+    // only valid transactions are returned
+    std::vector<CMPTxList::PositionedTx> vTxs = txlist.GetValidTxsOfTypes({OMNICORE_MESSAGE_TYPE_ALERT});
+    BOOST_CHECK_EQUAL(vTxs.size(), 1U);
+    BOOST_CHECK_EQUAL(vTxs[0].block, 100);
+    BOOST_CHECK(vTxs[0].txid == uint256S("01"));
+    BOOST_CHECK(txlist.GetValidTxsOfTypes({OMNICORE_MESSAGE_TYPE_ACTIVATION}).empty());
+    BOOST_CHECK_EQUAL(txlist.GetValidTxsOfTypes({MSC_TYPE_ENABLE_FREEZING, MSC_TYPE_FREEZE_PROPERTY_TOKENS}).size(), 2U);
+
+    // deleted and overwritten records are removed from the index
+    txlist.recordTX(uint256S("03"), true, 101, MSC_TYPE_SIMPLE_SEND, 0);
+    BOOST_CHECK(txlist.isMPinBlockRange(102, 200, true));
+    BOOST_CHECK(txlist.GetValidTxsOfTypes({MSC_TYPE_ENABLE_FREEZING, MSC_TYPE_FREEZE_PROPERTY_TOKENS}).empty());
+    BOOST_CHECK_EQUAL(txlist.GetValidTxsOfTypes({OMNICORE_MESSAGE_TYPE_ALERT}).size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(txs_of_types_in_chain_order)
+{
+    txlist.recordTX(uint256S("01"), true, 102, MSC_TYPE_ENABLE_FREEZING, 0, 1);
+    txlist.recordTX(uint256S("02"), true, 101, MSC_TYPE_FREEZE_PROPERTY_TOKENS, 0, 7);
+    txlist.recordTX(uint256S("03"), true, 101, MSC_TYPE_ENABLE_FREEZING, 0, 3);
+    txlist.recordTX(uint256S("04"), true, 102, MSC_TYPE_DISABLE_FREEZING, 0, 0);
+
+    std::vector<CMPTxList::PositionedTx> vTxs = txlist.GetValidTxsOfTypes({MSC_TYPE_ENABLE_FREEZING,
+            MSC_TYPE_DISABLE_FREEZING, MSC_TYPE_FREEZE_PROPERTY_TOKENS});
+    BOOST_CHECK_EQUAL(vTxs.size(), 4U);
+    BOOST_CHECK(vTxs[0].txid == uint256S("03"));
+    BOOST_CHECK(vTxs[1].txid == uint256S("02"));
+    BOOST_CHECK(vTxs[2].txid == uint256S("04"));
+    BOOST_CHECK(vTxs[3].txid == uint256S("01"));
+    BOOST_CHECK_EQUAL(vTxs[1].idx, 7U);
+
+    // a record moved to another block leaves no stale entry behind
+    txlist.recordTX(uint256S("02"), true, 103, MSC_TYPE_FREEZE_PROPERTY_TOKENS, 0, 2);
+    vTxs = txlist.GetValidTxsOfTypes({MSC_TYPE_FREEZE_PROPERTY_TOKENS});
+    BOOST_CHECK_EQUAL(vTxs.size(), 1U);
+    BOOST_CHECK_EQUAL(vTxs[0].block, 103);
+    BOOST_CHECK(txlist.CheckForFreezeTxs(103));
+    BOOST_CHECK(!txlist.CheckForFreezeTxs(104));
+}
+
+BOOST_AUTO_TEST_CASE(delete_block_range)
+{
+    txlist.recordTX(uint256S("01"), true, 100, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.recordTX(uint256S("02"), true, 101, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.recordTX(uint256S("03"), true, 102, MSC_TYPE_SIMPLE_SEND, 0);
+
+    BOOST_CHECK(txlist.isMPinBlockRange(101, 200, true));
+    BOOST_CHECK(txlist.exists(uint256S("01")));
+    BOOST_CHECK(!txlist.exists(uint256S("02")));
+    BOOST_CHECK(!txlist.exists(uint256S("03")));
+    BOOST_CHECK_EQUAL(txlist.getMPTransactionCountTotal(), 1);
+    BOOST_CHECK(!txlist.isMPinBlockRange(101, 200, false));
+    BOOST_CHECK_EQUAL(txlist.GetSeedBlocks(0, 200).size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(overwrite_in_other_block)
+{
+    txlist.recordTX(uint256S("01"), true, 100, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.recordTX(uint256S("01"), true, 101, MSC_TYPE_SIMPLE_SEND, 0);
+
+    BOOST_CHECK_EQUAL(txlist.getMPTransactionCountBlock(100), 0);
+    BOOST_CHECK_EQUAL(txlist.getMPTransactionCountBlock(101), 1);
+}
+
+BOOST_AUTO_TEST_CASE(exists_after_reload)
+{
+    txlist.recordTX(uint256S("01"), true, 100, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.recordPaymentTX(uint256S("02"), true, 100, 1, 1, 50, "buyer", "seller");
+    BOOST_CHECK(txlist.exists(uint256S("01")));
+    BOOST_CHECK(txlist.exists(uint256S("02")));
+    BOOST_CHECK(!txlist.exists(uint256S("03")));
+    BOOST_CHECK(!txlist.getValidMPTX(uint256S("03")));
+
+    // the filter is rebuilt from the records
+    CMPTxList reloaded(GetDataDir() / "MP_txlist_reloaded", true);
+    reloaded.recordTX(uint256S("04"), true, 100, MSC_TYPE_SIMPLE_SEND, 0);
+    reloaded.Clear();
+    BOOST_CHECK(!reloaded.exists(uint256S("04")));
+    reloaded.recordTX(uint256S("05"), false, 101, MSC_TYPE_SIMPLE_SEND, 0);
+    BOOST_CHECK(reloaded.exists(uint256S("05")));
+    BOOST_CHECK(!reloaded.getValidMPTX(uint256S("05")));
+}
+
+BOOST_AUTO_TEST_CASE(state_hashes)
+{
+    txlist.recordTX(uint256S("01"), true, 100, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.RecordStateHash(100, uint256S("a0"), uint256S("c0"));
+    txlist.RecordStateHash(101, uint256S("a1"), uint256S("c1"));
+    txlist.RecordStateHash(102, uint256S("a2"), uint256S("c2"));
+
+    uint256 stateHash;
+    BOOST_CHECK(txlist.GetStateHash(101, uint256S("a1"), stateHash));
+    BOOST_CHECK(stateHash == uint256S("c1"));
+    BOOST_CHECK(!txlist.GetStateHash(101, uint256S("b1"), stateHash));
+    BOOST_CHECK(!txlist.GetStateHash(103, uint256S("a3"), stateHash));
+
+    // a block processed again after a reorganization replaces the old one
+    txlist.RecordStateHash(102, uint256S("b2"), uint256S("d2"));
+    BOOST_CHECK(!txlist.GetStateHash(102, uint256S("a2"), stateHash));
+    BOOST_CHECK(txlist.GetStateHash(102, uint256S("b2"), stateHash));
+    BOOST_CHECK(stateHash == uint256S("d2"));
+
+    // the commitments are not counted as transactions, and deleted with the blocks above
+    BOOST_CHECK_EQUAL(txlist.getMPTransactionCountTotal(), 1);
+    txlist.DeleteStateHashes(101);
+    BOOST_CHECK(txlist.GetStateHash(100, uint256S("a0"), stateHash));
+    BOOST_CHECK(!txlist.GetStateHash(101, uint256S("a1"), stateHash));
+    BOOST_CHECK(!txlist.GetStateHash(102, uint256S("b2"), stateHash));
+    BOOST_CHECK(txlist.exists(uint256S("01")));
+}
+
+BOOST_AUTO_TEST_CASE(prune_below_block)
+{
+    txlist.recordTX(uint256S("01"), true, 100, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.recordTX(uint256S("02"), true, 100, MSC_TYPE_FREEZE_PROPERTY_TOKENS, 0, 1);
+    txlist.recordTX(uint256S("03"), true, 101, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.recordSendAllSubRecord(uint256S("03"), 1, 3, 50);
+    txlist.recordTX(uint256S("04"), true, 101, MSC_TYPE_GRANT_PROPERTY_TOKENS, 0);
+    txlist.RecordNonFungibleGrant(uint256S("04"), 1, 10);
+    txlist.recordTX(uint256S("05"), true, 101, MSC_TYPE_SIMPLE_SEND, 0);
+    txlist.recordTX(uint256S("06"), true, 102, MSC_TYPE_SIMPLE_SEND, 0);
+    BOOST_CHECK_EQUAL(txlist.GetPrunedHeight(), 0);
+
+    std::vector<uint256> vPruned;
+    BOOST_CHECK_EQUAL(txlist.PruneBelowBlock(102, std::set<uint256>{uint256S("05")}, vPruned), 3);
+    BOOST_CHECK_EQUAL(vPruned.size(), 3U);
+    BOOST_CHECK_EQUAL(txlist.GetPrunedHeight(), 102);
+
+    // freeze transactions, grant ranges and retained transactions are kept
+    BOOST_CHECK(!txlist.getValidMPTX(uint256S("01")));
+    BOOST_CHECK(txlist.getValidMPTX(uint256S("02")));
+    BOOST_CHECK_EQUAL(txlist.GetValidTxsOfTypes({MSC_TYPE_FREEZE_PROPERTY_TOKENS}).size(), 1U);
+    uint32_t propertyId;
+    int64_t amount;
+    BOOST_CHECK(!txlist.getSendAllDetails(uint256S("03"), 1, propertyId, amount));
+    BOOST_CHECK(!txlist.getValidMPTX(uint256S("04")));
+    BOOST_CHECK(txlist.GetNonFungibleGrant(uint256S("04")) == std::make_pair(int64_t(1), int64_t(10)));
+    BOOST_CHECK(txlist.getValidMPTX(uint256S("05")));
+    BOOST_CHECK(txlist.getValidMPTX(uint256S("06")));
+    BOOST_CHECK_EQUAL(txlist.GetSeedBlocks(0, 200).size(), 3U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
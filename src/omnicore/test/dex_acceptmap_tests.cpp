@@ -0,0 +1,118 @@
+#include <omnicore/dex.h>
+
+#include <test/util/setup_common.h>
+#include <uint256.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using mastercore::CDExAcceptMap;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_dex_acceptmap_tests, BasicTestingSetup)
+
+/** Creates an accept, which was confirmed in the given block. */
+static CMPAccept MakeAccept(int block, uint8_t paymentWindow)
+{
+    return CMPAccept(100, block, paymentWindow, 1, 1000, 500, uint256S("01"));
+}
+
+BOOST_AUTO_TEST_CASE(legacy_keys)
+{
+    BOOST_CHECK_EQUAL(CDExOfferKey("seller", 31).ToString(), "seller-31");
+    BOOST_CHECK_EQUAL(CDExAcceptKey("seller", 2, "buyer").ToString(), "seller-2+buyer");
+}
+
+BOOST_AUTO_TEST_CASE(seller_accepts)
+{
+    CDExAcceptMap accepts;
+    accepts.insert(std::make_pair(CDExAcceptKey("b", 2, "x"), MakeAccept(10, 5)));
+    accepts.insert(std::make_pair(CDExAcceptKey("a", 1, "y"), MakeAccept(10, 5)));
+    accepts.insert(std::make_pair(CDExAcceptKey("b", 1, "z"), MakeAccept(10, 5)));
+    accepts.insert(std::make_pair(CDExAcceptKey("c", 1, "y"), MakeAccept(10, 5)));
+
+    std::vector<CDExAcceptKey> vKeys = accepts.GetSellerAccepts("b");
+    BOOST_CHECK_EQUAL(vKeys.size(), 2U);
+    BOOST_CHECK(vKeys[0] == CDExAcceptKey("b", 1, "z"));
+    BOOST_CHECK(vKeys[1] == CDExAcceptKey("b", 2, "x"));
+
+    accepts.erase(accepts.find(CDExAcceptKey("b", 1, "z")));
+    BOOST_CHECK_EQUAL(accepts.GetSellerAccepts("b").size(), 1U);
+    BOOST_CHECK(accepts.GetSellerAccepts("d").empty());
+}
+
+BOOST_AUTO_TEST_CASE(buyer_sellers)
+{
+    CDExAcceptMap accepts;
+    accepts.insert(std::make_pair(CDExAcceptKey("s", 1, "b"), MakeAccept(10, 5)));
+    accepts.insert(std::make_pair(CDExAcceptKey("s", 2, "b"), MakeAccept(10, 5)));
+    accepts.insert(std::make_pair(CDExAcceptKey("r", 1, "b"), MakeAccept(10, 5)));
+    accepts.insert(std::make_pair(CDExAcceptKey("s", 1, "c"), MakeAccept(10, 5)));
+
+    std::vector<std::string> vSellers = accepts.GetBuyerSellers("b");
+    BOOST_CHECK_EQUAL(vSellers.size(), 2U);
+    BOOST_CHECK_EQUAL(vSellers[0], "r");
+    BOOST_CHECK_EQUAL(vSellers[1], "s");
+
+    // the seller remains, as long as one of the accepts is open
+    accepts.erase(accepts.find(CDExAcceptKey("s", 1, "b")));
+    BOOST_CHECK_EQUAL(accepts.GetBuyerSellers("b").size(), 2U);
+    accepts.erase(accepts.find(CDExAcceptKey("s", 2, "b")));
+    BOOST_CHECK_EQUAL(accepts.GetBuyerSellers("b").size(), 1U);
+    BOOST_CHECK(accepts.GetBuyerSellers("s").empty());
+}
+
+BOOST_AUTO_TEST_CASE(expired_accepts)
+{
+    CDExAcceptMap accepts;
+    accepts.insert(std::make_pair(CDExAcceptKey("s", 1, "b"), MakeAccept(100, 10)));
+    accepts.insert(std::make_pair(CDExAcceptKey("s", 1, "a"), MakeAccept(105, 5)));
+    accepts.insert(std::make_pair(CDExAcceptKey("s", 10, "a"), MakeAccept(100, 10)));
+    accepts.insert(std::make_pair(CDExAcceptKey("s", 2, "a"), MakeAccept(101, 10)));
+    accepts.insert(std::make_pair(CDExAcceptKey("t", 1, "a"), MakeAccept(100, 20)));
+
+    BOOST_CHECK(accepts.TakeExpired(109).empty());
+
+    // ordered by legacy key: "s-1+a" < "s-1+b" < "s-10+a"
+    std::vector<CDExAcceptKey> vExpired = accepts.TakeExpired(110);
+    BOOST_CHECK_EQUAL(vExpired.size(), 3U);
+    BOOST_CHECK(vExpired[0] == CDExAcceptKey("s", 1, "a"));
+    BOOST_CHECK(vExpired[1] == CDExAcceptKey("s", 1, "b"));
+    BOOST_CHECK(vExpired[2] == CDExAcceptKey("s", 10, "a"));
+    for (const CDExAcceptKey& key : vExpired) {
+        accepts.erase(accepts.find(key));
+    }
+
+    // an accept, which is erased before its payment window is over, is skipped
+    accepts.erase(accepts.find(CDExAcceptKey("s", 2, "a")));
+    // an accept, which is replaced by a later one, expires with the later one
+    accepts.erase(accepts.find(CDExAcceptKey("t", 1, "a")));
+    accepts.insert(std::make_pair(CDExAcceptKey("t", 1, "a"), MakeAccept(115, 20)));
+
+    BOOST_CHECK(accepts.TakeExpired(130).empty());
+    BOOST_CHECK_EQUAL(accepts.size(), 1U);
+
+    vExpired = accepts.TakeExpired(135);
+    BOOST_CHECK_EQUAL(vExpired.size(), 1U);
+    BOOST_CHECK(vExpired[0] == CDExAcceptKey("t", 1, "a"));
+}
+
+BOOST_AUTO_TEST_CASE(copy_and_compare)
+{
+    CDExAcceptMap accepts;
+    accepts.insert(std::make_pair(CDExAcceptKey("s", 1, "a"), MakeAccept(100, 10)));
+
+    CDExAcceptMap copy = accepts;
+    BOOST_CHECK(copy == accepts);
+    BOOST_CHECK_EQUAL(copy.TakeExpired(110).size(), 1U);
+
+    copy.clear();
+    BOOST_CHECK(copy.empty());
+    BOOST_CHECK(!(copy == accepts));
+    BOOST_CHECK(copy.TakeExpired(110).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,45 @@
+#include <omnicore/indexproperties.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <set>
+#include <string>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_indexproperties_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(parse_index_properties)
+{
+    std::set<uint32_t> setProperties;
+    BOOST_CHECK(ParseIndexProperties("", setProperties));
+    BOOST_CHECK(setProperties.empty());
+    BOOST_CHECK(ParseIndexProperties("31, 3,31", setProperties));
+    BOOST_CHECK_EQUAL(setProperties.size(), 2U);
+    BOOST_CHECK_EQUAL(FormatIndexProperties(setProperties), "3,31");
+
+    BOOST_CHECK(!ParseIndexProperties("0", setProperties));
+    BOOST_CHECK(!ParseIndexProperties("3,", setProperties));
+    BOOST_CHECK(!ParseIndexProperties("3;31", setProperties));
+    BOOST_CHECK(!ParseIndexProperties("4294967296", setProperties));
+}
+
+BOOST_AUTO_TEST_CASE(indexed_properties)
+{
+    BOOST_CHECK(IsIndexingAllProperties());
+    BOOST_CHECK(IsIndexedProperty(3));
+
+    SetIndexProperties(std::set<uint32_t>{31});
+    BOOST_CHECK(!IsIndexingAllProperties());
+    BOOST_CHECK(IsIndexedProperty(31));
+    BOOST_CHECK(!IsIndexedProperty(3));
+
+    SetIndexProperties(std::set<uint32_t>());
+    BOOST_CHECK(IsIndexingAllProperties());
+    BOOST_CHECK(IsIndexedProperty(3));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,117 @@
+#include <omnicore/inputcache.h>
+
+#include <coins.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <uint256.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_inputcache_tests, BasicTestingSetup)
+
+static COutPoint MakeOutPoint(uint32_t n)
+{
+    return COutPoint(uint256S("0x1c3d8c0b6a8b02840c3e5cd9e6c7a4b1d3c7b2f1e0a9183746556473829101ab"), n);
+}
+
+static Coin MakeCoin(CAmount nValue)
+{
+    return Coin(CTxOut(nValue, CScript() << OP_TRUE), 100, false);
+}
+
+BOOST_AUTO_TEST_CASE(inputcache_lru)
+{
+    COmniInputCache cache(2);
+    Coin coin;
+
+    cache.Add(MakeOutPoint(0), MakeCoin(1000));
+    cache.Add(MakeOutPoint(1), MakeCoin(2000));
+
+    // mark the first output as recently used
+    BOOST_CHECK(cache.Get(MakeOutPoint(0), coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 1000);
+
+    // the second output is the least recently used one
+    cache.Add(MakeOutPoint(2), MakeCoin(3000));
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+    BOOST_CHECK(!cache.Get(MakeOutPoint(1), coin));
+    BOOST_CHECK(cache.Get(MakeOutPoint(0), coin));
+    BOOST_CHECK(cache.Get(MakeOutPoint(2), coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 3000);
+
+    BOOST_CHECK_EQUAL(cache.GetHits(), 3U);
+    BOOST_CHECK_EQUAL(cache.GetMisses(), 1U);
+    BOOST_CHECK_EQUAL(cache.GetEvictions(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(inputcache_resize)
+{
+    COmniInputCache cache(10);
+    Coin coin;
+
+    for (uint32_t n = 0; n < 10; ++n) {
+        cache.Add(MakeOutPoint(n), MakeCoin(n));
+    }
+    cache.SetMaxSize(4);
+    BOOST_CHECK_EQUAL(cache.Size(), 4U);
+    BOOST_CHECK_EQUAL(cache.GetEvictions(), 6U);
+    BOOST_CHECK(cache.Get(MakeOutPoint(9), coin));
+    BOOST_CHECK(!cache.Get(MakeOutPoint(5), coin));
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    BOOST_CHECK_EQUAL(cache.GetHits(), 1U);
+
+    // a cache without capacity doesn't hold anything
+    cache.SetMaxSize(0);
+    cache.Add(MakeOutPoint(0), MakeCoin(0));
+    BOOST_CHECK(!cache.Get(MakeOutPoint(0), coin));
+}
+
+BOOST_AUTO_TEST_CASE(inputcache_memory_usage)
+{
+    COmniInputCache cache(10);
+    size_t nEmpty = cache.DynamicMemoryUsage();
+
+    cache.Add(MakeOutPoint(0), MakeCoin(0));
+    size_t nOne = cache.DynamicMemoryUsage();
+    BOOST_CHECK(nOne > nEmpty);
+
+    cache.Add(MakeOutPoint(1), MakeCoin(1));
+    BOOST_CHECK(cache.DynamicMemoryUsage() > nOne);
+
+    cache.Clear();
+    BOOST_CHECK(cache.DynamicMemoryUsage() < nOne);
+}
+
+BOOST_AUTO_TEST_CASE(inputcache_memory_limit)
+{
+    COmniInputCache cache(1000, 0);
+    Coin coin;
+
+    for (uint32_t n = 0; n < 100; ++n) {
+        cache.Add(MakeOutPoint(n), MakeCoin(n));
+    }
+    BOOST_CHECK_EQUAL(cache.Size(), 100U);
+
+    // the memory budget evicts before the number of outputs is reached
+    size_t nMaxMemory = cache.DynamicMemoryUsage() / 2;
+    cache.SetMaxMemory(nMaxMemory);
+    BOOST_CHECK(cache.Size() < 100U);
+    BOOST_CHECK(cache.Size() > 0U);
+    BOOST_CHECK(cache.DynamicMemoryUsage() <= nMaxMemory);
+    BOOST_CHECK(cache.Get(MakeOutPoint(99), coin));
+    BOOST_CHECK(!cache.Get(MakeOutPoint(0), coin));
+
+    for (uint32_t n = 100; n < 200; ++n) {
+        cache.Add(MakeOutPoint(n), MakeCoin(n));
+        BOOST_CHECK(cache.DynamicMemoryUsage() <= nMaxMemory);
+    }
+    BOOST_CHECK_EQUAL(cache.GetEvictions(), 200U - cache.Size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
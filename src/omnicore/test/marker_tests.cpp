@@ -1,5 +1,6 @@
 #include <omnicore/test/utils_tx.h>
 
+#include <omnicore/marker.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/parsing.h>
 #include <omnicore/rules.h>
@@ -312,5 +313,53 @@ BOOST_AUTO_TEST_CASE(class_class_c)
     }
 }
 
+BOOST_AUTO_TEST_CASE(scan_markers)
+{
+    {
+        int nBlock = ConsensusParams().NULLDATA_BLOCK;
+
+        CMutableTransaction mutableTx;
+        mutableTx.vout.push_back(PayToPubKeyHash_Unrelated());
+        mutableTx.vout.push_back(OpReturn_Unrelated());
+        mutableTx.vout.push_back(PayToPubKey_Unrelated());
+
+        CMarkerScan scan;
+        ScanMarkers(CTransaction(mutableTx), nBlock, scan);
+        BOOST_CHECK_EQUAL(scan.nEncodingClass, NO_MARKER);
+        BOOST_CHECK(!scan.HasMarker());
+    }
+    {
+        int nBlock = ConsensusParams().NULLDATA_BLOCK;
+
+        CMutableTransaction mutableTx;
+        mutableTx.vout.push_back(PayToPubKeyHash_Unrelated());
+        mutableTx.vout.push_back(PayToBareMultisig_1of2());
+        mutableTx.vout.push_back(PayToPubKeyHash_Exodus());
+        mutableTx.vout.push_back(OpReturn_PlainMarker());
+
+        CMarkerScan scan;
+        ScanMarkers(CTransaction(mutableTx), nBlock, scan);
+        BOOST_CHECK_EQUAL(scan.nEncodingClass, OMNI_CLASS_C);
+        BOOST_CHECK_EQUAL(scan.nMultisigOut, 1);
+        BOOST_CHECK_EQUAL(scan.nExodusOut, 2);
+        BOOST_CHECK_EQUAL(scan.nDataOut, 3);
+        BOOST_CHECK_EQUAL(scan.nRawMarkerOut, 3);
+        BOOST_CHECK(scan.HasMarker());
+    }
+    {
+        // class C is not enabled yet, but the marker is still detected
+        int nBlock = 0;
+
+        CMutableTransaction mutableTx;
+        mutableTx.vout.push_back(OpReturn_SimpleSend());
+
+        CMarkerScan scan;
+        ScanMarkers(CTransaction(mutableTx), nBlock, scan);
+        BOOST_CHECK_EQUAL(scan.nEncodingClass, NO_MARKER);
+        BOOST_CHECK_EQUAL(scan.nDataOut, -1);
+        BOOST_CHECK_EQUAL(scan.nRawMarkerOut, 0);
+        BOOST_CHECK(scan.HasMarker());
+    }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,336 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dbtradelist.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+
+#include <random.h>
+#include <sync.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+#include <limits>
+#include <vector>
+
+using namespace mastercore;
+
+namespace {
+struct MetaDExTestingSetup : BasicTestingSetup
+{
+    MetaDExTestingSetup()
+    {
+        LOCK(cs_tally);
+        MetaDEx_CLEAR();
+    }
+
+    ~MetaDExTestingSetup()
+    {
+        LOCK(cs_tally);
+        MetaDEx_CLEAR();
+    }
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_mdex_tests, MetaDExTestingSetup)
+
+BOOST_AUTO_TEST_CASE(metadex_insert)
+{
+    LOCK(cs_tally);
+    const CMPMetaDEx orderA("a", 100, 3, 50, 1, 100, uint256S("0a"), 1, 1);
+    const CMPMetaDEx orderB("b", 100, 3, 25, 1, 50, uint256S("0b"), 2, 1);
+    const CMPMetaDEx orderC("c", 101, 3, 10, 1, 30, uint256S("0c"), 1, 1);
+    const CMPMetaDEx orderD("d", 101, 3, 10, 2, 30, uint256S("0d"), 2, 1);
+
+    BOOST_CHECK(MetaDEx_INSERT(orderA));
+    BOOST_CHECK(MetaDEx_INSERT(orderB));
+    BOOST_CHECK(MetaDEx_INSERT(orderC));
+    BOOST_CHECK(MetaDEx_INSERT(orderD));
+    // an order can be inserted only once
+    BOOST_CHECK(!MetaDEx_INSERT(orderA));
+
+    BOOST_CHECK_EQUAL(metadex.size(), 2U);
+    md_PricesMap* pPrices = get_Prices(3, 1);
+    BOOST_REQUIRE(pPrices != nullptr);
+    BOOST_CHECK_EQUAL(pPrices->size(), 2U);
+    md_Set* pIndexes = get_Indexes(pPrices, orderA.unitPrice());
+    BOOST_REQUIRE(pIndexes != nullptr);
+    BOOST_CHECK_EQUAL(pIndexes->size(), 2U);
+    BOOST_CHECK_EQUAL(pIndexes->begin()->getAddr(), "a");
+    BOOST_CHECK(get_Prices(1, 3) == nullptr);
+
+    BOOST_CHECK(MetaDEx_isOpen(uint256S("0b")));
+    BOOST_CHECK(MetaDEx_isOpen(uint256S("0d"), 3));
+    BOOST_CHECK(!MetaDEx_isOpen(uint256S("0d"), 1));
+    BOOST_CHECK(!MetaDEx_isOpen(uint256S("0e")));
+}
+
+BOOST_AUTO_TEST_CASE(metadex_loader)
+{
+    LOCK(cs_tally);
+    const CMPMetaDEx orderA("a", 100, 3, 50, 1, 100, uint256S("0a"), 1, 1);
+    const CMPMetaDEx orderB("b", 101, 3, 25, 1, 50, uint256S("0b"), 2, 1);
+    const CMPMetaDEx orderC("c", 101, 3, 10, 1, 30, uint256S("0c"), 1, 1);
+    const CMPMetaDEx orderD("d", 101, 4, 10, 2, 30, uint256S("0d"), 2, 1);
+
+    // the orders are loaded like they are inserted one by one, sorted or not
+    MetaDEx_INSERT(orderA);
+    MetaDEx_INSERT(orderB);
+    MetaDEx_INSERT(orderC);
+    MetaDEx_INSERT(orderD);
+    const md_PropertiesMap expected = metadex;
+    MetaDEx_CLEAR();
+
+    CMetaDExLoader loader;
+    loader.Reserve(4);
+    BOOST_CHECK(loader.Insert(orderA));
+    BOOST_CHECK(loader.Insert(orderB));
+    BOOST_CHECK(loader.Insert(orderC));
+    BOOST_CHECK(loader.Insert(orderD));
+    BOOST_CHECK(!loader.Insert(orderB));
+    BOOST_CHECK(metadex == expected);
+    BOOST_CHECK(MetaDEx_isOpen(uint256S("0c"), 3));
+    MetaDEx_CLEAR();
+
+    CMetaDExLoader unsorted;
+    BOOST_CHECK(unsorted.Insert(orderD));
+    BOOST_CHECK(unsorted.Insert(orderC));
+    BOOST_CHECK(unsorted.Insert(orderA));
+    BOOST_CHECK(unsorted.Insert(orderB));
+    BOOST_CHECK(metadex == expected);
+    BOOST_CHECK(MetaDEx_isOpen(uint256S("0d"), 4));
+}
+
+BOOST_AUTO_TEST_CASE(metadex_txid_index)
+{
+    LOCK(cs_tally);
+    const CMPMetaDEx orderA("a", 100, 3, 50, 1, 100, uint256S("0a"), 1, 1);
+    const CMPMetaDEx orderB("b", 101, 4, 25, 1, 50, uint256S("0b"), 2, 1);
+
+    BOOST_CHECK(MetaDEx_INSERT(orderA));
+    BOOST_CHECK(MetaDEx_INSERT(orderB));
+
+    const CMPMetaDEx* pOrder = MetaDEx_RetrieveTrade(uint256S("0b"));
+    BOOST_REQUIRE(pOrder != nullptr);
+    BOOST_CHECK_EQUAL(pOrder->getAddr(), "b");
+    BOOST_CHECK(MetaDEx_RetrieveTrade(uint256S("0c")) == nullptr);
+
+    // the index follows, when the maps are replaced as a whole
+    md_PropertiesMap saved = metadex;
+    MetaDEx_CLEAR();
+    BOOST_CHECK(!MetaDEx_isOpen(uint256S("0a")));
+    metadex = saved;
+    MetaDEx_RebuildIndex();
+    BOOST_CHECK(MetaDEx_isOpen(uint256S("0a"), 3));
+    BOOST_CHECK(!MetaDEx_isOpen(uint256S("0a"), 4));
+}
+
+BOOST_AUTO_TEST_CASE(metadex_open_orders)
+{
+    LOCK(cs_tally);
+    const CMPMetaDEx orderA("a", 100, 4, 50, 1, 100, uint256S("0a"), 1, 1);
+    const CMPMetaDEx orderB("a", 101, 3, 10, 1, 30, uint256S("0b"), 2, 1);
+    const CMPMetaDEx orderC("a", 102, 3, 10, 1, 20, uint256S("0c"), 3, 1);
+    const CMPMetaDEx orderD("d", 102, 3, 10, 1, 20, uint256S("0d"), 4, 1);
+
+    BOOST_CHECK(MetaDEx_INSERT(orderA));
+    BOOST_CHECK(MetaDEx_INSERT(orderB));
+    BOOST_CHECK(MetaDEx_INSERT(orderC));
+    BOOST_CHECK(MetaDEx_INSERT(orderD));
+
+    // sorted by property for sale, price, block and position
+    std::vector<CMPMetaDEx> vOrders = MetaDEx_getOpenOrders("a");
+    BOOST_REQUIRE_EQUAL(vOrders.size(), 3U);
+    BOOST_CHECK(vOrders[0].getHash() == uint256S("0c"));
+    BOOST_CHECK(vOrders[1].getHash() == uint256S("0b"));
+    BOOST_CHECK(vOrders[2].getHash() == uint256S("0a"));
+    BOOST_CHECK_EQUAL(MetaDEx_getOpenOrders("d").size(), 1U);
+    BOOST_CHECK(MetaDEx_getOpenOrders("e").empty());
+}
+
+BOOST_AUTO_TEST_CASE(metadex_depth)
+{
+    LOCK(cs_tally);
+    const CMPMetaDEx orderA("a", 100, 3, 50, 1, 100, uint256S("0a"), 1, 1);
+    const CMPMetaDEx orderB("b", 101, 3, 25, 1, 50, uint256S("0b"), 1, 1);
+    const CMPMetaDEx orderC("c", 102, 3, 10, 1, 10, uint256S("0c"), 1, 1);
+
+    BOOST_CHECK(MetaDEx_INSERT(orderA));
+    BOOST_CHECK(MetaDEx_INSERT(orderB));
+    BOOST_CHECK(MetaDEx_INSERT(orderC));
+
+    std::vector<std::pair<rational_t, md_DepthLevel> > vLevels = MetaDEx_getDepth(3, 1, 10);
+    BOOST_REQUIRE_EQUAL(vLevels.size(), 2U);
+    BOOST_CHECK(vLevels[0].first == rational_t(1));
+    BOOST_CHECK_EQUAL(vLevels[0].second.amountRemaining, 10);
+    BOOST_CHECK_EQUAL(vLevels[0].second.orders, 1);
+    BOOST_CHECK(vLevels[1].first == rational_t(2));
+    BOOST_CHECK_EQUAL(vLevels[1].second.amountRemaining, 75);
+    BOOST_CHECK_EQUAL(vLevels[1].second.orders, 2);
+    BOOST_CHECK_EQUAL(MetaDEx_getDepth(3, 1, 1).size(), 1U);
+    BOOST_CHECK(MetaDEx_getDepth(1, 3, 10).empty());
+
+    md_PropertiesMap saved = metadex;
+    MetaDEx_CLEAR();
+    BOOST_CHECK(MetaDEx_getDepth(3, 1, 10).empty());
+    metadex = saved;
+    MetaDEx_RebuildIndex();
+    BOOST_CHECK_EQUAL(MetaDEx_getDepth(3, 1, 10).size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(metadex_cancel_everything)
+{
+    LOCK(cs_tally);
+    // cancellations are recorded, and logged with formatted amounts
+    CMPTxList txlist(GetDataDir() / "MP_txlist", true);
+    CMPSPInfo spinfo(GetDataDir() / "MP_spinfo", true);
+    CMPTxList* pPrevTransactionList = pDbTransactionList;
+    CMPSPInfo* pPrevSpInfo = pDbSpInfo;
+    pDbTransactionList = &txlist;
+    pDbSpInfo = &spinfo;
+
+    BOOST_CHECK(update_tally_map("a", 3, 100, BALANCE));
+    BOOST_CHECK(update_tally_map("a", 4, 100, BALANCE));
+    BOOST_CHECK(update_tally_map("b", 3, 100, BALANCE));
+    BOOST_CHECK_EQUAL(MetaDEx_ADD("a", 3, 50, 100, 1, 100, uint256S("0a"), 1), 0);
+    BOOST_CHECK_EQUAL(MetaDEx_ADD("a", 3, 30, 100, 1, 90, uint256S("0b"), 2), 0);
+    BOOST_CHECK_EQUAL(MetaDEx_ADD("a", 4, 20, 100, 1, 20, uint256S("0c"), 3), 0);
+    BOOST_CHECK_EQUAL(MetaDEx_ADD("b", 3, 40, 100, 1, 80, uint256S("0d"), 4), 0);
+    BOOST_CHECK_EQUAL(GetTokenBalance("a", 3, METADEX_RESERVE), 80);
+
+    const uint256 txid = uint256S("0e");
+    BOOST_CHECK_EQUAL(MetaDEx_CANCEL_EVERYTHING(txid, 101, "a", 1), 0);
+
+    // the reserves are released, and every cancelled order has a sub-record
+    BOOST_CHECK_EQUAL(GetTokenBalance("a", 3, METADEX_RESERVE), 0);
+    BOOST_CHECK_EQUAL(GetTokenBalance("a", 3, BALANCE), 100);
+    BOOST_CHECK_EQUAL(GetTokenBalance("a", 4, BALANCE), 100);
+    BOOST_CHECK_EQUAL(GetTokenBalance("b", 3, METADEX_RESERVE), 40);
+    BOOST_CHECK_EQUAL(txlist.getNumberOfMetaDExCancels(txid), 3);
+    uint256 orderTxid;
+    uint32_t propertyId = 0;
+    int64_t amountUnreserved = 0;
+    BOOST_CHECK(txlist.getMetaDExCancelDetails(txid, 3, orderTxid, propertyId, amountUnreserved));
+    BOOST_CHECK(txlist.findMetaDExCancel(orderTxid) == txid);
+    BOOST_CHECK(!txlist.getMetaDExCancelDetails(txid, 4, orderTxid, propertyId, amountUnreserved));
+
+    // the emptied price levels and pairs are removed
+    BOOST_CHECK(MetaDEx_getOpenOrders("a").empty());
+    BOOST_CHECK(get_Prices(4, 1) == nullptr);
+    md_PricesMap* pPrices = get_Prices(3, 1);
+    BOOST_REQUIRE(pPrices != nullptr);
+    BOOST_CHECK_EQUAL(pPrices->size(), 1U);
+    BOOST_CHECK_EQUAL(MetaDEx_CANCEL_EVERYTHING(uint256S("0f"), 101, "a", 1), METADEX_ERROR -40);
+
+    BOOST_CHECK_EQUAL(MetaDEx_SHUTDOWN(), 0);
+    BOOST_CHECK_EQUAL(GetTokenBalance("b", 3, METADEX_RESERVE), 0);
+    BOOST_CHECK_EQUAL(GetTokenBalance("b", 3, BALANCE), 100);
+
+    mp_tally_map.clear();
+    pDbTransactionList = pPrevTransactionList;
+    pDbSpInfo = pPrevSpInfo;
+}
+
+BOOST_AUTO_TEST_CASE(metadex_address_pool)
+{
+    const CMPMetaDEx orderA("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb", 100, 3, 50, 1, 100, uint256S("0a"), 1, 1);
+    const CMPMetaDEx orderB("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb", 101, 4, 25, 1, 50, uint256S("0b"), 2, 1);
+    const CMPMetaDEx orderC("1MCHESTbJhJK27Ygqj4qKkx4Z4ZxhnP826", 101, 4, 25, 1, 50, uint256S("0c"), 3, 1);
+
+    // orders of the same address share the interned address
+    BOOST_CHECK_EQUAL(orderA.getAddr(), "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb");
+    BOOST_CHECK_EQUAL(&orderA.getAddr(), &orderB.getAddr());
+    BOOST_CHECK_EQUAL(orderC.getAddr(), "1MCHESTbJhJK27Ygqj4qKkx4Z4ZxhnP826");
+    BOOST_CHECK(CMPMetaDEx().getAddr().empty());
+    BOOST_CHECK(MetaDEx_AddressPoolUsage() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(metadex_address_pool_clear)
+{
+    const CMPMetaDEx orderA("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb", 100, 3, 50, 1, 100, uint256S("0a"), 1, 1);
+    const size_t nUsage = MetaDEx_AddressPoolUsage();
+    {
+        LOCK(cs_tally);
+        MetaDEx_ClearAddresses();
+    }
+    BOOST_CHECK(MetaDEx_AddressPoolUsage() < nUsage);
+
+    // orders copied before the pool was cleared have no address, and ids aren't reused
+    BOOST_CHECK(orderA.getAddr().empty());
+    const CMPMetaDEx orderB("1MCHESTbJhJK27Ygqj4qKkx4Z4ZxhnP826", 101, 4, 25, 1, 50, uint256S("0b"), 2, 1);
+    BOOST_CHECK_EQUAL(orderB.getAddr(), "1MCHESTbJhJK27Ygqj4qKkx4Z4ZxhnP826");
+    BOOST_CHECK(orderA.getAddr().empty());
+    const CMPMetaDEx orderC("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb", 102, 3, 50, 1, 100, uint256S("0c"), 3, 1);
+    BOOST_CHECK_EQUAL(orderC.getAddr(), "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb");
+}
+
+BOOST_AUTO_TEST_CASE(metadex_partial_fill)
+{
+    LOCK(cs_tally);
+    CMPTradeList tradelist(GetDataDir() / "MP_tradelist", true);
+    CMPSPInfo spinfo(GetDataDir() / "MP_spinfo", true);
+    CMPTradeList* pPrevTradeList = pDbTradeList;
+    CMPSPInfo* pPrevSpInfo = pDbSpInfo;
+    pDbTradeList = &tradelist;
+    pDbSpInfo = &spinfo;
+
+    BOOST_CHECK(update_tally_map("a", 3, 100, BALANCE));
+    BOOST_CHECK(update_tally_map("b", 1, 100, BALANCE));
+    BOOST_CHECK_EQUAL(MetaDEx_ADD("a", 3, 100, 100, 1, 50, uint256S("0a"), 1), 0);
+    const CMPMetaDEx* pOrder = MetaDEx_RetrieveTrade(uint256S("0a"));
+    BOOST_REQUIRE(pOrder != nullptr);
+
+    // the seller's order is filled in place
+    BOOST_CHECK_EQUAL(MetaDEx_ADD("b", 1, 20, 101, 3, 40, uint256S("0b"), 1), 0);
+    BOOST_CHECK(MetaDEx_RetrieveTrade(uint256S("0a")) == pOrder);
+    BOOST_CHECK_EQUAL(pOrder->getAmountRemaining(), 60);
+    BOOST_CHECK(!MetaDEx_isOpen(uint256S("0b")));
+    BOOST_CHECK_EQUAL(GetTokenBalance("a", 3, METADEX_RESERVE), 60);
+    BOOST_CHECK_EQUAL(GetTokenBalance("a", 1, BALANCE), 20);
+    BOOST_CHECK_EQUAL(GetTokenBalance("b", 3, BALANCE), 40);
+
+    std::vector<std::pair<rational_t, md_DepthLevel> > vLevels = MetaDEx_getDepth(3, 1, 10);
+    BOOST_REQUIRE_EQUAL(vLevels.size(), 1U);
+    BOOST_CHECK_EQUAL(vLevels[0].second.amountRemaining, 60);
+
+    // and removed, once it is filled
+    BOOST_CHECK_EQUAL(MetaDEx_ADD("b", 1, 30, 102, 3, 60, uint256S("0c"), 1), 0);
+    BOOST_CHECK(!MetaDEx_isOpen(uint256S("0a")));
+    BOOST_CHECK(get_Prices(3, 1) == nullptr);
+    BOOST_CHECK(MetaDEx_getDepth(3, 1, 10).empty());
+    BOOST_CHECK_EQUAL(GetTokenBalance("a", 3, METADEX_RESERVE), 0);
+    BOOST_CHECK_EQUAL(GetTokenBalance("b", 3, BALANCE), 100);
+
+    mp_tally_map.clear();
+    pDbTradeList = pPrevTradeList;
+    pDbSpInfo = pPrevSpInfo;
+}
+
+BOOST_AUTO_TEST_CASE(metadex_price_comparison)
+{
+    // cross-multiplied comparisons match the comparisons of normalized prices
+    FastRandomContext rng(true);
+    for (int i = 0; i < 1000; ++i) {
+        int64_t num1 = 1 + rng.randrange(std::numeric_limits<int64_t>::max());
+        int64_t den1 = 1 + rng.randrange(std::numeric_limits<int64_t>::max());
+        int64_t num2 = (i % 2) ? num1 * 2 / 3 : 1 + rng.randrange(std::numeric_limits<int64_t>::max());
+        int64_t den2 = (i % 2) ? den1 * 2 / 3 : 1 + rng.randrange(std::numeric_limits<int64_t>::max());
+        if (num2 == 0 || den2 == 0) continue;
+        BOOST_CHECK_EQUAL(xIsLess(num1, den1, num2, den2), rational_t(num1, den1) < rational_t(num2, den2));
+        BOOST_CHECK_EQUAL(xIsLess(num2, den2, num1, den1), rational_t(num2, den2) < rational_t(num1, den1));
+    }
+    BOOST_CHECK(!xIsLess(2, 4, 1, 2));
+    BOOST_CHECK(xIsLess(1, 3, 1, 2));
+
+    const CMPMetaDEx order("a", 100, 3, 50, 1, 100, uint256S("0a"), 1, 1);
+    BOOST_CHECK(order.unitPrice() == rational_t(2, 1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
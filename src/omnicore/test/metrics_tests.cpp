@@ -0,0 +1,39 @@
+#include <omnicore/metrics.h>
+
+#include <omnicore/omnicore.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_metrics_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(metrics_transactions)
+{
+    // nothing is counted, while the metrics are not served
+    CountMetricsTransaction(MSC_TYPE_SIMPLE_SEND, true);
+    BOOST_CHECK(GetMetrics().find("omni_transactions_total{") == std::string::npos);
+
+    StartMetrics();
+    CountMetricsBlock();
+    CountMetricsTransaction(MSC_TYPE_SIMPLE_SEND, true);
+    CountMetricsTransaction(MSC_TYPE_SIMPLE_SEND, true);
+    CountMetricsTransaction(MSC_TYPE_SIMPLE_SEND, false);
+    const std::string metrics = GetMetrics();
+    StopMetrics();
+
+    BOOST_CHECK(metrics.find("# TYPE omni_blocks_processed_total counter\nomni_blocks_processed_total 1\n") != std::string::npos);
+    BOOST_CHECK(metrics.find("omni_transactions_total{type=\"Simple Send\",valid=\"true\"} 2\n") != std::string::npos);
+    BOOST_CHECK(metrics.find("omni_transactions_total{type=\"Simple Send\",valid=\"false\"} 1\n") != std::string::npos);
+
+    // every family is declared once
+    BOOST_CHECK(metrics.find("# TYPE omni_metadex_orders gauge\n") != std::string::npos);
+    BOOST_CHECK(metrics.find("# TYPE omni_rpc_duration_seconds histogram\n") != std::string::npos);
+    BOOST_CHECK_EQUAL(metrics.find("# TYPE omni_memory_bytes"), metrics.rfind("# TYPE omni_memory_bytes"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
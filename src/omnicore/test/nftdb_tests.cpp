@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <test/util/setup_common.h>
 
@@ -126,4 +127,92 @@ BOOST_AUTO_TEST_CASE(nftdb_test_sequence)
     delete UITDb;
 }
 
+BOOST_AUTO_TEST_CASE(nftdb_neighbouring_properties)
+{
+    LOCK(cs_tally);
+    auto UITDb = new CMPNonFungibleTokensDB(GetDataDir() / "OMNI_nftdb", true);
+
+    // ranges of the neighbouring properties and other types are not mixed up
+    UITDb->CreateNonFungibleTokens(49, 10, "Alice", "grant49");
+    UITDb->CreateNonFungibleTokens(51, 30, "Charles", "grant51");
+    BOOST_CHECK_EQUAL(0, UITDb->GetHighestRangeEnd(50));
+    BOOST_CHECK_EQUAL("", UITDb->GetNonFungibleTokenOwner(50, 5));
+
+    UITDb->CreateNonFungibleTokens(50, 20, "Bob", "grant50");
+    BOOST_CHECK_EQUAL(10, UITDb->GetHighestRangeEnd(49));
+    BOOST_CHECK_EQUAL(20, UITDb->GetHighestRangeEnd(50));
+    BOOST_CHECK_EQUAL(30, UITDb->GetHighestRangeEnd(51));
+    BOOST_CHECK_EQUAL("Alice", UITDb->GetNonFungibleTokenOwner(49, 10));
+    BOOST_CHECK_EQUAL("", UITDb->GetNonFungibleTokenOwner(49, 11));
+    BOOST_CHECK_EQUAL("Bob", UITDb->GetNonFungibleTokenOwner(50, 1));
+    BOOST_CHECK_EQUAL("", UITDb->GetNonFungibleTokenOwner(50, 0));
+    BOOST_CHECK_EQUAL("", UITDb->GetNonFungibleTokenOwner(50, 21));
+    BOOST_CHECK_EQUAL("grant50", UITDb->GetNonFungibleTokenData(50, 20, NonFungibleStorage::GrantData));
+
+    // a range starting at the token itself is found
+    BOOST_CHECK(UITDb->MoveNonFungibleTokens(50, 11, 20, "Bob", "Alice"));
+    BOOST_CHECK_EQUAL("Alice", UITDb->GetNonFungibleTokenOwner(50, 11));
+    BOOST_CHECK_EQUAL("Bob", UITDb->GetNonFungibleTokenOwner(50, 10));
+    BOOST_CHECK(UITDb->GetRange(50, 11, NonFungibleStorage::RangeIndex) == std::make_pair(int64_t{11}, int64_t{20}));
+    BOOST_CHECK_EQUAL(1U, UITDb->GetAddressNonFungibleTokens(50, "Alice").size());
+    BOOST_CHECK_EQUAL(2U, UITDb->GetAddressNonFungibleTokens(0, "Alice").size());
+    BOOST_CHECK_EQUAL(2U, UITDb->GetNonFungibleTokenRanges(50).size());
+
+    // pages of ranges start after the first token of the last range of the previous page
+    auto page = UITDb->GetNonFungibleTokenRanges(50, 0, 1);
+    BOOST_CHECK_EQUAL(1U, page.size());
+    BOOST_CHECK(page[0].second == std::make_pair(int64_t{1}, int64_t{10}));
+    page = UITDb->GetNonFungibleTokenRanges(50, page[0].second.first, 1);
+    BOOST_CHECK_EQUAL(1U, page.size());
+    BOOST_CHECK_EQUAL("Alice", page[0].first);
+    BOOST_CHECK(page[0].second == std::make_pair(int64_t{11}, int64_t{20}));
+    BOOST_CHECK(UITDb->GetNonFungibleTokenRanges(50, 11, 1).empty());
+
+    delete UITDb;
+}
+
+BOOST_AUTO_TEST_CASE(nftdb_range_cache)
+{
+    LOCK(cs_tally);
+    auto UITDb = new CMPNonFungibleTokensDB(GetDataDir() / "OMNI_nftdb_cache", true);
+
+    UITDb->CreateNonFungibleTokens(60, 100, "Alice", "grant60");
+    BOOST_CHECK(UITDb->MoveNonFungibleTokens(60, 41, 60, "Alice", "Bob"));
+    BOOST_CHECK(UITDb->ChangeNonFungibleTokenData(60, 50, 70, "holder", NonFungibleStorage::HolderData));
+    delete UITDb;
+
+    // the ranges are loaded from the database, when they are looked up for the first time
+    UITDb = new CMPNonFungibleTokensDB(GetDataDir() / "OMNI_nftdb_cache", false);
+    BOOST_CHECK_EQUAL("Bob", UITDb->GetNonFungibleTokenOwner(60, 41));
+    BOOST_CHECK_EQUAL("Alice", UITDb->GetNonFungibleTokenOwner(60, 61));
+    BOOST_CHECK(UITDb->GetRange(60, 50, NonFungibleStorage::RangeIndex) == std::make_pair(int64_t{41}, int64_t{60}));
+    BOOST_CHECK(UITDb->GetRange(60, 70, NonFungibleStorage::HolderData) == std::make_pair(int64_t{50}, int64_t{70}));
+    BOOST_CHECK_EQUAL("", UITDb->GetNonFungibleTokenData(60, 49, NonFungibleStorage::HolderData));
+    BOOST_CHECK_EQUAL(100, UITDb->GetHighestRangeEnd(60));
+
+    // writes keep the cached ranges and the database in sync
+    BOOST_CHECK(UITDb->MoveNonFungibleTokens(60, 41, 60, "Bob", "Alice"));
+    BOOST_CHECK(UITDb->GetRange(60, 50, NonFungibleStorage::RangeIndex) == std::make_pair(int64_t{1}, int64_t{100}));
+    BOOST_CHECK_EQUAL(1U, UITDb->GetNonFungibleTokenRanges(60).size());
+    UITDb->CreateNonFungibleTokens(60, 10, "Bob", "grant60");
+    BOOST_CHECK_EQUAL(110, UITDb->GetHighestRangeEnd(60));
+    BOOST_CHECK_EQUAL("Bob", UITDb->GetNonFungibleTokenOwner(60, 101));
+
+    // the owner index follows the moved and merged ranges
+    auto owned = UITDb->GetAddressNonFungibleTokens(0, "Bob");
+    BOOST_CHECK_EQUAL(1U, owned.size());
+    BOOST_CHECK(owned[60] == (std::vector<std::pair<int64_t, int64_t>>{{101, 110}}));
+    owned = UITDb->GetAddressNonFungibleTokens(60, "Alice");
+    BOOST_CHECK(owned[60] == (std::vector<std::pair<int64_t, int64_t>>{{1, 100}}));
+    BOOST_CHECK(UITDb->GetAddressNonFungibleTokens(61, "Alice").empty());
+    BOOST_CHECK(UITDb->GetAddressNonFungibleTokens(0, "Ali").empty());
+
+    // clearing the database drops the cached ranges
+    UITDb->Clear();
+    BOOST_CHECK_EQUAL("", UITDb->GetNonFungibleTokenOwner(60, 1));
+    BOOST_CHECK_EQUAL(0, UITDb->GetHighestRangeEnd(60));
+
+    delete UITDb;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
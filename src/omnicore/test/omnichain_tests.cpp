@@ -0,0 +1,94 @@
+#include <omnicore/omnicore.h>
+#include <omnicore/parsing.h>
+#include <omnicore/tx.h>
+
+#include <chainparams.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <sync.h>
+#include <validation.h>
+
+#include <test/util/omnichain.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_omnichain_tests, RegTestingSetup)
+
+static OmniChainSpec GetSmallSpec()
+{
+    OmniChainSpec spec;
+    spec.nProperties = 2;
+    spec.nHolders = 20;
+    spec.nOrders = 5;
+    spec.nNftRanges = 5;
+    spec.nStoRecipients = 5;
+    spec.nTxPerBlock = 10;
+    return spec;
+}
+
+BOOST_AUTO_TEST_CASE(omnichain_deterministic)
+{
+    OmniChainSpec spec = GetSmallSpec();
+    const std::vector<CBlock> vBlocksA = GenerateOmniChain(spec);
+    const std::vector<CBlock> vBlocksB = GenerateOmniChain(spec);
+    spec.nSeed = 2;
+    const std::vector<CBlock> vBlocksC = GenerateOmniChain(spec);
+
+    BOOST_CHECK_EQUAL(vBlocksA.size(), vBlocksB.size());
+    BOOST_CHECK(vBlocksA.back().GetHash() == vBlocksB.back().GetHash());
+    BOOST_CHECK(vBlocksA.back().GetHash() != vBlocksC.back().GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(omnichain_connects)
+{
+    const std::vector<CBlock> vBlocks = GenerateOmniChain(GetSmallSpec());
+
+    // crowdsale, 2 + 1 + 1 issuances, grant, 20 + 5 sends, STO, 5 NFT sends and 5 orders
+    const int nOmniTransactions = 1 + 4 + 1 + 25 + 1 + 5 + 5;
+    BOOST_CHECK_EQUAL(vBlocks.size(), (size_t) GetOmniChainFundingBlocks() + (nOmniTransactions + 9) / 10);
+
+    for (const CBlock& block : vBlocks) {
+        BOOST_CHECK(ProcessNewBlock(Params(), std::make_shared<const CBlock>(block), true, nullptr));
+    }
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(::ChainActive().Height(), (int) vBlocks.size());
+        BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == vBlocks.back().GetHash());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(omnichain_payloads)
+{
+    const std::vector<CBlock> vBlocks = GenerateOmniChain(GetSmallSpec());
+
+    std::map<unsigned int, int> mapTypes;
+    for (unsigned int nHeight = 1; nHeight <= vBlocks.size(); ++nHeight) {
+        const CBlock& block = vBlocks[nHeight - 1];
+        for (unsigned int idx = 0; idx < block.vtx.size(); ++idx) {
+            AddCoins(view, *block.vtx[idx], nHeight);
+            if (idx == 0 || (int) nHeight <= GetOmniChainFundingBlocks()) continue;
+
+            CMPTransaction mp_obj;
+            if (0 == ParseTransaction(*block.vtx[idx], nHeight, idx, mp_obj) && mp_obj.interpret_Transaction()) {
+                ++mapTypes[mp_obj.getType()];
+            }
+        }
+    }
+
+    BOOST_CHECK_EQUAL(mapTypes[MSC_TYPE_CREATE_PROPERTY_FIXED], 3);
+    BOOST_CHECK_EQUAL(mapTypes[MSC_TYPE_CREATE_PROPERTY_MANUAL], 1);
+    BOOST_CHECK_EQUAL(mapTypes[MSC_TYPE_GRANT_PROPERTY_TOKENS], 1);
+    BOOST_CHECK_EQUAL(mapTypes[MSC_TYPE_SIMPLE_SEND], 25);
+    BOOST_CHECK_EQUAL(mapTypes[MSC_TYPE_SEND_TO_OWNERS], 1);
+    BOOST_CHECK_EQUAL(mapTypes[MSC_TYPE_SEND_NONFUNGIBLE], 5);
+    BOOST_CHECK_EQUAL(mapTypes[MSC_TYPE_METADEX_TRADE], 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
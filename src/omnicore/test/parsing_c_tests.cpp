@@ -2,6 +2,7 @@
 
 #include <omnicore/createpayload.h>
 #include <omnicore/encoding.h>
+#include <omnicore/inputcache.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/parsing.h>
 #include <omnicore/rules.h>
@@ -429,5 +430,36 @@ BOOST_AUTO_TEST_CASE(multiple_op_return_pushes)
     }
 }
 
+BOOST_AUTO_TEST_CASE(provided_inputs)
+{
+    int nBlock = ConsensusParams().NULLDATA_BLOCK;
+
+    CMutableTransaction inputTx;
+    inputTx.vout.push_back(createTxOut(5000000, "1NNQKWM8mC35pBNPxV1noWFZEw7A5X6zXz"));
+    const COutPoint prevout(CTransaction(inputTx).GetHash(), 0);
+
+    CMutableTransaction mutableTx;
+    mutableTx.vin.push_back(CTxIn(prevout));
+    mutableTx.vout.push_back(OpReturn_SimpleSend());
+    mutableTx.vout.push_back(createTxOut(2700000, EncodeDestination(ExodusAddress())));
+    CTransaction dummyTx(mutableTx);
+
+    // the inputs are provided by the caller, instead of the shared coins view
+    CCoinsView viewDummy;
+    CCoinsViewCache viewInputs(&viewDummy);
+    Coin newcoin;
+    newcoin.out = inputTx.vout[0];
+    viewInputs.AddCoin(prevout, std::move(newcoin), true);
+
+    CMPTransaction metaTx;
+    BOOST_CHECK_EQUAL(ParseTransaction(dummyTx, nBlock, 1, metaTx, 0, &viewInputs), 0);
+    BOOST_CHECK_EQUAL(metaTx.getSender(), "1NNQKWM8mC35pBNPxV1noWFZEw7A5X6zXz");
+    BOOST_CHECK_EQUAL(metaTx.getFeePaid(), 2300000);
+
+    // and not remembered
+    BOOST_CHECK(!view.HaveCoin(prevout));
+    Coin cached;
+    BOOST_CHECK(!inputCache.Get(prevout, cached));
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,92 @@
+#include <omnicore/payload.h>
+
+#include <span.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_payload_tests, BasicTestingSetup)
+
+/** Returns a reader of the payload, which is followed by the padding. */
+static CPayloadReader Reader(const std::vector<unsigned char>& vch, size_t size, size_t pos = 0)
+{
+    return CPayloadReader(MakeSpan(vch), size, pos);
+}
+
+BOOST_AUTO_TEST_CASE(payload_round_trip)
+{
+    std::vector<unsigned char> vch = CPayloadWriter(1, 50)
+            .WriteU8(2)
+            .WriteU16(0x0102)
+            .WriteU32(0x01020304)
+            .WriteU64(0x0102030405060708ULL)
+            .WriteString("Omni", 255)
+            .WriteString("truncated", 5)
+            .Release();
+    BOOST_CHECK_EQUAL(vch.size(), 4U + 1 + 2 + 4 + 8 + 5 + 6);
+    BOOST_CHECK_EQUAL(vch[0], 0x00);
+    BOOST_CHECK_EQUAL(vch[1], 0x01);
+    BOOST_CHECK_EQUAL(vch[2], 0x00);
+    BOOST_CHECK_EQUAL(vch[3], 0x32);
+
+    const size_t size = vch.size();
+    vch.resize(size + 32, 0);
+    CPayloadReader reader = Reader(vch, size);
+    BOOST_CHECK_EQUAL(reader.ReadU16(), 1);
+    BOOST_CHECK_EQUAL(reader.ReadU16(), 50);
+    BOOST_CHECK_EQUAL(reader.ReadU8(), 2);
+    BOOST_CHECK_EQUAL(reader.ReadU16(), 0x0102);
+    BOOST_CHECK_EQUAL(reader.ReadU32(), 0x01020304U);
+    BOOST_CHECK_EQUAL(reader.ReadU64(), 0x0102030405060708ULL);
+    BOOST_CHECK_EQUAL(reader.ReadString(255), "Omni");
+    BOOST_CHECK_EQUAL(reader.ReadString(3), "tru");
+    BOOST_CHECK_EQUAL(reader.GetPosition(), size);
+    BOOST_CHECK(!reader.IsOverrun());
+}
+
+BOOST_AUTO_TEST_CASE(payload_overrun)
+{
+    std::vector<unsigned char> vch = CPayloadWriter(0, 0).WriteU32(7).Release();
+    const size_t size = vch.size();
+    vch.resize(size + 32, 0);
+
+    // fields past the end of the payload are read from the padding
+    CPayloadReader reader = Reader(vch, size, 4);
+    BOOST_CHECK_EQUAL(reader.ReadU32(), 7U);
+    BOOST_CHECK(!reader.IsOverrun());
+    BOOST_CHECK_EQUAL(reader.ReadU8(), 0);
+    BOOST_CHECK(!reader.IsOverrun()); // one byte past the end is tolerated
+    BOOST_CHECK_EQUAL(reader.ReadU8(), 0);
+    BOOST_CHECK(reader.IsOverrun());
+
+    // reads beyond the padding yield zeros
+    CPayloadReader readerPadding = Reader(vch, size, 4);
+    BOOST_CHECK_EQUAL(readerPadding.ReadString(255), "");
+    BOOST_CHECK_EQUAL(readerPadding.ReadString(255), "");
+    for (int i = 0; i < 8; ++i) readerPadding.ReadU64();
+    BOOST_CHECK_EQUAL(readerPadding.ReadU64(), 0U);
+    BOOST_CHECK(readerPadding.IsOverrun());
+
+    unsigned char buf[4] = {1, 2, 3, 4};
+    readerPadding.ReadBytes(buf, sizeof(buf));
+    BOOST_CHECK_EQUAL(buf[0], 0);
+    BOOST_CHECK_EQUAL(buf[3], 0);
+}
+
+BOOST_AUTO_TEST_CASE(payload_unterminated_string)
+{
+    std::vector<unsigned char> vch = {'a', 'b', 'c'};
+
+    CPayloadReader reader = Reader(vch, vch.size());
+    BOOST_CHECK_EQUAL(reader.ReadString(255), "");
+    BOOST_CHECK(reader.IsOverrun());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
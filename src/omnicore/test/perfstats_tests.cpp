@@ -0,0 +1,103 @@
+#include <omnicore/perfstats.h>
+
+#include <test/util/setup_common.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+#include <string>
+
+using namespace mastercore;
+
+namespace {
+const UniValue* FindPhase(const UniValue& stats, const std::string& name)
+{
+    for (const UniValue& phase : stats["phases"].getValues()) {
+        if (phase["phase"].get_str() == name) return &phase;
+    }
+    return nullptr;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_perfstats_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(perfstats_series_percentiles)
+{
+    CPerfSeries series;
+    BOOST_CHECK_EQUAL(series.GetPercentile99(), 0);
+    BOOST_CHECK_EQUAL(series.GetRecentPercentile99(100), 0);
+
+    // 99 fast blocks and one slow block
+    for (int n = 0; n < 99; ++n) {
+        series.Add(100);
+    }
+    series.Add(50000);
+
+    BOOST_CHECK_EQUAL(series.GetBlocks(), 100U);
+    BOOST_CHECK_EQUAL(series.GetRecentPercentile99(100), 100);
+    BOOST_CHECK_EQUAL(series.GetRecentPercentile99(1), 50000);
+    // 100 microseconds are in the bucket up to 128 microseconds
+    BOOST_CHECK_EQUAL(series.GetPercentile99(), 128);
+
+    series.Add(50000);
+    BOOST_CHECK_EQUAL(series.GetRecentPercentile99(101), 50000);
+    // the bucket limit is capped by the slowest block
+    BOOST_CHECK_EQUAL(series.GetPercentile99(), 50000);
+
+    UniValue json = series.ToJSON(2);
+    BOOST_CHECK_EQUAL(json["blocks"].get_int(), 101);
+    BOOST_CHECK_EQUAL(json["maxtime"].get_real(), 0.05);
+    BOOST_CHECK_EQUAL(json["recent"]["blocks"].get_int(), 2);
+    BOOST_CHECK_EQUAL(json["recent"]["mintime"].get_real(), 0.05);
+    BOOST_CHECK_EQUAL(json["recent"]["avgtime"].get_real(), 0.05);
+}
+
+BOOST_AUTO_TEST_CASE(perfstats_series_recent_blocks)
+{
+    CPerfSeries series;
+    for (size_t n = 0; n < PERF_RECENT_BLOCKS + 10; ++n) {
+        series.Add(n);
+    }
+
+    UniValue json = series.ToJSON(PERF_RECENT_BLOCKS + 10);
+    BOOST_CHECK_EQUAL(json["blocks"].get_int(), (int) PERF_RECENT_BLOCKS + 10);
+    BOOST_CHECK_EQUAL(json["mintime"].get_real(), 0.0);
+    BOOST_CHECK_EQUAL(json["recent"]["blocks"].get_int(), (int) PERF_RECENT_BLOCKS);
+    BOOST_CHECK_EQUAL(json["recent"]["mintime"].get_real(), 10 / 1000000.0);
+}
+
+BOOST_AUTO_TEST_CASE(perfstats_blocks)
+{
+    GetPerfStats(0, true);
+
+    AddPerfTime(PERF_PARSE, 300);
+    AddPerfTime(PERF_PARSE, 200);
+    AddPerfTypeTime(0, 100);
+    EndPerfBlock();
+    AddPerfTime(PERF_PARSE, 100);
+    EndPerfBlock();
+
+    UniValue stats = GetPerfStats(PERF_RECENT_BLOCKS, true);
+    BOOST_CHECK_EQUAL(stats["blocks"].get_int(), 2);
+
+    const UniValue* parse = FindPhase(stats, "parse");
+    BOOST_REQUIRE(parse != nullptr);
+    BOOST_CHECK_EQUAL((*parse)["blocks"].get_int(), 2);
+    BOOST_CHECK_EQUAL((*parse)["maxtime"].get_real(), 500 / 1000000.0);
+    BOOST_CHECK_EQUAL((*parse)["mintime"].get_real(), 100 / 1000000.0);
+
+    // the type was only seen in the first block
+    BOOST_REQUIRE_EQUAL(stats["types"].size(), 1U);
+    BOOST_CHECK_EQUAL(stats["types"][0]["type_int"].get_int(), 0);
+    BOOST_CHECK_EQUAL(stats["types"][0]["blocks"].get_int(), 1);
+
+    // the statistics were reset
+    stats = GetPerfStats(PERF_RECENT_BLOCKS, false);
+    BOOST_CHECK_EQUAL(stats["blocks"].get_int(), 0);
+    BOOST_CHECK_EQUAL(stats["types"].size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,244 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/persistence.h>
+#include <omnicore/sp.h>
+#include <omnicore/statefile.h>
+#include <omnicore/tally.h>
+
+#include <chain.h>
+#include <fs.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <string>
+
+extern fs::path pathStateFiles;
+
+using namespace mastercore;
+
+namespace {
+struct PersistenceTestingSetup : BasicTestingSetup
+{
+    fs::path pathPrev;
+
+    PersistenceTestingSetup()
+    {
+        LOCK(cs_tally);
+        pathPrev = pathStateFiles;
+        pathStateFiles = GetDataDir() / "MP_persist_test";
+        TryCreateDirectories(pathStateFiles);
+        pDbSpInfo = new CMPSPInfo(GetDataDir() / "MP_spinfo_persist", true);
+        mp_tally_map.clear();
+    }
+
+    ~PersistenceTestingSetup()
+    {
+        StopStatePersistence();
+        LOCK(cs_tally);
+        mp_tally_map.clear();
+        ClearFreezeState();
+        delete pDbSpInfo;
+        pDbSpInfo = nullptr;
+        pathStateFiles = pathPrev;
+    }
+};
+
+fs::path GetBalancesFile(const uint256& blockHash)
+{
+    return pathStateFiles / strprintf("balances-%s.dat", blockHash.ToString());
+}
+
+int GetFileType(const fs::path& path)
+{
+    CMappedStateFile mapped(path);
+    CStateFileReader reader(mapped.data(), mapped.size());
+    return reader.IsValid() ? reader.GetType() : -1;
+}
+
+uint256 GetWatermark()
+{
+    LOCK(cs_tally);
+    uint256 watermark;
+    pDbSpInfo->getWatermark(watermark);
+    return watermark;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_persistence_tests, PersistenceTestingSetup)
+
+BOOST_AUTO_TEST_CASE(persist_synchronous)
+{
+    const uint256 blockHash = uint256S("5a2d2a9e7c5c0ad7d3e0e1fa3b8bd7d0e1c1f4b6f1d8b1a4a2c6d0f7a3b9e001");
+    CBlockIndex index;
+    index.phashBlock = &blockHash;
+    index.nHeight = 1000;
+
+    {
+        LOCK(cs_tally);
+        mp_tally_map.UpdateMoney(mp_tally_map.AddAddress("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb"), 3, 500, BALANCE);
+        BOOST_CHECK_EQUAL(PersistInMemoryState(&index), 0);
+    }
+
+    // without the background thread the state is written immediately
+    BOOST_CHECK(fs::exists(GetBalancesFile(blockHash)));
+    BOOST_CHECK(GetWatermark() == blockHash);
+}
+
+BOOST_AUTO_TEST_CASE(persist_manifest)
+{
+    const uint256 blockHash = uint256S("5a2d2a9e7c5c0ad7d3e0e1fa3b8bd7d0e1c1f4b6f1d8b1a4a2c6d0f7a3b9e006");
+    CBlockIndex index;
+    index.phashBlock = &blockHash;
+    index.nHeight = 1005;
+
+    {
+        LOCK(cs_tally);
+        mp_tally_map.UpdateMoney(mp_tally_map.AddAddress("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb"), 3, 500, BALANCE);
+        BOOST_CHECK_EQUAL(PersistInMemoryState(&index), 0);
+    }
+
+    // the manifest marks the state as complete, and no temporary files are left behind
+    BOOST_CHECK_EQUAL(GetFileType(pathStateFiles / strprintf("manifest-%s.dat", blockHash.ToString())), 0x40);
+    for (fs::directory_iterator it(pathStateFiles); it != fs::directory_iterator(); ++it) {
+        BOOST_CHECK(it->path().extension() != ".tmp");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(persist_asynchronous)
+{
+    const uint256 blockHash = uint256S("5a2d2a9e7c5c0ad7d3e0e1fa3b8bd7d0e1c1f4b6f1d8b1a4a2c6d0f7a3b9e002");
+    CBlockIndex index;
+    index.phashBlock = &blockHash;
+    index.nHeight = 1001;
+
+    StartStatePersistence();
+    {
+        LOCK(cs_tally);
+        mp_tally_map.UpdateMoney(mp_tally_map.AddAddress("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb"), 3, 700, BALANCE);
+        BOOST_CHECK_EQUAL(PersistInMemoryState(&index), 0);
+
+        // changes after the block don't affect the queued state
+        mp_tally_map.UpdateMoney(mp_tally_map.AddAddress("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb"), 3, 100, BALANCE);
+    }
+
+    // the watermark is moved, once the state was written
+    FlushStatePersistence();
+    BOOST_CHECK(fs::exists(GetBalancesFile(blockHash)));
+    BOOST_CHECK(GetWatermark() == blockHash);
+
+    LOCK(cs_tally);
+    BOOST_CHECK_EQUAL(RestoreInMemoryState(GetBalancesFile(blockHash).string(), 0, true), 0);
+    const CMPTally* pTally = mp_tally_map.Get("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb");
+    BOOST_REQUIRE(pTally != nullptr);
+    BOOST_CHECK_EQUAL(pTally->getMoney(3, BALANCE), 700);
+}
+
+BOOST_AUTO_TEST_CASE(persist_delta)
+{
+    const uint256 baseHash = uint256S("5a2d2a9e7c5c0ad7d3e0e1fa3b8bd7d0e1c1f4b6f1d8b1a4a2c6d0f7a3b9e003");
+    const uint256 deltaHash = uint256S("5a2d2a9e7c5c0ad7d3e0e1fa3b8bd7d0e1c1f4b6f1d8b1a4a2c6d0f7a3b9e004");
+    CBlockIndex baseIndex;
+    baseIndex.phashBlock = &baseHash;
+    baseIndex.nHeight = 1002;
+    CBlockIndex deltaIndex;
+    deltaIndex.phashBlock = &deltaHash;
+    deltaIndex.nHeight = 1003;
+    deltaIndex.pprev = &baseIndex;
+
+    const std::string addressA = "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb";
+    const std::string addressB = "1Q3ksmXpemEHmqgkATxeUdVYg5okc6G5dT";
+    const std::string addressC = "3Gy2BbEvq4iqdfaYLfBhoxsoLE7DvqWZTp";
+
+    {
+        LOCK(cs_tally);
+        mp_tally_map.UpdateMoney(mp_tally_map.AddAddress(addressA), 3, 500, BALANCE);
+        mp_tally_map.UpdateMoney(mp_tally_map.AddAddress(addressB), 3, 200, BALANCE);
+        BOOST_CHECK_EQUAL(PersistInMemoryState(&baseIndex), 0);
+
+        mp_tally_map.UpdateMoney(mp_tally_map.AddAddress(addressB), 3, -200, BALANCE);
+        mp_tally_map.UpdateMoney(mp_tally_map.AddAddress(addressC), 3, 200, BALANCE);
+        BOOST_CHECK_EQUAL(PersistInMemoryState(&deltaIndex), 0);
+    }
+
+    // only the modified addresses are stored
+    BOOST_CHECK_EQUAL(GetFileType(GetBalancesFile(baseHash)), 0);
+    BOOST_CHECK_EQUAL(GetFileType(GetBalancesFile(deltaHash)), 0x80);
+
+    // restoring the delta loads its base first
+    LOCK(cs_tally);
+    mp_tally_map.clear();
+    BOOST_CHECK_EQUAL(RestoreInMemoryState(GetBalancesFile(deltaHash).string(), 0, true), 0);
+    BOOST_CHECK_EQUAL(mp_tally_map.Get(addressA)->getMoney(3, BALANCE), 500);
+    BOOST_CHECK_EQUAL(mp_tally_map.Get(addressB)->getMoney(3, BALANCE), 0);
+    BOOST_CHECK_EQUAL(mp_tally_map.Get(addressC)->getMoney(3, BALANCE), 200);
+    BOOST_CHECK_EQUAL(mp_tally_map.GetTotalTokens(3), 700);
+
+    // the base is still complete
+    BOOST_CHECK_EQUAL(RestoreInMemoryState(GetBalancesFile(baseHash).string(), 0, true), 0);
+    BOOST_CHECK_EQUAL(mp_tally_map.Get(addressB)->getMoney(3, BALANCE), 200);
+    BOOST_CHECK(mp_tally_map.Get(addressC) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(persist_compressed)
+{
+    const uint256 blockHash = uint256S("5a2d2a9e7c5c0ad7d3e0e1fa3b8bd7d0e1c1f4b6f1d8b1a4a2c6d0f7a3b9e007");
+    CBlockIndex index;
+    index.phashBlock = &blockHash;
+    index.nHeight = 1006;
+
+    gArgs.ForceSetArg("-omnistatecompression", "1");
+    {
+        LOCK(cs_tally);
+        mp_tally_map.UpdateMoney(mp_tally_map.AddAddress("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb"), 3, 500, BALANCE);
+        mp_tally_map.UpdateMoney(mp_tally_map.AddAddress("1Q3ksmXpemEHmqgkATxeUdVYg5okc6G5dT"), 3, 200, BALANCE);
+        BOOST_CHECK_EQUAL(PersistInMemoryState(&index), 0);
+    }
+    gArgs.ForceSetArg("-omnistatecompression", "0");
+
+    // the stored file is compressed, and restored like any other
+    CMappedStateFile mapped(GetBalancesFile(blockHash));
+    BOOST_CHECK(IsCompressedStateFile(mapped.data(), mapped.size()));
+    BOOST_CHECK(mapped.Decompress());
+    BOOST_CHECK(CStateFileReader::IsStateFile(mapped.data(), mapped.size()));
+
+    LOCK(cs_tally);
+    mp_tally_map.clear();
+    BOOST_CHECK_EQUAL(RestoreInMemoryState(GetBalancesFile(blockHash).string(), 0, true), 0);
+    BOOST_CHECK_EQUAL(mp_tally_map.Get("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb")->getMoney(3, BALANCE), 500);
+    BOOST_CHECK_EQUAL(mp_tally_map.GetTotalTokens(3), 700);
+}
+
+BOOST_AUTO_TEST_CASE(persist_freeze_state)
+{
+    const uint256 blockHash = uint256S("5a2d2a9e7c5c0ad7d3e0e1fa3b8bd7d0e1c1f4b6f1d8b1a4a2c6d0f7a3b9e005");
+    CBlockIndex index;
+    index.phashBlock = &blockHash;
+    index.nHeight = 1004;
+
+    const std::string address = "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb";
+    const fs::path path = pathStateFiles / strprintf("freeze-%s.dat", blockHash.ToString());
+
+    LOCK(cs_tally);
+    enableFreezing(3, 1000);
+    enableFreezing(4, 1010);
+    freezeAddress(address, 3);
+    BOOST_CHECK_EQUAL(PersistInMemoryState(&index), 0);
+    BOOST_CHECK(fs::exists(path));
+
+    ClearFreezeState();
+    BOOST_CHECK_EQUAL(RestoreInMemoryState(path.string(), 6, true), 0);
+    BOOST_CHECK(isFreezingEnabled(3, 1004));
+    BOOST_CHECK(!isFreezingEnabled(4, 1004));
+    BOOST_CHECK(isFreezingEnabled(4, 1010));
+    BOOST_CHECK(isAddressFrozen(address, 3));
+    BOOST_CHECK_EQUAL(GetFrozenAddresses().size(), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
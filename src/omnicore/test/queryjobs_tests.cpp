@@ -0,0 +1,95 @@
+#include <omnicore/queryjobs.h>
+#include <omnicore/workerpool.h>
+
+#include <rpc/protocol.h>
+#include <rpc/request.h>
+#include <uint256.h>
+#include <util/time.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <univalue.h>
+
+#include <stdexcept>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_queryjobs_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(queryjobs_result)
+{
+    // without worker threads, the calls are executed right away
+    CWorkerPool pool(0, "omnitest");
+    CQueryJobStore store(DEFAULT_QUERY_JOBS, DEFAULT_QUERY_JOB_TIMEOUT, &pool);
+    const int64_t nTime = GetTime();
+
+    const uint256 idDone = store.Submit("omni_test", [] { return UniValue(42); }, nTime);
+    const uint256 idError = store.Submit("omni_test", []() -> UniValue { throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid"); }, nTime);
+    const uint256 idException = store.Submit("omni_test", []() -> UniValue { throw std::runtime_error("broken"); }, nTime);
+    BOOST_CHECK_EQUAL(store.Size(), 3U);
+
+    CQueryJob job("", 0);
+    BOOST_REQUIRE(store.Get(idDone, nTime, job));
+    BOOST_CHECK_EQUAL(job.strMethod, "omni_test");
+    BOOST_CHECK_EQUAL(job.GetStatusName(), "done");
+    BOOST_CHECK_EQUAL(job.result->get_int(), 42);
+
+    BOOST_REQUIRE(store.Get(idError, nTime, job));
+    BOOST_CHECK_EQUAL(job.GetStatusName(), "failed");
+    BOOST_CHECK_EQUAL(find_value(*job.result, "code").get_int(), RPC_INVALID_PARAMETER);
+
+    BOOST_REQUIRE(store.Get(idException, nTime, job));
+    BOOST_CHECK_EQUAL(job.GetStatusName(), "failed");
+    BOOST_CHECK_EQUAL(find_value(*job.result, "message").get_str(), "broken");
+
+    BOOST_CHECK(!store.Get(uint256(), nTime, job));
+}
+
+BOOST_AUTO_TEST_CASE(queryjobs_background)
+{
+    CWorkerPool pool(2, "omnitest");
+    CQueryJobStore store(DEFAULT_QUERY_JOBS, DEFAULT_QUERY_JOB_TIMEOUT, &pool);
+
+    const uint256 id = store.Submit("omni_test", [] {
+        UniValue result(UniValue::VARR);
+        for (int n = 0; n < 100; ++n) result.push_back(n);
+        return result;
+    }, GetTime());
+    BOOST_REQUIRE(!id.IsNull());
+
+    // the job is polled, until it's finished
+    CQueryJob job("", 0);
+    for (int n = 0; n < 1000; ++n) {
+        BOOST_REQUIRE(store.Get(id, GetTime(), job));
+        if (job.status == CQueryJob::DONE) break;
+        UninterruptibleSleep(std::chrono::milliseconds{10});
+    }
+    BOOST_REQUIRE_EQUAL(job.GetStatusName(), "done");
+    BOOST_CHECK_EQUAL(job.result->size(), 100U);
+}
+
+BOOST_AUTO_TEST_CASE(queryjobs_limits)
+{
+    CWorkerPool pool(0, "omnitest");
+    CQueryJobStore store(2, 60, &pool);
+    const int64_t nTime = GetTime();
+
+    const uint256 idA = store.Submit("omni_test", [] { return UniValue(1); }, nTime);
+    const uint256 idB = store.Submit("omni_test", [] { return UniValue(2); }, nTime + 30);
+    BOOST_CHECK(idA != idB);
+
+    // no more jobs are accepted, while the others are kept
+    BOOST_CHECK(store.Submit("omni_test", [] { return UniValue(3); }, nTime + 40).IsNull());
+
+    // the first result expires, after it wasn't read within the timeout
+    CQueryJob job("", 0);
+    BOOST_CHECK(store.Get(idB, nTime + 50, job));
+    BOOST_CHECK(!store.Get(idA, nTime + 70, job));
+    BOOST_CHECK(store.Get(idB, nTime + 70, job));
+    BOOST_CHECK(!store.Submit("omni_test", [] { return UniValue(3); }, nTime + 71).IsNull());
+    BOOST_CHECK_EQUAL(store.Size(), 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,66 @@
+#include <omnicore/createtx.h>
+#include <omnicore/rawtxsession.h>
+
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <uint256.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_rawtxsession_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(rawtxsession_build)
+{
+    CRawTxSessionStore store;
+    const uint256 id = store.Create(CMutableTransaction(), 1000);
+    BOOST_CHECK(!id.IsNull());
+    BOOST_CHECK_EQUAL(store.Size(), 1U);
+
+    // the previous output is kept by the session, and determines the change of a later call
+    std::vector<PrevTxsEntry> prevTxs;
+    prevTxs.push_back(PrevTxsEntry(uint256S("6779a710fcd5f6fb0883ea3306360c3ad8c0a3c5de902768ec57ef3104e65eb1"), 4, 100000,
+            CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x01) << OP_EQUALVERIFY << OP_CHECKSIG));
+    BOOST_CHECK(store.Modify(id, 1010, [&prevTxs](CRawTxSession& session) {
+        session.builder.addInputs(prevTxs);
+        InputsToView(prevTxs, session.view);
+    }));
+    BOOST_CHECK(store.Modify(id, 1020, [](CRawTxSession& session) {
+        session.builder.addOpReturn(std::vector<unsigned char>(16, 0x00));
+        session.builder.addChange("1CE8bBr1dYZRMnpmyYsFEoexa1YoPz2mfB", session.view, 10000);
+    }));
+
+    CMutableTransaction tx;
+    BOOST_CHECK(store.Finalize(id, 1030, tx));
+    BOOST_CHECK_EQUAL(tx.vin.size(), 1U);
+    BOOST_REQUIRE_EQUAL(tx.vout.size(), 2U);
+    BOOST_CHECK_EQUAL(tx.vout[0].nValue, 90000);
+
+    // a finalized session is closed
+    BOOST_CHECK_EQUAL(store.Size(), 0U);
+    BOOST_CHECK(!store.Finalize(id, 1040, tx));
+    BOOST_CHECK(!store.Modify(id, 1040, [](CRawTxSession& session) {}));
+}
+
+BOOST_AUTO_TEST_CASE(rawtxsession_limits)
+{
+    CRawTxSessionStore store(2, 60);
+    const uint256 idA = store.Create(CMutableTransaction(), 1000);
+    const uint256 idB = store.Create(CMutableTransaction(), 1030);
+    BOOST_CHECK(idA != idB);
+
+    // no more sessions are opened, while the others are in use
+    BOOST_CHECK(store.Create(CMutableTransaction(), 1050).IsNull());
+
+    // the first session expires, after it wasn't used within the timeout
+    BOOST_CHECK(!store.Modify(idA, 1061, [](CRawTxSession& session) {}));
+    BOOST_CHECK(store.Modify(idB, 1061, [](CRawTxSession& session) {}));
+    BOOST_CHECK(!store.Create(CMutableTransaction(), 1062).IsNull());
+    BOOST_CHECK_EQUAL(store.Size(), 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
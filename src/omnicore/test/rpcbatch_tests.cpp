@@ -0,0 +1,120 @@
+#include <rpc/server.h>
+#include <rpc/request.h>
+
+#include <test/util/setup_common.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+UniValue omnitest_echo(const JSONRPCRequest& request)
+{
+    return request.params[0];
+}
+
+const CRPCCommand echoCommand{"hidden", "omnitest_echo", &omnitest_echo, {"value"}};
+const CRPCCommand echoSerialCommand{"hidden", "omnitest_echoserial", &omnitest_echo, {"value"}};
+
+UniValue Call(const std::string& method, int value)
+{
+    UniValue params(UniValue::VARR);
+    params.push_back(value);
+    UniValue req(UniValue::VOBJ);
+    req.pushKV("method", method);
+    req.pushKV("params", params);
+    req.pushKV("id", value);
+    return req;
+}
+
+struct RPCBatchTestingSetup : BasicTestingSetup
+{
+    RPCBatchTestingSetup()
+    {
+        tableRPC.appendCommand(echoCommand.name, &echoCommand);
+        tableRPC.appendCommand(echoSerialCommand.name, &echoSerialCommand);
+        tableRPC.markParallel(echoCommand.name);
+        if (RPCIsInWarmup(nullptr)) SetRPCWarmupFinished();
+    }
+
+    ~RPCBatchTestingSetup()
+    {
+        tableRPC.removeCommand(echoCommand.name, &echoCommand);
+        tableRPC.removeCommand(echoSerialCommand.name, &echoSerialCommand);
+    }
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_rpcbatch_tests, RPCBatchTestingSetup)
+
+BOOST_AUTO_TEST_CASE(rpcbatch_parallel_in_order)
+{
+    UniValue batch(UniValue::VARR);
+    for (int n = 0; n < 100; ++n) {
+        batch.push_back(Call(n % 25 == 10 ? "omnitest_echoserial" : "omnitest_echo", n));
+    }
+
+    std::vector<std::thread> vThreads;
+    int nTasks = 0;
+    RPCTaskEnqueuer enqueue = [&](const std::function<void()>& task) {
+        if (++nTasks % 4 == 0) return false;
+        vThreads.emplace_back(task);
+        return true;
+    };
+
+    UniValue reply;
+    BOOST_CHECK(reply.read(JSONRPCExecBatch(JSONRPCRequest(), batch, enqueue)));
+    for (std::thread& thread : vThreads) {
+        thread.join();
+    }
+
+    BOOST_CHECK(nTasks > 0);
+    BOOST_REQUIRE_EQUAL(reply.size(), batch.size());
+    for (size_t n = 0; n < reply.size(); ++n) {
+        BOOST_CHECK_EQUAL(reply[n]["result"].get_int(), static_cast<int>(n));
+        BOOST_CHECK_EQUAL(reply[n]["id"].get_int(), static_cast<int>(n));
+        BOOST_CHECK(reply[n]["error"].isNull());
+    }
+
+    // without an enqueuer, every call is executed in order
+    UniValue serialReply;
+    BOOST_CHECK(serialReply.read(JSONRPCExecBatch(JSONRPCRequest(), batch)));
+    BOOST_CHECK_EQUAL(serialReply.write(), reply.write());
+}
+
+BOOST_AUTO_TEST_CASE(rpcbatch_parallel_errors)
+{
+    UniValue batch(UniValue::VARR);
+    batch.push_back(Call("omnitest_echo", 1));
+    UniValue invalid(UniValue::VOBJ);
+    invalid.pushKV("method", "omnitest_echo");
+    invalid.pushKV("params", "invalid");
+    invalid.pushKV("id", 2);
+    batch.push_back(invalid);
+    batch.push_back(Call("omnitest_echo", 3));
+
+    std::vector<std::thread> vThreads;
+    RPCTaskEnqueuer enqueue = [&](const std::function<void()>& task) {
+        vThreads.emplace_back(task);
+        return true;
+    };
+
+    UniValue reply;
+    BOOST_CHECK(reply.read(JSONRPCExecBatch(JSONRPCRequest(), batch, enqueue)));
+    for (std::thread& thread : vThreads) {
+        thread.join();
+    }
+
+    BOOST_REQUIRE_EQUAL(reply.size(), 3U);
+    BOOST_CHECK_EQUAL(reply[0]["result"].get_int(), 1);
+    BOOST_CHECK(reply[1]["result"].isNull());
+    BOOST_CHECK(!reply[1]["error"].isNull());
+    BOOST_CHECK_EQUAL(reply[2]["result"].get_int(), 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,83 @@
+#include <omnicore/rpcjsonstream.h>
+
+#include <test/util/setup_common.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_rpcjsonstream_tests, BasicTestingSetup)
+
+static UniValue SampleValue()
+{
+    UniValue value(UniValue::VOBJ);
+    value.pushKV("name", "Omni \"Token\"");
+    value.pushKV("amount", "1.00000000");
+    value.pushKV("divisible", true);
+    value.pushKV("empty", UniValue(UniValue::VARR));
+    UniValue nested(UniValue::VARR);
+    nested.push_back(1);
+    nested.push_back(UniValue(UniValue::VOBJ));
+    nested.push_back(NullUniValue);
+    value.pushKV("nested", nested);
+    return value;
+}
+
+BOOST_AUTO_TEST_CASE(json_stream_matches_univalue)
+{
+    std::vector<std::string> vParts;
+    CJSONStreamWriter writer([&vParts](const std::string& part) { vParts.push_back(part); }, 16);
+
+    UniValue array(UniValue::VARR);
+    for (int n = 0; n < 10; ++n) {
+        array.push_back(SampleValue());
+    }
+    writer.Value(array);
+    writer.Flush();
+
+    // the output is split into several parts, but is the same as a whole
+    BOOST_CHECK(writer.HasFlushed());
+    BOOST_CHECK(vParts.size() > 1);
+    std::string output;
+    for (const std::string& part : vParts) {
+        output += part;
+    }
+    BOOST_CHECK_EQUAL(output, array.write());
+}
+
+BOOST_AUTO_TEST_CASE(json_stream_array_writer)
+{
+    std::string output;
+    CJSONStreamWriter writer([&output](const std::string& part) { output += part; }, 32);
+
+    writer.BeginObject();
+    writer.Key("result");
+    CRPCArrayWriter entries(&writer);
+    UniValue expected(UniValue::VARR);
+    for (int n = 0; n < 5; ++n) {
+        entries.push_back(SampleValue());
+        expected.push_back(SampleValue());
+    }
+    BOOST_CHECK_EQUAL(entries.size(), 5U);
+    BOOST_CHECK(entries.Finish().isNull());
+    BOOST_CHECK(writer.IsResultWritten());
+    writer.Key("error");
+    writer.Value(NullUniValue);
+    writer.EndObject();
+    output += writer.TakeBuffer();
+
+    UniValue reply(UniValue::VOBJ);
+    reply.pushKV("result", expected);
+    reply.pushKV("error", NullUniValue);
+    BOOST_CHECK_EQUAL(output, reply.write());
+
+    // without a writer, the array is returned as a whole
+    CRPCArrayWriter collected(nullptr);
+    collected.push_back(SampleValue());
+    BOOST_CHECK_EQUAL(collected.Finish().write(), "[" + SampleValue().write() + "]");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
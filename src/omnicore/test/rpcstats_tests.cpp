@@ -0,0 +1,187 @@
+#include <omnicore/rpcstats.h>
+#include <omnicore/timedmutex.h>
+
+#include <rpc/protocol.h>
+#include <rpc/request.h>
+#include <rpc/server.h>
+#include <sync.h>
+
+#include <test/util/setup_common.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace mastercore;
+
+namespace {
+UniValue omnitest_stats(const JSONRPCRequest& request)
+{
+    if (request.params[0].isNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "missing value");
+    }
+    UniValue result(UniValue::VARR);
+    result.push_back(request.params[0]);
+    return result;
+}
+
+const CRPCCommand statsCommand{"hidden", "omnitest_stats", &omnitest_stats, {"value"}};
+
+const UniValue* FindMethod(const UniValue& stats, const std::string& name)
+{
+    for (const UniValue& method : stats["methods"].getValues()) {
+        if (method["method"].get_str() == name) return &method;
+    }
+    return nullptr;
+}
+
+const UniValue* FindLock(const UniValue& locks, const std::string& name)
+{
+    for (const UniValue& lock : locks.getValues()) {
+        if (lock["name"].get_str() == name) return &lock;
+    }
+    return nullptr;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_rpcstats_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(rpcstats_json_size)
+{
+    UniValue value(UniValue::VOBJ);
+    value.pushKV("name", "Omni");
+    value.pushKV("amount", "1.00000000");
+    value.pushKV("number", 12345);
+    value.pushKV("divisible", false);
+    value.pushKV("empty", UniValue(UniValue::VOBJ));
+    UniValue array(UniValue::VARR);
+    array.push_back(NullUniValue);
+    array.push_back(true);
+    array.push_back(1.5);
+    value.pushKV("array", array);
+
+    BOOST_CHECK_EQUAL(GetJSONSize(value), value.write().size());
+    BOOST_CHECK_EQUAL(GetJSONSize(UniValue(UniValue::VARR)), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(rpcstats_calls)
+{
+    const CRPCCommand* command = WithRPCStats(statsCommand);
+    BOOST_CHECK_EQUAL(command->name, statsCommand.name);
+    BOOST_CHECK_EQUAL(command->unique_id, statsCommand.unique_id);
+    GetRPCStats(true);
+
+    JSONRPCRequest request;
+    request.params = UniValue(UniValue::VARR);
+    request.params.push_back("abc");
+    UniValue result;
+    BOOST_CHECK(command->actor(request, result, true));
+    BOOST_CHECK_EQUAL(result.write(), "[\"abc\"]");
+
+    JSONRPCRequest invalid;
+    invalid.params = UniValue(UniValue::VARR);
+    BOOST_CHECK_THROW(command->actor(invalid, result, true), UniValue);
+
+    // help requests are not counted
+    JSONRPCRequest help;
+    help.fHelp = true;
+    help.params = request.params;
+    BOOST_CHECK(command->actor(help, result, true));
+
+    const UniValue stats = GetRPCStats(true);
+    const UniValue* method = FindMethod(stats, "omnitest_stats");
+    BOOST_REQUIRE(method != nullptr);
+    BOOST_CHECK_EQUAL((*method)["calls"].get_int(), 2);
+    BOOST_CHECK_EQUAL((*method)["errors"].get_int(), 1);
+    BOOST_CHECK_EQUAL((*method)["responsebytes"].get_int(), 7);
+    BOOST_CHECK_EQUAL((*method)["latency"].size(), stats["latencylimits"].size() + 1);
+
+    int64_t nBucketCalls = 0;
+    for (const UniValue& count : (*method)["latency"].getValues()) {
+        nBucketCalls += count.get_int64();
+    }
+    BOOST_CHECK_EQUAL(nBucketCalls, 2);
+
+    // the statistics were reset
+    BOOST_CHECK(FindMethod(GetRPCStats(false), "omnitest_stats") == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(rpcstats_lock_wait)
+{
+    CTimedRecursiveMutex mutex;
+    const int64_t nWaitStart = GetThreadLockWaitTime();
+
+    // uncontended and recursive locks don't wait
+    {
+        LOCK(mutex);
+        LOCK(mutex);
+    }
+    BOOST_CHECK_EQUAL(GetThreadLockWaitTime(), nWaitStart);
+
+    // only the thread, which waits for the lock, records the time
+    std::thread waiter;
+    int64_t nWaited = 0;
+    {
+        LOCK(mutex);
+        waiter = std::thread([&mutex, &nWaited] {
+            const int64_t nBefore = GetThreadLockWaitTime();
+            LOCK(mutex);
+            nWaited = GetThreadLockWaitTime() - nBefore;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    waiter.join();
+    BOOST_CHECK(nWaited >= 10000);
+    BOOST_CHECK_EQUAL(GetThreadLockWaitTime(), nWaitStart);
+}
+
+BOOST_AUTO_TEST_CASE(rpcstats_lock_stats)
+{
+    CTimedRecursiveMutex mutex("omnitest_lock");
+    GetLockStats(0, true);
+    EnableLockStats(true);
+
+    {
+        LOCK(mutex);
+        LOCK(mutex);
+    }
+
+    std::thread waiter;
+    {
+        LOCK(mutex);
+        waiter = std::thread([&mutex] {
+            LOCK(mutex);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    waiter.join();
+    EnableLockStats(false);
+
+    // the waiting call site is reported
+    const UniValue locks = GetLockStats(LOCK_STATS_TOP_SITES, true);
+    const UniValue* lock = FindLock(locks, "omnitest_lock");
+    BOOST_REQUIRE(lock != nullptr);
+    BOOST_CHECK_EQUAL((*lock)["acquisitions"].get_int64(), 4);
+    BOOST_CHECK_EQUAL((*lock)["contended"].get_int64(), 1);
+    BOOST_CHECK((*lock)["maxwait"].get_real() >= 0.01);
+    BOOST_REQUIRE_EQUAL((*lock)["sites"].size(), 1U);
+    const std::string site = (*lock)["sites"][0]["site"].get_str();
+    BOOST_CHECK(site.find("rpcstats_tests.cpp:") != std::string::npos);
+
+    // nothing is recorded, while disabled, and the statistics were reset
+    {
+        LOCK(mutex);
+    }
+    lock = FindLock(GetLockStats(LOCK_STATS_TOP_SITES, false), "omnitest_lock");
+    BOOST_REQUIRE(lock != nullptr);
+    BOOST_CHECK_EQUAL((*lock)["acquisitions"].get_int64(), 0);
+    BOOST_CHECK_EQUAL((*lock)["sites"].size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
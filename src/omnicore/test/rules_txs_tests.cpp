@@ -34,5 +34,31 @@ BOOST_AUTO_TEST_CASE(simple_send_restrictions)
     BOOST_CHECK(IsTransactionTypeAllowed(MAX_BLOCK,         OMNI_PROPERTY_TMSC, MSC_TYPE_SIMPLE_SEND, MP_TX_PKT_V0));
 }
 
+BOOST_AUTO_TEST_CASE(known_transaction_types)
+{
+    BOOST_CHECK(IsTransactionTypeKnown(MSC_TYPE_SIMPLE_SEND, MP_TX_PKT_V0));
+    BOOST_CHECK(IsTransactionTypeKnown(MSC_TYPE_METADEX_TRADE, MP_TX_PKT_V0));
+
+    BOOST_CHECK(!IsTransactionTypeKnown(MSC_TYPE_SIMPLE_SEND, MP_TX_PKT_V1));
+    BOOST_CHECK(!IsTransactionTypeKnown(MSC_TYPE_SIMPLE_SEND, MAX_VERSION));
+    BOOST_CHECK(!IsTransactionTypeKnown(MSC_TYPE_NOTIFICATION, MP_TX_PKT_V0));
+}
+
+BOOST_AUTO_TEST_CASE(restrictions_follow_activations)
+{
+    int MSC_STOV1_BLOCK = ConsensusParams().MSC_STOV1_BLOCK;
+
+    BOOST_CHECK(!IsTransactionTypeAllowed(100, OMNI_PROPERTY_MSC, MSC_TYPE_SEND_TO_OWNERS, MP_TX_PKT_V1));
+
+    MutableConsensusParams().MSC_STOV1_BLOCK = 100;
+    BOOST_CHECK(IsTransactionTypeAllowed(100, OMNI_PROPERTY_MSC, MSC_TYPE_SEND_TO_OWNERS, MP_TX_PKT_V1));
+    BOOST_CHECK(!IsTransactionTypeAllowed(99, OMNI_PROPERTY_MSC, MSC_TYPE_SEND_TO_OWNERS, MP_TX_PKT_V1));
+
+    MutableConsensusParams().MSC_STOV1_BLOCK = MSC_STOV1_BLOCK;
+    BOOST_CHECK(!IsTransactionTypeAllowed(100, OMNI_PROPERTY_MSC, MSC_TYPE_SEND_TO_OWNERS, MP_TX_PKT_V1));
+
+    BOOST_CHECK_EQUAL(ConsensusParams().GetRestrictions().size(), 32U);
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,44 @@
+#include <omnicore/scanstatus.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_scanstatus_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(scanstatus_progress)
+{
+    CScanStatus status;
+    BOOST_CHECK(!status.Get().fScanning);
+
+    status.Start(100, 199, 1000, 2000);
+    status.BlockProcessed(100, 1250, 250, 3);
+    status.AddTime(10, 20, 30);
+
+    ScanStatusInfo info = status.Get();
+    BOOST_CHECK(info.fScanning);
+    BOOST_CHECK_EQUAL(info.nCurrentBlock, 100);
+    BOOST_CHECK_EQUAL(info.nBlocks, 1U);
+    BOOST_CHECK_EQUAL(info.nTransactions, 250U);
+    BOOST_CHECK_EQUAL(info.nOmniTransactions, 3U);
+    BOOST_CHECK_EQUAL(info.dProgress, 25.0);
+    BOOST_CHECK_EQUAL(info.nTimeDecode, 10);
+    BOOST_CHECK_EQUAL(info.nTimeInterpret, 20);
+    BOOST_CHECK_EQUAL(info.nTimePersist, 30);
+
+    status.Stop();
+    info = status.Get();
+    BOOST_CHECK(!info.fScanning);
+    BOOST_CHECK_EQUAL(info.nRemaining, 0);
+
+    // blocks processed after the scan are not counted
+    status.BlockProcessed(200, 2010, 10, 1);
+    status.AddTime(0, 0, 100);
+    info = status.Get();
+    BOOST_CHECK_EQUAL(info.nBlocks, 1U);
+    BOOST_CHECK_EQUAL(info.nTimePersist, 30);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -286,5 +286,37 @@ BOOST_AUTO_TEST_CASE(extract_anypush_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(extract_spans_test)
+{
+    std::vector<std::vector<unsigned char> > vvchPayloads;
+    vvchPayloads.push_back(ParseHex("0347d08029b5cbc934f6079b650c50718eab5a56d51cf6b742ec9f865a41fcfca3"));
+    vvchPayloads.push_back(std::vector<unsigned char>(80, 0x11)); // OP_PUSHDATA1
+    vvchPayloads.push_back(std::vector<unsigned char>(300, 0x22)); // OP_PUSHDATA2
+    vvchPayloads.push_back(ParseHex("444444"));
+
+    CScript script;
+    script << CScript::EncodeOP_N(1);
+    for (const std::vector<unsigned char>& vchPayload : vvchPayloads) {
+        script << vchPayload;
+    }
+    script << OP_CHECKMULTISIG;
+
+    // Confirm extracted data, and skip first push
+    Span<const unsigned char> vSolutions[2];
+    size_t nCount = 0;
+    BOOST_CHECK(GetScriptPushes(script, vSolutions, 2, nCount, true));
+    BOOST_CHECK_EQUAL(nCount, 3U);
+    BOOST_CHECK(std::vector<unsigned char>(vSolutions[0].begin(), vSolutions[0].end()) == vvchPayloads[1]);
+    BOOST_CHECK(std::vector<unsigned char>(vSolutions[1].begin(), vSolutions[1].end()) == vvchPayloads[2]);
+
+    // Pushes of further scripts are counted, but don't overflow the buffer
+    BOOST_CHECK(GetScriptPushes(script, vSolutions, 2, nCount));
+    BOOST_CHECK_EQUAL(nCount, 7U);
+    BOOST_CHECK(std::vector<unsigned char>(vSolutions[1].begin(), vSolutions[1].end()) == vvchPayloads[2]);
+
+    // Malformed scripts are rejected
+    CScript scriptInvalid = CScript() << OP_1 << OP_PUSHDATA1;
+    BOOST_CHECK(!GetScriptPushes(scriptInvalid, vSolutions, 2, nCount));
+}
 
 BOOST_AUTO_TEST_SUITE_END()
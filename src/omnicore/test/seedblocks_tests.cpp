@@ -0,0 +1,54 @@
+#include <omnicore/seedblocks.h>
+
+#include <chainparams.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_seedblocks_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(seed_block_filter)
+{
+    BOOST_CHECK(SkipBlock(0));
+    BOOST_CHECK(!SkipBlock(249498));
+    BOOST_CHECK(SkipBlock(249499));
+    BOOST_CHECK(SkipBlock(489725));
+    BOOST_CHECK(!SkipBlock(490000));
+    BOOST_CHECK(!SkipBlock(490001));
+}
+
+BOOST_AUTO_TEST_CASE(static_seed_blocks)
+{
+    std::vector<int> vBlocks;
+    int nCoveredHeight = 0;
+    BOOST_CHECK(GetStaticSeedBlocks(489720, 489730, vBlocks, nCoveredHeight));
+    BOOST_CHECK_EQUAL(nCoveredHeight, 489730);
+    BOOST_CHECK(vBlocks == std::vector<int>({489720, 489721, 489722, 489723, 489724, 489726, 489727, 489728, 489729, 489730}));
+
+    // the list ends at the last seed block
+    vBlocks.clear();
+    BOOST_CHECK(GetStaticSeedBlocks(489998, 500000, vBlocks, nCoveredHeight));
+    BOOST_CHECK_EQUAL(nCoveredHeight, 490000);
+    BOOST_CHECK(vBlocks == std::vector<int>({489998, 489999, 490000}));
+
+    vBlocks.clear();
+    BOOST_CHECK(!GetStaticSeedBlocks(490001, 500000, vBlocks, nCoveredHeight));
+    BOOST_CHECK(vBlocks.empty());
+}
+
+BOOST_AUTO_TEST_CASE(seed_blocks_other_networks)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+
+    std::vector<int> vBlocks;
+    int nCoveredHeight = 0;
+    BOOST_CHECK(!SkipBlock(0));
+    BOOST_CHECK(!GetStaticSeedBlocks(0, 100, vBlocks, nCoveredHeight));
+
+    SelectParams(CBaseChainParams::MAIN);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,88 @@
+#include <omnicore/tx.h>
+
+#include <omnicore/createpayload.h>
+#include <omnicore/dbspinfo.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace mastercore;
+
+namespace {
+struct SendPrecheckTestingSetup : BasicTestingSetup
+{
+    SendPrecheckTestingSetup()
+    {
+        LOCK(cs_tally);
+        pDbSpInfo = new CMPSPInfo(GetDataDir() / "MP_spinfo_precheck", true);
+        mp_tally_map.clear();
+        ClearFreezeState();
+    }
+
+    ~SendPrecheckTestingSetup()
+    {
+        LOCK(cs_tally);
+        ClearFreezeState();
+        mp_tally_map.clear();
+        delete pDbSpInfo;
+        pDbSpInfo = nullptr;
+    }
+};
+
+CMPTransaction CreateTransaction(const std::string& sender, std::vector<unsigned char> vchPayload)
+{
+    CMPTransaction mp_tx;
+    mp_tx.Set(sender, "receiver", 0, uint256(), 1000, 1, vchPayload.data(), vchPayload.size(), OMNI_CLASS_C, 0);
+    mp_tx.unlockLogic();
+    return mp_tx;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_send_precheck_tests, SendPrecheckTestingSetup)
+
+BOOST_AUTO_TEST_CASE(send_precheck_peek)
+{
+    uint32_t property = 0;
+    BOOST_CHECK(CreateTransaction("sender", CreatePayload_SimpleSend(OMNI_PROPERTY_TMSC, 50)).peekSimpleSend(property));
+    BOOST_CHECK_EQUAL(property, OMNI_PROPERTY_TMSC);
+    BOOST_CHECK(!CreateTransaction("sender", CreatePayload_SendAll(2)).peekSimpleSend(property));
+}
+
+BOOST_AUTO_TEST_CASE(send_precheck_checks)
+{
+    LOCK(cs_tally);
+    BOOST_CHECK(mp_tally_map.UpdateMoney(mp_tally_map.AddAddress("sender"), OMNI_PROPERTY_TMSC, 100, BALANCE));
+
+    CMPTransaction mp_tx = CreateTransaction("sender", CreatePayload_SimpleSend(OMNI_PROPERTY_TMSC, 100));
+    BOOST_CHECK(mp_tx.precheckSimpleSend());
+
+    // the logic of read-only transactions is never executed
+    CMPTransaction mp_readonly;
+    std::vector<unsigned char> vchPayload = CreatePayload_SimpleSend(OMNI_PROPERTY_TMSC, 100);
+    mp_readonly.Set("sender", "receiver", 0, uint256(), 1000, 1, vchPayload.data(), vchPayload.size(), OMNI_CLASS_C, 0);
+    BOOST_CHECK(!mp_readonly.precheckSimpleSend());
+
+    // sends, which would be rejected, are checked again, when they are executed
+    BOOST_CHECK(!CreateTransaction("sender", CreatePayload_SimpleSend(OMNI_PROPERTY_TMSC, 101)).precheckSimpleSend());
+    BOOST_CHECK(!CreateTransaction("sender", CreatePayload_SimpleSend(OMNI_PROPERTY_TMSC, 0)).precheckSimpleSend());
+    BOOST_CHECK(!CreateTransaction("other", CreatePayload_SimpleSend(OMNI_PROPERTY_TMSC, 1)).precheckSimpleSend());
+    BOOST_CHECK(!CreateTransaction("sender", CreatePayload_SimpleSend(TEST_ECO_PROPERTY_1, 1)).precheckSimpleSend());
+
+    freezeAddress("sender", OMNI_PROPERTY_TMSC);
+    BOOST_CHECK(!mp_tx.precheckSimpleSend());
+    unfreezeAddress("sender", OMNI_PROPERTY_TMSC);
+    BOOST_CHECK(mp_tx.precheckSimpleSend());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
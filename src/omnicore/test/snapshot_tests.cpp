@@ -0,0 +1,236 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/mdex.h>
+#include <omnicore/nftdb.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/snapshot.h>
+#include <omnicore/sp.h>
+#include <omnicore/stateexport.h>
+#include <omnicore/tally.h>
+
+#include <sync.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+using namespace mastercore;
+
+namespace {
+struct SnapshotTestingSetup : BasicTestingSetup
+{
+    SnapshotTestingSetup()
+    {
+        LOCK(cs_tally);
+        pDbSpInfo = new CMPSPInfo(GetDataDir() / "MP_spinfo_snapshot", true);
+        mp_tally_map.clear();
+        MetaDEx_CLEAR();
+        InitStateSnapshot(true);
+    }
+
+    ~SnapshotTestingSetup()
+    {
+        LOCK(cs_tally);
+        InitStateSnapshot(false);
+        mp_tally_map.clear();
+        MetaDEx_CLEAR();
+        delete pDbSpInfo;
+        pDbSpInfo = nullptr;
+    }
+};
+
+void UpdateMoney(const std::string& address, uint32_t propertyId, int64_t amount, TallyType ttype)
+{
+    LOCK(cs_tally);
+    BOOST_CHECK(mp_tally_map.UpdateMoney(mp_tally_map.AddAddress(address), propertyId, amount, ttype));
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_snapshot_tests, SnapshotTestingSetup)
+
+BOOST_AUTO_TEST_CASE(snapshot_publish)
+{
+    BOOST_CHECK(GetStateSnapshot() == nullptr);
+
+    UpdateMoney("a", OMNI_PROPERTY_MSC, 100, BALANCE);
+    {
+        LOCK(cs_tally);
+        PublishStateSnapshot(1, uint256S("01"));
+    }
+    std::shared_ptr<const CStateSnapshot> first = GetStateSnapshot();
+    BOOST_REQUIRE(first != nullptr);
+    BOOST_CHECK_EQUAL(first->nBlock, 1);
+    BOOST_CHECK_EQUAL(first->GetAvailableTokenBalance("a", OMNI_PROPERTY_MSC), 100);
+    BOOST_CHECK(first->GetTally("b") == nullptr);
+    BOOST_REQUIRE(first->GetProperty(OMNI_PROPERTY_MSC) != nullptr);
+    BOOST_CHECK(first->GetProperty(OMNI_PROPERTY_MSC)->fDivisible);
+    BOOST_CHECK(first->GetProperty(OMNI_PROPERTY_TMSC) != nullptr);
+    BOOST_CHECK(first->GetProperty(OMNI_PROPERTY_BTC) == nullptr);
+    BOOST_CHECK(first->GetProperty(3) == nullptr);
+
+    // changes of a block in progress are not visible
+    {
+        LOCK(cs_tally);
+        HoldStateSnapshot();
+    }
+    UpdateMoney("a", OMNI_PROPERTY_MSC, 50, BALANCE);
+    UpdateMoney("b", OMNI_PROPERTY_MSC, 7, METADEX_RESERVE);
+    {
+        LOCK(cs_tally);
+        RefreshStateSnapshot();
+    }
+    BOOST_CHECK(GetStateSnapshot() == first);
+
+    {
+        LOCK(cs_tally);
+        PublishStateSnapshot(2, uint256S("02"));
+    }
+    std::shared_ptr<const CStateSnapshot> second = GetStateSnapshot();
+    BOOST_CHECK_EQUAL(second->nBlock, 2);
+    BOOST_CHECK_EQUAL(second->GetAvailableTokenBalance("a", OMNI_PROPERTY_MSC), 150);
+    BOOST_CHECK_EQUAL(second->GetReservedTokenBalance("b", OMNI_PROPERTY_MSC), 7);
+
+    // the previous snapshot is unaffected
+    BOOST_CHECK_EQUAL(first->GetAvailableTokenBalance("a", OMNI_PROPERTY_MSC), 100);
+    BOOST_CHECK(first->GetTally("b") == nullptr);
+
+    // unmodified shards are shared
+    size_t nShared = 0;
+    for (size_t n = 0; n < CStateSnapshot::SHARD_COUNT; ++n) {
+        if (first->vShards[n] == second->vShards[n]) ++nShared;
+    }
+    BOOST_CHECK(nShared >= CStateSnapshot::SHARD_COUNT - 2);
+    BOOST_CHECK(first->pFrozen == second->pFrozen);
+    BOOST_CHECK(first->pProperties == second->pProperties);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_refresh_pending)
+{
+    UpdateMoney("a", OMNI_PROPERTY_MSC, 100, BALANCE);
+    {
+        LOCK(cs_tally);
+        // nothing is published before the first block
+        RefreshStateSnapshot();
+        BOOST_CHECK(GetStateSnapshot() == nullptr);
+        PublishStateSnapshot(5, uint256S("05"));
+    }
+
+    UpdateMoney("a", OMNI_PROPERTY_MSC, -30, PENDING);
+    {
+        LOCK(cs_tally);
+        RefreshStateSnapshot();
+    }
+    std::shared_ptr<const CStateSnapshot> snapshot = GetStateSnapshot();
+    BOOST_CHECK_EQUAL(snapshot->nBlock, 5);
+    BOOST_CHECK(snapshot->hashBlock == uint256S("05"));
+    BOOST_CHECK_EQUAL(snapshot->GetAvailableTokenBalance("a", OMNI_PROPERTY_MSC), 70);
+    BOOST_CHECK_EQUAL(snapshot->GetTokenBalance("a", OMNI_PROPERTY_MSC, BALANCE), 100);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_cleared)
+{
+    UpdateMoney("a", OMNI_PROPERTY_MSC, 100, BALANCE);
+    {
+        LOCK(cs_tally);
+        PublishStateSnapshot(1, uint256S("01"));
+        mp_tally_map.clear();
+    }
+    UpdateMoney("b", OMNI_PROPERTY_MSC, 1, BALANCE);
+    {
+        LOCK(cs_tally);
+        PublishStateSnapshot(1, uint256S("01"));
+    }
+    std::shared_ptr<const CStateSnapshot> snapshot = GetStateSnapshot();
+    BOOST_CHECK(snapshot->GetTally("a") == nullptr);
+    BOOST_CHECK_EQUAL(snapshot->GetAvailableTokenBalance("b", OMNI_PROPERTY_MSC), 1);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_orders)
+{
+    const md_PropertyPair pair(OMNI_PROPERTY_MSC, 3);
+    const md_PropertyPair other(3, OMNI_PROPERTY_MSC);
+    {
+        LOCK(cs_tally);
+        BOOST_CHECK(MetaDEx_INSERT(CMPMetaDEx("a", 1, pair.first, 100, pair.second, 50, uint256S("0a"), 1, 1)));
+        PublishStateSnapshot(1, uint256S("01"));
+    }
+    std::shared_ptr<const CStateSnapshot> first = GetStateSnapshot();
+    BOOST_REQUIRE(first->GetOrders(pair.first, pair.second) != nullptr);
+    BOOST_CHECK_EQUAL(first->GetOrders(pair.first, pair.second)->size(), 1U);
+    BOOST_CHECK(first->GetOrders(other.first, other.second) == nullptr);
+
+    {
+        LOCK(cs_tally);
+        BOOST_CHECK(MetaDEx_INSERT(CMPMetaDEx("b", 2, other.first, 10, other.second, 10, uint256S("0b"), 1, 1)));
+        PublishStateSnapshot(2, uint256S("02"));
+    }
+    std::shared_ptr<const CStateSnapshot> second = GetStateSnapshot();
+    BOOST_REQUIRE(second->GetOrders(other.first, other.second) != nullptr);
+    BOOST_CHECK(first->GetOrders(other.first, other.second) == nullptr);
+
+    // the orders of unmodified pairs are shared
+    BOOST_CHECK(first->GetOrders(pair.first, pair.second) == second->GetOrders(pair.first, pair.second));
+
+    {
+        LOCK(cs_tally);
+        MetaDEx_CLEAR();
+        PublishStateSnapshot(3, uint256S("03"));
+    }
+    std::shared_ptr<const CStateSnapshot> third = GetStateSnapshot();
+    BOOST_CHECK(third->pOrderBook->empty());
+    BOOST_CHECK_EQUAL(second->pOrderBook->size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_disabled)
+{
+    {
+        LOCK(cs_tally);
+        InitStateSnapshot(false);
+        PublishStateSnapshot(1, uint256S("01"));
+    }
+    BOOST_CHECK(GetStateSnapshot() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_export)
+{
+    const fs::path path = GetDataDir() / "omni_state.csv";
+    pDbNFT = new CMPNonFungibleTokensDB(GetDataDir() / "MP_nft_export", true);
+    UpdateMoney("a", OMNI_PROPERTY_MSC, 100, BALANCE);
+    pDbNFT->AddRange(5, 1, 10, "b", NonFungibleStorage::RangeIndex);
+    {
+        LOCK(cs_tally);
+        PublishStateSnapshot(1, uint256S("01"));
+        pDbNFT->PublishSnapshot();
+    }
+
+    // changes after the block are not exported
+    UpdateMoney("c", OMNI_PROPERTY_MSC, 1, BALANCE);
+    pDbNFT->AddRange(5, 11, 20, "c", NonFungibleStorage::RangeIndex);
+
+    ExportSummary summary;
+    std::string strError;
+    BOOST_CHECK(ExportState(path, ExportFormat::CSV, summary, strError));
+    BOOST_CHECK_EQUAL(summary.nBlock, 1);
+    BOOST_CHECK_EQUAL(summary.nBalances, 1U);
+    BOOST_CHECK_EQUAL(summary.nRanges, 1U);
+
+    std::ifstream file(path.string());
+    std::stringstream content;
+    content << file.rdbuf();
+    BOOST_CHECK(content.str().find("\nbalance,a,1,100,0,0,0\n") != std::string::npos);
+    BOOST_CHECK(content.str().find("\nnftrange,5,1,10,b\n") != std::string::npos);
+    BOOST_CHECK(content.str().find(",c") == std::string::npos);
+
+    delete pDbNFT;
+    pDbNFT = nullptr;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,171 @@
+#include <omnicore/statecommitment.h>
+
+#include <omnicore/consensushash.h>
+#include <omnicore/dex.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+#include <string>
+
+using namespace mastercore;
+
+namespace {
+struct StateCommitmentTestingSetup : BasicTestingSetup
+{
+    StateCommitmentTestingSetup()
+    {
+        LOCK(cs_tally);
+        Reset();
+    }
+
+    ~StateCommitmentTestingSetup()
+    {
+        LOCK(cs_tally);
+        Reset();
+    }
+
+    void Reset()
+    {
+        mp_tally_map.clear();
+        my_offers.clear();
+        my_accepts.clear();
+        my_crowds.clear();
+        MetaDEx_CLEAR();
+    }
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_statecommitment_tests, StateCommitmentTestingSetup)
+
+BOOST_AUTO_TEST_CASE(commitment_set_hash)
+{
+    const std::string address = "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb";
+
+    CStateCommitment a;
+    a.Add(COMMIT_BALANCE, address, uint32_t(1), int64_t(100));
+    a.Add(COMMIT_BALANCE, address, uint32_t(3), int64_t(5));
+
+    // the order of the updates doesn't matter
+    CStateCommitment b;
+    b.Add(COMMIT_BALANCE, address, uint32_t(3), int64_t(5));
+    b.Add(COMMIT_BALANCE, address, uint32_t(1), int64_t(100));
+    BOOST_CHECK(a == b);
+    BOOST_CHECK(a.GetHash() == b.GetHash());
+
+    // removing an element undoes adding it
+    b.Add(COMMIT_BALANCE, address, uint32_t(2), int64_t(7));
+    BOOST_CHECK(a != b);
+    b.Remove(COMMIT_BALANCE, address, uint32_t(2), int64_t(7));
+    BOOST_CHECK(a == b);
+
+    // commitments to disjoint sets can be combined
+    CStateCommitment c;
+    CStateCommitment d;
+    c.Add(COMMIT_BALANCE, address, uint32_t(1), int64_t(100));
+    d.Add(COMMIT_BALANCE, address, uint32_t(3), int64_t(5));
+    c += d;
+    BOOST_CHECK(a == c);
+
+    b.Remove(COMMIT_BALANCE, address, uint32_t(1), int64_t(100));
+    b.Remove(COMMIT_BALANCE, address, uint32_t(3), int64_t(5));
+    BOOST_CHECK(b == CStateCommitment());
+}
+
+BOOST_AUTO_TEST_CASE(commitment_balances_incremental)
+{
+    CMPTallyMap tallies;
+    const uint32_t idA = tallies.AddAddress("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb");
+    const uint32_t idB = tallies.AddAddress("1GXwTzeqhSzsPrkDBNcnfZq3s8i8fmnZTV");
+    BOOST_CHECK(tallies.UpdateMoney(idA, 3, 100, BALANCE));
+
+    // from now on the commitment is maintained with every update
+    const CStateCommitment before = tallies.GetCommitment();
+    BOOST_CHECK(tallies.UpdateMoney(idA, 3, -40, BALANCE));
+    BOOST_CHECK(tallies.UpdateMoney(idA, 3, 40, METADEX_RESERVE));
+    BOOST_CHECK(tallies.UpdateMoney(idB, 5, 7, BALANCE));
+    BOOST_CHECK(tallies.UpdateMoney(idB, 5, 9, PENDING));
+    BOOST_CHECK(!tallies.UpdateMoney(idB, 5, -8, BALANCE));
+    const CStateCommitment incremental = tallies.GetCommitment();
+    BOOST_CHECK(incremental != before);
+
+    // the same balances, without the pending amount, built at once
+    CMPTallyMap rebuilt;
+    const uint32_t idB2 = rebuilt.AddAddress("1GXwTzeqhSzsPrkDBNcnfZq3s8i8fmnZTV");
+    const uint32_t idA2 = rebuilt.AddAddress("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb");
+    BOOST_CHECK(rebuilt.UpdateMoney(idB2, 5, 7, BALANCE));
+    BOOST_CHECK(rebuilt.UpdateMoney(idA2, 3, 60, BALANCE));
+    BOOST_CHECK(rebuilt.UpdateMoney(idA2, 3, 40, METADEX_RESERVE));
+    BOOST_CHECK(rebuilt.GetCommitment() == incremental);
+
+    // empty balances are not part of the commitment
+    BOOST_CHECK(tallies.UpdateMoney(idB, 5, -7, BALANCE));
+    BOOST_CHECK(rebuilt.UpdateMoney(idB2, 5, -7, BALANCE));
+    BOOST_CHECK(tallies.GetCommitment() == rebuilt.GetCommitment());
+
+    tallies.clear();
+    BOOST_CHECK(tallies.GetCommitment() == CStateCommitment());
+}
+
+BOOST_AUTO_TEST_CASE(commitment_state_incremental)
+{
+    LOCK(cs_tally);
+
+    const uint256 empty = GetStateCommitment();
+    BOOST_CHECK(empty == CStateCommitment().GetHash());
+
+    BOOST_CHECK(update_tally_map("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb", 3, 50, METADEX_RESERVE));
+    const CMPMetaDEx order("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb", 100, 3, 50, 1, 100, uint256S("0a"), 1, 1);
+    BOOST_CHECK(MetaDEx_INSERT(order));
+    const uint256 incremental = GetStateCommitment();
+    BOOST_CHECK(incremental != empty);
+
+    // a rebuilt commitment matches the incrementally maintained one
+    InvalidateStateCommitment();
+    BOOST_CHECK(GetStateCommitment() == incremental);
+}
+
+BOOST_AUTO_TEST_CASE(consensus_delta)
+{
+    LOCK(cs_tally);
+
+    const std::string addressA = "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb";
+    const std::string addressB = "1GXwTzeqhSzsPrkDBNcnfZq3s8i8fmnZTV";
+
+    BOOST_CHECK(update_tally_map(addressA, 3, 100, BALANCE));
+    CStateCommitment before = GetCurrentStateCommitment();
+    BOOST_CHECK(GetConsensusDelta(before) == CStateCommitment().GetHash());
+
+    // a transfer of 40 tokens
+    BOOST_CHECK(update_tally_map(addressA, 3, -40, BALANCE));
+    BOOST_CHECK(update_tally_map(addressB, 3, 40, BALANCE));
+    const uint256 delta = GetConsensusDelta(before);
+    BOOST_CHECK(delta != CStateCommitment().GetHash());
+
+    // the same transfer in an otherwise different state has the same digest
+    Reset();
+    BOOST_CHECK(update_tally_map(addressA, 3, 100, BALANCE));
+    BOOST_CHECK(update_tally_map(addressB, 5, 77, BALANCE));
+    before = GetCurrentStateCommitment();
+    BOOST_CHECK(update_tally_map(addressA, 3, -40, BALANCE));
+    BOOST_CHECK(update_tally_map(addressB, 3, 40, BALANCE));
+    BOOST_CHECK(GetConsensusDelta(before) == delta);
+
+    // ... but from other balances it changes other elements
+    before = GetCurrentStateCommitment();
+    BOOST_CHECK(update_tally_map(addressA, 3, -40, BALANCE));
+    BOOST_CHECK(update_tally_map(addressB, 3, 40, BALANCE));
+    BOOST_CHECK(GetConsensusDelta(before) != delta);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,82 @@
+#include <omnicore/statedelta.h>
+
+#include <omnicore/dbbase.h>
+#include <omnicore/statefile.h>
+
+#include <arith_uint256.h>
+#include <uint256.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_statedelta_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(statedelta_roundtrip)
+{
+    CStateDelta delta;
+    delta.nBlock = 650000;
+    delta.hashBlock = ArithToUint256(arith_uint256(1));
+    delta.hashPrevBlock = ArithToUint256(arith_uint256(2));
+    delta.hashCommitment = ArithToUint256(arith_uint256(3));
+    delta.vParts.emplace_back(3, std::vector<unsigned char>{1, 2, 3});
+    std::vector<CDBWrite> vWrites;
+    vWrites.emplace_back("a", std::make_shared<const std::string>("value"));
+    vWrites.emplace_back("b", nullptr);
+    vWrites.emplace_back("c", std::make_shared<const std::string>(""));
+    delta.vDatabases.emplace_back("MP_txlist", vWrites);
+
+    CStateDelta decoded;
+    BOOST_CHECK(DecodeStateDelta(EncodeStateDelta(delta), decoded));
+    BOOST_CHECK_EQUAL(decoded.nBlock, 650000);
+    BOOST_CHECK(decoded.hashBlock == delta.hashBlock);
+    BOOST_CHECK(decoded.hashPrevBlock == delta.hashPrevBlock);
+    BOOST_CHECK(decoded.hashCommitment == delta.hashCommitment);
+    BOOST_CHECK(!decoded.fProcessBlock);
+    BOOST_CHECK_EQUAL(decoded.vParts.size(), 1U);
+    BOOST_CHECK_EQUAL(decoded.vParts[0].first, 3);
+    BOOST_CHECK(decoded.vParts[0].second == delta.vParts[0].second);
+
+    // deleted entries are distinguished from empty values
+    BOOST_CHECK_EQUAL(decoded.vDatabases.size(), 1U);
+    BOOST_CHECK_EQUAL(decoded.vDatabases[0].first, "MP_txlist");
+    const std::vector<CDBWrite>& vDecoded = decoded.vDatabases[0].second;
+    BOOST_CHECK_EQUAL(vDecoded.size(), 3U);
+    BOOST_CHECK_EQUAL(vDecoded[0].first, "a");
+    BOOST_CHECK(vDecoded[0].second && *vDecoded[0].second == "value");
+    BOOST_CHECK(!vDecoded[1].second);
+    BOOST_CHECK(vDecoded[2].second && vDecoded[2].second->empty());
+}
+
+BOOST_AUTO_TEST_CASE(statedelta_invalid)
+{
+    CStateDelta delta;
+    delta.nBlock = 1;
+    delta.fProcessBlock = true;
+    std::vector<unsigned char> vch = EncodeStateDelta(delta);
+
+    CStateDelta decoded;
+    BOOST_CHECK(DecodeStateDelta(vch, decoded));
+    BOOST_CHECK(decoded.fProcessBlock);
+
+    // corrupted content is rejected
+    vch[vch.size() / 2] ^= 0x01;
+    BOOST_CHECK(!DecodeStateDelta(vch, decoded));
+
+    // other state files are rejected
+    CStateFileWriter writer(0);
+    writer.WriteRecord(delta.hashBlock);
+    BOOST_CHECK(!DecodeStateDelta(writer.GetContent(), decoded));
+
+    // unknown state file types are rejected
+    delta.fProcessBlock = false;
+    delta.vParts.emplace_back(0xff, std::vector<unsigned char>());
+    BOOST_CHECK(!DecodeStateDelta(EncodeStateDelta(delta), decoded));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,307 @@
+#include <omnicore/statefile.h>
+
+#include <fs.h>
+#include <hash.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_statefile_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(statefile_roundtrip)
+{
+    const uint256 txid = uint256S("1c9a3de5edd0d8bd1b5aa19d2b5a6cd6d6f17f7bbd3a1c8a8d9a6e8b2e8a1f01");
+    std::map<uint256, std::vector<int64_t> > data;
+    data[txid] = std::vector<int64_t>{100, 1231006505, -5};
+
+    CStateFileWriter writer(3);
+    int64_t amount = -1;
+    int block = 550000;
+    uint32_t property = 2147483651U;
+    writer.WriteRecord(std::string("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb"), VARAMOUNT(amount), VARBLOCK(block), VARINT(property), txid);
+    writer.WriteRecord(data);
+    const std::vector<unsigned char> vch = writer.GetContent();
+
+    BOOST_CHECK(CStateFileReader::IsStateFile(vch));
+    CStateFileReader reader(vch);
+    BOOST_CHECK(reader.IsValid());
+    BOOST_CHECK_EQUAL(reader.GetType(), 3);
+
+    std::string address;
+    int64_t amountRead = 0;
+    int blockRead = 0;
+    uint32_t propertyRead = 0;
+    uint256 txidRead;
+    BOOST_CHECK(reader.ReadRecord(address, VARAMOUNT(amountRead), VARBLOCK(blockRead), VARINT(propertyRead), txidRead));
+    BOOST_CHECK_EQUAL(address, "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb");
+    BOOST_CHECK_EQUAL(amountRead, -1);
+    BOOST_CHECK_EQUAL(blockRead, 550000);
+    BOOST_CHECK_EQUAL(propertyRead, 2147483651U);
+    BOOST_CHECK(txidRead == txid);
+
+    std::map<uint256, std::vector<int64_t> > dataRead;
+    BOOST_CHECK(!reader.AtEnd());
+    BOOST_CHECK(reader.ReadRecord(dataRead));
+    BOOST_CHECK(dataRead == data);
+    BOOST_CHECK(reader.AtEnd());
+}
+
+BOOST_AUTO_TEST_CASE(statefile_varamount)
+{
+    const int64_t values[] = {0, 1, -1, 63, -64, 64, INT64_MAX, INT64_MIN};
+    for (int64_t value : values) {
+        CStateFileWriter writer(0);
+        writer.WriteRecord(VARAMOUNT(value));
+        const std::vector<unsigned char> vch = writer.GetContent();
+        CStateFileReader reader(vch);
+        int64_t valueRead = 0;
+        BOOST_CHECK(reader.ReadRecord(VARAMOUNT(valueRead)));
+        BOOST_CHECK_EQUAL(valueRead, value);
+    }
+
+    // small amounts of either sign take a single byte
+    int64_t small = -64;
+    CStateFileWriter writer(0);
+    size_t nEmpty = writer.GetContent().size();
+    writer.WriteRecord(VARAMOUNT(small));
+    BOOST_CHECK_EQUAL(writer.GetContent().size(), nEmpty + 2);
+}
+
+BOOST_AUTO_TEST_CASE(statefile_rejects_invalid)
+{
+    CStateFileWriter writer(1);
+    uint32_t value = 7;
+    writer.WriteRecord(VARINT(value), std::string("abc"));
+    const std::vector<unsigned char> vch = writer.GetContent();
+
+    // a flipped bit in the content fails the hash validation
+    std::vector<unsigned char> vchCorrupt(vch);
+    vchCorrupt[8] ^= 0x01;
+    BOOST_CHECK(CStateFileReader::IsStateFile(vchCorrupt));
+    BOOST_CHECK(!CStateFileReader(vchCorrupt).IsValid());
+
+    // a truncated file fails the hash validation
+    std::vector<unsigned char> vchTruncated(vch.begin(), vch.end() - 1);
+    BOOST_CHECK(!CStateFileReader(vchTruncated).IsValid());
+
+    // legacy text files aren't recognized as state files
+    std::string strLegacy = "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb=1:100,0,0,0;\n";
+    BOOST_CHECK(!CStateFileReader::IsStateFile(std::vector<unsigned char>(strLegacy.begin(), strLegacy.end())));
+
+    // a record, which isn't consumed completely, is rejected
+    CStateFileReader reader(vch);
+    BOOST_CHECK(reader.IsValid());
+    uint32_t valueRead = 0;
+    BOOST_CHECK(!reader.ReadRecord(VARINT(valueRead)));
+}
+
+BOOST_AUTO_TEST_CASE(statefile_split)
+{
+    CStateFileWriter writer(0);
+    for (uint32_t n = 0; n < 10; ++n) {
+        writer.WriteRecord(VARINT(n), std::string(n, 'x'));
+    }
+    const std::vector<unsigned char> vch = writer.GetContent();
+
+    // the parts hold all records in order
+    CStateFileReader reader(vch, false);
+    BOOST_CHECK(CStateFileReader::VerifyHash(vch));
+    std::vector<CStateFileReader> vParts;
+    BOOST_CHECK(reader.Split(3, vParts));
+    BOOST_CHECK_EQUAL(vParts.size(), 3U);
+    BOOST_CHECK(reader.AtEnd());
+
+    uint32_t nNext = 0;
+    for (CStateFileReader& part : vParts) {
+        BOOST_CHECK(!part.AtEnd());
+        while (!part.AtEnd()) {
+            uint32_t n = 0;
+            std::string str;
+            BOOST_CHECK(part.ReadRecord(VARINT(n), str));
+            BOOST_CHECK_EQUAL(n, nNext++);
+            BOOST_CHECK_EQUAL(str.size(), n);
+        }
+    }
+    BOOST_CHECK_EQUAL(nNext, 10U);
+
+    // there are no more parts than records
+    CStateFileReader reader2(vch);
+    BOOST_CHECK(reader2.Split(16, vParts));
+    BOOST_CHECK_EQUAL(vParts.size(), 10U);
+
+    // a length prefix beyond the content is rejected
+    std::vector<unsigned char> vchCorrupt(vch);
+    vchCorrupt[6] = 0xfc;
+    CStateFileReader reader3(vchCorrupt, false);
+    BOOST_CHECK(reader3.IsValid());
+    BOOST_CHECK(!CStateFileReader::VerifyHash(vchCorrupt));
+    BOOST_CHECK(!reader3.Split(2, vParts));
+}
+
+BOOST_AUTO_TEST_CASE(statefile_mapped)
+{
+    const fs::path path = GetDataDir() / "statefile_mapped.dat";
+    CStateFileWriter writer(2);
+    for (uint32_t n = 0; n < 1000; ++n) {
+        writer.WriteRecord(VARINT(n), std::string("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb"));
+    }
+    BOOST_CHECK(writer.WriteToFile(path));
+
+    // the records are decoded from the mapped file
+    CMappedStateFile mapped(path);
+    BOOST_CHECK(mapped.IsOpen());
+    BOOST_CHECK_EQUAL(mapped.size(), fs::file_size(path));
+    BOOST_CHECK(CStateFileReader::IsStateFile(mapped.data(), mapped.size()));
+    CStateFileReader reader(mapped.data(), mapped.size());
+    BOOST_CHECK(reader.IsValid());
+    BOOST_CHECK_EQUAL(reader.GetType(), 2);
+
+    uint32_t nNext = 0;
+    while (!reader.AtEnd()) {
+        uint32_t n = 0;
+        std::string address;
+        BOOST_CHECK(reader.ReadRecord(VARINT(n), address));
+        BOOST_CHECK_EQUAL(n, nNext++);
+    }
+    BOOST_CHECK_EQUAL(nNext, 1000U);
+
+    // missing and empty files
+    BOOST_CHECK(!CMappedStateFile(GetDataDir() / "statefile_missing.dat").IsOpen());
+    BOOST_CHECK(CStateFileWriter::WriteToFile(path, std::vector<unsigned char>()));
+    CMappedStateFile empty(path);
+    BOOST_CHECK(empty.IsOpen());
+    BOOST_CHECK_EQUAL(empty.size(), 0U);
+    BOOST_CHECK(!CStateFileReader::IsStateFile(empty.data(), empty.size()));
+}
+
+BOOST_AUTO_TEST_CASE(statefile_stream)
+{
+    const fs::path path = GetDataDir() / "statefile_stream.dat";
+    CStateFileWriter writer(0x10);
+    CStateFileStreamWriter stream(path, 0x10, 100);
+    BOOST_CHECK(stream.IsOpen());
+    for (uint32_t n = 0; n < 100; ++n) {
+        writer.WriteRecord(VARINT(n), std::string(n, 'x'));
+        stream.WriteRecord(VARINT(n), std::string(n, 'x'));
+    }
+    BOOST_CHECK(stream.Finish());
+
+    // the streamed file is identical to the one built in memory
+    CMappedStateFile mapped(path);
+    BOOST_CHECK(mapped.IsOpen());
+    const std::vector<unsigned char> vch = writer.GetContent();
+    BOOST_CHECK(std::vector<unsigned char>(mapped.data(), mapped.data() + mapped.size()) == vch);
+
+    CStateFileReader reader(mapped.data(), mapped.size());
+    BOOST_CHECK(reader.IsValid());
+    BOOST_CHECK_EQUAL(reader.GetType(), 0x10);
+    BOOST_CHECK_EQUAL(reader.GetRecordCount(), 100U);
+}
+
+/** Returns a state file with the given header and content, and a valid trailing hash. */
+static std::vector<unsigned char> BuildRawStateFile(const std::vector<unsigned char>& vchHeader, const std::vector<unsigned char>& vchContent)
+{
+    std::vector<unsigned char> vch(vchHeader);
+    vch.insert(vch.end(), vchContent.begin(), vchContent.end());
+    uint256 hash;
+    CHash256().Write(vch.data(), vch.size()).Finalize(hash.begin());
+    vch.insert(vch.end(), hash.begin(), hash.end());
+    return vch;
+}
+
+BOOST_AUTO_TEST_CASE(statefile_record_count)
+{
+    CStateFileWriter writer(4);
+    const std::vector<unsigned char> vchEmpty = writer.GetContent();
+    BOOST_CHECK_EQUAL(CStateFileReader(vchEmpty).GetRecordCount(), 0U);
+    for (uint32_t n = 0; n < 3; ++n) {
+        writer.WriteRecord(VARINT(n));
+    }
+
+    // the header holds the number of records
+    const std::vector<unsigned char> vch = writer.GetContent();
+    CStateFileReader reader(vch);
+    BOOST_CHECK(reader.IsValid());
+    BOOST_CHECK_EQUAL(reader.GetRecordCount(), 3U);
+    uint32_t n = 0;
+    BOOST_CHECK(reader.ReadRecord(VARINT(n)));
+    BOOST_CHECK_EQUAL(n, 0U);
+
+    // files of the first version have no number of records, but are still read
+    const std::vector<unsigned char> vchRecord{0x01, 0x07};
+    const std::vector<unsigned char> vchV1 = BuildRawStateFile({0xfe, 'O', 'M', 'N', 1, 4}, vchRecord);
+    CStateFileReader readerV1(vchV1);
+    BOOST_CHECK(readerV1.IsValid());
+    BOOST_CHECK_EQUAL(readerV1.GetRecordCount(), 0U);
+    BOOST_CHECK(readerV1.ReadRecord(VARINT(n)));
+    BOOST_CHECK_EQUAL(n, 7U);
+    BOOST_CHECK(readerV1.AtEnd());
+
+    // a number of records, which can't fit into the file, is rejected, as are unknown versions
+    const std::vector<unsigned char> vchTooMany = BuildRawStateFile({0xfe, 'O', 'M', 'N', 2, 4, 3}, vchRecord);
+    BOOST_CHECK(!CStateFileReader(vchTooMany).IsValid());
+    const std::vector<unsigned char> vchV2 = BuildRawStateFile({0xfe, 'O', 'M', 'N', 2, 4, 1}, vchRecord);
+    BOOST_CHECK(CStateFileReader(vchV2).IsValid());
+    const std::vector<unsigned char> vchV3 = BuildRawStateFile({0xfe, 'O', 'M', 'N', 3, 4, 1}, vchRecord);
+    BOOST_CHECK(!CStateFileReader(vchV3).IsValid());
+}
+
+BOOST_AUTO_TEST_CASE(statefile_compressed)
+{
+    CStateFileWriter writer(0);
+    for (uint32_t n = 0; n < 100000; ++n) {
+        writer.WriteRecord(std::string("1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb"), VARINT(n), VARAMOUNT(static_cast<int64_t>(n % 7)));
+    }
+    const std::vector<unsigned char> vch = writer.GetContent();
+    BOOST_CHECK_GT(vch.size(), 2 * STATE_FILE_FRAME_SIZE);
+
+    // the content spans several frames, and the hash is kept at the end
+    const std::vector<unsigned char> vchCompressed = CompressStateFile(vch);
+    BOOST_CHECK(IsCompressedStateFile(vchCompressed.data(), vchCompressed.size()));
+    BOOST_CHECK(!CStateFileReader::IsStateFile(vchCompressed));
+    BOOST_CHECK_LT(vchCompressed.size(), vch.size() / 4);
+    BOOST_CHECK(std::equal(vch.end() - 32, vch.end(), vchCompressed.end() - 32));
+
+    std::vector<unsigned char> vchRestored;
+    BOOST_CHECK(DecompressStateFile(vchCompressed.data(), vchCompressed.size(), vchRestored));
+    BOOST_CHECK(vchRestored == vch);
+
+    // frames without repetitions are stored as they are
+    CStateFileWriter writerRandom(1);
+    for (int n = 0; n < 100; ++n) {
+        writerRandom.WriteRecord(InsecureRand256());
+    }
+    const std::vector<unsigned char> vchRandom = writerRandom.GetContent();
+    const std::vector<unsigned char> vchRandomCompressed = CompressStateFile(vchRandom);
+    BOOST_CHECK_LE(vchRandomCompressed.size(), vchRandom.size() + 8);
+    BOOST_CHECK(DecompressStateFile(vchRandomCompressed.data(), vchRandomCompressed.size(), vchRestored));
+    BOOST_CHECK(vchRestored == vchRandom);
+
+    // truncated and corrupted files are rejected
+    BOOST_CHECK(!DecompressStateFile(vchCompressed.data(), vchCompressed.size() / 2, vchRestored));
+    std::vector<unsigned char> vchCorrupt(vchCompressed);
+    vchCorrupt[5] ^= 0x80;
+    BOOST_CHECK(!DecompressStateFile(vchCorrupt.data(), vchCorrupt.size(), vchRestored) || !CStateFileReader::VerifyHash(vchRestored));
+    BOOST_CHECK(!DecompressStateFile(vch.data(), vch.size(), vchRestored));
+
+    // a mapped file is decompressed in place, and other files are left as they are
+    const fs::path path = GetDataDir() / "statefile_compressed.dat";
+    BOOST_CHECK(CStateFileWriter::WriteToFile(path, vchCompressed));
+    CMappedStateFile mapped(path);
+    BOOST_CHECK(mapped.Decompress());
+    BOOST_CHECK(std::vector<unsigned char>(mapped.data(), mapped.data() + mapped.size()) == vch);
+    BOOST_CHECK(mapped.Decompress());
+    BOOST_CHECK_EQUAL(mapped.size(), vch.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,139 @@
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/statescan.h>
+#include <omnicore/tally.h>
+
+#include <sync.h>
+#include <test/util/setup_common.h>
+#include <uint256.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_statescan_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(statescan_generation)
+{
+    LOCK(cs_tally);
+    mp_tally_map.clear();
+    MetaDEx_CLEAR();
+
+    // every modification of the balances or orders changes the generation
+    uint64_t nGeneration = GetStateGeneration();
+    BOOST_CHECK(update_tally_map("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 3, 500, METADEX_RESERVE));
+    BOOST_CHECK(GetStateGeneration() != nGeneration);
+
+    nGeneration = GetStateGeneration();
+    BOOST_CHECK(MetaDEx_INSERT(CMPMetaDEx("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 100, 3, 500, 1, 100, uint256S("0a"), 1, 1)));
+    BOOST_CHECK(GetStateGeneration() != nGeneration);
+
+    // ... but failed updates don't
+    nGeneration = GetStateGeneration();
+    BOOST_CHECK(!update_tally_map("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 3, -1000, BALANCE));
+    BOOST_CHECK_EQUAL(GetStateGeneration(), nGeneration);
+
+    const uint64_t nClears = mp_tally_map.GetClearCount();
+    mp_tally_map.clear();
+    MetaDEx_CLEAR();
+    BOOST_CHECK_EQUAL(mp_tally_map.GetClearCount(), nClears + 1);
+}
+
+BOOST_AUTO_TEST_CASE(statescan_cursors)
+{
+    LOCK(cs_tally);
+    mp_tally_map.clear();
+    MetaDEx_CLEAR();
+
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", 3, 7000, BALANCE));
+    BOOST_CHECK(update_tally_map("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 3, 1000, METADEX_RESERVE));
+    BOOST_CHECK(update_tally_map("1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH", 4, 20, BALANCE));
+    BOOST_CHECK(MetaDEx_INSERT(CMPMetaDEx("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 100, 3, 500, 1, 100, uint256S("0a"), 1, 1)));
+    BOOST_CHECK(MetaDEx_INSERT(CMPMetaDEx("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 101, 3, 300, 1, 200, uint256S("0b"), 1, 1)));
+    BOOST_CHECK(MetaDEx_INSERT(CMPMetaDEx("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 102, 3, 200, 2, 100, uint256S("0c"), 1, 1)));
+
+    // the cursors resume, where the previous chunk ended
+    CTallyCursor tallyCursor;
+    std::vector<std::string> vAddresses;
+    auto fnAddress = [&vAddresses](uint32_t id, const std::string& address, const CMPTally& tally) {
+        vAddresses.push_back(address);
+    };
+    BOOST_CHECK(tallyCursor.Next(2, fnAddress));
+    BOOST_CHECK_EQUAL(vAddresses.size(), 2U);
+    BOOST_CHECK(!tallyCursor.Next(2, fnAddress));
+    BOOST_REQUIRE_EQUAL(vAddresses.size(), 3U);
+    BOOST_CHECK_EQUAL(vAddresses[2], "1PxejjeWZc9ZHph7A3SYDo2sk2Up4AcysH");
+
+    CMetaDExCursor orderCursor;
+    std::vector<uint256> vOrders;
+    auto fnOrder = [&vOrders](const CMPMetaDEx& order) { vOrders.push_back(order.getHash()); };
+    BOOST_CHECK(orderCursor.Next(2, fnOrder));
+    BOOST_CHECK_EQUAL(vOrders.size(), 2U);
+    BOOST_CHECK(!orderCursor.Next(2, fnOrder));
+    BOOST_CHECK_EQUAL(vOrders.size(), 3U);
+
+    // ... and start over, once they are reset
+    orderCursor.Reset();
+    vOrders.clear();
+    BOOST_CHECK(!orderCursor.Next(10, fnOrder));
+    BOOST_CHECK_EQUAL(vOrders.size(), 3U);
+
+    mp_tally_map.clear();
+    MetaDEx_CLEAR();
+}
+
+BOOST_AUTO_TEST_CASE(statescan_restart)
+{
+    {
+        LOCK(cs_tally);
+        mp_tally_map.clear();
+    }
+
+    // the state is modified between the chunks, so the scan starts over
+    int nChunks = 0;
+    int nCalls = 0;
+    int nRestarts = ScanStateInChunks([&]() EXCLUSIVE_LOCKS_REQUIRED(cs_tally) {
+        ++nCalls;
+        return ++nChunks < 3;
+    }, [&] {
+        nChunks = 0;
+    }, [&] {
+        LOCK(cs_tally);
+        if (nCalls == 1) BumpStateGeneration();
+    });
+    BOOST_CHECK_EQUAL(nRestarts, 1);
+    BOOST_CHECK_EQUAL(nCalls, 4);
+
+    // ... until the lock is kept, after too many restarts
+    nChunks = 0;
+    nCalls = 0;
+    nRestarts = ScanStateInChunks([&]() EXCLUSIVE_LOCKS_REQUIRED(cs_tally) {
+        ++nCalls;
+        return ++nChunks < 3;
+    }, [&] {
+        nChunks = 0;
+    }, [&] {
+        LOCK(cs_tally);
+        BumpStateGeneration();
+    });
+    BOOST_CHECK_EQUAL(nRestarts, MAX_STATE_SCAN_RESTARTS);
+    BOOST_CHECK_EQUAL(nCalls, MAX_STATE_SCAN_RESTARTS + 3);
+
+    // without restarts the modifications are merged by the caller
+    nChunks = 0;
+    nRestarts = ScanStateInChunks([&]() EXCLUSIVE_LOCKS_REQUIRED(cs_tally) {
+        BOOST_CHECK(update_tally_map("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", 3, 10, BALANCE));
+        return ++nChunks < 3;
+    }, nullptr);
+    BOOST_CHECK_EQUAL(nRestarts, 0);
+    BOOST_CHECK_EQUAL(nChunks, 3);
+
+    LOCK(cs_tally);
+    mp_tally_map.clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
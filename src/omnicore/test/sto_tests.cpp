@@ -0,0 +1,165 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/sto.h>
+#include <omnicore/tally.h>
+#include <omnicore/uint256_extensions.h>
+#include <omnicore/workerpool.h>
+
+#include <amount.h>
+#include <arith_uint256.h>
+#include <random.h>
+#include <sync.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_sto_tests, BasicTestingSetup)
+
+namespace {
+/** Calculates a distribution the way it was done originally, one owner after another. */
+std::vector<int64_t> ReferenceDistribution(const std::vector<int64_t>& vOwned, int64_t amount, int64_t totalTokens)
+{
+    std::vector<int64_t> vReceive;
+    int64_t sent_so_far = 0;
+    for (int64_t owned : vOwned) {
+        arith_uint256 temp = ConvertTo256(owned) * ConvertTo256(amount);
+        int64_t should_receive = ConvertTo64(DivideAndRoundUp(temp, ConvertTo256(totalTokens)));
+        int64_t will_really_receive = std::min(should_receive, amount - sent_so_far);
+        if (will_really_receive <= 0) break;
+        sent_so_far += will_really_receive;
+        vReceive.push_back(will_really_receive);
+    }
+    return vReceive;
+}
+
+std::vector<int64_t> RandomHoldings(FastRandomContext& rng, size_t nOwners, uint64_t nMax)
+{
+    std::vector<int64_t> vOwned(nOwners);
+    for (int64_t& owned : vOwned) {
+        owned = 1 + rng.randrange(nMax);
+    }
+    std::sort(vOwned.begin(), vOwned.end(), std::greater<int64_t>());
+    return vOwned;
+}
+
+int64_t Sum(const std::vector<int64_t>& v)
+{
+    int64_t sum = 0;
+    for (int64_t n : v) sum += n;
+    return sum;
+}
+}
+
+BOOST_AUTO_TEST_CASE(sto_distribution_simple)
+{
+    std::vector<int64_t> vReceive;
+    STO_CalculateDistribution({50, 30, 20}, 10, 100, vReceive);
+    BOOST_CHECK(vReceive == std::vector<int64_t>({5, 3, 2}));
+
+    // shares are rounded up, so the last owners may receive less or nothing
+    STO_CalculateDistribution({50, 30, 20}, 7, 100, vReceive);
+    BOOST_CHECK(vReceive == std::vector<int64_t>({4, 3}));
+
+    STO_CalculateDistribution({1, 1, 1, 1}, 2, 4, vReceive);
+    BOOST_CHECK(vReceive == std::vector<int64_t>({1, 1}));
+
+    STO_CalculateDistribution({}, 2, 0, vReceive);
+    BOOST_CHECK(vReceive.empty());
+
+    STO_CalculateDistribution({5}, 0, 5, vReceive);
+    BOOST_CHECK(vReceive.empty());
+}
+
+BOOST_AUTO_TEST_CASE(sto_distribution_large_values)
+{
+    const int64_t nMax = 9223372036854775807LL;
+    std::vector<int64_t> vOwned{nMax / 2, nMax / 3, nMax / 7};
+    int64_t totalTokens = Sum(vOwned);
+
+    std::vector<int64_t> vReceive;
+    STO_CalculateDistribution(vOwned, nMax, totalTokens, vReceive);
+    BOOST_CHECK(vReceive == ReferenceDistribution(vOwned, nMax, totalTokens));
+    BOOST_CHECK_EQUAL(Sum(vReceive), nMax);
+}
+
+BOOST_AUTO_TEST_CASE(sto_distribution_random)
+{
+    FastRandomContext rng(true);
+    for (int n = 0; n < 200; ++n) {
+        std::vector<int64_t> vOwned = RandomHoldings(rng, 1 + rng.randrange(300), 1 + rng.randrange(1000000));
+        int64_t totalTokens = Sum(vOwned);
+        int64_t amount = 1 + rng.randrange(2 * totalTokens);
+
+        std::vector<int64_t> vReceive;
+        STO_CalculateDistribution(vOwned, amount, totalTokens, vReceive);
+        BOOST_CHECK(vReceive == ReferenceDistribution(vOwned, amount, totalTokens));
+        BOOST_CHECK(vReceive.size() <= static_cast<size_t>(amount));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sto_distribution_parallel)
+{
+    FastRandomContext rng(true);
+    CWorkerPool pool(3, "omnitest");
+    std::vector<int64_t> vOwned = RandomHoldings(rng, STO_PARALLEL_THRESHOLD + 12345, 100000000);
+    int64_t totalTokens = Sum(vOwned);
+
+    for (int64_t amount : {int64_t(1000), totalTokens / 3, totalTokens * 5}) {
+        std::vector<int64_t> vSerial;
+        std::vector<int64_t> vParallel;
+        STO_CalculateDistribution(vOwned, amount, totalTokens, vSerial);
+        STO_CalculateDistribution(vOwned, amount, totalTokens, vParallel, &pool);
+        BOOST_CHECK(vSerial == vParallel);
+        BOOST_CHECK(vSerial == ReferenceDistribution(vOwned, amount, totalTokens));
+        BOOST_CHECK_EQUAL(Sum(vParallel), amount);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sto_fee_shares)
+{
+    LOCK(cs_tally);
+    CMPSPInfo spinfo(GetDataDir() / "MP_spinfo_feeshares", true);
+    CMPSPInfo* pPrevSpInfo = pDbSpInfo;
+    pDbSpInfo = &spinfo;
+    mp_tally_map.clear();
+
+    BOOST_CHECK(update_tally_map("1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj", OMNI_PROPERTY_MSC, 300, BALANCE));
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", OMNI_PROPERTY_MSC, 100, METADEX_RESERVE));
+
+    std::shared_ptr<const OwnerAddrType> pShares = GetFeeShares(OMNI_PROPERTY_MSC);
+    BOOST_REQUIRE_EQUAL(pShares->size(), 2U);
+    BOOST_CHECK_EQUAL(pShares->back().first, 3 * COIN / 4);
+    BOOST_CHECK_EQUAL(pShares->back().second, "1HG3s4Ext3sTqBTHrgftyUzG3cvx5ZbPCj");
+    BOOST_CHECK_EQUAL(pShares->front().first, COIN / 4);
+
+    // the shares are cached, until the balances of the property change
+    BOOST_CHECK(GetFeeShares(OMNI_PROPERTY_MSC) == pShares);
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", OMNI_PROPERTY_MSC, 100, PENDING));
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", OMNI_PROPERTY_TMSC, 100, BALANCE));
+    BOOST_CHECK(GetFeeShares(OMNI_PROPERTY_MSC) == pShares);
+
+    BOOST_CHECK(update_tally_map("3CwZ7FiQ4MqBenRdCkjjc41M5bnoKQGC2b", OMNI_PROPERTY_MSC, 200, BALANCE));
+    std::shared_ptr<const OwnerAddrType> pUpdated = GetFeeShares(OMNI_PROPERTY_MSC);
+    BOOST_CHECK(pUpdated != pShares);
+    BOOST_REQUIRE_EQUAL(pUpdated->size(), 2U);
+    BOOST_CHECK_EQUAL(pUpdated->back().first, COIN / 2);
+
+    // ... or the tally map is cleared
+    mp_tally_map.clear();
+    BOOST_CHECK(GetFeeShares(OMNI_PROPERTY_MSC)->empty());
+
+    pDbSpInfo = pPrevSpInfo;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
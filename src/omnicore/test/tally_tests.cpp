@@ -2,7 +2,10 @@
 
 #include <test/util/setup_common.h>
 
+#include <set>
 #include <stdint.h>
+#include <string>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -318,5 +321,388 @@ BOOST_AUTO_TEST_CASE(tally_overflow)
     BOOST_CHECK_EQUAL(tally.getMoneyReserved(3), int64_t(9223372036854775807LL));
 }
 
+BOOST_AUTO_TEST_CASE(tally_iterate_sorted)
+{
+    CMPTally tally;
+    BOOST_CHECK(tally.updateMoney(7, 1, BALANCE));
+    BOOST_CHECK(tally.updateMoney(3, 1, BALANCE));
+    BOOST_CHECK(tally.updateMoney(5, 1, BALANCE));
+
+    BOOST_CHECK_EQUAL(3, tally.init());
+    BOOST_CHECK_EQUAL(3, tally.next());
+
+    // records inserted while iterating don't invalidate the iterator
+    BOOST_CHECK(tally.updateMoney(1, 1, BALANCE));
+    BOOST_CHECK(tally.updateMoney(6, 1, BALANCE));
+    BOOST_CHECK_EQUAL(5, tally.next());
+    BOOST_CHECK_EQUAL(6, tally.next());
+    BOOST_CHECK_EQUAL(7, tally.next());
+    BOOST_CHECK_EQUAL(0, tally.next());
+    BOOST_CHECK_EQUAL(0, tally.next());
+    BOOST_CHECK_EQUAL(1, tally.init());
+}
+
+BOOST_AUTO_TEST_CASE(tally_const_iteration)
+{
+    CMPTally tally;
+    BOOST_CHECK(tally.begin() == tally.end());
+    BOOST_CHECK(tally.updateMoney(7, 1, BALANCE));
+    BOOST_CHECK(tally.updateMoney(3, 1, BALANCE));
+    BOOST_CHECK(tally.updateMoney(5, 1, BALANCE));
+
+    const CMPTally& constTally = tally;
+    std::vector<uint32_t> vFirst;
+    std::vector<uint32_t> vSecond;
+    // independent walks over the same tally don't interfere
+    for (uint32_t propertyId : constTally) {
+        vFirst.push_back(propertyId);
+        for (uint32_t id : constTally) {
+            vSecond.push_back(id);
+        }
+    }
+    BOOST_CHECK((vFirst == std::vector<uint32_t>{3, 5, 7}));
+    BOOST_CHECK_EQUAL(vSecond.size(), 9U);
+    BOOST_CHECK((std::vector<uint32_t>(vSecond.begin() + 6, vSecond.end()) == vFirst));
+}
+
+BOOST_AUTO_TEST_CASE(tally_empty_records)
+{
+    CMPTally tally;
+    BOOST_CHECK(tally.empty());
+
+    // failed updates don't leave records behind
+    BOOST_CHECK(!tally.updateMoney(3, -1, BALANCE));
+    BOOST_CHECK(tally.empty());
+
+    BOOST_CHECK(tally.updateMoney(3, 5, BALANCE));
+    BOOST_CHECK(tally.updateMoney(3, 2, METADEX_RESERVE));
+    BOOST_CHECK(tally.updateMoney(4, -1, PENDING));
+    BOOST_CHECK(tally.updateMoney(3, -5, BALANCE));
+    BOOST_CHECK((std::vector<uint32_t>(tally.begin(), tally.end()) == std::vector<uint32_t>{3, 4}));
+
+    // records are removed, once all their amounts are zero
+    BOOST_CHECK(tally.updateMoney(3, -2, METADEX_RESERVE));
+    BOOST_CHECK((std::vector<uint32_t>(tally.begin(), tally.end()) == std::vector<uint32_t>{4}));
+    BOOST_CHECK(tally.updateMoney(4, 1, PENDING));
+    BOOST_CHECK(tally.empty());
+    BOOST_CHECK_EQUAL(tally.getMoney(3, BALANCE), 0);
+
+    CMPTally other;
+    BOOST_CHECK(tally == other);
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_interning)
+{
+    CMPTallyMap tallyMap;
+    BOOST_CHECK_EQUAL(tallyMap.size(), 0U);
+    BOOST_CHECK_EQUAL(tallyMap.GetId("a"), CMPTallyMap::INVALID_ID);
+    BOOST_CHECK(tallyMap.Get("a") == nullptr);
+    BOOST_CHECK(tallyMap.Get(0) == nullptr);
+
+    BOOST_CHECK_EQUAL(tallyMap.AddAddress("a"), 0U);
+    BOOST_CHECK_EQUAL(tallyMap.AddAddress("b"), 1U);
+    BOOST_CHECK_EQUAL(tallyMap.AddAddress("a"), 0U);
+    BOOST_CHECK_EQUAL(tallyMap.size(), 2U);
+    BOOST_CHECK_EQUAL(tallyMap.GetId("b"), 1U);
+    BOOST_CHECK_EQUAL(tallyMap.GetAddress(1), "b");
+
+    CMPTally* pTally = tallyMap.Get("a");
+    BOOST_CHECK(pTally == tallyMap.Get(0));
+    BOOST_CHECK(pTally->updateMoney(3, 5, BALANCE));
+
+    // references remain valid, when addresses are added
+    for (int i = 0; i < 10000; ++i) {
+        tallyMap.AddAddress("x" + std::to_string(i));
+    }
+    BOOST_CHECK(pTally == tallyMap.Get("a"));
+    BOOST_CHECK_EQUAL(pTally->getMoney(3, BALANCE), 5);
+    BOOST_CHECK_EQUAL(tallyMap.GetAddress(0), "a");
+
+    std::string strAddresses;
+    for (const auto& entry : tallyMap) {
+        if (entry.second.getMoney(3, BALANCE) == 0) continue;
+        strAddresses += entry.first;
+    }
+    BOOST_CHECK_EQUAL(strAddresses, "a");
+
+    tallyMap.clear();
+    BOOST_CHECK_EQUAL(tallyMap.size(), 0U);
+    BOOST_CHECK_EQUAL(tallyMap.GetId("a"), CMPTallyMap::INVALID_ID);
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_holders)
+{
+    CMPTallyMap tallyMap;
+    uint32_t a = tallyMap.AddAddress("a");
+    uint32_t b = tallyMap.AddAddress("b");
+    uint32_t c = tallyMap.AddAddress("c");
+    BOOST_CHECK(tallyMap.GetHolders(3).empty());
+
+    BOOST_CHECK(tallyMap.UpdateMoney(c, 3, 10, BALANCE));
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, 5, METADEX_RESERVE));
+    BOOST_CHECK(tallyMap.UpdateMoney(b, 4, 5, BALANCE));
+    BOOST_CHECK(!tallyMap.UpdateMoney(b, 3, -1, BALANCE));
+    BOOST_CHECK(!tallyMap.UpdateMoney(CMPTallyMap::INVALID_ID, 3, 1, BALANCE));
+    BOOST_CHECK(std::set<uint32_t>({a, c}) == tallyMap.GetHolders(3));
+    BOOST_CHECK(std::set<uint32_t>({b}) == tallyMap.GetHolders(4));
+
+    // the holder remains, until all balances of the property are zero
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, -5, METADEX_RESERVE));
+    BOOST_CHECK(tallyMap.UpdateMoney(c, 3, -4, PENDING));
+    BOOST_CHECK(tallyMap.UpdateMoney(c, 3, -10, BALANCE));
+    BOOST_CHECK(std::set<uint32_t>({c}) == tallyMap.GetHolders(3));
+    BOOST_CHECK(tallyMap.UpdateMoney(c, 3, 4, PENDING));
+    BOOST_CHECK(tallyMap.GetHolders(3).empty());
+
+    tallyMap.clear();
+    BOOST_CHECK(tallyMap.GetHolders(4).empty());
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_totals)
+{
+    CMPTallyMap tallyMap;
+    uint32_t a = tallyMap.AddAddress("a");
+    uint32_t b = tallyMap.AddAddress("b");
+    BOOST_CHECK_EQUAL(tallyMap.GetTotalTokens(3), 0);
+    BOOST_CHECK_EQUAL(tallyMap.GetOwnerCount(3), 0);
+
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, 100, BALANCE));
+    BOOST_CHECK(tallyMap.UpdateMoney(b, 3, 50, BALANCE));
+    BOOST_CHECK(tallyMap.UpdateMoney(b, 3, 20, PENDING));
+    BOOST_CHECK_EQUAL(tallyMap.GetTotalTokens(3), 150);
+    BOOST_CHECK_EQUAL(tallyMap.GetReservedTokens(3), 0);
+    BOOST_CHECK_EQUAL(tallyMap.GetOwnerCount(3), 2);
+
+    // moving tokens into reserve doesn't change the supply
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, -100, BALANCE));
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, 100, METADEX_RESERVE));
+    BOOST_CHECK_EQUAL(tallyMap.GetTotalTokens(3), 150);
+    BOOST_CHECK_EQUAL(tallyMap.GetReservedTokens(3), 100);
+    BOOST_CHECK_EQUAL(tallyMap.GetOwnerCount(3), 2);
+
+    // failed updates are not counted
+    BOOST_CHECK(!tallyMap.UpdateMoney(b, 3, -51, BALANCE));
+    BOOST_CHECK(tallyMap.UpdateMoney(b, 3, -50, BALANCE));
+    BOOST_CHECK_EQUAL(tallyMap.GetTotalTokens(3), 100);
+    BOOST_CHECK_EQUAL(tallyMap.GetOwnerCount(3), 1);
+    BOOST_CHECK_EQUAL(tallyMap.GetTotalTokens(4), 0);
+
+    tallyMap.clear();
+    BOOST_CHECK_EQUAL(tallyMap.GetTotalTokens(3), 0);
+    BOOST_CHECK_EQUAL(tallyMap.GetOwnerCount(3), 0);
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_credit_balances)
+{
+    CMPTallyMap tallyMap;
+    uint32_t a = tallyMap.AddAddress("a");
+    uint32_t b = tallyMap.AddAddress("b");
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, 10, METADEX_RESERVE));
+
+    std::vector<std::pair<uint32_t, int64_t> > credits{{a, 5}, {b, 7}};
+    BOOST_CHECK(tallyMap.CreditBalances(3, credits));
+    BOOST_CHECK_EQUAL(tallyMap.Get(a)->getMoney(3, BALANCE), 5);
+    BOOST_CHECK_EQUAL(tallyMap.Get(b)->getMoney(3, BALANCE), 7);
+    BOOST_CHECK(std::set<uint32_t>({a, b}) == tallyMap.GetHolders(3));
+    BOOST_CHECK_EQUAL(tallyMap.GetTotalTokens(3), 22);
+    BOOST_CHECK_EQUAL(tallyMap.GetReservedTokens(3), 10);
+    BOOST_CHECK_EQUAL(tallyMap.GetOwnerCount(3), 2);
+
+    // the credits up to an invalid one are applied
+    credits = {{b, 1}, {a, 0}, {a, 1}};
+    BOOST_CHECK(!tallyMap.CreditBalances(3, credits));
+    BOOST_CHECK_EQUAL(tallyMap.Get(a)->getMoney(3, BALANCE), 5);
+    BOOST_CHECK_EQUAL(tallyMap.Get(b)->getMoney(3, BALANCE), 8);
+    BOOST_CHECK_EQUAL(tallyMap.GetTotalTokens(3), 23);
+
+    BOOST_CHECK(tallyMap.CreditBalances(4, {}));
+    BOOST_CHECK(tallyMap.GetHolders(4).empty());
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_ranked_holders)
+{
+    CMPTallyMap tallyMap;
+    uint32_t a = tallyMap.AddAddress("a");
+    uint32_t b = tallyMap.AddAddress("b");
+    uint32_t c = tallyMap.AddAddress("c");
+
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, 10, BALANCE));
+    BOOST_CHECK(tallyMap.UpdateMoney(b, 3, 5, BALANCE));
+    BOOST_CHECK(tallyMap.UpdateMoney(c, 3, -7, PENDING));
+
+    // holders with only pending amounts are not ranked
+    typedef std::set<std::pair<int64_t, uint32_t> > Ranking;
+    BOOST_CHECK((tallyMap.GetRankedHolders(3) == Ranking{{5, b}, {10, a}}));
+
+    // the ranking follows later updates, including reserved tokens and credits
+    BOOST_CHECK(tallyMap.UpdateMoney(b, 3, 8, METADEX_RESERVE));
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, -10, BALANCE));
+    BOOST_CHECK(tallyMap.CreditBalances(3, {{c, 1}}));
+    BOOST_CHECK((tallyMap.GetRankedHolders(3) == Ranking{{1, c}, {13, b}}));
+
+    tallyMap.clear();
+    BOOST_CHECK(tallyMap.GetRankedHolders(3).empty());
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_balance_columns)
+{
+    CMPTallyMap tallyMap;
+    uint32_t a = tallyMap.AddAddress("a");
+    uint32_t b = tallyMap.AddAddress("b");
+    uint32_t c = tallyMap.AddAddress("c");
+    BOOST_CHECK(tallyMap.GetBalances(3).empty());
+
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, 10, BALANCE));
+    BOOST_CHECK(tallyMap.UpdateMoney(b, 3, 5, SELLOFFER_RESERVE));
+    BOOST_CHECK(tallyMap.UpdateMoney(c, 3, -7, PENDING));
+    BOOST_CHECK(tallyMap.UpdateMoney(c, 3, 2, ACCEPT_RESERVE));
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, 3, METADEX_RESERVE));
+    BOOST_CHECK(!tallyMap.UpdateMoney(b, 3, -1, BALANCE));
+
+    // every holder has one row, and pending amounts are excluded
+    const CPropertyBalances& balances = tallyMap.GetBalances(3);
+    BOOST_CHECK_EQUAL(balances.size(), 3U);
+    BOOST_CHECK_EQUAL(balances.GetTotalTokens(), 20);
+    BOOST_CHECK_EQUAL(balances.GetOwnerCount(), 3);
+    for (size_t row = 0; row < balances.size(); ++row) {
+        const CMPTally& tally = *tallyMap.Get(balances.ids[row]);
+        BOOST_CHECK_EQUAL(balances.balance[row], tally.getMoney(3, BALANCE));
+        BOOST_CHECK_EQUAL(balances.sellOfferReserve[row], tally.getMoney(3, SELLOFFER_RESERVE));
+        BOOST_CHECK_EQUAL(balances.acceptReserve[row], tally.getMoney(3, ACCEPT_RESERVE));
+        BOOST_CHECK_EQUAL(balances.metaDExReserve[row], tally.getMoney(3, METADEX_RESERVE));
+    }
+
+    // the last row takes the place of a removed holder
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, -10, BALANCE));
+    BOOST_CHECK(tallyMap.UpdateMoney(a, 3, -3, METADEX_RESERVE));
+    BOOST_CHECK(tallyMap.UpdateMoney(c, 3, -2, ACCEPT_RESERVE));
+    BOOST_CHECK_EQUAL(tallyMap.GetBalances(3).size(), 2U);
+    BOOST_CHECK_EQUAL(tallyMap.GetBalances(3).GetOwnerCount(), 1);
+    BOOST_CHECK(tallyMap.CreditBalances(3, {{a, 4}, {c, 1}}));
+    BOOST_CHECK_EQUAL(tallyMap.GetBalances(3).size(), 3U);
+    BOOST_CHECK_EQUAL(tallyMap.GetBalances(3).GetTotalTokens(), tallyMap.GetTotalTokens(3));
+    BOOST_CHECK_EQUAL(tallyMap.GetBalances(3).GetOwnerCount(), tallyMap.GetOwnerCount(3));
+    for (size_t row = 0; row < tallyMap.GetBalances(3).size(); ++row) {
+        const uint32_t id = tallyMap.GetBalances(3).ids[row];
+        BOOST_CHECK_EQUAL(tallyMap.GetBalances(3).GetTokens(row),
+                tallyMap.Get(id)->getMoney(3, BALANCE) + tallyMap.Get(id)->getMoneyReserved(3));
+    }
+
+    tallyMap.clear();
+    BOOST_CHECK(tallyMap.GetBalances(3).empty());
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_memory_usage)
+{
+    CMPTallyMap tallyMap;
+    size_t nEmpty = tallyMap.DynamicMemoryUsage();
+
+    uint32_t id = tallyMap.AddAddress("1PxejjeWZc9ZHph7A3SYDo2sk1Up4AcysH");
+    size_t nAddress = tallyMap.DynamicMemoryUsage();
+    BOOST_CHECK(nAddress > nEmpty);
+
+    BOOST_CHECK(tallyMap.UpdateMoney(id, 1, 100, BALANCE));
+    BOOST_CHECK(tallyMap.DynamicMemoryUsage() > nAddress);
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_modified_consumers)
+{
+    CMPTallyMap tallyMap;
+    std::vector<uint32_t> vIds;
+    uint32_t idA = tallyMap.AddAddress("1PxejjeWZc9ZHph7A3SYDo2sk1Up4AcysH");
+    uint32_t idB = tallyMap.AddAddress("1Po1oWkD2LmodfkBYiAktwh76vkF93LKnh");
+
+    // the map starts cleared
+    BOOST_CHECK(!tallyMap.TakeModified(vIds, CMPTallyMap::MODIFIED_SNAPSHOT));
+    BOOST_CHECK(!tallyMap.TakeModified(vIds, CMPTallyMap::MODIFIED_WALLET));
+
+    BOOST_CHECK(tallyMap.UpdateMoney(idA, 1, 100, BALANCE));
+    BOOST_CHECK(tallyMap.UpdateMoney(idA, 1, -10, PENDING));
+    BOOST_CHECK(tallyMap.TakeModified(vIds, CMPTallyMap::MODIFIED_SNAPSHOT));
+    BOOST_CHECK((vIds == std::vector<uint32_t>{idA}));
+
+    BOOST_CHECK(tallyMap.UpdateMoney(idB, 1, 5, BALANCE));
+    BOOST_CHECK(tallyMap.TakeModified(vIds, CMPTallyMap::MODIFIED_SNAPSHOT));
+    BOOST_CHECK((vIds == std::vector<uint32_t>{idB}));
+
+    // every consumer sees all modifications since its own last call
+    BOOST_CHECK(tallyMap.TakeModified(vIds, CMPTallyMap::MODIFIED_WALLET));
+    BOOST_CHECK((vIds == std::vector<uint32_t>{idA, idB}));
+    BOOST_CHECK(tallyMap.TakeModified(vIds, CMPTallyMap::MODIFIED_WALLET));
+    BOOST_CHECK(vIds.empty());
+
+    tallyMap.clear();
+    BOOST_CHECK(!tallyMap.TakeModified(vIds, CMPTallyMap::MODIFIED_WALLET));
+}
+
+BOOST_AUTO_TEST_CASE(tally_map_remove_empty)
+{
+    CMPTallyMap tallyMap;
+    for (int i = 0; i < 1000; ++i) {
+        uint32_t id = tallyMap.AddAddress("a" + std::to_string(i));
+        BOOST_CHECK(tallyMap.UpdateMoney(id, 3, 10, BALANCE));
+    }
+    // all but every tenth address spend their tokens, the last one while the journal is recorded
+    for (uint32_t id = 0; id < 1000; ++id) {
+        if (id % 10 != 0 && id != 999) BOOST_CHECK(tallyMap.UpdateMoney(id, 3, -10, BALANCE));
+    }
+    std::vector<CMPTallyMap::Change> changes;
+    BOOST_CHECK(!tallyMap.TakeJournal(changes));
+    tallyMap.SetJournal(true);
+    BOOST_CHECK(tallyMap.UpdateMoney(999, 3, -10, BALANCE));
+    BOOST_CHECK_EQUAL(tallyMap.size(), 1000U);
+    BOOST_CHECK_EQUAL(tallyMap.GetEmptyCount(), 900U);
+
+    std::vector<uint32_t> vIds;
+    BOOST_CHECK(!tallyMap.TakeModified(vIds, CMPTallyMap::MODIFIED_WALLET));
+    const uint64_t nClears = tallyMap.GetClearCount();
+
+    // empty addresses are removed, unless they are referred to by the caller or the journal
+    std::vector<uint32_t> vRemap;
+    BOOST_CHECK_EQUAL(tallyMap.RemoveEmpty({5}, vRemap), 898U);
+    BOOST_CHECK_EQUAL(tallyMap.size(), 102U);
+    BOOST_CHECK_EQUAL(tallyMap.GetEmptyCount(), 2U);
+    BOOST_CHECK_EQUAL(vRemap.size(), 1000U);
+    BOOST_CHECK_EQUAL(vRemap[1], CMPTallyMap::INVALID_ID);
+    BOOST_CHECK_EQUAL(tallyMap.GetId("a1"), CMPTallyMap::INVALID_ID);
+
+    // scans visit the remaining addresses only, in the same order
+    size_t nVisited = 0;
+    int64_t nTokens = 0;
+    for (const auto& entry : tallyMap) {
+        ++nVisited;
+        nTokens += entry.second.getMoney(3, BALANCE);
+    }
+    BOOST_CHECK_EQUAL(nVisited, 102U);
+    BOOST_CHECK_EQUAL(nTokens, 1000);
+    BOOST_CHECK_EQUAL(tallyMap.GetAddress(0), "a0");
+    BOOST_CHECK_EQUAL(tallyMap.GetAddress(1), "a5");
+    BOOST_CHECK_EQUAL(tallyMap.GetAddress(2), "a10");
+    BOOST_CHECK_EQUAL(tallyMap.GetAddress(101), "a999");
+    BOOST_CHECK_EQUAL(tallyMap.GetId("a990"), vRemap[990]);
+
+    // the holders and columns refer to the new identifiers
+    BOOST_CHECK_EQUAL(tallyMap.GetHolders(3).size(), 100U);
+    BOOST_CHECK_EQUAL(*tallyMap.GetHolders(3).rbegin(), vRemap[990]);
+    const CPropertyBalances& balances = tallyMap.GetBalances(3);
+    for (size_t row = 0; row < balances.size(); ++row) {
+        BOOST_CHECK_EQUAL(tallyMap.Get(balances.ids[row])->getMoney(3, BALANCE), balances.balance[row]);
+    }
+    BOOST_CHECK_EQUAL(tallyMap.GetTotalTokens(3), 1000);
+    BOOST_CHECK_EQUAL(tallyMap.GetOwnerCount(3), 100);
+
+    // the journal is translated, while the consumers of identifiers observe a clear
+    BOOST_CHECK(tallyMap.TakeJournal(changes));
+    BOOST_CHECK_EQUAL(changes.size(), 1U);
+    BOOST_CHECK_EQUAL(changes[0].id, 101U);
+    BOOST_CHECK(tallyMap.RevertChanges(changes));
+    BOOST_CHECK_EQUAL(tallyMap.Get("a999")->getMoney(3, BALANCE), 10);
+    BOOST_CHECK(!tallyMap.TakeModified(vIds, CMPTallyMap::MODIFIED_WALLET));
+    BOOST_CHECK(tallyMap.GetClearCount() != nClears);
+
+    BOOST_CHECK(tallyMap.UpdateMoney(tallyMap.GetId("a990"), 3, -10, BALANCE));
+    BOOST_CHECK(tallyMap.TakeModified(vIds, CMPTallyMap::MODIFIED_WALLET));
+    BOOST_CHECK((vIds == std::vector<uint32_t>{tallyMap.GetId("a990")}));
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,68 @@
+#include <omnicore/createpayload.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/tx.h>
+
+#include <uint256.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_tx_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(reuse_transaction_object)
+{
+    std::vector<unsigned char> vchIssuance = CreatePayload_IssuanceFixed(1, 1, 0, "Companies", "Bitcoin Mining",
+            "Quantum Miner", "www.example.com", "Quantum Miner Tokens", 1000000);
+    std::vector<unsigned char> vchSend = CreatePayload_SimpleSend(31, 5000);
+
+    CMPTransaction mp_obj;
+    mp_obj.Set("Alice", "", 0, uint256S("01"), 350000, 1, vchIssuance.data(), vchIssuance.size(), OMNI_CLASS_C, 1000);
+    BOOST_CHECK(mp_obj.interpret_Transaction());
+    BOOST_CHECK_EQUAL(mp_obj.getSPName(), "Quantum Miner");
+    BOOST_CHECK_EQUAL(mp_obj.getSPData(), "Quantum Miner Tokens");
+    BOOST_CHECK_EQUAL(mp_obj.getAmount(), 1000000U);
+
+    // the object is reset and reused for another transaction
+    mp_obj.SetNull();
+    BOOST_CHECK_EQUAL(mp_obj.getPayloadSize(), 0);
+    BOOST_CHECK(mp_obj.getSPName().empty());
+    mp_obj.Set("Alice", "Bob", 0, uint256S("02"), 350000, 2, vchSend.data(), vchSend.size(), OMNI_CLASS_C, 1000);
+    BOOST_CHECK(mp_obj.interpret_Transaction());
+    BOOST_CHECK_EQUAL(mp_obj.getPayload(), HexStr(vchSend));
+    BOOST_CHECK_EQUAL(mp_obj.getProperty(), 31U);
+    BOOST_CHECK_EQUAL(mp_obj.getAmount(), 5000U);
+    BOOST_CHECK(mp_obj.getSPName().empty());
+    BOOST_CHECK(mp_obj.getSPCategory().empty());
+}
+
+BOOST_AUTO_TEST_CASE(truncated_string_fields)
+{
+    // the string fields are limited to SP_STRING_FIELD_LEN - 1 characters
+    const std::string strLong(SP_STRING_FIELD_LEN + 50, 'x');
+    std::vector<unsigned char> vchPayload = CreatePayload_IssuanceFixed(1, 1, 0, "", "", strLong, "", "", 1000);
+
+    CMPTransaction mp_obj;
+    mp_obj.Set("Alice", "", 0, uint256S("01"), 350000, 1, vchPayload.data(), vchPayload.size(), OMNI_CLASS_B, 1000);
+    BOOST_CHECK(mp_obj.interpret_Transaction());
+    BOOST_CHECK_EQUAL(mp_obj.getSPName(), std::string(SP_STRING_FIELD_LEN - 1, 'x'));
+    BOOST_CHECK_EQUAL(mp_obj.getAmount(), 1000U);
+}
+
+BOOST_AUTO_TEST_CASE(unterminated_string_fields)
+{
+    // the strings extend past the end of the payload, which is rejected as overrun
+    std::vector<unsigned char> vchPayload = CreatePayload_IssuanceFixed(1, 1, 0, "Companies", "Bitcoin Mining",
+            "Quantum Miner", "www.example.com", "Quantum Miner Tokens", 1000000);
+    vchPayload.resize(30);
+
+    CMPTransaction mp_obj;
+    mp_obj.Set("Alice", "", 0, uint256S("01"), 350000, 1, vchPayload.data(), vchPayload.size(), OMNI_CLASS_C, 1000);
+    BOOST_CHECK(!mp_obj.interpret_Transaction());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
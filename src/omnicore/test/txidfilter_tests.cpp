@@ -0,0 +1,51 @@
+#include <omnicore/txidfilter.h>
+
+#include <arith_uint256.h>
+#include <uint256.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stddef.h>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_txidfilter_tests, BasicTestingSetup)
+
+static uint256 MakeTxid(unsigned int n)
+{
+    return ArithToUint256(arith_uint256(n) * 2654435761U);
+}
+
+BOOST_AUTO_TEST_CASE(txidfilter_no_false_negatives)
+{
+    COmniTxidFilter filter(1000);
+    for (unsigned int n = 1; n <= 1000; ++n) {
+        filter.Insert(MakeTxid(n));
+    }
+    BOOST_CHECK(filter.IsFull());
+    for (unsigned int n = 1; n <= 1000; ++n) {
+        BOOST_CHECK(filter.MayContain(MakeTxid(n)));
+    }
+
+    // at about 1 %, far less than 5 % of other txids should match
+    size_t nFalsePositives = 0;
+    for (unsigned int n = 1001; n <= 11000; ++n) {
+        if (filter.MayContain(MakeTxid(n))) ++nFalsePositives;
+    }
+    BOOST_CHECK(nFalsePositives < 500);
+
+    filter.Reset(10);
+    BOOST_CHECK_EQUAL(filter.Size(), 0U);
+    BOOST_CHECK(!filter.MayContain(MakeTxid(1)));
+}
+
+BOOST_AUTO_TEST_CASE(txidfilter_unsized)
+{
+    // without capacity, the filter can't rule out anything
+    COmniTxidFilter filter;
+    BOOST_CHECK(filter.MayContain(MakeTxid(1)));
+    filter.Insert(MakeTxid(1));
+    BOOST_CHECK_EQUAL(filter.Size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,83 @@
+#include <omnicore/txobjectcache.h>
+
+#include <arith_uint256.h>
+#include <uint256.h>
+
+#include <test/util/setup_common.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_txobjectcache_tests, BasicTestingSetup)
+
+static uint256 MakeTxid(uint32_t n)
+{
+    return ArithToUint256(arith_uint256(n + 1));
+}
+
+static COmniTxObjectCache::Entry MakeEntry(int64_t amount)
+{
+    COmniTxObjectCache::Entry entry;
+    entry.txobj = UniValue(UniValue::VOBJ);
+    entry.txobj.pushKV("amount", amount);
+    entry.blockHash = uint256S("a0");
+    entry.sender = "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb";
+    return entry;
+}
+
+BOOST_AUTO_TEST_CASE(txobjectcache_lru)
+{
+    COmniTxObjectCache cache(2);
+    COmniTxObjectCache::Entry entry;
+
+    cache.Add(MakeTxid(0), MakeEntry(1000));
+    cache.Add(MakeTxid(1), MakeEntry(2000));
+
+    // mark the first object as recently used
+    BOOST_CHECK(cache.Get(MakeTxid(0), entry));
+    BOOST_CHECK_EQUAL(entry.txobj["amount"].get_int64(), 1000);
+    BOOST_CHECK_EQUAL(entry.sender, "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb");
+
+    // the second object is the least recently used one
+    cache.Add(MakeTxid(2), MakeEntry(3000));
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+    BOOST_CHECK(!cache.Get(MakeTxid(1), entry));
+    BOOST_CHECK(cache.Get(MakeTxid(0), entry));
+    BOOST_CHECK(cache.Get(MakeTxid(2), entry));
+    BOOST_CHECK_EQUAL(entry.txobj["amount"].get_int64(), 3000);
+
+    BOOST_CHECK_EQUAL(cache.GetHits(), 3U);
+    BOOST_CHECK_EQUAL(cache.GetMisses(), 1U);
+    BOOST_CHECK_EQUAL(cache.GetEvictions(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(txobjectcache_clear)
+{
+    COmniTxObjectCache cache(10);
+    COmniTxObjectCache::Entry entry;
+
+    for (uint32_t n = 0; n < 10; ++n) {
+        cache.Add(MakeTxid(n), MakeEntry(n));
+    }
+    cache.SetMaxSize(4);
+    BOOST_CHECK_EQUAL(cache.Size(), 4U);
+    BOOST_CHECK_EQUAL(cache.GetEvictions(), 6U);
+    BOOST_CHECK(cache.Get(MakeTxid(9), entry));
+    BOOST_CHECK(!cache.Get(MakeTxid(5), entry));
+
+    // after a reorganization nothing is served from the cache
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    BOOST_CHECK(!cache.Get(MakeTxid(9), entry));
+    BOOST_CHECK_EQUAL(cache.GetHits(), 1U);
+
+    // a cache without capacity doesn't hold anything
+    cache.SetMaxSize(0);
+    cache.Add(MakeTxid(0), MakeEntry(0));
+    BOOST_CHECK(!cache.Get(MakeTxid(0), entry));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
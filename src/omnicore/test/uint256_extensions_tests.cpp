@@ -6,7 +6,9 @@
 #include <boost/test/unit_test.hpp>
 
 #include <stdint.h>
+#include <algorithm>
 #include <limits>
+#include <vector>
 
 using namespace mastercore;
 
@@ -102,5 +104,84 @@ BOOST_AUTO_TEST_CASE(uint256_const)
     BOOST_CHECK_EQUAL(std::numeric_limits<int64_t>::max(), ConvertTo64(mastercore::uint256_const::max_int64));
 }
 
+BOOST_AUTO_TEST_CASE(multiply_and_divide)
+{
+    const int64_t max = std::numeric_limits<int64_t>::max();
+
+    BOOST_CHECK_EQUAL(2, MultiplyAndDivide(5, 3, 7));
+    BOOST_CHECK_EQUAL(3, MultiplyAndDivideRoundUp(5, 3, 7));
+    BOOST_CHECK_EQUAL(3, MultiplyAndDivideRoundUp(7, 3, 7));
+    BOOST_CHECK_EQUAL(0, MultiplyAndDivideRoundUp(0, 3, 0));
+    BOOST_CHECK_EQUAL(max, MultiplyAndDivide(max, max, max));
+    BOOST_CHECK_EQUAL(max - 1, MultiplyAndDivide(max, max - 1, max));
+    BOOST_CHECK_EQUAL(max - 1, MultiplyAndDivideRoundUp(max - 1, max - 1, max));
+
+    int64_t result = 0;
+    BOOST_CHECK(!CheckedMultiplyAndDivide(max, 2, 1, false, result));
+    BOOST_CHECK(!CheckedMultiplyAndDivide(max, max, max - 1, true, result));
+    BOOST_CHECK(CheckedMultiplyAndDivide(max, 2, 2, false, result));
+    BOOST_CHECK_EQUAL(max, result);
+}
+
+#ifdef __SIZEOF_INT128__
+/** Checks, whether the native and the 256 bit calculations yield the same results. */
+static void CheckMultiplyAndDivideEquivalence(int64_t a, int64_t b, int64_t c)
+{
+    for (bool fRoundUp : {false, true}) {
+        int64_t result128 = -1;
+        int64_t result256 = -1;
+        bool fInRange128 = CheckedMultiplyAndDivide128(a, b, c, fRoundUp, result128);
+        bool fInRange256 = CheckedMultiplyAndDivide256(a, b, c, fRoundUp, result256);
+        BOOST_REQUIRE_EQUAL(fInRange128, fInRange256);
+        if (fInRange128) BOOST_REQUIRE_EQUAL(result128, result256);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(multiply_and_divide_equivalence_small)
+{
+    // all small factors and divisors
+    for (int64_t a = 0; a <= 64; ++a) {
+        for (int64_t b = 0; b <= 64; ++b) {
+            for (int64_t c = 1; c <= 64; ++c) {
+                CheckMultiplyAndDivideEquivalence(a, b, c);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(multiply_and_divide_equivalence_bounds)
+{
+    // all combinations of the values around every third power of two
+    std::vector<int64_t> values;
+    for (int bits = 0; bits < 63; bits += 3) {
+        const int64_t power = int64_t(1) << bits;
+        values.push_back(power - 1);
+        values.push_back(power);
+        values.push_back(power + 1);
+    }
+    values.push_back(std::numeric_limits<int64_t>::max() - 1);
+    values.push_back(std::numeric_limits<int64_t>::max());
+
+    for (int64_t a : values) {
+        for (int64_t b : values) {
+            for (int64_t c : values) {
+                if (c > 0) CheckMultiplyAndDivideEquivalence(a, b, c);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(multiply_and_divide_equivalence_random)
+{
+    // random values of random sizes, where the results are mostly in range, as for pro-rated amounts
+    for (int i = 0; i < 100000; ++i) {
+        const int64_t a = InsecureRandBits(1 + InsecureRandRange(63));
+        const int64_t b = InsecureRandBits(1 + InsecureRandRange(63));
+        const int64_t c = 1 + InsecureRandBits(InsecureRandRange(63));
+        CheckMultiplyAndDivideEquivalence(a, b, c);
+        CheckMultiplyAndDivideEquivalence(std::min(a, c), b, c);
+    }
+}
+#endif
 
 BOOST_AUTO_TEST_SUITE_END()
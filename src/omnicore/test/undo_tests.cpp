@@ -0,0 +1,190 @@
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+#include <omnicore/undo.h>
+
+#include <sync.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+#include <string>
+
+extern int64_t exodus_prev;
+
+using namespace mastercore;
+
+namespace {
+struct UndoTestingSetup : BasicTestingSetup
+{
+    UndoTestingSetup()
+    {
+        LOCK(cs_tally);
+        pDbSpInfo = new CMPSPInfo(GetDataDir() / "MP_spinfo_undo", true);
+        mp_tally_map.clear();
+        my_offers.clear();
+        exodus_prev = 0;
+        InitUndoJournal(2);
+    }
+
+    ~UndoTestingSetup()
+    {
+        LOCK(cs_tally);
+        InitUndoJournal(0);
+        mp_tally_map.clear();
+        my_offers.clear();
+        ClearFreezeState();
+        exodus_prev = 0;
+        delete pDbSpInfo;
+        pDbSpInfo = nullptr;
+    }
+};
+
+void UpdateMoney(const std::string& address, uint32_t propertyId, int64_t amount, TallyType ttype)
+{
+    LOCK(cs_tally);
+    BOOST_CHECK(mp_tally_map.UpdateMoney(mp_tally_map.AddAddress(address), propertyId, amount, ttype));
+}
+
+int64_t GetMoney(const std::string& address, uint32_t propertyId, TallyType ttype)
+{
+    LOCK(cs_tally);
+    const CMPTally* pTally = mp_tally_map.Get(address);
+    return pTally ? pTally->getMoney(propertyId, ttype) : 0;
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_undo_tests, UndoTestingSetup)
+
+BOOST_AUTO_TEST_CASE(undo_blocks)
+{
+    UpdateMoney("a", OMNI_PROPERTY_MSC, 100, BALANCE);
+
+    LOCK(cs_tally);
+    BeginBlockUndo(10, uint256S("09"), 9);
+    UpdateMoney("a", OMNI_PROPERTY_MSC, -40, BALANCE);
+    UpdateMoney("b", OMNI_PROPERTY_MSC, 40, BALANCE);
+    exodus_prev = 5;
+    EndBlockUndo(10, uint256S("0a"));
+
+    BeginBlockUndo(11, uint256S("0a"), 10);
+    UpdateMoney("b", OMNI_PROPERTY_MSC, -15, BALANCE);
+    UpdateMoney("b", OMNI_PROPERTY_MSC, 15, METADEX_RESERVE);
+    my_offers[CDExOfferKey("b", 1)] = CMPOffer();
+    exodus_prev = 7;
+    EndBlockUndo(11, uint256S("0b"));
+    BOOST_CHECK_EQUAL(GetUndoBlockCount(), 2);
+
+    // pending amounts are not part of the undo journal
+    UpdateMoney("a", OMNI_PROPERTY_MSC, -10, PENDING);
+
+    // the fork block doesn't match
+    BOOST_CHECK_EQUAL(UndoBlocks(11, uint256S("ff")), -1);
+    BOOST_CHECK_EQUAL(GetUndoBlockCount(), 2);
+    // not covered by the journal
+    BOOST_CHECK_EQUAL(UndoBlocks(9, uint256S("08")), -1);
+
+    BOOST_CHECK_EQUAL(UndoBlocks(11, uint256S("0a")), 10);
+    BOOST_CHECK_EQUAL(GetUndoBlockCount(), 1);
+    BOOST_CHECK_EQUAL(GetMoney("b", OMNI_PROPERTY_MSC, BALANCE), 40);
+    BOOST_CHECK_EQUAL(GetMoney("b", OMNI_PROPERTY_MSC, METADEX_RESERVE), 0);
+    BOOST_CHECK(my_offers.empty());
+    BOOST_CHECK_EQUAL(exodus_prev, 5);
+
+    BOOST_CHECK_EQUAL(UndoBlocks(10, uint256S("09")), 9);
+    BOOST_CHECK_EQUAL(GetUndoBlockCount(), 0);
+    BOOST_CHECK_EQUAL(GetMoney("a", OMNI_PROPERTY_MSC, BALANCE), 100);
+    BOOST_CHECK_EQUAL(GetMoney("a", OMNI_PROPERTY_MSC, PENDING), -10);
+    BOOST_CHECK_EQUAL(GetMoney("b", OMNI_PROPERTY_MSC, BALANCE), 0);
+    BOOST_CHECK_EQUAL(mp_tally_map.GetTotalTokens(OMNI_PROPERTY_MSC), 100);
+    BOOST_CHECK_EQUAL(mp_tally_map.GetOwnerCount(OMNI_PROPERTY_MSC), 1);
+    BOOST_CHECK_EQUAL(exodus_prev, 0);
+}
+
+BOOST_AUTO_TEST_CASE(undo_shared_state)
+{
+    LOCK(cs_tally);
+    BeginBlockUndo(10, uint256S("09"), 9);
+    my_offers[CDExOfferKey("a", 1)] = CMPOffer(10, 100, 1, 50, 0, 10, uint256S("01"));
+    EndBlockUndo(10, uint256S("0a"));
+
+    // a block without changes shares the copy of the offers
+    BeginBlockUndo(11, uint256S("0a"), 10);
+    EndBlockUndo(11, uint256S("0b"));
+    my_offers.clear();
+
+    BOOST_CHECK_EQUAL(UndoBlocks(11, uint256S("0a")), 10);
+    BOOST_CHECK_EQUAL(my_offers.size(), 1U);
+    BOOST_CHECK(my_offers[CDExOfferKey("a", 1)] == CMPOffer(10, 100, 1, 50, 0, 10, uint256S("01")));
+
+    BOOST_CHECK_EQUAL(UndoBlocks(10, uint256S("09")), 9);
+    BOOST_CHECK(my_offers.empty());
+}
+
+BOOST_AUTO_TEST_CASE(undo_freeze_state)
+{
+    const std::string address = "1MCHESTxYkPSLoJ57WBQot7vz3xkNahkcb";
+
+    LOCK(cs_tally);
+    BeginBlockUndo(10, uint256S("09"), 9);
+    enableFreezing(3, 10);
+    EndBlockUndo(10, uint256S("0a"));
+
+    BeginBlockUndo(11, uint256S("0a"), 10);
+    freezeAddress(address, 3);
+    EndBlockUndo(11, uint256S("0b"));
+
+    BeginBlockUndo(12, uint256S("0b"), 11);
+    disableFreezing(3);
+    EndBlockUndo(12, uint256S("0c"));
+    BOOST_CHECK(!isFreezingEnabled(3, 12));
+    BOOST_CHECK(!isAddressFrozen(address, 3));
+
+    // the freeze state is rolled back like the balances, without a reparse
+    BOOST_CHECK_EQUAL(UndoBlocks(12, uint256S("0b")), 11);
+    BOOST_CHECK(isFreezingEnabled(3, 12));
+    BOOST_CHECK(isAddressFrozen(address, 3));
+
+    BOOST_CHECK_EQUAL(UndoBlocks(11, uint256S("0a")), 10);
+    BOOST_CHECK(isFreezingEnabled(3, 12));
+    BOOST_CHECK(!isAddressFrozen(address, 3));
+}
+
+BOOST_AUTO_TEST_CASE(undo_limited_blocks)
+{
+    LOCK(cs_tally);
+    // blocks further away from the tip are not recorded
+    BeginBlockUndo(1, uint256S("00"), 100);
+    UpdateMoney("a", OMNI_PROPERTY_MSC, 1, BALANCE);
+    EndBlockUndo(1, uint256S("01"));
+    BOOST_CHECK_EQUAL(GetUndoBlockCount(), 0);
+
+    for (int nBlock = 99; nBlock <= 101; ++nBlock) {
+        BeginBlockUndo(nBlock, uint256S(strprintf("%02x", nBlock - 1)), 100);
+        UpdateMoney("a", OMNI_PROPERTY_MSC, 1, BALANCE);
+        EndBlockUndo(nBlock, uint256S(strprintf("%02x", nBlock)));
+    }
+    // only the last two blocks are kept
+    BOOST_CHECK_EQUAL(GetUndoBlockCount(), 2);
+    BOOST_CHECK_EQUAL(UndoBlocks(99, uint256S(strprintf("%02x", 98))), -1);
+    BOOST_CHECK_EQUAL(UndoBlocks(100, uint256S(strprintf("%02x", 99))), 99);
+    BOOST_CHECK_EQUAL(GetUndoBlockCount(), 0);
+    BOOST_CHECK_EQUAL(GetMoney("a", OMNI_PROPERTY_MSC, BALANCE), 2);
+
+    // clearing the balances invalidates the journal
+    BeginBlockUndo(100, uint256S(strprintf("%02x", 99)), 99);
+    EndBlockUndo(100, uint256S(strprintf("%02x", 100)));
+    BOOST_CHECK_EQUAL(GetUndoBlockCount(), 1);
+    mp_tally_map.clear();
+    BeginBlockUndo(101, uint256S(strprintf("%02x", 100)), 100);
+    BOOST_CHECK_EQUAL(GetUndoBlockCount(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
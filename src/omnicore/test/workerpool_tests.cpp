@@ -0,0 +1,130 @@
+#include <omnicore/workerpool.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <stddef.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mastercore;
+
+BOOST_FIXTURE_TEST_SUITE(omnicore_workerpool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(workerpool_serial)
+{
+    CWorkerPool pool(0, "omnitest");
+    BOOST_CHECK_EQUAL(pool.Size(), 0U);
+
+    std::vector<size_t> vCalls;
+    pool.ForEach(5, [&](size_t n) { vCalls.push_back(n); });
+
+    BOOST_CHECK_EQUAL(vCalls.size(), 5U);
+    for (size_t n = 0; n < vCalls.size(); ++n) {
+        BOOST_CHECK_EQUAL(vCalls[n], n);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(workerpool_parallel)
+{
+    CWorkerPool pool(3, "omnitest");
+    BOOST_CHECK_EQUAL(pool.Size(), 3U);
+
+    for (int nRound = 0; nRound < 10; ++nRound) {
+        std::vector<int> vResults(1000, 0);
+        std::atomic<int> nCalls(0);
+        pool.ForEach(vResults.size(), [&](size_t n) {
+            vResults[n] = static_cast<int>(n) * 2;
+            ++nCalls;
+        });
+
+        BOOST_CHECK_EQUAL(nCalls.load(), 1000);
+        for (size_t n = 0; n < vResults.size(); ++n) {
+            BOOST_CHECK_EQUAL(vResults[n], static_cast<int>(n) * 2);
+        }
+    }
+
+    // nothing to do
+    pool.ForEach(0, [&](size_t n) { BOOST_ERROR("unexpected call"); });
+}
+
+BOOST_AUTO_TEST_CASE(workerpool_shared)
+{
+    CWorkerPool pool(3, "omnitest");
+
+    // several threads use the pool at the same time, and tasks use the pool themselves
+    std::vector<std::vector<int> > vResults(4, std::vector<int>(100, 0));
+    std::vector<std::thread> vCallers;
+    for (size_t nCaller = 0; nCaller < vResults.size(); ++nCaller) {
+        vCallers.emplace_back([&pool, &vResults, nCaller] {
+            pool.ForEach(10, [&](size_t n) {
+                pool.ForEach(10, [&](size_t m) { vResults[nCaller][n * 10 + m] += 1; });
+            });
+        });
+    }
+    for (std::thread& caller : vCallers) {
+        caller.join();
+    }
+
+    for (const std::vector<int>& vCounts : vResults) {
+        for (int nCount : vCounts) {
+            BOOST_CHECK_EQUAL(nCount, 1);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(workerpool_max_threads)
+{
+    CWorkerPool pool(3, "omnitest");
+
+    std::atomic<int> nActive(0);
+    std::atomic<int> nMaxActive(0);
+    pool.ForEach(200, [&](size_t n) {
+        int nNow = ++nActive;
+        int nMax = nMaxActive;
+        while (nNow > nMax && !nMaxActive.compare_exchange_weak(nMax, nNow)) {}
+        std::this_thread::yield();
+        --nActive;
+    }, 2);
+
+    BOOST_CHECK(nMaxActive.load() >= 1);
+    BOOST_CHECK(nMaxActive.load() <= 2);
+}
+
+BOOST_AUTO_TEST_CASE(workerpool_map)
+{
+    CWorkerPool pool(3, "omnitest");
+
+    std::vector<std::string> vResults = pool.Map<std::string>(500, [](size_t n) { return std::to_string(n); });
+
+    BOOST_REQUIRE_EQUAL(vResults.size(), 500U);
+    for (size_t n = 0; n < vResults.size(); ++n) {
+        BOOST_CHECK_EQUAL(vResults[n], std::to_string(n));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(workerpool_interrupt)
+{
+    CWorkerPool pool(3, "omnitest");
+
+    std::atomic<int> nCalls(0);
+    BOOST_CHECK(pool.ForEachInterruptible(100, [&](size_t n) { ++nCalls; }));
+    BOOST_CHECK_EQUAL(nCalls.load(), 100);
+
+    // the remaining interruptible tasks are skipped, while the others still run serially
+    pool.Stop();
+    BOOST_CHECK_EQUAL(pool.Size(), 0U);
+
+    nCalls = 0;
+    BOOST_CHECK(!pool.ForEachInterruptible(100, [&](size_t n) { ++nCalls; }));
+    BOOST_CHECK_EQUAL(nCalls.load(), 0);
+
+    pool.ForEach(100, [&](size_t n) { ++nCalls; });
+    BOOST_CHECK_EQUAL(nCalls.load(), 100);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
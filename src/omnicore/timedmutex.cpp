@@ -0,0 +1,189 @@
+/**
+ * @file timedmutex.cpp
+ *
+ * This file contains a recursive mutex, which records the time spent waiting for it,
+ * and the contention statistics of the Omni locks.
+ */
+
+#include <omnicore/timedmutex.h>
+
+#include <util/time.h>
+
+#include <univalue.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! Microseconds the current thread waited for timed mutexes
+static thread_local int64_t nThreadLockWaitTime = 0;
+
+//! Call site of the next lock of an instrumented mutex by the current thread
+static thread_local const char* pszThreadLockFile = nullptr;
+static thread_local int nThreadLockLine = 0;
+
+//! Whether the contention statistics are recorded
+static std::atomic<bool> fLockStatsEnabled{DEFAULT_OMNI_LOCK_STATS};
+
+/** The statistics of all named locks, which are alive. */
+struct LockStatsRegistry
+{
+    std::mutex mutex;
+    std::vector<CLockStats*> vStats;
+};
+
+static LockStatsRegistry& GetLockStatsRegistry()
+{
+    // constructed with the first lock, so it outlives the locks with static storage
+    static LockStatsRegistry registry;
+    return registry;
+}
+
+int64_t GetThreadLockWaitTime()
+{
+    return nThreadLockWaitTime;
+}
+
+void AddThreadLockWaitTime(int64_t nMicros)
+{
+    nThreadLockWaitTime += nMicros;
+}
+
+void EnableLockStats(bool fEnable)
+{
+    fLockStatsEnabled.store(fEnable, std::memory_order_relaxed);
+}
+
+bool IsLockStatsEnabled()
+{
+    return fLockStatsEnabled.load(std::memory_order_relaxed);
+}
+
+UniValue GetLockStats(size_t nSites, bool fReset)
+{
+    UniValue locks(UniValue::VARR);
+
+    LockStatsRegistry& registry = GetLockStatsRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (CLockStats* pStats : registry.vStats) {
+        locks.push_back(pStats->ToJSON(nSites));
+        if (fReset) pStats->Reset();
+    }
+
+    return locks;
+}
+
+CLockStats::CLockStats(const char* pszName) : m_name(pszName ? pszName : "")
+{
+    if (m_name.empty()) return;
+
+    LockStatsRegistry& registry = GetLockStatsRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.vStats.push_back(this);
+}
+
+CLockStats::~CLockStats()
+{
+    if (m_name.empty()) return;
+
+    LockStatsRegistry& registry = GetLockStatsRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.vStats.erase(std::remove(registry.vStats.begin(), registry.vStats.end(), this), registry.vStats.end());
+}
+
+void CLockStats::AddWait(int64_t nMicros, const char* pszFile, int nLine)
+{
+    const std::string strSite = pszFile ? std::string(pszFile) + ":" + std::to_string(nLine) : "unknown";
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (SiteStats* pSite : {&m_total, &m_sites[strSite]}) {
+        ++pSite->nWaits;
+        pSite->nTotalWait += nMicros;
+        pSite->nMaxWait = std::max(pSite->nMaxWait, nMicros);
+    }
+}
+
+UniValue CLockStats::ToJSON(size_t nSites) const
+{
+    std::vector<std::pair<std::string, SiteStats> > vSites;
+    UniValue result(UniValue::VOBJ);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        result.pushKV("name", m_name);
+        result.pushKV("acquisitions", m_nAcquisitions.load(std::memory_order_relaxed));
+        result.pushKV("contended", m_total.nWaits);
+        result.pushKV("totalwait", m_total.nTotalWait / 1000000.0);
+        result.pushKV("maxwait", m_total.nMaxWait / 1000000.0);
+        vSites.assign(m_sites.begin(), m_sites.end());
+    }
+
+    std::sort(vSites.begin(), vSites.end(), [](const std::pair<std::string, SiteStats>& a, const std::pair<std::string, SiteStats>& b) {
+        return a.second.nTotalWait > b.second.nTotalWait;
+    });
+    if (vSites.size() > nSites) vSites.resize(nSites);
+
+    UniValue sites(UniValue::VARR);
+    for (const std::pair<std::string, SiteStats>& site : vSites) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("site", site.first);
+        entry.pushKV("waits", site.second.nWaits);
+        entry.pushKV("totalwait", site.second.nTotalWait / 1000000.0);
+        entry.pushKV("maxwait", site.second.nMaxWait / 1000000.0);
+        sites.push_back(entry);
+    }
+    result.pushKV("sites", sites);
+
+    return result;
+}
+
+void CLockStats::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nAcquisitions.store(0, std::memory_order_relaxed);
+    m_total = SiteStats();
+    m_sites.clear();
+}
+
+void SetInstrumentedLockSite(const char* pszFile, int nLine)
+{
+    pszThreadLockFile = pszFile;
+    nThreadLockLine = nLine;
+}
+
+int64_t CInstrumentedRecursiveMutex::LockTimed()
+{
+    // the call site is only valid for the lock, it was set for
+    const char* pszFile = pszThreadLockFile;
+    const int nLine = nThreadLockLine;
+    pszThreadLockFile = nullptr;
+
+    const bool fStats = IsLockStatsEnabled();
+    if (fStats) m_stats.AddAcquisition();
+
+    if (RecursiveMutex::try_lock()) {
+        return 0;
+    }
+
+    const int64_t nStart = GetTimeMicros();
+    RecursiveMutex::lock();
+    const int64_t nWaited = GetTimeMicros() - nStart;
+    if (fStats) m_stats.AddWait(nWaited, pszFile, nLine);
+
+    return nWaited;
+}
+
+bool CInstrumentedRecursiveMutex::try_lock()
+{
+    pszThreadLockFile = nullptr;
+    if (!RecursiveMutex::try_lock()) {
+        return false;
+    }
+    if (IsLockStatsEnabled()) m_stats.AddAcquisition();
+    return true;
+}
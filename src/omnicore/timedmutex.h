@@ -0,0 +1,147 @@
+#ifndef BITCOIN_OMNICORE_TIMEDMUTEX_H
+#define BITCOIN_OMNICORE_TIMEDMUTEX_H
+
+#include <sync.h>
+#include <threadsafety.h>
+#include <util/time.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+class UniValue;
+
+//! Default for recording the contention statistics of the Omni locks
+static const bool DEFAULT_OMNI_LOCK_STATS = false;
+//! Number of call sites with the longest waits, which are reported per lock
+static const size_t LOCK_STATS_TOP_SITES = 10;
+
+/** Returns the number of microseconds the current thread waited for timed mutexes. */
+int64_t GetThreadLockWaitTime();
+
+/** Adds to the number of microseconds the current thread waited for timed mutexes. */
+void AddThreadLockWaitTime(int64_t nMicros);
+
+/** Enables or disables recording the contention statistics of the Omni locks. */
+void EnableLockStats(bool fEnable);
+
+/** Returns whether the contention statistics of the Omni locks are recorded. */
+bool IsLockStatsEnabled();
+
+/** Returns the contention statistics of the Omni locks, and optionally resets them. */
+UniValue GetLockStats(size_t nSites, bool fReset);
+
+/**
+ * Contention statistics of one lock.
+ *
+ * Acquisitions are counted without locks, only contended acquisitions record the
+ * time waited, in total and per call site.
+ */
+class CLockStats
+{
+private:
+    struct SiteStats
+    {
+        uint64_t nWaits = 0;
+        int64_t nTotalWait = 0;
+        int64_t nMaxWait = 0;
+    };
+
+    const std::string m_name;
+    std::atomic<uint64_t> m_nAcquisitions{0};
+    mutable std::mutex m_mutex;
+    SiteStats m_total;
+    //! Waits by call site, as "file:line"
+    std::map<std::string, SiteStats> m_sites;
+
+public:
+    /** Creates the statistics, which are reported under the name, unless it's null. */
+    explicit CLockStats(const char* pszName);
+    ~CLockStats();
+
+    void AddAcquisition() { m_nAcquisitions.fetch_add(1, std::memory_order_relaxed); }
+
+    /** Adds a contended acquisition, and the time waited at the call site. */
+    void AddWait(int64_t nMicros, const char* pszFile, int nLine);
+
+    /** Returns the statistics with the call sites, which waited the longest. */
+    UniValue ToJSON(size_t nSites) const;
+
+    void Reset();
+};
+
+/**
+ * Recursive mutex, which records its contention statistics, while enabled.
+ *
+ * The lock is tried first, so only contended locks are timed. The call site of
+ * waiting locks is passed by the LOCK() macros via SetLockSite().
+ */
+class LOCKABLE CInstrumentedRecursiveMutex : public RecursiveMutex
+{
+private:
+    CLockStats m_stats;
+
+protected:
+    /** Locks the mutex, and returns the number of microseconds waited. */
+    int64_t LockTimed();
+
+public:
+    explicit CInstrumentedRecursiveMutex(const char* pszName = nullptr) : m_stats(pszName) {}
+
+    void lock() EXCLUSIVE_LOCK_FUNCTION() { LockTimed(); }
+
+    bool try_lock() EXCLUSIVE_TRYLOCK_FUNCTION(true);
+
+    using UniqueLock = std::unique_lock<CInstrumentedRecursiveMutex>;
+};
+
+/**
+ * Recursive mutex, which also records how long the locking thread waited for it.
+ */
+class LOCKABLE CTimedRecursiveMutex : public CInstrumentedRecursiveMutex
+{
+public:
+    explicit CTimedRecursiveMutex(const char* pszName = nullptr) : CInstrumentedRecursiveMutex(pszName) {}
+
+    void lock() EXCLUSIVE_LOCK_FUNCTION() { AddThreadLockWaitTime(LockTimed()); }
+
+    using UniqueLock = std::unique_lock<CTimedRecursiveMutex>;
+};
+
+/** Sets the call site of the next lock of an instrumented mutex by the current thread. */
+void SetInstrumentedLockSite(const char* pszFile, int nLine);
+
+inline void SetLockSite(CInstrumentedRecursiveMutex& mutex, const char* pszFile, int nLine)
+{
+    SetInstrumentedLockSite(pszFile, nLine);
+}
+
+inline void SetLockSite(CTimedRecursiveMutex& mutex, const char* pszFile, int nLine)
+{
+    SetInstrumentedLockSite(pszFile, nLine);
+}
+
+/** Locks a deferred lock of another mutex type, and records it in the statistics, while enabled. */
+template <typename Lock>
+void LockWithStats(Lock& lock, CLockStats& stats, const char* pszFile, int nLine)
+{
+    if (!IsLockStatsEnabled()) {
+        lock.lock();
+        return;
+    }
+
+    stats.AddAcquisition();
+    if (lock.try_lock()) {
+        return;
+    }
+
+    const int64_t nStart = GetTimeMicros();
+    lock.lock();
+    stats.AddWait(GetTimeMicros() - nStart, pszFile, nLine);
+}
+
+#endif // BITCOIN_OMNICORE_TIMEDMUTEX_H
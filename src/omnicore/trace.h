@@ -0,0 +1,40 @@
+#ifndef BITCOIN_OMNICORE_TRACE_H
+#define BITCOIN_OMNICORE_TRACE_H
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+/**
+ * Static tracepoints of the Omni block processing, for USDT tools such as bpftrace.
+ *
+ * The tracepoints are only built in with the configure option --enable-omni-usdt,
+ * and otherwise compile to nothing, so their arguments are not evaluated. An attached
+ * tracepoint costs a trap, an unattached one a nop. The tracepoints are listed in
+ * omnicore/doc/tracing.md.
+ */
+#ifdef ENABLE_OMNI_TRACING
+
+#include <sys/sdt.h>
+
+#define OMNI_TRACE(event) DTRACE_PROBE(omnicore, event)
+#define OMNI_TRACE1(event, a) DTRACE_PROBE1(omnicore, event, a)
+#define OMNI_TRACE2(event, a, b) DTRACE_PROBE2(omnicore, event, a, b)
+#define OMNI_TRACE3(event, a, b, c) DTRACE_PROBE3(omnicore, event, a, b, c)
+#define OMNI_TRACE4(event, a, b, c, d) DTRACE_PROBE4(omnicore, event, a, b, c, d)
+#define OMNI_TRACE5(event, a, b, c, d, e) DTRACE_PROBE5(omnicore, event, a, b, c, d, e)
+#define OMNI_TRACE6(event, a, b, c, d, e, f) DTRACE_PROBE6(omnicore, event, a, b, c, d, e, f)
+
+#else
+
+#define OMNI_TRACE(event)
+#define OMNI_TRACE1(event, a)
+#define OMNI_TRACE2(event, a, b)
+#define OMNI_TRACE3(event, a, b, c)
+#define OMNI_TRACE4(event, a, b, c, d)
+#define OMNI_TRACE5(event, a, b, c, d, e)
+#define OMNI_TRACE6(event, a, b, c, d, e, f)
+
+#endif // ENABLE_OMNI_TRACING
+
+#endif // BITCOIN_OMNICORE_TRACE_H
@@ -3,17 +3,21 @@
 #include <omnicore/tx.h>
 
 #include <omnicore/activation.h>
+#include <omnicore/consensushash.h>
+#include <omnicore/dbaddressindex.h>
 #include <omnicore/dbfees.h>
 #include <omnicore/dbspinfo.h>
 #include <omnicore/dbstolist.h>
 #include <omnicore/dbtradelist.h>
 #include <omnicore/dbtxlist.h>
 #include <omnicore/dex.h>
+#include <omnicore/indexproperties.h>
 #include <omnicore/log.h>
 #include <omnicore/mdex.h>
 #include <omnicore/notifications.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/parsing.h>
+#include <omnicore/payload.h>
 #include <omnicore/rules.h>
 #include <omnicore/sp.h>
 #include <omnicore/sto.h>
@@ -25,6 +29,7 @@
 #include <base58.h>
 #include <key_io.h>
 #include <validation.h>
+#include <span.h>
 #include <sync.h>
 #include <util/time.h>
 
@@ -101,11 +106,10 @@ static std::string intToClass(int encodingClass)
     return "-";
 }
 
-/** Checks whether a pointer to the payload is past it's last position. */
-bool CMPTransaction::isOverrun(const char* p)
+/** Returns a reader of the payload and its padding, starting at the given position. */
+static CPayloadReader PayloadReader(const std::vector<unsigned char>& pkt, int pkt_size, size_t nPos)
 {
-    ptrdiff_t pos = (char*) p - (char*) &pkt;
-    return (pos > pkt_size);
+    return CPayloadReader(MakeSpan(pkt), pkt_size, nPos);
 }
 
 // -------------------- PACKET PARSING -----------------------
@@ -213,12 +217,9 @@ bool CMPTransaction::interpret_TransactionType()
     if (pkt_size < 4) {
         return false;
     }
-    uint16_t txVersion = 0;
-    uint16_t txType = 0;
-    memcpy(&txVersion, &pkt[0], 2);
-    SwapByteOrder16(txVersion);
-    memcpy(&txType, &pkt[2], 2);
-    SwapByteOrder16(txType);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 0);
+    uint16_t txVersion = reader.ReadU16();
+    uint16_t txType = reader.ReadU16();
     version = txVersion;
     type = txType;
 
@@ -237,10 +238,9 @@ bool CMPTransaction::interpret_SimpleSend()
     if (pkt_size < 16) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nValue, &pkt[8], 8);
-    SwapByteOrder64(nValue);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
 
     // Special case: if can't find the receiver -- assume send to self!
@@ -263,14 +263,12 @@ bool CMPTransaction::interpret_SendToOwners()
     if (pkt_size < expectedSize) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nValue, &pkt[8], 8);
-    SwapByteOrder64(nValue);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
     if (version > MP_TX_PKT_V0) {
-        memcpy(&distribution_property, &pkt[16], 4);
-        SwapByteOrder32(distribution_property);
+        distribution_property = reader.ReadU32();
     }
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
@@ -290,7 +288,8 @@ bool CMPTransaction::interpret_SendAll()
     if (pkt_size < 5) {
         return false;
     }
-    memcpy(&ecosystem, &pkt[4], 1);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    ecosystem = reader.ReadU8();
 
     property = ecosystem; // provide a hint for the UI, TODO: better handling!
 
@@ -312,12 +311,10 @@ bool CMPTransaction::interpret_SendNonFungible()
     if (pkt_size < 24) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nonfungible_token_start, &pkt[8], 8);
-    SwapByteOrder64(nonfungible_token_start);
-    memcpy(&nonfungible_token_end, &pkt[16], 8);
-    SwapByteOrder64(nonfungible_token_end);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nonfungible_token_start = reader.ReadU64();
+    nonfungible_token_end = reader.ReadU64();
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t        property: %d (%s)\n", property, strMPProperty(property));
@@ -335,19 +332,16 @@ bool CMPTransaction::interpret_TradeOffer()
     if (pkt_size < expectedSize) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nValue, &pkt[8], 8);
-    SwapByteOrder64(nValue);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
-    memcpy(&amount_desired, &pkt[16], 8);
-    memcpy(&blocktimelimit, &pkt[24], 1);
-    memcpy(&min_fee, &pkt[25], 8);
+    amount_desired = reader.ReadU64();
+    blocktimelimit = reader.ReadU8();
+    min_fee = reader.ReadU64();
     if (version > MP_TX_PKT_V0) {
-        memcpy(&subaction, &pkt[33], 1);
+        subaction = reader.ReadU8();
     }
-    SwapByteOrder64(amount_desired);
-    SwapByteOrder64(min_fee);
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t        property: %d (%s)\n", property, strMPProperty(property));
@@ -369,10 +363,9 @@ bool CMPTransaction::interpret_AcceptOfferBTC()
     if (pkt_size < 16) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nValue, &pkt[8], 8);
-    SwapByteOrder64(nValue);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
@@ -389,15 +382,12 @@ bool CMPTransaction::interpret_MetaDExTrade()
     if (pkt_size < 28) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nValue, &pkt[8], 8);
-    SwapByteOrder64(nValue);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
-    memcpy(&desired_property, &pkt[16], 4);
-    SwapByteOrder32(desired_property);
-    memcpy(&desired_value, &pkt[20], 8);
-    SwapByteOrder64(desired_value);
+    desired_property = reader.ReadU32();
+    desired_value = reader.ReadU64();
 
     action = CMPTransaction::ADD; // deprecated
 
@@ -417,15 +407,12 @@ bool CMPTransaction::interpret_MetaDExCancelPrice()
     if (pkt_size < 28) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nValue, &pkt[8], 8);
-    SwapByteOrder64(nValue);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
-    memcpy(&desired_property, &pkt[16], 4);
-    SwapByteOrder32(desired_property);
-    memcpy(&desired_value, &pkt[20], 8);
-    SwapByteOrder64(desired_value);
+    desired_property = reader.ReadU32();
+    desired_value = reader.ReadU64();
 
     action = CMPTransaction::CANCEL_AT_PRICE; // deprecated
 
@@ -445,10 +432,9 @@ bool CMPTransaction::interpret_MetaDExCancelPair()
     if (pkt_size < 12) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&desired_property, &pkt[8], 4);
-    SwapByteOrder32(desired_property);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    desired_property = reader.ReadU32();
 
     nValue = 0; // deprecated
     nNewValue = nValue; // deprecated
@@ -469,7 +455,8 @@ bool CMPTransaction::interpret_MetaDExCancelEcosystem()
     if (pkt_size < 5) {
         return false;
     }
-    memcpy(&ecosystem, &pkt[4], 1);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    ecosystem = reader.ReadU8();
 
     property = ecosystem; // deprecated
     desired_property = ecosystem; // deprecated
@@ -491,26 +478,16 @@ bool CMPTransaction::interpret_CreatePropertyFixed()
     if (pkt_size < 25) {
         return false;
     }
-    const char* p = 11 + (char*) &pkt;
-    std::vector<std::string> spstr;
-    memcpy(&ecosystem, &pkt[4], 1);
-    memcpy(&prop_type, &pkt[5], 2);
-    SwapByteOrder16(prop_type);
-    memcpy(&prev_prop_id, &pkt[7], 4);
-    SwapByteOrder32(prev_prop_id);
-    for (int i = 0; i < 5; i++) {
-        spstr.push_back(std::string(p));
-        p += spstr.back().size() + 1;
-    }
-    int i = 0;
-    memcpy(category, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(category)-1)); i++;
-    memcpy(subcategory, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(subcategory)-1)); i++;
-    memcpy(name, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(name)-1)); i++;
-    memcpy(url, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(url)-1)); i++;
-    memcpy(data, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(data)-1)); i++;
-    memcpy(&nValue, p, 8);
-    SwapByteOrder64(nValue);
-    p += 8;
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    ecosystem = reader.ReadU8();
+    prop_type = reader.ReadU16();
+    prev_prop_id = reader.ReadU32();
+    category = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    subcategory = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    name = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    url = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    data = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    nValue = reader.ReadU64();
     nNewValue = nValue;
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
@@ -525,7 +502,7 @@ bool CMPTransaction::interpret_CreatePropertyFixed()
         PrintToLog("\t           value: %s\n", FormatByType(nValue, prop_type));
     }
 
-    if (isOverrun(p)) {
+    if (reader.IsOverrun()) {
         PrintToLog("%s(): rejected: malformed string value(s)\n", __func__);
         return false;
     }
@@ -539,35 +516,21 @@ bool CMPTransaction::interpret_CreatePropertyVariable()
     if (pkt_size < 39) {
         return false;
     }
-    const char* p = 11 + (char*) &pkt;
-    std::vector<std::string> spstr;
-    memcpy(&ecosystem, &pkt[4], 1);
-    memcpy(&prop_type, &pkt[5], 2);
-    SwapByteOrder16(prop_type);
-    memcpy(&prev_prop_id, &pkt[7], 4);
-    SwapByteOrder32(prev_prop_id);
-    for (int i = 0; i < 5; i++) {
-        spstr.push_back(std::string(p));
-        p += spstr.back().size() + 1;
-    }
-    int i = 0;
-    memcpy(category, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(category)-1)); i++;
-    memcpy(subcategory, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(subcategory)-1)); i++;
-    memcpy(name, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(name)-1)); i++;
-    memcpy(url, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(url)-1)); i++;
-    memcpy(data, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(data)-1)); i++;
-    memcpy(&property, p, 4);
-    SwapByteOrder32(property);
-    p += 4;
-    memcpy(&nValue, p, 8);
-    SwapByteOrder64(nValue);
-    p += 8;
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    ecosystem = reader.ReadU8();
+    prop_type = reader.ReadU16();
+    prev_prop_id = reader.ReadU32();
+    category = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    subcategory = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    name = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    url = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    data = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
-    memcpy(&deadline, p, 8);
-    SwapByteOrder64(deadline);
-    p += 8;
-    memcpy(&early_bird, p++, 1);
-    memcpy(&percentage, p++, 1);
+    deadline = reader.ReadU64();
+    early_bird = reader.ReadU8();
+    percentage = reader.ReadU8();
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t       ecosystem: %d\n", ecosystem);
@@ -585,7 +548,7 @@ bool CMPTransaction::interpret_CreatePropertyVariable()
         PrintToLog("\t    issuer bonus: %d\n", percentage);
     }
 
-    if (isOverrun(p)) {
+    if (reader.IsOverrun()) {
         PrintToLog("%s(): rejected: malformed string value(s)\n", __func__);
         return false;
     }
@@ -599,8 +562,8 @@ bool CMPTransaction::interpret_CloseCrowdsale()
     if (pkt_size < 8) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t        property: %d (%s)\n", property, strMPProperty(property));
@@ -615,23 +578,15 @@ bool CMPTransaction::interpret_CreatePropertyManaged()
     if (pkt_size < 17) {
         return false;
     }
-    const char* p = 11 + (char*) &pkt;
-    std::vector<std::string> spstr;
-    memcpy(&ecosystem, &pkt[4], 1);
-    memcpy(&prop_type, &pkt[5], 2);
-    SwapByteOrder16(prop_type);
-    memcpy(&prev_prop_id, &pkt[7], 4);
-    SwapByteOrder32(prev_prop_id);
-    for (int i = 0; i < 5; i++) {
-        spstr.push_back(std::string(p));
-        p += spstr.back().size() + 1;
-    }
-    int i = 0;
-    memcpy(category, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(category)-1)); i++;
-    memcpy(subcategory, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(subcategory)-1)); i++;
-    memcpy(name, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(name)-1)); i++;
-    memcpy(url, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(url)-1)); i++;
-    memcpy(data, spstr[i].c_str(), std::min(spstr[i].length(), sizeof(data)-1)); i++;
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    ecosystem = reader.ReadU8();
+    prop_type = reader.ReadU16();
+    prev_prop_id = reader.ReadU32();
+    category = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    subcategory = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    name = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    url = reader.ReadString(SP_STRING_FIELD_LEN - 1);
+    data = reader.ReadString(SP_STRING_FIELD_LEN - 1);
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t       ecosystem: %d\n", ecosystem);
@@ -644,7 +599,7 @@ bool CMPTransaction::interpret_CreatePropertyManaged()
         PrintToLog("\t            data: %s\n", data);
     }
 
-    if (isOverrun(p)) {
+    if (reader.IsOverrun()) {
         PrintToLog("%s(): rejected: malformed string value(s)\n", __func__);
         return false;
     }
@@ -658,16 +613,13 @@ bool CMPTransaction::interpret_GrantTokens()
     if (pkt_size < 16) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nValue, &pkt[8], 8);
-    SwapByteOrder64(nValue);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
 
     // Get NFT data, was memo before and previously unused here.
-    const char* p = 16 + (char*) &pkt;
-    std::string spstr(p);
-    memcpy(nonfungible_data, spstr.c_str(), std::min(spstr.length(), sizeof(nonfungible_data)-1));
+    nonfungible_data = reader.ReadString(SP_STRING_FIELD_LEN - 1);
 
     // Special case: if can't find the receiver -- assume grant to self!
     if (receiver.empty()) {
@@ -689,10 +641,9 @@ bool CMPTransaction::interpret_RevokeTokens()
     if (pkt_size < 16) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nValue, &pkt[8], 8);
-    SwapByteOrder64(nValue);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
@@ -709,8 +660,8 @@ bool CMPTransaction::interpret_ChangeIssuer()
     if (pkt_size < 8) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t        property: %d (%s)\n", property, strMPProperty(property));
@@ -725,8 +676,8 @@ bool CMPTransaction::interpret_EnableFreezing()
     if (pkt_size < 8) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t        property: %d (%s)\n", property, strMPProperty(property));
@@ -741,8 +692,8 @@ bool CMPTransaction::interpret_DisableFreezing()
     if (pkt_size < 8) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t        property: %d (%s)\n", property, strMPProperty(property));
@@ -757,10 +708,9 @@ bool CMPTransaction::interpret_FreezeTokens()
     if (pkt_size < 37) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nValue, &pkt[8], 8);
-    SwapByteOrder64(nValue);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
 
     /**
@@ -768,10 +718,9 @@ bool CMPTransaction::interpret_FreezeTokens()
               With virtual reference transactions a hash160 in the payload sets the receiver.
               Reference outputs are ignored.
     **/
-    unsigned char address_version;
+    unsigned char address_version = reader.ReadU8();
     uint160 address_hash160;
-    memcpy(&address_version, &pkt[16], 1);
-    memcpy(&address_hash160, &pkt[17], 20);
+    reader.ReadBytes(address_hash160.begin(), address_hash160.size());
     receiver = HashToAddress(address_version, address_hash160);
     if (receiver.empty()) {
         return false;
@@ -796,10 +745,9 @@ bool CMPTransaction::interpret_UnfreezeTokens()
     if (pkt_size < 37) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nValue, &pkt[8], 8);
-    SwapByteOrder64(nValue);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nValue = reader.ReadU64();
     nNewValue = nValue;
 
     /**
@@ -807,10 +755,9 @@ bool CMPTransaction::interpret_UnfreezeTokens()
               With virtual reference transactions a hash160 in the payload sets the receiver.
               Reference outputs are ignored.
     **/
-    unsigned char address_version;
+    unsigned char address_version = reader.ReadU8();
     uint160 address_hash160;
-    memcpy(&address_version, &pkt[16], 1);
-    memcpy(&address_hash160, &pkt[17], 20);
+    reader.ReadBytes(address_hash160.begin(), address_hash160.size());
     receiver = HashToAddress(address_version, address_hash160);
     if (receiver.empty()) {
         return false;
@@ -835,8 +782,8 @@ bool CMPTransaction::interpret_AddDelegate()
     if (pkt_size < 8) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t        property: %d (%s)\n", property, strMPProperty(property));
@@ -851,8 +798,8 @@ bool CMPTransaction::interpret_RemoveDelegate()
     if (pkt_size < 8) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t        property: %d (%s)\n", property, strMPProperty(property));
@@ -882,17 +829,12 @@ bool CMPTransaction::interpret_NonFungibleData()
     if (pkt_size < 25) {
         return false;
     }
-    memcpy(&property, &pkt[4], 4);
-    SwapByteOrder32(property);
-    memcpy(&nonfungible_token_start, &pkt[8], 8);
-    SwapByteOrder64(nonfungible_token_start);
-    memcpy(&nonfungible_token_end, &pkt[16], 8);
-    SwapByteOrder64(nonfungible_token_end);
-    memcpy(&nonfungible_data_type, &pkt[24], 1);
-
-    const char* p = 25 + (char*) &pkt;
-    std::string spstr(p);
-    memcpy(nonfungible_data, spstr.c_str(), std::min(spstr.length(), sizeof(nonfungible_data)-1));
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    property = reader.ReadU32();
+    nonfungible_token_start = reader.ReadU64();
+    nonfungible_token_end = reader.ReadU64();
+    nonfungible_data_type = reader.ReadU8();
+    nonfungible_data = reader.ReadString(SP_STRING_FIELD_LEN - 1);
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t                property: %d (%s)\n", property, strMPProperty(property));
@@ -910,8 +852,8 @@ bool CMPTransaction::interpret_Deactivation()
     if (pkt_size < 6) {
         return false;
     }
-    memcpy(&feature_id, &pkt[4], 2);
-    SwapByteOrder16(feature_id);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    feature_id = reader.ReadU16();
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t      feature id: %d\n", feature_id);
@@ -926,12 +868,10 @@ bool CMPTransaction::interpret_Activation()
     if (pkt_size < 14) {
         return false;
     }
-    memcpy(&feature_id, &pkt[4], 2);
-    SwapByteOrder16(feature_id);
-    memcpy(&activation_block, &pkt[6], 4);
-    SwapByteOrder32(activation_block);
-    memcpy(&min_client_version, &pkt[10], 4);
-    SwapByteOrder32(min_client_version);
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    feature_id = reader.ReadU16();
+    activation_block = reader.ReadU32();
+    min_client_version = reader.ReadU32();
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t      feature id: %d\n", feature_id);
@@ -948,15 +888,12 @@ bool CMPTransaction::interpret_Alert()
     if (pkt_size < 11) {
         return false;
     }
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 4);
+    alert_type = reader.ReadU16();
+    alert_expiry = reader.ReadU32();
 
-    memcpy(&alert_type, &pkt[4], 2);
-    SwapByteOrder16(alert_type);
-    memcpy(&alert_expiry, &pkt[6], 4);
-    SwapByteOrder32(alert_expiry);
-
-    const char* p = 10 + (char*) &pkt;
-    std::string spstr(p);
-    memcpy(alert_text, spstr.c_str(), std::min(spstr.length(), sizeof(alert_text)-1));
+    // the message may run to the end of the payload without a terminator, so it's never overrun
+    alert_text = reader.ReadString(SP_STRING_FIELD_LEN - 1);
 
     if ((!rpcOnly && msc_debug_packets) || msc_debug_packets_readonly) {
         PrintToLog("\t      alert type: %d\n", alert_type);
@@ -964,11 +901,6 @@ bool CMPTransaction::interpret_Alert()
         PrintToLog("\t   alert message: %s\n", alert_text);
     }
 
-    if (isOverrun(p)) {
-        PrintToLog("%s(): rejected: malformed string value(s)\n", __func__);
-        return false;
-    }
-
     return true;
 }
 
@@ -981,6 +913,24 @@ bool CMPTransaction::interpret_Alert()
  *         <0  if the transaction is invalid
  */
 int CMPTransaction::interpretPacket()
+{
+    // Use ::ChainActive()[block] here to avoid locking cs_main after cs_tally below
+    const CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = ::ChainActive()[block];
+    }
+
+    return interpretPacket(pindex);
+}
+
+/**
+ * Interprets the payload and executes the logic of a transaction of the given block.
+ *
+ * Other than interpretPacket(), cs_main is not acquired, so the logic can be executed
+ * while holding cs_tally only.
+ */
+int CMPTransaction::interpretPacket(const CBlockIndex* pindex)
 {
     if (rpcOnly) {
         PrintToLog("%s(): ERROR: attempt to execute logic in RPC mode\n", __func__);
@@ -991,14 +941,7 @@ int CMPTransaction::interpretPacket()
         return (PKT_ERROR -2);
     }
 
-    // Use ::ChainActive()[block] here to avoid locking cs_main after cs_tally below
-    CBlockIndex* pindex;
-    uint256 blockHash;
-    {
-        LOCK(cs_main);
-        pindex = ::ChainActive()[block];
-        blockHash = ::ChainActive()[block]->GetBlockHash();
-    }
+    uint256 blockHash = pindex ? pindex->GetBlockHash() : uint256();
 
     LOCK(cs_tally);
 
@@ -1141,8 +1084,10 @@ int CMPTransaction::logicHelper_CrowdsaleParticipation(uint256& blockHash)
     }
 
     // Update the crowdsale object
+    CommitCrowdsale(receiver, *pcrowdsale, false);
     pcrowdsale->incTokensUserCreated(tokens.first);
     pcrowdsale->incTokensIssuerCreated(tokens.second);
+    CommitCrowdsale(receiver, *pcrowdsale, true);
 
     // Data to pass to txFundraiserData
     int64_t txdata[] = {(int64_t) nValue, blockTime, tokens.first, tokens.second};
@@ -1178,40 +1123,43 @@ int CMPTransaction::logicHelper_CrowdsaleParticipation(uint256& blockHash)
 /** Tx 0 */
 int CMPTransaction::logicMath_SimpleSend(uint256& blockHash)
 {
-    if (!IsTransactionTypeAllowed(block, property, type, version)) {
-        PrintToLog("%s(): rejected: type %d or version %d not permitted for property %d at block %d\n",
-                __func__,
-                type,
-                version,
-                property,
-                block);
-        return (PKT_ERROR_SEND -22);
-    }
+    // the checks may have passed already, while the transactions of the block were scheduled
+    if (!fSendPrechecked) {
+        if (!IsTransactionTypeAllowed(block, property, type, version)) {
+            PrintToLog("%s(): rejected: type %d or version %d not permitted for property %d at block %d\n",
+                    __func__,
+                    type,
+                    version,
+                    property,
+                    block);
+            return (PKT_ERROR_SEND -22);
+        }
 
-    if (isPropertyNonFungible(property)) {
-        PrintToLog("%s(): rejected: property %d is of type non-fungible\n", __func__, property);
-        return (PKT_ERROR_TOKENS -27);
-    }
+        if (isPropertyNonFungible(property)) {
+            PrintToLog("%s(): rejected: property %d is of type non-fungible\n", __func__, property);
+            return (PKT_ERROR_TOKENS -27);
+        }
 
-    if (nValue <= 0 || MAX_INT_8_BYTES < nValue) {
-        PrintToLog("%s(): rejected: value out of range or zero: %d", __func__, nValue);
-        return (PKT_ERROR_SEND -23);
-    }
+        if (nValue <= 0 || MAX_INT_8_BYTES < nValue) {
+            PrintToLog("%s(): rejected: value out of range or zero: %d", __func__, nValue);
+            return (PKT_ERROR_SEND -23);
+        }
 
-    if (!IsPropertyIdValid(property)) {
-        PrintToLog("%s(): rejected: property %d does not exist\n", __func__, property);
-        return (PKT_ERROR_SEND -24);
-    }
+        if (!IsPropertyIdValid(property)) {
+            PrintToLog("%s(): rejected: property %d does not exist\n", __func__, property);
+            return (PKT_ERROR_SEND -24);
+        }
 
-    int64_t nBalance = GetTokenBalance(sender, property, BALANCE);
-    if (nBalance < (int64_t) nValue) {
-        PrintToLog("%s(): rejected: sender %s has insufficient balance of property %d [%s < %s]\n",
-                __func__,
-                sender,
-                property,
-                FormatMP(property, nBalance),
-                FormatMP(property, nValue));
-        return (PKT_ERROR_SEND -25);
+        int64_t nBalance = GetTokenBalance(sender, property, BALANCE);
+        if (nBalance < (int64_t) nValue) {
+            PrintToLog("%s(): rejected: sender %s has insufficient balance of property %d [%s < %s]\n",
+                    __func__,
+                    sender,
+                    property,
+                    FormatMP(property, nBalance),
+                    FormatMP(property, nValue));
+            return (PKT_ERROR_SEND -25);
+        }
     }
 
     // ------------------------------------------
@@ -1226,6 +1174,50 @@ int CMPTransaction::logicMath_SimpleSend(uint256& blockHash)
     return 0;
 }
 
+/** Reads the version, property and amount of a simple send from the payload, as interpret_SimpleSend() does. */
+static bool ReadSimpleSend(const std::vector<unsigned char>& pkt, int pkt_size, uint16_t& txVersion, uint32_t& txProperty, uint64_t& txValue)
+{
+    if (pkt_size < 16) return false;
+
+    CPayloadReader reader = PayloadReader(pkt, pkt_size, 0);
+    txVersion = reader.ReadU16();
+    if (reader.ReadU16() != MSC_TYPE_SIMPLE_SEND) return false;
+
+    txProperty = reader.ReadU32();
+    txValue = reader.ReadU64();
+    return true;
+}
+
+bool CMPTransaction::peekSimpleSend(uint32_t& propertyOut) const
+{
+    uint16_t txVersion;
+    uint64_t txValue;
+    return ReadSimpleSend(pkt, pkt_size, txVersion, propertyOut, txValue);
+}
+
+bool CMPTransaction::precheckSimpleSend()
+{
+    fSendPrechecked = false;
+
+    uint16_t txVersion;
+    uint32_t txProperty;
+    uint64_t txValue;
+    if (rpcOnly || !ReadSimpleSend(pkt, pkt_size, txVersion, txProperty, txValue)) return false;
+
+    // the same checks as by interpretPacket() and logicMath_SimpleSend(), without locking cs_tally
+    const CMPTally* tally = mp_tally_map.Get(sender);
+    const int64_t nBalance = tally ? tally->getMoney(txProperty, BALANCE) : 0;
+
+    fSendPrechecked = !isAddressFrozen(sender, txProperty) &&
+            IsTransactionTypeAllowed(block, txProperty, MSC_TYPE_SIMPLE_SEND, txVersion) &&
+            !isPropertyNonFungible(txProperty) &&
+            txValue > 0 && txValue <= MAX_INT_8_BYTES &&
+            IsPropertyIdValid(txProperty) &&
+            nBalance >= (int64_t) txValue;
+
+    return fSendPrechecked;
+}
+
 /** Tx 3 */
 int CMPTransaction::logicMath_SendToOwners()
 {
@@ -1339,9 +1331,6 @@ int CMPTransaction::logicMath_SendToOwners()
         assert(update_tally_map(sender, property, -will_really_receive, BALANCE));
         assert(update_tally_map(address, property, will_really_receive, BALANCE));
 
-        // add to stodb
-        pDbStoList->recordSTOReceive(address, txid, block, property, will_really_receive);
-
         if (sent_so_far != (int64_t)nValue) {
             PrintToLog("sent_so_far= %14d, nValue= %14d, n_owners= %d\n", sent_so_far, nValue, numberOfReceivers);
         } else {
@@ -1352,6 +1341,14 @@ int CMPTransaction::logicMath_SendToOwners()
     // sent_so_far must equal nValue here
     assert(sent_so_far == (int64_t)nValue);
 
+    // add to stodb
+    if (IsIndexedProperty(property)) pDbStoList->recordSTOReceives(txid, block, property, receiversSet);
+    if (pDbAddressIndex) {
+        for (const auto& receiver : receiversSet) {
+            pDbAddressIndex->RecordAddress(receiver.second, ADDRESS_ROLE_STO_RECIPIENT);
+        }
+    }
+
     // Number of tokens has changed, update fee distribution thresholds
     if (version == MP_TX_PKT_V0) NotifyTotalTokensChanged(OMNI_PROPERTY_MSC, block); // fee was burned
 
@@ -1384,10 +1381,11 @@ int CMPTransaction::logicMath_SendAll()
         return (PKT_ERROR_SEND_ALL -54);
     }
 
-    uint32_t propertyId = ptally->init();
+    // the tally of the sender is modified while sending, so the properties are collected first
+    const std::vector<uint32_t> vPropertyIds(ptally->begin(), ptally->end());
     int numberOfPropertiesSent = 0;
 
-    while (0 != (propertyId = ptally->next())) {
+    for (uint32_t propertyId : vPropertyIds) {
         // only transfer tokens in the specified ecosystem
         if (ecosystem == OMNI_PROPERTY_MSC && isTestEcosystemProperty(propertyId)) {
             continue;
@@ -1713,7 +1711,9 @@ int CMPTransaction::logicMath_MetaDExTrade()
 
     // ------------------------------------------
 
-    pDbTradeList->recordNewTrade(txid, sender, property, desired_property, block, tx_idx);
+    if (IsIndexedProperty(property) || IsIndexedProperty(desired_property)) {
+        pDbTradeList->recordNewTrade(txid, sender, property, desired_property, block, tx_idx);
+    }
     int rc = MetaDEx_ADD(sender, property, nNewValue, block, desired_property, desired_value, txid, tx_idx);
     return rc;
 }
@@ -1854,7 +1854,7 @@ int CMPTransaction::logicMath_MetaDExCancelEcosystem()
 }
 
 /** Tx 50 */
-int CMPTransaction::logicMath_CreatePropertyFixed(CBlockIndex* pindex)
+int CMPTransaction::logicMath_CreatePropertyFixed(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -1887,7 +1887,7 @@ int CMPTransaction::logicMath_CreatePropertyFixed(CBlockIndex* pindex)
         return (PKT_ERROR_SP -36);
     }
 
-    if ('\0' == name[0]) {
+    if (name.empty()) {
         PrintToLog("%s(): rejected: property name must not be empty\n", __func__);
         return (PKT_ERROR_SP -37);
     }
@@ -1919,7 +1919,7 @@ int CMPTransaction::logicMath_CreatePropertyFixed(CBlockIndex* pindex)
 }
 
 /** Tx 51 */
-int CMPTransaction::logicMath_CreatePropertyVariable(CBlockIndex* pindex)
+int CMPTransaction::logicMath_CreatePropertyVariable(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -1970,7 +1970,7 @@ int CMPTransaction::logicMath_CreatePropertyVariable(CBlockIndex* pindex)
         return (PKT_ERROR_SP -36);
     }
 
-    if ('\0' == name[0]) {
+    if (name.empty()) {
         PrintToLog("%s(): rejected: property name must not be empty\n", __func__);
         return (PKT_ERROR_SP -37);
     }
@@ -2008,7 +2008,8 @@ int CMPTransaction::logicMath_CreatePropertyVariable(CBlockIndex* pindex)
 
     const uint32_t propertyId = pDbSpInfo->putSP(ecosystem, newSP);
     assert(propertyId > 0);
-    my_crowds.insert(std::make_pair(sender, CMPCrowd(propertyId, nValue, property, deadline, early_bird, percentage, 0, 0)));
+    std::pair<CrowdMap::iterator, bool> inserted = my_crowds.insert(std::make_pair(sender, CMPCrowd(propertyId, nValue, property, deadline, early_bird, percentage, 0, 0)));
+    if (inserted.second) CommitCrowdsale(sender, inserted.first->second, true);
 
     PrintToLog("CREATED CROWDSALE id: %d value: %d property: %d\n", propertyId, nValue, property);
 
@@ -2016,7 +2017,7 @@ int CMPTransaction::logicMath_CreatePropertyVariable(CBlockIndex* pindex)
 }
 
 /** Tx 53 */
-int CMPTransaction::logicMath_CloseCrowdsale(CBlockIndex* pindex)
+int CMPTransaction::logicMath_CloseCrowdsale(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -2074,15 +2075,16 @@ int CMPTransaction::logicMath_CloseCrowdsale(CBlockIndex* pindex)
     if (missedTokens > 0) {
         assert(update_tally_map(sp.issuer, property, missedTokens, BALANCE));
     }
+    CommitCrowdsale(it->first, it->second, false);
     my_crowds.erase(it);
 
-    if (msc_debug_sp) PrintToLog("CLOSED CROWDSALE id: %d=%X\n", property, property);
+    PrintToLogIf(msc_debug_sp, "CLOSED CROWDSALE id: %d=%X\n", property, property);
 
     return 0;
 }
 
 /** Tx 54 */
-int CMPTransaction::logicMath_CreatePropertyManaged(CBlockIndex* pindex)
+int CMPTransaction::logicMath_CreatePropertyManaged(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -2115,7 +2117,7 @@ int CMPTransaction::logicMath_CreatePropertyManaged(CBlockIndex* pindex)
         return (PKT_ERROR_SP -22);
     }
 
-    if ('\0' == name[0]) {
+    if (name.empty()) {
         PrintToLog("%s(): rejected: property name must not be empty\n", __func__);
         return (PKT_ERROR_SP -37);
     }
@@ -2155,7 +2157,7 @@ int CMPTransaction::logicMath_CreatePropertyManaged(CBlockIndex* pindex)
 }
 
 /** Tx 55 */
-int CMPTransaction::logicMath_GrantTokens(CBlockIndex* pindex, uint256& blockHash)
+int CMPTransaction::logicMath_GrantTokens(const CBlockIndex* pindex, uint256& blockHash)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -2209,7 +2211,8 @@ int CMPTransaction::logicMath_GrantTokens(CBlockIndex* pindex, uint256& blockHas
         return (PKT_ERROR_TOKENS -43);
     }
 
-    int64_t nTotalTokens = getTotalTokens(property);
+    // managed properties are never of fixed supply, so the property isn't loaded again
+    int64_t nTotalTokens = getVariableTotalTokens(property);
     if (nValue > (MAX_INT_8_BYTES - nTotalTokens)) {
         PrintToLog("%s(): rejected: no more than %s tokens can ever exist [%s + %s > %s]\n",
                 __func__,
@@ -2225,11 +2228,9 @@ int CMPTransaction::logicMath_GrantTokens(CBlockIndex* pindex, uint256& blockHas
     std::vector<int64_t> dataPt;
     dataPt.push_back(nValue);
     dataPt.push_back(0);
-    sp.historicalData.insert(std::make_pair(txid, dataPt));
-    sp.update_block = pindexBlockHash;
 
-    // Persist the number of granted tokens
-    assert(pDbSpInfo->updateSP(property, sp));
+    // Persist the number of granted tokens, which leaves the property itself unchanged
+    assert(pDbSpInfo->addHistoricalEntry(property, pindexBlockHash, txid, dataPt));
 
     // Move the tokens
     if (sp.unique) {
@@ -2257,7 +2258,7 @@ int CMPTransaction::logicMath_GrantTokens(CBlockIndex* pindex, uint256& blockHas
 }
 
 /** Tx 56 */
-int CMPTransaction::logicMath_RevokeTokens(CBlockIndex* pindex)
+int CMPTransaction::logicMath_RevokeTokens(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -2314,11 +2315,9 @@ int CMPTransaction::logicMath_RevokeTokens(CBlockIndex* pindex)
     std::vector<int64_t> dataPt;
     dataPt.push_back(0);
     dataPt.push_back(nValue);
-    sp.historicalData.insert(std::make_pair(txid, dataPt));
-    sp.update_block = blockHash;
 
     assert(update_tally_map(sender, property, -nValue, BALANCE));
-    assert(pDbSpInfo->updateSP(property, sp));
+    assert(pDbSpInfo->addHistoricalEntry(property, blockHash, txid, dataPt));
 
     NotifyTotalTokensChanged(property, block);
 
@@ -2326,7 +2325,7 @@ int CMPTransaction::logicMath_RevokeTokens(CBlockIndex* pindex)
 }
 
 /** Tx 70 */
-int CMPTransaction::logicMath_ChangeIssuer(CBlockIndex* pindex)
+int CMPTransaction::logicMath_ChangeIssuer(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -2390,7 +2389,7 @@ int CMPTransaction::logicMath_ChangeIssuer(CBlockIndex* pindex)
 }
 
 /** Tx 71 */
-int CMPTransaction::logicMath_EnableFreezing(CBlockIndex* pindex)
+int CMPTransaction::logicMath_EnableFreezing(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -2444,7 +2443,7 @@ int CMPTransaction::logicMath_EnableFreezing(CBlockIndex* pindex)
 }
 
 /** Tx 72 */
-int CMPTransaction::logicMath_DisableFreezing(CBlockIndex* pindex)
+int CMPTransaction::logicMath_DisableFreezing(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -2490,7 +2489,7 @@ int CMPTransaction::logicMath_DisableFreezing(CBlockIndex* pindex)
 }
 
 /** Tx 185 */
-int CMPTransaction::logicMath_FreezeTokens(CBlockIndex* pindex)
+int CMPTransaction::logicMath_FreezeTokens(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -2554,7 +2553,7 @@ int CMPTransaction::logicMath_FreezeTokens(CBlockIndex* pindex)
 }
 
 /** Tx 186 */
-int CMPTransaction::logicMath_UnfreezeTokens(CBlockIndex* pindex)
+int CMPTransaction::logicMath_UnfreezeTokens(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -2618,7 +2617,7 @@ int CMPTransaction::logicMath_UnfreezeTokens(CBlockIndex* pindex)
 }
 
 /** Tx 73 */
-int CMPTransaction::logicMath_AddDelegate(CBlockIndex* pindex)
+int CMPTransaction::logicMath_AddDelegate(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
@@ -2672,7 +2671,7 @@ int CMPTransaction::logicMath_AddDelegate(CBlockIndex* pindex)
 }
 
 /** Tx 74 */
-int CMPTransaction::logicMath_RemoveDelegate(CBlockIndex* pindex)
+int CMPTransaction::logicMath_RemoveDelegate(const CBlockIndex* pindex)
 {
     if (pindex == nullptr) {
         PrintToLog("%s(): ERROR: block %d not in the active chain\n", __func__, block);
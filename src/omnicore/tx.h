@@ -1,6 +1,7 @@
 #ifndef BITCOIN_OMNICORE_TX_H
 #define BITCOIN_OMNICORE_TX_H
 
+class CBlockIndex;
 class CMPMetaDEx;
 class CMPOffer;
 class CTransaction;
@@ -15,12 +16,21 @@ class CTransaction;
 #include <string.h>
 
 #include <string>
+#include <vector>
 
 using mastercore::strTransactionType;
 
+//! Maximal size of a payload, longer payloads are truncated
+static const unsigned int MAX_PAYLOAD_SIZE = 1 + MAX_PACKETS * PACKET_SIZE;
+//! Number of zero bytes after a payload, so fields and unterminated strings, which extend past its end, are read as zero
+static const unsigned int PAYLOAD_PADDING = 32;
+
 /** The class is responsible for transaction interpreting/parsing.
  *
  * It invokes other classes and methods: offers, accepts, tallies (balances).
+ *
+ * The payload and the string fields are held in buffers sized to their content, which
+ * are kept, when the object is reset, so one object can be reused for many transactions.
  */
 class CMPTransaction
 {
@@ -35,7 +45,8 @@ private:
     uint64_t tx_fee_paid;
 
     int pkt_size;
-    unsigned char pkt[1 + MAX_PACKETS * PACKET_SIZE];
+    //! The payload, followed by PAYLOAD_PADDING zero bytes
+    std::vector<unsigned char> pkt;
     int encodingClass;  // No Marker = 0, Class A = 1, Class B = 2, Class C = 3
 
     std::string sender;
@@ -63,11 +74,11 @@ private:
     // CreatePropertyFixed, CreatePropertyVariable, CreatePropertyMananged
     unsigned short prop_type;
     unsigned int prev_prop_id;
-    char category[SP_STRING_FIELD_LEN];
-    char subcategory[SP_STRING_FIELD_LEN];
-    char name[SP_STRING_FIELD_LEN];
-    char url[SP_STRING_FIELD_LEN];
-    char data[SP_STRING_FIELD_LEN];
+    std::string category;
+    std::string subcategory;
+    std::string name;
+    std::string url;
+    std::string data;
     uint64_t deadline;
     unsigned char early_bird;
     unsigned char percentage;
@@ -87,12 +98,12 @@ private:
     uint64_t nonfungible_token_start;
     uint64_t nonfungible_token_end;
     uint8_t nonfungible_data_type; // Issuer (1) or holder (0)
-    char nonfungible_data[SP_STRING_FIELD_LEN]; // GrantData, IssuerData or HolderData
+    std::string nonfungible_data; // GrantData, IssuerData or HolderData
 
     // Alert
     uint16_t alert_type;
     uint32_t alert_expiry;
-    char alert_text[SP_STRING_FIELD_LEN];
+    std::string alert_text;
 
     // Activation
     uint16_t feature_id;
@@ -102,8 +113,8 @@ private:
     // Indicates whether the transaction can be used to execute logic
     bool rpcOnly;
 
-    /** Checks whether a pointer to the payload is past it's last position. */
-    bool isOverrun(const char* p);
+    // Indicates whether the checks of a simple send passed ahead of its execution
+    bool fSendPrechecked;
 
     /**
      * Payload parsing
@@ -151,19 +162,19 @@ private:
     int logicMath_MetaDExCancelPrice();
     int logicMath_MetaDExCancelPair();
     int logicMath_MetaDExCancelEcosystem();
-    int logicMath_CreatePropertyFixed(CBlockIndex *pindex);
-    int logicMath_CreatePropertyVariable(CBlockIndex *pindex);
-    int logicMath_CloseCrowdsale(CBlockIndex *pindex);
-    int logicMath_CreatePropertyManaged(CBlockIndex* pindex);
-    int logicMath_GrantTokens(CBlockIndex* pindex, uint256 &blockHash);
-    int logicMath_RevokeTokens(CBlockIndex *pindex);
-    int logicMath_ChangeIssuer(CBlockIndex *pindex);
-    int logicMath_EnableFreezing(CBlockIndex *pindex);
-    int logicMath_DisableFreezing(CBlockIndex *pindex);
-    int logicMath_FreezeTokens(CBlockIndex *pindex);
-    int logicMath_UnfreezeTokens(CBlockIndex *pindex);
-    int logicMath_AddDelegate(CBlockIndex *pindex);
-    int logicMath_RemoveDelegate(CBlockIndex *pindex);
+    int logicMath_CreatePropertyFixed(const CBlockIndex* pindex);
+    int logicMath_CreatePropertyVariable(const CBlockIndex* pindex);
+    int logicMath_CloseCrowdsale(const CBlockIndex* pindex);
+    int logicMath_CreatePropertyManaged(const CBlockIndex* pindex);
+    int logicMath_GrantTokens(const CBlockIndex* pindex, uint256 &blockHash);
+    int logicMath_RevokeTokens(const CBlockIndex* pindex);
+    int logicMath_ChangeIssuer(const CBlockIndex* pindex);
+    int logicMath_EnableFreezing(const CBlockIndex* pindex);
+    int logicMath_DisableFreezing(const CBlockIndex* pindex);
+    int logicMath_FreezeTokens(const CBlockIndex* pindex);
+    int logicMath_UnfreezeTokens(const CBlockIndex* pindex);
+    int logicMath_AddDelegate(const CBlockIndex* pindex);
+    int logicMath_RemoveDelegate(const CBlockIndex* pindex);
     int logicMath_AnyData();
     int logicMath_NonFungibleData();
     int logicMath_Activation();
@@ -197,13 +208,15 @@ public:
     unsigned int getType() const { return type; }
     std::string getTypeString() const { return strTransactionType(getType()); }
     unsigned int getProperty() const { return property; }
+    unsigned int getDesiredProperty() const { return desired_property; }
     unsigned short getVersion() const { return version; }
     unsigned short getPropertyType() const { return prop_type; }
     uint64_t getFeePaid() const { return tx_fee_paid; }
     std::string getSender() const { return sender; }
     std::string getReceiver() const { return receiver; }
-    std::string getPayload() const { return HexStr(pkt, pkt + pkt_size); }
-    std::string getPayloadData() const { return HexStr(pkt + 4 /* skip version and type */, pkt + pkt_size); }
+    std::string getPayload() const { return HexStr(pkt.begin(), pkt.begin() + pkt_size); }
+    std::string getPayloadData() const { return HexStr(pkt.begin() + 4 /* skip version and type */, pkt.begin() + pkt_size); }
+    std::vector<unsigned char> getRawPayload() const { return std::vector<unsigned char>(pkt.begin(), pkt.begin() + pkt_size); }
     uint64_t getAmount() const { return nValue; }
     uint64_t getNewAmount() const { return nNewValue; }
     uint8_t getEcosystem() const { return ecosystem; }
@@ -226,6 +239,7 @@ public:
     uint32_t getActivationBlock() const { return activation_block; }
     uint32_t getMinClientVersion() const { return min_client_version; }
     unsigned int getIndexInBlock() const { return tx_idx; }
+    int getBlock() const { return block; }
     uint32_t getDistributionProperty() const { return distribution_property; }
     uint64_t getNonFungibleTokenStart() const { return nonfungible_token_start; }
     uint64_t getNonFungibleTokenEnd() const { return nonfungible_token_end; }
@@ -238,7 +252,7 @@ public:
         SetNull();
     }
 
-    /** Resets and clears all values. */
+    /** Resets and clears all values, while the allocated buffers are kept for reuse. */
     void SetNull()
     {
         txid.SetNull();
@@ -247,7 +261,7 @@ public:
         tx_idx = 0;
         tx_fee_paid = 0;
         pkt_size = 0;
-        memset(&pkt, 0, sizeof(pkt));
+        pkt.clear();
         encodingClass = 0;
         sender.clear();
         receiver.clear();
@@ -259,11 +273,11 @@ public:
         ecosystem = 0;
         prop_type = 0;
         prev_prop_id = 0;
-        memset(&category, 0, sizeof(category));
-        memset(&subcategory, 0, sizeof(subcategory));
-        memset(&name, 0, sizeof(name));
-        memset(&url, 0, sizeof(url));
-        memset(&data, 0, sizeof(data));
+        category.clear();
+        subcategory.clear();
+        name.clear();
+        url.clear();
+        data.clear();
         deadline = 0;
         early_bird = 0;
         percentage = 0;
@@ -276,15 +290,16 @@ public:
         subaction = 0;
         alert_type = 0;
         alert_expiry = 0;
-        memset(&alert_text, 0, sizeof(alert_text));
+        alert_text.clear();
         rpcOnly = true;
+        fSendPrechecked = false;
         feature_id = 0;
         activation_block = 0;
         min_client_version = 0;
         distribution_property = 0;
         nonfungible_token_start = 0;
         nonfungible_token_end = 0;
-        memset(&nonfungible_data, 0, sizeof(nonfungible_data));
+        nonfungible_data.clear();
     }
 
     /** Sets the given values. */
@@ -305,12 +320,13 @@ public:
         txid = t;
         block = b;
         tx_idx = idx;
-        pkt_size = size < sizeof (pkt) ? size : sizeof (pkt);
+        pkt_size = size < MAX_PAYLOAD_SIZE ? size : MAX_PAYLOAD_SIZE;
         nValue = n;
         nNewValue = n;
         encodingClass = encodingClassIn;
         tx_fee_paid = txf;
-        memcpy(&pkt, p, pkt_size);
+        pkt.assign(p, p + pkt_size);
+        pkt.resize(pkt_size + PAYLOAD_PADDING, 0);
     }
 
     /** Parses the packet or payload. */
@@ -319,9 +335,24 @@ public:
     /** Interprets the payload and executes the logic. */
     int interpretPacket();
 
+    /** Interprets the payload and executes the logic of a transaction of the given block, without acquiring cs_main. */
+    int interpretPacket(const CBlockIndex* pindex);
+
     /** Enables access of interpretPacket. */
     void unlockLogic() { rpcOnly = false; };
 
+    /** Reads the property of a simple send from the payload, without interpreting it, or returns false for other transactions. */
+    bool peekSimpleSend(uint32_t& propertyOut) const;
+
+    /**
+     * Evaluates the checks of a simple send ahead of its execution, and returns whether they passed.
+     *
+     * The state must not be modified meanwhile. It neither locks nor logs, so several
+     * transactions can be checked at once, while the caller holds cs_tally. If the checks
+     * passed, they are skipped, when the transaction is executed.
+     */
+    bool precheckSimpleSend();
+
     /** Compares transaction objects based on block height and position within the block. */
     bool operator<(const CMPTransaction& other) const
     {
@@ -0,0 +1,76 @@
+/**
+ * @file txidfilter.cpp
+ *
+ * This file contains a bloom filter of the txids of Omni transactions, which
+ * answers negative lookups of the transaction database in memory.
+ */
+
+#include <omnicore/txidfilter.h>
+
+#include <crypto/siphash.h>
+#include <memusage.h>
+#include <random.h>
+#include <uint256.h>
+
+#include <limits>
+#include <stddef.h>
+#include <stdint.h>
+
+//! Number of bits per txid, which results in a false positive rate of about 1 % with 7 hash functions
+static const size_t TXID_FILTER_BITS_PER_ELEMENT = 10;
+
+COmniTxidFilter::COmniTxidFilter(size_t nCapacity)
+  : m_nCapacity(0), m_nElements(0), m_k0(GetRand(std::numeric_limits<uint64_t>::max())), m_k1(GetRand(std::numeric_limits<uint64_t>::max()))
+{
+    if (nCapacity > 0) Reset(nCapacity);
+}
+
+void COmniTxidFilter::Reset(size_t nCapacity)
+{
+    m_nCapacity = nCapacity;
+    m_nElements = 0;
+    m_bits.assign((nCapacity * TXID_FILTER_BITS_PER_ELEMENT + 63) / 64, 0);
+    m_bits.shrink_to_fit();
+}
+
+void COmniTxidFilter::GetPositions(const uint256& txid, uint64_t (&positions)[TXID_FILTER_HASH_FUNCS]) const
+{
+    // the positions are derived from one salted hash by double hashing
+    const uint64_t nHash = SipHashUint256(m_k0, m_k1, txid);
+    const uint64_t nSize = m_bits.size() * 64;
+    uint64_t h1 = nHash & 0xffffffff;
+    const uint64_t h2 = (nHash >> 32) | 1;
+    for (unsigned int i = 0; i < TXID_FILTER_HASH_FUNCS; ++i) {
+        positions[i] = h1 % nSize;
+        h1 += h2;
+    }
+}
+
+void COmniTxidFilter::Insert(const uint256& txid)
+{
+    if (m_bits.empty()) return;
+
+    uint64_t positions[TXID_FILTER_HASH_FUNCS];
+    GetPositions(txid, positions);
+    for (uint64_t nPos : positions) {
+        m_bits[nPos / 64] |= uint64_t(1) << (nPos % 64);
+    }
+    ++m_nElements;
+}
+
+bool COmniTxidFilter::MayContain(const uint256& txid) const
+{
+    if (m_bits.empty()) return true;
+
+    uint64_t positions[TXID_FILTER_HASH_FUNCS];
+    GetPositions(txid, positions);
+    for (uint64_t nPos : positions) {
+        if (!(m_bits[nPos / 64] & (uint64_t(1) << (nPos % 64)))) return false;
+    }
+    return true;
+}
+
+size_t COmniTxidFilter::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(m_bits);
+}
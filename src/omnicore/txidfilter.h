@@ -0,0 +1,61 @@
+#ifndef BITCOIN_OMNICORE_TXIDFILTER_H
+#define BITCOIN_OMNICORE_TXIDFILTER_H
+
+#include <uint256.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/** Minimum number of txids the filter of the transaction database is sized for. */
+static const size_t MIN_TXID_FILTER_CAPACITY = 100000;
+//! Number of hash functions of the txid filter
+static const unsigned int TXID_FILTER_HASH_FUNCS = 7;
+
+/**
+ * Bloom filter of the txids of Omni transactions.
+ *
+ * It answers, whether a transaction may be an Omni transaction, without false
+ * negatives, so lookups of other transactions don't need to read the database.
+ * Entries can't be removed, so transactions, which were rolled back, remain false
+ * positives, until the filter is rebuilt.
+ *
+ * An empty filter, which wasn't sized yet, contains everything. The filter is not
+ * thread-safe.
+ */
+class COmniTxidFilter
+{
+private:
+    std::vector<uint64_t> m_bits;
+    size_t m_nCapacity;
+    size_t m_nElements;
+    //! Salt of the hashes, so the false positives differ between nodes
+    uint64_t m_k0;
+    uint64_t m_k1;
+
+    /** Returns the positions of a txid in the bit array. */
+    void GetPositions(const uint256& txid, uint64_t (&positions)[TXID_FILTER_HASH_FUNCS]) const;
+
+public:
+    explicit COmniTxidFilter(size_t nCapacity = 0);
+
+    /** Removes all txids, and sizes the filter for the given number of txids with a false positive rate of about 1 %. */
+    void Reset(size_t nCapacity);
+
+    /** Adds a txid. */
+    void Insert(const uint256& txid);
+
+    /** Returns false, if the txid was never added. */
+    bool MayContain(const uint256& txid) const;
+
+    /** Returns whether the number of added txids reached the capacity, and the filter should be rebuilt larger. */
+    bool IsFull() const { return m_nElements >= m_nCapacity; }
+
+    size_t Size() const { return m_nElements; }
+    size_t GetCapacity() const { return m_nCapacity; }
+
+    /** Returns the approximate heap memory used by the filter. */
+    size_t DynamicMemoryUsage() const;
+};
+
+#endif // BITCOIN_OMNICORE_TXIDFILTER_H
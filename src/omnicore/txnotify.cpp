@@ -0,0 +1,68 @@
+/**
+ * @file txnotify.cpp
+ *
+ * This file contains the signals for confirmed Omni transactions and for
+ * connected or disconnected blocks, for example to publish them via ZMQ.
+ */
+
+#include <omnicore/txnotify.h>
+
+#include <omnicore/tx.h>
+
+#include <ui_interface.h>
+#include <uint256.h>
+
+#include <atomic>
+
+namespace mastercore
+{
+//! Whether transactions and blocks are signaled, so no records are built otherwise
+static std::atomic<bool> fNotifyTransactions{false};
+
+void EnableTransactionNotifications()
+{
+    fNotifyTransactions = true;
+}
+
+void DisableTransactionNotifications()
+{
+    fNotifyTransactions = false;
+}
+
+void NotifyTransactionRecorded(const CMPTransaction& mp_obj, const uint256& blockHash, int processingResult)
+{
+    if (!fNotifyTransactions) return;
+
+    TransactionNotification notification;
+    notification.txid = mp_obj.getHash();
+    notification.blockHash = blockHash;
+    notification.block = mp_obj.getBlock();
+    notification.position = mp_obj.getIndexInBlock();
+    notification.processingResult = processingResult;
+    notification.encodingClass = mp_obj.getEncodingClass();
+    notification.version = mp_obj.getVersion();
+    notification.type = mp_obj.getType();
+    notification.propertyId = mp_obj.getProperty();
+    notification.amount = mp_obj.getAmount();
+    notification.fee = mp_obj.getFeePaid();
+    notification.sender = mp_obj.getSender();
+    notification.receiver = mp_obj.getReceiver();
+    notification.payload = mp_obj.getRawPayload();
+
+    uiInterface.OmniTransactionRecorded(notification);
+}
+
+void NotifyBlockConnected(int nBlock, const uint256& blockHash)
+{
+    if (!fNotifyTransactions) return;
+
+    uiInterface.OmniBlockChanged(nBlock, blockHash, true);
+}
+
+void NotifyBlockDisconnected(int nBlock, const uint256& blockHash)
+{
+    if (!fNotifyTransactions) return;
+
+    uiInterface.OmniBlockChanged(nBlock, blockHash, false);
+}
+}
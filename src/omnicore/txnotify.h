@@ -0,0 +1,75 @@
+#ifndef BITCOIN_OMNICORE_TXNOTIFY_H
+#define BITCOIN_OMNICORE_TXNOTIFY_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CMPTransaction;
+
+namespace mastercore
+{
+/** A confirmed Omni transaction with its decoded fields, as recorded in the transaction database. */
+struct TransactionNotification
+{
+    uint256 txid;
+    uint256 blockHash;
+    int32_t block;
+    uint32_t position;
+    //! The result of the interpretation, zero or positive, if the transaction is valid
+    int32_t processingResult;
+    int32_t encodingClass;
+    uint16_t version;
+    uint16_t type;
+    uint32_t propertyId;
+    uint64_t amount;
+    uint64_t fee;
+    std::string sender;
+    std::string receiver;
+    std::vector<unsigned char> payload;
+
+    TransactionNotification() : block(0), position(0), processingResult(0), encodingClass(0), version(0), type(0),
+            propertyId(0), amount(0), fee(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txid);
+        READWRITE(blockHash);
+        READWRITE(block);
+        READWRITE(position);
+        READWRITE(processingResult);
+        READWRITE(encodingClass);
+        READWRITE(version);
+        READWRITE(type);
+        READWRITE(propertyId);
+        READWRITE(amount);
+        READWRITE(fee);
+        READWRITE(sender);
+        READWRITE(receiver);
+        READWRITE(payload);
+    }
+};
+
+/** Starts signaling recorded transactions and processed or disconnected blocks. */
+void EnableTransactionNotifications();
+
+/** Stops signaling recorded transactions and blocks. */
+void DisableTransactionNotifications();
+
+/** Signals a transaction, right after it was recorded in the transaction database. */
+void NotifyTransactionRecorded(const CMPTransaction& mp_obj, const uint256& blockHash, int processingResult);
+
+/** Signals a block, after its Omni transactions were processed. */
+void NotifyBlockConnected(int nBlock, const uint256& blockHash);
+
+/** Signals a block, whose Omni transactions are going to be rolled back. */
+void NotifyBlockDisconnected(int nBlock, const uint256& blockHash);
+}
+
+#endif // BITCOIN_OMNICORE_TXNOTIFY_H
@@ -0,0 +1,84 @@
+/**
+ * @file txobjectcache.cpp
+ *
+ * This file contains a least recently used cache of the transaction objects,
+ * which are returned by the RPC calls.
+ */
+
+#include <omnicore/txobjectcache.h>
+
+#include <random.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <limits>
+#include <utility>
+
+COmniTxObjectCache mastercore::rpcTxCache;
+
+SaltedTxObjectHasher::SaltedTxObjectHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+COmniTxObjectCache::COmniTxObjectCache(size_t nMaxSize)
+  : m_nMaxSize(nMaxSize), m_nHits(0), m_nMisses(0), m_nEvictions(0)
+{
+}
+
+bool COmniTxObjectCache::Get(const uint256& txid, Entry& entry)
+{
+    LOCK(m_mutex);
+    auto it = m_index.find(txid);
+    if (it == m_index.end()) {
+        ++m_nMisses;
+        return false;
+    }
+    ++m_nHits;
+
+    // move to the front, which is the most recently used position
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    entry = it->second->second;
+
+    return true;
+}
+
+void COmniTxObjectCache::Add(const uint256& txid, const Entry& entry)
+{
+    LOCK(m_mutex);
+    if (m_nMaxSize == 0) return;
+
+    auto it = m_index.find(txid);
+    if (it != m_index.end()) {
+        it->second->second = entry;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+    }
+
+    m_entries.emplace_front(txid, entry);
+    m_index.emplace(txid, m_entries.begin());
+    Trim();
+}
+
+void COmniTxObjectCache::SetMaxSize(size_t nMaxSize)
+{
+    LOCK(m_mutex);
+    m_nMaxSize = nMaxSize;
+    Trim();
+}
+
+void COmniTxObjectCache::Clear()
+{
+    LOCK(m_mutex);
+    m_index.clear();
+    m_entries.clear();
+}
+
+/**
+ * Evicts the least recently used objects, until the cache is within its limit.
+ */
+void COmniTxObjectCache::Trim()
+{
+    while (m_index.size() > m_nMaxSize) {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+        ++m_nEvictions;
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef BITCOIN_OMNICORE_TXOBJECTCACHE_H
+#define BITCOIN_OMNICORE_TXOBJECTCACHE_H
+
+#include <crypto/siphash.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <univalue.h>
+
+#include <list>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/** Default number of transaction objects held in the RPC transaction cache. */
+static const unsigned int DEFAULT_RPC_TX_CACHE_SIZE = 2000;
+
+/** Hasher for txids, which is salted, as the txids are chosen by the callers. */
+class SaltedTxObjectHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    SaltedTxObjectHasher();
+
+    size_t operator()(const uint256& txid) const { return SipHashUint256(k0, k1, txid); }
+};
+
+/**
+ * Cache of rendered RPC objects of confirmed Omni transactions.
+ *
+ * Only the basic objects are cached, as the extended details, such as the state
+ * of a trade, change with later transactions. The fields, which depend on the
+ * wallet or the chain tip, are updated, when an object is retrieved.
+ *
+ * When the cache is full, the least recently used object is evicted, so the
+ * transactions of recent blocks, which are requested most, stay cached.
+ *
+ * The cache is thread-safe.
+ */
+class COmniTxObjectCache
+{
+public:
+    struct Entry
+    {
+        //! Rendered transaction object
+        UniValue txobj;
+        //! Block of the transaction
+        uint256 blockHash;
+        //! Sender and reference address, to filter by address and to determine, whether it's mine
+        std::string sender;
+        std::string receiver;
+    };
+
+private:
+    typedef std::list<std::pair<uint256, Entry>> EntryList;
+
+    mutable Mutex m_mutex;
+
+    //! Cached objects, the most recently used first
+    EntryList m_entries GUARDED_BY(m_mutex);
+    //! Position of each cached object in the list
+    std::unordered_map<uint256, EntryList::iterator, SaltedTxObjectHasher> m_index GUARDED_BY(m_mutex);
+
+    size_t m_nMaxSize GUARDED_BY(m_mutex);
+    uint64_t m_nHits GUARDED_BY(m_mutex);
+    uint64_t m_nMisses GUARDED_BY(m_mutex);
+    uint64_t m_nEvictions GUARDED_BY(m_mutex);
+
+    void Trim() EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+public:
+    explicit COmniTxObjectCache(size_t nMaxSize = DEFAULT_RPC_TX_CACHE_SIZE);
+
+    /** Retrieves the object of a transaction and marks it as recently used. */
+    bool Get(const uint256& txid, Entry& entry);
+
+    /** Adds the object of a transaction, and evicts the least recently used one, if the cache is full. */
+    void Add(const uint256& txid, const Entry& entry);
+
+    /** Sets the maximum number of cached objects. */
+    void SetMaxSize(size_t nMaxSize);
+
+    /** Removes all objects, but keeps the counters. */
+    void Clear();
+
+    size_t Size() const { LOCK(m_mutex); return m_index.size(); }
+    size_t GetMaxSize() const { LOCK(m_mutex); return m_nMaxSize; }
+    uint64_t GetHits() const { LOCK(m_mutex); return m_nHits; }
+    uint64_t GetMisses() const { LOCK(m_mutex); return m_nMisses; }
+    uint64_t GetEvictions() const { LOCK(m_mutex); return m_nEvictions; }
+};
+
+namespace mastercore
+{
+//! Cache of the transaction objects returned by the RPC calls
+extern COmniTxObjectCache rpcTxCache;
+}
+
+#endif // BITCOIN_OMNICORE_TXOBJECTCACHE_H
@@ -1,7 +1,8 @@
 /**
  * @file uint256_extensions.h
  *
- * This file provides helper to handle uint256 calculations.
+ * This file provides helper to handle uint256 calculations, and to pro-rate amounts
+ * with native 128 bit arithmetic, where available.
  */
 
 #ifndef BITCOIN_OMNICORE_UINT256_EXTENSIONS_H
@@ -59,6 +60,91 @@ inline arith_uint256 DivideAndRoundUp(const arith_uint256& numerator, const arit
     return uint256_const::one + (numerator - uint256_const::one) / denominator;
 }
 
+/**
+ * Calculates a * b / c with 256 bit arithmetic, rounded down or up, for non-negative
+ * factors and a positive divisor. A zero product yields zero for any divisor.
+ *
+ * @return False, if the result exceeds the range of int64_t
+ */
+inline bool CheckedMultiplyAndDivide256(int64_t a, int64_t b, int64_t c, bool fRoundUp, int64_t& result)
+{
+    if (a == 0 || b == 0) {
+        result = 0;
+        return true;
+    }
+    assert(c > 0);
+    arith_uint256 product = ConvertTo256(a) * ConvertTo256(b);
+    arith_uint256 quotient = fRoundUp ? DivideAndRoundUp(product, ConvertTo256(c)) : product / ConvertTo256(c);
+    if (quotient > uint256_const::max_int64) return false;
+    result = static_cast<int64_t>(quotient.GetLow64());
+    return true;
+}
+
+#ifdef __SIZEOF_INT128__
+/**
+ * Calculates a * b / c with native 128 bit arithmetic, rounded down or up, for non-negative
+ * factors and a positive divisor.
+ *
+ * Both factors are below 2^63, so the product fits into 126 bits.
+ *
+ * @return False, if the result exceeds the range of int64_t
+ */
+inline bool CheckedMultiplyAndDivide128(int64_t a, int64_t b, int64_t c, bool fRoundUp, int64_t& result)
+{
+    assert(a >= 0 && b >= 0);
+    if (a == 0 || b == 0) {
+        result = 0;
+        return true;
+    }
+    assert(c > 0);
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * static_cast<unsigned __int128>(b);
+    unsigned __int128 quotient = product / static_cast<unsigned __int128>(c);
+    if (fRoundUp && quotient * static_cast<unsigned __int128>(c) != product) ++quotient;
+    if (quotient > static_cast<unsigned __int128>(std::numeric_limits<int64_t>::max())) return false;
+    result = static_cast<int64_t>(quotient);
+    return true;
+}
+#endif
+
+/**
+ * Calculates a * b / c, rounded down or up, for non-negative factors and a positive divisor.
+ *
+ * The amounts are pro-rated with native 128 bit arithmetic, where available, and with
+ * 256 bit arithmetic otherwise. Both yield the same results.
+ *
+ * @return False, if the result exceeds the range of int64_t
+ */
+inline bool CheckedMultiplyAndDivide(int64_t a, int64_t b, int64_t c, bool fRoundUp, int64_t& result)
+{
+#ifdef __SIZEOF_INT128__
+    return CheckedMultiplyAndDivide128(a, b, c, fRoundUp, result);
+#else
+    return CheckedMultiplyAndDivide256(a, b, c, fRoundUp, result);
+#endif
+}
+
+/**
+ * Returns floor(a * b / c), which must be in range of int64_t.
+ */
+inline int64_t MultiplyAndDivide(int64_t a, int64_t b, int64_t c)
+{
+    int64_t result = 0;
+    bool fInRange = CheckedMultiplyAndDivide(a, b, c, false, result);
+    assert(fInRange);
+    return result;
+}
+
+/**
+ * Returns ceil(a * b / c), which must be in range of int64_t.
+ */
+inline int64_t MultiplyAndDivideRoundUp(int64_t a, int64_t b, int64_t c)
+{
+    int64_t result = 0;
+    bool fInRange = CheckedMultiplyAndDivide(a, b, c, true, result);
+    assert(fInRange);
+    return result;
+}
+
 } // namespace mastercore
 
 #endif // BITCOIN_OMNICORE_UINT256_EXTENSIONS_H
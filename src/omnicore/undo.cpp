@@ -0,0 +1,332 @@
+/**
+ * @file undo.cpp
+ *
+ * This file contains the undo journal of the last blocks, which allows to handle
+ * short reorganizations in memory.
+ */
+
+#include <omnicore/undo.h>
+
+#include <omnicore/consensushash.h>
+#include <omnicore/dbbalancehistory.h>
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dex.h>
+#include <omnicore/indexproperties.h>
+#include <omnicore/log.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/sp.h>
+#include <omnicore/tally.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <deque>
+#include <memory>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern int64_t exodus_prev;
+
+namespace mastercore
+{
+namespace
+{
+/** The changes of a block, and the state before the block. */
+struct CBlockUndoEntry
+{
+    int nBlock;
+    uint256 hashBlock;
+    uint256 hashPrevBlock;
+    //! Balance changes, excluding pending amounts
+    std::vector<CMPTallyMap::Change> vChanges;
+    //! Copies of the state before the block, shared with the previous entry, if the block didn't change them
+    std::shared_ptr<const OfferMap> pOffers;
+    std::shared_ptr<const AcceptMap> pAccepts;
+    std::shared_ptr<const CrowdMap> pCrowds;
+    std::shared_ptr<const md_PropertiesMap> pMetadex;
+    std::shared_ptr<const std::set<std::pair<uint32_t, int> > > pFreezingEnabled;
+    std::shared_ptr<const std::set<std::pair<std::string, uint32_t> > > pFrozenAddresses;
+    int64_t nExodusPrev;
+    uint32_t nNextMainId;
+    uint32_t nNextTestId;
+};
+
+//! Maximal number of entries, 0 if disabled
+int g_nMaxBlocks GUARDED_BY(cs_tally) = 0;
+//! Entries of consecutive blocks, the last one refers to the current state
+std::deque<CBlockUndoEntry> g_entries GUARDED_BY(cs_tally);
+//! Entry of the block in progress, if recorded
+std::unique_ptr<CBlockUndoEntry> g_current GUARDED_BY(cs_tally);
+
+/**
+ * Returns a copy of the state, or the copy of the previous entry, if the state is still the same.
+ *
+ * Most blocks don't touch the DEx, MetaDEx, crowdsales or freezing, so consecutive entries
+ * usually share one copy. Comparing is cheaper than copying, because nothing is allocated.
+ */
+template <typename T>
+std::shared_ptr<const T> ShareOrCopy(const T& state, const std::shared_ptr<const T>& pPrev)
+{
+    if (pPrev && *pPrev == state) return pPrev;
+    return std::make_shared<const T>(state);
+}
+
+/** Returns the copies of the state of an entry, without its balance changes. */
+CBlockUndoEntry SharedState(const CBlockUndoEntry& entry)
+{
+    CBlockUndoEntry shared;
+    shared.pOffers = entry.pOffers;
+    shared.pAccepts = entry.pAccepts;
+    shared.pCrowds = entry.pCrowds;
+    shared.pMetadex = entry.pMetadex;
+    shared.pFreezingEnabled = entry.pFreezingEnabled;
+    shared.pFrozenAddresses = entry.pFrozenAddresses;
+    return shared;
+}
+
+void Clear() EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    g_entries.clear();
+    g_current.reset();
+    mp_tally_map.SetJournal(false);
+}
+
+/**
+ * Stores the balances after a block in the balance history, see -omnibalancehistory.
+ *
+ * Only the balances changed in the block are stored, unless the history starts with
+ * the block, in which case all non-empty balances are stored as snapshot.
+ */
+void RecordBalanceHistory(int nBlock, const std::vector<CMPTallyMap::Change>& vChanges) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    // the changed balances by property and address identifier, without duplicates
+    std::set<std::pair<uint32_t, uint32_t> > setChanged;
+    if (pDbBalanceHistory->IsEmpty()) {
+        for (CMPTallyMap::iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
+            const CMPTally& tally = (*it).second;
+            for (uint32_t propertyId : tally) {
+                if (IsIndexedProperty(propertyId)) setChanged.emplace(propertyId, it.id());
+            }
+        }
+    } else {
+        for (const CMPTallyMap::Change& change : vChanges) {
+            if (IsIndexedProperty(change.propertyId)) setChanged.emplace(change.propertyId, change.id);
+        }
+    }
+
+    std::vector<CBalanceHistoryEntry> entries;
+    entries.reserve(setChanged.size());
+    for (const std::pair<uint32_t, uint32_t>& changed : setChanged) {
+        const CMPTally* pTally = mp_tally_map.Get(changed.second);
+        if (!pTally) continue;
+        CBalanceHistoryEntry entry;
+        entry.address = mp_tally_map.GetAddress(changed.second);
+        entry.propertyId = changed.first;
+        entry.nBalance = pTally->getMoney(changed.first, BALANCE);
+        entry.nReserved = pTally->getMoneyReserved(changed.first);
+        entries.push_back(std::move(entry));
+    }
+
+    pDbBalanceHistory->RecordBlock(nBlock, entries);
+}
+} // anonymous namespace
+
+/**
+ * Sets the number of blocks kept, 0 to disable the journal, and discards all entries.
+ */
+void InitUndoJournal(int nBlocks)
+{
+    LOCK(cs_tally);
+    g_nMaxBlocks = (nBlocks > 0) ? nBlocks : 0;
+    Clear();
+}
+
+/**
+ * Discards all entries, for example because the state was restored otherwise.
+ */
+void ClearUndoJournal()
+{
+    Clear();
+}
+
+/**
+ * Starts recording the changes of a block, if it's one of the last blocks of the chain.
+ *
+ * Blocks further away from the tip, such as during the initial scan, are not
+ * recorded. If the block doesn't follow the last recorded block, or if the
+ * balances were cleared in the meantime, all entries are discarded.
+ */
+void BeginBlockUndo(int nBlock, const uint256& hashPrevBlock, int nChainHeight)
+{
+    std::vector<CMPTallyMap::Change> vChanges;
+    if (!mp_tally_map.TakeJournal(vChanges) || g_current) {
+        // the balances were cleared, or the previous block was not completed
+        Clear();
+    }
+    if (g_nMaxBlocks == 0 || nBlock <= nChainHeight - g_nMaxBlocks) {
+        Clear();
+        // the balance history records the changes of every block
+        mp_tally_map.SetJournal(pDbBalanceHistory != nullptr);
+        return;
+    }
+    if (!g_entries.empty() && (g_entries.back().nBlock + 1 != nBlock || g_entries.back().hashBlock != hashPrevBlock)) {
+        g_entries.clear();
+    }
+
+    const CBlockUndoEntry prev = g_entries.empty() ? CBlockUndoEntry() : SharedState(g_entries.back());
+
+    g_current.reset(new CBlockUndoEntry());
+    g_current->nBlock = nBlock;
+    g_current->hashPrevBlock = hashPrevBlock;
+    g_current->pOffers = ShareOrCopy(my_offers, prev.pOffers);
+    g_current->pAccepts = ShareOrCopy(my_accepts, prev.pAccepts);
+    g_current->pCrowds = ShareOrCopy(my_crowds, prev.pCrowds);
+    g_current->pMetadex = ShareOrCopy(metadex, prev.pMetadex);
+    g_current->pFreezingEnabled = ShareOrCopy(GetFreezingEnabledProperties(), prev.pFreezingEnabled);
+    g_current->pFrozenAddresses = ShareOrCopy(GetFrozenAddresses(), prev.pFrozenAddresses);
+    g_current->nExodusPrev = exodus_prev;
+    g_current->nNextMainId = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_MSC);
+    g_current->nNextTestId = pDbSpInfo->peekNextSPID(OMNI_PROPERTY_TMSC);
+
+    mp_tally_map.SetJournal(true);
+}
+
+/**
+ * Stops recording the changes of a block, and stores them as entry of the journal.
+ *
+ * The balance changes of blocks, which are not kept, are still recorded, while the
+ * balance history is enabled, and only passed on to it.
+ */
+void EndBlockUndo(int nBlock, const uint256& hashBlock)
+{
+    if (!g_current) {
+        if (!pDbBalanceHistory) return;
+        std::vector<CMPTallyMap::Change> vChanges;
+        mp_tally_map.SetJournal(false);
+        if (mp_tally_map.TakeJournal(vChanges)) {
+            RecordBalanceHistory(nBlock, vChanges);
+        } else {
+            PrintToLog("%s(): the balances were cleared during block %d, which is missing in the balance history\n", __func__, nBlock);
+        }
+        return;
+    }
+
+    mp_tally_map.SetJournal(false);
+    if (!mp_tally_map.TakeJournal(g_current->vChanges) || g_current->nBlock != nBlock) {
+        Clear();
+        return;
+    }
+    g_current->hashBlock = hashBlock;
+    if (pDbBalanceHistory) RecordBalanceHistory(nBlock, g_current->vChanges);
+
+    g_entries.push_back(std::move(*g_current));
+    g_current.reset();
+    while (g_entries.size() > static_cast<size_t>(g_nMaxBlocks)) {
+        g_entries.pop_front();
+    }
+}
+
+/**
+ * Undoes all blocks at and above the given height, if they are covered by the journal.
+ *
+ * If reverting fails for some reason, the state is partially reverted, and must be
+ * restored otherwise, which replaces all state covered by the journal.
+ */
+int UndoBlocks(int nHeight, const uint256& hashForkBlock)
+{
+    if (g_current || g_entries.empty()) return -1;
+
+    const CBlockUndoEntry& last = g_entries.back();
+    if (last.nBlock < nHeight - 1) return -1;
+    if (last.nBlock == nHeight - 1) {
+        // nothing to undo, but the state must refer to the same block
+        return (last.hashBlock == hashForkBlock) ? last.nBlock : -1;
+    }
+
+    const CBlockUndoEntry& first = g_entries.front();
+    if (first.nBlock > nHeight) return -1;
+    const CBlockUndoEntry& fork = g_entries[nHeight - first.nBlock];
+    if (fork.nBlock != nHeight || fork.hashPrevBlock != hashForkBlock) return -1;
+
+    // the balances are reverted block by block, while the other state is copied once
+    CBlockUndoEntry restored;
+    while (!g_entries.empty() && g_entries.back().nBlock >= nHeight) {
+        CBlockUndoEntry& entry = g_entries.back();
+        if (!mp_tally_map.RevertChanges(entry.vChanges) || pDbSpInfo->popBlock(entry.hashBlock) < 0) {
+            PrintToLog("%s(): failed to undo block %d, the state must be restored otherwise\n", __func__, entry.nBlock);
+            Clear();
+            return -1;
+        }
+        restored = std::move(entry);
+        g_entries.pop_back();
+    }
+    my_offers = *restored.pOffers;
+    my_accepts = *restored.pAccepts;
+    my_crowds = *restored.pCrowds;
+    metadex = *restored.pMetadex;
+    InvalidateStateCommitment();
+    exodus_prev = restored.nExodusPrev;
+    pDbSpInfo->init(restored.nNextMainId, restored.nNextTestId);
+    RestoreFreezeState(*restored.pFreezingEnabled, *restored.pFrozenAddresses);
+    MetaDEx_RebuildIndex();
+    pDbSpInfo->setWatermark(hashForkBlock);
+
+    PrintToLog("%s(): undid the blocks above %d in memory\n", __func__, nHeight - 1);
+
+    return nHeight - 1;
+}
+
+/**
+ * Discards the entries of all blocks at and above the given height, without undoing them.
+ */
+void DiscardBlockUndo(int nHeight)
+{
+    if (g_current) {
+        Clear();
+        return;
+    }
+    while (!g_entries.empty() && g_entries.back().nBlock >= nHeight) {
+        g_entries.pop_back();
+    }
+}
+
+/**
+ * Returns the number of blocks, which can currently be undone.
+ */
+int GetUndoBlockCount()
+{
+    return g_entries.size();
+}
+
+/**
+ * Removes the addresses without balances from the tally map, except those referred
+ * to by the journal, whose balance changes are translated to the new identifiers.
+ *
+ * An emptied address may still be credited again, when a block is undone, so it's
+ * kept as long as the entry of any block refers to it.
+ */
+size_t RemoveEmptyAddresses()
+{
+    std::set<uint32_t> setReferenced;
+    for (const CBlockUndoEntry& entry : g_entries) {
+        for (const CMPTallyMap::Change& change : entry.vChanges) {
+            setReferenced.insert(change.id);
+        }
+    }
+
+    std::vector<uint32_t> vRemap;
+    const size_t nRemoved = mp_tally_map.RemoveEmpty(setReferenced, vRemap);
+    if (nRemoved == 0) return 0;
+
+    for (CBlockUndoEntry& entry : g_entries) {
+        for (CMPTallyMap::Change& change : entry.vChanges) {
+            change.id = vRemap[change.id];
+        }
+    }
+    return nRemoved;
+}
+} // namespace mastercore
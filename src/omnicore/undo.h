@@ -0,0 +1,83 @@
+#ifndef BITCOIN_OMNICORE_UNDO_H
+#define BITCOIN_OMNICORE_UNDO_H
+
+#include <omnicore/timedmutex.h>
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <stddef.h>
+
+extern CTimedRecursiveMutex cs_tally;
+
+namespace mastercore
+{
+//! Default number of most recent blocks, which can be undone in memory
+static const int DEFAULT_UNDO_BLOCKS = 6;
+
+/**
+ * The undo journal records the changes of the last blocks, so that a short
+ * reorganization can be handled in memory, without loading a persisted state
+ * and rescanning blocks.
+ *
+ * Balance changes are recorded as deltas, while the state of the DEx, MetaDEx,
+ * crowdsales and freezing before the block, which is small compared to the
+ * balances, is copied as a whole. Blocks, which don't change this state, share
+ * the copy with the previous block.
+ */
+
+/** Sets the number of blocks kept, 0 to disable the journal, and discards all entries. */
+void InitUndoJournal(int nBlocks);
+
+/** Discards all entries, for example because the state was restored otherwise. */
+void ClearUndoJournal() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Starts recording the changes of a block, if it's one of the last blocks of the chain.
+ *
+ * @param nBlock         The height of the block
+ * @param hashPrevBlock  The hash of the previous block
+ * @param nChainHeight   The height of the active chain
+ */
+void BeginBlockUndo(int nBlock, const uint256& hashPrevBlock, int nChainHeight) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Stops recording the changes of a block, and stores them as entry of the journal.
+ *
+ * If the balance history is enabled, the balances changed in the block are stored in
+ * it, including those of blocks, which are not kept in the journal.
+ */
+void EndBlockUndo(int nBlock, const uint256& hashBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Undoes all blocks at and above the given height, if they are covered by the journal.
+ *
+ * The SP database is rolled back as well, while the other databases are not touched.
+ *
+ * @param nHeight        The height of the first block to undo
+ * @param hashForkBlock  The hash of the block at nHeight - 1 in the active chain
+ * @return The height of the state after undoing, or -1, if the state must be restored otherwise
+ */
+int UndoBlocks(int nHeight, const uint256& hashForkBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Discards the entries of all blocks at and above the given height, without undoing them.
+ *
+ * Used, when the blocks didn't change the state, so the entry of the previous block
+ * still refers to the state after it.
+ */
+void DiscardBlockUndo(int nHeight) EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/** Returns the number of blocks, which can currently be undone. */
+int GetUndoBlockCount() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+
+/**
+ * Removes the addresses without balances from the tally map, except those referred
+ * to by the journal, whose balance changes are translated to the new identifiers.
+ *
+ * @return The number of removed addresses
+ */
+size_t RemoveEmptyAddresses() EXCLUSIVE_LOCKS_REQUIRED(cs_tally);
+}
+
+#endif // BITCOIN_OMNICORE_UNDO_H
@@ -4,8 +4,14 @@
  * This file contains certain helpers to access information about Bitcoin.
  */
 
+#include <omnicore/utilsbitcoin.h>
+
 #include <chain.h>
 #include <chainparams.h>
+#include <index/txindex.h>
+#include <primitives/transaction.h>
+#include <txmempool.h>
+#include <uint256.h>
 #include <validation.h>
 #include <sync.h>
 
@@ -50,6 +56,26 @@ CBlockIndex* GetBlockIndex(const uint256& hash)
     return pBlockIndex;
 }
 
+/**
+ * Fetches a transaction from the mempool or the transaction index.
+ *
+ * Other than GetTransaction(), cs_main isn't held while the transaction is read from
+ * disk, and ::mempool.cs is only held by CTxMemPool::get() for the lookup.
+ *
+ * @param txid[in]        The hash of the transaction
+ * @param tx[out]         The transaction
+ * @param hashBlock[out]  The block of the transaction, or null, if it's unconfirmed
+ * @return True, if the transaction was found
+ */
+bool FetchTransaction(const uint256& txid, CTransactionRef& tx, uint256& hashBlock)
+{
+    hashBlock.SetNull();
+    tx = ::mempool.get(txid);
+    if (tx) return true;
+
+    return g_txindex && g_txindex->FindTx(txid, hashBlock, tx);
+}
+
 bool MainNet()
 {
     return Params().NetworkIDString() == "main";
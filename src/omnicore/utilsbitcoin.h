@@ -4,6 +4,8 @@
 class CBlockIndex;
 class uint256;
 
+#include <primitives/transaction.h>
+
 #include <stdint.h>
 
 namespace mastercore
@@ -14,6 +16,8 @@ int GetHeight();
 uint32_t GetLatestBlockTime();
 /** Returns the CBlockIndex for a given block hash, or NULL. */
 CBlockIndex* GetBlockIndex(const uint256& hash);
+/** Fetches a transaction from the mempool or the transaction index, without holding cs_main. */
+bool FetchTransaction(const uint256& txid, CTransactionRef& tx, uint256& hashBlock);
 
 bool MainNet();
 bool TestNet();
@@ -9,6 +9,7 @@
 
 #include <omnicore/log.h>
 #include <omnicore/omnicore.h>
+#include <omnicore/statescan.h>
 #include <omnicore/tally.h>
 #include <omnicore/walletutils.h>
 
@@ -21,8 +22,10 @@
 
 #include <stdint.h>
 #include <algorithm>
+#include <atomic>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <utility>
@@ -30,67 +33,287 @@
 
 namespace mastercore
 {
+/** A cached wallet tally, and whether it's included in the wallet totals. */
+struct WalletTally
+{
+    CMPTally tally;
+    bool fSpendable;
+};
+
 //! Map of wallet balances
-static std::map<std::string, CMPTally> walletBalancesCache;
+static std::map<std::string, WalletTally> walletBalancesCache;
+//! Whether the cache is rebuilt from all addresses by the next update
+static bool fRebuildCache = true;
+
+/** Whether an address of the tally map belongs to a wallet. */
+enum AddressOwnership : uint8_t
+{
+    OWNERSHIP_UNKNOWN = 0,
+    OWNERSHIP_NONE,
+    OWNERSHIP_WATCHONLY,
+    OWNERSHIP_SPENDABLE,
+};
+
+//! Known ownership of the addresses, by address identifier of the tally map
+static std::vector<uint8_t> vAddressOwnership;
+//! Incremented by the wallets, whenever addresses may have been added or removed
+static std::atomic<uint64_t> nWalletAddressEpoch{0};
+//! Epoch of the known ownership
+static uint64_t nOwnershipEpoch = 0;
+
+#ifdef ENABLE_WALLET
+/** Connections to the signals of a loaded wallet, which announce new or removed addresses. */
+struct WalletSubscription
+{
+    std::weak_ptr<CWallet> wallet;
+    std::vector<boost::signals2::connection> connections;
+};
+
+//! Subscriptions to the loaded wallets
+static std::vector<WalletSubscription> vWalletSubscriptions;
+#endif
 
 /**
- * Updates the cache with the latest state, returning true if changes were made to wallet addresses (including watch only).
+ * Subscribes to the address events of the loaded wallets, if they changed since the last update.
  *
- * Also prepares a list of addresses that were changed (for future usage).
+ * The events only invalidate the known ownership, so they are cheap for the wallet.
  */
-int WalletCacheUpdate()
+static void SubscribeWallets()
 {
-    if (msc_debug_walletcache) PrintToLog("WALLETCACHE: Update requested\n");
-    int numChanges = 0;
-    std::set<std::string> changedAddresses;
+#ifdef ENABLE_WALLET
+    const std::vector<std::shared_ptr<CWallet>> vWallets = GetWallets();
+    bool fChanged = vWallets.size() != vWalletSubscriptions.size();
+    for (size_t n = 0; !fChanged && n < vWallets.size(); ++n) {
+        fChanged = vWalletSubscriptions[n].wallet.lock() != vWallets[n];
+    }
+    if (!fChanged) return;
 
-    LOCK(cs_tally);
+    for (WalletSubscription& subscription : vWalletSubscriptions) {
+        for (boost::signals2::connection& connection : subscription.connections) {
+            connection.disconnect();
+        }
+    }
+    vWalletSubscriptions.clear();
 
-    for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-        const std::string& address = my_it->first;
+    for (const std::shared_ptr<CWallet>& wallet : vWallets) {
+        WalletSubscription subscription;
+        subscription.wallet = wallet;
+        subscription.connections.push_back(wallet->NotifyAddressBookChanged.connect(
+                [](CWallet*, const CTxDestination&, const std::string&, bool, const std::string&, ChangeType) { ++nWalletAddressEpoch; }));
+        subscription.connections.push_back(wallet->NotifyWatchonlyChanged.connect([](bool) { ++nWalletAddressEpoch; }));
+        subscription.connections.push_back(wallet->NotifyCanGetAddressesChanged.connect([] { ++nWalletAddressEpoch; }));
+        vWalletSubscriptions.push_back(std::move(subscription));
+    }
 
-        // determine if this address is in the wallet
-        int addressIsMine = IsMyAddressAllWallets(address, true);
-        if (!addressIsMine) {
-            if (msc_debug_walletcache) PrintToLog("WALLETCACHE: Ignoring non-wallet address %s\n", address);
-            continue; // ignore this address, not in wallet
+    // a wallet was loaded or unloaded
+    ++nWalletAddressEpoch;
+#endif
+}
+
+/**
+ * Returns whether an address belongs to a wallet, which is only looked up in the wallets once, until
+ * the wallets announce new or removed addresses.
+ */
+static AddressOwnership GetOwnership(uint32_t id, const std::string& address)
+{
+    if (id >= vAddressOwnership.size()) {
+        vAddressOwnership.resize(std::max<size_t>(id + 1, mp_tally_map.size()), OWNERSHIP_UNKNOWN);
+    }
+    uint8_t& ownership = vAddressOwnership[id];
+    if (ownership == OWNERSHIP_UNKNOWN) {
+        if (!IsMyAddressAllWallets(address, true)) {
+            ownership = OWNERSHIP_NONE;
+        } else if (IsMyAddressAllWallets(address, false, ISMINE_SPENDABLE)) {
+            ownership = OWNERSHIP_SPENDABLE;
+        } else {
+            ownership = OWNERSHIP_WATCHONLY;
         }
+    }
+    return static_cast<AddressOwnership>(ownership);
+}
+
+/**
+ * Adds the balances of a spendable wallet address to the wallet totals, or subtracts them, if nSign is -1.
+ */
+static void UpdateWalletTotals(const CMPTally& tally, int64_t nSign)
+{
+    for (uint32_t propertyId : tally) {
+        global_wallet_property_list.insert(propertyId);
+        global_balance_money[propertyId] += nSign * tally.getMoneyAvailable(propertyId);
+        global_balance_reserved[propertyId] += nSign * tally.getMoney(propertyId, SELLOFFER_RESERVE);
+        global_balance_reserved[propertyId] += nSign * tally.getMoney(propertyId, METADEX_RESERVE);
+        global_balance_reserved[propertyId] += nSign * tally.getMoney(propertyId, ACCEPT_RESERVE);
+    }
+}
+
+/** Adds the properties of a tally to the changed properties, if they are collected. */
+static void CollectProperties(const CMPTally& tally, std::set<uint32_t>* pPropertyIds)
+{
+    if (!pPropertyIds) return;
+    for (uint32_t propertyId : tally) {
+        pPropertyIds->insert(propertyId);
+    }
+}
+
+/**
+ * Examines whether an address belongs to a wallet, and updates its cached tally and the wallet totals.
+ *
+ * @return 1, if the cached wallet address was changed, or 0 otherwise
+ */
+static int UpdateCachedAddress(uint32_t id, std::set<uint32_t>* pPropertyIds) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+{
+    const std::string& address = mp_tally_map.GetAddress(id);
+    const CMPTally& tally = *mp_tally_map.Get(id);
+
+    std::map<std::string, WalletTally>::iterator search_it = walletBalancesCache.find(address);
 
-        // obtain & init the tally
-        CMPTally& tally = my_it->second;
-        tally.init();
-
-        // check cache for miss on address
-        std::map<std::string, CMPTally>::iterator search_it = walletBalancesCache.find(address);
-        if (search_it == walletBalancesCache.end()) { // cache miss, new address
-            ++numChanges;
-            changedAddresses.insert(address);
-            walletBalancesCache.insert(std::make_pair(address,tally));
-            if (msc_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s not in cache\n", address);
-            continue;
+    // determine if this address is in the wallet
+    const AddressOwnership ownership = GetOwnership(id, address);
+    if (ownership == OWNERSHIP_NONE) {
+        PrintToLogVerbose(msc_debug_walletcache, "WALLETCACHE: Ignoring non-wallet address %s\n", address);
+        if (search_it != walletBalancesCache.end()) { // no longer in the wallet
+            CollectProperties(search_it->second.tally, pPropertyIds);
+            if (search_it->second.fSpendable) UpdateWalletTotals(search_it->second.tally, -1);
+            walletBalancesCache.erase(search_it);
+            return 1;
         }
+        return 0; // ignore this address, not in wallet
+    }
+
+    if (search_it != walletBalancesCache.end()) {
+        if (search_it->second.tally == tally) return 0; // cache hit
+        PrintToLogVerbose(msc_debug_walletcache, "WALLETCACHE: *CACHE MISS* - %s balance differs\n", address);
+        CollectProperties(search_it->second.tally, pPropertyIds);
+        if (search_it->second.fSpendable) UpdateWalletTotals(search_it->second.tally, -1);
+    } else {
+        PrintToLogVerbose(msc_debug_walletcache, "WALLETCACHE: *CACHE MISS* - %s not in cache\n", address);
+        search_it = walletBalancesCache.insert(std::make_pair(address, WalletTally())).first;
+    }
 
-        // check cache for miss on balance - TODO TRY AND OPTIMIZE THIS
-        CMPTally &cacheTally = search_it->second;
-        uint32_t propertyId;
-        while (0 != (propertyId = (tally.next()))) {
-            if (tally.getMoney(propertyId, BALANCE) != cacheTally.getMoney(propertyId, BALANCE) ||
-                    tally.getMoney(propertyId, PENDING) != cacheTally.getMoney(propertyId, PENDING) ||
-                    tally.getMoney(propertyId, SELLOFFER_RESERVE) != cacheTally.getMoney(propertyId, SELLOFFER_RESERVE) ||
-                    tally.getMoney(propertyId, ACCEPT_RESERVE) != cacheTally.getMoney(propertyId, ACCEPT_RESERVE) ||
-                    tally.getMoney(propertyId, METADEX_RESERVE) != cacheTally.getMoney(propertyId, METADEX_RESERVE)) { // cache miss, balance
-                ++numChanges;
-                changedAddresses.insert(address);
-                walletBalancesCache.erase(search_it);
-                walletBalancesCache.insert(std::make_pair(address,tally));
-                if (msc_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s balance for property %d differs\n", address, propertyId);
-                break;
+    CollectProperties(tally, pPropertyIds);
+    search_it->second.tally = tally;
+    search_it->second.fSpendable = ownership == OWNERSHIP_SPENDABLE;
+    if (search_it->second.fSpendable) UpdateWalletTotals(tally, 1);
+    return 1;
+}
+
+/**
+ * Updates the cache and the wallet totals with the latest state, returning the number of wallet addresses
+ * (including watch only), which were changed.
+ *
+ * Only the addresses modified since the last update are examined, unless the balances were cleared in the
+ * meantime. Whether an address belongs to a wallet is remembered, until the wallets announce new or removed
+ * addresses, in which case all addresses are examined again, so imported addresses with existing balances
+ * are picked up.
+ *
+ * The properties held by the changed addresses before or after the update are added to pPropertyIds, so
+ * the UI can refresh only those.
+ *
+ * Note: the wallet totals do not include balances of watch-only addresses.
+ */
+int WalletCacheUpdate(std::set<uint32_t>* pPropertyIds)
+{
+    PrintToLogVerbose(msc_debug_walletcache, "WALLETCACHE: Update requested\n");
+    int numChanges = 0;
+    std::vector<uint32_t> vModified;
+    uint64_t nClears = 0;
+
+    {
+        LOCK(cs_tally);
+
+        SubscribeWallets();
+        const uint64_t nEpoch = nWalletAddressEpoch;
+        if (nEpoch != nOwnershipEpoch) {
+            PrintToLogVerbose(msc_debug_walletcache, "WALLETCACHE: Wallet addresses changed\n");
+            vAddressOwnership.clear();
+            nOwnershipEpoch = nEpoch;
+            // addresses, which are not modified, may hold balances as well
+            fRebuildCache = true;
+        }
+
+        nClears = mp_tally_map.GetClearCount();
+        if (!mp_tally_map.TakeModified(vModified, CMPTallyMap::MODIFIED_WALLET) || fRebuildCache) {
+            // the balances were cleared, or the cache was reset, so all addresses are examined again
+            PrintToLogVerbose(msc_debug_walletcache, "WALLETCACHE: Rebuilding the cache\n");
+            if (pPropertyIds) pPropertyIds->insert(global_wallet_property_list.begin(), global_wallet_property_list.end());
+            walletBalancesCache.clear();
+            global_balance_money.clear();
+            global_balance_reserved.clear();
+            // the identifiers of the addresses are assigned again, when the balances are cleared
+            vAddressOwnership.clear();
+            fRebuildCache = false;
+            vModified.clear();
+            for (uint32_t id = 0; id < mp_tally_map.size(); ++id) {
+                vModified.push_back(id);
             }
         }
     }
-    if (msc_debug_walletcache) PrintToLog("WALLETCACHE: Update finished - there were %d changes\n", numChanges);
+
+    // the addresses are examined in chunks, and addresses modified in the meantime are tracked
+    // and examined by the next update, so the scan continues instead of starting over
+    size_t nNext = 0;
+    ScanStateInChunks([&]() EXCLUSIVE_LOCKS_REQUIRED(cs_tally) {
+        if (mp_tally_map.GetClearCount() != nClears) {
+            // the identifiers refer to other addresses now, so the next update rebuilds the cache
+            fRebuildCache = true;
+            return false;
+        }
+        const size_t nEnd = std::min(vModified.size(), nNext + STATE_SCAN_CHUNK_SIZE);
+        for (; nNext < nEnd; ++nNext) {
+            numChanges += UpdateCachedAddress(vModified[nNext], pPropertyIds);
+        }
+        return nNext < vModified.size();
+    }, nullptr);
+
+    PrintToLogVerbose(msc_debug_walletcache, "WALLETCACHE: Update finished - there were %d changes\n", numChanges);
     return numChanges;
 }
 
+/**
+ * Returns the cached wallet addresses, as of the last update.
+ *
+ * Addresses stay cached, once their balances are zero, so this includes all wallet addresses,
+ * which ever held or traded tokens.
+ */
+std::vector<std::string> WalletCacheGetAddresses()
+{
+    std::vector<std::string> vAddresses;
+
+    LOCK(cs_tally);
+    vAddresses.reserve(walletBalancesCache.size());
+    for (const auto& entry : walletBalancesCache) {
+        vAddresses.push_back(entry.first);
+    }
+    return vAddresses;
+}
+
+/**
+ * Returns the cached wallet addresses, which hold the property, as of the last update.
+ */
+std::vector<std::pair<std::string, CMPTally> > WalletCacheGetTallies(uint32_t propertyId)
+{
+    std::vector<std::pair<std::string, CMPTally> > vTallies;
+
+    LOCK(cs_tally);
+    for (const auto& entry : walletBalancesCache) {
+        const CMPTally& tally = entry.second.tally;
+        if (std::find(tally.begin(), tally.end(), propertyId) == tally.end()) continue;
+        vTallies.emplace_back(entry.first, tally);
+    }
+    return vTallies;
+}
 
+/**
+ * Discards the cache and the wallet totals, which are rebuilt from all addresses by the next update.
+ */
+void WalletCacheReset()
+{
+    LOCK(cs_tally);
+    walletBalancesCache.clear();
+    global_balance_money.clear();
+    global_balance_reserved.clear();
+    global_wallet_property_list.clear();
+    vAddressOwnership.clear();
+    fRebuildCache = true;
+}
 } // namespace mastercore
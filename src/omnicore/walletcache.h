@@ -1,14 +1,28 @@
 #ifndef BITCOIN_OMNICORE_WALLETCACHE_H
 #define BITCOIN_OMNICORE_WALLETCACHE_H
 
+class CMPTally;
 class uint256;
 
+#include <stdint.h>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace mastercore
 {
-/** Updates the cache and returns whether any wallet addresses were changed */
-int WalletCacheUpdate();
+/** Updates the cache and the wallet totals, and returns the number of wallet addresses, which were changed */
+int WalletCacheUpdate(std::set<uint32_t>* pPropertyIds = nullptr);
+
+/** Returns the cached wallet addresses, including watch-only addresses, which have a tally */
+std::vector<std::string> WalletCacheGetAddresses();
+
+/** Returns the cached wallet addresses, including watch-only addresses, which hold the property, with their tallies */
+std::vector<std::pair<std::string, CMPTally> > WalletCacheGetTallies(uint32_t propertyId);
+
+/** Discards the cache and the wallet totals, which are rebuilt by the next update */
+void WalletCacheReset();
 }
 
 #endif // BITCOIN_OMNICORE_WALLETCACHE_H
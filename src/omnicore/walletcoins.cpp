@@ -0,0 +1,201 @@
+/**
+ * @file walletcoins.cpp
+ *
+ * Provides an index of the wallet transactions by the addresses they pay to, so the
+ * outputs of the sender can be selected without visiting every wallet transaction.
+ */
+
+#include <omnicore/walletcoins.h>
+
+#include <interfaces/handler.h>
+#include <interfaces/wallet.h>
+#include <key_io.h>
+#include <primitives/transaction.h>
+#include <script/standard.h>
+#include <sync.h>
+#include <ui_interface.h>
+#include <uint256.h>
+#ifdef ENABLE_WALLET
+#include <wallet/wallet.h>
+#endif
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mastercore
+{
+#ifdef ENABLE_WALLET
+/**
+ * Index of the transactions of a wallet, by the addresses of their outputs.
+ *
+ * The wallet notifies about new, updated and removed transactions. The notifications are
+ * only queued, as they are sent while the wallet is locked, and the transactions are read,
+ * once the index is used. Spent outputs stay in the index, so the coin selection still has
+ * to check, whether an output is available.
+ */
+class CWalletAddressCoins
+{
+private:
+    Mutex m_queue_mutex;
+    //! Wallet transactions, which were added or updated (true) or removed (false) since the last update
+    std::vector<std::pair<uint256, bool> > m_queue GUARDED_BY(m_queue_mutex);
+    //! Whether the wallet was unloaded, and the index can't be used anymore
+    bool m_fUnloaded GUARDED_BY(m_queue_mutex) = false;
+
+    Mutex m_index_mutex;
+    //! Wallet transactions by the addresses of their outputs, ordered like the wallet
+    std::map<std::string, std::set<uint256> > m_addressTxids GUARDED_BY(m_index_mutex);
+    //! Addresses of the outputs of the indexed transactions
+    std::map<uint256, std::vector<std::string> > m_txidAddresses GUARDED_BY(m_index_mutex);
+
+    std::unique_ptr<interfaces::Handler> m_handlerTransactionChanged;
+    std::unique_ptr<interfaces::Handler> m_handlerUnload;
+
+    /** Removes a transaction from the index. */
+    void Remove(const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(m_index_mutex)
+    {
+        std::map<uint256, std::vector<std::string> >::iterator it = m_txidAddresses.find(txid);
+        if (it == m_txidAddresses.end()) return;
+        for (const std::string& address : it->second) {
+            std::map<std::string, std::set<uint256> >::iterator itAddress = m_addressTxids.find(address);
+            if (itAddress == m_addressTxids.end()) continue;
+            itAddress->second.erase(txid);
+            if (itAddress->second.empty()) m_addressTxids.erase(itAddress);
+        }
+        m_txidAddresses.erase(it);
+    }
+
+    /** Adds a transaction to the index, under the addresses of its outputs. */
+    void Add(const CTransaction& tx) EXCLUSIVE_LOCKS_REQUIRED(m_index_mutex)
+    {
+        const uint256& txid = tx.GetHash();
+        if (m_txidAddresses.count(txid)) return; // the outputs of a transaction never change
+
+        std::vector<std::string>& vAddresses = m_txidAddresses[txid];
+        for (const CTxOut& txOut : tx.vout) {
+            CTxDestination dest;
+            if (!ExtractDestination(txOut.scriptPubKey, dest)) continue;
+            std::string address = EncodeDestination(dest);
+            if (m_addressTxids[address].insert(txid).second) {
+                vAddresses.push_back(std::move(address));
+            }
+        }
+    }
+
+public:
+    /** Registers the index for the notifications of the wallet. */
+    explicit CWalletAddressCoins(interfaces::Wallet& iWallet)
+    {
+        m_handlerTransactionChanged = iWallet.handleTransactionChanged([this](const uint256& txid, ChangeType status) {
+            LOCK(m_queue_mutex);
+            m_queue.emplace_back(txid, status != CT_DELETED);
+        });
+        m_handlerUnload = iWallet.handleUnload([this]() {
+            LOCK(m_queue_mutex);
+            m_fUnloaded = true;
+        });
+
+        // the wallet transactions are only copied once, and indexed right away
+        std::vector<interfaces::WalletTx> transactions = iWallet.getWalletTxs();
+        LOCK(m_index_mutex);
+        for (const interfaces::WalletTx& transaction : transactions) {
+            Add(*transaction.tx);
+        }
+    }
+
+    ~CWalletAddressCoins()
+    {
+        m_handlerTransactionChanged->disconnect();
+        m_handlerUnload->disconnect();
+    }
+
+    /** Returns whether the wallet was unloaded. */
+    bool IsUnloaded()
+    {
+        LOCK(m_queue_mutex);
+        return m_fUnloaded;
+    }
+
+    /** Indexes the transactions, which were added or removed since the last call, and retrieves the ones of an address. */
+    void Get(interfaces::Wallet& iWallet, const std::string& address, std::vector<uint256>& vTxids)
+    {
+        std::vector<std::pair<uint256, bool> > vQueue;
+        {
+            LOCK(m_queue_mutex);
+            vQueue.swap(m_queue);
+        }
+
+        // the wallet is locked to read the transactions, so this is done without holding the index lock
+        std::vector<std::pair<uint256, CTransactionRef> > vChanged;
+        vChanged.reserve(vQueue.size());
+        for (const std::pair<uint256, bool>& entry : vQueue) {
+            vChanged.emplace_back(entry.first, entry.second ? iWallet.getTx(entry.first) : nullptr);
+        }
+
+        LOCK(m_index_mutex);
+        for (const std::pair<uint256, CTransactionRef>& entry : vChanged) {
+            if (!entry.second) {
+                Remove(entry.first);
+                continue;
+            }
+            // updates of known transactions, such as confirmations, don't change the outputs
+            Add(*entry.second);
+        }
+
+        std::map<std::string, std::set<uint256> >::const_iterator it = m_addressTxids.find(address);
+        if (it != m_addressTxids.end()) {
+            vTxids.assign(it->second.begin(), it->second.end());
+        }
+    }
+};
+
+static Mutex cs_wallet_coins;
+//! Indexes of the wallet transactions by wallet name
+static std::map<std::string, std::shared_ptr<CWalletAddressCoins> > mapWalletCoins GUARDED_BY(cs_wallet_coins);
+
+/** Returns the index of a wallet, which is created on first use, and again after the wallet was unloaded. */
+static std::shared_ptr<CWalletAddressCoins> GetWalletAddressCoins(interfaces::Wallet& iWallet)
+{
+    const std::string name = iWallet.getWalletName();
+    {
+        LOCK(cs_wallet_coins);
+        std::map<std::string, std::shared_ptr<CWalletAddressCoins> >::const_iterator it = mapWalletCoins.find(name);
+        if (it != mapWalletCoins.end() && !it->second->IsUnloaded()) return it->second;
+    }
+
+    // the wallet is locked to copy its transactions, so this is done without holding a lock
+    std::shared_ptr<CWalletAddressCoins> index = std::make_shared<CWalletAddressCoins>(iWallet);
+
+    LOCK(cs_wallet_coins);
+    std::shared_ptr<CWalletAddressCoins>& entry = mapWalletCoins[name];
+    if (!entry || entry->IsUnloaded()) entry = index;
+    return entry;
+}
+#endif
+
+/**
+ * Retrieves the wallet transactions with outputs to an address, in the order of the wallet.
+ */
+bool GetAddressTransactions(interfaces::Wallet& iWallet, const std::string& address, std::vector<uint256>& vTxids)
+{
+    vTxids.clear();
+#ifdef ENABLE_WALLET
+    if (!HasWallets()) {
+        return false;
+    }
+
+    std::shared_ptr<CWalletAddressCoins> index = GetWalletAddressCoins(iWallet);
+    if (index->IsUnloaded()) {
+        return false;
+    }
+    index->Get(iWallet, address, vTxids);
+    return true;
+#else
+    return false;
+#endif
+}
+} // namespace mastercore
@@ -0,0 +1,25 @@
+#ifndef BITCOIN_OMNICORE_WALLETCOINS_H
+#define BITCOIN_OMNICORE_WALLETCOINS_H
+
+class uint256;
+
+namespace interfaces {
+class Wallet;
+} // namespace interfaces
+
+#include <string>
+#include <vector>
+
+namespace mastercore
+{
+/**
+ * Retrieves the wallet transactions with outputs to an address, in the order of the wallet.
+ *
+ * The transactions are taken from an index, which is maintained with the transaction notifications of
+ * the wallet. The outputs may already be spent. Returns false, if the wallet is not loaded, in which
+ * case it must be searched instead.
+ */
+bool GetAddressTransactions(interfaces::Wallet& iWallet, const std::string& address, std::vector<uint256>& vTxids);
+}
+
+#endif // BITCOIN_OMNICORE_WALLETCOINS_H
@@ -3,116 +3,301 @@
  *
  * The fetch functions provide a sorted list of transaction hashes ordered by block,
  * position in block and position in wallet including STO receipts.
+ *
+ * The Omni transactions of each wallet are kept in an index, which is updated
+ * incrementally, so only the blocks and wallet transactions, which are new since
+ * the last call, are visited.
  */
 
 #include <omnicore/walletfetchtxs.h>
 
 #include <omnicore/dbstolist.h>
+#include <omnicore/dbtransaction.h>
 #include <omnicore/dbtxlist.h>
 #include <omnicore/log.h>
 #include <omnicore/omnicore.h>
 #include <omnicore/pending.h>
+#include <omnicore/tx.h>
 #include <omnicore/utilsbitcoin.h>
 
+#include <chain.h>
 #include <init.h>
+#include <key_io.h>
+#include <interfaces/handler.h>
 #include <interfaces/wallet.h>
+#include <ui_interface.h>
 #include <validation.h>
 #include <sync.h>
 #include <tinyformat.h>
-#include <index/txindex.h>
 #ifdef ENABLE_WALLET
 #include <wallet/wallet.h>
 #endif
 
-#include <boost/algorithm/string.hpp>
-
+#include <atomic>
 #include <stdint.h>
-#include <list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 namespace mastercore
 {
+#ifdef ENABLE_WALLET
+//! Source of the revisions of the indexes, so revisions are never reused, even after an index is replaced
+static std::atomic<uint64_t> nLastIndexRevision{0};
+
 /**
- * Gets the byte offset of a transaction from the transaction index.
+ * Index of the Omni transactions of a wallet, ordered by block and position in block.
+ *
+ * The index is fed from two sides: the wallet notifies about new and removed transactions,
+ * which are looked up in the transaction list database, and the blocks processed since the
+ * last update are read from the height index of the database, to find the transactions,
+ * which were added to the wallet before they were processed, and the STO receipts.
+ *
+ * The notifications are only queued, as they are sent while the wallet is locked. Receipts
+ * of addresses, which are added to the wallet later, are found, once the wallet is loaded
+ * again.
+ *
+ * The STO receipts of earlier blocks are looked up by the addresses, which received outputs
+ * of the wallet transactions, so loading the index scales with the size of the wallet, and
+ * not with the number of STO recipients. Every address, which held tokens, received such an
+ * output, either as reference of a transfer, or to fund its own transactions.
  */
-static unsigned int GetTransactionByteOffset(const uint256& txid)
+class CWalletOmniTxIndex
 {
-    LOCK(cs_main);
+private:
+    Mutex m_queue_mutex;
+    //! Wallet transactions, which were added (true) or removed (false) since the last update
+    std::vector<std::pair<uint256, bool> > m_queue GUARDED_BY(m_queue_mutex);
+    //! Whether the wallet was unloaded, and the index can't be used anymore
+    bool m_fUnloaded GUARDED_BY(m_queue_mutex) = false;
+    //! Addresses of the wallet, which received outputs of the wallet transactions, when the index was created
+    std::set<std::string> m_walletAddresses GUARDED_BY(m_queue_mutex);
+
+    //! Transactions of the wallet
+    std::set<uint256> m_walletTxids GUARDED_BY(cs_tally);
+    //! Omni transactions of the wallet and STO receipts, by block, position in block and txid
+    std::set<std::tuple<int, uint32_t, uint256> > m_ordered GUARDED_BY(cs_tally);
+    //! Block and position of the indexed transactions
+    std::map<uint256, std::pair<int, uint32_t> > m_positions GUARDED_BY(cs_tally);
+    //! Height and hash of the last block, whose transactions were indexed, or -1, if the index is new
+    int m_nScanned GUARDED_BY(cs_tally) = -1;
+    uint256 m_hashScanned GUARDED_BY(cs_tally);
+    //! Changes, whenever transactions of blocks, which were already indexed, are added or removed
+    uint64_t m_nRevision GUARDED_BY(cs_tally);
+
+    std::unique_ptr<interfaces::Handler> m_handlerTransactionChanged;
+    std::unique_ptr<interfaces::Handler> m_handlerUnload;
+
+    /** Adds a transaction of a block to the index. */
+    void Add(const uint256& txid, int block) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+    {
+        if (m_positions.count(txid)) return;
+        uint32_t position = pDbTransaction->FetchTransactionPosition(txid);
+        m_positions.emplace(txid, std::make_pair(block, position));
+        m_ordered.emplace(block, position, txid);
+    }
+
+    /** Removes a transaction from the index. */
+    void Remove(const uint256& txid) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+    {
+        std::map<uint256, std::pair<int, uint32_t> >::iterator it = m_positions.find(txid);
+        if (it == m_positions.end()) return;
+        m_ordered.erase(std::make_tuple(it->second.first, it->second.second, txid));
+        m_positions.erase(it);
+        m_nRevision = ++nLastIndexRevision;
+    }
+
+    /** Removes the transactions above a block, which are indexed again, if they are still in the chain. */
+    void RemoveAbove(int block) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+    {
+        std::set<std::tuple<int, uint32_t, uint256> >::iterator it = m_ordered.lower_bound(std::make_tuple(block + 1, 0, uint256()));
+        if (it == m_ordered.end()) return;
+        for (std::set<std::tuple<int, uint32_t, uint256> >::iterator itRemove = it; itRemove != m_ordered.end(); ++itRemove) {
+            m_positions.erase(std::get<2>(*itRemove));
+        }
+        m_ordered.erase(it, m_ordered.end());
+        m_nRevision = ++nLastIndexRevision;
+    }
+
+    /** Adds the wallet transactions and STO receipts, which are already in the database. */
+    void Load() EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_tally)
+    {
+        std::set<std::string> setAddresses;
+        {
+            LOCK(m_queue_mutex);
+            setAddresses.swap(m_walletAddresses);
+        }
+        for (const std::string& address : setAddresses) {
+            for (const std::pair<uint256, int>& receipt : pDbStoList->GetAddressReceipts(address)) {
+                Add(receipt.first, receipt.second);
+            }
+        }
+
+        m_nScanned = ::ChainActive().Height();
+        m_hashScanned = ::ChainActive().Tip() ? ::ChainActive().Tip()->GetBlockHash() : uint256();
+    }
+
+    /** Indexes the wallet transactions and STO receipts of the blocks, which were processed since the last update. */
+    void ScanBlocks(interfaces::Wallet& iWallet) EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_tally)
+    {
+        // the transactions of disconnected blocks are removed first
+        const CBlockIndex* pScanned = GetBlockIndex(m_hashScanned);
+        if (pScanned == nullptr || !::ChainActive().Contains(pScanned)) {
+            const CBlockIndex* pFork = pScanned ? ::ChainActive().FindFork(pScanned) : nullptr;
+            m_nScanned = pFork ? pFork->nHeight : -1;
+            RemoveAbove(m_nScanned);
+        }
+
+        const int nHeight = ::ChainActive().Height();
+        if (nHeight > m_nScanned) {
+            for (const CMPTxList::BlockTx& tx : pDbTransactionList->GetTxsInBlockRange(m_nScanned + 1, nHeight)) {
+                if (m_walletTxids.count(tx.txid) ||
+                        (tx.type == MSC_TYPE_SEND_TO_OWNERS && pDbStoList->HasReceiptInWallet(tx.txid, iWallet))) {
+                    Add(tx.txid, tx.block);
+                }
+            }
+        }
+        m_nScanned = nHeight;
+        m_hashScanned = ::ChainActive().Tip() ? ::ChainActive().Tip()->GetBlockHash() : uint256();
+    }
+
+public:
+    /** Registers the index for the notifications of the wallet. */
+    explicit CWalletOmniTxIndex(interfaces::Wallet& iWallet) : m_nRevision(++nLastIndexRevision)
+    {
+        m_handlerTransactionChanged = iWallet.handleTransactionChanged([this](const uint256& txid, ChangeType status) {
+            LOCK(m_queue_mutex);
+            m_queue.emplace_back(txid, status != CT_DELETED);
+        });
+        m_handlerUnload = iWallet.handleUnload([this]() {
+            LOCK(m_queue_mutex);
+            m_fUnloaded = true;
+        });
+
+        // the wallet transactions are only copied once, and handled like notifications
+        std::vector<interfaces::WalletTx> transactions = iWallet.getWalletTxs();
+        LOCK(m_queue_mutex);
+        for (const interfaces::WalletTx& transaction : transactions) {
+            m_queue.emplace_back(transaction.tx->GetHash(), true);
+            for (size_t n = 0; n < transaction.txout_address.size(); ++n) {
+                if (transaction.txout_address_is_mine[n] == ISMINE_NO) continue;
+                if (!IsValidDestination(transaction.txout_address[n])) continue;
+                m_walletAddresses.insert(EncodeDestination(transaction.txout_address[n]));
+            }
+        }
+    }
+
+    ~CWalletOmniTxIndex()
+    {
+        m_handlerTransactionChanged->disconnect();
+        m_handlerUnload->disconnect();
+    }
+
+    /** Returns whether the wallet was unloaded. */
+    bool IsUnloaded()
+    {
+        LOCK(m_queue_mutex);
+        return m_fUnloaded;
+    }
+
+    /** Brings the index up to date with the wallet and the processed blocks. */
+    void Update(interfaces::Wallet& iWallet) EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_tally)
+    {
+        if (m_nScanned < 0) {
+            Load();
+        } else {
+            ScanBlocks(iWallet);
+        }
+
+        std::vector<std::pair<uint256, bool> > vQueue;
+        {
+            LOCK(m_queue_mutex);
+            vQueue.swap(m_queue);
+        }
+        for (const std::pair<uint256, bool>& entry : vQueue) {
+            const uint256& txid = entry.first;
+            if (!entry.second) {
+                m_walletTxids.erase(txid);
+                Remove(txid);
+                continue;
+            }
+            m_walletTxids.insert(txid);
+            // transactions, which are not yet processed, are found by the next scan
+            int block = -1;
+            pDbTransactionList->getValidMPTX(txid, &block);
+            if (block >= 0 && block <= m_nScanned && !m_positions.count(txid)) {
+                Add(txid, block);
+                m_nRevision = ++nLastIndexRevision;
+            }
+        }
+    }
+
+    /** Returns the revision, which changes, whenever transactions of blocks, which were already indexed, are added or removed. */
+    uint64_t GetRevision() const EXCLUSIVE_LOCKS_REQUIRED(cs_tally) { return m_nRevision; }
+
+    /** Retrieves the last transactions in the given block range. */
+    void GetLast(size_t count, int startBlock, int endBlock, std::map<std::string, uint256>& mapResponse) EXCLUSIVE_LOCKS_REQUIRED(cs_tally)
+    {
+        std::set<std::tuple<int, uint32_t, uint256> >::const_iterator itBegin = m_ordered.lower_bound(std::make_tuple(startBlock, 0, uint256()));
+        std::set<std::tuple<int, uint32_t, uint256> >::const_iterator it = m_ordered.lower_bound(std::make_tuple(endBlock + 1, 0, uint256()));
+        while (it != itBegin && mapResponse.size() < count) {
+            --it;
+            std::string sortKey = strprintf("%06d%010d%s", std::get<0>(*it), std::get<1>(*it), std::get<2>(*it).GetHex());
+            mapResponse.insert(std::make_pair(sortKey, std::get<2>(*it)));
+        }
+    }
+};
+
+static Mutex cs_wallet_indexes;
+//! Indexes of the Omni transactions by wallet name
+static std::map<std::string, std::shared_ptr<CWalletOmniTxIndex> > mapWalletIndexes GUARDED_BY(cs_wallet_indexes);
 
-    if (g_txindex) {
-        return g_txindex->ReadTxPos(txid);
+/** Returns the index of a wallet, which is created on first use, and again after the wallet was unloaded. */
+static std::shared_ptr<CWalletOmniTxIndex> GetWalletOmniTxIndex(interfaces::Wallet& iWallet)
+{
+    const std::string name = iWallet.getWalletName();
+    {
+        LOCK(cs_wallet_indexes);
+        std::map<std::string, std::shared_ptr<CWalletOmniTxIndex> >::const_iterator it = mapWalletIndexes.find(name);
+        if (it != mapWalletIndexes.end() && !it->second->IsUnloaded()) return it->second;
     }
 
-    return 0;
+    // the wallet is locked to copy its transactions, so this is done without holding a lock
+    std::shared_ptr<CWalletOmniTxIndex> index = std::make_shared<CWalletOmniTxIndex>(iWallet);
+
+    LOCK(cs_wallet_indexes);
+    std::shared_ptr<CWalletOmniTxIndex>& entry = mapWalletIndexes[name];
+    if (!entry || entry->IsUnloaded()) entry = index;
+    return entry;
 }
+#endif
 
 /**
  * Returns an ordered list of Omni transactions including STO receipts that are relevant to the wallet.
  *
  * Ignores order in the wallet (which can be skewed by watch addresses) and utilizes block height and position within block.
+ *
+ * Callers, which only fetch the blocks since their last call, can compare the revision of the index
+ * to detect, whether transactions of earlier blocks were added or removed in the meantime.
  */
-std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& iWallet, unsigned int count, int startBlock, int endBlock)
+std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& iWallet, unsigned int count, int startBlock, int endBlock, uint64_t* pRevision)
 {
     std::map<std::string, uint256> mapResponse;
 #ifdef ENABLE_WALLET
     if (!HasWallets()) {
         return mapResponse;
     }
-    std::set<uint256> seenHashes;
-    std::multimap<int64_t, const interfaces::WalletTx*> txOrdered;
-    const std::vector<interfaces::WalletTx>& transactions = iWallet.getWalletTxs();
-    for (const auto& transaction : transactions)
-        txOrdered.insert(std::make_pair(transaction.order_pos, &transaction));
-
-    // Iterate backwards through wallet transactions until we have count items to return:
-    for (std::multimap<int64_t, const interfaces::WalletTx*>::reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it) {
-        const interfaces::WalletTx* pwtx = it->second;
-        const uint256& txHash = pwtx->tx->GetHash();
-        {
-            LOCK(cs_tally);
-            if (!pDbTransactionList->exists(txHash)) continue;
-        }
-        const uint256& blockHash = pwtx->hash_block;
-        if (blockHash.IsNull()) continue;
-        const CBlockIndex* pBlockIndex = GetBlockIndex(blockHash);
-        if (pBlockIndex == nullptr) continue;
-        int blockHeight = pBlockIndex->nHeight;
-        if (blockHeight < startBlock || blockHeight > endBlock) continue;
-        int blockPosition = GetTransactionByteOffset(txHash);
-        std::string sortKey = strprintf("%06d%010d", blockHeight, blockPosition);
-        mapResponse.insert(std::make_pair(sortKey, txHash));
-        seenHashes.insert(txHash);
-        if (mapResponse.size() >= count) break;
-    }
 
-    // Insert STO receipts - receiving an STO has no inbound transaction to the wallet, so we will insert these manually into the response
-    std::string mySTOReceipts;
+    std::shared_ptr<CWalletOmniTxIndex> index = GetWalletOmniTxIndex(iWallet);
     {
-        LOCK(cs_tally);
-        mySTOReceipts = pDbStoList->getMySTOReceipts("", iWallet);
-    }
-    std::vector<std::string> vecReceipts;
-    if (!mySTOReceipts.empty()) {
-        boost::split(vecReceipts, mySTOReceipts, boost::is_any_of(","), boost::token_compress_on);
-    }
-    for (size_t i = 0; i < vecReceipts.size(); i++) {
-        std::vector<std::string> svstr;
-        boost::split(svstr, vecReceipts[i], boost::is_any_of(":"), boost::token_compress_on);
-        if (svstr.size() != 4) {
-            PrintToLog("STODB Error - number of tokens is not as expected (%s)\n", vecReceipts[i]);
-            continue;
-        }
-        int blockHeight = atoi(svstr[1]);
-        if (blockHeight < startBlock || blockHeight > endBlock) continue;
-        uint256 txHash = uint256S(svstr[0]);
-        if (seenHashes.find(txHash) != seenHashes.end()) continue; // an STO may already be in the wallet if we sent it
-        int blockPosition = GetTransactionByteOffset(txHash);
-        std::string sortKey = strprintf("%06d%010d", blockHeight, blockPosition);
-        mapResponse.insert(std::make_pair(sortKey, txHash));
+        LOCK2(cs_main, cs_tally);
+        index->Update(iWallet);
+        index->GetLast(count, startBlock, endBlock, mapResponse);
+        if (pRevision) *pRevision = index->GetRevision();
     }
 
     // Insert pending transactions (sets block as 999999 and position as wallet position)
@@ -122,12 +307,7 @@ std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& i
         const uint256& txHash = it->first;
         int blockHeight = 999999;
         if (blockHeight < startBlock || blockHeight > endBlock) continue;
-        int blockPosition = 0;
-        {
-            for (const auto& transaction : transactions)
-                if (transaction.tx->GetHash() == txHash)
-                    blockPosition = transaction.order_pos;
-        }
+        int64_t blockPosition = iWallet.getWalletTx(txHash).order_pos;
         std::string sortKey = strprintf("%06d%010d", blockHeight, blockPosition);
         mapResponse.insert(std::make_pair(sortKey, txHash));
     }
@@ -135,5 +315,29 @@ std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& i
     return mapResponse;
 }
 
+/**
+ * Replaces the Omni transaction index of the wallet with a freshly loaded one.
+ *
+ * Used after a rescan, which can add transactions and addresses to the wallet, whose STO
+ * receipts are otherwise only found, once the wallet is loaded again.
+ */
+void ReloadWalletOmniTransactions(interfaces::Wallet& iWallet)
+{
+#ifdef ENABLE_WALLET
+    if (!HasWallets()) {
+        return;
+    }
+
+    // the wallet is locked to copy its transactions, so this is done without holding a lock
+    std::shared_ptr<CWalletOmniTxIndex> index = std::make_shared<CWalletOmniTxIndex>(iWallet);
+    {
+        LOCK2(cs_main, cs_tally);
+        index->Update(iWallet);
+    }
+
+    LOCK(cs_wallet_indexes);
+    mapWalletIndexes[iWallet.getWalletName()] = index;
+#endif
+}
 
 } // namespace mastercore
@@ -9,12 +9,21 @@ class Wallet;
 } // namespace interfaces
 
 #include <map>
+#include <stdint.h>
 #include <string>
 
 namespace mastercore
 {
-/** Returns an ordered list of Omni transactions that are relevant to the wallet. */
-std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& iWallet, unsigned int count, int startBlock = 0, int endBlock = 999999);
+/**
+ * Returns an ordered list of Omni transactions that are relevant to the wallet.
+ *
+ * The revision of the index is stored in pRevision, if given. It changes, whenever transactions
+ * of blocks, which were already indexed, are added or removed, including reorganizations.
+ */
+std::map<std::string, uint256> FetchWalletOmniTransactions(interfaces::Wallet& iWallet, unsigned int count, int startBlock = 0, int endBlock = 999999, uint64_t* pRevision = nullptr);
+
+/** Rebuilds the index of the Omni transactions of the wallet, in one pass over the processed blocks. */
+void ReloadWalletOmniTransactions(interfaces::Wallet& iWallet);
 }
 
 #endif // BITCOIN_OMNICORE_WALLETFETCHTXS_H
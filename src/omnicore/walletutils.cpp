@@ -5,6 +5,7 @@
 #include <omnicore/rules.h>
 #include <omnicore/script.h>
 #include <omnicore/utilsbitcoin.h>
+#include <omnicore/walletcoins.h>
 
 #include <amount.h>
 #include <base58.h>
@@ -29,6 +30,8 @@
 #include <algorithm>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace mastercore
 {
@@ -202,6 +205,34 @@ int64_t GetEconomicThreshold(interfaces::Wallet& iWallet, const CTxOut& txOut)
 }
 
 #ifdef ENABLE_WALLET
+/**
+ * Retrieves the wallet transactions, which may fund a transaction of the sender.
+ *
+ * Only the transactions with outputs to the sender are retrieved from the index of the
+ * wallet, or all wallet transactions, if the index is not available.
+ */
+static void GetSenderTransactions(interfaces::Wallet& iWallet, const std::string& fromAddress,
+        std::vector<interfaces::WalletTx>& transactions, std::map<uint256, interfaces::WalletTxStatus>& tx_status)
+{
+    std::vector<uint256> vTxids;
+    if (!GetAddressTransactions(iWallet, fromAddress, vTxids)) {
+        transactions = iWallet.getWalletTxsDetails(tx_status);
+        return;
+    }
+
+    transactions.reserve(vTxids.size());
+    for (const uint256& txid : vTxids) {
+        interfaces::WalletTxStatus status;
+        interfaces::WalletOrderForm orderForm;
+        bool fInMempool = false;
+        int nBlocks = 0;
+        interfaces::WalletTx wtx = iWallet.getWalletTxDetails(txid, status, orderForm, fInMempool, nBlocks);
+        if (!wtx.tx) continue; // removed from the wallet in the meantime
+        tx_status.emplace(txid, status);
+        transactions.push_back(std::move(wtx));
+    }
+}
+
 int64_t SelectCoins(interfaces::Wallet& iWallet, const std::string& fromAddress, CCoinControl& coinControl, int64_t amountRequired)
 {
     // total output funds collected
@@ -209,7 +240,8 @@ int64_t SelectCoins(interfaces::Wallet& iWallet, const std::string& fromAddress,
     int nHeight = ::ChainActive().Height();
 
     std::map<uint256, interfaces::WalletTxStatus> tx_status;
-    const std::vector<interfaces::WalletTx>& transactions = iWallet.getWalletTxsDetails(tx_status);
+    std::vector<interfaces::WalletTx> transactions;
+    GetSenderTransactions(iWallet, fromAddress, transactions, tx_status);
 
     // iterate over the wallet
     for (std::vector<interfaces::WalletTx>::const_iterator it = transactions.begin(); it != transactions.end(); ++it) {
@@ -282,7 +314,8 @@ int64_t SelectAllCoins(interfaces::Wallet& iWallet, const std::string& fromAddre
     int nHeight = ::ChainActive().Height();
 
     std::map<uint256, interfaces::WalletTxStatus> tx_status;
-    const std::vector<interfaces::WalletTx>& transactions = iWallet.getWalletTxsDetails(tx_status);
+    std::vector<interfaces::WalletTx> transactions;
+    GetSenderTransactions(iWallet, fromAddress, transactions, tx_status);
 
     // iterate over the wallet
     for (std::vector<interfaces::WalletTx>::const_iterator it = transactions.begin(); it != transactions.end(); ++it) {
@@ -316,7 +349,7 @@ int64_t SelectAllCoins(interfaces::Wallet& iWallet, const std::string& fromAddre
             }
 
             std::string sAddress = EncodeDestination(dest);
-            if (msc_debug_tokens) {
+            if (OMNI_VERBOSE_LOG && msc_debug_tokens) {
                 PrintToLog("%s: sender: %s, outpoint: %s:%d, value: %d\n", __func__, sAddress, txid.GetHex(), n, txOut.nValue);
             }
 
@@ -0,0 +1,220 @@
+/**
+ * @file workerpool.cpp
+ *
+ * This file contains a simple pool of worker threads, which are used to
+ * process independent tasks in parallel, such as decoding transactions.
+ *
+ * One pool is shared by all parallel tasks of Omni Core, and sized by the
+ * -omnithreads option.
+ */
+
+#include <omnicore/workerpool.h>
+
+#include <shutdown.h>
+#include <tinyformat.h>
+#include <util/system.h>
+#include <util/threadnames.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace mastercore
+{
+CWorkerPool::CWorkerPool(int nThreads, const std::string& strName)
+  : m_nThreads(std::max(0, nThreads)), m_fStop(false), m_fInterrupt(false)
+{
+    for (int i = 0; i < nThreads; ++i) {
+        std::string strThreadName = strprintf("%s.%d", strName, i);
+        m_threads.emplace_back([this, strThreadName] {
+            util::ThreadRename(std::string(strThreadName));
+            ThreadWork();
+        });
+    }
+}
+
+CWorkerPool::~CWorkerPool()
+{
+    Stop();
+}
+
+void CWorkerPool::Stop()
+{
+    m_fInterrupt = true;
+    m_nThreads = 0;
+    {
+        LOCK(m_mutex);
+        if (m_fStop) return;
+        m_fStop = true;
+    }
+    m_cvWorker.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+bool CWorkerPool::IsInterrupted() const
+{
+    return m_fInterrupt || ShutdownRequested();
+}
+
+/**
+ * Claims the next task of a batch, and skips the remaining tasks of an
+ * interruptible batch, once a shutdown was requested.
+ *
+ * @return False, if there are no more tasks to process
+ */
+bool CWorkerPool::NextTask(CBatch& batch, size_t& n)
+{
+    if (batch.nNext >= batch.nCount) return false;
+
+    if (batch.fInterruptible && IsInterrupted()) {
+        batch.fInterrupted = true;
+        batch.nDone += batch.nCount - batch.nNext;
+        batch.nNext = batch.nCount;
+        if (batch.nDone == batch.nCount) {
+            m_cvDone.notify_all();
+        }
+        return false;
+    }
+
+    n = batch.nNext++;
+    return true;
+}
+
+/**
+ * Waits for tasks of any batch and processes them, until the pool is stopped.
+ *
+ * The tasks of batches come first, because their callers wait for them.
+ */
+void CWorkerPool::ThreadWork()
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (true) {
+        CBatch* pBatch = nullptr;
+        size_t n = 0;
+        std::function<void()> fnPosted;
+        while (!m_fStop) {
+            for (CBatch* pCandidate : m_batches) {
+                if (pCandidate->nWorkers < pCandidate->nMaxWorkers && NextTask(*pCandidate, n)) {
+                    pBatch = pCandidate;
+                    break;
+                }
+            }
+            if (pBatch) break;
+            if (!m_posted.empty()) {
+                fnPosted.swap(m_posted.front());
+                m_posted.pop_front();
+                break;
+            }
+            m_cvWorker.wait(lock);
+        }
+        if (m_fStop) break;
+
+        if (fnPosted) {
+            REVERSE_LOCK(lock);
+            fnPosted();
+            continue;
+        }
+
+        ++pBatch->nWorkers;
+        {
+            REVERSE_LOCK(lock);
+            (*pBatch->pfnTask)(n);
+        }
+        --pBatch->nWorkers;
+        // the caller may return, once the last task is done
+        if (++pBatch->nDone == pBatch->nCount) {
+            m_cvDone.notify_all();
+        }
+    }
+}
+
+/**
+ * Queues the tasks for the worker threads and processes them with the calling thread.
+ */
+bool CWorkerPool::Run(size_t nCount, const std::function<void(size_t)>& fn, int nMaxThreads, bool fInterruptible)
+{
+    if (Size() == 0 || nCount < 2 || nMaxThreads == 1) {
+        for (size_t n = 0; n < nCount; ++n) {
+            if (fInterruptible && IsInterrupted()) return false;
+            fn(n);
+        }
+        return true;
+    }
+
+    CBatch batch;
+    batch.pfnTask = &fn;
+    batch.nCount = nCount;
+    batch.nNext = 0;
+    batch.nDone = 0;
+    batch.nMaxWorkers = (nMaxThreads > 0) ? nMaxThreads - 1 : nCount;
+    batch.nWorkers = 0;
+    batch.fInterruptible = fInterruptible;
+    batch.fInterrupted = false;
+
+    WAIT_LOCK(m_mutex, lock);
+    m_batches.push_back(&batch);
+    m_cvWorker.notify_all();
+
+    size_t n = 0;
+    while (NextTask(batch, n)) {
+        {
+            REVERSE_LOCK(lock);
+            fn(n);
+        }
+        ++batch.nDone;
+    }
+    while (batch.nDone < batch.nCount) {
+        m_cvDone.wait(lock);
+    }
+    m_batches.remove(&batch);
+
+    return !batch.fInterrupted;
+}
+
+void CWorkerPool::Post(const std::function<void()>& task)
+{
+    {
+        LOCK(m_mutex);
+        if (!m_fStop && Size() > 0) {
+            m_posted.push_back(task);
+            m_cvWorker.notify_one();
+            return;
+        }
+    }
+    task();
+}
+
+void CWorkerPool::ForEach(size_t nCount, const std::function<void(size_t)>& fn, int nMaxThreads)
+{
+    Run(nCount, fn, nMaxThreads, false);
+}
+
+bool CWorkerPool::ForEachInterruptible(size_t nCount, const std::function<void(size_t)>& fn, int nMaxThreads)
+{
+    return Run(nCount, fn, nMaxThreads, true);
+}
+
+static Mutex cs_workerPool;
+static std::unique_ptr<CWorkerPool> g_workerPool GUARDED_BY(cs_workerPool);
+
+CWorkerPool& GetWorkerPool()
+{
+    LOCK(cs_workerPool);
+    if (!g_workerPool) {
+        // the calling threads participate, so one thread less than requested is started
+        int nThreads = gArgs.GetArg("-omnithreads", DEFAULT_OMNI_THREADS);
+        if (nThreads <= 0) nThreads = GetNumCores();
+        g_workerPool.reset(new CWorkerPool(nThreads - 1, "omniwork"));
+    }
+    return *g_workerPool;
+}
+
+void StopWorkerPool()
+{
+    LOCK(cs_workerPool);
+    if (g_workerPool) {
+        g_workerPool->Stop();
+    }
+}
+}
@@ -0,0 +1,131 @@
+#ifndef BITCOIN_OMNICORE_WORKERPOOL_H
+#define BITCOIN_OMNICORE_WORKERPOOL_H
+
+#include <sync.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <stddef.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Default number of threads of the shared pool (0 = one per core). */
+static const int DEFAULT_OMNI_THREADS = 0;
+
+namespace mastercore
+{
+/**
+ * A fixed set of worker threads to process independent tasks.
+ *
+ * Every call of ForEach() queues a batch of tasks. The calling thread processes
+ * the tasks of its own batch, while idle worker threads take over the remaining
+ * tasks of any queued batch. The pool can therefore be shared by several threads,
+ * and tasks may use the pool themselves.
+ *
+ * Single tasks can also be posted to run in the background, once no worker
+ * thread is needed for the tasks of a batch.
+ *
+ * A pool without any worker threads simply runs all tasks serially.
+ */
+class CWorkerPool
+{
+private:
+    /** Tasks of one call of ForEach(), which live on the stack of the caller. */
+    struct CBatch
+    {
+        const std::function<void(size_t)>* pfnTask;
+        //! Number of tasks of the batch
+        size_t nCount;
+        //! Index of the next task to be processed
+        size_t nNext;
+        //! Number of tasks completed or skipped
+        size_t nDone;
+        //! Maximal number of worker threads processing tasks of the batch at the same time
+        size_t nMaxWorkers;
+        //! Number of worker threads processing tasks of the batch
+        size_t nWorkers;
+        //! Whether the remaining tasks are skipped, once a shutdown is requested
+        bool fInterruptible;
+        bool fInterrupted;
+    };
+
+    Mutex m_mutex;
+    std::condition_variable m_cvWorker;
+    std::condition_variable m_cvDone;
+    std::vector<std::thread> m_threads;
+    //! Number of worker threads, which is zero, once the pool is stopped
+    std::atomic<size_t> m_nThreads;
+    //! Batches with tasks, in the order of their calls
+    std::list<CBatch*> m_batches GUARDED_BY(m_mutex);
+    //! Background tasks, in the order they were posted
+    std::deque<std::function<void()> > m_posted GUARDED_BY(m_mutex);
+    bool m_fStop GUARDED_BY(m_mutex);
+    std::atomic<bool> m_fInterrupt;
+
+    void ThreadWork();
+    bool IsInterrupted() const;
+    bool NextTask(CBatch& batch, size_t& n) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    bool Run(size_t nCount, const std::function<void(size_t)>& fn, int nMaxThreads, bool fInterruptible);
+
+public:
+    CWorkerPool(int nThreads, const std::string& strName);
+    ~CWorkerPool();
+
+    /** Returns the number of worker threads. */
+    size_t Size() const { return m_nThreads; }
+
+    /**
+     * Calls fn(i) for every i in [0, nCount) and waits until all calls returned.
+     *
+     * At most nMaxThreads threads, including the calling thread, process the
+     * tasks at the same time, or all worker threads, if nMaxThreads is zero.
+     */
+    void ForEach(size_t nCount, const std::function<void(size_t)>& fn, int nMaxThreads = 0);
+
+    /**
+     * Like ForEach(), but skips the remaining calls, once a shutdown is requested
+     * or the pool is stopped, and returns false, if any call was skipped.
+     */
+    bool ForEachInterruptible(size_t nCount, const std::function<void(size_t)>& fn, int nMaxThreads = 0);
+
+    /**
+     * Calls fn(i) for every i in [0, nCount) and returns the results in the order of i.
+     *
+     * The results must not be bool, because the elements of std::vector<bool>
+     * can't be written by several threads.
+     */
+    template <typename T>
+    std::vector<T> Map(size_t nCount, const std::function<T(size_t)>& fn, int nMaxThreads = 0)
+    {
+        std::vector<T> vResults(nCount);
+        ForEach(nCount, [&](size_t n) { vResults[n] = fn(n); }, nMaxThreads);
+        return vResults;
+    }
+
+    /**
+     * Runs a task in the background, after the tasks posted earlier were started.
+     *
+     * The task runs on the calling thread, if the pool has no worker threads, and
+     * tasks, which were not started, when the pool is stopped, are dropped.
+     */
+    void Post(const std::function<void()>& task);
+
+    /**
+     * Skips the remaining tasks of interruptible batches, and waits for the worker
+     * threads to finish their current task, after which all tasks run serially.
+     */
+    void Stop();
+};
+
+/** Returns the pool shared by the parallel tasks of Omni Core, which is created on first use. */
+CWorkerPool& GetWorkerPool();
+
+/** Stops the worker threads of the shared pool. */
+void StopWorkerPool();
+}
+
+#endif // BITCOIN_OMNICORE_WORKERPOOL_H
@@ -10,6 +10,7 @@
 #include <omnicore/omnicore.h>
 #include <omnicore/sp.h>
 #include <omnicore/tally.h>
+#include <omnicore/walletcache.h>
 #include <omnicore/walletutils.h>
 
 #include <amount.h>
@@ -20,8 +21,11 @@
 
 #include <stdint.h>
 #include <map>
+#include <set>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <QAbstractItemView>
 #include <QAction>
@@ -129,7 +133,7 @@ void BalancesDialog::setClientModel(ClientModel *model)
 {
     this->clientModel = model;
     if (model != nullptr) {
-        connect(model, &ClientModel::refreshOmniBalance, this, &BalancesDialog::balancesUpdated);
+        connect(model, &ClientModel::refreshOmniProperties, this, &BalancesDialog::balancesChanged);
         connect(model, &ClientModel::reinitOmniState, this, &BalancesDialog::reinitOmni);
     }
 }
@@ -164,9 +168,9 @@ void BalancesDialog::UpdatePropSelector()
     if (propIdx != -1) { ui->propSelectorWidget->setCurrentIndex(propIdx); }
 }
 
-void BalancesDialog::AddRow(const std::string& label, const std::string& address, const std::string& reserved, const std::string& available)
+void BalancesDialog::AddRow(const std::string& label, const std::string& address, const std::string& reserved, const std::string& available, int row)
 {
-    int workingRow = ui->balancesTable->rowCount();
+    int workingRow = (row < 0) ? ui->balancesTable->rowCount() : row;
     ui->balancesTable->insertRow(workingRow);
     QTableWidgetItem *labelCell = new QTableWidgetItem(QString::fromStdString(label));
     QTableWidgetItem *addressCell = new QTableWidgetItem(QString::fromStdString(address));
@@ -206,21 +210,11 @@ void BalancesDialog::PopulateBalances(unsigned int propertyId)
         ui->balancesTable->setHorizontalHeaderItem(1, new QTableWidgetItem("Address"));
         bool propertyIsDivisible = isPropertyDivisible(propertyId); // only fetch the SP once, not for every address
 
-        // iterate mp_tally_map looking for addresses that hold a balance in propertyId
-        for(std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-            const std::string& address = my_it->first;
-            CMPTally& tally = my_it->second;
-            tally.init();
-
-            uint32_t id;
-            bool watchAddress = false, includeAddress = false;
-            while (0 != (id = (tally.next()))) {
-                if (id == propertyId) {
-                    includeAddress = true;
-                    break;
-                }
-            }
-            if (!includeAddress) continue; //ignore this address, has never transacted in this propertyId
+        // only the wallet addresses, which hold a balance in propertyId, are listed, as cached by the wallet cache
+        for (const auto& entry : WalletCacheGetTallies(propertyId)) {
+            const std::string& address = entry.first;
+            const CMPTally& tally = entry.second;
+            bool watchAddress = false;
 
             // obtain the balances for the address directly form tally
             int64_t available = tally.getMoney(propertyId, BALANCE);
@@ -255,6 +249,32 @@ void BalancesDialog::PopulateBalances(unsigned int propertyId)
     }
 }
 
+/**
+ * Updates the wallet totals of a property in the summary, or inserts them in order of the property identifiers.
+ */
+void BalancesDialog::UpdateSummaryRow(uint32_t propertyId)
+{
+    std::string available, reserved;
+    {
+        LOCK(cs_tally);
+        if (!global_wallet_property_list.count(propertyId)) return;
+        available = FormatMP(propertyId, global_balance_money[propertyId]);
+        reserved = FormatMP(propertyId, global_balance_reserved[propertyId]);
+    }
+
+    int row = 0;
+    for (; row < ui->balancesTable->rowCount(); ++row) {
+        uint32_t rowPropertyId = ui->balancesTable->item(row, 0)->text().toUInt();
+        if (rowPropertyId == propertyId) {
+            ui->balancesTable->item(row, 2)->setText(QString::fromStdString(reserved));
+            ui->balancesTable->item(row, 3)->setText(QString::fromStdString(available));
+            return;
+        }
+        if (rowPropertyId > propertyId) break;
+    }
+    AddRow(strprintf("%d", propertyId), getPropertyName(propertyId), reserved, available, row);
+}
+
 void BalancesDialog::propSelectorChanged()
 {
     QString spId = ui->propSelectorWidget->itemData(ui->propSelectorWidget->currentIndex()).toString();
@@ -303,6 +323,25 @@ void BalancesDialog::balancesUpdated()
     propSelectorChanged(); // refresh the table with the currently selected property ID
 }
 
+/**
+ * Refreshes only the rows of the properties, whose wallet balances changed.
+ *
+ * The summary updates the totals of the changed properties in place, and a single
+ * property is only listed again, if it changed.
+ */
+void BalancesDialog::balancesChanged(const std::set<uint32_t>& propertyIds)
+{
+    UpdatePropSelector();
+    unsigned int selectedId = ui->propSelectorWidget->itemData(ui->propSelectorWidget->currentIndex()).toString().toUInt();
+    if (selectedId == 2147483646) {
+        for (uint32_t propertyId : propertyIds) {
+            UpdateSummaryRow(propertyId);
+        }
+    } else if (propertyIds.count(selectedId)) {
+        PopulateBalances(selectedId);
+    }
+}
+
 // We override the virtual resizeEvent of the QWidget to adjust tables column
 // sizes as the tables width is proportional to the dialogs width.
 void BalancesDialog::resizeEvent(QResizeEvent* event)
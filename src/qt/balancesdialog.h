@@ -9,6 +9,10 @@
 
 #include <QDialog>
 
+#include <set>
+#include <stdint.h>
+#include <string>
+
 class ClientModel;
 class WalletModel;
 
@@ -34,8 +38,9 @@ public:
 
     void setClientModel(ClientModel *model);
     void setWalletModel(WalletModel *model);
-    void AddRow(const std::string& label, const std::string& address, const std::string& reserved, const std::string& available);
+    void AddRow(const std::string& label, const std::string& address, const std::string& reserved, const std::string& available, int row = -1);
     void PopulateBalances(unsigned int propertyId);
+    void UpdateSummaryRow(uint32_t propertyId);
     void UpdatePropSelector();
 
 private:
@@ -51,6 +56,7 @@ private:
 public Q_SLOTS:
     void propSelectorChanged();
     void balancesUpdated();
+    void balancesChanged(const std::set<uint32_t>& propertyIds);
     void reinitOmni();
 
 private Q_SLOTS:
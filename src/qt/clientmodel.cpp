@@ -19,6 +19,7 @@
 #include <stdint.h>
 
 #include <QDebug>
+#include <QMutexLocker>
 #include <QThread>
 #include <QTimer>
 
@@ -139,9 +140,35 @@ bool ClientModel::tryLockOmniBalanceChanged()
     return true;
 }
 
+void ClientModel::addOmniChangedProperties(const std::set<uint32_t>& propertyIds)
+{
+    QMutexLocker locker(&omniChangesMutex);
+    omniChangedProperties.insert(propertyIds.begin(), propertyIds.end());
+}
+
+void ClientModel::addOmniChangedPairs(const std::set<std::pair<uint32_t, uint32_t> >& pairs)
+{
+    QMutexLocker locker(&omniChangesMutex);
+    omniChangedPairs.insert(pairs.begin(), pairs.end());
+}
+
+void ClientModel::emitOmniChanges()
+{
+    std::set<uint32_t> propertyIds;
+    std::set<std::pair<uint32_t, uint32_t> > pairs;
+    {
+        QMutexLocker locker(&omniChangesMutex);
+        propertyIds.swap(omniChangedProperties);
+        pairs.swap(omniChangedPairs);
+    }
+    if (!pairs.empty()) Q_EMIT refreshOmniPairs(pairs);
+    if (!propertyIds.empty()) Q_EMIT refreshOmniProperties(propertyIds);
+}
+
 void ClientModel::updateOmniState()
 {
     lockedOmniStateChanged = false;
+    emitOmniChanges();
     Q_EMIT refreshOmniState();
 }
 
@@ -153,6 +180,7 @@ void ClientModel::updateOmniPending(bool pending)
 void ClientModel::updateOmniBalance()
 {
     lockedOmniBalanceChanged = false;
+    emitOmniChanges();
     Q_EMIT refreshOmniBalance();
 }
 
@@ -317,9 +345,10 @@ static void OmniPendingChanged(ClientModel *clientmodel, bool pending)
                               Q_ARG(bool, pending));
 }
 
-static void OmniBalanceChanged(ClientModel *clientmodel)
+static void OmniBalanceChanged(ClientModel *clientmodel, const std::set<uint32_t>& propertyIds)
 {
-    // Triggered when a balance for a wallet address changes
+    // Triggered when a balance for a wallet address changes, the properties are collected until the next refresh
+    clientmodel->addOmniChangedProperties(propertyIds);
     if (clientmodel->tryLockOmniBalanceChanged()) {
         QMetaObject::invokeMethod(clientmodel, "updateOmniBalance", Qt::QueuedConnection);
     }
@@ -331,6 +360,12 @@ static void OmniStateInvalidated(ClientModel *clientmodel)
     QMetaObject::invokeMethod(clientmodel, "invalidateOmniState", Qt::QueuedConnection);
 }
 
+static void OmniMetaDExPairsChanged(ClientModel *clientmodel, const std::set<std::pair<uint32_t, uint32_t> >& pairs)
+{
+    // Always followed by a state or balance change, which refreshes the pairs along with it
+    clientmodel->addOmniChangedPairs(pairs);
+}
+
 void ClientModel::subscribeToCoreSignals()
 {
     // Connect signals to client
@@ -345,8 +380,9 @@ void ClientModel::subscribeToCoreSignals()
     // Connect Omni signals
     m_handler_omni_state_changed = m_node.handleOmniStateChanged(std::bind(OmniStateChanged, this));
     m_handler_omni_pending_changed = m_node.handleOmniPendingChanged(std::bind(OmniPendingChanged, this, std::placeholders::_1));
-    m_handler_omni_balance_changed = m_node.handleOmniBalanceChanged(std::bind(OmniBalanceChanged, this));
+    m_handler_omni_balance_changed = m_node.handleOmniBalanceChanged(std::bind(OmniBalanceChanged, this, std::placeholders::_1));
     m_handler_omni_state_invalidated = m_node.handleOmniStateInvalidated(std::bind(OmniStateInvalidated, this));
+    m_handler_omni_metadex_pairs_changed = m_node.handleOmniMetaDExPairsChanged(std::bind(OmniMetaDExPairsChanged, this, std::placeholders::_1));
 }
 
 void ClientModel::unsubscribeFromCoreSignals()
@@ -365,6 +401,7 @@ void ClientModel::unsubscribeFromCoreSignals()
     m_handler_omni_pending_changed->disconnect();
     m_handler_omni_balance_changed->disconnect();
     m_handler_omni_state_invalidated->disconnect();
+    m_handler_omni_metadex_pairs_changed->disconnect();
 }
 
 bool ClientModel::getProxyInfo(std::string& ip_port) const
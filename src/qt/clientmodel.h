@@ -7,9 +7,13 @@
 
 #include <QObject>
 #include <QDateTime>
+#include <QMutex>
 
 #include <atomic>
 #include <memory>
+#include <set>
+#include <stdint.h>
+#include <utility>
 
 class BanTableModel;
 class OptionsModel;
@@ -77,6 +81,10 @@ public:
     bool tryLockOmniStateChanged();
     bool tryLockOmniBalanceChanged();
 
+    // Collect the changed Omni properties and MetaDEx pairs until the next refresh
+    void addOmniChangedProperties(const std::set<uint32_t>& propertyIds);
+    void addOmniChangedPairs(const std::set<std::pair<uint32_t, uint32_t> >& pairs);
+
     // caches for the best header
     mutable std::atomic<int> cachedBestHeaderHeight;
     mutable std::atomic<int64_t> cachedBestHeaderTime;
@@ -94,6 +102,7 @@ private:
     std::unique_ptr<interfaces::Handler> m_handler_omni_pending_changed;
     std::unique_ptr<interfaces::Handler> m_handler_omni_balance_changed;
     std::unique_ptr<interfaces::Handler> m_handler_omni_state_invalidated;
+    std::unique_ptr<interfaces::Handler> m_handler_omni_metadex_pairs_changed;
     OptionsModel *optionsModel;
     PeerTableModel *peerTableModel;
     BanTableModel *banTableModel;
@@ -103,11 +112,17 @@ private:
 
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
+    void emitOmniChanges();
 
     // Locks for Omni state changes
     bool lockedOmniStateChanged;
     bool lockedOmniBalanceChanged;
 
+    // Omni changes, which are coalesced until the next refresh
+    QMutex omniChangesMutex;
+    std::set<uint32_t> omniChangedProperties;
+    std::set<std::pair<uint32_t, uint32_t> > omniChangedPairs;
+
 Q_SIGNALS:
     void numConnectionsChanged(int count);
     void numBlocksChanged(int count, const QDateTime& blockDate, double nVerificationProgress, bool header);
@@ -121,6 +136,9 @@ Q_SIGNALS:
     void refreshOmniPending(bool pending);
     void refreshOmniBalance();
     void reinitOmniState();
+    // Emitted before refreshOmniState() or refreshOmniBalance() with the changes since the last refresh
+    void refreshOmniProperties(const std::set<uint32_t>& propertyIds);
+    void refreshOmniPairs(const std::set<std::pair<uint32_t, uint32_t> >& pairs);
 
     //! Fired when a message should be reported to the user
     void message(const QString &title, const QString &message, unsigned int style);
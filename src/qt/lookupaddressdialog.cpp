@@ -10,15 +10,19 @@
 
 #include <omnicore/omnicore.h>
 #include <omnicore/sp.h>
+#include <omnicore/tally.h>
 #include <omnicore/walletutils.h>
 
 #include <base58.h>
 #include <key_io.h>
+#include <sync.h>
 #include <wallet/ismine.h>
 
 #include <stdint.h>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <QAction>
 #include <QClipboard>
@@ -187,56 +191,36 @@ void LookupAddressDialog::searchAddress()
         }
         #endif
 
-        //scrappy way to do this, find a more efficient way of interacting with labels
-        //show first 10 SPs with balances - needs to be converted to listwidget or something
-        unsigned int propertyId;
-        unsigned int lastFoundPropertyIdMainEco = 1;
-        unsigned int lastFoundPropertyIdTestEco = 1;
+        // show the first 10 properties with available balances, main ecosystem first - needs to be converted to listwidget or something
+        // the properties are read from the tally of the address at once, instead of probing every property identifier
+        std::vector<std::pair<uint32_t, int64_t> > vBalances;
+        {
+            LOCK(cs_tally);
+            const CMPTally* tally = mp_tally_map.Get(searchText);
+            if (tally != nullptr) {
+                for (uint32_t propertyId : *tally) {
+                    if (propertyId == OMNI_PROPERTY_MSC) continue; // shown as the balance of the address
+                    int64_t available = tally->getMoneyAvailable(propertyId);
+                    if (available > 0) vBalances.emplace_back(propertyId, available);
+                    if (vBalances.size() > 10) break; // one more than shown, to tell whether there are further properties
+                }
+            }
+        }
         std::string pName[12]; // TODO: enough slots?
         uint64_t pBal[12];
         bool pDivisible[12];
         bool pFound[12];
         unsigned int pItem;
-        bool foundProperty = false;
         for (pItem = 1; pItem < 12; pItem++)
         {
-            pFound[pItem] = false;
-            for (propertyId = lastFoundPropertyIdMainEco+1; propertyId<10000; propertyId++)
-            {
-                foundProperty=false;
-                if (GetAvailableTokenBalance(searchText, propertyId) > 0)
-                {
-                    lastFoundPropertyIdMainEco = propertyId;
-                    foundProperty=true;
-                    pName[pItem] = getPropertyName(propertyId).c_str();
-                    if(pName[pItem].size()>32) pName[pItem]=pName[pItem].substr(0,32)+"...";
-                    pName[pItem] += strprintf(" (#%d)", propertyId);
-                    pBal[pItem] = GetAvailableTokenBalance(searchText, propertyId);
-                    pDivisible[pItem] = isPropertyDivisible(propertyId);
-                    pFound[pItem] = true;
-                    break;
-                }
-            }
-
-            // have we found a property in main eco?  If not let's try test eco
-            if (!foundProperty)
-            {
-                for (propertyId = lastFoundPropertyIdTestEco+1; propertyId<10000; propertyId++)
-                {
-                    if (GetAvailableTokenBalance(searchText, propertyId+2147483647) > 0)
-                    {
-                        lastFoundPropertyIdTestEco = propertyId;
-                        foundProperty=true;
-                        pName[pItem] = getPropertyName(propertyId+2147483647).c_str();
-                        if(pName[pItem].size()>32) pName[pItem]=pName[pItem].substr(0,32)+"...";
-                        pName[pItem] += strprintf(" (#%d)", propertyId+2147483647);
-                        pBal[pItem] = GetAvailableTokenBalance(searchText, propertyId+2147483647);
-                        pDivisible[pItem] = isPropertyDivisible(propertyId+2147483647);
-                        pFound[pItem] = true;
-                        break;
-                    }
-                }
-            }
+            pFound[pItem] = pItem <= vBalances.size();
+            if (!pFound[pItem]) continue;
+            uint32_t propertyId = vBalances[pItem-1].first;
+            pName[pItem] = getPropertyName(propertyId).c_str();
+            if(pName[pItem].size()>32) pName[pItem]=pName[pItem].substr(0,32)+"...";
+            pName[pItem] += strprintf(" (#%d)", propertyId);
+            pBal[pItem] = vBalances[pItem-1].second;
+            pDivisible[pItem] = isPropertyDivisible(propertyId);
         }
 
         // set balance info
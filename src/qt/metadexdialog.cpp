@@ -23,6 +23,7 @@
 #include <omnicore/tally.h>
 #include <omnicore/uint256_extensions.h>
 #include <omnicore/utilsbitcoin.h>
+#include <omnicore/walletcache.h>
 #include <omnicore/wallettxbuilder.h>
 #include <omnicore/walletutils.h>
 
@@ -37,8 +38,10 @@
 
 #include <stdint.h>
 #include <map>
+#include <set>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <QAbstractItemView>
@@ -117,8 +120,10 @@ void MetaDExDialog::setClientModel(ClientModel *model)
 {
     this->clientModel = model;
     if (nullptr != model) {
-        connect(model, &ClientModel::refreshOmniState, this, &MetaDExDialog::UpdateOffers);
-        connect(model, &ClientModel::refreshOmniBalance, this, &MetaDExDialog::BalanceOrderRefresh);
+        // only the changed pairs and properties are refreshed, the fee warning of the address with every balance change
+        connect(model, &ClientModel::refreshOmniPairs, this, &MetaDExDialog::PairsChanged);
+        connect(model, &ClientModel::refreshOmniProperties, this, &MetaDExDialog::PropertiesChanged);
+        connect(model, &ClientModel::refreshOmniBalance, this, &MetaDExDialog::UpdateBalance);
         connect(model, &ClientModel::reinitOmniState, this, &MetaDExDialog::FullRefresh);
     }
 }
@@ -137,17 +142,11 @@ void MetaDExDialog::PopulateAddresses()
         uint32_t propertyId = GetPropForSale();
         QString currentSetAddress = ui->comboAddress->currentText();
         ui->comboAddress->clear();
-        for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-            std::string address = (my_it->first).c_str();
-            int isMyAddress = IsMyAddress(address, &walletModel->wallet());
-            uint32_t id;
-            (my_it->second).init();
-            while (0 != (id = (my_it->second).next())) {
-                if (id == propertyId) {
-                    if (!GetAvailableTokenBalance(address, propertyId)) continue; // ignore this address, has no available balance to spend
-                    if (isMyAddress) ui->comboAddress->addItem((my_it->first).c_str()); // only include wallet addresses
-                }
-            }
+        // only the wallet addresses, which hold the property, are examined, as cached by the wallet cache
+        for (const auto& entry : WalletCacheGetTallies(propertyId)) {
+            const std::string& address = entry.first;
+            if (!entry.second.getMoneyAvailable(propertyId)) continue; // ignore this address, has no available balance to spend
+            if (IsMyAddress(address, &walletModel->wallet())) ui->comboAddress->addItem(address.c_str()); // only include wallet addresses
         }
         int idx = ui->comboAddress->findText(currentSetAddress);
         if (idx != -1) { ui->comboAddress->setCurrentIndex(idx); }
@@ -164,8 +163,13 @@ void MetaDExDialog::UpdateProperties()
     ui->comboPairTokenA->clear();
     ui->comboPairTokenB->clear();
 
+    LOCK(cs_tally);
+
+    uint32_t lastPropertyId = 0;
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        uint32_t propertyId = my_it->first;
+        uint32_t propertyId = my_it->first.first;
+        if (propertyId == lastPropertyId) continue; // the pairs are ordered by the property for sale, add each property once
+        lastPropertyId = propertyId;
         if ((testEco && !isTestEcosystemProperty(propertyId)) || (!testEco && isTestEcosystemProperty(propertyId))) continue;
         std::string spName;
         spName = getPropertyName(propertyId).c_str();
@@ -348,8 +352,9 @@ void MetaDExDialog::UpdateOffers()
     bool divisSale = isPropertyDivisible(GetPropForSale());
     bool divisDes = isPropertyDivisible(GetPropDesired());
 
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        if ((my_it->first != GetPropForSale())) continue; // not the property we're looking for, don't waste any more work
+    // only the orders of the selected pair are listed, so the pair is looked up directly
+    md_PropertiesMap::iterator my_it = metadex.find(md_PropertyPair(GetPropForSale(), GetPropDesired()));
+    if (my_it != metadex.end()) {
         md_PricesMap & prices = my_it->second;
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) { // loop through the sell prices for the property
             std::string unitPriceStr;
@@ -453,6 +458,29 @@ void MetaDExDialog::BalanceOrderRefresh()
     UpdateOffers();
 }
 
+// Refreshes the sending addresses, if the wallet balances of the property for sale changed
+void MetaDExDialog::PropertiesChanged(const std::set<uint32_t>& propertyIds)
+{
+    if (propertyIds.count(GetPropForSale())) PopulateAddresses();
+}
+
+// Refreshes the offers, if orders of the selected pair changed, and the markets, if a property has its first orders
+void MetaDExDialog::PairsChanged(const std::set<std::pair<uint32_t, uint32_t> >& pairs)
+{
+    bool testEco = ui->chkTestEco->isChecked();
+    bool fNewProperty = false;
+    for (const auto& pair : pairs) {
+        if (isTestEcosystemProperty(pair.first) != testEco) continue; // not listed in the selected ecosystem
+        if (ui->comboPairTokenA->findData(QString::number(pair.first)) == -1) {
+            fNewProperty = true;
+            break;
+        }
+    }
+    if (fNewProperty) UpdateProperties();
+
+    if (pairs.count(md_PropertyPair(GetPropForSale(), GetPropDesired()))) UpdateOffers();
+}
+
 void MetaDExDialog::sendTrade()
 {
 //    int blockHeight = GetHeight();
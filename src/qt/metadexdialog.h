@@ -5,8 +5,10 @@
 #ifndef BITCOIN_QT_METADEXDIALOG_H
 #define BITCOIN_QT_METADEXDIALOG_H
 
+#include <set>
 #include <stdint.h>
 #include <string>
+#include <utility>
 
 #include <QDialog>
 
@@ -45,6 +47,8 @@ public Q_SLOTS:
     void UpdateBalance();
     void UpdateOffers();
     void BalanceOrderRefresh();
+    void PropertiesChanged(const std::set<uint32_t>& propertyIds);
+    void PairsChanged(const std::set<std::pair<uint32_t, uint32_t> >& pairs);
     void FullRefresh();
     void RecalcSellValues();
     void InvertPair();
@@ -193,12 +193,10 @@ void SendMPDialog::updateProperty()
     QString spId = ui->propertyComboBox->itemData(ui->propertyComboBox->currentIndex()).toString();
     uint32_t propertyId = spId.toUInt();
     LOCK(cs_tally);
-    for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-        std::string address = (my_it->first).c_str();
-        uint32_t id = 0;
+    for (const auto& entry : mp_tally_map) {
+        const std::string& address = entry.first;
         bool includeAddress=false;
-        (my_it->second).init();
-        while (0 != (id = (my_it->second).next())) {
+        for (uint32_t id : entry.second) {
             if(id == propertyId) { includeAddress=true; break; }
         }
         if (!includeAddress) continue; //ignore this address, has never transacted in this propertyId
@@ -25,7 +25,6 @@
 #include <omnicore/tx.h>
 #include <omnicore/utilsbitcoin.h>
 #include <omnicore/walletcache.h>
-#include <omnicore/walletfetchtxs.h>
 #include <omnicore/walletutils.h>
 
 #include <amount.h>
@@ -38,9 +37,9 @@
 #include <uint256.h>
 #include <wallet/wallet.h>
 
-#include <boost/algorithm/string.hpp>
 
 #include <stdint.h>
+#include <algorithm>
 #include <map>
 #include <sstream>
 #include <string>
@@ -55,6 +54,7 @@
 #include <QModelIndex>
 #include <QPoint>
 #include <QResizeEvent>
+#include <QScrollBar>
 #include <QSortFilterProxyModel>
 #include <QString>
 #include <QTableWidget>
@@ -67,11 +67,16 @@ using namespace mastercore;
 
 bool hideInactiveTrades = false;
 
+//! Number of wallet trades, which are loaded at once, and whenever the view is scrolled to the end
+static const size_t TRADE_HISTORY_PAGE_SIZE = 100;
+
 TradeHistoryDialog::TradeHistoryDialog(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::tradeHistoryDialog),
     clientModel(nullptr),
-    walletModel(nullptr)
+    walletModel(nullptr),
+    nTradesShown(TRADE_HISTORY_PAGE_SIZE),
+    nTradesAvailable(0)
 {
     // Setup the UI
     ui->setupUi(this);
@@ -129,6 +134,7 @@ TradeHistoryDialog::TradeHistoryDialog(QWidget *parent) :
     connect(ui->tradeHistoryTable, &QTableView::customContextMenuRequested, this, &TradeHistoryDialog::contextualMenu);
     connect(ui->tradeHistoryTable, &QTableView::doubleClicked, this, &TradeHistoryDialog::showDetails);
     connect(ui->hideInactiveTrades, &QCheckBox::stateChanged, this, &TradeHistoryDialog::RepopulateTradeHistoryTable);
+    connect(ui->tradeHistoryTable->verticalScrollBar(), &QScrollBar::valueChanged, this, &TradeHistoryDialog::tradeHistoryScrolled);
     connect(copyTxIDAction, &QAction::triggered, this, &TradeHistoryDialog::copyTxID);
     connect(showDetailsAction, &QAction::triggered, this, &TradeHistoryDialog::showDetails);
 }
@@ -142,6 +148,16 @@ void TradeHistoryDialog::ReinitTradeHistoryTable()
 {
     ui->tradeHistoryTable->setRowCount(0);
     tradeHistoryMap.clear();
+    nTradesShown = TRADE_HISTORY_PAGE_SIZE;
+    UpdateTradeHistoryTable();
+}
+
+// Loads the next page of older trades, once the view is scrolled to the end
+void TradeHistoryDialog::tradeHistoryScrolled(int value)
+{
+    if (value < ui->tradeHistoryTable->verticalScrollBar()->maximum()) return;
+    if (nTradesShown >= nTradesAvailable) return;
+    nTradesShown += TRADE_HISTORY_PAGE_SIZE;
     UpdateTradeHistoryTable();
 }
 
@@ -309,26 +325,24 @@ int TradeHistoryDialog::PopulateTradeHistoryMap()
     // ### END PENDING TRANSACTIONS PROCESSING ###
 
     // ### START WALLET TRANSACTIONS PROCESSING ###
-    // obtain a sorted list of Omni layer wallet transactions (including STO receipts and pending) - default last 65535
-    std::map<std::string,uint256> walletTransactions;
-    if (walletModel)
-        walletTransactions = FetchWalletOmniTransactions(walletModel->wallet(), gArgs.GetArg("-omniuiwalletscope", 65535L));
+    // obtain the trades of the wallet addresses from the trade address index, without loading any transaction
+    std::vector<CMPAddressTrade> walletTrades;
+    if (walletModel) {
+        for (const std::string& address : WalletCacheGetAddresses()) {
+            pDbTradeList->getTradesForAddress(address, walletTrades);
+        }
+    }
 
-    // reverse iterate over (now ordered) transactions and populate history map for each one
-    for (std::map<std::string,uint256>::reverse_iterator it = walletTransactions.rbegin(); it != walletTransactions.rend(); it++) {
-        uint256 hash = it->second;
+    // only the newest trades are parsed, and older ones are loaded as the view is scrolled
+    std::sort(walletTrades.begin(), walletTrades.end(), [](const CMPAddressTrade& a, const CMPAddressTrade& b) {
+        return a.block != b.block ? a.block > b.block : a.blockIndex > b.blockIndex;
+    });
+    nTradesAvailable = walletTrades.size();
+    if (walletTrades.size() > nTradesShown) walletTrades.resize(nTradesShown);
 
-        // use levelDB to perform a fast check on whether it's a bitcoin or Omni tx and whether it's a trade
-        std::string tempStrValue;
-        {
-            LOCK(cs_tally);
-            if (!pDbTransactionList->getTX(hash, tempStrValue)) continue;
-        }
-        std::vector<std::string> vstr;
-        boost::split(vstr, tempStrValue, boost::is_any_of(":"), boost::token_compress_on);
-        if (vstr.size() > 2) {
-            if (atoi(vstr[2]) != MSC_TYPE_METADEX_TRADE) continue;
-        }
+    // iterate over the trades, newest first, and populate history map for each one
+    for (const CMPAddressTrade& trade : walletTrades) {
+        uint256 hash = trade.txid;
 
         // check historyMap, if this tx exists don't waste resources doing anymore work on it
         TradeHistoryMap::iterator hIter = tradeHistoryMap.find(hash);
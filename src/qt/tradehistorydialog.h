@@ -10,6 +10,8 @@
 
 #include <QDialog>
 
+#include <stddef.h>
+
 class WalletModel;
 class ClientModel;
 
@@ -62,6 +64,8 @@ private:
     WalletModel *walletModel;
     QMenu *contextMenu;
     TradeHistoryMap tradeHistoryMap;
+    size_t nTradesShown; // number of the newest wallet trades, which are loaded into tradeHistoryMap
+    size_t nTradesAvailable; // number of wallet trades listed by the trade address index
 
 public Q_SLOTS:
     void contextualMenu(const QPoint &point);
@@ -75,6 +79,7 @@ private Q_SLOTS:
     void UpdateTradeHistoryTable(bool forceUpdate = false);
     void RepopulateTradeHistoryTable(int hide);
     void ReinitTradeHistoryTable();
+    void tradeHistoryScrolled(int value);
 
 Q_SIGNALS:
     // Fired when a message should be reported to the user
@@ -39,6 +39,7 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <algorithm>
 #include <stdint.h>
 #include <list>
 #include <map>
@@ -66,7 +67,9 @@ TXHistoryDialog::TXHistoryDialog(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::txHistoryDialog),
     clientModel(nullptr),
-    walletModel(nullptr)
+    walletModel(nullptr),
+    nHistoryHeight(-1),
+    nHistoryRevision(0)
 {
     ui->setupUi(this);
     // setup
@@ -147,6 +150,7 @@ void TXHistoryDialog::ReinitTXHistoryTable()
 {
     ui->txHistoryTable->setRowCount(0);
     txHistoryMap.clear();
+    nHistoryHeight = -1;
     UpdateHistory();
 }
 
@@ -184,7 +188,7 @@ void TXHistoryDialog::setWalletModel(WalletModel *model)
     }
 }
 
-int TXHistoryDialog::PopulateHistoryMap()
+int TXHistoryDialog::PopulateHistoryMap(std::vector<uint256>& vNewTxids)
 {
     // TODO: locks may not be needed here -- looks like wallet lock can be removed
     //if (NULL == pwalletMain) return 0;
@@ -197,13 +201,24 @@ int TXHistoryDialog::PopulateHistoryMap()
     int64_t nProcessed = 0; // counter for how many transactions we've added to history this time
 
     // obtain a sorted list of Omni layer wallet transactions (including STO receipts and pending) - default last 65535
+    // only the blocks since the last update are fetched, unless transactions of earlier blocks were added or removed meanwhile
     std::map<std::string,uint256> walletTransactions;
-    if (walletModel)
-        walletTransactions = FetchWalletOmniTransactions(walletModel->wallet(), gArgs.GetArg("-omniuiwalletscope", 65535L));
+    if (walletModel) {
+        const unsigned int nScope = gArgs.GetArg("-omniuiwalletscope", 65535L);
+        uint64_t nRevision = 0;
+        walletTransactions = FetchWalletOmniTransactions(walletModel->wallet(), nScope, std::max(nHistoryHeight, 0), 999999, &nRevision);
+        if (nHistoryHeight >= 0 && nRevision != nHistoryRevision) {
+            walletTransactions = FetchWalletOmniTransactions(walletModel->wallet(), nScope, 0, 999999, &nRevision);
+        }
+        nHistoryRevision = nRevision;
+    }
 
     // reverse iterate over (now ordered) transactions and populate history map for each one
     for (std::map<std::string,uint256>::reverse_iterator it = walletTransactions.rbegin(); it != walletTransactions.rend(); it++) {
         uint256 txHash = it->second;
+        // the sort key starts with the block and the position, pending transactions are in block 999999
+        const int keyBlock = it->first.length() >= 16 ? atoi(it->first.substr(0,6)) : 0;
+        if (keyBlock < 999999) nHistoryHeight = std::max(nHistoryHeight, keyBlock);
         // check historyMap, if this tx exists and isn't pending don't waste resources doing anymore work on it
         HistoryMap::iterator hIter = txHistoryMap.find(txHash);
         if (hIter != txHistoryMap.end()) { // the tx is in historyMap, if it's a confirmed transaction skip it
@@ -239,7 +254,7 @@ int TXHistoryDialog::PopulateHistoryMap()
             const CMPPending& pending = pending_it->second;
             HistoryTXObject htxo;
             htxo.blockHeight = 0;
-            if (it->first.length() == 16) htxo.blockByteOffset = atoi(it->first.substr(6)); // use wallet position from key in lieu of block position
+            if (it->first.length() >= 16) htxo.blockByteOffset = atoi(it->first.substr(6,10)); // use wallet position from key in lieu of block position
             htxo.valid = true; // all pending transactions are assumed to be valid prior to confirmation (wallet would not send them otherwise)
             htxo.address = pending.src;
             htxo.amount = "-" + FormatShortMP(pending.prop, pending.amount) + getTokenLabel(pending.prop);
@@ -249,7 +264,7 @@ int TXHistoryDialog::PopulateHistoryMap()
                 pending.type == MSC_TYPE_METADEX_CANCEL_ECOSYSTEM || pending.type == MSC_TYPE_SEND_ALL) {
                 htxo.amount = "N/A";
             }
-            txHistoryMap.insert(std::make_pair(txHash, htxo));
+            if (txHistoryMap.insert(std::make_pair(txHash, htxo)).second) vNewTxids.push_back(txHash);
             nProcessed++;
             continue;
         }
@@ -261,9 +276,9 @@ int TXHistoryDialog::PopulateHistoryMap()
         CMPTransaction mp_obj;
         int parseRC = ParseTransaction(*wtx, blockHeight, 0, mp_obj);
         HistoryTXObject htxo;
-        if (it->first.length() == 16) {
-            htxo.blockHeight = atoi(it->first.substr(0,6));
-            htxo.blockByteOffset = atoi(it->first.substr(6));
+        if (it->first.length() >= 16) {
+            htxo.blockHeight = keyBlock;
+            htxo.blockByteOffset = atoi(it->first.substr(6,10));
         }
 
         // positive RC means payment, potential DEx purchase
@@ -298,7 +313,7 @@ int TXHistoryDialog::PopulateHistoryMap()
             htxo.valid = true; // only valid DEx payments are recorded in txlistdb
             htxo.amount = (!bIsBuy ? "-" : "") + FormatDivisibleShortMP(total) + getTokenLabel(tmpPropertyId);
             htxo.fundsMoved = true;
-            txHistoryMap.insert(std::make_pair(txHash, htxo));
+            if (txHistoryMap.insert(std::make_pair(txHash, htxo)).second) vNewTxids.push_back(txHash);
             nProcessed++;
             continue;
         }
@@ -343,7 +358,7 @@ int TXHistoryDialog::PopulateHistoryMap()
             displayAmount = FormatShortMP(mp_obj.getProperty(), tmpAmount) + getTokenLabel(mp_obj.getProperty());
         }
         htxo.amount = displayAmount;
-        txHistoryMap.insert(std::make_pair(txHash, htxo));
+        if (txHistoryMap.insert(std::make_pair(txHash, htxo)).second) vNewTxids.push_back(txHash);
         nProcessed++;
     }
 
@@ -352,98 +367,84 @@ int TXHistoryDialog::PopulateHistoryMap()
 
 void TXHistoryDialog::UpdateConfirmations()
 {
+    // the icons are created once, and a row is only changed, when its icon changes, so settled transactions cost
+    // a comparison per block
+    static const QIcon icons[] = {
+        QIcon(":/icons/transaction_0"), QIcon(":/icons/transaction_1"), QIcon(":/icons/transaction_2"),
+        QIcon(":/icons/transaction_3"), QIcon(":/icons/transaction_4"), QIcon(":/icons/transaction_5"),
+        QIcon(":/icons/transaction_confirmed"), QIcon(":/icons/transaction_conflicted")
+    };
     int chainHeight = GetHeight(); // get the chain height
     int rowCount = ui->txHistoryTable->rowCount();
     for (int row = 0; row < rowCount; row++) {
+        QTableWidgetItem *iconCell = ui->txHistoryTable->item(row,2);
+        if (nullptr == iconCell) continue;
+        // the block is the start of the sort key, which is spoofed as 999999 for pending transactions
         int confirmations = 0;
-        bool valid = false;
-        uint256 txid;
-        txid.SetHex(ui->txHistoryTable->item(row,0)->text().toStdString());
-        // lookup transaction in the map and grab validity and blockheight details
-        HistoryMap::iterator hIter = txHistoryMap.find(txid);
-        if (hIter != txHistoryMap.end()) {
-            HistoryTXObject *temphtxo = &(hIter->second);
-            if (temphtxo->blockHeight>0) confirmations = (chainHeight+1) - temphtxo->blockHeight;
-            valid = temphtxo->valid;
-        }
-        int txBlockHeight = ui->txHistoryTable->item(row,1)->text().toInt();
-        if (txBlockHeight>0) confirmations = (chainHeight+1) - txBlockHeight;
+        int txBlockHeight = ui->txHistoryTable->item(row,1)->text().left(6).toInt();
+        if (txBlockHeight > 0 && txBlockHeight < 999999) confirmations = (chainHeight+1) - txBlockHeight;
         // setup the appropriate icon
-        QIcon ic = QIcon(":/icons/transaction_0");
-        switch(confirmations) {
-            case 1: ic = QIcon(":/icons/transaction_1"); break;
-            case 2: ic = QIcon(":/icons/transaction_2"); break;
-            case 3: ic = QIcon(":/icons/transaction_3"); break;
-            case 4: ic = QIcon(":/icons/transaction_4"); break;
-            case 5: ic = QIcon(":/icons/transaction_5"); break;
-        }
-        if (confirmations > 5) ic = QIcon(":/icons/transaction_confirmed");
-        if (!valid) ic = QIcon(":/icons/transaction_conflicted");
-        QTableWidgetItem *iconCell = new QTableWidgetItem;
-//        ic = platformStyle->SingleColorIcon(ic);
-        iconCell->setIcon(ic);
-        ui->txHistoryTable->setItem(row, 2, iconCell);
+        int icon = std::max(0, std::min(confirmations, 6));
+        if (!iconCell->data(Qt::UserRole + 1).toBool()) icon = 7;
+        if (iconCell->data(Qt::UserRole).toInt() == icon) continue;
+        iconCell->setData(Qt::UserRole, icon);
+        iconCell->setIcon(icons[icon]);
+    }
+}
+
+void TXHistoryDialog::AddHistoryRow(const uint256& txid, const HistoryTXObject& htxo)
+{
+    int workingRow = ui->txHistoryTable->rowCount();
+    ui->txHistoryTable->insertRow(workingRow); // append a new row (sorting will take care of ordering)
+    QDateTime txTime;
+    QTableWidgetItem *dateCell = new QTableWidgetItem;
+    if (htxo.blockHeight>0) {
+        LOCK(cs_main);
+        CBlockIndex* pBlkIdx = ::ChainActive()[htxo.blockHeight];
+        if (nullptr != pBlkIdx) txTime.setTime_t(pBlkIdx->GetBlockTime());
+        dateCell->setData(Qt::DisplayRole, txTime);
+    } else {
+        dateCell->setData(Qt::DisplayRole, QString::fromStdString("Unconfirmed"));
     }
+    QTableWidgetItem *typeCell = new QTableWidgetItem(QString::fromStdString(htxo.txType));
+    QTableWidgetItem *addressCell = new QTableWidgetItem(QString::fromStdString(htxo.address));
+    QTableWidgetItem *amountCell = new QTableWidgetItem(QString::fromStdString(htxo.amount));
+    QTableWidgetItem *iconCell = new QTableWidgetItem;
+    iconCell->setData(Qt::UserRole, -1); // no icon yet, set by UpdateConfirmations()
+    iconCell->setData(Qt::UserRole + 1, htxo.valid);
+    QTableWidgetItem *txidCell = new QTableWidgetItem(QString::fromStdString(txid.GetHex()));
+    std::string sortKey = strprintf("%06d%010d",htxo.blockHeight,htxo.blockByteOffset);
+    if(htxo.blockHeight == 0) sortKey = strprintf("%06d%010D",999999,htxo.blockByteOffset); // spoof the hidden value to ensure pending txs are sorted top
+    QTableWidgetItem *sortKeyCell = new QTableWidgetItem(QString::fromStdString(sortKey));
+    addressCell->setTextAlignment(Qt::AlignLeft + Qt::AlignVCenter);
+    addressCell->setForeground(QColor("#707070"));
+    amountCell->setTextAlignment(Qt::AlignRight + Qt::AlignVCenter);
+    amountCell->setForeground(QColor("#00AA00"));
+    if (htxo.amount.length() > 0) { // protect against an empty value
+        if (htxo.amount.substr(0,1) == "-") amountCell->setForeground(QColor("#EE0000")); // outbound
+    }
+    if (!htxo.fundsMoved) amountCell->setForeground(QColor("#404040"));
+    ui->txHistoryTable->setItem(workingRow, 0, txidCell);
+    ui->txHistoryTable->setItem(workingRow, 1, sortKeyCell);
+    ui->txHistoryTable->setItem(workingRow, 2, iconCell);
+    ui->txHistoryTable->setItem(workingRow, 3, dateCell);
+    ui->txHistoryTable->setItem(workingRow, 4, typeCell);
+    ui->txHistoryTable->setItem(workingRow, 5, addressCell);
+    ui->txHistoryTable->setItem(workingRow, 6, amountCell);
 }
 
 void TXHistoryDialog::UpdateHistory()
 {
-    // now moved to a new methodology where historical transactions are stored in a map in memory (effectively a cache) so we can compare our
-    // history table against the cache.  This allows us to avoid reparsing transactions repeatedly and provides a diff to modify the table without
-    // repopuplating all the rows top to bottom each refresh.
-
-    // first things first, call PopulateHistoryMap to add in any missing (ie new) transactions
-    int newTXCount = PopulateHistoryMap();
-    // were any transactions added?
-    if(newTXCount > 0) { // there are new transactions (or a pending shifted to confirmed), refresh the table adding any that are in the map but not in the table
+    // historical transactions are stored in a map in memory (effectively a cache), which is only fed with the transactions of
+    // the blocks since the last update.  Only the rows of new transactions (or a pending shifted to confirmed) are added to the
+    // table, so the existing rows are neither searched nor repopulated each refresh.
+    std::vector<uint256> vNewTxids;
+    PopulateHistoryMap(vNewTxids);
+    if (!vNewTxids.empty()) {
         ui->txHistoryTable->setSortingEnabled(false); // disable sorting temporarily while we update the table (leaving enabled gives unexpected results)
-        QAbstractItemModel* historyAbstractModel = ui->txHistoryTable->model(); // get a model to work with
-        for(HistoryMap::iterator it = txHistoryMap.begin(); it != txHistoryMap.end(); ++it) {
-            uint256 txid = it->first; // grab txid
-            // search the history table for this transaction, here we're going to use a filter proxy because it's a little quicker
-            QSortFilterProxyModel historyProxy;
-            historyProxy.setSourceModel(historyAbstractModel);
-            historyProxy.setFilterKeyColumn(0);
-            historyProxy.setFilterFixedString(QString::fromStdString(txid.GetHex()));
-            QModelIndex rowIndex = historyProxy.mapToSource(historyProxy.index(0,0));
-            if(!rowIndex.isValid()) { // this transaction doesn't exist in the history table, add it
-                HistoryTXObject htxo = it->second; // grab the tranaaction
-                int workingRow = ui->txHistoryTable->rowCount();
-                ui->txHistoryTable->insertRow(workingRow); // append a new row (sorting will take care of ordering)
-                QDateTime txTime;
-                QTableWidgetItem *dateCell = new QTableWidgetItem;
-                if (htxo.blockHeight>0) {
-                    LOCK(cs_main);
-                    CBlockIndex* pBlkIdx = ::ChainActive()[htxo.blockHeight];
-                    if (nullptr != pBlkIdx) txTime.setTime_t(pBlkIdx->GetBlockTime());
-                    dateCell->setData(Qt::DisplayRole, txTime);
-                } else {
-                    dateCell->setData(Qt::DisplayRole, QString::fromStdString("Unconfirmed"));
-                }
-                QTableWidgetItem *typeCell = new QTableWidgetItem(QString::fromStdString(htxo.txType));
-                QTableWidgetItem *addressCell = new QTableWidgetItem(QString::fromStdString(htxo.address));
-                QTableWidgetItem *amountCell = new QTableWidgetItem(QString::fromStdString(htxo.amount));
-                QTableWidgetItem *iconCell = new QTableWidgetItem;
-                QTableWidgetItem *txidCell = new QTableWidgetItem(QString::fromStdString(txid.GetHex()));
-                std::string sortKey = strprintf("%06d%010d",htxo.blockHeight,htxo.blockByteOffset);
-                if(htxo.blockHeight == 0) sortKey = strprintf("%06d%010D",999999,htxo.blockByteOffset); // spoof the hidden value to ensure pending txs are sorted top
-                QTableWidgetItem *sortKeyCell = new QTableWidgetItem(QString::fromStdString(sortKey));
-                addressCell->setTextAlignment(Qt::AlignLeft + Qt::AlignVCenter);
-                addressCell->setForeground(QColor("#707070"));
-                amountCell->setTextAlignment(Qt::AlignRight + Qt::AlignVCenter);
-                amountCell->setForeground(QColor("#00AA00"));
-                if (htxo.amount.length() > 0) { // protect against an empty value
-                    if (htxo.amount.substr(0,1) == "-") amountCell->setForeground(QColor("#EE0000")); // outbound
-                }
-                if (!htxo.fundsMoved) amountCell->setForeground(QColor("#404040"));
-                ui->txHistoryTable->setItem(workingRow, 0, txidCell);
-                ui->txHistoryTable->setItem(workingRow, 1, sortKeyCell);
-                ui->txHistoryTable->setItem(workingRow, 2, iconCell);
-                ui->txHistoryTable->setItem(workingRow, 3, dateCell);
-                ui->txHistoryTable->setItem(workingRow, 4, typeCell);
-                ui->txHistoryTable->setItem(workingRow, 5, addressCell);
-                ui->txHistoryTable->setItem(workingRow, 6, amountCell);
-            }
+        for (const uint256& txid : vNewTxids) {
+            HistoryMap::const_iterator it = txHistoryMap.find(txid);
+            if (it != txHistoryMap.end()) AddHistoryRow(txid, it->second);
         }
         ui->txHistoryTable->setSortingEnabled(true); // re-enable sorting
     }
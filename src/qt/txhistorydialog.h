@@ -9,6 +9,8 @@
 #include <uint256.h>
 
 #include <map>
+#include <stdint.h>
+#include <vector>
 
 #include <QDialog>
 
@@ -66,6 +68,11 @@ private:
     GUIUtil::TableViewLastColumnResizingFixer *borrowedColumnResizingFixer;
     QMenu *contextMenu;
     HistoryMap txHistoryMap;
+    int nHistoryHeight; // highest block, whose wallet transactions are in the history map, or -1
+    uint64_t nHistoryRevision; // revision of the wallet index, when the history map was last populated
+
+    int PopulateHistoryMap(std::vector<uint256>& vNewTxids);
+    void AddHistoryRow(const uint256& txid, const HistoryTXObject& htxo);
 
 private Q_SLOTS:
     void contextualMenu(const QPoint &point);
@@ -74,7 +81,6 @@ private Q_SLOTS:
     void copyAmount();
     void copyTxID();
     void UpdateHistory();
-    int PopulateHistoryMap();
     void UpdateConfirmations();
     void checkSort(int column);
 
@@ -9,6 +9,15 @@
 #include <httpserver.h>
 #include <index/txindex.h>
 #include <node/context.h>
+#include <omnicore/dbspinfo.h>
+#include <omnicore/dbtxlist.h>
+#include <omnicore/errors.h>
+#include <omnicore/mdex.h>
+#include <omnicore/omnicore.h>
+#include <omnicore/rpc.h>
+#include <omnicore/rpctxobject.h>
+#include <omnicore/snapshot.h>
+#include <omnicore/sp.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/blockchain.h>
@@ -26,6 +35,11 @@
 
 #include <univalue.h>
 
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
 
 enum class RetFormat {
@@ -646,6 +660,235 @@ static bool rest_blockhash_by_height(HTTPRequest* req,
     }
 }
 
+/** Returns the most recent Omni state snapshot, or replies with an error, if none is published. */
+static std::shared_ptr<const mastercore::CStateSnapshot> GetOmniSnapshot(HTTPRequest* req)
+{
+    std::shared_ptr<const mastercore::CStateSnapshot> snapshot = mastercore::GetStateSnapshot();
+    if (!snapshot) {
+        RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "Omni state snapshots are not available (see -omnirpcsnapshot)");
+    }
+    return snapshot;
+}
+
+static bool ParseOmniPropertyId(const std::string& str, uint32_t& propertyId)
+{
+    int64_t value = 0;
+    if (!ParseInt64(str, &value) || value < 1 || value > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+    propertyId = static_cast<uint32_t>(value);
+    return true;
+}
+
+static bool rest_omni_balance(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string address;
+    const RetFormat rf = ParseDataFormat(address, strURIPart);
+
+    std::shared_ptr<const mastercore::CStateSnapshot> snapshot = GetOmniSnapshot(req);
+    if (!snapshot)
+        return false;
+
+    const CMPTally* addressTally = snapshot->GetTally(address);
+    if (!addressTally)
+        return RESTERR(req, HTTP_NOT_FOUND, "Address not found: " + SanitizeString(address));
+
+    switch (rf) {
+    case RetFormat::BINARY: {
+        std::vector<uint32_t> vPropertyIds;
+        for (uint32_t propertyId : *addressTally) {
+            if (snapshot->GetProperty(propertyId)) vPropertyIds.push_back(propertyId);
+        }
+
+        CDataStream ssBalances(SER_NETWORK, PROTOCOL_VERSION);
+        WriteCompactSize(ssBalances, vPropertyIds.size());
+        for (uint32_t propertyId : vPropertyIds) {
+            ssBalances << propertyId;
+            ssBalances << snapshot->GetAvailableTokenBalance(address, propertyId);
+            ssBalances << snapshot->GetReservedTokenBalance(address, propertyId);
+            ssBalances << snapshot->GetFrozenTokenBalance(address, propertyId);
+        }
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ssBalances.str());
+        return true;
+    }
+    case RetFormat::JSON: {
+        UniValue balances(UniValue::VARR);
+        for (uint32_t propertyId : *addressTally) {
+            const mastercore::CStateSnapshot::PropertyInfo* pProperty = snapshot->GetProperty(propertyId);
+            if (!pProperty) continue;
+
+            UniValue balanceObj(UniValue::VOBJ);
+            balanceObj.pushKV("propertyid", (uint64_t) propertyId);
+            balanceObj.pushKV("name", pProperty->name);
+            if (BalanceToJSON(*snapshot, address, propertyId, balanceObj, pProperty->fDivisible)) {
+                balances.push_back(balanceObj);
+            }
+        }
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, balances.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .json)");
+    }
+    }
+}
+
+static bool rest_omni_property(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string idStr;
+    const RetFormat rf = ParseDataFormat(idStr, strURIPart);
+
+    uint32_t propertyId = 0;
+    if (!ParseOmniPropertyId(idStr, propertyId))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid property identifier: " + SanitizeString(idStr));
+
+    // the listings are kept in memory, so cs_tally is only held to take the current table
+    std::shared_ptr<const CMPSPInfo::ListingTable> listings;
+    {
+        LOCK(cs_tally);
+        listings = mastercore::pDbSpInfo->getListings();
+    }
+    auto it = listings->find(propertyId);
+    if (it == listings->end())
+        return RESTERR(req, HTTP_NOT_FOUND, "Property identifier does not exist: " + idStr);
+    const CMPSPInfo::Listing& sp = *it->second;
+
+    switch (rf) {
+    case RetFormat::BINARY: {
+        CDataStream ssProperty(SER_NETWORK, PROTOCOL_VERSION);
+        ssProperty << propertyId << sp.prop_type << sp.name << sp.category << sp.subcategory << sp.url << sp.data;
+        ssProperty << sp.issuer << sp.delegate << sp.txid << sp.fixed << sp.manual << sp.unique;
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ssProperty.str());
+        return true;
+    }
+    case RetFormat::JSON: {
+        UniValue propertyObj(UniValue::VOBJ);
+        propertyObj.pushKV("propertyid", (uint64_t) propertyId);
+        PropertyToJSON(sp, propertyObj);
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, propertyObj.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .json)");
+    }
+    }
+}
+
+static bool rest_omni_tx(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + SanitizeString(hashStr));
+
+    switch (rf) {
+    case RetFormat::BINARY: {
+        // only the record of a confirmed transaction is returned, which is read without parsing the transaction
+        if (!mastercore::pDbTransactionList->exists(hash))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        int block = 0;
+        unsigned int type = 0;
+        uint64_t nAmended = 0;
+        const bool fValid = mastercore::pDbTransactionList->getValidMPTX(hash, &block, &type, &nAmended);
+
+        CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
+        ssTx << hash << fValid << static_cast<int32_t>(block) << static_cast<uint32_t>(type) << nAmended;
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ssTx.str());
+        return true;
+    }
+    case RetFormat::JSON: {
+        UniValue txobj(UniValue::VOBJ);
+        int populateResult = populateRPCTransactionObject(hash, txobj);
+        if (populateResult != 0) {
+            if (populateResult == MP_TX_NOT_FOUND || populateResult == MP_TX_IS_NOT_OMNI_PROTOCOL) {
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+            }
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Failed to populate transaction: " + hashStr);
+        }
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, txobj.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .json)");
+    }
+    }
+}
+
+static bool rest_omni_orderbook(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+    uint32_t propertyIdForSale = 0;
+    uint32_t propertyIdDesired = 0;
+    if (path.size() != 2 || !ParseOmniPropertyId(path[0], propertyIdForSale) || !ParseOmniPropertyId(path[1], propertyIdDesired))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/omni/orderbook/<propertyidforsale>/<propertyiddesired>.<ext>");
+
+    std::shared_ptr<const mastercore::CStateSnapshot> snapshot = GetOmniSnapshot(req);
+    if (!snapshot)
+        return false;
+
+    if (!snapshot->GetProperty(propertyIdForSale) || !snapshot->GetProperty(propertyIdDesired))
+        return RESTERR(req, HTTP_NOT_FOUND, "Property identifier does not exist");
+
+    std::vector<const CMPMetaDEx*> vOrders;
+    const mastercore::md_PricesMap* prices = snapshot->GetOrders(propertyIdForSale, propertyIdDesired);
+    if (prices) {
+        for (const auto& price : *prices) {
+            for (const CMPMetaDEx& order : price.second) {
+                vOrders.push_back(&order);
+            }
+        }
+    }
+
+    switch (rf) {
+    case RetFormat::BINARY: {
+        CDataStream ssOrders(SER_NETWORK, PROTOCOL_VERSION);
+        WriteCompactSize(ssOrders, vOrders.size());
+        for (const CMPMetaDEx* order : vOrders) {
+            ssOrders << order->getHash() << order->getAddr();
+            ssOrders << order->getAmountForSale() << order->getAmountRemaining() << order->getAmountDesired();
+            ssOrders << static_cast<int32_t>(order->getBlock()) << static_cast<uint32_t>(order->getIdx());
+        }
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ssOrders.str());
+        return true;
+    }
+    case RetFormat::JSON: {
+        UniValue orders(UniValue::VARR);
+        for (const CMPMetaDEx* order : vOrders) {
+            UniValue orderObj(UniValue::VOBJ);
+            MetaDexObjectToJSON(*order, orderObj);
+            orders.push_back(orderObj);
+        }
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, orders.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .json)");
+    }
+    }
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -659,6 +902,10 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/omni/balance/", rest_omni_balance},
+      {"/rest/omni/property/", rest_omni_property},
+      {"/rest/omni/tx/", rest_omni_tx},
+      {"/rest/omni/orderbook/", rest_omni_orderbook},
 };
 
 void StartREST()
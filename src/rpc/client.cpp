@@ -186,6 +186,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     /* Omni Core - data retrieval calls */
     { "omni_gettradehistoryforaddress", 1 , "count"},
     { "omni_gettradehistoryforaddress", 2, "propertyid" },
+    { "omni_getorderbookdepth", 0, "propertyid" },
+    { "omni_getorderbookdepth", 1, "propertyidsecond" },
+    { "omni_getorderbookdepth", 2, "levels" },
     { "omni_gettradehistoryforpair", 0, "propertyid" },
     { "omni_gettradehistoryforpair", 1, "propertyidsecond" },
     { "omni_gettradehistoryforpair", 2, "count" },
@@ -194,20 +197,44 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "omni_getcrowdsale", 1, "verbose" },
     { "omni_getgrants", 0, "propertyid" },
     { "omni_getbalance", 1, "propertyid" },
+    { "omni_getbalance", 2, "height" },
+    { "omni_getbalancehistory", 1, "propertyid" },
+    { "omni_getbalancehistory", 3, "limit" },
+    { "omni_getbalances", 0, "balances" },
+    { "omni_getbalancesforaddresses", 0, "addresses" },
+    { "omni_getbalancesforaddresses", 1, "propertyid" },
     { "omni_getproperty", 0, "propertyid" },
     { "omni_listtransactions", 1, "count" },
     { "omni_listtransactions", 2, "skip" },
     { "omni_listtransactions", 3, "startblock" },
     { "omni_listtransactions", 4, "endblock" },
+    { "omni_rescanaddresses", 0, "addresses" },
+    { "omni_rescanaddresses", 1, "startheight" },
     { "omni_getallbalancesforid", 0, "propertyid" },
+    { "omni_getallbalancesforid", 1, "limit" },
+    { "omni_getallbalancesforid", 3, "height" },
+    { "omni_listproperties", 0, "limit" },
+    { "omni_getrpcstats", 0, "reset" },
+    { "omni_getperfstats", 0, "blocks" },
+    { "omni_getperfstats", 1, "reset" },
+    { "omni_waitforblock", 0, "height" },
+    { "omni_waitforblock", 1, "timeout" },
+    { "omni_listproperties", 2, "ecosystem" },
+    { "omni_listproperties", 3, "type" },
     { "omni_listblocktransactions", 0, "index" },
     { "omni_listblockstransactions", 0, "firstblock" },
     { "omni_listblockstransactions", 1, "lastblock" },
+    { "omni_listaddresstransactions", 2, "limit" },
+    { "omni_getblock", 0, "hash_or_height" },
+    { "omni_getblock", 1, "verbosity" },
     { "omni_getorderbook", 0, "propertyid" },
-    { "omni_getorderbook", 1, "propertyid" },
+    { "omni_getorderbook", 1, "propertyiddesired" },
+    { "omni_getorderbook", 2, "limit" },
     { "omni_getseedblocks", 0, "startblock" },
     { "omni_getseedblocks", 1, "endblock" },
     { "omni_getmetadexhash", 0, "propertyid" },
+    { "omni_getcurrentconsensushash", 0, "sections" },
+    { "omni_getconsensushash", 0, "block" },
     { "omni_getfeecache", 0, "propertyid" },
     { "omni_getfeeshare", 1, "ecosystem" },
     { "omni_getfeetrigger", 0, "propertyid" },
@@ -220,10 +247,13 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "omni_getnonfungibletokendata", 0, "propertyid"},
     { "omni_getnonfungibletokendata", 2, "tokenidend"},
     { "omni_getnonfungibletokenranges", 0, "propertyid"},
-    { "omni_getnonfungibletokenranges", 0, "propertyid"},
+    { "omni_getnonfungibletokenranges", 1, "limit"},
+    { "omni_submitquery", 1, "params" },
+    { "omni_getqueryresult", 1, "cursor" },
 
     /* Omni Core - transaction calls */
     { "omni_send", 2, "propertyid" },
+    { "omni_sendbatch", 1, "sends" },
     { "omni_sendsto", 1, "propertyid" },
     { "omni_sendsto", 4, "distributionproperty" },
     { "omni_sendall", 2, "ecosystem" },
@@ -291,6 +321,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "omni_createrawtx_change", 1, "prevtxs" },
     { "omni_createrawtx_change", 3, "fee" },
     { "omni_createrawtx_change", 4, "position" },
+    { "omni_rawtxsession_add", 1, "steps" },
 
     /* Omni Core - payload creation */
     { "omni_createpayload_simplesend", 0, "propertyid" },
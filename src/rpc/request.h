@@ -24,6 +24,8 @@ void DeleteAuthCookie();
 /** Parse JSON-RPC batch reply into a vector */
 std::vector<UniValue> JSONRPCProcessBatchReply(const UniValue &in, size_t num);
 
+class CJSONStreamWriter;
+
 class JSONRPCRequest
 {
 public:
@@ -34,8 +36,10 @@ public:
     std::string URI;
     std::string authUser;
     std::string peerAddr;
+    //! Writer for large results, which are written into the reply in parts, if supported by the caller
+    CJSONStreamWriter* resultWriter;
 
-    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
+    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false), resultWriter(nullptr) {}
     void parse(const UniValue& valRequest);
 };
 
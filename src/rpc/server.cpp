@@ -15,6 +15,8 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <atomic>
+#include <condition_variable>
 #include <memory> // for unique_ptr
 #include <unordered_map>
 
@@ -269,6 +271,20 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+bool CRPCTable::markParallel(const std::string& name)
+{
+    if (IsRPCRunning())
+        return false;
+
+    setParallelCommands.insert(name);
+    return true;
+}
+
+bool CRPCTable::isParallel(const std::string& name) const
+{
+    return setParallelCommands.count(name) > 0;
+}
+
 bool CRPCTable::removeCommand(const std::string& name, const CRPCCommand* pcmd)
 {
     auto it = mapCommands.find(name);
@@ -360,11 +376,78 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
+/**
+ * Calls of a batch, which are executed by any thread that takes part.
+ *
+ * The state is shared with the helper threads, which may only start after
+ * all calls were executed.
+ */
+struct RPCParallelCalls
+{
+    const JSONRPCRequest jreq;
+    std::vector<UniValue> vReq;
+    std::vector<UniValue> vResults;
+    std::atomic<size_t> nNext{0};
+    Mutex mutex;
+    std::condition_variable cond;
+    size_t nDone GUARDED_BY(mutex){0};
+
+    RPCParallelCalls(const JSONRPCRequest& _jreq, std::vector<UniValue> _vReq)
+        : jreq(_jreq), vReq(std::move(_vReq)), vResults(vReq.size())
+    {
+    }
+
+    /** Executes calls, until none are left. */
+    void Run()
+    {
+        for (size_t n = nNext++; n < vReq.size(); n = nNext++) {
+            vResults[n] = JSONRPCExecOne(jreq, vReq[n]);
+            LOCK(mutex);
+            if (++nDone == vReq.size()) cond.notify_all();
+        }
+    }
+
+    /** Waits, until all calls were executed. */
+    void Wait()
+    {
+        WAIT_LOCK(mutex, lock);
+        while (nDone < vReq.size()) cond.wait(lock);
+    }
+};
+
+static bool IsParallelCall(const UniValue& req)
+{
+    if (!req.isObject()) return false;
+    const UniValue& method = find_value(req.get_obj(), "method");
+    return method.isStr() && tableRPC.isParallel(method.get_str());
+}
+
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq, const RPCTaskEnqueuer& enqueue)
 {
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    unsigned int reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        // calls, which can't be executed in parallel, keep their order relative to all other calls
+        unsigned int reqEnd = reqIdx;
+        while (enqueue && reqEnd < vReq.size() && IsParallelCall(vReq[reqEnd])) reqEnd++;
+        if (reqEnd - reqIdx < 2) {
+            ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx++]));
+            continue;
+        }
+
+        std::shared_ptr<RPCParallelCalls> calls = std::make_shared<RPCParallelCalls>(jreq,
+                std::vector<UniValue>(vReq.getValues().begin() + reqIdx, vReq.getValues().begin() + reqEnd));
+        for (unsigned int n = reqIdx + 1; n < reqEnd; n++) {
+            if (!enqueue([calls] { calls->Run(); })) break;
+        }
+        calls->Run();
+        calls->Wait();
+
+        for (UniValue& result : calls->vResults) {
+            ret.push_back(std::move(result));
+        }
+        reqIdx = reqEnd;
+    }
 
     return ret.write() + "\n";
 }
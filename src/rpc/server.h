@@ -10,6 +10,7 @@
 #include <rpc/request.h>
 
 #include <map>
+#include <set>
 #include <stdint.h>
 #include <string>
 #include <functional>
@@ -120,6 +121,7 @@ class CRPCTable
 {
 private:
     std::map<std::string, std::vector<const CRPCCommand*>> mapCommands;
+    std::set<std::string> setParallelCommands;
 public:
     CRPCTable();
     std::string help(const std::string& name, const JSONRPCRequest& helpreq) const;
@@ -153,6 +155,15 @@ public:
      */
     bool appendCommand(const std::string& name, const CRPCCommand* pcmd);
     bool removeCommand(const std::string& name, const CRPCCommand* pcmd);
+
+    /**
+     * Marks a method as read-only and thread-safe, so the calls of a batch may be
+     * executed in parallel.
+     *
+     * Returns false if RPC server is already running (dump concurrency protection).
+     */
+    bool markParallel(const std::string& name);
+    bool isParallel(const std::string& name) const;
 };
 
 bool IsDeprecatedRPCEnabled(const std::string& method);
@@ -162,7 +173,16 @@ extern CRPCTable tableRPC;
 void StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
+/** Queues a task on another thread, and returns false, if it can't be run right away */
+typedef std::function<bool(const std::function<void()>& task)> RPCTaskEnqueuer;
+
+/**
+ * Executes the calls of a batch.
+ *
+ * Consecutive calls of methods marked as parallel are shared with other threads
+ * via the enqueuer, if one is given, while all other calls are executed in order.
+ */
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq, const RPCTaskEnqueuer& enqueue = nullptr);
 
 // Retrieves any serialization flags requested in command line argument
 int RPCSerializationFlags();
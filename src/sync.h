@@ -116,6 +116,13 @@ typedef AnnotatedMixin<std::mutex> Mutex;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Passes the call site of a lock to mutexes, which record it. Such mutexes provide
+ * an overload, which is found by argument-dependent lookup.
+ */
+template <typename Mutex>
+inline void SetLockSite(Mutex& mutex, const char* pszFile, int nLine) {}
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock : public Base
@@ -124,6 +131,7 @@ private:
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()));
+        SetLockSite(*Base::mutex(), pszFile, nLine);
 #ifdef DEBUG_LOCKCONTENTION
         if (!Base::try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -0,0 +1,311 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/util/omnichain.h>
+
+#include <omnicore/createpayload.h>
+#include <omnicore/createtx.h>
+#include <omnicore/omnicore.h>
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <coins.h>
+#include <consensus/consensus.h>
+#include <consensus/merkle.h>
+#include <hash.h>
+#include <key.h>
+#include <key_io.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <script/sign.h>
+#include <script/signingprovider.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <tinyformat.h>
+#include <uint256.h>
+#include <validation.h>
+#include <versionbits.h>
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace mastercore;
+
+namespace {
+//! Fee of every generated transaction
+const CAmount OMNI_CHAIN_FEE = 1000;
+//! Minimal funds of the inputs of a transaction, besides the paid amount
+const CAmount OMNI_CHAIN_MIN_FUNDS = COIN;
+//! Payment to the Exodus crowdsale address, which buys the OMNI for the orders and the STO fee
+const CAmount OMNI_CHAIN_CROWDSALE = 10 * COIN;
+//! Number of tokens of each issued property
+const int64_t OMNI_CHAIN_ISSUANCE = 1000000000 * COIN;
+//! First property identifier of the main ecosystem
+const uint32_t OMNI_CHAIN_FIRST_PROPERTY = 3;
+
+/** Returns a deterministic hash of the seed, a label and an index. */
+uint256 GetSeedHash(uint32_t nSeed, const std::string& label, uint32_t nIndex)
+{
+    CHashWriter hasher(SER_GETHASH, 0);
+    hasher << nSeed << label << nIndex;
+    return hasher.GetHash();
+}
+
+/**
+ * Generator of a synthetic chain, where all Omni transactions are sent by one issuer.
+ *
+ * The transactions spend the change of the previous transaction, and coinbase outputs
+ * are added as inputs, once the change runs low.
+ */
+class COmniChainGenerator
+{
+private:
+    const OmniChainSpec& spec;
+    const std::function<void(const CBlock&)>& fnBlock;
+
+    CKey keyIssuer;
+    CScript scriptIssuer;
+    std::string strIssuer;
+    FillableSigningProvider keystore;
+
+    //! Outputs of the issuer, which are not yet spent
+    CCoinsView viewBase;
+    CCoinsViewCache viewCoins;
+    //! Coinbase outputs of the issuer, which are not yet spent
+    std::deque<COutPoint> vCoinbases;
+    //! Change output of the last transaction
+    COutPoint outChange;
+
+    uint256 hashPrevBlock;
+    uint32_t nPrevTime;
+    uint32_t nBits;
+    int nHeight;
+    std::vector<CTransactionRef> vPending;
+
+public:
+    COmniChainGenerator(const OmniChainSpec& specIn, const std::function<void(const CBlock&)>& fnBlockIn)
+      : spec(specIn), fnBlock(fnBlockIn), viewCoins(&viewBase), nHeight(0)
+    {
+        const uint256 hashKey = GetSeedHash(spec.nSeed, "issuer", 0);
+        keyIssuer.Set(hashKey.begin(), hashKey.end(), true);
+        assert(keyIssuer.IsValid());
+        keystore.AddKey(keyIssuer);
+        scriptIssuer = GetScriptForDestination(PKHash(keyIssuer.GetPubKey()));
+        strIssuer = EncodeDestination(PKHash(keyIssuer.GetPubKey()));
+
+        const CBlock& genesis = Params().GenesisBlock();
+        hashPrevBlock = genesis.GetHash();
+        nPrevTime = genesis.nTime;
+        nBits = genesis.nBits;
+    }
+
+    /** Returns the address of a holder, which doesn't need to sign. */
+    std::string GetHolder(uint32_t nIndex) const
+    {
+        const uint256 hash = GetSeedHash(spec.nSeed, "holder", nIndex);
+        return EncodeDestination(PKHash(uint160(std::vector<unsigned char>(hash.begin(), hash.begin() + 20))));
+    }
+
+    /** Mines a block with the pending transactions and a coinbase, which pays the issuer. */
+    void MineBlock()
+    {
+        ++nHeight;
+
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vin[0].prevout.SetNull();
+        coinbase.vin[0].scriptSig = CScript() << nHeight << OP_0;
+        coinbase.vout.emplace_back(GetBlockSubsidy(nHeight, Params().GetConsensus()), scriptIssuer);
+
+        CBlock block;
+        block.nVersion = VERSIONBITS_TOP_BITS;
+        block.hashPrevBlock = hashPrevBlock;
+        block.nTime = ++nPrevTime;
+        block.nBits = nBits;
+        block.nNonce = 0;
+        block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+        block.vtx.insert(block.vtx.end(), vPending.begin(), vPending.end());
+        block.hashMerkleRoot = BlockMerkleRoot(block);
+
+        while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) {
+            ++block.nNonce;
+            assert(block.nNonce);
+        }
+
+        const COutPoint outCoinbase(block.vtx[0]->GetHash(), 0);
+        viewCoins.AddCoin(outCoinbase, Coin(block.vtx[0]->vout[0], nHeight, true), false);
+        vCoinbases.push_back(outCoinbase);
+
+        hashPrevBlock = block.GetHash();
+        vPending.clear();
+        fnBlock(block);
+    }
+
+    /** Creates a transaction builder with inputs of the issuer, which cover the amount. */
+    OmniTxBuilder CreateBuilder(CAmount nAmount)
+    {
+        std::vector<PrevTxsEntry> vInputs;
+        CAmount nFunds = 0;
+
+        if (!outChange.IsNull()) {
+            const Coin& coin = viewCoins.AccessCoin(outChange);
+            vInputs.emplace_back(outChange.hash, outChange.n, coin.out.nValue, coin.out.scriptPubKey);
+            nFunds += coin.out.nValue;
+        }
+        while (nFunds < nAmount + OMNI_CHAIN_MIN_FUNDS) {
+            assert(!vCoinbases.empty());
+            const COutPoint outCoinbase = vCoinbases.front();
+            const Coin& coin = viewCoins.AccessCoin(outCoinbase);
+            assert(nHeight + 1 - (int) coin.nHeight >= COINBASE_MATURITY);
+            vInputs.emplace_back(outCoinbase.hash, outCoinbase.n, coin.out.nValue, coin.out.scriptPubKey);
+            nFunds += coin.out.nValue;
+            vCoinbases.pop_front();
+        }
+
+        OmniTxBuilder builder;
+        builder.addInputs(vInputs);
+        return builder;
+    }
+
+    /** Signs a transaction, whose last output is the change, and adds it to the next block. */
+    void AddTransaction(OmniTxBuilder& builder)
+    {
+        builder.addChange(strIssuer, viewCoins, OMNI_CHAIN_FEE);
+        CMutableTransaction tx = builder.build();
+        assert(tx.vout.back().scriptPubKey == scriptIssuer);
+
+        for (unsigned int n = 0; n < tx.vin.size(); ++n) {
+            const Coin& coin = viewCoins.AccessCoin(tx.vin[n].prevout);
+            assert(SignSignature(keystore, coin.out.scriptPubKey, tx, n, coin.out.nValue, SIGHASH_ALL));
+        }
+        for (const CTxIn& txIn : tx.vin) {
+            viewCoins.SpendCoin(txIn.prevout);
+        }
+
+        const CTransactionRef txRef = MakeTransactionRef(std::move(tx));
+        outChange = COutPoint(txRef->GetHash(), txRef->vout.size() - 1);
+        viewCoins.AddCoin(outChange, Coin(txRef->vout.back(), nHeight + 1, false), false);
+
+        vPending.push_back(txRef);
+        if (vPending.size() >= spec.nTxPerBlock) MineBlock();
+    }
+
+    /** Sends a payload with class C encoding and an optional reference. */
+    void SendPayload(const std::vector<unsigned char>& vchPayload, const std::string& strReference = "")
+    {
+        OmniTxBuilder builder = CreateBuilder(0);
+        builder.addOpReturn(vchPayload);
+        if (!strReference.empty()) {
+            builder.addReference(strReference, 0);
+        }
+        AddTransaction(builder);
+    }
+
+    /** Generates the chain and returns the number of blocks. */
+    int Generate()
+    {
+        for (int n = 0; n < COINBASE_MATURITY; ++n) {
+            MineBlock();
+        }
+
+        // buy OMNI for the STO fee and the MetaDEx orders
+        OmniTxBuilder builder = CreateBuilder(OMNI_CHAIN_CROWDSALE);
+        builder.addOutput(GetScriptForDestination(ExodusCrowdsaleAddress(nHeight + 1)), OMNI_CHAIN_CROWDSALE);
+        AddTransaction(builder);
+
+        uint32_t propertyId = OMNI_CHAIN_FIRST_PROPERTY;
+        for (unsigned int n = 0; n < spec.nProperties; ++n) {
+            SendPayload(CreatePayload_IssuanceFixed(OMNI_PROPERTY_MSC, MSC_PROPERTY_TYPE_DIVISIBLE, 0, "Synthetic", "Holders",
+                    strprintf("Property %d", n), "", "", OMNI_CHAIN_ISSUANCE));
+        }
+        const uint32_t firstPropertyId = propertyId;
+        propertyId += spec.nProperties;
+
+        const uint32_t stoPropertyId = propertyId;
+        if (spec.nStoRecipients > 0) {
+            SendPayload(CreatePayload_IssuanceFixed(OMNI_PROPERTY_MSC, MSC_PROPERTY_TYPE_DIVISIBLE, 0, "Synthetic", "Owners",
+                    "STO property", "", "", OMNI_CHAIN_ISSUANCE));
+            ++propertyId;
+        }
+
+        const uint32_t nftPropertyId = propertyId;
+        if (spec.nNftRanges > 0) {
+            SendPayload(CreatePayload_IssuanceManaged(OMNI_PROPERTY_MSC, MSC_PROPERTY_TYPE_NONFUNGIBLE, 0, "Synthetic", "Tokens",
+                    "NFT property", "", ""));
+            SendPayload(CreatePayload_Grant(nftPropertyId, spec.nNftRanges, ""));
+            ++propertyId;
+        }
+
+        if (spec.nProperties > 0) {
+            for (unsigned int n = 0; n < spec.nHolders; ++n) {
+                SendPayload(CreatePayload_SimpleSend(firstPropertyId + n % spec.nProperties, COIN), GetHolder(n));
+            }
+        }
+
+        if (spec.nStoRecipients > 0) {
+            for (unsigned int n = 0; n < spec.nStoRecipients; ++n) {
+                SendPayload(CreatePayload_SimpleSend(stoPropertyId, COIN), GetHolder(n));
+            }
+            SendPayload(CreatePayload_SendToOwners(stoPropertyId, (uint64_t) spec.nStoRecipients * COIN, stoPropertyId));
+        }
+
+        // every token is sent to another owner, so that each forms its own range
+        for (unsigned int n = 0; n < spec.nNftRanges; ++n) {
+            SendPayload(CreatePayload_SendNonFungible(nftPropertyId, n + 1, n + 1), GetHolder(n));
+        }
+
+        // the orders only offer the properties for OMNI, so none of them is matched
+        if (spec.nProperties > 0) {
+            for (unsigned int n = 0; n < spec.nOrders; ++n) {
+                SendPayload(CreatePayload_MetaDExTrade(firstPropertyId + n % spec.nProperties, COIN, OMNI_PROPERTY_MSC, COIN + n));
+            }
+        }
+
+        if (!vPending.empty()) MineBlock();
+
+        return nHeight;
+    }
+};
+} // namespace
+
+int GetOmniChainFundingBlocks()
+{
+    return COINBASE_MATURITY;
+}
+
+int GenerateOmniChain(const OmniChainSpec& spec, const std::function<void(const CBlock&)>& fnBlock)
+{
+    assert(spec.nTxPerBlock > 0);
+
+    COmniChainGenerator generator(spec, fnBlock);
+    return generator.Generate();
+}
+
+std::vector<CBlock> GenerateOmniChain(const OmniChainSpec& spec)
+{
+    std::vector<CBlock> vBlocks;
+    GenerateOmniChain(spec, [&vBlocks](const CBlock& block) { vBlocks.push_back(block); });
+    return vBlocks;
+}
+
+bool WriteOmniChain(const OmniChainSpec& spec, const fs::path& path)
+{
+    CAutoFile fileout(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) return false;
+
+    GenerateOmniChain(spec, [&fileout](const CBlock& block) {
+        // the format of the block files, as read by -loadblock
+        const unsigned int nSize = GetSerializeSize(block, fileout.GetVersion());
+        fileout << Params().MessageStart() << nSize;
+        fileout << block;
+    });
+
+    return true;
+}
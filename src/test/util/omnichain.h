@@ -0,0 +1,65 @@
+// Copyright (c) 2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TEST_UTIL_OMNICHAIN_H
+#define BITCOIN_TEST_UTIL_OMNICHAIN_H
+
+#include <fs.h>
+
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+class CBlock;
+
+/**
+ * Shape of a synthetic Omni chain.
+ *
+ * The chain starts at the regtest genesis block with mature funding blocks, followed by
+ * blocks with the issuance of the properties, the sends to the holders and the STO
+ * recipients, the NFT ranges, one send to owners and the open MetaDEx orders.
+ */
+struct OmniChainSpec
+{
+    //! Number of issued divisible properties, which are sent to the holders and offered on the MetaDEx
+    unsigned int nProperties{10};
+    //! Number of addresses, which receive one of the properties
+    unsigned int nHolders{1000};
+    //! Number of MetaDEx orders, which remain open
+    unsigned int nOrders{100};
+    //! Number of non-fungible token ranges with distinct owners
+    unsigned int nNftRanges{100};
+    //! Number of owners, which receive the send to owners
+    unsigned int nStoRecipients{100};
+    //! Maximal number of Omni transactions per block
+    unsigned int nTxPerBlock{1000};
+    //! Seed of the keys and addresses
+    uint32_t nSeed{1};
+};
+
+/** Returns the number of blocks, which are mined before the first Omni transaction. */
+int GetOmniChainFundingBlocks();
+
+/**
+ * Generates a synthetic Omni chain on top of the regtest genesis block and passes the
+ * blocks in order to the handler, so that large chains are never held in memory.
+ *
+ * The transactions are created with the payloads of CreatePayload_*() and the
+ * OmniTxBuilder, are signed and connect to the active chain, if it's at the genesis block.
+ *
+ * @return The number of generated blocks
+ */
+int GenerateOmniChain(const OmniChainSpec& spec, const std::function<void(const CBlock&)>& fnBlock);
+
+/** Generates a synthetic Omni chain and returns its blocks. */
+std::vector<CBlock> GenerateOmniChain(const OmniChainSpec& spec);
+
+/**
+ * Writes a synthetic Omni chain as block file, which can be imported with -loadblock
+ * by a regtest node to replay it with -omnireplay.
+ */
+bool WriteOmniChain(const OmniChainSpec& spec, const fs::path& path);
+
+#endif // BITCOIN_TEST_UTIL_OMNICHAIN_H
@@ -24,6 +24,12 @@ struct UISignals {
     boost::signals2::signal<CClientUIInterface::OmniPendingChangedSig> OmniPendingChanged;
     boost::signals2::signal<CClientUIInterface::OmniBalanceChangedSig> OmniBalanceChanged;
     boost::signals2::signal<CClientUIInterface::OmniStateInvalidatedSig> OmniStateInvalidated;
+    boost::signals2::signal<CClientUIInterface::OmniMetaDExPairsChangedSig> OmniMetaDExPairsChanged;
+    boost::signals2::signal<CClientUIInterface::OmniMetaDExTradeSig> OmniMetaDExTrade;
+    boost::signals2::signal<CClientUIInterface::OmniMetaDExOrderChangedSig> OmniMetaDExOrderChanged;
+    boost::signals2::signal<CClientUIInterface::OmniBalancesChangedSig> OmniBalancesChanged;
+    boost::signals2::signal<CClientUIInterface::OmniTransactionRecordedSig> OmniTransactionRecorded;
+    boost::signals2::signal<CClientUIInterface::OmniBlockChangedSig> OmniBlockChanged;
 };
 static UISignals g_ui_signals;
 
@@ -47,6 +53,12 @@ ADD_SIGNALS_IMPL_WRAPPER(OmniStateChanged);
 ADD_SIGNALS_IMPL_WRAPPER(OmniPendingChanged);
 ADD_SIGNALS_IMPL_WRAPPER(OmniBalanceChanged);
 ADD_SIGNALS_IMPL_WRAPPER(OmniStateInvalidated);
+ADD_SIGNALS_IMPL_WRAPPER(OmniMetaDExPairsChanged);
+ADD_SIGNALS_IMPL_WRAPPER(OmniMetaDExTrade);
+ADD_SIGNALS_IMPL_WRAPPER(OmniMetaDExOrderChanged);
+ADD_SIGNALS_IMPL_WRAPPER(OmniBalancesChanged);
+ADD_SIGNALS_IMPL_WRAPPER(OmniTransactionRecorded);
+ADD_SIGNALS_IMPL_WRAPPER(OmniBlockChanged);
 
 bool CClientUIInterface::ThreadSafeMessageBox(const std::string& message, const std::string& caption, unsigned int style) { return g_ui_signals.ThreadSafeMessageBox(message, caption, style); }
 bool CClientUIInterface::ThreadSafeQuestion(const std::string& message, const std::string& non_interactive_message, const std::string& caption, unsigned int style) { return g_ui_signals.ThreadSafeQuestion(message, non_interactive_message, caption, style); }
@@ -60,8 +72,14 @@ void CClientUIInterface::NotifyHeaderTip(bool b, const CBlockIndex* i) { return
 void CClientUIInterface::BannedListChanged() { return g_ui_signals.BannedListChanged(); }
 void CClientUIInterface::OmniStateChanged() { return g_ui_signals.OmniStateChanged(); }
 void CClientUIInterface::OmniPendingChanged(bool b) { return g_ui_signals.OmniPendingChanged(b); }
-void CClientUIInterface::OmniBalanceChanged() { return g_ui_signals.OmniBalanceChanged(); }
+void CClientUIInterface::OmniBalanceChanged(const std::set<uint32_t>& propertyIds) { return g_ui_signals.OmniBalanceChanged(propertyIds); }
 void CClientUIInterface::OmniStateInvalidated() { return g_ui_signals.OmniStateInvalidated(); }
+void CClientUIInterface::OmniMetaDExPairsChanged(const std::set<std::pair<uint32_t, uint32_t> >& pairs) { return g_ui_signals.OmniMetaDExPairsChanged(pairs); }
+void CClientUIInterface::OmniMetaDExTrade(const CMPMetaDEx& seller, const CMPMetaDEx& buyer, int64_t amountSold, int64_t amountReceived, int64_t tradingFee) { return g_ui_signals.OmniMetaDExTrade(seller, buyer, amountSold, amountReceived, tradingFee); }
+void CClientUIInterface::OmniMetaDExOrderChanged(const CMPMetaDEx& order, ChangeType status) { return g_ui_signals.OmniMetaDExOrderChanged(order, status); }
+void CClientUIInterface::OmniBalancesChanged(int block, const std::vector<mastercore::BalanceChange>& changes) { return g_ui_signals.OmniBalancesChanged(block, changes); }
+void CClientUIInterface::OmniTransactionRecorded(const mastercore::TransactionNotification& notification) { return g_ui_signals.OmniTransactionRecorded(notification); }
+void CClientUIInterface::OmniBlockChanged(int block, const uint256& blockHash, bool connected) { return g_ui_signals.OmniBlockChanged(block, blockHash, connected); }
 
 bool InitError(const std::string& str)
 {
@@ -8,9 +8,19 @@
 
 #include <functional>
 #include <memory>
+#include <set>
+#include <stdint.h>
 #include <string>
+#include <utility>
+#include <vector>
 
 class CBlockIndex;
+class CMPMetaDEx;
+class uint256;
+namespace mastercore {
+struct BalanceChange;
+struct TransactionNotification;
+}
 namespace boost {
 namespace signals2 {
 class connection;
@@ -118,8 +128,29 @@ public:
 
     ADD_SIGNALS_DECL_WRAPPER(OmniStateChanged, void);
     ADD_SIGNALS_DECL_WRAPPER(OmniPendingChanged, void, bool);
-    ADD_SIGNALS_DECL_WRAPPER(OmniBalanceChanged, void);
+
+    /** Wallet balances changed, signaled once per block with the properties, whose wallet balances changed. */
+    ADD_SIGNALS_DECL_WRAPPER(OmniBalanceChanged, void, const std::set<uint32_t>& propertyIds);
+
     ADD_SIGNALS_DECL_WRAPPER(OmniStateInvalidated, void);
+
+    /** Open MetaDEx orders changed, signaled once per block with the property pairs of the changed orders. */
+    ADD_SIGNALS_DECL_WRAPPER(OmniMetaDExPairsChanged, void, const std::set<std::pair<uint32_t, uint32_t> >& pairs);
+
+    /** An open MetaDEx order was matched by a new order. */
+    ADD_SIGNALS_DECL_WRAPPER(OmniMetaDExTrade, void, const CMPMetaDEx& seller, const CMPMetaDEx& buyer, int64_t amountSold, int64_t amountReceived, int64_t tradingFee);
+
+    /** A MetaDEx order was added to, updated in, or removed from the order book. */
+    ADD_SIGNALS_DECL_WRAPPER(OmniMetaDExOrderChanged, void, const CMPMetaDEx& order, ChangeType status);
+
+    /** Balances changed in a block, signaled once per block with the amounts after the block. */
+    ADD_SIGNALS_DECL_WRAPPER(OmniBalancesChanged, void, int block, const std::vector<mastercore::BalanceChange>& changes);
+
+    /** A confirmed Omni transaction was recorded with its decoded fields and processing result. */
+    ADD_SIGNALS_DECL_WRAPPER(OmniTransactionRecorded, void, const mastercore::TransactionNotification& notification);
+
+    /** The Omni transactions of a block were processed, or are rolled back, if the block was disconnected. */
+    ADD_SIGNALS_DECL_WRAPPER(OmniBlockChanged, void, int block, const uint256& blockHash, bool connected);
 };
 
 /** Show warning message **/
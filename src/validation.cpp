@@ -158,9 +158,14 @@ namespace {
 // TODO: replace handlers with signals
 int mastercore_handler_block_begin(int nBlockNow, CBlockIndex const * pBlockIndex);
 int mastercore_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex, unsigned int);
-bool mastercore_handler_tx(const CTransaction &tx, int nBlock, unsigned int idx, CBlockIndex const * pBlockIndex, std::shared_ptr<std::map<COutPoint, Coin>> removedCoins);
-void mastercore_handler_disc_begin(const int nHeight);
+unsigned int mastercore_handler_block(const CBlock& block, CBlockIndex const * pBlockIndex, std::shared_ptr<std::map<COutPoint, Coin>> removedCoins);
+void mastercore_handler_disc_begin(const int nHeight, const uint256& blockHash);
+bool mastercore_async_enabled();
+void mastercore_queue_block_connected(std::shared_ptr<const CBlock> pblock, CBlockIndex const * pBlockIndex, std::shared_ptr<std::map<COutPoint, Coin>> removedCoins);
+void mastercore_queue_block_disconnected(CBlockIndex const * pBlockIndex);
 void TryToAddToMarkerCache(const CTransactionRef& tx);
+bool HasMarkerForInputs(const CTransaction& tx, int nBlock);
+bool CheckOmniMempoolPayload(const CTransaction& tx, const CCoinsViewCache& view, bool fCache, std::string& strReason);
 void RemoveFromMarkerCache(const uint256& txHash);
 
 CBlockIndex* LookupBlockIndex(const uint256& hash)
@@ -1045,6 +1050,12 @@ bool MemPoolAccept::AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs
 
     if (!ConsensusScriptChecks(args, workspace, txdata)) return false;
 
+    // Omni payloads are only checked and decoded, after the transaction is known to be valid
+    std::string strOmniReason;
+    if (!CheckOmniMempoolPayload(*ptx, m_view, !args.m_test_accept, strOmniReason)) {
+        return args.m_state.Invalid(TxValidationResult::TX_NOT_STANDARD, "omni-payload-invalid", strOmniReason);
+    }
+
     // Tx was accepted, but not added
     if (args.m_test_accept) return true;
 
@@ -1454,11 +1465,11 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, CTxUndo &txund
     if (!tx.IsCoinBase()) {
         txundo.vprevout.reserve(tx.vin.size());
         for (const CTxIn &txin : tx.vin) {
-            if (removedCoins)
-                removedCoins->emplace(txin.prevout, inputs.AccessCoin(txin.prevout));
             txundo.vprevout.emplace_back();
             bool is_spent = inputs.SpendCoin(txin.prevout, &txundo.vprevout.back());
             assert(is_spent);
+            if (removedCoins)
+                removedCoins->emplace(txin.prevout, txundo.vprevout.back());
         }
     }
     // add outputs
@@ -2283,7 +2294,9 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
         }
-        UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight, removedCoins);
+        // Omni Core: only the inputs of transactions with markers are captured for the block handlers
+        const bool fOmniInputs = removedCoins && HasMarkerForInputs(tx, pindex->nHeight);
+        UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight, fOmniInputs ? removedCoins : nullptr);
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
@@ -2657,7 +2670,11 @@ bool CChainState::DisconnectTip(BlockValidationState& state, const CChainParams&
 
     //! Omni Core: begin block disconnect notification
     LogPrint(BCLog::HANDLER, "Omni Core handler: block disconnect begin [height: %d, reindex: %d]\n", ::ChainActive().Height(), (int)fReindex);
-    mastercore_handler_disc_begin(pindexDelete->nHeight);
+    if (mastercore_async_enabled()) {
+        mastercore_queue_block_disconnected(pindexDelete);
+    } else {
+        mastercore_handler_disc_begin(pindexDelete->nHeight, pindexDelete->GetBlockHash());
+    }
 
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
@@ -2769,9 +2786,14 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "  - Writing chainstate: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime5 - nTime4) * MILLI, nTimeChainState * MICRO, nTimeChainState * MILLI / nBlocksTotal);
 
+    //! Omni Core: with -omniasync the block is queued for the Omni thread, after the tip was updated
+    const bool fOmniAsync = mastercore_async_enabled();
+
     //! Omni Core: begin block connect notification
-    LogPrint(BCLog::HANDLER, "Omni Core handler: block connect begin [height: %d]\n", ::ChainActive().Height());
-    mastercore_handler_block_begin(::ChainActive().Height(), pindexNew);
+    if (!fOmniAsync) {
+        LogPrint(BCLog::HANDLER, "Omni Core handler: block connect begin [height: %d]\n", ::ChainActive().Height());
+        mastercore_handler_block_begin(::ChainActive().Height(), pindexNew);
+    }
 
     // Remove conflicting transactions from the mempool.;
     mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
@@ -2784,22 +2806,20 @@ bool CChainState::ConnectTip(BlockValidationState& state, const CChainParams& ch
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
 
-    //! Omni Core: transaction position within the block
-    unsigned int nTxIdx = 0;
-
-    //! Omni Core: number of meta transactions found
-    unsigned int nNumMetaTxs = 0;
+    if (fOmniAsync) {
+        LogPrint(BCLog::HANDLER, "Omni Core handler: block connect queued [height: %d, txs: %u]\n", pindexNew->nHeight, blockConnecting.vtx.size());
+        mastercore_queue_block_connected(pthisBlock, pindexNew, removedCoins);
+    } else {
+        //! Omni Core: new confirmed transactions notification
+        LogPrint(BCLog::HANDLER, "Omni Core handler: new confirmed transactions [height: %d, txs: %u]\n", pindexNew->nHeight, blockConnecting.vtx.size());
+        //! Omni Core: number of meta transactions found
+        unsigned int nNumMetaTxs = mastercore_handler_block(blockConnecting, pindexNew, removedCoins);
 
-    for (size_t i = 0; i < blockConnecting.vtx.size(); i++) {
-        //! Omni Core: new confirmed transaction notification
-        LogPrint(BCLog::HANDLER, "Omni Core handler: new confirmed transaction [height: %d, idx: %u]\n", pindexNew->nHeight, nTxIdx);
-        if (mastercore_handler_tx(*blockConnecting.vtx[i], pindexNew->nHeight, nTxIdx++, pindexNew, removedCoins)) ++nNumMetaTxs;
+        //! Omni Core: end of block connect notification
+        LogPrint(BCLog::HANDLER, "Omni Core handler: block connect end [new height: %d, found: %u txs]\n", pindexNew->nHeight, nNumMetaTxs);
+        mastercore_handler_block_end(pindexNew->nHeight, pindexNew, nNumMetaTxs);
     }
 
-    //! Omni Core: end of block connect notification
-    LogPrint(BCLog::HANDLER, "Omni Core handler: block connect end [new height: %d, found: %u txs]\n", pindexNew->nHeight, nNumMetaTxs);
-    mastercore_handler_block_end(pindexNew->nHeight, pindexNew, nNumMetaTxs);
-
     connectTrace.BlockConnected(pindexNew, std::move(pthisBlock));
     return true;
 }
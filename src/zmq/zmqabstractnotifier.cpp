@@ -20,3 +20,28 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyOmniMetaDExTrade(const CMPMetaDEx& /*seller*/, const CMPMetaDEx& /*buyer*/, int64_t /*amountSold*/, int64_t /*amountReceived*/, int64_t /*tradingFee*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyOmniMetaDExOrder(const CMPMetaDEx& /*order*/, ChangeType /*status*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyOmniBalances(int /*block*/, const std::vector<mastercore::BalanceChange>& /*changes*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyOmniTransaction(const mastercore::TransactionNotification& /*notification*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyOmniBlock(int /*block*/, const uint256& /*blockHash*/, bool /*connected*/)
+{
+    return true;
+}
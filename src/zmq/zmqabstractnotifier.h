@@ -5,10 +5,20 @@
 #ifndef BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 #define BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 
+#include <ui_interface.h>
 #include <zmq/zmqconfig.h>
 
+#include <stdint.h>
+#include <vector>
+
 class CBlockIndex;
+class CMPMetaDEx;
 class CZMQAbstractNotifier;
+class uint256;
+namespace mastercore {
+struct BalanceChange;
+struct TransactionNotification;
+}
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
@@ -42,6 +52,11 @@ public:
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    virtual bool NotifyOmniMetaDExTrade(const CMPMetaDEx& seller, const CMPMetaDEx& buyer, int64_t amountSold, int64_t amountReceived, int64_t tradingFee);
+    virtual bool NotifyOmniMetaDExOrder(const CMPMetaDEx& order, ChangeType status);
+    virtual bool NotifyOmniBalances(int block, const std::vector<mastercore::BalanceChange>& changes);
+    virtual bool NotifyOmniTransaction(const mastercore::TransactionNotification& notification);
+    virtual bool NotifyOmniBlock(int block, const uint256& blockHash, bool connected);
 
 protected:
     void *psocket;
@@ -5,15 +5,20 @@
 #include <zmq/zmqnotificationinterface.h>
 #include <zmq/zmqpublishnotifier.h>
 
+#include <omnicore/balancenotify.h>
+#include <omnicore/mdex.h>
+#include <omnicore/txnotify.h>
 #include <validation.h>
 #include <util/system.h>
 
+#include <boost/signals2/signal.hpp>
+
 void zmqError(const char *str)
 {
     LogPrint(BCLog::ZMQ, "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr)
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr), nMaxOmniQueued(DEFAULT_ZMQ_OMNI_QUEUE), nOmniQueued(0), nOmniDropped(0)
 {
 }
 
@@ -46,6 +51,11 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubomnitrade"] = CZMQAbstractNotifier::Create<CZMQPublishOmniTradeNotifier>;
+    factories["pubomniorder"] = CZMQAbstractNotifier::Create<CZMQPublishOmniOrderNotifier>;
+    factories["pubomnibalance"] = CZMQAbstractNotifier::Create<CZMQPublishOmniBalanceNotifier>;
+    factories["pubomnitx"] = CZMQAbstractNotifier::Create<CZMQPublishOmniTransactionNotifier>;
+    factories["pubomniblock"] = CZMQAbstractNotifier::Create<CZMQPublishOmniBlockNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -115,6 +125,33 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    nMaxOmniQueued = std::max<int64_t>(0, gArgs.GetArg("-zmqpubomniqueue", DEFAULT_ZMQ_OMNI_QUEUE));
+    omniConnections.push_back(uiInterface.OmniMetaDExTrade_connect(std::bind(&CZMQNotificationInterface::OmniMetaDExTrade, this,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5)));
+    omniConnections.push_back(uiInterface.OmniMetaDExOrderChanged_connect(std::bind(&CZMQNotificationInterface::OmniMetaDExOrderChanged, this,
+            std::placeholders::_1, std::placeholders::_2)));
+
+    // balance changes are only recorded, when they are published
+    for (const CZMQAbstractNotifier* notifier : notifiers) {
+        if (notifier->GetType() != "pubomnibalance") continue;
+        const std::vector<std::string> vFilter = gArgs.GetArgs("-zmqpubomnibalancefilter");
+        mastercore::EnableBalanceNotifications(std::set<std::string>(vFilter.begin(), vFilter.end()));
+        omniConnections.push_back(uiInterface.OmniBalancesChanged_connect(std::bind(&CZMQNotificationInterface::OmniBalancesChanged, this,
+                std::placeholders::_1, std::placeholders::_2)));
+        break;
+    }
+
+    // transaction records are only built, when transactions or blocks are published
+    for (const CZMQAbstractNotifier* notifier : notifiers) {
+        if (notifier->GetType() != "pubomnitx" && notifier->GetType() != "pubomniblock") continue;
+        mastercore::EnableTransactionNotifications();
+        omniConnections.push_back(uiInterface.OmniTransactionRecorded_connect(std::bind(&CZMQNotificationInterface::OmniTransactionRecorded, this,
+                std::placeholders::_1)));
+        omniConnections.push_back(uiInterface.OmniBlockChanged_connect(std::bind(&CZMQNotificationInterface::OmniBlockChanged, this,
+                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)));
+        break;
+    }
+
     return true;
 }
 
@@ -122,6 +159,13 @@ bool CZMQNotificationInterface::Initialize()
 void CZMQNotificationInterface::Shutdown()
 {
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
+    for (boost::signals2::connection& connection : omniConnections) {
+        connection.disconnect();
+    }
+    omniConnections.clear();
+    mastercore::DisableBalanceNotifications();
+    mastercore::DisableTransactionNotifications();
+
     if (pcontext)
     {
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
@@ -193,4 +237,86 @@ void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CB
     }
 }
 
+void CZMQNotificationInterface::OmniMetaDExTrade(const CMPMetaDEx& seller, const CMPMetaDEx& buyer, int64_t amountSold, int64_t amountReceived, int64_t tradingFee)
+{
+    // The MetaDEx is processed while holding cs_tally, so the orders are copied, and the
+    // messages are sent from the same queue as all other notifications of the sockets.
+    QueueOmniNotification([this, seller, buyer, amountSold, amountReceived, tradingFee] {
+        for (CZMQAbstractNotifier* notifier : notifiers) {
+            if (!notifier->NotifyOmniMetaDExTrade(seller, buyer, amountSold, amountReceived, tradingFee)) {
+                zmqError("Unable to publish Omni trade");
+            }
+        }
+    });
+}
+
+void CZMQNotificationInterface::OmniMetaDExOrderChanged(const CMPMetaDEx& order, ChangeType status)
+{
+    QueueOmniNotification([this, order, status] {
+        for (CZMQAbstractNotifier* notifier : notifiers) {
+            if (!notifier->NotifyOmniMetaDExOrder(order, status)) {
+                zmqError("Unable to publish Omni order");
+            }
+        }
+    });
+}
+
+void CZMQNotificationInterface::OmniBalancesChanged(int block, const std::vector<mastercore::BalanceChange>& changes)
+{
+    QueueOmniNotification([this, block, changes] {
+        for (CZMQAbstractNotifier* notifier : notifiers) {
+            if (!notifier->NotifyOmniBalances(block, changes)) {
+                zmqError("Unable to publish Omni balances");
+            }
+        }
+    });
+}
+
+void CZMQNotificationInterface::OmniTransactionRecorded(const mastercore::TransactionNotification& notification)
+{
+    QueueOmniNotification([this, notification] {
+        for (CZMQAbstractNotifier* notifier : notifiers) {
+            if (!notifier->NotifyOmniTransaction(notification)) {
+                zmqError("Unable to publish Omni transaction");
+            }
+        }
+    });
+}
+
+void CZMQNotificationInterface::OmniBlockChanged(int block, const uint256& blockHash, bool connected)
+{
+    QueueOmniNotification([this, block, blockHash, connected] {
+        for (CZMQAbstractNotifier* notifier : notifiers) {
+            if (!notifier->NotifyOmniBlock(block, blockHash, connected)) {
+                zmqError("Unable to publish Omni block");
+            }
+        }
+    });
+}
+
+/**
+ * Publishes an Omni notification from the validation interface queue.
+ *
+ * The queue isn't bounded, and transactions are processed much faster than messages are sent
+ * during a reparse, so notifications are dropped, while too many are waiting to be published.
+ */
+void CZMQNotificationInterface::QueueOmniNotification(const std::function<void()>& fn)
+{
+    if (nOmniQueued >= nMaxOmniQueued) {
+        if (nOmniDropped++ == 0) {
+            LogPrintf("zmq: Too many Omni notifications are queued, further ones are dropped\n");
+        }
+        return;
+    }
+    ++nOmniQueued;
+    CallFunctionInValidationInterfaceQueue([this, fn] {
+        fn();
+        --nOmniQueued;
+        const size_t nDropped = nOmniDropped.exchange(0);
+        if (nDropped > 0) {
+            LogPrintf("zmq: %d Omni notifications were dropped\n", nDropped);
+        }
+    });
+}
+
 CZMQNotificationInterface* g_zmq_notification_interface = nullptr;
@@ -5,11 +5,29 @@
 #ifndef BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include <ui_interface.h>
 #include <validationinterface.h>
+
+#include <boost/signals2/connection.hpp>
+
+#include <atomic>
+#include <functional>
 #include <list>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
 
 class CBlockIndex;
+class CMPMetaDEx;
 class CZMQAbstractNotifier;
+class uint256;
+namespace mastercore {
+struct BalanceChange;
+struct TransactionNotification;
+}
+
+/** Default for -zmqpubomniqueue, the maximal number of Omni notifications waiting to be published */
+static const size_t DEFAULT_ZMQ_OMNI_QUEUE = 10000;
 
 class CZMQNotificationInterface final : public CValidationInterface
 {
@@ -33,8 +51,21 @@ protected:
 private:
     CZMQNotificationInterface();
 
+    // Omni Core MetaDEx notifications, which are forwarded through the validation interface queue
+    void OmniMetaDExTrade(const CMPMetaDEx& seller, const CMPMetaDEx& buyer, int64_t amountSold, int64_t amountReceived, int64_t tradingFee);
+    void OmniMetaDExOrderChanged(const CMPMetaDEx& order, ChangeType status);
+    void OmniBalancesChanged(int block, const std::vector<mastercore::BalanceChange>& changes);
+    void OmniTransactionRecorded(const mastercore::TransactionNotification& notification);
+    void OmniBlockChanged(int block, const uint256& blockHash, bool connected);
+    void QueueOmniNotification(const std::function<void()>& fn);
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    std::vector<boost::signals2::connection> omniConnections;
+    //! Omni notifications are dropped, while this many are waiting to be published
+    size_t nMaxOmniQueued;
+    std::atomic<size_t> nOmniQueued;
+    std::atomic<size_t> nOmniDropped;
 };
 
 extern CZMQNotificationInterface* g_zmq_notification_interface;
@@ -4,18 +4,28 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <omnicore/balancenotify.h>
+#include <omnicore/mdex.h>
+#include <omnicore/txnotify.h>
 #include <streams.h>
 #include <zmq/zmqpublishnotifier.h>
 #include <validation.h>
 #include <util/system.h>
 #include <rpc/server.h>
 
+#include <univalue.h>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
 static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_OMNITRADE = "omnitrade";
+static const char *MSG_OMNIORDER = "omniorder";
+static const char *MSG_OMNIBALANCE = "omnibalance";
+static const char *MSG_OMNITX    = "omnitx";
+static const char *MSG_OMNIBLOCK = "omniblock";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -207,3 +217,94 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishOmniTradeNotifier::NotifyOmniMetaDExTrade(const CMPMetaDEx& seller, const CMPMetaDEx& buyer, int64_t amountSold, int64_t amountReceived, int64_t tradingFee)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish omnitrade %s matched by %s\n", seller.getHash().GetHex(), buyer.getHash().GetHex());
+
+    // amounts are published in willets, so no property lookups are needed
+    UniValue trade(UniValue::VOBJ);
+    trade.pushKV("block", buyer.getBlock());
+    trade.pushKV("sellertxid", seller.getHash().GetHex());
+    trade.pushKV("selleraddress", seller.getAddr());
+    trade.pushKV("buyertxid", buyer.getHash().GetHex());
+    trade.pushKV("buyeraddress", buyer.getAddr());
+    trade.pushKV("propertyidsold", (uint64_t) seller.getProperty());
+    trade.pushKV("amountsold", amountSold);
+    trade.pushKV("propertyidreceived", (uint64_t) seller.getDesProperty());
+    trade.pushKV("amountreceived", amountReceived);
+    trade.pushKV("tradingfee", tradingFee);
+
+    const std::string data = trade.write();
+    return SendMessage(MSG_OMNITRADE, data.data(), data.size());
+}
+
+bool CZMQPublishOmniOrderNotifier::NotifyOmniMetaDExOrder(const CMPMetaDEx& order, ChangeType status)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish omniorder %s\n", order.getHash().GetHex());
+
+    std::string event;
+    switch (status) {
+        case CT_NEW: event = "new"; break;
+        case CT_UPDATED: event = "updated"; break;
+        case CT_DELETED: event = (order.getAmountRemaining() == 0) ? "filled" : "cancelled"; break;
+    }
+
+    UniValue orderObj(UniValue::VOBJ);
+    orderObj.pushKV("event", event);
+    orderObj.pushKV("txid", order.getHash().GetHex());
+    orderObj.pushKV("address", order.getAddr());
+    orderObj.pushKV("block", order.getBlock());
+    orderObj.pushKV("propertyidforsale", (uint64_t) order.getProperty());
+    orderObj.pushKV("amountforsale", order.getAmountForSale());
+    orderObj.pushKV("propertyiddesired", (uint64_t) order.getDesProperty());
+    orderObj.pushKV("amountdesired", order.getAmountDesired());
+    orderObj.pushKV("amountremaining", order.getAmountRemaining());
+
+    const std::string data = orderObj.write();
+    return SendMessage(MSG_OMNIORDER, data.data(), data.size());
+}
+
+bool CZMQPublishOmniBalanceNotifier::NotifyOmniBalances(int block, const std::vector<mastercore::BalanceChange>& changes)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish omnibalance for %d balances of block %d\n", changes.size(), block);
+
+    UniValue balances(UniValue::VARR);
+    for (const mastercore::BalanceChange& change : changes) {
+        UniValue balanceObj(UniValue::VOBJ);
+        balanceObj.pushKV("address", change.address);
+        balanceObj.pushKV("propertyid", (uint64_t) change.propertyId);
+        balanceObj.pushKV("balance", change.balance);
+        balanceObj.pushKV("reserved", change.reserved);
+        balanceObj.pushKV("txid", change.txid.IsNull() ? "" : change.txid.GetHex());
+        balances.push_back(balanceObj);
+    }
+
+    UniValue blockObj(UniValue::VOBJ);
+    blockObj.pushKV("block", block);
+    blockObj.pushKV("balances", balances);
+
+    const std::string data = blockObj.write();
+    return SendMessage(MSG_OMNIBALANCE, data.data(), data.size());
+}
+
+bool CZMQPublishOmniTransactionNotifier::NotifyOmniTransaction(const mastercore::TransactionNotification& notification)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish omnitx %s\n", notification.txid.GetHex());
+
+    // the record is serialized compactly, as it's published for every Omni transaction
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << notification;
+    return SendMessage(MSG_OMNITX, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishOmniBlockNotifier::NotifyOmniBlock(int block, const uint256& blockHash, bool connected)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish omniblock %s of block %d (%s)\n", connected ? "connected" : "disconnected", block, blockHash.GetHex());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << static_cast<uint8_t>(connected ? 1 : 0);
+    ss << static_cast<int32_t>(block);
+    ss << blockHash;
+    return SendMessage(MSG_OMNIBLOCK, &(*ss.begin()), ss.size());
+}
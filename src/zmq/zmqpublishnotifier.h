@@ -52,4 +52,34 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+class CZMQPublishOmniTradeNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyOmniMetaDExTrade(const CMPMetaDEx& seller, const CMPMetaDEx& buyer, int64_t amountSold, int64_t amountReceived, int64_t tradingFee) override;
+};
+
+class CZMQPublishOmniOrderNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyOmniMetaDExOrder(const CMPMetaDEx& order, ChangeType status) override;
+};
+
+class CZMQPublishOmniBalanceNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyOmniBalances(int block, const std::vector<mastercore::BalanceChange>& changes) override;
+};
+
+class CZMQPublishOmniTransactionNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyOmniTransaction(const mastercore::TransactionNotification& notification) override;
+};
+
+class CZMQPublishOmniBlockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyOmniBlock(int block, const uint256& blockHash, bool connected) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
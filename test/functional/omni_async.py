@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017-2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the processing of connected blocks by the Omni thread."""
+
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_greater_than
+
+class OmniAsync(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+        self.extra_args = [["-omniasync"]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def wait_for_omni(self, node):
+        height = node.getblockcount()
+        result = node.omni_waitforblock(height, 60000)
+        assert_equal(result, {"hash": node.getblockhash(height), "height": height})
+
+    def run_test(self):
+        self.log.info("test block processing by the Omni thread")
+
+        node = self.nodes[0]
+
+        # Preparing some mature Bitcoins
+        coinbase_address = node.getnewaddress()
+        node.generatetoaddress(102, coinbase_address)
+
+        # Obtaining a master address to work with
+        address = node.getnewaddress()
+        node.sendtoaddress(address, 20)
+        node.generatetoaddress(1, coinbase_address)
+        self.wait_for_omni(node)
+
+        # Creating an indivisible test property
+        node.omni_sendissuancefixed(address, 1, 1, 0, "", "", "TST", "", "", "1000")
+        node.generatetoaddress(1, coinbase_address)
+        self.wait_for_omni(node)
+        property_id = 3
+
+        receiver = node.getnewaddress()
+        node.omni_send(address, receiver, property_id, "10")
+        node.generatetoaddress(1, coinbase_address)
+        self.wait_for_omni(node)
+        assert_equal(node.omni_getbalance(receiver, property_id)['balance'], "10")
+        assert_equal(node.omni_getinfo()['omniblock'], node.getblockcount())
+
+        # The send is rolled back, when its block is replaced
+        node.invalidateblock(node.getbestblockhash())
+        node.generatetoaddress(2, coinbase_address)
+        self.wait_for_omni(node)
+        assert_equal(node.omni_getbalance(receiver, property_id)['balance'], "10")
+
+        # A block, which was not processed yet, isn't reported
+        result = node.omni_waitforblock(node.getblockcount() + 1, 100)
+        assert_equal(result['height'], node.getblockcount())
+
+        self.log.info("test that the chain advances, while the Omni thread is inside a block")
+
+        # Every block holds the Omni thread for two seconds, while it executes the transactions
+        self.restart_node(0, ["-omniasync", "-omniblockdelay=2000"])
+        node = self.nodes[0]
+        self.wait_for_omni(node)
+
+        # The blocks are connected, while the Omni thread still executes the first one
+        start = time.time()
+        node.generatetoaddress(3, coinbase_address)
+        assert_greater_than(4, time.time() - start)
+        self.wait_for_omni(node)
+        assert_equal(node.omni_getbalance(receiver, property_id)['balance'], "10")
+
+if __name__ == '__main__':
+    OmniAsync().main()
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017-2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the replay of a block range."""
+
+import os
+import re
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+class OmniReplay(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.log.info("test block range replay")
+
+        node = self.nodes[0]
+
+        # Preparing some mature Bitcoins
+        coinbase_address = node.getnewaddress()
+        node.generatetoaddress(102, coinbase_address)
+
+        # Obtaining a master address to work with
+        address = node.getnewaddress()
+        node.sendtoaddress(address, 20)
+        node.generatetoaddress(1, coinbase_address)
+
+        # Creating an indivisible test property, and sending tokens in the blocks to replay
+        node.omni_sendissuancefixed(address, 1, 1, 0, "", "", "TST", "", "", "1000")
+        node.generatetoaddress(1, coinbase_address)
+        property_id = 3
+        first_block = node.getblockcount() + 1
+
+        receiver = node.getnewaddress()
+        for amount in ["10", "20", "30"]:
+            node.omni_send(address, receiver, property_id, amount)
+            node.generatetoaddress(1, coinbase_address)
+
+        last_block = node.getblockcount()
+        consensus_hash = node.omni_getcurrentconsensushash()['consensushash']
+
+        # The replay shuts the node down, once the blocks are processed
+        self.stop_node(0)
+        node.start(extra_args=["-omnireplay={}:{}".format(first_block, last_block)])
+        node.wait_until_stopped()
+
+        with open(os.path.join(node.datadir, self.chain, 'omnicore.log'), encoding='utf-8') as log:
+            finished = re.findall(r"Replay of blocks (\d+) to (\d+) finished, consensus hash after block (\d+): ([0-9a-f]+)", log.read())
+        assert_equal(finished, [(str(first_block), str(last_block), str(last_block), consensus_hash)])
+
+        # The Omni data of the datadir was left untouched
+        self.start_node(0)
+        assert_equal(node.getblockcount(), last_block)
+        assert_equal(node.omni_getcurrentconsensushash()['consensushash'], consensus_hash)
+        assert_equal(node.omni_getbalance(receiver, property_id)['balance'], "60")
+
+if __name__ == '__main__':
+    OmniReplay().main()
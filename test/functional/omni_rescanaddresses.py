@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017-2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the Omni address rescan."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+
+class OmniRescanAddresses(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.log.info("test address rescan")
+
+        node = self.nodes[0]
+
+        # Preparing some mature Bitcoins
+        coinbase_address = node.getnewaddress()
+        node.generatetoaddress(102, coinbase_address)
+
+        # Obtaining a master address to work with
+        address = node.getnewaddress()
+        node.sendtoaddress(address, 20)
+        node.generatetoaddress(1, coinbase_address)
+
+        # Creating an indivisible test property, and sending some tokens to a receiver
+        node.omni_sendissuancefixed(address, 1, 1, 0, "", "", "TST", "", "", "1000")
+        node.generatetoaddress(1, coinbase_address)
+        property_id = 3
+
+        receiver = node.getnewaddress()
+        txid = node.omni_send(address, receiver, property_id, "25")
+        node.generatetoaddress(10, coinbase_address)
+        self.sync_all()
+
+        # The second node watches the receiver, without rescanning the chain
+        watcher = self.nodes[1]
+        assert_raises_rpc_error(-5, None, watcher.omni_rescanaddresses, [receiver])
+        watcher.importaddress(receiver, "", False)
+        assert_equal(watcher.omni_listtransactions(), [])
+
+        result = watcher.omni_rescanaddresses([receiver])
+        assert_equal(result['transactions'], 1)
+        assert_equal(result['blocks'], 1)
+        assert_equal(result['stop_height'], watcher.getblockcount())
+
+        transactions = watcher.omni_listtransactions()
+        assert_equal(len(transactions), 1)
+        assert_equal(transactions[0]['txid'], txid)
+        assert_equal(transactions[0]['referenceaddress'], receiver)
+
+        # Nothing is found beyond the transaction
+        result = watcher.omni_rescanaddresses([receiver], watcher.getblockcount())
+        assert_equal(result['transactions'], 0)
+        assert_equal(result['blocks'], 0)
+
+if __name__ == '__main__':
+    OmniRescanAddresses().main()
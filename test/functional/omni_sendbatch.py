@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017-2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test Omni batch sends."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+
+class OmniSendBatch(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.log.info("test batch sends")
+
+        node = self.nodes[0]
+
+        # Preparing some mature Bitcoins
+        coinbase_address = node.getnewaddress()
+        node.generatetoaddress(102, coinbase_address)
+
+        # Obtaining a master address to work with, funded with a single output
+        address = node.getnewaddress()
+        node.sendtoaddress(address, 20)
+        node.generatetoaddress(1, coinbase_address)
+
+        # Creating an indivisible test property
+        node.omni_sendissuancefixed(address, 1, 1, 0, "", "", "TST", "", "", "1000")
+        node.generatetoaddress(1, coinbase_address)
+        property_id = 3
+
+        receivers = [node.getnewaddress() for _ in range(5)]
+        sends = [{"toaddress": receiver, "propertyid": property_id, "amount": str(i + 1)} for i, receiver in enumerate(receivers)]
+
+        # Checking the total of the sends is covered by the balance
+        too_much = [{"toaddress": receivers[0], "propertyid": property_id, "amount": "600"},
+                    {"toaddress": receivers[1], "propertyid": property_id, "amount": "600"}]
+        assert_raises_rpc_error(-3, None, node.omni_sendbatch, address, too_much)
+        assert_raises_rpc_error(-8, None, node.omni_sendbatch, address, [])
+
+        # Sending the batch, which has to chain the change of the single funding output
+        txids = node.omni_sendbatch(address, sends)
+        assert_equal(len(txids), len(sends))
+        node.generatetoaddress(1, coinbase_address)
+
+        for i, txid in enumerate(txids):
+            result = node.omni_gettransaction(txid)
+            assert_equal(result['valid'], True)
+            assert_equal(result['sendingaddress'], address)
+            assert_equal(result['referenceaddress'], receivers[i])
+            assert_equal(result['amount'], str(i + 1))
+            assert_equal(node.omni_getbalance(receivers[i], property_id)['balance'], str(i + 1))
+
+        # Each transaction spends the change of the previous one
+        for previous, txid in zip(txids, txids[1:]):
+            spent = [vin['txid'] for vin in node.decoderawtransaction(node.gettransaction(txid)['hex'])['vin']]
+            assert previous in spent
+
+        assert_equal(node.omni_getbalance(address, property_id)['balance'], "985")
+
+if __name__ == '__main__':
+    OmniSendBatch().main()
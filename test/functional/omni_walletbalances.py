@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017-2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the Omni wallet balances of imported addresses."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+class OmniWalletBalances(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.log.info("test wallet balances of imported addresses")
+
+        node = self.nodes[0]
+
+        # Preparing some mature Bitcoins
+        coinbase_address = node.getnewaddress()
+        node.generatetoaddress(102, coinbase_address)
+
+        # Obtaining a master address to work with
+        address = node.getnewaddress()
+        node.sendtoaddress(address, 20)
+        node.generatetoaddress(1, coinbase_address)
+
+        # Creating an indivisible test property, and sending some tokens to a receiver
+        node.omni_sendissuancefixed(address, 1, 1, 0, "", "", "TST", "", "", "1000")
+        node.generatetoaddress(1, coinbase_address)
+        property_id = 3
+
+        receiver = node.getnewaddress()
+        node.omni_send(address, receiver, property_id, "25")
+        node.generatetoaddress(1, coinbase_address)
+        self.sync_all()
+
+        # The second node holds no tokens, until the funded receiver is imported
+        importer = self.nodes[1]
+        assert_equal(importer.omni_getwalletbalances(), [])
+
+        importer.importprivkey(node.dumpprivkey(receiver), "", False)
+        expected = [{'propertyid': property_id, 'name': 'TST', 'balance': '25', 'reserved': '0', 'frozen': '0'}]
+        assert_equal(importer.omni_getwalletbalances(), expected)
+
+        # The balance remains, after blocks without changes of the receiver were processed
+        node.generatetoaddress(1, coinbase_address)
+        self.sync_all()
+        assert_equal(importer.omni_getwalletbalances(), expected)
+        assert_equal(importer.omni_getbalance(receiver, property_id)['balance'], '25')
+
+if __name__ == '__main__':
+    OmniWalletBalances().main()
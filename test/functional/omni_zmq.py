@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+# Copyright (c) 2017-2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the Omni ZMQ notifications of MetaDEx trades and orders."""
+
+import json
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, p2p_port
+from time import sleep
+
+class OmniZMQ(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_py3_zmq()
+        self.skip_if_no_bitcoind_zmq()
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        import zmq
+        self.ctx = zmq.Context()
+        try:
+            self.test_metadex()
+        finally:
+            self.ctx.destroy(linger=None)
+
+    def receive(self, topic):
+        received, body, seq = self.socket.recv_multipart()
+        assert_equal(received, topic)
+        return json.loads(body.decode())
+
+    def test_metadex(self):
+        self.log.info("test MetaDEx notifications")
+        import zmq
+
+        address = "tcp://127.0.0.1:%d" % p2p_port(self.num_nodes)
+        self.socket = self.ctx.socket(zmq.SUB)
+        self.socket.set(zmq.RCVTIMEO, 60000)
+        self.socket.setsockopt(zmq.SUBSCRIBE, b"omnitrade")
+        self.socket.setsockopt(zmq.SUBSCRIBE, b"omniorder")
+        self.restart_node(0, ["-zmqpubomnitrade=%s" % address, "-zmqpubomniorder=%s" % address])
+        self.socket.connect(address)
+        # Relax so that the subscriber is ready before publishing zmq messages
+        sleep(0.2)
+
+        node = self.nodes[0]
+
+        # Preparing some mature Bitcoins
+        coinbase_address = node.getnewaddress()
+        node.generatetoaddress(101, coinbase_address)
+
+        # Obtaining a maker and a taker address, funded with some BTC for fees
+        maker = node.getnewaddress()
+        taker = node.getnewaddress()
+        node.sendtoaddress(maker, 20)
+        node.sendtoaddress(taker, 20)
+        node.generatetoaddress(1, coinbase_address)
+
+        # Participating in the Exodus crowdsale to obtain some OMNI, which are passed on to the taker
+        node.sendmany("", {"moneyqMan7uh8FqdCA2BV5yZ8qVrc9ikLP": 10, maker: 4})
+        node.generatetoaddress(10, coinbase_address)
+        node.omni_send(maker, taker, 1, "2.0")
+        node.generatetoaddress(1, coinbase_address)
+
+        # Creating an indivisible test property
+        node.omni_sendissuancefixed(maker, 1, 1, 0, "", "", "TST", "", "", "1000")
+        node.generatetoaddress(1, coinbase_address)
+        property_id = 3
+
+        # The order of the maker is added to the order book
+        maker_txid = node.omni_sendtrade(maker, property_id, "100", 1, "1.0")
+        node.generatetoaddress(1, coinbase_address)
+        order = self.receive(b"omniorder")
+        assert_equal(order['event'], "new")
+        assert_equal(order['txid'], maker_txid)
+        assert_equal(order['address'], maker)
+        assert_equal(order['propertyidforsale'], property_id)
+        assert_equal(order['amountforsale'], 100)
+        assert_equal(order['propertyiddesired'], 1)
+        assert_equal(order['amountdesired'], 100000000)
+        assert_equal(order['amountremaining'], 100)
+
+        # The order of the taker is filled right away, and the order of the maker partially
+        taker_txid = node.omni_sendtrade(taker, 1, "0.5", property_id, "50")
+        node.generatetoaddress(1, coinbase_address)
+        trade = self.receive(b"omnitrade")
+        assert_equal(trade['block'], node.getblockcount())
+        assert_equal(trade['sellertxid'], maker_txid)
+        assert_equal(trade['selleraddress'], maker)
+        assert_equal(trade['buyertxid'], taker_txid)
+        assert_equal(trade['buyeraddress'], taker)
+        assert_equal(trade['propertyidsold'], property_id)
+        assert_equal(trade['amountsold'], 50)
+        assert_equal(trade['propertyidreceived'], 1)
+        assert_equal(trade['amountreceived'], 50000000)
+        assert_equal(trade['tradingfee'], 0)
+
+        order = self.receive(b"omniorder")
+        assert_equal(order['event'], "updated")
+        assert_equal(order['txid'], maker_txid)
+        assert_equal(order['amountremaining'], 50)
+
+        order = self.receive(b"omniorder")
+        assert_equal(order['event'], "filled")
+        assert_equal(order['txid'], taker_txid)
+        assert_equal(order['address'], taker)
+        assert_equal(order['amountremaining'], 0)
+
+        # The remaining order of the maker is cancelled
+        node.omni_sendcanceltradesbyprice(maker, property_id, "100", 1, "1.0")
+        node.generatetoaddress(1, coinbase_address)
+        order = self.receive(b"omniorder")
+        assert_equal(order['event'], "cancelled")
+        assert_equal(order['txid'], maker_txid)
+        assert_equal(order['amountremaining'], 50)
+
+if __name__ == '__main__':
+    OmniZMQ().main()
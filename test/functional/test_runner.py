@@ -236,7 +236,13 @@ BASE_SCRIPTS = [
     'omni_dexversionsspec.py',
     'omni_feecache.py',
     'omni_delegation.py',
-    'omni_nonfungibletokens.py'
+    'omni_nonfungibletokens.py',
+    'omni_sendbatch.py',
+    'omni_rescanaddresses.py',
+    'omni_walletbalances.py',
+    'omni_zmq.py',
+    'omni_replay.py',
+    'omni_async.py'
     # Don't append tests at the end to avoid merge conflicts
     # Put them in a random line within the section that fits their approximate run-time
 ]